@@ -2,11 +2,78 @@
 #ifndef INC_BL_H_
 #define INC_BL_H_
 
+#include "BL_config.h"
+
+/*
+ * Bootloader Version
+ * ------------------
+ * Defines the current version of the Bootloader.
+ */
+#define BL_VERSION     1u  /* Bootloader version 1 */
+
 /*
  * Bootloader Acknowledgment Codes
  */
 #define BL_ACK                       0xA5     /* Acknowledgment response from Bootloader */
 #define BL_NACK                      0x7F    /* Negative acknowledgment (Invalid command or failure) */
+#define BL_PROGRESS_MARKER           0xA6     /* Unsolicited progress frame (BL_SET_PROGRESS) */
+
+
+/*
+ * Frame Formats
+ * -------------
+ * v1 frame       : [Length to Follow (1)] [Command] [Payload ...] [CRC32 (4)]
+ * Extended frame : [BL_FRAME_EXT_MARKER] [Length to Follow (2, little endian)] [Command] [Payload ...] [CRC32 (4)]
+ * Aligned frame  : [BL_FRAME_ALIGNED_MARKER] [Length to Follow (2, little endian)] [Command] [Payload ...] [Padding] [CRC32 (4)]
+ *
+ * A v1 length of 0 can never describe a valid frame, so it marks the extended
+ * format, which carries payloads of up to BL_MAX_PAYLOAD_LENGTH bytes.
+ * A v1 length of 1 is just as impossible and marks the aligned format: the
+ * header is 4 bytes and the payload is zero-padded to a multiple of 4, so in a
+ * word-aligned receive buffer the payload and the CRC start on word boundaries.
+ * Its "Length to Follow" counts Command + Payload + CRC, without the padding.
+ * The write commands lay their aligned payload out as BL_AlignedWrite_t /
+ * BL_AlignedStream_t, whose data block is then word-aligned for the flash.
+ * The CRC covers every byte before it, header (and padding) included.
+ */
+#define BL_FRAME_EXT_MARKER          0x00     /* First byte of an extended (16-bit length) frame */
+#define BL_FRAME_ALIGNED_MARKER      0x01     /* First byte of an aligned (padded payload) frame */
+#define BL_FRAME_EXT_HEADER_LENGTH   3u       /* Marker + 16-bit "Length to Follow" */
+#define BL_FRAME_ALIGNED_PAD(LENGTH) (((LENGTH) + 3u) & ~3u) /* Payload length rounded up to a word */
+/* BL_MAX_PAYLOAD_LENGTH, the largest data block carried by one frame: BL_config.h */
+
+/* BL_RESPONSE_CRC_ENABLE (CRC32 trailer on ACK responses): BL_config.h */
+
+/* Command code of a received frame, in either format */
+#define BL_FRAME_COMMAND(PACKET)     (((PACKET)[0] <= BL_FRAME_ALIGNED_MARKER) ? (PACKET)[BL_FRAME_EXT_HEADER_LENGTH] : (PACKET)[1])
+
+/*
+ * Aligned Write Payloads
+ * ----------------------
+ * Payload of BL_MEM_WRITE / BL_MEM_WRITE_POSTED (BL_AlignedWrite_t) and of
+ * BL_MEM_WRITE_STREAM (BL_AlignedStream_t) in an aligned frame: every field
+ * sits on its natural boundary and Data starts on a word, so the handlers read
+ * the header with plain loads and the flash is programmed a word at a time
+ * straight from the receive buffer. Little endian, Reserved fields are 0.
+ */
+typedef struct
+{
+	uint32_t Address;                           /* Destination of Data */
+	uint16_t Length;                            /* Bytes in Data */
+	uint16_t Reserved;
+	uint8_t  Data[];
+} BL_AlignedWrite_t;
+
+typedef struct
+{
+	uint16_t Sequence;                          /* As the v1 stream packet */
+	uint8_t  Flags;                             /* BL_STREAM_FLAG_xxx */
+	uint8_t  Reserved;
+	uint32_t Address;                           /* Destination of Data */
+	uint16_t Length;                            /* Bytes in Data */
+	uint16_t Reserved2;
+	uint8_t  Data[];
+} BL_AlignedStream_t;
 
 
 /*
@@ -27,6 +94,959 @@
 #define BL_READ_SECTOR_STATUS        0x5A  /* Get the protection status of memory sectors */
 #define BL_OTP_READ                  0x5B  /* Read One-Time Programmable (OTP) memory */
 #define BL_DIS_WR_PROTECT            0x5C  /* Disable write protection for memory sectors */
+#define BL_MEM_WRITE_STREAM          0x5D  /* Windowed write: sequence-numbered packets, cumulative ACK */
+#define BL_CHANGE_BAUD               0x5E  /* Switch USART2 to a new baud rate */
+#define BL_MEM_COMPARE               0x5F  /* Compare a memory block with the CRC of the host's copy */
+#define BL_FLASH_ERASE_STATUS        0x60  /* Progress of a background erase started by BL_FLASH_ERASE */
+#define BL_MEM_WRITE_POSTED          0x61  /* MEM_WRITE acknowledged before programming, status reported one packet later */
+#define BL_BEGIN_PROGRAM             0x62  /* Open a programming session: flash stays unlocked */
+#define BL_END_PROGRAM               0x63  /* Close the programming session and relock the flash */
+#define BL_ERASE_RANGE               0x64  /* Erase the sectors covering an address range */
+#define BL_VERIFY_RANGE              0x65  /* Digest of a flash / SRAM range computed on the device */
+#define BL_COMMIT                    0x66  /* Check the running CRC of the session's writes */
+#define BL_BLOCK_CRC_MANIFEST        0x67  /* CRC of every fixed-size block of a range */
+#define BL_SET_FRAME_CRC             0x68  /* Switch the per-frame CRC check off / on (USB only) */
+#define BL_GET_DEVICE_INFO           0x69  /* Version, IDs, protections, limits and features in one reply */
+#define BL_READ_MULTI                0x6A  /* Scattered ranges concatenated in one CRC-checked reply */
+#define BL_BLANK_MAP                 0x6B  /* Erased ranges of a flash area at a given granularity */
+#define BL_BATCH                     0x6C  /* Sequence of sub-commands under one CRC, one status each */
+#define BL_RESUME_SESSION            0x6D  /* Reopen the programming session saved in backup SRAM */
+#define BL_GET_CAPABILITIES          0x6E  /* Limits and optional features of this build, for negotiation */
+#define BL_SET_FRAMING               0x6F  /* Switch between length-prefixed and COBS framing */
+#define BL_MEM_WRITE_LZ              0x70  /* Write an LZ-compressed stream, decoded into flash */
+#define BL_MEM_WRITE_DELTA           0x71  /* Rebuild an image from the installed one and a binary patch */
+#define BL_MEM_FILL                  0x72  /* Fill a range with a 32-bit pattern */
+#define BL_GET_BOOT_TIMES            0x73  /* Read the boot milestone cycle stamps */
+#define BL_RAM_RUN                   0x74  /* Start an image loaded into the RAM run area */
+#define BL_SLOT_ACTIVATE             0x75  /* Query / switch the active A/B application slot */
+#define BL_GET_WEAR_STATS            0x76  /* Erase count of every flash sector */
+#define BL_GET_STATS                 0x77  /* Per-command cycle counters and link counters */
+#define BL_GET_TRACE                 0x78  /* Event trace ring readout */
+#define BL_BROADCAST_STATUS          0x79  /* RS-485 broadcast writes this node missed */
+#define BL_GET_CRASH_RECORD          0x7A  /* Last fault saved by a fault handler */
+#define BL_ERASE_FOR_IMAGE           0x7B  /* Plan (and run) the cheapest erase for an image range */
+#define BL_DISCOVER                  0x7C  /* Unique ID search of the nodes on a CAN / RS-485 bus */
+#define BL_MEM_WRITE_PACKAGE         0x7D  /* Stream a pre-planned update package (BL_Package.h) */
+#define BL_SELF_UPDATE               0x7E  /* Replace the bootloader with an image staged in flash */
+                                           /* 0x7F is BL_NACK, never used as a command code */
+#define BL_RESET_AND_BOOT            0x80  /* Leave update mode: clean handoff to the application, or reset */
+#define BL_GET_APP_INFO              0x81  /* Parsed image header of every application slot */
+#define BL_PROGRAM_FROM_RAM          0x82  /* Program flash from an image uploaded to the RAM run area */
+#define BL_SET_PROGRESS              0x83  /* Progress frames during long commands on / off */
+#define BL_RUN_SCRIPT                0x84  /* Run a BL_BATCH recipe uploaded to the RAM run area */
+#define BL_ECHO                      0x85  /* Reply of N bytes: the data sent, then a pattern (link benchmark) */
+#define BL_SINK                      0x86  /* Frame counted and dropped, counters on request (link benchmark) */
+
+
+/*
+ * Programming Session
+ * -------------------
+ * Between BL_BEGIN_PROGRAM and BL_END_PROGRAM the flash is unlocked once
+ * instead of per packet. The session closes itself after
+ * BL_SESSION_TIMEOUT_MS without flash activity and before any jump.
+ *
+ * BL_MEM_WRITE to flash is write-combined inside a session: contiguous data
+ * is programmed in aligned 16-byte lines whatever the packet size, and a
+ * partial last line is programmed at the next discontinuous write or at
+ * BL_END_PROGRAM, whose status also covers it.
+ *
+ * Every payload byte successfully written in a session (MEM_WRITE, stream,
+ * posted) feeds a running word-wise CRC and SHA-256, in the order written.
+ * BL_COMMIT [expected CRC (4)] [expected length (4)] [expected SHA-256 (32, optional)]
+ * compares them with the host's image.
+ *
+ * BL_BEGIN_PROGRAM [target address (4)] [target length (4)] (optional) opens a
+ * resumable session: after every write that extends the contiguously written
+ * prefix of the target range (and leaves nothing staged), the range, the
+ * erased-sector bitmap, the prefix length and the running CRC / SHA-256 are
+ * saved in backup SRAM. After a cable pull, a host crash or a reset (backup
+ * SRAM survives a reset, and power loss with VBAT) BL_RESUME_SESSION reopens the
+ * session from that record and replies
+ *     [status] [target address (4)] [target length (4)] [written (4)] [CRC of the written prefix (4)]
+ *     [decrypting (1), see below]
+ * The host goes on at target address + written, without erasing again.
+ * A write outside the prefix makes the session non-resumable; BL_END_PROGRAM
+ * and a new BL_BEGIN_PROGRAM discard the record.
+ * With BL_JOURNAL_ENABLE the session is also logged in flash (BL_Journal.h):
+ * at boot, BL_uint8SessionRecover() rebuilds a record lost with backup SRAM.
+ *
+ * Encrypted Session (BL_DECRYPT_ENABLE, BL_FEATURE_DECRYPT)
+ * ---------------------------------------------------------
+ * BL_BEGIN_PROGRAM [target address (4)] [target length (4)] [initial counter block (16)]
+ * opens a decrypting session: the BL_MEM_WRITE, BL_MEM_WRITE_POSTED and
+ * BL_MEM_WRITE_STREAM data landing in the target range is AES-CTR
+ * ciphertext (BL_AES.h, the key built into the bootloader), the byte at
+ * target address + n encrypted with keystream byte n. The counter follows
+ * the address, not the order of arrival, so retransmissions, selective
+ * repeats and resumed sessions need nothing special. Data outside the range
+ * and the other write commands are taken as they are. The frame is
+ * decrypted in place before it is written: the flash, the running CRC /
+ * SHA-256 and BL_COMMIT see the plaintext image.
+ * The counter block is saved in the session record; the [decrypting] byte
+ * of the BL_RESUME_SESSION reply is 0 when the session it reopened is not
+ * decrypting (one recovered from the journal's OPEN entry alone): a host
+ * sending ciphertext starts over with a new BL_BEGIN_PROGRAM. A bootloader
+ * without decryption refuses a counter block (HAL_ERROR).
+ */
+#define BL_SESSION_TIMEOUT_MS        10000u
+
+#define BL_SESSION_COUNTER_SIZE      16u   /* Initial counter block of an encrypted session */
+
+
+/*
+ * Background Erase
+ * ----------------
+ * An optional third BL_FLASH_ERASE payload byte BL_ERASE_FLAG_ASYNC starts the
+ * sector erase in the background: the reply comes at once, sectors are erased
+ * one by one (FLASH interrupt) and BL_FLASH_ERASE_STATUS reports
+ *     [state] [sectors done] [sectors total] [blank-skipped bitmap (2, LE)]
+ * Frames received meanwhile are buffered; commands that touch flash wait for
+ * the erase to finish. MASS_ERASE is always synchronous.
+ *
+ * BL_ERASE_RANGE takes [address (4, LE)] [length (4, LE)] [flags (optional)]
+ * and erases every sector the range touches, with the same reply and flags.
+ *
+ * BL_ERASE_FLAG_PLAN (either command, synchronous, not MASS_ERASE) reads the
+ * write protection from the option bytes first: protected sectors are never
+ * issued, every other requested sector is erased even after one fails. The
+ * reply is [status] [result of sector 0] ... [result of sector 11], status
+ * HAL_OK when every requested sector ended ERASED or BLANK, so the host only
+ * retries (or unprotects) the sectors that need it.
+ */
+#define BL_ERASE_FLAG_ASYNC          0x01
+#define BL_ERASE_FLAG_PLAN           0x02
+
+#define BL_ERASE_SECTOR_UNTOUCHED    0x00  /* Not requested */
+#define BL_ERASE_SECTOR_ERASED       0x01
+#define BL_ERASE_SECTOR_BLANK        0x02  /* Already blank, not erased */
+#define BL_ERASE_SECTOR_PROTECTED    0x03  /* nWRP bit clear, not issued */
+#define BL_ERASE_SECTOR_REFUSED      0x04  /* Running A/B slot */
+#define BL_ERASE_SECTOR_FAILED       0x05
+#define BL_ERASE_PLAN_REPLY_SIZE     13u   /* [status] [12 x result] */
+
+#define BL_ERASE_IDLE                0x00  /* No background erase since reset */
+#define BL_ERASE_RUNNING             0x01
+#define BL_ERASE_DONE                0x02
+#define BL_ERASE_FAILED              0x03  /* Stopped at sector "first + done" */
+
+
+/*
+ * Streaming Write Flags
+ * ---------------------
+ * Carried in the flags byte of every BL_MEM_WRITE_STREAM packet.
+ */
+#define BL_STREAM_FLAG_START         0x01  /* First packet of a stream, resets the expected sequence number */
+#define BL_STREAM_FLAG_LAST          0x02  /* Last packet of a stream, requests an immediate ACK */
+#define BL_STREAM_FLAG_AUTO_ERASE    0x04  /* With START: erase each sector on the first write into it */
+#define BL_STREAM_FLAG_DIFFERENTIAL  0x08  /* With START: program only the words that differ from flash */
+#define BL_STREAM_FLAG_SELECTIVE     0x10  /* With START: selective retransmission (see below) */
+
+/*
+ * Streaming Write Status
+ * ----------------------
+ * First payload byte of a BL_MEM_WRITE_STREAM response, followed by the
+ * next sequence number the Bootloader expects (16-bit, little endian).
+ */
+#define BL_STREAM_ACK                0x00  /* Every packet before "next sequence" has been written */
+#define BL_STREAM_RETRANSMIT         0x01  /* Packet "next sequence" was lost or corrupted, resend from it */
+#define BL_STREAM_WRITE_ERROR        0x02  /* Packet "next sequence" failed to program or has an invalid address */
+#define BL_STREAM_ERASE_REQUIRED     0x03  /* Differential: packet "next sequence" needs a 0 -> 1 bit change;
+                                              erase its sector and resend every packet of that sector */
+#define BL_STREAM_MISSING            0x04  /* Selective: resend "next sequence" and every packet the bitmap lacks */
+
+/*
+ * Selective Retransmission
+ * ------------------------
+ * In a stream started with BL_STREAM_FLAG_SELECTIVE, a packet up to
+ * BL_STREAM_SELECTIVE_WINDOW - 1 sequence numbers ahead of "next sequence" is
+ * written at once (every packet carries its own address), so a lost or
+ * corrupted packet only costs its own retransmission. Every response then
+ * carries 5 more bytes:
+ *     [received bitmap (4, LE)] : bit n set, packet "next sequence" + n is written
+ *     [failed offset (1)]       : WRITE_ERROR / ERASE_REQUIRED name packet
+ *                                 "next sequence" + offset, 0 otherwise
+ * BL_STREAM_MISSING is sent once when a gap appears (and again when a
+ * retransmission fills a gap while others remain), on a corrupted packet and
+ * on the packet flagged BL_STREAM_FLAG_LAST. The running CRC / SHA-256 of the
+ * image still follows the sequence order.
+ * BL_STREAM_SELECTIVE_WINDOW is set in BL_config.h.
+ */
+
+/*
+ * Block Compare Status
+ * --------------------
+ * Reply of BL_MEM_COMPARE. The host skips blocks that already match.
+ */
+#define BL_COMPARE_MATCH             0x00  /* Memory content has the host's CRC */
+#define BL_COMPARE_DIFFER            0x01  /* Content differs, block must be written */
+#define BL_COMPARE_INVALID           0x02  /* Address range outside flash / SRAM */
+
+
+/*
+ * Range Verification
+ * ------------------
+ * BL_VERIFY_RANGE takes [address (4, LE)] [length (4, LE)] [algorithm (optional)]
+ * and replies [status] [digest], so an image is verified in one round trip
+ * instead of being read back.
+ */
+#define BL_VERIFY_ALGO_CRC32         0x00  /* Word-wise CRC-32 of BL_CRC.h, 4-byte digest (LE) */
+#define BL_VERIFY_ALGO_SHA256        0x01  /* SHA-256 (BL_SHA256.h), 32-byte digest */
+#define BL_VERIFY_ALGO_CRC32_IEEE    0x02  /* Standard (zlib) CRC-32, "IEEE CRC-32" in BL_CRC.h, 4-byte digest (LE) */
+#define BL_VERIFY_FLAG_CYCLES        0x80  /* Or-ed into the algorithm: append the CPU cycles spent (4, LE) */
+
+
+/*
+ * Block CRC Manifest
+ * ------------------
+ * BL_BLOCK_CRC_MANIFEST takes [address (4)] [length (4)] [block size (2)]
+ * [flags (1, optional)] and replies [status] [block count (2)] [CRC (4) per
+ * block], as many blocks as fit in one reply. The CRCs are word-wise, or the
+ * standard CRC-32 with BL_MANIFEST_FLAG_IEEE.
+ */
+#define BL_MANIFEST_FLAG_IEEE        0x01  /* Standard (zlib) CRC-32 per block */
+#define BL_MANIFEST_MAX_BLOCKS       ((BL_MAX_PAYLOAD_LENGTH - 3u) / 4u)
+
+
+/*
+ * Device Info
+ * -----------
+ * BL_GET_DEVICE_INFO answers what a host asks at connect (GET_VERSION,
+ * GET_HELP, GET_CID, GET_RDP_STATUS, READ_SECTOR_STATUS) in one round trip:
+ * a BL_DeviceInfo_t (little endian, packed) followed by CommandCount
+ * command codes.
+ */
+#define BL_DEVICE_INFO_VERSION       1u    /* Layout of BL_DeviceInfo_t */
+
+/* BL_DeviceInfo_t.Features */
+#define BL_FEATURE_EXT_FRAMES        (1UL << 0)  /* 16-bit length frames, payloads up to MaxPayload */
+#define BL_FEATURE_RESPONSE_CRC      (1UL << 1)  /* BL_RESPONSE_CRC_ENABLE */
+#define BL_FEATURE_CRC_WORDWISE      (1UL << 2)  /* BL_CRC_WORDWISE_ENABLE */
+#define BL_FEATURE_USB               (1UL << 3)  /* BL_TRANSPORT_USB_ENABLE */
+#define BL_FEATURE_SPI               (1UL << 4)  /* BL_TRANSPORT_SPI_ENABLE */
+#define BL_FEATURE_UART_FLOW_CONTROL (1UL << 5)  /* BL_UART_FLOW_CONTROL_ENABLE */
+#define BL_FEATURE_SIGNATURE         (1UL << 6)  /* BL_SIGNATURE_ENABLE: signed COMMIT required */
+#define BL_FEATURE_WRITE_VERIFY      (1UL << 7)  /* BL_WRITE_VERIFY_ENABLE */
+#define BL_FEATURE_FRAME_CRC_OFF     (1UL << 8)  /* USB frame CRC currently off (BL_SET_FRAME_CRC) */
+#define BL_FEATURE_ALIGNED_FRAMES    (1UL << 9)  /* BL_FRAME_ALIGNED_MARKER frames accepted */
+#define BL_FEATURE_COBS_FRAMING      (1UL << 10) /* BL_SET_FRAMING to COBS-delimited frames */
+#define BL_FEATURE_CAN               (1UL << 11) /* BL_TRANSPORT_CAN_ENABLE */
+#define BL_FEATURE_RS485             (1UL << 12) /* BL_RS485_ENABLE: node headers on USART2 */
+#define BL_FEATURE_UF2               (1UL << 13) /* BL_USB_MSC_ENABLE: USB drive taking .uf2 files */
+#define BL_FEATURE_CRC_IEEE          (1UL << 14) /* BL_VERIFY_ALGO_CRC32_IEEE, BL_MANIFEST_FLAG_IEEE */
+#define BL_FEATURE_DECRYPT           (1UL << 15) /* BL_DECRYPT_ENABLE: encrypted sessions (BL_BEGIN_PROGRAM) */
+#define BL_FEATURE_PROGRESS          (1UL << 16) /* BL_PROGRESS_ENABLE: BL_SET_PROGRESS */
+#define BL_FEATURE_LINK_TEST         (1UL << 17) /* BL_LINK_TEST_ENABLE: BL_ECHO, BL_SINK */
+
+typedef struct __attribute__((packed))
+{
+	uint8_t  InfoVersion;                       /* BL_DEVICE_INFO_VERSION */
+	uint8_t  BootloaderVersion;                 /* As BL_GET_VERSION */
+	uint16_t ChipId;                            /* DBGMCU_IDCODE DEV_ID, as BL_GET_CID */
+	uint16_t RevisionId;                        /* DBGMCU_IDCODE REV_ID */
+	uint8_t  RdpLevel;                          /* As BL_GET_RDP_STATUS */
+	uint16_t WriteProtected;                    /* As BL_READ_SECTOR_STATUS, bit n = sector n */
+	uint32_t UniqueId[3];                       /* 96-bit unique device ID (UID_BASE) */
+	uint16_t FlashSizeKb;                       /* Flash size register (FLASHSIZE_BASE) */
+	uint16_t MaxPayload;                        /* BL_MAX_PAYLOAD_LENGTH */
+	uint32_t Features;                          /* BL_FEATURE_xxx */
+	uint8_t  CommandCount;                      /* Command codes following the structure */
+} BL_DeviceInfo_t;
+
+
+/*
+ * Capabilities
+ * ------------
+ * BL_GET_CAPABILITIES replies a BL_Capabilities_t (little endian, packed):
+ * the limits and optional protocol features of this build, so a host picks
+ * the fastest mode every device of a mixed fleet supports. Fields are only
+ * ever appended; CapsVersion tells the host how many it may read.
+ * Any baud rate from MinBaudRate to MaxBaudRate is accepted by BL_CHANGE_BAUD
+ * when USART2 can generate it within 2 %.
+ *
+ * LzDecodeRate / LzWriteRate (version 2) are measured with the DWT cycle
+ * counter over the last BL_MEM_WRITE_LZ stream: decoded bytes per second of
+ * decoder time, and of write-path time. A host choosing a codec compares
+ * them with the link rate; a short stream into SRAM measures the decoder
+ * alone before anything is erased.
+ *
+ * VddMv / FlashParallelism (version 3): the supply measured at the last
+ * session start and the flash program / erase width chosen for it
+ * (BL_Flash.h). A board at x8 erases about 4x slower than one at x32; the
+ * host stretches its erase timeouts accordingly.
+ */
+#define BL_CAPABILITIES_VERSION      3u    /* Layout of BL_Capabilities_t */
+
+/* BL_Capabilities_t.Links, bit n = BL_LINK_n (BL_Transport.h) */
+#define BL_CAPS_LINK_UART            (1u << 0)
+#define BL_CAPS_LINK_USB             (1u << 1)
+#define BL_CAPS_LINK_SPI             (1u << 2)
+#define BL_CAPS_LINK_CAN             (1u << 3)
+#define BL_CAPS_LINK_CAN_GROUP       (1u << 4)
+
+/* BL_Capabilities_t.Codecs */
+#define BL_CAPS_CODEC_READ_RLE       (1u << 0)  /* BL_MEM_READ_FLAG_RLE */
+#define BL_CAPS_CODEC_WRITE_LZ       (1u << 1)  /* BL_MEM_WRITE_LZ, window size in BL_LZ.h */
+#define BL_CAPS_CODEC_WRITE_DELTA    (1u << 2)  /* BL_MEM_WRITE_DELTA */
+#define BL_CAPS_CODEC_DELTA_LZ       (1u << 3)  /* BL_DELTA_FLAG_LZ (BL_LZ_ENABLE) */
+#define BL_CAPS_CODEC_DELTA_THUMB    (1u << 4)  /* BL_DELTA_FLAG_THUMB */
+#define BL_CAPS_CODEC_PACKAGE        (1u << 5)  /* BL_MEM_WRITE_PACKAGE */
+
+/* BL_Capabilities_t.Hashes */
+#define BL_CAPS_HASH_CRC32           (1u << 0)  /* Byte-per-word CRC32 (frames, MEM_COMPARE) */
+#define BL_CAPS_HASH_CRC32_WORDWISE  (1u << 1)  /* Word-wise CRC32 (BL_CRC.h: COMMIT, VERIFY_RANGE, manifests) */
+#define BL_CAPS_HASH_SHA256          (1u << 2)  /* VERIFY_RANGE / COMMIT SHA-256 */
+#define BL_CAPS_HASH_ECDSA_P256      (1u << 3)  /* Signed COMMIT (BL_SIGNATURE_ENABLE) */
+
+typedef struct __attribute__((packed))
+{
+	uint8_t  CapsVersion;                       /* BL_CAPABILITIES_VERSION */
+	uint8_t  Link;                              /* BL_LINK_xxx this reply goes out on */
+	uint8_t  Links;                             /* BL_CAPS_LINK_xxx built in */
+	uint8_t  Codecs;                            /* BL_CAPS_CODEC_xxx */
+	uint8_t  Hashes;                            /* BL_CAPS_HASH_xxx */
+	uint8_t  StreamAckInterval;                 /* MEM_WRITE_STREAM packets per cumulative ACK */
+	uint8_t  SelectiveWindow;                   /* BL_STREAM_SELECTIVE_WINDOW */
+	uint8_t  Reserved;
+	uint16_t MaxFrame;                          /* Largest command frame, length field and CRC included */
+	uint16_t MaxPayload;                        /* BL_MAX_PAYLOAD_LENGTH, also the largest reply payload */
+	uint16_t RxBuffer;                          /* Receive ring of this link: bytes the host may keep in flight */
+	uint16_t FrameTimeoutMs;                    /* BL_FRAME_TIMEOUT_MS */
+	uint16_t SessionTimeoutMs;                  /* BL_SESSION_TIMEOUT_MS */
+	uint32_t MinBaudRate;                       /* BL_CHANGE_BAUD range */
+	uint32_t MaxBaudRate;
+	uint32_t Features;                          /* BL_FEATURE_xxx, as BL_GET_DEVICE_INFO */
+	uint32_t LzDecodeRate;                      /* Bytes / s, 0 before the first BL_MEM_WRITE_LZ stream */
+	uint32_t LzWriteRate;                       /* Bytes / s through the write path, same stream */
+	uint16_t VddMv;                             /* 0 with a fixed BL_FLASH_PARALLELISM */
+	uint8_t  FlashParallelism;                  /* BL_FLASH_PSIZE_xxx: bytes per program / erase step */
+	uint8_t  Reserved2;
+} BL_Capabilities_t;
+
+
+/*
+ * Sector Protection
+ * -----------------
+ * BL_EN_RW_PROTECT takes [sector mask (2, LE)] [mode], BL_DIS_WR_PROTECT
+ * [sector mask (2, LE)] (optional, default: all sectors); bit n = sector n.
+ * All the sectors of a request are changed in one option-byte programming
+ * cycle. Both reply [status] [write-protected bitmap (2, LE)] read back after
+ * the change. The F407 has no PCROP: BL_PROTECT_MODE_READ_WRITE is rejected.
+ */
+#define BL_PROTECT_MODE_WRITE        0x01  /* nWRP: sectors cannot be erased / programmed */
+#define BL_PROTECT_MODE_READ_WRITE   0x02  /* PCROP, not available on the F407 */
+
+
+/*
+ * OTP Read
+ * --------
+ * The F407 OTP area is 16 blocks of 32 bytes (FLASH_OTP_BASE) followed by one
+ * lock byte per block (0x00 = block locked). BL_OTP_READ takes
+ * [first block] [block count] (both optional, default: all) and replies in one
+ * response [status] [16 lock bytes] [block count x 32 bytes].
+ */
+#define BL_OTP_BLOCK_COUNT           16u
+#define BL_OTP_BLOCK_SIZE            32u
+#define BL_OTP_LOCK_ADDRESS          (FLASH_OTP_BASE + (BL_OTP_BLOCK_COUNT * BL_OTP_BLOCK_SIZE))
+
+
+/*
+ * Memory Read
+ * -----------
+ * BL_MEM_READ takes [address (4)] [length (2 or 4)] [flags (1, optional,
+ * after a 4-byte length)]. The first reply is [status] [length (4)]; with
+ * HAL_OK the range follows as consecutive responses of up to
+ * BL_MEM_READ_CHUNK_SIZE bytes, each
+ * [ACK] [length] [data] [CRC32 of header + data], whatever BL_RESPONSE_CRC_ENABLE.
+ *
+ * With BL_MEM_READ_FLAG_RLE the data of each response is a sequence of whole
+ * records, expanded by the host until it has the announced length:
+ *  - [BL_MEM_READ_RLE_LITERAL] [n (2, LE)] [n bytes]
+ *  - [BL_MEM_READ_RLE_REPEAT]  [word (4, as in memory)] [n (4, LE)] : n times the word
+ * Runs of at least BL_MEM_READ_RLE_MIN_WORDS identical aligned words (erased
+ * flash, zeroed RAM) are sent as one 9-byte record.
+ */
+#define BL_MEM_READ_CHUNK_SIZE       BL_MAX_PAYLOAD_LENGTH
+
+#define BL_MEM_READ_FLAG_RLE         0x01  /* Run-length encode repeated words */
+
+#define BL_MEM_READ_RLE_LITERAL      0x00
+#define BL_MEM_READ_RLE_REPEAT       0x01
+#define BL_MEM_READ_RLE_MIN_WORDS    4u
+
+
+/*
+ * Read Multi
+ * ----------
+ * BL_READ_MULTI takes [count] then count x [address (4)] [length (2)] and
+ * replies in one response [status] [data of every range, in request order]
+ * [CRC32 of header + status + data], whatever BL_RESPONSE_CRC_ENABLE.
+ * HAL_ERROR is followed by the index of the first rejected range (count for a
+ * malformed list or a total above BL_READ_MULTI_MAX_DATA).
+ */
+#define BL_READ_MULTI_ENTRY_SIZE     6u
+#define BL_READ_MULTI_MAX_DATA       (BL_MAX_PAYLOAD_LENGTH - 1u)
+
+
+/*
+ * Blank Map
+ * ---------
+ * BL_BLANK_MAP takes [address (4)] [length (4)] [granule (4, optional)], all
+ * multiples of 4 inside one flash area, and replies [status] [next address (4)]
+ * [range count (2)] then count x [start (4)] [length (4)]: the maximal runs of
+ * granules reading all 0xFF. When the list fills a response the scan stops
+ * and "next address" is where the host resumes; it is address + length once
+ * the whole area is mapped.
+ */
+#define BL_BLANK_MAP_DEFAULT_GRANULE 1024u
+#define BL_BLANK_MAP_MAX_RANGES      ((BL_MAX_PAYLOAD_LENGTH - 7u) / 8u)
+
+
+/*
+ * Batch
+ * -----
+ * BL_BATCH takes [count] then count x [expected status] [sub-frame], where a
+ * sub-frame is an ordinary v1 or extended command frame whose CRC field is not
+ * checked: the batch CRC covers it. The sub-commands run in order and the reply
+ * is [result] [n] [n statuses], a status being the first byte of the
+ * sub-command's reply (BL_ACK for an empty one, BL_NACK if it was rejected).
+ * Execution stops at a NACK or at a status other than the expected one
+ * (BL_BATCH_EXPECT_ANY accepts any).
+ * GO_TO and CHANGE_BAUD end a batch: its reply is sent first (BL_BATCH_HANDOFF),
+ * then the sub-command runs and answers as usual. MEM_READ, MEM_WRITE_STREAM and
+ * BATCH cannot be batched. For MALFORMED / REJECTED / HANDOFF, n is the index
+ * of that sub-command.
+ */
+#define BL_BATCH_EXPECT_ANY          0xFF
+
+#define BL_BATCH_DONE                0x00  /* Every sub-command ran */
+#define BL_BATCH_STOPPED             0x01  /* The last status is the failing sub-command */
+#define BL_BATCH_MALFORMED           0x02  /* Sub-frame n does not fit in the batch, not run */
+#define BL_BATCH_REJECTED            0x03  /* Sub-command n is unknown or cannot be batched, not run */
+#define BL_BATCH_HANDOFF             0x04  /* Sub-command n runs after this reply and answers itself */
+#define BL_BATCH_INVALID             0x05  /* BL_RUN_SCRIPT: script outside the RAM run area or CRC mismatch, not run */
+
+
+/*
+ * Run Script
+ * ----------
+ * A provisioning recipe in one round trip: the host uploads a BL_BATCH
+ * payload, [count] then the entries, into the RAM run area with
+ * BL_MEM_WRITE_STREAM, next to the data its sub-commands take (a
+ * BL_PROGRAM_FROM_RAM image, for one), then
+ * BL_RUN_SCRIPT [address (4)] [length (4)] [CRC (4)] checks the word-wise
+ * CRC-32 (BL_VERIFY_ALGO_CRC32) of the script and runs it as a batch, which
+ * is not limited to one frame: up to 255 sub-commands of any size. The reply
+ * is that of BL_BATCH, [BL_BATCH_INVALID] [0] if the script is not run.
+ * Execution stops at the first failing step as in a batch; a sub-command
+ * writing over the script itself makes the rest undefined.
+ */
+
+
+/*
+ * Frame CRC Mode
+ * --------------
+ * BL_SET_FRAME_CRC takes [mode] and replies [status] [mode in effect].
+ * BL_FRAME_CRC_OFF is only accepted from the USB link, whose bulk packets
+ * already carry a hardware CRC16: command frames from USB are then taken as
+ * they are, their 4-byte CRC trailer is still sent but not computed. The
+ * update is checked end to end by BL_COMMIT (running CRC / SHA-256).
+ * UART and SPI frames are always checked; the mode is lost on reset.
+ */
+#define BL_FRAME_CRC_ON              0x00  /* Every command frame is checked (default) */
+#define BL_FRAME_CRC_OFF             0x01  /* USB frames are not checked */
+
+
+/*
+ * Baud Rate Negotiation
+ * ---------------------
+ * BL_CHANGE_BAUD carries the proposed rate (32-bit, little endian).
+ * The status is sent at the old rate; on BL_BAUD_OK the host switches too and
+ * sends BL_BAUD_PING at the new rate within BL_BAUD_PING_TIMEOUT_MS, which the
+ * Bootloader answers with BL_ACK. Without a valid ping it falls back to
+ * BL_DEFAULT_BAUD_RATE, so hosts that never send the command are unaffected.
+ */
+#define BL_DEFAULT_BAUD_RATE         115200u  /* Rate set by MX_USART2_UART_Init */
+#define BL_BAUD_PING                 0xCC     /* Single byte sent by the host at the new rate */
+#define BL_BAUD_PING_TIMEOUT_MS      500u
+
+#define BL_BAUD_OK                   0x00  /* Rate accepted, switching after this reply */
+#define BL_BAUD_UNSUPPORTED          0x01  /* Rate cannot be generated within tolerance from PCLK1 */
+
+
+/*
+ * Compressed Write
+ * ----------------
+ * BL_MEM_WRITE_LZ takes [flags] [address (4)] [compressed bytes]: one LZ4
+ * sequence stream (BL_LZ.h) cut into packets anywhere, decoded as it arrives
+ * and written through the same path as BL_MEM_WRITE (write-combined inside a
+ * programming session). BL_LZ_WRITE_FLAG_START opens a stream at the address;
+ * every later packet carries the address its output starts at, which must be
+ * the next address of the stream. Reply: [status] [next address (4, LE)].
+ * Any status but BL_LZ_WRITE_OK ends the stream; the host restarts it at the
+ * next address with a fresh encoder, everything before is written.
+ */
+#define BL_LZ_WRITE_FLAG_START       0x01  /* First packet: new stream at the address, empty window */
+#define BL_LZ_WRITE_FLAG_END         0x02  /* Last packet: the stream must end on a sequence boundary */
+
+#define BL_LZ_WRITE_OK               0x00
+#define BL_LZ_WRITE_FAILED           0x01  /* Output outside a writable region, or programming failed */
+#define BL_LZ_WRITE_SEQUENCE         0x02  /* No open stream, or the address is not its next address */
+#define BL_LZ_WRITE_CORRUPT          0x03  /* Invalid offset, or END inside a sequence */
+
+
+/*
+ * Delta Write
+ * -----------
+ * BL_MEM_WRITE_DELTA rebuilds a new image from the installed one and a binary
+ * patch, streamed like BL_MEM_WRITE_LZ: [flags] [address (4)] [patch bytes],
+ * where the START packet inserts [source (4)] [source length (4)]
+ * [target length (4)] before its patch bytes and the address is the target,
+ * typically a staging slot (e.g. sector 8, 0x08080000) erased beforehand.
+ * The target may not overlap the source. Reply: [status] [next address (4, LE)].
+ *
+ * The patch is the bsdiff control / diff / extra stream, interleaved per record:
+ *     [diff length (4)] [extra length (4)] [seek (4, signed)]
+ *     [diff bytes] [extra bytes]
+ * each diff byte is added (mod 256) to the source byte at the source cursor,
+ * the extra bytes are copied, then the cursor moves by seek (all LE). END
+ * requires the target length written on a record boundary. The rebuilt image
+ * goes through the BL_MEM_WRITE path: in a session it feeds BL_COMMIT.
+ *
+ * Two START flags, kept for the whole stream, make patches smaller:
+ *  - BL_DELTA_FLAG_LZ: the patch bytes are one LZ4 sequence stream
+ *    ("Compressed Write", same 4 KB window), decoded before the records. It
+ *    uses the BL_MEM_WRITE_LZ decoder: starting one stream closes the other.
+ *    END also requires the LZ stream to end on a sequence boundary.
+ *  - BL_DELTA_FLAG_THUMB: the patch was made between filtered images, where
+ *    every Thumb-2 BL pair (halfwords 11110xxx xxxxxxxx, 11111xxx xxxxxxxx)
+ *    at an even offset p of its image, p + 4 within it, holds the absolute
+ *    target instead of the relative one:
+ *        v = ((hw1 & 0x7FF) << 11) | (hw2 & 0x7FF)
+ *        filtered v = (v + ((p + 4) >> 1)) mod 2^22, offsets from the image start
+ *    so the calls to a function that moved all change the same way. The
+ *    source is filtered as it is read, the rebuilt bytes unfiltered before
+ *    they are written; both keep the top five bits of each halfword, so the
+ *    pairs are the same on both sides (and two pairs never overlap). Up to
+ *    3 rebuilt bytes wait for the rest of their pair, so the reply's next
+ *    address may run ahead of what is written by that much.
+ */
+#define BL_DELTA_FLAG_START          0x01  /* First packet: source, lengths, new stream */
+#define BL_DELTA_FLAG_END            0x02  /* Last packet: the whole target must be rebuilt */
+#define BL_DELTA_FLAG_LZ             0x04  /* START: LZ-compressed patch (BL_LZ_ENABLE) */
+#define BL_DELTA_FLAG_THUMB          0x08  /* START: patch between BL-filtered images */
+
+#define BL_DELTA_OK                  0x00
+#define BL_DELTA_FAILED              0x01  /* Target outside a writable region, or programming failed */
+#define BL_DELTA_SEQUENCE            0x02  /* No open stream, or the address is not its next address */
+#define BL_DELTA_CORRUPT             0x03  /* Bad START, diff outside the source, or more / less than the target */
+
+
+/*
+ * Package Write
+ * -------------
+ * BL_MEM_WRITE_PACKAGE streams an update package (BL_Package.h), the file
+ * built once by "blflash package": [flags] [package offset (4)] [bytes],
+ * every packet continuing at the next offset, reply [status] [next offset
+ * (4, LE)]. The device needs no other command: the packet completing the
+ * manifest erases its plan before it is answered (the host allows the erase
+ * time for it), then the segments are written through the BL_MEM_WRITE path.
+ * With BL_SIGNATURE_ENABLE the manifest must carry a signature by the
+ * update signer, and a complete package marks the image validated. Blocks
+ * are checked before they are decoded: a corrupt block stops the package
+ * before any of its bytes reach the flash. LZ segments use the BL_MEM_WRITE_LZ decoder:
+ * starting a package closes an LZ or compressed delta stream, and the other
+ * way round. Any failure closes the package; its status is BL_PACKAGE_xxx
+ * of BL_Package.h from 0x10 up when the decoder refused it.
+ */
+#define BL_PACKAGE_FLAG_START        0x01  /* First packet, offset 0: new package */
+#define BL_PACKAGE_FLAG_END          0x02  /* Last packet: the package must be complete */
+
+#define BL_PACKAGE_WRITE_OK          0x00
+#define BL_PACKAGE_WRITE_FAILED      0x01  /* Plan protected or refused, erase or programming failed */
+#define BL_PACKAGE_WRITE_SEQUENCE    0x02  /* No open package, or the offset is not its next offset */
+#define BL_PACKAGE_WRITE_INCOMPLETE  0x03  /* END before the payload digest matched */
+
+
+/*
+ * Self Update
+ * -----------
+ * A new bootloader is written like an application image, anywhere from
+ * BL_IMAGE_BASE_ADDRESS on (blflash self-update stages it in sector 10),
+ * then BL_SELF_UPDATE [source (4)] [length (4)] [SHA-256 (32)] replaces
+ * sectors 0 and 1 with it: with BL_SIGNATURE_ENABLE [signature (64)] of
+ * that SHA-256 by the update signer follows. The image is checked where it
+ * lies (length, vector table, digest, signature, no write protection on the
+ * bootloader sectors) before anything is erased; reply [status], then the
+ * copier of BL_Flash.h ("Bootloader Replacement") erases, programs and
+ * verifies from SRAM with interrupts masked and resets the device. The
+ * staging copy is left in place: the host erases it once the new
+ * bootloader answers.
+ */
+#define BL_SELF_UPDATE_OK            0x00
+#define BL_SELF_UPDATE_INVALID       0x01  /* Source outside the application flash, length, alignment or vector table */
+#define BL_SELF_UPDATE_DIGEST        0x02  /* SHA-256 of the staged image differs */
+#define BL_SELF_UPDATE_SIGNATURE     0x03  /* BL_SIGNATURE_ENABLE: signature missing or not verified */
+#define BL_SELF_UPDATE_PROTECTED     0x04  /* Sector 0 or 1 write protected (nWRP) */
+
+
+/*
+ * Reset And Boot
+ * --------------
+ * BL_RESET_AND_BOOT [mode (1)] takes the device back to production after an
+ * update, unlike BL_GO_TO_ADDR, which calls the application with the
+ * bootloader's stack, VTOR, SysTick and USART2 still live. Any erase is
+ * finished, the session closed (staged writes programmed, flash locked) and
+ * the reply flushed onto the line, then:
+ *  - BL_RESET_BOOT_MODE_HANDOFF: the active slot is checked as on a normal
+ *    boot (BL_uint8ImageCheck) and started by Bootloader_JumpToImage, boot
+ *    path BL_HANDOFF_PATH_COMMAND. When that boot would have more to do than
+ *    jump (staged update to install, image on trial, anti-rollback step) the
+ *    device resets instead, and the reply says so.
+ *  - BL_RESET_BOOT_MODE_RESET: NVIC_SystemReset with BL_BOOT_REQUEST_MAGIC in
+ *    the update request register (BL_Handoff.h): the next boot ignores B1
+ *    once and takes the normal path, fast path included.
+ * Reply: [status]. BL_RESET_BOOT_INVALID leaves the device in update mode.
+ */
+#define BL_RESET_BOOT_MODE_HANDOFF   0x00
+#define BL_RESET_BOOT_MODE_RESET     0x01
+
+#define BL_RESET_BOOT_HANDOFF        0x00  /* Application started directly */
+#define BL_RESET_BOOT_RESET          0x01  /* Device resetting into the normal boot path */
+#define BL_RESET_BOOT_INVALID        0x02  /* Unknown mode, or no image to hand off to */
+
+
+/*
+ * Application Info
+ * ----------------
+ * BL_GET_APP_INFO (no payload) describes what is installed without a
+ * read-back or a boot: reply [status] [slot count] [active slot], then per
+ * slot BL_APP_INFO_ENTRY_SIZE bytes,
+ *     [state (1)] [version (4)] [build ID (4)] [length (4)] [CRC (4)]
+ *     [security version (4)] [activation (4)]
+ * all little endian. The state is BL_IMAGE_STATE_xxx (BL_Image.h), taken
+ * from the header's validated mark, so no CRC is computed: CRC is the
+ * stamped image CRC the host can compare with its own build, length the
+ * bytes from the slot base to EndAddress. Without an image header every
+ * field after the state is 0.
+ */
+#define BL_APP_INFO_OK               0x00
+#define BL_APP_INFO_ENTRY_SIZE       25u
+
+
+/*
+ * Memory Fill
+ * -----------
+ * BL_MEM_FILL takes [address (4)] [length (4)] [pattern (4, as in memory)],
+ * address and length multiples of 4, and writes the pattern over the range
+ * through the BL_MEM_WRITE path (word programming, write-combined and hashed
+ * in a session) without the data crossing the link. Reply: [status] [skipped].
+ * A 0xFFFFFFFF fill of flash that already reads erased programs nothing
+ * (skipped = 1); one over programmed flash fails, the range needs an erase.
+ */
+#define BL_FILL_CHUNK_SIZE           256u  /* Pattern bytes per write, on the stack */
+
+
+/*
+ * Boot Times
+ * ----------
+ * BL_GET_BOOT_TIMES replies [stamp count (1)] [stamps (4 each, LE)]
+ * [SystemCoreClock (4, LE)]: the milestone cycle stamps of this boot
+ * (BL_Handoff.h) and the clock they run at after BL_BOOT_STAMP_CLOCK.
+ */
+#define BL_BOOT_TIMES_REPLY_SIZE     (1u + (4u * BL_BOOT_STAMPS) + 4u)
+
+
+/*
+ * RAM Run
+ * -------
+ * Development images linked for SRAM (STM32F407VGTX_RAM.ld of the UserApp)
+ * run from the upper 64 KB of SRAM, which the bootloader leaves alone: its
+ * own RAM, stack included, is linked into the lower 64 KB. The image is
+ * loaded with BL_MEM_WRITE (plain memcpy, no erase, no flash wear), then
+ * BL_RAM_RUN [vector table address (4)] starts it like the flash application:
+ * reset-like peripheral state, VTOR on its table, MSP and reset handler from
+ * it. Reply [status] before the jump; nothing follows an accepted start.
+ */
+#define BL_RAM_RUN_BASE              0x20010000UL
+#define BL_RAM_RUN_SIZE              0x10000UL     /* Up to the end of SRAM2 */
+
+#define BL_RAM_RUN_OK                0x00
+#define BL_RAM_RUN_INVALID           0x01  /* Table not 512-aligned in the area, or MSP / reset handler outside it */
+
+
+/*
+ * Program From RAM
+ * ----------------
+ * Splits an update into the link part and the flash part: the host uploads
+ * up to BL_RAM_RUN_SIZE bytes into the RAM run area with BL_MEM_WRITE /
+ * BL_MEM_WRITE_STREAM (memcpy speed, nothing waits on the flash), then
+ * BL_PROGRAM_FROM_RAM [source (4)] [destination (4)] [length (4)] [CRC (4)]
+ * checks the word-wise CRC-32 (BL_VERIFY_ALGO_CRC32) of the source, programs
+ * it through the BL_MEM_WRITE path (write-combined and hashed in a session)
+ * and reads the flash back against it. A jig broadcasts the upload and then
+ * this command, so the boards program in parallel while the link is idle.
+ * Reply [status] [address (4)]: the start of the chunk that failed to
+ * program, the first address that failed to verify, destination + length
+ * when done. The data is taken as it is, not decrypted in an encrypted
+ * session.
+ */
+#define BL_PROGRAM_RAM_CHUNK_SIZE    4096u  /* Bytes per write / verify step */
+
+#define BL_PROGRAM_RAM_OK            0x00
+#define BL_PROGRAM_RAM_INVALID       0x01  /* Empty, source outside the RAM run area or destination not writable flash */
+#define BL_PROGRAM_RAM_CRC_ERROR     0x02  /* Source does not match the CRC: upload incomplete */
+#define BL_PROGRAM_RAM_WRITE_ERROR   0x03  /* Programming failed at the address */
+#define BL_PROGRAM_RAM_VERIFY_ERROR  0x04  /* Flash differs from the source at the address */
+
+
+/*
+ * Progress Frames
+ * ---------------
+ * BL_SET_PROGRESS [interval ms (2)] has the commands after it report how far
+ * they are, at most once per interval (0: off, as after reset; shorter ones
+ * are raised to BL_PROGRESS_MIN_INTERVAL_MS). Reply [status] [interval (2)].
+ * Erases (BL_FLASH_ERASE, BL_ERASE_RANGE, the background erase job),
+ * BL_PROGRAM_FROM_RAM and BL_MEM_FILL then push, between two steps,
+ *     [BL_PROGRESS_MARKER] [BL_PROGRESS_PAYLOAD_SIZE] [operation (1)]
+ *     [percent (1)] [sector (1)] [done (4)] [total (4)] [CRC (4)]
+ * framed as a v1 reply with the marker for the ACK (the CRC as for replies,
+ * BL_RESPONSE_CRC_ENABLE). done / total are bytes of the command's range,
+ * sector the flash sector last worked on. A frame is only started on an idle
+ * USART2 and never waited for: one that would have to queue is left out, the
+ * next step reports newer figures. None on the other links, in COBS framing,
+ * inside a BL_BATCH or for an RS-485 broadcast.
+ */
+#define BL_PROGRESS_PAYLOAD_SIZE     11u
+#define BL_PROGRESS_MIN_INTERVAL_MS  20u
+
+#define BL_PROGRESS_OP_ERASE         0x01
+#define BL_PROGRESS_OP_PROGRAM       0x02
+#define BL_PROGRESS_OP_VERIFY        0x03
+
+#define BL_SET_PROGRESS_OK           0x00
+
+
+/*
+ * Link Benchmark
+ * --------------
+ * Two commands that measure the link and nothing else. Both take the same
+ * path as BL_MEM_WRITE: DMA into the RX ring, the frame parser, the command
+ * table, and a DMA response.
+ * BL_ECHO [length (2)] [data] answers [BL_ECHO_OK] then length bytes: the
+ * data sent, then byte n of the reply is n & 0xFF. One command thus times
+ * both directions (data of length bytes), the download alone (no data) or
+ * the upload alone (length 0). A length above BL_ECHO_MAX_LENGTH is
+ * answered [BL_ECHO_TOO_LONG].
+ * BL_SINK [flags (1)] [data] is dropped once received. Its handler checks
+ * the CRC itself and counts a bad frame instead of answering NACK, so a
+ * host sends SINK frames back to back with nothing coming back:
+ * BL_SINK_FLAG_RESET restarts the counters at this frame, and
+ * BL_SINK_FLAG_REPORT has it answered [BL_SINK_OK] [frames (4)] [bytes (4)]
+ * [CRC errors (4)] [ms (4)]. The counts are the good frames and their data
+ * bytes since the reset (this one included), ms the device time between
+ * the two.
+ */
+#define BL_ECHO_MAX_LENGTH           (BL_MAX_PAYLOAD_LENGTH - 1u)
+
+#define BL_ECHO_OK                   0x00
+#define BL_ECHO_TOO_LONG             0x01
+
+#define BL_SINK_FLAG_RESET           0x01
+#define BL_SINK_FLAG_REPORT          0x02
+
+#define BL_SINK_OK                   0x00
+
+
+/*
+ * Go To Address Flags
+ * -------------------
+ * BL_GO_TO_ADDR [address (4)] alone calls the address as a Thumb function,
+ * with the bootloader's stack, peripherals and interrupts as they are.
+ * An optional flags byte turns it into a vector-table jump:
+ *  - BL_GO_FLAG_VECTOR_TABLE: the address is a vector table (512-byte
+ *    aligned, executable, initial MSP in SRAM / CCMRAM, Thumb reset handler
+ *    executable) started like the application (Bootloader_JumpToImage).
+ *  - BL_GO_FLAG_LOADER: the table starts a second-stage loader in the RAM
+ *    run area, which takes over the link as it is (see BL_Loader.h).
+ * Reply VALID_ADDRESS before the jump, NOT_VALID_ADDRESS for a table or
+ * loader that fails its checks.
+ */
+#define BL_GO_FLAG_VECTOR_TABLE      0x01
+#define BL_GO_FLAG_LOADER            0x02
+
+
+/*
+ * A/B Slots
+ * ---------
+ * BL_SLOT_ACTIVATE [slot (1)]: with BL_AB_SLOTS_ENABLE the host writes the
+ * update to the inactive slot (BL_MEM_WRITE at the base the query returns,
+ * the active slot refuses program / erase), then activates it. The slot must
+ * pass the image check (validated, or stamped CRC good) before its Activated
+ * word is programmed; it is started from the next boot (BL_GO_TO_ADDR or a
+ * reset). Activating the previous slot again is the roll-back.
+ * BL_SLOT_QUERY changes nothing. Reply: [status][active slot][update slot base (4)].
+ */
+#define BL_SLOT_QUERY                0xFF
+
+#define BL_SLOT_OK                   0x00
+#define BL_SLOT_INVALID              0x01  /* Unknown slot, or its image is not valid */
+#define BL_SLOT_REPLY_SIZE           6u
+
+
+/*
+ * Wear Statistics
+ * ---------------
+ * BL_GET_WEAR_STATS: how many times each sector was erased, so the host can
+ * spread staging over the slots and warn before a board nears the rated
+ * 10 000 cycles. Counted by the bootloader with BL_WEAR_STATS_ENABLE and kept
+ * in the session journal (BL_Journal.h).
+ */
+#define BL_WEAR_OK                   0x00
+#define BL_WEAR_UNAVAILABLE          0x01  /* Built without BL_WEAR_STATS_ENABLE */
+#define BL_WEAR_REPLY_SIZE           49u   /* [status] [12 x count (4)] */
+
+
+/*
+ * Statistics
+ * ----------
+ * BL_GET_STATS [flags (1), optional]: where the time of an update goes. Every
+ * frame dispatched is timed with the DWT cycle counter (CRC check and handler,
+ * including the waits inside it: a stream or an erase counts its link and
+ * flash stalls) and counted per opcode together with the ones answered by a
+ * NACK. The link counters tell a slow or noisy line apart: bytes of the
+ * frames received and of the responses sent, frames failing their CRC, UART
+ * line errors (overrun, framing, noise). The flash driver adds how long its
+ * program calls and sector erases took, per sector class (BL_Flash.h). With
+ * BL_STATS_ENABLE; all counters start at 0 on reset.
+ *
+ * Reply: [status] [rx bytes (4)] [tx bytes (4)] [crc failures (4)]
+ *        [uart errors (4)] [core clock Hz (4)] [entries (1)], then for every
+ *        opcode dispatched at least once: [opcode] [count (4)]
+ *        [total cycles (8)] [max cycles (4)] [nacks (4)];
+ *        then [classes (1)] [buckets (1)] and per class (16, 64, 128 KB) the
+ *        program and the erase histogram: [max us (4)] [total us (4)]
+ *        [bytes / sectors (4)] [buckets x count (4)];
+ *        then the USART2 detail: [overrun (4)] [framing (4)] [noise (4)]
+ *        [parity (4)] [DMA errors (4)] [RX ring high-water (4)]
+ *        [RX ring size (4)]. Overruns and a high-water mark near the ring
+ *        size are bytes lost at this baud rate, seen as CRC NACKs otherwise;
+ *        then the RAM reserves (MemoryUsage.h): [stack peak (4)]
+ *        [stack size (4)] [heap peak (4)] [heap size (4)], high-water marks
+ *        since reset that BL_STATS_FLAG_CLEAR does not reset;
+ *        then the interrupt masking (BL_Port.h): [max masked cycles (4)]
+ *        [masked sections (4)], the longest time a handler may have waited.
+ */
+#define BL_STATS_FLAG_CLEAR          0x01  /* Counters back to 0 once the reply is built */
+
+#define BL_STATS_OK                  0x00
+#define BL_STATS_UNAVAILABLE         0x01  /* Built without BL_STATS_ENABLE, nothing follows the status */
+#define BL_STATS_HEADER_SIZE         22u
+#define BL_STATS_ENTRY_SIZE          21u
+#define BL_STATS_HISTOGRAM_SIZE      (12u + (4u * BL_FLASH_TIMING_BUCKETS))
+#define BL_STATS_FLASH_SIZE          (2u + (2u * BL_FLASH_CLASS_COUNT * BL_STATS_HISTOGRAM_SIZE))
+#define BL_STATS_UART_SIZE           28u
+#define BL_STATS_MEMORY_SIZE         16u
+#define BL_STATS_MASK_SIZE           8u
+
+
+/*
+ * Broadcast Status
+ * ----------------
+ * BL_BROADCAST_STATUS [flags (1), optional], sent to one node: the collect
+ * phase after an RS-485 broadcast write (see "RS-485 Multidrop" in
+ * BL_Transport.h). With BL_BROADCAST_FLAG_CLEAR the record starts over once
+ * the reply is built; sent as a broadcast it clears every node at once.
+ *
+ * Reply: [status] [node address] [sequence end (2)] [done (2)]
+ *        [missing bitmap ((end + 7) / 8 bytes), bit n = sequence n not written].
+ *        Sequence numbers from "end" on were never received. BL_BROADCAST_UNAVAILABLE
+ *        alone without BL_RS485_ENABLE.
+ */
+#define BL_BROADCAST_FLAG_CLEAR      0x01
+
+#define BL_BROADCAST_OK              0x00
+#define BL_BROADCAST_UNAVAILABLE     0x01
+#define BL_BROADCAST_HEADER_SIZE     6u
+
+
+/*
+ * Crash Record
+ * ------------
+ * BL_GET_CRASH_RECORD [flags (1), optional] replies [status] [BL_CrashRecord_t
+ * (BL_CRASH_RECORD_WORDS x 4, LE)]: the last fault of the bootloader or the
+ * application, as its fault handler saved it before resetting (see "Crash
+ * Record" in BL_Handoff.h). BL_CRASH_NONE alone when backup SRAM holds no
+ * valid record. With BL_CRASH_FLAG_CLEAR the record is invalidated once the
+ * reply is built, so the next read only shows a new fault.
+ */
+#define BL_CRASH_FLAG_CLEAR          0x01
+
+#define BL_CRASH_OK                  0x00
+#define BL_CRASH_NONE                0x01
+
+
+/*
+ * Erase For Image
+ * ---------------
+ * BL_ERASE_FOR_IMAGE [address (4, LE)] [length (4, LE)] [flags (1), optional]
+ * lets the bootloader choose how to erase the sectors an image will be
+ * written to, from the blank map, the write protection and the erase cost:
+ *  - BL_ERASE_METHOD_SKIP   : every sector of the range is already blank.
+ *  - BL_ERASE_METHOD_SECTORS: the sectors that hold data are erased one by
+ *                             one, blank ones are skipped.
+ * A mass erase is never chosen: on the single-bank STM32F407 it always takes
+ * sectors 0 and 1 with it, and the bootloader sectors are never erased. The
+ * whole request is refused, nothing erased, when the range touches a
+ * bootloader sector, the running A/B slot or a write-protected sector.
+ * The reply is
+ *     [status] [method] [estimated erase time (4, LE, ms)] [result of sector 0] ... [result of sector 11]
+ * with the estimate from the measured erase times (BL_GET_STATS histograms)
+ * or, before any erase of that sector size, the datasheet typical at the
+ * current programming parallelism. BL_ERASE_IMAGE_FLAG_DRY_RUN only plans:
+ * the sectors that would be erased report BL_ERASE_SECTOR_PLANNED.
+ */
+#define BL_ERASE_IMAGE_FLAG_DRY_RUN  0x01
+
+#define BL_ERASE_METHOD_SKIP         0x00
+#define BL_ERASE_METHOD_SECTORS      0x01
+
+#define BL_ERASE_SECTOR_PLANNED      0x06  /* Dry run: would be erased */
+#define BL_ERASE_IMAGE_REPLY_SIZE    18u   /* [status] [method] [ms (4)] [12 x result] */
+
+
+/*
+ * Node Discovery
+ * --------------
+ * BL_DISCOVER [prefix bits (1)] [prefix (12)] finds every node of a bus by
+ * its 96-bit unique ID (UID_BASE), taken as a bit string: the bytes in
+ * address order, each most significant bit first. A node matches when its
+ * first "prefix bits" bits (0 .. 96) equal the prefix's. Sent on the CAN
+ * group identifier or as an RS-485 broadcast, where responses are dropped,
+ * each matching node answers out of band instead:
+ *  - CAN: one extended frame whose identifier carries the next
+ *    BL_DISCOVER_CAN_BITS ID bits after the prefix (left-aligned, fewer at
+ *    the end; "Discovery" in BL_CAN.h), no data, or [node id] [group id]
+ *    when these bits complete the ID. The bus arbitrates different bits and
+ *    merges identical frames, so one query returns every distinct next
+ *    piece: four rounds (25 + 25 + 25 + 21 bits) reach each node.
+ *  - RS-485: the next BL_DISCOVER_SLOT_BITS bits pick one of 16 time slots
+ *    ("Discovery" in BL_Transport.h), in which the node sends the reply
+ *    below. A slot with line activity holds at least one node; a reply that
+ *    arrives intact names a candidate, confirmed by querying its full 96 bits
+ *    (slot 0, only that node answers). Busy slots are searched 4 bits deeper.
+ * Sent to one node, it answers normally. Either way the reply is
+ *     [status] [unique ID (12)] [node address]
+ * where the address is BL_RS485_NODE_ADDRESS or BL_CAN_NODE_ID of the link,
+ * 0 elsewhere, and the status BL_DISCOVER_NO_MATCH for a unicast query the
+ * node does not match. Non-matching nodes stay silent on broadcasts.
+ */
+#define BL_DISCOVER_OK               0x00
+#define BL_DISCOVER_NO_MATCH         0x01
+
+#define BL_DISCOVER_UID_BITS         96u
+#define BL_DISCOVER_CAN_BITS         25u   /* Extended identifier bits below BL_CAN_EXT_ID_DISCOVER */
+#define BL_DISCOVER_SLOT_BITS        4u    /* 16 RS-485 time slots */
+#define BL_DISCOVER_REPLY_SIZE       14u
 
 
 /*
@@ -60,6 +1080,102 @@ void BL_voidHandleOTPReadCmd(uint8_t* copy_puint8CmdPacket);       /* Handles BL
 
 void BL_voidHandleDisWRProtectCmd(uint8_t* copy_puint8CmdPacket);  /* Handles BL_DIS_WR_PROTECT command */
 
+void BL_voidHandleMemWriteStreamCmd(uint8_t* copy_puint8CmdPacket); /* Handles BL_MEM_WRITE_STREAM command */
+
+void BL_voidHandleChangeBaudCmd(uint8_t* copy_puint8CmdPacket);    /* Handles BL_CHANGE_BAUD command */
+
+void BL_voidHandleMemCompareCmd(uint8_t* copy_puint8CmdPacket);    /* Handles BL_MEM_COMPARE command */
+
+void BL_voidHandleFlashEraseStatusCmd(uint8_t* copy_puint8CmdPacket); /* Handles BL_FLASH_ERASE_STATUS command */
+
+void BL_voidHandleMemWritePostedCmd(uint8_t* copy_puint8CmdPacket); /* Handles BL_MEM_WRITE_POSTED command */
+
+void BL_voidHandleBeginProgramCmd(uint8_t* copy_puint8CmdPacket);  /* Handles BL_BEGIN_PROGRAM command */
+
+void BL_voidHandleEndProgramCmd(uint8_t* copy_puint8CmdPacket);    /* Handles BL_END_PROGRAM command */
+
+void BL_voidHandleEraseRangeCmd(uint8_t* copy_puint8CmdPacket);    /* Handles BL_ERASE_RANGE command */
+
+void BL_voidHandleVerifyRangeCmd(uint8_t* copy_puint8CmdPacket);   /* Handles BL_VERIFY_RANGE command */
+
+void BL_voidHandleCommitCmd(uint8_t* copy_puint8CmdPacket);        /* Handles BL_COMMIT command */
+
+void BL_voidHandleBlockCrcManifestCmd(uint8_t* copy_puint8CmdPacket); /* Handles BL_BLOCK_CRC_MANIFEST command */
+
+void BL_voidHandleSetFrameCrcCmd(uint8_t* copy_puint8CmdPacket);    /* Handles BL_SET_FRAME_CRC command */
+
+void BL_voidHandleGetDeviceInfoCmd(uint8_t* copy_puint8CmdPacket);  /* Handles BL_GET_DEVICE_INFO command */
+
+void BL_voidHandleReadMultiCmd(uint8_t* copy_puint8CmdPacket);      /* Handles BL_READ_MULTI command */
+
+void BL_voidHandleBlankMapCmd(uint8_t* copy_puint8CmdPacket);       /* Handles BL_BLANK_MAP command */
+
+void BL_voidHandleBatchCmd(uint8_t* copy_puint8CmdPacket);          /* Handles BL_BATCH command */
+
+void BL_voidHandleResumeSessionCmd(uint8_t* copy_puint8CmdPacket);  /* Handles BL_RESUME_SESSION command */
+
+void BL_voidHandleGetCapabilitiesCmd(uint8_t* copy_puint8CmdPacket); /* Handles BL_GET_CAPABILITIES command */
+
+void BL_voidHandleSetFramingCmd(uint8_t* copy_puint8CmdPacket);     /* Handles BL_SET_FRAMING command */
+
+void BL_voidHandleMemWriteLzCmd(uint8_t* copy_puint8CmdPacket);     /* Handles BL_MEM_WRITE_LZ command */
+
+void BL_voidHandleMemWriteDeltaCmd(uint8_t* copy_puint8CmdPacket);  /* Handles BL_MEM_WRITE_DELTA command */
+
+void BL_voidHandleMemFillCmd(uint8_t* copy_puint8CmdPacket);        /* Handles BL_MEM_FILL command */
+
+void BL_voidHandleGetBootTimesCmd(uint8_t* copy_puint8CmdPacket);   /* Handles BL_GET_BOOT_TIMES command */
+
+void BL_voidHandleRamRunCmd(uint8_t* copy_puint8CmdPacket);         /* Handles BL_RAM_RUN command */
+
+void BL_voidHandleSlotActivateCmd(uint8_t* copy_puint8CmdPacket);   /* Handles BL_SLOT_ACTIVATE command */
+
+void BL_voidHandleGetWearStatsCmd(uint8_t* copy_puint8CmdPacket);   /* Handles BL_GET_WEAR_STATS command */
+
+void BL_voidHandleGetStatsCmd(uint8_t* copy_puint8CmdPacket);       /* Handles BL_GET_STATS command */
+
+void BL_voidHandleGetTraceCmd(uint8_t* copy_puint8CmdPacket);       /* Handles BL_GET_TRACE command */
+
+void BL_voidHandleBroadcastStatusCmd(uint8_t* copy_puint8CmdPacket); /* Handles BL_BROADCAST_STATUS command */
+
+void BL_voidHandleGetCrashRecordCmd(uint8_t* copy_puint8CmdPacket);  /* Handles BL_GET_CRASH_RECORD command */
+
+void BL_voidHandleEraseForImageCmd(uint8_t* copy_puint8CmdPacket);   /* Handles BL_ERASE_FOR_IMAGE command */
+
+void BL_voidHandleDiscoverCmd(uint8_t* copy_puint8CmdPacket);        /* Handles BL_DISCOVER command */
+
+void BL_voidHandleMemWritePackageCmd(uint8_t* copy_puint8CmdPacket); /* Handles BL_MEM_WRITE_PACKAGE command */
+
+void BL_voidHandleSelfUpdateCmd(uint8_t* copy_puint8CmdPacket);      /* Handles BL_SELF_UPDATE command */
+
+void BL_voidHandleResetAndBootCmd(uint8_t* copy_puint8CmdPacket);    /* Handles BL_RESET_AND_BOOT command */
+
+void BL_voidHandleGetAppInfoCmd(uint8_t* copy_puint8CmdPacket);      /* Handles BL_GET_APP_INFO command */
+
+void BL_voidHandleProgramFromRamCmd(uint8_t* copy_puint8CmdPacket); /* Handles BL_PROGRAM_FROM_RAM command */
+
+void BL_voidHandleSetProgressCmd(uint8_t* copy_puint8CmdPacket);     /* Handles BL_SET_PROGRESS command */
+
+void BL_voidHandleRunScriptCmd(uint8_t* copy_puint8CmdPacket);       /* Handles BL_RUN_SCRIPT command */
+
+void BL_voidHandleEchoCmd(uint8_t* copy_puint8CmdPacket);            /* Handles BL_ECHO command */
+
+void BL_voidHandleSinkCmd(uint8_t* copy_puint8CmdPacket);            /* Handles BL_SINK command */
+
+void BL_voidDispatchCommand(uint8_t* copy_puint8CmdPacket);         /* CRC / length check and handler call for one received frame */
+
+void BL_voidRunBackgroundTasks(void);                               /* Steps the background erase, called by the command loop */
+
+void BL_voidSessionTick(void);                                      /* 1 ms tick from SysTick, expires the programming session */
+
+uint8_t BL_uint8SessionRecover(uint32_t Copy_uint32Base, uint32_t Copy_uint32End); /* BL_JOURNAL_ENABLE: boot-time journal replay, 1 if an interrupted session touched the range */
+
+uint8_t BL_uint8ProgramOpen(void);                                  /* BL_USB_MSC_ENABLE: programming session for a UF2 copy, nothing erased yet */
+
+uint8_t BL_uint8ProgramWrite(uint32_t Copy_uint32Address, uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length); /* BL_USB_MSC_ENABLE: auto-erase + write-combined program */
+
+uint8_t BL_uint8ProgramClose(void);                                 /* BL_USB_MSC_ENABLE: flushes, relocks, HAL_ERROR if any write failed */
+
 
 
 
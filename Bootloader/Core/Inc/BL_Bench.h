@@ -0,0 +1,50 @@
+#ifndef INC_BL_BENCH_H_
+#define INC_BL_BENCH_H_
+
+#include <stdint.h>
+
+/*
+ * Microbenchmark Firmware
+ * -----------------------
+ * With BL_BENCH_ENABLE (the "Bench" build configuration) main() runs this
+ * suite instead of the bootloader, once at the CubeMX HSI profile and once
+ * at 168 MHz HSE, and reports every primitive over USART2 (115200 8N1) as
+ * one CSV line:
+ *
+ *   bench,<name>,<SYSCLK Hz>,<flash wait states>,<bytes>,<min cycles>,<max cycles>,<cycles/byte>
+ *
+ * Each primitive runs BL_BENCH_REPEAT times over BL_BENCH_LENGTH bytes,
+ * timed with DWT->CYCCNT. Only the SysTick interrupt is live: the minimum
+ * is the figure to compare, a repeat hit by a tick shows in the maximum.
+ *
+ *  - crc-byte  : one byte per CRC word, the frame check of uint8VerifyCRC
+ *                with BL_CRC_WORDWISE_ENABLE = 0 (BL_uint32CRCFeedBytes).
+ *  - crc-word  : whole words to CRC->DR by the CPU.
+ *  - crc-dma   : BL_uint32CRCCalculate on an aligned block (DMA2 Stream1).
+ *  - flash-byte, flash-word : HAL_FLASH_Program x8 / x32, one call per unit.
+ *  - flash-bl  : BL_uint8FlashProgram (register level, from RAM).
+ *  - flash-erase : BL_uint8FlashEraseSector of BL_BENCH_FLASH_SECTOR, which
+ *                the flash primitives then program: its contents are lost.
+ *  - copy-memcpy-<ram>, copy-words-<ram> : newlib memcpy and a word loop
+ *                from SRAM1 into SRAM1, SRAM2 (the RAM run area, unused
+ *                here) and CCMRAM (below the handoff block).
+ *  - sha256-sram, sha256-flash : BL_voidSHA256Calculate.
+ *  - aes-ctr-128, aes-ctr-256 : BL_voidAESCTR in place in SRAM1, the
+ *                decryption of an encrypted session's frames.
+ */
+#define BL_BENCH_LENGTH              4096u     /* Bytes per repeat */
+
+#define BL_BENCH_REPEAT              8u
+
+#define BL_BENCH_FLASH_SECTOR        11u       /* 128 KB: every flash repeat without another erase */
+
+
+/*
+ * Bootloader Bench Functions
+ * --------------------------
+ */
+
+void BL_voidBenchRun(void);                                              /* The whole suite at the current clock */
+
+
+#endif /* INC_BL_BENCH_H_ */
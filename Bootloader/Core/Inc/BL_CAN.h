@@ -0,0 +1,89 @@
+#ifndef INC_BL_CAN_H_
+#define INC_BL_CAN_H_
+
+#include <stdint.h>
+
+/*
+ * CAN1 Transport
+ * --------------
+ * Serves the command set on a CAN bus shared by several nodes (classic CAN,
+ * 11-bit identifiers, BL_CAN_BITRATE). Enabled with BL_TRANSPORT_CAN_ENABLE
+ * (BL_config.h). Pins: PD0 CAN1_RX, PD1 CAN1_TX (AF9), to an external transceiver.
+ *
+ * The frames are the USART2 frames, cut into CAN data frames of up to 8
+ * bytes sent back to back; a frame boundary needs no alignment to a CAN frame.
+ * Identifiers, per node (BL_CAN_NODE_ID, 1..127) and per group (BL_CAN_GROUP_ID):
+ *  - BL_CAN_ID_REQUEST + node : host -> this node, link BL_LINK_CAN
+ *  - BL_CAN_ID_RESPONSE + node: this node -> host, the responses of BL_LINK_CAN
+ *  - BL_CAN_ID_GROUP + group  : host -> every node of the group, link BL_LINK_CAN_GROUP
+ *
+ * Group (broadcast) mode: commands on the group identifier run on every node
+ * of the group at once and are never answered, since a dozen nodes would
+ * answer on top of each other. The host therefore paces itself:
+ *  1. Erase and write the image with group frames (BL_MEM_WRITE / FLASH_ERASE),
+ *     leaving a node's BL_CAN_RX_RING_SIZE of data in flight at most.
+ *  2. After each erase, and at the end, send any unicast command to each node
+ *     and wait for its answer: a node takes group frames before unicast ones,
+ *     so the answer means every group frame received so far has been executed.
+ *  3. Verify each node on its own identifier (BL_VERIFY_RANGE / GET_CRC) and
+ *     repeat the failed ranges unicast; a node that lost a group frame to a
+ *     full ring only shows up here.
+ * Each link has its own RX ring, filled by the FIFO interrupts (FIFO0:
+ * unicast, FIFO1: group).
+ *
+ * Discovery (BL_DISCOVER on the group identifier, "Node Discovery" in BL.h):
+ * the answer is one extended frame, BL_CAN_EXT_ID_DISCOVER | the next 25
+ * bits of the node's unique ID, outside the response stream. Nodes with
+ * different bits are serialised by the bitwise arbitration of the
+ * identifier; nodes with the same bits send identical frames, which the bus
+ * merges, so nothing ever collides in a data field.
+ */
+
+#ifndef BL_CAN_NODE_ID
+#define BL_CAN_NODE_ID               1u        /* 1..127, unique on the bus */
+#endif
+
+#ifndef BL_CAN_GROUP_ID
+#define BL_CAN_GROUP_ID              0u        /* 0..127, nodes flashed together share it */
+#endif
+
+#define BL_CAN_BITRATE               500000UL
+
+#define BL_CAN_ID_GROUP              0x080u
+#define BL_CAN_ID_REQUEST            0x100u
+#define BL_CAN_ID_RESPONSE           0x180u
+
+#define BL_CAN_EXT_ID_DISCOVER       0x1E000000UL   /* 29-bit, lowest priority: | 25 ID bits */
+
+#define BL_CAN_RX_RING_SIZE          4096u     /* Per link, power of two (Ring.h) */
+
+#define BL_CAN_TX_TIMEOUT_MS         1000u     /* A response nobody acknowledges on the bus is dropped */
+
+
+/*
+ * Bootloader CAN Functions
+ * ------------------------
+ */
+
+void     BL_voidCANInit(void);                                           /* CAN1 at BL_CAN_BITRATE, filters, FIFO / TX interrupts */
+
+void     BL_voidCANDeInit(void);                                         /* Interrupts off, CAN1 asleep, clock off */
+
+uint16_t BL_uint16CANAvailable(uint8_t Copy_uint8Group);                 /* Bytes waiting in the unicast (0) or group (1) ring */
+
+uint8_t  BL_uint8CANPeek(uint8_t Copy_uint8Group, uint16_t Copy_uint16Offset); /* Byte at tail + offset, not consumed */
+
+void     BL_voidCANConsume(uint8_t Copy_uint8Group, uint16_t Copy_uint16Count); /* Releases bytes from a ring */
+
+void     BL_voidCANTransmit(const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length); /* Queues a response, returns at once */
+
+void     BL_voidCANTxFlush(void);                                        /* Waits until the response is on the bus */
+
+void     BL_voidCANSendDiscovery(uint32_t Copy_uint32Bits, const uint8_t* Copy_puint8Data, uint8_t Copy_uint8Length); /* One extended discovery frame, blocking */
+
+void     BL_voidCANRxIRQHandler(uint8_t Copy_uint8Fifo);                 /* CAN1_RX0_IRQHandler / CAN1_RX1_IRQHandler */
+
+void     BL_voidCANTxIRQHandler(void);                                   /* CAN1_TX_IRQHandler */
+
+
+#endif /* INC_BL_CAN_H_ */
@@ -0,0 +1,143 @@
+#ifndef INC_BL_CRC_H_
+#define INC_BL_CRC_H_
+
+#include <stdint.h>
+
+/*
+ * Word-Wise CRC Engine
+ * --------------------
+ * CRC-32 of the hardware CRC unit (polynomial 0x04C11DB7, initial value
+ * 0xFFFFFFFF, no reflection, no final XOR) over a memory range:
+ *  - every complete group of 4 bytes is fed as one little-endian word
+ *    (b0 | b1 << 8 | b2 << 16 | b3 << 24),
+ *  - the (length % 4) tail bytes are fed one per word (0x000000bb).
+ * Host side, per word w: crc ^= w; 32 x { crc = (crc & 0x80000000) ?
+ * (crc << 1) ^ 0x04C11DB7 : crc << 1; }
+ *
+ * Word-aligned ranges of at least BL_CRC_DMA_MIN_LENGTH bytes are fed by
+ * DMA2 Stream1 in memory-to-memory mode (source incremented, destination
+ * fixed on CRC->DR), so a whole image is checked at bus speed. Shorter or
+ * unaligned ranges use a CPU loop. Flash and SRAM1/2 only (no CCM).
+ */
+
+#define BL_CRC_DMA_MIN_LENGTH        256u      /* Below this the DMA set-up costs more than it saves */
+
+#define BL_CRC_DMA_MAX_WORDS         0xFFFFu   /* NDTR limit of one DMA transfer */
+
+
+/*
+ * IEEE CRC-32
+ * -----------
+ * The standard CRC-32 of zlib, Ethernet and PNG (reflected polynomial
+ * 0xEDB88320, initial value and final XOR 0xFFFFFFFF, bytes in order) from
+ * the same unit: a bit-reversed unit computes the reflected CRC, so every
+ * little-endian word goes in through __RBIT and the result comes out through
+ * __RBIT and a final inversion. The tail bytes are added in software. Hosts
+ * check it with any CRC-32 library (hardware-accelerated on most PCs)
+ * instead of the word-wise CRC above. CPU-fed, as the DMA cannot reverse
+ * words: about the speed of the word-wise CPU loop.
+ */
+#define BL_CRC_IEEE_POLYNOMIAL       0xEDB88320UL
+
+
+/*
+ * Software CRC (BL_CRC_SOFT_ENABLE)
+ * ---------------------------------
+ * The same word-wise CRC without the unit, slicing-by-8: table n holds the
+ * CRC of a byte followed by n zero bytes, so two words (8 bytes) take 8
+ * lookups and XORs instead of 64 shift steps. The 8 x 256 words are
+ * built once by BL_voidCRCInit into CCMRAM (zero wait states, no flash
+ * space). Any number of software CRCs run side by side, each in its own
+ * variable, and interrupts need not be masked.
+ *
+ * Engine Choice
+ * -------------
+ * A running CRC keeps the same State whichever engine computed it, so every
+ * update picks one: word-aligned pieces of at least BL_CRC_SOFT_DMA_LENGTH
+ * bytes outside CCMRAM go to the unit by DMA (bus speed, the restore of the
+ * unit paid once), everything else is computed in software. Frame-sized
+ * pieces therefore never make the receive interrupt skip its frame check.
+ */
+#define BL_CRC_SOFT_DMA_LENGTH       1024u     /* Smallest piece still worth restoring the unit for */
+
+
+/*
+ * Running CRC
+ * -----------
+ * Word-wise CRC of data arriving in pieces of any size: the result of
+ * BL_uint32CRCStreamFinish equals BL_uint32CRCCalculate over the
+ * concatenation. The CRC unit is shared with frame checks, so its state is
+ * saved in the context between updates and restored afterwards (the unit has
+ * no initial-value register on the F4: restoring costs one computed word).
+ */
+typedef struct
+{
+	uint32_t State;                             /* CRC unit value after the last whole word */
+	uint32_t Length;                            /* Bytes fed so far */
+	uint8_t  Tail[4];                           /* Bytes of the unfinished word */
+	uint8_t  TailCount;
+} BL_CRCStream_t;
+
+
+/*
+ * Frame Pre-Check
+ * ---------------
+ * BL_uint8CRCCheckFrame runs from the receive interrupt (in RAM), while a
+ * handler may be in the middle of its own CRC: the unit's value is saved and
+ * restored around the check, which is therefore only skipped when DMA2
+ * Stream1 is feeding the unit. Same CRC as the dispatcher's frame check
+ * (word-wise with BL_CRC_WORDWISE_ENABLE, one byte per word otherwise).
+ */
+#define BL_CRC_FRAME_UNCHECKED       0u        /* Not checked: the dispatcher computes it */
+#define BL_CRC_FRAME_OK              1u
+#define BL_CRC_FRAME_BAD             2u
+#define BL_CRC_FRAME_PENDING         3u        /* Checked by DMA, result from BL_uint8CRCCheckFramePoll */
+
+
+/*
+ * Frame Check By DMA (BL_CRC_WORDWISE_ENABLE)
+ * -------------------------------------------
+ * The same check without the CPU, so it runs while the CPU programs the
+ * previous frame into flash: BL_uint8CRCCheckFrameStart saves the unit and
+ * points DMA2 Stream1 at the frame with a byte-wide source, its FIFO packing
+ * each 4 bytes into one little-endian word for CRC->DR (no alignment needed
+ * then). BL_uint8CRCCheckFramePoll feeds the tail bytes once the stream is
+ * done, compares and restores the unit. One frame at a time; until the poll
+ * has returned the result the unit belongs to it, so the caller keeps every
+ * other CRC away meanwhile (BL_voidTransportCheckAhead). Frames fed one byte
+ * per word cannot be packed by the FIFO: without BL_CRC_WORDWISE_ENABLE the
+ * start always returns BL_CRC_FRAME_UNCHECKED.
+ */
+
+
+/*
+ * Bootloader CRC Functions
+ * ------------------------
+ */
+
+void     BL_voidCRCInit(void);                                           /* DMA2 Stream1 memory-to-memory set-up */
+
+uint32_t BL_uint32CRCCalculate(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length); /* Word-wise CRC from reset */
+
+uint32_t BL_uint32CRCCalculateIEEE(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length); /* Standard (zlib) CRC-32 */
+
+void     BL_voidCRCStreamStart(BL_CRCStream_t* Copy_pStream);            /* Empty running CRC */
+
+void     BL_voidCRCStreamUpdate(BL_CRCStream_t* Copy_pStream, const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length); /* Appends data */
+
+uint32_t BL_uint32CRCStreamFinish(const BL_CRCStream_t* Copy_pStream);   /* CRC of everything fed, context unchanged */
+
+void     BL_voidCRCReset(void);                                          /* Next CRC starts from 0xFFFFFFFF */
+
+uint32_t BL_uint32CRCFeedBytes(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length); /* One byte per word, continuing; returns the CRC so far */
+
+uint8_t  BL_uint8CRCCheckFrame(const uint8_t* Copy_puint8Frame, uint16_t Copy_uint16Length); /* BL_CRC_FRAME_xxx of a whole frame, from interrupt context */
+
+uint8_t  BL_uint8CRCCheckFrameStart(const uint8_t* Copy_puint8Frame, uint16_t Copy_uint16Length); /* BL_CRC_FRAME_PENDING if the DMA took the frame, UNCHECKED if busy */
+
+uint8_t  BL_uint8CRCCheckFramePoll(uint8_t Copy_uint8Wait);             /* Result of that check: OK / BAD, PENDING while running, UNCHECKED if none */
+
+uint32_t BL_uint32CRCSoftCalculate(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length); /* BL_CRC_SOFT_ENABLE: word-wise CRC from reset, CRC unit untouched */
+
+
+#endif /* INC_BL_CRC_H_ */
@@ -0,0 +1,166 @@
+#ifndef INC_BL_FLASH_H_
+#define INC_BL_FLASH_H_
+
+#include <stdint.h>
+
+/*
+ * RAM-Resident Flash Programming
+ * ------------------------------
+ * The bootloader runs from flash, and every program / erase operation stalls
+ * instruction fetch from flash until it completes (up to 2 s per 128 KB sector).
+ * The routines below drive the flash interface at register level and are placed
+ * in the .RamFunc section (STM32F407VGTX_FLASH.ld), together with the USART2 /
+ * DMA and OTG_FS interrupt paths, the SysTick and a copy of the vector table
+ * in SRAM.
+ * While they wait for BSY, interrupts keep being serviced: the RX ring is fed,
+ * IDLE events are recorded and RTS follows the ring level.
+ *
+ * BL_voidFlashEraseSectorStart() does not wait: the end of the erase raises the
+ * FLASH interrupt, which wakes the command loop (BL_voidTransportNotifyBackground).
+ *
+ * The caller unlocks / locks the flash (HAL_FLASH_Unlock / HAL_FLASH_Lock).
+ *
+ * With BL_WEAR_STATS_ENABLE every erase started is counted per sector in RAM
+ * until the journal takes the counts over (BL_Journal.h).
+ *
+ * With BL_SLOT_CACHE_ENABLE every program and erase first invalidates the
+ * blocks it touches in the slot cache (BL_SlotCache.h).
+ *
+ * Parallelism: programs and erases go BL_FLASH_PSIZE_xxx bytes at a time,
+ * the widest the supply allows (BL_FLASH_PARALLELISM in BL_config.h). Given
+ * x32, a 128 KB sector erases about 2x faster than with x16 and 4x faster
+ * than with x8. Measured, BL_uint8FlashSelectParallelism converts VREFINT
+ * (ADC1 channel 17, factory calibrated at 3.3 V) a few times and takes the
+ * mean; the thresholds keep 50 mV of margin for the ADC error. A reading
+ * that makes no sense falls back to x8, legal on any supply the part
+ * runs from.
+ *
+ * With BL_STATS_ENABLE every program call and sector erase is timed with the
+ * DWT cycle counter into a log2 histogram of microseconds per sector class
+ * (16 / 64 / 128 KB), reported by BL_GET_STATS: the host sets its timeouts
+ * from what this board's flash really takes.
+ */
+
+/*
+ * Bootloader Replacement
+ * ----------------------
+ * BL_voidFlashReplaceBootloader copies a checked image over sectors 0 and 1
+ * and resets. From its first erase on there is no bootloader in flash, so
+ * it runs with interrupts masked and touches nothing outside SRAM: register
+ * loops only, no HAL and no vector fetch. A sector is erased unless it
+ * reads blank already, past the image too (no stale code left behind it),
+ * then the image is programmed a word at a time with x32 (half-words /
+ * bytes on a lower supply) and read back; a failed pass starts over, up to
+ * BL_FLASH_REPLACE_ATTEMPTS times. At x32 the window without a bootloader
+ * is one or two 16 KB erases (250 ms each, typical) and 16 us per word:
+ * about 0.4 s for a 16 KB bootloader, 0.6 s for a full 32 KB one.
+ */
+#define BL_FLASH_BOOTLOADER_SECTORS   2u        /* Sectors 0 and 1, up to BL_IMAGE_BASE_ADDRESS */
+#define BL_FLASH_REPLACE_ATTEMPTS     3u        /* Erase / program / verify passes before the reset */
+
+/*
+ * Sector geometry
+ * ---------------
+ * STM32F407VG, 1 MB single bank: 4 x 16 KB, 1 x 64 KB, 7 x 128 KB.
+ * Described once in a const table (BL_Flash.c); everything that needs the
+ * layout (blank-check, auto-erase, BL_ERASE_RANGE) looks sectors up there.
+ */
+#define BL_FLASH_SECTOR_COUNT         12u
+#define BL_FLASH_INVALID_SECTOR       0xFFu     /* Address outside the flash */
+
+typedef struct
+{
+	uint32_t Base;                              /* First address of the sector */
+	uint32_t Size;                              /* Sector size in bytes */
+} BL_FlashSector_t;
+
+/* Returned by BL_uint8FlashSectorIsBlank */
+#define BL_FLASH_SECTOR_BLANK         1u
+#define BL_FLASH_SECTOR_NOT_BLANK     0u
+
+/* Returned by BL_uint32FlashVerify when the flash matches (not a flash address) */
+#define BL_FLASH_VERIFY_OK            0xFFFFFFFFUL
+
+/* Returned by BL_uint8FlashGetEraseResult while a started erase is running */
+#define BL_FLASH_OP_PENDING           0xFFu
+
+/* Operation timing (BL_STATS_ENABLE): sector classes, by size */
+#define BL_FLASH_CLASS_16KB           0u
+#define BL_FLASH_CLASS_64KB           1u
+#define BL_FLASH_CLASS_128KB          2u
+#define BL_FLASH_CLASS_COUNT          3u
+
+/* Programming parallelism, in bytes per step */
+#define BL_FLASH_PSIZE_X8             1u        /* 1.8 V .. 2.1 V */
+#define BL_FLASH_PSIZE_X16            2u        /* 2.1 V .. 2.7 V */
+#define BL_FLASH_PSIZE_X32            4u        /* 2.7 V .. 3.6 V */
+
+#define BL_FLASH_VDD_X32_MV           2750u     /* Lowest measured VDD taken for x32 */
+#define BL_FLASH_VDD_X16_MV           2150u     /* Lowest measured VDD taken for x16 */
+#define BL_FLASH_VDD_SAMPLES          8u        /* Conversions averaged, after one discarded */
+
+/* Bucket 0: under 1 us; bucket n: 2^(n-1) .. 2^n - 1 us; the last one everything from 2^22 us (4.2 s) */
+#define BL_FLASH_TIMING_BUCKETS       24u
+
+typedef struct
+{
+	uint32_t MaxUs;                             /* Longest operation */
+	uint32_t TotalUs;                           /* Sum of all of them (wraps after 71 min) */
+	uint32_t Units;                             /* Bytes programmed / sectors erased */
+	uint32_t Counts[BL_FLASH_TIMING_BUCKETS];
+} BL_FlashHistogram_t;
+
+typedef struct
+{
+	BL_FlashHistogram_t Program[BL_FLASH_CLASS_COUNT];   /* One per BL_uint8FlashProgram call, by the sector of its address */
+	BL_FlashHistogram_t Erase[BL_FLASH_CLASS_COUNT];     /* One per sector erase, synchronous or started */
+} BL_FlashTiming_t;
+
+
+/*
+ * Bootloader Flash Functions
+ * --------------------------
+ */
+
+void     BL_voidFlashInit(void);                                         /* Moves the vector table to SRAM */
+
+uint8_t  BL_uint8FlashSelectParallelism(void);                          /* Measures VDD, sets and returns BL_FLASH_PSIZE_xxx */
+
+uint8_t  BL_uint8FlashGetParallelism(void);                             /* BL_FLASH_PSIZE_xxx in use */
+
+uint16_t BL_uint16FlashGetVdd(void);                                    /* VDD in mV at the last selection, 0 with a fixed parallelism */
+
+uint8_t  BL_uint8FlashProgram(uint32_t Copy_uint32Address, const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length); /* Byte head / parallelism-wide body / byte tail */
+
+uint32_t BL_uint32FlashVerify(uint32_t Copy_uint32Address, const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length); /* First differing address or BL_FLASH_VERIFY_OK */
+
+uint8_t  BL_uint8FlashEraseSector(uint8_t Copy_uint8Sector);             /* Erases one sector (0 .. 11) */
+
+uint8_t  BL_uint8FlashMassErase(void);                                   /* Erases the whole bank */
+
+uint8_t  BL_uint8FlashSectorIsBlank(uint8_t Copy_uint8Sector);           /* 1 if the sector reads all 0xFF */
+
+uint8_t  BL_uint8FlashRangeIsBlank(uint32_t Copy_uint32Address, uint32_t Copy_uint32Length); /* Same for a word-aligned range */
+
+uint8_t  BL_uint8FlashGetSector(uint32_t Copy_uint32Address);            /* Sector holding an address, or BL_FLASH_INVALID_SECTOR */
+
+const BL_FlashSector_t* BL_pFlashGetSectorInfo(uint8_t Copy_uint8Sector); /* Base / size of a sector, NULL if out of range */
+
+void     BL_voidFlashEraseSectorStart(uint8_t Copy_uint8Sector);         /* Starts an erase, ends in the FLASH interrupt */
+
+uint8_t  BL_uint8FlashGetEraseResult(void);                              /* BL_FLASH_OP_PENDING / HAL_OK / HAL_ERROR */
+
+void     BL_voidFlashIRQHandler(void);                                   /* Called from FLASH_IRQHandler */
+
+uint16_t BL_uint16FlashGetEraseCount(uint8_t Copy_uint8Sector);          /* BL_WEAR_STATS_ENABLE: erases since the last clear */
+
+void     BL_voidFlashClearEraseCounts(void);                             /* BL_WEAR_STATS_ENABLE: counts moved to the journal */
+
+void     BL_voidFlashReplaceBootloader(uint32_t Copy_uint32Source, uint32_t Copy_uint32Length) __attribute__((noreturn)); /* Copies an image over the bootloader, resets */
+
+const BL_FlashTiming_t* BL_pFlashGetTiming(void);                        /* BL_STATS_ENABLE: histograms since reset or the last clear */
+
+void     BL_voidFlashClearTiming(void);                                  /* BL_STATS_ENABLE: histograms back to 0 */
+
+
+#endif /* INC_BL_FLASH_H_ */
@@ -0,0 +1,172 @@
+#ifndef INC_BL_HANDOFF_H_
+#define INC_BL_HANDOFF_H_
+
+#include <stdint.h>
+
+/*
+ * Boot Handoff Block
+ * ------------------
+ * Written by Bootloader_JumpToUserApp into the last 64 bytes of CCMRAM, which
+ * neither linker script allocates and no start-up code clears: what the
+ * bootloader leaves to the application, read once by its start-up code.
+ *  - the clock tree at the jump (RCC PLLCFGR / CFGR, flash ACR, SYSCLK): with
+ *    BL_HANDOFF_KEEP_CLOCK the PLL is still running and an application
+ *    wanting the same configuration skips its PLL start-up and lock wait,
+ *  - the reset flags (RCC CSR, not cleared by the bootloader) and the path
+ *    the boot took,
+ *  - the bootloader version,
+ *  - DWT cycle stamps of the boot milestones (below).
+ * Check is the complement of the XOR of the other words: a block left from an
+ * earlier boot after power loss (random CCMRAM) is not taken for valid.
+ * The UserApp keeps its own copy of the layout (IDE projects are separate).
+ */
+
+#define BL_HANDOFF_ADDRESS            0x1000FFC0UL   /* CCMRAM end - 64 */
+#define BL_HANDOFF_SIZE               64u
+
+#define BL_HANDOFF_MAGIC              0x46444842UL   /* "BHDF" */
+
+/* BL_Handoff_t.BootPath */
+#define BL_HANDOFF_PATH_FAST          1u             /* Jumped before HAL_Init (Bootloader_FastBootAllowed) */
+#define BL_HANDOFF_PATH_CHECKED       2u             /* Full path: image checked (and CRC-validated if needed) */
+#define BL_HANDOFF_PATH_INSTALLED     3u             /* A staged update was installed on this boot */
+#define BL_HANDOFF_PATH_RAM           4u             /* BL_RAM_RUN of an image in SRAM */
+#define BL_HANDOFF_PATH_ROLLBACK      5u             /* Trial boot expired, previous slot started */
+#define BL_HANDOFF_PATH_LOADER        6u             /* Second-stage loader started (BL_Loader.h) */
+#define BL_HANDOFF_PATH_COMMAND       7u             /* BL_RESET_AND_BOOT handoff out of update mode */
+
+/*
+ * Boot milestones
+ * ---------------
+ * main starts the DWT cycle counter from 0 (the reset origin: only the start-up
+ * code before main is not counted) and each milestone stores CYCCNT in
+ * Stamps[], 0 = not reached on this boot. The counter keeps running across
+ * the jump, so the application can go on from Stamps[BL_BOOT_STAMP_JUMP].
+ * Cycles before BL_BOOT_STAMP_CLOCK run at HSI (16 MHz), later ones at
+ * SysClock. The stamps are filled in place during the boot (Magic is cleared
+ * at main entry and set at the jump): BL_GET_BOOT_TIMES reads them in update
+ * mode, the application from the handoff block.
+ */
+#define BL_BOOT_STAMP_CLOCK           0u             /* System clock configured (full path only) */
+#define BL_BOOT_STAMP_DECISION        1u             /* Jump or update mode decided */
+#define BL_BOOT_STAMP_VALIDATED       2u             /* Application image accepted */
+#define BL_BOOT_STAMP_JUMP            3u             /* Handoff written, about to jump */
+#define BL_BOOT_STAMPS                4u
+
+typedef struct
+{
+	uint32_t Magic;                             /* BL_HANDOFF_MAGIC */
+	uint32_t Version;                           /* BL_VERSION */
+	uint32_t BootPath;                          /* BL_HANDOFF_PATH_xxx */
+	uint32_t ResetFlags;                        /* RCC->CSR at the jump */
+	uint32_t SysClock;                          /* SystemCoreClock (Hz) */
+	uint32_t Pllcfgr;                           /* RCC->PLLCFGR */
+	uint32_t Cfgr;                              /* RCC->CFGR, SWS = source in use */
+	uint32_t FlashAcr;                          /* FLASH->ACR, latency and caches */
+	uint32_t Stamps[BL_BOOT_STAMPS];            /* DWT->CYCCNT at each milestone */
+	uint32_t Check;                             /* ~(XOR of the words above) */
+} BL_Handoff_t;
+
+#define BL_HANDOFF                    ((BL_Handoff_t*)BL_HANDOFF_ADDRESS)
+
+/*
+ * Update Request
+ * --------------
+ * The other direction: the application asks for update mode without B1 by
+ * writing BL_UPDATE_REQUEST_MAGIC to RTC backup register 0 (backup domain
+ * write access enabled) and calling NVIC_SystemReset. The register survives
+ * the reset (and any reset short of a backup domain reset or power loss
+ * without VBAT); the bootloader reads and clears it before anything else, so
+ * one request enters update mode once.
+ *
+ * BL_RESET_AND_BOOT uses the same register the other way round: its reset
+ * leaves BL_BOOT_REQUEST_MAGIC, and the next boot ignores B1 once, so a
+ * button held (or strapped on a fixture) cannot keep it in update mode.
+ */
+#define BL_UPDATE_REQUEST_REGISTER    (RTC->BKP0R)
+#define BL_UPDATE_REQUEST_MAGIC       0x51524C42UL   /* "BLRQ" */
+#define BL_BOOT_REQUEST_MAGIC         0x54424C42UL   /* "BLBT" */
+
+/*
+ * Trial Boot (BL_TRIAL_BOOT_ENABLE)
+ * ---------------------------------
+ * A newly activated or installed image starts on trial: RTC backup register 1
+ * holds BL_TRIAL_MAGIC with the number of boots tried in its low byte. Each
+ * boot of a trial image increments it and arms the IWDG (about 8 s) before
+ * the jump, so an image that hangs resets back into the bootloader. The image
+ * confirms itself by writing BL_TRIAL_CONFIRMED (Bootloader_ConfirmImage in
+ * the UserApp) and must then keep refreshing the watchdog, which cannot be
+ * stopped. After BL_TRIAL_BOOT_ATTEMPTS unconfirmed boots the previous A/B
+ * slot is activated again, or update mode waits when there is none.
+ * Power lost without VBAT clears the register: the image is then trusted.
+ */
+#define BL_TRIAL_REGISTER             (RTC->BKP1R)
+#define BL_TRIAL_MAGIC                0x544C4200UL   /* "BLT" + attempt count */
+#define BL_TRIAL_MAGIC_MASK           0xFFFFFF00UL
+#define BL_TRIAL_CONFIRMED            0x00000000UL
+
+/*
+ * Crash Record
+ * ------------
+ * The fault handlers of both images (HardFault, MemManage, BusFault,
+ * UsageFault in stm32f4xx_it.c) save what the fault left into the last
+ * 256 bytes of backup SRAM and reset at once, so a device in the field is
+ * back in service and the fault can still be diagnosed without a debugger:
+ * BL_GET_CRASH_RECORD reads it in one frame (blflash crash).
+ *  - the exception number (BL_CRASH_FAULT_xxx) and the image it hit,
+ *  - the stacked R0-R3, R12, LR, PC, xPSR and the EXC_RETURN value,
+ *  - SCB CFSR / HFSR / MMFAR / BFAR (MMFAR / BFAR only hold an address
+ *    when CFSR MMARVALID / BFARVALID is set),
+ *  - the stack pointer before the exception and up to BL_CRASH_STACK_WORDS
+ *    words from it, cut at the end of its RAM,
+ *  - DWT->CYCCNT, the cycles since the reset that led to the faulting boot
+ *    (main starts the counter; it keeps running across the jump).
+ * A frame or stack pointer outside SRAM / CCMRAM (a stack overflow) is not
+ * read: Registers and Stack stay 0, StackWords 0. Count adds up the faults
+ * recorded since the record was cleared, the other fields describe the last.
+ * Backup SRAM keeps its content over any reset, and with VBAT over power loss;
+ * Check is computed like the handoff block's. The session records
+ * (BL_private.h) use the start of backup SRAM, far below.
+ * The UserApp keeps its own copy of the layout.
+ */
+#define BL_CRASH_ADDRESS              0x40024F00UL   /* Backup SRAM end - 256 */
+
+#define BL_CRASH_MAGIC                0x48535243UL   /* "CRSH" */
+
+/* BL_CrashRecord_t.Fault: exception number (IPSR) */
+#define BL_CRASH_FAULT_HARD           3u
+#define BL_CRASH_FAULT_MEMMANAGE      4u
+#define BL_CRASH_FAULT_BUS            5u
+#define BL_CRASH_FAULT_USAGE          6u
+
+/* BL_CrashRecord_t.Source */
+#define BL_CRASH_SOURCE_BOOTLOADER    1u
+#define BL_CRASH_SOURCE_APPLICATION   2u
+
+#define BL_CRASH_REGISTERS            8u             /* R0 R1 R2 R3 R12 LR PC xPSR */
+#define BL_CRASH_STACK_WORDS          32u
+
+typedef struct
+{
+	uint32_t Magic;                             /* BL_CRASH_MAGIC */
+	uint32_t Count;                             /* Faults since the record was cleared */
+	uint32_t Source;                            /* BL_CRASH_SOURCE_xxx */
+	uint32_t Fault;                             /* BL_CRASH_FAULT_xxx */
+	uint32_t Registers[BL_CRASH_REGISTERS];     /* Exception frame, 0 when not readable */
+	uint32_t ExcReturn;                         /* LR at handler entry */
+	uint32_t Cfsr;                              /* SCB->CFSR */
+	uint32_t Hfsr;                              /* SCB->HFSR */
+	uint32_t Mmfar;                             /* SCB->MMFAR */
+	uint32_t Bfar;                              /* SCB->BFAR */
+	uint32_t Cycles;                            /* DWT->CYCCNT */
+	uint32_t Sp;                                /* MSP / PSP before the exception */
+	uint32_t StackWords;                        /* Words of Stack[] read from Sp */
+	uint32_t Stack[BL_CRASH_STACK_WORDS];
+	uint32_t Check;                             /* ~(XOR of the words above) */
+} BL_CrashRecord_t;
+
+#define BL_CRASH_RECORD               ((volatile BL_CrashRecord_t*)BL_CRASH_ADDRESS)
+#define BL_CRASH_RECORD_WORDS         (sizeof(BL_CrashRecord_t) / 4u)
+
+
+#endif /* INC_BL_HANDOFF_H_ */
@@ -0,0 +1,131 @@
+#ifndef INC_BL_IMAGE_H_
+#define INC_BL_IMAGE_H_
+
+#include <stdint.h>
+
+/*
+ * Application Image Header
+ * ------------------------
+ * The UserApp linker script places a BL_ImageHeader_t right after its vector
+ * table, at BL_IMAGE_HEADER_ADDRESS. The bootloader checks it before the jump:
+ *  - no header (magic missing) or Crc not stamped: jumps as before when the
+ *    vectors are plausible (stack in SRAM, reset handler in the application
+ *    slot), stays in the bootloader when they are not (erased, half-written),
+ *  - header marked validated: only the header and the vectors are checked,
+ *  - otherwise: word-wise CRC (BL_CRC.h) of the whole image; a matching image
+ *    gets its Validated word programmed, a bad one keeps the bootloader running.
+ *
+ * Crc covers [slot base, EndAddress) with the Crc, Validated and Activated
+ * words skipped; it is stamped into the image after the build (host tool).
+ * Validated is left erased (0xFFFFFFFF) by the build. Programming only clears
+ * bits, so the mark needs no erase, and erasing sector 2 (any update) resets it.
+ * Any other program / erase of the application by the bootloader revokes it
+ * (BL_IMAGE_FLAG_REVOKED): the full check then runs on every boot until the
+ * next update.
+ *
+ * With BL_SIGNATURE_ENABLE the CRC no longer makes an image bootable: only a
+ * BL_COMMIT whose signature verifies marks it (BL_voidImageMarkValidated),
+ * and an unmarked image, with or without a header, is not started.
+ *
+ * A/B slots (BL_AB_SLOTS_ENABLE): sectors 2..5 are slot A, 6..9 slot B (the
+ * UserApp links for one of them, STM32F407VGTX_FLASH_SLOTB.ld for slot B).
+ * Activated is an erased word until BL_uint8ImageActivate programs it with a
+ * sequence one above the active slot's; the plausible slot with the highest
+ * sequence is started, slot A when none is activated. Updates go to the
+ * inactive slot (program / erase of the active one is refused), so switching
+ * is one word written after the new image checked out and the old image stays
+ * in place as the fallback: activating it again is another pointer flip.
+ *
+ * Anti-rollback (BL_ROLLBACK_ENABLE): SecurityVersion, covered by the CRC
+ * and the signature, must be at least the OTP security counter
+ * (BL_Rollback.h) and at most BL_ROLLBACK_MAX, or the header fails the
+ * cheap checks: the slot is neither started nor activated. A checked boot
+ * of a confirmed image raises the counter to its SecurityVersion
+ * (BL_uint8ImageRaiseRollback), and such a boot is forced while the counter
+ * is behind, so from then on no older image starts. Version stays free for
+ * the application's own numbering.
+ */
+
+#define BL_IMAGE_BASE_ADDRESS         0x08008000UL   /* Flash sector 2 */
+#define BL_IMAGE_HEADER_OFFSET        0x200u         /* After the 98-entry vector table */
+#define BL_IMAGE_HEADER_ADDRESS       (BL_IMAGE_BASE_ADDRESS + BL_IMAGE_HEADER_OFFSET)
+
+#if BL_AB_SLOTS_ENABLE
+#define BL_IMAGE_SLOT_B_ADDRESS       0x08040000UL   /* Flash sector 6 */
+#define BL_IMAGE_SLOT_COUNT           2u
+#else
+#define BL_IMAGE_SLOT_COUNT           1u
+#endif
+
+#define BL_IMAGE_SLOT_A               0u
+#define BL_IMAGE_SLOT_B               1u
+
+#define BL_IMAGE_MAGIC                0x48494C42UL   /* "BLIH" */
+
+#define BL_IMAGE_CRC_UNSTAMPED        0xFFFFFFFFUL   /* Crc as built, before stamping */
+
+#define BL_IMAGE_FLAG_BLANK           0xFFFFFFFFUL   /* Not validated yet */
+#define BL_IMAGE_FLAG_VALIDATED       0x56414C44UL   /* Full check passed */
+#define BL_IMAGE_FLAG_REVOKED         0x00000000UL   /* Changed after validation */
+
+#define BL_IMAGE_ACTIVATION_BLANK     0xFFFFFFFFUL   /* Slot never activated */
+
+typedef struct
+{
+	uint32_t Magic;                             /* BL_IMAGE_MAGIC */
+	uint32_t Version;                           /* Application version, for the host */
+	uint32_t EndAddress;                        /* First address after the image (linker) */
+	uint32_t Crc;                               /* Stamped after the build */
+	uint32_t Validated;                         /* BL_IMAGE_FLAG_xxx, written by the bootloader */
+	uint32_t Activated;                         /* Activation sequence, written by the bootloader */
+	uint32_t SecurityVersion;                   /* Anti-rollback version, raised only to close old images out */
+	uint32_t BuildId;                           /* Build identifier (APP_BUILD_ID), for the host */
+} BL_ImageHeader_t;
+
+/* Returned by BL_uint8ImageCheck */
+#define BL_IMAGE_NO_HEADER            0u
+#define BL_IMAGE_VALID                1u
+#define BL_IMAGE_INVALID              2u
+
+/* Returned by BL_uint8ImageGetState: flash reads only, no CRC */
+#define BL_IMAGE_STATE_EMPTY          0u             /* No header, vectors implausible (erased, half-written) */
+#define BL_IMAGE_STATE_NO_HEADER      1u             /* No header or Crc unstamped, started on its vectors */
+#define BL_IMAGE_STATE_UNCHECKED      2u             /* Header passes the cheap checks, CRC not verified yet */
+#define BL_IMAGE_STATE_VALIDATED      3u             /* Validated mark: started without a CRC */
+#define BL_IMAGE_STATE_REVOKED        4u             /* Mark revoked by a later change: full check on boot */
+#define BL_IMAGE_STATE_INVALID        5u             /* Header fails the cheap checks (range, vectors, rollback) */
+
+
+/*
+ * Bootloader Image Functions
+ * --------------------------
+ */
+
+uint8_t BL_uint8ImageCheck(void);                                        /* Boot-time check, marks a good image validated */
+
+uint8_t BL_uint8ImageRevoke(uint32_t Copy_uint32Address, uint32_t Copy_uint32Length); /* Drops the marks a change to the range voids, flash unlocked by the caller */
+
+uint8_t BL_uint8ImageMarkValidated(void);                                /* Programs the validated mark of a blank header */
+
+uint8_t BL_uint8ImageIsValidated(void);                                  /* Marked and plausible: no CRC, no peripheral needed */
+
+uint8_t BL_uint8ImageGetActiveSlot(void);                                /* Slot the bootloader starts */
+
+uint8_t BL_uint8ImageGetUpdateSlot(void);                                /* Slot updates are written to */
+
+uint32_t BL_uint32ImageGetSlotBase(uint8_t Copy_uint8Slot);              /* Vector table address of a slot */
+
+uint32_t BL_uint32ImageGetSlotEnd(uint8_t Copy_uint8Slot);               /* First address after a slot */
+
+uint8_t BL_uint8ImageActivate(uint8_t Copy_uint8Slot);                   /* Pointer flip to a checked slot */
+
+uint8_t BL_uint8ImageSlotIsPlausible(uint8_t Copy_uint8Slot);            /* Header and vectors only, flash reads */
+
+uint8_t BL_uint8ImageGetState(uint8_t Copy_uint8Slot);                   /* BL_IMAGE_STATE_xxx of a slot, flash reads */
+
+uint8_t BL_uint8ImageRollbackPending(void);                             /* Active image above the OTP counter (BL_ROLLBACK_ENABLE, else 0) */
+
+uint8_t BL_uint8ImageRaiseRollback(void);                               /* BL_ROLLBACK_ENABLE: OTP counter up to the active image's version */
+
+
+#endif /* INC_BL_IMAGE_H_ */
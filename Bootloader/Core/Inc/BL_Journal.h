@@ -0,0 +1,88 @@
+#ifndef INC_BL_JOURNAL_H_
+#define INC_BL_JOURNAL_H_
+
+#include <stdint.h>
+
+/*
+ * Session Journal (BL_JOURNAL_ENABLE)
+ * -----------------------------------
+ * Flash sector 11 (128 KB) is an append-only log of the resumable programming
+ * session, so its state survives what backup SRAM does not (power loss
+ * without VBAT). The staging slot shrinks to sector 10.
+ *
+ * Entry: [BL_JournalEntry_t] [Words payload words] [check word]
+ *  - the header word is programmed first, in one 32-bit write, so the length
+ *    is never torn and a reader can always step over an entry,
+ *  - the check word (~XOR of header and payload) is programmed last: an entry
+ *    cut by a reset does not verify and is ignored.
+ * Appends need the flash unlocked (the session keeps it so). An erased
+ * header word ends the log.
+ *
+ * Types:
+ *  - OPEN     [base (4)] [size (4)]  : BL_BEGIN_PROGRAM of a target range (intent),
+ *  - ERASED   [sector bitmap (4)]    : after a synchronous erase in the session,
+ *  - PROGRESS [session record]       : resume point, each BL_JOURNAL_PROGRESS_STEP
+ *                                      bytes of the written prefix,
+ *  - DIRTY                           : a write outside the prefix, no resume point,
+ *  - CLOSED                          : BL_END_PROGRAM,
+ *  - WEAR     [erase count per sector (12 x 4)] : totals (BL_WEAR_STATS_ENABLE).
+ * Only the entries from the newest OPEN on describe the current session;
+ * the newest WEAR is valid across sessions.
+ * An OPEN finding less than BL_JOURNAL_RESERVE free erases the sector first
+ * (the only erase, one per ~BL_JOURNAL_SIZE / BL_JOURNAL_RESERVE sessions),
+ * and writes the WEAR totals again right after it.
+ */
+
+/*
+ * Wear Statistics (BL_WEAR_STATS_ENABLE)
+ * --------------------------------------
+ * BL_Flash.c counts the erases it starts in RAM; BL_uint8JournalFlushWear()
+ * adds them to the newest WEAR totals in one new entry. The bootloader calls
+ * it when the flash goes idle (no session, no background erase) and before it
+ * jumps, so a whole session costs one entry. Erases done by the application
+ * through the services table (BL_Services.h) are not counted.
+ */
+
+#define BL_JOURNAL_SECTOR             11u
+#define BL_JOURNAL_BASE_ADDRESS       0x080E0000UL   /* Flash sector 11 */
+#define BL_JOURNAL_SIZE               0x20000UL
+
+#define BL_JOURNAL_RESERVE            0x8000UL       /* Free space an OPEN needs, else the sector is erased */
+#define BL_JOURNAL_PROGRESS_STEP      4096u          /* Prefix bytes between two PROGRESS entries */
+
+#define BL_JOURNAL_ENTRY_MAGIC        0x4A4Cu        /* "LJ" */
+
+#define BL_JOURNAL_OPEN               1u
+#define BL_JOURNAL_ERASED             2u
+#define BL_JOURNAL_PROGRESS           3u
+#define BL_JOURNAL_DIRTY              4u
+#define BL_JOURNAL_CLOSED             5u
+#define BL_JOURNAL_WEAR               6u
+
+typedef struct
+{
+	uint16_t Magic;                             /* BL_JOURNAL_ENTRY_MAGIC */
+	uint8_t  Type;                              /* BL_JOURNAL_xxx */
+	uint8_t  Words;                             /* Payload words that follow */
+} BL_JournalEntry_t;
+
+
+/*
+ * Bootloader Journal Functions
+ * ----------------------------
+ */
+
+uint8_t BL_uint8JournalAppend(uint8_t Copy_uint8Type, const void* Copy_pData, uint16_t Copy_uint16Length); /* One entry, length a multiple of 4 */
+
+uint8_t BL_uint8JournalOpen(uint32_t Copy_uint32Base, uint32_t Copy_uint32Size); /* OPEN entry, erases a nearly full sector first */
+
+const uint32_t* BL_puint32JournalFind(uint8_t Copy_uint8Type, uint8_t* Copy_puint8Words); /* Newest valid entry of the current session, NULL if none */
+
+uint8_t BL_uint8JournalIsOpen(void);                                     /* 1 if the newest session was never CLOSED */
+
+uint8_t BL_uint8JournalFlushWear(void);                                  /* BL_WEAR_STATS_ENABLE: new WEAR entry if erases are pending */
+
+void    BL_voidJournalGetWear(uint32_t* Copy_puint32Counts);             /* BL_WEAR_STATS_ENABLE: 12 erase totals, pending included */
+
+
+#endif /* INC_BL_JOURNAL_H_ */
@@ -0,0 +1,100 @@
+#ifndef INC_BL_KV_H_
+#define INC_BL_KV_H_
+
+#include <stdint.h>
+
+/*
+ * Key/Value Configuration Store (BL_KV_ENABLE)
+ * --------------------------------------------
+ * Small settings (calibration, node address, serial numbers, counters) kept
+ * in an append-only log in flash sectors 8 and 9, one of them active. The
+ * single application slot ends at sector 7 (BL_KV_BASE_ADDRESS).
+ *
+ * Sector: [BL_KVSector_t] [records ...] [erased]
+ * Record: [header: Key (16) | Length (16)] [data, padded to words with 0xFF] [check word]
+ *  - the header word is programmed first, so a reader can always step over
+ *    a record, the check word (~XOR of header and data words) last: a record
+ *    cut by a reset does not verify and is skipped,
+ *  - a Length of 0 is a deletion (tombstone),
+ *  - an erased header word ends the log.
+ *
+ * Index: a BL_KV_INDEX_SLOTS open-addressing hash in the caller's BL_KV_t
+ * maps each key to its newest record. BL_voidKVInit builds it with one scan
+ * of the active sector; a get is then one probe sequence and one flash read,
+ * a set appends one record (nothing when the value is unchanged).
+ *
+ * Compaction: a record that does not fit any more copies the newest record of
+ * every live key into the other sector (erased first), then programs that
+ * sector's header with Sequence + 1, Magic last. A reset before that leaves
+ * the old sector in charge; after it, the valid header with the higher
+ * Sequence wins. The old sector is erased by the next compaction, so each one
+ * costs one erase and the set that triggers it stalls for it (up to 2 s).
+ *
+ * All state is in the BL_KV_t, flash is written through the services table
+ * (BL_Services.h): the application calls the same functions through
+ * KvInit / KvGet / KvSet / KvDelete with its own context. The writes unlock
+ * and lock the flash, so the bootloader does not call them while a
+ * programming session is open.
+ *
+ * Keys below BL_KV_KEY_APP_FIRST belong to the bootloader; 0xFFFF is not
+ * a key.
+ */
+
+#define BL_KV_SECTOR_A                8u
+#define BL_KV_SECTOR_B                9u
+#define BL_KV_BASE_ADDRESS            0x08080000UL   /* Flash sector 8 */
+#define BL_KV_SECTOR_SIZE             0x20000UL
+
+#define BL_KV_MAGIC                   0x564B4C42UL   /* "BLKV" */
+
+#define BL_KV_INDEX_SLOTS             128u           /* Power of two */
+#define BL_KV_MAX_KEYS                96u            /* 3/4 of the slots, so probes stay short */
+#define BL_KV_MAX_LENGTH              256u           /* Value bytes */
+
+#define BL_KV_KEY_APP_FIRST           0x0100u
+#define BL_KV_KEY_NONE                0xFFFFu
+
+#define BL_KV_NOT_FOUND               0xFFFFu        /* BL_uint16KVGet: no such key */
+
+typedef struct
+{
+	uint32_t Magic;                             /* BL_KV_MAGIC, programmed last */
+	uint32_t Sequence;                          /* Compactions so far */
+	uint32_t SequenceInv;                       /* ~Sequence */
+	uint32_t Reserved;                          /* Left erased */
+} BL_KVSector_t;
+
+typedef struct
+{
+	uint16_t Key;                               /* BL_KV_KEY_NONE: free slot */
+	uint16_t Word;                              /* Record header, in words from the sector base */
+} BL_KVSlot_t;
+
+typedef struct
+{
+	uint32_t    Base;                           /* Active sector, 0: none formatted yet */
+	uint32_t    End;                            /* Append address */
+	uint32_t    Sequence;
+	uint16_t    Keys;                           /* Slots in use, deleted keys included until a compaction */
+	uint16_t    Reserved;
+	BL_KVSlot_t Index[BL_KV_INDEX_SLOTS];
+} BL_KV_t;
+
+
+/*
+ * Bootloader Key/Value Functions
+ * ------------------------------
+ */
+
+void     BL_voidKVInit(BL_KV_t* Copy_pKV);                               /* Picks the active sector and builds the index, reads only */
+
+uint16_t BL_uint16KVGet(const BL_KV_t* Copy_pKV, uint16_t Copy_uint16Key, void* Copy_pData, uint16_t Copy_uint16Size); /* Value length, BL_KV_NOT_FOUND */
+
+uint8_t  BL_uint8KVSet(BL_KV_t* Copy_pKV, uint16_t Copy_uint16Key, const void* Copy_pData, uint16_t Copy_uint16Length); /* 1 .. BL_KV_MAX_LENGTH bytes */
+
+uint8_t  BL_uint8KVDelete(BL_KV_t* Copy_pKV, uint16_t Copy_uint16Key);   /* Tombstone record, HAL_OK for a missing key too */
+
+uint32_t BL_uint32KVGetFree(const BL_KV_t* Copy_pKV);                    /* Bytes left before the next compaction */
+
+
+#endif /* INC_BL_KV_H_ */
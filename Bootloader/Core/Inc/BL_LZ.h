@@ -0,0 +1,60 @@
+#ifndef INC_BL_LZ_H_
+#define INC_BL_LZ_H_
+
+#include <stdint.h>
+
+/*
+ * Streaming LZ Decoder
+ * --------------------
+ * Decodes the LZ4 sequence format (the contents of an LZ4 block, without the
+ * frame header) incrementally: the input may be cut anywhere, in the middle of
+ * a length, an offset or a literal run, and the state carries over to the next
+ * call. BL_MEM_WRITE_LZ feeds it one frame payload at a time.
+ *
+ * Sequence: [token] [literal length extension] [literals]
+ *           [offset (2, LE)] [match length extension]
+ *  - token high nibble: literal count, 15 = followed by extension bytes,
+ *  - token low nibble : match length - BL_LZ_MIN_MATCH, 15 = idem,
+ *  - an extension is a run of bytes added to the count, ended by one < 255.
+ * The last sequence of a stream stops after its literals.
+ *
+ * The decoder only remembers the last BL_LZ_WINDOW_SIZE bytes, held in a
+ * ring inside the context (4 KB of static RAM): the host compresses with the
+ * same limit on match offsets (lz4 -B4 or any encoder with a 4 KB window).
+ * Decoded bytes are returned in place, as contiguous pieces of the ring, and
+ * stay valid until the decoder runs again: no intermediate output buffer.
+ */
+
+#define BL_LZ_WINDOW_SIZE            4096u     /* Power of two, largest match offset */
+#define BL_LZ_MIN_MATCH              4u
+
+/* Returned by BL_uint8LZDecode */
+#define BL_LZ_OK                     0u
+#define BL_LZ_CORRUPT                1u        /* Offset 0, beyond the window or before the first byte */
+
+typedef struct
+{
+	uint8_t  Window[BL_LZ_WINDOW_SIZE];         /* Last decoded bytes (ring) */
+	uint32_t Produced;                          /* Bytes decoded since BL_voidLZStart */
+	uint32_t Count;                             /* Literals / match bytes left in the current run */
+	uint16_t Position;                          /* Next Window index written */
+	uint16_t Offset;                            /* Distance of the current match */
+	uint8_t  Token;                             /* Token of the current sequence */
+	uint8_t  State;                             /* Field expected next */
+} BL_LZ_t;
+
+
+/*
+ * Bootloader LZ Functions
+ * -----------------------
+ */
+
+void    BL_voidLZStart(BL_LZ_t* Copy_pContext);                          /* New stream, empty window */
+
+uint8_t BL_uint8LZDecode(BL_LZ_t* Copy_pContext, const uint8_t** Copy_ppuint8Input, uint16_t* Copy_puint16InputLength,
+                         uint8_t** Copy_ppuint8Output, uint16_t* Copy_puint16OutputLength); /* Next contiguous piece of output */
+
+uint8_t BL_uint8LZIsComplete(const BL_LZ_t* Copy_pContext);              /* 1 if the stream may end here */
+
+
+#endif /* INC_BL_LZ_H_ */
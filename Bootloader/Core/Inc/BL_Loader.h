@@ -0,0 +1,73 @@
+#ifndef INC_BL_LOADER_H_
+#define INC_BL_LOADER_H_
+
+#include <stdint.h>
+
+/*
+ * Second-Stage Loader ABI
+ * -----------------------
+ * The resident bootloader stays small and rarely changes; faster transports,
+ * new codecs or protocol extensions can ship as a second-stage loader that
+ * runs from SRAM instead, in the spirit of the external flash loaders of
+ * debug probes. Nothing in the bootloader sectors is reflashed for it.
+ *
+ * Image: linked for the RAM run area (BL_RAM_RUN_BASE, BL_RAM_RUN_SIZE in
+ * BL.h; the bootloader's own RAM and stack live below it), starting with a
+ * vector table (initial MSP, reset handler) and a BL_LoaderHeader_t at
+ * BL_LOADER_HEADER_OFFSET, like the application's BL_ImageHeader_t.
+ *
+ * Sequence (host):
+ *  1. Upload the loader to BL_RAM_RUN_BASE with BL_MEM_WRITE_STREAM (SRAM
+ *     targets are plain copies: no erase, no flash wear) and check it with
+ *     BL_VERIFY_RANGE.
+ *  2. BL_GO_TO_ADDR [table address (4)] [BL_GO_FLAG_LOADER]. The bootloader
+ *     checks the table and the header (Magic, AbiVersion, Length inside the
+ *     area) and that the command came over USART2, replies VALID_ADDRESS and
+ *     hands over; NOT_VALID_ADDRESS otherwise, and it stays in control.
+ *  3. Talk to the loader, on the same line at the same baud rate, with
+ *     whatever protocol it implements.
+ *
+ * Handover (Bootloader_JumpToLoader), unlike BL_RAM_RUN which starts an
+ * image from a reset-like state:
+ *  - the clock tree, the GPIO configuration and USART2 (enabled, at
+ *    BaudRate) are kept, its DMA streams are stopped: the loader owns the
+ *    line at once, without re-initialising anything;
+ *  - interrupts: SysTick stopped, every NVIC line disabled and cleared,
+ *    PRIMASK clear; VTOR on the loader's table, MSP from its first word;
+ *  - the header fields below "filled in by the bootloader" are written,
+ *    then the reset handler is called with R0 = the header address:
+ *        void Reset_Handler(BL_LoaderHeader_t* Header);
+ *  - the boot handoff block (BL_Handoff.h) carries BL_HANDOFF_PATH_LOADER.
+ * The loader may call the bootloader services table (BL_Services.h) for CRC,
+ * SHA-256 and flash programming. It never returns; NVIC_SystemReset goes
+ * back to the bootloader (which, without a valid application, or with an
+ * update request, stays in update mode).
+ *
+ * Versioning: fields are only ever appended. A loader built for an older
+ * AbiVersion is accepted; one newer than BL_LOADER_ABI_VERSION is refused.
+ */
+
+#define BL_LOADER_HEADER_OFFSET       0x200u         /* After the 98-entry vector table */
+
+#define BL_LOADER_MAGIC               0x324C4C42UL   /* "BLL2" */
+#define BL_LOADER_ABI_VERSION         1u
+
+typedef struct
+{
+	/* Linked into the loader */
+	uint32_t Magic;                             /* BL_LOADER_MAGIC */
+	uint32_t AbiVersion;                        /* BL_LOADER_ABI_VERSION the loader was built for */
+	uint32_t Length;                            /* Bytes from the vector table on, inside the RAM run area */
+
+	/* Filled in by the bootloader before the jump */
+	uint32_t BootloaderVersion;                 /* BL_VERSION */
+	uint32_t Link;                              /* BL_LINK_UART, the line the loader takes over */
+	uint32_t BaudRate;                          /* USART2 rate in effect */
+	uint32_t SysClock;                          /* SystemCoreClock (Hz) */
+	uint32_t Services;                          /* BL_SERVICES_ADDRESS (BL_Services.h) */
+} BL_LoaderHeader_t;
+
+#define BL_LOADER_HEADER(Base)        ((volatile BL_LoaderHeader_t*)((Base) + BL_LOADER_HEADER_OFFSET))
+
+
+#endif /* INC_BL_LOADER_H_ */
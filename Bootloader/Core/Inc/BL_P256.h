@@ -0,0 +1,47 @@
+#ifndef INC_BL_P256_H_
+#define INC_BL_P256_H_
+
+#include <stdint.h>
+
+/*
+ * ECDSA P-256 Signature Verification
+ * ----------------------------------
+ * Verifies an ECDSA signature (NIST P-256, FIPS 186-4) over a SHA-256 digest,
+ * so a signed update is checked with the digest the incremental SHA-256 engine
+ * (BL_SHA256.h) already computed while the image was written: the image is
+ * hashed once, during the transfer, never again at boot.
+ * ECDSA-P256 rather than Ed25519: Ed25519 hashes the message with SHA-512
+ * together with the signature, which would need a second engine and a second
+ * pass over the image.
+ *
+ * Only public data is handled, so the code is not constant time:
+ *  - field elements are 8 little-endian 32-bit words,
+ *  - multiplication mod p uses the FIPS 186-4 fast reduction (built at -O2),
+ *  - u1.G + u2.Q is computed in one pass (Shamir's trick) in Jacobian
+ *    coordinates with mixed additions, inversions use the binary algorithm.
+ * About 4500 field multiplications per signature: well below 100 ms at 168 MHz.
+ *
+ * Byte formats (big endian, as produced by OpenSSL or Python cryptography):
+ *  - public key : X (32) || Y (32), the uncompressed point without the 0x04 prefix,
+ *  - signature  : r (32) || s (32),
+ *  - digest     : SHA-256 output (32).
+ */
+
+#define BL_P256_KEY_SIZE             64u
+#define BL_P256_SIGNATURE_SIZE       64u
+
+/* Returned by BL_uint8P256Verify */
+#define BL_P256_SIGNATURE_VALID      1u
+#define BL_P256_SIGNATURE_INVALID    0u
+
+
+/*
+ * Bootloader P-256 Functions
+ * --------------------------
+ */
+
+uint8_t BL_uint8P256Verify(const uint8_t* Copy_puint8PublicKey, const uint8_t* Copy_puint8Digest,
+                           const uint8_t* Copy_puint8Signature);        /* BL_P256_SIGNATURE_VALID / _INVALID */
+
+
+#endif /* INC_BL_P256_H_ */
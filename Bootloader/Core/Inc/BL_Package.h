@@ -0,0 +1,147 @@
+#ifndef INC_BL_PACKAGE_H_
+#define INC_BL_PACKAGE_H_
+
+#include <stdint.h>
+#include "BL_CRC.h"
+#include "BL_LZ.h"
+#include "BL_SHA256.h"
+#include "BL_P256.h"
+
+/*
+ * Update Package
+ * --------------
+ * One pre-planned file per update, built once by the host (blflash package)
+ * and fed unchanged to every path that takes it: BL_MEM_WRITE_PACKAGE over
+ * UART, USB CDC, CAN or SPI, and the staging slot filled by the running
+ * application (BL_STAGING_CODEC_PACKAGE). Everything the device must decide
+ * is in the manifest at the front, checked before the first sector is
+ * erased; the payload then only has to be consumed in order.
+ *
+ * Layout (all fields little endian):
+ *     [header (56)] [segment table (16 x SegmentCount)]
+ *     [block CRCs (4 x block count)] [manifest CRC (4)]
+ *     [signature (64), BL_PACKAGE_FLAG_SIGNED only] [payload]
+ *  - the payload is the stored bytes of every segment, in table order,
+ *  - segment n is written from its Address, Length bytes once decoded:
+ *    its StoredLength bytes as they are (BL_PACKAGE_CODEC_RAW) or one LZ4
+ *    sequence stream of BL_LZ.h, 4 KB window (BL_PACKAGE_CODEC_LZ),
+ *  - the erase plan is a bitmap of the flash sectors erased before the
+ *    payload; every sector a segment touches is in it,
+ *  - block n covers payload bytes [n x BlockSize, (n + 1) x BlockSize),
+ *    its CRC word-wise (BL_CRC.h); a block is checked before any of it is
+ *    decoded, so a corrupt block never reaches the flash,
+ *  - the manifest is everything before the manifest CRC, which is its
+ *    word-wise CRC; the signature is ECDSA-P256 (BL_P256.h) over its
+ *    SHA-256, and the manifest holds the SHA-256 of the payload, checked
+ *    at the end: one signature covers the whole package.
+ *
+ * Manifest Checks
+ * ---------------
+ * Magic and version, 1 .. BL_PACKAGE_MAX_SEGMENTS segments, BlockSize a
+ * power of two from BL_PACKAGE_MIN_BLOCK_SIZE to BL_PACKAGE_MAX_BLOCK_SIZE,
+ * at most BL_PACKAGE_MAX_BLOCKS blocks, stored lengths adding up to the
+ * payload, segments in ascending order without overlap inside the
+ * application flash (from BL_IMAGE_BASE_ADDRESS), covered by the erase plan,
+ * and no bootloader sector in the plan. With a key the signature must be
+ * present and valid. The caller adds its own limits (the staging slot
+ * keeps its own sectors out of the plan).
+ *
+ * Decoder
+ * -------
+ * BL_uint8PackageDecode takes the package in pieces of any size and returns
+ * events, like BL_LZ.h returns output: call it until it returns
+ * BL_PACKAGE_MORE, which means the whole input was used. The context holds
+ * the manifest and one block (about 4.5 KB with the limits below); the LZ
+ * codec runs on a decoder context lent by the caller, restarted per segment.
+ */
+
+#define BL_PACKAGE_MAGIC              0x4B504C42UL   /* "BLPK" */
+#define BL_PACKAGE_VERSION            1u
+
+#define BL_PACKAGE_FLAG_SIGNED        0x01u          /* A signature follows the manifest CRC */
+
+#define BL_PACKAGE_CODEC_RAW          0u
+#define BL_PACKAGE_CODEC_LZ           1u
+
+#define BL_PACKAGE_MAX_SEGMENTS       16u
+#define BL_PACKAGE_MIN_BLOCK_SIZE     256u
+#define BL_PACKAGE_MAX_BLOCK_SIZE     2048u
+#define BL_PACKAGE_MAX_BLOCKS         512u           /* 1 MB of payload at the largest block size */
+
+typedef struct
+{
+	uint32_t Magic;                             /* BL_PACKAGE_MAGIC */
+	uint16_t Version;                           /* BL_PACKAGE_VERSION */
+	uint8_t  SegmentCount;
+	uint8_t  Flags;                             /* BL_PACKAGE_FLAG_xxx */
+	uint32_t BlockSize;                         /* Payload bytes per block CRC */
+	uint32_t PayloadLength;
+	uint32_t EraseSectors;                      /* Bit n: sector n erased before the payload */
+	uint32_t Reserved;                          /* 0 */
+	uint8_t  PayloadSha[BL_SHA256_DIGEST_SIZE]; /* SHA-256 of the payload */
+} BL_PackageHeader_t;
+
+typedef struct
+{
+	uint32_t Address;                           /* First byte written */
+	uint32_t Length;                            /* Bytes written */
+	uint32_t StoredLength;                      /* Payload bytes of the segment */
+	uint8_t  Codec;                             /* BL_PACKAGE_CODEC_xxx */
+	uint8_t  Reserved[3];                       /* 0 */
+} BL_PackageSegment_t;
+
+#define BL_PACKAGE_HEADER_SIZE        56u
+#define BL_PACKAGE_SEGMENT_SIZE       16u
+
+/* Returned by BL_uint8PackageDecode: events, then errors (the context must be restarted) */
+#define BL_PACKAGE_MORE               0x00u          /* Input used up, nothing to report */
+#define BL_PACKAGE_MANIFEST           0x01u          /* Manifest valid: erase the plan before the next call */
+#define BL_PACKAGE_WRITE              0x02u          /* Program the output at the address */
+#define BL_PACKAGE_COMPLETE           0x03u          /* Every segment written, payload digest matches */
+#define BL_PACKAGE_BAD_HEADER         0x10u          /* Magic, version or a limit */
+#define BL_PACKAGE_BAD_MANIFEST       0x11u          /* Manifest CRC */
+#define BL_PACKAGE_BAD_SIGNATURE      0x12u          /* Unsigned while a key is set, or not verified */
+#define BL_PACKAGE_BAD_PLAN           0x13u          /* Segments or erase plan outside the rules */
+#define BL_PACKAGE_BAD_BLOCK          0x14u          /* Block CRC */
+#define BL_PACKAGE_CORRUPT            0x15u          /* LZ stream, segment length, or bytes after the payload */
+#define BL_PACKAGE_BAD_DIGEST         0x16u          /* Payload SHA-256 */
+
+typedef struct
+{
+	BL_PackageHeader_t  Header;
+	BL_PackageSegment_t Segments[BL_PACKAGE_MAX_SEGMENTS];
+	uint32_t       BlockCrc[BL_PACKAGE_MAX_BLOCKS];
+	uint8_t        Trailer[4u + BL_P256_SIGNATURE_SIZE]; /* Manifest CRC, signature */
+	uint8_t        Block[BL_PACKAGE_MAX_BLOCK_SIZE];     /* Block being gathered, then decoded */
+	BL_SHA256_t    Sha;                        /* Manifest digest, then payload digest */
+	BL_CRCStream_t Crc;                        /* Manifest CRC */
+	BL_LZ_t*       Lz;                         /* Lent by the caller */
+	const uint8_t* Key;                        /* Signer's public key, NULL: signature not checked */
+	uint32_t       Gathered;                   /* Bytes of the current manifest part / block */
+	uint32_t       Received;                   /* Payload bytes checked so far */
+	uint32_t       Address;                    /* Next byte written */
+	uint32_t       StoredLeft;                 /* Payload bytes left in the current segment */
+	uint32_t       OutputLeft;                 /* Bytes left to write in the current segment */
+	uint16_t       BlockIndex;                 /* Next block CRC */
+	uint16_t       BlockLength;                /* Checked bytes in Block */
+	uint16_t       BlockRead;                  /* Of which decoded */
+	uint8_t        Segment;                    /* Current segment */
+	uint8_t        Verified;                   /* 1 once the signature checked out with the key */
+	uint8_t        State;
+} BL_Package_t;
+
+
+/*
+ * Bootloader Package Functions
+ * ----------------------------
+ */
+
+void    BL_voidPackageStart(BL_Package_t* Copy_pContext, BL_LZ_t* Copy_pDecoder, const uint8_t* Copy_puint8Key); /* New package */
+
+uint8_t BL_uint8PackageDecode(BL_Package_t* Copy_pContext, const uint8_t** Copy_ppuint8Input, uint16_t* Copy_puint16InputLength,
+                              uint32_t* Copy_puint32Address, uint8_t** Copy_ppuint8Output, uint16_t* Copy_puint16OutputLength); /* Next event */
+
+uint8_t BL_uint8PackageIsComplete(const BL_Package_t* Copy_pContext);    /* 1 once BL_PACKAGE_COMPLETE was returned */
+
+
+#endif /* INC_BL_PACKAGE_H_ */
@@ -0,0 +1,139 @@
+#ifndef INC_BL_PORT_H_
+#define INC_BL_PORT_H_
+
+/*
+ * Port Layer
+ * ----------
+ * What the bootloader core (frame parser, dispatcher, write pipeline: BL.c,
+ * BL_Transport.c and the image / journal / staging / LZ / crypto modules)
+ * needs from the chip, so it can also be built for the host against a
+ * simulated one (Host/sim):
+ *  - BL_Flash.h, BL_CRC.h and BL_UART.h: the only modules that drive the
+ *    flash interface, the CRC unit, USART2 and their DMA streams at
+ *    register level,
+ *  - the HAL: GPIO, HAL_GetTick, flash lock and option bytes, RCC
+ *    frequencies, huart2.Init.BaudRate,
+ *  - BL_voidSessionTick from SysTick, BL_voidFlashIRQHandler from the FLASH
+ *    interrupt and the BL_voidTransportUartXxx calls of BL_UART.c,
+ *  - the waits below, where the core spins until an interrupt changes a flag,
+ *  - the interrupt mask around the few sections shared with interrupt context,
+ *    and the priorities it masks by,
+ *  - the IWDG refresh of the command loop and the long flash operations,
+ *  - Memory_GetUsage of sysmem.c (MemoryUsage.h), which reads the stack the
+ *    startup painted.
+ * Everything else the core reads or writes at a fixed address (flash, SRAM,
+ * OTP, UID, backup SRAM, DWT) is plain memory to it.
+ *
+ * The host build defines BL_PORT_HOST and provides BL_PortHost.h, which
+ * delivers the simulated interrupts in BL_PORT_WAIT_EVENT.
+ */
+
+#ifdef BL_PORT_HOST
+#include "BL_PortHost.h"
+#endif
+
+/*
+ * BL_PORT_WAIT_EVENT
+ * ------------------
+ * Body of every busy wait on an interrupt flag (idle parser, single-byte read,
+ * TX flush). On the target nothing: the interrupt ends the wait.
+ */
+#ifndef BL_PORT_WAIT_EVENT
+#define BL_PORT_WAIT_EVENT()
+#endif
+
+/*
+ * Interrupt Priorities
+ * --------------------
+ * NVIC_PRIORITYGROUP_4: four bits of preemption priority, no sub-priority, a
+ * lower number preempts a higher one. Ranked by what a late handler costs,
+ * all set once in HAL_MspInit (stm32f4xx_hal_msp.c):
+ *  - BL_IRQ_PRIORITY_LINK_RX : USART2 and its RX DMA, USB OTG FS, SPI1 NSS,
+ *                              CAN1 FIFOs. Late, bytes are lost (overrun,
+ *                              full FIFO),
+ *  - BL_IRQ_PRIORITY_LINK_TX : USART2 TX DMA, CAN1 mailboxes. Late, a
+ *                              response leaves a little later,
+ *  - BL_IRQ_PRIORITY_FLASH   : end of a background erase,
+ *  - BL_IRQ_PRIORITY_TICK    : SysTick (HAL tick, session timer), last.
+ *                              TICK_INT_PRIORITY in stm32f4xx_hal_conf.h.
+ * Handlers of one level never preempt each other. Level 0 is left free: no
+ * bootloader section ever masks it.
+ */
+#define BL_IRQ_PRIORITY_LINK_RX       1u
+#define BL_IRQ_PRIORITY_LINK_TX       2u
+#define BL_IRQ_PRIORITY_FLASH         3u
+#define BL_IRQ_PRIORITY_TICK          4u
+
+/*
+ * BL_PORT_IRQ_SAVE / BL_PORT_IRQ_RESTORE
+ * --------------------------------------
+ * Masks every bootloader interrupt (BASEPRI at BL_IRQ_PRIORITY_LINK_RX,
+ * raised only: BASEPRI_MAX) and returns the previous BASEPRI / puts it back,
+ * so a section nests in interrupt handlers and other masked sections.
+ * PRIMASK stays clear: faults, NMI and a level-0 handler still run.
+ * BL_PORT_IRQ_MASK(PRIORITY) masks only the levels from PRIORITY down, for
+ * a section shared with slower handlers alone; reception keeps running.
+ *
+ * The outermost section is timed with the DWT cycle counter: the longest
+ * one (what a handler may have waited at worst) and the number of sections
+ * since reset, in BL_PortMaskStats (stm32f4xx_hal_msp.c, BL_GET_STATS).
+ */
+typedef struct
+{
+	uint32_t MaxCycles;                         /* Longest outermost masked section */
+	uint32_t Sections;                          /* Outermost masked sections */
+	uint32_t Start;                             /* CYCCNT when the current one began */
+} BL_PortMaskStats_t;
+
+extern BL_PortMaskStats_t BL_PortMaskStats;
+
+#ifndef BL_PORT_IRQ_SAVE
+#define BL_PORT_IRQ_MASK(PRIORITY)    uint32_PortIrqMask(PRIORITY)
+#define BL_PORT_IRQ_SAVE()            uint32_PortIrqMask(BL_IRQ_PRIORITY_LINK_RX)
+#define BL_PORT_IRQ_RESTORE(STATE)    voidPortIrqRestore(STATE)
+
+__attribute__((always_inline)) static inline uint32_t uint32_PortIrqMask(uint32_t Copy_uint32Priority)
+{
+	uint32_t Local_uint32Basepri = __get_BASEPRI();
+
+	__set_BASEPRI_MAX(Copy_uint32Priority << (8u - __NVIC_PRIO_BITS));
+	if(Local_uint32Basepri == 0u)
+	{
+		BL_PortMaskStats.Start = DWT->CYCCNT;
+	}
+
+	return Local_uint32Basepri;
+}
+
+__attribute__((always_inline)) static inline void voidPortIrqRestore(uint32_t Copy_uint32Basepri)
+{
+	uint32_t Local_uint32Cycles;
+
+	if(Copy_uint32Basepri == 0u)
+	{
+		Local_uint32Cycles = DWT->CYCCNT - BL_PortMaskStats.Start;
+		if(Local_uint32Cycles > BL_PortMaskStats.MaxCycles)
+		{
+			BL_PortMaskStats.MaxCycles = Local_uint32Cycles;
+		}
+		BL_PortMaskStats.Sections++;
+	}
+
+	__set_BASEPRI(Copy_uint32Basepri);
+}
+#endif
+
+/*
+ * BL_PORT_WATCHDOG_REFRESH
+ * ------------------------
+ * Reloads the IWDG: one register write, ignored while the IWDG is stopped.
+ * Only ever called between bounded steps (a wait for the next event, one
+ * program call, one sector erase), so a loop that stops making progress
+ * still runs into the timeout.
+ */
+#ifndef BL_PORT_WATCHDOG_REFRESH
+#define BL_PORT_WATCHDOG_REFRESH()    (IWDG->KR = 0xAAAAu)
+#endif
+
+
+#endif /* INC_BL_PORT_H_ */
@@ -0,0 +1,39 @@
+#ifndef INC_BL_ROLLBACK_H_
+#define INC_BL_ROLLBACK_H_
+
+#include <stdint.h>
+
+/*
+ * Anti-Rollback Counter
+ * ---------------------
+ * A monotonic security counter kept in the OTP area: BL_ROLLBACK_OTP_BLOCKS
+ * blocks of 32 bytes from BL_ROLLBACK_OTP_BLOCK (BL_config.h), the last two
+ * by default, 512 steps. Its value is the number of programmed (0) bits:
+ * OTP bits only ever go from 1 to 0, so no glitch, power loss or erase can
+ * lower it, and raising it needs no sector erase.
+ *
+ * Read: one pass of word reads the first time it is asked, then cached;
+ * the boot check compares the header's SecurityVersion with the cached
+ * value (uint8_CheckHeader in BL_Image.c), a single compare per boot.
+ * Raise: the lowest bits still set are programmed, word by word from the
+ * first block on. A word is programmed again to clear more of its bits,
+ * which the F4 flash interface allows (AN3969 does the same with its page
+ * headers). The lock bytes of these blocks must stay 0xFF: a locked block
+ * takes no more steps.
+ */
+
+#define BL_ROLLBACK_OTP_WORDS         (BL_ROLLBACK_OTP_BLOCKS * 8u)
+#define BL_ROLLBACK_MAX               (BL_ROLLBACK_OTP_WORDS * 32u)   /* Highest value the blocks hold */
+
+
+/*
+ * Bootloader Rollback Functions
+ * -----------------------------
+ */
+
+uint32_t BL_uint32RollbackGetCounter(void);                              /* Security counter, read from OTP once */
+
+uint8_t  BL_uint8RollbackRaise(uint32_t Copy_uint32Value);               /* Counter up to the value (never down), HAL_OK / HAL_ERROR */
+
+
+#endif /* INC_BL_ROLLBACK_H_ */
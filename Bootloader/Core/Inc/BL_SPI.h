@@ -0,0 +1,64 @@
+#ifndef INC_BL_SPI_H_
+#define INC_BL_SPI_H_
+
+#include <stdint.h>
+
+/*
+ * SPI1 Slave Transport
+ * --------------------
+ * Lets a supervisor MCU drive the bootloader over SPI1 (mode 0, 8-bit, MSB first),
+ * with the same frames as USART2. Enabled with BL_TRANSPORT_SPI_ENABLE (BL_config.h).
+ *
+ * Pins:
+ *  - PA5 SCK, PA6 MISO, PA7 MOSI (AF5, set by MX_GPIO_Init)
+ *  - PA15 NSS input   : framing, falling edge selects, rising edge ends a transfer
+ *  - PB1  READY output: high when the bootloader can take a command or has a response
+ * The on-board LIS3DSH shares SPI1; its CS (PE3) is held high by MX_GPIO_Init.
+ *
+ * Transfer sequence seen by the master:
+ *  1. Wait for READY high, select (NSS low), clock out the command frame, deselect.
+ *  2. READY drops while the command runs (flash erase / program included).
+ *  3. READY high again: if the command answers, select and clock in the response
+ *     (ACK, length, payload) sending BL_SPI_FILLER, then deselect.
+ * The master must leave BL_SPI_NSS_SETUP_US between NSS falling and the first clock.
+ */
+
+#define BL_SPI_RX_RING_SIZE          8192u     /* Power of two, indexes are wrapped with a mask */
+
+#define BL_SPI_FILLER                0xFFu     /* Byte the master sends while reading a response */
+
+#define BL_SPI_NSS_SETUP_US          2u        /* Time for the NSS interrupt to enable the slave */
+
+#define BL_SPI_RESPONSE_TIMEOUT_MS   1000u     /* A response not read within this time is dropped */
+
+#define BL_SPI_NSS_PORT              GPIOA
+#define BL_SPI_NSS_PIN               GPIO_PIN_15
+#define BL_SPI_READY_PORT            GPIOB
+#define BL_SPI_READY_PIN             GPIO_PIN_1
+
+
+/*
+ * Bootloader SPI Functions
+ * ------------------------
+ */
+
+void     BL_voidSPIInit(void);                                           /* SPI1 slave, RX circular DMA, NSS interrupt */
+
+void     BL_voidSPIDeInit(void);                                         /* NSS interrupt, DMA and SPI1 clock off, READY low */
+
+uint16_t BL_uint16SPIAvailable(void);                                    /* Bytes waiting in the RX ring */
+
+uint8_t  BL_uint8SPIPeek(uint16_t Copy_uint16Offset);                    /* Byte at tail + offset, not consumed */
+
+void     BL_voidSPIConsume(uint16_t Copy_uint16Count);                   /* Releases bytes from the RX ring */
+
+void     BL_voidSPISetReady(void);                                       /* Raises READY: idle, waiting for a command */
+
+void     BL_voidSPITransmit(uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length); /* Arms the response, raises READY */
+
+void     BL_voidSPITxFlush(void);                                        /* Waits until the master read the response */
+
+void     BL_voidSPINssIRQHandler(void);                                  /* NSS edge, called from EXTI15_10_IRQHandler */
+
+
+#endif /* INC_BL_SPI_H_ */
@@ -0,0 +1,86 @@
+#ifndef INC_BL_SERVICES_H_
+#define INC_BL_SERVICES_H_
+
+#include <stdint.h>
+#include "BL_SHA256.h"
+#include "BL_KV.h"
+
+/*
+ * Bootloader Services Table
+ * -------------------------
+ * A BL_Services_t at the fixed address BL_SERVICES_ADDRESS (bootloader
+ * flash, right after its vector table) lets the application call the
+ * bootloader's CRC, flash programming, SHA-256 and image routines instead of
+ * linking its own copies.
+ *
+ * The entries run in the application's context, after the bootloader's RAM
+ * has been handed over: they use only peripheral registers, flash constants
+ * and the caller's memory (contexts, buffers, stack). That rules out the RAM
+ * functions and DMA-fed paths the bootloader itself uses, so:
+ *  - Crc is CPU-fed (same word-wise CRC as BL_CRC.h), the caller enables the
+ *    CRC clock and must not share the unit with an interrupt,
+ *  - the flash entries run from flash: the CPU stalls on code fetches while
+ *    a word is programmed or a sector erased (up to 2 s for 128 KB), so
+ *    interrupts wait too. They refuse the bootloader's sectors (0 and 1),
+ *  - Sha256xxx, ImageIsValidated and FlashSectorIsBlank are the bootloader's
+ *    own functions (the last one range-checked),
+ *  - InactiveSectors names the sectors the next update goes to while the
+ *    application runs elsewhere: the inactive A/B slot, or the swap scratch
+ *    area. The application may pre-erase them one sector at a time (one stall
+ *    per sector, between its own work); the bootloader blank-checks every
+ *    sector before erasing it, so the next update programs right away.
+ *  - ImageActivateUpdate is BL_SLOT_ACTIVATE of the A/B update slot for an
+ *    application that wrote the update there itself: plausible header and
+ *    vectors, stamped CRC computed by the CPU, then the Validated and
+ *    Activated words are programmed (and the trial begins with
+ *    BL_TRIAL_BOOT_ENABLE). The new image starts from the next reset. It
+ *    fails without BL_AB_SLOTS_ENABLE, and with BL_SIGNATURE_ENABLE, where only
+ *    a signed commit may make an image bootable.
+ *  - KvInit / KvGet / KvSet / KvDelete are the key/value store (BL_KV.h) on
+ *    a BL_KV_t of the caller's, initialised once with KvInit. Without
+ *    BL_KV_ENABLE KvInit leaves the store empty and the writes fail.
+ *
+ * Versioning: Magic identifies the table, entries are only ever appended and
+ * Version counts them in revisions. A caller checks Magic and
+ * Version >= the revision that added the entry it needs.
+ */
+
+#define BL_SERVICES_ADDRESS           0x08000200UL   /* Bootloader vectors (0x188 bytes) end below */
+
+#define BL_SERVICES_MAGIC             0x56534C42UL   /* "BLSV" */
+#define BL_SERVICES_VERSION           4u
+
+typedef struct
+{
+	uint32_t Magic;                             /* BL_SERVICES_MAGIC */
+	uint32_t Version;                           /* BL_SERVICES_VERSION */
+
+	/* Version 1 */
+	uint32_t (*Crc)(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length);                 /* Word-wise CRC (BL_CRC.h) */
+	uint8_t  (*FlashUnlock)(void);                                                                /* HAL_OK / HAL_ERROR */
+	void     (*FlashLock)(void);
+	uint8_t  (*FlashProgram)(uint32_t Copy_uint32Address, const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length); /* Word-aligned address and length */
+	uint8_t  (*FlashEraseSector)(uint8_t Copy_uint8Sector);                                     /* Sectors 2 .. 11 */
+	void     (*Sha256Start)(BL_SHA256_t* Copy_pContext);
+	void     (*Sha256Update)(BL_SHA256_t* Copy_pContext, const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length);
+	void     (*Sha256Finish)(const BL_SHA256_t* Copy_pContext, uint8_t* Copy_puint8Digest);
+	uint8_t  (*ImageIsValidated)(void);                                                           /* BL_uint8ImageIsValidated */
+
+	/* Version 2 */
+	uint8_t  (*InactiveSectors)(uint8_t* Copy_puint8First, uint8_t* Copy_puint8Count);           /* HAL_ERROR: no inactive area (one slot) */
+	uint8_t  (*FlashSectorIsBlank)(uint8_t Copy_uint8Sector);                                   /* BL_FLASH_SECTOR_BLANK / _NOT_BLANK */
+
+	/* Version 3 */
+	uint8_t  (*ImageActivateUpdate)(void);                                                        /* HAL_OK: the update slot boots next */
+
+	/* Version 4 */
+	void     (*KvInit)(BL_KV_t* Copy_pKV);
+	uint16_t (*KvGet)(const BL_KV_t* Copy_pKV, uint16_t Copy_uint16Key, void* Copy_pData, uint16_t Copy_uint16Size); /* Length, BL_KV_NOT_FOUND */
+	uint8_t  (*KvSet)(BL_KV_t* Copy_pKV, uint16_t Copy_uint16Key, const void* Copy_pData, uint16_t Copy_uint16Length);
+	uint8_t  (*KvDelete)(BL_KV_t* Copy_pKV, uint16_t Copy_uint16Key);
+} BL_Services_t;
+
+#define BL_SERVICES                   ((const BL_Services_t*)BL_SERVICES_ADDRESS)
+
+
+#endif /* INC_BL_SERVICES_H_ */
@@ -0,0 +1,54 @@
+#ifndef INC_BL_SLOTCACHE_H_
+#define INC_BL_SLOTCACHE_H_
+
+#include <stdint.h>
+
+/*
+ * Slot Scan Cache
+ * ---------------
+ * What a host asks first about the application slots - BL_BLOCK_CRC_MANIFEST
+ * to send only the changed blocks, BL_BLANK_MAP to skip erasing - is worked
+ * out while the link is idle, so those requests are answered from RAM
+ * instead of a scan of the flash (BL_SLOT_CACHE_ENABLE in BL_config.h):
+ *  - the area from BL_IMAGE_BASE_ADDRESS to the end of the last slot is cut
+ *    into BL_SLOT_CACHE_BLOCK_SIZE blocks; per block the word-wise CRC of
+ *    BL_CRC.h and one blank bit per BL_SLOT_CACHE_GRANULE are kept, in
+ *    CCMRAM, with a valid bit,
+ *  - BL_uint8SlotCacheStep computes one block per call from the command
+ *    loop's background tasks, which any frame preempts: a frame waiting in
+ *    the ring is handled before the next block. Not while a session is open
+ *    or an erase is running, so it never reads a sector the flash is busy on,
+ *  - every program / erase of BL_Flash.c clears the valid bits of the blocks
+ *    it touches, before the flash changes, and moves the scan back to the
+ *    first of them. A block computed while it changed is not marked valid.
+ * A request the cache cannot answer (unaligned, another block size, a block
+ * not computed yet, the IEEE CRC) is computed from the flash as before.
+ * About 1.3 KB of CCMRAM for the full 992 KB above the bootloader.
+ *
+ * GET_APP_INFO reads the slot headers only and needs no cache.
+ */
+
+#define BL_SLOT_CACHE_BASE            BL_IMAGE_BASE_ADDRESS
+#define BL_SLOT_CACHE_BLOCK_SIZE      4096u     /* The host's delta block (BlockStore::kBlockSize) */
+#define BL_SLOT_CACHE_GRANULE         BL_BLANK_MAP_DEFAULT_GRANULE
+#define BL_SLOT_CACHE_MAX_BLOCKS      (((FLASH_END + 1u) - BL_SLOT_CACHE_BASE) / BL_SLOT_CACHE_BLOCK_SIZE)
+
+/* Returned by BL_uint8SlotCacheRangeIsBlank besides BL_FLASH_SECTOR_BLANK / NOT_BLANK */
+#define BL_SLOT_CACHE_UNKNOWN         0xFFu
+
+
+/*
+ * Bootloader Slot Cache Functions
+ * -------------------------------
+ */
+
+void    BL_voidSlotCacheInvalidate(uint32_t Copy_uint32Address, uint32_t Copy_uint32Length); /* Before a program / erase; RAM-resident */
+
+uint8_t BL_uint8SlotCacheStep(void);                                      /* One block computed; 1 while blocks are left */
+
+uint8_t BL_uint8SlotCacheGetCrc(uint32_t Copy_uint32Address, uint32_t* Copy_puint32Crc); /* 1 and the CRC of the block at the address, 0 if not cached */
+
+uint8_t BL_uint8SlotCacheRangeIsBlank(uint32_t Copy_uint32Address, uint32_t Copy_uint32Length); /* BL_FLASH_SECTOR_xxx or BL_SLOT_CACHE_UNKNOWN */
+
+
+#endif /* INC_BL_SLOTCACHE_H_ */
@@ -0,0 +1,119 @@
+#ifndef INC_BL_STAGING_H_
+#define INC_BL_STAGING_H_
+
+#include <stdint.h>
+
+/*
+ * Staging Slot
+ * ------------
+ * Flash sectors 10 and 11 (256 KB) hold an update staged by the running
+ * application (USB host, network), possibly compressed and written as slowly
+ * as it arrives: a BL_StagingHeader_t followed by the stream. The application
+ * links below the slot (BL_IMAGE_BASE_ADDRESS .. BL_STAGING_BASE_ADDRESS;
+ * with BL_AB_SLOTS_ENABLE the install goes to slot A, which it then activates).
+ *
+ * On the next boot BL_uint8StagingInstall() finds a staged image whose Result
+ * is still blank and whose stream CRC matches, erases the application sectors
+ * it covers and decompresses the stream into them at flash speed, then checks
+ * the installed image CRC and programs Result. Decompression is BL_LZ.h, the
+ * same format and 4 KB window as BL_MEM_WRITE_LZ.
+ *
+ * Progress journal: Started and one word per application sector are cleared
+ * (programmed to 0) as the install goes, Result last. A reset in the middle
+ * leaves Result blank: the next boot starts the install over from the erase
+ * (the stream is untouched, the decoder cannot resume mid-window), and the
+ * journal tells how far the interrupted attempt got. The application erases
+ * the slot before staging the next update.
+ *
+ * The application programs the stream first and the header last, its journal
+ * words and Result left erased.
+ * Both CRCs are word-wise (BL_CRC.h): CompressedCrc over the Length stream
+ * bytes after the header, ImageCrc over ImageLength bytes at BL_IMAGE_BASE_ADDRESS.
+ *
+ * A BL_STAGING_CODEC_PACKAGE stream is an update package (BL_Package.h), the
+ * same file BL_MEM_WRITE_PACKAGE takes: its manifest says where each segment
+ * goes and what to erase, its block CRCs and payload digest check the
+ * install, so ImageLength and ImageCrc are not used (0). The plan must stay
+ * below the slot (and the key/value store or the swap scratch before it).
+ */
+
+/*
+ * Swap Install (BL_SWAP_ENABLE)
+ * -----------------------------
+ * For images that must run from BL_IMAGE_BASE_ADDRESS but want the previous
+ * one kept: the application is limited to sectors 2..5 (224 KB) and sectors
+ * 6..7 (BL_SWAP_SCRATCH_ADDRESS) are the scratch area. A raw stream staged
+ * with BL_STAGING_CODEC_SWAP is installed sector by sector:
+ *  - Started: scratch erased (once, before the application changes),
+ *  - Sectors[2n]    : application sector 2 + n copied to the scratch, same offset,
+ *  - Sectors[2n + 1]: sector 2 + n erased and programmed from the stream.
+ * Each step is repeated whole when its word is still blank, so a reset
+ * resumes at the step it interrupted; nothing done before is redone. When
+ * Result is written the scratch holds the previous image (sectors up to the
+ * end of the new one; later sectors were not touched).
+ */
+
+#define BL_STAGING_BASE_ADDRESS       0x080C0000UL   /* Flash sector 10 */
+#if BL_JOURNAL_ENABLE
+#define BL_STAGING_SIZE               0x20000UL      /* Sector 10, sector 11 is the session journal */
+#else
+#define BL_STAGING_SIZE               0x40000UL      /* Sectors 10 and 11 */
+#endif
+
+#define BL_STAGING_MAGIC              0x54534C42UL   /* "BLST" */
+
+#define BL_STAGING_CODEC_NONE         0u             /* Stream is the image as is */
+#define BL_STAGING_CODEC_LZ           1u             /* Stream is BL_LZ.h sequences */
+#define BL_STAGING_CODEC_SWAP         2u             /* Raw stream, swap install (BL_SWAP_ENABLE) */
+#define BL_STAGING_CODEC_PACKAGE      3u             /* Update package, BL_Package.h (BL_PACKAGE_ENABLE) */
+
+#define BL_STAGING_FIRST_SECTOR       2u             /* Sector at BL_IMAGE_BASE_ADDRESS */
+#if BL_KV_ENABLE
+#define BL_STAGING_JOURNAL_SECTORS    6u             /* Sectors 2 .. 7, up to the key/value store */
+#else
+#define BL_STAGING_JOURNAL_SECTORS    8u             /* Sectors 2 .. 9, up to the slot */
+#endif
+
+#define BL_SWAP_SCRATCH_ADDRESS       0x08040000UL   /* Flash sector 6 */
+#define BL_SWAP_SCRATCH_FIRST_SECTOR  6u
+#define BL_SWAP_SCRATCH_SECTORS       2u             /* Sectors 6 and 7, 256 KB */
+#define BL_SWAP_SECTORS               4u             /* Application sectors 2 .. 5 */
+
+#define BL_STAGING_MARK_BLANK         0xFFFFFFFFUL   /* Journal word not reached */
+#define BL_STAGING_MARK_DONE          0x00000000UL   /* Journal word reached */
+
+#define BL_STAGING_RESULT_INSTALLED   0x4C54534EUL   /* Result: image installed and verified */
+#define BL_STAGING_RESULT_FAILED      0x00000000UL   /* Result: rejected or failed, not retried */
+
+typedef struct
+{
+	uint32_t Magic;                             /* BL_STAGING_MAGIC */
+	uint32_t Codec;                             /* BL_STAGING_CODEC_xxx */
+	uint32_t Length;                            /* Stream bytes after the header */
+	uint32_t CompressedCrc;                     /* Word-wise CRC of the stream */
+	uint32_t ImageLength;                       /* Installed size from BL_IMAGE_BASE_ADDRESS */
+	uint32_t ImageCrc;                          /* Word-wise CRC of the installed image */
+	uint32_t Started;                           /* Journal: install begun */
+	uint32_t Sectors[BL_STAGING_JOURNAL_SECTORS]; /* Journal: sector 2 + n fully written */
+	uint32_t Result;                            /* BL_STAGING_RESULT_xxx, blank until the end */
+} BL_StagingHeader_t;
+
+#define BL_STAGING_DATA_ADDRESS       (BL_STAGING_BASE_ADDRESS + sizeof(BL_StagingHeader_t))
+
+/* Returned by BL_uint8StagingInstall */
+#define BL_STAGING_NONE               0u             /* Nothing staged, or already handled */
+#define BL_STAGING_INSTALLED          1u
+#define BL_STAGING_FAILED             2u
+
+
+/*
+ * Bootloader Staging Functions
+ * ----------------------------
+ */
+
+uint8_t BL_uint8StagingInstall(void);                                    /* Boot-time install of a staged update */
+
+uint8_t BL_uint8StagingIsPending(void);                                  /* 1 if a staged header waits for its Result */
+
+
+#endif /* INC_BL_STAGING_H_ */
@@ -0,0 +1,97 @@
+#ifndef INC_BL_TRACE_H_
+#define INC_BL_TRACE_H_
+
+#include <stdint.h>
+#include "main.h"
+
+/*
+ * Event Trace (BL_TRACE_ENABLE)
+ * -----------------------------
+ * Fixed-size binary log of what the bootloader does, in RAM: the newest
+ * BL_TRACE_DEPTH events, each stamped with the DWT cycle counter (running
+ * from reset, Bootloader_StartBootTimer). Recording is a short critical
+ * section of a few stores, so it can stay on in production builds and show
+ * where an update stalls: gaps between FRAME_RX and the DISPATCH after it
+ * are parser / link time, between PROGRAM_START and PROGRAM_END flash time.
+ *
+ * Readout:
+ *  - BL_GET_TRACE [from sequence (4), optional]: the events from that
+ *    sequence number on (older ones are gone once overwritten),
+ *  - a debugger: Global_Trace in BL_Trace.c. Head counts every event ever
+ *    recorded, the newest is Entries[(Head - 1) & (BL_TRACE_DEPTH - 1)].
+ * Events recorded while a readout copies the ring may overwrite the oldest
+ * entries it returns; their sequence numbers tell.
+ */
+
+/*
+ * SWO stream (BL_ITM_ENABLE): each event is three 32-bit writes, to one ITM
+ * stimulus port per field so a decoder can find its way back in after an
+ * overflow.
+ */
+#define BL_TRACE_ITM_PORT_CYCLES      1u      /* Cycles: starts an event */
+#define BL_TRACE_ITM_PORT_EVENT       2u      /* (Event << 16) | Arg0 */
+#define BL_TRACE_ITM_PORT_ARG         3u      /* Arg1: completes it */
+
+/* Events: Arg0 / Arg1 */
+#define BL_TRACE_BOOT                 0x01u   /* Bootloader command loop entered: -, SystemCoreClock */
+#define BL_TRACE_FRAME_RX             0x02u   /* Frame handed to the command loop: link, length */
+#define BL_TRACE_CRC_CHECKED          0x03u   /* Frame CRC checked: command, CRC_SUCCESS / CRC_FAIL */
+#define BL_TRACE_DISPATCH             0x04u   /* Handler called: command, payload length */
+#define BL_TRACE_DISPATCH_END         0x05u   /* Handler returned: command, 1 if it answered with a NACK */
+#define BL_TRACE_TX_QUEUED            0x06u   /* Response handed to the link: link, length */
+#define BL_TRACE_PROGRAM_START        0x07u   /* BL_uint8FlashProgram: length, address */
+#define BL_TRACE_PROGRAM_END          0x08u   /* -, HAL status */
+#define BL_TRACE_ERASE_START          0x09u   /* Sector erase started: sector, 1 if in the background */
+#define BL_TRACE_ERASE_END            0x0Au   /* Sector erase done: sector (0xFF in the background), HAL status */
+#define BL_TRACE_MASS_ERASE           0x0Bu   /* -, HAL status, once done */
+#define BL_TRACE_UART_ERROR           0x0Cu   /* USART2 line error: -, BL_UART_ERROR_xxx */
+#define BL_TRACE_BAUD_CHANGE          0x0Du   /* -, new baud rate */
+#define BL_TRACE_LINK_LOCKED          0x0Eu   /* First good frame: link kept, bit per BL_LINK_xxx shut down */
+
+typedef struct
+{
+	uint32_t Cycles;                            /* DWT->CYCCNT */
+	uint16_t Event;                             /* BL_TRACE_xxx */
+	uint16_t Arg0;
+	uint32_t Arg1;
+} BL_TraceEntry_t;
+
+typedef struct
+{
+	uint32_t        Head;                       /* Events recorded since reset (free-running) */
+	BL_TraceEntry_t Entries[BL_TRACE_DEPTH];
+} BL_Trace_t;
+
+/*
+ * GET_TRACE reply: [status] [head (4)] [depth (2)] [core clock Hz (4)]
+ * [entries (2)] [first sequence (4)], then the entries oldest first, 12 bytes
+ * each as BL_TraceEntry_t.
+ */
+#define BL_TRACE_OK                   0x00u
+#define BL_TRACE_UNAVAILABLE          0x01u   /* Built without BL_TRACE_ENABLE, nothing follows the status */
+#define BL_TRACE_HEADER_SIZE          17u
+#define BL_TRACE_ENTRY_SIZE           12u
+
+#if BL_TRACE_ENABLE
+#define BL_TRACE(EVENT, ARG0, ARG1)   BL_voidTraceRecord((EVENT), (uint16_t)(ARG0), (uint32_t)(ARG1))
+#else
+#define BL_TRACE(EVENT, ARG0, ARG1)   ((void)0)
+#endif
+
+
+/*
+ * Bootloader Trace Functions
+ * --------------------------
+ * Thread and interrupt context alike.
+ */
+
+void     BL_voidTraceRecord(uint16_t Copy_uint16Event, uint16_t Copy_uint16Arg0, uint32_t Copy_uint32Arg1); /* Use BL_TRACE() */
+
+uint16_t BL_uint16TraceRead(uint32_t* Copy_puint32From, uint8_t* Copy_puint8Out, uint16_t Copy_uint16MaxEntries); /* Entries from *from on, *from moved to the first one returned */
+
+uint32_t BL_uint32TraceHead(void);                                       /* Events recorded so far */
+
+void     BL_voidTraceItmInit(void);                                      /* SWO, ITM ports and PC sampling; once SystemCoreClock is final */
+
+
+#endif /* INC_BL_TRACE_H_ */
@@ -0,0 +1,262 @@
+#ifndef INC_BL_TRANSPORT_H_
+#define INC_BL_TRANSPORT_H_
+
+#include <stdint.h>
+#include "BL.h"
+
+/*
+ * BL_RX_RING_SIZE
+ * ---------------
+ * Size in bytes of the circular buffer that USART2 RX DMA writes into.
+ * The host may stream several packets back-to-back, so the ring must hold
+ * at least one full packet plus whatever arrives while a handler is busy.
+ * Sized for a few maximum-length extended frames in flight.
+ *
+ * NOTE: must be a power of two, indexes are wrapped with a mask.
+ * Set in BL_config.h.
+ */
+
+/*
+ * BL_FRAME_MIN_LENGTH
+ * -------------------
+ * Smallest valid frame: length byte + command code + 4-byte CRC.
+ * A "Length to Follow" byte that gives less than this is treated as noise.
+ */
+#define BL_FRAME_MIN_LENGTH           6u
+
+/*
+ * BL_FRAME_EXT_MIN_LENGTH
+ * -----------------------
+ * Smallest valid extended frame: 3-byte header + command code + 4-byte CRC.
+ */
+#define BL_FRAME_EXT_MIN_LENGTH       8u
+
+/*
+ * BL_FRAME_TIMEOUT_MS
+ * -------------------
+ * An incomplete frame that receives no byte for this long (corrupted length
+ * byte, host gone mid-frame) is discarded together with every byte buffered
+ * behind it, and the parser waits for a length byte again. Measured only
+ * while the parser waits for that frame, so a host held off during a flash
+ * operation does not trip it.
+ */
+#define BL_FRAME_TIMEOUT_MS           50u
+
+/*
+ * BL_MAX_FRAME_LENGTH
+ * -------------------
+ * Receive buffer size: a full payload plus the largest command header
+ * (extended header, command, sequence, flags, address, 16-bit length) and CRC.
+ */
+#define BL_MAX_FRAME_LENGTH           (BL_MAX_PAYLOAD_LENGTH + 16u)
+
+/*
+ * BL_FRAME_QUEUE_DEPTH
+ * --------------------
+ * USART2 frames the receive interrupt may index ahead of the command loop.
+ * On every reception event (IDLE, half / full ring) the interrupt walks the
+ * complete frames behind the one being handled, checks their CRC
+ * (BL_uint8CRCCheckFrame) and queues them; the command loop then takes them
+ * already framed and checked, so parsing and checking command N+1 overlap
+ * with the execution of command N. While flash is programmed the checks go
+ * to DMA (BL_voidTransportCheckAhead, BL_CRC_WORDWISE_ENABLE) and leave the
+ * programming loop its CPU. Frames the interrupt cannot take in
+ * place (noise, ring wrap, misaligned aligned frame, COBS mode) are left to
+ * the command loop's own parser, as are the USB and SPI links.
+ * Set in BL_config.h.
+ */
+
+/*
+ * BL_TX_BUFFER_SIZE
+ * -----------------
+ * One complete response: ACK + extended length (3) + payload + optional CRC (4).
+ */
+#define BL_TX_BUFFER_SIZE             (BL_MAX_PAYLOAD_LENGTH + 8u)
+
+
+/*
+ * Framing (BL_SET_FRAMING)
+ * ------------------------
+ * BL_FRAMING_LENGTH : frames are found by their "Length to Follow" field (default).
+ * BL_FRAMING_COBS   : every frame, in both directions, is COBS encoded and ends
+ *                     with a BL_COBS_DELIMITER byte, which no encoded byte can be.
+ *                     The decoded bytes are an ordinary frame (any of the formats).
+ * A lost or corrupted byte in COBS mode costs the frame it belongs to: the
+ * parser resynchronizes on the next delimiter at once, no timeout involved.
+ * Frames are decoded in place in the receive ring (decoding only shrinks),
+ * responses are encoded in place in the TX buffer. The mode applies to every
+ * link and is lost on reset. The BL_CHANGE_BAUD ping stays a single raw byte.
+ */
+#define BL_FRAMING_LENGTH             0x00u
+#define BL_FRAMING_COBS               0x01u
+#define BL_COBS_DELIMITER             0x00u
+#define BL_COBS_OVERHEAD(LENGTH)      (((LENGTH) / 254u) + 1u)   /* Worst-case code bytes added to LENGTH bytes */
+
+
+/*
+ * USART2 flow control (BL_UART_FLOW_CONTROL_ENABLE)
+ * -------------------------------------------------
+ * RTS is driven by software on PA1 (active low, to the host's CTS input):
+ * deasserted while flash is being erased / programmed, or when the RX ring
+ * holds more than BL_RX_RTS_HIGH_WATERMARK bytes; asserted again once flash is
+ * idle and the ring has drained below BL_RX_RTS_LOW_WATERMARK.
+ * The USART's own RTS logic only sees its single-byte data register, which the
+ * DMA always empties, so it cannot express either condition.
+ * CTS (PA0) is not used: it is the B1 button that selects the boot mode.
+ */
+#define BL_UART_RTS_PORT              GPIOA
+#define BL_UART_RTS_PIN               GPIO_PIN_1
+#define BL_RX_RTS_HIGH_WATERMARK      (BL_RX_RING_SIZE - 1024u)   /* Room for the host's in-flight bytes */
+#define BL_RX_RTS_LOW_WATERMARK       (BL_RX_RING_SIZE / 2u)
+
+
+/*
+ * Links
+ * -----
+ * Physical interfaces carrying command frames. A response always goes back
+ * on the link its command arrived on.
+ */
+#define BL_LINK_UART                  0u
+#define BL_LINK_USB                   1u
+#define BL_LINK_SPI                   2u
+#define BL_LINK_CAN                   3u     /* CAN1, this node's identifier */
+#define BL_LINK_CAN_GROUP             4u     /* CAN1, group identifier: never answered */
+#define BL_LINK_COUNT                 5u
+
+
+/*
+ * RS-485 Multidrop (BL_RS485_ENABLE)
+ * ----------------------------------
+ * Every node sees every byte on the bus, so each USART2 frame and response
+ * starts with a node header, the address repeated inverted against noise:
+ *  - [address] [~address] [frame]            : host -> node BL_RS485_NODE_ADDRESS
+ *  - [0xFF] [0x00] [sequence (2, LE)] [frame]: host -> every node (broadcast)
+ *  - [0x00] [0xFF] [length (2, LE)] [bytes]  : node -> host, once per response piece
+ * A node skips frames addressed to others by their length and responses by
+ * the header's length; bytes matching no header are dropped one by one.
+ * Length-prefixed framing only (BL_SET_FRAMING to COBS is refused).
+ *
+ * Broadcast frames are executed by every node and never answered. A
+ * BL_MEM_WRITE or BL_MEM_FILL that succeeds marks its sequence number (below
+ * BL_RS485_SEQUENCE_COUNT) as done; the host then collects each node's missing
+ * sequence numbers in one unicast BL_BROADCAST_STATUS and repairs them
+ * unicast. Other broadcast commands (erase, BEGIN_PROGRAM) should use sequence
+ * 0xFFFF, which is not tracked. Frames reach the parser in bus order, so the
+ * answer to any unicast command means the broadcasts before it have run.
+ *
+ * DE / nRE (tied together) goes high before a response and low again from
+ * the USART2 transmission complete interrupt, after the last stop bit.
+ *
+ * Discovery (BL_DISCOVER as a broadcast, "Node Discovery" in BL.h): the
+ * bytes of two nodes answering at once garble each other, so each matching
+ * node answers in one of 16 time slots of BL_RS485_DISCOVER_SLOT_US after
+ * the frame, picked by the next 4 bits of its unique ID. Every node starts
+ * counting when the same frame arrives, so the slots line up to within the
+ * interrupt latency; the margin in a slot covers it.
+ */
+#define BL_RS485_ADDRESS_HOST         0x00u
+#define BL_RS485_ADDRESS_BROADCAST    0xFFu
+#define BL_RS485_HEADER_LENGTH        2u      /* Unicast */
+#define BL_RS485_LONG_HEADER_LENGTH   4u      /* Broadcast and responses */
+#define BL_RS485_SEQUENCE_COUNT       2048u   /* Broadcast writes tracked per session, multiple of 8 */
+#define BL_RS485_DE_PORT              GPIOA
+#define BL_RS485_DE_PIN               GPIO_PIN_8
+#define BL_RS485_DISCOVER_SLOT_US     2500u   /* A 20-byte answer at 115200 baud (1.7 ms) plus margin */
+
+
+/*
+ * BL_TransportStats_t
+ * -------------------
+ * Link counters since reset (BL_GET_STATS), all links together.
+ */
+typedef struct
+{
+	uint32_t RxBytes;                           /* Frames handed to the command loop, single bytes read */
+	uint32_t TxBytes;                           /* Responses and buffers sent, as on the wire */
+	uint32_t UartErrors;                        /* USART2 error events (BL_voidTransportUartError) */
+	uint32_t OverrunErrors;                     /* ORE: a byte arrived before DMA took the last one */
+	uint32_t FramingErrors;                     /* FE: stop bit missing (baud mismatch, break) */
+	uint32_t NoiseErrors;                       /* NE */
+	uint32_t ParityErrors;                      /* PE (parity is off: a line fault) */
+	uint32_t DmaErrors;                         /* DMA1 Stream5 transfer errors */
+	uint32_t RxRingHighWater;                   /* Most USART2 ring bytes waiting at one RX event */
+} BL_TransportStats_t;
+
+
+/*
+ * Bootloader Transport Functions
+ * ------------------------------
+ * USART2 receives continuously by DMA in circular mode; the command parser
+ * pulls whole frames out of the ring, woken by the IDLE line interrupt.
+ */
+
+void     BL_voidTransportInit(void);                                             /* Starts circular DMA reception */
+
+uint16_t BL_uint16TransportAvailable(void);                                      /* Bytes waiting in the ring */
+
+uint16_t BL_uint16TransportReceiveFrame(uint8_t** Copy_ppuint8Frame, uint8_t* Copy_puint8Buffer, uint16_t Copy_uint16MaxLength); /* Blocking read of one frame, in place when possible */
+
+void     BL_voidTransportReleaseFrame(void);                                     /* Consumes the frame handed out in place */
+
+uint8_t  BL_uint8TransportGetFrameCrc(const uint8_t* Copy_puint8Frame);          /* BL_CRC_FRAME_xxx: CRC already checked by the receive interrupt */
+
+void     BL_voidTransportUartRxEvent(void);                                      /* IDLE / half / full ring, called by BL_UART.c */
+
+void     BL_voidTransportUartTxDone(void);                                       /* Last stop bit of a DMA response, called by BL_UART.c */
+
+void     BL_voidTransportUartError(uint32_t Copy_uint32Errors);                  /* BL_UART_ERROR_xxx, called by BL_UART.c */
+
+uint8_t  BL_uint8TransportReadByte(uint8_t* Copy_puint8Byte, uint32_t Copy_uint32TimeoutMs); /* Single byte with timeout, HAL_OK / HAL_TIMEOUT */
+
+uint8_t  BL_uint8TransportSetBaudRate(uint32_t Copy_uint32BaudRate);             /* Reprograms USART2 and restarts reception */
+
+uint8_t* BL_puint8TransportTxAcquire(void);                                      /* Waits for the TX buffer to be free and returns it */
+
+void     BL_voidTransportTxStart(uint16_t Copy_uint16Length);                    /* Sends the TX buffer by DMA, returns immediately */
+
+void     BL_voidTransportTxSendBuffer(const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length); /* Sends any buffer (UART DMA / USB), after the previous TX */
+
+void     BL_voidTransportTxFlush(void);                                          /* Waits until the last byte has left the line */
+
+uint8_t  BL_uint8TransportTxReady(void);                                         /* 1: an unsolicited frame can start on USART2 now, without waiting */
+
+void     BL_voidTransportTxCapture(uint8_t Copy_uint8Enable);                    /* Responses stay in the TX buffer instead of being sent */
+
+uint16_t BL_uint16TransportTxCaptured(void);                                     /* Length of the last captured response, 0 if none */
+
+void     BL_voidTransportSetFlashBusy(uint8_t Copy_uint8Busy);                   /* Flash erase / program in progress, pauses the host */
+
+void     BL_voidTransportCheckAhead(uint8_t Copy_uint8Enable);                   /* 1 around flash programming: queued frames CRC-checked by DMA meanwhile */
+
+uint8_t  BL_uint8TransportGetLink(void);                                       /* BL_LINK_xxx the current command came from */
+
+void     BL_voidTransportLock(void);                                             /* Good frame: keep its link, shut the others down (BL_TRANSPORT_LOCK_ENABLE) */
+
+uint16_t BL_uint16TransportGetRxCapacity(void);                                /* Receive ring size of that link */
+
+void     BL_voidTransportSetFraming(uint8_t Copy_uint8Framing);                  /* BL_FRAMING_LENGTH / BL_FRAMING_COBS, from the next frame on */
+
+uint8_t  BL_uint8TransportGetFraming(void);                                      /* Framing in effect */
+
+void     BL_voidTransportNotifyRx(void);                                         /* Wakes the parser, called from the USB / SPI IRQs */
+
+void     BL_voidTransportGetStats(BL_TransportStats_t* Copy_pStats);           /* Link counters since reset or the last clear */
+
+void     BL_voidTransportClearStats(void);
+
+void     BL_voidTransportNotifyBackground(void);                                 /* ReceiveFrame returns 0 so background work can run */
+
+#if BL_RS485_ENABLE
+uint8_t  BL_uint8TransportIsBroadcast(void);                                     /* 1: the current command came as an RS-485 broadcast */
+
+void     BL_voidTransportBroadcastDone(void);                                    /* Marks the current broadcast write as done */
+
+uint16_t BL_uint16TransportBroadcastMissing(uint8_t* Copy_puint8Bitmap, uint16_t* Copy_puint16Done); /* Missing bitmap, returns the sequence end */
+
+void     BL_voidTransportBroadcastClear(void);                                   /* Forgets every broadcast sequence number */
+
+void     BL_voidTransportRs485SendSlot(uint8_t Copy_uint8Slot, uint16_t Copy_uint16Length); /* TX buffer in a discovery time slot, blocking */
+#endif
+
+
+#endif /* INC_BL_TRANSPORT_H_ */
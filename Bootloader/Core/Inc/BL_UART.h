@@ -0,0 +1,68 @@
+#ifndef INC_BL_UART_H_
+#define INC_BL_UART_H_
+
+#include <stdint.h>
+
+/*
+ * USART2 Driver
+ * -------------
+ * The bootloader's own USART2 / DMA1 driver, at register level, under
+ * BL_Transport.c. MX_USART2_UART_Init (HAL, once at start-up) sets up the
+ * clocks, pins, NVIC and the 8N1 format; from then on only this driver
+ * touches USART2, DMA1 Stream5 (RX, channel 4) and DMA1 Stream6 (TX,
+ * channel 4), so no frame goes through the HAL handle's lock, state
+ * machine or timeouts:
+ *  - reception is one circular DMA transfer into the transport's ring that
+ *    never stops on its own: a line error (parity, framing, noise, overrun)
+ *    is counted and cleared, the bad byte is left to the frame CRC. Only a
+ *    DMA transfer error stops the stream (BL_UART_ERROR_DMA),
+ *  - a response is one DMA transfer. The stream's TC hands over to the
+ *    USART's TC, so BL_uint8UARTTxBusy drops after the last stop bit,
+ *  - the three interrupt handlers read the status registers once and call
+ *    the transport: BL_voidTransportUartRxEvent on IDLE / half / full ring,
+ *    BL_voidTransportUartTxDone after the last stop bit,
+ *    BL_voidTransportUartError with BL_UART_ERROR_xxx.
+ * Everything the interrupt path calls runs from RAM (.RamFunc).
+ *
+ * The host build (Host/sim) replaces BL_UART.c with its simulated line.
+ */
+
+/* Line errors (BL_voidTransportUartError, BL_TRACE_UART_ERROR): the HAL_UART_ERROR_xxx values */
+#define BL_UART_ERROR_PE             0x01u
+#define BL_UART_ERROR_NE             0x02u
+#define BL_UART_ERROR_FE             0x04u
+#define BL_UART_ERROR_ORE            0x08u
+#define BL_UART_ERROR_DMA            0x10u     /* RX stream disabled by a transfer error */
+
+
+/*
+ * Bootloader UART Functions
+ * -------------------------
+ */
+
+void     BL_voidUARTStartRx(uint8_t* Copy_puint8Ring, uint16_t Copy_uint16Size); /* Circular DMA into the ring from its start, IDLE / error interrupts */
+
+void     BL_voidUARTStopRx(void);                                         /* RX stream and its interrupts off, bytes from now on are lost */
+
+uint16_t BL_uint16UARTRxRemaining(void);                                  /* NDTR: ring bytes until the DMA wraps */
+
+void     BL_voidUARTTransmit(const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length); /* One DMA transfer, returns at once */
+
+void     BL_voidUARTWrite(const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length); /* Polled, returns after the last stop bit */
+
+uint8_t  BL_uint8UARTTxBusy(void);                                        /* 1 until the last stop bit of the DMA transfer */
+
+uint8_t  BL_uint8UARTSetBaudRate(uint32_t Copy_uint32BaudRate);           /* BRR from PCLK1; 0 if done, 1 if out of range */
+
+uint32_t BL_uint32UARTGetBaudRate(void);
+
+void     BL_voidUARTStop(void);                                           /* Both streams and every interrupt off, the line stays configured */
+
+void     BL_voidUARTIRQHandler(void);                                     /* USART2_IRQHandler: IDLE, line errors, TC */
+
+void     BL_voidUARTRxDmaIRQHandler(void);                                /* DMA1_Stream5_IRQHandler: half / full ring, transfer error */
+
+void     BL_voidUARTTxDmaIRQHandler(void);                                /* DMA1_Stream6_IRQHandler: transfer complete, transfer error */
+
+
+#endif /* INC_BL_UART_H_ */
@@ -0,0 +1,93 @@
+#ifndef INC_BL_UF2_H_
+#define INC_BL_UF2_H_
+
+#include <stdint.h>
+
+/*
+ * UF2 Drag-and-Drop Drive (BL_USB_MSC_ENABLE)
+ * -------------------------------------------
+ * The OTG FS device (BL_USB.c) enumerates as a USB drive; copying a .uf2
+ * file onto it programs the application, on any laptop, without drivers or
+ * the host tool. Bulk-only transport with the SCSI commands the usual
+ * operating systems send, served from the command loop (BL_voidUF2Poll).
+ *
+ * The volume is virtual, nothing of it is stored: a 4 MB FAT16 disk of 512-
+ * byte sectors and clusters whose boot sector, FATs and root directory are
+ * generated on every READ(10). It holds two read-only files:
+ *  - INFO_UF2.TXT : bootloader version and board.
+ *  - CURRENT.UF2  : the application flash (BL_UF2_FLASH_BASE ..
+ *                   BL_UF2_FLASH_END) as UF2 blocks, for reading an image back.
+ *
+ * Writing: the operating system writes the file to clusters of its choice,
+ * in an order of its choice, around FAT and directory updates. The sector
+ * number is therefore ignored; every 512-byte sector written is checked for
+ * the UF2 magic numbers, anything else is dropped. A UF2 block states its
+ * own flash address, its number and the number of blocks in the file:
+ *  1. The first block of a file (a block count that differs from the file
+ *     being received) opens a programming session (BL_uint8ProgramOpen).
+ *  2. Each block is written through BL_uint8ProgramWrite: a sector is erased
+ *     on the first block landing in it, the data is write-combined. Blocks
+ *     out of order cost a line flush, not an error.
+ *  3. A bitmap of block numbers drops the ones already written, which the
+ *     OS may send twice.
+ *  4. When every block of the file has arrived the session is closed and,
+ *     if all of them were written, the board resets BL_UF2_RESET_DELAY_MS
+ *     after the status of the last write; the boot path checks the new
+ *     image (BL_Image.h) as after any update.
+ * Blocks flagged "not main flash", of another family, or addressed outside
+ * the application flash are refused (counted, so the file still completes,
+ * but the board stays in the bootloader).
+ */
+
+/* UF2 block format (github.com/microsoft/uf2) */
+#define BL_UF2_MAGIC_START0           0x0A324655UL   /* "UF2\n" */
+#define BL_UF2_MAGIC_START1           0x9E5D5157UL
+#define BL_UF2_MAGIC_END              0x0AB16F30UL
+
+#define BL_UF2_FLAG_NOT_MAIN_FLASH    0x00000001UL
+#define BL_UF2_FLAG_FAMILY_ID         0x00002000UL   /* FileSize holds a family ID */
+
+#define BL_UF2_FAMILY_STM32F407       0x6D0922FAUL
+#define BL_UF2_FAMILY_STM32F407VG     0x8FB060FEUL
+
+#define BL_UF2_BLOCK_SIZE             512u
+#define BL_UF2_DATA_SIZE              476u
+#define BL_UF2_PAYLOAD_SIZE           256u           /* Payload of the CURRENT.UF2 blocks */
+
+typedef struct
+{
+	uint32_t MagicStart0;
+	uint32_t MagicStart1;
+	uint32_t Flags;
+	uint32_t TargetAddr;
+	uint32_t PayloadSize;
+	uint32_t BlockNo;
+	uint32_t NumBlocks;
+	uint32_t FamilyId;                          /* With BL_UF2_FLAG_FAMILY_ID */
+	uint8_t  Data[BL_UF2_DATA_SIZE];
+	uint32_t MagicEnd;
+} BL_UF2Block_t;
+
+/* Application flash, as exposed and as accepted */
+#define BL_UF2_FLASH_BASE             BL_IMAGE_BASE_ADDRESS
+#define BL_UF2_FLASH_END              0x08100000UL
+
+/* Block numbers tracked per file: 1 MB of 256-byte blocks, files with more are refused */
+#define BL_UF2_MAX_BLOCKS             4096u
+
+#define BL_UF2_VOLUME_SECTORS         8192u          /* 4 MB: enough clusters to be FAT16 */
+
+#define BL_UF2_RESET_DELAY_MS         100u           /* Lets the host take the last status */
+
+
+/*
+ * Bootloader UF2 Functions
+ * ------------------------
+ */
+
+void BL_voidUF2Init(void);                                          /* Connects the drive */
+
+void BL_voidUF2Poll(void);                                          /* Serves the command blocks received, called by the command loop */
+
+
+#endif /* INC_BL_UF2_H_ */
@@ -0,0 +1,90 @@
+#ifndef INC_BL_USB_H_
+#define INC_BL_USB_H_
+
+#include <stdint.h>
+
+/*
+ * USB Full-Speed Device Transport
+ * -------------------------------
+ * Register-level driver for the OTG_FS core in device mode, one vendor-specific
+ * interface with a bulk OUT (0x01) and a bulk IN (0x81) endpoint.
+ * The byte stream carries exactly the same frames as USART2, so the command
+ * handlers are shared; BL_Transport decides which link a reply goes to.
+ *
+ * The interrupt handler and everything it calls run from RAM (.RamFunc),
+ * with the descriptors and strings in RAM as well, so a sector erase of up
+ * to 2 s does not stall the device stack: enumeration and control requests
+ * are answered, and bulk OUT stays NAKed (BL_USB_RX_RING_SIZE) until the
+ * command loop, back from the flash, consumes the ring. The flash is not
+ * slowed down for it; the host sees a slow reply, never a dropped device.
+ *
+ * Enabled with BL_TRANSPORT_USB_ENABLE (BL_config.h). The 48 MHz USB clock comes
+ * from PLLQ, which is only correct with BL_CLOCK_PROFILE_168MHZ.
+ *
+ * With BL_USB_MSC_ENABLE the same interface is a mass-storage one instead
+ * (class 08h, SCSI transparent, bulk-only transport) under BL_USB_MSC_PID.
+ * The driver still only moves bytes: BL_UF2.c parses the command blocks out
+ * of the RX ring, and every bulk OUT packet wakes the command loop for it
+ * (BL_voidTransportNotifyBackground) rather than the frame parser. The class
+ * requests (Get Max LUN, Bulk-Only Mass Storage Reset) and the endpoint halt
+ * of the status phase are handled here.
+ */
+
+/*
+ * Device identification
+ * ---------------------
+ * ST vendor ID with a product ID reserved for this bootloader.
+ * Host tools open the device by this pair (libusb / WinUSB).
+ */
+#define BL_USB_VID                   0x0483u
+#define BL_USB_PID                   0x5750u
+#define BL_USB_BCD_DEVICE            0x0100u
+#define BL_USB_MSC_PID               0x5751u   /* BL_USB_MSC_ENABLE: a drive, not the vendor interface */
+
+/* Bulk endpoints, full-speed maximum packet size */
+#define BL_USB_BULK_OUT_EP           0x01u
+#define BL_USB_BULK_IN_EP            0x81u
+#define BL_USB_BULK_MPS              64u
+
+/*
+ * BL_USB_RX_RING_SIZE
+ * -------------------
+ * Received bulk OUT bytes wait here for the frame parser.
+ * The OUT endpoint is NAKed while less than one packet of space is left.
+ *
+ * NOTE: must be a power of two, indexes are wrapped with a mask.
+ */
+#define BL_USB_RX_RING_SIZE          8192u
+
+
+/*
+ * Bootloader USB Functions
+ * ------------------------
+ */
+
+void     BL_voidUSBInit(void);                                           /* Core reset, FIFOs, soft connect */
+
+void     BL_voidUSBDeInit(void);                                         /* Soft disconnect, PHY and clock off */
+
+uint16_t BL_uint16USBAvailable(void);                                    /* Bytes waiting in the RX ring */
+
+uint8_t  BL_uint8USBPeek(uint16_t Copy_uint16Offset);                    /* Byte at tail + offset, not consumed */
+
+uint8_t* BL_puint8USBPeekBuffer(uint16_t Copy_uint16Length);             /* Tail bytes in place, NULL if they wrap */
+
+void     BL_voidUSBConsume(uint16_t Copy_uint16Count);                   /* Releases bytes, re-arms bulk OUT */
+
+void     BL_voidUSBTransmit(uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length); /* Queues one bulk IN transfer */
+
+void     BL_voidUSBTxFlush(void);                                        /* Waits for the bulk IN transfer to finish */
+
+void     BL_voidUSBIRQHandler(void);                                     /* Called from OTG_FS_IRQHandler */
+
+void     BL_voidUSBStallIn(void);                                        /* BL_USB_MSC_ENABLE: halts bulk IN until the host clears it */
+
+uint8_t  BL_uint8USBInHalted(void);                                      /* BL_USB_MSC_ENABLE: 1 until that CLEAR_FEATURE */
+
+uint8_t  BL_uint8USBTakeReset(void);                                     /* BL_USB_MSC_ENABLE: 1 once per bus / mass-storage reset */
+
+
+#endif /* INC_BL_USB_H_ */
@@ -0,0 +1,635 @@
+#ifndef INC_BL_CONFIG_H_
+#define INC_BL_CONFIG_H_
+
+/*
+ * Bootloader Build Configuration
+ * ------------------------------
+ * Every compile-time switch and size of the bootloader: clock, transports,
+ * frame and buffer sizes, codecs and hashes, image layout, journal,
+ * diagnostics. Each one defaults to the general-purpose build; a product
+ * line overrides what it needs without touching the sources, either with -D
+ * on the command line or in its own header named by BL_CONFIG_FILE
+ * (-DBL_CONFIG_FILE='"BL_config_product.h"'), read first.
+ *
+ * A feature switched off is compiled out: its handler leaves the command
+ * table (the code answers NACK like any unknown one), its buffers leave RAM,
+ * and BL_GET_DEVICE_INFO / BL_GET_CAPABILITIES stop announcing it, so host
+ * tools fall back on their own.
+ *
+ * The bootloader must link into sectors 0-1 (32 KB, STM32F407VGTX_FLASH.ld).
+ * The optional subsystems (codecs, SHA-256, self-update, diagnostics, slot
+ * cache) therefore default to 0: all of them together do not fit there. A
+ * product enables the ones it needs in its BL_CONFIG_FILE and checks the
+ * MinSize link with blsize; Host/sim/BL_SimConfig.h enables them all for the
+ * host build, which has no flash budget.
+ *
+ * No includes: main.h, BL.h and the host simulator all read it.
+ */
+
+#ifdef BL_CONFIG_FILE
+#include BL_CONFIG_FILE
+#endif
+
+/*
+ * BL_CLOCK_PROFILE_168MHZ
+ * -----------------------
+ * Build-time clock profile selection (override with -DBL_CLOCK_PROFILE_168MHZ=1):
+ *  0 -> HSI + PLL, 25 MHz SYSCLK, FLASH_LATENCY_0 (CubeMX configuration).
+ *  1 -> 8 MHz HSE + PLL, 168 MHz SYSCLK, APB1 42 MHz, FLASH_LATENCY_5,
+ *       prefetch, instruction cache and data cache enabled.
+ */
+#ifndef BL_CLOCK_PROFILE_168MHZ
+#define BL_CLOCK_PROFILE_168MHZ      0
+#endif
+
+/*
+ * BL_HANDOFF_KEEP_CLOCK
+ * ---------------------
+ * 1 -> Bootloader_JumpToUserApp leaves the clock tree running instead of
+ *      returning it to HSI; BL_Handoff_t (BL_Handoff.h) describes it, so the
+ *      UserApp skips its PLL start-up when the configuration matches.
+ */
+#ifndef BL_HANDOFF_KEEP_CLOCK
+#define BL_HANDOFF_KEEP_CLOCK        0
+#endif
+
+/*
+ * BL_TRANSPORT_USB_ENABLE
+ * -----------------------
+ * 1 -> the command set is also served over USB OTG FS (vendor bulk, BL_USB.c),
+ *      alongside USART2. Needs BL_CLOCK_PROFILE_168MHZ for the 48 MHz USB clock.
+ */
+#ifndef BL_TRANSPORT_USB_ENABLE
+#define BL_TRANSPORT_USB_ENABLE      0
+#endif
+
+/*
+ * BL_USB_MSC_ENABLE
+ * -----------------
+ * 1 -> USB OTG FS is a mass-storage drive instead (BL_UF2.c): copying a .uf2
+ *      file onto it programs the application, no host tool or driver needed.
+ *      Same core and clock as BL_TRANSPORT_USB_ENABLE, so only one of them.
+ */
+#ifndef BL_USB_MSC_ENABLE
+#define BL_USB_MSC_ENABLE            0
+#endif
+
+#if (BL_USB_MSC_ENABLE && BL_TRANSPORT_USB_ENABLE)
+#error "BL_USB_MSC_ENABLE and BL_TRANSPORT_USB_ENABLE share the OTG FS core"
+#endif
+
+/*
+ * BL_TRANSPORT_SPI_ENABLE
+ * -----------------------
+ * 1 -> the command set is also served as SPI1 slave (BL_SPI.c) with a READY pin.
+ */
+#ifndef BL_TRANSPORT_SPI_ENABLE
+#define BL_TRANSPORT_SPI_ENABLE      0
+#endif
+
+/*
+ * BL_TRANSPORT_CAN_ENABLE
+ * -----------------------
+ * 1 -> the command set is also served on CAN1 (BL_CAN.c, PD0 / PD1), with a
+ *      node identifier for unicast commands and a group identifier whose
+ *      commands run on every node of the group without an answer.
+ */
+#ifndef BL_TRANSPORT_CAN_ENABLE
+#define BL_TRANSPORT_CAN_ENABLE      0
+#endif
+
+/*
+ * BL_TRANSPORT_LOCK_ENABLE
+ * ------------------------
+ * 1 -> every enabled link listens from reset, and the first one to deliver a
+ *      frame with a good CRC is kept until reset: the others are shut down
+ *      (receivers, interrupts and, except USART2, their clocks), so a stray
+ *      byte can no longer steal the responses and the unused links draw no
+ *      power. 0 -> every link is served for as long as the bootloader runs.
+ * No effect with USART2 alone.
+ */
+#ifndef BL_TRANSPORT_LOCK_ENABLE
+#define BL_TRANSPORT_LOCK_ENABLE     1
+#endif
+
+/*
+ * BL_RS485_ENABLE
+ * ---------------
+ * 1 -> USART2 is a node on an RS-485 half-duplex bus: frames carry a node
+ *      header (BL_Transport.h), broadcast writes are not answered and the
+ *      transceiver's DE / nRE is driven from PA8. BL_RS485_NODE_ADDRESS
+ *      (1..254) must be unique on the bus.
+ */
+#ifndef BL_RS485_ENABLE
+#define BL_RS485_ENABLE              0
+#endif
+
+#ifndef BL_RS485_NODE_ADDRESS
+#define BL_RS485_NODE_ADDRESS        1u
+#endif
+
+/*
+ * BL_UART_FLOW_CONTROL_ENABLE
+ * ---------------------------
+ * 1 -> USART2 RTS on PA1 pauses the host while flash is busy or the RX ring is
+ *      nearly full (BL_Transport.h). The host adapter must honour CTS.
+ */
+#ifndef BL_UART_FLOW_CONTROL_ENABLE
+#define BL_UART_FLOW_CONTROL_ENABLE  0
+#endif
+
+/*
+ * BL_MAX_PAYLOAD_LENGTH
+ * ---------------------
+ * Largest data block one frame carries (BL.h "Frame Formats"), reported to
+ * the host in BL_GET_DEVICE_INFO / BL_GET_CAPABILITIES. Sizes the frame and
+ * response buffers (BL_MAX_FRAME_LENGTH, BL_TX_BUFFER_SIZE): a product with
+ * little RAM to spare, or a slow link, builds with 1024 and loses nothing
+ * but per-frame overhead. A multiple of 4, 256 .. 16384.
+ */
+#ifndef BL_MAX_PAYLOAD_LENGTH
+#define BL_MAX_PAYLOAD_LENGTH        4096u
+#endif
+
+#if ((BL_MAX_PAYLOAD_LENGTH < 256u) || (BL_MAX_PAYLOAD_LENGTH > 16384u) || ((BL_MAX_PAYLOAD_LENGTH & 3u) != 0u))
+#error "BL_MAX_PAYLOAD_LENGTH is a multiple of 4, 256 .. 16384"
+#endif
+
+/*
+ * BL_RX_RING_SIZE
+ * ---------------
+ * USART2 RX DMA ring (BL_Transport.h). Holds at least one full frame; a few
+ * let the host stream frames back to back while a handler is busy.
+ * A power of two, 32 KB at most (16-bit ring indexes and DMA count).
+ */
+#ifndef BL_RX_RING_SIZE
+#define BL_RX_RING_SIZE              16384u
+#endif
+
+#if ((BL_RX_RING_SIZE & (BL_RX_RING_SIZE - 1u)) != 0u)
+#error "BL_RX_RING_SIZE must be a power of two"
+#endif
+
+#if ((BL_RX_RING_SIZE < (BL_MAX_PAYLOAD_LENGTH + 16u)) || (BL_RX_RING_SIZE > 32768u))
+#error "BL_RX_RING_SIZE must hold one BL_MAX_PAYLOAD_LENGTH frame, 32768 at most"
+#endif
+
+#if (BL_UART_FLOW_CONTROL_ENABLE && (BL_RX_RING_SIZE < 4096u))
+#error "BL_UART_FLOW_CONTROL_ENABLE keeps 1 KB of the RX ring for the host's in-flight bytes: BL_RX_RING_SIZE >= 4096"
+#endif
+
+/*
+ * BL_FRAME_QUEUE_DEPTH
+ * --------------------
+ * USART2 frames the receive interrupt may frame and CRC-check ahead of the
+ * command loop (BL_Transport.h).
+ */
+#ifndef BL_FRAME_QUEUE_DEPTH
+#define BL_FRAME_QUEUE_DEPTH         4u
+#endif
+
+/*
+ * BL_STREAM_SELECTIVE_WINDOW
+ * --------------------------
+ * Packets a selective BL_MEM_WRITE_STREAM accepts ahead of the next expected
+ * one (BL.h "Selective Retransmission"). 1 .. 32: the received bitmap is
+ * one 32-bit word.
+ */
+#ifndef BL_STREAM_SELECTIVE_WINDOW
+#define BL_STREAM_SELECTIVE_WINDOW   32u
+#endif
+
+#if ((BL_STREAM_SELECTIVE_WINDOW < 1u) || (BL_STREAM_SELECTIVE_WINDOW > 32u))
+#error "BL_STREAM_SELECTIVE_WINDOW is 1 .. 32"
+#endif
+
+/*
+ * BL_CRC_WORDWISE_ENABLE
+ * ----------------------
+ * 0 -> frame CRC fed one byte per CRC word (original host convention).
+ * 1 -> frame CRC fed as little-endian 32-bit words, tail bytes one per word
+ *      (4x fewer CRC writes). The host tool must be built to match.
+ */
+#ifndef BL_CRC_WORDWISE_ENABLE
+#define BL_CRC_WORDWISE_ENABLE       0
+#endif
+
+/*
+ * BL_CRC_SOFT_ENABLE
+ * ------------------
+ * 1 -> running CRCs (BL_CRCStream_t: the session's image CRC, frame CRCs
+ *      built from pieces) are computed by a slicing-by-8 software CRC with
+ *      8 KB of tables in CCMRAM, except pieces the DMA can feed faster
+ *      ("Engine Choice" in BL_CRC.h). The CRC unit then serves one-shot CRCs
+ *      and the receive interrupt's frame check, and is no longer reset and
+ *      restored for every update of every stream.
+ */
+#ifndef BL_CRC_SOFT_ENABLE
+#define BL_CRC_SOFT_ENABLE           0
+#endif
+
+/*
+ * BL_RESPONSE_CRC_ENABLE
+ * ----------------------
+ * 1 -> every ACK response ends with a CRC32 over its header and payload,
+ *      computed like the request CRC. The announced length does not include
+ *      it. Off by default so existing host tools keep working.
+ */
+#ifndef BL_RESPONSE_CRC_ENABLE
+#define BL_RESPONSE_CRC_ENABLE       0
+#endif
+
+/*
+ * BL_LZ_ENABLE
+ * ------------
+ * 1 -> BL_MEM_WRITE_LZ: LZ-compressed image streams (BL_LZ.h), 4 KB of
+ *      CCMRAM for the window. 0 -> the command is unknown (NACK) and
+ *      BL_GET_CAPABILITIES no longer lists the codec.
+ */
+#ifndef BL_LZ_ENABLE
+#define BL_LZ_ENABLE                 0
+#endif
+
+/*
+ * BL_DELTA_ENABLE
+ * ---------------
+ * 1 -> BL_MEM_WRITE_DELTA: images rebuilt from a patch against the one in
+ *      flash. 0 -> the command is unknown (NACK).
+ */
+#ifndef BL_DELTA_ENABLE
+#define BL_DELTA_ENABLE              0
+#endif
+
+/*
+ * BL_PACKAGE_ENABLE
+ * -----------------
+ * 1 -> BL_MEM_WRITE_PACKAGE and BL_STAGING_CODEC_PACKAGE: pre-planned update
+ *      packages (BL_Package.h), about 4.5 KB of CCMRAM per decoder. Needs
+ *      BL_LZ_ENABLE (compressed segments) and BL_SHA256_ENABLE (digests).
+ */
+#ifndef BL_PACKAGE_ENABLE
+#define BL_PACKAGE_ENABLE            0
+#endif
+
+/*
+ * BL_SELF_UPDATE_ENABLE
+ * ---------------------
+ * 1 -> BL_SELF_UPDATE: a new bootloader staged in the application flash is
+ *      checked (SHA-256, and the signature with BL_SIGNATURE_ENABLE), then
+ *      copied over sectors 0 and 1 by a copier running from SRAM. Needs
+ *      BL_SHA256_ENABLE. 0 -> the bootloader is only replaced with SWD.
+ */
+#ifndef BL_SELF_UPDATE_ENABLE
+#define BL_SELF_UPDATE_ENABLE        0
+#endif
+
+/*
+ * BL_READ_RLE_ENABLE
+ * ------------------
+ * 1 -> BL_MEM_READ_FLAG_RLE run-length encodes the data read. 0 -> the flag
+ *      is ignored and the data comes back raw, which every host tool reads.
+ */
+#ifndef BL_READ_RLE_ENABLE
+#define BL_READ_RLE_ENABLE           0
+#endif
+
+/*
+ * BL_SHA256_ENABLE
+ * ----------------
+ * 1 -> the programming session hashes every byte written with SHA-256 for
+ *      BL_COMMIT, and BL_VERIFY_RANGE offers BL_VERIFY_ALGO_SHA256.
+ *      0 -> the CRC-32 checks only: BL_COMMIT refuses a digest and the SHA
+ *      rounds leave the write path. Needed by BL_SIGNATURE_ENABLE.
+ */
+#ifndef BL_SHA256_ENABLE
+#define BL_SHA256_ENABLE             0
+#endif
+
+/*
+ * BL_SIGNATURE_ENABLE
+ * -------------------
+ * 1 -> signed updates only: BL_COMMIT must carry an ECDSA-P256 signature of
+ *      the session's SHA-256 (BL_P256.h), checked against the key built into
+ *      the bootloader, and only an image marked by a signed commit is started.
+ */
+#ifndef BL_SIGNATURE_ENABLE
+#define BL_SIGNATURE_ENABLE          0
+#endif
+
+/*
+ * BL_DECRYPT_ENABLE / BL_DECRYPT_KEY_BITS
+ * ---------------------------------------
+ * 1 -> encrypted updates: a BL_BEGIN_PROGRAM carrying an initial counter
+ *      block opens a decrypting session, and the BL_MEM_WRITE / _POSTED /
+ *      _STREAM data of its target range is AES-CTR ciphertext under the key
+ *      built into the bootloader (BL_AES.h), decrypted in the frame before
+ *      it is written and hashed. 1.25 KB of CCMRAM for the tables. The key
+ *      is 128 or 256 bits.
+ */
+#ifndef BL_DECRYPT_ENABLE
+#define BL_DECRYPT_ENABLE            0
+#endif
+
+#ifndef BL_DECRYPT_KEY_BITS
+#define BL_DECRYPT_KEY_BITS          128
+#endif
+
+/*
+ * BL_WRITE_VERIFY_ENABLE
+ * ----------------------
+ * 1 -> every flash program is read back (32-bit reads) and compared with the
+ *      frame data; BL_MEM_WRITE / BL_END_PROGRAM report the first differing
+ *      address (WRITE_VERIFY_ERROR + address).
+ */
+#ifndef BL_WRITE_VERIFY_ENABLE
+#define BL_WRITE_VERIFY_ENABLE       0
+#endif
+
+/*
+ * BL_FLASH_PARALLELISM
+ * --------------------
+ * Bytes per flash program / erase step (FLASH_CR PSIZE), legal by supply:
+ * x32 from 2.7 V, x16 from 2.1 V, x8 from 1.8 V (RM0090).
+ * 0 -> measured: VDD is read through VREFINT at start-up and at every session
+ *      start, and the widest legal size is used (BL_Flash.h).
+ * 1 / 2 / 4 -> fixed, no ADC use: for a board whose rail is known.
+ */
+#ifndef BL_FLASH_PARALLELISM
+#define BL_FLASH_PARALLELISM         0
+#endif
+
+#if ((BL_FLASH_PARALLELISM != 0) && (BL_FLASH_PARALLELISM != 1) && (BL_FLASH_PARALLELISM != 2) && (BL_FLASH_PARALLELISM != 4))
+#error "BL_FLASH_PARALLELISM is 0 (measured), 1, 2 or 4"
+#endif
+
+/*
+ * BL_FLASH_HAL_PROGRAM
+ * --------------------
+ * 0 -> BL_uint8FlashProgram drives the flash interface itself, from RAM:
+ *      PG and PSIZE set once per run, a store and a BSY poll per unit, the
+ *      error flags checked once per PROGRAM_SLICE_UNITS units.
+ * 1 -> every unit goes through HAL_FLASH_Program (lock, set-up and timed
+ *      wait per unit, from flash): the fallback, to compare against.
+ */
+#ifndef BL_FLASH_HAL_PROGRAM
+#define BL_FLASH_HAL_PROGRAM         0
+#endif
+
+/*
+ * BL_AB_SLOTS_ENABLE
+ * ------------------
+ * 1 -> two application slots, A (sectors 2..5) and B (sectors 6..9): the
+ *      host updates the inactive one and BL_SLOT_ACTIVATE switches to it by
+ *      programming one header word (BL_Image.h). 0 -> one slot up to the
+ *      staging slot, as before.
+ */
+#ifndef BL_AB_SLOTS_ENABLE
+#define BL_AB_SLOTS_ENABLE           0
+#endif
+
+/*
+ * BL_SWAP_ENABLE
+ * --------------
+ * 1 -> staged updates may use the swap install (BL_Staging.h): the image stays
+ *      linked at 0x08008000, limited to sectors 2..5, and the previous one is
+ *      kept in sectors 6..7. A reset during the install resumes it. Not
+ *      combined with BL_AB_SLOTS_ENABLE, which uses those sectors for slot B.
+ */
+#ifndef BL_SWAP_ENABLE
+#define BL_SWAP_ENABLE               0
+#endif
+
+/*
+ * BL_TRIAL_BOOT_ENABLE
+ * --------------------
+ * 1 -> an image activated by BL_SLOT_ACTIVATE or installed from staging boots
+ *      on trial under the IWDG until it confirms itself; after
+ *      BL_TRIAL_BOOT_ATTEMPTS unconfirmed boots the bootloader rolls back to
+ *      the previous A/B slot (BL_Handoff.h).
+ */
+#ifndef BL_TRIAL_BOOT_ENABLE
+#define BL_TRIAL_BOOT_ENABLE         0
+#endif
+
+#ifndef BL_TRIAL_BOOT_ATTEMPTS
+#define BL_TRIAL_BOOT_ATTEMPTS       3u
+#endif
+
+/*
+ * BL_ROLLBACK_ENABLE / BL_ROLLBACK_OTP_BLOCK / BL_ROLLBACK_OTP_BLOCKS
+ * -------------------------------------------------------------------
+ * 1 -> anti-rollback (BL_Rollback.h): an image whose header SecurityVersion
+ *      is below the security counter burned into OTP blocks
+ *      BL_ROLLBACK_OTP_BLOCK .. + BL_ROLLBACK_OTP_BLOCKS - 1 is not started,
+ *      and a confirmed image raises the counter to its own version. OTP bits
+ *      never come back: every image must carry the field before this is on.
+ */
+#ifndef BL_ROLLBACK_ENABLE
+#define BL_ROLLBACK_ENABLE           0
+#endif
+
+#ifndef BL_ROLLBACK_OTP_BLOCK
+#define BL_ROLLBACK_OTP_BLOCK        14u
+#endif
+
+#ifndef BL_ROLLBACK_OTP_BLOCKS
+#define BL_ROLLBACK_OTP_BLOCKS       2u
+#endif
+
+/*
+ * BL_WATCHDOG_ENABLE
+ * ------------------
+ * 1 -> update mode runs under the IWDG (about 8 s, BL_WATCHDOG_RELOAD at
+ *      LSI / 64): a hung command loop resets the board. MASS_ERASE then goes
+ *      sector by sector, since one bank erase takes up to 16 s and cannot be
+ *      interrupted. The IWDG keeps running in the application, which must
+ *      refresh it. The refresh points (BL_PORT_WATCHDOG_REFRESH) are built
+ *      in either way, for an IWDG the application or the option bytes
+ *      started: command loop, frame waits, every flash program call and
+ *      sector erase.
+ */
+#ifndef BL_WATCHDOG_ENABLE
+#define BL_WATCHDOG_ENABLE           0
+#endif
+
+#ifndef BL_WATCHDOG_RELOAD
+#define BL_WATCHDOG_RELOAD           0x0FFFu   /* 4095 x 64 / 32 kHz: 8.2 s, more than a 128 KB erase at x8 (4 s max) */
+#endif
+
+#if (BL_SWAP_ENABLE && BL_AB_SLOTS_ENABLE)
+#error "BL_SWAP_ENABLE and BL_AB_SLOTS_ENABLE share flash sectors 6..9"
+#endif
+
+/*
+ * BL_JOURNAL_ENABLE
+ * -----------------
+ * 1 -> the resumable programming session is also journaled in flash sector 11
+ *      (BL_Journal.h), so BL_RESUME_SESSION works after a power loss without
+ *      VBAT, and an image without header is not started after an interrupted
+ *      session. The staging slot shrinks to sector 10.
+ */
+#ifndef BL_JOURNAL_ENABLE
+#define BL_JOURNAL_ENABLE            0
+#endif
+
+/*
+ * BL_WEAR_STATS_ENABLE
+ * --------------------
+ * 1 -> the bootloader counts the erases of every flash sector and keeps the
+ *      totals in the session journal (BL_Journal.h), one entry per session;
+ *      BL_GET_WEAR_STATS reports them. Needs BL_JOURNAL_ENABLE.
+ */
+#ifndef BL_WEAR_STATS_ENABLE
+#define BL_WEAR_STATS_ENABLE         0
+#endif
+
+#if (BL_WEAR_STATS_ENABLE && !BL_JOURNAL_ENABLE)
+#error "BL_WEAR_STATS_ENABLE keeps its counts in the BL_JOURNAL_ENABLE sector"
+#endif
+
+/*
+ * BL_KV_ENABLE
+ * ------------
+ * 1 -> flash sectors 8 and 9 hold a key/value configuration store (BL_KV.h)
+ *      for the bootloader and, through the services table, the application;
+ *      the single application slot ends at sector 7 (link the UserApp with
+ *      STM32F407VGTX_FLASH_KV.ld). Not combined with BL_AB_SLOTS_ENABLE,
+ *      whose slot B covers those sectors.
+ */
+#ifndef BL_KV_ENABLE
+#define BL_KV_ENABLE                 0
+#endif
+
+#if (BL_KV_ENABLE && BL_AB_SLOTS_ENABLE)
+#error "BL_KV_ENABLE and BL_AB_SLOTS_ENABLE share flash sectors 8..9"
+#endif
+
+/*
+ * BL_TRACE_ENABLE
+ * ---------------
+ * 1 -> the bootloader records its events (frames, CRC checks, dispatch,
+ *      responses, flash program / erase) with DWT timestamps in a RAM ring of
+ *      the last BL_TRACE_DEPTH (power of two, 12 bytes each), read with
+ *      BL_GET_TRACE or a debugger (BL_Trace.h).
+ */
+#ifndef BL_TRACE_ENABLE
+#define BL_TRACE_ENABLE              0
+#endif
+
+#ifndef BL_TRACE_DEPTH
+#define BL_TRACE_DEPTH               256u
+#endif
+
+#if ((BL_TRACE_DEPTH & (BL_TRACE_DEPTH - 1u)) != 0u)
+#error "BL_TRACE_DEPTH must be a power of two"
+#endif
+
+/*
+ * BL_ITM_ENABLE
+ * -------------
+ * 1 -> bench profiling over SWO (PB3), leaving USART2 to the protocol: every
+ *      trace event is also written to ITM stimulus ports 1-3 and, with
+ *      BL_ITM_PC_SAMPLE_PERIOD, the DWT samples the PC every
+ *      1024 x BL_ITM_PC_SAMPLE_PERIOD cycles (1..16, 0 -> off). The SWO pin
+ *      runs NRZ at BL_ITM_SWO_BAUD; Host/tools/blswo decodes a capture.
+ *      Each event waits for room in the ITM FIFO: not for production builds.
+ */
+#ifndef BL_ITM_ENABLE
+#define BL_ITM_ENABLE                0
+#endif
+
+#ifndef BL_ITM_SWO_BAUD
+#define BL_ITM_SWO_BAUD              2000000u
+#endif
+
+#ifndef BL_ITM_PC_SAMPLE_PERIOD
+#define BL_ITM_PC_SAMPLE_PERIOD      4u
+#endif
+
+#if (BL_ITM_ENABLE && !BL_TRACE_ENABLE)
+#error "BL_ITM_ENABLE streams the trace events: it needs BL_TRACE_ENABLE"
+#endif
+
+#if (BL_ITM_PC_SAMPLE_PERIOD > 16u)
+#error "BL_ITM_PC_SAMPLE_PERIOD is 0 (off) or 1..16 (x 1024 cycles)"
+#endif
+
+/*
+ * BL_BENCH_ENABLE
+ * ---------------
+ * 1 -> microbenchmark firmware instead of the bootloader (the "Bench" build
+ *      configuration): main() times the CRC, flash program, copy and SHA-256
+ *      primitives of BL_Bench.h at the HSI profile and at 168 MHz HSE and
+ *      prints them over USART2. Erases BL_BENCH_FLASH_SECTOR; never boots.
+ */
+#ifndef BL_BENCH_ENABLE
+#define BL_BENCH_ENABLE              0
+#endif
+
+/*
+ * BL_STATS_ENABLE
+ * ---------------
+ * 1 -> every dispatched command is timed with the DWT cycle counter and
+ *      counted per opcode, BL_GET_STATS reports it with the link counters.
+ *      A few dozen cycles per command and 20 bytes of RAM per opcode.
+ */
+#ifndef BL_STATS_ENABLE
+#define BL_STATS_ENABLE              0
+#endif
+
+/*
+ * BL_PROGRESS_ENABLE
+ * ------------------
+ * 1 -> BL_SET_PROGRESS is supported: once a host asks for them, long erase
+ *      and program commands push rate-limited progress frames on USART2
+ *      ("Progress Frames" in BL.h). Off after every reset either way.
+ */
+#ifndef BL_PROGRESS_ENABLE
+#define BL_PROGRESS_ENABLE           0
+#endif
+
+/*
+ * BL_LINK_TEST_ENABLE
+ * -------------------
+ * 1 -> BL_ECHO and BL_SINK are supported ("Link Benchmark" in BL.h): the
+ *      link's own throughput in each direction, without the flash, for
+ *      characterising adapters, cables and baud rates.
+ */
+#ifndef BL_LINK_TEST_ENABLE
+#define BL_LINK_TEST_ENABLE          0
+#endif
+
+/*
+ * BL_SLOT_CACHE_ENABLE
+ * --------------------
+ * 1 -> while the link is idle, the block CRCs and the blank map of the
+ *      application slots are computed into CCMRAM ("Slot Scan Cache" in
+ *      BL_SlotCache.h), and BL_BLOCK_CRC_MANIFEST / BL_BLANK_MAP are answered
+ *      from there. About 1.3 KB of CCMRAM.
+ */
+#ifndef BL_SLOT_CACHE_ENABLE
+#define BL_SLOT_CACHE_ENABLE         0
+#endif
+
+#if (BL_SIGNATURE_ENABLE && !BL_SHA256_ENABLE)
+#error "BL_SIGNATURE_ENABLE signs the session's SHA-256: it needs BL_SHA256_ENABLE"
+#endif
+
+#if (BL_PACKAGE_ENABLE && (!BL_LZ_ENABLE || !BL_SHA256_ENABLE))
+#error "BL_PACKAGE_ENABLE decodes LZ segments and checks SHA-256 digests: it needs BL_LZ_ENABLE and BL_SHA256_ENABLE"
+#endif
+
+#if (BL_SELF_UPDATE_ENABLE && !BL_SHA256_ENABLE)
+#error "BL_SELF_UPDATE_ENABLE checks the staged bootloader's SHA-256: it needs BL_SHA256_ENABLE"
+#endif
+
+#if ((BL_ROLLBACK_OTP_BLOCKS == 0) || ((BL_ROLLBACK_OTP_BLOCK + BL_ROLLBACK_OTP_BLOCKS) > 16))
+#error "BL_ROLLBACK_OTP_BLOCK / BL_ROLLBACK_OTP_BLOCKS must name blocks of the 16 OTP blocks"
+#endif
+
+#if ((BL_DECRYPT_KEY_BITS != 128) && (BL_DECRYPT_KEY_BITS != 256))
+#error "BL_DECRYPT_KEY_BITS is 128 or 256"
+#endif
+
+
+#endif /* INC_BL_CONFIG_H_ */
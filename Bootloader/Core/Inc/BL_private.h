@@ -1,6 +1,9 @@
 #ifndef INC_BL_PRIVATE_H_
 #define INC_BL_PRIVATE_H_
 
+#include "BL_CRC.h"
+#include "BL_SHA256.h"
+
 /*
  * CRC Status Codes
  * ----------------
@@ -10,13 +13,6 @@
 #define CRC_SUCCESS    1u  /* CRC verification passed */
 #define CRC_FAIL       0u  /* CRC verification failed */
 
-/*
- * Bootloader Version
- * ------------------
- * Defines the current version of the Bootloader.
- */
-#define BL_VERSION     1u  /* Bootloader version 1 */
-
 
 /*
  * Address Validation Status
@@ -30,6 +26,118 @@
 #define NOT_VALID_ADDRESS            0u  /* Address is not valid */
 
 
+/*
+ * Memory Regions
+ * --------------
+ * Every memory the commands may touch is described once in a const table
+ * (Global_MemoryRegions, BL.c): base, size, what is allowed and how it is written.
+ * Validation, read, write and jump commands all go through pMemory_LookupRegion().
+ */
+#define BL_MEMORY_READ               0x01u  /* Readable by MEM_READ and friends */
+#define BL_MEMORY_WRITE              0x02u  /* Writable by MEM_WRITE and friends */
+#define BL_MEMORY_EXECUTE            0x04u  /* Valid BL_GO_TO_ADDR target */
+#define BL_MEMORY_DMA                0x08u  /* Reachable by the DMA controllers (zero-copy TX, CRC DMA) */
+#define BL_MEMORY_BACKUP             0x10u  /* Backup domain: clock and write access enabled on first use */
+
+#define BL_MEMORY_METHOD_NONE        0u     /* Read only */
+#define BL_MEMORY_METHOD_COPY        1u     /* Plain memcpy (RAM) */
+#define BL_MEMORY_METHOD_FLASH       2u     /* Flash programming (uint8_ProgramFlash) */
+
+typedef struct
+{
+	uint32_t Base;                          /* First address of the region */
+	uint32_t Size;                          /* Region size in bytes */
+	uint8_t  Access;                        /* BL_MEMORY_xxx flags */
+	uint8_t  Method;                        /* BL_MEMORY_METHOD_xxx */
+} BL_MemoryRegion_t;
+
+
+/*
+ * Session Record
+ * --------------
+ * Resume point of a programming session, kept in backup SRAM. Two slots are
+ * written alternately (Generation selects the newest valid one), so a reset
+ * in the middle of a save still leaves the previous record intact.
+ */
+#define BL_SESSION_RECORD_MAGIC      0x4E535342UL  /* "BSSN" */
+#define BL_SESSION_RECORD_SLOTS      2u
+
+typedef struct
+{
+	uint32_t Magic;                         /* BL_SESSION_RECORD_MAGIC */
+	uint32_t Generation;                    /* Incremented by every save */
+	uint32_t Base;                          /* Target range */
+	uint32_t Size;
+	uint32_t Written;                       /* Bytes written contiguously from Base */
+	uint32_t ErasedSectors;                 /* Global_uint16ErasedSectors */
+	BL_CRCStream_t Crc;                     /* Running image CRC / SHA-256 over those bytes */
+	BL_SHA256_t    Sha;
+	uint8_t  Counter[BL_SESSION_COUNTER_SIZE]; /* Initial counter block of a decrypting session */
+	uint32_t Decrypt;                       /* 1: the target range is AES-CTR ciphertext */
+	uint32_t RecordCrc;                     /* Word-wise CRC of every field above */
+} BL_SessionRecord_t;
+
+
+/*
+ * Delta Stream
+ * ------------
+ * State of the open BL_MEM_WRITE_DELTA stream (Global_DeltaStream, BL.c).
+ * The patch may be cut anywhere: a record header is gathered in Header until
+ * complete, a run continues with Remaining bytes in the next packet.
+ * With BL_DELTA_FLAG_THUMB the last rebuilt bytes that may start a BL pair
+ * wait in Hold until the pair is complete.
+ */
+#define BL_DELTA_HEADER_SIZE         12u    /* [diff length (4)] [extra length (4)] [seek (4)] */
+#define BL_DELTA_CHUNK_SIZE          64u    /* Diff bytes rebuilt per write, on the stack */
+
+#define BL_DELTA_STATE_CLOSED        0u
+#define BL_DELTA_STATE_HEADER        1u
+#define BL_DELTA_STATE_DIFF          2u
+#define BL_DELTA_STATE_EXTRA         3u
+
+typedef struct
+{
+	uint32_t Source;                        /* Installed image the patch applies to */
+	uint32_t SourceLength;
+	uint32_t SourceCursor;                  /* Offset in the source of the next diff byte */
+	uint32_t Target;                        /* Destination of the rebuilt image */
+	uint32_t TargetLength;
+	uint32_t Written;                       /* Bytes of the rebuilt image written */
+	uint32_t Remaining;                     /* Bytes left in the current diff / extra run */
+	uint32_t ExtraLength;                   /* Extra run of the current record */
+	int32_t  Seek;                          /* Source cursor move after the extra run */
+	uint8_t  Header[BL_DELTA_HEADER_SIZE];  /* Record header being gathered */
+	uint8_t  HeaderCount;
+	uint8_t  State;                         /* BL_DELTA_STATE_xxx */
+	uint8_t  Flags;                         /* BL_DELTA_FLAG_LZ / _THUMB of the START packet */
+	uint8_t  Held;                          /* Rebuilt bytes in Hold, not written yet */
+	uint8_t  Hold[4];                       /* Starting at offset Written - Held, which is even */
+} BL_DeltaStream_t;
+
+
+/*
+ * Command Table
+ * -------------
+ * One const entry per command code, indexed by (code - BL_COMMAND_BASE)
+ * (Global_Commands, BL.c). BL_voidDispatchCommand() verifies the frame CRC
+ * and the minimum payload length once, then calls the handler.
+ */
+#define BL_COMMAND_BASE              BL_GET_VESRION  /* Lowest command code */
+
+#define BL_COMMAND_FLAG_OWN_CRC      0x01u  /* The handler checks the frame CRC itself (custom failure reply) */
+#define BL_COMMAND_FLAG_NO_BATCH     0x02u  /* Several responses or own framing: not accepted in BL_BATCH */
+#define BL_COMMAND_FLAG_ENDS_BATCH   0x04u  /* Leaves the command loop or the baud rate: runs after the BL_BATCH reply */
+
+typedef void (*BL_CommandHandler_t)(uint8_t* copy_puint8CmdPacket);
+
+typedef struct
+{
+	BL_CommandHandler_t Handler;            /* NULL: unknown command, ignored */
+	uint16_t MinPayload;                    /* Bytes required after the command code, CRC excluded */
+	uint8_t  Flags;                         /* BL_COMMAND_FLAG_xxx */
+} BL_Command_t;
+
+
 /*
  * DBGMCU_IDCODE_REGISTER
  * -----------------------
@@ -90,9 +198,54 @@
 #define MASS_ERASE                    0XFF
 
 
+/*
+ * AUTO_ERASE_FIRST_SECTOR
+ * -----------------------
+ * Auto-erase never touches the sectors below the user application
+ * (sectors 0..1 hold the bootloader); writes into them are refused.
+ */
+#define AUTO_ERASE_FIRST_SECTOR       2u
+
+
+/*
+ * WRITE_COMBINE_LINE_SIZE
+ * -----------------------
+ * Size of the BL_MEM_WRITE staging line (one flash cache line: 4 words).
+ * Inside a programming session small or unaligned writes are gathered here
+ * and programmed a line at a time.
+ */
+#define WRITE_COMBINE_LINE_SIZE       16u
+
+
+/* Returned by uint8_ExecuteDifferentialWrite when flash must be erased first */
+#define DIFF_ERASE_REQUIRED           0xEEu
+
+
 #define WRITING_SUCCESS               1u
 #define WRITING_ERROR                 0u
 
+/* Write status replaced by this code, followed by the first differing address (BL_WRITE_VERIFY_ENABLE) */
+#define WRITE_VERIFY_ERROR            0xEDu
+
+
+/*
+ * STREAM_ACK_INTERVAL
+ * -------------------
+ * Number of in-order BL_MEM_WRITE_STREAM packets after which a cumulative
+ * ACK is sent. The host keeps up to twice this many packets in flight, so
+ * the RX ring must be able to hold that many full frames.
+ */
+#define STREAM_ACK_INTERVAL           2u
+
+
+/*
+ * Baud Rate Limits
+ */
+#define BAUD_MIN_RATE                1200u
+#define BAUD_MAX_ERROR_PERMILLE      20u     /* 2 % total error still samples correctly */
+#define VALID_BAUD_RATE              1u
+#define INVALID_BAUD_RATE            0u
+
 
 
 
@@ -104,30 +257,157 @@
  */
 /*==========================================================================================================*/
 
+/*
+ * uint32_CalculateCRC
+ * -------------------
+ * Computes the CRC of a byte array with the CRC unit, starting from its reset value.
+ */
+static uint32_t uint32_CalculateCRC(uint8_t* copy_puint8dataArr, uint16_t copy_uint16Length);
+
+
 /*
  * uint8VerifyCRC
  * --------------
  * Verifies the integrity of received data using CRC.
  *
  * @param copy_puint8dataArr   : Pointer to the data array to be verified.
- * @param copy_uint8Length     : Length of the data array in bytes.
+ * @param copy_uint16Length    : Length of the data array in bytes.
  * @param copy_uint32HostCRC   : Expected CRC value received from the Host.
  *
  * @return uint8_t: CRC verification result:
  *         - CRC_SUCCESS (if computed CRC matches expected CRC)
  *         - CRC_FAIL    (if computed CRC does not match)
  */
-static uint8_t uint8VerifyCRC(uint8_t* copy_puint8dataArr, uint8_t copy_uint8Length, uint32_t copy_uint32HostCRC);
+static uint8_t uint8VerifyCRC(uint8_t* copy_puint8dataArr, uint16_t copy_uint16Length, uint32_t copy_uint32HostCRC);
 
 
 /*
- * voidSendACK
- * -----------
- * Sends an Acknowledgment (ACK) response to the Host.
- *
- * @param copy_uint8ReplyLength : The length of the response data following the ACK.
+ * uint8_BuildAckHeader
+ * --------------------
+ * Writes [ACK][len] or [ACK][0x00][len16] into a buffer, returns the header length.
+ */
+static uint8_t uint8_BuildAckHeader(uint8_t* Copy_puint8Buffer, uint16_t copy_uint16ReplyLength);
+
+
+/*
+ * voidSendResponse
+ * ----------------
+ * Sends ACK header, payload and optional CRC as a single DMA transfer.
+ */
+static void voidSendResponse(uint8_t* Copy_puint8Payload, uint16_t Copy_uint16PayloadLength);
+
+
+/*
+ * uint16_FinishResponse
+ * ---------------------
+ * Adds the optional response CRC to a reply built in the TX buffer, returns its full length.
+ */
+static uint16_t uint16_FinishResponse(uint8_t* Copy_puint8Tx, uint16_t Copy_uint16Length);
+
+
+/*
+ * voidStartResponse
+ * -----------------
+ * Adds the optional response CRC to a reply built in the TX buffer and starts it.
+ */
+static void voidStartResponse(uint8_t* Copy_puint8Tx, uint16_t Copy_uint16Length);
+
+
+/*
+ * voidReportProgress
+ * ------------------
+ * Pushes a progress frame when enabled, the interval is up and USART2 is idle.
+ */
+static void voidReportProgress(uint8_t Copy_uint8Operation, uint8_t Copy_uint8Sector, uint32_t Copy_uint32Done, uint32_t Copy_uint32Total);
+
+
+/*
+ * voidReportEraseProgress
+ * -----------------------
+ * voidReportProgress of a sector range erased up to and including Copy_uint8Sector.
+ */
+static void voidReportEraseProgress(uint8_t Copy_uint8FirstSector, uint8_t Copy_uint8NumberofSectors, uint8_t Copy_uint8Sector);
+
+
+/*
+ * voidSendWriteStatus
+ * -------------------
+ * Replies a write status, or WRITE_VERIFY_ERROR and the first differing address.
+ */
+static void voidSendWriteStatus(uint8_t Copy_uint8Status);
+
+
+/*
+ * uint8_WriteRegion
+ * -----------------
+ * Checks the destination region and writes, write-combined to flash in a session.
+ */
+static uint8_t uint8_WriteRegion(uint8_t* Copy_Puint8Buffer, uint32_t Copy_uint32Address, uint16_t Copy_uint16Length);
+
+
+#if BL_DELTA_ENABLE
+/*
+ * uint8_ApplyDelta
+ * ----------------
+ * Runs patch bytes of the open BL_MEM_WRITE_DELTA stream, writing the rebuilt image.
+ */
+static uint8_t uint8_ApplyDelta(uint8_t* Copy_puint8Patch, uint16_t Copy_uint16Length);
+
+
+/*
+ * uint8_FilterBranchPair
+ * ----------------------
+ * Converts a Thumb-2 BL pair between relative and absolute target (BL_DELTA_FLAG_THUMB).
+ */
+static uint8_t uint8_FilterBranchPair(uint8_t* Copy_puint8Pair, uint32_t Copy_uint32Offset, uint8_t Copy_uint8Encode);
+
+
+/*
+ * voidReadDeltaSource
+ * -------------------
+ * Copies source bytes of the open delta stream, BL pairs filtered with BL_DELTA_FLAG_THUMB.
+ */
+static void voidReadDeltaSource(uint8_t* Copy_puint8Buffer, uint32_t Copy_uint32Offset, uint32_t Copy_uint32Length);
+
+
+/*
+ * uint8_WriteDeltaTarget
+ * ----------------------
+ * Writes rebuilt bytes at the end of the target, BL pairs unfiltered with BL_DELTA_FLAG_THUMB.
+ */
+static uint8_t uint8_WriteDeltaTarget(uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length);
+#endif
+
+
+/*
+ * uint16_ReadWriteProtection / uint8_ProgramWriteProtection
+ * ---------------------------------------------------------
+ * Write-protected sectors as a bitmap (bit n = sector n), and one option-byte
+ * cycle that protects / unprotects every sector of a mask.
+ */
+static uint16_t uint16_ReadWriteProtection(void);
+
+
+#if BL_READ_RLE_ENABLE
+/*
+ * uint16_EncodeReadRle
+ * --------------------
+ * Encodes the next BL_MEM_READ_FLAG_RLE records of a read, at most Copy_uint16Capacity bytes.
  */
-static void voidSendACK(uint8_t copy_uint8ReplyeLngth);
+static uint16_t uint16_EncodeReadRle(uint8_t* Copy_puint8Out, uint16_t Copy_uint16Capacity,
+                                     const uint8_t** Copy_ppuint8Data, uint32_t* Copy_puint32Remaining);
+#endif
+
+static uint8_t uint8_ProgramWriteProtection(uint16_t Copy_uint16SectorMask, uint32_t Copy_uint32State);
+
+
+/*
+ * uint32_CalculateFrameCRC
+ * ------------------------
+ * Frame CRC (uint32_CalculateCRC convention) of a header and data held in two buffers.
+ */
+static uint32_t uint32_CalculateFrameCRC(const uint8_t* Copy_puint8Header, uint16_t Copy_uint16HeaderLength,
+                                         const uint8_t* Copy_puint8Data, uint16_t Copy_uint16DataLength);
 
 
 /*
@@ -140,22 +420,421 @@ static void voidSendNACK(void);
 
 
 /*
- * uint8_ValidateAddress
+ * uint8_VerifyFrameCRC
+ * --------------------
+ * CRC check of a whole received frame, reusing the receive interrupt's result.
+ */
+static uint8_t uint8_VerifyFrameCRC(uint8_t* copy_puint8CmdPacket);
+
+
+/*
+ * uint16_GetFrameLength
+ * ---------------------
+ * Returns the total length of a received v1 or extended frame, CRC included.
+ */
+static uint16_t uint16_GetFrameLength(uint8_t* copy_puint8CmdPacket);
+
+
+/*
+ * puint8_GetFramePayload
  * ----------------------
- * Validates whether a given memory address falls within the permissible memory regions
- * (Flash or SRAM).
+ * Returns a pointer to the first byte following the command code.
+ */
+static uint8_t* puint8_GetFramePayload(uint8_t* copy_puint8CmdPacket);
+
+
+/*
+ * pCommand_Lookup
+ * ---------------
+ * Command table entry of a frame's command code, NULL if unknown.
+ */
+static const BL_Command_t* pCommand_Lookup(uint8_t* copy_puint8CmdPacket);
+
+
+/*
+ * uint16_GetFramePayloadLength
+ * ----------------------------
+ * Number of bytes between the command code and the CRC of a frame.
  */
-static uint8_t uint8_ValidateAddress(uint32_t Copy_uint32Address);
+static uint16_t uint16_GetFramePayloadLength(uint8_t* copy_puint8CmdPacket);
+
+
+/*
+ * uint32_GetField / uint16_GetField
+ * ---------------------------------
+ * Little-endian field of a frame, read without an unaligned access.
+ */
+static uint32_t uint32_GetField(const uint8_t* copy_puint8Field);
+static uint16_t uint16_GetField(const uint8_t* copy_puint8Field);
+
+
+/*
+ * uint8_GetCapturedStatus
+ * -----------------------
+ * Status of a response captured in the TX buffer (first payload byte,
+ * BL_ACK for an empty reply, BL_NACK for a NACK or no reply).
+ */
+static uint8_t uint8_GetCapturedStatus(void);
+
+
+/*
+ * voidRunBatch
+ * ------------
+ * Runs the batch payload in [batch, end) and sends the BL_BATCH reply.
+ */
+static void voidRunBatch(uint8_t* Copy_puint8Batch, uint8_t* Copy_puint8End);
+
+
+/*
+ * uint8_RangeIsBlank
+ * ------------------
+ * BL_uint8FlashRangeIsBlank, answered from the slot cache where it can.
+ */
+static uint8_t uint8_RangeIsBlank(uint32_t Copy_uint32Address, uint32_t Copy_uint32Length);
+
+
+/*
+ * pMemory_LookupRegion
+ * --------------------
+ * Region holding the whole of [address, address + length) with all the
+ * requested BL_MEMORY_xxx flags, NULL otherwise.
+ */
+static const BL_MemoryRegion_t* pMemory_LookupRegion(uint32_t Copy_uint32Address, uint32_t Copy_uint32Length, uint8_t Copy_uint8Access);
 
 
 /*
  * uint8_tExecute_FlashErase
  * -------------------------
  * Performs a flash erase operation on a specified sector or the entire flash memory.
+ * Sectors found blank are skipped and reported in *Copy_puint16BlankSectors.
+ */
+static uint8_t uint8_tExecute_FlashErase(uint8_t Copy_uint8SectorNumber ,uint8_t Copy_uint8NumberofSectors, uint16_t* Copy_puint16BlankSectors);
+
+
+/*
+ * uint8_ExecutePlannedErase
+ * -------------------------
+ * BL_ERASE_FLAG_PLAN: erases the requested sectors that are not write
+ * protected, going on after a failure, one BL_ERASE_SECTOR_xxx result per sector.
  */
-static uint8_t uint8_tExecute_FlashErase(uint8_t Copy_uint8SectorNumber ,uint8_t Copy_uint8NumberofSectors);
+static uint8_t uint8_ExecutePlannedErase(uint8_t Copy_uint8SectorNumber, uint8_t Copy_uint8NumberofSectors, uint8_t* Copy_puint8Results);
+
 
-static uint8_t uint8_ExecuteMemoryWrite(uint8_t* Copy_Puint8Buffer ,uint32_t Copy_uint32Address ,uint8_t Copy_uint8Length);
+/*
+ * voidRecordErasedSectors
+ * -----------------------
+ * Adds freshly erased sectors to Global_uint16ErasedSectors (and the journal).
+ */
+static void voidRecordErasedSectors(uint16_t Copy_uint16Sectors);
+
+static uint8_t uint8_ExecuteMemoryWrite(uint8_t* Copy_Puint8Buffer ,uint32_t Copy_uint32Address ,uint16_t Copy_uint16Length);
+
+
+/*
+ * uint8_ProgramFlash
+ * ------------------
+ * Programs a flash range sector piece by piece: waits for a background erase, RTS busy, unlock, program, lock.
+ */
+static uint8_t uint8_ProgramFlash(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Address, uint16_t Copy_uint16Length);
+
+
+/*
+ * uint8_CheckSectorPieces
+ * -----------------------
+ * Every sector a flash write touches exists and is not write protected.
+ */
+static uint8_t uint8_CheckSectorPieces(uint32_t Copy_uint32Address, uint16_t Copy_uint16Length);
+
+
+/*
+ * uint8_CombineWrite
+ * ------------------
+ * Write-combining BL_MEM_WRITE to flash: whole lines are programmed at once,
+ * a partial trailing line waits in the staging buffer for the next write.
+ */
+static uint8_t uint8_CombineWrite(uint8_t* Copy_Puint8Buffer, uint32_t Copy_uint32Address, uint16_t Copy_uint16Length);
+
+
+/*
+ * uint8_FlushWriteBuffer
+ * ----------------------
+ * Programs the bytes waiting in the staging buffer, returns HAL_OK / HAL_ERROR.
+ */
+static uint8_t uint8_FlushWriteBuffer(void);
+
+
+/*
+ * uint8_AutoErase
+ * ---------------
+ * Erases every sector touched by [address, address + length) that was not
+ * erased yet in this stream, and records it in the erased-sector bitmap.
+ */
+static uint8_t uint8_AutoErase(uint32_t Copy_uint32Address, uint16_t Copy_uint16Length);
+
+
+/*
+ * uint8_ExecuteDifferentialWrite
+ * ------------------------------
+ * Programs only the flash words that differ from the buffer; reports
+ * DIFF_ERASE_REQUIRED, without writing, if any bit would have to go 0 -> 1.
+ */
+static uint8_t uint8_ExecuteDifferentialWrite(uint8_t* Copy_Puint8Buffer, uint32_t Copy_uint32Address, uint16_t Copy_uint16Length);
+
+
+/*
+ * voidFlashUnlock / voidFlashLock
+ * -------------------------------
+ * Unlock / lock around one flash operation; no-ops while a programming
+ * session keeps the flash unlocked.
+ */
+static void voidFlashUnlock(void);
+static void voidFlashLock(void);
+
+
+/*
+ * voidCloseSession
+ * ----------------
+ * Ends the programming session and relocks the flash.
+ */
+static void voidCloseSession(void);
+
+
+/*
+ * voidTrackImageWrite
+ * -------------------
+ * Adds written payload bytes to the session's running image CRC (BL_COMMIT).
+ */
+static void voidTrackImageWrite(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Address, uint16_t Copy_uint16Length);
+
+
+#if BL_DECRYPT_ENABLE
+/*
+ * voidDecryptPayload
+ * ------------------
+ * Deciphers in place the part of a write payload inside a decrypting session's target range.
+ */
+static void voidDecryptPayload(uint8_t* Copy_puint8Data, uint32_t Copy_uint32Address, uint16_t Copy_uint16Length);
+#endif
+
+
+/*
+ * uint32_GetFeatures
+ * ------------------
+ * BL_FEATURE_xxx flags of this build and of the current modes.
+ */
+static uint32_t uint32_GetFeatures(void);
+
+
+#if BL_LZ_ENABLE
+/*
+ * uint32_GetLzRate
+ * ----------------
+ * Output bytes per second of the last BL_MEM_WRITE_LZ stream for a cycle total.
+ */
+static uint32_t uint32_GetLzRate(uint64_t Copy_uint64Cycles);
+#endif
+
+
+/*
+ * voidEnableBackupSram
+ * --------------------
+ * Clocks the backup SRAM and enables write access to the backup domain.
+ */
+static void voidEnableBackupSram(void);
+
+
+/*
+ * voidSaveSessionRecord
+ * ---------------------
+ * Saves the resume point of the session in the older backup SRAM slot.
+ */
+static void voidSaveSessionRecord(void);
+
+
+/*
+ * pSession_LoadRecord
+ * -------------------
+ * Newest valid session record in backup SRAM, NULL if none.
+ */
+static const BL_SessionRecord_t* pSession_LoadRecord(void);
+
+
+/*
+ * voidClearSessionRecord
+ * ----------------------
+ * Invalidates both backup SRAM slots.
+ */
+static void voidClearSessionRecord(void);
+
+
+#if BL_JOURNAL_ENABLE
+/*
+ * voidJournalProgress
+ * -------------------
+ * Copies the newest session record into the flash journal, once per step.
+ */
+static void voidJournalProgress(void);
+#endif
+
+
+/*
+ * voidStartEraseJob
+ * -----------------
+ * Starts a background erase of consecutive sectors (BL_ERASE_FLAG_ASYNC).
+ */
+static void voidStartEraseJob(uint8_t Copy_uint8FirstSector, uint8_t Copy_uint8NumberofSectors);
+
+
+/*
+ * voidStepEraseJob
+ * ----------------
+ * Advances the background erase by at most one sector start.
+ */
+static void voidStepEraseJob(void);
+
+
+/*
+ * voidFinishEraseJob
+ * ------------------
+ * Runs the background erase to its end, used before any flash access.
+ */
+static void voidFinishEraseJob(void);
+
+
+/*
+ * voidSendEraseReply
+ * ------------------
+ * Sends the BL_FLASH_ERASE / BL_ERASE_RANGE reply: status + blank-skipped bitmap.
+ */
+static void voidSendEraseReply(uint8_t Copy_uint8Status, uint16_t Copy_uint16BlankSectors);
+
+
+/*
+ * voidRunPlannedErase
+ * -------------------
+ * BL_FLASH_ERASE / BL_ERASE_RANGE with BL_ERASE_FLAG_PLAN: erase and
+ * [status] [per-sector results] reply.
+ */
+static void voidRunPlannedErase(uint8_t Copy_uint8FirstSector, uint8_t Copy_uint8NumberofSectors);
+
+
+/*
+ * uint32_EstimateEraseMs
+ * ----------------------
+ * Expected erase time of one sector: measured mean, else datasheet typical.
+ */
+static uint32_t uint32_EstimateEraseMs(uint8_t Copy_uint8Sector);
+
+
+/*
+ * uint8_PlanImageErase
+ * --------------------
+ * BL_ERASE_FOR_IMAGE: per-sector plan and erase time estimate, flash unchanged.
+ */
+static uint8_t uint8_PlanImageErase(uint8_t Copy_uint8SectorNumber, uint8_t Copy_uint8NumberofSectors, uint8_t* Copy_puint8Results, uint32_t* Copy_puint32EstimateMs);
+
+
+/*
+ * voidSendStreamStatus
+ * --------------------
+ * Sends a BL_MEM_WRITE_STREAM response: status byte + next expected sequence number
+ * (+ received bitmap and failed offset in a selective stream).
+ */
+static void voidSendStreamStatus(uint8_t Copy_uint8Status, uint16_t Copy_uint16NextSeq, uint8_t Copy_uint8FailedOffset);
+
+
+/*
+ * uint8_AdvanceStreamWindow
+ * -------------------------
+ * Selective stream: steps "next sequence" over the packets already written.
+ */
+static uint8_t uint8_AdvanceStreamWindow(void);
+
+
+/*
+ * uint8_ValidateBaudRate
+ * ----------------------
+ * Checks that USART2 can generate the requested baud rate from the current
+ * PCLK1 with 16x oversampling, within BAUD_MAX_ERROR_PERMILLE.
+ */
+static uint8_t uint8_ValidateBaudRate(uint32_t Copy_uint32BaudRate);
+
+
+/*
+ * uint8_CheckVectorTable
+ * ----------------------
+ * BL_GO_FLAG_VECTOR_TABLE: aligned table, MSP in SRAM / CCMRAM, executable Thumb reset handler.
+ */
+static uint8_t uint8_CheckVectorTable(uint32_t Copy_uint32Base);
+
+
+/*
+ * uint8_CheckLoader
+ * -----------------
+ * BL_GO_FLAG_LOADER: table in the RAM run area with a BL_LoaderHeader_t this ABI accepts, USART2 link.
+ */
+static uint8_t uint8_CheckLoader(uint32_t Copy_uint32Base);
+
+
+/*
+ * BL_CommandStats_t
+ * -----------------
+ * Dispatch statistics of one opcode (BL_GET_STATS), indexed like the command table.
+ */
+typedef struct
+{
+	uint64_t TotalCycles;
+	uint32_t Count;
+	uint32_t MaxCycles;
+	uint32_t Nacks;                         /* Answered by a NACK: CRC, length or handler refusal */
+} BL_CommandStats_t;
+
+
+#if BL_STATS_ENABLE
+/*
+ * voidRecordCommand
+ * -----------------
+ * Adds one dispatch of command table entry Copy_uint8Index, started at DWT
+ * cycle Copy_uint32Start, to its statistics.
+ */
+static void voidRecordCommand(uint8_t Copy_uint8Index, uint32_t Copy_uint32Start);
+#endif
+
+
+#if BL_TRANSPORT_CAN_ENABLE || BL_RS485_ENABLE
+/*
+ * uint32_GetUidBits
+ * -----------------
+ * Bits of the unique ID from a bit index on, MSB first, right-aligned (BL_DISCOVER).
+ */
+static uint32_t uint32_GetUidBits(const uint8_t* Copy_puint8Uid, uint8_t Copy_uint8First, uint8_t Copy_uint8Count);
+
+
+/*
+ * uint32_GetNextUidBits
+ * ---------------------
+ * The bits after a discovery prefix, left-aligned in a fixed width.
+ */
+static uint32_t uint32_GetNextUidBits(const uint8_t* Copy_puint8Uid, uint8_t Copy_uint8Bits, uint8_t Copy_uint8Width);
+#endif
+
+
+/*
+ * uint8_UidMatches
+ * ----------------
+ * 1 when the unique ID starts with the given bit prefix.
+ */
+static uint8_t uint8_UidMatches(const uint8_t* Copy_puint8Uid, const uint8_t* Copy_puint8Prefix, uint8_t Copy_uint8Bits);
+
+
+#if BL_PACKAGE_ENABLE
+/*
+ * uint8_ErasePackagePlan
+ * ----------------------
+ * Erases the plan of a BL_MEM_WRITE_PACKAGE manifest, refused whole if one sector may not be erased.
+ */
+static uint8_t uint8_ErasePackagePlan(uint32_t Copy_uint32Sectors);
+#endif
 
 
 #endif /* INC_BL_PRIVATE_H_ */
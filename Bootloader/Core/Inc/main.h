@@ -32,6 +32,7 @@ extern "C" {
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "BL_config.h"
 
 /* USER CODE END Includes */
 
@@ -56,6 +57,13 @@ void Error_Handler(void);
 /* USER CODE BEGIN EFP */
 void Bootloader_UartReadData(void);
 void Bootloader_JumpToUserApp(void);
+void Bootloader_JumpToImage(uint32_t Copy_uint32Base);
+void Bootloader_JumpToLoader(uint32_t Copy_uint32Base);
+uint8_t Bootloader_FastBootAllowed(uint8_t Copy_uint8IgnoreButton);
+uint8_t Bootloader_TakeUpdateRequest(void);
+void Bootloader_TrialStart(void);
+uint8_t Bootloader_HandoffAllowed(void);
+void Bootloader_LeaveUpdateMode(uint8_t Copy_uint8Reset) __attribute__((noreturn));
 /* USER CODE END EFP */
 
 /* Private defines -----------------------------------------------------------*/
@@ -127,6 +135,41 @@ void Bootloader_JumpToUserApp(void);
 #define MEMS_INT2_GPIO_Port GPIOE
 /* USER CODE BEGIN Private defines */
 
+/*
+ * BL_CCMRAM / BL_CCMRAM_DATA
+ * --------------------------
+ * Place a variable in the 64 KB CCMRAM: .ccmbss (zeroed by the startup) or
+ * .ccmram (initialized from flash). Zero wait states, and no contention with
+ * the UART / SPI / CRC DMA streams on SRAM1 / SRAM2, but the DMA controllers
+ * cannot reach it: only for state the CPU alone touches. _Stack_In_CCMRAM in
+ * the linker script moves the main stack there as well.
+ */
+#define BL_CCMRAM                    __attribute__((section(".ccmbss")))
+#define BL_CCMRAM_DATA               __attribute__((section(".ccmram")))
+
+/*
+ * BL_DMA_RAM
+ * ----------
+ * A buffer a DMA stream reads or writes (UART / SPI rings, TX buffers):
+ * .bss.dma, linked first in .bss, at the bottom of SRAM1 and away from the
+ * RAM run area the uploads are written to. Still zeroed with .bss. Everything
+ * the CPU alone touches that is large or hot goes to CCMRAM instead.
+ */
+#define BL_DMA_RAM                   __attribute__((section(".bss.dma")))
+
+/*
+ * BL_RAM_BUDGET / BL_DMA_RAM_BUDGET / BL_CCMRAM_BUDGET
+ * ----------------------------------------------------
+ * The same placements (SRAM1, .bss.dma, CCMRAM), charged to one of the RAM
+ * budgets of the FLASH linker script: "rx", "staging", "codec" or "trace".
+ * Each budget's buffers are linked together and the link fails once they
+ * outgrow it, so one feature cannot quietly take the RAM another was sized
+ * with. Other linker scripts link them with the rest of their region.
+ */
+#define BL_RAM_BUDGET(NAME)          __attribute__((section(".bss.budget." NAME)))
+#define BL_DMA_RAM_BUDGET(NAME)      __attribute__((section(".bss.dma.budget." NAME)))
+#define BL_CCMRAM_BUDGET(NAME)       __attribute__((section(".ccmbss.budget." NAME)))
+
 /* USER CODE END Private defines */
 
 #ifdef __cplusplus
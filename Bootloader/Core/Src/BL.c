@@ -1,12 +1,388 @@
 
 #include <stdio.h>
+#include <stddef.h>
+#include <string.h>
 #include "BL.h"
 #include "main.h"
 #include "BL_private.h"
+#include "BL_Transport.h"
+#include "BL_Flash.h"
+#include "BL_CRC.h"
+#include "BL_SHA256.h"
+#include "BL_Image.h"
+#include "BL_P256.h"
+#include "BL_AES.h"
+#include "BL_LZ.h"
+#include "BL_Package.h"
+#include "BL_Handoff.h"
+#include "BL_Loader.h"
+#include "BL_Journal.h"
+#include "BL_Trace.h"
+#include "BL_SlotCache.h"
+#include "BL_Port.h"
+#include "MemoryUsage.h"
+#if BL_TRANSPORT_CAN_ENABLE
+#include "BL_CAN.h"
+#endif
 
 
-extern CRC_HandleTypeDef hcrc;
-extern UART_HandleTypeDef huart2;
+/*
+ * Streaming write state
+ * ---------------------
+ * Global_uint16StreamNextSeq   : Sequence number of the next packet to be written.
+ * Global_uint8StreamUnacked    : In-order packets written since the last cumulative ACK.
+ * Global_uint8StreamNackSent   : A RETRANSMIT for Global_uint16StreamNextSeq is outstanding,
+ *                                later out-of-order packets are dropped silently until it arrives.
+ * Global_uint8StreamAutoErase  : The stream was started with BL_STREAM_FLAG_AUTO_ERASE.
+ * Global_uint8StreamDiff       : The stream was started with BL_STREAM_FLAG_DIFFERENTIAL.
+ * Global_uint8StreamSelective  : The stream was started with BL_STREAM_FLAG_SELECTIVE.
+ * Global_uint32StreamReceived  : Selective: bit n set, packet "next sequence" + n is written.
+ * Global_uint32StreamSlotAddress / Global_uint16StreamSlotLength :
+ *                                Selective: where each packet of the window was written
+ *                                (slot = sequence % BL_STREAM_SELECTIVE_WINDOW), to add it to
+ *                                the image CRC / SHA-256 in sequence order.
+ */
+static uint16_t Global_uint16StreamNextSeq;
+static uint8_t  Global_uint8StreamUnacked;
+static uint8_t  Global_uint8StreamNackSent;
+static uint8_t  Global_uint8StreamAutoErase;
+static uint8_t  Global_uint8StreamDiff;
+static uint8_t  Global_uint8StreamSelective;
+static uint32_t Global_uint32StreamReceived;
+static uint32_t Global_uint32StreamSlotAddress[BL_STREAM_SELECTIVE_WINDOW];
+static uint16_t Global_uint16StreamSlotLength[BL_STREAM_SELECTIVE_WINDOW];
+
+/*
+ * Global_uint16ErasedSectors
+ * --------------------------
+ * Bit n set: sector n has been erased and not auto-erased again since.
+ * Set by BL_FLASH_ERASE and by auto-erase, cleared when an auto-erase stream
+ * starts (the previous image may occupy the sectors).
+ */
+static uint16_t Global_uint16ErasedSectors;
+
+/*
+ * Background erase job (BL_ERASE_FLAG_ASYNC)
+ * ------------------------------------------
+ * Global_uint8EraseState       : BL_ERASE_IDLE / _RUNNING / _DONE / _FAILED.
+ * Global_uint8EraseNextSector  : Sector being erased, or the next one to erase.
+ * Global_uint8EraseDone        : Sectors finished (erased or skipped as blank).
+ * Global_uint8EraseTotal       : Sectors requested.
+ * Global_uint16EraseBlank      : Sectors skipped because they were already blank.
+ * Global_uint8EraseInFlight    : An erase was started and its interrupt is awaited.
+ */
+static uint8_t  Global_uint8EraseState = BL_ERASE_IDLE;
+static uint8_t  Global_uint8EraseNextSector;
+static uint8_t  Global_uint8EraseDone;
+static uint8_t  Global_uint8EraseTotal;
+static uint16_t Global_uint16EraseBlank;
+static uint8_t  Global_uint8EraseInFlight;
+
+/*
+ * Programming session (BL_BEGIN_PROGRAM / BL_END_PROGRAM)
+ * -------------------------------------------------------
+ * Global_uint8SessionOpen      : The flash is kept unlocked.
+ * Global_uint32SessionIdleMs   : Milliseconds since the last flash operation, counted by SysTick.
+ * Global_uint8SessionExpired   : Timeout reached, the command loop closes the session.
+ */
+static volatile uint8_t  Global_uint8SessionOpen;
+static volatile uint32_t Global_uint32SessionIdleMs;
+static volatile uint8_t  Global_uint8SessionExpired;
+
+/*
+ * Write-combining staging line (BL_MEM_WRITE inside a programming session)
+ * ------------------------------------------------------------------------
+ * Global_uint8CombineLine      : Data of one WRITE_COMBINE_LINE_SIZE aligned flash line.
+ * Global_uint32CombineBase     : Address of the line.
+ * Global_uint8CombineStart     : Offset of the first pending byte in the line.
+ * Global_uint8CombineEnd       : Offset after the last pending byte (Start == End: empty).
+ * Global_uint8CombineStatus    : HAL_ERROR latched by a failed flush until BL_END_PROGRAM.
+ */
+static uint8_t  Global_uint8CombineLine[WRITE_COMBINE_LINE_SIZE] __attribute__((aligned(4))) BL_CCMRAM_BUDGET("staging");
+static uint32_t Global_uint32CombineBase;
+static uint8_t  Global_uint8CombineStart;
+static uint8_t  Global_uint8CombineEnd;
+static uint8_t  Global_uint8CombineStatus = HAL_OK;
+
+/*
+ * Global_ImageCrc / Global_ImageSha
+ * ---------------------------------
+ * Running word-wise CRC and SHA-256 of every payload byte written in the
+ * programming session, in the order written; checked by BL_COMMIT.
+ * Updated for every payload byte: in CCMRAM, off the bus the DMA streams use.
+ */
+static BL_CRCStream_t Global_ImageCrc BL_CCMRAM_DATA = { 0xFFFFFFFFUL, 0u, { 0u }, 0u };
+static BL_SHA256_t    Global_ImageSha BL_CCMRAM;
+
+/*
+ * Resumable session (BL_BEGIN_PROGRAM with a target range, BL_RESUME_SESSION)
+ * ---------------------------------------------------------------------------
+ * Global_uint8SessionResumable : The session has a target range and a valid resume point.
+ * Global_uint8SessionResumed   : Reopened by BL_RESUME_SESSION, auto-erase streams keep the bitmap.
+ * Global_uint32SessionBase / Size : Target range.
+ * Global_uint32SessionWritten  : Bytes written contiguously from the base.
+ * Global_uint32SessionGeneration : Generation of the last record saved.
+ * Global_SessionRecords        : The two record slots, at the start of backup SRAM.
+ */
+static uint8_t  Global_uint8SessionResumable;
+static uint8_t  Global_uint8SessionResumed;
+static uint32_t Global_uint32SessionBase;
+static uint32_t Global_uint32SessionSize;
+static uint32_t Global_uint32SessionWritten;
+static uint32_t Global_uint32SessionGeneration;
+static BL_SessionRecord_t* const Global_SessionRecords = (BL_SessionRecord_t*)BKPSRAM_BASE;
+
+#if BL_JOURNAL_ENABLE
+/* Global_uint32JournalWritten : Prefix length of the last PROGRESS journal entry */
+static uint32_t Global_uint32JournalWritten;
+#endif
+
+#if BL_SIGNATURE_ENABLE
+/*
+ * Global_uint8SigningKey
+ * ----------------------
+ * ECDSA-P256 public key of the update signer, X || Y big endian (BL_P256.h).
+ * Placeholder: replace with the production key before enabling
+ * BL_SIGNATURE_ENABLE ("openssl ec -pubout -outform DER", last 64 bytes).
+ */
+static const uint8_t Global_uint8SigningKey[BL_P256_KEY_SIZE] = { 0u };
+#endif
+
+/*
+ * Encrypted session (BL_BEGIN_PROGRAM with a counter block)
+ * ---------------------------------------------------------
+ * Global_uint8SessionDecrypt   : The target range of the session is AES-CTR ciphertext.
+ * Global_uint8SessionCounter   : Initial counter block, keystream byte 0 at Global_uint32SessionBase.
+ */
+static uint8_t  Global_uint8SessionDecrypt;
+static uint8_t  Global_uint8SessionCounter[BL_SESSION_COUNTER_SIZE];
+
+#if BL_DECRYPT_ENABLE
+/*
+ * Global_uint8ImageKey
+ * --------------------
+ * AES key of encrypted updates (BL_DECRYPT_KEY_BITS), expanded into
+ * Global_ImageAes by every decrypting BL_BEGIN_PROGRAM.
+ * Placeholder: replace with the production key before enabling
+ * BL_DECRYPT_ENABLE, and keep the bootloader sectors read-protected (RDP).
+ */
+static const uint8_t Global_uint8ImageKey[BL_DECRYPT_KEY_BITS / 8] = { 0u };
+
+static BL_AES_t Global_ImageAes;
+#endif
+
+/* BL_FRAME_CRC_ON / BL_FRAME_CRC_OFF, set by BL_SET_FRAME_CRC */
+static uint8_t  Global_uint8FrameCrcMode = BL_FRAME_CRC_ON;
+
+/*
+ * Global_uint32VerifyFailAddress
+ * ------------------------------
+ * First address whose read-back differed (BL_WRITE_VERIFY_ENABLE), kept
+ * until a write status reply reports it. BL_FLASH_VERIFY_OK when none.
+ */
+static uint32_t Global_uint32VerifyFailAddress = BL_FLASH_VERIFY_OK;
+
+/* Result of the last BL_MEM_WRITE_POSTED packet, sent in the reply to the next one */
+static uint8_t  Global_uint8PostedWriteStatus = HAL_OK;
+
+#if BL_PROGRESS_ENABLE
+/*
+ * Global_uint16ProgressInterval
+ * -----------------------------
+ * Milliseconds between progress frames (BL_SET_PROGRESS, 0 = off), the
+ * HAL_GetTick of the last one sent, and its buffer: DMA-read, so it is only
+ * refilled once USART2 is idle again.
+ */
+static uint16_t Global_uint16ProgressInterval;
+static uint32_t Global_uint32ProgressTick;
+static uint8_t  Global_uint8ProgressFrame[2u + BL_PROGRESS_PAYLOAD_SIZE + 4u] BL_DMA_RAM;
+#endif
+
+#if BL_LZ_ENABLE
+/*
+ * Global_LzStream
+ * ---------------
+ * Decoder of the open BL_MEM_WRITE_LZ stream (its 4 KB window is the only
+ * buffer, in CCMRAM), the address its next output byte goes to, and whether
+ * a stream is open at all.
+ */
+static BL_LZ_t  Global_LzStream BL_CCMRAM_BUDGET("codec");
+static uint32_t Global_uint32LzAddress;
+static uint8_t  Global_uint8LzOpen;
+
+/* DWT cycles spent decoding / writing the current (or last) LZ stream, and its output bytes */
+static uint64_t Global_uint64LzDecodeCycles;
+static uint64_t Global_uint64LzWriteCycles;
+static uint32_t Global_uint32LzDecoded;
+#endif
+
+/* Frames failing their CRC, and whether the command being dispatched was answered by a NACK (BL_GET_STATS) */
+static uint32_t Global_uint32CrcFailures;
+static uint8_t  Global_uint8CommandNacked;
+
+#if BL_LINK_TEST_ENABLE
+/* BL_SINK counters since the last BL_SINK_FLAG_RESET, and its HAL_GetTick */
+static uint32_t Global_uint32SinkFrames;
+static uint32_t Global_uint32SinkBytes;
+static uint32_t Global_uint32SinkCrcErrors;
+static uint32_t Global_uint32SinkStart;
+#endif
+
+#if BL_DELTA_ENABLE
+/* Open BL_MEM_WRITE_DELTA stream, BL_DELTA_STATE_CLOSED when none */
+static BL_DeltaStream_t Global_DeltaStream BL_CCMRAM_BUDGET("codec");
+#endif
+
+#if BL_PACKAGE_ENABLE
+/*
+ * Global_Package
+ * --------------
+ * Decoder of the open BL_MEM_WRITE_PACKAGE package (manifest and one block,
+ * in CCMRAM), the package offset of its next byte, and whether one is open.
+ */
+static BL_Package_t Global_Package BL_CCMRAM_BUDGET("staging");
+static uint32_t Global_uint32PackageOffset;
+static uint8_t  Global_uint8PackageOpen;
+#endif
+
+/* Datasheet typical sector erase times (ms), by BL_FLASH_CLASS_xxx, at x8 / x16 / x32 parallelism */
+static const uint16_t Global_uint16EraseTypicalMs[BL_FLASH_CLASS_COUNT][3] =
+{
+	{  400u,  300u,  250u },
+	{ 1200u,  700u,  550u },
+	{ 2000u, 1100u, 1000u },
+};
+
+
+/* Supported bootloader commands, sent by BL_GET_HELP and BL_GET_DEVICE_INFO */
+static const uint8_t Global_uint8SupportedCommands[] =
+{
+	BL_GET_VESRION            ,
+	BL_GET_HELP               ,
+	BL_GET_CID                ,
+	BL_GET_RDP_STATUS         ,
+	BL_GO_TO_ADDR             ,
+	BL_FLASH_ERASE            ,
+	BL_MEM_WRITE              ,
+	BL_EN_RW_PROTECT          ,
+	BL_MEM_READ               ,
+	BL_READ_SECTOR_STATUS     ,
+	BL_OTP_READ               ,
+	BL_DIS_WR_PROTECT         ,
+	BL_MEM_WRITE_STREAM       ,
+	BL_CHANGE_BAUD            ,
+	BL_MEM_COMPARE            ,
+	BL_FLASH_ERASE_STATUS     ,
+	BL_MEM_WRITE_POSTED       ,
+	BL_BEGIN_PROGRAM          ,
+	BL_END_PROGRAM            ,
+	BL_ERASE_RANGE            ,
+	BL_VERIFY_RANGE           ,
+	BL_COMMIT                 ,
+	BL_BLOCK_CRC_MANIFEST     ,
+	BL_SET_FRAME_CRC          ,
+	BL_GET_DEVICE_INFO        ,
+	BL_READ_MULTI             ,
+	BL_BLANK_MAP              ,
+	BL_BATCH                  ,
+	BL_RESUME_SESSION         ,
+	BL_GET_CAPABILITIES       ,
+	BL_SET_FRAMING            ,
+#if BL_LZ_ENABLE
+	BL_MEM_WRITE_LZ           ,
+#endif
+#if BL_DELTA_ENABLE
+	BL_MEM_WRITE_DELTA        ,
+#endif
+#if BL_PACKAGE_ENABLE
+	BL_MEM_WRITE_PACKAGE      ,
+#endif
+#if BL_SELF_UPDATE_ENABLE
+	BL_SELF_UPDATE            ,
+#endif
+	BL_MEM_FILL               ,
+	BL_GET_BOOT_TIMES         ,
+	BL_RAM_RUN                ,
+	BL_SLOT_ACTIVATE          ,
+	BL_GET_WEAR_STATS         ,
+	BL_GET_STATS              ,
+	BL_GET_TRACE              ,
+	BL_BROADCAST_STATUS       ,
+	BL_GET_CRASH_RECORD       ,
+	BL_ERASE_FOR_IMAGE        ,
+	BL_DISCOVER               ,
+	BL_RESET_AND_BOOT         ,
+	BL_GET_APP_INFO           ,
+	BL_PROGRAM_FROM_RAM       ,
+#if BL_PROGRESS_ENABLE
+	BL_SET_PROGRESS           ,
+#endif
+	BL_RUN_SCRIPT             ,
+#if BL_LINK_TEST_ENABLE
+	BL_ECHO                   ,
+	BL_SINK
+#endif
+};
+
+
+/*
+ * uint32_CalculateCRC
+ * -------------------
+ * Computes the CRC-32 (hardware CRC unit, polynomial 0x04C11DB7, initial value
+ * 0xFFFFFFFF, no reflection, no final XOR) of a byte array through BL_CRC.c,
+ * the only module driving the CRC unit: one store per CRC word instead of one
+ * HAL call per byte.
+ *
+ * Behavior:
+ * ---------
+ * 1. Resets the CRC data register, so every calculation starts from 0xFFFFFFFF.
+ * 2. BL_CRC_WORDWISE_ENABLE = 0: each byte is fed as one 32-bit word
+ *    (0x000000bb), the convention the Host uses for its frames.
+ *    BL_CRC_WORDWISE_ENABLE = 1: word-wise CRC of BL_CRC.h (little-endian
+ *    words, tail bytes one per word, DMA-fed for large aligned blocks).
+ *    Host side, per word w: crc ^= w; 32 x { crc = (crc & 0x80000000) ?
+ *    (crc << 1) ^ 0x04C11DB7 : crc << 1; }
+ *
+ * Return:
+ * -------
+ * @return uint32_t : The computed CRC.
+ */
+static uint32_t uint32_CalculateCRC(uint8_t* copy_puint8dataArr, uint16_t copy_uint16Length)
+{
+#if BL_CRC_WORDWISE_ENABLE
+	return BL_uint32CRCCalculate(copy_puint8dataArr, copy_uint16Length);
+#else
+	BL_voidCRCReset();
+
+	return BL_uint32CRCFeedBytes(copy_puint8dataArr, copy_uint16Length);
+#endif
+}
+
+
+/*
+ * uint32_CalculateFrameCRC
+ * ------------------------
+ * Same CRC as uint32_CalculateCRC() over the concatenation of a header and a
+ * data block, without assembling them: the data can stay in flash.
+ */
+static uint32_t uint32_CalculateFrameCRC(const uint8_t* Copy_puint8Header, uint16_t Copy_uint16HeaderLength,
+                                         const uint8_t* Copy_puint8Data, uint16_t Copy_uint16DataLength)
+{
+#if BL_CRC_WORDWISE_ENABLE
+	BL_CRCStream_t Local_Crc;
+
+	BL_voidCRCStreamStart(&Local_Crc);
+	BL_voidCRCStreamUpdate(&Local_Crc, Copy_puint8Header, Copy_uint16HeaderLength);
+	BL_voidCRCStreamUpdate(&Local_Crc, Copy_puint8Data, Copy_uint16DataLength);
+
+	return BL_uint32CRCStreamFinish(&Local_Crc);
+#else
+	BL_voidCRCReset();
+	(void)BL_uint32CRCFeedBytes(Copy_puint8Header, Copy_uint16HeaderLength);
+
+	return BL_uint32CRCFeedBytes(Copy_puint8Data, Copy_uint16DataLength);
+#endif
+}
 
 
 /*
@@ -18,9 +394,9 @@ extern UART_HandleTypeDef huart2;
  * If both values match, the data is considered valid; otherwise, it is deemed corrupted.
  *
  * **Execution Steps:**
- * 1. Iterate through each byte of the received data array.
- * 2. Accumulate the CRC value using the HAL_CRC_Accumulate() function.
- * 3. Reset the CRC calculation unit to prepare for future computations.
+ * 1. Reset the CRC calculation unit.
+ * 2. Feed the received data to the CRC data register (uint32_CalculateCRC).
+ * 3. Read the accumulated CRC.
  * 4. Compare the computed CRC with the one received from the host.
  * 5. Return `CRC_SUCCESS` if they match, otherwise return `CRC_FAIL`.
  *
@@ -31,7 +407,7 @@ extern UART_HandleTypeDef huart2;
  * Parameters:
  * -----------
  * @param copy_puint8dataArr   : Pointer to the data array that needs CRC verification.
- * @param copy_uint8Length     : Length of the data array in bytes.
+ * @param copy_uint16Length    : Length of the data array in bytes.
  * @param copy_uint32HostCRC   : Expected CRC value received from the Host for comparison.
  *
  * Return:
@@ -42,29 +418,21 @@ extern UART_HandleTypeDef huart2;
  */
 
 
-static uint8_t uint8VerifyCRC(uint8_t* copy_puint8dataArr,uint8_t copy_uint8Length,uint32_t copy_uint32HostCRC)
+static uint8_t uint8VerifyCRC(uint8_t* copy_puint8dataArr,uint16_t copy_uint16Length,uint32_t copy_uint32HostCRC)
 {
-	uint8_t Local_uint8Iterator , Local_uint8CRCStatus ;
-	uint32_t Local_uint8AccCRC   , Local_uint32Temp;
+	uint8_t  Local_uint8CRCStatus ;
+	uint32_t Local_uint8AccCRC;
 
-	/*
-	 * Step 1: Compute the CRC for the given data.
-	 * The function iterates through each byte of the data array, accumulating the CRC value.
-	 */
-	for(Local_uint8Iterator = 0 ; Local_uint8Iterator < copy_uint8Length; Local_uint8Iterator++)
+	/* Trusted link with the frame CRC switched off (BL_SET_FRAME_CRC) */
+	if((Global_uint8FrameCrcMode == BL_FRAME_CRC_OFF) && (BL_uint8TransportGetLink() == BL_LINK_USB))
 	{
-		/* Load the current byte from the data array into a temporary variable */
-		Local_uint32Temp = copy_puint8dataArr[Local_uint8Iterator];
-
-		/* Accumulate the CRC for the current byte */
-		Local_uint8AccCRC = HAL_CRC_Accumulate(&hcrc, &Local_uint32Temp, 1);
+		return CRC_SUCCESS;
 	}
 
 	/*
-	 * Step 2: Reset the CRC calculation unit.
-	 * This ensures that every time this function is called, it starts calculation from the beginning.
+	 * Step 1 & 2: Compute the CRC for the given data, starting from a reset CRC unit.
 	 */
-	__HAL_CRC_RESET_HANDLE_STATE(&hcrc);
+	Local_uint8AccCRC = uint32_CalculateCRC(copy_puint8dataArr, copy_uint16Length);
 
 
 	/*
@@ -84,32 +452,215 @@ static uint8_t uint8VerifyCRC(uint8_t* copy_puint8dataArr,uint8_t copy_uint8Leng
 }
 
 
-
 /*
- * voidSendACK
- * -----------
- * This function sends an Acknowledgment (ACK) response to the Host,
- * along with the length of the response data that follows.
+ * uint8_VerifyFrameCRC
+ * --------------------
+ * Checks the CRC trailer of a whole received frame (v1, extended or aligned).
+ * A frame the receive interrupt has already checked (BL_FRAME_QUEUE_DEPTH) is
+ * not computed again.
  *
- * @param copy_uint8ReplyLength : Number of bytes that the Bootloader will send after ACK.
+ * Return:
+ * -------
+ * @return uint8_t : CRC_SUCCESS / CRC_FAIL.
+ */
+static uint8_t uint8_VerifyFrameCRC(uint8_t* copy_puint8CmdPacket)
+{
+	uint16_t Local_uint16CmdLen = uint16_GetFrameLength(copy_puint8CmdPacket);
+	uint8_t  Local_uint8Status;
+
+	switch(BL_uint8TransportGetFrameCrc(copy_puint8CmdPacket))
+	{
+	case BL_CRC_FRAME_OK:
+		Local_uint8Status = CRC_SUCCESS;
+		break;
+
+	case BL_CRC_FRAME_BAD:
+		Local_uint8Status = CRC_FAIL;
+		break;
+
+	default:
+		/* Host CRC in the last 4 bytes, the frame end is not aligned */
+		Local_uint8Status = uint8VerifyCRC(copy_puint8CmdPacket, (Local_uint16CmdLen - 4), uint32_GetField(copy_puint8CmdPacket + Local_uint16CmdLen - 4));
+		break;
+	}
+
+	if(Local_uint8Status != CRC_SUCCESS)
+	{
+		Global_uint32CrcFailures++;
+	}
+	else
+	{
+		/* The first good frame picks the link, the others are released */
+		BL_voidTransportLock();
+	}
+
+	BL_TRACE(BL_TRACE_CRC_CHECKED, BL_FRAME_COMMAND(copy_puint8CmdPacket), Local_uint8Status);
+
+	return Local_uint8Status;
+}
+
+
+
+/*
+ * uint16_BuildAckHeader
+ * ---------------------
+ * Writes the ACK header of a response with Copy_uint16ReplyLength bytes of payload.
  *
  * Behavior:
  * ----------
- * - The function creates a buffer containing:
+ * - The header contains:
  *     [0] -> BL_ACK (indicating a successful command reception)
  *     [1] -> Length of the response data that follows
- * - It then transmits this buffer over UART to notify the Host.
+ * - Replies longer than 255 bytes use the extended form, mirroring the request framing:
+ *     [0] -> BL_ACK
+ *     [1] -> BL_FRAME_EXT_MARKER
+ *     [2] -> Length low byte
+ *     [3] -> Length high byte
+ *
+ * Return:
+ * -------
+ * @return uint8_t : Header length in bytes (2 or 4).
+ */
+static uint8_t uint8_BuildAckHeader(uint8_t* Copy_puint8Buffer, uint16_t copy_uint16ReplyLength)
+{
+	Copy_puint8Buffer[0] = BL_ACK;
+
+	if(copy_uint16ReplyLength > 0xFFu)
+	{
+		Copy_puint8Buffer[1] = BL_FRAME_EXT_MARKER;
+		Copy_puint8Buffer[2] = (uint8_t)copy_uint16ReplyLength;
+		Copy_puint8Buffer[3] = (uint8_t)(copy_uint16ReplyLength >> 8);
+		return 4u;
+	}
+
+	Copy_puint8Buffer[1] = (uint8_t)copy_uint16ReplyLength;
+	return 2u;
+}
+
+
+/*
+ * voidSendResponse
+ * ----------------
+ * Sends a complete response in one DMA transfer:
+ *     [ACK header] [payload] [CRC32, if BL_RESPONSE_CRC_ENABLE]
+ *
+ * @param Copy_puint8Payload     : Response data (may be NULL when the length is 0).
+ * @param Copy_uint16PayloadLength: Number of payload bytes.
+ *
+ * Behavior:
+ * ----------
+ * - The response is assembled in the transport TX buffer; the handler returns
+ *   as soon as the DMA is started, so the next command is parsed while TX drains.
+ * - The optional CRC covers the header and payload and uses the same CRC unit
+ *   as the request check, so the host verifies it with its existing routine.
+ */
+static void voidSendResponse(uint8_t* Copy_puint8Payload, uint16_t Copy_uint16PayloadLength)
+{
+	uint8_t* Local_puint8Tx = BL_puint8TransportTxAcquire();
+	uint16_t Local_uint16Length;
+
+	Local_uint16Length = uint8_BuildAckHeader(Local_puint8Tx, Copy_uint16PayloadLength);
+
+	if(Copy_uint16PayloadLength > 0u)
+	{
+		memcpy(&Local_puint8Tx[Local_uint16Length], Copy_puint8Payload, Copy_uint16PayloadLength);
+		Local_uint16Length += Copy_uint16PayloadLength;
+	}
+
+	voidStartResponse(Local_puint8Tx, Local_uint16Length);
+}
+
+
+/*
+ * uint16_FinishResponse
+ * ---------------------
+ * Appends the optional response CRC to a reply built in the TX buffer
+ * (header + payload, Copy_uint16Length bytes) and returns the length to send.
+ */
+static uint16_t uint16_FinishResponse(uint8_t* Copy_puint8Tx, uint16_t Copy_uint16Length)
+{
+#if BL_RESPONSE_CRC_ENABLE
+	{
+		uint32_t Local_uint32CRC = uint32_CalculateCRC(Copy_puint8Tx, Copy_uint16Length);
+		memcpy(&Copy_puint8Tx[Copy_uint16Length], &Local_uint32CRC, 4u);
+		Copy_uint16Length += 4u;
+	}
+#else
+	(void)Copy_puint8Tx;
+#endif
+
+	return Copy_uint16Length;
+}
+
+
+/*
+ * voidStartResponse
+ * -----------------
+ * Finishes a reply built in the TX buffer (uint16_FinishResponse) and starts sending it.
+ */
+static void voidStartResponse(uint8_t* Copy_puint8Tx, uint16_t Copy_uint16Length)
+{
+	BL_voidTransportTxStart(uint16_FinishResponse(Copy_puint8Tx, Copy_uint16Length));
+}
+
+
+/*
+ * voidReportProgress
+ * ------------------
+ * One progress frame (see "Progress Frames" in BL.h), called between the
+ * steps of a long command. Returns at once unless a host asked for them,
+ * the interval since the last one is up and BL_uint8TransportTxReady; the
+ * frame then goes out by DMA while the command carries on.
  */
+static void voidReportProgress(uint8_t Copy_uint8Operation, uint8_t Copy_uint8Sector, uint32_t Copy_uint32Done, uint32_t Copy_uint32Total)
+{
+#if BL_PROGRESS_ENABLE
+	uint32_t Local_uint32Now = HAL_GetTick();
+	uint8_t* Local_puint8Frame = Global_uint8ProgressFrame;
+
+	if((Global_uint16ProgressInterval == 0u) || ((Local_uint32Now - Global_uint32ProgressTick) < Global_uint16ProgressInterval) ||
+	   (BL_uint8TransportTxReady() == 0u))
+	{
+		return;
+	}
+
+	Local_puint8Frame[0] = BL_PROGRESS_MARKER;
+	Local_puint8Frame[1] = BL_PROGRESS_PAYLOAD_SIZE;
+	Local_puint8Frame[2] = Copy_uint8Operation;
+	Local_puint8Frame[3] = (uint8_t)((Copy_uint32Total != 0u) ? (((uint64_t)Copy_uint32Done * 100u) / Copy_uint32Total) : 100u);
+	Local_puint8Frame[4] = Copy_uint8Sector;
+	memcpy(&Local_puint8Frame[5], &Copy_uint32Done, 4u);
+	memcpy(&Local_puint8Frame[9], &Copy_uint32Total, 4u);
+
+	Global_uint32ProgressTick = Local_uint32Now;
+	BL_voidTransportTxSendBuffer(Local_puint8Frame, uint16_FinishResponse(Local_puint8Frame, 2u + BL_PROGRESS_PAYLOAD_SIZE));
+#else
+	(void)Copy_uint8Operation;
+	(void)Copy_uint8Sector;
+	(void)Copy_uint32Done;
+	(void)Copy_uint32Total;
+#endif
+}
+
 
-static void voidSendACK(uint8_t copy_uint8ReplyeLngth)
+/*
+ * voidReportEraseProgress
+ * -----------------------
+ * Erase progress in bytes: from the first sector's base to the end of
+ * Copy_uint8Sector, out of the whole range.
+ */
+static void voidReportEraseProgress(uint8_t Copy_uint8FirstSector, uint8_t Copy_uint8NumberofSectors, uint8_t Copy_uint8Sector)
 {
-	/* Buffer to hold the ACK response and the length of the following response */
-	uint8_t Local_uint8AckBuffer[2] = {BL_ACK, copy_uint8ReplyeLngth};
+	const BL_FlashSector_t* Local_pFirst = BL_pFlashGetSectorInfo(Copy_uint8FirstSector);
+	const BL_FlashSector_t* Local_pLast  = BL_pFlashGetSectorInfo((uint8_t)(Copy_uint8FirstSector + Copy_uint8NumberofSectors - 1u));
+	const BL_FlashSector_t* Local_pDone  = BL_pFlashGetSectorInfo(Copy_uint8Sector);
 
-	/* Send ACK response via UART */
-	HAL_UART_Transmit(&huart2, Local_uint8AckBuffer, 2, HAL_MAX_DELAY);
+	voidReportProgress(BL_PROGRESS_OP_ERASE, Copy_uint8Sector,
+	                   (Local_pDone->Base + Local_pDone->Size) - Local_pFirst->Base,
+	                   (Local_pLast->Base + Local_pLast->Size) - Local_pFirst->Base);
 }
 
+
 /*
  * voidSendNACK
  * ------------
@@ -118,65 +669,210 @@ static void voidSendACK(uint8_t copy_uint8ReplyeLngth)
  *
  * Behavior:
  * ----------
- * - The function prepares a single-byte buffer containing BL_NACK.
+ * - The function places a single byte containing BL_NACK in the TX buffer.
  * - It then transmits this NACK response over UART to notify the Host of the failure.
  */
 
 static void voidSendNACK(void)
 {
-	/* Buffer holding the NACK response */
-	uint8_t Local_uint8NAck = BL_NACK;
+	uint8_t* Local_puint8Tx = BL_puint8TransportTxAcquire();
+
+	Local_puint8Tx[0] = BL_NACK;
+	Global_uint8CommandNacked = 1u;
 
 	/* Send NACK response via UART */
-	HAL_UART_Transmit(&huart2, &Local_uint8NAck, 1, HAL_MAX_DELAY);
+	BL_voidTransportTxStart(1u);
 }
 
 /*
- * uint8_ValidateAddress
+ * uint16_GetFrameLength
  * ---------------------
- * This function checks whether a given memory address is within valid memory regions.
- * The address is considered valid if it falls within the Flash memory or SRAM1.
+ * Returns the total number of bytes in a received frame, length field and CRC included.
+ *
+ * - v1 frame       : [Length to Follow (1)] [Command] ...                -> Length + 1
+ * - Extended frame : [BL_FRAME_EXT_MARKER] [Length to Follow (2)] ...     -> Length + 3
+ * - Aligned frame  : [BL_FRAME_ALIGNED_MARKER] [Length to Follow (2)] ... -> 8 + padded payload
+ */
+static uint16_t uint16_GetFrameLength(uint8_t* copy_puint8CmdPacket)
+{
+	uint16_t Local_uint16FrameLength;
+
+	if(copy_puint8CmdPacket[0] == BL_FRAME_EXT_MARKER)
+	{
+		Local_uint16FrameLength = (uint16_t)(copy_puint8CmdPacket[1] | (copy_puint8CmdPacket[2] << 8)) + BL_FRAME_EXT_HEADER_LENGTH;
+	}
+	else if(copy_puint8CmdPacket[0] == BL_FRAME_ALIGNED_MARKER)
+	{
+		/* Length to Follow = Command + Payload + CRC, the transport guarantees at least 5 */
+		Local_uint16FrameLength = (uint16_t)(copy_puint8CmdPacket[1] | (copy_puint8CmdPacket[2] << 8)) - 5u;
+		Local_uint16FrameLength = (uint16_t)(BL_FRAME_ALIGNED_PAD(Local_uint16FrameLength) + BL_FRAME_EXT_HEADER_LENGTH + 5u);
+	}
+	else
+	{
+		Local_uint16FrameLength = (uint16_t)copy_puint8CmdPacket[0] + 1u;
+	}
+
+	return Local_uint16FrameLength;
+}
+
+/*
+ * puint8_GetFramePayload
+ * ----------------------
+ * Returns a pointer to the first byte after the command code, for both frame formats.
+ */
+static uint8_t* puint8_GetFramePayload(uint8_t* copy_puint8CmdPacket)
+{
+	return (copy_puint8CmdPacket[0] <= BL_FRAME_ALIGNED_MARKER) ? &copy_puint8CmdPacket[BL_FRAME_EXT_HEADER_LENGTH + 1u] : &copy_puint8CmdPacket[2];
+}
+
+/*
+ * uint16_GetFramePayloadLength
+ * ----------------------------
+ * Returns the number of bytes between the command code and the 4-byte CRC
+ * (the padding of an aligned frame excluded).
+ */
+static uint16_t uint16_GetFramePayloadLength(uint8_t* copy_puint8CmdPacket)
+{
+	if(copy_puint8CmdPacket[0] == BL_FRAME_ALIGNED_MARKER)
+	{
+		return (uint16_t)((copy_puint8CmdPacket[1] | (copy_puint8CmdPacket[2] << 8)) - 5u);
+	}
+
+	return (uint16_t)((copy_puint8CmdPacket + uint16_GetFrameLength(copy_puint8CmdPacket) - 4) - puint8_GetFramePayload(copy_puint8CmdPacket));
+}
+
+/*
+ * uint32_GetField / uint16_GetField
+ * ---------------------------------
+ * Read a little-endian field at any offset of a frame. The payload of a v1 or
+ * extended frame has no alignment, a word cast would be an unaligned access;
+ * memcpy compiles to a single load on the Cortex-M4 either way.
+ */
+static uint32_t uint32_GetField(const uint8_t* copy_puint8Field)
+{
+	uint32_t Local_uint32Value;
+
+	memcpy(&Local_uint32Value, copy_puint8Field, sizeof(Local_uint32Value));
+
+	return Local_uint32Value;
+}
+
+static uint16_t uint16_GetField(const uint8_t* copy_puint8Field)
+{
+	uint16_t Local_uint16Value;
+
+	memcpy(&Local_uint16Value, copy_puint8Field, sizeof(Local_uint16Value));
+
+	return Local_uint16Value;
+}
+
+/*
+ * Global_MemoryRegions
+ * --------------------
+ * STM32F407VG memory map, by increasing address. SRAM1 and SRAM2 are
+ * contiguous: a range may run from one into the other. CCMRAM and the backup
+ * SRAM are not on the DMA buses, the system memory, OTP and option bytes are
+ * read only (OTP and option bytes have their own commands).
+ */
+static const BL_MemoryRegion_t Global_MemoryRegions[] =
+{
+	{ FLASH_BASE,        (FLASH_END - FLASH_BASE + 1u),         (BL_MEMORY_READ | BL_MEMORY_WRITE | BL_MEMORY_EXECUTE | BL_MEMORY_DMA), BL_MEMORY_METHOD_FLASH },
+	{ CCMDATARAM_BASE,   (CCMDATARAM_END - CCMDATARAM_BASE + 1u), (BL_MEMORY_READ | BL_MEMORY_WRITE),                                     BL_MEMORY_METHOD_COPY  },
+	{ 0x1FFF0000UL,      (30u * 1024u),                         (BL_MEMORY_READ | BL_MEMORY_EXECUTE | BL_MEMORY_DMA),                   BL_MEMORY_METHOD_NONE  }, /* System memory */
+	{ FLASH_OTP_BASE,    (FLASH_OTP_END - FLASH_OTP_BASE + 1u), (BL_MEMORY_READ | BL_MEMORY_DMA),                                       BL_MEMORY_METHOD_NONE  },
+	{ 0x1FFFC000UL,      16u,                                   (BL_MEMORY_READ | BL_MEMORY_DMA),                                       BL_MEMORY_METHOD_NONE  }, /* Option bytes */
+	{ SRAM1_BASE,        (112u * 1024u),                        (BL_MEMORY_READ | BL_MEMORY_WRITE | BL_MEMORY_EXECUTE | BL_MEMORY_DMA), BL_MEMORY_METHOD_COPY  },
+	{ SRAM2_BASE,        (16u * 1024u),                         (BL_MEMORY_READ | BL_MEMORY_WRITE | BL_MEMORY_EXECUTE | BL_MEMORY_DMA), BL_MEMORY_METHOD_COPY  },
+	{ BKPSRAM_BASE,      (4u * 1024u),                          (BL_MEMORY_READ | BL_MEMORY_WRITE | BL_MEMORY_BACKUP),                  BL_MEMORY_METHOD_COPY  },
+};
+
+#define BL_MEMORY_REGION_COUNT       (sizeof(Global_MemoryRegions) / sizeof(Global_MemoryRegions[0]))
+
+
+/*
+ * pMemory_LookupRegion
+ * --------------------
+ * Finds the region of a memory range, the single check every command uses
+ * before it reads, writes or jumps.
  *
  * Parameters:
  * -----------
- * @param Copy_uint32Address : The memory address to be validated.
+ * @param Copy_uint32Address : First address of the range.
+ * @param Copy_uint32Length  : Length in bytes (0 is never valid).
+ * @param Copy_uint8Access   : BL_MEMORY_xxx flags the range must have.
  *
  * Behavior:
  * ---------
- * 1. Initializes the address status as `NOT_VALID_ADDRESS`.
- * 2. Checks if the address falls within the Flash memory range (`FLASH_BASE` to `FLASH_END`).
- * 3. If not in Flash, checks if the address is within the SRAM1 range.
- * 4. If the address matches either region, it is marked as `VALID_ADDRESS`, otherwise remains `NOT_VALID_ADDRESS`.
- * 5. Returns the validation result.
+ * 1. Rejects empty and wrapping ranges.
+ * 2. Finds the region of the first address; the range may continue into the
+ *    next region when it is contiguous and has the same flags and method.
+ * 3. The backup SRAM clock and backup-domain write access are enabled when
+ *    the backup SRAM is first looked up.
  *
  * Return:
  * -------
- * @return uint8_t : Address validation status:
- *         - `VALID_ADDRESS` if the address is within Flash or SRAM.
- *         - `NOT_VALID_ADDRESS` otherwise.
+ * @return const BL_MemoryRegion_t* : Region of the first address, NULL if the
+ *         range is not entirely allowed.
  */
-static uint8_t uint8_ValidateAddress(uint32_t Copy_uint32Address)
+static const BL_MemoryRegion_t* pMemory_LookupRegion(uint32_t Copy_uint32Address, uint32_t Copy_uint32Length, uint8_t Copy_uint8Access)
 {
+	const BL_MemoryRegion_t* Local_pRegion = NULL;
+	uint32_t Local_uint32Last = Copy_uint32Address + Copy_uint32Length - 1u;
+	uint8_t  Local_uint8Index;
+	uint8_t  Local_uint8Next;
+
+	if((Copy_uint32Length == 0u) || (Local_uint32Last < Copy_uint32Address))
+	{
+		return NULL;
+	}
+
+	for(Local_uint8Index = 0; Local_uint8Index < BL_MEMORY_REGION_COUNT; Local_uint8Index++)
+	{
+		if((Copy_uint32Address - Global_MemoryRegions[Local_uint8Index].Base) < Global_MemoryRegions[Local_uint8Index].Size)
+		{
+			Local_pRegion = &Global_MemoryRegions[Local_uint8Index];
+			break;
+		}
+	}
+
+	if((Local_pRegion == NULL) || ((Local_pRegion->Access & Copy_uint8Access) != Copy_uint8Access))
+	{
+		return NULL;
+	}
+
+	/* Follow contiguous regions of the same kind up to the last address */
+	Local_uint8Next = Local_uint8Index;
+	while((Local_uint32Last - Global_MemoryRegions[Local_uint8Next].Base) >= Global_MemoryRegions[Local_uint8Next].Size)
+	{
+		if(((Local_uint8Next + 1u) >= BL_MEMORY_REGION_COUNT) ||
+		   (Global_MemoryRegions[Local_uint8Next + 1u].Base != (Global_MemoryRegions[Local_uint8Next].Base + Global_MemoryRegions[Local_uint8Next].Size)) ||
+		   (Global_MemoryRegions[Local_uint8Next + 1u].Access != Local_pRegion->Access) ||
+		   (Global_MemoryRegions[Local_uint8Next + 1u].Method != Local_pRegion->Method))
+		{
+			return NULL;
+		}
+		Local_uint8Next++;
+	}
+
+	if((Local_pRegion->Access & BL_MEMORY_BACKUP) != 0u)
+	{
+		voidEnableBackupSram();
+	}
 
-	     /* Initialize status as NOT valid */
-		uint8_t Local_uint8AddressStatus = NOT_VALID_ADDRESS;
+	return Local_pRegion;
+}
 
-		/* Check if the address falls within Flash memory */
-	     if((Copy_uint32Address >= FLASH_BASE) && (Copy_uint32Address<= FLASH_END))
-	     {
-	    	 Local_uint8AddressStatus = VALID_ADDRESS ;
-	     }
-	     /* Check if the address falls within SRAM memory */
-	     else if((Copy_uint32Address >= SRAM1_BASE) && (Copy_uint32Address <= (SRAM1_BASE + (128*1024))))
-	     {
-	    	 Local_uint8AddressStatus = VALID_ADDRESS ;
-	     }
-	     else
-	     {
-	    	 Local_uint8AddressStatus = NOT_VALID_ADDRESS ;
-	     }
 
-return Local_uint8AddressStatus ;
+/*
+ * voidEnableBackupSram
+ * --------------------
+ * The backup SRAM sits in the backup domain: PWR clock, DBP and its own clock.
+ */
+static void voidEnableBackupSram(void)
+{
+	__HAL_RCC_PWR_CLK_ENABLE();
+	HAL_PWR_EnableBkUpAccess();
+	__HAL_RCC_BKPSRAM_CLK_ENABLE();
 }
 
 
@@ -191,6 +887,7 @@ return Local_uint8AddressStatus ;
  * @param Copy_uint8SectorNumber    : The starting sector number to erase.
  *                                    - If `MASS_ERASE` is passed, the entire flash memory is erased.
  * @param Copy_uint8NumberofSectors : The number of consecutive sectors to erase.
+ * @param Copy_puint16BlankSectors  : Receives a bitmap of the sectors skipped as blank.
  *
  * Behavior:
  * ---------
@@ -198,9 +895,12 @@ return Local_uint8AddressStatus ;
  * 2. If an invalid sector number is provided (out of range), it returns `HAL_ERROR`.
  * 3. If `MASS_ERASE` is requested, it sets the erase type to `FLASH_TYPEERASE_MASSERASE`.
  * 4. Otherwise, it calculates the remaining sectors to ensure the erase does not exceed the flash range.
- * 5. Sets up the erase configuration structure (`FLASH_EraseInitTypeDef`).
- * 6. Unlocks the flash memory to allow erasing.
- * 7. Calls `HAL_FLASHEx_Erase()` to perform the erase operation.
+ * 5. Unlocks the flash memory to allow erasing.
+ * 6. Erases the sectors one by one (or the whole bank) with the RAM-resident
+ *    routines of BL_Flash.c, so reception keeps running meanwhile.
+ *    A sector that already reads all 0xFF is skipped and its bit set in
+ *    *Copy_puint16BlankSectors.
+ * 7. Stops at the first sector that fails.
  * 8. Locks the flash memory after the erase operation to prevent accidental modifications.
  * 9. Returns the erase status (`HAL_OK` for success, `HAL_ERROR` for failure).
  *
@@ -210,10 +910,16 @@ return Local_uint8AddressStatus ;
  *         - `HAL_OK`    -> Erase successful.
  *         - `HAL_ERROR` -> Invalid parameters or erase failure.
  */
-static uint8_t uint8_tExecute_FlashErase(uint8_t Copy_uint8SectorNumber, uint8_t Copy_uint8NumberofSectors)
+static uint8_t uint8_tExecute_FlashErase(uint8_t Copy_uint8SectorNumber, uint8_t Copy_uint8NumberofSectors, uint16_t* Copy_puint16BlankSectors)
 {
     HAL_StatusTypeDef Local_ErrorStatus = HAL_OK; // Variable to store function execution status
 
+    *Copy_puint16BlankSectors = 0;
+
+    /* A background erase must not be interleaved with this one, staged writes go before the erase */
+    voidFinishEraseJob();
+    uint8_FlushWriteBuffer();
+
     /* Validate input parameters */
     if ((Copy_uint8NumberofSectors > NUMBER_OF_SECTORS) && (Copy_uint8SectorNumber != MASS_ERASE))
     {
@@ -227,20 +933,45 @@ static uint8_t uint8_tExecute_FlashErase(uint8_t Copy_uint8SectorNumber, uint8_t
     }
     else
     {
-        /* Define structure to configure erase operation */
-        FLASH_EraseInitTypeDef Local_MyErase;
-        uint32_t Local_uint32SectorError; // Variable to store sector erase errors
+        /* Pause the host (RTS) for the whole erase */
+        BL_voidTransportSetFlashBusy(1);
 
-        /* Check if a mass erase is required */
+        /* Unlock the flash memory for write/erase operations */
+        voidFlashUnlock();
+
+        /* The application changes: its cached "validated" mark no longer holds,
+         * and with A/B slots the running slot is not erased at all */
         if (Copy_uint8SectorNumber == MASS_ERASE)
+        {
+            Local_ErrorStatus = BL_uint8ImageRevoke(BL_IMAGE_BASE_ADDRESS, (FLASH_END + 1u) - BL_IMAGE_BASE_ADDRESS);
+        }
+        else
+        {
+            const BL_FlashSector_t* Local_pFirst = BL_pFlashGetSectorInfo(Copy_uint8SectorNumber);
+            const BL_FlashSector_t* Local_pLast  = BL_pFlashGetSectorInfo(((uint16_t)(Copy_uint8SectorNumber + Copy_uint8NumberofSectors) > NUMBER_OF_SECTORS) ?
+                                                                          (NUMBER_OF_SECTORS - 1u) : (uint8_t)(Copy_uint8SectorNumber + Copy_uint8NumberofSectors - 1u));
+
+            if (Copy_uint8NumberofSectors != 0u)
+            {
+                Local_ErrorStatus = BL_uint8ImageRevoke(Local_pFirst->Base, (Local_pLast->Base + Local_pLast->Size) - Local_pFirst->Base);
+            }
+        }
+
+        if (Local_ErrorStatus != HAL_OK)
+        {
+            /* Refused: nothing erased */
+        }
+        /* Check if a mass erase is required */
+        else if (Copy_uint8SectorNumber == MASS_ERASE)
         {
             /* Mass Erase: Erases all sectors in the flash memory */
-            Local_MyErase.TypeErase = FLASH_TYPEERASE_MASSERASE;
+            Local_ErrorStatus = BL_uint8FlashMassErase();
         }
         else
         {
             /* Sector Erase: Erase a specific number of sectors starting from Copy_uint8SectorNumber */
             uint8_t Local_uint8RemainingSectors = NUMBER_OF_SECTORS - Copy_uint8SectorNumber;
+            uint8_t Local_uint8Iterator;
 
             /* Ensure the number of sectors does not exceed the available range */
             if (Copy_uint8NumberofSectors > Local_uint8RemainingSectors)
@@ -248,29 +979,170 @@ static uint8_t uint8_tExecute_FlashErase(uint8_t Copy_uint8SectorNumber, uint8_t
                 Copy_uint8NumberofSectors = Local_uint8RemainingSectors;
             }
 
-            /* Configure sector erase parameters */
-            Local_MyErase.TypeErase = FLASH_TYPEERASE_SECTORS;  // Select sector erase mode
-            Local_MyErase.NbSectors = Copy_uint8NumberofSectors; // Number of sectors to erase
-            Local_MyErase.Sector = Copy_uint8SectorNumber;       // Start sector for erase
+            /* Erase sector by sector from RAM, stop at the first failure */
+            for (Local_uint8Iterator = 0; (Local_uint8Iterator < Copy_uint8NumberofSectors) && (Local_ErrorStatus == HAL_OK); Local_uint8Iterator++)
+            {
+                uint8_t Local_uint8Sector = Copy_uint8SectorNumber + Local_uint8Iterator;
+
+                /* Already erased (e.g. factory-blank): no erase time, no wear */
+                if (BL_uint8FlashSectorIsBlank(Local_uint8Sector) == BL_FLASH_SECTOR_BLANK)
+                {
+                    *Copy_puint16BlankSectors |= (uint16_t)(1u << Local_uint8Sector);
+                }
+                else
+                {
+                    Local_ErrorStatus = BL_uint8FlashEraseSector(Local_uint8Sector);
+                }
+
+                voidReportEraseProgress(Copy_uint8SectorNumber, Copy_uint8NumberofSectors, Local_uint8Sector);
+            }
         }
 
-        /* Set additional erase parameters */
-        Local_MyErase.VoltageRange = FLASH_VOLTAGE_RANGE_3; // Voltage range (2.7V to 3.6V)
-        Local_MyErase.Banks = FLASH_BANK_1;                 // Select flash bank to erase
-
-        /* Unlock the flash memory for write/erase operations */
-        HAL_FLASH_Unlock();
-
-        /* Perform the erase operation */
-        Local_ErrorStatus = HAL_FLASHEx_Erase(&Local_MyErase, &Local_uint32SectorError);
-
         /* Lock the flash memory to prevent accidental modifications */
-        HAL_FLASH_Lock();
-    }
-
-    /* Return the erase operation status */
-    return Local_ErrorStatus;
-}
+        voidFlashLock();
+
+        BL_voidTransportSetFlashBusy(0);
+
+        /* Erased sectors need no auto-erase later */
+        if (Local_ErrorStatus == HAL_OK)
+        {
+            if (Copy_uint8SectorNumber == MASS_ERASE)
+            {
+                voidRecordErasedSectors((uint16_t)((1u << NUMBER_OF_SECTORS) - 1u));
+            }
+            else
+            {
+                voidRecordErasedSectors((uint16_t)(((1u << Copy_uint8NumberofSectors) - 1u) << Copy_uint8SectorNumber));
+            }
+        }
+    }
+
+    /* Return the erase operation status */
+    return Local_ErrorStatus;
+}
+
+
+/*
+ * uint8_ExecutePlannedErase
+ * -------------------------
+ * Erase planned against the option bytes: a write-protected sector would
+ * only fail once issued, and stop the rest of the request with it.
+ *
+ * Parameters:
+ * -----------
+ * @param Copy_uint8SectorNumber    : First sector (MASS_ERASE is not planned).
+ * @param Copy_uint8NumberofSectors : Number of sectors, clipped at the last one.
+ * @param Copy_puint8Results        : NUMBER_OF_SECTORS bytes, BL_ERASE_SECTOR_xxx.
+ *
+ * Behavior:
+ * ---------
+ * 1. The nWRP bits are read once, before anything is erased.
+ * 2. Each requested sector is, in order: PROTECTED (never issued), REFUSED
+ *    (running A/B slot, BL_uint8ImageRevoke), BLANK (already erased), then
+ *    ERASED or FAILED. A failure does not stop the sectors after it.
+ * 3. Sectors not requested stay BL_ERASE_SECTOR_UNTOUCHED.
+ *
+ * Return:
+ * -------
+ * HAL_OK when every requested sector ends ERASED or BLANK, HAL_ERROR otherwise.
+ */
+static uint8_t uint8_ExecutePlannedErase(uint8_t Copy_uint8SectorNumber, uint8_t Copy_uint8NumberofSectors, uint8_t* Copy_puint8Results)
+{
+	const BL_FlashSector_t* Local_pSector;
+	uint8_t  Local_uint8Status = HAL_OK;
+	uint16_t Local_uint16Protected;
+	uint16_t Local_uint16Erased = 0;
+	uint8_t  Local_uint8Sector;
+
+	memset(Copy_puint8Results, BL_ERASE_SECTOR_UNTOUCHED, NUMBER_OF_SECTORS);
+
+	voidFinishEraseJob();
+	uint8_FlushWriteBuffer();
+
+	if (Copy_uint8SectorNumber >= NUMBER_OF_SECTORS)
+	{
+		/* MASS_ERASE or an invalid sector */
+		Local_uint8Status = HAL_ERROR;
+	}
+	else
+	{
+		if (Copy_uint8NumberofSectors > (NUMBER_OF_SECTORS - Copy_uint8SectorNumber))
+		{
+			Copy_uint8NumberofSectors = NUMBER_OF_SECTORS - Copy_uint8SectorNumber;
+		}
+
+		Local_uint16Protected = uint16_ReadWriteProtection();
+
+		BL_voidTransportSetFlashBusy(1);
+		voidFlashUnlock();
+
+		for (Local_uint8Sector = Copy_uint8SectorNumber; Local_uint8Sector < (Copy_uint8SectorNumber + Copy_uint8NumberofSectors); Local_uint8Sector++)
+		{
+			Local_pSector = BL_pFlashGetSectorInfo(Local_uint8Sector);
+
+			if ((Local_uint16Protected & (1u << Local_uint8Sector)) != 0u)
+			{
+				Copy_puint8Results[Local_uint8Sector] = BL_ERASE_SECTOR_PROTECTED;
+			}
+			else if (BL_uint8ImageRevoke(Local_pSector->Base, Local_pSector->Size) != HAL_OK)
+			{
+				Copy_puint8Results[Local_uint8Sector] = BL_ERASE_SECTOR_REFUSED;
+			}
+			else if (BL_uint8FlashSectorIsBlank(Local_uint8Sector) == BL_FLASH_SECTOR_BLANK)
+			{
+				Copy_puint8Results[Local_uint8Sector] = BL_ERASE_SECTOR_BLANK;
+			}
+			else if (BL_uint8FlashEraseSector(Local_uint8Sector) == HAL_OK)
+			{
+				Copy_puint8Results[Local_uint8Sector] = BL_ERASE_SECTOR_ERASED;
+			}
+			else
+			{
+				Copy_puint8Results[Local_uint8Sector] = BL_ERASE_SECTOR_FAILED;
+			}
+
+			if ((Copy_puint8Results[Local_uint8Sector] == BL_ERASE_SECTOR_ERASED) ||
+			    (Copy_puint8Results[Local_uint8Sector] == BL_ERASE_SECTOR_BLANK))
+			{
+				Local_uint16Erased |= (uint16_t)(1u << Local_uint8Sector);
+			}
+			else
+			{
+				Local_uint8Status = HAL_ERROR;
+			}
+
+			voidReportEraseProgress(Copy_uint8SectorNumber, Copy_uint8NumberofSectors, Local_uint8Sector);
+		}
+
+		voidFlashLock();
+		BL_voidTransportSetFlashBusy(0);
+
+		voidRecordErasedSectors(Local_uint16Erased);
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * voidRecordErasedSectors
+ * -----------------------
+ * Sectors now erased need no auto-erase later; a resumable session also logs
+ * the new bitmap in the journal (its flash stays unlocked).
+ */
+static void voidRecordErasedSectors(uint16_t Copy_uint16Sectors)
+{
+	Global_uint16ErasedSectors |= Copy_uint16Sectors;
+
+#if BL_JOURNAL_ENABLE
+	if ((Copy_uint16Sectors != 0u) && (Global_uint8SessionOpen != 0) && (Global_uint8SessionResumable != 0))
+	{
+		uint32_t Local_uint32Erased = Global_uint16ErasedSectors;
+
+		BL_uint8JournalAppend(BL_JOURNAL_ERASED, &Local_uint32Erased, sizeof(Local_uint32Erased));
+	}
+#endif
+}
 
 
 /*
@@ -282,17 +1154,22 @@ static uint8_t uint8_tExecute_FlashErase(uint8_t Copy_uint8SectorNumber, uint8_t
  * -----------
  * @param Copy_Puint8Buffer   : Pointer to the buffer containing data to be written.
  * @param Copy_uint32Address  : Target memory address where data should be written.
- * @param Copy_uint8Length    : Number of bytes to write.
+ * @param Copy_uint16Length   : Number of bytes to write.
  *
  * Behavior:
  * ---------
  * 1. If the target address is within Flash memory:
  *    - Unlocks Flash for writing.
- *    - Writes data byte-by-byte using Flash programming.
+ *    - Programs unaligned head bytes one at a time until the address is
+ *      word aligned, then whole 32-bit words (x32 parallelism, allowed by
+ *      FLASH_VOLTAGE_RANGE_3), then the remaining tail bytes.
+ *    - Stops at the first programming error.
+ *    - Programming runs from RAM (BL_uint8FlashProgram), so reception
+ *      keeps running while the flash is busy.
  *    - Locks Flash after writing to prevent accidental modifications.
  *
  * 2. If the target address is within SRAM:
- *    - Writes data byte-by-byte directly to SRAM.
+ *    - Copies the data with one memcpy (word moves for aligned buffers).
  *
  * Return:
  * -------
@@ -300,42 +1177,35 @@ static uint8_t uint8_tExecute_FlashErase(uint8_t Copy_uint8SectorNumber, uint8_t
  *         - `HAL_OK`   if the operation is successful.
  *         - `HAL_ERROR` otherwise.
  */
-static uint8_t uint8_ExecuteMemoryWrite(uint8_t* Copy_Puint8Buffer ,uint32_t Copy_uint32Address ,uint8_t Copy_uint8Length)
+static uint8_t uint8_ExecuteMemoryWrite(uint8_t* Copy_Puint8Buffer ,uint32_t Copy_uint32Address ,uint16_t Copy_uint16Length)
 {
    uint8_t Local_uint8ErrorStatus = HAL_ERROR;
+   const BL_MemoryRegion_t* Local_pRegion;
 
-   /* Check if the target address is within Flash memory */
-   if((Copy_uint32Address >= FLASH_BASE) && (Copy_uint32Address <= FLASH_END))
-   {
-       /* We will write byte-by-byte (Byte Programming), so a loop is used */
-       uint8_t Local_uint8Iterator;
-
-       /* Unlock the flash memory for write operations */
-       HAL_FLASH_Unlock();
+   /* Bytes still staged by write-combining go first, they may precede this write */
+   uint8_FlushWriteBuffer();
 
-       /* Write each byte from the buffer to the target Flash address */
-       for(Local_uint8Iterator = 0; Local_uint8Iterator < Copy_uint8Length; Local_uint8Iterator++)
-       {
-           Local_uint8ErrorStatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_BYTE, Copy_uint32Address + Local_uint8Iterator,(uint64_t)Copy_Puint8Buffer[Local_uint8Iterator]);
+   if(Copy_uint16Length == 0u)
+   {
+       return HAL_OK;
+   }
 
-       }
+   /* The region decides the write path, nothing is decided per byte */
+   Local_pRegion = pMemory_LookupRegion(Copy_uint32Address, Copy_uint16Length, BL_MEMORY_WRITE);
 
-       /* Lock the flash memory to prevent accidental modifications */
-       HAL_FLASH_Lock();
+   if(Local_pRegion == NULL)
+   {
+       Local_uint8ErrorStatus = HAL_ERROR;
+   }
+   else if(Local_pRegion->Method == BL_MEMORY_METHOD_FLASH)
+   {
+       Local_uint8ErrorStatus = uint8_ProgramFlash(Copy_Puint8Buffer, Copy_uint32Address, Copy_uint16Length);
    }
-
-   /* If the target address is within SRAM */
    else
    {
-       /* We will write byte-by-byte (Byte Programming), so a loop is used */
-       uint8_t Local_uint8Iterator;
-       uint8_t* Local_Puint8Destination = (uint8_t*)Copy_uint32Address; /* Cast the address to a byte pointer */
-
-       /* Copy data from the buffer to the target SRAM address */
-       for(Local_uint8Iterator = 0; Local_uint8Iterator < Copy_uint8Length; Local_uint8Iterator++)
-       {
-           Local_Puint8Destination[Local_uint8Iterator] = Copy_Puint8Buffer[Local_uint8Iterator];
-       }
+       /* RAM: one memcpy */
+       memcpy((uint8_t*)Copy_uint32Address, Copy_Puint8Buffer, Copy_uint16Length);
+       Local_uint8ErrorStatus = HAL_OK;
    }
 
    /* Return the error status (HAL_OK if successful, HAL_ERROR otherwise) */
@@ -343,598 +1213,6141 @@ static uint8_t uint8_ExecuteMemoryWrite(uint8_t* Copy_Puint8Buffer ,uint32_t Cop
 }
 
 
-
-
-/**
- * BL_voidHandleGetVERCmd
- * @brief  Handles the "Get Version" command sent by the host.
- *         It verifies the CRC and, if valid, responds with the bootloader version.
+/*
+ * uint8_ProgramFlash
+ * ------------------
+ * Programs Copy_uint16Length bytes at a flash address.
  *
  * Behavior:
- * ----------
- * 1. Extracts the command length from the first byte of the packet.
- * 2. Retrieves the CRC value sent by the host (last 4 bytes of the packet).
- * 3. Verifies the CRC of the received data.
- * 4. If CRC is valid:
- *      - Sends an ACK response.
- *      - Sends the bootloader version to the host.
- * 5. If CRC is invalid:
- *      - Sends a NACK response.
- *
- * Parameters:
- * -----------
- * @param  copy_puint8CmdPacket: Pointer to the received command packet from the host.
+ * ---------
+ * 1. Data pipelined behind a background erase is written once the erase is done.
+ * 2. Every sector the write touches must exist and be free of write
+ *    protection (uint8_CheckSectorPieces), or nothing is programmed.
+ * 3. RTS tells the host to pause while programming.
+ * 4. Revokes the application's "validated" mark when writing into it.
+ * 5. The data is programmed one sector piece at a time, so a packet crossing
+ *    e.g. from a 16 KB into the 64 KB sector is timed per sector class; each
+ *    piece is byte head, word body, byte tail, executed from RAM
+ *    (BL_uint8FlashProgram). The first failing piece stops the rest.
+ * 6. The flash is locked again unless a programming session is open.
+ */
+static uint8_t uint8_ProgramFlash(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Address, uint16_t Copy_uint16Length)
+{
+	const BL_FlashSector_t* Local_pSector;
+	const uint8_t* Local_puint8Piece = Copy_puint8Data;
+	uint32_t Local_uint32Piece = Copy_uint32Address;
+	uint16_t Local_uint16Remaining = Copy_uint16Length;
+	uint16_t Local_uint16PieceLength;
+	uint8_t  Local_uint8Status;
+
+	voidFinishEraseJob();
+
+	Local_uint8Status = uint8_CheckSectorPieces(Copy_uint32Address, Copy_uint16Length);
+	if(Local_uint8Status != HAL_OK)
+	{
+		return Local_uint8Status;
+	}
+
+	BL_voidTransportSetFlashBusy(1);
+	voidFlashUnlock();
+
+	Local_uint8Status = BL_uint8ImageRevoke(Copy_uint32Address, Copy_uint16Length);
+
+	/* The next queued frames are CRC-checked by DMA while the CPU programs this one */
+	BL_voidTransportCheckAhead(1);
+
+	while((Local_uint8Status == HAL_OK) && (Local_uint16Remaining != 0u))
+	{
+		Local_pSector = BL_pFlashGetSectorInfo(BL_uint8FlashGetSector(Local_uint32Piece));
+
+		Local_uint16PieceLength = Local_uint16Remaining;
+		if((Local_pSector->Base + Local_pSector->Size - Local_uint32Piece) < Local_uint16PieceLength)
+		{
+			Local_uint16PieceLength = (uint16_t)(Local_pSector->Base + Local_pSector->Size - Local_uint32Piece);
+		}
+
+		Local_uint8Status = BL_uint8FlashProgram(Local_uint32Piece, Local_puint8Piece, Local_uint16PieceLength);
+
+		Local_puint8Piece     += Local_uint16PieceLength;
+		Local_uint32Piece     += Local_uint16PieceLength;
+		Local_uint16Remaining -= Local_uint16PieceLength;
+	}
+
+	BL_voidTransportCheckAhead(0);
+
+	voidFlashLock();
+	BL_voidTransportSetFlashBusy(0);
+
+#if BL_WRITE_VERIFY_ENABLE
+	if(Local_uint8Status == HAL_OK)
+	{
+		uint32_t Local_uint32Mismatch = BL_uint32FlashVerify(Copy_uint32Address, Copy_puint8Data, Copy_uint16Length);
+
+		if(Local_uint32Mismatch != BL_FLASH_VERIFY_OK)
+		{
+			if(Global_uint32VerifyFailAddress == BL_FLASH_VERIFY_OK)
+			{
+				Global_uint32VerifyFailAddress = Local_uint32Mismatch;
+			}
+			Local_uint8Status = HAL_ERROR;
+		}
+	}
+#endif
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * uint8_CheckSectorPieces
+ * -----------------------
+ * Splits a flash write at the sector boundaries and checks each piece: its
+ * sector must exist (the write does not run past FLASH_END) and its nWRP
+ * bit must be set. The option bytes are read once per write.
  *
  * Return:
  * -------
- * @return None.
+ * HAL_OK, HAL_ERROR for a piece past the flash or in a protected sector.
  */
-void BL_voidHandleGetVERCmd(uint8_t* copy_puint8CmdPacket)
+static uint8_t uint8_CheckSectorPieces(uint32_t Copy_uint32Address, uint16_t Copy_uint16Length)
 {
-	uint8_t Local_uint8BLVersion, Local_uint8CRCStatus;
-	uint8_t Local_uint8CmdLen; // this variable to extract command length
-	uint32_t Local_uint32HostCRC; // this variable to extract host CRC
+	uint8_t  Local_uint8FirstSector;
+	uint8_t  Local_uint8LastSector;
+	uint16_t Local_uint16Pieces;
+
+	if(Copy_uint16Length == 0u)
+	{
+		return HAL_OK;
+	}
+
+	Local_uint8FirstSector = BL_uint8FlashGetSector(Copy_uint32Address);
+	Local_uint8LastSector  = BL_uint8FlashGetSector(Copy_uint32Address + Copy_uint16Length - 1u);
+
+	if((Local_uint8FirstSector == BL_FLASH_INVALID_SECTOR) || (Local_uint8LastSector == BL_FLASH_INVALID_SECTOR) ||
+	   (Local_uint8LastSector < Local_uint8FirstSector))
+	{
+		/* Outside the flash, or wrapping around the address space */
+		return HAL_ERROR;
+	}
 
-	/* Extract command length (first byte includes "Length to follow") */
-	Local_uint8CmdLen = copy_puint8CmdPacket[0] + 1;
+	Local_uint16Pieces = (uint16_t)(((1u << (Local_uint8LastSector - Local_uint8FirstSector + 1u)) - 1u) << Local_uint8FirstSector);
+
+	return ((uint16_ReadWriteProtection() & Local_uint16Pieces) != 0u) ? HAL_ERROR : HAL_OK;
+}
 
-	/* Extract CRC from the last 4 bytes of the received packet */
-	Local_uint32HostCRC = *((uint32_t*)(copy_puint8CmdPacket + Local_uint8CmdLen - 4));
 
-	/* Verify CRC of the received command */
-	Local_uint8CRCStatus = uint8VerifyCRC(copy_puint8CmdPacket, (Local_uint8CmdLen - 4), Local_uint32HostCRC);
+/*
+ * voidSendWriteStatus
+ * -------------------
+ * Reply of BL_MEM_WRITE and BL_END_PROGRAM. A failed status with a recorded
+ * read-back mismatch is sent as [WRITE_VERIFY_ERROR] [address (4, LE)], so
+ * the host knows where the flash differs without reading it back; the record
+ * is then cleared. Otherwise the 1-byte status as before.
+ */
+static void voidSendWriteStatus(uint8_t Copy_uint8Status)
+{
+	uint8_t Local_uint8Reply[5];
 
-	if (Local_uint8CRCStatus == CRC_SUCCESS)
+	if((Copy_uint8Status != HAL_OK) && (Global_uint32VerifyFailAddress != BL_FLASH_VERIFY_OK))
 	{
-		/* Send ACK with the length of the response payload (1 byte for version) */
-		voidSendACK(1u);
+		Local_uint8Reply[0] = WRITE_VERIFY_ERROR;
+		memcpy(&Local_uint8Reply[1], &Global_uint32VerifyFailAddress, 4u);
+		Global_uint32VerifyFailAddress = BL_FLASH_VERIFY_OK;
 
-		/* Send the bootloader version */
-		Local_uint8BLVersion = BL_VERSION;
-		HAL_UART_Transmit(&huart2, &Local_uint8BLVersion, 1, HAL_MAX_DELAY);
+		voidSendResponse(Local_uint8Reply, 5u);
 	}
 	else
 	{
-		/* Send NACK if CRC verification fails */
-		voidSendNACK();
+		voidSendResponse(&Copy_uint8Status, 1u);
 	}
 }
 
 
 /*
- * BL_voidHandleGetHelpCmd
- * -----------------------
- * This function handles the "Get Help" command in the bootloader.
- * It verifies the received command packet using CRC and, if valid,
- * sends back a list of supported bootloader commands to the host.
+ * uint8_WriteRegion
+ * -----------------
+ * Write path of BL_MEM_WRITE and BL_MEM_WRITE_LZ: the whole destination must
+ * be writable; flash inside a programming session is write-combined, anything
+ * else written at once. A successful write is added to the session hashes.
  *
- * Parameters:
- * -----------
- * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ * Return:
+ * -------
+ * HAL_OK, HAL_ERROR for a destination outside the regions (WRITING_ERROR
+ * equals HAL_OK), or the status of the write.
+ */
+static uint8_t uint8_WriteRegion(uint8_t* Copy_Puint8Buffer, uint32_t Copy_uint32Address, uint16_t Copy_uint16Length)
+{
+	uint8_t Local_uint8Status = HAL_ERROR;
+	const BL_MemoryRegion_t* Local_pRegion;
+
+	Local_pRegion = pMemory_LookupRegion(Copy_uint32Address, (Copy_uint16Length != 0u) ? Copy_uint16Length : 1u, BL_MEMORY_WRITE);
+
+	if(Local_pRegion != NULL)
+	{
+		if((Global_uint8SessionOpen != 0) && (Local_pRegion->Method == BL_MEMORY_METHOD_FLASH))
+		{
+			Local_uint8Status = uint8_CombineWrite(Copy_Puint8Buffer, Copy_uint32Address, Copy_uint16Length);
+		}
+		else
+		{
+			Local_uint8Status = uint8_ExecuteMemoryWrite(Copy_Puint8Buffer, Copy_uint32Address, Copy_uint16Length);
+		}
+
+		if(Local_uint8Status == HAL_OK)
+		{
+			voidTrackImageWrite(Copy_Puint8Buffer, Copy_uint32Address, Copy_uint16Length);
+		}
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * uint8_CombineWrite
+ * ------------------
+ * Gathers BL_MEM_WRITE data, however the host chunks it, into aligned
+ * WRITE_COMBINE_LINE_SIZE lines so flash is programmed a full line of words
+ * at a time instead of byte head / tail per packet.
  *
  * Behavior:
  * ---------
- * 1. Extracts the command length from the first byte of the packet.
- * 2. Retrieves the CRC value from the last 4 bytes of the packet.
- * 3. Verifies the integrity of the received packet using `uint8VerifyCRC()`.
- * 4. If CRC verification passes:
- *      - Prepares an array of supported bootloader commands.
- *      - Sends an ACK with the size of the supported commands list.
- *      - Transmits the list of supported commands via UART.
- * 5. If CRC verification fails, sends a NACK to the host.
+ * 1. A write that does not continue the staged bytes flushes them first.
+ * 2. The staged line is completed from the new data and programmed when full.
+ * 3. Whole aligned lines are programmed straight from the frame buffer.
+ * 4. The remaining tail is copied into the staging line and waits for the
+ *    next contiguous write, an explicit flush (BL_END_PROGRAM, session close)
+ *    or any command that reads, erases or writes flash otherwise.
+ *
+ * Return:
+ * -------
+ * HAL_OK, or HAL_ERROR if any line programmed during this call failed.
  */
-void BL_voidHandleGetHelpCmd(uint8_t* copy_puint8CmdPacket)
+static uint8_t uint8_CombineWrite(uint8_t* Copy_Puint8Buffer, uint32_t Copy_uint32Address, uint16_t Copy_uint16Length)
 {
-	uint8_t Local_uint8CRCStatus;
-	uint8_t Local_uint8CmdLen; // this variable to extract command length
-	uint32_t Local_uint32HostCRC; // this variable to extract host CRC
+	uint8_t  Local_uint8Status = HAL_OK;
+	uint16_t Local_uint16Chunk;
+	uint8_t  Local_uint8Offset;
 
-	/* Extract command length (first byte includes "Length to follow") */
-	Local_uint8CmdLen = copy_puint8CmdPacket[0] + 1;
-
-	/* Extract CRC from the last 4 bytes of the received packet */
-	Local_uint32HostCRC = *((uint32_t*)(copy_puint8CmdPacket + Local_uint8CmdLen - 4));
-
-	/* Verify CRC of the received command */
-	Local_uint8CRCStatus = uint8VerifyCRC(copy_puint8CmdPacket, (Local_uint8CmdLen - 4), Local_uint32HostCRC);
+	/* Discontinuity: the staged bytes cannot be extended */
+	if((Global_uint8CombineEnd != Global_uint8CombineStart) &&
+	   (Copy_uint32Address != (Global_uint32CombineBase + Global_uint8CombineEnd)))
+	{
+		Local_uint8Status = uint8_FlushWriteBuffer();
+	}
 
-	if (Local_uint8CRCStatus == CRC_SUCCESS)
+	while(Copy_uint16Length != 0u)
 	{
+		Local_uint8Offset = (uint8_t)(Copy_uint32Address & (WRITE_COMBINE_LINE_SIZE - 1u));
 
-		/* Define an array containing all supported bootloader commands */
-		uint8_t Local_uint8BLSupportedCommands []=
+		if((Local_uint8Offset == 0u) && (Copy_uint16Length >= WRITE_COMBINE_LINE_SIZE))
 		{
-			                	BL_GET_VESRION            ,
-			                 	BL_GET_HELP               ,
-								BL_GET_CID                ,
-								BL_GET_RDP_STATUS         ,
-								BL_GO_TO_ADDR             ,
-								BL_FLASH_ERASE            ,
-								BL_MEM_WRITE              ,
-								BL_EN_RW_PROTECT          ,
-								BL_MEM_READ               ,
-								BL_READ_SECTOR_STATUS     ,
-								BL_OTP_READ               ,
-								BL_DIS_WR_PROTECT
-		};
+			/* Aligned whole lines, nothing staged in front of them (flushed when the line completed) */
+			Local_uint16Chunk = (uint16_t)(Copy_uint16Length & ~(WRITE_COMBINE_LINE_SIZE - 1u));
 
-		/* Send an ACK with the size of the supported commands list */
-		voidSendACK(sizeof(Local_uint8BLSupportedCommands));
-
-		/* Transmit the list of supported commands to the host over UART */
-		HAL_UART_Transmit(&huart2, Local_uint8BLSupportedCommands, sizeof(Local_uint8BLSupportedCommands), HAL_MAX_DELAY);
+			if(uint8_ProgramFlash(Copy_Puint8Buffer, Copy_uint32Address, Local_uint16Chunk) != HAL_OK)
+			{
+				Local_uint8Status = HAL_ERROR;
+			}
+		}
+		else
+		{
+			/* Partial line: stage it */
+			if(Global_uint8CombineEnd == Global_uint8CombineStart)
+			{
+				Global_uint32CombineBase = Copy_uint32Address - Local_uint8Offset;
+				Global_uint8CombineStart = Local_uint8Offset;
+				Global_uint8CombineEnd   = Local_uint8Offset;
+			}
+
+			Local_uint16Chunk = (uint16_t)(WRITE_COMBINE_LINE_SIZE - Local_uint8Offset);
+			if(Local_uint16Chunk > Copy_uint16Length)
+			{
+				Local_uint16Chunk = Copy_uint16Length;
+			}
+
+			memcpy(&Global_uint8CombineLine[Local_uint8Offset], Copy_Puint8Buffer, Local_uint16Chunk);
+			Global_uint8CombineEnd = (uint8_t)(Local_uint8Offset + Local_uint16Chunk);
+
+			if(Global_uint8CombineEnd == WRITE_COMBINE_LINE_SIZE)
+			{
+				if(uint8_FlushWriteBuffer() != HAL_OK)
+				{
+					Local_uint8Status = HAL_ERROR;
+				}
+			}
+		}
 
+		Copy_Puint8Buffer    += Local_uint16Chunk;
+		Copy_uint32Address   += Local_uint16Chunk;
+		Copy_uint16Length    -= Local_uint16Chunk;
 	}
-	else
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * uint8_FlushWriteBuffer
+ * ----------------------
+ * Programs the staged bytes of the write-combining line (nothing to do when
+ * it is empty). A failure is also latched in Global_uint8CombineStatus so
+ * BL_END_PROGRAM reports it even if no MEM_WRITE reply could.
+ */
+static uint8_t uint8_FlushWriteBuffer(void)
+{
+	uint8_t Local_uint8Status = HAL_OK;
+
+	if(Global_uint8CombineEnd != Global_uint8CombineStart)
 	{
-		/* Send NACK if CRC verification fails */
-		voidSendNACK();
+		Local_uint8Status = uint8_ProgramFlash(&Global_uint8CombineLine[Global_uint8CombineStart],
+		                                       Global_uint32CombineBase + Global_uint8CombineStart,
+		                                       (uint16_t)(Global_uint8CombineEnd - Global_uint8CombineStart));
+
+		Global_uint8CombineStart = 0;
+		Global_uint8CombineEnd   = 0;
+
+		if(Local_uint8Status != HAL_OK)
+		{
+			Global_uint8CombineStatus = HAL_ERROR;
+		}
 	}
+
+	return Local_uint8Status;
 }
 
 
 /*
- * BL_voidHandleGetCIDcmd
- * ----------------------
- * This function handles the "Get Chip ID" command from the host.
- * It extracts the Chip ID (CID) from the MCU's IDCODE register and sends it back.
+ * uint8_AutoErase
+ * ---------------
+ * Lazy erase used by streams started with BL_STREAM_FLAG_AUTO_ERASE.
  *
  * Parameters:
  * -----------
- * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ * @param Copy_uint32Address : First flash address about to be written.
+ * @param Copy_uint16Length  : Number of bytes about to be written.
  *
  * Behavior:
  * ---------
- * 1. Extracts the length of the command from the first byte.
- * 2. Retrieves the expected CRC from the last 4 bytes of the packet.
- * 3. Verifies the CRC of the received data.
- * 4. If CRC is valid:
- *    - Reads the Chip ID from the `DBGMCU_IDCODE_REGISTER`.
- *    - Sends an ACK response to indicate success.
- *    - Transmits the Chip ID (2 bytes) to the host.
- * 5. If CRC verification fails, it sends a NACK response.
+ * 1. Checks every sector piece of the write (uint8_CheckSectorPieces): a
+ *    write running past the flash or into a protected sector erases nothing.
+ * 2. Erases each of its sectors whose bit in Global_uint16ErasedSectors is
+ *    clear, so an image only pays for the sectors it touches, and the erase
+ *    time is spread over the transfer; a packet spanning two sectors erases both.
+ * 3. Refuses sectors below AUTO_ERASE_FIRST_SECTOR (bootloader).
+ *
+ * Return:
+ * -------
+ * @return uint8_t : HAL_OK, or HAL_ERROR if a sector was refused or failed to erase.
  */
-void BL_voidHandleGetCIDcmd(uint8_t* copy_puint8CmdPacket)
+static uint8_t uint8_AutoErase(uint32_t Copy_uint32Address, uint16_t Copy_uint16Length)
 {
-	uint8_t Local_uint8CRCStatus;
-	uint8_t Local_uint8CmdLen; // this variable to extract command length
-	uint16_t Local_uint16CID ; // Variable to hold the extracted Chip ID
-	uint32_t Local_uint32HostCRC; // this variable to extract host CRC
-
-	/* Step 1: Extract command length (first byte includes "Length to follow") */
-	Local_uint8CmdLen = copy_puint8CmdPacket[0] + 1;
-
-	/* Step 2: Extract CRC from the last 4 bytes of the received packet */
-	Local_uint32HostCRC = *((uint32_t*)(copy_puint8CmdPacket + Local_uint8CmdLen - 4));
-
-	/* Step 3: Verify CRC of the received command */
-	Local_uint8CRCStatus = uint8VerifyCRC(copy_puint8CmdPacket, (Local_uint8CmdLen - 4), Local_uint32HostCRC);
+	uint8_t Local_uint8Status = HAL_OK;
+	uint8_t Local_uint8Sector;
+	uint8_t Local_uint8LastSector;
 
-	if (Local_uint8CRCStatus == CRC_SUCCESS)
+	if(Copy_uint16Length != 0u)
 	{
-		/* Step 4: Retrieve Chip ID (12-bit value from the DBGMCU_IDCODE register) */
-		Local_uint16CID = DBGMCU_IDCODE_REGISTER & 0x0fff;
+		if(uint8_CheckSectorPieces(Copy_uint32Address, Copy_uint16Length) != HAL_OK)
+		{
+			/* Runs past the end of the flash, or into a protected sector */
+			return HAL_ERROR;
+		}
 
-		/* Step 5: Send ACK with the response length (2 bytes for Chip ID) */
-		voidSendACK(2u);
+		Local_uint8Sector     = BL_uint8FlashGetSector(Copy_uint32Address);
+		Local_uint8LastSector = BL_uint8FlashGetSector(Copy_uint32Address + Copy_uint16Length - 1u);
 
-		/* Step 6: Transmit the Chip ID to the host */
-		HAL_UART_Transmit(&huart2, (uint8_t*)&Local_uint16CID , 2 , HAL_MAX_DELAY);
-	}
-	else
-	{
-		/* Send NACK if CRC verification fails */
-		voidSendNACK();
+		for(; (Local_uint8Sector <= Local_uint8LastSector) && (Local_uint8Status == HAL_OK); Local_uint8Sector++)
+		{
+			if(Local_uint8Sector < AUTO_ERASE_FIRST_SECTOR)
+			{
+				Local_uint8Status = HAL_ERROR;
+			}
+			else if((Global_uint16ErasedSectors & (1u << Local_uint8Sector)) == 0u)
+			{
+				uint16_t Local_uint16BlankSectors;
+
+				/* Also sets the sector's bit on success */
+				Local_uint8Status = uint8_tExecute_FlashErase(Local_uint8Sector, 1u, &Local_uint16BlankSectors);
+			}
+			else
+			{
+				/* Already erased in this stream */
+			}
+		}
 	}
-}
 
+	return Local_uint8Status;
+}
 
 
 /*
- * BL_voidHandleGetRDPStatusCmd
- * ----------------------------
- * This function handles the "Get Read Protection (RDP) Status" command from the host.
- * It verifies the CRC, extracts the RDP status from the option bytes, and sends it back.
+ * uint8_ExecuteDifferentialWrite
+ * ------------------------------
+ * Write-if-different flash programming used by BL_STREAM_FLAG_DIFFERENTIAL.
  *
  * Parameters:
  * -----------
- * @param copy_puint8CmdPacket   : Pointer to the received command packet from the host.
+ * @param Copy_Puint8Buffer   : Data to be written.
+ * @param Copy_uint32Address  : Target flash address.
+ * @param Copy_uint16Length   : Number of bytes.
  *
  * Behavior:
  * ---------
- * 1. Extracts the command length from the first byte of the packet.
- * 2. Retrieves the CRC sent by the host from the last 4 bytes of the packet.
- * 3. Calls `uint8VerifyCRC()` to check if the received data is valid.
- * 4. If the CRC check passes:
- *      - Reads the RDP status from the option bytes at `RDP_USER_OPTION_WORD`.
- *      - Sends an ACK followed by the 1-byte RDP status.
- * 5. If the CRC check fails, sends a NACK.
+ * 1. Checks every byte: programming can only clear bits, so a byte whose new
+ *    value needs a 1 where flash holds a 0 makes the packet DIFF_ERASE_REQUIRED.
+ *    Nothing is written in that case, the host erases the sector and resends.
+ * 2. Walks the block in word-aligned chunks; runs of chunks that differ from
+ *    flash are programmed with uint8_ExecuteMemoryWrite(), chunks that match
+ *    are skipped. An unchanged block costs no programming at all.
+ *
+ * Return:
+ * -------
+ * @return uint8_t : HAL_OK, HAL_ERROR or DIFF_ERASE_REQUIRED.
  */
-void BL_voidHandleGetRDPStatusCmd(uint8_t* copy_puint8CmdPacket)
+static uint8_t uint8_ExecuteDifferentialWrite(uint8_t* Copy_Puint8Buffer, uint32_t Copy_uint32Address, uint16_t Copy_uint16Length)
 {
-	uint8_t Local_uint8CRCStatus;
-	uint8_t Local_uint8CmdLen; // this variable to extract command length
-	uint32_t Local_uint32HostCRC; // this variable to extract host CRC
+	const uint8_t* Local_puint8Flash = (const uint8_t*)Copy_uint32Address;
+	uint8_t  Local_uint8Status = HAL_OK;
+	uint16_t Local_uint16Iterator;
+	uint16_t Local_uint16Chunk;
+	int32_t  Local_int32SpanStart = -1;
+
+	/* Compare against the final flash content */
+	voidFinishEraseJob();
+	uint8_FlushWriteBuffer();
+
+	/* 1. Bits can only be cleared without an erase */
+	for(Local_uint16Iterator = 0; Local_uint16Iterator < Copy_uint16Length; Local_uint16Iterator++)
+	{
+		if((Local_puint8Flash[Local_uint16Iterator] & Copy_Puint8Buffer[Local_uint16Iterator]) != Copy_Puint8Buffer[Local_uint16Iterator])
+		{
+			Local_uint8Status = DIFF_ERASE_REQUIRED;
+			break;
+		}
+	}
 
-	/* Extract command length (first byte includes "Length to follow") */
-	Local_uint8CmdLen = copy_puint8CmdPacket[0] + 1;
+	/* 2. Program the differing spans only */
+	Local_uint16Iterator = 0;
+	while((Local_uint8Status == HAL_OK) && (Local_uint16Iterator < Copy_uint16Length))
+	{
+		Local_uint16Chunk = 4u - ((Copy_uint32Address + Local_uint16Iterator) & 0x3u);
+		if(Local_uint16Chunk > (Copy_uint16Length - Local_uint16Iterator))
+		{
+			Local_uint16Chunk = Copy_uint16Length - Local_uint16Iterator;
+		}
 
-	/* Extract CRC from the last 4 bytes of the received packet */
-	Local_uint32HostCRC = *((uint32_t*)(copy_puint8CmdPacket + Local_uint8CmdLen - 4));
+		if(memcmp(&Local_puint8Flash[Local_uint16Iterator], &Copy_Puint8Buffer[Local_uint16Iterator], Local_uint16Chunk) != 0)
+		{
+			if(Local_int32SpanStart < 0)
+			{
+				Local_int32SpanStart = Local_uint16Iterator;
+			}
+		}
+		else if(Local_int32SpanStart >= 0)
+		{
+			Local_uint8Status = uint8_ExecuteMemoryWrite(&Copy_Puint8Buffer[Local_int32SpanStart], Copy_uint32Address + (uint32_t)Local_int32SpanStart,
+			                                             (uint16_t)(Local_uint16Iterator - Local_int32SpanStart));
+			Local_int32SpanStart = -1;
+		}
+		else
+		{
+			/* Unchanged chunk */
+		}
 
-	/* Verify CRC of the received command */
-	Local_uint8CRCStatus = uint8VerifyCRC(copy_puint8CmdPacket, (Local_uint8CmdLen - 4), Local_uint32HostCRC);
+		Local_uint16Iterator += Local_uint16Chunk;
+	}
 
-	if (Local_uint8CRCStatus == CRC_SUCCESS)
+	if((Local_uint8Status == HAL_OK) && (Local_int32SpanStart >= 0))
 	{
+		Local_uint8Status = uint8_ExecuteMemoryWrite(&Copy_Puint8Buffer[Local_int32SpanStart], Copy_uint32Address + (uint32_t)Local_int32SpanStart,
+		                                             (uint16_t)(Copy_uint16Length - Local_int32SpanStart));
+	}
 
-		/* Extract RDP status from option bytes (stored in the upper byte) */
-		uint8_t Local_uint8RDPStatus = (uint8_t)((RDP_USER_OPTION_WORD >> 8) & 0xff);
-
-		/* Send ACK with the length of the response payload (1 byte for version) */
-		voidSendACK(1u);
+	return Local_uint8Status;
+}
 
-		/* Transmit the RDP status back to the host */
-		HAL_UART_Transmit(&huart2, (uint8_t*)&Local_uint8RDPStatus , 1 , HAL_MAX_DELAY);
 
+/*
+ * voidFlashUnlock
+ * ---------------
+ * Unlocks the flash for one operation, or only restarts the session idle
+ * time when a programming session already holds it unlocked.
+ */
+static void voidFlashUnlock(void)
+{
+	if(Global_uint8SessionOpen != 0)
+	{
+		Global_uint32SessionIdleMs = 0;
 	}
 	else
 	{
-		/* Send NACK if CRC verification fails */
-		voidSendNACK();
+		HAL_FLASH_Unlock();
 	}
 }
 
+
 /*
- * BL_voidHandleGoToAddressCmd
- * ----------------------------
- * Handles the "Go To Address" command from the Host, which requests jumping to a specific
- * memory address and executing the code present there.
+ * voidFlashLock
+ * -------------
+ * Locks the flash after one operation, unless a programming session is open.
+ */
+static void voidFlashLock(void)
+{
+	if(Global_uint8SessionOpen == 0)
+	{
+		HAL_FLASH_Lock();
+	}
+}
+
+
+/*
+ * uint16_ReadWriteProtection
+ * --------------------------
+ * Bit n set = sector n write protected (its nWRP option bit is 0).
+ */
+static uint16_t uint16_ReadWriteProtection(void)
+{
+	FLASH_OBProgramInitTypeDef Local_OptionBytes;
+
+	HAL_FLASHEx_OBGetConfig(&Local_OptionBytes);
+
+	return (uint16_t)(~Local_OptionBytes.WRPSector & OB_WRP_SECTOR_All);
+}
+
+
+/*
+ * uint8_ProgramWriteProtection
+ * ----------------------------
+ * Sets (OB_WRPSTATE_ENABLE) or clears (OB_WRPSTATE_DISABLE) the write
+ * protection of every sector in Copy_uint16SectorMask with a single
+ * HAL_FLASHEx_OBProgram + HAL_FLASH_OB_Launch cycle. The other sectors keep
+ * their protection. An empty mask costs no cycle.
+ *
+ * Return:
+ * -------
+ * HAL_OK or HAL_ERROR.
+ */
+static uint8_t uint8_ProgramWriteProtection(uint16_t Copy_uint16SectorMask, uint32_t Copy_uint32State)
+{
+	FLASH_OBProgramInitTypeDef Local_OptionBytes = {0};
+	uint8_t Local_uint8Status = HAL_OK;
+
+	if(Copy_uint16SectorMask != 0u)
+	{
+		voidFinishEraseJob();
+		uint8_FlushWriteBuffer();
+
+		Local_OptionBytes.OptionType = OPTIONBYTE_WRP;
+		Local_OptionBytes.WRPState   = Copy_uint32State;
+		Local_OptionBytes.WRPSector  = Copy_uint16SectorMask;
+		Local_OptionBytes.Banks      = FLASH_BANK_1;
+
+		BL_voidTransportSetFlashBusy(1);
+		HAL_FLASH_OB_Unlock();
+
+		Local_uint8Status = (uint8_t)HAL_FLASHEx_OBProgram(&Local_OptionBytes);
+		if(Local_uint8Status == HAL_OK)
+		{
+			Local_uint8Status = (uint8_t)HAL_FLASH_OB_Launch();
+		}
+
+		HAL_FLASH_OB_Lock();
+		BL_voidTransportSetFlashBusy(0);
+	}
+
+	return (Local_uint8Status == HAL_OK) ? HAL_OK : HAL_ERROR;
+}
+
+
+/*
+ * voidCloseSession
+ * ----------------
+ * Waits for a background erase, programs the staged write-combining line,
+ * then relocks the flash.
+ */
+static void voidCloseSession(void)
+{
+	if(Global_uint8SessionOpen != 0)
+	{
+		voidFinishEraseJob();
+		uint8_FlushWriteBuffer();
+		Global_uint8SessionOpen    = 0;
+		Global_uint8SessionExpired = 0;
+		HAL_FLASH_Lock();
+	}
+}
+
+
+/*
+ * voidTrackImageWrite
+ * -------------------
+ * Adds the payload of a successful write to the session's running image CRC
+ * and SHA-256. The data is already in the frame buffer, nothing is re-read.
+ *
+ * In a resumable session a write at the end of the contiguous prefix extends
+ * it and saves the resume point (once nothing is left staged in the
+ * write-combining line, so the record never covers bytes a reset could lose).
+ * Any other write makes the session non-resumable: the running hashes no
+ * longer describe a prefix of the target range.
+ */
+static void voidTrackImageWrite(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Address, uint16_t Copy_uint16Length)
+{
+	if(Global_uint8SessionOpen != 0)
+	{
+		BL_voidCRCStreamUpdate(&Global_ImageCrc, Copy_puint8Data, Copy_uint16Length);
+#if BL_SHA256_ENABLE
+		BL_voidSHA256Update(&Global_ImageSha, Copy_puint8Data, Copy_uint16Length);
+#endif
+
+		if(Global_uint8SessionResumable != 0)
+		{
+			if((Copy_uint32Address == (Global_uint32SessionBase + Global_uint32SessionWritten)) &&
+			   (Copy_uint16Length <= (Global_uint32SessionSize - Global_uint32SessionWritten)))
+			{
+				Global_uint32SessionWritten += Copy_uint16Length;
+
+				if(Global_uint8CombineEnd == Global_uint8CombineStart)
+				{
+					voidSaveSessionRecord();
+#if BL_JOURNAL_ENABLE
+					voidJournalProgress();
+#endif
+				}
+			}
+			else
+			{
+				Global_uint8SessionResumable = 0;
+				voidClearSessionRecord();
+#if BL_JOURNAL_ENABLE
+				BL_uint8JournalAppend(BL_JOURNAL_DIRTY, NULL, 0u);
+#endif
+			}
+		}
+	}
+}
+
+
+#if BL_DECRYPT_ENABLE
+/*
+ * voidDecryptPayload
+ * ------------------
+ * BL_MEM_WRITE, _POSTED and _STREAM payloads of a decrypting session are
+ * deciphered in the frame buffer, right before they are written: the bytes
+ * inside the target range with the keystream at their offset from the
+ * target address ("Encrypted Session" in BL.h), the others left as they
+ * are. The frame is not used again once written, retransmissions arrive in
+ * a frame of their own.
+ */
+static void voidDecryptPayload(uint8_t* Copy_puint8Data, uint32_t Copy_uint32Address, uint16_t Copy_uint16Length)
+{
+	uint32_t Local_uint32Start = Copy_uint32Address;
+	uint32_t Local_uint32End   = Copy_uint32Address + Copy_uint16Length;
+
+	if((Global_uint8SessionOpen != 0) && (Global_uint8SessionDecrypt != 0))
+	{
+		if(Local_uint32Start < Global_uint32SessionBase)
+		{
+			Local_uint32Start = Global_uint32SessionBase;
+		}
+		if(Local_uint32End > (Global_uint32SessionBase + Global_uint32SessionSize))
+		{
+			Local_uint32End = Global_uint32SessionBase + Global_uint32SessionSize;
+		}
+
+		if(Local_uint32Start < Local_uint32End)
+		{
+			BL_voidAESCTR(&Global_ImageAes, Global_uint8SessionCounter, Local_uint32Start - Global_uint32SessionBase,
+			              &Copy_puint8Data[Local_uint32Start - Copy_uint32Address], Local_uint32End - Local_uint32Start);
+		}
+	}
+}
+#endif
+
+
+/*
+ * voidSaveSessionRecord
+ * ---------------------
+ * Writes the resume point of the session into the slot not holding the
+ * newest record, CRC last: the other slot stays valid until it is complete.
+ */
+static void voidSaveSessionRecord(void)
+{
+	BL_SessionRecord_t* Local_pRecord;
+
+	Global_uint32SessionGeneration++;
+	Local_pRecord = &Global_SessionRecords[Global_uint32SessionGeneration % BL_SESSION_RECORD_SLOTS];
+
+	voidEnableBackupSram();
+
+	Local_pRecord->Magic         = BL_SESSION_RECORD_MAGIC;
+	Local_pRecord->Generation    = Global_uint32SessionGeneration;
+	Local_pRecord->Base          = Global_uint32SessionBase;
+	Local_pRecord->Size          = Global_uint32SessionSize;
+	Local_pRecord->Written       = Global_uint32SessionWritten;
+	Local_pRecord->ErasedSectors = Global_uint16ErasedSectors;
+	Local_pRecord->Crc           = Global_ImageCrc;
+	Local_pRecord->Sha           = Global_ImageSha;
+	memcpy(Local_pRecord->Counter, Global_uint8SessionCounter, BL_SESSION_COUNTER_SIZE);
+	Local_pRecord->Decrypt       = Global_uint8SessionDecrypt;
+	Local_pRecord->RecordCrc     = BL_uint32CRCCalculate((const uint8_t*)Local_pRecord, offsetof(BL_SessionRecord_t, RecordCrc));
+}
+
+
+/*
+ * pSession_LoadRecord
+ * -------------------
+ * Returns the valid record (magic and CRC) with the highest generation, NULL
+ * when neither slot holds one.
+ */
+static const BL_SessionRecord_t* pSession_LoadRecord(void)
+{
+	const BL_SessionRecord_t* Local_pNewest = NULL;
+	const BL_SessionRecord_t* Local_pRecord;
+	uint8_t Local_uint8Slot;
+
+	voidEnableBackupSram();
+
+	for(Local_uint8Slot = 0; Local_uint8Slot < BL_SESSION_RECORD_SLOTS; Local_uint8Slot++)
+	{
+		Local_pRecord = &Global_SessionRecords[Local_uint8Slot];
+
+		if((Local_pRecord->Magic == BL_SESSION_RECORD_MAGIC) &&
+		   (Local_pRecord->RecordCrc == BL_uint32CRCCalculate((const uint8_t*)Local_pRecord, offsetof(BL_SessionRecord_t, RecordCrc))) &&
+		   ((Local_pNewest == NULL) || ((int32_t)(Local_pRecord->Generation - Local_pNewest->Generation) > 0)))
+		{
+			Local_pNewest = Local_pRecord;
+		}
+	}
+
+	return Local_pNewest;
+}
+
+
+/*
+ * voidClearSessionRecord
+ * ----------------------
+ * Removes the resume point: both slots lose their magic.
+ */
+static void voidClearSessionRecord(void)
+{
+	uint8_t Local_uint8Slot;
+
+	voidEnableBackupSram();
+
+	for(Local_uint8Slot = 0; Local_uint8Slot < BL_SESSION_RECORD_SLOTS; Local_uint8Slot++)
+	{
+		Global_SessionRecords[Local_uint8Slot].Magic = 0u;
+	}
+}
+
+
+#if BL_JOURNAL_ENABLE
+/*
+ * voidJournalProgress
+ * -------------------
+ * Copies the record just saved into the flash journal when the prefix has
+ * grown by BL_JOURNAL_PROGRESS_STEP since the last copy, or is complete:
+ * backup SRAM follows every write, flash one entry per step.
+ */
+static void voidJournalProgress(void)
+{
+	if(((Global_uint32SessionWritten / BL_JOURNAL_PROGRESS_STEP) != (Global_uint32JournalWritten / BL_JOURNAL_PROGRESS_STEP)) ||
+	   (Global_uint32SessionWritten == Global_uint32SessionSize))
+	{
+		BL_uint8JournalAppend(BL_JOURNAL_PROGRESS, &Global_SessionRecords[Global_uint32SessionGeneration % BL_SESSION_RECORD_SLOTS],
+		                      sizeof(BL_SessionRecord_t));
+		Global_uint32JournalWritten = Global_uint32SessionWritten;
+	}
+}
+
+
+/*
+ * BL_uint8SessionRecover
+ * ----------------------
+ * Boot-time look at the flash journal (BL_Journal.h), before the image is
+ * trusted.
+ *
+ * Behavior:
+ * ---------
+ * 1. No interrupted session: returns 0.
+ * 2. Backup SRAM lost its record (power loss without VBAT) and the session
+ *    was resumable: the newest PROGRESS entry, or the OPEN range with nothing
+ *    written, becomes the backup SRAM record again, with the bitmap of the
+ *    newest ERASED entry merged in. BL_RESUME_SESSION then works as if the
+ *    power had stayed on.
+ * 3. Returns 1 when the interrupted session's range overlaps
+ *    [Copy_uint32Base, Copy_uint32End): that flash may be half-written.
+ */
+uint8_t BL_uint8SessionRecover(uint32_t Copy_uint32Base, uint32_t Copy_uint32End)
+{
+	const uint32_t* Local_puint32Open;
+	const uint32_t* Local_puint32Entry;
+	uint8_t Local_uint8Words;
+
+	if(BL_uint8JournalIsOpen() == 0u)
+	{
+		return 0;
+	}
+
+	Local_puint32Open = BL_puint32JournalFind(BL_JOURNAL_OPEN, &Local_uint8Words);
+
+	if((pSession_LoadRecord() == NULL) && (BL_puint32JournalFind(BL_JOURNAL_DIRTY, &Local_uint8Words) == NULL))
+	{
+		Local_puint32Entry = BL_puint32JournalFind(BL_JOURNAL_PROGRESS, &Local_uint8Words);
+
+		if((Local_puint32Entry != NULL) && (Local_uint8Words == (sizeof(BL_SessionRecord_t) / 4u)))
+		{
+			const BL_SessionRecord_t* Local_pRecord = (const BL_SessionRecord_t*)Local_puint32Entry;
+
+			Global_uint32SessionBase       = Local_pRecord->Base;
+			Global_uint32SessionSize       = Local_pRecord->Size;
+			Global_uint32SessionWritten    = Local_pRecord->Written;
+			Global_uint32SessionGeneration = Local_pRecord->Generation;
+			Global_uint16ErasedSectors     = (uint16_t)Local_pRecord->ErasedSectors;
+			Global_ImageCrc                = Local_pRecord->Crc;
+			Global_ImageSha                = Local_pRecord->Sha;
+			Global_uint8SessionDecrypt     = (uint8_t)Local_pRecord->Decrypt;
+			memcpy(Global_uint8SessionCounter, Local_pRecord->Counter, BL_SESSION_COUNTER_SIZE);
+		}
+		else
+		{
+			/* The OPEN entry has no counter block: a decrypting session must be begun again */
+			Global_uint32SessionBase       = Local_puint32Open[0];
+			Global_uint32SessionSize       = Local_puint32Open[1];
+			Global_uint32SessionWritten    = 0;
+			Global_uint16ErasedSectors     = 0;
+			Global_uint8SessionDecrypt     = 0;
+			BL_voidCRCStreamStart(&Global_ImageCrc);
+			BL_voidSHA256Start(&Global_ImageSha);
+		}
+
+		Local_puint32Entry = BL_puint32JournalFind(BL_JOURNAL_ERASED, &Local_uint8Words);
+		if(Local_puint32Entry != NULL)
+		{
+			Global_uint16ErasedSectors |= (uint16_t)Local_puint32Entry[0];
+		}
+
+		voidSaveSessionRecord();
+		Global_uint32JournalWritten = Global_uint32SessionWritten;
+	}
+
+	return (uint8_t)((Local_puint32Open[0] < Copy_uint32End) && ((Local_puint32Open[0] + Local_puint32Open[1]) > Copy_uint32Base));
+}
+#endif
+
+
+/*
+ * BL_voidSessionTick
+ * ------------------
+ * Called every millisecond from SysTick_Handler. When an open session has
+ * seen no flash operation for BL_SESSION_TIMEOUT_MS, the command loop is
+ * woken to close it (the lock itself is not taken in interrupt context,
+ * an operation may be running). Runs from RAM like the tick itself.
+ */
+__RAM_FUNC void BL_voidSessionTick(void)
+{
+	if((Global_uint8SessionOpen != 0) && (Global_uint8SessionExpired == 0))
+	{
+		Global_uint32SessionIdleMs++;
+		if(Global_uint32SessionIdleMs >= BL_SESSION_TIMEOUT_MS)
+		{
+			Global_uint8SessionExpired = 1;
+			BL_voidTransportNotifyBackground();
+		}
+	}
+}
+
+
+/*
+ * voidStartEraseJob
+ * -----------------
+ * Finishes a previous background erase, then sets up the new one and starts
+ * its first sector. The range is clipped to the end of the flash.
+ */
+static void voidStartEraseJob(uint8_t Copy_uint8FirstSector, uint8_t Copy_uint8NumberofSectors)
+{
+	voidFinishEraseJob();
+	uint8_FlushWriteBuffer();
+
+	if(Copy_uint8NumberofSectors > (NUMBER_OF_SECTORS - Copy_uint8FirstSector))
+	{
+		Copy_uint8NumberofSectors = NUMBER_OF_SECTORS - Copy_uint8FirstSector;
+	}
+
+	Global_uint8EraseNextSector = Copy_uint8FirstSector;
+	Global_uint8EraseTotal      = Copy_uint8NumberofSectors;
+	Global_uint8EraseDone       = 0;
+	Global_uint16EraseBlank     = 0;
+	Global_uint8EraseInFlight   = 0;
+	Global_uint8EraseState      = BL_ERASE_RUNNING;
+
+	voidStepEraseJob();
+}
+
+
+/*
+ * voidSendEraseReply
+ * ------------------
+ * [status] [blank-skipped sectors (16-bit bitmap, little endian)]
+ */
+static void voidSendEraseReply(uint8_t Copy_uint8Status, uint16_t Copy_uint16BlankSectors)
+{
+	uint8_t Local_uint8EraseReply[3];
+
+	Local_uint8EraseReply[0] = Copy_uint8Status;
+	Local_uint8EraseReply[1] = (uint8_t)(Copy_uint16BlankSectors & 0xFFu);
+	Local_uint8EraseReply[2] = (uint8_t)(Copy_uint16BlankSectors >> 8);
+
+	voidSendResponse(Local_uint8EraseReply, 3u);
+}
+
+
+/*
+ * voidRunPlannedErase
+ * -------------------
+ * Synchronous planned erase (uint8_ExecutePlannedErase) and its reply:
+ * [status] [result of sector 0] ... [result of sector 11]
+ */
+static void voidRunPlannedErase(uint8_t Copy_uint8FirstSector, uint8_t Copy_uint8NumberofSectors)
+{
+	uint8_t Local_uint8Reply[BL_ERASE_PLAN_REPLY_SIZE];
+
+	/* Turn on LED (LD5) to indicate flash erase is in progress */
+	HAL_GPIO_WritePin(LD5_GPIO_Port, LD5_Pin, GPIO_PIN_SET);
+
+	Local_uint8Reply[0] = uint8_ExecutePlannedErase(Copy_uint8FirstSector, Copy_uint8NumberofSectors, &Local_uint8Reply[1]);
+
+	/* Turn off LED (LD5) after erase completion */
+	HAL_GPIO_WritePin(LD5_GPIO_Port, LD5_Pin, GPIO_PIN_RESET);
+
+	voidSendResponse(Local_uint8Reply, BL_ERASE_PLAN_REPLY_SIZE);
+}
+
+
+/*
+ * uint32_EstimateEraseMs
+ * ----------------------
+ * Expected erase time of one sector: the mean of the erases of that sector
+ * size measured so far (BL_STATS_ENABLE), else the datasheet typical at the
+ * programming parallelism in use.
+ */
+static uint32_t uint32_EstimateEraseMs(uint8_t Copy_uint8Sector)
+{
+	uint32_t Local_uint32Size = BL_pFlashGetSectorInfo(Copy_uint8Sector)->Size;
+	uint8_t  Local_uint8Class = (Local_uint32Size == 0x04000UL) ? BL_FLASH_CLASS_16KB :
+	                            (Local_uint32Size == 0x10000UL) ? BL_FLASH_CLASS_64KB : BL_FLASH_CLASS_128KB;
+	uint8_t  Local_uint8Parallelism = BL_uint8FlashGetParallelism();
+#if BL_STATS_ENABLE
+	const BL_FlashHistogram_t* Local_pErase = &BL_pFlashGetTiming()->Erase[Local_uint8Class];
+
+	if(Local_pErase->Units != 0u)
+	{
+		return ((Local_pErase->TotalUs / Local_pErase->Units) + 999u) / 1000u;
+	}
+#endif
+
+	return Global_uint16EraseTypicalMs[Local_uint8Class][(Local_uint8Parallelism == BL_FLASH_PSIZE_X8)  ? 0u :
+	                                                     (Local_uint8Parallelism == BL_FLASH_PSIZE_X16) ? 1u : 2u];
+}
+
+
+/*
+ * uint8_PlanImageErase
+ * --------------------
+ * BL_ERASE_FOR_IMAGE planning, no flash is changed.
+ *
+ * Parameters:
+ * -----------
+ * @param Copy_uint8SectorNumber    : First sector of the image range.
+ * @param Copy_uint8NumberofSectors : Sectors the range touches.
+ * @param Copy_puint8Results        : NUMBER_OF_SECTORS bytes, BL_ERASE_SECTOR_xxx.
+ * @param Copy_puint32EstimateMs    : Sum of uint32_EstimateEraseMs of the sectors to erase.
+ *
+ * Behavior:
+ * ---------
+ * Each sector of the range is REFUSED (bootloader sector or running A/B
+ * slot), PROTECTED (nWRP bit clear), BLANK or PLANNED; the others stay
+ * UNTOUCHED. The current blank state needs the background erase finished
+ * and the write buffer flushed, which the caller does.
+ *
+ * Return:
+ * -------
+ * HAL_OK when no sector is REFUSED or PROTECTED, HAL_ERROR otherwise.
+ */
+static uint8_t uint8_PlanImageErase(uint8_t Copy_uint8SectorNumber, uint8_t Copy_uint8NumberofSectors, uint8_t* Copy_puint8Results, uint32_t* Copy_puint32EstimateMs)
+{
+	const BL_FlashSector_t* Local_pSector;
+	uint8_t  Local_uint8Status = HAL_OK;
+	uint16_t Local_uint16Protected = uint16_ReadWriteProtection();
+	uint32_t Local_uint32RunningBase = 0u;
+	uint32_t Local_uint32RunningEnd  = 0u;
+	uint8_t  Local_uint8Sector;
+
+	memset(Copy_puint8Results, BL_ERASE_SECTOR_UNTOUCHED, NUMBER_OF_SECTORS);
+	*Copy_puint32EstimateMs = 0u;
+
+	if(BL_IMAGE_SLOT_COUNT > 1u)
+	{
+		Local_uint32RunningBase = BL_uint32ImageGetSlotBase(BL_uint8ImageGetActiveSlot());
+		Local_uint32RunningEnd  = BL_uint32ImageGetSlotEnd(BL_uint8ImageGetActiveSlot());
+	}
+
+	for(Local_uint8Sector = Copy_uint8SectorNumber; Local_uint8Sector < (Copy_uint8SectorNumber + Copy_uint8NumberofSectors); Local_uint8Sector++)
+	{
+		Local_pSector = BL_pFlashGetSectorInfo(Local_uint8Sector);
+
+		if((Local_pSector->Base < BL_IMAGE_BASE_ADDRESS) ||
+		   ((Local_pSector->Base < Local_uint32RunningEnd) && ((Local_pSector->Base + Local_pSector->Size) > Local_uint32RunningBase)))
+		{
+			Copy_puint8Results[Local_uint8Sector] = BL_ERASE_SECTOR_REFUSED;
+			Local_uint8Status = HAL_ERROR;
+		}
+		else if((Local_uint16Protected & (1u << Local_uint8Sector)) != 0u)
+		{
+			Copy_puint8Results[Local_uint8Sector] = BL_ERASE_SECTOR_PROTECTED;
+			Local_uint8Status = HAL_ERROR;
+		}
+		else if(BL_uint8FlashSectorIsBlank(Local_uint8Sector) == BL_FLASH_SECTOR_BLANK)
+		{
+			Copy_puint8Results[Local_uint8Sector] = BL_ERASE_SECTOR_BLANK;
+		}
+		else
+		{
+			Copy_puint8Results[Local_uint8Sector] = BL_ERASE_SECTOR_PLANNED;
+			*Copy_puint32EstimateMs += uint32_EstimateEraseMs(Local_uint8Sector);
+		}
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * voidStepEraseJob
+ * ----------------
+ * One step of the background erase, called from the command loop.
+ *
+ * Behavior:
+ * ---------
+ * 1. While the started sector is still being erased, nothing happens.
+ *    (Code fetched from flash stalls until then anyway; the RX ring keeps
+ *    filling from RAM-resident interrupts.)
+ * 2. A finished sector is counted and recorded in Global_uint16ErasedSectors;
+ *    a failed one stops the job (BL_ERASE_FAILED).
+ * 3. Blank sectors are skipped without erasing.
+ * 4. The next sector erase is started, and the function returns so the loop
+ *    can answer BL_FLASH_ERASE_STATUS between sectors.
+ */
+static void voidStepEraseJob(void)
+{
+	uint8_t Local_uint8Result;
+
+	if(Global_uint8EraseState != BL_ERASE_RUNNING)
+	{
+		return;
+	}
+
+	if(Global_uint8EraseInFlight != 0)
+	{
+		Local_uint8Result = BL_uint8FlashGetEraseResult();
+		if(Local_uint8Result == BL_FLASH_OP_PENDING)
+		{
+			return;
+		}
+
+		Global_uint8EraseInFlight = 0;
+		voidFlashLock();
+
+		if(Local_uint8Result != HAL_OK)
+		{
+			Global_uint8EraseState = BL_ERASE_FAILED;
+			return;
+		}
+
+		Global_uint16ErasedSectors |= (uint16_t)(1u << Global_uint8EraseNextSector);
+		Global_uint8EraseNextSector++;
+		Global_uint8EraseDone++;
+	}
+
+	/* Already erased sectors cost nothing */
+	while((Global_uint8EraseDone < Global_uint8EraseTotal) &&
+	      (BL_uint8FlashSectorIsBlank(Global_uint8EraseNextSector) == BL_FLASH_SECTOR_BLANK))
+	{
+		Global_uint16EraseBlank    |= (uint16_t)(1u << Global_uint8EraseNextSector);
+		Global_uint16ErasedSectors |= (uint16_t)(1u << Global_uint8EraseNextSector);
+		Global_uint8EraseNextSector++;
+		Global_uint8EraseDone++;
+	}
+
+	if(Global_uint8EraseDone != 0u)
+	{
+		voidReportEraseProgress((uint8_t)(Global_uint8EraseNextSector - Global_uint8EraseDone), Global_uint8EraseTotal,
+		                        (uint8_t)(Global_uint8EraseNextSector - 1u));
+	}
+
+	if(Global_uint8EraseDone >= Global_uint8EraseTotal)
+	{
+		Global_uint8EraseState = BL_ERASE_DONE;
+	}
+	else
+	{
+		/* Locked again once the FLASH interrupt reports the end. RTS is not
+		 * forced off: the host may pipeline frames, the RX ring watermark still applies */
+		const BL_FlashSector_t* Local_pSector = BL_pFlashGetSectorInfo(Global_uint8EraseNextSector);
+
+		voidFlashUnlock();
+
+		if(BL_uint8ImageRevoke(Local_pSector->Base, Local_pSector->Size) != HAL_OK)
+		{
+			/* The running A/B slot: the job stops here */
+			voidFlashLock();
+			Global_uint8EraseState = BL_ERASE_FAILED;
+		}
+		else
+		{
+			Global_uint8EraseInFlight = 1;
+			BL_voidFlashEraseSectorStart(Global_uint8EraseNextSector);
+		}
+	}
+}
+
+
+/*
+ * voidFinishEraseJob
+ * ------------------
+ * Blocks until the background erase (if any) has ended.
+ */
+static void voidFinishEraseJob(void)
+{
+	while(Global_uint8EraseState == BL_ERASE_RUNNING)
+	{
+		voidStepEraseJob();
+	}
+}
+
+
+/*
+ * BL_voidRunBackgroundTasks
+ * -------------------------
+ * Called by the command loop before waiting for the next frame, and whenever
+ * the transport returns without one (woken by the FLASH interrupt or by an
+ * expired programming session).
+ */
+void BL_voidRunBackgroundTasks(void)
+{
+	voidStepEraseJob();
+
+	if(Global_uint8SessionExpired != 0)
+	{
+		voidCloseSession();
+	}
+
+#if BL_WEAR_STATS_ENABLE
+	/* Erase counts reach the journal once the flash is idle: one entry per session or erase command */
+	if((Global_uint8SessionOpen == 0) && (Global_uint8EraseState != BL_ERASE_RUNNING))
+	{
+		BL_uint8JournalFlushWear();
+	}
+#endif
+
+#if BL_SLOT_CACHE_ENABLE
+	/* Idle: the next block of the slot cache, then back to the ring, until every block is cached */
+	if((Global_uint8SessionOpen == 0) && (Global_uint8EraseState != BL_ERASE_RUNNING) && (BL_uint8SlotCacheStep() != 0u))
+	{
+		BL_voidTransportNotifyBackground();
+	}
+#endif
+}
+
+
+#if BL_USB_MSC_ENABLE
+/*
+ * BL_uint8ProgramOpen
+ * -------------------
+ * Write path of the UF2 drive (BL_UF2.c), the one a host tool gets from
+ * BL_BEGIN_PROGRAM + auto-erase BL_MEM_WRITE: opens a programming session
+ * and forgets which sectors were erased, so every sector the new file
+ * touches is erased once, on its first block, whatever the block order.
+ * Not resumable: a UF2 copy that broke off is simply copied again.
+ */
+uint8_t BL_uint8ProgramOpen(void)
+{
+	uint8_t Local_uint8Status = HAL_OK;
+
+	voidFinishEraseJob();
+	(void)BL_uint8FlashSelectParallelism();
+
+	if(Global_uint8SessionOpen == 0)
+	{
+		Local_uint8Status = HAL_FLASH_Unlock();
+	}
+
+	if(Local_uint8Status == HAL_OK)
+	{
+		__HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR |
+		                       FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR);
+
+		Global_uint16ErasedSectors     = 0;
+		Global_uint8CombineStatus      = HAL_OK;
+		Global_uint32VerifyFailAddress = BL_FLASH_VERIFY_OK;
+		BL_voidCRCStreamStart(&Global_ImageCrc);
+		BL_voidSHA256Start(&Global_ImageSha);
+		Global_uint32SessionIdleMs = 0;
+		Global_uint8SessionExpired = 0;
+		Global_uint8SessionOpen    = 1;
+
+		voidClearSessionRecord();
+		Global_uint8SessionResumed   = 0;
+		Global_uint8SessionResumable = 0;
+		Global_uint8SessionDecrypt   = 0;
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * BL_uint8ProgramWrite
+ * --------------------
+ * Erases the sectors of the block not erased yet in this session, then
+ * writes it through uint8_WriteRegion: write-combined while the session is
+ * open, direct once it expired. Contiguous blocks fill whole lines, a block
+ * out of order only flushes the staged line first.
+ */
+uint8_t BL_uint8ProgramWrite(uint32_t Copy_uint32Address, uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length)
+{
+	uint8_t Local_uint8Status = uint8_AutoErase(Copy_uint32Address, Copy_uint16Length);
+
+	if(Local_uint8Status == HAL_OK)
+	{
+		Local_uint8Status = uint8_WriteRegion(Copy_puint8Data, Copy_uint32Address, Copy_uint16Length);
+	}
+
+	if(Local_uint8Status != HAL_OK)
+	{
+		Global_uint8CombineStatus = HAL_ERROR;
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * BL_uint8ProgramClose
+ * --------------------
+ * Like BL_END_PROGRAM: programs the staged line and relocks the flash.
+ * HAL_ERROR if any write of the session failed.
+ */
+uint8_t BL_uint8ProgramClose(void)
+{
+	uint8_t Local_uint8Status;
+
+	voidCloseSession();
+
+	Local_uint8Status         = Global_uint8CombineStatus;
+	Global_uint8CombineStatus = HAL_OK;
+
+	return Local_uint8Status;
+}
+#endif
+
+
+/*
+ * voidSendStreamStatus
+ * --------------------
+ * Sends the response used by BL_MEM_WRITE_STREAM:
+ *     [0] -> BL_ACK
+ *     [1] -> 3 (length of the response data)
+ *     [2] -> Stream status (BL_STREAM_ACK / BL_STREAM_RETRANSMIT / BL_STREAM_WRITE_ERROR ...)
+ *     [3] -> Next expected sequence number (low byte)
+ *     [4] -> Next expected sequence number (high byte)
+ * In a selective stream the length is 8, followed by the received bitmap
+ * (4 bytes, LE) and Copy_uint8FailedOffset.
+ */
+static void voidSendStreamStatus(uint8_t Copy_uint8Status, uint16_t Copy_uint16NextSeq, uint8_t Copy_uint8FailedOffset)
+{
+	uint8_t Local_uint8Status[8] = {Copy_uint8Status, (uint8_t)Copy_uint16NextSeq, (uint8_t)(Copy_uint16NextSeq >> 8)};
+
+	if(Global_uint8StreamSelective == 0)
+	{
+		voidSendResponse(Local_uint8Status, 3u);
+		return;
+	}
+
+	memcpy(&Local_uint8Status[3], &Global_uint32StreamReceived, 4u);
+	Local_uint8Status[7] = Copy_uint8FailedOffset;
+
+	voidSendResponse(Local_uint8Status, 8u);
+}
+
+
+/*
+ * uint8_AdvanceStreamWindow
+ * -------------------------
+ * Selective stream: moves "next sequence" over the packets already written
+ * in order, adding each one to the image CRC / SHA-256 from where it was
+ * written.
+ *
+ * Return:
+ * -------
+ * @return uint8_t : 1 if "next sequence" moved.
+ */
+static uint8_t uint8_AdvanceStreamWindow(void)
+{
+	uint8_t Local_uint8Moved = 0;
+	uint8_t Local_uint8Slot;
+
+	while((Global_uint32StreamReceived & 1u) != 0u)
+	{
+		Local_uint8Slot = (uint8_t)(Global_uint16StreamNextSeq % BL_STREAM_SELECTIVE_WINDOW);
+		voidTrackImageWrite((const uint8_t*)Global_uint32StreamSlotAddress[Local_uint8Slot], Global_uint32StreamSlotAddress[Local_uint8Slot],
+		                    Global_uint16StreamSlotLength[Local_uint8Slot]);
+
+		Global_uint32StreamReceived >>= 1;
+		Global_uint16StreamNextSeq++;
+		Local_uint8Moved = 1u;
+	}
+
+	return Local_uint8Moved;
+}
+
+
+/*
+ * uint8_ValidateBaudRate
+ * ----------------------
+ * Checks whether USART2 can run at the requested baud rate.
+ *
+ * Behavior:
+ * ---------
+ * 1. With 16x oversampling BRR holds PCLK1 / baud rounded to 1/16 of a bit,
+ *    so the rate must not exceed PCLK1 / 16.
+ * 2. The rate actually generated is PCLK1 / BRR; its error against the
+ *    requested rate must stay within BAUD_MAX_ERROR_PERMILLE.
+ *
+ * Return:
+ * -------
+ * @return uint8_t : VALID_BAUD_RATE or INVALID_BAUD_RATE.
+ */
+static uint8_t uint8_ValidateBaudRate(uint32_t Copy_uint32BaudRate)
+{
+	uint32_t Local_uint32PCLK1 = HAL_RCC_GetPCLK1Freq();
+	uint32_t Local_uint32BRR;
+	uint32_t Local_uint32ActualRate;
+	uint32_t Local_uint32Error;
+
+	if((Copy_uint32BaudRate < BAUD_MIN_RATE) || (Copy_uint32BaudRate > (Local_uint32PCLK1 / 16u)))
+	{
+		return INVALID_BAUD_RATE;
+	}
+
+	Local_uint32BRR        = (Local_uint32PCLK1 + (Copy_uint32BaudRate / 2u)) / Copy_uint32BaudRate;
+	Local_uint32ActualRate = Local_uint32PCLK1 / Local_uint32BRR;
+	Local_uint32Error      = (Local_uint32ActualRate > Copy_uint32BaudRate) ? (Local_uint32ActualRate - Copy_uint32BaudRate) : (Copy_uint32BaudRate - Local_uint32ActualRate);
+
+	if(((uint64_t)Local_uint32Error * 1000u) > ((uint64_t)Copy_uint32BaudRate * BAUD_MAX_ERROR_PERMILLE))
+	{
+		return INVALID_BAUD_RATE;
+	}
+
+	return VALID_BAUD_RATE;
+}
+
+
+
+
+/*
+ * Global_Commands
+ * ---------------
+ * Command table, indexed by (code - BL_COMMAND_BASE). MinPayload covers the
+ * fields a handler reads without checking the payload length first.
+ */
+static const BL_Command_t Global_Commands[] =
+{
+	[BL_GET_VESRION        - BL_COMMAND_BASE] = { BL_voidHandleGetVERCmd,            0u,  0u },
+	[BL_GET_HELP           - BL_COMMAND_BASE] = { BL_voidHandleGetHelpCmd,           0u,  0u },
+	[BL_GET_CID            - BL_COMMAND_BASE] = { BL_voidHandleGetCIDcmd,            0u,  0u },
+	[BL_GET_RDP_STATUS     - BL_COMMAND_BASE] = { BL_voidHandleGetRDPStatusCmd,      0u,  0u },
+	[BL_GO_TO_ADDR         - BL_COMMAND_BASE] = { BL_voidHandleGoToAddressCmd,       4u,  BL_COMMAND_FLAG_ENDS_BATCH },
+	[BL_FLASH_ERASE        - BL_COMMAND_BASE] = { BL_voidHandleFlashEraseCmd,        2u,  0u },
+	[BL_MEM_WRITE          - BL_COMMAND_BASE] = { BL_voidHandleMemWriteCmd,          5u,  0u },
+	[BL_EN_RW_PROTECT      - BL_COMMAND_BASE] = { BL_voidHandleEnRWProtectCmd,       0u,  0u },
+	[BL_MEM_READ           - BL_COMMAND_BASE] = { BL_voidHandleMemReadCmd,           4u,  BL_COMMAND_FLAG_NO_BATCH },
+	[BL_READ_SECTOR_STATUS - BL_COMMAND_BASE] = { BL_voidHandleReadSectorStatusCmd,  0u,  0u },
+	[BL_OTP_READ           - BL_COMMAND_BASE] = { BL_voidHandleOTPReadCmd,           0u,  0u },
+	[BL_DIS_WR_PROTECT     - BL_COMMAND_BASE] = { BL_voidHandleDisWRProtectCmd,      0u,  0u },
+	[BL_MEM_WRITE_STREAM   - BL_COMMAND_BASE] = { BL_voidHandleMemWriteStreamCmd,    8u,  (BL_COMMAND_FLAG_OWN_CRC | BL_COMMAND_FLAG_NO_BATCH) },
+	[BL_CHANGE_BAUD        - BL_COMMAND_BASE] = { BL_voidHandleChangeBaudCmd,        4u,  BL_COMMAND_FLAG_ENDS_BATCH },
+	[BL_MEM_COMPARE        - BL_COMMAND_BASE] = { BL_voidHandleMemCompareCmd,        10u, 0u },
+	[BL_FLASH_ERASE_STATUS - BL_COMMAND_BASE] = { BL_voidHandleFlashEraseStatusCmd,  0u,  0u },
+	[BL_MEM_WRITE_POSTED   - BL_COMMAND_BASE] = { BL_voidHandleMemWritePostedCmd,    5u,  0u },
+	[BL_BEGIN_PROGRAM      - BL_COMMAND_BASE] = { BL_voidHandleBeginProgramCmd,      0u,  0u },
+	[BL_END_PROGRAM        - BL_COMMAND_BASE] = { BL_voidHandleEndProgramCmd,        0u,  0u },
+	[BL_ERASE_RANGE        - BL_COMMAND_BASE] = { BL_voidHandleEraseRangeCmd,        0u,  0u },
+	[BL_VERIFY_RANGE       - BL_COMMAND_BASE] = { BL_voidHandleVerifyRangeCmd,       0u,  0u },
+	[BL_COMMIT             - BL_COMMAND_BASE] = { BL_voidHandleCommitCmd,            0u,  0u },
+	[BL_BLOCK_CRC_MANIFEST - BL_COMMAND_BASE] = { BL_voidHandleBlockCrcManifestCmd,  0u,  0u },
+	[BL_SET_FRAME_CRC      - BL_COMMAND_BASE] = { BL_voidHandleSetFrameCrcCmd,       0u,  0u },
+	[BL_GET_DEVICE_INFO    - BL_COMMAND_BASE] = { BL_voidHandleGetDeviceInfoCmd,     0u,  0u },
+	[BL_READ_MULTI         - BL_COMMAND_BASE] = { BL_voidHandleReadMultiCmd,         0u,  0u },
+	[BL_BLANK_MAP          - BL_COMMAND_BASE] = { BL_voidHandleBlankMapCmd,          0u,  0u },
+	[BL_BATCH              - BL_COMMAND_BASE] = { BL_voidHandleBatchCmd,             1u,  BL_COMMAND_FLAG_NO_BATCH },
+	[BL_RESUME_SESSION     - BL_COMMAND_BASE] = { BL_voidHandleResumeSessionCmd,     0u,  0u },
+	[BL_GET_CAPABILITIES   - BL_COMMAND_BASE] = { BL_voidHandleGetCapabilitiesCmd,   0u,  0u },
+	[BL_SET_FRAMING        - BL_COMMAND_BASE] = { BL_voidHandleSetFramingCmd,        1u,  BL_COMMAND_FLAG_NO_BATCH },
+#if BL_LZ_ENABLE
+	[BL_MEM_WRITE_LZ       - BL_COMMAND_BASE] = { BL_voidHandleMemWriteLzCmd,        5u,  0u },
+#endif
+#if BL_DELTA_ENABLE
+	[BL_MEM_WRITE_DELTA    - BL_COMMAND_BASE] = { BL_voidHandleMemWriteDeltaCmd,     5u,  0u },
+#endif
+	[BL_MEM_FILL           - BL_COMMAND_BASE] = { BL_voidHandleMemFillCmd,          12u,  0u },
+	[BL_GET_BOOT_TIMES     - BL_COMMAND_BASE] = { BL_voidHandleGetBootTimesCmd,      0u,  0u },
+	[BL_RAM_RUN            - BL_COMMAND_BASE] = { BL_voidHandleRamRunCmd,            4u,  BL_COMMAND_FLAG_ENDS_BATCH },
+	[BL_SLOT_ACTIVATE      - BL_COMMAND_BASE] = { BL_voidHandleSlotActivateCmd,      1u,  0u },
+	[BL_GET_WEAR_STATS     - BL_COMMAND_BASE] = { BL_voidHandleGetWearStatsCmd,      0u,  0u },
+	[BL_GET_STATS          - BL_COMMAND_BASE] = { BL_voidHandleGetStatsCmd,          0u,  0u },
+	[BL_GET_TRACE          - BL_COMMAND_BASE] = { BL_voidHandleGetTraceCmd,          0u,  0u },
+	[BL_BROADCAST_STATUS   - BL_COMMAND_BASE] = { BL_voidHandleBroadcastStatusCmd,   0u,  0u },
+	[BL_GET_CRASH_RECORD   - BL_COMMAND_BASE] = { BL_voidHandleGetCrashRecordCmd,    0u,  0u },
+	[BL_ERASE_FOR_IMAGE    - BL_COMMAND_BASE] = { BL_voidHandleEraseForImageCmd,     8u,  0u },
+	[BL_DISCOVER           - BL_COMMAND_BASE] = { BL_voidHandleDiscoverCmd,         13u,  0u },
+#if BL_PACKAGE_ENABLE
+	[BL_MEM_WRITE_PACKAGE  - BL_COMMAND_BASE] = { BL_voidHandleMemWritePackageCmd,   5u,  0u },
+#endif
+#if BL_SELF_UPDATE_ENABLE
+	[BL_SELF_UPDATE        - BL_COMMAND_BASE] = { BL_voidHandleSelfUpdateCmd,       40u,  BL_COMMAND_FLAG_ENDS_BATCH },
+#endif
+	[BL_RESET_AND_BOOT     - BL_COMMAND_BASE] = { BL_voidHandleResetAndBootCmd,      1u,  BL_COMMAND_FLAG_ENDS_BATCH },
+	[BL_GET_APP_INFO       - BL_COMMAND_BASE] = { BL_voidHandleGetAppInfoCmd,        0u,  0u },
+	[BL_PROGRAM_FROM_RAM   - BL_COMMAND_BASE] = { BL_voidHandleProgramFromRamCmd,   16u,  0u },
+#if BL_PROGRESS_ENABLE
+	[BL_SET_PROGRESS       - BL_COMMAND_BASE] = { BL_voidHandleSetProgressCmd,       2u,  0u },
+#endif
+	[BL_RUN_SCRIPT         - BL_COMMAND_BASE] = { BL_voidHandleRunScriptCmd,        12u,  BL_COMMAND_FLAG_NO_BATCH },
+#if BL_LINK_TEST_ENABLE
+	[BL_ECHO               - BL_COMMAND_BASE] = { BL_voidHandleEchoCmd,              2u,  0u },
+	[BL_SINK               - BL_COMMAND_BASE] = { BL_voidHandleSinkCmd,              1u,  (BL_COMMAND_FLAG_OWN_CRC | BL_COMMAND_FLAG_NO_BATCH) },
+#endif
+};
+
+#define BL_COMMAND_COUNT             (sizeof(Global_Commands) / sizeof(Global_Commands[0]))
+
+#if BL_STATS_ENABLE
+static BL_CommandStats_t Global_CommandStats[BL_COMMAND_COUNT] BL_CCMRAM;
+#endif
+
+
+/*
+ * pCommand_Lookup
+ * ---------------
+ * Returns the Global_Commands entry of the frame's command code, or NULL for
+ * a code without a handler.
+ */
+static const BL_Command_t* pCommand_Lookup(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t Local_uint8Index = (uint8_t)(BL_FRAME_COMMAND(copy_puint8CmdPacket) - BL_COMMAND_BASE);
+
+	if((Local_uint8Index >= BL_COMMAND_COUNT) || (Global_Commands[Local_uint8Index].Handler == NULL))
+	{
+		return NULL;
+	}
+
+	return &Global_Commands[Local_uint8Index];
+}
+
+
+/*
+ * BL_voidDispatchCommand
+ * ----------------------
+ * Runs one received frame: the single place where the frame CRC is checked
+ * and a handler is chosen.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received v1 or extended frame.
+ *
+ * Behavior:
+ * ---------
+ * 1. Unknown codes (no table entry) are ignored, as before.
+ * 2. The host CRC is verified (uint8_VerifyFrameCRC), unless the command has
+ *    BL_COMMAND_FLAG_OWN_CRC.
+ * 3. A payload shorter than the entry's MinPayload is rejected.
+ * 4. A failed check sends a NACK, otherwise the handler is called.
+ */
+void BL_voidDispatchCommand(uint8_t* copy_puint8CmdPacket)
+{
+	const BL_Command_t* Local_pCommand = pCommand_Lookup(copy_puint8CmdPacket);
+#if BL_STATS_ENABLE
+	uint32_t Local_uint32Start = DWT->CYCCNT;
+#endif
+
+	if(Local_pCommand == NULL)
+	{
+		/* Invalid command from host */
+		return;
+	}
+
+	Global_uint8CommandNacked = 0;
+
+	if(((Local_pCommand->Flags & BL_COMMAND_FLAG_OWN_CRC) == 0u) && (uint8_VerifyFrameCRC(copy_puint8CmdPacket) != CRC_SUCCESS))
+	{
+		/* Send NACK if CRC verification fails */
+		voidSendNACK();
+	}
+	else if(uint16_GetFramePayloadLength(copy_puint8CmdPacket) < Local_pCommand->MinPayload)
+	{
+		voidSendNACK();
+	}
+	else
+	{
+		BL_TRACE(BL_TRACE_DISPATCH, BL_FRAME_COMMAND(copy_puint8CmdPacket), uint16_GetFramePayloadLength(copy_puint8CmdPacket));
+		Local_pCommand->Handler(copy_puint8CmdPacket);
+	}
+
+	/* The handler may have released the frame (stream): its code from the table */
+	BL_TRACE(BL_TRACE_DISPATCH_END, BL_COMMAND_BASE + (Local_pCommand - Global_Commands), Global_uint8CommandNacked);
+
+#if BL_STATS_ENABLE
+	voidRecordCommand((uint8_t)(Local_pCommand - Global_Commands), Local_uint32Start);
+#endif
+}
+
+
+#if BL_STATS_ENABLE
+/*
+ * voidRecordCommand
+ * -----------------
+ * One dispatch into the opcode's counters. CYCCNT wraps after 25 s at
+ * 168 MHz: longer commands (a mass erase at 16 MHz stays below) read short.
+ */
+static void voidRecordCommand(uint8_t Copy_uint8Index, uint32_t Copy_uint32Start)
+{
+	BL_CommandStats_t* Local_pStats       = &Global_CommandStats[Copy_uint8Index];
+	uint32_t           Local_uint32Cycles = DWT->CYCCNT - Copy_uint32Start;
+
+	Local_pStats->Count++;
+	Local_pStats->TotalCycles += Local_uint32Cycles;
+
+	if(Local_uint32Cycles > Local_pStats->MaxCycles)
+	{
+		Local_pStats->MaxCycles = Local_uint32Cycles;
+	}
+
+	if(Global_uint8CommandNacked != 0u)
+	{
+		Local_pStats->Nacks++;
+	}
+}
+#endif
+
+
+/**
+ * BL_voidHandleGetVERCmd
+ * @brief  Handles the "Get Version" command sent by the host.
+ *         Responds with the bootloader version.
+ *
+ * Behavior:
+ * ----------
+ * Called by BL_voidDispatchCommand() once the frame CRC has been verified:
+ *      - Sends an ACK response.
+ *      - Sends the bootloader version to the host.
+ *
+ * Parameters:
+ * -----------
+ * @param  copy_puint8CmdPacket: Pointer to the received command packet from the host.
+ *
+ * Return:
+ * -------
+ * @return None.
+ */
+void BL_voidHandleGetVERCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t Local_uint8BLVersion;
+
+	/* Send ACK and the bootloader version (1 byte) in one response */
+	Local_uint8BLVersion = BL_VERSION;
+	voidSendResponse(&Local_uint8BLVersion, 1u);
+}
+
+
+/*
+ * BL_voidHandleGetHelpCmd
+ * -----------------------
+ * This function handles the "Get Help" command in the bootloader.
+ * It sends back a list of supported bootloader commands to the host.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *
+ * Behavior:
+ * ---------
+ * Once BL_voidDispatchCommand() has verified the frame CRC:
+ *      - Sends an ACK with the size of the supported commands list.
+ *      - Transmits the list of supported commands (Global_uint8SupportedCommands).
+ */
+void BL_voidHandleGetHelpCmd(uint8_t* copy_puint8CmdPacket)
+{
+	/* Send an ACK with the size of the supported commands list, followed by the list */
+	voidSendResponse((uint8_t*)Global_uint8SupportedCommands, sizeof(Global_uint8SupportedCommands));
+}
+
+
+/*
+ * BL_voidHandleGetCIDcmd
+ * ----------------------
+ * This function handles the "Get Chip ID" command from the host.
+ * It extracts the Chip ID (CID) from the MCU's IDCODE register and sends it back.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *
+ * Behavior:
+ * ---------
+ * Once BL_voidDispatchCommand() has verified the frame CRC:
+ *    - Reads the Chip ID from the `DBGMCU_IDCODE_REGISTER`.
+ *    - Sends an ACK response to indicate success.
+ *    - Transmits the Chip ID (2 bytes) to the host.
+ */
+void BL_voidHandleGetCIDcmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint16_t Local_uint16CID ; // Variable to hold the extracted Chip ID
+
+	/* Step 4: Retrieve Chip ID (12-bit value from the DBGMCU_IDCODE register) */
+	Local_uint16CID = DBGMCU_IDCODE_REGISTER & 0x0fff;
+
+	/* Step 5: Send ACK with the response length (2 bytes for Chip ID) and the Chip ID */
+	voidSendResponse((uint8_t*)&Local_uint16CID, 2u);
+}
+
+
+
+/*
+ * BL_voidHandleGetRDPStatusCmd
+ * ----------------------------
+ * This function handles the "Get Read Protection (RDP) Status" command from the host.
+ * It extracts the RDP status from the option bytes, and sends it back.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket   : Pointer to the received command packet from the host.
+ *
+ * Behavior:
+ * ---------
+ * Once BL_voidDispatchCommand() has verified the frame CRC:
+ *      - Reads the RDP status from the option bytes at `RDP_USER_OPTION_WORD`.
+ *      - Sends an ACK followed by the 1-byte RDP status.
+ */
+void BL_voidHandleGetRDPStatusCmd(uint8_t* copy_puint8CmdPacket)
+{
+	/* Extract RDP status from option bytes (stored in the upper byte) */
+	uint8_t Local_uint8RDPStatus = (uint8_t)((RDP_USER_OPTION_WORD >> 8) & 0xff);
+
+	/* Send ACK and the RDP status (1 byte) back to the host */
+	voidSendResponse(&Local_uint8RDPStatus, 1u);
+}
+
+/*
+ * uint8_CheckVectorTable
+ * ----------------------
+ * BL_GO_FLAG_VECTOR_TABLE: the address must be a VTOR-aligned (512 bytes)
+ * table in an executable region, its initial MSP a word-aligned address in
+ * SRAM or CCMRAM (at most the end of it), its reset handler a Thumb address
+ * in an executable region.
+ *
+ * Return: VALID_ADDRESS / NOT_VALID_ADDRESS.
+ */
+static uint8_t uint8_CheckVectorTable(uint32_t Copy_uint32Base)
+{
+	uint32_t Local_uint32Stack;
+	uint32_t Local_uint32Reset;
+
+	if(((Copy_uint32Base & 0x1FFu) != 0u) || (pMemory_LookupRegion(Copy_uint32Base, 8u, BL_MEMORY_EXECUTE) == NULL))
+	{
+		return NOT_VALID_ADDRESS;
+	}
+
+	Local_uint32Stack = *((const volatile uint32_t*)Copy_uint32Base);
+	Local_uint32Reset = *((const volatile uint32_t*)(Copy_uint32Base + 4u));
+
+	if(((Local_uint32Stack & 0x3u) != 0u) ||
+	   !(((Local_uint32Stack > CCMDATARAM_BASE) && (Local_uint32Stack <= (CCMDATARAM_END + 1u))) ||
+	     ((Local_uint32Stack > SRAM1_BASE) && (Local_uint32Stack <= (SRAM2_BASE + (16u * 1024u))))))
+	{
+		return NOT_VALID_ADDRESS;
+	}
+
+	if(((Local_uint32Reset & 1u) == 0u) || (pMemory_LookupRegion(Local_uint32Reset & ~1UL, 2u, BL_MEMORY_EXECUTE) == NULL))
+	{
+		return NOT_VALID_ADDRESS;
+	}
+
+	return VALID_ADDRESS;
+}
+
+
+/*
+ * uint8_CheckLoader
+ * -----------------
+ * BL_GO_FLAG_LOADER, after uint8_CheckVectorTable: the table lies in the RAM
+ * run area, its BL_LoaderHeader_t has the magic, an ABI version this
+ * bootloader implements and a length that stays inside the area, and the
+ * command came over USART2, the link a loader takes over.
+ *
+ * Return: VALID_ADDRESS / NOT_VALID_ADDRESS.
+ */
+static uint8_t uint8_CheckLoader(uint32_t Copy_uint32Base)
+{
+	const volatile BL_LoaderHeader_t* Local_pHeader = BL_LOADER_HEADER(Copy_uint32Base);
+	uint32_t Local_uint32End = BL_RAM_RUN_BASE + BL_RAM_RUN_SIZE;
+
+	if((Copy_uint32Base < BL_RAM_RUN_BASE) || ((Copy_uint32Base + BL_LOADER_HEADER_OFFSET + sizeof(BL_LoaderHeader_t)) > Local_uint32End))
+	{
+		return NOT_VALID_ADDRESS;
+	}
+
+	if((Local_pHeader->Magic != BL_LOADER_MAGIC) || (Local_pHeader->AbiVersion == 0u) ||
+	   (Local_pHeader->AbiVersion > BL_LOADER_ABI_VERSION) ||
+	   (Local_pHeader->Length < (BL_LOADER_HEADER_OFFSET + sizeof(BL_LoaderHeader_t))) ||
+	   (Local_pHeader->Length > (Local_uint32End - Copy_uint32Base)))
+	{
+		return NOT_VALID_ADDRESS;
+	}
+
+	return (BL_uint8TransportGetLink() == BL_LINK_UART) ? VALID_ADDRESS : NOT_VALID_ADDRESS;
+}
+
+
+/*
+ * BL_voidHandleGoToAddressCmd
+ * ----------------------------
+ * Handles the "Go To Address" command from the Host, which requests jumping to a specific
+ * memory address and executing the code present there.
+ *
+ * **Parameters:**
+ * ---------------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet containing:
+ *        - Command length
+ *        - Target address
+ *        - CRC for verification
+ *
+ *        - Flags (optional): BL_GO_FLAG_VECTOR_TABLE / BL_GO_FLAG_LOADER
+ *
+ * **Behavior:**
+ * ------------
+ * Once BL_voidDispatchCommand() has verified the frame CRC:
+ * 1. Extracts the target memory address from the command packet.
+ * 2. Validates that the address lies in an executable memory region; with a
+ *    flag, that it holds a vector table (uint8_CheckVectorTable) and, for
+ *    BL_GO_FLAG_LOADER, a second-stage loader (uint8_CheckLoader).
+ * 3. If valid:
+ *    - Sends ACK + confirmation to the Host and waits until it is sent.
+ *    - Jumps to the specified address by updating the Program Counter (PC),
+ *      or starts the table (Bootloader_JumpToImage / Bootloader_JumpToLoader).
+ * 4. If invalid, replies NOT_VALID_ADDRESS.
+ */
+void BL_voidHandleGoToAddressCmd(uint8_t* copy_puint8CmdPacket)
+{
+    uint32_t Local_uint32Address;
+    uint8_t Local_uint8AddressValidStatus;
+    uint8_t Local_uint8Flags = 0;
+
+    /* Extract the target address from the command packet */
+    Local_uint32Address = uint32_GetField(puint8_GetFramePayload(copy_puint8CmdPacket));
+
+    if (uint16_GetFramePayloadLength(copy_puint8CmdPacket) >= 5u)
+    {
+        Local_uint8Flags = puint8_GetFramePayload(copy_puint8CmdPacket)[4];
+    }
+
+    /* Validate if the extracted address lies in an executable region */
+    Local_uint8AddressValidStatus = (pMemory_LookupRegion(Local_uint32Address, 2u, BL_MEMORY_EXECUTE) != NULL) ? VALID_ADDRESS : NOT_VALID_ADDRESS;
+
+    if ((Local_uint8Flags & (BL_GO_FLAG_VECTOR_TABLE | BL_GO_FLAG_LOADER)) != 0u)
+    {
+        Local_uint8AddressValidStatus = uint8_CheckVectorTable(Local_uint32Address);
+    }
+
+    if (((Local_uint8Flags & BL_GO_FLAG_LOADER) != 0u) && (Local_uint8AddressValidStatus == VALID_ADDRESS))
+    {
+        Local_uint8AddressValidStatus = uint8_CheckLoader(Local_uint32Address);
+    }
+
+    if (Local_uint8AddressValidStatus == VALID_ADDRESS)
+    {
+        /* Never jump into a sector that is still being erased, never leave the flash unlocked */
+        voidFinishEraseJob();
+        voidCloseSession();
+
+        /* Notify the Host that the address is valid, the reply must be on the line before jumping */
+        voidSendResponse(&Local_uint8AddressValidStatus, 1u);
+        BL_voidTransportTxFlush();
+
+        if ((Local_uint8Flags & BL_GO_FLAG_LOADER) != 0u)
+        {
+            Bootloader_JumpToLoader(Local_uint32Address);
+        }
+        else if ((Local_uint8Flags & BL_GO_FLAG_VECTOR_TABLE) != 0u)
+        {
+            Bootloader_JumpToImage(Local_uint32Address);
+        }
+        else
+        {
+            /*
+             * Jump to the specified address:
+             * - Define a pointer to function.
+             * - Increment address by 1 to ensure Thumb mode (T-bit = 1).
+             * - Cast address to function pointer and execute.
+             */
+            void (*Local_pvFuncPtr)(void) = NULL;
+            Local_uint32Address|=0x1;  /* Set T-bit for ARM Cortex-M Thumb mode */
+            Local_pvFuncPtr = (void*)Local_uint32Address;
+            Local_pvFuncPtr();  /* Jump to the specified address */
+
+            /* Same to __asm volatile("MSR PC ,%0"::"r"(Local_uint32Address+1));
+             * */
+        }
+    }
+    else
+    {
+    	/* Notify the Host that the address is Invalid */
+      voidSendResponse(&Local_uint8AddressValidStatus, 1u);
+    }
+}
+
+
+/*
+ * BL_voidHandleFlashEraseCmd
+ * --------------------------
+ * Handles the flash erase command received from the host.
+ * This function extracts and verifies the command data, performs the requested erase operation,
+ * and returns the erase status.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               The expected packet structure:
+ *                               - Byte [0]  : Command length (excluding itself).
+ *                               - Byte [1]  : Command identifier.
+ *                               - Byte [2]  : Sector number to erase (or `MASS_ERASE` for full erase).
+ *                               - Byte [3]  : Number of sectors to erase.
+ *                               - Byte [4]  : Optional flags, BL_ERASE_FLAG_ASYNC / BL_ERASE_FLAG_PLAN.
+ *                               - Last 4 bytes: CRC checksum for validation.
+ *
+ * Behavior:
+ * ---------
+ * Once BL_voidDispatchCommand() has verified the frame CRC:
+ *    - Turns on an LED (LD5) to indicate an erase operation in progress.
+ *    - Calls `uint8_tExecute_FlashErase()` to perform the erase.
+ *    - Turns off the LED (LD5) after completion.
+ *    - Sends ACK, the erase status and the bitmap of sectors skipped as
+ *      already blank (16-bit, little endian) back to the host in one response.
+ *    - With BL_ERASE_FLAG_ASYNC the erase is only started: the reply (bitmap 0)
+ *      comes at once and BL_FLASH_ERASE_STATUS reports the progress.
+ *    - With BL_ERASE_FLAG_PLAN the erase skips write-protected sectors and
+ *      replies with one result per sector (voidRunPlannedErase).
+ *
+ * Return:
+ * -------
+ * - No return value (void), but the function sends feedback to the host via UART.
+ */
+void BL_voidHandleFlashEraseCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t  Local_uint8EraseStatus ;
+	uint16_t Local_uint16BlankSectors = 0 ;
+
+	 uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	 uint16_t Local_uint16PayloadLength = uint16_GetFramePayloadLength(copy_puint8CmdPacket);
+
+	 if((Local_uint16PayloadLength >= 3u) && (Local_puint8Payload[2] & BL_ERASE_FLAG_PLAN))
+	 {
+		 /* Per-sector results, protected sectors never issued */
+		 voidRunPlannedErase(Local_puint8Payload[0], Local_puint8Payload[1]);
+		 return;
+	 }
+
+	 /* Turn on LED (LD5) to indicate flash erase is in progress */
+	 HAL_GPIO_WritePin(LD5_GPIO_Port, LD5_Pin, GPIO_PIN_SET) ;
+
+	 if((Local_uint16PayloadLength >= 3u) && (Local_puint8Payload[2] & BL_ERASE_FLAG_ASYNC) &&
+	    (Local_puint8Payload[0] != MASS_ERASE) && (Local_puint8Payload[0] < NUMBER_OF_SECTORS) &&
+	    (Local_puint8Payload[1] <= NUMBER_OF_SECTORS))
+	 {
+		 /* Background erase: only the first sector is started here */
+		 voidStartEraseJob(Local_puint8Payload[0], Local_puint8Payload[1]);
+		 Local_uint8EraseStatus = HAL_OK;
+	 }
+	 else
+	 {
+		 /* Execute flash erase */
+		 Local_uint8EraseStatus =  uint8_tExecute_FlashErase(Local_puint8Payload[0] ,Local_puint8Payload[1], &Local_uint16BlankSectors) ;
+	 }
+
+	 /* Turn off LED (LD5) after erase completion */
+	 HAL_GPIO_WritePin(LD5_GPIO_Port, LD5_Pin, GPIO_PIN_RESET) ;
+
+	 /* Send ACK with the erase status and the bitmap of blank (skipped) sectors */
+	 voidSendEraseReply(Local_uint8EraseStatus, Local_uint16BlankSectors);
+}
+
+void BL_voidHandleMemWriteCmd(uint8_t* copy_puint8CmdPacket)
+{
+     uint8_t Local_uint8WritingStatus ;
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+
+	/*Extract the base memory address from command */
+	uint32_t Local_uint32Address = uint32_GetField(&Local_puint8Payload[0]);
+
+	/*Extract Payload Length (16-bit in extended and aligned frames) */
+	uint16_t Local_uint16PayloadLength;
+	uint8_t* Local_puint8Data;
+
+	if(copy_puint8CmdPacket[0] == BL_FRAME_EXT_MARKER)
+	{
+		Local_uint16PayloadLength = uint16_GetField(&Local_puint8Payload[4]);
+		Local_puint8Data = &Local_puint8Payload[6];
+	}
+	else if(copy_puint8CmdPacket[0] == BL_FRAME_ALIGNED_MARKER)
+	{
+		BL_AlignedWrite_t* Local_pAligned = (BL_AlignedWrite_t*)Local_puint8Payload;
+
+		Local_uint16PayloadLength = Local_pAligned->Length;
+		Local_puint8Data = Local_pAligned->Data;
+	}
+	else
+	{
+		Local_uint16PayloadLength = Local_puint8Payload[4];
+		Local_puint8Data = &Local_puint8Payload[5];
+	}
+
+	/* The data must lie inside the payload, before the padding and the CRC */
+	if((Local_puint8Data + Local_uint16PayloadLength) <= (Local_puint8Payload + uint16_GetFramePayloadLength(copy_puint8CmdPacket)))
+	{
+#if BL_DECRYPT_ENABLE
+		voidDecryptPayload(Local_puint8Data, Local_uint32Address, Local_uint16PayloadLength);
+#endif
+		Local_uint8WritingStatus = uint8_WriteRegion(Local_puint8Data ,Local_uint32Address ,Local_uint16PayloadLength);
+#if BL_RS485_ENABLE
+		if(Local_uint8WritingStatus == HAL_OK)
+		{
+			BL_voidTransportBroadcastDone();
+		}
+#endif
+	}
+	else
+	{
+		Local_uint8WritingStatus = WRITING_ERROR ;
+	}
+
+	/* Send ACK and the writing status in one response */
+	voidSendWriteStatus(Local_uint8WritingStatus);
+}
+
+/*
+ * BL_voidHandleEnRWProtectCmd
+ * ---------------------------
+ * Write-protects a set of sectors in one option-byte programming cycle.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               The expected packet structure:
+ *                               - Byte [0]     : Command length (excluding itself).
+ *                               - Byte [1]     : Command identifier.
+ *                               - Byte [2:3]   : Sector mask (little endian, bit n = sector n).
+ *                               - Byte [4]     : BL_PROTECT_MODE_WRITE.
+ *                               - Last 4 bytes : CRC checksum for validation.
+ *
+ * Behavior:
+ * ---------
+ * Replies [status] [write-protected bitmap (2, LE)]. HAL_ERROR without any
+ * change for a missing mask, an unsupported mode or sectors beyond 11.
+ */
+void BL_voidHandleEnRWProtectCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t  Local_uint8Reply[3];
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint16_t Local_uint16PayloadLength = uint16_GetFramePayloadLength(copy_puint8CmdPacket);
+	uint16_t Local_uint16Mask;
+
+	Local_uint8Reply[0] = HAL_ERROR;
+
+	if(Local_uint16PayloadLength >= 3u)
+	{
+		Local_uint16Mask = uint16_GetField(&Local_puint8Payload[0]);
+
+		if((Local_puint8Payload[2] == BL_PROTECT_MODE_WRITE) && ((Local_uint16Mask & ~OB_WRP_SECTOR_All) == 0u))
+		{
+			Local_uint8Reply[0] = uint8_ProgramWriteProtection(Local_uint16Mask, OB_WRPSTATE_ENABLE);
+		}
+	}
+
+	Local_uint16Mask = uint16_ReadWriteProtection();
+	Local_uint8Reply[1] = (uint8_t)(Local_uint16Mask & 0xFFu);
+	Local_uint8Reply[2] = (uint8_t)(Local_uint16Mask >> 8);
+
+	voidSendResponse(Local_uint8Reply, 3u);
+}
+
+#if BL_READ_RLE_ENABLE
+/*
+ * uint8_ReadRunStarts
+ * -------------------
+ * A run worth a repeat record starts at Copy_puint8Data: aligned, and the
+ * first BL_MEM_READ_RLE_MIN_WORDS words of the remaining bytes are equal.
+ */
+static uint8_t uint8_ReadRunStarts(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Remaining)
+{
+	const uint32_t* Local_puint32Words = (const uint32_t*)Copy_puint8Data;
+	uint8_t Local_uint8Index;
+
+	if((((uint32_t)Copy_puint8Data & 0x3u) != 0u) || (Copy_uint32Remaining < (4u * BL_MEM_READ_RLE_MIN_WORDS)))
+	{
+		return 0u;
+	}
+
+	for(Local_uint8Index = 1; Local_uint8Index < BL_MEM_READ_RLE_MIN_WORDS; Local_uint8Index++)
+	{
+		if(Local_puint32Words[Local_uint8Index] != Local_puint32Words[0])
+		{
+			return 0u;
+		}
+	}
+
+	return 1u;
+}
+
+
+/*
+ * uint16_EncodeReadRle
+ * --------------------
+ * Fills one BL_MEM_READ response with whole RLE records (see "Memory Read"
+ * in BL.h) and advances the read cursor past the bytes they describe.
+ *
+ * Behavior:
+ * ---------
+ * - At a run start, the whole run becomes one repeat record.
+ * - Otherwise bytes are gathered into a literal record up to the next run
+ *   start, the end of the range or the room left in the response.
+ * - Stops when the next record does not fit.
+ *
+ * Return:
+ * -------
+ * Number of bytes written to Copy_puint8Out.
+ */
+static uint16_t uint16_EncodeReadRle(uint8_t* Copy_puint8Out, uint16_t Copy_uint16Capacity,
+                                     const uint8_t** Copy_ppuint8Data, uint32_t* Copy_puint32Remaining)
+{
+	const uint8_t* Local_puint8Data = *Copy_ppuint8Data;
+	uint32_t Local_uint32Remaining  = *Copy_puint32Remaining;
+	uint16_t Local_uint16Out = 0u;
+	uint32_t Local_uint32Count;
+	uint32_t Local_uint32Word;
+	uint16_t Local_uint16Literal;
+	uint16_t Local_uint16MaxLiteral;
+
+	while(Local_uint32Remaining != 0u)
+	{
+		if(uint8_ReadRunStarts(Local_puint8Data, Local_uint32Remaining) != 0u)
+		{
+			if((Local_uint16Out + 9u) > Copy_uint16Capacity)
+			{
+				break;
+			}
+
+			Local_uint32Word  = *((const uint32_t*)Local_puint8Data);
+			Local_uint32Count = BL_MEM_READ_RLE_MIN_WORDS;
+			while(((Local_uint32Remaining - (4u * Local_uint32Count)) >= 4u) &&
+			      (((const uint32_t*)Local_puint8Data)[Local_uint32Count] == Local_uint32Word))
+			{
+				Local_uint32Count++;
+			}
+
+			Copy_puint8Out[Local_uint16Out] = BL_MEM_READ_RLE_REPEAT;
+			memcpy(&Copy_puint8Out[Local_uint16Out + 1u], &Local_uint32Word, 4u);
+			memcpy(&Copy_puint8Out[Local_uint16Out + 5u], &Local_uint32Count, 4u);
+			Local_uint16Out += 9u;
+
+			Local_puint8Data      += 4u * Local_uint32Count;
+			Local_uint32Remaining -= 4u * Local_uint32Count;
+		}
+		else
+		{
+			if((Local_uint16Out + 4u) > Copy_uint16Capacity)
+			{
+				break;
+			}
+
+			Local_uint16MaxLiteral = (uint16_t)(Copy_uint16Capacity - Local_uint16Out - 3u);
+			if(Local_uint32Remaining < Local_uint16MaxLiteral)
+			{
+				Local_uint16MaxLiteral = (uint16_t)Local_uint32Remaining;
+			}
+
+			Local_uint16Literal = 1u;
+			while((Local_uint16Literal < Local_uint16MaxLiteral) &&
+			      (uint8_ReadRunStarts(&Local_puint8Data[Local_uint16Literal], Local_uint32Remaining - Local_uint16Literal) == 0u))
+			{
+				Local_uint16Literal++;
+			}
+
+			Copy_puint8Out[Local_uint16Out]      = BL_MEM_READ_RLE_LITERAL;
+			Copy_puint8Out[Local_uint16Out + 1u] = (uint8_t)(Local_uint16Literal & 0xFFu);
+			Copy_puint8Out[Local_uint16Out + 2u] = (uint8_t)(Local_uint16Literal >> 8);
+			memcpy(&Copy_puint8Out[Local_uint16Out + 3u], Local_puint8Data, Local_uint16Literal);
+			Local_uint16Out += (uint16_t)(3u + Local_uint16Literal);
+
+			Local_puint8Data      += Local_uint16Literal;
+			Local_uint32Remaining -= Local_uint16Literal;
+		}
+	}
+
+	*Copy_ppuint8Data      = Local_puint8Data;
+	*Copy_puint32Remaining = Local_uint32Remaining;
+
+	return Local_uint16Out;
+}
+#endif
+
+
+/*
+ * BL_voidHandleMemReadCmd
+ * -----------------------
+ * Reads a flash / SRAM range back to the host (crash logs, calibration data).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               The expected packet structure:
+ *                               - Byte [0]     : Command length (excluding itself).
+ *                               - Byte [1]     : Command identifier.
+ *                               - Byte [2:5]   : Start address (little endian).
+ *                               - Byte [6:7] or [6:9] : Length in bytes (16 or 32-bit, little endian).
+ *                               - Byte [10]    : Flags (optional, BL_MEM_READ_FLAG_xxx).
+ *                               - Last 4 bytes : CRC checksum for validation.
+ *
+ * Behavior:
+ * ---------
+ * 1. Waits for a background erase and programs staged writes, so the data
+ *    read is what the host wrote.
+ * 2. Replies [status] [length (4, LE)]. HAL_ERROR for an invalid range, and
+ *    nothing follows.
+ * 3. Sends the range in BL_MEM_READ_CHUNK_SIZE responses, each with its own
+ *    CRC. Over UART / USB the data is not copied: the header and CRC go from
+ *    the TX buffer, the data by DMA (UART) straight from memory, one piece
+ *    after the other, so the line stays busy at full speed. Over SPI, where a
+ *    response is read as one buffer, each chunk is assembled in the TX buffer.
+ *    With BL_MEM_READ_FLAG_RLE each response is encoded in the TX buffer
+ *    instead (uint16_EncodeReadRle): an erased region costs a few bytes.
+ */
+void BL_voidHandleMemReadCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t  Local_uint8Reply[5];
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint16_t Local_uint16PayloadLength = uint16_GetFramePayloadLength(copy_puint8CmdPacket);
+	uint32_t Local_uint32Address = uint32_GetField(&Local_puint8Payload[0]);
+	uint32_t Local_uint32Length  = 0u;
+	const uint8_t* Local_puint8Data;
+	uint8_t* Local_puint8Tx;
+	uint16_t Local_uint16Chunk;
+	uint16_t Local_uint16HeaderLength;
+	uint32_t Local_uint32ChunkCRC;
+	uint8_t  Local_uint8Flags = 0u;
+	const BL_MemoryRegion_t* Local_pRegion;
+
+	if(Local_uint16PayloadLength >= 9u)
+	{
+		Local_uint8Flags = Local_puint8Payload[8];
+	}
+
+	if(Local_uint16PayloadLength >= 8u)
+	{
+		Local_uint32Length = uint32_GetField(&Local_puint8Payload[4]);
+	}
+	else if(Local_uint16PayloadLength >= 6u)
+	{
+		Local_uint32Length = uint16_GetField(&Local_puint8Payload[4]);
+	}
+
+	voidFinishEraseJob();
+	uint8_FlushWriteBuffer();
+
+	Local_pRegion = pMemory_LookupRegion(Local_uint32Address, Local_uint32Length, BL_MEMORY_READ);
+	Local_uint8Reply[0] = (Local_pRegion != NULL) ? HAL_OK : HAL_ERROR;
+	memcpy(&Local_uint8Reply[1], &Local_uint32Length, 4u);
+	voidSendResponse(Local_uint8Reply, 5u);
+
+	Local_puint8Data = (const uint8_t*)Local_uint32Address;
+
+#if BL_READ_RLE_ENABLE
+	while((Local_uint8Reply[0] == HAL_OK) && (Local_uint32Length != 0u) && ((Local_uint8Flags & BL_MEM_READ_FLAG_RLE) != 0u))
+	{
+		/* Encoded behind the longest header; moved down when the short one is enough */
+		Local_puint8Tx = BL_puint8TransportTxAcquire();
+		Local_uint16Chunk = uint16_EncodeReadRle(&Local_puint8Tx[4], BL_MEM_READ_CHUNK_SIZE, &Local_puint8Data, &Local_uint32Length);
+		Local_uint16HeaderLength = uint8_BuildAckHeader(Local_puint8Tx, Local_uint16Chunk);
+		if(Local_uint16HeaderLength != 4u)
+		{
+			memmove(&Local_puint8Tx[Local_uint16HeaderLength], &Local_puint8Tx[4], Local_uint16Chunk);
+		}
+
+		Local_uint16Chunk = (uint16_t)(Local_uint16HeaderLength + Local_uint16Chunk);
+		Local_uint32ChunkCRC = uint32_CalculateCRC(Local_puint8Tx, Local_uint16Chunk);
+		memcpy(&Local_puint8Tx[Local_uint16Chunk], &Local_uint32ChunkCRC, 4u);
+
+		BL_voidTransportTxStart((uint16_t)(Local_uint16Chunk + 4u));
+	}
+#else
+	(void)Local_uint8Flags;
+#endif
+
+	while((Local_uint8Reply[0] == HAL_OK) && (Local_uint32Length != 0u))
+	{
+		Local_uint16Chunk = (Local_uint32Length > BL_MEM_READ_CHUNK_SIZE) ? (uint16_t)BL_MEM_READ_CHUNK_SIZE : (uint16_t)Local_uint32Length;
+
+		Local_puint8Tx = BL_puint8TransportTxAcquire();
+		Local_uint16HeaderLength = uint8_BuildAckHeader(Local_puint8Tx, Local_uint16Chunk);
+
+		if((BL_uint8TransportGetLink() == BL_LINK_SPI) || (BL_uint8TransportGetFraming() == BL_FRAMING_COBS) ||
+		   ((Local_pRegion->Access & BL_MEMORY_DMA) == 0u))
+		{
+			/* Copied first: the CRC DMA cannot read CCMRAM / backup SRAM either, COBS encodes whole responses */
+			memcpy(&Local_puint8Tx[Local_uint16HeaderLength], Local_puint8Data, Local_uint16Chunk);
+			Local_uint32ChunkCRC = uint32_CalculateCRC(Local_puint8Tx, (uint16_t)(Local_uint16HeaderLength + Local_uint16Chunk));
+			memcpy(&Local_puint8Tx[Local_uint16HeaderLength + Local_uint16Chunk], &Local_uint32ChunkCRC, 4u);
+			BL_voidTransportTxStart((uint16_t)(Local_uint16HeaderLength + Local_uint16Chunk + 4u));
+		}
+		else
+		{
+			Local_uint32ChunkCRC = uint32_CalculateFrameCRC(Local_puint8Tx, Local_uint16HeaderLength, Local_puint8Data, Local_uint16Chunk);
+
+			/* The CRC waits behind the header in the TX buffer, which stays busy until it is sent */
+			memcpy(&Local_puint8Tx[Local_uint16HeaderLength], &Local_uint32ChunkCRC, 4u);
+			BL_voidTransportTxStart(Local_uint16HeaderLength);
+			BL_voidTransportTxSendBuffer(Local_puint8Data, Local_uint16Chunk);
+			BL_voidTransportTxSendBuffer(&Local_puint8Tx[Local_uint16HeaderLength], 4u);
+		}
+
+		Local_puint8Data   += Local_uint16Chunk;
+		Local_uint32Length -= Local_uint16Chunk;
+	}
+}
+
+/*
+ * BL_voidHandleReadSectorStatusCmd
+ * --------------------------------
+ * Reports the protection of every sector in one response, so the host can
+ * plan an erase around protected sectors instead of timing out on them.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *
+ * Behavior:
+ * ---------
+ * Reads the option bytes with HAL_FLASHEx_OBGetConfig() and replies
+ * [write-protected bitmap (2, LE)] [RDP level] [user option byte] [BOR level]:
+ * bit n set = sector n write protected (nWRPn = 0). The F407 has no PCROP
+ * (SPRMOD), nWRP is its only per-sector protection.
+ */
+void BL_voidHandleReadSectorStatusCmd(uint8_t* copy_puint8CmdPacket)
+{
+	FLASH_OBProgramInitTypeDef Local_OptionBytes;
+	uint8_t  Local_uint8Reply[5];
+	uint16_t Local_uint16Protected = uint16_ReadWriteProtection();
+
+	HAL_FLASHEx_OBGetConfig(&Local_OptionBytes);
+
+	Local_uint8Reply[0] = (uint8_t)(Local_uint16Protected & 0xFFu);
+	Local_uint8Reply[1] = (uint8_t)(Local_uint16Protected >> 8);
+	Local_uint8Reply[2] = (uint8_t)Local_OptionBytes.RDPLevel;
+	Local_uint8Reply[3] = Local_OptionBytes.USERConfig;
+	Local_uint8Reply[4] = (uint8_t)Local_OptionBytes.BORLevel;
+
+	voidSendResponse(Local_uint8Reply, 5u);
+}
+
+
+/*
+ * BL_voidHandleOTPReadCmd
+ * -----------------------
+ * Reads calibration / serial data from the OTP area in one round trip.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               The expected packet structure:
+ *                               - Byte [0]     : Command length (excluding itself).
+ *                               - Byte [1]     : Command identifier.
+ *                               - Byte [2]     : First block (optional, 0 .. 15).
+ *                               - Byte [3]     : Number of blocks (optional).
+ *                               - Last 4 bytes : CRC checksum for validation.
+ *
+ * Behavior:
+ * ---------
+ * Without a range the whole area is returned. The reply is built straight in
+ * the TX buffer: [HAL_OK] [lock bytes (16)] [blocks], or [HAL_ERROR] alone
+ * for a range beyond block 15.
+ */
+void BL_voidHandleOTPReadCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint16_t Local_uint16PayloadLength = uint16_GetFramePayloadLength(copy_puint8CmdPacket);
+	uint8_t  Local_uint8FirstBlock = 0u;
+	uint8_t  Local_uint8BlockCount = BL_OTP_BLOCK_COUNT;
+	uint16_t Local_uint16DataLength;
+	uint8_t* Local_puint8Tx;
+	uint16_t Local_uint16TxLength;
+
+	if(Local_uint16PayloadLength >= 1u)
+	{
+		Local_uint8FirstBlock = Local_puint8Payload[0];
+		Local_uint8BlockCount = (uint8_t)(BL_OTP_BLOCK_COUNT - Local_uint8FirstBlock);
+	}
+	if(Local_uint16PayloadLength >= 2u)
+	{
+		Local_uint8BlockCount = Local_puint8Payload[1];
+	}
+
+	if(((uint16_t)Local_uint8FirstBlock + Local_uint8BlockCount) <= BL_OTP_BLOCK_COUNT)
+	{
+		Local_uint16DataLength = (uint16_t)(Local_uint8BlockCount * BL_OTP_BLOCK_SIZE);
+
+		Local_puint8Tx = BL_puint8TransportTxAcquire();
+		Local_uint16TxLength = uint8_BuildAckHeader(Local_puint8Tx, (uint16_t)(1u + BL_OTP_BLOCK_COUNT + Local_uint16DataLength));
+
+		Local_puint8Tx[Local_uint16TxLength++] = HAL_OK;
+
+		memcpy(&Local_puint8Tx[Local_uint16TxLength], (const uint8_t*)BL_OTP_LOCK_ADDRESS, BL_OTP_BLOCK_COUNT);
+		Local_uint16TxLength += BL_OTP_BLOCK_COUNT;
+
+		memcpy(&Local_puint8Tx[Local_uint16TxLength],
+		       (const uint8_t*)(FLASH_OTP_BASE + ((uint32_t)Local_uint8FirstBlock * BL_OTP_BLOCK_SIZE)), Local_uint16DataLength);
+		Local_uint16TxLength += Local_uint16DataLength;
+
+		voidStartResponse(Local_puint8Tx, Local_uint16TxLength);
+	}
+	else
+	{
+		uint8_t Local_uint8Status = HAL_ERROR;
+
+		voidSendResponse(&Local_uint8Status, 1u);
+	}
+}
+
+/*
+ * BL_voidHandleDisWRProtectCmd
+ * ----------------------------
+ * Removes the write protection of a set of sectors in one option-byte
+ * programming cycle.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               The expected packet structure:
+ *                               - Byte [0]     : Command length (excluding itself).
+ *                               - Byte [1]     : Command identifier.
+ *                               - Byte [2:3]   : Sector mask (optional, little endian, default: all).
+ *                               - Last 4 bytes : CRC checksum for validation.
+ *
+ * Behavior:
+ * ---------
+ * Replies [status] [write-protected bitmap (2, LE)]. HAL_ERROR without any
+ * change for sectors beyond 11.
+ */
+void BL_voidHandleDisWRProtectCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t  Local_uint8Reply[3];
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint16_t Local_uint16PayloadLength = uint16_GetFramePayloadLength(copy_puint8CmdPacket);
+	uint16_t Local_uint16Mask = (uint16_t)OB_WRP_SECTOR_All;
+
+	if(Local_uint16PayloadLength >= 2u)
+	{
+		Local_uint16Mask = uint16_GetField(&Local_puint8Payload[0]);
+	}
+
+	Local_uint8Reply[0] = HAL_ERROR;
+	if((Local_uint16Mask & ~OB_WRP_SECTOR_All) == 0u)
+	{
+		Local_uint8Reply[0] = uint8_ProgramWriteProtection(Local_uint16Mask, OB_WRPSTATE_DISABLE);
+	}
+
+	Local_uint16Mask = uint16_ReadWriteProtection();
+	Local_uint8Reply[1] = (uint8_t)(Local_uint16Mask & 0xFFu);
+	Local_uint8Reply[2] = (uint8_t)(Local_uint16Mask >> 8);
+
+	voidSendResponse(Local_uint8Reply, 3u);
+}
+
+/*
+ * BL_voidHandleMemWriteStreamCmd
+ * ------------------------------
+ * Handles one packet of a windowed streaming write. The host keeps several
+ * packets in flight and does not wait for a reply per packet; the RX ring
+ * buffers them while the current one is being programmed.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               The expected packet structure:
+ *                               - Byte [0]     : Command length (excluding itself).
+ *                               - Byte [1]     : Command identifier.
+ *                               - Byte [2..3]  : Sequence number (little endian).
+ *                               - Byte [4]     : Flags (BL_STREAM_FLAG_START / _LAST / _AUTO_ERASE / _DIFFERENTIAL).
+ *                               - Byte [5..8]  : Target address.
+ *                               - Byte [9]     : Payload length.
+ *                               - Byte [10..]  : Payload.
+ *                               - Last 4 bytes : CRC checksum for validation.
+ *                               In an extended frame the same fields follow the
+ *                               3-byte header, with a 16-bit payload length.
+ *
+ * Behavior:
+ * ---------
+ * 1. A corrupted packet cannot be trusted for its sequence number: the host is
+ *    asked to retransmit from the next expected sequence (BL_STREAM_RETRANSMIT).
+ * 2. A packet with an unexpected sequence number (lost predecessor) is answered
+ *    with a single RETRANSMIT; the rest of the window is dropped silently.
+ * 3. An in-order packet is written with uint8_ExecuteMemoryWrite(). In a stream
+ *    started with BL_STREAM_FLAG_AUTO_ERASE, the sectors it lands in are erased
+ *    first if this stream has not erased them yet (uint8_AutoErase()). In a
+ *    stream started with BL_STREAM_FLAG_DIFFERENTIAL only the words that differ
+ *    are programmed (uint8_ExecuteDifferentialWrite()); a packet that would
+ *    need an erase stops the stream with BL_STREAM_ERASE_REQUIRED.
+ * 4. A cumulative BL_STREAM_ACK is sent every STREAM_ACK_INTERVAL packets and
+ *    on the packet flagged BL_STREAM_FLAG_LAST.
+ * 5. In a stream started with BL_STREAM_FLAG_SELECTIVE, packets ahead of the
+ *    expected one (inside BL_STREAM_SELECTIVE_WINDOW) are written too and
+ *    recorded in Global_uint32StreamReceived; gaps are reported with
+ *    BL_STREAM_MISSING and its bitmap, and only the missing packets are resent.
+ */
+void BL_voidHandleMemWriteStreamCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t Local_uint8CRCStatus;
+
+	/* Verify CRC of the received command (possibly done by the receive interrupt) */
+	Local_uint8CRCStatus = uint8_VerifyFrameCRC(copy_puint8CmdPacket);
+
+	if(Local_uint8CRCStatus == CRC_SUCCESS)
+	{
+		uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+		uint16_t Local_uint16Seq   = uint16_GetField(&Local_puint8Payload[0]);
+		uint8_t  Local_uint8Flags  = Local_puint8Payload[2];
+
+		/* A new stream restarts the sequence numbering */
+		if(Local_uint8Flags & BL_STREAM_FLAG_START)
+		{
+			Global_uint16StreamNextSeq = Local_uint16Seq;
+			Global_uint8StreamUnacked  = 0;
+			Global_uint8StreamNackSent = 0;
+
+			/* Auto-erase: forget earlier erases, the previous image may still be there */
+			Global_uint8StreamAutoErase = ((Local_uint8Flags & BL_STREAM_FLAG_AUTO_ERASE) != 0) ? 1u : 0u;
+			Global_uint8StreamDiff      = ((Local_uint8Flags & BL_STREAM_FLAG_DIFFERENTIAL) != 0) ? 1u : 0u;
+			Global_uint8StreamSelective = ((Local_uint8Flags & BL_STREAM_FLAG_SELECTIVE) != 0) ? 1u : 0u;
+			Global_uint32StreamReceived = 0;
+			if((Global_uint8StreamAutoErase != 0) && (Global_uint8SessionResumed == 0))
+			{
+				Global_uint16ErasedSectors = 0;
+			}
+		}
+
+		/* Distance ahead of the next expected packet, wraps for old duplicates */
+		uint16_t Local_uint16Offset = (uint16_t)(Local_uint16Seq - Global_uint16StreamNextSeq);
+
+		if((Local_uint16Offset == 0u) ||
+		   ((Global_uint8StreamSelective != 0) && (Local_uint16Offset < BL_STREAM_SELECTIVE_WINDOW) &&
+		    ((Global_uint32StreamReceived & (1UL << Local_uint16Offset)) == 0u)))
+		{
+			uint8_t  Local_uint8WritingStatus = HAL_ERROR;
+			uint32_t Local_uint32Address;
+			uint16_t Local_uint16PayloadLength;
+			uint8_t* Local_puint8Data;
+			const BL_MemoryRegion_t* Local_pRegion;
+
+			/* Payload length is 16-bit in extended frames, aligned frames use BL_AlignedStream_t */
+			if(copy_puint8CmdPacket[0] == BL_FRAME_EXT_MARKER)
+			{
+				Local_uint32Address = uint32_GetField(&Local_puint8Payload[3]);
+				Local_uint16PayloadLength = uint16_GetField(&Local_puint8Payload[7]);
+				Local_puint8Data = &Local_puint8Payload[9];
+			}
+			else if(copy_puint8CmdPacket[0] == BL_FRAME_ALIGNED_MARKER)
+			{
+				BL_AlignedStream_t* Local_pAligned = (BL_AlignedStream_t*)Local_puint8Payload;
+
+				Local_uint32Address = Local_pAligned->Address;
+				Local_uint16PayloadLength = Local_pAligned->Length;
+				Local_puint8Data = Local_pAligned->Data;
+			}
+			else
+			{
+				Local_uint32Address = uint32_GetField(&Local_puint8Payload[3]);
+				Local_uint16PayloadLength = Local_puint8Payload[7];
+				Local_puint8Data = &Local_puint8Payload[8];
+			}
+
+			Local_pRegion = pMemory_LookupRegion(Local_uint32Address, (Local_uint16PayloadLength != 0u) ? Local_uint16PayloadLength : 1u, BL_MEMORY_WRITE);
+
+			if((Local_pRegion != NULL) &&
+			   ((Local_puint8Data + Local_uint16PayloadLength) <= (Local_puint8Payload + uint16_GetFramePayloadLength(copy_puint8CmdPacket))))
+			{
+				Local_uint8WritingStatus = HAL_OK;
+#if BL_DECRYPT_ENABLE
+				voidDecryptPayload(Local_puint8Data, Local_uint32Address, Local_uint16PayloadLength);
+#endif
+
+				if((Global_uint8StreamDiff != 0) && (Local_pRegion->Method == BL_MEMORY_METHOD_FLASH))
+				{
+					/* Write-if-different, no implicit erase */
+					Local_uint8WritingStatus = uint8_ExecuteDifferentialWrite(Local_puint8Data, Local_uint32Address, Local_uint16PayloadLength);
+				}
+				else
+				{
+					/* Erase the sectors this packet lands in, on first use */
+					if((Global_uint8StreamAutoErase != 0) && (Local_pRegion->Method == BL_MEMORY_METHOD_FLASH))
+					{
+						Local_uint8WritingStatus = uint8_AutoErase(Local_uint32Address, Local_uint16PayloadLength);
+					}
+
+					if(Local_uint8WritingStatus == HAL_OK)
+					{
+						Local_uint8WritingStatus = uint8_ExecuteMemoryWrite(Local_puint8Data, Local_uint32Address, Local_uint16PayloadLength);
+					}
+				}
+			}
+
+			if((Local_uint8WritingStatus == HAL_OK) && (Global_uint8StreamSelective != 0))
+			{
+				/* Remember where it went, the image hash is updated in sequence order */
+				Global_uint32StreamSlotAddress[Local_uint16Seq % BL_STREAM_SELECTIVE_WINDOW] = Local_uint32Address;
+				Global_uint16StreamSlotLength[Local_uint16Seq % BL_STREAM_SELECTIVE_WINDOW]  = Local_uint16PayloadLength;
+				Global_uint32StreamReceived |= (1UL << Local_uint16Offset);
+				Global_uint8StreamUnacked++;
+
+				/* A gap is reported once, and again each time a retransmission fills one */
+				if(uint8_AdvanceStreamWindow() != 0)
+				{
+					Global_uint8StreamNackSent = 0;
+				}
+
+				if((Global_uint32StreamReceived != 0u) && ((Global_uint8StreamNackSent == 0) || (Local_uint8Flags & BL_STREAM_FLAG_LAST)))
+				{
+					Global_uint8StreamUnacked  = 0;
+					Global_uint8StreamNackSent = 1;
+					voidSendStreamStatus(BL_STREAM_MISSING, Global_uint16StreamNextSeq, 0u);
+				}
+				else if((Global_uint32StreamReceived == 0u) &&
+				        ((Global_uint8StreamUnacked >= STREAM_ACK_INTERVAL) || (Local_uint8Flags & BL_STREAM_FLAG_LAST)))
+				{
+					Global_uint8StreamUnacked = 0;
+					voidSendStreamStatus(BL_STREAM_ACK, Global_uint16StreamNextSeq, 0u);
+				}
+			}
+			else if(Local_uint8WritingStatus == HAL_OK)
+			{
+				voidTrackImageWrite(Local_puint8Data, Local_uint32Address, Local_uint16PayloadLength);
+
+				Global_uint16StreamNextSeq++;
+				Global_uint8StreamUnacked++;
+				Global_uint8StreamNackSent = 0;
+
+				/* Cumulative ACK for everything written so far */
+				if((Global_uint8StreamUnacked >= STREAM_ACK_INTERVAL) || (Local_uint8Flags & BL_STREAM_FLAG_LAST))
+				{
+					Global_uint8StreamUnacked = 0;
+					voidSendStreamStatus(BL_STREAM_ACK, Global_uint16StreamNextSeq, 0u);
+				}
+			}
+			else
+			{
+				/* Stop the stream at the failing packet, the host decides what to do */
+				Global_uint8StreamUnacked  = 0;
+				Global_uint8StreamNackSent = 1;
+				voidSendStreamStatus((Local_uint8WritingStatus == DIFF_ERASE_REQUIRED) ? BL_STREAM_ERASE_REQUIRED : BL_STREAM_WRITE_ERROR,
+				                     Global_uint16StreamNextSeq, (uint8_t)Local_uint16Offset);
+			}
+		}
+		else if(Global_uint8StreamSelective != 0)
+		{
+			/* Duplicate, or beyond the window: dropped, the bitmap already tells the host */
+		}
+		else if(Global_uint8StreamNackSent == 0)
+		{
+			/* A packet before this one was lost: ask once for a resend, drop the rest of the window */
+			Global_uint8StreamUnacked  = 0;
+			Global_uint8StreamNackSent = 1;
+			voidSendStreamStatus(BL_STREAM_RETRANSMIT, Global_uint16StreamNextSeq, 0u);
+		}
+		else
+		{
+			/* Out-of-order packet while a retransmission is pending: dropped */
+		}
+	}
+	else if(Global_uint8StreamNackSent == 0)
+	{
+		/* Corrupted packet: ask for a resend starting at the first packet not yet written */
+		Global_uint8StreamUnacked  = 0;
+		Global_uint8StreamNackSent = 1;
+		voidSendStreamStatus((Global_uint8StreamSelective != 0) ? BL_STREAM_MISSING : BL_STREAM_RETRANSMIT, Global_uint16StreamNextSeq, 0u);
+	}
+	else
+	{
+		/* Corrupted packet while a retransmission is pending: dropped */
+	}
+}
+
+
+/*
+ * BL_voidHandleChangeBaudCmd
+ * --------------------------
+ * Negotiates a new USART2 baud rate with the host.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               The expected packet structure:
+ *                               - Byte [0]     : Command length (excluding itself).
+ *                               - Byte [1]     : Command identifier.
+ *                               - Byte [2..5]  : Proposed baud rate (little endian).
+ *                               - Last 4 bytes : CRC checksum for validation.
+ *
+ * Behavior:
+ * ---------
+ * 1. Checks the rate with uint8_ValidateBaudRate().
+ * 2. Replies with BL_BAUD_OK / BL_BAUD_UNSUPPORTED at the current rate.
+ * 3. On BL_BAUD_OK, reprograms USART2 once the reply has left the line.
+ * 4. Waits BL_BAUD_PING_TIMEOUT_MS for BL_BAUD_PING at the new rate and
+ *    answers it with BL_ACK.
+ * 5. If no valid ping arrives, falls back to BL_DEFAULT_BAUD_RATE.
+ */
+void BL_voidHandleChangeBaudCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint32_t Local_uint32BaudRate = uint32_GetField(puint8_GetFramePayload(copy_puint8CmdPacket));
+	uint8_t  Local_uint8BaudStatus = BL_BAUD_UNSUPPORTED;
+	uint8_t  Local_uint8Ping = 0;
+
+	if(uint8_ValidateBaudRate(Local_uint32BaudRate) == VALID_BAUD_RATE)
+	{
+		Local_uint8BaudStatus = BL_BAUD_OK;
+	}
+
+	/* Confirm at the old rate, the transport flushes it before switching */
+	voidSendResponse(&Local_uint8BaudStatus, 1u);
+
+	if(Local_uint8BaudStatus == BL_BAUD_OK)
+	{
+		if((BL_uint8TransportSetBaudRate(Local_uint32BaudRate) == HAL_OK) &&
+		   (BL_uint8TransportReadByte(&Local_uint8Ping, BL_BAUD_PING_TIMEOUT_MS) == HAL_OK) &&
+		   (Local_uint8Ping == BL_BAUD_PING))
+		{
+			uint8_t* Local_puint8Tx = BL_puint8TransportTxAcquire();
+			Local_puint8Tx[0] = BL_ACK;
+			BL_voidTransportTxStart(1u);
+		}
+		else
+		{
+			/* Host did not follow: return to the rate every host starts with */
+			BL_uint8TransportSetBaudRate(BL_DEFAULT_BAUD_RATE);
+		}
+	}
+}
+
+
+/*
+ * BL_voidHandleMemCompareCmd
+ * --------------------------
+ * Per-block compare used by differential updates: the host sends the CRC of
+ * its copy of a block and only transfers the block when it differs.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               The expected packet structure:
+ *                               - Byte [0]     : Command length (excluding itself).
+ *                               - Byte [1]     : Command identifier.
+ *                               - Byte [2..5]  : Block address (little endian).
+ *                               - Byte [6..7]  : Block length (little endian).
+ *                               - Byte [8..11] : CRC of the host's block (same CRC as the frames).
+ *                               - Last 4 bytes : CRC checksum for validation.
+ *
+ * Behavior:
+ * ---------
+ * 1. Checks that the block lies in a readable, DMA-reachable region.
+ * 2. Computes the CRC of the memory content with the CRC unit and replies
+ *    BL_COMPARE_MATCH, BL_COMPARE_DIFFER or BL_COMPARE_INVALID.
+ */
+void BL_voidHandleMemCompareCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t* Local_puint8Payload   = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint32_t Local_uint32Address   = uint32_GetField(&Local_puint8Payload[0]);
+	uint16_t Local_uint16Length    = uint16_GetField(&Local_puint8Payload[4]);
+	uint32_t Local_uint32BlockCRC  = uint32_GetField(&Local_puint8Payload[6]);
+	uint8_t  Local_uint8CompareStatus = BL_COMPARE_INVALID;
+
+	voidFinishEraseJob();
+	uint8_FlushWriteBuffer();
+
+	if(pMemory_LookupRegion(Local_uint32Address, Local_uint16Length, (BL_MEMORY_READ | BL_MEMORY_DMA)) != NULL)
+	{
+		if(uint32_CalculateCRC((uint8_t*)Local_uint32Address, Local_uint16Length) == Local_uint32BlockCRC)
+		{
+			Local_uint8CompareStatus = BL_COMPARE_MATCH;
+		}
+		else
+		{
+			Local_uint8CompareStatus = BL_COMPARE_DIFFER;
+		}
+	}
+
+	voidSendResponse(&Local_uint8CompareStatus, 1u);
+}
+
+
+/*
+ * BL_voidHandleFlashEraseStatusCmd
+ * --------------------------------
+ * Reports the progress of the background erase started by BL_FLASH_ERASE with
+ * BL_ERASE_FLAG_ASYNC. Answered between two sector erases, so the host can show
+ * real progress instead of waiting on a fixed timeout.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               The expected packet structure:
+ *                               - Byte [0]     : Command length (excluding itself).
+ *                               - Byte [1]     : Command identifier.
+ *                               - Last 4 bytes : CRC checksum for validation.
+ *
+ * Behavior:
+ * ---------
+ * Replies [state] [sectors done] [sectors total] [blank-skipped bitmap (2, LE)].
+ */
+void BL_voidHandleFlashEraseStatusCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t Local_uint8StatusReply[5];
+
+	/* Pick up a sector that has just finished */
+	voidStepEraseJob();
+
+	Local_uint8StatusReply[0] = Global_uint8EraseState;
+	Local_uint8StatusReply[1] = Global_uint8EraseDone;
+	Local_uint8StatusReply[2] = Global_uint8EraseTotal;
+	Local_uint8StatusReply[3] = (uint8_t)(Global_uint16EraseBlank & 0xFFu);
+	Local_uint8StatusReply[4] = (uint8_t)(Global_uint16EraseBlank >> 8);
+
+	voidSendResponse(Local_uint8StatusReply, 5u);
+}
+
+
+/*
+ * BL_voidHandleMemWritePostedCmd
+ * ------------------------------
+ * Pipelined variant of BL_MEM_WRITE: the reply is sent as soon as the packet
+ * is validated, before it is programmed. The host sends packet N+1 on that
+ * reply, so its transfer (DMA into the RX ring, the second buffer slot)
+ * overlaps the programming of packet N held in the command buffer, and the
+ * throughput approaches min(UART rate, flash rate) instead of their sum.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet,
+ *                               same structure as BL_MEM_WRITE:
+ *                               - Byte [2..5]  : Target address.
+ *                               - Byte [6]     : Payload length (16-bit in extended frames).
+ *                               - Byte [7..]   : Payload.
+ *                               - Last 4 bytes : CRC checksum for validation.
+ *
+ * Behavior:
+ * ---------
+ * 1. Verifies the address and that the data lies inside the frame.
+ * 2. Replies [accepted] [status of the previous posted packet]:
+ *      accepted : HAL_OK if this packet will be written, HAL_ERROR if rejected.
+ *      previous : HAL_OK / HAL_ERROR from programming the packet before.
+ * 3. Programs the packet; its status goes out with the next reply.
+ *    A packet with a zero payload length writes nothing and only collects
+ *    the status of the last one (end of transfer).
+ *
+ * NOTE: with BL_UART_FLOW_CONTROL_ENABLE, RTS pauses the host while flash is
+ *       programmed, which limits the overlap to the bytes already in flight.
+ */
+void BL_voidHandleMemWritePostedCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint32_t Local_uint32Address = uint32_GetField(&Local_puint8Payload[0]);
+	uint16_t Local_uint16PayloadLength;
+	uint8_t* Local_puint8Data;
+	uint8_t  Local_uint8Reply[2];
+
+	if(copy_puint8CmdPacket[0] == BL_FRAME_EXT_MARKER)
+	{
+		Local_uint16PayloadLength = uint16_GetField(&Local_puint8Payload[4]);
+		Local_puint8Data = &Local_puint8Payload[6];
+	}
+	else if(copy_puint8CmdPacket[0] == BL_FRAME_ALIGNED_MARKER)
+	{
+		BL_AlignedWrite_t* Local_pAligned = (BL_AlignedWrite_t*)Local_puint8Payload;
+
+		Local_uint16PayloadLength = Local_pAligned->Length;
+		Local_puint8Data = Local_pAligned->Data;
+	}
+	else
+	{
+		Local_uint16PayloadLength = Local_puint8Payload[4];
+		Local_puint8Data = &Local_puint8Payload[5];
+	}
+
+	Local_uint8Reply[0] = HAL_ERROR;
+	Local_uint8Reply[1] = Global_uint8PostedWriteStatus;
+
+	if((pMemory_LookupRegion(Local_uint32Address, (Local_uint16PayloadLength != 0u) ? Local_uint16PayloadLength : 1u, BL_MEMORY_WRITE) != NULL) &&
+	   ((Local_puint8Data + Local_uint16PayloadLength) <= (Local_puint8Payload + uint16_GetFramePayloadLength(copy_puint8CmdPacket))))
+	{
+		Local_uint8Reply[0] = HAL_OK;
+	}
+
+	/* Reply first: the host starts sending the next packet meanwhile */
+	voidSendResponse(Local_uint8Reply, 2u);
+
+	if(Local_uint8Reply[0] == HAL_OK)
+	{
+		Global_uint8PostedWriteStatus = HAL_OK;
+
+		if(Local_uint16PayloadLength != 0u)
+		{
+#if BL_DECRYPT_ENABLE
+			voidDecryptPayload(Local_puint8Data, Local_uint32Address, Local_uint16PayloadLength);
+#endif
+			Global_uint8PostedWriteStatus = uint8_ExecuteMemoryWrite(Local_puint8Data, Local_uint32Address, Local_uint16PayloadLength);
+
+			if(Global_uint8PostedWriteStatus == HAL_OK)
+			{
+				voidTrackImageWrite(Local_puint8Data, Local_uint32Address, Local_uint16PayloadLength);
+			}
+		}
+	}
+}
+
+
+/*
+ * BL_voidHandleBeginProgramCmd
+ * ----------------------------
+ * Opens a programming session for a whole update.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               The expected packet structure:
+ *                               - Byte [0]     : Command length (excluding itself).
+ *                               - Byte [1]     : Command identifier.
+ *                               - Last 4 bytes : CRC checksum for validation.
+ *
+ * Behavior:
+ * ---------
+ * 1. Waits for a background erase, unlocks the flash once and clears error
+ *    flags left by earlier operations.
+ * 2. Forgets the erased-sector bitmap: a new update starts from unknown content,
+ *    and restarts the running image CRC / SHA-256 checked by BL_COMMIT.
+ * 3. Discards the backup SRAM session record. With the optional
+ *    [target address (4)] [target length (4)] payload the session is resumable
+ *    and a first record (nothing written) is saved. A further
+ *    [initial counter block (16)] makes it a decrypting session ("Encrypted
+ *    Session" in BL.h), refused with HAL_ERROR without BL_DECRYPT_ENABLE.
+ * 4. Replies HAL_OK. Until BL_END_PROGRAM (or the session timeout / a jump),
+ *    writes and erases skip the per-packet unlock / lock.
+ */
+void BL_voidHandleBeginProgramCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint16_t Local_uint16PayloadLength = uint16_GetFramePayloadLength(copy_puint8CmdPacket);
+	uint8_t  Local_uint8Status = HAL_OK;
+
+	voidFinishEraseJob();
+
+	/* The supply may have changed since start-up (battery, other rail) */
+	(void)BL_uint8FlashSelectParallelism();
+
+#if !BL_DECRYPT_ENABLE
+	/* Ciphertext must not reach the flash as it is */
+	if(Local_uint16PayloadLength >= (8u + BL_SESSION_COUNTER_SIZE))
+	{
+		Local_uint8Status = HAL_ERROR;
+	}
+#endif
+
+	if((Local_uint8Status == HAL_OK) && (Global_uint8SessionOpen == 0))
+	{
+		Local_uint8Status = HAL_FLASH_Unlock();
+	}
+
+	if(Local_uint8Status == HAL_OK)
+	{
+		__HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR |
+		                       FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR);
+
+		Global_uint16ErasedSectors = 0;
+		Global_uint8CombineStatus  = HAL_OK;
+		Global_uint32VerifyFailAddress = BL_FLASH_VERIFY_OK;
+		BL_voidCRCStreamStart(&Global_ImageCrc);
+		BL_voidSHA256Start(&Global_ImageSha);
+		Global_uint32SessionIdleMs = 0;
+		Global_uint8SessionExpired = 0;
+		Global_uint8SessionOpen    = 1;
+
+		voidClearSessionRecord();
+		Global_uint8SessionResumed   = 0;
+		Global_uint8SessionResumable = 0;
+		Global_uint8SessionDecrypt   = 0;
+		if(Local_uint16PayloadLength >= 8u)
+		{
+			memcpy(&Global_uint32SessionBase, &Local_puint8Payload[0], 4u);
+			memcpy(&Global_uint32SessionSize, &Local_puint8Payload[4], 4u);
+			Global_uint32SessionWritten  = 0;
+			Global_uint8SessionResumable = 1;
+#if BL_DECRYPT_ENABLE
+			if(Local_uint16PayloadLength >= (8u + BL_SESSION_COUNTER_SIZE))
+			{
+				memcpy(Global_uint8SessionCounter, &Local_puint8Payload[8], BL_SESSION_COUNTER_SIZE);
+				BL_voidAESSetKey(&Global_ImageAes, Global_uint8ImageKey, (uint8_t)sizeof(Global_uint8ImageKey));
+				Global_uint8SessionDecrypt = 1;
+			}
+#endif
+			voidSaveSessionRecord();
+#if BL_JOURNAL_ENABLE
+			BL_uint8JournalOpen(Global_uint32SessionBase, Global_uint32SessionSize);
+			Global_uint32JournalWritten = 0;
+#endif
+		}
+	}
+
+	voidSendResponse(&Local_uint8Status, 1u);
+}
+
+
+/*
+ * BL_voidHandleEndProgramCmd
+ * --------------------------
+ * Closes the programming session: waits for a background erase, programs the
+ * bytes still staged by write-combining, relocks the flash and replies HAL_OK,
+ * or HAL_ERROR if a staged write failed. Harmless when no session is open.
+ * Discards the backup SRAM session record (a timeout or a jump keeps it).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               The expected packet structure:
+ *                               - Byte [0]     : Command length (excluding itself).
+ *                               - Byte [1]     : Command identifier.
+ *                               - Last 4 bytes : CRC checksum for validation.
+ */
+void BL_voidHandleEndProgramCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t Local_uint8Status;
+
+	voidCloseSession();
+
+	/* Finished on purpose: nothing left to resume */
+	Global_uint8SessionResumable = 0;
+	voidClearSessionRecord();
+
+#if BL_JOURNAL_ENABLE
+	if(BL_uint8JournalIsOpen() != 0u)
+	{
+		HAL_FLASH_Unlock();
+		BL_uint8JournalAppend(BL_JOURNAL_CLOSED, NULL, 0u);
+		HAL_FLASH_Lock();
+	}
+#endif
+
+	Local_uint8Status         = Global_uint8CombineStatus;
+	Global_uint8CombineStatus = HAL_OK;
+
+	voidSendWriteStatus(Local_uint8Status);
+}
+
+
+/*
+ * BL_voidHandleEraseRangeCmd
+ * --------------------------
+ * Erases exactly the sectors covered by an image, so the host can plan the
+ * erase from the image addresses without knowing the sector layout.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               The expected packet structure:
+ *                               - Byte [0]     : Command length (excluding itself).
+ *                               - Byte [1]     : Command identifier.
+ *                               - Byte [2:5]   : Start address (little endian).
+ *                               - Byte [6:9]   : Length in bytes (little endian).
+ *                               - Byte [10]    : Flags (optional, BL_ERASE_FLAG_ASYNC / BL_ERASE_FLAG_PLAN).
+ *                               - Last 4 bytes : CRC checksum for validation.
+ *
+ * Behavior:
+ * ---------
+ * 1. Looks up the first and last sector in the sector table (BL_Flash).
+ * 2. An empty range, or one leaving the flash, is rejected with HAL_ERROR.
+ * 3. Otherwise erases the sectors like BL_FLASH_ERASE (blank sectors skipped,
+ *    background erase with BL_ERASE_FLAG_ASYNC) and sends the same reply:
+ *    [status] [blank-skipped sectors (16-bit bitmap, little endian)]
+ */
+void BL_voidHandleEraseRangeCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t  Local_uint8EraseStatus = HAL_ERROR;
+	uint16_t Local_uint16BlankSectors = 0;
+	uint8_t  Local_uint8FirstSector;
+	uint8_t  Local_uint8LastSector;
+
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint16_t Local_uint16PayloadLength = uint16_GetFramePayloadLength(copy_puint8CmdPacket);
+
+	uint32_t Local_uint32Address = uint32_GetField(&Local_puint8Payload[0]);
+	uint32_t Local_uint32Length  = uint32_GetField(&Local_puint8Payload[4]);
+
+	if((Local_uint16PayloadLength >= 8u) && (Local_uint32Length != 0u) &&
+	   (Local_uint32Length <= (FLASH_END - Local_uint32Address + 1u)))
+	{
+		Local_uint8FirstSector = BL_uint8FlashGetSector(Local_uint32Address);
+		Local_uint8LastSector  = BL_uint8FlashGetSector(Local_uint32Address + Local_uint32Length - 1u);
+
+		if((Local_uint8FirstSector != BL_FLASH_INVALID_SECTOR) && (Local_uint8LastSector != BL_FLASH_INVALID_SECTOR))
+		{
+			if((Local_uint16PayloadLength >= 9u) && (Local_puint8Payload[8] & BL_ERASE_FLAG_PLAN))
+			{
+				voidRunPlannedErase(Local_uint8FirstSector, (uint8_t)(Local_uint8LastSector - Local_uint8FirstSector + 1u));
+				return;
+			}
+
+			/* Turn on LED (LD5) to indicate flash erase is in progress */
+			HAL_GPIO_WritePin(LD5_GPIO_Port, LD5_Pin, GPIO_PIN_SET);
+
+			if((Local_uint16PayloadLength >= 9u) && (Local_puint8Payload[8] & BL_ERASE_FLAG_ASYNC))
+			{
+				voidStartEraseJob(Local_uint8FirstSector, (uint8_t)(Local_uint8LastSector - Local_uint8FirstSector + 1u));
+				Local_uint8EraseStatus = HAL_OK;
+			}
+			else
+			{
+				Local_uint8EraseStatus = uint8_tExecute_FlashErase(Local_uint8FirstSector,
+				                                                   (uint8_t)(Local_uint8LastSector - Local_uint8FirstSector + 1u),
+				                                                   &Local_uint16BlankSectors);
+			}
+
+			/* Turn off LED (LD5) after erase completion */
+			HAL_GPIO_WritePin(LD5_GPIO_Port, LD5_Pin, GPIO_PIN_RESET);
+		}
+	}
+
+	voidSendEraseReply(Local_uint8EraseStatus, Local_uint16BlankSectors);
+}
+
+
+/*
+ * BL_voidHandleVerifyRangeCmd
+ * ---------------------------
+ * Post-flash verification in one round trip: the device computes the digest
+ * of a memory range and returns only the digest.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               The expected packet structure:
+ *                               - Byte [0]     : Command length (excluding itself).
+ *                               - Byte [1]     : Command identifier.
+ *                               - Byte [2:5]   : Start address (little endian).
+ *                               - Byte [6:9]   : Length in bytes (little endian).
+ *                               - Byte [10]    : Algorithm (optional, BL_VERIFY_ALGO_CRC32 / _SHA256 /
+ *                                                _CRC32_IEEE, may be or-ed with BL_VERIFY_FLAG_CYCLES).
+ *                               - Last 4 bytes : CRC checksum for validation.
+ *
+ * Behavior:
+ * ---------
+ * 1. Waits for a background erase and programs staged writes, so the digest
+ *    covers the final content.
+ * 2. Validates the range (flash or SRAM, not crossing between them).
+ * 3. Replies [HAL_OK] [digest]: CRC-32 (4, LE) from the DMA-fed CRC engine,
+ *    standard CRC-32 (4, LE) from the bit-reversed unit or SHA-256 (32), followed by the DWT cycle count of the computation (4, LE)
+ *    with BL_VERIFY_FLAG_CYCLES (on-target benchmark of both engines).
+ *    [HAL_ERROR] alone for an invalid range or an unknown algorithm.
+ */
+void BL_voidHandleVerifyRangeCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t  Local_uint8Reply[1u + BL_SHA256_DIGEST_SIZE + 4u];
+	uint16_t Local_uint16ReplyLength = 1u;
+	uint8_t  Local_uint8Algorithm = BL_VERIFY_ALGO_CRC32;
+	uint32_t Local_uint32Digest;
+	uint32_t Local_uint32Cycles;
+
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint16_t Local_uint16PayloadLength = uint16_GetFramePayloadLength(copy_puint8CmdPacket);
+
+	uint32_t Local_uint32Address = uint32_GetField(&Local_puint8Payload[0]);
+	uint32_t Local_uint32Length  = uint32_GetField(&Local_puint8Payload[4]);
+
+	if(Local_uint16PayloadLength >= 9u)
+	{
+		Local_uint8Algorithm = Local_puint8Payload[8];
+	}
+
+	voidFinishEraseJob();
+	uint8_FlushWriteBuffer();
+
+	Local_uint8Reply[0] = HAL_ERROR;
+
+	if((Local_uint16PayloadLength >= 8u) &&
+	   (pMemory_LookupRegion(Local_uint32Address, Local_uint32Length, (BL_MEMORY_READ | BL_MEMORY_DMA)) != NULL))
+	{
+		/* Cycle counter for BL_VERIFY_FLAG_CYCLES */
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+		DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+		Local_uint32Cycles = DWT->CYCCNT;
+
+		switch(Local_uint8Algorithm & (uint8_t)~BL_VERIFY_FLAG_CYCLES)
+		{
+		case BL_VERIFY_ALGO_CRC32:
+			Local_uint32Digest = BL_uint32CRCCalculate((const uint8_t*)Local_uint32Address, Local_uint32Length);
+			memcpy(&Local_uint8Reply[1], &Local_uint32Digest, 4u);
+			Local_uint16ReplyLength = 5u;
+			break;
+
+		case BL_VERIFY_ALGO_CRC32_IEEE:
+			Local_uint32Digest = BL_uint32CRCCalculateIEEE((const uint8_t*)Local_uint32Address, Local_uint32Length);
+			memcpy(&Local_uint8Reply[1], &Local_uint32Digest, 4u);
+			Local_uint16ReplyLength = 5u;
+			break;
+
+#if BL_SHA256_ENABLE
+		case BL_VERIFY_ALGO_SHA256:
+			BL_voidSHA256Calculate((const uint8_t*)Local_uint32Address, Local_uint32Length, &Local_uint8Reply[1]);
+			Local_uint16ReplyLength = 1u + BL_SHA256_DIGEST_SIZE;
+			break;
+#endif
+
+		default:
+			break;
+		}
+
+		Local_uint32Cycles = DWT->CYCCNT - Local_uint32Cycles;
+
+		if(Local_uint16ReplyLength != 1u)
+		{
+			Local_uint8Reply[0] = HAL_OK;
+
+			if((Local_uint8Algorithm & BL_VERIFY_FLAG_CYCLES) != 0u)
+			{
+				memcpy(&Local_uint8Reply[Local_uint16ReplyLength], &Local_uint32Cycles, 4u);
+				Local_uint16ReplyLength += 4u;
+			}
+		}
+	}
+
+	voidSendResponse(Local_uint8Reply, Local_uint16ReplyLength);
+}
+
+
+/*
+ * BL_voidHandleCommitCmd
+ * ----------------------
+ * End-to-end check of an update without a separate verification pass: the
+ * running CRC of every byte written in the session is compared with the CRC
+ * of the image on the host.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               The expected packet structure:
+ *                               - Byte [0]     : Command length (excluding itself).
+ *                               - Byte [1]     : Command identifier.
+ *                               - Byte [2:5]   : Expected CRC (word-wise CRC of BL_CRC.h, little endian).
+ *                               - Byte [6:9]   : Expected total length in bytes (little endian).
+ *                               - Byte [10:41] : Expected SHA-256 of the image (optional).
+ *                               - Byte [42:105]: ECDSA-P256 signature r || s of that SHA-256
+ *                                                (required with BL_SIGNATURE_ENABLE).
+ *                               - Last 4 bytes : CRC checksum for validation.
+ *
+ * Behavior:
+ * ---------
+ * 1. Waits for a background erase and programs staged writes, so a write
+ *    error still pending is reported here too.
+ * 2. Replies [status] [session CRC (4, LE)] [session length (4, LE)]:
+ *    HAL_OK when CRC, length (and SHA-256 if given) match and every write succeeded, HAL_ERROR
+ *    otherwise (the image must not be marked bootable). The session stays
+ *    open; without one the CRC is that of the last session.
+ * 3. With BL_SIGNATURE_ENABLE the signature is verified over the SHA-256
+ *    computed on the device during the transfer (no second pass over the
+ *    image) and, when valid, the image header is marked validated so the
+ *    boot check does not hash the image again. Without a valid signature
+ *    the status is HAL_ERROR.
+ */
+void BL_voidHandleCommitCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t  Local_uint8Reply[9];
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint32_t Local_uint32ExpectedCRC    = uint32_GetField(&Local_puint8Payload[0]);
+	uint32_t Local_uint32ExpectedLength = uint32_GetField(&Local_puint8Payload[4]);
+	uint16_t Local_uint16PayloadLength = uint16_GetFramePayloadLength(copy_puint8CmdPacket);
+	uint32_t Local_uint32ImageCRC;
+#if BL_SHA256_ENABLE
+	uint8_t  Local_uint8ImageSha[BL_SHA256_DIGEST_SIZE];
+#endif
+
+	voidFinishEraseJob();
+	uint8_FlushWriteBuffer();
+
+	Local_uint32ImageCRC = BL_uint32CRCStreamFinish(&Global_ImageCrc);
+
+	Local_uint8Reply[0] = HAL_ERROR;
+	if((Local_uint32ImageCRC == Local_uint32ExpectedCRC) &&
+	   (Global_ImageCrc.Length == Local_uint32ExpectedLength) &&
+	   (Global_uint8CombineStatus == HAL_OK))
+	{
+		Local_uint8Reply[0] = HAL_OK;
+
+		if(Local_uint16PayloadLength >= (8u + BL_SHA256_DIGEST_SIZE))
+		{
+#if BL_SHA256_ENABLE
+			BL_voidSHA256Finish(&Global_ImageSha, Local_uint8ImageSha);
+
+			if(memcmp(Local_uint8ImageSha, &Local_puint8Payload[8], BL_SHA256_DIGEST_SIZE) != 0)
+			{
+				Local_uint8Reply[0] = HAL_ERROR;
+			}
+#else
+			/* No hash kept: a digest cannot be checked, so it is not accepted */
+			Local_uint8Reply[0] = HAL_ERROR;
+#endif
+		}
+
+#if BL_SIGNATURE_ENABLE
+		if((Local_uint8Reply[0] == HAL_OK) &&
+		   ((Local_uint16PayloadLength < (8u + BL_SHA256_DIGEST_SIZE + BL_P256_SIGNATURE_SIZE)) ||
+		    (BL_uint8P256Verify(Global_uint8SigningKey, Local_uint8ImageSha,
+		                        &Local_puint8Payload[8u + BL_SHA256_DIGEST_SIZE]) != BL_P256_SIGNATURE_VALID) ||
+		    (BL_uint8ImageMarkValidated() != HAL_OK)))
+		{
+			Local_uint8Reply[0] = HAL_ERROR;
+		}
+#endif
+	}
+
+	memcpy(&Local_uint8Reply[1], &Local_uint32ImageCRC, 4u);
+	memcpy(&Local_uint8Reply[5], &Global_ImageCrc.Length, 4u);
+
+	voidSendResponse(Local_uint8Reply, 9u);
+}
+
+
+/*
+ * BL_voidHandleBlockCrcManifestCmd
+ * --------------------------------
+ * rsync-style incremental updates: returns the CRC of every fixed-size block
+ * of a range in one reply, so the host only erases and sends the blocks that
+ * changed.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               The expected packet structure:
+ *                               - Byte [0]     : Command length (excluding itself).
+ *                               - Byte [1]     : Command identifier.
+ *                               - Byte [2:5]   : Start address (little endian).
+ *                               - Byte [6:9]   : Length in bytes (little endian).
+ *                               - Byte [10:11] : Block size in bytes (little endian).
+ *                               - Byte [12]    : Flags (optional, BL_MANIFEST_FLAG_IEEE).
+ *                               - Last 4 bytes : CRC checksum for validation.
+ *
+ * Behavior:
+ * ---------
+ * 1. Waits for a background erase and programs staged writes.
+ * 2. Validates the range and the block size (not 0).
+ * 3. Replies [HAL_OK] [block count (2, LE)] [CRC (4, LE) x block count], the
+ *    word-wise CRC of BL_CRC.h per block, or the standard CRC-32 with
+ *    BL_MANIFEST_FLAG_IEEE (the last block may be shorter). The
+ *    table is built straight in the TX buffer. Word-wise CRCs of aligned
+ *    4 KB blocks in the slots come from the slot cache (BL_SlotCache.h). At most BL_MANIFEST_MAX_BLOCKS
+ *    blocks are returned: the host asks again from the first missing block.
+ *    [HAL_ERROR] alone for an invalid request.
+ */
+void BL_voidHandleBlockCrcManifestCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint16_t Local_uint16PayloadLength = uint16_GetFramePayloadLength(copy_puint8CmdPacket);
+
+	uint32_t Local_uint32Address   = uint32_GetField(&Local_puint8Payload[0]);
+	uint32_t Local_uint32Length    = uint32_GetField(&Local_puint8Payload[4]);
+	uint16_t Local_uint16BlockSize = uint16_GetField(&Local_puint8Payload[8]);
+	uint8_t  Local_uint8Flags = 0;
+	uint32_t Local_uint32Blocks;
+	uint32_t Local_uint32Block;
+	uint32_t Local_uint32BlockLength;
+	uint32_t Local_uint32BlockCRC;
+	uint8_t* Local_puint8Tx;
+	uint16_t Local_uint16TxLength;
+
+	if(Local_uint16PayloadLength >= 11u)
+	{
+		Local_uint8Flags = Local_puint8Payload[10];
+	}
+
+	voidFinishEraseJob();
+	uint8_FlushWriteBuffer();
+
+	if((Local_uint16PayloadLength >= 10u) && (Local_uint16BlockSize != 0u) &&
+	   (pMemory_LookupRegion(Local_uint32Address, Local_uint32Length, (BL_MEMORY_READ | BL_MEMORY_DMA)) != NULL))
+	{
+		Local_uint32Blocks = (Local_uint32Length + Local_uint16BlockSize - 1u) / Local_uint16BlockSize;
+		if(Local_uint32Blocks > BL_MANIFEST_MAX_BLOCKS)
+		{
+			Local_uint32Blocks = BL_MANIFEST_MAX_BLOCKS;
+		}
+
+		Local_puint8Tx = BL_puint8TransportTxAcquire();
+		Local_uint16TxLength = uint8_BuildAckHeader(Local_puint8Tx, (uint16_t)(3u + (4u * Local_uint32Blocks)));
+
+		Local_puint8Tx[Local_uint16TxLength++] = HAL_OK;
+		Local_puint8Tx[Local_uint16TxLength++] = (uint8_t)(Local_uint32Blocks & 0xFFu);
+		Local_puint8Tx[Local_uint16TxLength++] = (uint8_t)(Local_uint32Blocks >> 8);
+
+		for(Local_uint32Block = 0; Local_uint32Block < Local_uint32Blocks; Local_uint32Block++)
+		{
+			Local_uint32BlockLength = Local_uint32Length - (Local_uint32Block * Local_uint16BlockSize);
+			if(Local_uint32BlockLength > Local_uint16BlockSize)
+			{
+				Local_uint32BlockLength = Local_uint16BlockSize;
+			}
+
+			if((Local_uint8Flags & BL_MANIFEST_FLAG_IEEE) != 0u)
+			{
+				Local_uint32BlockCRC = BL_uint32CRCCalculateIEEE((const uint8_t*)(Local_uint32Address + (Local_uint32Block * Local_uint16BlockSize)),
+				                                                 Local_uint32BlockLength);
+			}
+#if BL_SLOT_CACHE_ENABLE
+			else if((Local_uint32BlockLength == BL_SLOT_CACHE_BLOCK_SIZE) &&
+			        (BL_uint8SlotCacheGetCrc(Local_uint32Address + (Local_uint32Block * Local_uint16BlockSize), &Local_uint32BlockCRC) != 0u))
+			{
+				/* Computed while the link was idle */
+			}
+#endif
+			else
+			{
+				Local_uint32BlockCRC = BL_uint32CRCCalculate((const uint8_t*)(Local_uint32Address + (Local_uint32Block * Local_uint16BlockSize)),
+				                                             Local_uint32BlockLength);
+			}
+
+			memcpy(&Local_puint8Tx[Local_uint16TxLength], &Local_uint32BlockCRC, 4u);
+			Local_uint16TxLength += 4u;
+		}
+
+		voidStartResponse(Local_puint8Tx, Local_uint16TxLength);
+	}
+	else
+	{
+		uint8_t Local_uint8Status = HAL_ERROR;
+
+		voidSendResponse(&Local_uint8Status, 1u);
+	}
+}
+
+
+/*
+ * BL_voidHandleSetFrameCrcCmd
+ * ---------------------------
+ * Switches the per-frame CRC check of USB command frames off or back on
+ * (see "Frame CRC Mode" in BL.h).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               The expected packet structure:
+ *                               - Byte [0]     : Command length (excluding itself).
+ *                               - Byte [1]     : Command identifier.
+ *                               - Byte [2]     : BL_FRAME_CRC_ON / BL_FRAME_CRC_OFF.
+ *                               - Last 4 bytes : CRC checksum for validation
+ *                                                (checked unless already off).
+ *
+ * Behavior:
+ * ---------
+ * Replies [status] [mode in effect]. HAL_ERROR, mode unchanged, for an
+ * unknown mode or BL_FRAME_CRC_OFF requested over UART / SPI.
+ */
+void BL_voidHandleSetFrameCrcCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t  Local_uint8Reply[2];
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint16_t Local_uint16PayloadLength = uint16_GetFramePayloadLength(copy_puint8CmdPacket);
+
+	Local_uint8Reply[0] = HAL_ERROR;
+
+	if(Local_uint16PayloadLength >= 1u)
+	{
+		if(Local_puint8Payload[0] == BL_FRAME_CRC_ON)
+		{
+			Global_uint8FrameCrcMode = BL_FRAME_CRC_ON;
+			Local_uint8Reply[0] = HAL_OK;
+		}
+		else if((Local_puint8Payload[0] == BL_FRAME_CRC_OFF) && (BL_uint8TransportGetLink() == BL_LINK_USB))
+		{
+			Global_uint8FrameCrcMode = BL_FRAME_CRC_OFF;
+			Local_uint8Reply[0] = HAL_OK;
+		}
+	}
+
+	Local_uint8Reply[1] = Global_uint8FrameCrcMode;
+
+	voidSendResponse(Local_uint8Reply, 2u);
+}
+
+
+/*
+ * uint32_GetFeatures
+ * ------------------
+ * Collects the BL_FEATURE_xxx flags: the build options, plus the frame CRC
+ * mode currently in effect.
+ */
+static uint32_t uint32_GetFeatures(void)
+{
+	uint32_t Local_uint32Features = BL_FEATURE_EXT_FRAMES | BL_FEATURE_ALIGNED_FRAMES | BL_FEATURE_COBS_FRAMING | BL_FEATURE_CRC_IEEE;
+
+#if BL_RESPONSE_CRC_ENABLE
+	Local_uint32Features |= BL_FEATURE_RESPONSE_CRC;
+#endif
+#if BL_CRC_WORDWISE_ENABLE
+	Local_uint32Features |= BL_FEATURE_CRC_WORDWISE;
+#endif
+#if BL_TRANSPORT_USB_ENABLE
+	Local_uint32Features |= BL_FEATURE_USB;
+#endif
+#if BL_TRANSPORT_SPI_ENABLE
+	Local_uint32Features |= BL_FEATURE_SPI;
+#endif
+#if BL_TRANSPORT_CAN_ENABLE
+	Local_uint32Features |= BL_FEATURE_CAN;
+#endif
+#if BL_RS485_ENABLE
+	Local_uint32Features |= BL_FEATURE_RS485;
+#endif
+#if BL_USB_MSC_ENABLE
+	Local_uint32Features |= BL_FEATURE_UF2;
+#endif
+#if BL_UART_FLOW_CONTROL_ENABLE
+	Local_uint32Features |= BL_FEATURE_UART_FLOW_CONTROL;
+#endif
+#if BL_SIGNATURE_ENABLE
+	Local_uint32Features |= BL_FEATURE_SIGNATURE;
+#endif
+#if BL_WRITE_VERIFY_ENABLE
+	Local_uint32Features |= BL_FEATURE_WRITE_VERIFY;
+#endif
+#if BL_DECRYPT_ENABLE
+	Local_uint32Features |= BL_FEATURE_DECRYPT;
+#endif
+#if BL_PROGRESS_ENABLE
+	Local_uint32Features |= BL_FEATURE_PROGRESS;
+#endif
+#if BL_LINK_TEST_ENABLE
+	Local_uint32Features |= BL_FEATURE_LINK_TEST;
+#endif
+	if(Global_uint8FrameCrcMode == BL_FRAME_CRC_OFF)
+	{
+		Local_uint32Features |= BL_FEATURE_FRAME_CRC_OFF;
+	}
+
+	return Local_uint32Features;
+}
+
+
+/*
+ * BL_voidHandleGetDeviceInfoCmd
+ * -----------------------------
+ * Replies, in one response, a BL_DeviceInfo_t followed by the supported
+ * command list (see "Device Info" in BL.h).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ */
+void BL_voidHandleGetDeviceInfoCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t Local_uint8Reply[sizeof(BL_DeviceInfo_t) + sizeof(Global_uint8SupportedCommands)];
+	BL_DeviceInfo_t Local_Info;
+
+	Local_Info.InfoVersion       = BL_DEVICE_INFO_VERSION;
+	Local_Info.BootloaderVersion = BL_VERSION;
+	Local_Info.ChipId            = (uint16_t)(DBGMCU_IDCODE_REGISTER & 0x0fff);
+	Local_Info.RevisionId        = (uint16_t)(DBGMCU_IDCODE_REGISTER >> 16);
+	Local_Info.RdpLevel          = (uint8_t)((RDP_USER_OPTION_WORD >> 8) & 0xff);
+	Local_Info.WriteProtected    = uint16_ReadWriteProtection();
+	Local_Info.UniqueId[0]       = *((const volatile uint32_t*)(UID_BASE + 0u));
+	Local_Info.UniqueId[1]       = *((const volatile uint32_t*)(UID_BASE + 4u));
+	Local_Info.UniqueId[2]       = *((const volatile uint32_t*)(UID_BASE + 8u));
+	Local_Info.FlashSizeKb       = *((const volatile uint16_t*)FLASHSIZE_BASE);
+	Local_Info.MaxPayload        = BL_MAX_PAYLOAD_LENGTH;
+	Local_Info.Features          = uint32_GetFeatures();
+	Local_Info.CommandCount      = (uint8_t)sizeof(Global_uint8SupportedCommands);
+
+	memcpy(Local_uint8Reply, &Local_Info, sizeof(BL_DeviceInfo_t));
+	memcpy(&Local_uint8Reply[sizeof(BL_DeviceInfo_t)], Global_uint8SupportedCommands, sizeof(Global_uint8SupportedCommands));
+
+	voidSendResponse(Local_uint8Reply, sizeof(Local_uint8Reply));
+}
+
+
+/*
+ * BL_voidHandleReadMultiCmd
+ * -------------------------
+ * Reads a list of scattered ranges (config, fault log, version strings,
+ * option bytes...) in one round trip (see "Read Multi" in BL.h).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               - Byte [2]     : Range count.
+ *                               - Then per range : address (4, LE), length (2, LE).
+ *                               - Last 4 bytes : CRC checksum for validation.
+ *
+ * Behavior:
+ * ---------
+ * 1. Every range is checked (pMemory_LookupRegion, readable) and the total
+ *    length computed before anything is copied.
+ * 2. The ranges are copied one after the other into the TX buffer, behind the
+ *    ACK header and the status, and one CRC32 covers the whole response.
+ */
+void BL_voidHandleReadMultiCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint16_t Local_uint16PayloadLength = uint16_GetFramePayloadLength(copy_puint8CmdPacket);
+	uint8_t  Local_uint8Count = 0u;
+	uint8_t  Local_uint8Index = 0u;
+	uint32_t Local_uint32Total = 0u;
+	uint32_t Local_uint32Address;
+	uint16_t Local_uint16Length;
+	uint8_t* Local_puint8Entry;
+	uint8_t* Local_puint8Tx;
+	uint16_t Local_uint16TxLength;
+	uint32_t Local_uint32ResponseCRC;
+
+	if(Local_uint16PayloadLength >= 1u)
+	{
+		Local_uint8Count = Local_puint8Payload[0];
+	}
+
+	if((Local_uint16PayloadLength == 0u) ||
+	   (Local_uint16PayloadLength != (1u + ((uint16_t)Local_uint8Count * BL_READ_MULTI_ENTRY_SIZE))))
+	{
+		Local_uint8Index = Local_uint8Count;
+		Local_uint32Total = BL_READ_MULTI_MAX_DATA + 1u;
+	}
+	else
+	{
+		voidFinishEraseJob();
+		uint8_FlushWriteBuffer();
+
+		for(Local_uint8Index = 0; Local_uint8Index < Local_uint8Count; Local_uint8Index++)
+		{
+			Local_puint8Entry   = &Local_puint8Payload[1u + ((uint16_t)Local_uint8Index * BL_READ_MULTI_ENTRY_SIZE)];
+			Local_uint32Address = uint32_GetField(&Local_puint8Entry[0]);
+			Local_uint16Length  = uint16_GetField(&Local_puint8Entry[4]);
+
+			if(pMemory_LookupRegion(Local_uint32Address, Local_uint16Length, BL_MEMORY_READ) == NULL)
+			{
+				break;
+			}
+
+			Local_uint32Total += Local_uint16Length;
+		}
+
+		if(Local_uint32Total > BL_READ_MULTI_MAX_DATA)
+		{
+			Local_uint8Index = Local_uint8Count;
+		}
+	}
+
+	Local_puint8Tx = BL_puint8TransportTxAcquire();
+
+	if((Local_uint8Index == Local_uint8Count) && (Local_uint32Total <= BL_READ_MULTI_MAX_DATA))
+	{
+		Local_uint16TxLength = uint8_BuildAckHeader(Local_puint8Tx, (uint16_t)(1u + Local_uint32Total));
+		Local_puint8Tx[Local_uint16TxLength++] = HAL_OK;
+
+		for(Local_uint8Index = 0; Local_uint8Index < Local_uint8Count; Local_uint8Index++)
+		{
+			Local_puint8Entry   = &Local_puint8Payload[1u + ((uint16_t)Local_uint8Index * BL_READ_MULTI_ENTRY_SIZE)];
+			Local_uint32Address = uint32_GetField(&Local_puint8Entry[0]);
+			Local_uint16Length  = uint16_GetField(&Local_puint8Entry[4]);
+
+			memcpy(&Local_puint8Tx[Local_uint16TxLength], (const uint8_t*)Local_uint32Address, Local_uint16Length);
+			Local_uint16TxLength += Local_uint16Length;
+		}
+	}
+	else
+	{
+		Local_uint16TxLength = uint8_BuildAckHeader(Local_puint8Tx, 2u);
+		Local_puint8Tx[Local_uint16TxLength++] = HAL_ERROR;
+		Local_puint8Tx[Local_uint16TxLength++] = Local_uint8Index;
+	}
+
+	/* One CRC over the whole snapshot */
+	Local_uint32ResponseCRC = uint32_CalculateCRC(Local_puint8Tx, Local_uint16TxLength);
+	memcpy(&Local_puint8Tx[Local_uint16TxLength], &Local_uint32ResponseCRC, 4u);
+
+	BL_voidTransportTxStart((uint16_t)(Local_uint16TxLength + 4u));
+}
+
+
+/*
+ * uint8_RangeIsBlank
+ * ------------------
+ * Blank check of a flash range for BL_BLANK_MAP: granules of the slots the
+ * cache has computed cost no flash read, the rest is scanned.
+ *
+ * Return:
+ * -------
+ *  BL_FLASH_SECTOR_BLANK or BL_FLASH_SECTOR_NOT_BLANK.
+ */
+static uint8_t uint8_RangeIsBlank(uint32_t Copy_uint32Address, uint32_t Copy_uint32Length)
+{
+#if BL_SLOT_CACHE_ENABLE
+	uint8_t Local_uint8Blank = BL_uint8SlotCacheRangeIsBlank(Copy_uint32Address, Copy_uint32Length);
+
+	if(Local_uint8Blank != BL_SLOT_CACHE_UNKNOWN)
+	{
+		return Local_uint8Blank;
+	}
+#endif
+
+	return BL_uint8FlashRangeIsBlank(Copy_uint32Address, Copy_uint32Length);
+}
+
+
+/*
+ * BL_voidHandleBlankMapCmd
+ * ------------------------
+ * Maps the erased parts of a flash area so the host can skip erasing and
+ * writing them (see "Blank Map" in BL.h).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               - Byte [2:5]   : Address (LE).
+ *                               - Byte [6:9]   : Length (LE).
+ *                               - Byte [10:13] : Granule (LE, optional).
+ *                               - Last 4 bytes : CRC checksum for validation.
+ *
+ * Behavior:
+ * ---------
+ * 1. The area must be word aligned and lie in flash (pMemory_LookupRegion).
+ * 2. Each granule is blank-checked from the slot cache, or with 32-bit reads
+ *    where it has no answer (uint8_RangeIsBlank); adjacent blank granules are
+ *    merged into one range. The last granule may be shorter.
+ * 3. The list is built in the TX buffer behind the longest ACK header and
+ *    moved down when the short one is enough.
+ */
+void BL_voidHandleBlankMapCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint16_t Local_uint16PayloadLength = uint16_GetFramePayloadLength(copy_puint8CmdPacket);
+	uint32_t Local_uint32Address = uint32_GetField(&Local_puint8Payload[0]);
+	uint32_t Local_uint32Length  = uint32_GetField(&Local_puint8Payload[4]);
+	uint32_t Local_uint32Granule = BL_BLANK_MAP_DEFAULT_GRANULE;
+	const BL_MemoryRegion_t* Local_pRegion = NULL;
+	uint32_t Local_uint32End;
+	uint32_t Local_uint32Step;
+	uint32_t Local_uint32RunStart = 0u;
+	uint32_t Local_uint32RunLength;
+	uint8_t  Local_uint8InRun = 0u;
+	uint16_t Local_uint16Ranges = 0u;
+	uint8_t* Local_puint8Tx;
+	uint8_t* Local_puint8List;
+	uint16_t Local_uint16HeaderLength;
+	uint16_t Local_uint16ReplyLength;
+
+	if(Local_uint16PayloadLength >= 12u)
+	{
+		Local_uint32Granule = uint32_GetField(&Local_puint8Payload[8]);
+	}
+
+	voidFinishEraseJob();
+	uint8_FlushWriteBuffer();
+
+	if(Local_uint16PayloadLength >= 8u)
+	{
+		Local_pRegion = pMemory_LookupRegion(Local_uint32Address, Local_uint32Length, BL_MEMORY_READ);
+	}
+
+	if((Local_pRegion != NULL) && (Local_pRegion->Method == BL_MEMORY_METHOD_FLASH) &&
+	   (((Local_uint32Address | Local_uint32Length | Local_uint32Granule) & 0x3u) == 0u) && (Local_uint32Granule != 0u))
+	{
+		Local_uint32End  = Local_uint32Address + Local_uint32Length;
+		Local_puint8Tx   = BL_puint8TransportTxAcquire();
+		Local_puint8List = &Local_puint8Tx[4u + 7u];
+
+		while(Local_uint32Address < Local_uint32End)
+		{
+			Local_uint32Step = Local_uint32End - Local_uint32Address;
+			if(Local_uint32Step > Local_uint32Granule)
+			{
+				Local_uint32Step = Local_uint32Granule;
+			}
+
+			if(uint8_RangeIsBlank(Local_uint32Address, Local_uint32Step) == BL_FLASH_SECTOR_BLANK)
+			{
+				if(Local_uint8InRun == 0u)
+				{
+					/* A new range that no longer fits: resume here next time */
+					if(Local_uint16Ranges == BL_BLANK_MAP_MAX_RANGES)
+					{
+						break;
+					}
+					Local_uint32RunStart = Local_uint32Address;
+					Local_uint8InRun = 1u;
+				}
+			}
+			else if(Local_uint8InRun != 0u)
+			{
+				memcpy(&Local_puint8List[8u * Local_uint16Ranges], &Local_uint32RunStart, 4u);
+				Local_uint32RunLength = Local_uint32Address - Local_uint32RunStart;
+				memcpy(&Local_puint8List[(8u * Local_uint16Ranges) + 4u], &Local_uint32RunLength, 4u);
+				Local_uint16Ranges++;
+				Local_uint8InRun = 0u;
+			}
+
+			Local_uint32Address += Local_uint32Step;
+		}
+
+		if(Local_uint8InRun != 0u)
+		{
+			memcpy(&Local_puint8List[8u * Local_uint16Ranges], &Local_uint32RunStart, 4u);
+			Local_uint32RunLength = Local_uint32Address - Local_uint32RunStart;
+			memcpy(&Local_puint8List[(8u * Local_uint16Ranges) + 4u], &Local_uint32RunLength, 4u);
+			Local_uint16Ranges++;
+		}
+
+		Local_puint8Tx[4] = HAL_OK;
+		memcpy(&Local_puint8Tx[5], &Local_uint32Address, 4u);
+		memcpy(&Local_puint8Tx[9], &Local_uint16Ranges, 2u);
+
+		Local_uint16ReplyLength  = (uint16_t)(7u + (8u * Local_uint16Ranges));
+		Local_uint16HeaderLength = uint8_BuildAckHeader(Local_puint8Tx, Local_uint16ReplyLength);
+		if(Local_uint16HeaderLength != 4u)
+		{
+			memmove(&Local_puint8Tx[Local_uint16HeaderLength], &Local_puint8Tx[4], Local_uint16ReplyLength);
+		}
+
+		voidStartResponse(Local_puint8Tx, (uint16_t)(Local_uint16HeaderLength + Local_uint16ReplyLength));
+	}
+	else
+	{
+		uint8_t Local_uint8Status = HAL_ERROR;
+
+		voidSendResponse(&Local_uint8Status, 1u);
+	}
+}
+
+
+/*
+ * uint8_GetCapturedStatus
+ * -----------------------
+ * Reads back the response a sub-command left in the TX buffer in capture mode.
+ *
+ * Return:
+ * -------
+ * @return uint8_t : First payload byte, BL_ACK for an empty ACK reply,
+ *                   BL_NACK for a NACK or when nothing was sent.
+ */
+static uint8_t uint8_GetCapturedStatus(void)
+{
+	uint16_t Local_uint16Length = BL_uint16TransportTxCaptured();
+	uint8_t* Local_puint8Tx = BL_puint8TransportTxAcquire();
+
+	if((Local_uint16Length < 2u) || (Local_puint8Tx[0] != BL_ACK))
+	{
+		return BL_NACK;
+	}
+
+	if(Local_puint8Tx[1] != BL_FRAME_EXT_MARKER)
+	{
+		return Local_puint8Tx[2];
+	}
+
+	/* [ACK] [0x00] is an empty reply, an extended header announces more than 255 bytes */
+	return (Local_uint16Length >= (4u + 0x100u)) ? Local_puint8Tx[4] : BL_ACK;
+}
+
+
+/*
+ * BL_voidHandleBatchCmd
+ * ---------------------
+ * Runs a sequence of sub-commands received under one CRC and answers with
+ * their statuses in one response: a provisioning sequence (erase, write,
+ * verify, protect, jump) costs one round trip instead of one per command.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               The expected packet structure:
+ *                               - Byte [0]     : Command length (or extended header).
+ *                               - Byte [1]     : Command identifier.
+ *                               - Byte [2]     : Number of sub-commands.
+ *                               - Then, per sub-command: expected status (1)
+ *                                 and a complete v1 / extended frame.
+ *                               - Last 4 bytes : CRC checksum for validation.
+ *
+ * Behavior:
+ * ---------
+ * 1. Each sub-frame must lie inside the batch and hold a command code and a
+ *    CRC field, otherwise the batch ends with BL_BATCH_MALFORMED.
+ * 2. Unknown and BL_COMMAND_FLAG_NO_BATCH commands, and aligned-format sub-frames
+ *    not starting on a word, end it with BL_BATCH_REJECTED.
+ * 3. A sub-command is run through its table entry like a received frame (minimum
+ *    payload included, the CRC excepted) with its response captured in the TX
+ *    buffer; the status is read back with uint8_GetCapturedStatus().
+ * 4. A NACK or an unexpected status ends the batch with BL_BATCH_STOPPED.
+ * 5. A BL_COMMAND_FLAG_ENDS_BATCH command is run after the reply has been
+ *    started, with its own response, and ends the batch.
+ * 6. Replies [result] [n] [n statuses].
+ * The loop is voidRunBatch, shared with BL_RUN_SCRIPT.
+ */
+void BL_voidHandleBatchCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+
+	voidRunBatch(Local_puint8Payload, Local_puint8Payload + uint16_GetFramePayloadLength(copy_puint8CmdPacket));
+}
+
+
+/*
+ * voidRunBatch
+ * ------------
+ * Runs and answers a BL_BATCH payload, [count] then the entries, wherever it
+ * lies: in the received frame (BL_BATCH) or in SRAM (BL_RUN_SCRIPT).
+ */
+static void voidRunBatch(uint8_t* Copy_puint8Batch, uint8_t* Copy_puint8End)
+{
+	uint8_t* Local_puint8Entry = Copy_puint8Batch;
+	uint8_t  Local_uint8Count = *Local_puint8Entry++;
+	uint8_t  Local_uint8Reply[2u + 0xFFu];
+	uint8_t  Local_uint8Done = 0;
+	uint8_t  Local_uint8Result = BL_BATCH_DONE;
+	uint8_t* Local_puint8SubFrame = NULL;
+	const BL_Command_t* Local_pCommand = NULL;
+
+	while((Local_uint8Done < Local_uint8Count) && (Local_uint8Result == BL_BATCH_DONE))
+	{
+		uint8_t  Local_uint8Expected = Local_puint8Entry[0];
+		uint16_t Local_uint16SubLength;
+		uint8_t  Local_uint8Status;
+
+		Local_puint8SubFrame = &Local_puint8Entry[1];
+
+		/* The header, command code and CRC field must all lie inside the batch */
+		if(((Copy_puint8End - Local_puint8SubFrame) < 6) ||
+		   ((Local_puint8SubFrame[0] <= BL_FRAME_ALIGNED_MARKER) && ((Copy_puint8End - Local_puint8SubFrame) < 8)) ||
+		   ((Local_puint8SubFrame[0] == BL_FRAME_ALIGNED_MARKER) && ((Local_puint8SubFrame[1] | (Local_puint8SubFrame[2] << 8)) < 5)))
+		{
+			Local_uint8Result = BL_BATCH_MALFORMED;
+			break;
+		}
+
+		/* An aligned sub-frame is only aligned if it starts on a word */
+		if((Local_puint8SubFrame[0] == BL_FRAME_ALIGNED_MARKER) && (((uint32_t)Local_puint8SubFrame & 3u) != 0u))
+		{
+			Local_uint8Result = BL_BATCH_REJECTED;
+			break;
+		}
+
+		Local_uint16SubLength = uint16_GetFrameLength(Local_puint8SubFrame);
+		if((Local_uint16SubLength > (uint16_t)(Copy_puint8End - Local_puint8SubFrame)) ||
+		   (Local_uint16SubLength < (uint16_t)((puint8_GetFramePayload(Local_puint8SubFrame) - Local_puint8SubFrame) + 4)))
+		{
+			Local_uint8Result = BL_BATCH_MALFORMED;
+			break;
+		}
+
+		Local_pCommand = pCommand_Lookup(Local_puint8SubFrame);
+		if((Local_pCommand == NULL) || ((Local_pCommand->Flags & BL_COMMAND_FLAG_NO_BATCH) != 0u))
+		{
+			Local_uint8Result = BL_BATCH_REJECTED;
+			break;
+		}
+
+		if(uint16_GetFramePayloadLength(Local_puint8SubFrame) < Local_pCommand->MinPayload)
+		{
+			Local_uint8Status = BL_NACK;
+		}
+		else if((Local_pCommand->Flags & BL_COMMAND_FLAG_ENDS_BATCH) != 0u)
+		{
+			Local_uint8Result = BL_BATCH_HANDOFF;
+			break;
+		}
+		else
+		{
+			BL_voidTransportTxCapture(1u);
+			Local_pCommand->Handler(Local_puint8SubFrame);
+			Local_uint8Status = uint8_GetCapturedStatus();
+			BL_voidTransportTxCapture(0u);
+		}
+
+		Local_uint8Reply[2u + Local_uint8Done] = Local_uint8Status;
+		Local_uint8Done++;
+
+		if((Local_uint8Status == BL_NACK) ||
+		   ((Local_uint8Expected != BL_BATCH_EXPECT_ANY) && (Local_uint8Status != Local_uint8Expected)))
+		{
+			Local_uint8Result = BL_BATCH_STOPPED;
+		}
+
+		Local_puint8Entry = Local_puint8SubFrame + Local_uint16SubLength;
+	}
+
+	Local_uint8Reply[0] = Local_uint8Result;
+	Local_uint8Reply[1] = Local_uint8Done;
+	voidSendResponse(Local_uint8Reply, (uint16_t)(2u + Local_uint8Done));
+
+	if(Local_uint8Result == BL_BATCH_HANDOFF)
+	{
+		/* Answers with its own response, after the batch reply */
+		Local_pCommand->Handler(Local_puint8SubFrame);
+	}
+}
+
+
+/*
+ * BL_voidHandleResumeSessionCmd
+ * -----------------------------
+ * Reopens an interrupted resumable programming session from its backup SRAM
+ * record, so a transfer lost at 95 % goes on from the last saved offset
+ * instead of starting over with the erase.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               The expected packet structure:
+ *                               - Byte [0]     : Command length (excluding itself).
+ *                               - Byte [1]     : Command identifier.
+ *                               - Last 4 bytes : CRC checksum for validation.
+ *
+ * Behavior:
+ * ---------
+ * 1. Waits for a background erase and programs staged writes.
+ * 2. Without a valid record replies [HAL_ERROR] and changes nothing.
+ * 3. Otherwise the session is (re)opened with the record's range, written
+ *    length, erased-sector bitmap and running CRC / SHA-256: writes made after
+ *    the record was saved are forgotten and must be sent again.
+ * 4. Replies [HAL_OK] [target address (4)] [target length (4)] [written (4)]
+ *    [CRC of the written prefix (4)] [decrypting (1)], all little endian.
+ */
+void BL_voidHandleResumeSessionCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t  Local_uint8Reply[18];
+	uint8_t  Local_uint8Status = HAL_ERROR;
+	uint32_t Local_uint32PrefixCRC;
+	const BL_SessionRecord_t* Local_pRecord;
+
+	voidFinishEraseJob();
+	uint8_FlushWriteBuffer();
+	(void)BL_uint8FlashSelectParallelism();
+
+	Local_pRecord = pSession_LoadRecord();
+
+	if(Local_pRecord != NULL)
+	{
+		Local_uint8Status = HAL_OK;
+		if(Global_uint8SessionOpen == 0)
+		{
+			Local_uint8Status = HAL_FLASH_Unlock();
+		}
+	}
+
+	if(Local_uint8Status == HAL_OK)
+	{
+		__HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR |
+		                       FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR);
+
+		Global_uint32SessionBase       = Local_pRecord->Base;
+		Global_uint32SessionSize       = Local_pRecord->Size;
+		Global_uint32SessionWritten    = Local_pRecord->Written;
+		Global_uint32SessionGeneration = Local_pRecord->Generation;
+		Global_uint16ErasedSectors     = (uint16_t)Local_pRecord->ErasedSectors;
+		Global_ImageCrc                = Local_pRecord->Crc;
+		Global_ImageSha                = Local_pRecord->Sha;
+		Global_uint8SessionDecrypt     = (uint8_t)Local_pRecord->Decrypt;
+		memcpy(Global_uint8SessionCounter, Local_pRecord->Counter, BL_SESSION_COUNTER_SIZE);
+#if BL_DECRYPT_ENABLE
+		BL_voidAESSetKey(&Global_ImageAes, Global_uint8ImageKey, (uint8_t)sizeof(Global_uint8ImageKey));
+#endif
+
+		Global_uint8CombineStatus      = HAL_OK;
+		Global_uint32VerifyFailAddress = BL_FLASH_VERIFY_OK;
+		Global_uint8SessionResumable   = 1;
+		Global_uint8SessionResumed     = 1;
+		Global_uint32SessionIdleMs     = 0;
+		Global_uint8SessionExpired     = 0;
+		Global_uint8SessionOpen        = 1;
+
+		Local_uint32PrefixCRC = BL_uint32CRCStreamFinish(&Global_ImageCrc);
+
+		Local_uint8Reply[0] = HAL_OK;
+		memcpy(&Local_uint8Reply[1],  &Global_uint32SessionBase, 4u);
+		memcpy(&Local_uint8Reply[5],  &Global_uint32SessionSize, 4u);
+		memcpy(&Local_uint8Reply[9],  &Global_uint32SessionWritten, 4u);
+		memcpy(&Local_uint8Reply[13], &Local_uint32PrefixCRC, 4u);
+		Local_uint8Reply[17] = Global_uint8SessionDecrypt;
+
+		voidSendResponse(Local_uint8Reply, 18u);
+	}
+	else
+	{
+		Local_uint8Status = HAL_ERROR;
+		voidSendResponse(&Local_uint8Status, 1u);
+	}
+}
+
+
+#if BL_LZ_ENABLE
+/*
+ * uint32_GetLzRate
+ * ----------------
+ * Bytes per second of the last LZ stream for a cycle total, 0 when no
+ * stream has produced anything yet.
+ */
+static uint32_t uint32_GetLzRate(uint64_t Copy_uint64Cycles)
+{
+	uint32_t Local_uint32Rate = 0;
+
+	if(Copy_uint64Cycles != 0u)
+	{
+		Local_uint32Rate = (uint32_t)(((uint64_t)Global_uint32LzDecoded * SystemCoreClock) / Copy_uint64Cycles);
+	}
+
+	return Local_uint32Rate;
+}
+#endif
+
+
+/*
+ * BL_voidHandleGetCapabilitiesCmd
+ * -------------------------------
+ * Replies a BL_Capabilities_t (see "Capabilities" in BL.h): frame and window
+ * limits, baud rate range, links, codecs and hash algorithms of this build.
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ */
+void BL_voidHandleGetCapabilitiesCmd(uint8_t* copy_puint8CmdPacket)
+{
+	BL_Capabilities_t Local_Caps;
+
+	memset(&Local_Caps, 0, sizeof(Local_Caps));
+
+	Local_Caps.CapsVersion       = BL_CAPABILITIES_VERSION;
+	Local_Caps.Link              = BL_uint8TransportGetLink();
+	Local_Caps.Links             = BL_CAPS_LINK_UART;
+#if BL_TRANSPORT_USB_ENABLE
+	Local_Caps.Links            |= BL_CAPS_LINK_USB;
+#endif
+#if BL_TRANSPORT_SPI_ENABLE
+	Local_Caps.Links            |= BL_CAPS_LINK_SPI;
+#endif
+#if BL_TRANSPORT_CAN_ENABLE
+	Local_Caps.Links            |= BL_CAPS_LINK_CAN | BL_CAPS_LINK_CAN_GROUP;
+#endif
+	Local_Caps.Codecs            = 0u;
+#if BL_READ_RLE_ENABLE
+	Local_Caps.Codecs           |= BL_CAPS_CODEC_READ_RLE;
+#endif
+#if BL_LZ_ENABLE
+	Local_Caps.Codecs           |= BL_CAPS_CODEC_WRITE_LZ;
+#endif
+#if BL_DELTA_ENABLE
+	Local_Caps.Codecs           |= BL_CAPS_CODEC_WRITE_DELTA | BL_CAPS_CODEC_DELTA_THUMB;
+#if BL_LZ_ENABLE
+	Local_Caps.Codecs           |= BL_CAPS_CODEC_DELTA_LZ;
+#endif
+#endif
+#if BL_PACKAGE_ENABLE
+	Local_Caps.Codecs           |= BL_CAPS_CODEC_PACKAGE;
+#endif
+	Local_Caps.Hashes            = BL_CAPS_HASH_CRC32 | BL_CAPS_HASH_CRC32_WORDWISE;
+#if BL_SHA256_ENABLE
+	Local_Caps.Hashes           |= BL_CAPS_HASH_SHA256;
+#endif
+#if BL_SIGNATURE_ENABLE
+	Local_Caps.Hashes           |= BL_CAPS_HASH_ECDSA_P256;
+#endif
+	Local_Caps.StreamAckInterval = STREAM_ACK_INTERVAL;
+	Local_Caps.SelectiveWindow   = BL_STREAM_SELECTIVE_WINDOW;
+	Local_Caps.MaxFrame          = BL_MAX_FRAME_LENGTH;
+	Local_Caps.MaxPayload        = BL_MAX_PAYLOAD_LENGTH;
+	Local_Caps.RxBuffer          = BL_uint16TransportGetRxCapacity();
+	Local_Caps.FrameTimeoutMs    = BL_FRAME_TIMEOUT_MS;
+	Local_Caps.SessionTimeoutMs  = BL_SESSION_TIMEOUT_MS;
+	Local_Caps.MinBaudRate       = BAUD_MIN_RATE;
+	Local_Caps.MaxBaudRate       = HAL_RCC_GetPCLK1Freq() / 16u;
+	Local_Caps.Features          = uint32_GetFeatures();
+#if BL_LZ_ENABLE
+	Local_Caps.LzDecodeRate      = uint32_GetLzRate(Global_uint64LzDecodeCycles);
+	Local_Caps.LzWriteRate       = uint32_GetLzRate(Global_uint64LzWriteCycles);
+#endif
+	Local_Caps.VddMv             = BL_uint16FlashGetVdd();
+	Local_Caps.FlashParallelism  = BL_uint8FlashGetParallelism();
+
+	voidSendResponse((uint8_t*)&Local_Caps, sizeof(Local_Caps));
+}
+
+
+/*
+ * BL_voidHandleSetFramingCmd
+ * --------------------------
+ * Switches the framing of the following frames and responses (see "Framing"
+ * in BL_Transport.h).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               Payload: [BL_FRAMING_LENGTH / BL_FRAMING_COBS].
+ *
+ * Behavior:
+ * ---------
+ * Replies [status] [framing in effect] in the framing the command came in;
+ * on HAL_OK the host switches too before its next frame. HAL_ERROR, framing
+ * unchanged, for an unknown mode.
+ */
+void BL_voidHandleSetFramingCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t Local_uint8Framing = puint8_GetFramePayload(copy_puint8CmdPacket)[0];
+	uint8_t Local_uint8Reply[2];
+
+	Local_uint8Reply[0] = ((Local_uint8Framing == BL_FRAMING_LENGTH) || (Local_uint8Framing == BL_FRAMING_COBS)) ? HAL_OK : HAL_ERROR;
+#if BL_RS485_ENABLE
+	if(Local_uint8Framing == BL_FRAMING_COBS)
+	{
+		/* The node headers are length based */
+		Local_uint8Reply[0] = HAL_ERROR;
+	}
+#endif
+	Local_uint8Reply[1] = (Local_uint8Reply[0] == HAL_OK) ? Local_uint8Framing : BL_uint8TransportGetFraming();
+
+	voidSendResponse(Local_uint8Reply, 2u);
+
+	if(Local_uint8Reply[0] == HAL_OK)
+	{
+		BL_voidTransportSetFraming(Local_uint8Framing);
+	}
+}
+
+
+#if BL_LZ_ENABLE
+/*
+ * BL_voidHandleMemWriteLzCmd
+ * --------------------------
+ * Writes one packet of an LZ-compressed stream (see "Compressed Write" in BL.h).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               Payload: [flags] [address (4)] [compressed bytes].
+ *
+ * Behavior:
+ * ---------
+ * The packet is decoded in pieces that are contiguous in the decoder window,
+ * each one written through uint8_WriteRegion before the next is decoded, so
+ * the decompressed bytes go straight from the window into the write-combining
+ * line or the flash. The pieces of one packet may span several regions.
+ * Replies [status] [next address (4, LE)]: the address the following packet
+ * starts at, or after a failure the first byte not written.
+ */
+void BL_voidHandleMemWriteLzCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	const uint8_t* Local_puint8Input = &Local_puint8Payload[5];
+	uint16_t Local_uint16InputLength = uint16_GetFramePayloadLength(copy_puint8CmdPacket) - 5u;
+	uint8_t  Local_uint8Flags = Local_puint8Payload[0];
+	uint32_t Local_uint32Address = uint32_GetField(&Local_puint8Payload[1]);
+	uint8_t  Local_uint8Status = BL_LZ_WRITE_OK;
+	uint8_t* Local_puint8Output;
+	uint16_t Local_uint16OutputLength;
+	uint8_t  Local_uint8Reply[5];
+	uint32_t Local_uint32Cycles;
+
+	if((Local_uint8Flags & BL_LZ_WRITE_FLAG_START) != 0u)
+	{
+		BL_voidLZStart(&Global_LzStream);
+		Global_uint32LzAddress = Local_uint32Address;
+		Global_uint8LzOpen = 1;
+
+#if BL_DELTA_ENABLE
+		/* The decoder was a compressed delta stream's */
+		if((Global_DeltaStream.Flags & BL_DELTA_FLAG_LZ) != 0u)
+		{
+			Global_DeltaStream.State = BL_DELTA_STATE_CLOSED;
+		}
+#endif
+#if BL_PACKAGE_ENABLE
+		/* ... or a package's */
+		Global_uint8PackageOpen = 0;
+#endif
+
+		Global_uint64LzDecodeCycles = 0;
+		Global_uint64LzWriteCycles  = 0;
+		Global_uint32LzDecoded      = 0;
+	}
+
+	/* Cycle counter for the LzDecodeRate / LzWriteRate capabilities */
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	if((Global_uint8LzOpen == 0) || (Local_uint32Address != Global_uint32LzAddress))
+	{
+		Local_uint8Status = BL_LZ_WRITE_SEQUENCE;
+	}
+
+	while(Local_uint8Status == BL_LZ_WRITE_OK)
+	{
+		Local_uint32Cycles = DWT->CYCCNT;
+
+		if(BL_uint8LZDecode(&Global_LzStream, &Local_puint8Input, &Local_uint16InputLength,
+		                    &Local_puint8Output, &Local_uint16OutputLength) != BL_LZ_OK)
+		{
+			Local_uint8Status = BL_LZ_WRITE_CORRUPT;
+			break;
+		}
+
+		Global_uint64LzDecodeCycles += DWT->CYCCNT - Local_uint32Cycles;
+
+		if(Local_uint16OutputLength == 0u)
+		{
+			break;
+		}
+
+		Local_uint32Cycles = DWT->CYCCNT;
+
+		if(uint8_WriteRegion(Local_puint8Output, Global_uint32LzAddress, Local_uint16OutputLength) != HAL_OK)
+		{
+			Local_uint8Status = BL_LZ_WRITE_FAILED;
+		}
+		else
+		{
+			Global_uint32LzAddress += Local_uint16OutputLength;
+			Global_uint32LzDecoded += Local_uint16OutputLength;
+		}
+
+		Global_uint64LzWriteCycles += DWT->CYCCNT - Local_uint32Cycles;
+	}
+
+	if((Local_uint8Status == BL_LZ_WRITE_OK) && ((Local_uint8Flags & BL_LZ_WRITE_FLAG_END) != 0u))
+	{
+		if(BL_uint8LZIsComplete(&Global_LzStream) == 0u)
+		{
+			Local_uint8Status = BL_LZ_WRITE_CORRUPT;
+		}
+
+		Global_uint8LzOpen = 0;
+	}
+
+	/* A failed stream cannot continue: its window no longer matches the host encoder */
+	if(Local_uint8Status != BL_LZ_WRITE_OK)
+	{
+		Global_uint8LzOpen = 0;
+	}
+
+	Local_uint8Reply[0] = Local_uint8Status;
+	memcpy(&Local_uint8Reply[1], &Global_uint32LzAddress, 4u);
+
+	voidSendResponse(Local_uint8Reply, 5u);
+}
+#endif
+
+
+#if BL_DELTA_ENABLE
+/*
+ * uint8_FilterBranchPair
+ * ----------------------
+ * Converts a Thumb-2 BL pair between its relative and its absolute target
+ * (BL_DELTA_FLAG_THUMB in BL.h).
+ *
+ * Parameters:
+ * -----------
+ * @param Copy_puint8Pair   : 4 bytes at an even offset of the image, converted in place.
+ * @param Copy_uint32Offset : Their offset from the start of the image.
+ * @param Copy_uint8Encode  : 1 relative -> absolute, 0 absolute -> relative.
+ *
+ * Return:
+ * -------
+ * 1 if the bytes were a BL pair, 0 if they were left alone.
+ */
+static uint8_t uint8_FilterBranchPair(uint8_t* Copy_puint8Pair, uint32_t Copy_uint32Offset, uint8_t Copy_uint8Encode)
+{
+	uint32_t Local_uint32Position = (Copy_uint32Offset + 4u) >> 1;
+	uint32_t Local_uint32Value;
+
+	if(((Copy_puint8Pair[1] & 0xF8u) != 0xF0u) || ((Copy_puint8Pair[3] & 0xF8u) != 0xF8u))
+	{
+		return 0u;
+	}
+
+	Local_uint32Value = ((uint32_t)(Copy_puint8Pair[1] & 0x07u) << 19) | ((uint32_t)Copy_puint8Pair[0] << 11) |
+	                    ((uint32_t)(Copy_puint8Pair[3] & 0x07u) << 8)  | (uint32_t)Copy_puint8Pair[2];
+	Local_uint32Value = (Copy_uint8Encode != 0u) ? (Local_uint32Value + Local_uint32Position)
+	                                             : (Local_uint32Value - Local_uint32Position);
+
+	Copy_puint8Pair[0] = (uint8_t)(Local_uint32Value >> 11);
+	Copy_puint8Pair[1] = (uint8_t)(0xF0u | ((Local_uint32Value >> 19) & 0x07u));
+	Copy_puint8Pair[2] = (uint8_t)Local_uint32Value;
+	Copy_puint8Pair[3] = (uint8_t)(0xF8u | ((Local_uint32Value >> 8) & 0x07u));
+
+	return 1u;
+}
+
+
+/*
+ * voidReadDeltaSource
+ * -------------------
+ * Copies bytes of the delta stream's source, for the diff bytes to be added to.
+ *
+ * Behavior:
+ * ---------
+ * With BL_DELTA_FLAG_THUMB every BL pair overlapping the range (starting at
+ * most 3 bytes before it) is filtered as the host filtered the source, and
+ * the bytes of it inside the range replace the copied ones. The caller has
+ * checked that the range lies inside the source.
+ */
+static void voidReadDeltaSource(uint8_t* Copy_puint8Buffer, uint32_t Copy_uint32Offset, uint32_t Copy_uint32Length)
+{
+	const BL_DeltaStream_t* Local_pDelta = &Global_DeltaStream;
+	const uint8_t* Local_puint8Source = (const uint8_t*)Local_pDelta->Source;
+	uint32_t Local_uint32Pair = (Copy_uint32Offset > 2u) ? ((Copy_uint32Offset - 2u) & ~1UL) : 0u;
+	uint32_t Local_uint32Index;
+	uint8_t  Local_uint8Filtered[4];
+
+	memcpy(Copy_puint8Buffer, &Local_puint8Source[Copy_uint32Offset], Copy_uint32Length);
+
+	if((Local_pDelta->Flags & BL_DELTA_FLAG_THUMB) == 0u)
+	{
+		return;
+	}
+
+	while((Local_uint32Pair < (Copy_uint32Offset + Copy_uint32Length)) && ((Local_uint32Pair + 4u) <= Local_pDelta->SourceLength))
+	{
+		memcpy(Local_uint8Filtered, &Local_puint8Source[Local_uint32Pair], 4u);
+
+		if(uint8_FilterBranchPair(Local_uint8Filtered, Local_uint32Pair, 1u) != 0u)
+		{
+			for(Local_uint32Index = 0; Local_uint32Index < 4u; Local_uint32Index++)
+			{
+				if(((Local_uint32Pair + Local_uint32Index) >= Copy_uint32Offset) &&
+				   ((Local_uint32Pair + Local_uint32Index) < (Copy_uint32Offset + Copy_uint32Length)))
+				{
+					Copy_puint8Buffer[Local_uint32Pair + Local_uint32Index - Copy_uint32Offset] = Local_uint8Filtered[Local_uint32Index];
+				}
+			}
+		}
+
+		Local_uint32Pair += 2u;
+	}
+}
+
+
+/*
+ * uint8_WriteDeltaTarget
+ * ----------------------
+ * Writes up to BL_DELTA_CHUNK_SIZE rebuilt bytes, the next ones of the target.
+ *
+ * Behavior:
+ * ---------
+ * Without BL_DELTA_FLAG_THUMB the bytes go straight to uint8_WriteRegion.
+ * With it they are appended to the held bytes, which start at an even
+ * offset: every pair that fits is unfiltered and written, the bytes from
+ * the first pair that does not fit yet are held for the next call, unless
+ * no pair fits in the target any more.
+ *
+ * Return:
+ * -------
+ * HAL_OK, or the uint8_WriteRegion status.
+ */
+static uint8_t uint8_WriteDeltaTarget(uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length)
+{
+	BL_DeltaStream_t* Local_pDelta = &Global_DeltaStream;
+	uint8_t  Local_uint8Buffer[BL_DELTA_CHUNK_SIZE + sizeof(Local_pDelta->Hold)];
+	uint32_t Local_uint32Start = Local_pDelta->Written - Local_pDelta->Held;
+	uint32_t Local_uint32Length = (uint32_t)Local_pDelta->Held + Copy_uint16Length;
+	uint32_t Local_uint32Pair = 0;
+	uint8_t  Local_uint8Status = HAL_OK;
+
+	if((Local_pDelta->Flags & BL_DELTA_FLAG_THUMB) == 0u)
+	{
+		return uint8_WriteRegion(Copy_puint8Data, Local_pDelta->Target + Local_pDelta->Written, Copy_uint16Length);
+	}
+
+	memcpy(Local_uint8Buffer, Local_pDelta->Hold, Local_pDelta->Held);
+	memcpy(&Local_uint8Buffer[Local_pDelta->Held], Copy_puint8Data, Copy_uint16Length);
+
+	while((Local_uint32Pair + 4u) <= Local_uint32Length)
+	{
+		Local_uint32Pair += (uint8_FilterBranchPair(&Local_uint8Buffer[Local_uint32Pair], Local_uint32Start + Local_uint32Pair, 0u) != 0u) ? 4u : 2u;
+	}
+
+	if((Local_uint32Start + Local_uint32Pair + 4u) > Local_pDelta->TargetLength)
+	{
+		Local_uint32Pair = Local_uint32Length;
+	}
+
+	Local_pDelta->Held = (uint8_t)(Local_uint32Length - Local_uint32Pair);
+	memcpy(Local_pDelta->Hold, &Local_uint8Buffer[Local_uint32Pair], Local_pDelta->Held);
+
+	if(Local_uint32Pair != 0u)
+	{
+		Local_uint8Status = uint8_WriteRegion(Local_uint8Buffer, Local_pDelta->Target + Local_uint32Start, (uint16_t)Local_uint32Pair);
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * uint8_ApplyDelta
+ * ----------------
+ * Runs patch bytes of the open delta stream through its record state machine.
+ *
+ * Behavior:
+ * ---------
+ * 1. HEADER : gathers the 12-byte record header; a record producing more than
+ *             the rest of the target is rejected.
+ * 2. DIFF   : rebuilds up to BL_DELTA_CHUNK_SIZE bytes at a time as source + diff
+ *             and writes them; the source bytes must lie inside the source.
+ * 3. EXTRA  : writes the extra bytes straight from the patch, BL_DELTA_CHUNK_SIZE
+ *             at a time, then applies the seek.
+ * Empty runs advance at once, so the stream ends on a record boundary as soon
+ * as its last bytes have been written.
+ *
+ * Return:
+ * -------
+ * BL_DELTA_OK, BL_DELTA_FAILED or BL_DELTA_CORRUPT.
+ */
+static uint8_t uint8_ApplyDelta(uint8_t* Copy_puint8Patch, uint16_t Copy_uint16Length)
+{
+	BL_DeltaStream_t* Local_pDelta = &Global_DeltaStream;
+	uint8_t  Local_uint8Status = BL_DELTA_OK;
+	uint8_t  Local_uint8Rebuilt[BL_DELTA_CHUNK_SIZE];
+	uint32_t Local_uint32Chunk;
+	uint32_t Local_uint32Diff;
+	uint32_t Local_uint32Index;
+	int32_t  Local_int32Cursor;
+
+	while(Local_uint8Status == BL_DELTA_OK)
+	{
+		if((Local_pDelta->State == BL_DELTA_STATE_DIFF) && (Local_pDelta->Remaining == 0u))
+		{
+			Local_pDelta->Remaining = Local_pDelta->ExtraLength;
+			Local_pDelta->State = BL_DELTA_STATE_EXTRA;
+			continue;
+		}
+
+		if((Local_pDelta->State == BL_DELTA_STATE_EXTRA) && (Local_pDelta->Remaining == 0u))
+		{
+			/* The cursor may leave the source: only the diff bytes read it */
+			Local_int32Cursor = (int32_t)Local_pDelta->SourceCursor + Local_pDelta->Seek;
+			Local_pDelta->SourceCursor = (uint32_t)Local_int32Cursor;
+			Local_pDelta->State = BL_DELTA_STATE_HEADER;
+			continue;
+		}
+
+		if(Copy_uint16Length == 0u)
+		{
+			break;
+		}
+
+		if(Local_pDelta->State == BL_DELTA_STATE_HEADER)
+		{
+			Local_pDelta->Header[Local_pDelta->HeaderCount] = *Copy_puint8Patch;
+			Local_pDelta->HeaderCount++;
+			Copy_puint8Patch++;
+			Copy_uint16Length--;
+
+			if(Local_pDelta->HeaderCount == BL_DELTA_HEADER_SIZE)
+			{
+				Local_uint32Diff         = uint32_GetField(&Local_pDelta->Header[0]);
+				Local_pDelta->ExtraLength = uint32_GetField(&Local_pDelta->Header[4]);
+				Local_pDelta->Seek        = (int32_t)uint32_GetField(&Local_pDelta->Header[8]);
+				Local_pDelta->HeaderCount = 0;
+
+				if((Local_uint32Diff > (Local_pDelta->TargetLength - Local_pDelta->Written)) ||
+				   (Local_pDelta->ExtraLength > (Local_pDelta->TargetLength - Local_pDelta->Written - Local_uint32Diff)))
+				{
+					Local_uint8Status = BL_DELTA_CORRUPT;
+				}
+				else
+				{
+					Local_pDelta->Remaining = Local_uint32Diff;
+					Local_pDelta->State = BL_DELTA_STATE_DIFF;
+				}
+			}
+		}
+		else
+		{
+			Local_uint32Chunk = (Local_pDelta->Remaining < Copy_uint16Length) ? Local_pDelta->Remaining : Copy_uint16Length;
+
+			if(Local_uint32Chunk > BL_DELTA_CHUNK_SIZE)
+			{
+				Local_uint32Chunk = BL_DELTA_CHUNK_SIZE;
+			}
+
+			if(Local_pDelta->State == BL_DELTA_STATE_DIFF)
+			{
+				if((Local_pDelta->SourceCursor > Local_pDelta->SourceLength) ||
+				   (Local_uint32Chunk > (Local_pDelta->SourceLength - Local_pDelta->SourceCursor)))
+				{
+					Local_uint8Status = BL_DELTA_CORRUPT;
+					break;
+				}
+
+				voidReadDeltaSource(Local_uint8Rebuilt, Local_pDelta->SourceCursor, Local_uint32Chunk);
+				for(Local_uint32Index = 0; Local_uint32Index < Local_uint32Chunk; Local_uint32Index++)
+				{
+					Local_uint8Rebuilt[Local_uint32Index] = (uint8_t)(Local_uint8Rebuilt[Local_uint32Index] + Copy_puint8Patch[Local_uint32Index]);
+				}
+
+				if(uint8_WriteDeltaTarget(Local_uint8Rebuilt, (uint16_t)Local_uint32Chunk) != HAL_OK)
+				{
+					Local_uint8Status = BL_DELTA_FAILED;
+					break;
+				}
+
+				Local_pDelta->SourceCursor += Local_uint32Chunk;
+			}
+			else if(uint8_WriteDeltaTarget(Copy_puint8Patch, (uint16_t)Local_uint32Chunk) != HAL_OK)
+			{
+				Local_uint8Status = BL_DELTA_FAILED;
+				break;
+			}
+
+			Copy_puint8Patch        += Local_uint32Chunk;
+			Copy_uint16Length       -= (uint16_t)Local_uint32Chunk;
+			Local_pDelta->Remaining -= Local_uint32Chunk;
+			Local_pDelta->Written   += Local_uint32Chunk;
+		}
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * BL_voidHandleMemWriteDeltaCmd
+ * -----------------------------
+ * Applies one packet of a delta patch (see "Delta Write" in BL.h).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               Payload: [flags] [address (4)]
+ *                               [source (4)] [source length (4)] [target length (4)] (START only)
+ *                               [patch bytes].
+ *
+ * Behavior:
+ * ---------
+ * START checks that the source is readable, the target writable and both
+ * disjoint, then opens the stream. Every packet must continue at the next
+ * target address. A compressed stream (BL_DELTA_FLAG_LZ) is decoded in
+ * pieces contiguous in the decoder window, each run through the records
+ * before the next is decoded. Replies [status] [next address (4, LE)]; any
+ * failure closes the stream, the target keeps what was written.
+ */
+void BL_voidHandleMemWriteDeltaCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint16_t Local_uint16PayloadLength = uint16_GetFramePayloadLength(copy_puint8CmdPacket);
+	uint8_t  Local_uint8Flags = Local_puint8Payload[0];
+	uint32_t Local_uint32Address = uint32_GetField(&Local_puint8Payload[1]);
+	uint16_t Local_uint16PatchOffset = 5u;
+	uint8_t  Local_uint8Status = BL_DELTA_OK;
+	BL_DeltaStream_t* Local_pDelta = &Global_DeltaStream;
+	uint8_t  Local_uint8Reply[5];
+#if BL_LZ_ENABLE
+	const uint8_t* Local_puint8Input;
+	uint16_t Local_uint16InputLength;
+	uint8_t* Local_puint8Output;
+	uint16_t Local_uint16OutputLength;
+#endif
+
+	if((Local_uint8Flags & BL_DELTA_FLAG_START) != 0u)
+	{
+		Local_pDelta->State = BL_DELTA_STATE_CLOSED;
+		Local_uint8Status = BL_DELTA_CORRUPT;
+
+		if(Local_uint16PayloadLength >= 17u)
+		{
+			Local_pDelta->Source       = uint32_GetField(&Local_puint8Payload[5]);
+			Local_pDelta->SourceLength = uint32_GetField(&Local_puint8Payload[9]);
+			Local_pDelta->TargetLength = uint32_GetField(&Local_puint8Payload[13]);
+			Local_pDelta->Target       = Local_uint32Address;
+			Local_uint16PatchOffset    = 17u;
+
+			if((pMemory_LookupRegion(Local_pDelta->Source, Local_pDelta->SourceLength, BL_MEMORY_READ) != NULL) &&
+			   (pMemory_LookupRegion(Local_pDelta->Target, Local_pDelta->TargetLength, BL_MEMORY_WRITE) != NULL) &&
+			   (((Local_pDelta->Target + Local_pDelta->TargetLength) <= Local_pDelta->Source) ||
+			    (Local_pDelta->Target >= (Local_pDelta->Source + Local_pDelta->SourceLength))))
+			{
+				Local_pDelta->SourceCursor = 0;
+				Local_pDelta->Written      = 0;
+				Local_pDelta->Remaining    = 0;
+				Local_pDelta->HeaderCount  = 0;
+				Local_pDelta->Held         = 0;
+				Local_pDelta->Flags        = Local_uint8Flags & (BL_DELTA_FLAG_LZ | BL_DELTA_FLAG_THUMB);
+				Local_pDelta->State        = BL_DELTA_STATE_HEADER;
+				Local_uint8Status = BL_DELTA_OK;
+			}
+		}
+
+		if((Local_uint8Status == BL_DELTA_OK) && ((Local_pDelta->Flags & BL_DELTA_FLAG_LZ) != 0u))
+		{
+#if BL_LZ_ENABLE
+			/* The decoder was an LZ write stream's */
+			BL_voidLZStart(&Global_LzStream);
+			Global_uint8LzOpen = 0;
+#if BL_PACKAGE_ENABLE
+			Global_uint8PackageOpen = 0;
+#endif
+#else
+			Local_pDelta->State = BL_DELTA_STATE_CLOSED;
+			Local_uint8Status = BL_DELTA_CORRUPT;
+#endif
+		}
+	}
+	else if((Local_pDelta->State == BL_DELTA_STATE_CLOSED) ||
+	        (Local_uint32Address != (Local_pDelta->Target + Local_pDelta->Written)))
+	{
+		Local_uint8Status = BL_DELTA_SEQUENCE;
+	}
+
+#if BL_LZ_ENABLE
+	if((Local_uint8Status == BL_DELTA_OK) && ((Local_pDelta->Flags & BL_DELTA_FLAG_LZ) != 0u))
+	{
+		Local_puint8Input       = &Local_puint8Payload[Local_uint16PatchOffset];
+		Local_uint16InputLength = Local_uint16PayloadLength - Local_uint16PatchOffset;
+
+		while(Local_uint8Status == BL_DELTA_OK)
+		{
+			if(BL_uint8LZDecode(&Global_LzStream, &Local_puint8Input, &Local_uint16InputLength,
+			                    &Local_puint8Output, &Local_uint16OutputLength) != BL_LZ_OK)
+			{
+				Local_uint8Status = BL_DELTA_CORRUPT;
+			}
+			else if(Local_uint16OutputLength == 0u)
+			{
+				break;
+			}
+			else
+			{
+				Local_uint8Status = uint8_ApplyDelta(Local_puint8Output, Local_uint16OutputLength);
+			}
+		}
+
+		/* The records went through above */
+		Local_uint16PatchOffset = Local_uint16PayloadLength;
+	}
+#endif
+
+	if(Local_uint8Status == BL_DELTA_OK)
+	{
+		Local_uint8Status = uint8_ApplyDelta(&Local_puint8Payload[Local_uint16PatchOffset], Local_uint16PayloadLength - Local_uint16PatchOffset);
+	}
+
+	if((Local_uint8Status == BL_DELTA_OK) && ((Local_uint8Flags & BL_DELTA_FLAG_END) != 0u))
+	{
+		if((Local_pDelta->State != BL_DELTA_STATE_HEADER) || (Local_pDelta->HeaderCount != 0u) ||
+		   (Local_pDelta->Written != Local_pDelta->TargetLength))
+		{
+			Local_uint8Status = BL_DELTA_CORRUPT;
+		}
+
+#if BL_LZ_ENABLE
+		if(((Local_pDelta->Flags & BL_DELTA_FLAG_LZ) != 0u) && (BL_uint8LZIsComplete(&Global_LzStream) == 0u))
+		{
+			Local_uint8Status = BL_DELTA_CORRUPT;
+		}
+#endif
+
+		Local_pDelta->State = BL_DELTA_STATE_CLOSED;
+	}
+
+	if(Local_uint8Status != BL_DELTA_OK)
+	{
+		Local_pDelta->State = BL_DELTA_STATE_CLOSED;
+	}
+
+	Local_uint32Address = Local_pDelta->Target + Local_pDelta->Written;
+	Local_uint8Reply[0] = Local_uint8Status;
+	memcpy(&Local_uint8Reply[1], &Local_uint32Address, 4u);
+
+	voidSendResponse(Local_uint8Reply, 5u);
+}
+#endif
+
+
+#if BL_PACKAGE_ENABLE
+/*
+ * uint8_ErasePackagePlan
+ * ----------------------
+ * Erases the plan of a package manifest (bit n: sector n).
+ *
+ * Behavior:
+ * ---------
+ * Every planned sector goes through uint8_PlanImageErase first, so a
+ * refused (bootloader, running A/B slot) or write-protected sector refuses
+ * the whole plan before anything is erased. The sectors are then erased one
+ * by one through uint8_tExecute_FlashErase, blank ones skipped.
+ *
+ * Return:
+ * -------
+ * HAL_OK, or HAL_ERROR for a refused plan or a failing sector.
+ */
+static uint8_t uint8_ErasePackagePlan(uint32_t Copy_uint32Sectors)
+{
+	uint8_t  Local_uint8Results[NUMBER_OF_SECTORS];
+	uint32_t Local_uint32EstimateMs;
+	uint16_t Local_uint16BlankSectors;
+	uint8_t  Local_uint8Status = HAL_OK;
+	uint8_t  Local_uint8Sector;
+
+	/* The blank map is only current with no erase running and nothing staged */
+	voidFinishEraseJob();
+	uint8_FlushWriteBuffer();
+
+	for(Local_uint8Sector = 0; (Local_uint8Sector < NUMBER_OF_SECTORS) && (Local_uint8Status == HAL_OK); Local_uint8Sector++)
+	{
+		if((Copy_uint32Sectors & (1UL << Local_uint8Sector)) != 0u)
+		{
+			Local_uint8Status = uint8_PlanImageErase(Local_uint8Sector, 1u, Local_uint8Results, &Local_uint32EstimateMs);
+		}
+	}
+
+	/* Turn on LED (LD5) to indicate flash erase is in progress */
+	HAL_GPIO_WritePin(LD5_GPIO_Port, LD5_Pin, GPIO_PIN_SET);
+
+	for(Local_uint8Sector = 0; (Local_uint8Sector < NUMBER_OF_SECTORS) && (Local_uint8Status == HAL_OK); Local_uint8Sector++)
+	{
+		if((Copy_uint32Sectors & (1UL << Local_uint8Sector)) != 0u)
+		{
+			Local_uint8Status = uint8_tExecute_FlashErase(Local_uint8Sector, 1u, &Local_uint16BlankSectors);
+		}
+	}
+
+	/* Turn off LED (LD5) after erase completion */
+	HAL_GPIO_WritePin(LD5_GPIO_Port, LD5_Pin, GPIO_PIN_RESET);
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * BL_voidHandleMemWritePackageCmd
+ * -------------------------------
+ * Takes one packet of an update package (see "Package Write" in BL.h).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               Payload: [flags] [package offset (4)] [package bytes].
+ *
+ * Behavior:
+ * ---------
+ * START (offset 0) restarts the decoder, with the signer's key under
+ * BL_SIGNATURE_ENABLE. The packet bytes are fed to BL_uint8PackageDecode and
+ * its events handled in order: MANIFEST erases the plan
+ * (uint8_ErasePackagePlan), WRITE goes through uint8_WriteRegion, COMPLETE
+ * marks the image validated under BL_SIGNATURE_ENABLE. END requires the
+ * package complete. Replies [status] [next offset (4, LE)]: the offset of
+ * the first byte not consumed; any failure closes the package.
+ */
+void BL_voidHandleMemWritePackageCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	const uint8_t* Local_puint8Input = &Local_puint8Payload[5];
+	uint16_t Local_uint16InputLength = uint16_GetFramePayloadLength(copy_puint8CmdPacket) - 5u;
+	uint16_t Local_uint16Consumed;
+	uint8_t  Local_uint8Flags = Local_puint8Payload[0];
+	uint32_t Local_uint32Offset = uint32_GetField(&Local_puint8Payload[1]);
+	uint8_t  Local_uint8Status = BL_PACKAGE_WRITE_OK;
+	uint8_t  Local_uint8Event;
+	uint32_t Local_uint32Address;
+	uint8_t* Local_puint8Output;
+	uint16_t Local_uint16OutputLength;
+	uint8_t  Local_uint8Reply[5];
+
+	if(((Local_uint8Flags & BL_PACKAGE_FLAG_START) != 0u) && (Local_uint32Offset == 0u))
+	{
+#if BL_SIGNATURE_ENABLE
+		BL_voidPackageStart(&Global_Package, &Global_LzStream, Global_uint8SigningKey);
+#else
+		BL_voidPackageStart(&Global_Package, &Global_LzStream, NULL);
+#endif
+		Global_uint32PackageOffset = 0;
+		Global_uint8PackageOpen = 1;
+
+		/* The LZ decoder was an LZ write or compressed delta stream's */
+		Global_uint8LzOpen = 0;
+#if BL_DELTA_ENABLE
+		if((Global_DeltaStream.Flags & BL_DELTA_FLAG_LZ) != 0u)
+		{
+			Global_DeltaStream.State = BL_DELTA_STATE_CLOSED;
+		}
+#endif
+	}
+
+	if((Global_uint8PackageOpen == 0) || (Local_uint32Offset != Global_uint32PackageOffset))
+	{
+		Local_uint8Status = BL_PACKAGE_WRITE_SEQUENCE;
+	}
+
+	while(Local_uint8Status == BL_PACKAGE_WRITE_OK)
+	{
+		Local_uint16Consumed = Local_uint16InputLength;
+		Local_uint8Event = BL_uint8PackageDecode(&Global_Package, &Local_puint8Input, &Local_uint16InputLength,
+		                                         &Local_uint32Address, &Local_puint8Output, &Local_uint16OutputLength);
+		Global_uint32PackageOffset += (uint16_t)(Local_uint16Consumed - Local_uint16InputLength);
+
+		if(Local_uint8Event == BL_PACKAGE_MORE)
+		{
+			break;
+		}
+		else if(Local_uint8Event == BL_PACKAGE_MANIFEST)
+		{
+			if(uint8_ErasePackagePlan(Global_Package.Header.EraseSectors) != HAL_OK)
+			{
+				Local_uint8Status = BL_PACKAGE_WRITE_FAILED;
+			}
+		}
+		else if(Local_uint8Event == BL_PACKAGE_WRITE)
+		{
+			if(uint8_WriteRegion(Local_puint8Output, Local_uint32Address, Local_uint16OutputLength) != HAL_OK)
+			{
+				Local_uint8Status = BL_PACKAGE_WRITE_FAILED;
+			}
+		}
+		else if(Local_uint8Event == BL_PACKAGE_COMPLETE)
+		{
+#if BL_SIGNATURE_ENABLE
+			/* The signature covered the payload digest that just matched */
+			if((uint8_FlushWriteBuffer() != HAL_OK) || (BL_uint8ImageMarkValidated() != HAL_OK))
+			{
+				Local_uint8Status = BL_PACKAGE_WRITE_FAILED;
+			}
+#endif
+		}
+		else
+		{
+			Local_uint8Status = Local_uint8Event;
+		}
+	}
+
+	if((Local_uint8Status == BL_PACKAGE_WRITE_OK) && ((Local_uint8Flags & BL_PACKAGE_FLAG_END) != 0u))
+	{
+		if(BL_uint8PackageIsComplete(&Global_Package) == 0u)
+		{
+			Local_uint8Status = BL_PACKAGE_WRITE_INCOMPLETE;
+		}
+
+		Global_uint8PackageOpen = 0;
+	}
+
+	if(Local_uint8Status != BL_PACKAGE_WRITE_OK)
+	{
+		Global_uint8PackageOpen = 0;
+	}
+
+	Local_uint8Reply[0] = Local_uint8Status;
+	memcpy(&Local_uint8Reply[1], &Global_uint32PackageOffset, 4u);
+
+	voidSendResponse(Local_uint8Reply, 5u);
+}
+#endif
+
+
+/*
+ * BL_voidHandleMemFillCmd
+ * -----------------------
+ * Fills a memory range with a 32-bit pattern (see "Memory Fill" in BL.h).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               Payload: [address (4)] [length (4)] [pattern (4)].
+ *
+ * Behavior:
+ * ---------
+ * The pattern is repeated once into a BL_FILL_CHUNK_SIZE buffer that is then
+ * written at each step of the range. For an all-ones pattern over flash the
+ * range is blank-checked first (after any staged line and background erase):
+ * when erased the chunks only feed the session hashes, otherwise nothing is
+ * written and the fill fails.
+ * Replies [status] [skipped]: HAL_ERROR for a misaligned, empty or
+ * non-writable range, or the first failing write status.
+ */
+void BL_voidHandleMemFillCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint32_t Local_uint32Address = uint32_GetField(&Local_puint8Payload[0]);
+	uint32_t Local_uint32Length  = uint32_GetField(&Local_puint8Payload[4]);
+	uint32_t Local_uint32Pattern = uint32_GetField(&Local_puint8Payload[8]);
+	uint32_t Local_uint32Total   = Local_uint32Length;
+	uint32_t Local_uint32Chunk[BL_FILL_CHUNK_SIZE / 4u];
+	uint32_t Local_uint32Step;
+	uint8_t  Local_uint8Index;
+	const BL_MemoryRegion_t* Local_pRegion = NULL;
+	uint8_t  Local_uint8Reply[2] = { HAL_ERROR, 0u };
+
+	if(((Local_uint32Address | Local_uint32Length) & 0x3u) == 0u)
+	{
+		Local_pRegion = pMemory_LookupRegion(Local_uint32Address, Local_uint32Length, BL_MEMORY_WRITE);
+	}
+
+	if(Local_pRegion != NULL)
+	{
+		Local_uint8Reply[0] = HAL_OK;
+
+		if((Local_uint32Pattern == 0xFFFFFFFFUL) && (Local_pRegion->Method == BL_MEMORY_METHOD_FLASH))
+		{
+			voidFinishEraseJob();
+			(void)uint8_FlushWriteBuffer();
+
+			if(BL_uint8FlashRangeIsBlank(Local_uint32Address, Local_uint32Length) == BL_FLASH_SECTOR_BLANK)
+			{
+				Local_uint8Reply[1] = 1u;
+			}
+			else
+			{
+				/* Programming cannot set bits back to 1 */
+				Local_uint8Reply[0] = HAL_ERROR;
+			}
+		}
+
+		for(Local_uint8Index = 0; Local_uint8Index < (BL_FILL_CHUNK_SIZE / 4u); Local_uint8Index++)
+		{
+			Local_uint32Chunk[Local_uint8Index] = Local_uint32Pattern;
+		}
+
+		while((Local_uint32Length != 0u) && (Local_uint8Reply[0] == HAL_OK))
+		{
+			Local_uint32Step = (Local_uint32Length < BL_FILL_CHUNK_SIZE) ? Local_uint32Length : BL_FILL_CHUNK_SIZE;
+
+			if(Local_uint8Reply[1] != 0u)
+			{
+				voidTrackImageWrite((const uint8_t*)Local_uint32Chunk, Local_uint32Address, (uint16_t)Local_uint32Step);
+			}
+			else
+			{
+				Local_uint8Reply[0] = uint8_WriteRegion((uint8_t*)Local_uint32Chunk, Local_uint32Address, (uint16_t)Local_uint32Step);
+			}
+
+			Local_uint32Address += Local_uint32Step;
+			Local_uint32Length  -= Local_uint32Step;
+			voidReportProgress(BL_PROGRESS_OP_PROGRAM, BL_uint8FlashGetSector(Local_uint32Address - 1u), Local_uint32Total - Local_uint32Length, Local_uint32Total);
+		}
+
+#if BL_RS485_ENABLE
+		if(Local_uint8Reply[0] == HAL_OK)
+		{
+			BL_voidTransportBroadcastDone();
+		}
+#endif
+	}
+
+	voidSendResponse(Local_uint8Reply, 2u);
+}
+
+
+/*
+ * BL_voidHandleGetBootTimesCmd
+ * ----------------------------
+ * Reports where this boot spent its time (see "Boot Times" in BL.h).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet (no payload).
+ *
+ * Behavior:
+ * ---------
+ * The stamps are read from the handoff block as main left them: in update
+ * mode the clock and decision milestones are set, the later ones still 0.
+ */
+void BL_voidHandleGetBootTimesCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t  Local_uint8Reply[BL_BOOT_TIMES_REPLY_SIZE];
+	uint32_t Local_uint32Stamp;
+	uint8_t  Local_uint8Index;
+
+	(void)copy_puint8CmdPacket;
+
+	Local_uint8Reply[0] = BL_BOOT_STAMPS;
+
+	for(Local_uint8Index = 0; Local_uint8Index < BL_BOOT_STAMPS; Local_uint8Index++)
+	{
+		Local_uint32Stamp = BL_HANDOFF->Stamps[Local_uint8Index];
+		memcpy(&Local_uint8Reply[1u + (4u * Local_uint8Index)], &Local_uint32Stamp, 4u);
+	}
+
+	memcpy(&Local_uint8Reply[1u + (4u * BL_BOOT_STAMPS)], &SystemCoreClock, 4u);
+
+	voidSendResponse(Local_uint8Reply, BL_BOOT_TIMES_REPLY_SIZE);
+}
+
+
+/*
+ * BL_voidHandleRamRunCmd
+ * ----------------------
+ * Starts an image loaded into the RAM run area (see "RAM Run" in BL.h).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               Payload: [vector table address (4)].
+ *
+ * Behavior:
+ * ---------
+ * The table must be 512-byte aligned (VTOR) inside the area, its initial
+ * MSP above it and at most the end of the area, its reset handler a Thumb
+ * address inside the area. A valid start finishes any erase, closes the
+ * session, flushes the reply and leaves through Bootloader_JumpToImage.
+ */
+void BL_voidHandleRamRunCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint32_t Local_uint32Base = uint32_GetField(puint8_GetFramePayload(copy_puint8CmdPacket));
+	uint32_t Local_uint32End  = BL_RAM_RUN_BASE + BL_RAM_RUN_SIZE;
+	uint32_t Local_uint32Stack;
+	uint32_t Local_uint32Reset;
+	uint8_t  Local_uint8Status = BL_RAM_RUN_INVALID;
+
+	if(((Local_uint32Base & 0x1FFu) == 0u) && (Local_uint32Base >= BL_RAM_RUN_BASE) && (Local_uint32Base < Local_uint32End))
+	{
+		Local_uint32Stack = *((const volatile uint32_t*)Local_uint32Base);
+		Local_uint32Reset = *((const volatile uint32_t*)(Local_uint32Base + 4u));
+
+		if((Local_uint32Stack > Local_uint32Base) && (Local_uint32Stack <= Local_uint32End) &&
+		   ((Local_uint32Reset & 1u) != 0u) && (Local_uint32Reset > Local_uint32Base) && (Local_uint32Reset < Local_uint32End))
+		{
+			Local_uint8Status = BL_RAM_RUN_OK;
+		}
+	}
+
+	if(Local_uint8Status == BL_RAM_RUN_OK)
+	{
+		voidFinishEraseJob();
+		voidCloseSession();
+	}
+
+	voidSendResponse(&Local_uint8Status, 1u);
+
+	if(Local_uint8Status == BL_RAM_RUN_OK)
+	{
+		BL_voidTransportTxFlush();
+		Bootloader_JumpToImage(Local_uint32Base);
+	}
+}
+
+
+/*
+ * BL_voidHandleSlotActivateCmd
+ * ----------------------------
+ * Queries or switches the active application slot (see "A/B Slots" in BL.h).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               Payload: [slot (1)], BL_SLOT_QUERY to only read.
+ *
+ * Behavior:
+ * ---------
+ * Before an activation any erase is finished and staged writes reach the
+ * flash, so the image check sees what the host sent. BL_uint8ImageActivate
+ * does the check and the one-word program; with BL_TRIAL_BOOT_ENABLE the
+ * newly active slot then boots on trial. Without BL_AB_SLOTS_ENABLE only
+ * slot A exists, and activating it is a no-op success.
+ */
+void BL_voidHandleSlotActivateCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t  Local_uint8Slot = *puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint8_t  Local_uint8Reply[BL_SLOT_REPLY_SIZE];
+	uint32_t Local_uint32Base;
+
+	Local_uint8Reply[0] = BL_SLOT_OK;
+
+	if(Local_uint8Slot != BL_SLOT_QUERY)
+	{
+		voidFinishEraseJob();
+		uint8_FlushWriteBuffer();
+
+		if(Local_uint8Slot == BL_uint8ImageGetActiveSlot())
+		{
+			/* Already active: no new trial */
+		}
+		else if(BL_uint8ImageActivate(Local_uint8Slot) != HAL_OK)
+		{
+			Local_uint8Reply[0] = BL_SLOT_INVALID;
+		}
+		else
+		{
+#if BL_TRIAL_BOOT_ENABLE
+			Bootloader_TrialStart();
+#endif
+		}
+	}
+
+	Local_uint8Reply[1] = BL_uint8ImageGetActiveSlot();
+	Local_uint32Base    = BL_uint32ImageGetSlotBase(BL_uint8ImageGetUpdateSlot());
+	memcpy(&Local_uint8Reply[2], &Local_uint32Base, 4u);
+
+	voidSendResponse(Local_uint8Reply, BL_SLOT_REPLY_SIZE);
+}
+
+
+/*
+ * BL_voidHandleGetWearStatsCmd
+ * ----------------------------
+ * Handles BL_GET_WEAR_STATS: the erase count of every flash sector, from the
+ * journal totals plus the erases not flushed yet (BL_Journal.h).
+ *
+ * Reply: [status] [count of sector 0 (4)] ... [count of sector 11 (4)]
+ * BL_WEAR_UNAVAILABLE, counts 0, without BL_WEAR_STATS_ENABLE.
+ */
+void BL_voidHandleGetWearStatsCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t  Local_uint8Reply[BL_WEAR_REPLY_SIZE] = { 0u };
+#if BL_WEAR_STATS_ENABLE
+	uint32_t Local_uint32Counts[BL_FLASH_SECTOR_COUNT];
+
+	BL_voidJournalGetWear(Local_uint32Counts);
+	memcpy(&Local_uint8Reply[1], Local_uint32Counts, sizeof(Local_uint32Counts));
+	Local_uint8Reply[0] = BL_WEAR_OK;
+#else
+	Local_uint8Reply[0] = BL_WEAR_UNAVAILABLE;
+#endif
+
+	(void)copy_puint8CmdPacket;
+
+	voidSendResponse(Local_uint8Reply, BL_WEAR_REPLY_SIZE);
+}
+
+
+/*
+ * BL_voidHandleGetStatsCmd
+ * ------------------------
+ * Handles BL_GET_STATS: the link counters, then one entry per opcode
+ * dispatched since reset, the flash timing histograms, the USART2 detail
+ * and the stack and heap marks (BL.h), built straight in the TX buffer. This
+ * command's own dispatch is counted once the reply is built, so it shows in
+ * the next one. With BL_STATS_FLAG_CLEAR every counter restarts from 0.
+ *
+ * Reply: BL_STATS_UNAVAILABLE alone without BL_STATS_ENABLE.
+ */
+void BL_voidHandleGetStatsCmd(uint8_t* copy_puint8CmdPacket)
+{
+#if BL_STATS_ENABLE
+	uint8_t*            Local_puint8Tx = BL_puint8TransportTxAcquire();
+	uint8_t*            Local_puint8Out;
+	BL_TransportStats_t Local_Link;
+	MemoryUsage_t       Local_Memory;
+	uint32_t            Local_uint32RingSize;
+	uint16_t            Local_uint16Length;
+	uint8_t             Local_uint8Entries = 0;
+	uint8_t             Local_uint8Index;
+	uint8_t             Local_uint8Flags = 0;
+
+	if(uint16_GetFramePayloadLength(copy_puint8CmdPacket) >= 1u)
+	{
+		Local_uint8Flags = puint8_GetFramePayload(copy_puint8CmdPacket)[0];
+	}
+
+	for(Local_uint8Index = 0; Local_uint8Index < BL_COMMAND_COUNT; Local_uint8Index++)
+	{
+		if(Global_CommandStats[Local_uint8Index].Count != 0u)
+		{
+			Local_uint8Entries++;
+		}
+	}
+
+	Local_uint16Length = uint8_BuildAckHeader(Local_puint8Tx, (uint16_t)(BL_STATS_HEADER_SIZE + (Local_uint8Entries * BL_STATS_ENTRY_SIZE) +
+	                                                                     BL_STATS_FLASH_SIZE + BL_STATS_UART_SIZE + BL_STATS_MEMORY_SIZE +
+	                                                                     BL_STATS_MASK_SIZE));
+	Local_puint8Out    = &Local_puint8Tx[Local_uint16Length];
+
+	BL_voidTransportGetStats(&Local_Link);
+	Local_puint8Out[0] = BL_STATS_OK;
+	memcpy(&Local_puint8Out[1],  &Local_Link.RxBytes, 4u);
+	memcpy(&Local_puint8Out[5],  &Local_Link.TxBytes, 4u);
+	memcpy(&Local_puint8Out[9],  &Global_uint32CrcFailures, 4u);
+	memcpy(&Local_puint8Out[13], &Local_Link.UartErrors, 4u);
+	memcpy(&Local_puint8Out[17], &SystemCoreClock, 4u);
+	Local_puint8Out[21] = Local_uint8Entries;
+	Local_puint8Out    += BL_STATS_HEADER_SIZE;
+
+	for(Local_uint8Index = 0; Local_uint8Index < BL_COMMAND_COUNT; Local_uint8Index++)
+	{
+		const BL_CommandStats_t* Local_pStats = &Global_CommandStats[Local_uint8Index];
+
+		if(Local_pStats->Count == 0u)
+		{
+			continue;
+		}
+
+		Local_puint8Out[0] = (uint8_t)(BL_COMMAND_BASE + Local_uint8Index);
+		memcpy(&Local_puint8Out[1],  &Local_pStats->Count, 4u);
+		memcpy(&Local_puint8Out[5],  &Local_pStats->TotalCycles, 8u);
+		memcpy(&Local_puint8Out[13], &Local_pStats->MaxCycles, 4u);
+		memcpy(&Local_puint8Out[17], &Local_pStats->Nacks, 4u);
+		Local_puint8Out += BL_STATS_ENTRY_SIZE;
+	}
+
+	/* Flash timing: the histograms are laid out as sent, class by class */
+	Local_puint8Out[0] = BL_FLASH_CLASS_COUNT;
+	Local_puint8Out[1] = BL_FLASH_TIMING_BUCKETS;
+	Local_puint8Out   += 2u;
+	for(Local_uint8Index = 0; Local_uint8Index < BL_FLASH_CLASS_COUNT; Local_uint8Index++)
+	{
+		memcpy(Local_puint8Out, &BL_pFlashGetTiming()->Program[Local_uint8Index], BL_STATS_HISTOGRAM_SIZE);
+		memcpy(&Local_puint8Out[BL_STATS_HISTOGRAM_SIZE], &BL_pFlashGetTiming()->Erase[Local_uint8Index], BL_STATS_HISTOGRAM_SIZE);
+		Local_puint8Out += 2u * BL_STATS_HISTOGRAM_SIZE;
+	}
+
+	Local_uint32RingSize = BL_RX_RING_SIZE;
+	memcpy(&Local_puint8Out[0],  &Local_Link.OverrunErrors, 4u);
+	memcpy(&Local_puint8Out[4],  &Local_Link.FramingErrors, 4u);
+	memcpy(&Local_puint8Out[8],  &Local_Link.NoiseErrors, 4u);
+	memcpy(&Local_puint8Out[12], &Local_Link.ParityErrors, 4u);
+	memcpy(&Local_puint8Out[16], &Local_Link.DmaErrors, 4u);
+	memcpy(&Local_puint8Out[20], &Local_Link.RxRingHighWater, 4u);
+	memcpy(&Local_puint8Out[24], &Local_uint32RingSize, 4u);
+	Local_puint8Out += BL_STATS_UART_SIZE;
+
+	Memory_GetUsage(&Local_Memory);
+	memcpy(&Local_puint8Out[0],  &Local_Memory.StackPeak, 4u);
+	memcpy(&Local_puint8Out[4],  &Local_Memory.StackSize, 4u);
+	memcpy(&Local_puint8Out[8],  &Local_Memory.HeapPeak, 4u);
+	memcpy(&Local_puint8Out[12], &Local_Memory.HeapSize, 4u);
+	Local_puint8Out += BL_STATS_MEMORY_SIZE;
+
+	memcpy(&Local_puint8Out[0],  &BL_PortMaskStats.MaxCycles, 4u);
+	memcpy(&Local_puint8Out[4],  &BL_PortMaskStats.Sections, 4u);
+	Local_puint8Out += BL_STATS_MASK_SIZE;
+
+	if((Local_uint8Flags & BL_STATS_FLAG_CLEAR) != 0u)
+	{
+		memset(Global_CommandStats, 0, sizeof(Global_CommandStats));
+		Global_uint32CrcFailures = 0;
+		BL_voidTransportClearStats();
+		BL_voidFlashClearTiming();
+		BL_PortMaskStats.MaxCycles = 0;
+		BL_PortMaskStats.Sections  = 0;
+	}
+
+	voidStartResponse(Local_puint8Tx, (uint16_t)(Local_puint8Out - Local_puint8Tx));
+#else
+	uint8_t Local_uint8Status = BL_STATS_UNAVAILABLE;
+
+	(void)copy_puint8CmdPacket;
+
+	voidSendResponse(&Local_uint8Status, 1u);
+#endif
+}
+
+
+/*
+ * BL_voidHandleGetTraceCmd
+ * ------------------------
+ * Handles BL_GET_TRACE: the trace events from the requested sequence number
+ * on (all still in the ring without one), as many as one reply holds,
+ * copied straight into the TX buffer (BL_Trace.h). The host asks again from
+ * "first sequence + entries" for the rest.
+ *
+ * Reply: BL_TRACE_UNAVAILABLE alone without BL_TRACE_ENABLE.
+ */
+void BL_voidHandleGetTraceCmd(uint8_t* copy_puint8CmdPacket)
+{
+#if BL_TRACE_ENABLE
+	uint8_t* Local_puint8Tx   = BL_puint8TransportTxAcquire();
+	uint8_t* Local_puint8Out;
+	uint32_t Local_uint32From = 0;
+	uint32_t Local_uint32Head = BL_uint32TraceHead();
+	uint16_t Local_uint16Depth = BL_TRACE_DEPTH;
+	uint16_t Local_uint16Count;
+	uint16_t Local_uint16Length;
+
+	if(uint16_GetFramePayloadLength(copy_puint8CmdPacket) >= 4u)
+	{
+		Local_uint32From = uint32_GetField(puint8_GetFramePayload(copy_puint8CmdPacket));
+	}
+
+	/* Copied behind the longest header; moved down when the short one is enough */
+	Local_puint8Out    = &Local_puint8Tx[4];
+	Local_uint16Count  = BL_uint16TraceRead(&Local_uint32From, &Local_puint8Out[BL_TRACE_HEADER_SIZE],
+	                                        (uint16_t)((BL_MAX_PAYLOAD_LENGTH - BL_TRACE_HEADER_SIZE) / BL_TRACE_ENTRY_SIZE));
+
+	Local_puint8Out[0] = BL_TRACE_OK;
+	memcpy(&Local_puint8Out[1],  &Local_uint32Head, 4u);
+	memcpy(&Local_puint8Out[5],  &Local_uint16Depth, 2u);
+	memcpy(&Local_puint8Out[7],  &SystemCoreClock, 4u);
+	memcpy(&Local_puint8Out[11], &Local_uint16Count, 2u);
+	memcpy(&Local_puint8Out[13], &Local_uint32From, 4u);
+
+	Local_uint16Count  = (uint16_t)(BL_TRACE_HEADER_SIZE + (Local_uint16Count * BL_TRACE_ENTRY_SIZE));
+	Local_uint16Length = uint8_BuildAckHeader(Local_puint8Tx, Local_uint16Count);
+	if(Local_uint16Length != 4u)
+	{
+		memmove(&Local_puint8Tx[Local_uint16Length], &Local_puint8Tx[4], Local_uint16Count);
+	}
+
+	voidStartResponse(Local_puint8Tx, (uint16_t)(Local_uint16Length + Local_uint16Count));
+#else
+	uint8_t Local_uint8Status = BL_TRACE_UNAVAILABLE;
+
+	(void)copy_puint8CmdPacket;
+
+	voidSendResponse(&Local_uint8Status, 1u);
+#endif
+}
+
+
+/*
+ * BL_voidHandleBroadcastStatusCmd
+ * -------------------------------
+ * Handles BL_BROADCAST_STATUS: which RS-485 broadcast writes this node is
+ * missing (see "Broadcast Status" in BL.h), built straight in the TX buffer.
+ * The host resends those sequence numbers to this node alone.
+ *
+ * Reply: BL_BROADCAST_UNAVAILABLE alone without BL_RS485_ENABLE.
+ */
+void BL_voidHandleBroadcastStatusCmd(uint8_t* copy_puint8CmdPacket)
+{
+#if BL_RS485_ENABLE
+	uint8_t* Local_puint8Tx = BL_puint8TransportTxAcquire();
+	uint8_t  Local_uint8Bitmap[BL_RS485_SEQUENCE_COUNT / 8u];
+	uint16_t Local_uint16End;
+	uint16_t Local_uint16Done;
+	uint16_t Local_uint16BitmapLength;
+	uint16_t Local_uint16Length;
+	uint8_t  Local_uint8Flags = 0;
+
+	if(uint16_GetFramePayloadLength(copy_puint8CmdPacket) >= 1u)
+	{
+		Local_uint8Flags = puint8_GetFramePayload(copy_puint8CmdPacket)[0];
+	}
+
+	Local_uint16End          = BL_uint16TransportBroadcastMissing(Local_uint8Bitmap, &Local_uint16Done);
+	Local_uint16BitmapLength = (uint16_t)((Local_uint16End + 7u) / 8u);
+	Local_uint16Length       = uint8_BuildAckHeader(Local_puint8Tx, (uint16_t)(BL_BROADCAST_HEADER_SIZE + Local_uint16BitmapLength));
+
+	Local_puint8Tx[Local_uint16Length]      = BL_BROADCAST_OK;
+	Local_puint8Tx[Local_uint16Length + 1u] = BL_RS485_NODE_ADDRESS;
+	memcpy(&Local_puint8Tx[Local_uint16Length + 2u], &Local_uint16End, 2u);
+	memcpy(&Local_puint8Tx[Local_uint16Length + 4u], &Local_uint16Done, 2u);
+	memcpy(&Local_puint8Tx[Local_uint16Length + BL_BROADCAST_HEADER_SIZE], Local_uint8Bitmap, Local_uint16BitmapLength);
+	Local_uint16Length = (uint16_t)(Local_uint16Length + BL_BROADCAST_HEADER_SIZE + Local_uint16BitmapLength);
+
+	if((Local_uint8Flags & BL_BROADCAST_FLAG_CLEAR) != 0u)
+	{
+		BL_voidTransportBroadcastClear();
+	}
+
+	voidStartResponse(Local_puint8Tx, Local_uint16Length);
+#else
+	uint8_t Local_uint8Status = BL_BROADCAST_UNAVAILABLE;
+
+	(void)copy_puint8CmdPacket;
+
+	voidSendResponse(&Local_uint8Status, 1u);
+#endif
+}
+
+
+/*
+ * BL_voidHandleGetCrashRecordCmd
+ * ------------------------------
+ * Handles BL_GET_CRASH_RECORD: the fault record the fault handlers leave in
+ * backup SRAM (see "Crash Record" in BL.h), checked like the handoff block.
+ *
+ * Reply: [BL_CRASH_OK] [record], or BL_CRASH_NONE alone.
+ */
+void BL_voidHandleGetCrashRecordCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t  Local_uint8Reply[1u + sizeof(BL_CrashRecord_t)];
+	uint32_t Local_uint32Words[BL_CRASH_RECORD_WORDS];
+	uint32_t Local_uint32Check = 0u;
+	uint32_t Local_uint32Index;
+	uint16_t Local_uint16ReplyLength = 1u;
+	uint8_t  Local_uint8Flags = 0;
+
+	if(uint16_GetFramePayloadLength(copy_puint8CmdPacket) >= 1u)
+	{
+		Local_uint8Flags = puint8_GetFramePayload(copy_puint8CmdPacket)[0];
+	}
+
+	voidEnableBackupSram();
+
+	for(Local_uint32Index = 0u; Local_uint32Index < BL_CRASH_RECORD_WORDS; Local_uint32Index++)
+	{
+		Local_uint32Words[Local_uint32Index] = ((volatile uint32_t*)BL_CRASH_RECORD)[Local_uint32Index];
+		Local_uint32Check ^= Local_uint32Words[Local_uint32Index];
+	}
+
+	Local_uint8Reply[0] = BL_CRASH_NONE;
+	if((Local_uint32Words[0] == BL_CRASH_MAGIC) && (Local_uint32Check == 0xFFFFFFFFUL))
+	{
+		Local_uint8Reply[0] = BL_CRASH_OK;
+		memcpy(&Local_uint8Reply[1], Local_uint32Words, sizeof(BL_CrashRecord_t));
+		Local_uint16ReplyLength = (uint16_t)(1u + sizeof(BL_CrashRecord_t));
+	}
+
+	if((Local_uint8Flags & BL_CRASH_FLAG_CLEAR) != 0u)
+	{
+		BL_CRASH_RECORD->Magic = 0u;
+	}
+
+	voidSendResponse(Local_uint8Reply, Local_uint16ReplyLength);
+}
+
+
+/*
+ * BL_voidHandleEraseForImageCmd
+ * -----------------------------
+ * Handles BL_ERASE_FOR_IMAGE: erases what an image range needs, nothing more
+ * (see "Erase For Image" in BL.h).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               - Bytes [0..3] : Start address of the image (little endian).
+ *                               - Bytes [4..7] : Image length in bytes (little endian).
+ *                               - Byte [8]     : Flags (optional, BL_ERASE_IMAGE_FLAG_DRY_RUN).
+ *
+ * Behavior:
+ * ---------
+ * 1. The range is planned first (uint8_PlanImageErase): a refused or
+ *    protected sector refuses the whole request before anything is erased.
+ * 2. When some sector holds data and the dry-run flag is clear, the range is
+ *    erased (uint8_ExecutePlannedErase, blank sectors skipped) and the results
+ *    replaced by the erase outcome.
+ *
+ * Reply: [status] [BL_ERASE_METHOD_xxx] [estimated ms (4)] [12 x BL_ERASE_SECTOR_xxx].
+ */
+void BL_voidHandleEraseForImageCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t  Local_uint8Reply[BL_ERASE_IMAGE_REPLY_SIZE];
+	uint8_t* Local_puint8Results = &Local_uint8Reply[6];
+	uint32_t Local_uint32EstimateMs = 0u;
+	uint8_t  Local_uint8Method = BL_ERASE_METHOD_SKIP;
+	uint8_t  Local_uint8Status = HAL_ERROR;
+	uint8_t  Local_uint8Flags = 0;
+	uint8_t  Local_uint8FirstSector;
+	uint8_t  Local_uint8LastSector;
+
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint16_t Local_uint16PayloadLength = uint16_GetFramePayloadLength(copy_puint8CmdPacket);
+
+	uint32_t Local_uint32Address = uint32_GetField(&Local_puint8Payload[0]);
+	uint32_t Local_uint32Length  = uint32_GetField(&Local_puint8Payload[4]);
+
+	memset(Local_puint8Results, BL_ERASE_SECTOR_UNTOUCHED, NUMBER_OF_SECTORS);
+
+	if(Local_uint16PayloadLength >= 9u)
+	{
+		Local_uint8Flags = Local_puint8Payload[8];
+	}
+
+	if((Local_uint32Length != 0u) && (Local_uint32Length <= (FLASH_END - Local_uint32Address + 1u)))
+	{
+		Local_uint8FirstSector = BL_uint8FlashGetSector(Local_uint32Address);
+		Local_uint8LastSector  = BL_uint8FlashGetSector(Local_uint32Address + Local_uint32Length - 1u);
+
+		if((Local_uint8FirstSector != BL_FLASH_INVALID_SECTOR) && (Local_uint8LastSector != BL_FLASH_INVALID_SECTOR))
+		{
+			/* The blank map is only current with no erase running and nothing staged */
+			voidFinishEraseJob();
+			uint8_FlushWriteBuffer();
+
+			Local_uint8Status = uint8_PlanImageErase(Local_uint8FirstSector, (uint8_t)(Local_uint8LastSector - Local_uint8FirstSector + 1u),
+			                                         Local_puint8Results, &Local_uint32EstimateMs);
+
+			if(memchr(Local_puint8Results, BL_ERASE_SECTOR_PLANNED, NUMBER_OF_SECTORS) != NULL)
+			{
+				Local_uint8Method = BL_ERASE_METHOD_SECTORS;
+			}
+
+			if((Local_uint8Status == HAL_OK) && (Local_uint8Method == BL_ERASE_METHOD_SECTORS) &&
+			   ((Local_uint8Flags & BL_ERASE_IMAGE_FLAG_DRY_RUN) == 0u))
+			{
+				/* Turn on LED (LD5) to indicate flash erase is in progress */
+				HAL_GPIO_WritePin(LD5_GPIO_Port, LD5_Pin, GPIO_PIN_SET);
+
+				Local_uint8Status = uint8_ExecutePlannedErase(Local_uint8FirstSector, (uint8_t)(Local_uint8LastSector - Local_uint8FirstSector + 1u),
+				                                              Local_puint8Results);
+
+				/* Turn off LED (LD5) after erase completion */
+				HAL_GPIO_WritePin(LD5_GPIO_Port, LD5_Pin, GPIO_PIN_RESET);
+			}
+		}
+	}
+
+	Local_uint8Reply[0] = Local_uint8Status;
+	Local_uint8Reply[1] = Local_uint8Method;
+	memcpy(&Local_uint8Reply[2], &Local_uint32EstimateMs, 4u);
+
+	voidSendResponse(Local_uint8Reply, BL_ERASE_IMAGE_REPLY_SIZE);
+}
+
+
+#if BL_TRANSPORT_CAN_ENABLE || BL_RS485_ENABLE
+/*
+ * uint32_GetUidBits
+ * -----------------
+ * Copy_uint8Count (0 .. 25) bits of the unique ID from bit Copy_uint8First
+ * on, MSB first ("Node Discovery" in BL.h), right-aligned; bits past the
+ * 96th read as 0.
+ */
+static uint32_t uint32_GetUidBits(const uint8_t* Copy_puint8Uid, uint8_t Copy_uint8First, uint8_t Copy_uint8Count)
+{
+	uint32_t Local_uint32Bits = 0u;
+	uint8_t  Local_uint8Index;
+	uint8_t  Local_uint8Bit;
+
+	for(Local_uint8Index = 0u; Local_uint8Index < Copy_uint8Count; Local_uint8Index++)
+	{
+		Local_uint8Bit = (uint8_t)(Copy_uint8First + Local_uint8Index);
+		Local_uint32Bits <<= 1;
+
+		if(Local_uint8Bit < BL_DISCOVER_UID_BITS)
+		{
+			Local_uint32Bits |= (uint32_t)(Copy_puint8Uid[Local_uint8Bit >> 3] >> (7u - (Local_uint8Bit & 7u))) & 1u;
+		}
+	}
+
+	return Local_uint32Bits;
+}
+
+
+/*
+ * uint32_GetNextUidBits
+ * ---------------------
+ * The Copy_uint8Width bits after a Copy_uint8Bits-bit prefix, left-aligned
+ * in Copy_uint8Width bits when fewer are left.
+ */
+static uint32_t uint32_GetNextUidBits(const uint8_t* Copy_puint8Uid, uint8_t Copy_uint8Bits, uint8_t Copy_uint8Width)
+{
+	uint8_t Local_uint8Count = (uint8_t)(BL_DISCOVER_UID_BITS - Copy_uint8Bits);
+
+	if(Local_uint8Count > Copy_uint8Width)
+	{
+		Local_uint8Count = Copy_uint8Width;
+	}
+
+	return uint32_GetUidBits(Copy_puint8Uid, Copy_uint8Bits, Local_uint8Count) << (Copy_uint8Width - Local_uint8Count);
+}
+#endif
+
+
+/*
+ * uint8_UidMatches
+ * ----------------
+ * 1 when the first Copy_uint8Bits bits of the unique ID equal the prefix's.
+ */
+static uint8_t uint8_UidMatches(const uint8_t* Copy_puint8Uid, const uint8_t* Copy_puint8Prefix, uint8_t Copy_uint8Bits)
+{
+	uint8_t Local_uint8Bytes = (uint8_t)(Copy_uint8Bits >> 3);
+	uint8_t Local_uint8Mask  = (uint8_t)(0xFFu << (8u - (Copy_uint8Bits & 7u)));
+	uint8_t Local_uint8Match = 0u;
+
+	if(Copy_uint8Bits <= BL_DISCOVER_UID_BITS)
+	{
+		Local_uint8Match = (memcmp(Copy_puint8Uid, Copy_puint8Prefix, Local_uint8Bytes) == 0) ? 1u : 0u;
+
+		if(((Copy_uint8Bits & 7u) != 0u) && (((Copy_puint8Uid[Local_uint8Bytes] ^ Copy_puint8Prefix[Local_uint8Bytes]) & Local_uint8Mask) != 0u))
+		{
+			Local_uint8Match = 0u;
+		}
+	}
+
+	return Local_uint8Match;
+}
+
+
+/*
+ * BL_voidHandleDiscoverCmd
+ * ------------------------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               - Byte [0]      : Prefix length in bits (0 .. 96).
+ *                               - Bytes [1..12] : Prefix, unique ID bit order (bits past the length ignored).
  *
- * **Parameters:**
- * ---------------
- * @param copy_puint8CmdPacket : Pointer to the received command packet containing:
- *        - Command length
- *        - Target address
- *        - CRC for verification
+ * Behavior:
+ * ---------
+ * - On the CAN group identifier a matching node sends one discovery frame
+ *   (BL_voidCANSendDiscovery) with the next BL_DISCOVER_CAN_BITS bits of its
+ *   ID, carrying the node and group identifiers once these complete it.
+ * - On an RS-485 broadcast a matching node sends the reply in the time slot of
+ *   its next BL_DISCOVER_SLOT_BITS bits (BL_voidTransportRs485SendSlot).
+ * - Elsewhere the node answers, matching or not.
  *
- * **Behavior:**
- * ------------
- * 1. Extracts the command length from the packet.
- * 2. Extracts and verifies the CRC to ensure data integrity.
- * 3. If the CRC is valid:
- *    - Sends an ACK response to the Host.
- *    - Extracts the target memory address from the command packet.
- *    - Validates if the address falls within the permissible memory regions.
- *    - If valid:
- *        - Sends confirmation to the Host.
- *        - Jumps to the specified address by updating the Program Counter (PC).
- *    - If invalid:
- *        - Sends a NACK response to indicate failure.
- * 4. If the CRC check fails, a NACK is sent immediately.
+ * Reply: [status] [unique ID (12)] [node address].
  */
-void BL_voidHandleGoToAddressCmd(uint8_t* copy_puint8CmdPacket)
+void BL_voidHandleDiscoverCmd(uint8_t* copy_puint8CmdPacket)
 {
-    uint8_t Local_uint8CRCStatus;
-    uint8_t Local_uint8CmdLen;       /* Variable to store command length */
-    uint32_t Local_uint32HostCRC;    /* Variable to store CRC received from Host */
-
-    /* Extract command length (first byte includes "Length to follow") */
-    Local_uint8CmdLen = copy_puint8CmdPacket[0] + 1;
-
-    /* Extract CRC from the last 4 bytes of the received packet */
-    Local_uint32HostCRC = *((uint32_t*)(copy_puint8CmdPacket + Local_uint8CmdLen - 4));
+	uint8_t  Local_uint8Reply[BL_DISCOVER_REPLY_SIZE];
+	uint32_t Local_uint32Uid[3];
+	uint8_t* Local_puint8Uid = &Local_uint8Reply[1];
+	uint8_t  Local_uint8Address = 0u;
+	uint8_t  Local_uint8Direct = 1u;
+	uint8_t  Local_uint8Match;
+
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint8_t  Local_uint8Bits = Local_puint8Payload[0];
+
+	/* Word reads of the ID, little endian: the bytes land in address order */
+	Local_uint32Uid[0] = *((const volatile uint32_t*)(UID_BASE + 0u));
+	Local_uint32Uid[1] = *((const volatile uint32_t*)(UID_BASE + 4u));
+	Local_uint32Uid[2] = *((const volatile uint32_t*)(UID_BASE + 8u));
+	memcpy(Local_puint8Uid, Local_uint32Uid, 12u);
+
+	Local_uint8Match = uint8_UidMatches(Local_puint8Uid, &Local_puint8Payload[1], Local_uint8Bits);
+
+#if BL_TRANSPORT_CAN_ENABLE
+	if((BL_uint8TransportGetLink() == BL_LINK_CAN) || (BL_uint8TransportGetLink() == BL_LINK_CAN_GROUP))
+	{
+		Local_uint8Address = BL_CAN_NODE_ID;
+	}
+#endif
+#if BL_RS485_ENABLE
+	if(BL_uint8TransportGetLink() == BL_LINK_UART)
+	{
+		Local_uint8Address = BL_RS485_NODE_ADDRESS;
+	}
+#endif
 
-    /* Verify CRC of the received command */
-    Local_uint8CRCStatus = uint8VerifyCRC(copy_puint8CmdPacket, (Local_uint8CmdLen - 4), Local_uint32HostCRC);
+	Local_uint8Reply[0] = (Local_uint8Match != 0u) ? BL_DISCOVER_OK : BL_DISCOVER_NO_MATCH;
+	Local_uint8Reply[13] = Local_uint8Address;
 
-    if (Local_uint8CRCStatus == CRC_SUCCESS)
-    {
-        uint32_t Local_uint32Address;
-        uint8_t Local_uint8AddressValidStatus;
+#if BL_TRANSPORT_CAN_ENABLE
+	if(BL_uint8TransportGetLink() == BL_LINK_CAN_GROUP)
+	{
+		Local_uint8Direct = 0u;
 
-        /* Send ACK with the length of the response payload (4 byte for address validation result) */
-        voidSendACK(4u);
+		if(Local_uint8Match != 0u)
+		{
+			uint8_t Local_uint8Ids[2] = { BL_CAN_NODE_ID, BL_CAN_GROUP_ID };
 
-        /* Extract the target address from the command packet */
-        Local_uint32Address = *((uint32_t*)&copy_puint8CmdPacket[2]);
+			BL_voidCANSendDiscovery(uint32_GetNextUidBits(Local_puint8Uid, Local_uint8Bits, BL_DISCOVER_CAN_BITS), Local_uint8Ids,
+			                        ((Local_uint8Bits + BL_DISCOVER_CAN_BITS) >= BL_DISCOVER_UID_BITS) ? 2u : 0u);
+		}
+	}
+#endif
+#if BL_RS485_ENABLE
+	if(BL_uint8TransportIsBroadcast() != 0u)
+	{
+		Local_uint8Direct = 0u;
 
-        /* Validate if the extracted address falls within Flash or SRAM */
-        Local_uint8AddressValidStatus = uint8_ValidateAddress(Local_uint32Address);
+		if(Local_uint8Match != 0u)
+		{
+			uint8_t* Local_puint8Tx = BL_puint8TransportTxAcquire();
+			uint16_t Local_uint16Length = uint8_BuildAckHeader(Local_puint8Tx, BL_DISCOVER_REPLY_SIZE);
 
-        if (Local_uint8AddressValidStatus == VALID_ADDRESS)
-        {
-            /* Notify the Host that the address is valid */
-            HAL_UART_Transmit(&huart2, &Local_uint8AddressValidStatus, 1, HAL_MAX_DELAY);
+			memcpy(&Local_puint8Tx[Local_uint16Length], Local_uint8Reply, BL_DISCOVER_REPLY_SIZE);
+			Local_uint16Length = uint16_FinishResponse(Local_puint8Tx, (uint16_t)(Local_uint16Length + BL_DISCOVER_REPLY_SIZE));
 
-            /*
-             * Jump to the specified address:
-             * - Define a pointer to function.
-             * - Increment address by 1 to ensure Thumb mode (T-bit = 1).
-             * - Cast address to function pointer and execute.
-             */
-            void (*Local_pvFuncPtr)(void) = NULL;
-            Local_uint32Address|=0x1;  /* Set T-bit for ARM Cortex-M Thumb mode */
-            Local_pvFuncPtr = (void*)Local_uint32Address;
-            Local_pvFuncPtr();  /* Jump to the specified address */
+			BL_voidTransportRs485SendSlot((uint8_t)uint32_GetNextUidBits(Local_puint8Uid, Local_uint8Bits, BL_DISCOVER_SLOT_BITS),
+			                              Local_uint16Length);
+		}
+	}
+#endif
 
-            /* Same to __asm volatile("MSR PC ,%0"::"r"(Local_uint32Address+1));
-             * */
-        }
-        else
-        {
-        	/* Notify the Host that the address is Invalid */
-          HAL_UART_Transmit(&huart2, &Local_uint8AddressValidStatus, 1, HAL_MAX_DELAY);
-        }
-    }
-    else
-    {
-        /* Send NACK if CRC verification fails */
-        voidSendNACK();
-    }
+	if(Local_uint8Direct != 0u)
+	{
+		voidSendResponse(Local_uint8Reply, BL_DISCOVER_REPLY_SIZE);
+	}
 }
 
 
+#if BL_SELF_UPDATE_ENABLE
 /*
- * BL_voidHandleFlashEraseCmd
+ * BL_voidHandleSelfUpdateCmd
  * --------------------------
- * Handles the flash erase command received from the host.
- * This function extracts and verifies the command data, performs the requested erase operation,
- * and returns the erase status.
+ * Replaces the bootloader with an image staged in the application flash
+ * (see "Self Update" in BL.h).
  *
  * Parameters:
  * -----------
  * @param copy_puint8CmdPacket : Pointer to the received command packet.
- *                               The expected packet structure:
- *                               - Byte [0]  : Command length (excluding itself).
- *                               - Byte [1]  : Command identifier.
- *                               - Byte [2]  : Sector number to erase (or `MASS_ERASE` for full erase).
- *                               - Byte [3]  : Number of sectors to erase.
- *                               - Last 4 bytes: CRC checksum for validation.
+ *                               Payload: [source (4)] [length (4)] [SHA-256 (32)],
+ *                               [signature (64)] with BL_SIGNATURE_ENABLE.
  *
  * Behavior:
  * ---------
- * 1. Extracts the command length and CRC from the received packet.
- * 2. Performs CRC verification to ensure data integrity.
- * 3. If CRC is valid:
- *    - Sends an ACK to indicate a valid command.
- *    - Turns on an LED (LD5) to indicate an erase operation in progress.
- *    - Calls `uint8_tExecute_FlashErase()` to perform the erase.
- *    - Turns off the LED (LD5) after completion.
- *    - Sends the erase status back to the host.
- * 4. If CRC verification fails, sends a NACK to the host.
- *
- * Return:
- * -------
- * - No return value (void), but the function sends feedback to the host via UART.
+ * - The source is word-aligned from BL_IMAGE_BASE_ADDRESS on, the image
+ *   inside the flash, 8 bytes up to the bootloader sectors, a whole number
+ *   of words.
+ * - Its vector table must hold an initial MSP in SRAM / CCMRAM and a Thumb
+ *   reset handler inside the image once it sits at FLASH_BASE.
+ * - The staged bytes must hash to the SHA-256 given, signed by the update
+ *   signer with BL_SIGNATURE_ENABLE, and sectors 0 and 1 must not be write
+ *   protected.
+ * - Accepted: any erase is finished, the session closed and the reply
+ *   flushed, then BL_voidFlashReplaceBootloader takes over for good.
  */
-void BL_voidHandleFlashEraseCmd(uint8_t* copy_puint8CmdPacket)
+void BL_voidHandleSelfUpdateCmd(uint8_t* copy_puint8CmdPacket)
 {
-	uint8_t Local_uint8CRCStatus;
-	uint8_t Local_uint8CmdLen; // this variable to extract command length
-	uint32_t Local_uint32HostCRC; // this variable to extract host CRC
-
-	/* Extract command length (first byte includes "Length to follow") */
-	Local_uint8CmdLen = copy_puint8CmdPacket[0] + 1;
-
-	/* Extract CRC from the last 4 bytes of the received packet */
-	Local_uint32HostCRC = *((uint32_t*)(copy_puint8CmdPacket + Local_uint8CmdLen - 4));
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint32_t Local_uint32Source  = uint32_GetField(&Local_puint8Payload[0]);
+	uint32_t Local_uint32Length  = uint32_GetField(&Local_puint8Payload[4]);
+	uint32_t Local_uint32Limit   = BL_IMAGE_BASE_ADDRESS - FLASH_BASE;
+	uint32_t Local_uint32Stack;
+	uint32_t Local_uint32Reset;
+	uint8_t  Local_uint8Digest[BL_SHA256_DIGEST_SIZE];
+	uint8_t  Local_uint8Status = BL_SELF_UPDATE_INVALID;
+
+	if(((Local_uint32Source & 0x3u) == 0u) && ((Local_uint32Length & 0x3u) == 0u) &&
+	   (Local_uint32Length >= 8u) && (Local_uint32Length <= Local_uint32Limit) &&
+	   (Local_uint32Source >= BL_IMAGE_BASE_ADDRESS) && (Local_uint32Source <= ((FLASH_END + 1u) - Local_uint32Length)))
+	{
+		Local_uint32Stack = *((const volatile uint32_t*)Local_uint32Source);
+		Local_uint32Reset = *((const volatile uint32_t*)(Local_uint32Source + 4u));
 
-	/* Verify CRC of the received command */
-	Local_uint8CRCStatus = uint8VerifyCRC(copy_puint8CmdPacket, (Local_uint8CmdLen - 4), Local_uint32HostCRC);
+		if(((Local_uint32Stack & 0x3u) == 0u) &&
+		   (((Local_uint32Stack > CCMDATARAM_BASE) && (Local_uint32Stack <= (CCMDATARAM_END + 1u))) ||
+		    ((Local_uint32Stack > SRAM1_BASE) && (Local_uint32Stack <= (SRAM2_BASE + (16u * 1024u))))) &&
+		   ((Local_uint32Reset & 1u) != 0u) && (Local_uint32Reset > FLASH_BASE) && (Local_uint32Reset < (FLASH_BASE + Local_uint32Length)))
+		{
+			Local_uint8Status = BL_SELF_UPDATE_DIGEST;
+		}
+	}
 
-	if(Local_uint8CRCStatus == CRC_SUCCESS)
+	if(Local_uint8Status == BL_SELF_UPDATE_DIGEST)
 	{
-		uint8_t Local_uint8EraseStatus ;
-		/* Send ACK with the length of the response payload (1 byte for erase status) */
-		 voidSendACK(1u);
+		BL_voidSHA256Calculate((const uint8_t*)Local_uint32Source, Local_uint32Length, Local_uint8Digest);
 
-		 /* Turn on LED (LD5) to indicate flash erase is in progress */
-		 HAL_GPIO_WritePin(LD5_GPIO_Port, LD5_Pin, GPIO_PIN_SET) ;
+		if(memcmp(Local_uint8Digest, &Local_puint8Payload[8], BL_SHA256_DIGEST_SIZE) == 0)
+		{
+			Local_uint8Status = BL_SELF_UPDATE_OK;
+		}
+	}
 
-		 /* Execute flash erase */
-		 Local_uint8EraseStatus =  uint8_tExecute_FlashErase(copy_puint8CmdPacket[2] ,copy_puint8CmdPacket[3]) ;
+#if BL_SIGNATURE_ENABLE
+	if((Local_uint8Status == BL_SELF_UPDATE_OK) &&
+	   ((uint16_GetFramePayloadLength(copy_puint8CmdPacket) < (8u + BL_SHA256_DIGEST_SIZE + BL_P256_SIGNATURE_SIZE)) ||
+	    (BL_uint8P256Verify(Global_uint8SigningKey, Local_uint8Digest,
+	                        &Local_puint8Payload[8u + BL_SHA256_DIGEST_SIZE]) != BL_P256_SIGNATURE_VALID)))
+	{
+		Local_uint8Status = BL_SELF_UPDATE_SIGNATURE;
+	}
+#endif
 
-		 /* Turn off LED (LD5) after erase completion */
-		 HAL_GPIO_WritePin(LD5_GPIO_Port, LD5_Pin, GPIO_PIN_RESET) ;
+	if((Local_uint8Status == BL_SELF_UPDATE_OK) && ((uint16_ReadWriteProtection() & ((1u << BL_FLASH_BOOTLOADER_SECTORS) - 1u)) != 0u))
+	{
+		Local_uint8Status = BL_SELF_UPDATE_PROTECTED;
+	}
 
-		 /* Send the erase status to the host */
-		 HAL_UART_Transmit(&huart2, &Local_uint8EraseStatus, 1, HAL_MAX_DELAY) ;
+	if(Local_uint8Status == BL_SELF_UPDATE_OK)
+	{
+		voidFinishEraseJob();
+		voidCloseSession();
+	}
 
+	voidSendResponse(&Local_uint8Status, 1u);
 
-	}
-	else
+	if(Local_uint8Status == BL_SELF_UPDATE_OK)
 	{
-		/* Send NACK if CRC verification fails */
-		voidSendNACK();
+		BL_voidTransportTxFlush();
+		BL_voidFlashReplaceBootloader(Local_uint32Source, Local_uint32Length);
 	}
 }
+#endif
 
-void BL_voidHandleMemWriteCmd(uint8_t* copy_puint8CmdPacket)
-{
-	uint8_t Local_uint8CRCStatus;
-	uint8_t Local_uint8CmdLen; // this variable to extract command length
-	uint32_t Local_uint32HostCRC; // this variable to extract host CRC
-
-	/* Extract command length (first byte includes "Length to follow") */
-	Local_uint8CmdLen = copy_puint8CmdPacket[0] + 1;
-
-	/* Extract CRC from the last 4 bytes of the received packet */
-	Local_uint32HostCRC = *((uint32_t*)(copy_puint8CmdPacket + Local_uint8CmdLen - 4));
 
-	/* Verify CRC of the received command */
-	Local_uint8CRCStatus = uint8VerifyCRC(copy_puint8CmdPacket, (Local_uint8CmdLen - 4), Local_uint32HostCRC);
+/*
+ * BL_voidHandleResetAndBootCmd
+ * ----------------------------
+ * Leaves update mode (see "Reset And Boot" in BL.h).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               Payload: [mode (1)].
+ *
+ * Behavior:
+ * ---------
+ * The erase and the session end first, so the image check sees every write
+ * the host made. A handoff the boot path would not have taken either
+ * (Bootloader_HandoffAllowed) becomes a reset; a reset needs no check, the
+ * boot after it decides. Either way the reply is on the line before
+ * Bootloader_LeaveUpdateMode, which does not return.
+ */
+void BL_voidHandleResetAndBootCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t Local_uint8Mode   = *puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint8_t Local_uint8Status = BL_RESET_BOOT_INVALID;
 
-	if(Local_uint8CRCStatus == CRC_SUCCESS)
+	if((Local_uint8Mode == BL_RESET_BOOT_MODE_HANDOFF) || (Local_uint8Mode == BL_RESET_BOOT_MODE_RESET))
 	{
-         uint8_t Local_uint8WritingStatus ;
-
-		/*Extract the base memory address from command */
-		uint32_t Local_uint32Address = *((uint32_t*)&copy_puint8CmdPacket[2]);
-
-		 /* Validate if the extracted address falls within Flash or SRAM */
-		uint8_t Local_uint8AddressValidStatus = uint8_ValidateAddress(Local_uint32Address);
+		voidFinishEraseJob();
+		voidCloseSession();
+		uint8_FlushWriteBuffer();
 
-		/* Send ACK  */
-				voidSendACK(1u);
-		if(Local_uint8AddressValidStatus == VALID_ADDRESS)
-		{
-			/*Extract Payload Length */
-			uint8_t Local_uint8PayloadLength = copy_puint8CmdPacket[6] ;
+		Local_uint8Status = BL_RESET_BOOT_RESET;
 
-			/*Execute writing functionality */
-			Local_uint8WritingStatus =uint8_ExecuteMemoryWrite(&copy_puint8CmdPacket[7] ,Local_uint32Address ,Local_uint8PayloadLength);
-		}
-		else
+		if(Local_uint8Mode == BL_RESET_BOOT_MODE_HANDOFF)
 		{
-			Local_uint8WritingStatus = WRITING_ERROR ;
+			if(BL_uint8ImageCheck() == BL_IMAGE_INVALID)
+			{
+				Local_uint8Status = BL_RESET_BOOT_INVALID;
+			}
+			else if(Bootloader_HandoffAllowed() != 0u)
+			{
+				Local_uint8Status = BL_RESET_BOOT_HANDOFF;
+			}
 		}
-		HAL_UART_Transmit(&huart2, &Local_uint8WritingStatus, 1, HAL_MAX_DELAY) ;
-
 	}
-	else
+
+	voidSendResponse(&Local_uint8Status, 1u);
+
+	if(Local_uint8Status != BL_RESET_BOOT_INVALID)
 	{
-		/* Send NACK if CRC verification fails */
-		voidSendNACK();
+		BL_voidTransportTxFlush();
+		Bootloader_LeaveUpdateMode((uint8_t)(Local_uint8Status == BL_RESET_BOOT_RESET));
 	}
 }
 
-void BL_voidHandleEnRWProtectCmd(uint8_t* copy_puint8CmdPacket)
-{
-	uint8_t Local_uint8CRCStatus;
-	uint8_t Local_uint8CmdLen; // this variable to extract command length
-	uint32_t Local_uint32HostCRC; // this variable to extract host CRC
 
-	/* Extract command length (first byte includes "Length to follow") */
-	Local_uint8CmdLen = copy_puint8CmdPacket[0] + 1;
+/*
+ * BL_voidHandleGetAppInfoCmd
+ * --------------------------
+ * Handles BL_GET_APP_INFO (see "Application Info" in BL.h): one entry per
+ * slot from its header words, read in place.
+ *
+ * Behavior:
+ * ---------
+ * The header fields are copied whenever the slot has the magic, also for an
+ * unstamped or failing header, so the host sees what is there; the length
+ * only when EndAddress lies in the slot.
+ */
+void BL_voidHandleGetAppInfoCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t  Local_uint8Reply[3u + (BL_IMAGE_SLOT_COUNT * BL_APP_INFO_ENTRY_SIZE)] = { 0u };
+	uint8_t* Local_puint8Entry = &Local_uint8Reply[3];
+	const volatile BL_ImageHeader_t* Local_pHeader;
+	uint32_t Local_uint32Base;
+	uint32_t Local_uint32Words[6];
+	uint8_t  Local_uint8Slot;
 
-	/* Extract CRC from the last 4 bytes of the received packet */
-	Local_uint32HostCRC = *((uint32_t*)(copy_puint8CmdPacket + Local_uint8CmdLen - 4));
+	(void)copy_puint8CmdPacket;
 
-	/* Verify CRC of the received command */
-	Local_uint8CRCStatus = uint8VerifyCRC(copy_puint8CmdPacket, (Local_uint8CmdLen - 4), Local_uint32HostCRC);
+	Local_uint8Reply[0] = BL_APP_INFO_OK;
+	Local_uint8Reply[1] = BL_IMAGE_SLOT_COUNT;
+	Local_uint8Reply[2] = BL_uint8ImageGetActiveSlot();
 
-	if(Local_uint8CRCStatus == CRC_SUCCESS)
+	for(Local_uint8Slot = 0; Local_uint8Slot < BL_IMAGE_SLOT_COUNT; Local_uint8Slot++)
 	{
-		/* Send ACK with the length of the response payload (1 byte for version) */
-		voidSendACK(1u);
+		Local_uint32Base = BL_uint32ImageGetSlotBase(Local_uint8Slot);
+		Local_pHeader    = (const volatile BL_ImageHeader_t*)(Local_uint32Base + BL_IMAGE_HEADER_OFFSET);
 
+		Local_puint8Entry[0] = BL_uint8ImageGetState(Local_uint8Slot);
+
+		if(Local_pHeader->Magic == BL_IMAGE_MAGIC)
+		{
+			Local_uint32Words[0] = Local_pHeader->Version;
+			Local_uint32Words[1] = Local_pHeader->BuildId;
+			Local_uint32Words[2] = ((Local_pHeader->EndAddress > Local_uint32Base) &&
+			                        (Local_pHeader->EndAddress <= BL_uint32ImageGetSlotEnd(Local_uint8Slot))) ?
+			                       (Local_pHeader->EndAddress - Local_uint32Base) : 0u;
+			Local_uint32Words[3] = Local_pHeader->Crc;
+			Local_uint32Words[4] = Local_pHeader->SecurityVersion;
+			Local_uint32Words[5] = Local_pHeader->Activated;
+			memcpy(&Local_puint8Entry[1], Local_uint32Words, sizeof(Local_uint32Words));
+		}
+
+		Local_puint8Entry += BL_APP_INFO_ENTRY_SIZE;
 	}
-	else
-	{
-		/* Send NACK if CRC verification fails */
-		voidSendNACK();
-	}
+
+	voidSendResponse(Local_uint8Reply, sizeof(Local_uint8Reply));
 }
 
-void BL_voidHandleMemReadCmd(uint8_t* copy_puint8CmdPacket)
+
+/*
+ * BL_voidHandleProgramFromRamCmd
+ * ------------------------------
+ * Programs flash from the RAM run area (see "Program From RAM" in BL.h).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               Payload: [source (4)] [destination (4)] [length (4)] [CRC (4)].
+ *
+ * Behavior:
+ * ---------
+ * 1. The source must lie in the RAM run area and the destination be one
+ *    writable flash region; the CRC is checked before anything is written.
+ * 2. BL_PROGRAM_RAM_CHUNK_SIZE steps through uint8_WriteRegion, so a session
+ *    write-combines and hashes them as it does BL_MEM_WRITE data.
+ * 3. The staged line is flushed, then the flash is compared with the source
+ *    one chunk at a time.
+ */
+void BL_voidHandleProgramFromRamCmd(uint8_t* copy_puint8CmdPacket)
 {
-	uint8_t Local_uint8CRCStatus;
-	uint8_t Local_uint8CmdLen; // this variable to extract command length
-	uint32_t Local_uint32HostCRC; // this variable to extract host CRC
+	uint8_t* Local_puint8Payload     = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint32_t Local_uint32Source      = uint32_GetField(&Local_puint8Payload[0]);
+	uint32_t Local_uint32Destination = uint32_GetField(&Local_puint8Payload[4]);
+	uint32_t Local_uint32Length      = uint32_GetField(&Local_puint8Payload[8]);
+	uint32_t Local_uint32Crc         = uint32_GetField(&Local_puint8Payload[12]);
+	uint32_t Local_uint32Address     = Local_uint32Destination;
+	uint32_t Local_uint32Offset      = 0u;
+	uint32_t Local_uint32Step;
+	const BL_MemoryRegion_t* Local_pRegion = NULL;
+	uint8_t  Local_uint8Reply[5];
+
+	Local_uint8Reply[0] = BL_PROGRAM_RAM_INVALID;
+
+	if((Local_uint32Length != 0u) && (Local_uint32Source >= BL_RAM_RUN_BASE) &&
+	   (Local_uint32Length <= BL_RAM_RUN_SIZE) && ((Local_uint32Source - BL_RAM_RUN_BASE) <= (BL_RAM_RUN_SIZE - Local_uint32Length)))
+	{
+		Local_pRegion = pMemory_LookupRegion(Local_uint32Destination, Local_uint32Length, BL_MEMORY_WRITE);
+	}
 
-	/* Extract command length (first byte includes "Length to follow") */
-	Local_uint8CmdLen = copy_puint8CmdPacket[0] + 1;
+	if((Local_pRegion != NULL) && (Local_pRegion->Method == BL_MEMORY_METHOD_FLASH))
+	{
+		Local_uint8Reply[0] = BL_PROGRAM_RAM_OK;
+
+		if(BL_uint32CRCCalculate((const uint8_t*)Local_uint32Source, Local_uint32Length) != Local_uint32Crc)
+		{
+			Local_uint8Reply[0] = BL_PROGRAM_RAM_CRC_ERROR;
+		}
 
-	/* Extract CRC from the last 4 bytes of the received packet */
-	Local_uint32HostCRC = *((uint32_t*)(copy_puint8CmdPacket + Local_uint8CmdLen - 4));
+		while((Local_uint32Offset < Local_uint32Length) && (Local_uint8Reply[0] == BL_PROGRAM_RAM_OK))
+		{
+			Local_uint32Step    = Local_uint32Length - Local_uint32Offset;
+			Local_uint32Step    = (Local_uint32Step < BL_PROGRAM_RAM_CHUNK_SIZE) ? Local_uint32Step : BL_PROGRAM_RAM_CHUNK_SIZE;
+			Local_uint32Address = Local_uint32Destination + Local_uint32Offset;
+
+			if(uint8_WriteRegion((uint8_t*)(Local_uint32Source + Local_uint32Offset), Local_uint32Address, (uint16_t)Local_uint32Step) != HAL_OK)
+			{
+				Local_uint8Reply[0] = BL_PROGRAM_RAM_WRITE_ERROR;
+			}
+			else
+			{
+				Local_uint32Offset += Local_uint32Step;
+				voidReportProgress(BL_PROGRESS_OP_PROGRAM, BL_uint8FlashGetSector(Local_uint32Address), Local_uint32Offset, Local_uint32Length);
+			}
+		}
 
-	/* Verify CRC of the received command */
-	Local_uint8CRCStatus = uint8VerifyCRC(copy_puint8CmdPacket, (Local_uint8CmdLen - 4), Local_uint32HostCRC);
+		if((Local_uint8Reply[0] == BL_PROGRAM_RAM_OK) && (uint8_FlushWriteBuffer() != HAL_OK))
+		{
+			/* Only the last staged line can be left */
+			Local_uint8Reply[0]  = BL_PROGRAM_RAM_WRITE_ERROR;
+			Local_uint32Address  = (Local_uint32Destination + Local_uint32Length) & ~(uint32_t)(WRITE_COMBINE_LINE_SIZE - 1u);
+		}
 
-	if(Local_uint8CRCStatus == CRC_SUCCESS)
-	{
-		/* Send ACK with the length of the response payload (1 byte for version) */
-		voidSendACK(1u);
+		for(Local_uint32Offset = 0u; (Local_uint32Offset < Local_uint32Length) && (Local_uint8Reply[0] == BL_PROGRAM_RAM_OK); Local_uint32Offset += Local_uint32Step)
+		{
+			Local_uint32Step    = Local_uint32Length - Local_uint32Offset;
+			Local_uint32Step    = (Local_uint32Step < BL_PROGRAM_RAM_CHUNK_SIZE) ? Local_uint32Step : BL_PROGRAM_RAM_CHUNK_SIZE;
+			Local_uint32Address = BL_uint32FlashVerify(Local_uint32Destination + Local_uint32Offset,
+			                                           (const uint8_t*)(Local_uint32Source + Local_uint32Offset), (uint16_t)Local_uint32Step);
+
+			if(Local_uint32Address != BL_FLASH_VERIFY_OK)
+			{
+				Local_uint8Reply[0] = BL_PROGRAM_RAM_VERIFY_ERROR;
+			}
+			else
+			{
+				voidReportProgress(BL_PROGRESS_OP_VERIFY, BL_uint8FlashGetSector(Local_uint32Destination + Local_uint32Offset),
+				                   Local_uint32Offset + Local_uint32Step, Local_uint32Length);
+			}
+		}
 
+		if(Local_uint8Reply[0] == BL_PROGRAM_RAM_OK)
+		{
+			Local_uint32Address = Local_uint32Destination + Local_uint32Length;
+#if BL_RS485_ENABLE
+			BL_voidTransportBroadcastDone();
+#endif
+		}
 	}
-	else
-	{
-		/* Send NACK if CRC verification fails */
-		voidSendNACK();
-	}
+
+	memcpy(&Local_uint8Reply[1], &Local_uint32Address, 4u);
+	voidSendResponse(Local_uint8Reply, 5u);
 }
 
-void BL_voidHandleReadSectorStatusCmd(uint8_t* copy_puint8CmdPacket)
+
+#if BL_PROGRESS_ENABLE
+/*
+ * BL_voidHandleSetProgressCmd
+ * ---------------------------
+ * Sets the progress frame interval (see "Progress Frames" in BL.h).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               Payload: [interval ms (2)], 0 = off.
+ *
+ * Behavior:
+ * ---------
+ * The interval is raised to BL_PROGRESS_MIN_INTERVAL_MS and replied as in
+ * effect; the first frame may follow as soon as the next step.
+ */
+void BL_voidHandleSetProgressCmd(uint8_t* copy_puint8CmdPacket)
 {
-	uint8_t Local_uint8CRCStatus;
-	uint8_t Local_uint8CmdLen; // this variable to extract command length
-	uint32_t Local_uint32HostCRC; // this variable to extract host CRC
+	uint16_t Local_uint16Interval = uint16_GetField(puint8_GetFramePayload(copy_puint8CmdPacket));
+	uint8_t  Local_uint8Reply[3];
 
-	/* Extract command length (first byte includes "Length to follow") */
-	Local_uint8CmdLen = copy_puint8CmdPacket[0] + 1;
+	if((Local_uint16Interval != 0u) && (Local_uint16Interval < BL_PROGRESS_MIN_INTERVAL_MS))
+	{
+		Local_uint16Interval = BL_PROGRESS_MIN_INTERVAL_MS;
+	}
 
-	/* Extract CRC from the last 4 bytes of the received packet */
-	Local_uint32HostCRC = *((uint32_t*)(copy_puint8CmdPacket + Local_uint8CmdLen - 4));
+	Global_uint16ProgressInterval = Local_uint16Interval;
+	Global_uint32ProgressTick     = HAL_GetTick() - Local_uint16Interval;
 
-	/* Verify CRC of the received command */
-	Local_uint8CRCStatus = uint8VerifyCRC(copy_puint8CmdPacket, (Local_uint8CmdLen - 4), Local_uint32HostCRC);
+	Local_uint8Reply[0] = BL_SET_PROGRESS_OK;
+	memcpy(&Local_uint8Reply[1], &Local_uint16Interval, 2u);
 
-	if(Local_uint8CRCStatus == CRC_SUCCESS)
-	{
-		/* Send ACK with the length of the response payload (1 byte for version) */
-		voidSendACK(1u);
+	voidSendResponse(Local_uint8Reply, 3u);
+}
+#endif
 
-	}
-	else
+
+/*
+ * BL_voidHandleRunScriptCmd
+ * -------------------------
+ * Runs a BL_BATCH payload stored in the RAM run area (see "Run Script" in
+ * BL.h).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               Payload: [address (4)] [length (4)] [CRC (4)].
+ *
+ * Behavior:
+ * ---------
+ * 1. A script that is empty, not wholly inside the RAM run area or does not
+ *    match the CRC gets [BL_BATCH_INVALID] [0].
+ * 2. Otherwise the script runs as a batch and is answered as one.
+ */
+void BL_voidHandleRunScriptCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint32_t Local_uint32Address = uint32_GetField(&Local_puint8Payload[0]);
+	uint32_t Local_uint32Length  = uint32_GetField(&Local_puint8Payload[4]);
+	uint32_t Local_uint32Crc     = uint32_GetField(&Local_puint8Payload[8]);
+	uint8_t  Local_uint8Reply[2] = { BL_BATCH_INVALID, 0u };
+
+	if((Local_uint32Length == 0u) || (Local_uint32Address < BL_RAM_RUN_BASE) || (Local_uint32Length > BL_RAM_RUN_SIZE) ||
+	   ((Local_uint32Address - BL_RAM_RUN_BASE) > (BL_RAM_RUN_SIZE - Local_uint32Length)) ||
+	   (BL_uint32CRCCalculate((const uint8_t*)Local_uint32Address, Local_uint32Length) != Local_uint32Crc))
 	{
-		/* Send NACK if CRC verification fails */
-		voidSendNACK();
+		voidSendResponse(Local_uint8Reply, 2u);
+		return;
 	}
-}
 
-void BL_voidHandleOTPReadCmd(uint8_t* copy_puint8CmdPacket)
-{
-	uint8_t Local_uint8CRCStatus;
-	uint8_t Local_uint8CmdLen; // this variable to extract command length
-	uint32_t Local_uint32HostCRC; // this variable to extract host CRC
+	voidRunBatch((uint8_t*)Local_uint32Address, (uint8_t*)(Local_uint32Address + Local_uint32Length));
+}
 
-	/* Extract command length (first byte includes "Length to follow") */
-	Local_uint8CmdLen = copy_puint8CmdPacket[0] + 1;
 
-	/* Extract CRC from the last 4 bytes of the received packet */
-	Local_uint32HostCRC = *((uint32_t*)(copy_puint8CmdPacket + Local_uint8CmdLen - 4));
+#if BL_LINK_TEST_ENABLE
+/*
+ * BL_voidHandleEchoCmd
+ * --------------------
+ * Link benchmark reply of a requested size (see "Link Benchmark" in BL.h).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               Payload: [length (2)] [data].
+ *
+ * Behavior:
+ * ---------
+ * The reply is built in the TX buffer: the data sent, cut to length, then
+ * the pattern up to length.
+ */
+void BL_voidHandleEchoCmd(uint8_t* copy_puint8CmdPacket)
+{
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint16_t Local_uint16Length  = uint16_GetField(&Local_puint8Payload[0]);
+	uint16_t Local_uint16Data    = (uint16_t)(uint16_GetFramePayloadLength(copy_puint8CmdPacket) - 2u);
+	uint16_t Local_uint16Index;
+	uint16_t Local_uint16TxLength;
+	uint8_t* Local_puint8Tx;
+	uint8_t  Local_uint8Status = BL_ECHO_TOO_LONG;
+
+	if(Local_uint16Length > BL_ECHO_MAX_LENGTH)
+	{
+		voidSendResponse(&Local_uint8Status, 1u);
+		return;
+	}
 
-	/* Verify CRC of the received command */
-	Local_uint8CRCStatus = uint8VerifyCRC(copy_puint8CmdPacket, (Local_uint8CmdLen - 4), Local_uint32HostCRC);
+	Local_uint16Data = (Local_uint16Data < Local_uint16Length) ? Local_uint16Data : Local_uint16Length;
 
-	if(Local_uint8CRCStatus == CRC_SUCCESS)
-	{
-		/* Send ACK with the length of the response payload (1 byte for version) */
-		voidSendACK(1u);
+	Local_puint8Tx = BL_puint8TransportTxAcquire();
+	Local_uint16TxLength = uint8_BuildAckHeader(Local_puint8Tx, (uint16_t)(1u + Local_uint16Length));
+	Local_puint8Tx[Local_uint16TxLength++] = BL_ECHO_OK;
 
-	}
-	else
+	memcpy(&Local_puint8Tx[Local_uint16TxLength], &Local_puint8Payload[2], Local_uint16Data);
+	for(Local_uint16Index = Local_uint16Data; Local_uint16Index < Local_uint16Length; Local_uint16Index++)
 	{
-		/* Send NACK if CRC verification fails */
-		voidSendNACK();
+		Local_puint8Tx[Local_uint16TxLength + Local_uint16Index] = (uint8_t)Local_uint16Index;
 	}
+
+	voidStartResponse(Local_puint8Tx, (uint16_t)(Local_uint16TxLength + Local_uint16Length));
 }
 
-void BL_voidHandleDisWRProtectCmd(uint8_t* copy_puint8CmdPacket)
+
+/*
+ * BL_voidHandleSinkCmd
+ * --------------------
+ * Counts and drops a link benchmark frame (see "Link Benchmark" in BL.h).
+ *
+ * Parameters:
+ * -----------
+ * @param copy_puint8CmdPacket : Pointer to the received command packet.
+ *                               Payload: [flags (1)] [data].
+ *
+ * Behavior:
+ * ---------
+ * 1. A frame failing its CRC is counted and otherwise ignored: its flags
+ *    cannot be trusted.
+ * 2. BL_SINK_FLAG_RESET clears the counters and notes the time.
+ * 3. The frame and its data bytes are counted.
+ * 4. BL_SINK_FLAG_REPORT answers the counters; nothing is sent otherwise.
+ */
+void BL_voidHandleSinkCmd(uint8_t* copy_puint8CmdPacket)
 {
-	uint8_t Local_uint8CRCStatus;
-	uint8_t Local_uint8CmdLen; // this variable to extract command length
-	uint32_t Local_uint32HostCRC; // this variable to extract host CRC
+	uint8_t* Local_puint8Payload = puint8_GetFramePayload(copy_puint8CmdPacket);
+	uint8_t  Local_uint8Flags    = Local_puint8Payload[0];
+	uint32_t Local_uint32Elapsed;
+	uint8_t  Local_uint8Reply[17];
 
-	/* Extract command length (first byte includes "Length to follow") */
-	Local_uint8CmdLen = copy_puint8CmdPacket[0] + 1;
+	if(uint8_VerifyFrameCRC(copy_puint8CmdPacket) != CRC_SUCCESS)
+	{
+		Global_uint32SinkCrcErrors++;
+		return;
+	}
 
-	/* Extract CRC from the last 4 bytes of the received packet */
-	Local_uint32HostCRC = *((uint32_t*)(copy_puint8CmdPacket + Local_uint8CmdLen - 4));
+	if((Local_uint8Flags & BL_SINK_FLAG_RESET) != 0u)
+	{
+		Global_uint32SinkFrames    = 0u;
+		Global_uint32SinkBytes     = 0u;
+		Global_uint32SinkCrcErrors = 0u;
+		Global_uint32SinkStart     = HAL_GetTick();
+	}
 
-	/* Verify CRC of the received command */
-	Local_uint8CRCStatus = uint8VerifyCRC(copy_puint8CmdPacket, (Local_uint8CmdLen - 4), Local_uint32HostCRC);
+	Global_uint32SinkFrames++;
+	Global_uint32SinkBytes += (uint32_t)uint16_GetFramePayloadLength(copy_puint8CmdPacket) - 1u;
 
-	if(Local_uint8CRCStatus == CRC_SUCCESS)
+	if((Local_uint8Flags & BL_SINK_FLAG_REPORT) != 0u)
 	{
-		/* Send ACK with the length of the response payload (1 byte for version) */
-		voidSendACK(1u);
+		Local_uint32Elapsed = HAL_GetTick() - Global_uint32SinkStart;
 
-	}
-	else
-	{
-		/* Send NACK if CRC verification fails */
-		voidSendNACK();
+		Local_uint8Reply[0] = BL_SINK_OK;
+		memcpy(&Local_uint8Reply[1],  &Global_uint32SinkFrames, 4u);
+		memcpy(&Local_uint8Reply[5],  &Global_uint32SinkBytes, 4u);
+		memcpy(&Local_uint8Reply[9],  &Global_uint32SinkCrcErrors, 4u);
+		memcpy(&Local_uint8Reply[13], &Local_uint32Elapsed, 4u);
+
+		voidSendResponse(Local_uint8Reply, 17u);
 	}
 }
+#endif
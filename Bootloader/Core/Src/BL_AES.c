@@ -0,0 +1,242 @@
+#include <string.h>
+#include "main.h"
+#include "BL_AES.h"
+
+
+/* Rotation of a column word: row n of a column moves to row n + 1 per 8 bits, one ROR operand on the M4 */
+#define ROTL(x, n)                    (((x) << (n)) | ((x) >> (32u - (n))))
+
+/* Multiplication by x in GF(2^8) modulo x^8 + x^4 + x^3 + x + 1 */
+#define XTIME(b)                      ((uint8_t)(((b) << 1) ^ ((((b) >> 7) & 1u) * 0x1Bu)))
+
+/*
+ * AES_ROUND
+ * ---------
+ * One full round into column word (o): the byte of row r comes from column
+ * (c + r) of the state (ShiftRows), looked up in the T-table rotated by r
+ * rows, and the round key word is added.
+ */
+#define AES_ROUND(o, s0, s1, s2, s3, k)                                                              \
+	(o) = Global_uint32Te[(s0) & 0xFFu]                 ^                                            \
+	      ROTL(Global_uint32Te[((s1) >> 8) & 0xFFu], 8u)  ^                                          \
+	      ROTL(Global_uint32Te[((s2) >> 16) & 0xFFu], 16u)^                                          \
+	      ROTL(Global_uint32Te[(s3) >> 24], 24u)          ^ (k)
+
+/* Last round: ShiftRows and SubBytes only */
+#define AES_FINAL(s0, s1, s2, s3, k)                                                                 \
+	(((uint32_t)Global_uint8SBox[(s0) & 0xFFu])                ^                                     \
+	 ((uint32_t)Global_uint8SBox[((s1) >> 8) & 0xFFu] << 8)    ^                                     \
+	 ((uint32_t)Global_uint8SBox[((s2) >> 16) & 0xFFu] << 16)  ^                                     \
+	 ((uint32_t)Global_uint8SBox[(s3) >> 24] << 24)            ^ (k))
+
+
+/*
+ * Global_uint32Te / Global_uint8SBox
+ * ----------------------------------
+ * Built by BL_voidAESInit. Te[b] is the column MixColumns makes of S(b) in
+ * row 0: bytes 2.S(b), S(b), S(b), 3.S(b) from the least significant up.
+ */
+static uint32_t Global_uint32Te[256] BL_CCMRAM;
+static uint8_t  Global_uint8SBox[256] BL_CCMRAM;
+
+
+/*
+ * voidAESEncryptWords
+ * -------------------
+ * Encrypts one block held as four little-endian column words. Two rounds
+ * per iteration ping-pong between the two sets of locals.
+ */
+__attribute__((optimize("O2")))
+static void voidAESEncryptWords(const BL_AES_t* Copy_pContext, const uint32_t* Copy_puint32Input, uint32_t* Copy_puint32Output)
+{
+	const uint32_t* Local_puint32Key = Copy_pContext->RoundKeys;
+	uint32_t S0 = Copy_puint32Input[0] ^ Local_puint32Key[0];
+	uint32_t S1 = Copy_puint32Input[1] ^ Local_puint32Key[1];
+	uint32_t S2 = Copy_puint32Input[2] ^ Local_puint32Key[2];
+	uint32_t S3 = Copy_puint32Input[3] ^ Local_puint32Key[3];
+	uint32_t T0, T1, T2, T3;
+	uint8_t  Local_uint8Round;
+
+	for(Local_uint8Round = (uint8_t)(Copy_pContext->Rounds / 2u); ; )
+	{
+		AES_ROUND(T0, S0, S1, S2, S3, Local_puint32Key[4]);
+		AES_ROUND(T1, S1, S2, S3, S0, Local_puint32Key[5]);
+		AES_ROUND(T2, S2, S3, S0, S1, Local_puint32Key[6]);
+		AES_ROUND(T3, S3, S0, S1, S2, Local_puint32Key[7]);
+		Local_puint32Key += 8;
+
+		if(--Local_uint8Round == 0u)
+		{
+			break;
+		}
+
+		AES_ROUND(S0, T0, T1, T2, T3, Local_puint32Key[0]);
+		AES_ROUND(S1, T1, T2, T3, T0, Local_puint32Key[1]);
+		AES_ROUND(S2, T2, T3, T0, T1, Local_puint32Key[2]);
+		AES_ROUND(S3, T3, T0, T1, T2, Local_puint32Key[3]);
+	}
+
+	Copy_puint32Output[0] = AES_FINAL(T0, T1, T2, T3, Local_puint32Key[0]);
+	Copy_puint32Output[1] = AES_FINAL(T1, T2, T3, T0, Local_puint32Key[1]);
+	Copy_puint32Output[2] = AES_FINAL(T2, T3, T0, T1, Local_puint32Key[2]);
+	Copy_puint32Output[3] = AES_FINAL(T3, T0, T1, T2, Local_puint32Key[3]);
+}
+
+
+/*
+ * BL_voidAESInit
+ * --------------
+ * Builds the S-box (multiplicative inverse and affine map, walking the
+ * field by powers of the generator 3) and the T-table from it.
+ */
+void BL_voidAESInit(void)
+{
+	uint8_t  Local_uint8Power = 1u;
+	uint8_t  Local_uint8Inverse = 1u;
+	uint8_t  Local_uint8Value;
+	uint16_t Local_uint16Index;
+
+	/* Power ^ Inverse = 1: multiplying one by 3 divides the other by 3 */
+	do
+	{
+		Local_uint8Power   = (uint8_t)(Local_uint8Power ^ XTIME(Local_uint8Power));
+		Local_uint8Inverse = (uint8_t)(Local_uint8Inverse ^ (Local_uint8Inverse << 1));
+		Local_uint8Inverse = (uint8_t)(Local_uint8Inverse ^ (Local_uint8Inverse << 2));
+		Local_uint8Inverse = (uint8_t)(Local_uint8Inverse ^ (Local_uint8Inverse << 4));
+		Local_uint8Inverse = (uint8_t)(Local_uint8Inverse ^ (((Local_uint8Inverse & 0x80u) != 0u) ? 0x09u : 0x00u));
+
+		Local_uint8Value = (uint8_t)(Local_uint8Inverse ^ (uint8_t)((Local_uint8Inverse << 1) | (Local_uint8Inverse >> 7)) ^
+		                                                  (uint8_t)((Local_uint8Inverse << 2) | (Local_uint8Inverse >> 6)) ^
+		                                                  (uint8_t)((Local_uint8Inverse << 3) | (Local_uint8Inverse >> 5)) ^
+		                                                  (uint8_t)((Local_uint8Inverse << 4) | (Local_uint8Inverse >> 4)));
+		Global_uint8SBox[Local_uint8Power] = (uint8_t)(Local_uint8Value ^ 0x63u);
+	} while(Local_uint8Power != 1u);
+
+	/* Zero has no inverse */
+	Global_uint8SBox[0] = 0x63u;
+
+	for(Local_uint16Index = 0; Local_uint16Index < 256u; Local_uint16Index++)
+	{
+		Local_uint8Value = Global_uint8SBox[Local_uint16Index];
+
+		Global_uint32Te[Local_uint16Index] = (uint32_t)XTIME(Local_uint8Value)                               |
+		                                     ((uint32_t)Local_uint8Value << 8)                              |
+		                                     ((uint32_t)Local_uint8Value << 16)                             |
+		                                     ((uint32_t)(uint8_t)(XTIME(Local_uint8Value) ^ Local_uint8Value) << 24);
+	}
+}
+
+
+/*
+ * BL_voidAESSetKey
+ * ----------------
+ * Key expansion (FIPS 197 section 5.2) into little-endian words: RotWord
+ * is a rotation right by 8 bits, the round constant goes into the low byte.
+ * A key length other than 32 is taken as 16.
+ */
+void BL_voidAESSetKey(BL_AES_t* Copy_pContext, const uint8_t* Copy_puint8Key, uint8_t Copy_uint8KeyLength)
+{
+	uint32_t* Local_puint32Key = Copy_pContext->RoundKeys;
+	uint8_t   Local_uint8Words = (Copy_uint8KeyLength == 32u) ? 8u : 4u;
+	uint8_t   Local_uint8Index;
+	uint8_t   Local_uint8Rcon = 1u;
+	uint32_t  Local_uint32Word;
+
+	Copy_pContext->Rounds = (uint8_t)(Local_uint8Words + 6u);
+	memcpy(Local_puint32Key, Copy_puint8Key, 4u * Local_uint8Words);
+
+	for(Local_uint8Index = Local_uint8Words; Local_uint8Index < (4u * (Copy_pContext->Rounds + 1u)); Local_uint8Index++)
+	{
+		Local_uint32Word = Local_puint32Key[Local_uint8Index - 1u];
+
+		if((Local_uint8Index % Local_uint8Words) == 0u)
+		{
+			Local_uint32Word = ROTL(Local_uint32Word, 24u);
+			Local_uint32Word = ((uint32_t)Global_uint8SBox[Local_uint32Word & 0xFFu] |
+			                    ((uint32_t)Global_uint8SBox[(Local_uint32Word >> 8) & 0xFFu] << 8) |
+			                    ((uint32_t)Global_uint8SBox[(Local_uint32Word >> 16) & 0xFFu] << 16) |
+			                    ((uint32_t)Global_uint8SBox[Local_uint32Word >> 24] << 24)) ^ Local_uint8Rcon;
+			Local_uint8Rcon  = XTIME(Local_uint8Rcon);
+		}
+		else if((Local_uint8Words == 8u) && ((Local_uint8Index % 8u) == 4u))
+		{
+			/* AES-256 only: SubWord without the rotation in the middle of each group */
+			Local_uint32Word = (uint32_t)Global_uint8SBox[Local_uint32Word & 0xFFu] |
+			                   ((uint32_t)Global_uint8SBox[(Local_uint32Word >> 8) & 0xFFu] << 8) |
+			                   ((uint32_t)Global_uint8SBox[(Local_uint32Word >> 16) & 0xFFu] << 16) |
+			                   ((uint32_t)Global_uint8SBox[Local_uint32Word >> 24] << 24);
+		}
+
+		Local_puint32Key[Local_uint8Index] = Local_puint32Key[Local_uint8Index - Local_uint8Words] ^ Local_uint32Word;
+	}
+}
+
+
+/*
+ * BL_voidAESEncrypt
+ * -----------------
+ * Encrypts one 16-byte block; input and output may be the same buffer.
+ */
+void BL_voidAESEncrypt(const BL_AES_t* Copy_pContext, const uint8_t* Copy_puint8Input, uint8_t* Copy_puint8Output)
+{
+	uint32_t Local_uint32Block[4];
+
+	memcpy(Local_uint32Block, Copy_puint8Input, BL_AES_BLOCK_SIZE);
+	voidAESEncryptWords(Copy_pContext, Local_uint32Block, Local_uint32Block);
+	memcpy(Copy_puint8Output, Local_uint32Block, BL_AES_BLOCK_SIZE);
+}
+
+
+/*
+ * BL_voidAESCTR
+ * -------------
+ * XORs the keystream into a piece of data that starts Copy_uint32Offset
+ * bytes after the initial counter block ("Counter Block" in BL_AES.h).
+ *
+ * Behavior:
+ * ---------
+ * 1. The counter of the first block is the initial one plus Offset / 16.
+ * 2. Each keystream block is XORed as four words (unaligned accesses are
+ *    single loads and stores on the M4), the first and last blocks of the
+ *    piece byte by byte from where the piece starts or ends in them.
+ * 3. The counter word is carried big endian, incremented as one 32-bit
+ *    value.
+ */
+void BL_voidAESCTR(const BL_AES_t* Copy_pContext, const uint8_t* Copy_puint8Counter, uint32_t Copy_uint32Offset,
+                   uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length)
+{
+	uint32_t Local_uint32Counter[4];
+	uint32_t Local_uint32Stream[4];
+	uint32_t Local_uint32Block;
+	uint8_t  Local_uint8Skip = (uint8_t)(Copy_uint32Offset % BL_AES_BLOCK_SIZE);
+	uint8_t  Local_uint8Index;
+
+	memcpy(Local_uint32Counter, Copy_puint8Counter, BL_AES_BLOCK_SIZE);
+	Local_uint32Block = __REV(Local_uint32Counter[3]) + (Copy_uint32Offset / BL_AES_BLOCK_SIZE);
+
+	while(Copy_uint32Length != 0u)
+	{
+		Local_uint32Counter[3] = __REV(Local_uint32Block);
+		voidAESEncryptWords(Copy_pContext, Local_uint32Counter, Local_uint32Stream);
+		Local_uint32Block++;
+
+		if((Local_uint8Skip == 0u) && (Copy_uint32Length >= BL_AES_BLOCK_SIZE))
+		{
+			for(Local_uint8Index = 0; Local_uint8Index < 4u; Local_uint8Index++)
+			{
+				__UNALIGNED_UINT32_WRITE(Copy_puint8Data, __UNALIGNED_UINT32_READ(Copy_puint8Data) ^ Local_uint32Stream[Local_uint8Index]);
+				Copy_puint8Data += 4;
+			}
+			Copy_uint32Length -= BL_AES_BLOCK_SIZE;
+		}
+		else
+		{
+			for(Local_uint8Index = Local_uint8Skip; (Local_uint8Index < BL_AES_BLOCK_SIZE) && (Copy_uint32Length != 0u); Local_uint8Index++)
+			{
+				*Copy_puint8Data++ ^= ((const uint8_t*)Local_uint32Stream)[Local_uint8Index];
+				Copy_uint32Length--;
+			}
+			Local_uint8Skip = 0;
+		}
+	}
+}
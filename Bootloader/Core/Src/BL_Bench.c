@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "BL_Bench.h"
+#include "BL_CRC.h"
+#include "BL_Flash.h"
+#include "BL_SHA256.h"
+#include "BL_AES.h"
+#include "BL_UART.h"
+
+#if BL_BENCH_ENABLE
+
+#if (3u * BL_BENCH_REPEAT * BL_BENCH_LENGTH) > (128u * 1024u)
+#error "BL_BENCH_REPEAT x BL_BENCH_LENGTH: the flash primitives need more than one 128 KB sector"
+#endif
+
+
+/* Destination of the copies in SRAM2: nothing else is running */
+#define BENCH_SRAM2                  ((uint8_t*)SRAM2_BASE)
+
+/* Source of every primitive and the SRAM1 destination */
+static uint8_t Global_uint8Source[BL_BENCH_LENGTH] __attribute__((aligned(4)));
+static uint8_t Global_uint8Sram1[BL_BENCH_LENGTH] __attribute__((aligned(4)));
+static uint8_t Global_uint8Ccmram[BL_BENCH_LENGTH] __attribute__((aligned(4))) BL_CCMRAM;
+
+/* Parameters of the primitive being measured */
+static uint8_t* Global_puint8Destination;
+static uint32_t Global_uint32FlashAddress;      /* Next erased address of the bench sector */
+
+/* Results nobody reads, so that no primitive is optimised away */
+static volatile uint32_t Global_uint32Sink;
+static uint8_t Global_uint8Digest[32];
+static BL_AES_t Global_Aes;
+
+
+static void voidCrcByte(void)
+{
+	BL_voidCRCReset();
+	Global_uint32Sink = BL_uint32CRCFeedBytes(Global_uint8Source, BL_BENCH_LENGTH);
+}
+
+static void voidCrcWord(void)
+{
+	const uint32_t* Local_puint32Word = (const uint32_t*)Global_uint8Source;
+	uint32_t Local_uint32Index;
+
+	CRC->CR = CRC_CR_RESET;
+	for(Local_uint32Index = 0; Local_uint32Index < (BL_BENCH_LENGTH / 4u); Local_uint32Index++)
+	{
+		CRC->DR = Local_puint32Word[Local_uint32Index];
+	}
+	Global_uint32Sink = CRC->DR;
+}
+
+static void voidCrcDma(void)
+{
+	Global_uint32Sink = BL_uint32CRCCalculate(Global_uint8Source, BL_BENCH_LENGTH);
+}
+
+#if BL_CRC_SOFT_ENABLE
+static void voidCrcSoft(void)
+{
+	Global_uint32Sink = BL_uint32CRCSoftCalculate(Global_uint8Source, BL_BENCH_LENGTH);
+}
+#endif
+
+static void voidFlashByte(void)
+{
+	uint32_t Local_uint32Index;
+
+	for(Local_uint32Index = 0; Local_uint32Index < BL_BENCH_LENGTH; Local_uint32Index++)
+	{
+		(void)HAL_FLASH_Program(FLASH_TYPEPROGRAM_BYTE, Global_uint32FlashAddress + Local_uint32Index, Global_uint8Source[Local_uint32Index]);
+	}
+	Global_uint32FlashAddress += BL_BENCH_LENGTH;
+}
+
+static void voidFlashWord(void)
+{
+	uint32_t Local_uint32Index;
+
+	for(Local_uint32Index = 0; Local_uint32Index < BL_BENCH_LENGTH; Local_uint32Index += 4u)
+	{
+		(void)HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, Global_uint32FlashAddress + Local_uint32Index,
+		                        *(const uint32_t*)&Global_uint8Source[Local_uint32Index]);
+	}
+	Global_uint32FlashAddress += BL_BENCH_LENGTH;
+}
+
+static void voidFlashBl(void)
+{
+	Global_uint32Sink = BL_uint8FlashProgram(Global_uint32FlashAddress, Global_uint8Source, BL_BENCH_LENGTH);
+	Global_uint32FlashAddress += BL_BENCH_LENGTH;
+}
+
+static void voidCopyMemcpy(void)
+{
+	memcpy(Global_puint8Destination, Global_uint8Source, BL_BENCH_LENGTH);
+}
+
+/* Volatile stores: GCC would turn a plain word loop back into memcpy */
+static void voidCopyWords(void)
+{
+	const uint32_t*    Local_puint32Source      = (const uint32_t*)Global_uint8Source;
+	volatile uint32_t* Local_puint32Destination = (volatile uint32_t*)Global_puint8Destination;
+	uint32_t Local_uint32Index;
+
+	for(Local_uint32Index = 0; Local_uint32Index < (BL_BENCH_LENGTH / 4u); Local_uint32Index++)
+	{
+		Local_puint32Destination[Local_uint32Index] = Local_puint32Source[Local_uint32Index];
+	}
+}
+
+static void voidSha256Sram(void)
+{
+	BL_voidSHA256Calculate(Global_uint8Source, BL_BENCH_LENGTH, Global_uint8Digest);
+}
+
+/* The bootloader's own code as the data */
+static void voidSha256Flash(void)
+{
+	BL_voidSHA256Calculate((const uint8_t*)FLASH_BASE, BL_BENCH_LENGTH, Global_uint8Digest);
+}
+
+
+/* In place, as a decrypting session deciphers the frame buffer */
+static void voidAesCtr(void)
+{
+	BL_voidAESCTR(&Global_Aes, Global_uint8Source, 0u, Global_uint8Sram1, BL_BENCH_LENGTH);
+}
+
+
+/*
+ * voidPrint
+ * ---------
+ * One line over USART2, blocking: nothing is measured meanwhile.
+ */
+static void voidPrint(const char* Copy_pcLine)
+{
+	BL_voidUARTWrite((const uint8_t*)Copy_pcLine, (uint16_t)strlen(Copy_pcLine));
+}
+
+
+/*
+ * voidReport
+ * ----------
+ * The CSV line of BL_Bench.h, cycles per byte with two decimals.
+ */
+static void voidReport(const char* Copy_pcName, uint32_t Copy_uint32Length, uint32_t Copy_uint32Min, uint32_t Copy_uint32Max)
+{
+	char     Local_cLine[112];
+	uint32_t Local_uint32Hundredths = (uint32_t)(((uint64_t)Copy_uint32Min * 100u) / Copy_uint32Length);
+
+	snprintf(Local_cLine, sizeof(Local_cLine), "bench,%s,%lu,%lu,%lu,%lu,%lu,%lu.%02lu\r\n", Copy_pcName,
+	         (unsigned long)SystemCoreClock, (unsigned long)(FLASH->ACR & FLASH_ACR_LATENCY),
+	         (unsigned long)Copy_uint32Length, (unsigned long)Copy_uint32Min, (unsigned long)Copy_uint32Max,
+	         (unsigned long)(Local_uint32Hundredths / 100u), (unsigned long)(Local_uint32Hundredths % 100u));
+	voidPrint(Local_cLine);
+}
+
+
+/*
+ * voidMeasure
+ * -----------
+ * Runs a primitive BL_BENCH_REPEAT times and reports the fastest and the
+ * slowest repeat.
+ */
+static void voidMeasure(const char* Copy_pcName, void (*Copy_pfPrimitive)(void))
+{
+	uint32_t Local_uint32Min = UINT32_MAX;
+	uint32_t Local_uint32Max = 0u;
+	uint32_t Local_uint32Start;
+	uint32_t Local_uint32Cycles;
+	uint8_t  Local_uint8Repeat;
+
+	for(Local_uint8Repeat = 0; Local_uint8Repeat < BL_BENCH_REPEAT; Local_uint8Repeat++)
+	{
+		Local_uint32Start = DWT->CYCCNT;
+		Copy_pfPrimitive();
+		Local_uint32Cycles = DWT->CYCCNT - Local_uint32Start;
+
+		Local_uint32Min = (Local_uint32Cycles < Local_uint32Min) ? Local_uint32Cycles : Local_uint32Min;
+		Local_uint32Max = (Local_uint32Cycles > Local_uint32Max) ? Local_uint32Cycles : Local_uint32Max;
+	}
+
+	voidReport(Copy_pcName, BL_BENCH_LENGTH, Local_uint32Min, Local_uint32Max);
+}
+
+
+/*
+ * BL_voidBenchRun
+ * ---------------
+ * The suite of BL_Bench.h at the current clock, after a comment line with
+ * the ART accelerator settings: the flash figures depend on them as much
+ * as on the wait states.
+ */
+void BL_voidBenchRun(void)
+{
+	static const struct
+	{
+		const char* Name;
+		uint8_t*    Destination;
+	} Local_Copies[] =
+	{
+		{ "sram1",  Global_uint8Sram1 },
+		{ "sram2",  BENCH_SRAM2       },
+		{ "ccmram", Global_uint8Ccmram },
+	};
+	const BL_FlashSector_t* Local_pSector = BL_pFlashGetSectorInfo(BL_BENCH_FLASH_SECTOR);
+	char     Local_cName[32];
+	char     Local_cLine[96];
+	uint32_t Local_uint32Start;
+	uint32_t Local_uint32Index;
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	for(Local_uint32Index = 0; Local_uint32Index < BL_BENCH_LENGTH; Local_uint32Index++)
+	{
+		Global_uint8Source[Local_uint32Index] = (uint8_t)((Local_uint32Index * 7u) + 1u);
+	}
+
+	snprintf(Local_cLine, sizeof(Local_cLine), "# clock %lu Hz, prefetch %u, icache %u, dcache %u\r\n",
+	         (unsigned long)SystemCoreClock, ((FLASH->ACR & FLASH_ACR_PRFTEN) != 0u) ? 1u : 0u,
+	         ((FLASH->ACR & FLASH_ACR_ICEN) != 0u) ? 1u : 0u, ((FLASH->ACR & FLASH_ACR_DCEN) != 0u) ? 1u : 0u);
+	voidPrint(Local_cLine);
+
+	voidMeasure("crc-byte", voidCrcByte);
+	voidMeasure("crc-word", voidCrcWord);
+	voidMeasure("crc-dma",  voidCrcDma);
+#if BL_CRC_SOFT_ENABLE
+	voidMeasure("crc-soft", voidCrcSoft);
+#endif
+
+	/* Flash: one erase, then every repeat in fresh erased space */
+	HAL_FLASH_Unlock();
+	Local_uint32Start = DWT->CYCCNT;
+	Global_uint32Sink = BL_uint8FlashEraseSector(BL_BENCH_FLASH_SECTOR);
+	Local_uint32Start = DWT->CYCCNT - Local_uint32Start;
+	voidReport("flash-erase", Local_pSector->Size, Local_uint32Start, Local_uint32Start);
+
+	Global_uint32FlashAddress = Local_pSector->Base;
+	voidMeasure("flash-byte", voidFlashByte);
+	voidMeasure("flash-word", voidFlashWord);
+	voidMeasure("flash-bl",   voidFlashBl);
+	HAL_FLASH_Lock();
+
+	for(Local_uint32Index = 0; Local_uint32Index < (sizeof(Local_Copies) / sizeof(Local_Copies[0])); Local_uint32Index++)
+	{
+		Global_puint8Destination = Local_Copies[Local_uint32Index].Destination;
+
+		snprintf(Local_cName, sizeof(Local_cName), "copy-memcpy-%s", Local_Copies[Local_uint32Index].Name);
+		voidMeasure(Local_cName, voidCopyMemcpy);
+		snprintf(Local_cName, sizeof(Local_cName), "copy-words-%s", Local_Copies[Local_uint32Index].Name);
+		voidMeasure(Local_cName, voidCopyWords);
+	}
+
+	voidMeasure("sha256-sram",  voidSha256Sram);
+	voidMeasure("sha256-flash", voidSha256Flash);
+
+	BL_voidAESSetKey(&Global_Aes, Global_uint8Source, 16u);
+	voidMeasure("aes-ctr-128", voidAesCtr);
+	BL_voidAESSetKey(&Global_Aes, Global_uint8Source, 32u);
+	voidMeasure("aes-ctr-256", voidAesCtr);
+}
+
+#endif
@@ -0,0 +1,370 @@
+#include "main.h"
+
+#if BL_TRANSPORT_CAN_ENABLE
+
+#include "BL_CAN.h"
+#include "BL_Transport.h"
+#include "Ring.h"
+
+
+/*
+ * Global_RxRings
+ * --------------
+ * One reception ring per link ([0] unicast, [1] group), written by the FIFO
+ * interrupts with the data bytes of each CAN frame (Ring.h: the interrupt
+ * the producer, the parser the consumer).
+ */
+static uint8_t Global_uint8RxData[2][BL_CAN_RX_RING_SIZE] BL_CCMRAM_BUDGET("rx");
+static Ring_t  Global_RxRings[2];
+
+/*
+ * Global_puint8TxData
+ * -------------------
+ * Response being sent: the TX interrupt moves it into the three mailboxes,
+ * 8 bytes per CAN frame, in order (TXFP).
+ */
+static const uint8_t* volatile Global_puint8TxData;
+static volatile uint16_t       Global_uint16TxLeft;
+static uint32_t                Global_uint32TxTick;
+
+#define CAN_TSR_TME_ALL              (CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2)
+#define CAN_TSR_RQCP_ALL             (CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2)
+
+
+/*
+ * uint32_GetBitTiming
+ * -------------------
+ * CAN_BTR value for BL_CAN_BITRATE from the APB1 clock: the most time quanta
+ * per bit (16 down to 8) that divide it exactly, sample point near 87.5 %.
+ * 42 MHz (168 MHz profile): 6 x 14 tq, 16 MHz (HSI): 2 x 16 tq.
+ */
+static uint32_t uint32_GetBitTiming(void)
+{
+	uint32_t Local_uint32Clock = HAL_RCC_GetPCLK1Freq();
+	uint32_t Local_uint32Quanta;
+	uint32_t Local_uint32Prescaler;
+	uint32_t Local_uint32Seg2;
+
+	for(Local_uint32Quanta = 16u; Local_uint32Quanta >= 8u; Local_uint32Quanta--)
+	{
+		if((Local_uint32Clock % (BL_CAN_BITRATE * Local_uint32Quanta)) == 0u)
+		{
+			Local_uint32Prescaler = Local_uint32Clock / (BL_CAN_BITRATE * Local_uint32Quanta);
+			Local_uint32Seg2      = (Local_uint32Quanta + 7u) / 8u;
+
+			if(Local_uint32Prescaler <= 1024u)
+			{
+				/* SJW = 1 tq, TS1 = quanta - sync - TS2 */
+				return ((Local_uint32Seg2 - 1u) << CAN_BTR_TS2_Pos) |
+				       ((Local_uint32Quanta - 2u - Local_uint32Seg2) << CAN_BTR_TS1_Pos) |
+				       (Local_uint32Prescaler - 1u);
+			}
+		}
+	}
+
+	/* No exact divider: the bus would not work at all */
+	Error_Handler();
+	return 0u;
+}
+
+
+/*
+ * voidFillMailboxes
+ * -----------------
+ * Loads the next response bytes into every empty mailbox. Only called from
+ * the TX interrupt (BL_voidCANTransmit pends it), so it never races itself.
+ */
+__RAM_FUNC static void voidFillMailboxes(void)
+{
+	CAN_TxMailBox_TypeDef* Local_pMailbox;
+	uint8_t  Local_uint8Bytes[8];
+	uint8_t  Local_uint8Count;
+	uint8_t  Local_uint8Index;
+	uint32_t Local_uint32Free;
+
+	while(Global_uint16TxLeft != 0u)
+	{
+		Local_uint32Free = CAN1->TSR & CAN_TSR_TME_ALL;
+
+		if(Local_uint32Free == 0u)
+		{
+			break;
+		}
+
+		/* CODE is the next empty mailbox */
+		Local_pMailbox   = &CAN1->sTxMailBox[(CAN1->TSR & CAN_TSR_CODE) >> CAN_TSR_CODE_Pos];
+		Local_uint8Count = (Global_uint16TxLeft > 8u) ? 8u : (uint8_t)Global_uint16TxLeft;
+
+		for(Local_uint8Index = 0; Local_uint8Index < 8u; Local_uint8Index++)
+		{
+			Local_uint8Bytes[Local_uint8Index] = (Local_uint8Index < Local_uint8Count) ? Global_puint8TxData[Local_uint8Index] : 0u;
+		}
+
+		Local_pMailbox->TDTR = Local_uint8Count;
+		Local_pMailbox->TDLR = Local_uint8Bytes[0] | ((uint32_t)Local_uint8Bytes[1] << 8) |
+		                       ((uint32_t)Local_uint8Bytes[2] << 16) | ((uint32_t)Local_uint8Bytes[3] << 24);
+		Local_pMailbox->TDHR = Local_uint8Bytes[4] | ((uint32_t)Local_uint8Bytes[5] << 8) |
+		                       ((uint32_t)Local_uint8Bytes[6] << 16) | ((uint32_t)Local_uint8Bytes[7] << 24);
+		Local_pMailbox->TIR  = ((uint32_t)(BL_CAN_ID_RESPONSE + BL_CAN_NODE_ID) << CAN_TI0R_STID_Pos) | CAN_TI0R_TXRQ;
+
+		Global_puint8TxData += Local_uint8Count;
+		Global_uint16TxLeft -= Local_uint8Count;
+	}
+}
+
+
+/*
+ * BL_voidCANInit
+ * --------------
+ * Starts CAN1: bit timing, automatic bus-off recovery, transmission in
+ * request order, one list filter per link and the FIFO / TX interrupts.
+ */
+void BL_voidCANInit(void)
+{
+	GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+	__HAL_RCC_CAN1_CLK_ENABLE();
+	__HAL_RCC_GPIOD_CLK_ENABLE();
+
+	GPIO_InitStruct.Pin = GPIO_PIN_0 | GPIO_PIN_1;
+	GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+	GPIO_InitStruct.Pull = GPIO_PULLUP;
+	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+	GPIO_InitStruct.Alternate = GPIO_AF9_CAN1;
+	HAL_GPIO_Init(GPIOD, &GPIO_InitStruct);
+
+	/* Leave sleep, enter initialization */
+	CAN1->MCR = CAN_MCR_INRQ;
+	while((CAN1->MSR & CAN_MSR_INAK) == 0u)
+	{
+	}
+
+	CAN1->MCR = CAN_MCR_INRQ | CAN_MCR_ABOM | CAN_MCR_TXFP;
+	CAN1->BTR = (0u << CAN_BTR_SJW_Pos) | uint32_GetBitTiming();
+
+	/* Bank 0: unicast identifier -> FIFO0, bank 1: group identifier -> FIFO1 (32-bit list mode) */
+	CAN1->FMR |= CAN_FMR_FINIT;
+	CAN1->FA1R &= ~(CAN_FA1R_FACT0 | CAN_FA1R_FACT1);
+	CAN1->FM1R |= CAN_FM1R_FBM0 | CAN_FM1R_FBM1;
+	CAN1->FS1R |= CAN_FS1R_FSC0 | CAN_FS1R_FSC1;
+	CAN1->FFA1R = (CAN1->FFA1R & ~CAN_FFA1R_FFA0) | CAN_FFA1R_FFA1;
+	CAN1->sFilterRegister[0].FR1 = (uint32_t)(BL_CAN_ID_REQUEST + BL_CAN_NODE_ID) << CAN_TI0R_STID_Pos;
+	CAN1->sFilterRegister[0].FR2 = (uint32_t)(BL_CAN_ID_REQUEST + BL_CAN_NODE_ID) << CAN_TI0R_STID_Pos;
+	CAN1->sFilterRegister[1].FR1 = (uint32_t)(BL_CAN_ID_GROUP + BL_CAN_GROUP_ID) << CAN_TI0R_STID_Pos;
+	CAN1->sFilterRegister[1].FR2 = (uint32_t)(BL_CAN_ID_GROUP + BL_CAN_GROUP_ID) << CAN_TI0R_STID_Pos;
+	CAN1->FA1R |= CAN_FA1R_FACT0 | CAN_FA1R_FACT1;
+	CAN1->FMR &= ~CAN_FMR_FINIT;
+
+	(void)Ring_Init(&Global_RxRings[0], Global_uint8RxData[0], BL_CAN_RX_RING_SIZE, 1u);
+	(void)Ring_Init(&Global_RxRings[1], Global_uint8RxData[1], BL_CAN_RX_RING_SIZE, 1u);
+	Global_uint16TxLeft = 0;
+
+	CAN1->IER = CAN_IER_FMPIE0 | CAN_IER_FMPIE1 | CAN_IER_TMEIE;
+
+	HAL_NVIC_EnableIRQ(CAN1_RX0_IRQn);
+	HAL_NVIC_EnableIRQ(CAN1_RX1_IRQn);
+	HAL_NVIC_EnableIRQ(CAN1_TX_IRQn);
+
+	/* Normal mode once 11 recessive bits were seen on the bus */
+	CAN1->MCR &= ~CAN_MCR_INRQ;
+	while((CAN1->MSR & CAN_MSR_INAK) != 0u)
+	{
+	}
+}
+
+
+/*
+ * BL_voidCANDeInit
+ * ----------------
+ * Interrupts off and CAN1 reset, which leaves it in sleep mode: it neither
+ * acknowledges nor receives frames on the bus any more, and a transmission
+ * still under way is aborted at once (waiting for the bus to go idle could
+ * take forever on a stuck bus). Then its clock is stopped. A response still
+ * queued is dropped.
+ */
+void BL_voidCANDeInit(void)
+{
+	HAL_NVIC_DisableIRQ(CAN1_RX0_IRQn);
+	HAL_NVIC_DisableIRQ(CAN1_RX1_IRQn);
+	HAL_NVIC_DisableIRQ(CAN1_TX_IRQn);
+
+	CAN1->IER = 0;
+	Global_uint16TxLeft = 0;
+
+	__HAL_RCC_CAN1_FORCE_RESET();
+	__HAL_RCC_CAN1_RELEASE_RESET();
+
+	__HAL_RCC_CAN1_CLK_DISABLE();
+	HAL_NVIC_ClearPendingIRQ(CAN1_RX0_IRQn);
+	HAL_NVIC_ClearPendingIRQ(CAN1_RX1_IRQn);
+	HAL_NVIC_ClearPendingIRQ(CAN1_TX_IRQn);
+}
+
+
+/*
+ * BL_uint16CANAvailable
+ * ---------------------
+ * Returns the number of received bytes not yet consumed by the parser.
+ */
+uint16_t BL_uint16CANAvailable(uint8_t Copy_uint8Group)
+{
+	return (uint16_t)Ring_Used(&Global_RxRings[Copy_uint8Group]);
+}
+
+
+/*
+ * BL_uint8CANPeek
+ * ---------------
+ * Returns the byte Copy_uint16Offset positions after the ring tail.
+ */
+uint8_t BL_uint8CANPeek(uint8_t Copy_uint8Group, uint16_t Copy_uint16Offset)
+{
+	return *(const uint8_t*)Ring_Peek(&Global_RxRings[Copy_uint8Group], Copy_uint16Offset);
+}
+
+
+/*
+ * BL_voidCANConsume
+ * -----------------
+ * Releases bytes from a ring.
+ */
+void BL_voidCANConsume(uint8_t Copy_uint8Group, uint16_t Copy_uint16Count)
+{
+	Ring_Release(&Global_RxRings[Copy_uint8Group], Copy_uint16Count);
+}
+
+
+/*
+ * BL_voidCANTransmit
+ * ------------------
+ * Hands a response to the TX interrupt and returns; the buffer must stay
+ * unchanged until BL_voidCANTxFlush.
+ */
+void BL_voidCANTransmit(const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length)
+{
+	BL_voidCANTxFlush();
+
+	Global_puint8TxData = Copy_puint8Data;
+	Global_uint32TxTick = HAL_GetTick();
+	Global_uint16TxLeft = Copy_uint16Length;
+
+	/* The first mailboxes are loaded by the interrupt, as all later ones */
+	HAL_NVIC_SetPendingIRQ(CAN1_TX_IRQn);
+}
+
+
+/*
+ * BL_voidCANTxFlush
+ * -----------------
+ * Waits until the response is completely on the bus. With no other node
+ * acknowledging (host adapter unplugged), the frames would be repeated
+ * forever: after BL_CAN_TX_TIMEOUT_MS they are aborted.
+ */
+void BL_voidCANTxFlush(void)
+{
+	while((Global_uint16TxLeft != 0u) || ((CAN1->TSR & CAN_TSR_TME_ALL) != CAN_TSR_TME_ALL))
+	{
+		if((HAL_GetTick() - Global_uint32TxTick) >= BL_CAN_TX_TIMEOUT_MS)
+		{
+			HAL_NVIC_DisableIRQ(CAN1_TX_IRQn);
+			Global_uint16TxLeft = 0;
+			CAN1->TSR = CAN_TSR_ABRQ0 | CAN_TSR_ABRQ1 | CAN_TSR_ABRQ2;
+			HAL_NVIC_EnableIRQ(CAN1_TX_IRQn);
+		}
+	}
+}
+
+
+/*
+ * BL_voidCANSendDiscovery
+ * -----------------------
+ * Sends one extended frame, BL_CAN_EXT_ID_DISCOVER | Copy_uint32Bits (25
+ * bits), with up to 8 data bytes, after any response still going out, and
+ * waits until it is on the bus. A frame losing arbitration to another node's
+ * answer is repeated by the controller until it wins.
+ */
+void BL_voidCANSendDiscovery(uint32_t Copy_uint32Bits, const uint8_t* Copy_puint8Data, uint8_t Copy_uint8Length)
+{
+	CAN_TxMailBox_TypeDef* Local_pMailbox;
+	uint8_t  Local_uint8Bytes[8] = {0};
+	uint8_t  Local_uint8Index;
+
+	BL_voidCANTxFlush();
+
+	for(Local_uint8Index = 0; (Local_uint8Index < Copy_uint8Length) && (Local_uint8Index < 8u); Local_uint8Index++)
+	{
+		Local_uint8Bytes[Local_uint8Index] = Copy_puint8Data[Local_uint8Index];
+	}
+
+	/* Every mailbox is empty after the flush: CODE is mailbox 0 */
+	Local_pMailbox = &CAN1->sTxMailBox[(CAN1->TSR & CAN_TSR_CODE) >> CAN_TSR_CODE_Pos];
+	Local_pMailbox->TDTR = Local_uint8Index;
+	Local_pMailbox->TDLR = Local_uint8Bytes[0] | ((uint32_t)Local_uint8Bytes[1] << 8) |
+	                       ((uint32_t)Local_uint8Bytes[2] << 16) | ((uint32_t)Local_uint8Bytes[3] << 24);
+	Local_pMailbox->TDHR = Local_uint8Bytes[4] | ((uint32_t)Local_uint8Bytes[5] << 8) |
+	                       ((uint32_t)Local_uint8Bytes[6] << 16) | ((uint32_t)Local_uint8Bytes[7] << 24);
+
+	Global_uint32TxTick  = HAL_GetTick();
+	Local_pMailbox->TIR  = ((BL_CAN_EXT_ID_DISCOVER | (Copy_uint32Bits & 0x01FFFFFFUL)) << CAN_TI0R_EXID_Pos) | CAN_TI0R_IDE | CAN_TI0R_TXRQ;
+
+	BL_voidCANTxFlush();
+}
+
+
+/*
+ * BL_voidCANRxIRQHandler
+ * ----------------------
+ * Moves every frame waiting in a FIFO into its link's ring and wakes the
+ * parser. A frame the ring has no room for is dropped whole; the host sees
+ * it as a frame timeout, or in group mode at the per-node verify.
+ */
+__RAM_FUNC void BL_voidCANRxIRQHandler(uint8_t Copy_uint8Fifo)
+{
+	Ring_t* Local_pRing = &Global_RxRings[Copy_uint8Fifo];
+	volatile uint32_t* Local_puint32RFR = (Copy_uint8Fifo == 0u) ? &CAN1->RF0R : &CAN1->RF1R;
+	CAN_FIFOMailBox_TypeDef* Local_pMailbox = &CAN1->sFIFOMailBox[Copy_uint8Fifo];
+	uint32_t Local_uint32Data[2];              /* Little endian: the data bytes in order */
+	uint8_t  Local_uint8Count;
+
+	while((*Local_puint32RFR & CAN_RF0R_FMP0) != 0u)
+	{
+		Local_uint8Count = (uint8_t)(Local_pMailbox->RDTR & CAN_RDT0R_DLC);
+		Local_uint32Data[0] = Local_pMailbox->RDLR;
+		Local_uint32Data[1] = Local_pMailbox->RDHR;
+
+		if(Local_uint8Count > 8u)
+		{
+			Local_uint8Count = 8u;
+		}
+
+		/* Room for the whole frame, or none of it */
+		if(Ring_Free(Local_pRing) >= Local_uint8Count)
+		{
+			(void)Ring_Write(Local_pRing, Local_uint32Data, Local_uint8Count);
+		}
+
+		/* Release the FIFO output mailbox (RFOM0 / RFOM1 share the bit position) */
+		*Local_puint32RFR = CAN_RF0R_RFOM0;
+	}
+
+	/* Overrun: frames were lost in the FIFO itself */
+	*Local_puint32RFR = CAN_RF0R_FOVR0 | CAN_RF0R_FULL0;
+
+	BL_voidTransportNotifyRx();
+}
+
+
+/*
+ * BL_voidCANTxIRQHandler
+ * ----------------------
+ * A mailbox completed (or BL_voidCANTransmit pended the interrupt): loads the
+ * next bytes of the response.
+ */
+__RAM_FUNC void BL_voidCANTxIRQHandler(void)
+{
+	CAN1->TSR = CAN_TSR_RQCP_ALL;
+
+	voidFillMailboxes();
+}
+
+#endif /* BL_TRANSPORT_CAN_ENABLE */
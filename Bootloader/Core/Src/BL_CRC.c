@@ -0,0 +1,663 @@
+
+#include "main.h"
+#include "BL_CRC.h"
+
+
+/* CRC unit polynomial and reset value */
+#define CRC_POLYNOMIAL                0x04C11DB7UL
+#define CRC_INITIAL_VALUE             0xFFFFFFFFUL
+
+
+/*
+ * Global_hdmaCrc
+ * --------------
+ * DMA2 Stream1, memory-to-memory (only DMA2 can): the "peripheral" side is
+ * the incremented source range, the "memory" side is the fixed CRC->DR.
+ */
+static DMA_HandleTypeDef Global_hdmaCrc;
+
+#if BL_CRC_WORDWISE_ENABLE
+/*
+ * Frame check by DMA ("Frame Check By DMA" in BL_CRC.h)
+ * -----------------------------------------------------
+ * Global_puint8AsyncFrame  : Frame the stream is checking, NULL while none is.
+ * Global_uint16AsyncLength : Its length, CRC trailer included.
+ * Global_uint32AsyncSaved  : CRC unit value before the check, restored after it.
+ */
+static const uint8_t* volatile Global_puint8AsyncFrame;
+static uint16_t                Global_uint16AsyncLength;
+static uint32_t                Global_uint32AsyncSaved;
+
+#define CRC_DMA_STREAM1_FLAGS         (DMA_LIFCR_CFEIF1 | DMA_LIFCR_CDMEIF1 | DMA_LIFCR_CTEIF1 | DMA_LIFCR_CHTIF1 | DMA_LIFCR_CTCIF1)
+#endif
+
+#if BL_CRC_SOFT_ENABLE
+/*
+ * Global_uint32SoftTable
+ * ----------------------
+ * Slicing-by-8 tables ("Software CRC" in BL_CRC.h): [n][b] is the CRC step
+ * of byte b at the top of the register followed by n zero bytes.
+ */
+static uint32_t Global_uint32SoftTable[8][256] BL_CCMRAM;
+#endif
+
+
+/*
+ * voidRestoreCRC
+ * --------------
+ * Brings the CRC unit to a saved value: after a reset, writing word X gives
+ * F(0xFFFFFFFF ^ X), F being 32 shift / XOR steps. Each step is inverted from
+ * the bit 0 of its result (the polynomial is odd), so X = F^-1(state) ^ 0xFFFFFFFF.
+ * In RAM: also used by the frame pre-check in the receive interrupt.
+ */
+__RAM_FUNC static void voidRestoreCRC(uint32_t Copy_uint32State)
+{
+	uint8_t Local_uint8Bit;
+
+	CRC->CR = CRC_CR_RESET;
+
+	if(Copy_uint32State != CRC_INITIAL_VALUE)
+	{
+		for(Local_uint8Bit = 0; Local_uint8Bit < 32u; Local_uint8Bit++)
+		{
+			if((Copy_uint32State & 1u) != 0u)
+			{
+				Copy_uint32State = ((Copy_uint32State ^ CRC_POLYNOMIAL) >> 1) | 0x80000000UL;
+			}
+			else
+			{
+				Copy_uint32State >>= 1;
+			}
+		}
+
+		CRC->DR = Copy_uint32State ^ CRC_INITIAL_VALUE;
+	}
+}
+
+
+/*
+ * BL_voidCRCInit
+ * --------------
+ * Configures the DMA stream once. The CRC unit itself is set up by MX_CRC_Init.
+ * Memory-to-memory transfers require the FIFO (direct mode is not allowed).
+ * With BL_CRC_SOFT_ENABLE also builds the software CRC tables.
+ */
+void BL_voidCRCInit(void)
+{
+#if BL_CRC_SOFT_ENABLE
+	uint32_t Local_uint32Value;
+	uint16_t Local_uint16Index;
+	uint8_t  Local_uint8Slice;
+
+	for(Local_uint16Index = 0; Local_uint16Index < 256u; Local_uint16Index++)
+	{
+		Local_uint32Value = (uint32_t)Local_uint16Index << 24;
+
+		for(Local_uint8Slice = 0; Local_uint8Slice < 8u; Local_uint8Slice++)
+		{
+			Local_uint32Value = ((Local_uint32Value & 0x80000000UL) != 0u) ? ((Local_uint32Value << 1) ^ CRC_POLYNOMIAL) : (Local_uint32Value << 1);
+		}
+
+		Global_uint32SoftTable[0][Local_uint16Index] = Local_uint32Value;
+	}
+
+	/* One more zero byte per table: an 8-step shift of the previous entry */
+	for(Local_uint8Slice = 1; Local_uint8Slice < 8u; Local_uint8Slice++)
+	{
+		for(Local_uint16Index = 0; Local_uint16Index < 256u; Local_uint16Index++)
+		{
+			Local_uint32Value = Global_uint32SoftTable[Local_uint8Slice - 1u][Local_uint16Index];
+			Global_uint32SoftTable[Local_uint8Slice][Local_uint16Index] = (Local_uint32Value << 8) ^ Global_uint32SoftTable[0][Local_uint32Value >> 24];
+		}
+	}
+#endif
+
+	__HAL_RCC_DMA2_CLK_ENABLE();
+
+	Global_hdmaCrc.Instance = DMA2_Stream1;
+	Global_hdmaCrc.Init.Channel = DMA_CHANNEL_0;
+	Global_hdmaCrc.Init.Direction = DMA_MEMORY_TO_MEMORY;
+	Global_hdmaCrc.Init.PeriphInc = DMA_PINC_ENABLE;
+	Global_hdmaCrc.Init.MemInc = DMA_MINC_DISABLE;
+	Global_hdmaCrc.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+	Global_hdmaCrc.Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+	Global_hdmaCrc.Init.Mode = DMA_NORMAL;
+	Global_hdmaCrc.Init.Priority = DMA_PRIORITY_LOW;
+	Global_hdmaCrc.Init.FIFOMode = DMA_FIFOMODE_ENABLE;
+	Global_hdmaCrc.Init.FIFOThreshold = DMA_FIFO_THRESHOLD_FULL;
+	Global_hdmaCrc.Init.MemBurst = DMA_MBURST_SINGLE;
+	Global_hdmaCrc.Init.PeriphBurst = DMA_PBURST_SINGLE;
+	if (HAL_DMA_Init(&Global_hdmaCrc) != HAL_OK)
+	{
+		Error_Handler();
+	}
+}
+
+
+/*
+ * voidFeedWords
+ * -------------
+ * Feeds whole little-endian words to the CRC unit, continuing its current value.
+ *
+ * Behavior:
+ * ---------
+ * 1. Word-aligned blocks of BL_CRC_DMA_MIN_LENGTH bytes or more are fed by
+ *    DMA, in transfers of at most BL_CRC_DMA_MAX_WORDS, polled to completion,
+ *    unless they are in CCMRAM, which the DMA controllers cannot read.
+ *    After a DMA error the CRC unit holds a partial result: it is restored to
+ *    its value before the block and the block is fed again by the CPU.
+ * 2. Otherwise the CPU writes CRC->DR directly, unaligned loads are fine on
+ *    the Cortex-M4.
+ */
+static void voidFeedWords(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Words)
+{
+	const uint8_t* Local_puint8Start = Copy_puint8Data;
+	uint32_t Local_uint32Total = Copy_uint32Words;
+	uint32_t Local_uint32Saved;
+	uint32_t Local_uint32Chunk;
+
+	if(((((uint32_t)Copy_puint8Data) & 3u) == 0u) && (Copy_uint32Words >= (BL_CRC_DMA_MIN_LENGTH / 4u)) &&
+	   ((((uint32_t)Copy_puint8Data) < CCMDATARAM_BASE) || (((uint32_t)Copy_puint8Data) > CCMDATARAM_END)))
+	{
+		Local_uint32Saved = CRC->DR;
+
+		while(Copy_uint32Words != 0u)
+		{
+			Local_uint32Chunk = (Copy_uint32Words > BL_CRC_DMA_MAX_WORDS) ? BL_CRC_DMA_MAX_WORDS : Copy_uint32Words;
+
+			if((HAL_DMA_Start(&Global_hdmaCrc, (uint32_t)Copy_puint8Data, (uint32_t)&CRC->DR, Local_uint32Chunk) != HAL_OK) ||
+			   (HAL_DMA_PollForTransfer(&Global_hdmaCrc, HAL_DMA_FULL_TRANSFER, HAL_MAX_DELAY) != HAL_OK))
+			{
+				/* Start the block over without DMA */
+				HAL_DMA_Abort(&Global_hdmaCrc);
+				voidRestoreCRC(Local_uint32Saved);
+				Copy_puint8Data  = Local_puint8Start;
+				Copy_uint32Words = Local_uint32Total;
+				break;
+			}
+
+			Copy_puint8Data  += Local_uint32Chunk * 4u;
+			Copy_uint32Words -= Local_uint32Chunk;
+		}
+	}
+
+	for( ; Copy_uint32Words != 0u; Copy_uint32Words--)
+	{
+		CRC->DR = __UNALIGNED_UINT32_READ(Copy_puint8Data);
+		Copy_puint8Data += 4u;
+	}
+}
+
+
+#if BL_CRC_SOFT_ENABLE
+/*
+ * uint32_SoftFeedWords
+ * --------------------
+ * Whole little-endian words in software, continuing Copy_uint32State: two
+ * words per slicing-by-8 step, an odd last word with the four tables of one
+ * word. Same result as feeding them to the CRC unit.
+ */
+static uint32_t uint32_SoftFeedWords(uint32_t Copy_uint32State, const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Words)
+{
+	uint32_t Local_uint32First;
+	uint32_t Local_uint32Second;
+
+	for( ; Copy_uint32Words >= 2u; Copy_uint32Words -= 2u)
+	{
+		Local_uint32First  = Copy_uint32State ^ __UNALIGNED_UINT32_READ(Copy_puint8Data);
+		Local_uint32Second = __UNALIGNED_UINT32_READ(Copy_puint8Data + 4u);
+
+		Copy_uint32State = Global_uint32SoftTable[7][Local_uint32First >> 24]           ^
+		                   Global_uint32SoftTable[6][(Local_uint32First >> 16) & 0xFFu] ^
+		                   Global_uint32SoftTable[5][(Local_uint32First >> 8) & 0xFFu]  ^
+		                   Global_uint32SoftTable[4][Local_uint32First & 0xFFu]         ^
+		                   Global_uint32SoftTable[3][Local_uint32Second >> 24]          ^
+		                   Global_uint32SoftTable[2][(Local_uint32Second >> 16) & 0xFFu]^
+		                   Global_uint32SoftTable[1][(Local_uint32Second >> 8) & 0xFFu] ^
+		                   Global_uint32SoftTable[0][Local_uint32Second & 0xFFu];
+
+		Copy_puint8Data += 8u;
+	}
+
+	if(Copy_uint32Words != 0u)
+	{
+		Local_uint32First = Copy_uint32State ^ __UNALIGNED_UINT32_READ(Copy_puint8Data);
+
+		Copy_uint32State = Global_uint32SoftTable[3][Local_uint32First >> 24]           ^
+		                   Global_uint32SoftTable[2][(Local_uint32First >> 16) & 0xFFu] ^
+		                   Global_uint32SoftTable[1][(Local_uint32First >> 8) & 0xFFu]  ^
+		                   Global_uint32SoftTable[0][Local_uint32First & 0xFFu];
+	}
+
+	return Copy_uint32State;
+}
+
+
+/*
+ * uint32_SoftFeedTail
+ * -------------------
+ * Tail bytes in software, one per word (0x000000bb).
+ */
+static uint32_t uint32_SoftFeedTail(uint32_t Copy_uint32State, const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length)
+{
+	uint32_t Local_uint32Word;
+
+	for( ; Copy_uint32Length != 0u; Copy_uint32Length--)
+	{
+		Local_uint32Word = *Copy_puint8Data;
+		Copy_uint32State = uint32_SoftFeedWords(Copy_uint32State, (const uint8_t*)&Local_uint32Word, 1u);
+		Copy_puint8Data++;
+	}
+
+	return Copy_uint32State;
+}
+
+
+/*
+ * uint8_UseUnit
+ * -------------
+ * Engine choice of a running CRC update ("Engine Choice" in BL_CRC.h): 1 when
+ * the words are fed to the CRC unit by DMA, 0 for the software CRC.
+ */
+static uint8_t uint8_UseUnit(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Words)
+{
+	return ((((uint32_t)Copy_puint8Data & 3u) == 0u) && (Copy_uint32Words >= (BL_CRC_SOFT_DMA_LENGTH / 4u)) &&
+	        (((uint32_t)Copy_puint8Data < CCMDATARAM_BASE) || ((uint32_t)Copy_puint8Data > CCMDATARAM_END))) ? 1u : 0u;
+}
+
+
+/*
+ * BL_uint32CRCSoftCalculate
+ * -------------------------
+ * Word-wise CRC (BL_CRC.h) of a memory range in software: same value as
+ * BL_uint32CRCCalculate, the CRC unit is not touched.
+ */
+uint32_t BL_uint32CRCSoftCalculate(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length)
+{
+	uint32_t Local_uint32State = uint32_SoftFeedWords(CRC_INITIAL_VALUE, Copy_puint8Data, Copy_uint32Length / 4u);
+
+	return uint32_SoftFeedTail(Local_uint32State, &Copy_puint8Data[Copy_uint32Length & ~3u], Copy_uint32Length & 3u);
+}
+#endif
+
+
+/*
+ * BL_uint32CRCCalculate
+ * ---------------------
+ * Computes the word-wise CRC (BL_CRC.h) of a memory range, starting from a
+ * reset CRC unit: whole words (DMA-fed when large and aligned), then the
+ * tail bytes one per word.
+ *
+ * Return:
+ * -------
+ * @return uint32_t : The computed CRC.
+ */
+uint32_t BL_uint32CRCCalculate(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length)
+{
+	CRC->CR = CRC_CR_RESET;
+
+	voidFeedWords(Copy_puint8Data, Copy_uint32Length / 4u);
+	Copy_puint8Data += Copy_uint32Length & ~3u;
+
+	/* Tail bytes, one per word */
+	for(Copy_uint32Length &= 3u; Copy_uint32Length != 0u; Copy_uint32Length--)
+	{
+		CRC->DR = *Copy_puint8Data;
+		Copy_puint8Data++;
+	}
+
+	return CRC->DR;
+}
+
+
+/*
+ * BL_uint32CRCCalculateIEEE
+ * -------------------------
+ * Standard CRC-32 (BL_CRC.h, "IEEE CRC-32") of a memory range: whole words
+ * bit-reversed into a reset unit by the CPU (the DMA cannot reverse them),
+ * then the tail bytes on the reflected value in software.
+ *
+ * Return:
+ * -------
+ * @return uint32_t : The CRC, as zlib's crc32() computes it.
+ */
+uint32_t BL_uint32CRCCalculateIEEE(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length)
+{
+	uint32_t Local_uint32Words = Copy_uint32Length / 4u;
+	uint32_t Local_uint32Crc;
+	uint8_t  Local_uint8Bit;
+
+	CRC->CR = CRC_CR_RESET;
+
+	for( ; Local_uint32Words != 0u; Local_uint32Words--)
+	{
+		CRC->DR = __RBIT(__UNALIGNED_UINT32_READ(Copy_puint8Data));
+		Copy_puint8Data += 4u;
+	}
+
+	Local_uint32Crc = __RBIT(CRC->DR);
+
+	for(Copy_uint32Length &= 3u; Copy_uint32Length != 0u; Copy_uint32Length--)
+	{
+		Local_uint32Crc ^= *Copy_puint8Data;
+		Copy_puint8Data++;
+
+		for(Local_uint8Bit = 0; Local_uint8Bit < 8u; Local_uint8Bit++)
+		{
+			Local_uint32Crc = (Local_uint32Crc >> 1) ^ (BL_CRC_IEEE_POLYNOMIAL & (0u - (Local_uint32Crc & 1u)));
+		}
+	}
+
+	return ~Local_uint32Crc;
+}
+
+
+/*
+ * BL_voidCRCReset / BL_uint32CRCFeedBytes
+ * ---------------------------------------
+ * Byte-per-word CRC (0x000000bb per byte, BL_CRC_WORDWISE_ENABLE = 0): reset
+ * once, then feed any number of pieces; each call returns the CRC of
+ * everything fed since the reset. Not saved across other CRC users.
+ */
+void BL_voidCRCReset(void)
+{
+	CRC->CR = CRC_CR_RESET;
+}
+
+uint32_t BL_uint32CRCFeedBytes(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length)
+{
+	for( ; Copy_uint32Length != 0u; Copy_uint32Length--)
+	{
+		CRC->DR = *Copy_puint8Data;
+		Copy_puint8Data++;
+	}
+
+	return CRC->DR;
+}
+
+
+/*
+ * BL_voidCRCStreamStart
+ * ---------------------
+ * Starts an empty running CRC.
+ */
+void BL_voidCRCStreamStart(BL_CRCStream_t* Copy_pStream)
+{
+	Copy_pStream->State     = CRC_INITIAL_VALUE;
+	Copy_pStream->Length    = 0;
+	Copy_pStream->TailCount = 0;
+}
+
+
+/*
+ * BL_voidCRCStreamUpdate
+ * ----------------------
+ * Appends data to a running CRC.
+ *
+ * Behavior:
+ * ---------
+ * 1. Restores the CRC unit to the saved state.
+ * 2. Completes the unfinished word of the previous update, if any.
+ * 3. Feeds the whole words (DMA-fed when large and aligned), keeps the last
+ *    (length % 4) bytes for later:
+ *    they only become tail bytes (one per word) if nothing follows them.
+ * 4. Saves the CRC unit value.
+ * With BL_CRC_SOFT_ENABLE the unfinished word is completed in software and
+ * the whole words go to the engine uint8_UseUnit picks; the unit is only
+ * restored and read when it computes them.
+ */
+void BL_voidCRCStreamUpdate(BL_CRCStream_t* Copy_pStream, const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length)
+{
+	if(Copy_uint32Length == 0u)
+	{
+		return;
+	}
+
+#if !BL_CRC_SOFT_ENABLE
+	voidRestoreCRC(Copy_pStream->State);
+#endif
+	Copy_pStream->Length += Copy_uint32Length;
+
+	while((Copy_pStream->TailCount != 0u) && (Copy_uint32Length != 0u))
+	{
+		Copy_pStream->Tail[Copy_pStream->TailCount] = *Copy_puint8Data;
+		Copy_pStream->TailCount = (uint8_t)((Copy_pStream->TailCount + 1u) & 3u);
+		Copy_puint8Data++;
+		Copy_uint32Length--;
+
+		if(Copy_pStream->TailCount == 0u)
+		{
+#if BL_CRC_SOFT_ENABLE
+			Copy_pStream->State = uint32_SoftFeedWords(Copy_pStream->State, Copy_pStream->Tail, 1u);
+#else
+			CRC->DR = __UNALIGNED_UINT32_READ(Copy_pStream->Tail);
+#endif
+		}
+	}
+
+#if BL_CRC_SOFT_ENABLE
+	if(uint8_UseUnit(Copy_puint8Data, Copy_uint32Length / 4u) != 0u)
+	{
+		voidRestoreCRC(Copy_pStream->State);
+		voidFeedWords(Copy_puint8Data, Copy_uint32Length / 4u);
+		Copy_pStream->State = CRC->DR;
+	}
+	else
+	{
+		Copy_pStream->State = uint32_SoftFeedWords(Copy_pStream->State, Copy_puint8Data, Copy_uint32Length / 4u);
+	}
+#else
+	voidFeedWords(Copy_puint8Data, Copy_uint32Length / 4u);
+#endif
+	Copy_puint8Data   += Copy_uint32Length & ~3u;
+	Copy_uint32Length &= 3u;
+
+	for( ; Copy_uint32Length != 0u; Copy_uint32Length--)
+	{
+		Copy_pStream->Tail[Copy_pStream->TailCount] = *Copy_puint8Data;
+		Copy_pStream->TailCount++;
+		Copy_puint8Data++;
+	}
+
+#if !BL_CRC_SOFT_ENABLE
+	Copy_pStream->State = CRC->DR;
+#endif
+}
+
+
+/*
+ * BL_uint32CRCStreamFinish
+ * ------------------------
+ * Returns the CRC of everything fed so far, the unfinished word fed as tail
+ * bytes (in software with BL_CRC_SOFT_ENABLE). The context is not changed,
+ * more data may still be appended.
+ */
+uint32_t BL_uint32CRCStreamFinish(const BL_CRCStream_t* Copy_pStream)
+{
+#if BL_CRC_SOFT_ENABLE
+	return uint32_SoftFeedTail(Copy_pStream->State, Copy_pStream->Tail, Copy_pStream->TailCount);
+#else
+	uint8_t Local_uint8Iterator;
+
+	voidRestoreCRC(Copy_pStream->State);
+
+	for(Local_uint8Iterator = 0; Local_uint8Iterator < Copy_pStream->TailCount; Local_uint8Iterator++)
+	{
+		CRC->DR = Copy_pStream->Tail[Local_uint8Iterator];
+	}
+
+	return CRC->DR;
+#endif
+}
+
+
+/*
+ * BL_uint8CRCCheckFrame
+ * ---------------------
+ * Checks the CRC of a complete frame (trailer included) for the receive
+ * interrupt, see "Frame Pre-Check" in BL_CRC.h.
+ *
+ * Behavior:
+ * ---------
+ * 1. Returns BL_CRC_FRAME_UNCHECKED while the CRC DMA stream is enabled.
+ * 2. Saves the CRC unit, computes the frame CRC by CPU from a reset unit,
+ *    then restores the saved value: an interrupted CPU-fed CRC in thread
+ *    context continues as if nothing happened.
+ *
+ * Return:
+ * -------
+ * @return uint8_t : BL_CRC_FRAME_OK / BL_CRC_FRAME_BAD / BL_CRC_FRAME_UNCHECKED.
+ */
+__RAM_FUNC uint8_t BL_uint8CRCCheckFrame(const uint8_t* Copy_puint8Frame, uint16_t Copy_uint16Length)
+{
+	uint32_t Local_uint32Saved;
+	uint32_t Local_uint32HostCRC;
+	uint32_t Local_uint32CRC;
+	uint16_t Local_uint16Length = (uint16_t)(Copy_uint16Length - 4u);
+	uint16_t Local_uint16Iterator = 0;
+
+	if((DMA2_Stream1->CR & DMA_SxCR_EN) != 0u)
+	{
+		return BL_CRC_FRAME_UNCHECKED;
+	}
+
+	Local_uint32Saved = CRC->DR;
+	CRC->CR = CRC_CR_RESET;
+
+#if BL_CRC_WORDWISE_ENABLE
+	for( ; (Local_uint16Iterator + 4u) <= Local_uint16Length; Local_uint16Iterator += 4u)
+	{
+		CRC->DR = __UNALIGNED_UINT32_READ(&Copy_puint8Frame[Local_uint16Iterator]);
+	}
+#endif
+	for( ; Local_uint16Iterator < Local_uint16Length; Local_uint16Iterator++)
+	{
+		CRC->DR = Copy_puint8Frame[Local_uint16Iterator];
+	}
+
+	Local_uint32CRC = CRC->DR;
+	voidRestoreCRC(Local_uint32Saved);
+
+	Local_uint32HostCRC = __UNALIGNED_UINT32_READ(&Copy_puint8Frame[Local_uint16Length]);
+
+	return (Local_uint32CRC == Local_uint32HostCRC) ? BL_CRC_FRAME_OK : BL_CRC_FRAME_BAD;
+}
+
+
+/*
+ * BL_uint8CRCCheckFrameStart
+ * --------------------------
+ * Starts the DMA check of a complete frame (trailer included), see
+ * "Frame Check By DMA" in BL_CRC.h. Thread or interrupt context, while no
+ * other CRC is computed.
+ *
+ * Behavior:
+ * ---------
+ * 1. Returns BL_CRC_FRAME_UNCHECKED while the stream is enabled or a check
+ *    is still unpolled, and for frames with less than one word before the CRC.
+ * 2. Saves the unit, resets it and feeds the whole words before the CRC by
+ *    DMA2 Stream1, byte-wide source (NDTR in bytes), polled: no interrupt.
+ *
+ * Return:
+ * -------
+ * @return uint8_t : BL_CRC_FRAME_PENDING / BL_CRC_FRAME_UNCHECKED.
+ */
+__RAM_FUNC uint8_t BL_uint8CRCCheckFrameStart(const uint8_t* Copy_puint8Frame, uint16_t Copy_uint16Length)
+{
+#if BL_CRC_WORDWISE_ENABLE
+	uint16_t Local_uint16Bytes = (uint16_t)((Copy_uint16Length - 4u) & ~3u);
+
+	if(((DMA2_Stream1->CR & DMA_SxCR_EN) != 0u) || (Global_puint8AsyncFrame != NULL) || (Local_uint16Bytes == 0u))
+	{
+		return BL_CRC_FRAME_UNCHECKED;
+	}
+
+	Global_uint32AsyncSaved  = CRC->DR;
+	Global_uint16AsyncLength = Copy_uint16Length;
+	Global_puint8AsyncFrame  = Copy_puint8Frame;
+	CRC->CR = CRC_CR_RESET;
+
+	DMA2->LIFCR         = CRC_DMA_STREAM1_FLAGS;
+	DMA2_Stream1->CR   &= ~DMA_SxCR_PSIZE;
+	DMA2_Stream1->NDTR  = Local_uint16Bytes;
+	DMA2_Stream1->PAR   = (uint32_t)Copy_puint8Frame;
+	DMA2_Stream1->M0AR  = (uint32_t)&CRC->DR;
+	DMA2_Stream1->CR   |= DMA_SxCR_EN;
+
+	return BL_CRC_FRAME_PENDING;
+#else
+	(void)Copy_puint8Frame;
+	(void)Copy_uint16Length;
+
+	return BL_CRC_FRAME_UNCHECKED;
+#endif
+}
+
+
+/*
+ * BL_uint8CRCCheckFramePoll
+ * -------------------------
+ * Result of the check BL_uint8CRCCheckFrameStart started.
+ *
+ * Behavior:
+ * ---------
+ * 1. BL_CRC_FRAME_UNCHECKED when no check is running.
+ * 2. While the stream runs: BL_CRC_FRAME_PENDING, or with Copy_uint8Wait
+ *    waits for it (about 1 us per 128 bytes).
+ * 3. Done: the tail bytes go in one per word, the result is compared with the
+ *    frame's trailer, the stream gets its word-wide source back (voidFeedWords)
+ *    and the unit its saved value. A transfer error leaves the frame
+ *    BL_CRC_FRAME_UNCHECKED for the dispatcher.
+ *
+ * Return:
+ * -------
+ * @return uint8_t : BL_CRC_FRAME_OK / BAD / PENDING / UNCHECKED.
+ */
+__RAM_FUNC uint8_t BL_uint8CRCCheckFramePoll(uint8_t Copy_uint8Wait)
+{
+#if BL_CRC_WORDWISE_ENABLE
+	const uint8_t* Local_puint8Frame = Global_puint8AsyncFrame;
+	uint16_t Local_uint16Length = (uint16_t)(Global_uint16AsyncLength - 4u);
+	uint16_t Local_uint16Iterator;
+	uint8_t  Local_uint8Status = BL_CRC_FRAME_UNCHECKED;
+
+	if(Local_puint8Frame == NULL)
+	{
+		return BL_CRC_FRAME_UNCHECKED;
+	}
+
+	while((DMA2->LISR & (DMA_LISR_TCIF1 | DMA_LISR_TEIF1)) == 0u)
+	{
+		if(Copy_uint8Wait == 0u)
+		{
+			return BL_CRC_FRAME_PENDING;
+		}
+	}
+
+	if((DMA2->LISR & DMA_LISR_TEIF1) == 0u)
+	{
+		for(Local_uint16Iterator = (uint16_t)(Local_uint16Length & ~3u); Local_uint16Iterator < Local_uint16Length; Local_uint16Iterator++)
+		{
+			CRC->DR = Local_puint8Frame[Local_uint16Iterator];
+		}
+
+		Local_uint8Status = (CRC->DR == __UNALIGNED_UINT32_READ(&Local_puint8Frame[Local_uint16Length])) ? BL_CRC_FRAME_OK : BL_CRC_FRAME_BAD;
+	}
+
+	DMA2_Stream1->CR &= ~DMA_SxCR_EN;
+	while((DMA2_Stream1->CR & DMA_SxCR_EN) != 0u)
+	{
+	}
+	DMA2_Stream1->CR |= DMA_SxCR_PSIZE_1;
+	DMA2->LIFCR = CRC_DMA_STREAM1_FLAGS;
+
+	voidRestoreCRC(Global_uint32AsyncSaved);
+	Global_puint8AsyncFrame = NULL;
+
+	return Local_uint8Status;
+#else
+	(void)Copy_uint8Wait;
+
+	return BL_CRC_FRAME_UNCHECKED;
+#endif
+}
@@ -0,0 +1,1096 @@
+
+#include <string.h>
+#include "main.h"
+#include "BL_Flash.h"
+#include "BL_Transport.h"
+#include "BL_Trace.h"
+#include "BL_Port.h"
+#include "BL_SlotCache.h"
+
+
+/* Exceptions (16) plus STM32F407 interrupts (FPU_IRQn is the last one) */
+#define VECTOR_TABLE_ENTRIES          (16u + (uint32_t)FPU_IRQn + 1u)
+
+/* Error flags reported by the flash interface after an operation */
+#define FLASH_ERROR_FLAGS             (FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_PGSERR)
+
+/* VREFINT conversion, factory calibration (RM0090 / datasheet): raw value at VDDA = 3.3 V */
+#define VREFINT_CAL                   (*(const volatile uint16_t*)0x1FFF7A2AUL)
+#define VREFINT_CAL_MV                3300UL
+#define VREFINT_CHANNEL               17u
+
+/* Program units (bytes, half-words or words) between two IWDG refreshes and error checks: a few ms at most */
+#define PROGRAM_SLICE_UNITS           256u
+
+/* A source word read in one load when the source is aligned */
+typedef uint32_t BL_FlashWord_t __attribute__((may_alias));
+
+
+/*
+ * Global_uint32VectorTable
+ * ------------------------
+ * SRAM copy of the vector table. The Cortex-M4 fetches the handler address
+ * from the table on every exception, so a table in flash would stall each
+ * interrupt until the flash operation ends.
+ * VTOR needs the table aligned to its size rounded up to a power of two (512 bytes).
+ */
+static uint32_t Global_uint32VectorTable[VECTOR_TABLE_ENTRIES] __attribute__((aligned(512)));
+
+/*
+ * Global_FlashSectors
+ * -------------------
+ * Sector layout, sorted by base address (required by BL_uint8FlashGetSector).
+ */
+static const BL_FlashSector_t Global_FlashSectors[BL_FLASH_SECTOR_COUNT] =
+{
+	{ 0x08000000UL, 0x04000UL },                /* Sector 0  :  16 KB */
+	{ 0x08004000UL, 0x04000UL },                /* Sector 1  :  16 KB */
+	{ 0x08008000UL, 0x04000UL },                /* Sector 2  :  16 KB */
+	{ 0x0800C000UL, 0x04000UL },                /* Sector 3  :  16 KB */
+	{ 0x08010000UL, 0x10000UL },                /* Sector 4  :  64 KB */
+	{ 0x08020000UL, 0x20000UL },                /* Sector 5  : 128 KB */
+	{ 0x08040000UL, 0x20000UL },                /* Sector 6  : 128 KB */
+	{ 0x08060000UL, 0x20000UL },                /* Sector 7  : 128 KB */
+	{ 0x08080000UL, 0x20000UL },                /* Sector 8  : 128 KB */
+	{ 0x080A0000UL, 0x20000UL },                /* Sector 9  : 128 KB */
+	{ 0x080C0000UL, 0x20000UL },                /* Sector 10 : 128 KB */
+	{ 0x080E0000UL, 0x20000UL }                 /* Sector 11 : 128 KB */
+};
+
+/*
+ * Global_uint8Parallelism / Global_uint32Psize
+ * --------------------------------------------
+ * BL_FLASH_PSIZE_xxx in use and its FLASH_CR PSIZE bits, x32 until the first
+ * selection; Global_uint16VddMv the VDD it was chosen for.
+ */
+static uint8_t  Global_uint8Parallelism = BL_FLASH_PSIZE_X32;
+static uint32_t Global_uint32Psize      = FLASH_CR_PSIZE_1;
+static uint16_t Global_uint16VddMv;
+
+/* Result of the last erase started with BL_voidFlashEraseSectorStart */
+static volatile uint8_t Global_uint8EraseResult = HAL_OK;
+
+#if BL_WEAR_STATS_ENABLE
+/* Erases started per sector since the counts were last written to the journal (BL_Journal.h) */
+static uint16_t Global_uint16EraseCounts[BL_FLASH_SECTOR_COUNT];
+#endif
+
+#if BL_STATS_ENABLE
+/* Operation times (BL_Flash.h), and the start of the erase the FLASH interrupt ends */
+static BL_FlashTiming_t Global_FlashTiming;
+static uint32_t         Global_uint32EraseStartCycles;
+static uint8_t          Global_uint8EraseClass;
+#endif
+
+
+/*
+ * voidWaitBusy
+ * ------------
+ * Waits for the current flash operation to end, nothing else: the error
+ * flags stay set until uint8_TakeFlashErrors, so a run of program units
+ * checks them once.
+ */
+__RAM_FUNC static inline __attribute__((always_inline)) void voidWaitBusy(void)
+{
+	while((FLASH->SR & FLASH_SR_BSY) != 0u)
+	{
+	}
+}
+
+
+/*
+ * uint8_TakeFlashErrors
+ * ---------------------
+ * Reports and clears the error flags of the operations since the last call.
+ */
+__RAM_FUNC static uint8_t uint8_TakeFlashErrors(void)
+{
+	uint8_t Local_uint8Status = HAL_OK;
+
+	if((FLASH->SR & FLASH_ERROR_FLAGS) != 0u)
+	{
+		FLASH->SR = FLASH_ERROR_FLAGS;          /* Write 1 to clear */
+		Local_uint8Status = HAL_ERROR;
+	}
+
+	FLASH->SR = FLASH_SR_EOP;
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * uint8_WaitForFlash
+ * ------------------
+ * Waits for the current flash operation to end, then reports and clears its
+ * error flags. Runs from RAM, interrupts are serviced meanwhile.
+ */
+__RAM_FUNC static uint8_t uint8_WaitForFlash(void)
+{
+	voidWaitBusy();
+
+	return uint8_TakeFlashErrors();
+}
+
+
+/*
+ * voidFlushCaches
+ * ---------------
+ * Resets the ART instruction and data caches after an erase, so stale lines
+ * of the erased sector are not served (same as HAL FLASH_FlushCaches).
+ */
+__RAM_FUNC static void voidFlushCaches(void)
+{
+	if((FLASH->ACR & FLASH_ACR_ICEN) != 0u)
+	{
+		FLASH->ACR &= ~FLASH_ACR_ICEN;
+		FLASH->ACR |= FLASH_ACR_ICRST;
+		FLASH->ACR &= ~FLASH_ACR_ICRST;
+		FLASH->ACR |= FLASH_ACR_ICEN;
+	}
+
+	if((FLASH->ACR & FLASH_ACR_DCEN) != 0u)
+	{
+		FLASH->ACR &= ~FLASH_ACR_DCEN;
+		FLASH->ACR |= FLASH_ACR_DCRST;
+		FLASH->ACR &= ~FLASH_ACR_DCRST;
+		FLASH->ACR |= FLASH_ACR_DCEN;
+	}
+}
+
+
+#if BL_WEAR_STATS_ENABLE
+/*
+ * voidCountErase
+ * --------------
+ * One more erase of a sector, counted when it is started (a failed erase
+ * wears the sector all the same).
+ */
+__RAM_FUNC static void voidCountErase(uint8_t Copy_uint8Sector)
+{
+	if((Copy_uint8Sector < BL_FLASH_SECTOR_COUNT) && (Global_uint16EraseCounts[Copy_uint8Sector] != 0xFFFFu))
+	{
+		Global_uint16EraseCounts[Copy_uint8Sector]++;
+	}
+}
+#endif
+
+
+#if BL_SLOT_CACHE_ENABLE
+/*
+ * voidInvalidateSector
+ * --------------------
+ * A sector is about to be erased: the slot cache forgets its blocks.
+ */
+__RAM_FUNC static void voidInvalidateSector(uint8_t Copy_uint8Sector)
+{
+	if(Copy_uint8Sector < BL_FLASH_SECTOR_COUNT)
+	{
+		BL_voidSlotCacheInvalidate(Global_FlashSectors[Copy_uint8Sector].Base, Global_FlashSectors[Copy_uint8Sector].Size);
+	}
+}
+#endif
+
+
+#if BL_STATS_ENABLE
+/*
+ * uint8_GetSectorClass
+ * --------------------
+ * BL_FLASH_CLASS_xxx of a sector, from its size.
+ */
+__RAM_FUNC static uint8_t uint8_GetSectorClass(uint8_t Copy_uint8Sector)
+{
+	uint32_t Local_uint32Size = Global_FlashSectors[Copy_uint8Sector].Size;
+
+	return (Local_uint32Size == 0x04000UL) ? BL_FLASH_CLASS_16KB :
+	       (Local_uint32Size == 0x10000UL) ? BL_FLASH_CLASS_64KB : BL_FLASH_CLASS_128KB;
+}
+
+
+/*
+ * voidRecordTiming
+ * ----------------
+ * One operation that started at Copy_uint32StartCycles and ended now, in its
+ * histogram: the bucket is the bit length of the time in microseconds.
+ */
+__RAM_FUNC static void voidRecordTiming(BL_FlashHistogram_t* Copy_pHistogram, uint32_t Copy_uint32StartCycles, uint32_t Copy_uint32Units)
+{
+	uint32_t Local_uint32Us     = (DWT->CYCCNT - Copy_uint32StartCycles) / (SystemCoreClock / 1000000UL);
+	uint32_t Local_uint32Bucket = (Local_uint32Us == 0u) ? 0u : (32u - __CLZ(Local_uint32Us));
+
+	if(Local_uint32Bucket >= BL_FLASH_TIMING_BUCKETS)
+	{
+		Local_uint32Bucket = BL_FLASH_TIMING_BUCKETS - 1u;
+	}
+
+	Copy_pHistogram->Counts[Local_uint32Bucket]++;
+	Copy_pHistogram->TotalUs += Local_uint32Us;
+	Copy_pHistogram->Units   += Copy_uint32Units;
+	if(Local_uint32Us > Copy_pHistogram->MaxUs)
+	{
+		Copy_pHistogram->MaxUs = Local_uint32Us;
+	}
+}
+#endif
+
+
+/*
+ * BL_voidFlashInit
+ * ----------------
+ * Copies the vector table to SRAM and points VTOR at it, and enables the
+ * FLASH interrupt. Must run before the first flash operation.
+ */
+void BL_voidFlashInit(void)
+{
+	const uint32_t* Local_puint32Source = (const uint32_t*)SCB->VTOR;
+	uint32_t Local_uint32Iterator;
+	uint32_t Local_uint32Irq;
+
+	for(Local_uint32Iterator = 0; Local_uint32Iterator < VECTOR_TABLE_ENTRIES; Local_uint32Iterator++)
+	{
+		Global_uint32VectorTable[Local_uint32Iterator] = Local_puint32Source[Local_uint32Iterator];
+	}
+
+	Local_uint32Irq = BL_PORT_IRQ_SAVE();
+	SCB->VTOR = (uint32_t)Global_uint32VectorTable;
+	__DSB();
+	BL_PORT_IRQ_RESTORE(Local_uint32Irq);
+
+	/* End of operation / error interrupt of BL_voidFlashEraseSectorStart (BL_IRQ_PRIORITY_FLASH) */
+	HAL_NVIC_EnableIRQ(FLASH_IRQn);
+
+	(void)BL_uint8FlashSelectParallelism();
+}
+
+
+#if (BL_FLASH_PARALLELISM == 0)
+/*
+ * uint16_MeasureVdd
+ * -----------------
+ * VDD (= VDDA on this board) in mV from VREFINT: ADC1 is powered up for
+ * the measurement only, channel 17 sampled 480 cycles (VREFINT needs 10 us),
+ * the first conversion discarded, BL_FLASH_VDD_SAMPLES averaged.
+ * 0 when a conversion reads 0.
+ */
+static uint16_t uint16_MeasureVdd(void)
+{
+	uint32_t Local_uint32Sum = 0u;
+	uint32_t Local_uint32Raw = 1u;
+	uint8_t  Local_uint8Sample;
+
+	RCC->APB2ENR |= RCC_APB2ENR_ADC1EN;
+	(void)RCC->APB2ENR;
+
+	ADC123_COMMON->CCR = (ADC123_COMMON->CCR & ~ADC_CCR_ADCPRE) | ADC_CCR_ADCPRE_0 | ADC_CCR_TSVREFE;  /* PCLK2 / 4 */
+	ADC1->CR1   = 0u;                                               /* 12 bits, single channel */
+	ADC1->SMPR1 = ADC_SMPR1_SMP17;                                  /* 480 cycles */
+	ADC1->SQR1  = 0u;                                               /* One conversion */
+	ADC1->SQR3  = VREFINT_CHANNEL;
+	ADC1->CR2   = ADC_CR2_ADON;
+
+	for(Local_uint8Sample = 0; (Local_uint8Sample <= BL_FLASH_VDD_SAMPLES) && (Local_uint32Raw != 0u); Local_uint8Sample++)
+	{
+		ADC1->SR   = 0u;
+		ADC1->CR2 |= ADC_CR2_SWSTART;
+		while((ADC1->SR & ADC_SR_EOC) == 0u)
+		{
+		}
+
+		Local_uint32Raw = ADC1->DR;
+		if(Local_uint8Sample != 0u)
+		{
+			Local_uint32Sum += Local_uint32Raw;
+		}
+	}
+
+	ADC1->CR2 = 0u;
+	ADC123_COMMON->CCR &= ~ADC_CCR_TSVREFE;
+	RCC->APB2ENR &= ~RCC_APB2ENR_ADC1EN;
+
+	return (Local_uint32Raw == 0u) ? 0u : (uint16_t)((VREFINT_CAL_MV * VREFINT_CAL * BL_FLASH_VDD_SAMPLES) / Local_uint32Sum);
+}
+#endif
+
+
+/*
+ * BL_uint8FlashSelectParallelism
+ * ------------------------------
+ * Sets the parallelism of every following program and erase: the widest the
+ * measured VDD allows (x8 when the measurement failed), or the one fixed by
+ * BL_FLASH_PARALLELISM. Called at start-up and at each session start, never
+ * while an operation runs.
+ *
+ * Return:
+ * -------
+ *  BL_FLASH_PSIZE_xxx.
+ */
+uint8_t BL_uint8FlashSelectParallelism(void)
+{
+#if (BL_FLASH_PARALLELISM == 0)
+	Global_uint16VddMv = uint16_MeasureVdd();
+
+	Global_uint8Parallelism = (Global_uint16VddMv >= BL_FLASH_VDD_X32_MV) ? BL_FLASH_PSIZE_X32 :
+	                          (Global_uint16VddMv >= BL_FLASH_VDD_X16_MV) ? BL_FLASH_PSIZE_X16 : BL_FLASH_PSIZE_X8;
+#else
+	Global_uint8Parallelism = BL_FLASH_PARALLELISM;
+#endif
+
+	Global_uint32Psize = (Global_uint8Parallelism == BL_FLASH_PSIZE_X32) ? FLASH_CR_PSIZE_1 :
+	                     (Global_uint8Parallelism == BL_FLASH_PSIZE_X16) ? FLASH_CR_PSIZE_0 : 0u;
+
+	return Global_uint8Parallelism;
+}
+
+
+/*
+ * BL_uint8FlashGetParallelism / BL_uint16FlashGetVdd
+ * --------------------------------------------------
+ * The last selection, for BL_GET_CAPABILITIES.
+ */
+uint8_t BL_uint8FlashGetParallelism(void)
+{
+	return Global_uint8Parallelism;
+}
+
+uint16_t BL_uint16FlashGetVdd(void)
+{
+	return Global_uint16VddMv;
+}
+
+
+#if BL_FLASH_HAL_PROGRAM
+/*
+ * uint8_ProgramHal
+ * ----------------
+ * BL_FLASH_HAL_PROGRAM: the same head / body / tail split, one
+ * HAL_FLASH_Program call (lock, PSIZE / PG set-up, timed wait) per unit.
+ * Runs from flash, so the CPU stalls on every unit.
+ */
+static uint8_t uint8_ProgramHal(uint32_t Copy_uint32Address, const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length)
+{
+	uint8_t  Local_uint8Status = HAL_OK;
+	uint8_t  Local_uint8Step;
+	uint16_t Local_uint16Iterator = 0;
+	uint16_t Local_uint16Units = 0;
+	uint32_t Local_uint32Address;
+	const uint8_t* Local_puint8Data;
+
+	while((Local_uint8Status == HAL_OK) && (Local_uint16Iterator < Copy_uint16Length))
+	{
+		Local_uint32Address = Copy_uint32Address + Local_uint16Iterator;
+		Local_puint8Data    = &Copy_puint8Data[Local_uint16Iterator];
+		Local_uint8Step     = Global_uint8Parallelism;
+		if(((Local_uint32Address & (Local_uint8Step - 1u)) != 0u) || ((Copy_uint16Length - Local_uint16Iterator) < Local_uint8Step))
+		{
+			Local_uint8Step = BL_FLASH_PSIZE_X8;
+		}
+
+		switch(Local_uint8Step)
+		{
+		case BL_FLASH_PSIZE_X32:
+			Local_uint8Status = (uint8_t)HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, Local_uint32Address,
+			                     (uint32_t)Local_puint8Data[0] | ((uint32_t)Local_puint8Data[1] << 8) |
+			                    ((uint32_t)Local_puint8Data[2] << 16) | ((uint32_t)Local_puint8Data[3] << 24));
+			break;
+		case BL_FLASH_PSIZE_X16:
+			Local_uint8Status = (uint8_t)HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, Local_uint32Address,
+			                     (uint32_t)Local_puint8Data[0] | ((uint32_t)Local_puint8Data[1] << 8));
+			break;
+		default:
+			Local_uint8Status = (uint8_t)HAL_FLASH_Program(FLASH_TYPEPROGRAM_BYTE, Local_uint32Address, Local_puint8Data[0]);
+			break;
+		}
+
+		Local_uint16Iterator = (uint16_t)(Local_uint16Iterator + Local_uint8Step);
+		if((++Local_uint16Units % PROGRAM_SLICE_UNITS) == 0u)
+		{
+			BL_PORT_WATCHDOG_REFRESH();
+		}
+	}
+
+	return (Local_uint8Status == HAL_OK) ? HAL_OK : HAL_ERROR;
+}
+#endif
+
+
+/*
+ * BL_uint8FlashProgram
+ * --------------------
+ * Programs Copy_uint16Length bytes at Copy_uint32Address.
+ *
+ * Behavior:
+ * ---------
+ *  - PG is set once for the whole call and PSIZE once per part.
+ *  - Head bytes up to an address aligned to the parallelism, with byte
+ *    parallelism (PSIZE x8).
+ *  - The body in words (x32) or half-words (x16), as selected for the supply
+ *    (BL_uint8FlashSelectParallelism). With x8 everything after the head is
+ *    programmed as tail.
+ *  - Remaining tail bytes with byte parallelism.
+ *  - Each unit is a store and a BSY poll. The error flags are checked after
+ *    the head, after every PROGRAM_SLICE_UNITS units and at the end, and
+ *    the first error stops the rest.
+ *  - Refreshes the IWDG on entry and every PROGRAM_SLICE_UNITS units.
+ * The source may be unaligned: words are then assembled byte by byte (no
+ * library call, the whole loop stays in RAM); from an aligned source they
+ * are read whole. With BL_FLASH_HAL_PROGRAM the units go through
+ * HAL_FLASH_Program instead (uint8_ProgramHal), for comparison.
+ *
+ * Return:
+ * -------
+ *  HAL_OK or HAL_ERROR.
+ */
+__RAM_FUNC uint8_t BL_uint8FlashProgram(uint32_t Copy_uint32Address, const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length)
+{
+	uint8_t  Local_uint8Status = uint8_WaitForFlash();
+#if !BL_FLASH_HAL_PROGRAM
+	uint8_t  Local_uint8Unit = Global_uint8Parallelism;
+	uint16_t Local_uint16Iterator = 0;
+	uint16_t Local_uint16End;
+#endif
+#if BL_STATS_ENABLE
+	uint32_t Local_uint32StartCycles = DWT->CYCCNT;
+	uint8_t  Local_uint8Sector;
+#endif
+
+	BL_TRACE(BL_TRACE_PROGRAM_START, Copy_uint16Length, Copy_uint32Address);
+	BL_PORT_WATCHDOG_REFRESH();
+#if BL_SLOT_CACHE_ENABLE
+	BL_voidSlotCacheInvalidate(Copy_uint32Address, Copy_uint16Length);
+#endif
+
+#if BL_FLASH_HAL_PROGRAM
+	if(Local_uint8Status == HAL_OK)
+	{
+		Local_uint8Status = uint8_ProgramHal(Copy_uint32Address, Copy_puint8Data, Copy_uint16Length);
+	}
+#else
+	FLASH->CR &= ~FLASH_CR_PSIZE;               /* x8 */
+	FLASH->CR |= FLASH_CR_PG;
+
+	/* Head: bytes up to the first address aligned to the parallelism */
+	while((Local_uint8Status == HAL_OK) && (Local_uint16Iterator < Copy_uint16Length) &&
+	      (((Copy_uint32Address + Local_uint16Iterator) & (Local_uint8Unit - 1u)) != 0u))
+	{
+		*(volatile uint8_t*)(Copy_uint32Address + Local_uint16Iterator) = Copy_puint8Data[Local_uint16Iterator];
+		voidWaitBusy();
+		Local_uint16Iterator++;
+	}
+	if(Local_uint8Status == HAL_OK)
+	{
+		Local_uint8Status = uint8_TakeFlashErrors();
+	}
+
+	/* Body: whole words, or half-words with x16, one slice at a time */
+	FLASH->CR |= Global_uint32Psize;
+	while((Local_uint8Unit == BL_FLASH_PSIZE_X32) && (Local_uint8Status == HAL_OK) && ((Copy_uint16Length - Local_uint16Iterator) >= 4u))
+	{
+		Local_uint16End = (uint16_t)(Local_uint16Iterator + ((Copy_uint16Length - Local_uint16Iterator) & ~3u));
+		if((Local_uint16End - Local_uint16Iterator) > (PROGRAM_SLICE_UNITS * 4u))
+		{
+			Local_uint16End = (uint16_t)(Local_uint16Iterator + (PROGRAM_SLICE_UNITS * 4u));
+		}
+
+		if((((uint32_t)&Copy_puint8Data[Local_uint16Iterator]) & 3u) == 0u)
+		{
+			for(; Local_uint16Iterator < Local_uint16End; Local_uint16Iterator += 4u)
+			{
+				*(volatile uint32_t*)(Copy_uint32Address + Local_uint16Iterator) = *(const BL_FlashWord_t*)&Copy_puint8Data[Local_uint16Iterator];
+				voidWaitBusy();
+			}
+		}
+		else
+		{
+			for(; Local_uint16Iterator < Local_uint16End; Local_uint16Iterator += 4u)
+			{
+				*(volatile uint32_t*)(Copy_uint32Address + Local_uint16Iterator) =
+					(uint32_t)Copy_puint8Data[Local_uint16Iterator]               |
+				   ((uint32_t)Copy_puint8Data[Local_uint16Iterator + 1u] << 8)    |
+				   ((uint32_t)Copy_puint8Data[Local_uint16Iterator + 2u] << 16)   |
+				   ((uint32_t)Copy_puint8Data[Local_uint16Iterator + 3u] << 24);
+				voidWaitBusy();
+			}
+		}
+
+		Local_uint8Status = uint8_TakeFlashErrors();
+		BL_PORT_WATCHDOG_REFRESH();
+	}
+
+	while((Local_uint8Unit == BL_FLASH_PSIZE_X16) && (Local_uint8Status == HAL_OK) && ((Copy_uint16Length - Local_uint16Iterator) >= 2u))
+	{
+		Local_uint16End = (uint16_t)(Local_uint16Iterator + ((Copy_uint16Length - Local_uint16Iterator) & ~1u));
+		if((Local_uint16End - Local_uint16Iterator) > (PROGRAM_SLICE_UNITS * 2u))
+		{
+			Local_uint16End = (uint16_t)(Local_uint16Iterator + (PROGRAM_SLICE_UNITS * 2u));
+		}
+
+		for(; Local_uint16Iterator < Local_uint16End; Local_uint16Iterator += 2u)
+		{
+			*(volatile uint16_t*)(Copy_uint32Address + Local_uint16Iterator) =
+				(uint16_t)((uint16_t)Copy_puint8Data[Local_uint16Iterator] | ((uint16_t)Copy_puint8Data[Local_uint16Iterator + 1u] << 8));
+			voidWaitBusy();
+		}
+
+		Local_uint8Status = uint8_TakeFlashErrors();
+		BL_PORT_WATCHDOG_REFRESH();
+	}
+
+	/* Tail: remaining bytes, all of them with x8 */
+	FLASH->CR &= ~FLASH_CR_PSIZE;               /* x8 */
+	while((Local_uint8Status == HAL_OK) && (Local_uint16Iterator < Copy_uint16Length))
+	{
+		Local_uint16End = Copy_uint16Length;
+		if((Local_uint16End - Local_uint16Iterator) > PROGRAM_SLICE_UNITS)
+		{
+			Local_uint16End = (uint16_t)(Local_uint16Iterator + PROGRAM_SLICE_UNITS);
+		}
+
+		for(; Local_uint16Iterator < Local_uint16End; Local_uint16Iterator++)
+		{
+			*(volatile uint8_t*)(Copy_uint32Address + Local_uint16Iterator) = Copy_puint8Data[Local_uint16Iterator];
+			voidWaitBusy();
+		}
+
+		Local_uint8Status = uint8_TakeFlashErrors();
+		BL_PORT_WATCHDOG_REFRESH();
+	}
+
+	FLASH->CR &= ~FLASH_CR_PG;
+#endif
+
+#if BL_STATS_ENABLE
+	/* OTP and option bytes are timed by nobody */
+	Local_uint8Sector = BL_uint8FlashGetSector(Copy_uint32Address);
+	if((Local_uint8Status == HAL_OK) && (Local_uint8Sector != BL_FLASH_INVALID_SECTOR))
+	{
+		voidRecordTiming(&Global_FlashTiming.Program[uint8_GetSectorClass(Local_uint8Sector)], Local_uint32StartCycles, Copy_uint16Length);
+	}
+#endif
+
+	BL_TRACE(BL_TRACE_PROGRAM_END, 0u, Local_uint8Status);
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * BL_uint8FlashEraseSector
+ * ------------------------
+ * Erases one sector with the selected parallelism.
+ *
+ * Return:
+ * -------
+ *  HAL_OK or HAL_ERROR.
+ */
+__RAM_FUNC uint8_t BL_uint8FlashEraseSector(uint8_t Copy_uint8Sector)
+{
+	uint8_t Local_uint8Status = uint8_WaitForFlash();
+#if BL_STATS_ENABLE
+	uint32_t Local_uint32StartCycles = DWT->CYCCNT;
+#endif
+
+	if(Local_uint8Status == HAL_OK)
+	{
+#if BL_SLOT_CACHE_ENABLE
+		voidInvalidateSector(Copy_uint8Sector);
+#endif
+		FLASH->CR &= ~(FLASH_CR_PSIZE | FLASH_CR_SNB);
+		FLASH->CR |= Global_uint32Psize | FLASH_CR_SER | ((uint32_t)Copy_uint8Sector << FLASH_CR_SNB_Pos);
+		FLASH->CR |= FLASH_CR_STRT;
+		BL_TRACE(BL_TRACE_ERASE_START, Copy_uint8Sector, 0u);
+#if BL_WEAR_STATS_ENABLE
+		voidCountErase(Copy_uint8Sector);
+#endif
+
+		Local_uint8Status = uint8_WaitForFlash();
+
+		FLASH->CR &= ~(FLASH_CR_SER | FLASH_CR_SNB);
+		voidFlushCaches();
+#if BL_STATS_ENABLE
+		if((Local_uint8Status == HAL_OK) && (Copy_uint8Sector < BL_FLASH_SECTOR_COUNT))
+		{
+			voidRecordTiming(&Global_FlashTiming.Erase[uint8_GetSectorClass(Copy_uint8Sector)], Local_uint32StartCycles, 1u);
+		}
+#endif
+		BL_TRACE(BL_TRACE_ERASE_END, Copy_uint8Sector, Local_uint8Status);
+	}
+
+	/* The longest single step there is: 4 s for 128 KB at x8 */
+	BL_PORT_WATCHDOG_REFRESH();
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * BL_uint8FlashMassErase
+ * ----------------------
+ * Erases the whole flash bank with the selected parallelism.
+ * With BL_WATCHDOG_ENABLE one sector at a time instead (BL_uint8FlashEraseSector,
+ * IWDG refreshed and erase timed after each), from sector 11 down, the
+ * bootloader sectors 1 and 0 last; sectors 2..11 that read blank are skipped.
+ * A single bank erase takes 8 s (x32) to 16 s (x8) and would outlast the IWDG.
+ * NOTE: this erases the bootloader itself; the routine keeps running from RAM
+ *       but returns into erased code.
+ *
+ * Return:
+ * -------
+ *  HAL_OK or HAL_ERROR.
+ */
+#if BL_WATCHDOG_ENABLE
+__RAM_FUNC uint8_t BL_uint8FlashMassErase(void)
+{
+	uint8_t Local_uint8Status = HAL_OK;
+	uint8_t Local_uint8Sector = BL_FLASH_SECTOR_COUNT;
+
+	while((Local_uint8Status == HAL_OK) && (Local_uint8Sector != 0u))
+	{
+		Local_uint8Sector--;
+
+		/* The blank check is not in RAM: only called while sectors 0 and 1 still hold it */
+		if((Local_uint8Sector < 2u) || (BL_uint8FlashSectorIsBlank(Local_uint8Sector) == BL_FLASH_SECTOR_NOT_BLANK))
+		{
+			Local_uint8Status = BL_uint8FlashEraseSector(Local_uint8Sector);
+		}
+	}
+
+	BL_TRACE(BL_TRACE_MASS_ERASE, 0u, Local_uint8Status);
+
+	return Local_uint8Status;
+}
+#else
+__RAM_FUNC uint8_t BL_uint8FlashMassErase(void)
+{
+	uint8_t Local_uint8Status = uint8_WaitForFlash();
+#if BL_WEAR_STATS_ENABLE
+	uint8_t Local_uint8Sector;
+#endif
+
+	if(Local_uint8Status == HAL_OK)
+	{
+#if BL_SLOT_CACHE_ENABLE
+		BL_voidSlotCacheInvalidate(FLASH_BASE, (FLASH_END + 1u) - FLASH_BASE);
+#endif
+		FLASH->CR &= ~FLASH_CR_PSIZE;
+		FLASH->CR |= Global_uint32Psize | FLASH_CR_MER;
+		FLASH->CR |= FLASH_CR_STRT;
+#if BL_WEAR_STATS_ENABLE
+		for(Local_uint8Sector = 0; Local_uint8Sector < BL_FLASH_SECTOR_COUNT; Local_uint8Sector++)
+		{
+			voidCountErase(Local_uint8Sector);
+		}
+#endif
+
+		Local_uint8Status = uint8_WaitForFlash();
+
+		FLASH->CR &= ~FLASH_CR_MER;
+		voidFlushCaches();
+		BL_TRACE(BL_TRACE_MASS_ERASE, 0u, Local_uint8Status);
+	}
+
+	return Local_uint8Status;
+}
+#endif
+
+
+/*
+ * BL_uint8FlashSectorIsBlank
+ * --------------------------
+ * Blank-check of one sector before erasing it: a 128 KB erase costs 1-2 s and
+ * a program/erase cycle, a 32-bit read scan of the same sector well under 1 ms
+ * at 168 MHz (ART prefetch on, early exit on the first programmed word).
+ *
+ * Return:
+ * -------
+ *  BL_FLASH_SECTOR_BLANK if every word reads 0xFFFFFFFF, BL_FLASH_SECTOR_NOT_BLANK otherwise.
+ */
+uint8_t BL_uint8FlashSectorIsBlank(uint8_t Copy_uint8Sector)
+{
+	return BL_uint8FlashRangeIsBlank(Global_FlashSectors[Copy_uint8Sector].Base, Global_FlashSectors[Copy_uint8Sector].Size);
+}
+
+
+/*
+ * BL_uint8FlashRangeIsBlank
+ * -------------------------
+ * 32-bit read scan of a word-aligned range (length a multiple of 4), early
+ * exit on the first programmed word.
+ *
+ * Return:
+ * -------
+ *  BL_FLASH_SECTOR_BLANK if every word reads 0xFFFFFFFF, BL_FLASH_SECTOR_NOT_BLANK otherwise.
+ */
+uint8_t BL_uint8FlashRangeIsBlank(uint32_t Copy_uint32Address, uint32_t Copy_uint32Length)
+{
+	const volatile uint32_t* Local_puint32Word;
+	const volatile uint32_t* Local_puint32End;
+
+	Local_puint32Word = (const volatile uint32_t*)Copy_uint32Address;
+	Local_puint32End  = Local_puint32Word + (Copy_uint32Length / 4u);
+
+	while((Local_puint32Word < Local_puint32End) && (*Local_puint32Word == 0xFFFFFFFFUL))
+	{
+		Local_puint32Word++;
+	}
+
+	return (Local_puint32Word == Local_puint32End) ? BL_FLASH_SECTOR_BLANK : BL_FLASH_SECTOR_NOT_BLANK;
+}
+
+
+/*
+ * BL_uint32FlashVerify
+ * --------------------
+ * Read-back check of freshly programmed bytes against their source. The ART
+ * caches are reset first (a line read before the program would still hold the
+ * old content), then the word-aligned body is compared with 32-bit flash reads
+ * and the head / tail byte by byte. Costs about one cycle per byte.
+ *
+ * Return:
+ * -------
+ *  BL_FLASH_VERIFY_OK, or the address of the first byte that differs.
+ */
+uint32_t BL_uint32FlashVerify(uint32_t Copy_uint32Address, const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length)
+{
+	uint16_t Local_uint16Iterator = 0;
+
+	voidFlushCaches();
+
+	/* Head, then the body a word at a time: a differing word is left to the byte loop */
+	while((Local_uint16Iterator < Copy_uint16Length) && (((Copy_uint32Address + Local_uint16Iterator) & 0x3u) != 0u) &&
+	      (*(const volatile uint8_t*)(Copy_uint32Address + Local_uint16Iterator) == Copy_puint8Data[Local_uint16Iterator]))
+	{
+		Local_uint16Iterator++;
+	}
+
+	if(((Copy_uint32Address + Local_uint16Iterator) & 0x3u) == 0u)
+	{
+		while(((Copy_uint16Length - Local_uint16Iterator) >= 4u) &&
+		      (*(const volatile uint32_t*)(Copy_uint32Address + Local_uint16Iterator) ==
+		       __UNALIGNED_UINT32_READ(&Copy_puint8Data[Local_uint16Iterator])))
+		{
+			Local_uint16Iterator += 4u;
+		}
+	}
+
+	while((Local_uint16Iterator < Copy_uint16Length) &&
+	      (*(const volatile uint8_t*)(Copy_uint32Address + Local_uint16Iterator) == Copy_puint8Data[Local_uint16Iterator]))
+	{
+		Local_uint16Iterator++;
+	}
+
+	return (Local_uint16Iterator == Copy_uint16Length) ? BL_FLASH_VERIFY_OK : (Copy_uint32Address + Local_uint16Iterator);
+}
+
+
+/*
+ * BL_voidFlashEraseSectorStart
+ * ----------------------------
+ * Starts erasing one sector and returns at once. The flash must be unlocked
+ * and stays unlocked when the erase ends.
+ * Until then BL_uint8FlashGetEraseResult() reports BL_FLASH_OP_PENDING.
+ */
+__RAM_FUNC void BL_voidFlashEraseSectorStart(uint8_t Copy_uint8Sector)
+{
+	if(uint8_WaitForFlash() != HAL_OK)
+	{
+		/* Error left by an earlier operation, it is cleared now */
+	}
+
+	Global_uint8EraseResult = BL_FLASH_OP_PENDING;
+#if BL_SLOT_CACHE_ENABLE
+	voidInvalidateSector(Copy_uint8Sector);
+#endif
+
+	FLASH->CR &= ~(FLASH_CR_PSIZE | FLASH_CR_SNB);
+	FLASH->CR |= Global_uint32Psize | FLASH_CR_SER | ((uint32_t)Copy_uint8Sector << FLASH_CR_SNB_Pos) | FLASH_CR_EOPIE | FLASH_IT_ERR;
+	FLASH->CR |= FLASH_CR_STRT;
+	BL_TRACE(BL_TRACE_ERASE_START, Copy_uint8Sector, 1u);
+#if BL_WEAR_STATS_ENABLE
+	voidCountErase(Copy_uint8Sector);
+#endif
+#if BL_STATS_ENABLE
+	Global_uint32EraseStartCycles = DWT->CYCCNT;
+	Global_uint8EraseClass        = (Copy_uint8Sector < BL_FLASH_SECTOR_COUNT) ? uint8_GetSectorClass(Copy_uint8Sector) : BL_FLASH_CLASS_COUNT;
+#endif
+}
+
+
+/*
+ * BL_uint8FlashGetEraseResult
+ * ---------------------------
+ * Returns BL_FLASH_OP_PENDING while the started erase runs, then HAL_OK / HAL_ERROR.
+ */
+uint8_t BL_uint8FlashGetEraseResult(void)
+{
+	return Global_uint8EraseResult;
+}
+
+
+/*
+ * BL_voidFlashIRQHandler
+ * ----------------------
+ * End of a started erase: records the result, disables the interrupt
+ * sources, flushes the ART caches and wakes the command loop for the next
+ * step (which relocks the flash unless a programming session is open).
+ */
+__RAM_FUNC void BL_voidFlashIRQHandler(void)
+{
+	uint32_t Local_uint32Status = FLASH->SR;
+
+	if((Local_uint32Status & (FLASH_SR_EOP | FLASH_ERROR_FLAGS | FLASH_SR_SOP)) != 0u)
+	{
+		FLASH->SR = FLASH_SR_EOP | FLASH_ERROR_FLAGS | FLASH_SR_SOP;
+
+		FLASH->CR &= ~(FLASH_CR_SER | FLASH_CR_SNB | FLASH_CR_EOPIE | FLASH_IT_ERR);
+		voidFlushCaches();
+
+		Global_uint8EraseResult = ((Local_uint32Status & (FLASH_ERROR_FLAGS | FLASH_SR_SOP)) != 0u) ? HAL_ERROR : HAL_OK;
+#if BL_STATS_ENABLE
+		if((Global_uint8EraseResult == HAL_OK) && (Global_uint8EraseClass < BL_FLASH_CLASS_COUNT))
+		{
+			voidRecordTiming(&Global_FlashTiming.Erase[Global_uint8EraseClass], Global_uint32EraseStartCycles, 1u);
+		}
+#endif
+		BL_TRACE(BL_TRACE_ERASE_END, 0xFFu, Global_uint8EraseResult);
+
+		BL_voidTransportNotifyBackground();
+	}
+}
+
+
+/*
+ * BL_voidFlashReplaceBootloader
+ * -----------------------------
+ * Copies Copy_uint32Length bytes (a multiple of 4, at most the
+ * BL_FLASH_BOOTLOADER_SECTORS sectors) from Copy_uint32Source, outside
+ * them, over the bootloader and resets (see "Bootloader Replacement" in
+ * BL_Flash.h). The caller has checked the image; from here on nothing
+ * else runs.
+ *
+ * Behavior:
+ * ---------
+ *  - Masks interrupts and unlocks the flash with its key sequence.
+ *  - Per pass: every sector that does not read blank is erased, then the
+ *    image is programmed word by word (each word as two half-words / four
+ *    bytes below x32) and compared with the source.
+ *  - The sector bases are computed (all 16 KB): Global_FlashSectors is
+ *    const data of the image being erased.
+ *  - Relocks and requests a system reset, after a verified pass or the
+ *    last failed one (the ROM bootloader, BOOT0, is then the way back).
+ */
+__RAM_FUNC void BL_voidFlashReplaceBootloader(uint32_t Copy_uint32Source, uint32_t Copy_uint32Length)
+{
+	uint8_t  Local_uint8Unit   = Global_uint8Parallelism;
+	uint32_t Local_uint32Psize = Global_uint32Psize;
+	uint8_t  Local_uint8Status = HAL_ERROR;
+	uint8_t  Local_uint8Attempt;
+	uint8_t  Local_uint8Sector;
+	uint8_t  Local_uint8Byte;
+	uint32_t Local_uint32Offset;
+	uint32_t Local_uint32Word;
+	uint32_t Local_uint32Address;
+
+	__disable_irq();
+
+	if((FLASH->CR & FLASH_CR_LOCK) != 0u)
+	{
+		FLASH->KEYR = FLASH_KEY1;
+		FLASH->KEYR = FLASH_KEY2;
+	}
+
+	for(Local_uint8Attempt = 0; (Local_uint8Attempt < BL_FLASH_REPLACE_ATTEMPTS) && (Local_uint8Status != HAL_OK); Local_uint8Attempt++)
+	{
+		Local_uint8Status = uint8_WaitForFlash();
+
+		/* Erase: a sector already blank is skipped, 250 ms less without a bootloader */
+		for(Local_uint8Sector = 0; (Local_uint8Status == HAL_OK) && (Local_uint8Sector < BL_FLASH_BOOTLOADER_SECTORS); Local_uint8Sector++)
+		{
+			Local_uint32Address = FLASH_BASE + ((uint32_t)Local_uint8Sector * 0x4000UL);
+
+			for(Local_uint32Offset = 0; (Local_uint32Offset < 0x4000UL) &&
+			    (*(const volatile uint32_t*)(Local_uint32Address + Local_uint32Offset) == 0xFFFFFFFFUL); Local_uint32Offset += 4u)
+			{
+			}
+
+			if(Local_uint32Offset < 0x4000UL)
+			{
+				FLASH->CR &= ~(FLASH_CR_PSIZE | FLASH_CR_SNB);
+				FLASH->CR |= Local_uint32Psize | FLASH_CR_SER | ((uint32_t)Local_uint8Sector << FLASH_CR_SNB_Pos);
+				FLASH->CR |= FLASH_CR_STRT;
+				Local_uint8Status = uint8_WaitForFlash();
+				FLASH->CR &= ~(FLASH_CR_SER | FLASH_CR_SNB);
+			}
+
+			BL_PORT_WATCHDOG_REFRESH();
+		}
+
+		voidFlushCaches();
+
+		/* Program: one source word per step, in the units the supply allows */
+		FLASH->CR &= ~FLASH_CR_PSIZE;
+		FLASH->CR |= Local_uint32Psize | FLASH_CR_PG;
+
+		for(Local_uint32Offset = 0; (Local_uint8Status == HAL_OK) && (Local_uint32Offset < Copy_uint32Length); Local_uint32Offset += 4u)
+		{
+			Local_uint32Word    = *(const volatile uint32_t*)(Copy_uint32Source + Local_uint32Offset);
+			Local_uint32Address = FLASH_BASE + Local_uint32Offset;
+
+			if(Local_uint8Unit == BL_FLASH_PSIZE_X32)
+			{
+				*(volatile uint32_t*)Local_uint32Address = Local_uint32Word;
+				Local_uint8Status = uint8_WaitForFlash();
+			}
+			else if(Local_uint8Unit == BL_FLASH_PSIZE_X16)
+			{
+				*(volatile uint16_t*)Local_uint32Address = (uint16_t)Local_uint32Word;
+				Local_uint8Status = uint8_WaitForFlash();
+				*(volatile uint16_t*)(Local_uint32Address + 2u) = (uint16_t)(Local_uint32Word >> 16);
+				Local_uint8Status |= uint8_WaitForFlash();
+			}
+			else
+			{
+				for(Local_uint8Byte = 0; (Local_uint8Status == HAL_OK) && (Local_uint8Byte < 4u); Local_uint8Byte++)
+				{
+					*(volatile uint8_t*)(Local_uint32Address + Local_uint8Byte) = (uint8_t)(Local_uint32Word >> (8u * Local_uint8Byte));
+					Local_uint8Status = uint8_WaitForFlash();
+				}
+			}
+
+			if((Local_uint32Offset & ((PROGRAM_SLICE_UNITS * 4u) - 1u)) == 0u)
+			{
+				BL_PORT_WATCHDOG_REFRESH();
+			}
+		}
+
+		FLASH->CR &= ~FLASH_CR_PG;
+		voidFlushCaches();
+
+		/* Verify: the copy must read back as the source */
+		for(Local_uint32Offset = 0; (Local_uint8Status == HAL_OK) && (Local_uint32Offset < Copy_uint32Length); Local_uint32Offset += 4u)
+		{
+			if(*(const volatile uint32_t*)(FLASH_BASE + Local_uint32Offset) != *(const volatile uint32_t*)(Copy_uint32Source + Local_uint32Offset))
+			{
+				Local_uint8Status = HAL_ERROR;
+			}
+		}
+	}
+
+	FLASH->CR |= FLASH_CR_LOCK;
+
+	/* NVIC_SystemReset, written out: nothing may be called in flash */
+	__DSB();
+	SCB->AIRCR = (0x5FAUL << SCB_AIRCR_VECTKEY_Pos) | (SCB->AIRCR & SCB_AIRCR_PRIGROUP_Msk) | SCB_AIRCR_SYSRESETREQ_Msk;
+	__DSB();
+
+	for(;;)
+	{
+	}
+}
+
+
+/*
+ * BL_uint8FlashGetSector
+ * ----------------------
+ * Binary search of the sector table: the last sector whose base is not above
+ * the address (4 steps for 12 sectors).
+ *
+ * Return:
+ * -------
+ *  Sector number, or BL_FLASH_INVALID_SECTOR outside FLASH_BASE .. FLASH_END.
+ */
+uint8_t BL_uint8FlashGetSector(uint32_t Copy_uint32Address)
+{
+	uint8_t Local_uint8Low  = 0;
+	uint8_t Local_uint8High = BL_FLASH_SECTOR_COUNT - 1u;
+	uint8_t Local_uint8Mid;
+
+	if((Copy_uint32Address < FLASH_BASE) || (Copy_uint32Address > FLASH_END))
+	{
+		return BL_FLASH_INVALID_SECTOR;
+	}
+
+	while(Local_uint8Low < Local_uint8High)
+	{
+		Local_uint8Mid = (uint8_t)((Local_uint8Low + Local_uint8High + 1u) / 2u);
+
+		if(Global_FlashSectors[Local_uint8Mid].Base <= Copy_uint32Address)
+		{
+			Local_uint8Low = Local_uint8Mid;
+		}
+		else
+		{
+			Local_uint8High = Local_uint8Mid - 1u;
+		}
+	}
+
+	return Local_uint8Low;
+}
+
+
+/*
+ * BL_pFlashGetSectorInfo
+ * ----------------------
+ * Returns the table entry of a sector, NULL for an invalid sector number.
+ */
+const BL_FlashSector_t* BL_pFlashGetSectorInfo(uint8_t Copy_uint8Sector)
+{
+	const BL_FlashSector_t* Local_pSector = NULL;
+
+	if(Copy_uint8Sector < BL_FLASH_SECTOR_COUNT)
+	{
+		Local_pSector = &Global_FlashSectors[Copy_uint8Sector];
+	}
+
+	return Local_pSector;
+}
+
+
+#if BL_WEAR_STATS_ENABLE
+/*
+ * BL_uint16FlashGetEraseCount
+ * ---------------------------
+ * Erases of a sector started since the last BL_voidFlashClearEraseCounts()
+ * (0 for an invalid sector number).
+ */
+uint16_t BL_uint16FlashGetEraseCount(uint8_t Copy_uint8Sector)
+{
+	uint16_t Local_uint16Count = 0;
+
+	if(Copy_uint8Sector < BL_FLASH_SECTOR_COUNT)
+	{
+		Local_uint16Count = Global_uint16EraseCounts[Copy_uint8Sector];
+	}
+
+	return Local_uint16Count;
+}
+
+
+/*
+ * BL_voidFlashClearEraseCounts
+ * ----------------------------
+ * The counts were added to the journal totals.
+ */
+void BL_voidFlashClearEraseCounts(void)
+{
+	memset(Global_uint16EraseCounts, 0, sizeof(Global_uint16EraseCounts));
+}
+#endif
+
+
+#if BL_STATS_ENABLE
+/*
+ * BL_pFlashGetTiming
+ * ------------------
+ * The operation time histograms (BL_Flash.h), read by BL_GET_STATS.
+ */
+const BL_FlashTiming_t* BL_pFlashGetTiming(void)
+{
+	return &Global_FlashTiming;
+}
+
+
+void BL_voidFlashClearTiming(void)
+{
+	memset(&Global_FlashTiming, 0, sizeof(Global_FlashTiming));
+}
+#endif
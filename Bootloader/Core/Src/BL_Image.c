@@ -0,0 +1,523 @@
+
+#include "main.h"
+#include "BL_Image.h"
+#include "BL_CRC.h"
+#include "BL_Flash.h"
+#include "BL_Staging.h"
+#include "BL_KV.h"
+#include "BL_Rollback.h"
+
+
+/* SRAM1 + SRAM2, where the application's initial stack pointer must lie */
+#define IMAGE_SRAM_START              0x20000000UL
+#define IMAGE_SRAM_END                0x20020000UL
+
+#define IMAGE_HEADER(base)            ((const volatile BL_ImageHeader_t*)((base) + BL_IMAGE_HEADER_OFFSET))
+
+/* Header words left out of the image CRC: Crc, Validated, Activated */
+#define IMAGE_CRC_SKIP_WORDS          3u
+
+
+/*
+ * Global_uint32SlotBase / Global_uint32SlotEnd
+ * --------------------------------------------
+ * Application slots by index (BL_IMAGE_SLOT_x). Slot A is the whole area up
+ * to the staging slot unless BL_AB_SLOTS_ENABLE splits it, BL_SWAP_ENABLE
+ * keeps the swap scratch area or BL_KV_ENABLE the key/value store out of it.
+ */
+static const uint32_t Global_uint32SlotBase[BL_IMAGE_SLOT_COUNT] =
+{
+	BL_IMAGE_BASE_ADDRESS,
+#if BL_AB_SLOTS_ENABLE
+	BL_IMAGE_SLOT_B_ADDRESS,
+#endif
+};
+
+static const uint32_t Global_uint32SlotEnd[BL_IMAGE_SLOT_COUNT] =
+{
+#if BL_AB_SLOTS_ENABLE
+	BL_IMAGE_SLOT_B_ADDRESS,
+	BL_STAGING_BASE_ADDRESS,
+#elif BL_SWAP_ENABLE
+	BL_SWAP_SCRATCH_ADDRESS,
+#elif BL_KV_ENABLE
+	BL_KV_BASE_ADDRESS,
+#else
+	BL_STAGING_BASE_ADDRESS,
+#endif
+};
+
+
+/*
+ * uint8_CheckVectors
+ * ------------------
+ * An initial stack pointer in SRAM and a Thumb reset handler inside the slot,
+ * below Copy_uint32End. Erased or half-written flash fails it (0xFFFFFFFF).
+ */
+static uint8_t uint8_CheckVectors(uint32_t Copy_uint32Base, uint32_t Copy_uint32End)
+{
+	uint32_t Local_uint32Stack = *((const volatile uint32_t*)Copy_uint32Base);
+	uint32_t Local_uint32Reset = *((const volatile uint32_t*)(Copy_uint32Base + 4u));
+
+	return (uint8_t)((Local_uint32Stack > IMAGE_SRAM_START) && (Local_uint32Stack <= IMAGE_SRAM_END) &&
+	                 ((Local_uint32Reset & 1u) != 0u) &&
+	                 (Local_uint32Reset > Copy_uint32Base) && (Local_uint32Reset < Copy_uint32End));
+}
+
+
+/*
+ * uint8_CheckHeader
+ * -----------------
+ * Cheap checks done on every boot: a header (magic), an end address inside
+ * the slot and plausible vectors inside the image. With BL_ROLLBACK_ENABLE
+ * a SecurityVersion from the OTP counter up to BL_ROLLBACK_MAX as well.
+ */
+static uint8_t uint8_CheckHeader(uint8_t Copy_uint8Slot)
+{
+	uint32_t Local_uint32Base = Global_uint32SlotBase[Copy_uint8Slot];
+	uint32_t Local_uint32End  = IMAGE_HEADER(Local_uint32Base)->EndAddress;
+
+	return (uint8_t)((IMAGE_HEADER(Local_uint32Base)->Magic == BL_IMAGE_MAGIC) &&
+	                 (Local_uint32End >= (Local_uint32Base + BL_IMAGE_HEADER_OFFSET + sizeof(BL_ImageHeader_t))) &&
+	                 (Local_uint32End <= Global_uint32SlotEnd[Copy_uint8Slot]) &&
+#if BL_ROLLBACK_ENABLE
+	                 (IMAGE_HEADER(Local_uint32Base)->SecurityVersion >= BL_uint32RollbackGetCounter()) &&
+	                 (IMAGE_HEADER(Local_uint32Base)->SecurityVersion <= BL_ROLLBACK_MAX) &&
+#endif
+	                 (uint8_CheckVectors(Local_uint32Base, Local_uint32End) != 0u));
+}
+
+
+/*
+ * uint32_ImageCrc
+ * ---------------
+ * CRC of the image without the IMAGE_CRC_SKIP_WORDS words the bootloader
+ * writes (two DMA-fed pieces).
+ */
+static uint32_t uint32_ImageCrc(uint8_t Copy_uint8Slot)
+{
+	uint32_t Local_uint32Base = Global_uint32SlotBase[Copy_uint8Slot];
+	BL_CRCStream_t Local_Crc;
+	const uint8_t* Local_puint8Skip = (const uint8_t*)&IMAGE_HEADER(Local_uint32Base)->Crc;
+	const uint8_t* Local_puint8Rest = Local_puint8Skip + (IMAGE_CRC_SKIP_WORDS * sizeof(uint32_t));
+
+	BL_voidCRCStreamStart(&Local_Crc);
+	BL_voidCRCStreamUpdate(&Local_Crc, (const uint8_t*)Local_uint32Base,
+	                       (uint32_t)Local_puint8Skip - Local_uint32Base);
+	BL_voidCRCStreamUpdate(&Local_Crc, Local_puint8Rest,
+	                       IMAGE_HEADER(Local_uint32Base)->EndAddress - (uint32_t)Local_puint8Rest);
+
+	return BL_uint32CRCStreamFinish(&Local_Crc);
+}
+
+
+/*
+ * uint8_ProgramHeaderWord
+ * -----------------------
+ * Programs one header word of a slot; the flash is unlocked by the caller.
+ */
+static uint8_t uint8_ProgramHeaderWord(const volatile uint32_t* Copy_puint32Word, uint32_t Copy_uint32Value)
+{
+	return BL_uint8FlashProgram((uint32_t)Copy_puint32Word, (const uint8_t*)&Copy_uint32Value, sizeof(Copy_uint32Value));
+}
+
+
+/*
+ * uint8_SlotIsValidated
+ * ---------------------
+ * A slot whose header carries the validated mark and passes the cheap checks.
+ */
+static uint8_t uint8_SlotIsValidated(uint8_t Copy_uint8Slot)
+{
+	return (uint8_t)((IMAGE_HEADER(Global_uint32SlotBase[Copy_uint8Slot])->Validated == BL_IMAGE_FLAG_VALIDATED) &&
+	                 (uint8_CheckHeader(Copy_uint8Slot) != 0u));
+}
+
+
+/*
+ * uint8_CheckSlot
+ * ---------------
+ * BL_IMAGE_VALID when the slot is validated, or its stamped CRC matches (an
+ * unmarked header is then marked, flash unlocked / locked here). With
+ * BL_SIGNATURE_ENABLE only the mark of a signed commit counts.
+ */
+static uint8_t uint8_CheckSlot(uint8_t Copy_uint8Slot)
+{
+	uint8_t Local_uint8Result = BL_IMAGE_INVALID;
+#if (BL_SIGNATURE_ENABLE == 0)
+	const volatile BL_ImageHeader_t* Local_pHeader = IMAGE_HEADER(Global_uint32SlotBase[Copy_uint8Slot]);
+#endif
+
+	if(uint8_SlotIsValidated(Copy_uint8Slot) != 0u)
+	{
+		Local_uint8Result = BL_IMAGE_VALID;
+	}
+#if (BL_SIGNATURE_ENABLE == 0)
+	else if((uint8_CheckHeader(Copy_uint8Slot) != 0u) && (Local_pHeader->Crc != BL_IMAGE_CRC_UNSTAMPED) &&
+	        (uint32_ImageCrc(Copy_uint8Slot) == Local_pHeader->Crc))
+	{
+		Local_uint8Result = BL_IMAGE_VALID;
+
+		if(Local_pHeader->Validated == BL_IMAGE_FLAG_BLANK)
+		{
+			HAL_FLASH_Unlock();
+			uint8_ProgramHeaderWord(&Local_pHeader->Validated, BL_IMAGE_FLAG_VALIDATED);
+			HAL_FLASH_Lock();
+		}
+	}
+#endif
+
+	return Local_uint8Result;
+}
+
+
+/*
+ * BL_uint8ImageGetActiveSlot
+ * --------------------------
+ * The slot the bootloader starts: of the slots whose header passes the cheap
+ * checks and carries an activation, the one with the highest sequence; slot A
+ * when none is activated (single-slot layout, or images from before A/B).
+ */
+uint8_t BL_uint8ImageGetActiveSlot(void)
+{
+	uint8_t  Local_uint8Active = BL_IMAGE_SLOT_A;
+	uint32_t Local_uint32Best  = 0;
+	uint32_t Local_uint32Sequence;
+	uint8_t  Local_uint8Slot;
+
+	for(Local_uint8Slot = 0; Local_uint8Slot < BL_IMAGE_SLOT_COUNT; Local_uint8Slot++)
+	{
+		Local_uint32Sequence = IMAGE_HEADER(Global_uint32SlotBase[Local_uint8Slot])->Activated;
+
+		if((Local_uint32Sequence != BL_IMAGE_ACTIVATION_BLANK) && (Local_uint32Sequence >= Local_uint32Best) &&
+		   (uint8_CheckHeader(Local_uint8Slot) != 0u))
+		{
+			Local_uint32Best  = Local_uint32Sequence;
+			Local_uint8Active = Local_uint8Slot;
+		}
+	}
+
+	return Local_uint8Active;
+}
+
+
+/*
+ * BL_uint32ImageGetSlotBase
+ * -------------------------
+ * Vector table address of a slot (BL_IMAGE_SLOT_x), 0 for an unknown slot.
+ */
+uint32_t BL_uint32ImageGetSlotBase(uint8_t Copy_uint8Slot)
+{
+	return (Copy_uint8Slot < BL_IMAGE_SLOT_COUNT) ? Global_uint32SlotBase[Copy_uint8Slot] : 0u;
+}
+
+
+/*
+ * BL_uint32ImageGetSlotEnd
+ * ------------------------
+ * First address after a slot (BL_IMAGE_SLOT_x), 0 for an unknown slot.
+ */
+uint32_t BL_uint32ImageGetSlotEnd(uint8_t Copy_uint8Slot)
+{
+	return (Copy_uint8Slot < BL_IMAGE_SLOT_COUNT) ? Global_uint32SlotEnd[Copy_uint8Slot] : 0u;
+}
+
+
+/*
+ * BL_uint8ImageGetUpdateSlot
+ * --------------------------
+ * The slot updates are written to: the inactive one with two slots, slot A
+ * (in place) otherwise.
+ */
+uint8_t BL_uint8ImageGetUpdateSlot(void)
+{
+	return (uint8_t)((BL_uint8ImageGetActiveSlot() + 1u) % BL_IMAGE_SLOT_COUNT);
+}
+
+
+/*
+ * BL_uint8ImageCheck
+ * ------------------
+ * Decides whether the active slot can be started.
+ *
+ * Behavior:
+ * ---------
+ * 1. No magic, or a header whose Crc was never stamped: only the vectors are
+ *    checked against the application slot, BL_IMAGE_NO_HEADER when they are
+ *    plausible (the caller jumps as it always did). An erased or half-written
+ *    slot is BL_IMAGE_INVALID.
+ * 2. Header or vectors implausible: BL_IMAGE_INVALID.
+ * 3. Marked validated: BL_IMAGE_VALID without reading the image.
+ * 4. Otherwise the image CRC is computed. On a match an unmarked header is
+ *    marked (one word programmed) and BL_IMAGE_VALID is returned, else
+ *    BL_IMAGE_INVALID.
+ * With BL_SIGNATURE_ENABLE only step 3 can return BL_IMAGE_VALID.
+ */
+uint8_t BL_uint8ImageCheck(void)
+{
+	uint8_t  Local_uint8Slot = BL_uint8ImageGetActiveSlot();
+	uint8_t  Local_uint8Result = BL_IMAGE_INVALID;
+
+#if (BL_SIGNATURE_ENABLE == 0)
+	uint32_t Local_uint32Base = Global_uint32SlotBase[Local_uint8Slot];
+
+	if((IMAGE_HEADER(Local_uint32Base)->Magic != BL_IMAGE_MAGIC) || (IMAGE_HEADER(Local_uint32Base)->Crc == BL_IMAGE_CRC_UNSTAMPED))
+	{
+		if(uint8_CheckVectors(Local_uint32Base, Global_uint32SlotEnd[Local_uint8Slot]) != 0u)
+		{
+			Local_uint8Result = BL_IMAGE_NO_HEADER;
+		}
+	}
+	else
+#endif
+	{
+		Local_uint8Result = uint8_CheckSlot(Local_uint8Slot);
+	}
+
+	return Local_uint8Result;
+}
+
+
+/*
+ * BL_uint8ImageIsValidated
+ * ------------------------
+ * Step 3 of BL_uint8ImageCheck on its own: the active slot's header carries
+ * the validated mark and passes the cheap checks. Flash reads only, so it is
+ * usable before HAL_Init (fast boot path).
+ */
+uint8_t BL_uint8ImageIsValidated(void)
+{
+	return uint8_SlotIsValidated(BL_uint8ImageGetActiveSlot());
+}
+
+
+/*
+ * BL_uint8ImageMarkValidated
+ * --------------------------
+ * Programs BL_IMAGE_FLAG_VALIDATED into the update slot's header when its
+ * mark is still blank (a revoked mark needs the next update). Unlocks / locks
+ * the flash itself.
+ *
+ * Return:
+ * -------
+ * HAL_OK when the header now reads validated, HAL_ERROR otherwise.
+ */
+uint8_t BL_uint8ImageMarkValidated(void)
+{
+	const volatile BL_ImageHeader_t* Local_pHeader = IMAGE_HEADER(Global_uint32SlotBase[BL_uint8ImageGetUpdateSlot()]);
+
+	if((Local_pHeader->Magic == BL_IMAGE_MAGIC) && (Local_pHeader->Validated == BL_IMAGE_FLAG_BLANK))
+	{
+		HAL_FLASH_Unlock();
+		uint8_ProgramHeaderWord(&Local_pHeader->Validated, BL_IMAGE_FLAG_VALIDATED);
+		HAL_FLASH_Lock();
+	}
+
+	return (Local_pHeader->Validated == BL_IMAGE_FLAG_VALIDATED) ? HAL_OK : HAL_ERROR;
+}
+
+
+/*
+ * BL_uint8ImageRevoke
+ * -------------------
+ * Called before the bootloader programs or erases application flash, with
+ * the range about to change; the flash is unlocked by the caller.
+ *
+ * Behavior:
+ * ---------
+ * 1. With two slots a range touching the active one is refused: the running
+ *    image keeps serving, updates go to the other slot.
+ * 2. A validated mark of each slot the range touches would no longer describe
+ *    the content, it is cleared to BL_IMAGE_FLAG_REVOKED.
+ *
+ * Return:
+ * -------
+ * HAL_OK, or HAL_ERROR (case 1, nothing changed).
+ */
+uint8_t BL_uint8ImageRevoke(uint32_t Copy_uint32Address, uint32_t Copy_uint32Length)
+{
+	uint32_t Local_uint32Last = Copy_uint32Address + Copy_uint32Length - 1u;
+	uint8_t  Local_uint8Status = HAL_OK;
+	uint8_t  Local_uint8Slot;
+	const volatile BL_ImageHeader_t* Local_pHeader;
+
+	for(Local_uint8Slot = 0; Local_uint8Slot < BL_IMAGE_SLOT_COUNT; Local_uint8Slot++)
+	{
+		if((Copy_uint32Length != 0u) && (Copy_uint32Address < Global_uint32SlotEnd[Local_uint8Slot]) &&
+		   (Local_uint32Last >= Global_uint32SlotBase[Local_uint8Slot]) &&
+		   (BL_IMAGE_SLOT_COUNT > 1u) && (Local_uint8Slot == BL_uint8ImageGetActiveSlot()))
+		{
+			Local_uint8Status = HAL_ERROR;
+		}
+	}
+
+	for(Local_uint8Slot = 0; (Local_uint8Slot < BL_IMAGE_SLOT_COUNT) && (Local_uint8Status == HAL_OK); Local_uint8Slot++)
+	{
+		Local_pHeader = IMAGE_HEADER(Global_uint32SlotBase[Local_uint8Slot]);
+
+		if((Copy_uint32Length != 0u) && (Copy_uint32Address < Global_uint32SlotEnd[Local_uint8Slot]) &&
+		   (Local_uint32Last >= Global_uint32SlotBase[Local_uint8Slot]) &&
+		   (Local_pHeader->Magic == BL_IMAGE_MAGIC) && (Local_pHeader->Validated == BL_IMAGE_FLAG_VALIDATED))
+		{
+			uint8_ProgramHeaderWord(&Local_pHeader->Validated, BL_IMAGE_FLAG_REVOKED);
+		}
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * BL_uint8ImageActivate
+ * ---------------------
+ * Makes a slot the one started from the next boot on: the image must pass
+ * uint8_CheckSlot, then its Activated word is programmed with the active
+ * slot's sequence + 1. One word, no copy and no erase; the previous slot
+ * stays intact behind it. Unlocks / locks the flash itself.
+ *
+ * Return:
+ * -------
+ * HAL_OK when the slot is now active (or already was), HAL_ERROR otherwise.
+ */
+uint8_t BL_uint8ImageActivate(uint8_t Copy_uint8Slot)
+{
+	uint8_t  Local_uint8Status = HAL_ERROR;
+	uint8_t  Local_uint8Active = BL_uint8ImageGetActiveSlot();
+	uint32_t Local_uint32Sequence;
+	const volatile BL_ImageHeader_t* Local_pHeader;
+
+	if(Copy_uint8Slot == Local_uint8Active)
+	{
+		Local_uint8Status = HAL_OK;
+	}
+	else if((Copy_uint8Slot < BL_IMAGE_SLOT_COUNT) && (uint8_CheckSlot(Copy_uint8Slot) == BL_IMAGE_VALID))
+	{
+		Local_pHeader        = IMAGE_HEADER(Global_uint32SlotBase[Copy_uint8Slot]);
+		Local_uint32Sequence = IMAGE_HEADER(Global_uint32SlotBase[Local_uint8Active])->Activated;
+		Local_uint32Sequence = (Local_uint32Sequence == BL_IMAGE_ACTIVATION_BLANK) ? 1u : (Local_uint32Sequence + 1u);
+
+		if((Local_pHeader->Activated == BL_IMAGE_ACTIVATION_BLANK) && (Local_uint32Sequence != BL_IMAGE_ACTIVATION_BLANK))
+		{
+			HAL_FLASH_Unlock();
+			uint8_ProgramHeaderWord(&Local_pHeader->Activated, Local_uint32Sequence);
+			HAL_FLASH_Lock();
+		}
+
+		if(BL_uint8ImageGetActiveSlot() == Copy_uint8Slot)
+		{
+			Local_uint8Status = HAL_OK;
+		}
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * BL_uint8ImageSlotIsPlausible
+ * ----------------------------
+ * The cheap checks of every boot (uint8_CheckHeader) on any slot: magic, an
+ * end address inside the slot and vectors inside the image. No CRC, no
+ * peripheral, so the services table can run it in the application's context.
+ */
+uint8_t BL_uint8ImageSlotIsPlausible(uint8_t Copy_uint8Slot)
+{
+	return (Copy_uint8Slot < BL_IMAGE_SLOT_COUNT) ? uint8_CheckHeader(Copy_uint8Slot) : 0u;
+}
+
+
+/*
+ * BL_uint8ImageGetState
+ * ---------------------
+ * What the next boot would make of a slot, from the header as it is: the
+ * classification of BL_uint8ImageCheck, with the validated mark standing in
+ * for the CRC it would compute. Flash (and with BL_ROLLBACK_ENABLE, cached
+ * OTP) reads only, so BL_GET_APP_INFO answers in microseconds.
+ */
+uint8_t BL_uint8ImageGetState(uint8_t Copy_uint8Slot)
+{
+	uint32_t Local_uint32Base;
+	const volatile BL_ImageHeader_t* Local_pHeader;
+	uint8_t  Local_uint8State = BL_IMAGE_STATE_EMPTY;
+
+	if(Copy_uint8Slot < BL_IMAGE_SLOT_COUNT)
+	{
+		Local_uint32Base = Global_uint32SlotBase[Copy_uint8Slot];
+		Local_pHeader    = IMAGE_HEADER(Local_uint32Base);
+
+		if((Local_pHeader->Magic != BL_IMAGE_MAGIC) || (Local_pHeader->Crc == BL_IMAGE_CRC_UNSTAMPED))
+		{
+			if(uint8_CheckVectors(Local_uint32Base, Global_uint32SlotEnd[Copy_uint8Slot]) != 0u)
+			{
+				Local_uint8State = BL_IMAGE_STATE_NO_HEADER;
+			}
+		}
+		else if(uint8_CheckHeader(Copy_uint8Slot) == 0u)
+		{
+			Local_uint8State = BL_IMAGE_STATE_INVALID;
+		}
+		else if(Local_pHeader->Validated == BL_IMAGE_FLAG_VALIDATED)
+		{
+			Local_uint8State = BL_IMAGE_STATE_VALIDATED;
+		}
+		else if(Local_pHeader->Validated == BL_IMAGE_FLAG_BLANK)
+		{
+			Local_uint8State = BL_IMAGE_STATE_UNCHECKED;
+		}
+		else
+		{
+			Local_uint8State = BL_IMAGE_STATE_REVOKED;
+		}
+	}
+
+	return Local_uint8State;
+}
+
+
+/*
+ * BL_uint8ImageRollbackPending
+ * ----------------------------
+ * 1 when the active slot's header passes the cheap checks and its
+ * SecurityVersion is above the OTP counter: the next checked boot of a
+ * confirmed image has a step to burn. Flash and OTP reads only; always 0
+ * without BL_ROLLBACK_ENABLE.
+ */
+uint8_t BL_uint8ImageRollbackPending(void)
+{
+#if BL_ROLLBACK_ENABLE
+	uint8_t Local_uint8Slot = BL_uint8ImageGetActiveSlot();
+
+	return (uint8_t)((uint8_CheckHeader(Local_uint8Slot) != 0u) &&
+	                 (IMAGE_HEADER(Global_uint32SlotBase[Local_uint8Slot])->SecurityVersion > BL_uint32RollbackGetCounter()));
+#else
+	return 0u;
+#endif
+}
+
+
+#if BL_ROLLBACK_ENABLE
+
+/*
+ * BL_uint8ImageRaiseRollback
+ * --------------------------
+ * Raises the OTP counter to the active slot's SecurityVersion when it is
+ * behind (BL_uint8RollbackRaise). Called for an image about to be started
+ * that is not on trial: a trial that fails goes back to the previous slot,
+ * which must still pass the check.
+ *
+ * Return:
+ * -------
+ * HAL_OK when nothing was pending or the counter now matches, HAL_ERROR otherwise.
+ */
+uint8_t BL_uint8ImageRaiseRollback(void)
+{
+	uint8_t Local_uint8Status = HAL_OK;
+
+	if(BL_uint8ImageRollbackPending() != 0u)
+	{
+		Local_uint8Status = BL_uint8RollbackRaise(IMAGE_HEADER(Global_uint32SlotBase[BL_uint8ImageGetActiveSlot()])->SecurityVersion);
+	}
+
+	return Local_uint8Status;
+}
+#endif
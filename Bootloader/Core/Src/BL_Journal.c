@@ -0,0 +1,383 @@
+
+#include "main.h"
+#include "BL_Journal.h"
+#include "BL_Flash.h"
+
+
+#define JOURNAL_END_ADDRESS           (BL_JOURNAL_BASE_ADDRESS + BL_JOURNAL_SIZE)
+
+#define JOURNAL_ERASED_WORD           0xFFFFFFFFUL
+
+/* Bytes taken by an entry of n payload words: header, payload, check */
+#define JOURNAL_ENTRY_SIZE(n)         (((uint32_t)(n) + 2u) * 4u)
+
+/* Append address, 0 until the log was scanned once */
+static uint32_t Global_uint32JournalEnd;
+
+
+/*
+ * uint32_EntryCheck
+ * -----------------
+ * Check word of an entry: ~XOR of its header word and payload words.
+ */
+static uint32_t uint32_EntryCheck(uint32_t Copy_uint32Header, const uint8_t* Copy_puint8Payload, uint8_t Copy_uint8Words)
+{
+	uint32_t Local_uint32Check = Copy_uint32Header;
+	uint8_t  Local_uint8Index;
+
+	for(Local_uint8Index = 0; Local_uint8Index < Copy_uint8Words; Local_uint8Index++)
+	{
+		Local_uint32Check ^= __UNALIGNED_UINT32_READ(&Copy_puint8Payload[4u * Local_uint8Index]);
+	}
+
+	return ~Local_uint32Check;
+}
+
+
+/*
+ * puint32_NextEntry
+ * -----------------
+ * Header of the entry after Copy_puint32Entry (NULL: first entry), NULL at
+ * the end of the log. Content that is not an entry header ends it too.
+ */
+static const uint32_t* puint32_NextEntry(const uint32_t* Copy_puint32Entry)
+{
+	uint32_t Local_uint32Address = BL_JOURNAL_BASE_ADDRESS;
+
+	if(Copy_puint32Entry != NULL)
+	{
+		Local_uint32Address = (uint32_t)Copy_puint32Entry + JOURNAL_ENTRY_SIZE(((const BL_JournalEntry_t*)Copy_puint32Entry)->Words);
+	}
+
+	if((Local_uint32Address > (JOURNAL_END_ADDRESS - JOURNAL_ENTRY_SIZE(0))) ||
+	   (((const BL_JournalEntry_t*)Local_uint32Address)->Magic != BL_JOURNAL_ENTRY_MAGIC) ||
+	   ((Local_uint32Address + JOURNAL_ENTRY_SIZE(((const BL_JournalEntry_t*)Local_uint32Address)->Words)) > JOURNAL_END_ADDRESS))
+	{
+		return NULL;
+	}
+
+	return (const uint32_t*)Local_uint32Address;
+}
+
+
+/*
+ * uint8_EntryIsValid
+ * ------------------
+ * The check word, programmed last, matches: the entry is complete.
+ */
+static uint8_t uint8_EntryIsValid(const uint32_t* Copy_puint32Entry)
+{
+	uint8_t Local_uint8Words = ((const BL_JournalEntry_t*)Copy_puint32Entry)->Words;
+
+	return (uint8_t)(Copy_puint32Entry[1u + Local_uint8Words] ==
+	                 uint32_EntryCheck(Copy_puint32Entry[0], (const uint8_t*)&Copy_puint32Entry[1], Local_uint8Words));
+}
+
+
+/*
+ * uint32_FindEnd
+ * --------------
+ * First address after the last entry. A log ending in anything but erased
+ * flash counts as full, so the next OPEN erases it.
+ */
+static uint32_t uint32_FindEnd(void)
+{
+	const uint32_t* Local_puint32Entry = puint32_NextEntry(NULL);
+	const uint32_t* Local_puint32Last  = NULL;
+	uint32_t Local_uint32End;
+
+	while(Local_puint32Entry != NULL)
+	{
+		Local_puint32Last  = Local_puint32Entry;
+		Local_puint32Entry = puint32_NextEntry(Local_puint32Entry);
+	}
+
+	Local_uint32End = (Local_puint32Last == NULL) ? BL_JOURNAL_BASE_ADDRESS :
+	                  ((uint32_t)Local_puint32Last + JOURNAL_ENTRY_SIZE(((const BL_JournalEntry_t*)Local_puint32Last)->Words));
+
+	if((Local_uint32End < JOURNAL_END_ADDRESS) && (*(const volatile uint32_t*)Local_uint32End != JOURNAL_ERASED_WORD))
+	{
+		Local_uint32End = JOURNAL_END_ADDRESS;
+	}
+
+	return Local_uint32End;
+}
+
+
+/*
+ * BL_uint8JournalAppend
+ * ---------------------
+ * Appends one entry: header word, payload, check word, in that order. The
+ * space is used even when a program fails (the entry then does not verify).
+ *
+ * Return:
+ * -------
+ * HAL_OK, or HAL_ERROR (length not a multiple of 4 or over 255 words, log
+ * full, program error).
+ */
+uint8_t BL_uint8JournalAppend(uint8_t Copy_uint8Type, const void* Copy_pData, uint16_t Copy_uint16Length)
+{
+	uint8_t  Local_uint8Words = (uint8_t)(Copy_uint16Length / 4u);
+	uint8_t  Local_uint8Status = HAL_ERROR;
+	uint32_t Local_uint32Header;
+	uint32_t Local_uint32Check;
+
+	if(Global_uint32JournalEnd == 0u)
+	{
+		Global_uint32JournalEnd = uint32_FindEnd();
+	}
+
+	if(((Copy_uint16Length & 0x3u) == 0u) && ((Copy_uint16Length / 4u) <= 0xFFu) &&
+	   (JOURNAL_ENTRY_SIZE(Local_uint8Words) <= (JOURNAL_END_ADDRESS - Global_uint32JournalEnd)))
+	{
+		Local_uint32Header = BL_JOURNAL_ENTRY_MAGIC | ((uint32_t)Copy_uint8Type << 16) | ((uint32_t)Local_uint8Words << 24);
+		Local_uint32Check  = uint32_EntryCheck(Local_uint32Header, (const uint8_t*)Copy_pData, Local_uint8Words);
+
+		Local_uint8Status = BL_uint8FlashProgram(Global_uint32JournalEnd, (const uint8_t*)&Local_uint32Header, 4u);
+
+		if((Local_uint8Status == HAL_OK) && (Copy_uint16Length != 0u))
+		{
+			Local_uint8Status = BL_uint8FlashProgram(Global_uint32JournalEnd + 4u, (const uint8_t*)Copy_pData, Copy_uint16Length);
+		}
+
+		if(Local_uint8Status == HAL_OK)
+		{
+			Local_uint8Status = BL_uint8FlashProgram(Global_uint32JournalEnd + 4u + Copy_uint16Length, (const uint8_t*)&Local_uint32Check, 4u);
+		}
+
+		Global_uint32JournalEnd += JOURNAL_ENTRY_SIZE(Local_uint8Words);
+	}
+
+	return Local_uint8Status;
+}
+
+
+#if BL_WEAR_STATS_ENABLE
+/*
+ * uint8_WriteWear
+ * ---------------
+ * Appends the WEAR totals Copy_puint32Base (NULL: none yet) plus the counts
+ * pending in BL_Flash.c, which are cleared once the entry is written.
+ */
+static uint8_t uint8_WriteWear(const uint32_t* Copy_puint32Base)
+{
+	uint32_t Local_uint32Wear[BL_FLASH_SECTOR_COUNT];
+	uint8_t  Local_uint8Sector;
+	uint8_t  Local_uint8Status;
+
+	for(Local_uint8Sector = 0; Local_uint8Sector < BL_FLASH_SECTOR_COUNT; Local_uint8Sector++)
+	{
+		Local_uint32Wear[Local_uint8Sector] = ((Copy_puint32Base != NULL) ? Copy_puint32Base[Local_uint8Sector] : 0u) +
+		                                      BL_uint16FlashGetEraseCount(Local_uint8Sector);
+	}
+
+	Local_uint8Status = BL_uint8JournalAppend(BL_JOURNAL_WEAR, Local_uint32Wear, sizeof(Local_uint32Wear));
+
+	if(Local_uint8Status == HAL_OK)
+	{
+		BL_voidFlashClearEraseCounts();
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * puint32_FindWear
+ * ----------------
+ * Newest WEAR totals, NULL if none was written yet.
+ */
+static const uint32_t* puint32_FindWear(void)
+{
+	uint8_t Local_uint8Words = 0;
+	const uint32_t* Local_puint32Wear = BL_puint32JournalFind(BL_JOURNAL_WEAR, &Local_uint8Words);
+
+	return (Local_uint8Words == BL_FLASH_SECTOR_COUNT) ? Local_puint32Wear : NULL;
+}
+#endif
+
+
+/*
+ * BL_uint8JournalOpen
+ * -------------------
+ * Starts the log of a new session: with less than BL_JOURNAL_RESERVE left the
+ * sector is erased first (earlier sessions are over), then OPEN [base][size].
+ */
+uint8_t BL_uint8JournalOpen(uint32_t Copy_uint32Base, uint32_t Copy_uint32Size)
+{
+	uint32_t Local_uint32Range[2];
+	uint8_t  Local_uint8Status = HAL_OK;
+#if BL_WEAR_STATS_ENABLE
+	uint32_t Local_uint32Wear[BL_FLASH_SECTOR_COUNT];
+#endif
+
+	if(Global_uint32JournalEnd == 0u)
+	{
+		Global_uint32JournalEnd = uint32_FindEnd();
+	}
+
+	if((JOURNAL_END_ADDRESS - Global_uint32JournalEnd) < BL_JOURNAL_RESERVE)
+	{
+#if BL_WEAR_STATS_ENABLE
+		BL_voidJournalGetWear(Local_uint32Wear);
+		BL_voidFlashClearEraseCounts();
+#endif
+		Local_uint8Status = BL_uint8FlashEraseSector(BL_JOURNAL_SECTOR);
+		Global_uint32JournalEnd = BL_JOURNAL_BASE_ADDRESS;
+#if BL_WEAR_STATS_ENABLE
+		if(Local_uint8Status == HAL_OK)
+		{
+			/* This erase is the one count still pending */
+			Local_uint8Status = uint8_WriteWear(Local_uint32Wear);
+		}
+#endif
+	}
+
+	if(Local_uint8Status == HAL_OK)
+	{
+		Local_uint32Range[0] = Copy_uint32Base;
+		Local_uint32Range[1] = Copy_uint32Size;
+		Local_uint8Status = BL_uint8JournalAppend(BL_JOURNAL_OPEN, Local_uint32Range, sizeof(Local_uint32Range));
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * BL_puint32JournalFind
+ * ---------------------
+ * Newest valid entry of a type in the current session (from the newest OPEN
+ * on; for BL_JOURNAL_OPEN the newest OPEN itself).
+ *
+ * Return:
+ * -------
+ * Its payload, with the number of payload words in *Copy_puint8Words, or NULL.
+ */
+const uint32_t* BL_puint32JournalFind(uint8_t Copy_uint8Type, uint8_t* Copy_puint8Words)
+{
+	const uint32_t* Local_puint32Entry = puint32_NextEntry(NULL);
+	const uint32_t* Local_puint32Found = NULL;
+	uint8_t Local_uint8Type;
+
+	while(Local_puint32Entry != NULL)
+	{
+		Local_uint8Type = ((const BL_JournalEntry_t*)Local_puint32Entry)->Type;
+
+		if(uint8_EntryIsValid(Local_puint32Entry) == 0u)
+		{
+			/* Cut by a reset */
+		}
+		else if(Local_uint8Type == Copy_uint8Type)
+		{
+			Local_puint32Found = Local_puint32Entry;
+		}
+		else if((Local_uint8Type == BL_JOURNAL_OPEN) && (Copy_uint8Type != BL_JOURNAL_WEAR))
+		{
+			Local_puint32Found = NULL;
+		}
+		else
+		{
+			/* Other type */
+		}
+
+		Local_puint32Entry = puint32_NextEntry(Local_puint32Entry);
+	}
+
+	if(Local_puint32Found != NULL)
+	{
+		*Copy_puint8Words = ((const BL_JournalEntry_t*)Local_puint32Found)->Words;
+		Local_puint32Found++;
+	}
+
+	return Local_puint32Found;
+}
+
+
+/*
+ * BL_uint8JournalIsOpen
+ * ---------------------
+ * 1 when the newest valid OPEN has no valid CLOSED after it: the session was
+ * interrupted (reset, power loss, timeout, jump) before BL_END_PROGRAM.
+ */
+uint8_t BL_uint8JournalIsOpen(void)
+{
+	const uint32_t* Local_puint32Entry = puint32_NextEntry(NULL);
+	uint8_t Local_uint8Open = 0;
+
+	while(Local_puint32Entry != NULL)
+	{
+		if(uint8_EntryIsValid(Local_puint32Entry) != 0u)
+		{
+			if(((const BL_JournalEntry_t*)Local_puint32Entry)->Type == BL_JOURNAL_OPEN)
+			{
+				Local_uint8Open = 1;
+			}
+			else if(((const BL_JournalEntry_t*)Local_puint32Entry)->Type == BL_JOURNAL_CLOSED)
+			{
+				Local_uint8Open = 0;
+			}
+		}
+
+		Local_puint32Entry = puint32_NextEntry(Local_puint32Entry);
+	}
+
+	return Local_uint8Open;
+}
+
+
+#if BL_WEAR_STATS_ENABLE
+/*
+ * BL_uint8JournalFlushWear
+ * ------------------------
+ * Adds the erases counted since the last flush to the WEAR totals: one entry,
+ * nothing written when no erase is pending. Unlocks and locks the flash
+ * itself, so it is not called while a programming session is open.
+ *
+ * Return:
+ * -------
+ * HAL_OK, or HAL_ERROR (journal full: the counts stay pending until the next
+ * OPEN erases the sector).
+ */
+uint8_t BL_uint8JournalFlushWear(void)
+{
+	uint8_t Local_uint8Sector;
+	uint8_t Local_uint8Status = HAL_OK;
+
+	for(Local_uint8Sector = 0; Local_uint8Sector < BL_FLASH_SECTOR_COUNT; Local_uint8Sector++)
+	{
+		if(BL_uint16FlashGetEraseCount(Local_uint8Sector) != 0u)
+		{
+			break;
+		}
+	}
+
+	if(Local_uint8Sector < BL_FLASH_SECTOR_COUNT)
+	{
+		HAL_FLASH_Unlock();
+		Local_uint8Status = uint8_WriteWear(puint32_FindWear());
+		HAL_FLASH_Lock();
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * BL_voidJournalGetWear
+ * ---------------------
+ * Erase count of each of the BL_FLASH_SECTOR_COUNT sectors: the newest WEAR
+ * totals plus what is still pending.
+ */
+void BL_voidJournalGetWear(uint32_t* Copy_puint32Counts)
+{
+	const uint32_t* Local_puint32Wear = puint32_FindWear();
+	uint8_t Local_uint8Sector;
+
+	for(Local_uint8Sector = 0; Local_uint8Sector < BL_FLASH_SECTOR_COUNT; Local_uint8Sector++)
+	{
+		Copy_puint32Counts[Local_uint8Sector] = ((Local_puint32Wear != NULL) ? Local_puint32Wear[Local_uint8Sector] : 0u) +
+		                                        BL_uint16FlashGetEraseCount(Local_uint8Sector);
+	}
+}
+#endif
@@ -0,0 +1,448 @@
+#include <string.h>
+#include "main.h"
+#include "BL_KV.h"
+#include "BL_Services.h"
+#include "BL_Flash.h"
+
+
+#define KV_ERASED_WORD                0xFFFFFFFFUL
+
+#define KV_SECTOR_BASE(s)             (BL_KV_BASE_ADDRESS + ((uint32_t)((s) - BL_KV_SECTOR_A) * BL_KV_SECTOR_SIZE))
+#define KV_SECTOR_HEADER(base)        ((const volatile BL_KVSector_t*)(base))
+#define KV_FIRST_RECORD(base)         ((base) + sizeof(BL_KVSector_t))
+
+/* Record header word and the bytes a record of n value bytes takes: header, data words, check */
+#define KV_RECORD_HEADER(key, n)      ((uint32_t)(key) | ((uint32_t)(n) << 16))
+#define KV_RECORD_KEY(h)              ((uint16_t)((h) & 0xFFFFu))
+#define KV_RECORD_LENGTH(h)           ((uint16_t)((h) >> 16))
+#define KV_RECORD_SIZE(n)             (((((uint32_t)(n) + 3u) / 4u) + 2u) * 4u)
+
+#define KV_RECORD(kv, slot)           ((const volatile uint32_t*)((kv)->Base + 4u * (uint32_t)(kv)->Index[slot].Word))
+
+
+/*
+ * uint32_KVDataWord
+ * -----------------
+ * Word Copy_uint16Word of a value as stored: the last one padded with 0xFF.
+ */
+static uint32_t uint32_KVDataWord(const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length, uint16_t Copy_uint16Word)
+{
+	uint32_t Local_uint32Offset = 4u * (uint32_t)Copy_uint16Word;
+	uint32_t Local_uint32Value  = KV_ERASED_WORD;
+	uint8_t  Local_uint8Byte;
+
+	if((Local_uint32Offset + 4u) <= Copy_uint16Length)
+	{
+		Local_uint32Value = __UNALIGNED_UINT32_READ(&Copy_puint8Data[Local_uint32Offset]);
+	}
+	else
+	{
+		for(Local_uint8Byte = 0; (Local_uint32Offset + Local_uint8Byte) < Copy_uint16Length; Local_uint8Byte++)
+		{
+			Local_uint32Value &= ~(0xFFUL << (8u * Local_uint8Byte));
+			Local_uint32Value |= (uint32_t)Copy_puint8Data[Local_uint32Offset + Local_uint8Byte] << (8u * Local_uint8Byte);
+		}
+	}
+
+	return Local_uint32Value;
+}
+
+
+/*
+ * uint8_KVRecordIsValid
+ * ---------------------
+ * The check word, programmed last, matches the header and data in flash.
+ */
+static uint8_t uint8_KVRecordIsValid(const volatile uint32_t* Copy_puint32Record)
+{
+	uint16_t Local_uint16Words = (uint16_t)((KV_RECORD_SIZE(KV_RECORD_LENGTH(Copy_puint32Record[0])) / 4u) - 1u);
+	uint32_t Local_uint32Check = 0;
+	uint16_t Local_uint16Index;
+
+	for(Local_uint16Index = 0; Local_uint16Index < Local_uint16Words; Local_uint16Index++)
+	{
+		Local_uint32Check ^= Copy_puint32Record[Local_uint16Index];
+	}
+
+	return (uint8_t)(Copy_puint32Record[Local_uint16Words] == ~Local_uint32Check);
+}
+
+
+/*
+ * uint16_KVFindSlot
+ * -----------------
+ * Index slot holding Copy_uint16Key, or the free slot where it would go. The
+ * index never holds more than BL_KV_MAX_KEYS, so a free slot ends every probe.
+ */
+static uint16_t uint16_KVFindSlot(const BL_KV_t* Copy_pKV, uint16_t Copy_uint16Key)
+{
+	uint16_t Local_uint16Slot = (uint16_t)((((uint32_t)Copy_uint16Key * 0x9E3779B1UL) >> 16) & (BL_KV_INDEX_SLOTS - 1u));
+
+	while((Copy_pKV->Index[Local_uint16Slot].Key != BL_KV_KEY_NONE) && (Copy_pKV->Index[Local_uint16Slot].Key != Copy_uint16Key))
+	{
+		Local_uint16Slot = (uint16_t)((Local_uint16Slot + 1u) & (BL_KV_INDEX_SLOTS - 1u));
+	}
+
+	return Local_uint16Slot;
+}
+
+
+/*
+ * voidKVIndex
+ * -----------
+ * Points the key's slot at the record at Copy_uint32Address, taking a free
+ * slot for a new key. A new key past BL_KV_MAX_KEYS is left out.
+ */
+static void voidKVIndex(BL_KV_t* Copy_pKV, uint16_t Copy_uint16Key, uint32_t Copy_uint32Address)
+{
+	uint16_t Local_uint16Slot = uint16_KVFindSlot(Copy_pKV, Copy_uint16Key);
+
+	if((Copy_pKV->Index[Local_uint16Slot].Key == BL_KV_KEY_NONE) && (Copy_pKV->Keys < BL_KV_MAX_KEYS))
+	{
+		Copy_pKV->Index[Local_uint16Slot].Key = Copy_uint16Key;
+		Copy_pKV->Keys++;
+	}
+
+	if(Copy_pKV->Index[Local_uint16Slot].Key == Copy_uint16Key)
+	{
+		Copy_pKV->Index[Local_uint16Slot].Word = (uint16_t)((Copy_uint32Address - Copy_pKV->Base) / 4u);
+	}
+}
+
+
+/*
+ * voidKVScan
+ * ----------
+ * Rebuilds the index from the active sector and finds the append address.
+ * Records that do not verify are stepped over; a header that cannot be a
+ * record ends the log as if the sector were full, so the next set compacts.
+ */
+static void voidKVScan(BL_KV_t* Copy_pKV)
+{
+	uint32_t Local_uint32SectorEnd = Copy_pKV->Base + BL_KV_SECTOR_SIZE;
+	uint32_t Local_uint32Address   = KV_FIRST_RECORD(Copy_pKV->Base);
+	uint32_t Local_uint32Header;
+	uint16_t Local_uint16Slot;
+
+	for(Local_uint16Slot = 0; Local_uint16Slot < BL_KV_INDEX_SLOTS; Local_uint16Slot++)
+	{
+		Copy_pKV->Index[Local_uint16Slot].Key = BL_KV_KEY_NONE;
+	}
+
+	Copy_pKV->Keys = 0;
+
+	while(Local_uint32Address < Local_uint32SectorEnd)
+	{
+		Local_uint32Header = *(const volatile uint32_t*)Local_uint32Address;
+
+		if(Local_uint32Header == KV_ERASED_WORD)
+		{
+			break;
+		}
+
+		if((KV_RECORD_KEY(Local_uint32Header) == BL_KV_KEY_NONE) || (KV_RECORD_LENGTH(Local_uint32Header) > BL_KV_MAX_LENGTH) ||
+		   (KV_RECORD_SIZE(KV_RECORD_LENGTH(Local_uint32Header)) > (Local_uint32SectorEnd - Local_uint32Address)))
+		{
+			Local_uint32Address = Local_uint32SectorEnd;
+			break;
+		}
+
+		if(uint8_KVRecordIsValid((const volatile uint32_t*)Local_uint32Address) != 0u)
+		{
+			voidKVIndex(Copy_pKV, KV_RECORD_KEY(Local_uint32Header), Local_uint32Address);
+		}
+
+		Local_uint32Address += KV_RECORD_SIZE(KV_RECORD_LENGTH(Local_uint32Header));
+	}
+
+	Copy_pKV->End = Local_uint32Address;
+}
+
+
+/*
+ * uint8_KVSectorIsValid
+ * ---------------------
+ * The sector header is complete (Magic, programmed last) and consistent.
+ */
+static uint8_t uint8_KVSectorIsValid(uint32_t Copy_uint32Base)
+{
+	const volatile BL_KVSector_t* Local_pHeader = KV_SECTOR_HEADER(Copy_uint32Base);
+
+	return (uint8_t)((Local_pHeader->Magic == BL_KV_MAGIC) && (Local_pHeader->Sequence == ~Local_pHeader->SequenceInv));
+}
+
+
+/*
+ * uint8_KVCompact
+ * ---------------
+ * Copies the newest record of every live key into the other sector, then
+ * makes it the active one. Called with the flash unlocked; also formats the
+ * store (no active sector: sector A, Sequence 1).
+ */
+static uint8_t uint8_KVCompact(BL_KV_t* Copy_pKV)
+{
+	uint8_t  Local_uint8Sector = (Copy_pKV->Base == KV_SECTOR_BASE(BL_KV_SECTOR_A)) ? BL_KV_SECTOR_B : BL_KV_SECTOR_A;
+	uint32_t Local_uint32Base  = KV_SECTOR_BASE(Local_uint8Sector);
+	uint32_t Local_uint32Write = KV_FIRST_RECORD(Local_uint32Base);
+	uint32_t Local_uint32Header[3];
+	uint32_t Local_uint32Size;
+	uint16_t Local_uint16Slot;
+	uint8_t  Local_uint8Status = HAL_OK;
+	const volatile uint32_t* Local_puint32Record;
+
+	if(BL_SERVICES->FlashSectorIsBlank(Local_uint8Sector) != BL_FLASH_SECTOR_BLANK)
+	{
+		Local_uint8Status = BL_SERVICES->FlashEraseSector(Local_uint8Sector);
+	}
+
+	for(Local_uint16Slot = 0; (Local_uint16Slot < BL_KV_INDEX_SLOTS) && (Local_uint8Status == HAL_OK); Local_uint16Slot++)
+	{
+		if(Copy_pKV->Index[Local_uint16Slot].Key != BL_KV_KEY_NONE)
+		{
+			Local_puint32Record = KV_RECORD(Copy_pKV, Local_uint16Slot);
+
+			if(KV_RECORD_LENGTH(Local_puint32Record[0]) != 0u)
+			{
+				Local_uint32Size  = KV_RECORD_SIZE(KV_RECORD_LENGTH(Local_puint32Record[0]));
+				Local_uint8Status = BL_SERVICES->FlashProgram(Local_uint32Write, (const uint8_t*)Local_puint32Record, Local_uint32Size);
+				Local_uint32Write += Local_uint32Size;
+			}
+		}
+	}
+
+	if(Local_uint8Status == HAL_OK)
+	{
+		Local_uint32Header[0] = Copy_pKV->Sequence + 1u;
+		Local_uint32Header[1] = ~Local_uint32Header[0];
+		Local_uint32Header[2] = BL_KV_MAGIC;
+
+		Local_uint8Status = BL_SERVICES->FlashProgram((uint32_t)&KV_SECTOR_HEADER(Local_uint32Base)->Sequence, (const uint8_t*)&Local_uint32Header[0], 8u);
+
+		if(Local_uint8Status == HAL_OK)
+		{
+			Local_uint8Status = BL_SERVICES->FlashProgram((uint32_t)&KV_SECTOR_HEADER(Local_uint32Base)->Magic, (const uint8_t*)&Local_uint32Header[2], 4u);
+		}
+	}
+
+	if(Local_uint8Status == HAL_OK)
+	{
+		Copy_pKV->Base     = Local_uint32Base;
+		Copy_pKV->Sequence = Local_uint32Header[0];
+		voidKVScan(Copy_pKV);
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * uint8_KVAppend
+ * --------------
+ * Appends one record (Copy_uint16Length 0: tombstone) and indexes it,
+ * compacting first when it does not fit. Header, data, check word, in that
+ * order; the space is used even when a program fails.
+ */
+static uint8_t uint8_KVAppend(BL_KV_t* Copy_pKV, uint16_t Copy_uint16Key, const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length)
+{
+	uint32_t Local_uint32Address;
+	uint32_t Local_uint32Word;
+	uint32_t Local_uint32Check;
+	uint16_t Local_uint16Words = (uint16_t)((Copy_uint16Length + 3u) / 4u);
+	uint16_t Local_uint16Index;
+	uint8_t  Local_uint8Status = BL_SERVICES->FlashUnlock();
+
+	if((Local_uint8Status == HAL_OK) && (BL_uint32KVGetFree(Copy_pKV) < KV_RECORD_SIZE(Copy_uint16Length)))
+	{
+		Local_uint8Status = uint8_KVCompact(Copy_pKV);
+
+		if((Local_uint8Status == HAL_OK) && (BL_uint32KVGetFree(Copy_pKV) < KV_RECORD_SIZE(Copy_uint16Length)))
+		{
+			Local_uint8Status = HAL_ERROR;
+		}
+	}
+
+	if(Local_uint8Status == HAL_OK)
+	{
+		Local_uint32Address = Copy_pKV->End;
+		Local_uint32Word    = KV_RECORD_HEADER(Copy_uint16Key, Copy_uint16Length);
+		Local_uint32Check   = Local_uint32Word;
+		Copy_pKV->End      += KV_RECORD_SIZE(Copy_uint16Length);
+
+		Local_uint8Status = BL_SERVICES->FlashProgram(Local_uint32Address, (const uint8_t*)&Local_uint32Word, 4u);
+
+		for(Local_uint16Index = 0; (Local_uint16Index < Local_uint16Words) && (Local_uint8Status == HAL_OK); Local_uint16Index++)
+		{
+			Local_uint32Word   = uint32_KVDataWord(Copy_puint8Data, Copy_uint16Length, Local_uint16Index);
+			Local_uint32Check ^= Local_uint32Word;
+			Local_uint8Status  = BL_SERVICES->FlashProgram(Local_uint32Address + 4u + (4u * (uint32_t)Local_uint16Index), (const uint8_t*)&Local_uint32Word, 4u);
+		}
+
+		if(Local_uint8Status == HAL_OK)
+		{
+			Local_uint32Check = ~Local_uint32Check;
+			Local_uint8Status = BL_SERVICES->FlashProgram(Local_uint32Address + 4u + (4u * (uint32_t)Local_uint16Words), (const uint8_t*)&Local_uint32Check, 4u);
+		}
+
+		if(Local_uint8Status == HAL_OK)
+		{
+			voidKVIndex(Copy_pKV, Copy_uint16Key, Local_uint32Address);
+		}
+	}
+
+	BL_SERVICES->FlashLock();
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * BL_voidKVInit
+ * -------------
+ * Takes the valid sector with the higher Sequence and indexes it. Without
+ * one the store reads empty and the first set formats sector A.
+ */
+void BL_voidKVInit(BL_KV_t* Copy_pKV)
+{
+	uint32_t Local_uint32BaseA = KV_SECTOR_BASE(BL_KV_SECTOR_A);
+	uint32_t Local_uint32BaseB = KV_SECTOR_BASE(BL_KV_SECTOR_B);
+	uint8_t  Local_uint8ValidA = uint8_KVSectorIsValid(Local_uint32BaseA);
+	uint8_t  Local_uint8ValidB = uint8_KVSectorIsValid(Local_uint32BaseB);
+	uint16_t Local_uint16Slot;
+
+	Copy_pKV->Base     = 0;
+	Copy_pKV->End      = 0;
+	Copy_pKV->Sequence = 0;
+	Copy_pKV->Keys     = 0;
+
+	for(Local_uint16Slot = 0; Local_uint16Slot < BL_KV_INDEX_SLOTS; Local_uint16Slot++)
+	{
+		Copy_pKV->Index[Local_uint16Slot].Key = BL_KV_KEY_NONE;
+	}
+
+	if((Local_uint8ValidB != 0u) &&
+	   ((Local_uint8ValidA == 0u) ||
+	    ((int32_t)(KV_SECTOR_HEADER(Local_uint32BaseB)->Sequence - KV_SECTOR_HEADER(Local_uint32BaseA)->Sequence) > 0)))
+	{
+		Copy_pKV->Base = Local_uint32BaseB;
+	}
+	else if(Local_uint8ValidA != 0u)
+	{
+		Copy_pKV->Base = Local_uint32BaseA;
+	}
+
+	if(Copy_pKV->Base != 0u)
+	{
+		Copy_pKV->Sequence = KV_SECTOR_HEADER(Copy_pKV->Base)->Sequence;
+		voidKVScan(Copy_pKV);
+	}
+}
+
+
+/*
+ * BL_uint16KVGet
+ * --------------
+ * Copies up to Copy_uint16Size bytes of the key's value into Copy_pData.
+ *
+ * Return:
+ * -------
+ * The full value length (more than Copy_uint16Size: truncated), or
+ * BL_KV_NOT_FOUND for a key never set or deleted.
+ */
+uint16_t BL_uint16KVGet(const BL_KV_t* Copy_pKV, uint16_t Copy_uint16Key, void* Copy_pData, uint16_t Copy_uint16Size)
+{
+	uint16_t Local_uint16Slot   = uint16_KVFindSlot(Copy_pKV, Copy_uint16Key);
+	uint16_t Local_uint16Length = BL_KV_NOT_FOUND;
+	const volatile uint32_t* Local_puint32Record;
+
+	if((Copy_uint16Key != BL_KV_KEY_NONE) && (Copy_pKV->Index[Local_uint16Slot].Key == Copy_uint16Key))
+	{
+		Local_puint32Record = KV_RECORD(Copy_pKV, Local_uint16Slot);
+		Local_uint16Length  = KV_RECORD_LENGTH(Local_puint32Record[0]);
+
+		if(Local_uint16Length == 0u)
+		{
+			Local_uint16Length = BL_KV_NOT_FOUND;
+		}
+		else
+		{
+			memcpy(Copy_pData, (const void*)&Local_puint32Record[1], (Local_uint16Length < Copy_uint16Size) ? Local_uint16Length : Copy_uint16Size);
+		}
+	}
+
+	return Local_uint16Length;
+}
+
+
+/*
+ * BL_uint8KVSet
+ * -------------
+ * Stores a value of 1 .. BL_KV_MAX_LENGTH bytes. An unchanged value writes
+ * nothing.
+ *
+ * Return:
+ * -------
+ * HAL_OK, or HAL_ERROR (bad key or length, BL_KV_MAX_KEYS keys already,
+ * store full of live values, program or erase error).
+ */
+uint8_t BL_uint8KVSet(BL_KV_t* Copy_pKV, uint16_t Copy_uint16Key, const void* Copy_pData, uint16_t Copy_uint16Length)
+{
+	uint16_t Local_uint16Slot  = uint16_KVFindSlot(Copy_pKV, Copy_uint16Key);
+	uint8_t  Local_uint8Status = HAL_ERROR;
+	const volatile uint32_t* Local_puint32Record;
+
+	if((Copy_uint16Key != BL_KV_KEY_NONE) && (Copy_uint16Length != 0u) && (Copy_uint16Length <= BL_KV_MAX_LENGTH))
+	{
+		if(Copy_pKV->Index[Local_uint16Slot].Key == Copy_uint16Key)
+		{
+			Local_puint32Record = KV_RECORD(Copy_pKV, Local_uint16Slot);
+
+			if((KV_RECORD_LENGTH(Local_puint32Record[0]) == Copy_uint16Length) &&
+			   (memcmp((const void*)&Local_puint32Record[1], Copy_pData, Copy_uint16Length) == 0))
+			{
+				Local_uint8Status = HAL_OK;
+			}
+			else
+			{
+				Local_uint8Status = uint8_KVAppend(Copy_pKV, Copy_uint16Key, (const uint8_t*)Copy_pData, Copy_uint16Length);
+			}
+		}
+		else if(Copy_pKV->Keys < BL_KV_MAX_KEYS)
+		{
+			Local_uint8Status = uint8_KVAppend(Copy_pKV, Copy_uint16Key, (const uint8_t*)Copy_pData, Copy_uint16Length);
+		}
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * BL_uint8KVDelete
+ * ----------------
+ * Appends a tombstone for a live key; its slot is given back by the next
+ * compaction.
+ */
+uint8_t BL_uint8KVDelete(BL_KV_t* Copy_pKV, uint16_t Copy_uint16Key)
+{
+	uint16_t Local_uint16Slot  = uint16_KVFindSlot(Copy_pKV, Copy_uint16Key);
+	uint8_t  Local_uint8Status = HAL_OK;
+
+	if((Copy_uint16Key != BL_KV_KEY_NONE) && (Copy_pKV->Index[Local_uint16Slot].Key == Copy_uint16Key) &&
+	   (KV_RECORD_LENGTH(KV_RECORD(Copy_pKV, Local_uint16Slot)[0]) != 0u))
+	{
+		Local_uint8Status = uint8_KVAppend(Copy_pKV, Copy_uint16Key, NULL, 0u);
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * BL_uint32KVGetFree
+ * ------------------
+ * Bytes the active sector still takes before a set compacts it.
+ */
+uint32_t BL_uint32KVGetFree(const BL_KV_t* Copy_pKV)
+{
+	return (Copy_pKV->Base == 0u) ? 0u : ((Copy_pKV->Base + BL_KV_SECTOR_SIZE) - Copy_pKV->End);
+}
@@ -0,0 +1,228 @@
+
+#include <string.h>
+#include "main.h"
+#include "BL_LZ.h"
+
+
+/* Field of the current sequence the next input byte belongs to */
+#define LZ_STATE_TOKEN               0u
+#define LZ_STATE_LITERAL_LENGTH      1u
+#define LZ_STATE_LITERALS            2u
+#define LZ_STATE_OFFSET_LOW          3u
+#define LZ_STATE_OFFSET_HIGH         4u
+#define LZ_STATE_MATCH_LENGTH        5u
+#define LZ_STATE_MATCH               6u
+
+/* Nibble value announcing length extension bytes */
+#define LZ_LENGTH_EXTENDED           15u
+
+
+/*
+ * BL_voidLZStart
+ * --------------
+ * Starts a new stream: nothing decoded yet, so the first sequence cannot
+ * refer back.
+ */
+void BL_voidLZStart(BL_LZ_t* Copy_pContext)
+{
+	Copy_pContext->Produced = 0;
+	Copy_pContext->Count    = 0;
+	Copy_pContext->Position = 0;
+	Copy_pContext->Offset   = 0;
+	Copy_pContext->Token    = 0;
+	Copy_pContext->State    = LZ_STATE_TOKEN;
+}
+
+
+/*
+ * BL_uint8LZDecode
+ * ----------------
+ * Decodes from the input until it is consumed or the output reaches the end
+ * of the window ring, whichever comes first.
+ *
+ * Parameters:
+ * -----------
+ * @param Copy_ppuint8Input        : Input pointer, advanced over the consumed bytes.
+ * @param Copy_puint16InputLength  : Input bytes left, decreased accordingly.
+ * @param Copy_ppuint8Output       : Set to the decoded bytes, inside the window.
+ * @param Copy_puint16OutputLength : Set to their number; 0 once the input is
+ *                                   consumed and nothing is pending.
+ *
+ * Behavior:
+ * ---------
+ * Literals are copied with memcpy, matches byte by byte so an offset shorter
+ * than the match repeats the pattern, as LZ4 requires. A match still running
+ * when the input ends (or the ring wraps) continues in the next call, which
+ * may then produce output without any input: call until the output length is 0.
+ *
+ * Return:
+ * -------
+ * BL_LZ_OK, or BL_LZ_CORRUPT (the context must be restarted).
+ */
+uint8_t BL_uint8LZDecode(BL_LZ_t* Copy_pContext, const uint8_t** Copy_ppuint8Input, uint16_t* Copy_puint16InputLength,
+                         uint8_t** Copy_ppuint8Output, uint16_t* Copy_puint16OutputLength)
+{
+	const uint8_t* Local_puint8Input = *Copy_ppuint8Input;
+	uint16_t Local_uint16InputLength = *Copy_puint16InputLength;
+	uint8_t  Local_uint8Status = BL_LZ_OK;
+	uint16_t Local_uint16Start;
+	uint16_t Local_uint16Source;
+	uint32_t Local_uint32Chunk;
+	uint8_t  Local_uint8Byte;
+
+	/* The previous call stopped at the end of the ring */
+	if(Copy_pContext->Position == BL_LZ_WINDOW_SIZE)
+	{
+		Copy_pContext->Position = 0;
+	}
+
+	Local_uint16Start = Copy_pContext->Position;
+
+	while((Local_uint8Status == BL_LZ_OK) && (Copy_pContext->Position < BL_LZ_WINDOW_SIZE))
+	{
+		if(Copy_pContext->State == LZ_STATE_LITERALS)
+		{
+			if(Copy_pContext->Count == 0u)
+			{
+				Copy_pContext->State = LZ_STATE_OFFSET_LOW;
+				continue;
+			}
+
+			if(Local_uint16InputLength == 0u)
+			{
+				break;
+			}
+
+			Local_uint32Chunk = Copy_pContext->Count;
+			if(Local_uint32Chunk > Local_uint16InputLength)
+			{
+				Local_uint32Chunk = Local_uint16InputLength;
+			}
+			if(Local_uint32Chunk > (uint32_t)(BL_LZ_WINDOW_SIZE - Copy_pContext->Position))
+			{
+				Local_uint32Chunk = BL_LZ_WINDOW_SIZE - Copy_pContext->Position;
+			}
+
+			memcpy(&Copy_pContext->Window[Copy_pContext->Position], Local_puint8Input, Local_uint32Chunk);
+			Local_puint8Input       += Local_uint32Chunk;
+			Local_uint16InputLength -= (uint16_t)Local_uint32Chunk;
+			Copy_pContext->Position += (uint16_t)Local_uint32Chunk;
+			Copy_pContext->Count    -= Local_uint32Chunk;
+			Copy_pContext->Produced += Local_uint32Chunk;
+		}
+		else if(Copy_pContext->State == LZ_STATE_MATCH)
+		{
+			if(Copy_pContext->Count == 0u)
+			{
+				Copy_pContext->State = LZ_STATE_TOKEN;
+				continue;
+			}
+
+			Local_uint32Chunk = Copy_pContext->Count;
+			if(Local_uint32Chunk > (uint32_t)(BL_LZ_WINDOW_SIZE - Copy_pContext->Position))
+			{
+				Local_uint32Chunk = BL_LZ_WINDOW_SIZE - Copy_pContext->Position;
+			}
+
+			/* An offset of BL_LZ_WINDOW_SIZE reads each byte just before overwriting it */
+			Local_uint16Source = (uint16_t)((Copy_pContext->Position - Copy_pContext->Offset) & (BL_LZ_WINDOW_SIZE - 1u));
+			Copy_pContext->Count    -= Local_uint32Chunk;
+			Copy_pContext->Produced += Local_uint32Chunk;
+
+			while(Local_uint32Chunk != 0u)
+			{
+				Copy_pContext->Window[Copy_pContext->Position] = Copy_pContext->Window[Local_uint16Source];
+				Copy_pContext->Position++;
+				Local_uint16Source = (Local_uint16Source + 1u) & (BL_LZ_WINDOW_SIZE - 1u);
+				Local_uint32Chunk--;
+			}
+		}
+		else if(Local_uint16InputLength == 0u)
+		{
+			break;
+		}
+		else
+		{
+			Local_uint8Byte = *Local_puint8Input;
+			Local_puint8Input++;
+			Local_uint16InputLength--;
+
+			switch(Copy_pContext->State)
+			{
+			case LZ_STATE_TOKEN:
+				Copy_pContext->Token = Local_uint8Byte;
+				Copy_pContext->Count = (uint32_t)Local_uint8Byte >> 4;
+				Copy_pContext->State = (Copy_pContext->Count == LZ_LENGTH_EXTENDED) ? LZ_STATE_LITERAL_LENGTH : LZ_STATE_LITERALS;
+				break;
+
+			case LZ_STATE_LITERAL_LENGTH:
+				Copy_pContext->Count += Local_uint8Byte;
+				if(Local_uint8Byte != 0xFFu)
+				{
+					Copy_pContext->State = LZ_STATE_LITERALS;
+				}
+				break;
+
+			case LZ_STATE_OFFSET_LOW:
+				Copy_pContext->Offset = Local_uint8Byte;
+				Copy_pContext->State  = LZ_STATE_OFFSET_HIGH;
+				break;
+
+			case LZ_STATE_OFFSET_HIGH:
+				Copy_pContext->Offset |= (uint16_t)((uint16_t)Local_uint8Byte << 8);
+
+				if((Copy_pContext->Offset == 0u) || (Copy_pContext->Offset > BL_LZ_WINDOW_SIZE) ||
+				   (Copy_pContext->Offset > Copy_pContext->Produced))
+				{
+					Local_uint8Status = BL_LZ_CORRUPT;
+				}
+				else
+				{
+					Copy_pContext->Count = (uint32_t)(Copy_pContext->Token & 0x0Fu) + BL_LZ_MIN_MATCH;
+					Copy_pContext->State = ((Copy_pContext->Token & 0x0Fu) == LZ_LENGTH_EXTENDED) ? LZ_STATE_MATCH_LENGTH : LZ_STATE_MATCH;
+				}
+				break;
+
+			default:
+				/* LZ_STATE_MATCH_LENGTH */
+				Copy_pContext->Count += Local_uint8Byte;
+				if(Local_uint8Byte != 0xFFu)
+				{
+					Copy_pContext->State = LZ_STATE_MATCH;
+				}
+				break;
+			}
+		}
+	}
+
+	*Copy_ppuint8Input        = Local_puint8Input;
+	*Copy_puint16InputLength  = Local_uint16InputLength;
+	*Copy_ppuint8Output       = &Copy_pContext->Window[Local_uint16Start];
+	*Copy_puint16OutputLength = (uint16_t)(Copy_pContext->Position - Local_uint16Start);
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * BL_uint8LZIsComplete
+ * --------------------
+ * A stream may end between two sequences, or right after the literals of a
+ * sequence (the last one has no match).
+ */
+uint8_t BL_uint8LZIsComplete(const BL_LZ_t* Copy_pContext)
+{
+	uint8_t Local_uint8Complete = 0;
+
+	if((Copy_pContext->State == LZ_STATE_TOKEN) || (Copy_pContext->State == LZ_STATE_OFFSET_LOW))
+	{
+		Local_uint8Complete = 1;
+	}
+	else if(((Copy_pContext->State == LZ_STATE_LITERALS) || (Copy_pContext->State == LZ_STATE_MATCH)) &&
+	        (Copy_pContext->Count == 0u))
+	{
+		Local_uint8Complete = 1;
+	}
+
+	return Local_uint8Complete;
+}
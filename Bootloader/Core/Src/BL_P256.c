@@ -0,0 +1,598 @@
+#include <string.h>
+#include "main.h"
+#include "BL_P256.h"
+
+
+/* Number of 32-bit words of a 256-bit integer */
+#define P256_WORDS                    8u
+
+typedef uint32_t P256_Int_t[P256_WORDS];     /* Little endian: word 0 is the least significant */
+
+/* Point in Jacobian coordinates (x = X / Z^2, y = Y / Z^3), Z = 0 is the point at infinity */
+typedef struct
+{
+	P256_Int_t X;
+	P256_Int_t Y;
+	P256_Int_t Z;
+} P256_Point_t;
+
+/* Point in affine coordinates */
+typedef struct
+{
+	P256_Int_t X;
+	P256_Int_t Y;
+} P256_Affine_t;
+
+
+/* p = 2^256 - 2^224 + 2^192 + 2^96 - 1 */
+static const P256_Int_t Global_P256Prime =
+{
+	0xFFFFFFFFUL, 0xFFFFFFFFUL, 0xFFFFFFFFUL, 0x00000000UL, 0x00000000UL, 0x00000000UL, 0x00000001UL, 0xFFFFFFFFUL
+};
+
+/* n, order of the base point */
+static const P256_Int_t Global_P256Order =
+{
+	0xFC632551UL, 0xF3B9CAC2UL, 0xA7179E84UL, 0xBCE6FAADUL, 0xFFFFFFFFUL, 0xFFFFFFFFUL, 0x00000000UL, 0xFFFFFFFFUL
+};
+
+/* b, curve y^2 = x^3 - 3x + b */
+static const P256_Int_t Global_P256B =
+{
+	0x27D2604BUL, 0x3BCE3C3EUL, 0xCC53B0F6UL, 0x651D06B0UL, 0x769886BCUL, 0xB3EBBD55UL, 0xAA3A93E7UL, 0x5AC635D8UL
+};
+
+/* G, base point */
+static const P256_Affine_t Global_P256G =
+{
+	{ 0xD898C296UL, 0xF4A13945UL, 0x2DEB33A0UL, 0x77037D81UL, 0x63A440F2UL, 0xF8BCE6E5UL, 0xE12C4247UL, 0x6B17D1F2UL },
+	{ 0x37BF51F5UL, 0xCBB64068UL, 0x6B315ECEUL, 0x2BCE3357UL, 0x7C0F9E16UL, 0x8EE7EB4AUL, 0xFE1A7F9BUL, 0x4FE342E2UL }
+};
+
+
+/*
+ * Multi-precision helpers
+ * -----------------------
+ */
+
+static uint32_t uint32_IntAdd(P256_Int_t Copy_Result, const P256_Int_t Copy_A, const P256_Int_t Copy_B)
+{
+	uint64_t Local_uint64Acc = 0;
+	uint8_t  Local_uint8Index;
+
+	for(Local_uint8Index = 0; Local_uint8Index < P256_WORDS; Local_uint8Index++)
+	{
+		Local_uint64Acc += (uint64_t)Copy_A[Local_uint8Index] + Copy_B[Local_uint8Index];
+		Copy_Result[Local_uint8Index] = (uint32_t)Local_uint64Acc;
+		Local_uint64Acc >>= 32;
+	}
+
+	return (uint32_t)Local_uint64Acc;          /* Carry */
+}
+
+static uint32_t uint32_IntSub(P256_Int_t Copy_Result, const P256_Int_t Copy_A, const P256_Int_t Copy_B)
+{
+	int64_t Local_int64Acc = 0;
+	uint8_t Local_uint8Index;
+
+	for(Local_uint8Index = 0; Local_uint8Index < P256_WORDS; Local_uint8Index++)
+	{
+		Local_int64Acc += (int64_t)Copy_A[Local_uint8Index] - Copy_B[Local_uint8Index];
+		Copy_Result[Local_uint8Index] = (uint32_t)Local_int64Acc;
+		Local_int64Acc >>= 32;
+	}
+
+	return (uint32_t)(Local_int64Acc != 0);    /* Borrow */
+}
+
+/* -1, 0 or 1 as A <, = or > B */
+static int8_t int8_IntCompare(const P256_Int_t Copy_A, const P256_Int_t Copy_B)
+{
+	int8_t Local_int8Index;
+
+	for(Local_int8Index = (int8_t)(P256_WORDS - 1u); Local_int8Index >= 0; Local_int8Index--)
+	{
+		if(Copy_A[Local_int8Index] != Copy_B[Local_int8Index])
+		{
+			return (Copy_A[Local_int8Index] > Copy_B[Local_int8Index]) ? 1 : -1;
+		}
+	}
+
+	return 0;
+}
+
+static uint8_t uint8_IntIsZero(const P256_Int_t Copy_A)
+{
+	uint32_t Local_uint32Or = 0;
+	uint8_t  Local_uint8Index;
+
+	for(Local_uint8Index = 0; Local_uint8Index < P256_WORDS; Local_uint8Index++)
+	{
+		Local_uint32Or |= Copy_A[Local_uint8Index];
+	}
+
+	return (uint8_t)(Local_uint32Or == 0u);
+}
+
+static uint8_t uint8_IntIsOne(const P256_Int_t Copy_A)
+{
+	uint32_t Local_uint32Or = Copy_A[0] ^ 1u;
+	uint8_t  Local_uint8Index;
+
+	for(Local_uint8Index = 1; Local_uint8Index < P256_WORDS; Local_uint8Index++)
+	{
+		Local_uint32Or |= Copy_A[Local_uint8Index];
+	}
+
+	return (uint8_t)(Local_uint32Or == 0u);
+}
+
+/* Shifts right by one bit, Copy_uint32Top enters as bit 255 */
+static void voidIntHalve(P256_Int_t Copy_A, uint32_t Copy_uint32Top)
+{
+	uint8_t Local_uint8Index;
+
+	for(Local_uint8Index = 0; Local_uint8Index < (P256_WORDS - 1u); Local_uint8Index++)
+	{
+		Copy_A[Local_uint8Index] = (Copy_A[Local_uint8Index] >> 1) | (Copy_A[Local_uint8Index + 1u] << 31);
+	}
+	Copy_A[P256_WORDS - 1u] = (Copy_A[P256_WORDS - 1u] >> 1) | (Copy_uint32Top << 31);
+}
+
+/* 32 big-endian bytes to an integer */
+static void voidIntFromBytes(P256_Int_t Copy_Result, const uint8_t* Copy_puint8Bytes)
+{
+	uint8_t Local_uint8Index;
+
+	for(Local_uint8Index = 0; Local_uint8Index < P256_WORDS; Local_uint8Index++)
+	{
+		const uint8_t* Local_puint8Word = &Copy_puint8Bytes[(P256_WORDS - 1u - Local_uint8Index) * 4u];
+
+		Copy_Result[Local_uint8Index] = ((uint32_t)Local_puint8Word[0] << 24) | ((uint32_t)Local_puint8Word[1] << 16) |
+		                                ((uint32_t)Local_puint8Word[2] << 8)  |  (uint32_t)Local_puint8Word[3];
+	}
+}
+
+
+/*
+ * Arithmetic modulo an odd modulus (p or n), operands already reduced
+ * --------------------------------------------------------------------
+ */
+
+static void voidModAdd(P256_Int_t Copy_Result, const P256_Int_t Copy_A, const P256_Int_t Copy_B, const P256_Int_t Copy_Mod)
+{
+	if((uint32_IntAdd(Copy_Result, Copy_A, Copy_B) != 0u) || (int8_IntCompare(Copy_Result, Copy_Mod) >= 0))
+	{
+		uint32_IntSub(Copy_Result, Copy_Result, Copy_Mod);
+	}
+}
+
+static void voidModSub(P256_Int_t Copy_Result, const P256_Int_t Copy_A, const P256_Int_t Copy_B, const P256_Int_t Copy_Mod)
+{
+	if(uint32_IntSub(Copy_Result, Copy_A, Copy_B) != 0u)
+	{
+		uint32_IntAdd(Copy_Result, Copy_Result, Copy_Mod);
+	}
+}
+
+/*
+ * voidModInverse
+ * --------------
+ * Binary extended Euclid: Copy_Result = Copy_A^-1 mod Copy_Mod, Copy_A not 0.
+ */
+static void voidModInverse(P256_Int_t Copy_Result, const P256_Int_t Copy_A, const P256_Int_t Copy_Mod)
+{
+	P256_Int_t Local_U, Local_V, Local_X1, Local_X2;
+	uint32_t   Local_uint32Carry;
+
+	memcpy(Local_U, Copy_A, sizeof(P256_Int_t));
+	memcpy(Local_V, Copy_Mod, sizeof(P256_Int_t));
+	memset(Local_X1, 0, sizeof(P256_Int_t));
+	memset(Local_X2, 0, sizeof(P256_Int_t));
+	Local_X1[0] = 1u;
+
+	while((uint8_IntIsOne(Local_U) == 0u) && (uint8_IntIsOne(Local_V) == 0u))
+	{
+		while((Local_U[0] & 1u) == 0u)
+		{
+			voidIntHalve(Local_U, 0u);
+			Local_uint32Carry = ((Local_X1[0] & 1u) != 0u) ? uint32_IntAdd(Local_X1, Local_X1, Copy_Mod) : 0u;
+			voidIntHalve(Local_X1, Local_uint32Carry);
+		}
+
+		while((Local_V[0] & 1u) == 0u)
+		{
+			voidIntHalve(Local_V, 0u);
+			Local_uint32Carry = ((Local_X2[0] & 1u) != 0u) ? uint32_IntAdd(Local_X2, Local_X2, Copy_Mod) : 0u;
+			voidIntHalve(Local_X2, Local_uint32Carry);
+		}
+
+		if(int8_IntCompare(Local_U, Local_V) >= 0)
+		{
+			uint32_IntSub(Local_U, Local_U, Local_V);
+			voidModSub(Local_X1, Local_X1, Local_X2, Copy_Mod);
+		}
+		else
+		{
+			uint32_IntSub(Local_V, Local_V, Local_U);
+			voidModSub(Local_X2, Local_X2, Local_X1, Copy_Mod);
+		}
+	}
+
+	memcpy(Copy_Result, (uint8_IntIsOne(Local_U) != 0u) ? Local_X1 : Local_X2, sizeof(P256_Int_t));
+}
+
+/* 256 x 256 -> 512-bit product, schoolbook with 64-bit accumulation (UMLAL) */
+__attribute__((optimize("O2")))
+static void voidIntMultiply(uint32_t* Copy_puint32Product, const P256_Int_t Copy_A, const P256_Int_t Copy_B)
+{
+	uint8_t Local_uint8I, Local_uint8J;
+
+	memset(Copy_puint32Product, 0, 2u * sizeof(P256_Int_t));
+
+	for(Local_uint8I = 0; Local_uint8I < P256_WORDS; Local_uint8I++)
+	{
+		uint64_t Local_uint64Acc = 0;
+
+		for(Local_uint8J = 0; Local_uint8J < P256_WORDS; Local_uint8J++)
+		{
+			Local_uint64Acc += (uint64_t)Copy_A[Local_uint8I] * Copy_B[Local_uint8J] + Copy_puint32Product[Local_uint8I + Local_uint8J];
+			Copy_puint32Product[Local_uint8I + Local_uint8J] = (uint32_t)Local_uint64Acc;
+			Local_uint64Acc >>= 32;
+		}
+		Copy_puint32Product[Local_uint8I + P256_WORDS] = (uint32_t)Local_uint64Acc;
+	}
+}
+
+/*
+ * voidOrderMultiply
+ * -----------------
+ * Copy_Result = Copy_A * Copy_B mod n, bit-serial reduction. Only called
+ * twice per signature, speed does not matter.
+ */
+static void voidOrderMultiply(P256_Int_t Copy_Result, const P256_Int_t Copy_A, const P256_Int_t Copy_B)
+{
+	uint32_t   Local_uint32Product[2u * P256_WORDS];
+	P256_Int_t Local_R = {0};
+	int16_t    Local_int16Bit;
+	uint32_t   Local_uint32Carry;
+	uint8_t    Local_uint8Index;
+
+	voidIntMultiply(Local_uint32Product, Copy_A, Copy_B);
+
+	for(Local_int16Bit = (int16_t)(64u * P256_WORDS) - 1; Local_int16Bit >= 0; Local_int16Bit--)
+	{
+		/* R = 2R + bit, R < n before so 2R + 1 < 2n */
+		Local_uint32Carry = Local_R[P256_WORDS - 1u] >> 31;
+		for(Local_uint8Index = (uint8_t)(P256_WORDS - 1u); Local_uint8Index > 0u; Local_uint8Index--)
+		{
+			Local_R[Local_uint8Index] = (Local_R[Local_uint8Index] << 1) | (Local_R[Local_uint8Index - 1u] >> 31);
+		}
+		Local_R[0] = (Local_R[0] << 1) | ((Local_uint32Product[Local_int16Bit >> 5] >> (Local_int16Bit & 31)) & 1u);
+
+		if((Local_uint32Carry != 0u) || (int8_IntCompare(Local_R, Global_P256Order) >= 0))
+		{
+			uint32_IntSub(Local_R, Local_R, Global_P256Order);
+		}
+	}
+
+	memcpy(Copy_Result, Local_R, sizeof(P256_Int_t));
+}
+
+
+/*
+ * voidFieldMultiply
+ * -----------------
+ * Copy_Result = Copy_A * Copy_B mod p. The 512-bit product (c15..c0) is
+ * folded with the FIPS 186-4 D.2.3 fast reduction:
+ *   s1 + 2 s2 + 2 s3 + s4 + s5 - d1 - d2 - d3 - d4,
+ * summed column by column with a signed carry, then brought into [0, p).
+ */
+__attribute__((optimize("O2")))
+static void voidFieldMultiply(P256_Int_t Copy_Result, const P256_Int_t Copy_A, const P256_Int_t Copy_B)
+{
+	uint32_t C[2u * P256_WORDS];
+	int64_t  Local_int64Acc;
+	int32_t  Local_int32Top;
+
+	voidIntMultiply(C, Copy_A, Copy_B);
+
+#define P256_COLUMN(j, sum)                                                  \
+	Local_int64Acc += (sum);                                                 \
+	Copy_Result[(j)] = (uint32_t)Local_int64Acc;                             \
+	Local_int64Acc >>= 32
+
+	Local_int64Acc = 0;
+	P256_COLUMN(0, (int64_t)C[0]  + C[8]  + C[9]  - C[11] - C[12] - C[13] - C[14]);
+	P256_COLUMN(1, (int64_t)C[1]  + C[9]  + C[10] - C[12] - C[13] - C[14] - C[15]);
+	P256_COLUMN(2, (int64_t)C[2]  + C[10] + C[11] - C[13] - C[14] - C[15]);
+	P256_COLUMN(3, (int64_t)C[3]  + 2 * ((int64_t)C[11] + C[12]) + C[13] - C[15] - C[8] - C[9]);
+	P256_COLUMN(4, (int64_t)C[4]  + 2 * ((int64_t)C[12] + C[13]) + C[14] - C[9] - C[10]);
+	P256_COLUMN(5, (int64_t)C[5]  + 2 * ((int64_t)C[13] + C[14]) + C[15] - C[10] - C[11]);
+	P256_COLUMN(6, (int64_t)C[6]  + 2 * ((int64_t)C[14] + C[15]) + C[14] + C[13] - C[8] - C[9]);
+	P256_COLUMN(7, (int64_t)C[7]  + 2 * (int64_t)C[15] + C[15] + C[8] - C[10] - C[11] - C[12] - C[13]);
+
+#undef P256_COLUMN
+
+	/* The signed top word is small (-4 .. 6): fold it back with +/- p */
+	Local_int32Top = (int32_t)Local_int64Acc;
+
+	while(Local_int32Top < 0)
+	{
+		Local_int32Top += (int32_t)uint32_IntAdd(Copy_Result, Copy_Result, Global_P256Prime);
+	}
+
+	while((Local_int32Top > 0) || (int8_IntCompare(Copy_Result, Global_P256Prime) >= 0))
+	{
+		Local_int32Top -= (int32_t)uint32_IntSub(Copy_Result, Copy_Result, Global_P256Prime);
+	}
+}
+
+static void voidFieldSquare(P256_Int_t Copy_Result, const P256_Int_t Copy_A)
+{
+	voidFieldMultiply(Copy_Result, Copy_A, Copy_A);
+}
+
+static void voidFieldAdd(P256_Int_t Copy_Result, const P256_Int_t Copy_A, const P256_Int_t Copy_B)
+{
+	voidModAdd(Copy_Result, Copy_A, Copy_B, Global_P256Prime);
+}
+
+static void voidFieldSub(P256_Int_t Copy_Result, const P256_Int_t Copy_A, const P256_Int_t Copy_B)
+{
+	voidModSub(Copy_Result, Copy_A, Copy_B, Global_P256Prime);
+}
+
+
+/*
+ * Point arithmetic
+ * ----------------
+ */
+
+/*
+ * voidPointDouble
+ * ---------------
+ * Jacobian doubling for a = -3 (dbl-2001-b). Infinity stays infinity (Z = 0);
+ * y = 0 cannot occur on P-256 (odd order). In place allowed.
+ */
+static void voidPointDouble(P256_Point_t* Copy_pResult, const P256_Point_t* Copy_pPoint)
+{
+	P256_Int_t Local_Delta, Local_Gamma, Local_Beta, Local_Alpha, Local_T1, Local_T2;
+
+	voidFieldSquare(Local_Delta, Copy_pPoint->Z);
+	voidFieldSquare(Local_Gamma, Copy_pPoint->Y);
+	voidFieldMultiply(Local_Beta, Copy_pPoint->X, Local_Gamma);
+
+	/* alpha = 3 (X - delta)(X + delta) */
+	voidFieldSub(Local_T1, Copy_pPoint->X, Local_Delta);
+	voidFieldAdd(Local_T2, Copy_pPoint->X, Local_Delta);
+	voidFieldMultiply(Local_Alpha, Local_T1, Local_T2);
+	voidFieldAdd(Local_T1, Local_Alpha, Local_Alpha);
+	voidFieldAdd(Local_Alpha, Local_T1, Local_Alpha);
+
+	/* Z3 = (Y + Z)^2 - gamma - delta */
+	voidFieldAdd(Local_T1, Copy_pPoint->Y, Copy_pPoint->Z);
+	voidFieldSquare(Local_T1, Local_T1);
+	voidFieldSub(Local_T1, Local_T1, Local_Gamma);
+	voidFieldSub(Copy_pResult->Z, Local_T1, Local_Delta);
+
+	/* X3 = alpha^2 - 8 beta */
+	voidFieldAdd(Local_Beta, Local_Beta, Local_Beta);          /* 2 beta */
+	voidFieldAdd(Local_Beta, Local_Beta, Local_Beta);          /* 4 beta */
+	voidFieldSquare(Local_T1, Local_Alpha);
+	voidFieldSub(Local_T1, Local_T1, Local_Beta);
+	voidFieldSub(Copy_pResult->X, Local_T1, Local_Beta);
+
+	/* Y3 = alpha (4 beta - X3) - 8 gamma^2 */
+	voidFieldSub(Local_T1, Local_Beta, Copy_pResult->X);
+	voidFieldMultiply(Local_T1, Local_Alpha, Local_T1);
+	voidFieldSquare(Local_T2, Local_Gamma);
+	voidFieldAdd(Local_T2, Local_T2, Local_T2);
+	voidFieldAdd(Local_T2, Local_T2, Local_T2);
+	voidFieldAdd(Local_T2, Local_T2, Local_T2);
+	voidFieldSub(Copy_pResult->Y, Local_T1, Local_T2);
+}
+
+/*
+ * voidPointAddAffine
+ * ------------------
+ * Point += affine point (madd-2007-bl), with the infinity and equal-point
+ * cases handled.
+ */
+static void voidPointAddAffine(P256_Point_t* Copy_pPoint, const P256_Affine_t* Copy_pAffine)
+{
+	P256_Int_t Local_Z1Z1, Local_U2, Local_S2, Local_H, Local_HH, Local_I, Local_J, Local_R, Local_V, Local_T1;
+
+	if(uint8_IntIsZero(Copy_pPoint->Z) != 0u)
+	{
+		memcpy(Copy_pPoint->X, Copy_pAffine->X, sizeof(P256_Int_t));
+		memcpy(Copy_pPoint->Y, Copy_pAffine->Y, sizeof(P256_Int_t));
+		memset(Copy_pPoint->Z, 0, sizeof(P256_Int_t));
+		Copy_pPoint->Z[0] = 1u;
+		return;
+	}
+
+	voidFieldSquare(Local_Z1Z1, Copy_pPoint->Z);
+	voidFieldMultiply(Local_U2, Copy_pAffine->X, Local_Z1Z1);
+	voidFieldMultiply(Local_S2, Copy_pAffine->Y, Copy_pPoint->Z);
+	voidFieldMultiply(Local_S2, Local_S2, Local_Z1Z1);
+
+	voidFieldSub(Local_H, Local_U2, Copy_pPoint->X);
+	voidFieldSub(Local_R, Local_S2, Copy_pPoint->Y);
+
+	if(uint8_IntIsZero(Local_H) != 0u)
+	{
+		if(uint8_IntIsZero(Local_R) != 0u)
+		{
+			voidPointDouble(Copy_pPoint, Copy_pPoint);            /* Same point */
+		}
+		else
+		{
+			memset(Copy_pPoint->Z, 0, sizeof(P256_Int_t));        /* Opposite points */
+		}
+		return;
+	}
+
+	voidFieldSquare(Local_HH, Local_H);
+	voidFieldAdd(Local_I, Local_HH, Local_HH);
+	voidFieldAdd(Local_I, Local_I, Local_I);                     /* I = 4 HH */
+	voidFieldMultiply(Local_J, Local_H, Local_I);
+	voidFieldAdd(Local_R, Local_R, Local_R);                     /* r = 2 (S2 - Y1) */
+	voidFieldMultiply(Local_V, Copy_pPoint->X, Local_I);
+
+	/* Z3 = (Z1 + H)^2 - Z1Z1 - HH */
+	voidFieldAdd(Local_T1, Copy_pPoint->Z, Local_H);
+	voidFieldSquare(Local_T1, Local_T1);
+	voidFieldSub(Local_T1, Local_T1, Local_Z1Z1);
+	voidFieldSub(Copy_pPoint->Z, Local_T1, Local_HH);
+
+	/* Y1 J, taken before Y1 is overwritten (S2 is free) */
+	voidFieldMultiply(Local_S2, Copy_pPoint->Y, Local_J);
+
+	/* X3 = r^2 - J - 2 V */
+	voidFieldSquare(Copy_pPoint->X, Local_R);
+	voidFieldSub(Copy_pPoint->X, Copy_pPoint->X, Local_J);
+	voidFieldSub(Copy_pPoint->X, Copy_pPoint->X, Local_V);
+	voidFieldSub(Copy_pPoint->X, Copy_pPoint->X, Local_V);
+
+	/* Y3 = r (V - X3) - 2 Y1 J */
+	voidFieldSub(Local_T1, Local_V, Copy_pPoint->X);
+	voidFieldMultiply(Local_T1, Local_R, Local_T1);
+	voidFieldAdd(Local_S2, Local_S2, Local_S2);
+	voidFieldSub(Copy_pPoint->Y, Local_T1, Local_S2);
+}
+
+/* Affine coordinates of a point not at infinity */
+static void voidPointToAffine(P256_Affine_t* Copy_pAffine, const P256_Point_t* Copy_pPoint)
+{
+	P256_Int_t Local_ZInv, Local_ZInv2;
+
+	voidModInverse(Local_ZInv, Copy_pPoint->Z, Global_P256Prime);
+	voidFieldSquare(Local_ZInv2, Local_ZInv);
+	voidFieldMultiply(Copy_pAffine->X, Copy_pPoint->X, Local_ZInv2);
+	voidFieldMultiply(Local_ZInv2, Local_ZInv2, Local_ZInv);
+	voidFieldMultiply(Copy_pAffine->Y, Copy_pPoint->Y, Local_ZInv2);
+}
+
+/* Coordinates below p and y^2 = x^3 - 3x + b */
+static uint8_t uint8_PointIsOnCurve(const P256_Affine_t* Copy_pAffine)
+{
+	P256_Int_t Local_Left, Local_Right, Local_T1;
+
+	if((int8_IntCompare(Copy_pAffine->X, Global_P256Prime) >= 0) || (int8_IntCompare(Copy_pAffine->Y, Global_P256Prime) >= 0))
+	{
+		return 0u;
+	}
+
+	voidFieldSquare(Local_Left, Copy_pAffine->Y);
+
+	voidFieldSquare(Local_Right, Copy_pAffine->X);
+	voidFieldMultiply(Local_Right, Local_Right, Copy_pAffine->X);
+	voidFieldAdd(Local_T1, Copy_pAffine->X, Copy_pAffine->X);
+	voidFieldAdd(Local_T1, Local_T1, Copy_pAffine->X);
+	voidFieldSub(Local_Right, Local_Right, Local_T1);
+	voidFieldAdd(Local_Right, Local_Right, Global_P256B);
+
+	return (uint8_t)(int8_IntCompare(Local_Left, Local_Right) == 0);
+}
+
+
+/*
+ * BL_uint8P256Verify
+ * ------------------
+ * ECDSA verification (FIPS 186-4, 6.4.2).
+ *
+ * Parameters:
+ * -----------
+ * @param Copy_puint8PublicKey : X || Y, big endian (BL_P256_KEY_SIZE bytes).
+ * @param Copy_puint8Digest    : SHA-256 of the signed data.
+ * @param Copy_puint8Signature : r || s, big endian (BL_P256_SIGNATURE_SIZE bytes).
+ *
+ * Behavior:
+ * ---------
+ * 1. Rejects r or s outside [1, n - 1] and a key that is not on the curve.
+ * 2. w = s^-1, u1 = e w, u2 = r w (mod n), e being the digest.
+ * 3. R = u1 G + u2 Q, scanning both scalars together from the top bit with
+ *    a table {G, Q, G + Q}. Q = -G (G + Q at infinity) is rejected.
+ * 4. Valid when R is not at infinity and x(R) mod n = r.
+ *
+ * Return:
+ * -------
+ * BL_P256_SIGNATURE_VALID or BL_P256_SIGNATURE_INVALID.
+ */
+uint8_t BL_uint8P256Verify(const uint8_t* Copy_puint8PublicKey, const uint8_t* Copy_puint8Digest,
+                           const uint8_t* Copy_puint8Signature)
+{
+	P256_Affine_t  Local_Table[3];               /* G, Q, G + Q */
+	P256_Point_t   Local_Sum;
+	P256_Int_t     Local_R, Local_S, Local_E, Local_W, Local_U1, Local_U2;
+	int16_t        Local_int16Bit;
+	uint8_t        Local_uint8Index;
+
+	voidIntFromBytes(Local_R, &Copy_puint8Signature[0]);
+	voidIntFromBytes(Local_S, &Copy_puint8Signature[32]);
+
+	if((uint8_IntIsZero(Local_R) != 0u) || (int8_IntCompare(Local_R, Global_P256Order) >= 0) ||
+	   (uint8_IntIsZero(Local_S) != 0u) || (int8_IntCompare(Local_S, Global_P256Order) >= 0))
+	{
+		return BL_P256_SIGNATURE_INVALID;
+	}
+
+	memcpy(&Local_Table[0], &Global_P256G, sizeof(P256_Affine_t));
+	voidIntFromBytes(Local_Table[1].X, &Copy_puint8PublicKey[0]);
+	voidIntFromBytes(Local_Table[1].Y, &Copy_puint8PublicKey[32]);
+
+	if(uint8_PointIsOnCurve(&Local_Table[1]) == 0u)
+	{
+		return BL_P256_SIGNATURE_INVALID;
+	}
+
+	/* e: a 256-bit digest is below 2n, one subtraction reduces it */
+	voidIntFromBytes(Local_E, Copy_puint8Digest);
+	if(int8_IntCompare(Local_E, Global_P256Order) >= 0)
+	{
+		uint32_IntSub(Local_E, Local_E, Global_P256Order);
+	}
+
+	voidModInverse(Local_W, Local_S, Global_P256Order);
+	voidOrderMultiply(Local_U1, Local_E, Local_W);
+	voidOrderMultiply(Local_U2, Local_R, Local_W);
+
+	/* G + Q */
+	memset(&Local_Sum, 0, sizeof(Local_Sum));
+	voidPointAddAffine(&Local_Sum, &Local_Table[0]);
+	voidPointAddAffine(&Local_Sum, &Local_Table[1]);
+	if(uint8_IntIsZero(Local_Sum.Z) != 0u)
+	{
+		return BL_P256_SIGNATURE_INVALID;
+	}
+	voidPointToAffine(&Local_Table[2], &Local_Sum);
+
+	/* Shamir's trick */
+	memset(&Local_Sum, 0, sizeof(Local_Sum));
+	for(Local_int16Bit = 255; Local_int16Bit >= 0; Local_int16Bit--)
+	{
+		voidPointDouble(&Local_Sum, &Local_Sum);
+
+		Local_uint8Index = (uint8_t)(((Local_U1[Local_int16Bit >> 5] >> (Local_int16Bit & 31)) & 1u) |
+		                            (((Local_U2[Local_int16Bit >> 5] >> (Local_int16Bit & 31)) & 1u) << 1));
+		if(Local_uint8Index != 0u)
+		{
+			voidPointAddAffine(&Local_Sum, &Local_Table[Local_uint8Index - 1u]);
+		}
+	}
+
+	if(uint8_IntIsZero(Local_Sum.Z) != 0u)
+	{
+		return BL_P256_SIGNATURE_INVALID;
+	}
+
+	/* x(R) < p < 2n: one subtraction reduces it mod n */
+	voidPointToAffine(&Local_Table[0], &Local_Sum);
+	if(int8_IntCompare(Local_Table[0].X, Global_P256Order) >= 0)
+	{
+		uint32_IntSub(Local_Table[0].X, Local_Table[0].X, Global_P256Order);
+	}
+
+	return (int8_IntCompare(Local_Table[0].X, Local_R) == 0) ? BL_P256_SIGNATURE_VALID : BL_P256_SIGNATURE_INVALID;
+}
@@ -0,0 +1,525 @@
+#include <string.h>
+#include "main.h"
+#include "BL_Package.h"
+#include "BL_Flash.h"
+#include "BL_Image.h"
+
+
+/* Decoder states: the manifest parts in file order, then the payload */
+#define PACKAGE_STATE_HEADER          0u
+#define PACKAGE_STATE_TABLE           1u
+#define PACKAGE_STATE_CRCS            2u
+#define PACKAGE_STATE_TRAILER         3u
+#define PACKAGE_STATE_PAYLOAD         4u
+#define PACKAGE_STATE_DONE            5u
+#define PACKAGE_STATE_FAILED          6u
+
+
+/*
+ * uint32_BlockCount
+ * -----------------
+ * Number of block CRCs of the package, the last block possibly short.
+ */
+static uint32_t uint32_BlockCount(const BL_Package_t* Copy_pContext)
+{
+	return (Copy_pContext->Header.PayloadLength + Copy_pContext->Header.BlockSize - 1u) / Copy_pContext->Header.BlockSize;
+}
+
+
+/*
+ * uint8_Gather
+ * ------------
+ * Copies input into Copy_puint8Target until it holds Copy_uint32Length
+ * bytes, Gathered counting them across calls.
+ *
+ * Return:
+ * -------
+ * 1 when the target is complete (Gathered back to 0), 0 once the input is
+ * used up before that.
+ */
+static uint8_t uint8_Gather(BL_Package_t* Copy_pContext, uint8_t* Copy_puint8Target, uint32_t Copy_uint32Length,
+                            const uint8_t** Copy_ppuint8Input, uint16_t* Copy_puint16InputLength)
+{
+	uint32_t Local_uint32Chunk = Copy_uint32Length - Copy_pContext->Gathered;
+
+	if(Local_uint32Chunk > *Copy_puint16InputLength)
+	{
+		Local_uint32Chunk = *Copy_puint16InputLength;
+	}
+
+	memcpy(&Copy_puint8Target[Copy_pContext->Gathered], *Copy_ppuint8Input, Local_uint32Chunk);
+	*Copy_ppuint8Input       += Local_uint32Chunk;
+	*Copy_puint16InputLength -= (uint16_t)Local_uint32Chunk;
+	Copy_pContext->Gathered  += Local_uint32Chunk;
+
+	if(Copy_pContext->Gathered != Copy_uint32Length)
+	{
+		return 0u;
+	}
+
+	Copy_pContext->Gathered = 0;
+	return 1u;
+}
+
+
+/*
+ * uint8_CheckHeader
+ * -----------------
+ * Header limits, before the lengths of the next parts are taken from it.
+ */
+static uint8_t uint8_CheckHeader(const BL_Package_t* Copy_pContext)
+{
+	const BL_PackageHeader_t* Local_pHeader = &Copy_pContext->Header;
+	uint8_t Local_uint8Status = BL_PACKAGE_BAD_HEADER;
+
+	if((Local_pHeader->Magic == BL_PACKAGE_MAGIC) && (Local_pHeader->Version == BL_PACKAGE_VERSION) &&
+	   (Local_pHeader->SegmentCount != 0u) && (Local_pHeader->SegmentCount <= BL_PACKAGE_MAX_SEGMENTS) &&
+	   (Local_pHeader->BlockSize >= BL_PACKAGE_MIN_BLOCK_SIZE) && (Local_pHeader->BlockSize <= BL_PACKAGE_MAX_BLOCK_SIZE) &&
+	   ((Local_pHeader->BlockSize & (Local_pHeader->BlockSize - 1u)) == 0u) &&
+	   (Local_pHeader->PayloadLength != 0u) &&
+	   (Local_pHeader->PayloadLength <= (BL_PACKAGE_MAX_BLOCKS * Local_pHeader->BlockSize)))
+	{
+		Local_uint8Status = BL_PACKAGE_MORE;
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * uint8_CheckPlan
+ * ---------------
+ * Segment table and erase plan against "Manifest Checks" in BL_Package.h.
+ */
+static uint8_t uint8_CheckPlan(const BL_Package_t* Copy_pContext)
+{
+	const BL_PackageHeader_t*  Local_pHeader = &Copy_pContext->Header;
+	const BL_PackageSegment_t* Local_pSegment;
+	uint32_t Local_uint32Next = BL_IMAGE_BASE_ADDRESS;
+	uint32_t Local_uint32Stored = 0;
+	uint32_t Local_uint32Last;
+	uint8_t  Local_uint8FirstSector = BL_uint8FlashGetSector(BL_IMAGE_BASE_ADDRESS);
+	uint8_t  Local_uint8Sector;
+	uint8_t  Local_uint8LastSector;
+	uint8_t  Local_uint8Index;
+
+	/* No bootloader sector, nothing past the last sector */
+	if(((Local_pHeader->EraseSectors & ((1UL << Local_uint8FirstSector) - 1u)) != 0u) ||
+	   ((Local_pHeader->EraseSectors >> BL_FLASH_SECTOR_COUNT) != 0u))
+	{
+		return BL_PACKAGE_BAD_PLAN;
+	}
+
+	for(Local_uint8Index = 0; Local_uint8Index < Local_pHeader->SegmentCount; Local_uint8Index++)
+	{
+		Local_pSegment   = &Copy_pContext->Segments[Local_uint8Index];
+		Local_uint32Last = Local_pSegment->Address + Local_pSegment->Length - 1u;
+
+		if((Local_pSegment->Length == 0u) || (Local_pSegment->StoredLength == 0u) ||
+		   (Local_pSegment->StoredLength > (Local_pHeader->PayloadLength - Local_uint32Stored)) ||
+		   (Local_pSegment->Address < Local_uint32Next) || (Local_uint32Last < Local_pSegment->Address))
+		{
+			return BL_PACKAGE_BAD_PLAN;
+		}
+
+		if(!((Local_pSegment->Codec == BL_PACKAGE_CODEC_RAW) && (Local_pSegment->StoredLength == Local_pSegment->Length)) &&
+		   !((Local_pSegment->Codec == BL_PACKAGE_CODEC_LZ) && (Copy_pContext->Lz != NULL)))
+		{
+			return BL_PACKAGE_BAD_PLAN;
+		}
+
+		Local_uint8Sector     = BL_uint8FlashGetSector(Local_pSegment->Address);
+		Local_uint8LastSector = BL_uint8FlashGetSector(Local_uint32Last);
+
+		if((Local_uint8Sector == BL_FLASH_INVALID_SECTOR) || (Local_uint8LastSector == BL_FLASH_INVALID_SECTOR))
+		{
+			return BL_PACKAGE_BAD_PLAN;
+		}
+
+		for(; Local_uint8Sector <= Local_uint8LastSector; Local_uint8Sector++)
+		{
+			if((Local_pHeader->EraseSectors & (1UL << Local_uint8Sector)) == 0u)
+			{
+				return BL_PACKAGE_BAD_PLAN;
+			}
+		}
+
+		Local_uint32Next    = Local_uint32Last + 1u;
+		Local_uint32Stored += Local_pSegment->StoredLength;
+	}
+
+	return (Local_uint32Stored == Local_pHeader->PayloadLength) ? BL_PACKAGE_MORE : BL_PACKAGE_BAD_PLAN;
+}
+
+
+/*
+ * voidStartSegment
+ * ----------------
+ * Output cursor on the current segment, LZ decoder restarted for it.
+ */
+static void voidStartSegment(BL_Package_t* Copy_pContext)
+{
+	const BL_PackageSegment_t* Local_pSegment = &Copy_pContext->Segments[Copy_pContext->Segment];
+
+	Copy_pContext->Address    = Local_pSegment->Address;
+	Copy_pContext->StoredLeft = Local_pSegment->StoredLength;
+	Copy_pContext->OutputLeft = Local_pSegment->Length;
+
+	if(Local_pSegment->Codec == BL_PACKAGE_CODEC_LZ)
+	{
+		BL_voidLZStart(Copy_pContext->Lz);
+	}
+}
+
+
+/*
+ * uint8_CheckManifest
+ * -------------------
+ * Runs once the trailer is in: manifest CRC, plan, then the signature (the
+ * only slow check, about 100 ms, last).
+ *
+ * Return:
+ * -------
+ * BL_PACKAGE_MANIFEST with the payload digest started and the first segment
+ * set up, or the first failing check.
+ */
+static uint8_t uint8_CheckManifest(BL_Package_t* Copy_pContext)
+{
+	uint8_t  Local_uint8Digest[BL_SHA256_DIGEST_SIZE];
+	uint32_t Local_uint32Crc;
+	uint8_t  Local_uint8Status;
+
+	memcpy(&Local_uint32Crc, Copy_pContext->Trailer, 4u);
+
+	if(BL_uint32CRCStreamFinish(&Copy_pContext->Crc) != Local_uint32Crc)
+	{
+		return BL_PACKAGE_BAD_MANIFEST;
+	}
+
+	Local_uint8Status = uint8_CheckPlan(Copy_pContext);
+
+	if((Local_uint8Status == BL_PACKAGE_MORE) && (Copy_pContext->Key != NULL))
+	{
+		BL_voidSHA256Finish(&Copy_pContext->Sha, Local_uint8Digest);
+
+		if(((Copy_pContext->Header.Flags & BL_PACKAGE_FLAG_SIGNED) == 0u) ||
+		   (BL_uint8P256Verify(Copy_pContext->Key, Local_uint8Digest, &Copy_pContext->Trailer[4]) != BL_P256_SIGNATURE_VALID))
+		{
+			Local_uint8Status = BL_PACKAGE_BAD_SIGNATURE;
+		}
+		else
+		{
+			Copy_pContext->Verified = 1;
+		}
+	}
+
+	if(Local_uint8Status == BL_PACKAGE_MORE)
+	{
+		BL_voidSHA256Start(&Copy_pContext->Sha);
+		Copy_pContext->Segment = 0;
+		voidStartSegment(Copy_pContext);
+		Local_uint8Status = BL_PACKAGE_MANIFEST;
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * uint8_GatherManifest
+ * --------------------
+ * Collects the header, segment table, block CRCs and trailer in turn, each
+ * part added to the manifest CRC and digest once complete.
+ *
+ * Return:
+ * -------
+ * BL_PACKAGE_MORE (input used up), BL_PACKAGE_MANIFEST or an error.
+ */
+static uint8_t uint8_GatherManifest(BL_Package_t* Copy_pContext, const uint8_t** Copy_ppuint8Input, uint16_t* Copy_puint16InputLength)
+{
+	uint8_t  Local_uint8Status = BL_PACKAGE_MORE;
+	uint8_t* Local_puint8Target;
+	uint32_t Local_uint32Length;
+
+	while((Local_uint8Status == BL_PACKAGE_MORE) && (Copy_pContext->State < PACKAGE_STATE_PAYLOAD))
+	{
+		if(Copy_pContext->State == PACKAGE_STATE_HEADER)
+		{
+			Local_puint8Target = (uint8_t*)&Copy_pContext->Header;
+			Local_uint32Length = BL_PACKAGE_HEADER_SIZE;
+		}
+		else if(Copy_pContext->State == PACKAGE_STATE_TABLE)
+		{
+			Local_puint8Target = (uint8_t*)Copy_pContext->Segments;
+			Local_uint32Length = BL_PACKAGE_SEGMENT_SIZE * Copy_pContext->Header.SegmentCount;
+		}
+		else if(Copy_pContext->State == PACKAGE_STATE_CRCS)
+		{
+			Local_puint8Target = (uint8_t*)Copy_pContext->BlockCrc;
+			Local_uint32Length = 4u * uint32_BlockCount(Copy_pContext);
+		}
+		else
+		{
+			Local_puint8Target = Copy_pContext->Trailer;
+			Local_uint32Length = ((Copy_pContext->Header.Flags & BL_PACKAGE_FLAG_SIGNED) != 0u) ? sizeof(Copy_pContext->Trailer) : 4u;
+		}
+
+		if(uint8_Gather(Copy_pContext, Local_puint8Target, Local_uint32Length, Copy_ppuint8Input, Copy_puint16InputLength) == 0u)
+		{
+			break;
+		}
+
+		if(Copy_pContext->State == PACKAGE_STATE_TRAILER)
+		{
+			Local_uint8Status = uint8_CheckManifest(Copy_pContext);
+		}
+		else
+		{
+			BL_voidCRCStreamUpdate(&Copy_pContext->Crc, Local_puint8Target, Local_uint32Length);
+			BL_voidSHA256Update(&Copy_pContext->Sha, Local_puint8Target, Local_uint32Length);
+
+			if(Copy_pContext->State == PACKAGE_STATE_HEADER)
+			{
+				Local_uint8Status = uint8_CheckHeader(Copy_pContext);
+			}
+		}
+
+		Copy_pContext->State++;
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * uint8_DecodePayload
+ * -------------------
+ * Next event of the payload.
+ *
+ * Behavior:
+ * ---------
+ * 1. Once the checked bytes of the block are decoded and the segment wants
+ *    more, the next block is gathered, its CRC checked and its bytes added
+ *    to the payload digest.
+ * 2. A raw segment returns its bytes in the block as they are, an LZ one
+ *    the pieces of the decoder window; no output may run past its Length.
+ * 3. A segment ends when its stored bytes are used and nothing is pending:
+ *    all of its Length written, its LZ stream on a sequence boundary. After
+ *    the last one the payload digest must match.
+ *
+ * Return:
+ * -------
+ * BL_PACKAGE_MORE, BL_PACKAGE_WRITE, BL_PACKAGE_COMPLETE or an error.
+ */
+static uint8_t uint8_DecodePayload(BL_Package_t* Copy_pContext, const uint8_t** Copy_ppuint8Input, uint16_t* Copy_puint16InputLength,
+                                   uint32_t* Copy_puint32Address, uint8_t** Copy_ppuint8Output, uint16_t* Copy_puint16OutputLength)
+{
+	const BL_PackageSegment_t* Local_pSegment;
+	uint8_t  Local_uint8Status = BL_PACKAGE_MORE;
+	uint8_t  Local_uint8Digest[BL_SHA256_DIGEST_SIZE];
+	const uint8_t* Local_puint8Stored;
+	uint16_t Local_uint16Stored;
+	uint16_t Local_uint16Output;
+	uint32_t Local_uint32Block;
+
+	while(Local_uint8Status == BL_PACKAGE_MORE)
+	{
+		if((Copy_pContext->BlockRead == Copy_pContext->BlockLength) && (Copy_pContext->StoredLeft != 0u))
+		{
+			Local_uint32Block = Copy_pContext->Header.PayloadLength - Copy_pContext->Received;
+			if(Local_uint32Block > Copy_pContext->Header.BlockSize)
+			{
+				Local_uint32Block = Copy_pContext->Header.BlockSize;
+			}
+
+			if(uint8_Gather(Copy_pContext, Copy_pContext->Block, Local_uint32Block, Copy_ppuint8Input, Copy_puint16InputLength) == 0u)
+			{
+				break;
+			}
+
+			if(BL_uint32CRCCalculate(Copy_pContext->Block, Local_uint32Block) != Copy_pContext->BlockCrc[Copy_pContext->BlockIndex])
+			{
+				Local_uint8Status = BL_PACKAGE_BAD_BLOCK;
+				break;
+			}
+
+			BL_voidSHA256Update(&Copy_pContext->Sha, Copy_pContext->Block, Local_uint32Block);
+			Copy_pContext->BlockIndex++;
+			Copy_pContext->Received   += Local_uint32Block;
+			Copy_pContext->BlockLength = (uint16_t)Local_uint32Block;
+			Copy_pContext->BlockRead   = 0;
+			continue;
+		}
+
+		Local_pSegment     = &Copy_pContext->Segments[Copy_pContext->Segment];
+		Local_puint8Stored = &Copy_pContext->Block[Copy_pContext->BlockRead];
+		Local_uint16Stored = Copy_pContext->BlockLength - Copy_pContext->BlockRead;
+		if(Local_uint16Stored > Copy_pContext->StoredLeft)
+		{
+			Local_uint16Stored = (uint16_t)Copy_pContext->StoredLeft;
+		}
+
+		if(Local_pSegment->Codec == BL_PACKAGE_CODEC_RAW)
+		{
+			*Copy_ppuint8Output = (uint8_t*)Local_puint8Stored;
+			Local_uint16Output  = Local_uint16Stored;
+			Local_puint8Stored += Local_uint16Stored;
+		}
+		else if(BL_uint8LZDecode(Copy_pContext->Lz, &Local_puint8Stored, &Local_uint16Stored,
+		                         Copy_ppuint8Output, &Local_uint16Output) != BL_LZ_OK)
+		{
+			Local_uint8Status = BL_PACKAGE_CORRUPT;
+			break;
+		}
+
+		Local_uint16Stored = (uint16_t)(Local_puint8Stored - &Copy_pContext->Block[Copy_pContext->BlockRead]);
+		Copy_pContext->BlockRead  += Local_uint16Stored;
+		Copy_pContext->StoredLeft -= Local_uint16Stored;
+
+		if(Local_uint16Output != 0u)
+		{
+			if(Local_uint16Output > Copy_pContext->OutputLeft)
+			{
+				Local_uint8Status = BL_PACKAGE_CORRUPT;
+			}
+			else
+			{
+				*Copy_puint32Address      = Copy_pContext->Address;
+				*Copy_puint16OutputLength = Local_uint16Output;
+				Copy_pContext->Address    += Local_uint16Output;
+				Copy_pContext->OutputLeft -= Local_uint16Output;
+				Local_uint8Status = BL_PACKAGE_WRITE;
+			}
+		}
+		else if(Copy_pContext->StoredLeft == 0u)
+		{
+			if((Copy_pContext->OutputLeft != 0u) ||
+			   ((Local_pSegment->Codec == BL_PACKAGE_CODEC_LZ) && (BL_uint8LZIsComplete(Copy_pContext->Lz) == 0u)))
+			{
+				Local_uint8Status = BL_PACKAGE_CORRUPT;
+			}
+			else if((Copy_pContext->Segment + 1u) < Copy_pContext->Header.SegmentCount)
+			{
+				Copy_pContext->Segment++;
+				voidStartSegment(Copy_pContext);
+			}
+			else
+			{
+				BL_voidSHA256Finish(&Copy_pContext->Sha, Local_uint8Digest);
+				Local_uint8Status = (memcmp(Local_uint8Digest, Copy_pContext->Header.PayloadSha, BL_SHA256_DIGEST_SIZE) == 0) ?
+				                    BL_PACKAGE_COMPLETE : BL_PACKAGE_BAD_DIGEST;
+				Copy_pContext->State = PACKAGE_STATE_DONE;
+			}
+		}
+		else
+		{
+			/* The block is decoded, the segment goes on in the next one */
+		}
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * BL_voidPackageStart
+ * -------------------
+ * Prepares the context for a new package.
+ *
+ * Parameters:
+ * -----------
+ * @param Copy_pContext   : Decoder context.
+ * @param Copy_pDecoder   : LZ decoder used for BL_PACKAGE_CODEC_LZ segments,
+ *                          NULL to refuse them; not touched between packages.
+ * @param Copy_puint8Key  : ECDSA-P256 public key (BL_P256.h) the package must
+ *                          be signed with, NULL to accept it unsigned.
+ */
+void BL_voidPackageStart(BL_Package_t* Copy_pContext, BL_LZ_t* Copy_pDecoder, const uint8_t* Copy_puint8Key)
+{
+	Copy_pContext->Lz          = Copy_pDecoder;
+	Copy_pContext->Key         = Copy_puint8Key;
+	Copy_pContext->Gathered    = 0;
+	Copy_pContext->Received    = 0;
+	Copy_pContext->StoredLeft  = 0;
+	Copy_pContext->OutputLeft  = 0;
+	Copy_pContext->BlockIndex  = 0;
+	Copy_pContext->BlockLength = 0;
+	Copy_pContext->BlockRead   = 0;
+	Copy_pContext->Segment     = 0;
+	Copy_pContext->Verified    = 0;
+	Copy_pContext->State       = PACKAGE_STATE_HEADER;
+
+	BL_voidCRCStreamStart(&Copy_pContext->Crc);
+	BL_voidSHA256Start(&Copy_pContext->Sha);
+}
+
+
+/*
+ * BL_uint8PackageDecode
+ * ---------------------
+ * Runs the package from the input until there is something to report.
+ *
+ * Parameters:
+ * -----------
+ * @param Copy_ppuint8Input        : Input pointer, advanced over the consumed bytes.
+ * @param Copy_puint16InputLength  : Input bytes left, decreased accordingly.
+ * @param Copy_puint32Address      : BL_PACKAGE_WRITE: where the output goes.
+ * @param Copy_ppuint8Output       : BL_PACKAGE_WRITE: the bytes, inside the
+ *                                   context or the LZ window, valid until the
+ *                                   next call.
+ * @param Copy_puint16OutputLength : BL_PACKAGE_WRITE: their number, 0 otherwise.
+ *
+ * Behavior:
+ * ---------
+ * BL_PACKAGE_MANIFEST is returned once, before any WRITE: the caller erases
+ * Header.EraseSectors (and may apply its own checks to the table) before
+ * calling again. Input left after BL_PACKAGE_COMPLETE is an error.
+ *
+ * Return:
+ * -------
+ * A BL_PACKAGE_xxx event or error; after an error every call fails until
+ * BL_voidPackageStart.
+ */
+uint8_t BL_uint8PackageDecode(BL_Package_t* Copy_pContext, const uint8_t** Copy_ppuint8Input, uint16_t* Copy_puint16InputLength,
+                              uint32_t* Copy_puint32Address, uint8_t** Copy_ppuint8Output, uint16_t* Copy_puint16OutputLength)
+{
+	uint8_t Local_uint8Status = BL_PACKAGE_MORE;
+
+	*Copy_puint16OutputLength = 0;
+
+	if(Copy_pContext->State < PACKAGE_STATE_PAYLOAD)
+	{
+		Local_uint8Status = uint8_GatherManifest(Copy_pContext, Copy_ppuint8Input, Copy_puint16InputLength);
+	}
+	else if(Copy_pContext->State == PACKAGE_STATE_PAYLOAD)
+	{
+		Local_uint8Status = uint8_DecodePayload(Copy_pContext, Copy_ppuint8Input, Copy_puint16InputLength,
+		                                        Copy_puint32Address, Copy_ppuint8Output, Copy_puint16OutputLength);
+	}
+	else if((Copy_pContext->State == PACKAGE_STATE_FAILED) || (*Copy_puint16InputLength != 0u))
+	{
+		Local_uint8Status = BL_PACKAGE_CORRUPT;
+	}
+	else
+	{
+		/* Complete, nothing more expected */
+	}
+
+	if(Local_uint8Status >= BL_PACKAGE_BAD_HEADER)
+	{
+		Copy_pContext->State = PACKAGE_STATE_FAILED;
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * BL_uint8PackageIsComplete
+ * -------------------------
+ * 1 once every segment was written and the payload digest matched.
+ */
+uint8_t BL_uint8PackageIsComplete(const BL_Package_t* Copy_pContext)
+{
+	return (uint8_t)(Copy_pContext->State == PACKAGE_STATE_DONE);
+}
@@ -0,0 +1,126 @@
+#include "main.h"
+#include "BL_Rollback.h"
+#include "BL_Flash.h"
+
+
+/* First word of the counter (FLASH_OTP_BASE: 16 blocks of 32 bytes) */
+#define ROLLBACK_OTP_ADDRESS          (FLASH_OTP_BASE + (BL_ROLLBACK_OTP_BLOCK * 32u))
+
+#define ROLLBACK_NOT_READ             0xFFFFFFFFUL
+
+
+/*
+ * Global_uint32RollbackCounter
+ * ----------------------------
+ * Value read from OTP, ROLLBACK_NOT_READ until the first BL_uint32RollbackGetCounter.
+ */
+static uint32_t Global_uint32RollbackCounter = ROLLBACK_NOT_READ;
+
+
+/*
+ * uint32_CountZeros
+ * -----------------
+ * Programmed bits of one OTP word (a bit count of its complement, no
+ * library call).
+ */
+static uint32_t uint32_CountZeros(uint32_t Copy_uint32Word)
+{
+	uint32_t Local_uint32Bits = ~Copy_uint32Word;
+
+	Local_uint32Bits = Local_uint32Bits - ((Local_uint32Bits >> 1) & 0x55555555UL);
+	Local_uint32Bits = (Local_uint32Bits & 0x33333333UL) + ((Local_uint32Bits >> 2) & 0x33333333UL);
+
+	/* Byte sums added up in the top byte: the product must wrap at 32 bits, also where long is wider */
+	return (uint32_t)(((Local_uint32Bits + (Local_uint32Bits >> 4)) & 0x0F0F0F0FUL) * 0x01010101UL) >> 24;
+}
+
+
+/*
+ * uint32_ReadCounter
+ * ------------------
+ * Programmed bits of all BL_ROLLBACK_OTP_WORDS words.
+ */
+static uint32_t uint32_ReadCounter(void)
+{
+	const volatile uint32_t* Local_puint32Word = (const volatile uint32_t*)ROLLBACK_OTP_ADDRESS;
+	uint32_t Local_uint32Count = 0;
+	uint32_t Local_uint32Index;
+
+	for(Local_uint32Index = 0; Local_uint32Index < BL_ROLLBACK_OTP_WORDS; Local_uint32Index++)
+	{
+		Local_uint32Count += uint32_CountZeros(Local_puint32Word[Local_uint32Index]);
+	}
+
+	return Local_uint32Count;
+}
+
+
+/*
+ * BL_uint32RollbackGetCounter
+ * ---------------------------
+ * The security counter (0 .. BL_ROLLBACK_MAX), read the first time only.
+ */
+uint32_t BL_uint32RollbackGetCounter(void)
+{
+	if(Global_uint32RollbackCounter == ROLLBACK_NOT_READ)
+	{
+		Global_uint32RollbackCounter = uint32_ReadCounter();
+	}
+
+	return Global_uint32RollbackCounter;
+}
+
+
+/*
+ * BL_uint8RollbackRaise
+ * ---------------------
+ * Raises the counter to Copy_uint32Value: the lowest set bits of each word,
+ * first word first, are cleared until enough bits are programmed. A value
+ * at or below the counter changes nothing. Unlocks / locks the flash itself.
+ *
+ * Return:
+ * -------
+ * HAL_OK when the counter now reads at least the value, HAL_ERROR for a
+ * value above BL_ROLLBACK_MAX or a program that did not take.
+ */
+uint8_t BL_uint8RollbackRaise(uint32_t Copy_uint32Value)
+{
+	const volatile uint32_t* Local_puint32Word = (const volatile uint32_t*)ROLLBACK_OTP_ADDRESS;
+	uint32_t Local_uint32Missing;
+	uint32_t Local_uint32Index;
+	uint32_t Local_uint32Word;
+
+	if(Copy_uint32Value > BL_ROLLBACK_MAX)
+	{
+		return HAL_ERROR;
+	}
+
+	if(Copy_uint32Value > BL_uint32RollbackGetCounter())
+	{
+		Local_uint32Missing = Copy_uint32Value - Global_uint32RollbackCounter;
+
+		HAL_FLASH_Unlock();
+
+		for(Local_uint32Index = 0; (Local_uint32Index < BL_ROLLBACK_OTP_WORDS) && (Local_uint32Missing != 0u); Local_uint32Index++)
+		{
+			Local_uint32Word = Local_puint32Word[Local_uint32Index];
+
+			while((Local_uint32Word != 0u) && (Local_uint32Missing != 0u))
+			{
+				Local_uint32Word &= Local_uint32Word - 1u;      /* Lowest set bit programmed */
+				Local_uint32Missing--;
+			}
+
+			if(Local_uint32Word != Local_puint32Word[Local_uint32Index])
+			{
+				(void)BL_uint8FlashProgram((uint32_t)&Local_puint32Word[Local_uint32Index], (const uint8_t*)&Local_uint32Word, sizeof(Local_uint32Word));
+			}
+		}
+
+		HAL_FLASH_Lock();
+
+		Global_uint32RollbackCounter = uint32_ReadCounter();
+	}
+
+	return (Global_uint32RollbackCounter >= Copy_uint32Value) ? HAL_OK : HAL_ERROR;
+}
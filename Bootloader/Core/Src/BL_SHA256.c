@@ -0,0 +1,232 @@
+
+#include <string.h>
+#include "main.h"
+#include "BL_SHA256.h"
+
+
+/* FIPS 180-4 functions, the rotates compile to single ROR instructions */
+#define ROTR(x, n)                    (((x) >> (n)) | ((x) << (32u - (n))))
+#define SIGMA0(x)                     (ROTR((x), 2u)  ^ ROTR((x), 13u) ^ ROTR((x), 22u))
+#define SIGMA1(x)                     (ROTR((x), 6u)  ^ ROTR((x), 11u) ^ ROTR((x), 25u))
+#define GAMMA0(x)                     (ROTR((x), 7u)  ^ ROTR((x), 18u) ^ ((x) >> 3u))
+#define GAMMA1(x)                     (ROTR((x), 17u) ^ ROTR((x), 19u) ^ ((x) >> 10u))
+#define CH(x, y, z)                   ((((y) ^ (z)) & (x)) ^ (z))
+#define MAJ(x, y, z)                  (((x) & (y)) | ((z) & ((x) | (y))))
+
+/*
+ * SHA256_ROUND
+ * ------------
+ * One round. Rounds 0..15 load the message word (big endian), later rounds
+ * extend the schedule in place in the 16-word window; (i) is a constant so
+ * the branch disappears. Only d and h are written: the caller rotates the
+ * variable names for the next round.
+ */
+#define SHA256_ROUND(a, b, c, d, e, f, g, h, i)                                                      \
+	do                                                                                               \
+	{                                                                                                \
+		uint32_t Local_uint32T1;                                                                     \
+		if((i) < 16u)                                                                                \
+		{                                                                                            \
+			Local_uint32W[(i) & 15u] = __REV(__UNALIGNED_UINT32_READ(Copy_puint8Data + (4u * (i)))); \
+		}                                                                                            \
+		else                                                                                         \
+		{                                                                                            \
+			Local_uint32W[(i) & 15u] += GAMMA1(Local_uint32W[((i) - 2u) & 15u]) +                    \
+			                            Local_uint32W[((i) - 7u) & 15u] +                            \
+			                            GAMMA0(Local_uint32W[((i) - 15u) & 15u]);                    \
+		}                                                                                            \
+		Local_uint32T1 = (h) + SIGMA1(e) + CH((e), (f), (g)) + Global_uint32K[(i)] + Local_uint32W[(i) & 15u]; \
+		(d) += Local_uint32T1;                                                                       \
+		(h)  = Local_uint32T1 + SIGMA0(a) + MAJ((a), (b), (c));                                      \
+	} while(0)
+
+/* Eight rounds: after them every variable is back in its own name */
+#define SHA256_ROUND8(i)                                                                             \
+	SHA256_ROUND(A, B, C, D, E, F, G, H, (i) + 0u);                                                  \
+	SHA256_ROUND(H, A, B, C, D, E, F, G, (i) + 1u);                                                  \
+	SHA256_ROUND(G, H, A, B, C, D, E, F, (i) + 2u);                                                  \
+	SHA256_ROUND(F, G, H, A, B, C, D, E, (i) + 3u);                                                  \
+	SHA256_ROUND(E, F, G, H, A, B, C, D, (i) + 4u);                                                  \
+	SHA256_ROUND(D, E, F, G, H, A, B, C, (i) + 5u);                                                  \
+	SHA256_ROUND(C, D, E, F, G, H, A, B, (i) + 6u);                                                  \
+	SHA256_ROUND(B, C, D, E, F, G, H, A, (i) + 7u)
+
+
+/* Round constants: first 32 bits of the fractional parts of the cube roots of the first 64 primes */
+static const uint32_t Global_uint32K[64] =
+{
+	0x428A2F98UL, 0x71374491UL, 0xB5C0FBCFUL, 0xE9B5DBA5UL, 0x3956C25BUL, 0x59F111F1UL, 0x923F82A4UL, 0xAB1C5ED5UL,
+	0xD807AA98UL, 0x12835B01UL, 0x243185BEUL, 0x550C7DC3UL, 0x72BE5D74UL, 0x80DEB1FEUL, 0x9BDC06A7UL, 0xC19BF174UL,
+	0xE49B69C1UL, 0xEFBE4786UL, 0x0FC19DC6UL, 0x240CA1CCUL, 0x2DE92C6FUL, 0x4A7484AAUL, 0x5CB0A9DCUL, 0x76F988DAUL,
+	0x983E5152UL, 0xA831C66DUL, 0xB00327C8UL, 0xBF597FC7UL, 0xC6E00BF3UL, 0xD5A79147UL, 0x06CA6351UL, 0x14292967UL,
+	0x27B70A85UL, 0x2E1B2138UL, 0x4D2C6DFCUL, 0x53380D13UL, 0x650A7354UL, 0x766A0ABBUL, 0x81C2C92EUL, 0x92722C85UL,
+	0xA2BFE8A1UL, 0xA81A664BUL, 0xC24B8B70UL, 0xC76C51A3UL, 0xD192E819UL, 0xD6990624UL, 0xF40E3585UL, 0x106AA070UL,
+	0x19A4C116UL, 0x1E376C08UL, 0x2748774CUL, 0x34B0BCB5UL, 0x391C0CB3UL, 0x4ED8AA4AUL, 0x5B9CCA4FUL, 0x682E6FF3UL,
+	0x748F82EEUL, 0x78A5636FUL, 0x84C87814UL, 0x8CC70208UL, 0x90BEFFFAUL, 0xA4506CEBUL, 0xBEF9A3F7UL, 0xC67178F2UL
+};
+
+/* Initial hash value: first 32 bits of the fractional parts of the square roots of the first 8 primes */
+static const uint32_t Global_uint32H0[8] =
+{
+	0x6A09E667UL, 0xBB67AE85UL, 0x3C6EF372UL, 0xA54FF53AUL, 0x510E527FUL, 0x9B05688CUL, 0x1F83D9ABUL, 0x5BE0CD19UL
+};
+
+
+/*
+ * voidSHA256Compress
+ * ------------------
+ * Hashes Copy_uint32Blocks consecutive 64-byte blocks into the state.
+ * The state is loaded into locals once and written back once.
+ */
+__attribute__((optimize("O2")))
+static void voidSHA256Compress(uint32_t* Copy_puint32State, const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Blocks)
+{
+	uint32_t A = Copy_puint32State[0], B = Copy_puint32State[1], C = Copy_puint32State[2], D = Copy_puint32State[3];
+	uint32_t E = Copy_puint32State[4], F = Copy_puint32State[5], G = Copy_puint32State[6], H = Copy_puint32State[7];
+	uint32_t Local_uint32W[16];
+
+	for( ; Copy_uint32Blocks != 0u; Copy_uint32Blocks--)
+	{
+		SHA256_ROUND8(0u);
+		SHA256_ROUND8(8u);
+		SHA256_ROUND8(16u);
+		SHA256_ROUND8(24u);
+		SHA256_ROUND8(32u);
+		SHA256_ROUND8(40u);
+		SHA256_ROUND8(48u);
+		SHA256_ROUND8(56u);
+
+		A += Copy_puint32State[0]; Copy_puint32State[0] = A;
+		B += Copy_puint32State[1]; Copy_puint32State[1] = B;
+		C += Copy_puint32State[2]; Copy_puint32State[2] = C;
+		D += Copy_puint32State[3]; Copy_puint32State[3] = D;
+		E += Copy_puint32State[4]; Copy_puint32State[4] = E;
+		F += Copy_puint32State[5]; Copy_puint32State[5] = F;
+		G += Copy_puint32State[6]; Copy_puint32State[6] = G;
+		H += Copy_puint32State[7]; Copy_puint32State[7] = H;
+
+		Copy_puint8Data += BL_SHA256_BLOCK_SIZE;
+	}
+}
+
+
+/*
+ * BL_voidSHA256Start
+ * ------------------
+ * Starts an empty hash.
+ */
+void BL_voidSHA256Start(BL_SHA256_t* Copy_pContext)
+{
+	memcpy(Copy_pContext->State, Global_uint32H0, sizeof(Global_uint32H0));
+	Copy_pContext->Length     = 0;
+	Copy_pContext->BlockCount = 0;
+}
+
+
+/*
+ * BL_voidSHA256Update
+ * -------------------
+ * Appends data to a hash.
+ *
+ * Behavior:
+ * ---------
+ * 1. Completes the unfinished block of the previous update, if any.
+ * 2. Hashes all full blocks in place from the caller's buffer.
+ * 3. Keeps the remaining bytes for the next update or the padding.
+ */
+void BL_voidSHA256Update(BL_SHA256_t* Copy_pContext, const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length)
+{
+	uint32_t Local_uint32Chunk;
+
+	Copy_pContext->Length += Copy_uint32Length;
+
+	if(Copy_pContext->BlockCount != 0u)
+	{
+		Local_uint32Chunk = BL_SHA256_BLOCK_SIZE - Copy_pContext->BlockCount;
+		if(Local_uint32Chunk > Copy_uint32Length)
+		{
+			Local_uint32Chunk = Copy_uint32Length;
+		}
+
+		memcpy(&Copy_pContext->Block[Copy_pContext->BlockCount], Copy_puint8Data, Local_uint32Chunk);
+		Copy_pContext->BlockCount = (uint8_t)(Copy_pContext->BlockCount + Local_uint32Chunk);
+		Copy_puint8Data   += Local_uint32Chunk;
+		Copy_uint32Length -= Local_uint32Chunk;
+
+		if(Copy_pContext->BlockCount == BL_SHA256_BLOCK_SIZE)
+		{
+			voidSHA256Compress(Copy_pContext->State, Copy_pContext->Block, 1u);
+			Copy_pContext->BlockCount = 0;
+		}
+	}
+
+	if(Copy_uint32Length >= BL_SHA256_BLOCK_SIZE)
+	{
+		voidSHA256Compress(Copy_pContext->State, Copy_puint8Data, Copy_uint32Length / BL_SHA256_BLOCK_SIZE);
+		Copy_puint8Data   += Copy_uint32Length & ~(BL_SHA256_BLOCK_SIZE - 1u);
+		Copy_uint32Length &= (BL_SHA256_BLOCK_SIZE - 1u);
+	}
+
+	if(Copy_uint32Length != 0u)
+	{
+		memcpy(Copy_pContext->Block, Copy_puint8Data, Copy_uint32Length);
+		Copy_pContext->BlockCount = (uint8_t)Copy_uint32Length;
+	}
+}
+
+
+/*
+ * BL_voidSHA256Finish
+ * -------------------
+ * Pads a copy of the context (0x80, zeros, 64-bit big-endian bit length) and
+ * writes the 32-byte digest. The context itself is not changed.
+ */
+void BL_voidSHA256Finish(const BL_SHA256_t* Copy_pContext, uint8_t* Copy_puint8Digest)
+{
+	uint32_t Local_uint32State[8];
+	uint8_t  Local_uint8Pad[2u * BL_SHA256_BLOCK_SIZE];
+	uint32_t Local_uint32PadLength;
+	uint32_t Local_uint32Bits = Copy_pContext->Length << 3;
+	uint8_t  Local_uint8Iterator;
+
+	memcpy(Local_uint32State, Copy_pContext->State, sizeof(Local_uint32State));
+
+	/* One block, two when the length field does not fit after the data */
+	Local_uint32PadLength = (Copy_pContext->BlockCount < (BL_SHA256_BLOCK_SIZE - 8u)) ? BL_SHA256_BLOCK_SIZE : (2u * BL_SHA256_BLOCK_SIZE);
+
+	memset(Local_uint8Pad, 0, Local_uint32PadLength);
+	memcpy(Local_uint8Pad, Copy_pContext->Block, Copy_pContext->BlockCount);
+	Local_uint8Pad[Copy_pContext->BlockCount] = 0x80u;
+
+	Local_uint8Pad[Local_uint32PadLength - 5u] = (uint8_t)(Copy_pContext->Length >> 29);
+	Local_uint8Pad[Local_uint32PadLength - 4u] = (uint8_t)(Local_uint32Bits >> 24);
+	Local_uint8Pad[Local_uint32PadLength - 3u] = (uint8_t)(Local_uint32Bits >> 16);
+	Local_uint8Pad[Local_uint32PadLength - 2u] = (uint8_t)(Local_uint32Bits >> 8);
+	Local_uint8Pad[Local_uint32PadLength - 1u] = (uint8_t)(Local_uint32Bits);
+
+	voidSHA256Compress(Local_uint32State, Local_uint8Pad, Local_uint32PadLength / BL_SHA256_BLOCK_SIZE);
+
+	for(Local_uint8Iterator = 0; Local_uint8Iterator < 8u; Local_uint8Iterator++)
+	{
+		Copy_puint8Digest[(4u * Local_uint8Iterator) + 0u] = (uint8_t)(Local_uint32State[Local_uint8Iterator] >> 24);
+		Copy_puint8Digest[(4u * Local_uint8Iterator) + 1u] = (uint8_t)(Local_uint32State[Local_uint8Iterator] >> 16);
+		Copy_puint8Digest[(4u * Local_uint8Iterator) + 2u] = (uint8_t)(Local_uint32State[Local_uint8Iterator] >> 8);
+		Copy_puint8Digest[(4u * Local_uint8Iterator) + 3u] = (uint8_t)(Local_uint32State[Local_uint8Iterator]);
+	}
+}
+
+
+/*
+ * BL_voidSHA256Calculate
+ * ----------------------
+ * One-shot digest of a memory range, hashed in place (image checks at boot,
+ * BL_VERIFY_RANGE).
+ */
+void BL_voidSHA256Calculate(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length, uint8_t* Copy_puint8Digest)
+{
+	BL_SHA256_t Local_Context;
+
+	BL_voidSHA256Start(&Local_Context);
+	BL_voidSHA256Update(&Local_Context, Copy_puint8Data, Copy_uint32Length);
+	BL_voidSHA256Finish(&Local_Context, Copy_puint8Digest);
+}
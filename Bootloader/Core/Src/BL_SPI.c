@@ -0,0 +1,287 @@
+
+#include "main.h"
+
+#if BL_TRANSPORT_SPI_ENABLE
+
+#include "BL_SPI.h"
+#include "BL_Transport.h"
+
+
+/*
+ * Global_uint8RxRing
+ * ------------------
+ * Circular reception buffer, written by DMA2 Stream0 (SPI1_RX, channel 3).
+ */
+static uint8_t  Global_uint8RxRing[BL_SPI_RX_RING_SIZE] BL_DMA_RAM_BUDGET("rx");
+
+/* Index of the next byte the parser will consume */
+static uint16_t Global_uint16RxTail;
+
+/* SPI1_RX: DMA2 Stream0 channel 3, SPI1_TX: DMA2 Stream3 channel 3 */
+static DMA_HandleTypeDef Global_hdmaSpiRx;
+static DMA_HandleTypeDef Global_hdmaSpiTx;
+
+/*
+ * Global_uint8ResponsePending
+ * ---------------------------
+ * A response is armed in the TX DMA and the master has not finished reading it.
+ * The next NSS rising edge ends the read-out instead of a command.
+ */
+static volatile uint8_t  Global_uint8ResponsePending;
+static uint32_t          Global_uint32ResponseTick;
+
+
+/*
+ * uint16_GetRxHead
+ * ----------------
+ * Index of the next byte the RX DMA will write (SIZE - NDTR).
+ */
+static uint16_t uint16_GetRxHead(void)
+{
+	return (uint16_t)((BL_SPI_RX_RING_SIZE - __HAL_DMA_GET_COUNTER(&Global_hdmaSpiRx)) & (BL_SPI_RX_RING_SIZE - 1u));
+}
+
+
+/*
+ * voidConfigureSPI
+ * ----------------
+ * Resets SPI1 and configures it as slave: mode 0, 8-bit, MSB first, software NSS
+ * (SSI driven from the NSS pin interrupt), both DMA requests enabled.
+ * The reset is also the only way to drop a byte left in the TX buffer
+ * when the master stops reading a response early.
+ */
+static void voidConfigureSPI(void)
+{
+	__HAL_RCC_SPI1_FORCE_RESET();
+	__HAL_RCC_SPI1_RELEASE_RESET();
+
+	SPI1->CR1 = SPI_CR1_SSM | SPI_CR1_SSI;
+	SPI1->CR2 = SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN;
+	SPI1->CR1 |= SPI_CR1_SPE;
+}
+
+
+/*
+ * voidEndResponse
+ * ---------------
+ * Closes a response read-out: stops the TX DMA, flushes SPI1 and discards the
+ * filler bytes the master clocked in while reading.
+ */
+static void voidEndResponse(void)
+{
+	HAL_DMA_Abort(&Global_hdmaSpiTx);
+	voidConfigureSPI();
+
+	Global_uint16RxTail = uint16_GetRxHead();
+	Global_uint8ResponsePending = 0;
+}
+
+
+/*
+ * BL_voidSPIInit
+ * --------------
+ * Starts SPI1 in slave mode with circular DMA reception and the NSS interrupt.
+ * READY stays low until the frame parser waits for the first command.
+ */
+void BL_voidSPIInit(void)
+{
+	GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+	__HAL_RCC_SPI1_CLK_ENABLE();
+	__HAL_RCC_DMA2_CLK_ENABLE();
+	__HAL_RCC_GPIOA_CLK_ENABLE();
+	__HAL_RCC_GPIOB_CLK_ENABLE();
+
+	/* READY / busy output */
+	HAL_GPIO_WritePin(BL_SPI_READY_PORT, BL_SPI_READY_PIN, GPIO_PIN_RESET);
+	GPIO_InitStruct.Pin = BL_SPI_READY_PIN;
+	GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+	GPIO_InitStruct.Pull = GPIO_NOPULL;
+	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+	HAL_GPIO_Init(BL_SPI_READY_PORT, &GPIO_InitStruct);
+
+	/* NSS input, both edges */
+	GPIO_InitStruct.Pin = BL_SPI_NSS_PIN;
+	GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING_FALLING;
+	GPIO_InitStruct.Pull = GPIO_PULLUP;
+	HAL_GPIO_Init(BL_SPI_NSS_PORT, &GPIO_InitStruct);
+
+	Global_hdmaSpiRx.Instance = DMA2_Stream0;
+	Global_hdmaSpiRx.Init.Channel = DMA_CHANNEL_3;
+	Global_hdmaSpiRx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+	Global_hdmaSpiRx.Init.PeriphInc = DMA_PINC_DISABLE;
+	Global_hdmaSpiRx.Init.MemInc = DMA_MINC_ENABLE;
+	Global_hdmaSpiRx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	Global_hdmaSpiRx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	Global_hdmaSpiRx.Init.Mode = DMA_CIRCULAR;
+	Global_hdmaSpiRx.Init.Priority = DMA_PRIORITY_HIGH;
+	Global_hdmaSpiRx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+	if (HAL_DMA_Init(&Global_hdmaSpiRx) != HAL_OK)
+	{
+		Error_Handler();
+	}
+
+	Global_hdmaSpiTx.Instance = DMA2_Stream3;
+	Global_hdmaSpiTx.Init.Channel = DMA_CHANNEL_3;
+	Global_hdmaSpiTx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+	Global_hdmaSpiTx.Init.PeriphInc = DMA_PINC_DISABLE;
+	Global_hdmaSpiTx.Init.MemInc = DMA_MINC_ENABLE;
+	Global_hdmaSpiTx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	Global_hdmaSpiTx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	Global_hdmaSpiTx.Init.Mode = DMA_NORMAL;
+	Global_hdmaSpiTx.Init.Priority = DMA_PRIORITY_LOW;
+	Global_hdmaSpiTx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+	if (HAL_DMA_Init(&Global_hdmaSpiTx) != HAL_OK)
+	{
+		Error_Handler();
+	}
+
+	Global_uint16RxTail = 0;
+	Global_uint8ResponsePending = 0;
+	HAL_DMA_Start(&Global_hdmaSpiRx, (uint32_t)&SPI1->DR, (uint32_t)Global_uint8RxRing, BL_SPI_RX_RING_SIZE);
+
+	voidConfigureSPI();
+
+	HAL_NVIC_EnableIRQ(EXTI15_10_IRQn);
+}
+
+
+/*
+ * BL_voidSPIDeInit
+ * ----------------
+ * NSS interrupt off, both DMA streams stopped and SPI1 held in reset with its
+ * clock off. READY stays low, so the master sees a busy slave. DMA2's clock
+ * is left alone, other streams may use it.
+ */
+void BL_voidSPIDeInit(void)
+{
+	HAL_NVIC_DisableIRQ(EXTI15_10_IRQn);
+
+	HAL_DMA_Abort(&Global_hdmaSpiRx);
+	HAL_DMA_Abort(&Global_hdmaSpiTx);
+	Global_uint8ResponsePending = 0;
+
+	HAL_GPIO_WritePin(BL_SPI_READY_PORT, BL_SPI_READY_PIN, GPIO_PIN_RESET);
+
+	__HAL_RCC_SPI1_FORCE_RESET();
+	__HAL_RCC_SPI1_CLK_DISABLE();
+	__HAL_GPIO_EXTI_CLEAR_IT(BL_SPI_NSS_PIN);
+	HAL_NVIC_ClearPendingIRQ(EXTI15_10_IRQn);
+}
+
+
+/*
+ * BL_uint16SPIAvailable
+ * ---------------------
+ * Returns the number of received bytes not yet consumed by the parser.
+ */
+uint16_t BL_uint16SPIAvailable(void)
+{
+	return (uint16_t)((uint16_GetRxHead() - Global_uint16RxTail) & (BL_SPI_RX_RING_SIZE - 1u));
+}
+
+
+/*
+ * BL_uint8SPIPeek
+ * ---------------
+ * Returns the byte Copy_uint16Offset positions after the ring tail.
+ */
+uint8_t BL_uint8SPIPeek(uint16_t Copy_uint16Offset)
+{
+	return Global_uint8RxRing[(Global_uint16RxTail + Copy_uint16Offset) & (BL_SPI_RX_RING_SIZE - 1u)];
+}
+
+
+/*
+ * BL_voidSPIConsume
+ * -----------------
+ * Releases bytes from the RX ring.
+ */
+void BL_voidSPIConsume(uint16_t Copy_uint16Count)
+{
+	Global_uint16RxTail = (Global_uint16RxTail + Copy_uint16Count) & (BL_SPI_RX_RING_SIZE - 1u);
+}
+
+
+/*
+ * BL_voidSPISetReady
+ * ------------------
+ * Tells the master the bootloader is idle and accepts the next command.
+ */
+void BL_voidSPISetReady(void)
+{
+	HAL_GPIO_WritePin(BL_SPI_READY_PORT, BL_SPI_READY_PIN, GPIO_PIN_SET);
+}
+
+
+/*
+ * BL_voidSPITransmit
+ * ------------------
+ * Arms the TX DMA with a complete response and raises READY; the master
+ * reads it in its next transfer. The buffer must stay valid until then.
+ */
+void BL_voidSPITransmit(uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length)
+{
+	BL_voidSPITxFlush();
+
+	HAL_DMA_Abort(&Global_hdmaSpiTx);
+	HAL_DMA_Start(&Global_hdmaSpiTx, (uint32_t)Copy_puint8Data, (uint32_t)&SPI1->DR, Copy_uint16Length);
+
+	Global_uint32ResponseTick   = HAL_GetTick();
+	Global_uint8ResponsePending = 1;
+
+	BL_voidSPISetReady();
+}
+
+
+/*
+ * BL_voidSPITxFlush
+ * -----------------
+ * Waits until the master has read the armed response; a response left unread
+ * for BL_SPI_RESPONSE_TIMEOUT_MS is dropped so the other links cannot stall.
+ */
+void BL_voidSPITxFlush(void)
+{
+	while(Global_uint8ResponsePending != 0)
+	{
+		if((HAL_GetTick() - Global_uint32ResponseTick) >= BL_SPI_RESPONSE_TIMEOUT_MS)
+		{
+			HAL_NVIC_DisableIRQ(EXTI15_10_IRQn);
+			voidEndResponse();
+			HAL_NVIC_EnableIRQ(EXTI15_10_IRQn);
+		}
+	}
+}
+
+
+/*
+ * BL_voidSPINssIRQHandler
+ * -----------------------
+ * NSS falling : the slave is selected (SSI = 0) and shifts data.
+ * NSS rising  : end of a transfer.
+ *      - after a response read-out, the response is closed and READY stays high.
+ *      - after a command, READY drops (busy) and the parser is woken.
+ */
+void BL_voidSPINssIRQHandler(void)
+{
+	if(HAL_GPIO_ReadPin(BL_SPI_NSS_PORT, BL_SPI_NSS_PIN) == GPIO_PIN_RESET)
+	{
+		SPI1->CR1 &= ~SPI_CR1_SSI;
+	}
+	else
+	{
+		SPI1->CR1 |= SPI_CR1_SSI;
+
+		if(Global_uint8ResponsePending != 0)
+		{
+			voidEndResponse();
+		}
+		else
+		{
+			HAL_GPIO_WritePin(BL_SPI_READY_PORT, BL_SPI_READY_PIN, GPIO_PIN_RESET);
+			BL_voidTransportNotifyRx();
+		}
+	}
+}
+
+#endif /* BL_TRANSPORT_SPI_ENABLE */
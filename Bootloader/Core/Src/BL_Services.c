@@ -0,0 +1,389 @@
+#include "main.h"
+#include "BL_Services.h"
+#include "BL_SHA256.h"
+#include "BL_Image.h"
+#include "BL_Flash.h"
+#include "BL_Staging.h"
+#include "BL_KV.h"
+
+
+/* First flash address the services may program or erase: sector 2 */
+#define SERVICES_FLASH_START          0x08008000UL
+#define SERVICES_FIRST_SECTOR         2u
+#define SERVICES_LAST_SECTOR          11u
+
+/* Error flags reported by the flash interface after an operation */
+#define SERVICES_FLASH_ERRORS         (FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_PGSERR)
+
+
+/*
+ * uint8_ServiceWaitForFlash
+ * -------------------------
+ * Waits for the flash operation to end, reports and clears its error flags.
+ */
+static uint8_t uint8_ServiceWaitForFlash(void)
+{
+	uint8_t Local_uint8Status = HAL_OK;
+
+	while((FLASH->SR & FLASH_SR_BSY) != 0u)
+	{
+	}
+
+	if((FLASH->SR & SERVICES_FLASH_ERRORS) != 0u)
+	{
+		FLASH->SR = SERVICES_FLASH_ERRORS;
+		Local_uint8Status = HAL_ERROR;
+	}
+
+	FLASH->SR = FLASH_SR_EOP;
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * voidServiceCrcFeed
+ * ------------------
+ * Feeds data to the CRC unit without resetting it, every word written by
+ * the CPU.
+ */
+static void voidServiceCrcFeed(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length)
+{
+	for( ; Copy_uint32Length >= 4u; Copy_uint32Length -= 4u)
+	{
+		CRC->DR = __UNALIGNED_UINT32_READ(Copy_puint8Data);
+		Copy_puint8Data += 4u;
+	}
+
+	/* Tail bytes, one per word */
+	for( ; Copy_uint32Length != 0u; Copy_uint32Length--)
+	{
+		CRC->DR = *Copy_puint8Data;
+		Copy_puint8Data++;
+	}
+}
+
+
+/*
+ * uint32_ServiceCrc
+ * -----------------
+ * Word-wise CRC from a reset unit.
+ */
+static uint32_t uint32_ServiceCrc(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length)
+{
+	CRC->CR = CRC_CR_RESET;
+	voidServiceCrcFeed(Copy_puint8Data, Copy_uint32Length);
+
+	return CRC->DR;
+}
+
+
+/*
+ * uint8_ServiceFlashUnlock
+ * ------------------------
+ * Key sequence on FLASH->KEYR; a wrong sequence locks the interface until reset.
+ */
+static uint8_t uint8_ServiceFlashUnlock(void)
+{
+	if((FLASH->CR & FLASH_CR_LOCK) != 0u)
+	{
+		FLASH->KEYR = FLASH_KEY1;
+		FLASH->KEYR = FLASH_KEY2;
+	}
+
+	return ((FLASH->CR & FLASH_CR_LOCK) == 0u) ? HAL_OK : HAL_ERROR;
+}
+
+
+/*
+ * voidServiceFlashLock
+ * --------------------
+ * Locks the flash control register again.
+ */
+static void voidServiceFlashLock(void)
+{
+	FLASH->CR |= FLASH_CR_LOCK;
+}
+
+
+/*
+ * uint8_ServiceFlashProgram
+ * -------------------------
+ * Programs whole words (PSIZE x32, 2.7 V .. 3.6 V) into the application area.
+ *
+ * Return:
+ * -------
+ * HAL_ERROR for an unaligned or out-of-range request, or at the first failing
+ * word; HAL_OK otherwise.
+ */
+static uint8_t uint8_ServiceFlashProgram(uint32_t Copy_uint32Address, const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length)
+{
+	uint8_t  Local_uint8Status = HAL_ERROR;
+	uint32_t Local_uint32Offset;
+
+	if((((Copy_uint32Address | Copy_uint32Length) & 0x3u) == 0u) && (Copy_uint32Address >= SERVICES_FLASH_START) &&
+	   (Copy_uint32Length <= ((FLASH_END + 1u) - Copy_uint32Address)))
+	{
+		Local_uint8Status = uint8_ServiceWaitForFlash();
+
+		FLASH->CR &= ~FLASH_CR_PSIZE;
+		FLASH->CR |= FLASH_CR_PSIZE_1 | FLASH_CR_PG;
+
+		for(Local_uint32Offset = 0; (Local_uint32Offset < Copy_uint32Length) && (Local_uint8Status == HAL_OK); Local_uint32Offset += 4u)
+		{
+			*(volatile uint32_t*)(Copy_uint32Address + Local_uint32Offset) = __UNALIGNED_UINT32_READ(&Copy_puint8Data[Local_uint32Offset]);
+			Local_uint8Status = uint8_ServiceWaitForFlash();
+		}
+
+		FLASH->CR &= ~FLASH_CR_PG;
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * uint8_ServiceFlashEraseSector
+ * -----------------------------
+ * Erases one application sector with x32 parallelism, then resets the ART
+ * caches so no stale line of the sector is served.
+ */
+static uint8_t uint8_ServiceFlashEraseSector(uint8_t Copy_uint8Sector)
+{
+	uint8_t Local_uint8Status = HAL_ERROR;
+
+	if((Copy_uint8Sector >= SERVICES_FIRST_SECTOR) && (Copy_uint8Sector <= SERVICES_LAST_SECTOR))
+	{
+		Local_uint8Status = uint8_ServiceWaitForFlash();
+
+		if(Local_uint8Status == HAL_OK)
+		{
+			FLASH->CR &= ~(FLASH_CR_PSIZE | FLASH_CR_SNB);
+			FLASH->CR |= FLASH_CR_PSIZE_1 | FLASH_CR_SER | ((uint32_t)Copy_uint8Sector << FLASH_CR_SNB_Pos);
+			FLASH->CR |= FLASH_CR_STRT;
+
+			Local_uint8Status = uint8_ServiceWaitForFlash();
+
+			FLASH->CR &= ~(FLASH_CR_SER | FLASH_CR_SNB);
+
+			if((FLASH->ACR & FLASH_ACR_ICEN) != 0u)
+			{
+				FLASH->ACR &= ~FLASH_ACR_ICEN;
+				FLASH->ACR |= FLASH_ACR_ICRST;
+				FLASH->ACR &= ~FLASH_ACR_ICRST;
+				FLASH->ACR |= FLASH_ACR_ICEN;
+			}
+
+			if((FLASH->ACR & FLASH_ACR_DCEN) != 0u)
+			{
+				FLASH->ACR &= ~FLASH_ACR_DCEN;
+				FLASH->ACR |= FLASH_ACR_DCRST;
+				FLASH->ACR &= ~FLASH_ACR_DCRST;
+				FLASH->ACR |= FLASH_ACR_DCEN;
+			}
+		}
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * uint8_ServiceFlashSectorIsBlank
+ * -------------------------------
+ * BL_uint8FlashSectorIsBlank for a caller-supplied sector number; an invalid
+ * one reads as not blank, so nothing gets erased for it.
+ */
+static uint8_t uint8_ServiceFlashSectorIsBlank(uint8_t Copy_uint8Sector)
+{
+	return (Copy_uint8Sector < BL_FLASH_SECTOR_COUNT) ? BL_uint8FlashSectorIsBlank(Copy_uint8Sector) : BL_FLASH_SECTOR_NOT_BLANK;
+}
+
+
+/*
+ * uint8_ServiceInactiveSectors
+ * ----------------------------
+ * First sector and number of sectors of the area the next update is written
+ * to without touching the running image: the A/B update slot, or the swap
+ * scratch area. Header reads only (BL_uint8ImageGetActiveSlot).
+ *
+ * Return:
+ * -------
+ * HAL_OK, or HAL_ERROR with a count of 0 when the image has a single slot.
+ */
+static uint8_t uint8_ServiceInactiveSectors(uint8_t* Copy_puint8First, uint8_t* Copy_puint8Count)
+{
+	uint8_t Local_uint8Status = HAL_ERROR;
+
+	*Copy_puint8First = 0;
+	*Copy_puint8Count = 0;
+
+#if BL_AB_SLOTS_ENABLE
+	uint8_t Local_uint8Slot = BL_uint8ImageGetUpdateSlot();
+
+	*Copy_puint8First = BL_uint8FlashGetSector(BL_uint32ImageGetSlotBase(Local_uint8Slot));
+	*Copy_puint8Count = (uint8_t)(BL_uint8FlashGetSector(BL_uint32ImageGetSlotEnd(Local_uint8Slot) - 1u) + 1u - *Copy_puint8First);
+	Local_uint8Status = HAL_OK;
+#elif BL_SWAP_ENABLE
+	*Copy_puint8First = BL_SWAP_SCRATCH_FIRST_SECTOR;
+	*Copy_puint8Count = BL_SWAP_SCRATCH_SECTORS;
+	Local_uint8Status = HAL_OK;
+#endif
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * uint8_ServiceImageActivateUpdate
+ * --------------------------------
+ * BL_uint8ImageActivate of the update slot, with the CRC fed by the CPU and
+ * the header words programmed by the service flash entries: nothing here
+ * touches the bootloader's RAM, DMA or HAL state.
+ *
+ * Behavior:
+ * ---------
+ * 1. The update slot must be plausible (BL_uint8ImageSlotIsPlausible), its
+ *    Crc stamped and its Activated word still erased.
+ * 2. The image CRC comes from the two pieces around the Crc, Validated and
+ *    Activated words, as at boot; the caller enables the CRC clock.
+ * 3. A blank Validated word is marked, then Activated is programmed with the
+ *    active slot's sequence + 1 and, with BL_TRIAL_BOOT_ENABLE, the trial is
+ *    started.
+ *
+ * Return:
+ * -------
+ * HAL_OK when the update slot is now the active one, HAL_ERROR otherwise.
+ */
+static uint8_t uint8_ServiceImageActivateUpdate(void)
+{
+	uint8_t Local_uint8Status = HAL_ERROR;
+
+#if (BL_AB_SLOTS_ENABLE && (BL_SIGNATURE_ENABLE == 0))
+	uint8_t  Local_uint8Slot = BL_uint8ImageGetUpdateSlot();
+	uint32_t Local_uint32Base = BL_uint32ImageGetSlotBase(Local_uint8Slot);
+	const volatile BL_ImageHeader_t* Local_pHeader = (const volatile BL_ImageHeader_t*)(Local_uint32Base + BL_IMAGE_HEADER_OFFSET);
+	const volatile BL_ImageHeader_t* Local_pActive = (const volatile BL_ImageHeader_t*)(BL_uint32ImageGetSlotBase(BL_uint8ImageGetActiveSlot()) + BL_IMAGE_HEADER_OFFSET);
+	const uint8_t* Local_puint8Skip = (const uint8_t*)&Local_pHeader->Crc;
+	const uint8_t* Local_puint8Rest = (const uint8_t*)(&Local_pHeader->Activated + 1);
+	uint32_t Local_uint32Word;
+
+	if((BL_uint8ImageSlotIsPlausible(Local_uint8Slot) != 0u) && (Local_pHeader->Crc != BL_IMAGE_CRC_UNSTAMPED) &&
+	   (Local_pHeader->Activated == BL_IMAGE_ACTIVATION_BLANK))
+	{
+		CRC->CR = CRC_CR_RESET;
+		voidServiceCrcFeed((const uint8_t*)Local_uint32Base, (uint32_t)Local_puint8Skip - Local_uint32Base);
+		voidServiceCrcFeed(Local_puint8Rest, Local_pHeader->EndAddress - (uint32_t)Local_puint8Rest);
+
+		if((CRC->DR == Local_pHeader->Crc) && (uint8_ServiceFlashUnlock() == HAL_OK))
+		{
+			Local_uint8Status = HAL_OK;
+
+			if(Local_pHeader->Validated == BL_IMAGE_FLAG_BLANK)
+			{
+				Local_uint32Word  = BL_IMAGE_FLAG_VALIDATED;
+				Local_uint8Status = uint8_ServiceFlashProgram((uint32_t)&Local_pHeader->Validated, (const uint8_t*)&Local_uint32Word, 4u);
+			}
+
+			Local_uint32Word = (Local_pActive->Activated == BL_IMAGE_ACTIVATION_BLANK) ? 1u : (Local_pActive->Activated + 1u);
+
+			if((Local_uint8Status == HAL_OK) && (Local_uint32Word != BL_IMAGE_ACTIVATION_BLANK))
+			{
+				Local_uint8Status = uint8_ServiceFlashProgram((uint32_t)&Local_pHeader->Activated, (const uint8_t*)&Local_uint32Word, 4u);
+			}
+
+			voidServiceFlashLock();
+
+			Local_uint8Status = (BL_uint8ImageGetActiveSlot() == Local_uint8Slot) ? HAL_OK : HAL_ERROR;
+		}
+	}
+
+#if BL_TRIAL_BOOT_ENABLE
+	if(Local_uint8Status == HAL_OK)
+	{
+		Bootloader_TrialStart();
+	}
+#endif
+#endif
+
+	return Local_uint8Status;
+}
+
+
+#if (BL_KV_ENABLE == 0)
+/*
+ * voidServiceKvInit / uint8_ServiceKvSet / uint8_ServiceKvDelete
+ * --------------------------------------------------------------
+ * Without BL_KV_ENABLE sectors 8 and 9 belong to the image: the store stays
+ * empty (Base 0, every get BL_KV_NOT_FOUND) and nothing is written.
+ */
+static void voidServiceKvInit(BL_KV_t* Copy_pKV)
+{
+	uint16_t Local_uint16Slot;
+
+	Copy_pKV->Base = 0;
+	Copy_pKV->End  = 0;
+	Copy_pKV->Keys = 0;
+
+	for(Local_uint16Slot = 0; Local_uint16Slot < BL_KV_INDEX_SLOTS; Local_uint16Slot++)
+	{
+		Copy_pKV->Index[Local_uint16Slot].Key = BL_KV_KEY_NONE;
+	}
+}
+
+
+static uint8_t uint8_ServiceKvSet(BL_KV_t* Copy_pKV, uint16_t Copy_uint16Key, const void* Copy_pData, uint16_t Copy_uint16Length)
+{
+	(void)Copy_pKV;
+	(void)Copy_uint16Key;
+	(void)Copy_pData;
+	(void)Copy_uint16Length;
+
+	return HAL_ERROR;
+}
+
+
+static uint8_t uint8_ServiceKvDelete(BL_KV_t* Copy_pKV, uint16_t Copy_uint16Key)
+{
+	(void)Copy_pKV;
+	(void)Copy_uint16Key;
+
+	return HAL_ERROR;
+}
+#endif
+
+
+/*
+ * Global_Services
+ * ---------------
+ * The exported table, placed at BL_SERVICES_ADDRESS by STM32F407VGTX_FLASH.ld.
+ */
+__attribute__((section(".bl_services"), used))
+const BL_Services_t Global_Services =
+{
+	BL_SERVICES_MAGIC,
+	BL_SERVICES_VERSION,
+	uint32_ServiceCrc,
+	uint8_ServiceFlashUnlock,
+	voidServiceFlashLock,
+	uint8_ServiceFlashProgram,
+	uint8_ServiceFlashEraseSector,
+	BL_voidSHA256Start,
+	BL_voidSHA256Update,
+	BL_voidSHA256Finish,
+	BL_uint8ImageIsValidated,
+	uint8_ServiceInactiveSectors,
+	uint8_ServiceFlashSectorIsBlank,
+	uint8_ServiceImageActivateUpdate,
+#if BL_KV_ENABLE
+	BL_voidKVInit,
+	BL_uint16KVGet,
+	BL_uint8KVSet,
+	BL_uint8KVDelete
+#else
+	voidServiceKvInit,
+	BL_uint16KVGet,
+	uint8_ServiceKvSet,
+	uint8_ServiceKvDelete
+#endif
+};
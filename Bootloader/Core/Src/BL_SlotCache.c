@@ -0,0 +1,221 @@
+#include "main.h"
+#include "BL.h"
+#include "BL_Image.h"
+#include "BL_Flash.h"
+#include "BL_CRC.h"
+#include "BL_SlotCache.h"
+
+#if BL_SLOT_CACHE_ENABLE
+
+#define SLOT_CACHE_GRANULES           (BL_SLOT_CACHE_BLOCK_SIZE / BL_SLOT_CACHE_GRANULE)   /* Per block */
+#define SLOT_CACHE_VALID_WORDS        ((BL_SLOT_CACHE_MAX_BLOCKS + 31u) / 32u)
+
+#if (SLOT_CACHE_GRANULES > 8u) || ((BL_SLOT_CACHE_BLOCK_SIZE % BL_SLOT_CACHE_GRANULE) != 0u)
+#error "BL_SLOT_CACHE_BLOCK_SIZE: a whole number of granules, at most 8 per block"
+#endif
+
+
+/*
+ * Global_uint32BlockCrc / Global_uint8BlockBlank / Global_uint32BlockValid
+ * ------------------------------------------------------------------------
+ * Per block from BL_SLOT_CACHE_BASE: its word-wise CRC, a bit per granule
+ * that reads blank, and whether both describe the flash as it is now.
+ * Zeroed by the startup: nothing is cached after a reset.
+ */
+static uint32_t Global_uint32BlockCrc[BL_SLOT_CACHE_MAX_BLOCKS] BL_CCMRAM;
+static uint8_t  Global_uint8BlockBlank[BL_SLOT_CACHE_MAX_BLOCKS] BL_CCMRAM;
+static uint32_t Global_uint32BlockValid[SLOT_CACHE_VALID_WORDS] BL_CCMRAM;
+
+/* Every block below it is valid: where the next step looks first */
+static uint32_t Global_uint32NextBlock BL_CCMRAM;
+
+/* Counts invalidations, so that a block that changed while it was computed is not taken */
+static volatile uint32_t Global_uint32Generation;
+
+
+static uint8_t uint8_IsValid(uint32_t Copy_uint32Block)
+{
+	return (uint8_t)((Global_uint32BlockValid[Copy_uint32Block >> 5] >> (Copy_uint32Block & 31u)) & 1u);
+}
+
+
+/*
+ * BL_voidSlotCacheInvalidate
+ * --------------------------
+ * Called by BL_Flash.c with any range it is about to program or erase:
+ * clears the valid bit of every cached block the range touches and moves
+ * the scan back to the first of them. Ranges outside the cache (bootloader,
+ * OTP, option bytes) change nothing. Only arithmetic, from RAM: the flash
+ * may already be busy.
+ */
+__RAM_FUNC void BL_voidSlotCacheInvalidate(uint32_t Copy_uint32Address, uint32_t Copy_uint32Length)
+{
+	uint32_t Local_uint32End = Copy_uint32Address + Copy_uint32Length;
+	uint32_t Local_uint32Block;
+	uint32_t Local_uint32Last;
+
+	if((Copy_uint32Length == 0u) || (Local_uint32End <= BL_SLOT_CACHE_BASE) ||
+	   (Copy_uint32Address >= (BL_SLOT_CACHE_BASE + (BL_SLOT_CACHE_MAX_BLOCKS * BL_SLOT_CACHE_BLOCK_SIZE))))
+	{
+		return;
+	}
+
+	if(Copy_uint32Address < BL_SLOT_CACHE_BASE)
+	{
+		Copy_uint32Address = BL_SLOT_CACHE_BASE;
+	}
+
+	Local_uint32Block = (Copy_uint32Address - BL_SLOT_CACHE_BASE) / BL_SLOT_CACHE_BLOCK_SIZE;
+	Local_uint32Last  = (Local_uint32End - 1u - BL_SLOT_CACHE_BASE) / BL_SLOT_CACHE_BLOCK_SIZE;
+	if(Local_uint32Last >= BL_SLOT_CACHE_MAX_BLOCKS)
+	{
+		Local_uint32Last = BL_SLOT_CACHE_MAX_BLOCKS - 1u;
+	}
+
+	Global_uint32Generation++;
+
+	if(Local_uint32Block < Global_uint32NextBlock)
+	{
+		Global_uint32NextBlock = Local_uint32Block;
+	}
+
+	for(; Local_uint32Block <= Local_uint32Last; Local_uint32Block++)
+	{
+		Global_uint32BlockValid[Local_uint32Block >> 5] &= ~(1UL << (Local_uint32Block & 31u));
+	}
+}
+
+
+/*
+ * BL_uint8SlotCacheStep
+ * ---------------------
+ * Computes the first block not valid, up to the end of the last slot: the
+ * blank bit of each granule (BL_uint8FlashRangeIsBlank), then the CRC of
+ * the block (BL_uint32CRCCalculate, by DMA). A few tens of microseconds at
+ * 168 MHz, short enough to run between two frames. The caller makes sure
+ * the flash is idle.
+ *
+ * Return:
+ * -------
+ *  1 while blocks are left to compute, 0 once everything is cached.
+ */
+uint8_t BL_uint8SlotCacheStep(void)
+{
+	uint32_t Local_uint32Blocks = (BL_uint32ImageGetSlotEnd(BL_IMAGE_SLOT_COUNT - 1u) - BL_SLOT_CACHE_BASE) / BL_SLOT_CACHE_BLOCK_SIZE;
+	uint32_t Local_uint32Block  = Global_uint32NextBlock;
+	uint32_t Local_uint32Generation;
+	uint32_t Local_uint32Address;
+	uint32_t Local_uint32Crc;
+	uint8_t  Local_uint8Blank = 0u;
+	uint8_t  Local_uint8Granule;
+
+	while((Local_uint32Block < Local_uint32Blocks) && (uint8_IsValid(Local_uint32Block) != 0u))
+	{
+		Local_uint32Block++;
+	}
+
+	if(Local_uint32Block >= Local_uint32Blocks)
+	{
+		Global_uint32NextBlock = Local_uint32Block;
+		return 0u;
+	}
+
+	Local_uint32Generation = Global_uint32Generation;
+	Local_uint32Address    = BL_SLOT_CACHE_BASE + (Local_uint32Block * BL_SLOT_CACHE_BLOCK_SIZE);
+
+	for(Local_uint8Granule = 0; Local_uint8Granule < SLOT_CACHE_GRANULES; Local_uint8Granule++)
+	{
+		if(BL_uint8FlashRangeIsBlank(Local_uint32Address + (Local_uint8Granule * BL_SLOT_CACHE_GRANULE), BL_SLOT_CACHE_GRANULE) == BL_FLASH_SECTOR_BLANK)
+		{
+			Local_uint8Blank |= (uint8_t)(1u << Local_uint8Granule);
+		}
+	}
+
+	Local_uint32Crc = BL_uint32CRCCalculate((const uint8_t*)Local_uint32Address, BL_SLOT_CACHE_BLOCK_SIZE);
+
+	/* Programmed or erased meanwhile: the next step computes it again */
+	if(Local_uint32Generation == Global_uint32Generation)
+	{
+		Global_uint32BlockCrc[Local_uint32Block]  = Local_uint32Crc;
+		Global_uint8BlockBlank[Local_uint32Block] = Local_uint8Blank;
+		Global_uint32BlockValid[Local_uint32Block >> 5] |= (1UL << (Local_uint32Block & 31u));
+		Global_uint32NextBlock = Local_uint32Block + 1u;
+	}
+
+	return (Global_uint32NextBlock < Local_uint32Blocks) ? 1u : 0u;
+}
+
+
+/*
+ * BL_uint8SlotCacheGetCrc
+ * -----------------------
+ * The word-wise CRC of the BL_SLOT_CACHE_BLOCK_SIZE bytes at
+ * Copy_uint32Address, if that is the start of a valid block.
+ *
+ * Return:
+ * -------
+ *  1 with *Copy_puint32Crc set, 0 if the caller computes it.
+ */
+uint8_t BL_uint8SlotCacheGetCrc(uint32_t Copy_uint32Address, uint32_t* Copy_puint32Crc)
+{
+	uint32_t Local_uint32Block = (Copy_uint32Address - BL_SLOT_CACHE_BASE) / BL_SLOT_CACHE_BLOCK_SIZE;
+
+	if((Copy_uint32Address < BL_SLOT_CACHE_BASE) || (((Copy_uint32Address - BL_SLOT_CACHE_BASE) % BL_SLOT_CACHE_BLOCK_SIZE) != 0u) ||
+	   (Local_uint32Block >= BL_SLOT_CACHE_MAX_BLOCKS) || (uint8_IsValid(Local_uint32Block) == 0u))
+	{
+		return 0u;
+	}
+
+	*Copy_puint32Crc = Global_uint32BlockCrc[Local_uint32Block];
+
+	return 1u;
+}
+
+
+/*
+ * BL_uint8SlotCacheRangeIsBlank
+ * -----------------------------
+ * Blank check of a range of whole granules from the cache. One granule of a
+ * valid block that is not blank decides it; otherwise every granule must be
+ * in a valid block.
+ *
+ * Return:
+ * -------
+ *  BL_FLASH_SECTOR_BLANK, BL_FLASH_SECTOR_NOT_BLANK, or BL_SLOT_CACHE_UNKNOWN
+ *  for a range the cache cannot answer (the caller reads the flash).
+ */
+uint8_t BL_uint8SlotCacheRangeIsBlank(uint32_t Copy_uint32Address, uint32_t Copy_uint32Length)
+{
+	uint8_t  Local_uint8Result = BL_FLASH_SECTOR_BLANK;
+	uint32_t Local_uint32Granule;
+	uint32_t Local_uint32End;
+	uint32_t Local_uint32Block;
+
+	if((Copy_uint32Length == 0u) || (Copy_uint32Address < BL_SLOT_CACHE_BASE) ||
+	   (((Copy_uint32Address | Copy_uint32Length) % BL_SLOT_CACHE_GRANULE) != 0u) ||
+	   (Copy_uint32Length > ((BL_SLOT_CACHE_MAX_BLOCKS * BL_SLOT_CACHE_BLOCK_SIZE) - (Copy_uint32Address - BL_SLOT_CACHE_BASE))))
+	{
+		return BL_SLOT_CACHE_UNKNOWN;
+	}
+
+	Local_uint32Granule = (Copy_uint32Address - BL_SLOT_CACHE_BASE) / BL_SLOT_CACHE_GRANULE;
+	Local_uint32End     = Local_uint32Granule + (Copy_uint32Length / BL_SLOT_CACHE_GRANULE);
+
+	for(; Local_uint32Granule < Local_uint32End; Local_uint32Granule++)
+	{
+		Local_uint32Block = Local_uint32Granule / SLOT_CACHE_GRANULES;
+
+		if(uint8_IsValid(Local_uint32Block) == 0u)
+		{
+			Local_uint8Result = BL_SLOT_CACHE_UNKNOWN;
+		}
+		else if(((Global_uint8BlockBlank[Local_uint32Block] >> (Local_uint32Granule % SLOT_CACHE_GRANULES)) & 1u) == 0u)
+		{
+			return BL_FLASH_SECTOR_NOT_BLANK;
+		}
+	}
+
+	return Local_uint8Result;
+}
+
+#endif
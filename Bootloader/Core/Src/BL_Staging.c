@@ -0,0 +1,538 @@
+#include "main.h"
+#include "BL_Staging.h"
+#include "BL_Image.h"
+#include "BL_CRC.h"
+#include "BL_Flash.h"
+#include "BL_LZ.h"
+#include "BL_Package.h"
+#include "BL_KV.h"
+
+
+#define STAGING_HEADER                ((const volatile BL_StagingHeader_t*)BL_STAGING_BASE_ADDRESS)
+
+/* End of the slot the image is installed into (slot A) */
+#if BL_AB_SLOTS_ENABLE
+#define STAGING_IMAGE_END             BL_IMAGE_SLOT_B_ADDRESS
+#elif BL_SWAP_ENABLE
+#define STAGING_IMAGE_END             BL_SWAP_SCRATCH_ADDRESS
+#elif BL_KV_ENABLE
+#define STAGING_IMAGE_END             BL_KV_BASE_ADDRESS
+#else
+#define STAGING_IMAGE_END             BL_STAGING_BASE_ADDRESS
+#endif
+
+/* Stream bytes handed to the decoder / copied per step */
+#define STAGING_STEP_SIZE             1024u
+
+/*
+ * Global_Decoder
+ * --------------
+ * Install-time decoder. Its window is the only buffer: each decoded piece is
+ * programmed straight from it (CCMRAM, the CPU alone reads it).
+ */
+static BL_LZ_t  Global_Decoder BL_CCMRAM_BUDGET("codec");
+
+#if BL_PACKAGE_ENABLE
+/* Install-time package decoder, its LZ segments on Global_Decoder */
+static BL_Package_t Global_Package BL_CCMRAM_BUDGET("staging");
+#endif
+
+/* Index in Sectors[] of the next journal word to clear */
+static uint8_t  Global_uint8JournalNext;
+
+
+/*
+ * voidMark
+ * --------
+ * Programs one journal word, unless an earlier attempt already did.
+ */
+static void voidMark(const volatile uint32_t* Copy_puint32Word, uint32_t Copy_uint32Value)
+{
+	if(*Copy_puint32Word == BL_STAGING_MARK_BLANK)
+	{
+		BL_uint8FlashProgram((uint32_t)Copy_puint32Word, (const uint8_t*)&Copy_uint32Value, sizeof(Copy_uint32Value));
+	}
+}
+
+
+/*
+ * voidRecordProgress
+ * ------------------
+ * Clears the journal word of every application sector ending at or before
+ * Copy_uint32End.
+ */
+static void voidRecordProgress(uint32_t Copy_uint32End)
+{
+	const BL_FlashSector_t* Local_pSector;
+
+	while(Global_uint8JournalNext < BL_STAGING_JOURNAL_SECTORS)
+	{
+		Local_pSector = BL_pFlashGetSectorInfo(BL_STAGING_FIRST_SECTOR + Global_uint8JournalNext);
+
+		if((Local_pSector->Base + Local_pSector->Size) > Copy_uint32End)
+		{
+			break;
+		}
+
+		voidMark(&STAGING_HEADER->Sectors[Global_uint8JournalNext], BL_STAGING_MARK_DONE);
+		Global_uint8JournalNext++;
+	}
+}
+
+
+/*
+ * uint8_CheckStaged
+ * -----------------
+ * A staged update is installed when its header is complete, its Result still
+ * blank, both lengths fit their areas and the stream CRC matches.
+ *
+ * Return:
+ * -------
+ * BL_STAGING_INSTALLED (go ahead), BL_STAGING_FAILED (reject it for good) or
+ * BL_STAGING_NONE (nothing staged).
+ */
+static uint8_t uint8_CheckStaged(void)
+{
+	uint8_t Local_uint8Result = BL_STAGING_NONE;
+
+	if((STAGING_HEADER->Magic == BL_STAGING_MAGIC) && (STAGING_HEADER->Result == BL_STAGING_MARK_BLANK))
+	{
+		Local_uint8Result = BL_STAGING_FAILED;
+
+		if(((STAGING_HEADER->Codec == BL_STAGING_CODEC_NONE) || (STAGING_HEADER->Codec == BL_STAGING_CODEC_LZ) ||
+		    ((BL_SWAP_ENABLE != 0) && (STAGING_HEADER->Codec == BL_STAGING_CODEC_SWAP)) ||
+		    ((BL_PACKAGE_ENABLE != 0) && (STAGING_HEADER->Codec == BL_STAGING_CODEC_PACKAGE))) &&
+		   (STAGING_HEADER->Length != 0u) &&
+		   (STAGING_HEADER->Length <= (BL_STAGING_SIZE - sizeof(BL_StagingHeader_t))) &&
+		   ((STAGING_HEADER->Codec == BL_STAGING_CODEC_PACKAGE) ||
+		    ((STAGING_HEADER->ImageLength != 0u) &&
+		     (STAGING_HEADER->ImageLength <= (STAGING_IMAGE_END - BL_IMAGE_BASE_ADDRESS)) &&
+		     ((STAGING_HEADER->Codec == BL_STAGING_CODEC_LZ) || (STAGING_HEADER->Length == STAGING_HEADER->ImageLength)))) &&
+		   (BL_uint32CRCCalculate((const uint8_t*)BL_STAGING_DATA_ADDRESS, STAGING_HEADER->Length) == STAGING_HEADER->CompressedCrc))
+		{
+			Local_uint8Result = BL_STAGING_INSTALLED;
+		}
+	}
+
+	return Local_uint8Result;
+}
+
+
+/*
+ * uint8_EraseTarget
+ * -----------------
+ * Erases the application sectors the image will occupy, skipping blank ones.
+ * Returns the last of them in Copy_puint8LastSector.
+ */
+static uint8_t uint8_EraseTarget(uint8_t* Copy_puint8LastSector)
+{
+	uint8_t Local_uint8Status = HAL_OK;
+	uint8_t Local_uint8Sector;
+
+	*Copy_puint8LastSector = BL_uint8FlashGetSector(BL_IMAGE_BASE_ADDRESS + STAGING_HEADER->ImageLength - 1u);
+
+	for(Local_uint8Sector = BL_STAGING_FIRST_SECTOR; (Local_uint8Sector <= *Copy_puint8LastSector) && (Local_uint8Status == HAL_OK); Local_uint8Sector++)
+	{
+		if(BL_uint8FlashSectorIsBlank(Local_uint8Sector) != BL_FLASH_SECTOR_BLANK)
+		{
+			Local_uint8Status = BL_uint8FlashEraseSector(Local_uint8Sector);
+		}
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * uint8_InstallStream
+ * -------------------
+ * Programs the image from the stream, STAGING_STEP_SIZE stream bytes at a
+ * time: copied as they are, or decoded piece by piece from the window.
+ *
+ * Return:
+ * -------
+ * HAL_OK when exactly ImageLength bytes were programmed and the LZ stream
+ * ended on a sequence boundary, HAL_ERROR otherwise.
+ */
+static uint8_t uint8_InstallStream(void)
+{
+	const uint8_t* Local_puint8Input = (const uint8_t*)BL_STAGING_DATA_ADDRESS;
+	uint32_t Local_uint32Remaining = STAGING_HEADER->Length;
+	uint32_t Local_uint32Address = BL_IMAGE_BASE_ADDRESS;
+	uint32_t Local_uint32End = BL_IMAGE_BASE_ADDRESS + STAGING_HEADER->ImageLength;
+	uint8_t  Local_uint8Status = HAL_OK;
+	uint16_t Local_uint16Step;
+	uint8_t* Local_puint8Output;
+	uint16_t Local_uint16OutputLength;
+
+	BL_voidLZStart(&Global_Decoder);
+
+	while((Local_uint32Remaining != 0u) && (Local_uint8Status == HAL_OK))
+	{
+		Local_uint16Step = (Local_uint32Remaining < STAGING_STEP_SIZE) ? (uint16_t)Local_uint32Remaining : STAGING_STEP_SIZE;
+		Local_uint32Remaining -= Local_uint16Step;
+
+		if(STAGING_HEADER->Codec == BL_STAGING_CODEC_NONE)
+		{
+			Local_uint8Status = BL_uint8FlashProgram(Local_uint32Address, Local_puint8Input, Local_uint16Step);
+			Local_puint8Input   += Local_uint16Step;
+			Local_uint32Address += Local_uint16Step;
+			voidRecordProgress(Local_uint32Address);
+			continue;
+		}
+
+		do
+		{
+			if(BL_uint8LZDecode(&Global_Decoder, &Local_puint8Input, &Local_uint16Step,
+			                    &Local_puint8Output, &Local_uint16OutputLength) != BL_LZ_OK)
+			{
+				Local_uint8Status = HAL_ERROR;
+			}
+			else if(Local_uint16OutputLength > (Local_uint32End - Local_uint32Address))
+			{
+				Local_uint8Status = HAL_ERROR;
+			}
+			else if(Local_uint16OutputLength != 0u)
+			{
+				Local_uint8Status = BL_uint8FlashProgram(Local_uint32Address, Local_puint8Output, Local_uint16OutputLength);
+				Local_uint32Address += Local_uint16OutputLength;
+				voidRecordProgress(Local_uint32Address);
+			}
+		}
+		while((Local_uint16OutputLength != 0u) && (Local_uint8Status == HAL_OK));
+	}
+
+	if((Local_uint32Address != Local_uint32End) ||
+	   ((STAGING_HEADER->Codec == BL_STAGING_CODEC_LZ) && (BL_uint8LZIsComplete(&Global_Decoder) == 0u)))
+	{
+		Local_uint8Status = HAL_ERROR;
+	}
+
+	return Local_uint8Status;
+}
+
+
+#if BL_PACKAGE_ENABLE
+/*
+ * uint8_ErasePlan
+ * ---------------
+ * Erase plan of the staged package's manifest. Besides the package rules
+ * (BL_Package.h), no planned sector may lie at or above STAGING_IMAGE_END:
+ * the segments, all inside planned sectors, stay below the slot.
+ */
+static uint8_t uint8_ErasePlan(void)
+{
+	uint32_t Local_uint32Sectors = Global_Package.Header.EraseSectors;
+	uint8_t  Local_uint8Status = HAL_OK;
+	uint8_t  Local_uint8Sector;
+
+	if((Local_uint32Sectors >> BL_uint8FlashGetSector(STAGING_IMAGE_END)) != 0u)
+	{
+		return HAL_ERROR;
+	}
+
+	for(Local_uint8Sector = 0; (Local_uint8Sector < BL_FLASH_SECTOR_COUNT) && (Local_uint8Status == HAL_OK); Local_uint8Sector++)
+	{
+		if(((Local_uint32Sectors & (1UL << Local_uint8Sector)) != 0u) &&
+		   (BL_uint8FlashSectorIsBlank(Local_uint8Sector) != BL_FLASH_SECTOR_BLANK))
+		{
+			Local_uint8Status = BL_uint8FlashEraseSector(Local_uint8Sector);
+		}
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * uint8_InstallPackage
+ * --------------------
+ * Installs a staged update package (BL_STAGING_CODEC_PACKAGE) straight from
+ * the slot, STAGING_STEP_SIZE package bytes handed to the decoder at a time.
+ *
+ * Behavior:
+ * ---------
+ * 1. The manifest is checked before anything is erased, then the plan is
+ *    erased (uint8_ErasePlan).
+ * 2. Every decoded piece is programmed, journal words cleared as sectors
+ *    complete; a block failing its CRC stops the install before any of it
+ *    reaches the flash.
+ * 3. The package must be complete (payload digest matched) and end with
+ *    the stream.
+ * No key is given to the decoder: the signature, if any, is not checked
+ * here; with BL_SIGNATURE_ENABLE the installed image is not marked
+ * validated, as for the other codecs.
+ *
+ * Return:
+ * -------
+ * HAL_OK, or HAL_ERROR at the first refused manifest, corrupt block or
+ * failing erase / program.
+ */
+static uint8_t uint8_InstallPackage(void)
+{
+	const uint8_t* Local_puint8Input = (const uint8_t*)BL_STAGING_DATA_ADDRESS;
+	uint32_t Local_uint32Remaining = STAGING_HEADER->Length;
+	uint8_t  Local_uint8Status = HAL_OK;
+	uint8_t  Local_uint8Event;
+	uint16_t Local_uint16Step;
+	uint32_t Local_uint32Address;
+	uint8_t* Local_puint8Output;
+	uint16_t Local_uint16OutputLength;
+
+	BL_voidPackageStart(&Global_Package, &Global_Decoder, NULL);
+
+	while((Local_uint32Remaining != 0u) && (Local_uint8Status == HAL_OK))
+	{
+		Local_uint16Step = (Local_uint32Remaining < STAGING_STEP_SIZE) ? (uint16_t)Local_uint32Remaining : STAGING_STEP_SIZE;
+		Local_uint32Remaining -= Local_uint16Step;
+
+		do
+		{
+			Local_uint8Event = BL_uint8PackageDecode(&Global_Package, &Local_puint8Input, &Local_uint16Step,
+			                                         &Local_uint32Address, &Local_puint8Output, &Local_uint16OutputLength);
+
+			if(Local_uint8Event == BL_PACKAGE_MANIFEST)
+			{
+				Local_uint8Status = uint8_ErasePlan();
+			}
+			else if(Local_uint8Event == BL_PACKAGE_WRITE)
+			{
+				Local_uint8Status = BL_uint8FlashProgram(Local_uint32Address, Local_puint8Output, Local_uint16OutputLength);
+				voidRecordProgress(Local_uint32Address + Local_uint16OutputLength);
+			}
+			else if(Local_uint8Event >= BL_PACKAGE_BAD_HEADER)
+			{
+				Local_uint8Status = HAL_ERROR;
+			}
+			else
+			{
+				/* MORE, or COMPLETE: nothing to do */
+			}
+		}
+		while((Local_uint8Event != BL_PACKAGE_MORE) && (Local_uint8Status == HAL_OK));
+	}
+
+	if(BL_uint8PackageIsComplete(&Global_Package) == 0u)
+	{
+		Local_uint8Status = HAL_ERROR;
+	}
+
+	return Local_uint8Status;
+}
+#endif
+
+
+#if BL_SWAP_ENABLE
+/*
+ * uint8_CopyFlash
+ * ---------------
+ * Programs Copy_uint32Length bytes read from flash at Copy_uint32Source,
+ * STAGING_STEP_SIZE at a time (RAM-resident word programming).
+ */
+static uint8_t uint8_CopyFlash(uint32_t Copy_uint32Destination, uint32_t Copy_uint32Source, uint32_t Copy_uint32Length)
+{
+	uint8_t  Local_uint8Status = HAL_OK;
+	uint16_t Local_uint16Step;
+
+	while((Copy_uint32Length != 0u) && (Local_uint8Status == HAL_OK))
+	{
+		Local_uint16Step = (Copy_uint32Length < STAGING_STEP_SIZE) ? (uint16_t)Copy_uint32Length : STAGING_STEP_SIZE;
+
+		Local_uint8Status = BL_uint8FlashProgram(Copy_uint32Destination, (const uint8_t*)Copy_uint32Source, Local_uint16Step);
+		Copy_uint32Destination += Local_uint16Step;
+		Copy_uint32Source      += Local_uint16Step;
+		Copy_uint32Length      -= Local_uint16Step;
+	}
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * uint8_SwapStream
+ * ----------------
+ * Swap install (see "Swap Install" in BL_Staging.h), resumed from the first
+ * journal word still blank. Each step programs its word once it succeeded.
+ *
+ * Return:
+ * -------
+ * HAL_OK when every step of the image's sectors is done, HAL_ERROR at the
+ * first failing erase / program (its word stays blank).
+ */
+static uint8_t uint8_SwapStream(void)
+{
+	uint32_t Local_uint32End = BL_IMAGE_BASE_ADDRESS + STAGING_HEADER->ImageLength;
+	uint8_t  Local_uint8Status = HAL_OK;
+	uint8_t  Local_uint8Index;
+	uint32_t Local_uint32Offset;
+	uint32_t Local_uint32Length;
+	const BL_FlashSector_t* Local_pSector;
+
+	/* The scratch is erased before the first application sector is saved into it */
+	if(STAGING_HEADER->Started == BL_STAGING_MARK_BLANK)
+	{
+		for(Local_uint8Index = 0; (Local_uint8Index < BL_SWAP_SCRATCH_SECTORS) && (Local_uint8Status == HAL_OK); Local_uint8Index++)
+		{
+			if(BL_uint8FlashSectorIsBlank(BL_SWAP_SCRATCH_FIRST_SECTOR + Local_uint8Index) != BL_FLASH_SECTOR_BLANK)
+			{
+				Local_uint8Status = BL_uint8FlashEraseSector(BL_SWAP_SCRATCH_FIRST_SECTOR + Local_uint8Index);
+			}
+		}
+
+		if(Local_uint8Status == HAL_OK)
+		{
+			voidMark(&STAGING_HEADER->Started, BL_STAGING_MARK_DONE);
+		}
+	}
+
+	for(Local_uint8Index = 0; (Local_uint8Index < BL_SWAP_SECTORS) && (Local_uint8Status == HAL_OK); Local_uint8Index++)
+	{
+		Local_pSector      = BL_pFlashGetSectorInfo(BL_STAGING_FIRST_SECTOR + Local_uint8Index);
+		Local_uint32Offset = Local_pSector->Base - BL_IMAGE_BASE_ADDRESS;
+
+		if(Local_pSector->Base >= Local_uint32End)
+		{
+			break;
+		}
+
+		/* Step 2n: the previous content of the sector goes to the scratch */
+		if(STAGING_HEADER->Sectors[2u * Local_uint8Index] == BL_STAGING_MARK_BLANK)
+		{
+			Local_uint8Status = uint8_CopyFlash(BL_SWAP_SCRATCH_ADDRESS + Local_uint32Offset, Local_pSector->Base, Local_pSector->Size);
+
+			if(Local_uint8Status == HAL_OK)
+			{
+				voidMark(&STAGING_HEADER->Sectors[2u * Local_uint8Index], BL_STAGING_MARK_DONE);
+			}
+		}
+
+		/* Step 2n + 1: the sector gets its part of the new image */
+		if((Local_uint8Status == HAL_OK) && (STAGING_HEADER->Sectors[(2u * Local_uint8Index) + 1u] == BL_STAGING_MARK_BLANK))
+		{
+			Local_uint32Length = Local_uint32End - Local_pSector->Base;
+			if(Local_uint32Length > Local_pSector->Size)
+			{
+				Local_uint32Length = Local_pSector->Size;
+			}
+
+			Local_uint8Status = BL_uint8FlashEraseSector(BL_STAGING_FIRST_SECTOR + Local_uint8Index);
+
+			if(Local_uint8Status == HAL_OK)
+			{
+				Local_uint8Status = uint8_CopyFlash(Local_pSector->Base, BL_STAGING_DATA_ADDRESS + Local_uint32Offset, Local_uint32Length);
+			}
+
+			if(Local_uint8Status == HAL_OK)
+			{
+				voidMark(&STAGING_HEADER->Sectors[(2u * Local_uint8Index) + 1u], BL_STAGING_MARK_DONE);
+			}
+		}
+	}
+
+	return Local_uint8Status;
+}
+#endif
+
+
+/*
+ * BL_uint8StagingIsPending
+ * ------------------------
+ * Header-only test used by the fast boot path: any staged update without a
+ * Result sends the boot through BL_uint8StagingInstall.
+ */
+uint8_t BL_uint8StagingIsPending(void)
+{
+	return (uint8_t)((STAGING_HEADER->Magic == BL_STAGING_MAGIC) && (STAGING_HEADER->Result == BL_STAGING_MARK_BLANK));
+}
+
+
+/*
+ * BL_uint8StagingInstall
+ * ----------------------
+ * Installs a staged update before the application image is checked.
+ *
+ * Behavior:
+ * ---------
+ * 1. Nothing staged, or Result already programmed: BL_STAGING_NONE, no flash access.
+ * 2. Header or stream CRC wrong: Result = FAILED, the application is untouched.
+ * 3. Otherwise Started is cleared, the target sectors erased and the stream
+ *    programmed into them, one journal word per completed sector. A
+ *    BL_STAGING_CODEC_SWAP stream goes through uint8_SwapStream instead,
+ *    a BL_STAGING_CODEC_PACKAGE one through uint8_InstallPackage.
+ * 4. The installed image CRC decides Result (INSTALLED / FAILED); for a
+ *    package its own block CRCs and payload digest do.
+ * 5. With BL_AB_SLOTS_ENABLE the installed slot A is activated, so it wins
+ *    over a slot B activated earlier.
+ * A reset during 3 repeats the whole install on the next boot, except for a
+ * swap, which resumes at the interrupted step.
+ *
+ * Return:
+ * -------
+ * BL_STAGING_NONE, BL_STAGING_INSTALLED or BL_STAGING_FAILED.
+ */
+uint8_t BL_uint8StagingInstall(void)
+{
+	uint8_t Local_uint8Result = uint8_CheckStaged();
+	uint8_t Local_uint8LastSector;
+	const BL_FlashSector_t* Local_pLast;
+
+	if(Local_uint8Result != BL_STAGING_NONE)
+	{
+		HAL_FLASH_Unlock();
+
+#if BL_SWAP_ENABLE
+		if((Local_uint8Result == BL_STAGING_INSTALLED) && (STAGING_HEADER->Codec == BL_STAGING_CODEC_SWAP))
+		{
+			if((uint8_SwapStream() != HAL_OK) ||
+			   (BL_uint32CRCCalculate((const uint8_t*)BL_IMAGE_BASE_ADDRESS, STAGING_HEADER->ImageLength) != STAGING_HEADER->ImageCrc))
+			{
+				Local_uint8Result = BL_STAGING_FAILED;
+			}
+		}
+		else
+#endif
+#if BL_PACKAGE_ENABLE
+		if((Local_uint8Result == BL_STAGING_INSTALLED) && (STAGING_HEADER->Codec == BL_STAGING_CODEC_PACKAGE))
+		{
+			voidMark(&STAGING_HEADER->Started, BL_STAGING_MARK_DONE);
+			Global_uint8JournalNext = 0;
+
+			if(uint8_InstallPackage() != HAL_OK)
+			{
+				Local_uint8Result = BL_STAGING_FAILED;
+			}
+		}
+		else
+#endif
+		if(Local_uint8Result == BL_STAGING_INSTALLED)
+		{
+			voidMark(&STAGING_HEADER->Started, BL_STAGING_MARK_DONE);
+			Global_uint8JournalNext = 0;
+
+			if((uint8_EraseTarget(&Local_uint8LastSector) != HAL_OK) || (uint8_InstallStream() != HAL_OK) ||
+			   (BL_uint32CRCCalculate((const uint8_t*)BL_IMAGE_BASE_ADDRESS, STAGING_HEADER->ImageLength) != STAGING_HEADER->ImageCrc))
+			{
+				Local_uint8Result = BL_STAGING_FAILED;
+			}
+			else
+			{
+				/* The sector holding the end of the image is complete too */
+				Local_pLast = BL_pFlashGetSectorInfo(Local_uint8LastSector);
+				voidRecordProgress(Local_pLast->Base + Local_pLast->Size);
+			}
+		}
+
+		voidMark(&STAGING_HEADER->Result, (Local_uint8Result == BL_STAGING_INSTALLED) ? BL_STAGING_RESULT_INSTALLED : BL_STAGING_RESULT_FAILED);
+
+		HAL_FLASH_Lock();
+
+#if BL_AB_SLOTS_ENABLE
+		if(Local_uint8Result == BL_STAGING_INSTALLED)
+		{
+			BL_uint8ImageActivate(BL_IMAGE_SLOT_A);
+		}
+#endif
+	}
+
+	return Local_uint8Result;
+}
@@ -0,0 +1,149 @@
+#include <string.h>
+#include "main.h"
+#include "BL_Trace.h"
+#include "BL_Port.h"
+
+#if BL_TRACE_ENABLE
+
+/*
+ * Global_Trace
+ * ------------
+ * The ring (BL_Trace.h). Zeroed at reset with .bss: a debugger reading it
+ * after a hang sees Head events, the newest Head % BL_TRACE_DEPTH slots back.
+ */
+BL_Trace_t Global_Trace BL_RAM_BUDGET("trace");
+
+
+#if BL_ITM_ENABLE
+/*
+ * voidItmWrite
+ * ------------
+ * One word to a stimulus port, once the FIFO has room. Nothing while the
+ * port is off: a debugger may take ITM over, and the core never blocks on it.
+ */
+__RAM_FUNC static void voidItmWrite(uint32_t Copy_uint32Port, uint32_t Copy_uint32Value)
+{
+	if(((ITM->TCR & ITM_TCR_ITMENA_Msk) != 0u) && ((ITM->TER & (1UL << Copy_uint32Port)) != 0u))
+	{
+		while(ITM->PORT[Copy_uint32Port].u32 == 0u)
+		{
+		}
+		ITM->PORT[Copy_uint32Port].u32 = Copy_uint32Value;
+	}
+}
+#endif
+
+
+/*
+ * BL_voidTraceRecord
+ * ------------------
+ * Stores one event in the next slot. The slot is claimed and filled with
+ * interrupts masked, so an event from an interrupt handler never tears one
+ * being written by the command loop. In RAM: also called while flash is busy.
+ */
+__RAM_FUNC void BL_voidTraceRecord(uint16_t Copy_uint16Event, uint16_t Copy_uint16Arg0, uint32_t Copy_uint32Arg1)
+{
+	uint32_t         Local_uint32Irq = BL_PORT_IRQ_SAVE();
+	BL_TraceEntry_t* Local_pEntry    = &Global_Trace.Entries[Global_Trace.Head & (BL_TRACE_DEPTH - 1u)];
+
+	Local_pEntry->Cycles = DWT->CYCCNT;
+	Local_pEntry->Event  = Copy_uint16Event;
+	Local_pEntry->Arg0   = Copy_uint16Arg0;
+	Local_pEntry->Arg1   = Copy_uint32Arg1;
+	Global_Trace.Head++;
+
+#if BL_ITM_ENABLE
+	voidItmWrite(BL_TRACE_ITM_PORT_CYCLES, Local_pEntry->Cycles);
+	voidItmWrite(BL_TRACE_ITM_PORT_EVENT, ((uint32_t)Copy_uint16Event << 16) | Copy_uint16Arg0);
+	voidItmWrite(BL_TRACE_ITM_PORT_ARG, Copy_uint32Arg1);
+#endif
+
+	BL_PORT_IRQ_RESTORE(Local_uint32Irq);
+}
+
+
+/*
+ * BL_uint16TraceRead
+ * ------------------
+ * Copies up to Copy_uint16MaxEntries events, oldest first, starting at
+ * sequence *Copy_puint32From or at the oldest one still in the ring.
+ *
+ * Parameters:
+ * -----------
+ * @param Copy_puint32From : In: first sequence wanted; out: first sequence copied.
+ * @param Copy_puint8Out   : BL_TRACE_ENTRY_SIZE bytes per event, any alignment.
+ *
+ * Return:
+ * -------
+ * @return uint16_t : Events copied.
+ */
+uint16_t BL_uint16TraceRead(uint32_t* Copy_puint32From, uint8_t* Copy_puint8Out, uint16_t Copy_uint16MaxEntries)
+{
+	uint32_t Local_uint32Head   = Global_Trace.Head;
+	uint32_t Local_uint32Oldest = (Local_uint32Head > BL_TRACE_DEPTH) ? (Local_uint32Head - BL_TRACE_DEPTH) : 0u;
+	uint32_t Local_uint32Seq;
+	uint16_t Local_uint16Count = 0;
+
+	if(((*Copy_puint32From) < Local_uint32Oldest) || ((*Copy_puint32From) > Local_uint32Head))
+	{
+		*Copy_puint32From = Local_uint32Oldest;
+	}
+
+	for(Local_uint32Seq = *Copy_puint32From; (Local_uint32Seq != Local_uint32Head) && (Local_uint16Count < Copy_uint16MaxEntries); Local_uint32Seq++)
+	{
+		memcpy(Copy_puint8Out, &Global_Trace.Entries[Local_uint32Seq & (BL_TRACE_DEPTH - 1u)], BL_TRACE_ENTRY_SIZE);
+		Copy_puint8Out += BL_TRACE_ENTRY_SIZE;
+		Local_uint16Count++;
+	}
+
+	return Local_uint16Count;
+}
+
+
+uint32_t BL_uint32TraceHead(void)
+{
+	return Global_Trace.Head;
+}
+
+#endif
+
+
+/*
+ * BL_voidTraceItmInit
+ * -------------------
+ * Without BL_ITM_ENABLE nothing. Otherwise: PB3 as TRACESWO (its reset
+ * function, re-selected in case GPIO set-up moved it), the TPIU as NRZ at
+ * BL_ITM_SWO_BAUD from HCLK, ITM ports 1-3 on with local timestamps, and the
+ * DWT's PC sampling. The cycle counter keeps running from reset: the trace
+ * timestamps stay comparable with the ring's.
+ */
+void BL_voidTraceItmInit(void)
+{
+#if BL_ITM_ENABLE
+	RCC->AHB1ENR |= RCC_AHB1ENR_GPIOBEN;
+	GPIOB->MODER   = (GPIOB->MODER & ~GPIO_MODER_MODER3_Msk) | GPIO_MODER_MODER3_1;
+	GPIOB->AFR[0] &= ~GPIO_AFRL_AFSEL3_Msk;
+	GPIOB->OSPEEDR |= GPIO_OSPEEDR_OSPEED3_Msk;
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DBGMCU->CR = (DBGMCU->CR & ~DBGMCU_CR_TRACE_MODE_Msk) | DBGMCU_CR_TRACE_IOEN;
+
+	TPI->SPPR = 2u;                                              /* NRZ (UART) */
+	TPI->ACPR = (SystemCoreClock / BL_ITM_SWO_BAUD) - 1u;
+	TPI->FFCR = 0x100u;                                          /* Formatter off: ITM / DWT packets only */
+
+	ITM->LAR = 0xC5ACCE55UL;
+	ITM->TCR = ITM_TCR_ITMENA_Msk | ITM_TCR_TSENA_Msk | ITM_TCR_SYNCENA_Msk | ITM_TCR_DWTENA_Msk |
+	           (1UL << ITM_TCR_TraceBusID_Pos);
+	ITM->TPR = 0u;
+	ITM->TER = (1UL << BL_TRACE_ITM_PORT_CYCLES) | (1UL << BL_TRACE_ITM_PORT_EVENT) | (1UL << BL_TRACE_ITM_PORT_ARG);
+
+#if (BL_ITM_PC_SAMPLE_PERIOD != 0u)
+	/* CYCTAP: POSTCNT counts every 1024 cycles, a sample each time it reloads */
+	DWT->CTRL = (DWT->CTRL & ~(DWT_CTRL_POSTPRESET_Msk | DWT_CTRL_POSTINIT_Msk)) | DWT_CTRL_CYCTAP_Msk |
+	            ((BL_ITM_PC_SAMPLE_PERIOD - 1u) << DWT_CTRL_POSTPRESET_Pos) |
+	            ((BL_ITM_PC_SAMPLE_PERIOD - 1u) << DWT_CTRL_POSTINIT_Pos) | DWT_CTRL_CYCCNTENA_Msk;
+	DWT->CTRL |= DWT_CTRL_PCSAMPLENA_Msk;
+#endif
+#endif
+}
@@ -0,0 +1,2113 @@
+
+#include "main.h"
+#include <string.h>
+#include "BL_Transport.h"
+#include "BL_CRC.h"
+#include "BL_Port.h"
+#include "BL_Trace.h"
+#include "BL_UART.h"
+#if BL_TRANSPORT_USB_ENABLE
+#include "BL_USB.h"
+#endif
+#if BL_TRANSPORT_SPI_ENABLE
+#include "BL_SPI.h"
+#endif
+#if BL_TRANSPORT_CAN_ENABLE
+#include "BL_CAN.h"
+#endif
+
+
+/*
+ * Global_uint8RxRing
+ * ------------------
+ * Circular reception buffer. DMA1 Stream5 is the only writer (producer),
+ * the command parser is the only reader (consumer).
+ */
+static uint8_t  Global_uint8RxRing[BL_RX_RING_SIZE] __attribute__((aligned(4))) BL_DMA_RAM_BUDGET("rx");
+
+/* Index of the next byte the parser will consume */
+static uint16_t Global_uint16RxTail;
+
+/*
+ * Global_uint8RxEvent
+ * -------------------
+ * Set from interrupt context whenever new data may have completed a frame:
+ * USART IDLE line, DMA half transfer and DMA transfer complete.
+ * The parser sleeps on it instead of polling the DMA counter byte by byte.
+ */
+static volatile uint8_t Global_uint8RxEvent;
+
+/*
+ * Global_uint8RxRestart
+ * ---------------------
+ * Set by BL_voidTransportUartError when a DMA transfer error has stopped the
+ * RX stream, so the parser restarts reception from thread context. Line
+ * errors (overrun, framing, noise) leave the DMA running.
+ */
+static volatile uint8_t Global_uint8RxRestart;
+
+/*
+ * Global_uint8TxBuffer
+ * --------------------
+ * Responses are assembled here and sent by DMA1 Stream6 in a single transfer.
+ * It is owned by the DMA until the transfer completes (BL_uint8UARTTxBusy 0).
+ * Sized for the COBS code bytes and delimiter of a full response.
+ */
+static uint8_t  Global_uint8TxBuffer[BL_TX_BUFFER_SIZE + BL_COBS_OVERHEAD(BL_TX_BUFFER_SIZE) + 1u] BL_DMA_RAM;
+
+/*
+ * Global_uint8ActiveLink
+ * ----------------------
+ * Link the last frame came from (BL_LINK_UART / USB / SPI / CAN); responses go back on it.
+ */
+static uint8_t  Global_uint8ActiveLink = BL_LINK_UART;
+
+#if BL_TRANSPORT_LOCK_ENABLE
+/*
+ * Global_uint8LockedLink
+ * ----------------------
+ * The only link still served once a frame passed its CRC check
+ * (BL_voidTransportLock), BL_LINK_COUNT while every link listens.
+ * CAN group frames lock BL_LINK_CAN, which keeps both CAN rings.
+ */
+static uint8_t  Global_uint8LockedLink = BL_LINK_COUNT;
+#endif
+
+/* Set by the flash routines while an erase / program operation runs */
+static volatile uint8_t Global_uint8FlashBusy;
+
+/* Set from interrupt context when background work (erase job) can make progress */
+static volatile uint8_t Global_uint8BackgroundEvent;
+
+/*
+ * Global_uint16HeldLength
+ * -----------------------
+ * Frame handed out in place (zero-copy) and not consumed yet: its bytes stay
+ * counted in the ring level, so neither the RTS watermarks nor the USB OUT
+ * endpoint let the host overwrite it while its handler runs.
+ */
+static uint16_t Global_uint16HeldLength;
+static uint8_t  Global_uint8HeldLink;
+
+/*
+ * Global_uint8TxCapture
+ * ---------------------
+ * While set, BL_voidTransportTxStart() leaves the response in the TX buffer
+ * and only records its length: BL_BATCH reads the status of each sub-command
+ * there instead of sending it.
+ */
+static uint8_t  Global_uint8TxCapture;
+static uint16_t Global_uint16TxCaptured;
+
+/* Link counters (BL_voidTransportGetStats); the USART2 error counters and the ring
+ * high-water mark grow in interrupt context */
+static BL_TransportStats_t Global_Stats;
+
+/*
+ * Partial frame timeout (BL_FRAME_TIMEOUT_MS)
+ * -------------------------------------------
+ * Global_uint8PartialPending : Bit n set, link n holds an incomplete frame the parser waits for.
+ * Global_uint16PartialLevel  : Bytes buffered on the link when that frame last grew.
+ * Global_uint32PartialTick   : HAL_GetTick() at that moment.
+ */
+static uint8_t  Global_uint8PartialPending;
+static uint16_t Global_uint16PartialLevel[BL_LINK_COUNT];
+static uint32_t Global_uint32PartialTick[BL_LINK_COUNT];
+
+/*
+ * Global_uint8Framing
+ * -------------------
+ * BL_FRAMING_LENGTH / BL_FRAMING_COBS. In COBS mode Global_uint16CobsScanned
+ * holds, per link, how many bytes at the ring tail are known to contain no
+ * delimiter, so a frame arriving in pieces is not scanned again from its start.
+ */
+static uint8_t  Global_uint8Framing = BL_FRAMING_LENGTH;
+static uint16_t Global_uint16CobsScanned[BL_LINK_COUNT];
+
+/*
+ * Frame queue (BL_FRAME_QUEUE_DEPTH)
+ * ----------------------------------
+ * Global_FrameQueue         : USART2 frames framed and checked by the receive interrupt, in ring order.
+ * Global_uint16QueueScanned : Bytes after the ring tail covered by the held USART2 frame and the queue,
+ *                             where the interrupt resumes.
+ * Global_uint8QueueLock     : Set while the command loop (or an outer interrupt) works on the ring
+ *                             tail or the queue; the interrupt then leaves the frames to the parser.
+ * Global_puint8CheckedFrame : Frame handed out with the pre-checked CRC status Global_uint8CheckedCrc.
+ * Global_uint8CheckAhead    : Flash is being programmed (BL_voidTransportCheckAhead): queued frames
+ *                             are checked by DMA, the one in flight is Global_uint8CheckEntry.
+ */
+typedef struct
+{
+	uint16_t Length;                            /* Whole frame, CRC included */
+	uint8_t  CrcStatus;                         /* BL_CRC_FRAME_xxx */
+} BL_QueuedFrame_t;
+
+static BL_QueuedFrame_t  Global_FrameQueue[BL_FRAME_QUEUE_DEPTH];
+static volatile uint8_t  Global_uint8QueueHead;
+static volatile uint8_t  Global_uint8QueueCount;
+static volatile uint16_t Global_uint16QueueScanned;
+static volatile uint8_t  Global_uint8QueueLock;
+static const uint8_t*    Global_puint8CheckedFrame;
+static uint8_t           Global_uint8CheckedCrc;
+#if BL_CRC_WORDWISE_ENABLE
+static volatile uint8_t  Global_uint8CheckAhead;
+static uint8_t           Global_uint8CheckEntry;
+#endif
+
+#if BL_RS485_ENABLE
+/*
+ * RS-485 node header (BL_RS485_ENABLE)
+ * ------------------------------------
+ * Global_uint8Rs485State      : What the USART2 ring tail holds: a node header (RS485_WAIT_HEADER),
+ *                               our frame behind a taken header (RS485_FRAME_OURS) or another
+ *                               node's frame, to be skipped once its length is known (RS485_FRAME_FOREIGN).
+ * Global_uint16Rs485Skip      : Bytes still to drop (another node's frame or response).
+ * Global_uint8Rs485Broadcast  : The USART2 frame handed out last came with the broadcast header,
+ *                               Global_uint16Rs485Sequence is its sequence number.
+ * Global_uint8Rs485Done       : Bit n set, broadcast write n succeeded; Global_uint16Rs485End is
+ *                               one past the highest sequence number received.
+ */
+#define RS485_WAIT_HEADER            0u
+#define RS485_FRAME_OURS             1u
+#define RS485_FRAME_FOREIGN          2u
+
+static uint8_t  Global_uint8Rs485State;
+static uint16_t Global_uint16Rs485Skip;
+static uint8_t  Global_uint8Rs485Broadcast;
+static uint16_t Global_uint16Rs485Sequence;
+static uint8_t  Global_uint8Rs485Done[BL_RS485_SEQUENCE_COUNT / 8u];
+static uint16_t Global_uint16Rs485End;
+#endif
+
+
+/*
+ * uint16_GetRxHead
+ * ----------------
+ * Returns the index of the next byte the DMA will write.
+ * The DMA stream counts NDTR down from BL_RX_RING_SIZE to 1 and reloads it
+ * automatically in circular mode, so the write position is SIZE - NDTR.
+ */
+__RAM_FUNC static uint16_t uint16_GetRxHead(void)
+{
+	return (uint16_t)((BL_RX_RING_SIZE - BL_uint16UARTRxRemaining()) & (BL_RX_RING_SIZE - 1u));
+}
+
+
+/*
+ * voidUpdateRts
+ * -------------
+ * Applies the RTS rule of BL_UART_FLOW_CONTROL_ENABLE (see BL_Transport.h).
+ * Called from thread and interrupt context; between the watermarks RTS keeps
+ * its state (hysteresis). Runs from RAM like the rest of the interrupt path.
+ * Every RX event passes here: the ring's high-water mark is taken as well,
+ * the margin left before the DMA overwrites unread bytes.
+ */
+__RAM_FUNC static void voidUpdateRts(void)
+{
+	uint16_t Local_uint16Fill = BL_uint16TransportAvailable();
+
+	if(Local_uint16Fill > Global_Stats.RxRingHighWater)
+	{
+		Global_Stats.RxRingHighWater = Local_uint16Fill;
+	}
+
+#if BL_UART_FLOW_CONTROL_ENABLE
+	if((Global_uint8FlashBusy != 0) || (Local_uint16Fill >= BL_RX_RTS_HIGH_WATERMARK))
+	{
+		HAL_GPIO_WritePin(BL_UART_RTS_PORT, BL_UART_RTS_PIN, GPIO_PIN_SET);      /* Stop */
+	}
+	else if(Local_uint16Fill <= BL_RX_RTS_LOW_WATERMARK)
+	{
+		HAL_GPIO_WritePin(BL_UART_RTS_PORT, BL_UART_RTS_PIN, GPIO_PIN_RESET);    /* Send */
+	}
+#endif
+}
+
+
+#if BL_CRC_WORDWISE_ENABLE
+/*
+ * voidCheckAhead
+ * --------------
+ * One step of the DMA frame check while flash is programmed, with the queue
+ * locked: takes the result of the frame in flight once the stream is done
+ * (waiting for it with Copy_uint8Wait), then starts the oldest queued frame
+ * still unchecked. The queued frames end Global_uint16QueueScanned bytes
+ * after the ring tail, which gives where the first one starts.
+ */
+__RAM_FUNC static void voidCheckAhead(uint8_t Copy_uint8Wait)
+{
+	uint16_t Local_uint16Offset = Global_uint16QueueScanned;
+	uint8_t  Local_uint8Entry;
+	uint8_t  Local_uint8Index;
+	uint8_t  Local_uint8Status = BL_uint8CRCCheckFramePoll(Copy_uint8Wait);
+
+	if(Local_uint8Status == BL_CRC_FRAME_PENDING)
+	{
+		return;
+	}
+
+	/* OK / BAD, or UNCHECKED after a transfer error: the dispatcher computes it */
+	if(Global_FrameQueue[Global_uint8CheckEntry].CrcStatus == BL_CRC_FRAME_PENDING)
+	{
+		Global_FrameQueue[Global_uint8CheckEntry].CrcStatus = Local_uint8Status;
+	}
+
+	if(Copy_uint8Wait != 0u)
+	{
+		return;
+	}
+
+	for(Local_uint8Index = 0; Local_uint8Index < Global_uint8QueueCount; Local_uint8Index++)
+	{
+		Local_uint16Offset = (uint16_t)(Local_uint16Offset - Global_FrameQueue[(Global_uint8QueueHead + Local_uint8Index) % BL_FRAME_QUEUE_DEPTH].Length);
+	}
+
+	for(Local_uint8Index = 0; Local_uint8Index < Global_uint8QueueCount; Local_uint8Index++)
+	{
+		Local_uint8Entry = (uint8_t)((Global_uint8QueueHead + Local_uint8Index) % BL_FRAME_QUEUE_DEPTH);
+
+		if((Global_FrameQueue[Local_uint8Entry].CrcStatus == BL_CRC_FRAME_UNCHECKED) &&
+		   (BL_uint8CRCCheckFrameStart(&Global_uint8RxRing[(Global_uint16RxTail + Local_uint16Offset) & (BL_RX_RING_SIZE - 1u)],
+		                               Global_FrameQueue[Local_uint8Entry].Length) == BL_CRC_FRAME_PENDING))
+		{
+			Global_FrameQueue[Local_uint8Entry].CrcStatus = BL_CRC_FRAME_PENDING;
+			Global_uint8CheckEntry = Local_uint8Entry;
+			break;
+		}
+
+		Local_uint16Offset = (uint16_t)(Local_uint16Offset + Global_FrameQueue[Local_uint8Entry].Length);
+	}
+}
+#endif
+
+
+/*
+ * voidQueueFrames
+ * ---------------
+ * Receive interrupt side of the frame queue (see BL_FRAME_QUEUE_DEPTH).
+ *
+ * Behavior:
+ * ---------
+ * 1. Does nothing while the queue is locked, in COBS mode or with BL_RS485_ENABLE.
+ * 2. From Global_uint16QueueScanned on, reads each frame header with the same
+ *    rules as uint16_ExtractFrame() and stops at the first frame that is
+ *    incomplete, invalid, wraps around the ring end or is an aligned frame
+ *    off a word: the command loop's parser handles it.
+ * 3. Checks the CRC of each complete frame and appends it to the queue.
+ *    While flash is programmed the CPU is left alone: the frames are
+ *    queued unchecked and checked by DMA one after the other (voidCheckAhead).
+ */
+__RAM_FUNC static void voidQueueFrames(void)
+{
+	uint16_t Local_uint16Available;
+	uint16_t Local_uint16Start;
+	uint32_t Local_uint32FrameLength;
+	uint8_t  Local_uint8Marker;
+
+	/* RS-485: the node headers are only taken by the command loop's parser */
+	if((Global_uint8QueueLock != 0) || (Global_uint8Framing != BL_FRAMING_LENGTH) || (BL_RS485_ENABLE != 0))
+	{
+		return;
+	}
+	Global_uint8QueueLock = 1;
+
+	while(Global_uint8QueueCount < BL_FRAME_QUEUE_DEPTH)
+	{
+		Local_uint16Available = (uint16_t)(BL_uint16TransportAvailable() - Global_uint16QueueScanned);
+		if((Local_uint16Available == 0u) || (Local_uint16Available > BL_RX_RING_SIZE))
+		{
+			break;
+		}
+
+		Local_uint16Start = (Global_uint16RxTail + Global_uint16QueueScanned) & (BL_RX_RING_SIZE - 1u);
+		Local_uint8Marker = Global_uint8RxRing[Local_uint16Start];
+
+		if(Local_uint8Marker > BL_FRAME_ALIGNED_MARKER)
+		{
+			Local_uint32FrameLength = (uint32_t)Local_uint8Marker + 1u;
+		}
+		else
+		{
+			/* The 16-bit length may not wrap either */
+			if((Local_uint16Available < BL_FRAME_EXT_HEADER_LENGTH) || ((Local_uint16Start + BL_FRAME_EXT_HEADER_LENGTH) > BL_RX_RING_SIZE))
+			{
+				break;
+			}
+
+			Local_uint32FrameLength = (uint32_t)(Global_uint8RxRing[Local_uint16Start + 1u] | (Global_uint8RxRing[Local_uint16Start + 2u] << 8));
+			if(Local_uint8Marker == BL_FRAME_ALIGNED_MARKER)
+			{
+				if((Local_uint32FrameLength < 5u) || ((Local_uint16Start & 3u) != 0u))
+				{
+					break;
+				}
+				Local_uint32FrameLength = BL_FRAME_ALIGNED_PAD(Local_uint32FrameLength - 5u) + 5u;
+			}
+			Local_uint32FrameLength += BL_FRAME_EXT_HEADER_LENGTH;
+
+			if(Local_uint32FrameLength < BL_FRAME_EXT_MIN_LENGTH)
+			{
+				break;
+			}
+		}
+
+		if((Local_uint32FrameLength < BL_FRAME_MIN_LENGTH) || (Local_uint32FrameLength > BL_MAX_FRAME_LENGTH) ||
+		   (Local_uint32FrameLength > Local_uint16Available) || ((Local_uint16Start + Local_uint32FrameLength) > BL_RX_RING_SIZE))
+		{
+			break;
+		}
+
+		Global_FrameQueue[(Global_uint8QueueHead + Global_uint8QueueCount) % BL_FRAME_QUEUE_DEPTH].Length    = (uint16_t)Local_uint32FrameLength;
+#if BL_CRC_WORDWISE_ENABLE
+		if(Global_uint8CheckAhead != 0u)
+		{
+			Global_FrameQueue[(Global_uint8QueueHead + Global_uint8QueueCount) % BL_FRAME_QUEUE_DEPTH].CrcStatus = BL_CRC_FRAME_UNCHECKED;
+		}
+		else
+#endif
+		{
+			Global_FrameQueue[(Global_uint8QueueHead + Global_uint8QueueCount) % BL_FRAME_QUEUE_DEPTH].CrcStatus =
+				BL_uint8CRCCheckFrame(&Global_uint8RxRing[Local_uint16Start], (uint16_t)Local_uint32FrameLength);
+		}
+		Global_uint8QueueCount++;
+		Global_uint16QueueScanned = (uint16_t)(Global_uint16QueueScanned + Local_uint32FrameLength);
+	}
+
+#if BL_CRC_WORDWISE_ENABLE
+	if(Global_uint8CheckAhead != 0u)
+	{
+		voidCheckAhead(0u);
+	}
+#endif
+
+	Global_uint8QueueLock = 0;
+}
+
+
+/*
+ * voidClearQueue
+ * --------------
+ * Forgets the queued frames (they stay in the ring and are parsed again).
+ * Called with the queue locked, when the ring tail moves by other means.
+ */
+static void voidClearQueue(void)
+{
+	Global_uint8QueueHead     = 0;
+	Global_uint8QueueCount    = 0;
+	Global_uint16QueueScanned = 0;
+}
+
+
+/*
+ * voidStartReception
+ * ------------------
+ * (Re)starts circular DMA reception at the beginning of the ring and enables
+ * the IDLE line interrupt used for frame completion events.
+ */
+static void voidStartReception(void)
+{
+	Global_uint8QueueLock = 1;
+
+	/* A frame held in the ring is gone with it, so are the queued ones */
+	if(Global_uint8HeldLink == BL_LINK_UART)
+	{
+		Global_uint16HeldLength = 0;
+	}
+	voidClearQueue();
+
+	Global_uint16RxTail   = 0;
+	Global_uint8RxEvent   = 0;
+	Global_uint8RxRestart = 0;
+#if BL_RS485_ENABLE
+	Global_uint8Rs485State = RS485_WAIT_HEADER;
+	Global_uint16Rs485Skip = 0;
+#endif
+
+	BL_voidUARTStartRx(Global_uint8RxRing, BL_RX_RING_SIZE);
+	Global_uint8QueueLock = 0;
+}
+
+
+/*
+ * uint8_LinkListening
+ * -------------------
+ * 1 while Copy_uint8Link is served: no link locked yet, or it is the locked one.
+ */
+static uint8_t uint8_LinkListening(uint8_t Copy_uint8Link)
+{
+#if BL_TRANSPORT_LOCK_ENABLE
+	if(Copy_uint8Link == BL_LINK_CAN_GROUP)
+	{
+		Copy_uint8Link = BL_LINK_CAN;
+	}
+
+	return (uint8_t)((Global_uint8LockedLink == BL_LINK_COUNT) || (Global_uint8LockedLink == Copy_uint8Link));
+#else
+	(void)Copy_uint8Link;
+
+	return 1u;
+#endif
+}
+
+
+/*
+ * Link access
+ * -----------
+ * The frame parser is the same for every link; these helpers hide where the
+ * bytes are buffered: the USART2 DMA ring, the USB bulk OUT ring, the SPI1 DMA ring
+ * or one of the two CAN1 rings.
+ */
+static uint16_t uint16_LinkAvailable(uint8_t Copy_uint8Link)
+{
+#if BL_TRANSPORT_USB_ENABLE
+	if(Copy_uint8Link == BL_LINK_USB)
+	{
+		return BL_uint16USBAvailable();
+	}
+#endif
+#if BL_TRANSPORT_SPI_ENABLE
+	if(Copy_uint8Link == BL_LINK_SPI)
+	{
+		return BL_uint16SPIAvailable();
+	}
+#endif
+#if BL_TRANSPORT_CAN_ENABLE
+	if((Copy_uint8Link == BL_LINK_CAN) || (Copy_uint8Link == BL_LINK_CAN_GROUP))
+	{
+		return BL_uint16CANAvailable((uint8_t)(Copy_uint8Link == BL_LINK_CAN_GROUP));
+	}
+#endif
+	return BL_uint16TransportAvailable();
+}
+
+static uint8_t uint8_LinkPeek(uint8_t Copy_uint8Link, uint16_t Copy_uint16Offset)
+{
+#if BL_TRANSPORT_USB_ENABLE
+	if(Copy_uint8Link == BL_LINK_USB)
+	{
+		return BL_uint8USBPeek(Copy_uint16Offset);
+	}
+#endif
+#if BL_TRANSPORT_SPI_ENABLE
+	if(Copy_uint8Link == BL_LINK_SPI)
+	{
+		return BL_uint8SPIPeek(Copy_uint16Offset);
+	}
+#endif
+#if BL_TRANSPORT_CAN_ENABLE
+	if((Copy_uint8Link == BL_LINK_CAN) || (Copy_uint8Link == BL_LINK_CAN_GROUP))
+	{
+		return BL_uint8CANPeek((uint8_t)(Copy_uint8Link == BL_LINK_CAN_GROUP), Copy_uint16Offset);
+	}
+#endif
+	return Global_uint8RxRing[(Global_uint16RxTail + Copy_uint16Offset) & (BL_RX_RING_SIZE - 1u)];
+}
+
+static uint8_t* puint8_LinkPeekBuffer(uint8_t Copy_uint8Link, uint16_t Copy_uint16Length)
+{
+#if BL_TRANSPORT_USB_ENABLE
+	if(Copy_uint8Link == BL_LINK_USB)
+	{
+		return BL_puint8USBPeekBuffer(Copy_uint16Length);
+	}
+#endif
+#if BL_TRANSPORT_SPI_ENABLE
+	if(Copy_uint8Link == BL_LINK_SPI)
+	{
+		/* The SPI ring is flushed after every response read-out: always copied */
+		return NULL;
+	}
+#endif
+#if BL_TRANSPORT_CAN_ENABLE
+	if((Copy_uint8Link == BL_LINK_CAN) || (Copy_uint8Link == BL_LINK_CAN_GROUP))
+	{
+		/* Frames arrive 8 bytes at a time, copying them costs nothing next to the bus */
+		return NULL;
+	}
+#endif
+	if(((uint32_t)Global_uint16RxTail + Copy_uint16Length) > BL_RX_RING_SIZE)
+	{
+		return NULL;
+	}
+
+	return &Global_uint8RxRing[Global_uint16RxTail];
+}
+
+static void voidLinkConsume(uint8_t Copy_uint8Link, uint16_t Copy_uint16Count)
+{
+#if BL_TRANSPORT_USB_ENABLE
+	if(Copy_uint8Link == BL_LINK_USB)
+	{
+		BL_voidUSBConsume(Copy_uint16Count);
+		return;
+	}
+#endif
+#if BL_TRANSPORT_SPI_ENABLE
+	if(Copy_uint8Link == BL_LINK_SPI)
+	{
+		BL_voidSPIConsume(Copy_uint16Count);
+		return;
+	}
+#endif
+#if BL_TRANSPORT_CAN_ENABLE
+	if((Copy_uint8Link == BL_LINK_CAN) || (Copy_uint8Link == BL_LINK_CAN_GROUP))
+	{
+		BL_voidCANConsume((uint8_t)(Copy_uint8Link == BL_LINK_CAN_GROUP), Copy_uint16Count);
+		return;
+	}
+#endif
+	Global_uint16RxTail = (Global_uint16RxTail + Copy_uint16Count) & (BL_RX_RING_SIZE - 1u);
+	voidUpdateRts();
+}
+
+
+/*
+ * uint8_PartialFrameExpired
+ * -------------------------
+ * Called when the frame at the tail of a link is incomplete. Restarts the
+ * timeout whenever more bytes have arrived; once BL_FRAME_TIMEOUT_MS pass
+ * without any, the buffered bytes are discarded (resynchronization).
+ *
+ * Return:
+ * -------
+ * @return uint8_t : 1 if the partial frame was discarded.
+ */
+static uint8_t uint8_PartialFrameExpired(uint8_t Copy_uint8Link, uint16_t Copy_uint16Available)
+{
+	uint8_t Local_uint8Mask = (uint8_t)(1u << Copy_uint8Link);
+
+	if(((Global_uint8PartialPending & Local_uint8Mask) == 0u) || (Global_uint16PartialLevel[Copy_uint8Link] != Copy_uint16Available))
+	{
+		Global_uint8PartialPending |= Local_uint8Mask;
+		Global_uint16PartialLevel[Copy_uint8Link] = Copy_uint16Available;
+		Global_uint32PartialTick[Copy_uint8Link]  = HAL_GetTick();
+		return 0;
+	}
+
+	if((HAL_GetTick() - Global_uint32PartialTick[Copy_uint8Link]) < BL_FRAME_TIMEOUT_MS)
+	{
+		return 0;
+	}
+
+	/* Nothing more is coming: back to the idle state, the host retransmits */
+	voidLinkConsume(Copy_uint8Link, Copy_uint16Available);
+	Global_uint8PartialPending &= (uint8_t)~Local_uint8Mask;
+#if BL_RS485_ENABLE
+	if(Copy_uint8Link == BL_LINK_UART)
+	{
+		/* Also a response cut short: its remaining length is not coming */
+		Global_uint8Rs485State = RS485_WAIT_HEADER;
+		Global_uint16Rs485Skip = 0;
+	}
+#endif
+	return 1u;
+}
+
+
+/*
+ * uint8_PartialFrameDue
+ * ---------------------
+ * 1 when an incomplete frame has waited BL_FRAME_TIMEOUT_MS, so the idle
+ * wait of the parser also ends for it (SysTick advances HAL_GetTick()).
+ */
+static uint8_t uint8_PartialFrameDue(void)
+{
+	uint8_t Local_uint8Link;
+
+	for(Local_uint8Link = 0; Local_uint8Link < BL_LINK_COUNT; Local_uint8Link++)
+	{
+		if(((Global_uint8PartialPending & (1u << Local_uint8Link)) != 0u) &&
+		   ((HAL_GetTick() - Global_uint32PartialTick[Local_uint8Link]) >= BL_FRAME_TIMEOUT_MS))
+		{
+			return 1u;
+		}
+	}
+
+	return 0;
+}
+
+
+/*
+ * uint16_CheckFrameLength
+ * -----------------------
+ * Total length a frame header announces (same rules as uint16_ExtractFrame),
+ * 0 if it cannot describe a frame of at least its format's minimum length.
+ */
+static uint16_t uint16_CheckFrameLength(const uint8_t* Copy_puint8Frame, uint16_t Copy_uint16Length)
+{
+	uint32_t Local_uint32FrameLength;
+
+	if(Copy_puint8Frame[0] > BL_FRAME_ALIGNED_MARKER)
+	{
+		Local_uint32FrameLength = (uint32_t)Copy_puint8Frame[0] + 1u;
+		return (Local_uint32FrameLength >= BL_FRAME_MIN_LENGTH) ? (uint16_t)Local_uint32FrameLength : 0u;
+	}
+
+	if(Copy_uint16Length < BL_FRAME_EXT_MIN_LENGTH)
+	{
+		return 0;
+	}
+
+	Local_uint32FrameLength = (uint32_t)(Copy_puint8Frame[1] | (Copy_puint8Frame[2] << 8));
+	if(Copy_puint8Frame[0] == BL_FRAME_ALIGNED_MARKER)
+	{
+		if(Local_uint32FrameLength < 5u)
+		{
+			return 0;
+		}
+		Local_uint32FrameLength = BL_FRAME_ALIGNED_PAD(Local_uint32FrameLength - 5u) + 5u;
+	}
+	Local_uint32FrameLength += BL_FRAME_EXT_HEADER_LENGTH;
+
+	return ((Local_uint32FrameLength >= BL_FRAME_EXT_MIN_LENGTH) && (Local_uint32FrameLength <= 0xFFFFu)) ? (uint16_t)Local_uint32FrameLength : 0u;
+}
+
+
+#if BL_RS485_ENABLE
+/*
+ * uint8_Rs485TakeHeader
+ * ---------------------
+ * Runs before each USART2 frame is parsed: takes the node header at the ring
+ * tail (see "RS-485 Multidrop" in BL_Transport.h) and drops whatever is not
+ * meant for this node, another node's frame by its length, a response by the
+ * length in its header, noise one byte at a time.
+ *
+ * Return:
+ * -------
+ * @return uint8_t : 1 when a frame for this node starts at the tail,
+ *                   0 while bytes are missing (partial frame timeout running).
+ */
+static uint8_t uint8_Rs485TakeHeader(uint16_t* Copy_puint16Available)
+{
+	uint8_t  Local_uint8Header[3];
+	uint16_t Local_uint16Count;
+
+	while(1)
+	{
+		if(Global_uint16Rs485Skip != 0u)
+		{
+			Local_uint16Count = (*Copy_puint16Available < Global_uint16Rs485Skip) ? *Copy_puint16Available : Global_uint16Rs485Skip;
+			voidLinkConsume(BL_LINK_UART, Local_uint16Count);
+			*Copy_puint16Available  = (uint16_t)(*Copy_puint16Available - Local_uint16Count);
+			Global_uint16Rs485Skip  = (uint16_t)(Global_uint16Rs485Skip - Local_uint16Count);
+		}
+
+		if((Global_uint16Rs485Skip != 0u) || (*Copy_puint16Available == 0u))
+		{
+			/* Nothing pending once a skipped frame ended exactly at the head */
+			if((Global_uint16Rs485Skip != 0u) || (Global_uint8Rs485State == RS485_FRAME_OURS))
+			{
+				(void)uint8_PartialFrameExpired(BL_LINK_UART, *Copy_puint16Available);
+			}
+			return 0u;
+		}
+
+		Local_uint8Header[0] = uint8_LinkPeek(BL_LINK_UART, 0u);
+
+		if(Global_uint8Rs485State == RS485_FRAME_OURS)
+		{
+			return 1u;
+		}
+
+		if(Global_uint8Rs485State == RS485_FRAME_FOREIGN)
+		{
+			/* Wait for enough of the other frame to read its length */
+			if((Local_uint8Header[0] <= BL_FRAME_ALIGNED_MARKER) && (*Copy_puint16Available < BL_FRAME_EXT_MIN_LENGTH))
+			{
+				(void)uint8_PartialFrameExpired(BL_LINK_UART, *Copy_puint16Available);
+				return 0u;
+			}
+
+			Local_uint8Header[1] = uint8_LinkPeek(BL_LINK_UART, 1u);
+			Local_uint8Header[2] = uint8_LinkPeek(BL_LINK_UART, 2u);
+			Global_uint16Rs485Skip = uint16_CheckFrameLength(Local_uint8Header, *Copy_puint16Available);
+			Global_uint8Rs485State = RS485_WAIT_HEADER;
+			continue;
+		}
+
+		if(*Copy_puint16Available < BL_RS485_HEADER_LENGTH)
+		{
+			(void)uint8_PartialFrameExpired(BL_LINK_UART, *Copy_puint16Available);
+			return 0u;
+		}
+
+		Local_uint8Header[1] = uint8_LinkPeek(BL_LINK_UART, 1u);
+
+		if(Local_uint8Header[1] != (uint8_t)~Local_uint8Header[0])
+		{
+			voidLinkConsume(BL_LINK_UART, 1u);
+			(*Copy_puint16Available)--;
+			continue;
+		}
+
+		if((Local_uint8Header[0] == BL_RS485_ADDRESS_BROADCAST) || (Local_uint8Header[0] == BL_RS485_ADDRESS_HOST))
+		{
+			if(*Copy_puint16Available < BL_RS485_LONG_HEADER_LENGTH)
+			{
+				(void)uint8_PartialFrameExpired(BL_LINK_UART, *Copy_puint16Available);
+				return 0u;
+			}
+
+			Local_uint16Count = (uint16_t)(uint8_LinkPeek(BL_LINK_UART, 2u) | (uint8_LinkPeek(BL_LINK_UART, 3u) << 8));
+			voidLinkConsume(BL_LINK_UART, BL_RS485_LONG_HEADER_LENGTH);
+			*Copy_puint16Available = (uint16_t)(*Copy_puint16Available - BL_RS485_LONG_HEADER_LENGTH);
+
+			if(Local_uint8Header[0] == BL_RS485_ADDRESS_HOST)
+			{
+				/* Another node's response */
+				Global_uint16Rs485Skip = Local_uint16Count;
+				continue;
+			}
+
+			Global_uint8Rs485Broadcast = 1u;
+			Global_uint16Rs485Sequence = Local_uint16Count;
+			if((Local_uint16Count < BL_RS485_SEQUENCE_COUNT) && (Local_uint16Count >= Global_uint16Rs485End))
+			{
+				Global_uint16Rs485End = (uint16_t)(Local_uint16Count + 1u);
+			}
+			Global_uint8Rs485State = RS485_FRAME_OURS;
+			continue;
+		}
+
+		voidLinkConsume(BL_LINK_UART, BL_RS485_HEADER_LENGTH);
+		*Copy_puint16Available = (uint16_t)(*Copy_puint16Available - BL_RS485_HEADER_LENGTH);
+
+		if(Local_uint8Header[0] == BL_RS485_NODE_ADDRESS)
+		{
+			Global_uint8Rs485Broadcast = 0u;
+			Global_uint8Rs485State     = RS485_FRAME_OURS;
+		}
+		else
+		{
+			Global_uint8Rs485State     = RS485_FRAME_FOREIGN;
+		}
+	}
+}
+
+
+/*
+ * voidRs485SendHeader
+ * -------------------
+ * Takes the bus (DE high) and sends the response header announcing the
+ * Copy_uint16Length bytes that follow it, so the other nodes skip them.
+ * Blocking: 4 bytes, before the DMA transfer of the bytes themselves.
+ */
+static void voidRs485SendHeader(uint16_t Copy_uint16Length)
+{
+	uint8_t Local_uint8Header[BL_RS485_LONG_HEADER_LENGTH];
+
+	Local_uint8Header[0] = BL_RS485_ADDRESS_HOST;
+	Local_uint8Header[1] = (uint8_t)~BL_RS485_ADDRESS_HOST;
+	Local_uint8Header[2] = (uint8_t)Copy_uint16Length;
+	Local_uint8Header[3] = (uint8_t)(Copy_uint16Length >> 8);
+
+	BL_RS485_DE_PORT->BSRR = BL_RS485_DE_PIN;
+	BL_voidUARTWrite(Local_uint8Header, BL_RS485_LONG_HEADER_LENGTH);
+}
+#endif
+
+
+/*
+ * uint16_CobsDecode
+ * -----------------
+ * Decodes the Copy_uint16EncodedLength bytes at the ring tail (delimiter
+ * excluded) into Copy_puint8Frame. The output never runs ahead of the input,
+ * so Copy_puint8Frame may be the ring tail itself (decoding in place).
+ *
+ * Return:
+ * -------
+ * @return uint16_t : Decoded length, 0 if the encoding is broken or the frame
+ *                    does not fit Copy_uint16MaxLength.
+ */
+static uint16_t uint16_CobsDecode(uint8_t Copy_uint8Link, uint16_t Copy_uint16EncodedLength, uint8_t* Copy_puint8Frame, uint16_t Copy_uint16MaxLength)
+{
+	uint16_t Local_uint16In = 0;
+	uint16_t Local_uint16Out = 0;
+
+	while(Local_uint16In < Copy_uint16EncodedLength)
+	{
+		/* Code byte: that many - 1 data bytes follow, then a zero unless the code is 0xFF */
+		uint8_t Local_uint8Code = uint8_LinkPeek(Copy_uint8Link, Local_uint16In++);
+		uint8_t Local_uint8Iterator;
+
+		if(((uint32_t)Local_uint16In + Local_uint8Code - 1u) > Copy_uint16EncodedLength)
+		{
+			return 0;
+		}
+
+		for(Local_uint8Iterator = 1; Local_uint8Iterator < Local_uint8Code; Local_uint8Iterator++)
+		{
+			if(Local_uint16Out >= Copy_uint16MaxLength)
+			{
+				return 0;
+			}
+			Copy_puint8Frame[Local_uint16Out++] = uint8_LinkPeek(Copy_uint8Link, Local_uint16In++);
+		}
+
+		if((Local_uint8Code != 0xFFu) && (Local_uint16In < Copy_uint16EncodedLength))
+		{
+			if(Local_uint16Out >= Copy_uint16MaxLength)
+			{
+				return 0;
+			}
+			Copy_puint8Frame[Local_uint16Out++] = 0x00u;
+		}
+	}
+
+	return Local_uint16Out;
+}
+
+
+/*
+ * uint16_ExtractCobsFrame
+ * -----------------------
+ * BL_FRAMING_COBS counterpart of uint16_ExtractFrame().
+ *
+ * Behavior:
+ * ---------
+ * 1. Looks for a delimiter at the ring tail, from where the last call stopped.
+ *    Empty frames (delimiters back to back) are skipped; more bytes than the
+ *    largest encoded frame without a delimiter are dropped.
+ * 2. A frame that does not wrap is decoded in place and held until
+ *    BL_voidTransportReleaseFrame(), with its delimiter; otherwise (or for an
+ *    aligned frame not on a word) it is decoded into the caller's buffer.
+ * 3. A broken encoding, or a decoded frame whose header does not announce
+ *    exactly its length, is dropped up to its delimiter.
+ *
+ * Return:
+ * -------
+ * @return uint16_t : Decoded frame length, 0 if no complete frame yet.
+ */
+static uint16_t uint16_ExtractCobsFrame(uint8_t Copy_uint8Link, uint8_t** Copy_ppuint8Frame, uint8_t* Copy_puint8Buffer, uint16_t Copy_uint16MaxLength)
+{
+	uint16_t Local_uint16Available = uint16_LinkAvailable(Copy_uint8Link);
+	uint16_t Local_uint16MaxEncoded = (uint16_t)(Copy_uint16MaxLength + BL_COBS_OVERHEAD(Copy_uint16MaxLength));
+	uint16_t Local_uint16Encoded;
+	uint16_t Local_uint16FrameLength;
+	uint8_t* Local_puint8Decoded;
+
+	while(1)
+	{
+		/* Step 1: end of the frame at the tail */
+		Local_uint16Encoded = Global_uint16CobsScanned[Copy_uint8Link];
+		while((Local_uint16Encoded < Local_uint16Available) && (uint8_LinkPeek(Copy_uint8Link, Local_uint16Encoded) != BL_COBS_DELIMITER))
+		{
+			Local_uint16Encoded++;
+		}
+
+		if(Local_uint16Encoded >= Local_uint16Available)
+		{
+			if(Local_uint16Encoded > Local_uint16MaxEncoded)
+			{
+				/* Too long to be a frame: the next delimiter starts the next one */
+				voidLinkConsume(Copy_uint8Link, Local_uint16Encoded);
+				Local_uint16Encoded = 0;
+			}
+			Global_uint16CobsScanned[Copy_uint8Link] = Local_uint16Encoded;
+			return 0;
+		}
+		Global_uint16CobsScanned[Copy_uint8Link] = 0;
+
+		if((Local_uint16Encoded == 0u) || (Local_uint16Encoded > Local_uint16MaxEncoded))
+		{
+			voidLinkConsume(Copy_uint8Link, (uint16_t)(Local_uint16Encoded + 1u));
+			Local_uint16Available = (uint16_t)(Local_uint16Available - Local_uint16Encoded - 1u);
+			continue;
+		}
+
+		/* Step 2: in place when contiguous, the delimiter is held with the frame */
+		Local_puint8Decoded = puint8_LinkPeekBuffer(Copy_uint8Link, (uint16_t)(Local_uint16Encoded + 1u));
+		if(Local_puint8Decoded == NULL)
+		{
+			Local_puint8Decoded = Copy_puint8Buffer;
+		}
+
+		Local_uint16FrameLength = uint16_CobsDecode(Copy_uint8Link, Local_uint16Encoded, Local_puint8Decoded, Copy_uint16MaxLength);
+
+		/* Step 3: the decoded header must describe the decoded bytes */
+		if((Local_uint16FrameLength == 0u) ||
+		   (uint16_CheckFrameLength(Local_puint8Decoded, Local_uint16FrameLength) != Local_uint16FrameLength))
+		{
+			voidLinkConsume(Copy_uint8Link, (uint16_t)(Local_uint16Encoded + 1u));
+			Local_uint16Available = (uint16_t)(Local_uint16Available - Local_uint16Encoded - 1u);
+			continue;
+		}
+
+		if((Local_puint8Decoded != Copy_puint8Buffer) &&
+		   ((Local_puint8Decoded[0] != BL_FRAME_ALIGNED_MARKER) || (((uint32_t)Local_puint8Decoded & 3u) == 0u)))
+		{
+			Global_uint16HeldLength = (uint16_t)(Local_uint16Encoded + 1u);
+			Global_uint8HeldLink    = Copy_uint8Link;
+		}
+		else
+		{
+			if(Local_puint8Decoded != Copy_puint8Buffer)
+			{
+				/* Aligned frame decoded off a word: moved to the (word-aligned) buffer */
+				memcpy(Copy_puint8Buffer, Local_puint8Decoded, Local_uint16FrameLength);
+				Local_puint8Decoded = Copy_puint8Buffer;
+			}
+			voidLinkConsume(Copy_uint8Link, (uint16_t)(Local_uint16Encoded + 1u));
+		}
+
+		*Copy_ppuint8Frame = Local_puint8Decoded;
+		return Local_uint16FrameLength;
+	}
+}
+
+
+/*
+ * uint16_CobsEncode
+ * -----------------
+ * COBS-encodes the first Copy_uint16Length bytes of the TX buffer in place and
+ * appends the delimiter. The data is first moved up by the worst-case overhead,
+ * so the encoder never writes ahead of what it still has to read.
+ *
+ * Return:
+ * -------
+ * @return uint16_t : Encoded length, delimiter included.
+ */
+static uint16_t uint16_CobsEncode(uint16_t Copy_uint16Length)
+{
+	uint16_t Local_uint16Overhead = (uint16_t)BL_COBS_OVERHEAD(Copy_uint16Length);
+	uint16_t Local_uint16In;
+	uint16_t Local_uint16Out = 1;
+	uint16_t Local_uint16CodeIndex = 0;
+	uint8_t  Local_uint8Code = 1;
+
+	memmove(&Global_uint8TxBuffer[Local_uint16Overhead], Global_uint8TxBuffer, Copy_uint16Length);
+
+	for(Local_uint16In = 0; Local_uint16In < Copy_uint16Length; Local_uint16In++)
+	{
+		uint8_t Local_uint8Byte = Global_uint8TxBuffer[Local_uint16Overhead + Local_uint16In];
+
+		if(Local_uint8Byte == 0x00u)
+		{
+			Global_uint8TxBuffer[Local_uint16CodeIndex] = Local_uint8Code;
+			Local_uint16CodeIndex = Local_uint16Out++;
+			Local_uint8Code = 1;
+		}
+		else
+		{
+			Global_uint8TxBuffer[Local_uint16Out++] = Local_uint8Byte;
+			if(++Local_uint8Code == 0xFFu)
+			{
+				Global_uint8TxBuffer[Local_uint16CodeIndex] = Local_uint8Code;
+				Local_uint16CodeIndex = Local_uint16Out++;
+				Local_uint8Code = 1;
+			}
+		}
+	}
+
+	Global_uint8TxBuffer[Local_uint16CodeIndex] = Local_uint8Code;
+	Global_uint8TxBuffer[Local_uint16Out++] = BL_COBS_DELIMITER;
+
+	return Local_uint16Out;
+}
+
+
+/*
+ * uint16_ExtractFrame
+ * -------------------
+ * Tries to take one complete frame out of the RX ring of a link.
+ *
+ * Behavior:
+ * ---------
+ * 1. Reads the "Length to Follow" byte at the ring tail without consuming it.
+ *    A BL_FRAME_EXT_MARKER or BL_FRAME_ALIGNED_MARKER byte is followed by a
+ *    16-bit length instead; an aligned frame also carries its payload padding.
+ * 2. A length that cannot hold a command code and CRC, or that does not fit the
+ *    caller's buffer, cannot start a valid frame: the byte is dropped so the
+ *    parser resynchronizes on the following bytes.
+ * 3. If the whole frame has arrived and does not wrap around the end of the
+ *    ring, it is handed out in place and held until BL_voidTransportReleaseFrame().
+ *    Only a wrapping frame, or an aligned frame not starting on a word of the
+ *    ring, is copied into the caller's (word-aligned) buffer and consumed.
+ * 4. An incomplete frame is dropped after BL_FRAME_TIMEOUT_MS without a new
+ *    byte (uint8_PartialFrameExpired()).
+ * 5. In BL_FRAMING_COBS mode the delimiters mark the frames instead
+ *    (uint16_ExtractCobsFrame()).
+ *
+ * Return:
+ * -------
+ * @return uint16_t : Frame length (length byte included), 0 if no complete frame yet.
+ */
+static uint16_t uint16_ExtractFrame(uint8_t Copy_uint8Link, uint8_t** Copy_ppuint8Frame, uint8_t* Copy_puint8Buffer, uint16_t Copy_uint16MaxLength)
+{
+	uint16_t Local_uint16Available = uint16_LinkAvailable(Copy_uint8Link);
+	uint16_t Local_uint16FrameLength;
+	uint16_t Local_uint16Iterator;
+
+	if(Global_uint8Framing == BL_FRAMING_COBS)
+	{
+		return uint16_ExtractCobsFrame(Copy_uint8Link, Copy_ppuint8Frame, Copy_puint8Buffer, Copy_uint16MaxLength);
+	}
+
+	while(Local_uint16Available > 0)
+	{
+		uint16_t Local_uint16MinLength = BL_FRAME_MIN_LENGTH;
+		uint8_t  Local_uint8Marker;
+
+#if BL_RS485_ENABLE
+		if((Copy_uint8Link == BL_LINK_UART) && (uint8_Rs485TakeHeader(&Local_uint16Available) == 0u))
+		{
+			return 0;
+		}
+#endif
+
+		Local_uint8Marker = uint8_LinkPeek(Copy_uint8Link, 0u);
+
+		if(Local_uint8Marker <= BL_FRAME_ALIGNED_MARKER)
+		{
+			if(Local_uint16Available < BL_FRAME_EXT_HEADER_LENGTH)
+			{
+				/* 16-bit length still arriving */
+				(void)uint8_PartialFrameExpired(Copy_uint8Link, Local_uint16Available);
+				return 0;
+			}
+
+			Local_uint16FrameLength = (uint16_t)(uint8_LinkPeek(Copy_uint8Link, 1u) | (uint8_LinkPeek(Copy_uint8Link, 2u) << 8));
+			if(Local_uint8Marker == BL_FRAME_ALIGNED_MARKER)
+			{
+				/* Command + Payload + CRC, the payload padded to a word */
+				Local_uint16FrameLength = (Local_uint16FrameLength < 5u) ? 0u :
+				                          (Local_uint16FrameLength > (0xFFFFu - 8u)) ? 0xFFFFu :
+				                          (uint16_t)(BL_FRAME_ALIGNED_PAD(Local_uint16FrameLength - 5u) + BL_FRAME_EXT_HEADER_LENGTH + 5u);
+			}
+			else
+			{
+				Local_uint16FrameLength = (Local_uint16FrameLength > (0xFFFFu - BL_FRAME_EXT_HEADER_LENGTH)) ?
+				                          0xFFFFu : (uint16_t)(Local_uint16FrameLength + BL_FRAME_EXT_HEADER_LENGTH);
+			}
+			Local_uint16MinLength   = BL_FRAME_EXT_MIN_LENGTH;
+		}
+		else
+		{
+			Local_uint16FrameLength = (uint16_t)uint8_LinkPeek(Copy_uint8Link, 0u) + 1u;
+		}
+
+		if((Local_uint16FrameLength < Local_uint16MinLength) || (Local_uint16FrameLength > Copy_uint16MaxLength))
+		{
+			/* Not a valid length byte: drop it and look at the next one */
+			voidLinkConsume(Copy_uint8Link, 1u);
+			Local_uint16Available--;
+#if BL_RS485_ENABLE
+			if(Copy_uint8Link == BL_LINK_UART)
+			{
+				/* The header matched by chance: back to scanning for one */
+				Global_uint8Rs485State = RS485_WAIT_HEADER;
+			}
+#endif
+			continue;
+		}
+
+		if(Local_uint16Available < Local_uint16FrameLength)
+		{
+			/* Frame still arriving */
+			(void)uint8_PartialFrameExpired(Copy_uint8Link, Local_uint16Available);
+			return 0;
+		}
+
+		Global_uint8PartialPending &= (uint8_t)~(1u << Copy_uint8Link);
+#if BL_RS485_ENABLE
+		if(Copy_uint8Link == BL_LINK_UART)
+		{
+			Global_uint8Rs485State = RS485_WAIT_HEADER;
+		}
+#endif
+
+		/* Hot path: the frame is used where it was received */
+		*Copy_ppuint8Frame = puint8_LinkPeekBuffer(Copy_uint8Link, Local_uint16FrameLength);
+		if((*Copy_ppuint8Frame != NULL) &&
+		   ((Local_uint8Marker != BL_FRAME_ALIGNED_MARKER) || (((uint32_t)*Copy_ppuint8Frame & 3u) == 0u)))
+		{
+			Global_uint16HeldLength = Local_uint16FrameLength;
+			Global_uint8HeldLink    = Copy_uint8Link;
+			return Local_uint16FrameLength;
+		}
+
+		/* Copy the complete frame out of the ring, index wraps at the end of the buffer */
+		for(Local_uint16Iterator = 0; Local_uint16Iterator < Local_uint16FrameLength; Local_uint16Iterator++)
+		{
+			Copy_puint8Buffer[Local_uint16Iterator] = uint8_LinkPeek(Copy_uint8Link, Local_uint16Iterator);
+		}
+		voidLinkConsume(Copy_uint8Link, Local_uint16FrameLength);
+		*Copy_ppuint8Frame = Copy_puint8Buffer;
+
+		return Local_uint16FrameLength;
+	}
+
+	return 0;
+}
+
+
+/*
+ * uint16_ExtractUartFrame
+ * -----------------------
+ * USART2 side of the frame queue: hands out the oldest queued frame in place,
+ * or runs uint16_ExtractFrame() when the interrupt has queued nothing.
+ * The queue stays locked meanwhile, the ring tail belongs to the parser.
+ */
+static uint16_t uint16_ExtractUartFrame(uint8_t** Copy_ppuint8Frame, uint8_t* Copy_puint8Buffer, uint16_t Copy_uint16MaxLength)
+{
+	uint16_t Local_uint16FrameLength;
+
+	Global_uint8QueueLock = 1;
+
+	if(Global_uint8QueueCount != 0u)
+	{
+		Local_uint16FrameLength = Global_FrameQueue[Global_uint8QueueHead].Length;
+		Global_uint8CheckedCrc  = Global_FrameQueue[Global_uint8QueueHead].CrcStatus;
+		Global_uint8QueueHead   = (uint8_t)((Global_uint8QueueHead + 1u) % BL_FRAME_QUEUE_DEPTH);
+		Global_uint8QueueCount--;
+
+		/* Already counted in Global_uint16QueueScanned */
+		*Copy_ppuint8Frame        = &Global_uint8RxRing[Global_uint16RxTail];
+		Global_puint8CheckedFrame = *Copy_ppuint8Frame;
+		Global_uint16HeldLength   = Local_uint16FrameLength;
+		Global_uint8HeldLink      = BL_LINK_UART;
+		Global_uint8PartialPending &= (uint8_t)~(1u << BL_LINK_UART);
+	}
+	else
+	{
+		Local_uint16FrameLength = uint16_ExtractFrame(BL_LINK_UART, Copy_ppuint8Frame, Copy_puint8Buffer, Copy_uint16MaxLength);
+		Global_uint16QueueScanned = Global_uint16HeldLength;
+	}
+
+	Global_uint8QueueLock = 0;
+
+	return Local_uint16FrameLength;
+}
+
+
+/*
+ * BL_voidTransportInit
+ * --------------------
+ * Starts USART2 reception in circular DMA mode into the RX ring, the
+ * USB device when BL_TRANSPORT_USB_ENABLE is set, the SPI1 slave when
+ * BL_TRANSPORT_SPI_ENABLE is set and CAN1 when BL_TRANSPORT_CAN_ENABLE is set.
+ * From this point on every byte sent by the host is stored, even while a
+ * command handler is busy erasing or programming flash.
+ */
+void BL_voidTransportInit(void)
+{
+#if BL_UART_FLOW_CONTROL_ENABLE
+	GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+	/* RTS asserted: the host may send */
+	HAL_GPIO_WritePin(BL_UART_RTS_PORT, BL_UART_RTS_PIN, GPIO_PIN_RESET);
+	GPIO_InitStruct.Pin = BL_UART_RTS_PIN;
+	GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+	GPIO_InitStruct.Pull = GPIO_NOPULL;
+	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+	HAL_GPIO_Init(BL_UART_RTS_PORT, &GPIO_InitStruct);
+#endif
+
+#if BL_RS485_ENABLE
+	{
+		GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+		/* DE / nRE low: receiving */
+		HAL_GPIO_WritePin(BL_RS485_DE_PORT, BL_RS485_DE_PIN, GPIO_PIN_RESET);
+		GPIO_InitStruct.Pin = BL_RS485_DE_PIN;
+		GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+		GPIO_InitStruct.Pull = GPIO_NOPULL;
+		GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+		HAL_GPIO_Init(BL_RS485_DE_PORT, &GPIO_InitStruct);
+	}
+#endif
+
+	voidStartReception();
+
+#if BL_TRANSPORT_USB_ENABLE
+	BL_voidUSBInit();
+#endif
+
+#if BL_TRANSPORT_SPI_ENABLE
+	BL_voidSPIInit();
+#endif
+
+#if BL_TRANSPORT_CAN_ENABLE
+	BL_voidCANInit();
+#endif
+}
+
+
+/*
+ * BL_uint16TransportAvailable
+ * ---------------------------
+ * Returns the number of USART2 bytes not yet consumed by the parser.
+ */
+__RAM_FUNC uint16_t BL_uint16TransportAvailable(void)
+{
+	return (uint16_t)((uint16_GetRxHead() - Global_uint16RxTail) & (BL_RX_RING_SIZE - 1u));
+}
+
+
+/*
+ * BL_uint16TransportReceiveFrame
+ * ------------------------------
+ * Blocks until one complete command frame is available and returns where it
+ * lies: in place in the link's ring (held until BL_voidTransportReleaseFrame),
+ * or in Copy_puint8Buffer when it wraps around the end of the ring.
+ *
+ * Behavior:
+ * ---------
+ * 1. Frames already sitting in the ring (host streaming back-to-back) are returned at once.
+ * 2. Otherwise waits for the next RX event (IDLE line / DMA half / DMA complete)
+ *    so a whole packet is handled with one wake-up instead of one per byte.
+ * 3. If the HAL aborted reception on a line error, reception is restarted first.
+ * 4. With USB / SPI enabled every link is polled; the one that delivered the
+ *    frame becomes the active link for the responses.
+ * 5. SPI READY is raised whenever the parser has nothing left to do.
+ *    CAN group frames are taken before CAN unicast ones, so the answer to a
+ *    unicast command tells the host every group frame before it has run.
+ * 6. Returns 0 without a frame when BL_voidTransportNotifyBackground() was
+ *    called (e.g. a background sector erase finished).
+ * 7. A frame still held from the previous call is released first.
+ * 8. An incomplete frame is discarded after BL_FRAME_TIMEOUT_MS of silence,
+ *    so a corrupted length byte costs milliseconds instead of a reset.
+ * 9. USART2 frames queued by the receive interrupt are taken first, with
+ *    their CRC status (BL_uint8TransportGetFrameCrc).
+ * 10. Once BL_voidTransportLock has picked a link, the others are skipped.
+ *
+ * Return:
+ * -------
+ * @return uint16_t : Frame length in bytes, including the "Length to Follow" byte,
+ *                    or 0 if woken for background work.
+ */
+uint16_t BL_uint16TransportReceiveFrame(uint8_t** Copy_ppuint8Frame, uint8_t* Copy_puint8Buffer, uint16_t Copy_uint16MaxLength)
+{
+	uint16_t Local_uint16FrameLength;
+
+	BL_voidTransportReleaseFrame();
+
+	/* Time spent in the handler does not count against a partial frame */
+	Global_uint8PartialPending = 0;
+
+	/* The handler may have read bytes itself (BL_uint8TransportReadByte): scan again */
+	memset(Global_uint16CobsScanned, 0, sizeof(Global_uint16CobsScanned));
+
+	while(1)
+	{
+		if((Global_uint8RxRestart != 0) && (uint8_LinkListening(BL_LINK_UART) != 0u))
+		{
+			voidStartReception();
+		}
+
+		Local_uint16FrameLength = 0;
+		if(uint8_LinkListening(BL_LINK_UART) != 0u)
+		{
+			Local_uint16FrameLength = uint16_ExtractUartFrame(Copy_ppuint8Frame, Copy_puint8Buffer, Copy_uint16MaxLength);
+		}
+		if(Local_uint16FrameLength != 0)
+		{
+			Global_uint8ActiveLink = BL_LINK_UART;
+			Global_Stats.RxBytes  += Local_uint16FrameLength;
+			BL_TRACE(BL_TRACE_FRAME_RX, Global_uint8ActiveLink, Local_uint16FrameLength);
+			return Local_uint16FrameLength;
+		}
+
+#if BL_TRANSPORT_USB_ENABLE
+		if(uint8_LinkListening(BL_LINK_USB) != 0u)
+		{
+			Local_uint16FrameLength = uint16_ExtractFrame(BL_LINK_USB, Copy_ppuint8Frame, Copy_puint8Buffer, Copy_uint16MaxLength);
+		}
+		if(Local_uint16FrameLength != 0)
+		{
+			Global_uint8ActiveLink = BL_LINK_USB;
+			Global_Stats.RxBytes  += Local_uint16FrameLength;
+			BL_TRACE(BL_TRACE_FRAME_RX, Global_uint8ActiveLink, Local_uint16FrameLength);
+			return Local_uint16FrameLength;
+		}
+#endif
+
+#if BL_TRANSPORT_SPI_ENABLE
+		if(uint8_LinkListening(BL_LINK_SPI) != 0u)
+		{
+			Local_uint16FrameLength = uint16_ExtractFrame(BL_LINK_SPI, Copy_ppuint8Frame, Copy_puint8Buffer, Copy_uint16MaxLength);
+			if(Local_uint16FrameLength != 0)
+			{
+				Global_uint8ActiveLink = BL_LINK_SPI;
+				Global_Stats.RxBytes  += Local_uint16FrameLength;
+				BL_TRACE(BL_TRACE_FRAME_RX, Global_uint8ActiveLink, Local_uint16FrameLength);
+				return Local_uint16FrameLength;
+			}
+
+			/* Nothing (complete) from the master: accept its next transfer */
+			BL_voidSPISetReady();
+		}
+#endif
+
+#if BL_TRANSPORT_CAN_ENABLE
+		if(uint8_LinkListening(BL_LINK_CAN) != 0u)
+		{
+			Local_uint16FrameLength = uint16_ExtractFrame(BL_LINK_CAN_GROUP, Copy_ppuint8Frame, Copy_puint8Buffer, Copy_uint16MaxLength);
+			if(Local_uint16FrameLength == 0)
+			{
+				Local_uint16FrameLength = uint16_ExtractFrame(BL_LINK_CAN, Copy_ppuint8Frame, Copy_puint8Buffer, Copy_uint16MaxLength);
+				Global_uint8ActiveLink  = BL_LINK_CAN;
+			}
+			else
+			{
+				Global_uint8ActiveLink  = BL_LINK_CAN_GROUP;
+			}
+			if(Local_uint16FrameLength != 0)
+			{
+				Global_Stats.RxBytes  += Local_uint16FrameLength;
+				BL_TRACE(BL_TRACE_FRAME_RX, Global_uint8ActiveLink, Local_uint16FrameLength);
+				return Local_uint16FrameLength;
+			}
+		}
+#endif
+
+		/* No frame, but background work is waiting */
+		if(Global_uint8BackgroundEvent != 0)
+		{
+			Global_uint8BackgroundEvent = 0;
+			return 0;
+		}
+
+		/* Nothing complete yet: sleep until the next reception event or a partial frame timeout */
+		while((Global_uint8RxEvent == 0) && (Global_uint8RxRestart == 0) && (Global_uint8BackgroundEvent == 0) &&
+		      (uint8_PartialFrameDue() == 0))
+		{
+			/* An idle line is progress too: the host decides when the next frame comes */
+			BL_PORT_WATCHDOG_REFRESH();
+			BL_PORT_WAIT_EVENT();
+		}
+		Global_uint8RxEvent = 0;
+	}
+}
+
+
+/*
+ * BL_voidTransportReleaseFrame
+ * ----------------------------
+ * Consumes the frame handed out in place by BL_uint16TransportReceiveFrame(),
+ * once its handler is done with it.
+ */
+void BL_voidTransportReleaseFrame(void)
+{
+	Global_puint8CheckedFrame = NULL;
+
+	if(Global_uint16HeldLength != 0)
+	{
+		Global_uint8QueueLock = 1;
+
+		voidLinkConsume(Global_uint8HeldLink, Global_uint16HeldLength);
+		if(Global_uint8HeldLink == BL_LINK_UART)
+		{
+			Global_uint16QueueScanned = (uint16_t)(Global_uint16QueueScanned - Global_uint16HeldLength);
+		}
+		Global_uint16HeldLength = 0;
+
+		Global_uint8QueueLock = 0;
+	}
+}
+
+
+/*
+ * BL_uint8TransportGetFrameCrc
+ * ----------------------------
+ * CRC status of a frame the receive interrupt has already checked: valid for
+ * the frame just handed out by BL_uint16TransportReceiveFrame() only.
+ *
+ * Return:
+ * -------
+ * @return uint8_t : BL_CRC_FRAME_OK / BL_CRC_FRAME_BAD, or BL_CRC_FRAME_UNCHECKED
+ *                   for any other frame (the caller computes the CRC itself).
+ */
+uint8_t BL_uint8TransportGetFrameCrc(const uint8_t* Copy_puint8Frame)
+{
+	if((Copy_puint8Frame == NULL) || (Copy_puint8Frame != Global_puint8CheckedFrame))
+	{
+		return BL_CRC_FRAME_UNCHECKED;
+	}
+
+	return Global_uint8CheckedCrc;
+}
+
+
+/*
+ * BL_uint8TransportReadByte
+ * -------------------------
+ * Takes one byte out of the RX ring, waiting at most Copy_uint32TimeoutMs.
+ * A held frame is released first: the byte follows it. Frames the receive
+ * interrupt had queued are parsed again afterwards.
+ *
+ * Return:
+ * -------
+ * @return uint8_t : HAL_OK if a byte was read, HAL_TIMEOUT otherwise.
+ */
+uint8_t BL_uint8TransportReadByte(uint8_t* Copy_puint8Byte, uint32_t Copy_uint32TimeoutMs)
+{
+	uint32_t Local_uint32Start = HAL_GetTick();
+	uint8_t  Local_uint8Status = HAL_OK;
+
+	BL_voidTransportReleaseFrame();
+
+	/* The byte is not a frame: nothing may be queued in front of it */
+	Global_uint8QueueLock = 1;
+	voidClearQueue();
+
+	while(BL_uint16TransportAvailable() == 0)
+	{
+		if(Global_uint8RxRestart != 0)
+		{
+			voidStartReception();
+			Global_uint8QueueLock = 1;
+		}
+
+		if((HAL_GetTick() - Local_uint32Start) >= Copy_uint32TimeoutMs)
+		{
+			Local_uint8Status = HAL_TIMEOUT;
+			break;
+		}
+
+		BL_PORT_WATCHDOG_REFRESH();
+		BL_PORT_WAIT_EVENT();
+	}
+
+	if(Local_uint8Status == HAL_OK)
+	{
+		*Copy_puint8Byte = Global_uint8RxRing[Global_uint16RxTail];
+		Global_uint16RxTail = (Global_uint16RxTail + 1u) & (BL_RX_RING_SIZE - 1u);
+		Global_Stats.RxBytes++;
+	}
+
+	Global_uint8QueueLock = 0;
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * BL_uint8TransportSetBaudRate
+ * ----------------------------
+ * Switches USART2 to a new baud rate.
+ *
+ * Behavior:
+ * ---------
+ * 1. Stops the DMA reception; unread bytes are discarded.
+ * 2. BL_uint8UARTSetBaudRate() recomputes BRR from the current PCLK1.
+ * 3. Circular reception is restarted at the new rate.
+ *
+ * NOTE: a reply still being sent is flushed first, at the old rate.
+ */
+uint8_t BL_uint8TransportSetBaudRate(uint32_t Copy_uint32BaudRate)
+{
+	uint8_t Local_uint8Status;
+
+	BL_voidTransportTxFlush();
+	BL_voidUARTStopRx();
+
+	Local_uint8Status = BL_uint8UARTSetBaudRate(Copy_uint32BaudRate);
+	BL_TRACE(BL_TRACE_BAUD_CHANGE, 0u, Copy_uint32BaudRate);
+
+	voidStartReception();
+
+	return Local_uint8Status;
+}
+
+
+/*
+ * BL_puint8TransportTxAcquire
+ * ---------------------------
+ * Returns the response buffer once the previous response has been handed to
+ * the line. Handlers only block here when they reply faster than USART2 drains.
+ */
+uint8_t* BL_puint8TransportTxAcquire(void)
+{
+	BL_voidTransportTxFlush();
+
+	return Global_uint8TxBuffer;
+}
+
+
+/*
+ * BL_uint16TransportGetRxCapacity
+ * -------------------------------
+ * Size of the receive ring of the active link: how many bytes the host may
+ * send ahead of the responses.
+ */
+uint16_t BL_uint16TransportGetRxCapacity(void)
+{
+#if BL_TRANSPORT_USB_ENABLE
+	if(Global_uint8ActiveLink == BL_LINK_USB)
+	{
+		return BL_USB_RX_RING_SIZE;
+	}
+#endif
+#if BL_TRANSPORT_SPI_ENABLE
+	if(Global_uint8ActiveLink == BL_LINK_SPI)
+	{
+		return BL_SPI_RX_RING_SIZE;
+	}
+#endif
+#if BL_TRANSPORT_CAN_ENABLE
+	if((Global_uint8ActiveLink == BL_LINK_CAN) || (Global_uint8ActiveLink == BL_LINK_CAN_GROUP))
+	{
+		return BL_CAN_RX_RING_SIZE;
+	}
+#endif
+	return BL_RX_RING_SIZE;
+}
+
+
+/*
+ * BL_voidTransportSetFraming
+ * --------------------------
+ * Selects BL_FRAMING_LENGTH or BL_FRAMING_COBS for the following frames and
+ * responses; the caller sends the reply to the switch before.
+ */
+void BL_voidTransportSetFraming(uint8_t Copy_uint8Framing)
+{
+	BL_voidTransportTxFlush();
+
+	Global_uint8QueueLock = 1;
+
+	Global_uint8Framing = Copy_uint8Framing;
+	Global_uint8PartialPending = 0;
+	memset(Global_uint16CobsScanned, 0, sizeof(Global_uint16CobsScanned));
+
+	/* Queued frames were framed the old way, only the held one stays covered */
+	voidClearQueue();
+	if((Global_uint16HeldLength != 0) && (Global_uint8HeldLink == BL_LINK_UART))
+	{
+		Global_uint16QueueScanned = Global_uint16HeldLength;
+	}
+
+	Global_uint8QueueLock = 0;
+}
+
+
+/*
+ * BL_uint8TransportGetFraming
+ * ---------------------------
+ * Framing in effect, BL_FRAMING_LENGTH or BL_FRAMING_COBS.
+ */
+uint8_t BL_uint8TransportGetFraming(void)
+{
+	return Global_uint8Framing;
+}
+
+
+/*
+ * BL_uint8TransportGetLink
+ * ------------------------
+ * Link (BL_LINK_UART / USB / SPI) of the last frame received, that is of the
+ * command being handled.
+ */
+uint8_t BL_uint8TransportGetLink(void)
+{
+	return Global_uint8ActiveLink;
+}
+
+
+/*
+ * BL_voidTransportLock
+ * --------------------
+ * Called by the command loop for every frame whose CRC checked out. The first
+ * one decides: its link is kept until reset, every other link is shut down
+ * (USART2: RX stream and interrupts off, its TX stays for the console lines;
+ * USB: soft disconnect; SPI1 / CAN1: stopped, clocks off). Later calls do
+ * nothing. The bytes a released link had buffered are never parsed.
+ * Without BL_TRANSPORT_LOCK_ENABLE, or with USART2 alone, nothing happens.
+ */
+void BL_voidTransportLock(void)
+{
+#if BL_TRANSPORT_LOCK_ENABLE && (BL_TRANSPORT_USB_ENABLE || BL_TRANSPORT_SPI_ENABLE || BL_TRANSPORT_CAN_ENABLE)
+	uint32_t Local_uint32Released = 0;
+
+	if(Global_uint8LockedLink != BL_LINK_COUNT)
+	{
+		return;
+	}
+
+	Global_uint8LockedLink = (Global_uint8ActiveLink == BL_LINK_CAN_GROUP) ? BL_LINK_CAN : Global_uint8ActiveLink;
+
+	if(Global_uint8LockedLink != BL_LINK_UART)
+	{
+		BL_voidUARTStopRx();
+		Global_uint8RxRestart = 0;
+		Local_uint32Released |= (1UL << BL_LINK_UART);
+	}
+
+#if BL_TRANSPORT_USB_ENABLE
+	if(Global_uint8LockedLink != BL_LINK_USB)
+	{
+		BL_voidUSBDeInit();
+		Local_uint32Released |= (1UL << BL_LINK_USB);
+	}
+#endif
+
+#if BL_TRANSPORT_SPI_ENABLE
+	if(Global_uint8LockedLink != BL_LINK_SPI)
+	{
+		BL_voidSPIDeInit();
+		Local_uint32Released |= (1UL << BL_LINK_SPI);
+	}
+#endif
+
+#if BL_TRANSPORT_CAN_ENABLE
+	if(Global_uint8LockedLink != BL_LINK_CAN)
+	{
+		BL_voidCANDeInit();
+		Local_uint32Released |= (1UL << BL_LINK_CAN) | (1UL << BL_LINK_CAN_GROUP);
+	}
+#endif
+
+	Global_uint8PartialPending &= (uint8_t)~Local_uint32Released;
+
+	BL_TRACE(BL_TRACE_LINK_LOCKED, Global_uint8LockedLink, Local_uint32Released);
+#endif
+}
+
+
+/*
+ * BL_voidTransportTxStart
+ * -----------------------
+ * Starts sending the first Copy_uint16Length bytes of the TX buffer by DMA.
+ * Returns at once, so the next command can be parsed while TX drains.
+ * Over USB the response is queued as one bulk IN transfer instead, over SPI
+ * it is armed in the SPI1 TX DMA for the master to read, over CAN it is cut
+ * into CAN frames by the CAN1 TX interrupt; a group command is not answered.
+ * In capture mode nothing is sent (see BL_voidTransportTxCapture); in COBS
+ * mode the response is encoded first.
+ */
+void BL_voidTransportTxStart(uint16_t Copy_uint16Length)
+{
+	if(Global_uint8TxCapture != 0)
+	{
+		Global_uint16TxCaptured = Copy_uint16Length;
+		return;
+	}
+
+#if BL_TRANSPORT_CAN_ENABLE
+	/* Every node of the group runs the command: none of them answers */
+	if(Global_uint8ActiveLink == BL_LINK_CAN_GROUP)
+	{
+		return;
+	}
+#endif
+#if BL_RS485_ENABLE
+	if(BL_uint8TransportIsBroadcast() != 0u)
+	{
+		return;
+	}
+#endif
+
+	if(Global_uint8Framing == BL_FRAMING_COBS)
+	{
+		Copy_uint16Length = uint16_CobsEncode(Copy_uint16Length);
+	}
+
+	Global_Stats.TxBytes += Copy_uint16Length;
+	BL_TRACE(BL_TRACE_TX_QUEUED, Global_uint8ActiveLink, Copy_uint16Length);
+
+#if BL_TRANSPORT_USB_ENABLE
+	if(Global_uint8ActiveLink == BL_LINK_USB)
+	{
+		BL_voidUSBTransmit(Global_uint8TxBuffer, Copy_uint16Length);
+		return;
+	}
+#endif
+#if BL_TRANSPORT_SPI_ENABLE
+	if(Global_uint8ActiveLink == BL_LINK_SPI)
+	{
+		BL_voidSPITransmit(Global_uint8TxBuffer, Copy_uint16Length);
+		return;
+	}
+#endif
+#if BL_TRANSPORT_CAN_ENABLE
+	if(Global_uint8ActiveLink == BL_LINK_CAN)
+	{
+		BL_voidCANTransmit(Global_uint8TxBuffer, Copy_uint16Length);
+		return;
+	}
+#endif
+
+	/* A progress frame may have started since TxAcquire */
+	BL_voidTransportTxFlush();
+
+#if BL_RS485_ENABLE
+	voidRs485SendHeader(Copy_uint16Length);
+#endif
+
+	BL_voidUARTTransmit(Global_uint8TxBuffer, Copy_uint16Length);
+}
+
+
+/*
+ * BL_voidTransportTxCapture
+ * -------------------------
+ * Enables / disables capture of responses in the TX buffer. Enabling it
+ * clears the captured length, so 0 afterwards means "no response".
+ */
+void BL_voidTransportTxCapture(uint8_t Copy_uint8Enable)
+{
+	Global_uint8TxCapture   = Copy_uint8Enable;
+	Global_uint16TxCaptured = 0;
+}
+
+
+/*
+ * BL_uint16TransportTxCaptured
+ * ----------------------------
+ * Length of the last response captured in the TX buffer, 0 if none.
+ */
+uint16_t BL_uint16TransportTxCaptured(void)
+{
+	return Global_uint16TxCaptured;
+}
+
+
+/*
+ * BL_voidTransportTxSendBuffer
+ * ----------------------------
+ * Sends Copy_uint16Length bytes from any DMA-readable memory (flash, SRAM1/2)
+ * once the previous transmission has been handed to the line, without copying
+ * them into the TX buffer: a response can go out in pieces, e.g. a header
+ * from the TX buffer followed by data straight from flash.
+ * The buffer must stay unchanged until the next TxAcquire / TxFlush.
+ * Not for the SPI link, where the master reads one armed buffer per response,
+ * nor in BL_FRAMING_COBS mode, where a response can only be sent whole.
+ */
+void BL_voidTransportTxSendBuffer(const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length)
+{
+	BL_voidTransportTxFlush();
+
+#if BL_TRANSPORT_CAN_ENABLE
+	if(Global_uint8ActiveLink == BL_LINK_CAN_GROUP)
+	{
+		return;
+	}
+#endif
+#if BL_RS485_ENABLE
+	if(BL_uint8TransportIsBroadcast() != 0u)
+	{
+		return;
+	}
+#endif
+
+	Global_Stats.TxBytes += Copy_uint16Length;
+	BL_TRACE(BL_TRACE_TX_QUEUED, Global_uint8ActiveLink, Copy_uint16Length);
+
+#if BL_TRANSPORT_USB_ENABLE
+	if(Global_uint8ActiveLink == BL_LINK_USB)
+	{
+		BL_voidUSBTransmit((uint8_t*)Copy_puint8Data, Copy_uint16Length);
+		return;
+	}
+#endif
+#if BL_TRANSPORT_CAN_ENABLE
+	if(Global_uint8ActiveLink == BL_LINK_CAN)
+	{
+		BL_voidCANTransmit(Copy_puint8Data, Copy_uint16Length);
+		return;
+	}
+#endif
+
+#if BL_RS485_ENABLE
+	voidRs485SendHeader(Copy_uint16Length);
+#endif
+
+	BL_voidUARTTransmit(Copy_puint8Data, Copy_uint16Length);
+}
+
+
+/*
+ * BL_voidTransportTxFlush
+ * -----------------------
+ * Waits until the running response is completely sent. BL_UART.c clears its
+ * busy flag from the TC interrupt, i.e. after the stop bit of the last byte.
+ * Needed before jumping away or changing the baud rate.
+ */
+void BL_voidTransportTxFlush(void)
+{
+	while(BL_uint8UARTTxBusy() != 0u)
+	{
+		BL_PORT_WAIT_EVENT();
+	}
+
+#if BL_TRANSPORT_USB_ENABLE
+	BL_voidUSBTxFlush();
+#endif
+
+#if BL_TRANSPORT_SPI_ENABLE
+	BL_voidSPITxFlush();
+#endif
+
+#if BL_TRANSPORT_CAN_ENABLE
+	BL_voidCANTxFlush();
+#endif
+}
+
+
+/*
+ * BL_uint8TransportTxReady
+ * ------------------------
+ * 1 when a frame sent now with BL_voidTransportTxSendBuffer goes out at once
+ * and alone: the current command came over USART2 in length framing, is not
+ * captured (BL_BATCH) nor an RS-485 broadcast, and the line is idle. For
+ * frames the host does not wait for (progress), which are better left out
+ * than allowed to hold up the command.
+ */
+uint8_t BL_uint8TransportTxReady(void)
+{
+	if((Global_uint8ActiveLink != BL_LINK_UART) || (Global_uint8Framing != BL_FRAMING_LENGTH) ||
+	   (Global_uint8TxCapture != 0) || (BL_uint8UARTTxBusy() != 0u))
+	{
+		return 0u;
+	}
+#if BL_RS485_ENABLE
+	if(BL_uint8TransportIsBroadcast() != 0u)
+	{
+		return 0u;
+	}
+#endif
+
+	return 1u;
+}
+
+
+/*
+ * BL_voidTransportSetFlashBusy
+ * ----------------------------
+ * Called around flash erase / program. With flow control enabled the host is
+ * paused for the duration, so a 2 s sector erase cannot overrun the RX ring.
+ */
+void BL_voidTransportSetFlashBusy(uint8_t Copy_uint8Busy)
+{
+	Global_uint8FlashBusy = Copy_uint8Busy;
+	voidUpdateRts();
+}
+
+
+/*
+ * BL_voidTransportCheckAhead
+ * --------------------------
+ * Called around the flash programming loop, which leaves the CRC unit alone:
+ * meanwhile the USART2 frames queued behind the current one are checked by
+ * DMA ("Frame Check By DMA" in BL_CRC.h) instead of by the CPU in the receive
+ * interrupt, so checking packet N+1 costs the programming of packet N
+ * nothing. At the end the check in flight is waited for (a few
+ * microseconds): its result is in the queue before the frame is handed out,
+ * and the unit is free again. Frames still unchecked are left to the
+ * dispatcher. Without BL_CRC_WORDWISE_ENABLE nothing changes.
+ */
+void BL_voidTransportCheckAhead(uint8_t Copy_uint8Enable)
+{
+#if BL_CRC_WORDWISE_ENABLE
+	Global_uint8QueueLock = 1;
+
+	Global_uint8CheckAhead = Copy_uint8Enable;
+	voidCheckAhead((uint8_t)(Copy_uint8Enable == 0u));
+
+	Global_uint8QueueLock = 0;
+#else
+	(void)Copy_uint8Enable;
+#endif
+}
+
+
+/*
+ * BL_voidTransportNotifyRx
+ * ------------------------
+ * Wakes the frame parser, called by links without an IDLE event
+ * (USB bulk OUT, SPI1 NSS rising edge, CAN1 FIFO).
+ */
+__RAM_FUNC void BL_voidTransportNotifyRx(void)
+{
+	Global_uint8RxEvent = 1;
+}
+
+
+/*
+ * BL_voidTransportGetStats
+ * ------------------------
+ * Copies the link counters (BL_GET_STATS).
+ */
+void BL_voidTransportGetStats(BL_TransportStats_t* Copy_pStats)
+{
+	*Copy_pStats = Global_Stats;
+}
+
+
+void BL_voidTransportClearStats(void)
+{
+	memset(&Global_Stats, 0, sizeof(Global_Stats));
+}
+
+
+/*
+ * BL_voidTransportNotifyBackground
+ * --------------------------------
+ * Makes BL_uint16TransportReceiveFrame return 0 at its next wait, so the
+ * command loop can step background work. Called from the FLASH interrupt.
+ */
+__RAM_FUNC void BL_voidTransportNotifyBackground(void)
+{
+	Global_uint8BackgroundEvent = 1;
+}
+
+
+#if BL_RS485_ENABLE
+/*
+ * BL_uint8TransportIsBroadcast
+ * ----------------------------
+ * 1 while the command being handled came over USART2 with the broadcast
+ * header: its responses are dropped.
+ */
+uint8_t BL_uint8TransportIsBroadcast(void)
+{
+	return (uint8_t)((Global_uint8ActiveLink == BL_LINK_UART) && (Global_uint8Rs485Broadcast != 0u));
+}
+
+
+/*
+ * BL_voidTransportBroadcastDone
+ * -----------------------------
+ * Called by BL_MEM_WRITE / BL_MEM_FILL once their data is written: marks the
+ * sequence number of a broadcast one, so BL_BROADCAST_STATUS leaves it out.
+ */
+void BL_voidTransportBroadcastDone(void)
+{
+	if((BL_uint8TransportIsBroadcast() != 0u) && (Global_uint16Rs485Sequence < BL_RS485_SEQUENCE_COUNT))
+	{
+		Global_uint8Rs485Done[Global_uint16Rs485Sequence / 8u] |= (uint8_t)(1u << (Global_uint16Rs485Sequence % 8u));
+	}
+}
+
+
+/*
+ * BL_uint16TransportBroadcastMissing
+ * ----------------------------------
+ * Fills Copy_puint8Bitmap with the broadcast sequence numbers below the end
+ * that did not complete (bit n set, (end + 7) / 8 bytes) and
+ * Copy_puint16Done with the number that did. Returns the end: one past the
+ * highest sequence number received; the host knows whether it sent more.
+ */
+uint16_t BL_uint16TransportBroadcastMissing(uint8_t* Copy_puint8Bitmap, uint16_t* Copy_puint16Done)
+{
+	uint16_t Local_uint16Sequence;
+	uint16_t Local_uint16Done = 0;
+
+	memset(Copy_puint8Bitmap, 0, (Global_uint16Rs485End + 7u) / 8u);
+
+	for(Local_uint16Sequence = 0; Local_uint16Sequence < Global_uint16Rs485End; Local_uint16Sequence++)
+	{
+		if((Global_uint8Rs485Done[Local_uint16Sequence / 8u] & (1u << (Local_uint16Sequence % 8u))) != 0u)
+		{
+			Local_uint16Done++;
+		}
+		else
+		{
+			Copy_puint8Bitmap[Local_uint16Sequence / 8u] |= (uint8_t)(1u << (Local_uint16Sequence % 8u));
+		}
+	}
+
+	*Copy_puint16Done = Local_uint16Done;
+
+	return Global_uint16Rs485End;
+}
+
+
+/*
+ * BL_voidTransportBroadcastClear
+ * ------------------------------
+ * Starts a new broadcast session: no sequence number received.
+ */
+void BL_voidTransportBroadcastClear(void)
+{
+	memset(Global_uint8Rs485Done, 0, sizeof(Global_uint8Rs485Done));
+	Global_uint16Rs485End = 0;
+}
+
+
+/*
+ * BL_voidTransportRs485SendSlot
+ * -----------------------------
+ * Answers a broadcast out of band (BL_DISCOVER): waits until time slot
+ * Copy_uint8Slot, Copy_uint8Slot x BL_RS485_DISCOVER_SLOT_US after the call,
+ * then sends the response header and Copy_uint16Length bytes of the TX
+ * buffer, blocking, and frees the bus again. The DWT cycle counter times
+ * the slot.
+ */
+void BL_voidTransportRs485SendSlot(uint8_t Copy_uint8Slot, uint16_t Copy_uint16Length)
+{
+	uint32_t Local_uint32Start;
+	uint32_t Local_uint32Delay = (uint32_t)Copy_uint8Slot * BL_RS485_DISCOVER_SLOT_US * (SystemCoreClock / 1000000u);
+
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	Local_uint32Start = DWT->CYCCNT;
+
+	BL_voidTransportTxFlush();
+
+	while((DWT->CYCCNT - Local_uint32Start) < Local_uint32Delay)
+	{
+	}
+
+	Global_Stats.TxBytes += Copy_uint16Length;
+	BL_TRACE(BL_TRACE_TX_QUEUED, BL_LINK_UART, Copy_uint16Length);
+
+	voidRs485SendHeader(Copy_uint16Length);
+	BL_voidUARTWrite(Global_uint8TxBuffer, Copy_uint16Length);
+	BL_RS485_DE_PORT->BSRR = (uint32_t)BL_RS485_DE_PIN << 16u;
+}
+#endif
+
+
+/*
+ * BL_voidTransportUartRxEvent
+ * ---------------------------
+ * Called by BL_UART.c on the IDLE line interrupt and on the half / full
+ * ring DMA events: queues the frames completed so far (voidQueueFrames) and
+ * wakes the parser. IDLE normally means a complete packet has arrived; the
+ * ring events pick up long streams without idle gaps.
+ * Placed in RAM (.RamFunc) together with the driver, so it keeps running
+ * while flash is being erased or programmed.
+ */
+__RAM_FUNC void BL_voidTransportUartRxEvent(void)
+{
+	voidQueueFrames();
+	Global_uint8RxEvent = 1;
+	voidUpdateRts();
+}
+
+
+/*
+ * BL_voidTransportUartTxDone
+ * --------------------------
+ * TC after the last stop bit of a DMA response: with BL_RS485_ENABLE the
+ * bus is released (DE / nRE low).
+ */
+__RAM_FUNC void BL_voidTransportUartTxDone(void)
+{
+#if BL_RS485_ENABLE
+	BL_RS485_DE_PORT->BSRR = (uint32_t)BL_RS485_DE_PIN << 16u;
+#endif
+}
+
+
+/*
+ * BL_voidTransportUartError
+ * -------------------------
+ * Counts a USART2 error event (BL_UART_ERROR_xxx, several at once possible).
+ * Only BL_UART_ERROR_DMA stops reception and needs the restart.
+ */
+__RAM_FUNC void BL_voidTransportUartError(uint32_t Copy_uint32Errors)
+{
+	if((Copy_uint32Errors & BL_UART_ERROR_DMA) != 0u)
+	{
+		Global_uint8RxRestart = 1;
+	}
+	Global_Stats.UartErrors++;
+	Global_Stats.OverrunErrors += ((Copy_uint32Errors & BL_UART_ERROR_ORE) != 0u) ? 1u : 0u;
+	Global_Stats.FramingErrors += ((Copy_uint32Errors & BL_UART_ERROR_FE) != 0u) ? 1u : 0u;
+	Global_Stats.NoiseErrors   += ((Copy_uint32Errors & BL_UART_ERROR_NE) != 0u) ? 1u : 0u;
+	Global_Stats.ParityErrors  += ((Copy_uint32Errors & BL_UART_ERROR_PE) != 0u) ? 1u : 0u;
+	Global_Stats.DmaErrors     += ((Copy_uint32Errors & BL_UART_ERROR_DMA) != 0u) ? 1u : 0u;
+	BL_TRACE(BL_TRACE_UART_ERROR, 0u, Copy_uint32Errors);
+}
@@ -0,0 +1,312 @@
+#include "main.h"
+#include "BL_UART.h"
+#include "BL_Transport.h"
+
+
+extern UART_HandleTypeDef huart2;
+
+/* DMA1 Stream5 / Stream6 flags, in HISR / HIFCR */
+#define UART_DMA_RX_FLAGS            (DMA_HIFCR_CTCIF5 | DMA_HIFCR_CHTIF5 | DMA_HIFCR_CTEIF5 | DMA_HIFCR_CDMEIF5 | DMA_HIFCR_CFEIF5)
+#define UART_DMA_TX_FLAGS            (DMA_HIFCR_CTCIF6 | DMA_HIFCR_CHTIF6 | DMA_HIFCR_CTEIF6 | DMA_HIFCR_CDMEIF6 | DMA_HIFCR_CFEIF6)
+
+/* Channel 4, byte transfers, memory increment; RX circular at high priority */
+#define UART_DMA_RX_CR               (DMA_SxCR_CHSEL_2 | DMA_SxCR_PL_1 | DMA_SxCR_MINC | DMA_SxCR_CIRC | \
+                                      DMA_SxCR_HTIE | DMA_SxCR_TCIE | DMA_SxCR_TEIE)
+#define UART_DMA_TX_CR               (DMA_SxCR_CHSEL_2 | DMA_SxCR_MINC | DMA_SxCR_DIR_0 | DMA_SxCR_TCIE | DMA_SxCR_TEIE)
+
+#define UART_SR_ERRORS               (USART_SR_PE | USART_SR_FE | USART_SR_NE | USART_SR_ORE)
+
+/* Set by BL_voidUARTTransmit, cleared by the USART TC interrupt after the last stop bit */
+static volatile uint8_t Global_uint8TxBusy;
+
+
+/*
+ * voidStopStream
+ * --------------
+ * Disables a DMA stream and waits for it to finish its current beat: its
+ * registers only take new values with EN read back as 0.
+ */
+__RAM_FUNC static void voidStopStream(DMA_Stream_TypeDef* Copy_pStream)
+{
+	Copy_pStream->CR &= ~DMA_SxCR_EN;
+	while((Copy_pStream->CR & DMA_SxCR_EN) != 0u)
+	{
+	}
+}
+
+
+/*
+ * uint32_TakeErrors
+ * -----------------
+ * The line error flags of an SR value, as BL_UART_ERROR_xxx. The flags clear
+ * with the SR read that sampled them followed by a DR read; those that come
+ * with IDLE clear with it.
+ */
+__RAM_FUNC static uint32_t uint32_TakeErrors(uint32_t Copy_uint32Status)
+{
+	uint32_t Local_uint32Errors = 0u;
+
+	Local_uint32Errors |= ((Copy_uint32Status & USART_SR_PE)  != 0u) ? BL_UART_ERROR_PE  : 0u;
+	Local_uint32Errors |= ((Copy_uint32Status & USART_SR_NE)  != 0u) ? BL_UART_ERROR_NE  : 0u;
+	Local_uint32Errors |= ((Copy_uint32Status & USART_SR_FE)  != 0u) ? BL_UART_ERROR_FE  : 0u;
+	Local_uint32Errors |= ((Copy_uint32Status & USART_SR_ORE) != 0u) ? BL_UART_ERROR_ORE : 0u;
+
+	return Local_uint32Errors;
+}
+
+
+/*
+ * BL_voidUARTStartRx
+ * ------------------
+ * (Re)starts reception at the beginning of Copy_puint8Ring: Stream5 in
+ * circular mode with the half / full ring and transfer error interrupts,
+ * then DMAR, the IDLE interrupt and the error interrupts (EIE for framing,
+ * noise and overrun in DMA mode, PEIE for parity). Stale flags, and the
+ * byte that may wait in DR, are dropped first.
+ */
+void BL_voidUARTStartRx(uint8_t* Copy_puint8Ring, uint16_t Copy_uint16Size)
+{
+	BL_voidUARTStopRx();
+
+	DMA1->HIFCR = UART_DMA_RX_FLAGS;
+	DMA1_Stream5->PAR  = (uint32_t)&USART2->DR;
+	DMA1_Stream5->M0AR = (uint32_t)Copy_puint8Ring;
+	DMA1_Stream5->NDTR = Copy_uint16Size;
+	DMA1_Stream5->FCR  = 0u;                          /* Direct mode */
+	DMA1_Stream5->CR   = UART_DMA_RX_CR;
+
+	(void)USART2->SR;
+	(void)USART2->DR;
+
+	DMA1_Stream5->CR |= DMA_SxCR_EN;
+	USART2->CR3 |= USART_CR3_DMAR | USART_CR3_EIE;
+	USART2->CR1 |= USART_CR1_IDLEIE | USART_CR1_PEIE;
+}
+
+
+/*
+ * BL_voidUARTStopRx
+ * -----------------
+ * Reception off: the interrupts first, so none fires for a stopped stream.
+ */
+void BL_voidUARTStopRx(void)
+{
+	USART2->CR1 &= ~(USART_CR1_IDLEIE | USART_CR1_PEIE);
+	USART2->CR3 &= ~(USART_CR3_DMAR | USART_CR3_EIE);
+	voidStopStream(DMA1_Stream5);
+	DMA1->HIFCR = UART_DMA_RX_FLAGS;
+}
+
+
+/*
+ * BL_uint16UARTRxRemaining
+ * ------------------------
+ * NDTR of the RX stream: counts down from the ring size to 1 and reloads
+ * in circular mode, so the DMA writes at size - NDTR next.
+ */
+__RAM_FUNC uint16_t BL_uint16UARTRxRemaining(void)
+{
+	return (uint16_t)DMA1_Stream5->NDTR;
+}
+
+
+/*
+ * BL_voidUARTTransmit
+ * -------------------
+ * Sends Copy_uint16Length bytes from DMA-readable memory (not CCMRAM) in one
+ * Stream6 transfer and returns. The caller waits for BL_uint8UARTTxBusy to
+ * drop before the next one and leaves the bytes alone until then.
+ */
+void BL_voidUARTTransmit(const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length)
+{
+	if(Copy_uint16Length == 0u)
+	{
+		return;
+	}
+
+	voidStopStream(DMA1_Stream6);
+	DMA1->HIFCR = UART_DMA_TX_FLAGS;
+	DMA1_Stream6->PAR  = (uint32_t)&USART2->DR;
+	DMA1_Stream6->M0AR = (uint32_t)Copy_puint8Data;
+	DMA1_Stream6->NDTR = Copy_uint16Length;
+	DMA1_Stream6->FCR  = 0u;
+	DMA1_Stream6->CR   = UART_DMA_TX_CR;
+
+	Global_uint8TxBusy = 1u;
+	USART2->SR   = (uint32_t)~USART_SR_TC;                       /* rc_w0: only TC is cleared */
+	USART2->CR3 |= USART_CR3_DMAT;
+	DMA1_Stream6->CR |= DMA_SxCR_EN;
+}
+
+
+/*
+ * BL_voidUARTWrite
+ * ----------------
+ * Polled transmission, for the few bytes sent outside a DMA transfer
+ * (RS-485 headers and slots, benchmark lines). Waits for a running DMA
+ * transfer first and returns once the last stop bit has left the line.
+ */
+void BL_voidUARTWrite(const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length)
+{
+	uint16_t Local_uint16Iterator;
+
+	while(Global_uint8TxBusy != 0u)
+	{
+	}
+
+	for(Local_uint16Iterator = 0; Local_uint16Iterator < Copy_uint16Length; Local_uint16Iterator++)
+	{
+		while((USART2->SR & USART_SR_TXE) == 0u)
+		{
+		}
+		USART2->DR = Copy_puint8Data[Local_uint16Iterator];
+	}
+
+	while((USART2->SR & USART_SR_TC) == 0u)
+	{
+	}
+}
+
+
+__RAM_FUNC uint8_t BL_uint8UARTTxBusy(void)
+{
+	return Global_uint8TxBusy;
+}
+
+
+/*
+ * BL_uint8UARTSetBaudRate
+ * -----------------------
+ * Reprograms BRR (oversampling by 16) for Copy_uint32BaudRate from the
+ * current PCLK1, with the USART disabled meanwhile; the streams are left as
+ * they are. Nothing may be on the line: the caller flushes and stops
+ * reception first. huart2.Init.BaudRate keeps the rate in use (loader
+ * handoff).
+ *
+ * Return:
+ * -------
+ * @return uint8_t : 0 (HAL_OK) if done, 1 if the rate cannot be divided down to.
+ */
+uint8_t BL_uint8UARTSetBaudRate(uint32_t Copy_uint32BaudRate)
+{
+	uint32_t Local_uint32Pclk = HAL_RCC_GetPCLK1Freq();
+	uint32_t Local_uint32Brr;
+
+	if((Copy_uint32BaudRate == 0u) || (Copy_uint32BaudRate > (Local_uint32Pclk / 16u)))
+	{
+		return 1u;
+	}
+
+	Local_uint32Brr = UART_BRR_SAMPLING16(Local_uint32Pclk, Copy_uint32BaudRate);
+	if(Local_uint32Brr > 0xFFFFu)
+	{
+		return 1u;
+	}
+
+	USART2->CR1 &= ~USART_CR1_UE;
+	USART2->BRR  = Local_uint32Brr;
+	USART2->CR1 |= USART_CR1_UE;
+
+	huart2.Init.BaudRate = Copy_uint32BaudRate;
+
+	return 0u;
+}
+
+
+/*
+ * BL_voidUARTStop
+ * ---------------
+ * Before handing over to a loader: no transfer or interrupt of the
+ * bootloader's is left running, the line keeps its rate and format.
+ */
+void BL_voidUARTStop(void)
+{
+	BL_voidUARTStopRx();
+
+	USART2->CR1 &= ~USART_CR1_TCIE;
+	USART2->CR3 &= ~USART_CR3_DMAT;
+	voidStopStream(DMA1_Stream6);
+	DMA1->HIFCR = UART_DMA_TX_FLAGS;
+	Global_uint8TxBusy = 0u;
+}
+
+
+/*
+ * BL_voidUARTIRQHandler
+ * ---------------------
+ * USART2: one SR sample for every source.
+ * 1. Line errors are reported and cleared with the DR read IDLE needs as
+ *    well; the DMA keeps running.
+ * 2. IDLE: the line went quiet, normally after a complete frame.
+ * 3. TC with TCIE: the response's last stop bit is out.
+ */
+__RAM_FUNC void BL_voidUARTIRQHandler(void)
+{
+	uint32_t Local_uint32Status = USART2->SR;
+	uint32_t Local_uint32Errors;
+
+	if((Local_uint32Status & (UART_SR_ERRORS | USART_SR_IDLE)) != 0u)
+	{
+		(void)USART2->DR;
+
+		Local_uint32Errors = uint32_TakeErrors(Local_uint32Status);
+		if(Local_uint32Errors != 0u)
+		{
+			BL_voidTransportUartError(Local_uint32Errors);
+		}
+		if((Local_uint32Status & USART_SR_IDLE) != 0u)
+		{
+			BL_voidTransportUartRxEvent();
+		}
+	}
+
+	if(((Local_uint32Status & USART_SR_TC) != 0u) && ((USART2->CR1 & USART_CR1_TCIE) != 0u))
+	{
+		USART2->CR1 &= ~USART_CR1_TCIE;
+		USART2->CR3 &= ~USART_CR3_DMAT;
+		Global_uint8TxBusy = 0u;
+		BL_voidTransportUartTxDone();
+	}
+}
+
+
+/*
+ * BL_voidUARTRxDmaIRQHandler
+ * --------------------------
+ * Stream5: half and full ring mean more data, like IDLE. A transfer error
+ * has stopped the stream; the transport restarts reception.
+ */
+__RAM_FUNC void BL_voidUARTRxDmaIRQHandler(void)
+{
+	uint32_t Local_uint32Flags = DMA1->HISR & UART_DMA_RX_FLAGS;
+
+	DMA1->HIFCR = Local_uint32Flags;
+
+	if((Local_uint32Flags & DMA_HISR_TEIF5) != 0u)
+	{
+		BL_voidTransportUartError(BL_UART_ERROR_DMA);
+	}
+	if((Local_uint32Flags & (DMA_HISR_HTIF5 | DMA_HISR_TCIF5)) != 0u)
+	{
+		BL_voidTransportUartRxEvent();
+	}
+}
+
+
+/*
+ * BL_voidUARTTxDmaIRQHandler
+ * --------------------------
+ * Stream6: the last byte is in the USART (or a transfer error ended the
+ * transfer early); its TC interrupt takes over from here.
+ */
+__RAM_FUNC void BL_voidUARTTxDmaIRQHandler(void)
+{
+	uint32_t Local_uint32Flags = DMA1->HISR & UART_DMA_TX_FLAGS;
+
+	DMA1->HIFCR = Local_uint32Flags;
+
+	if((Local_uint32Flags & (DMA_HISR_TCIF6 | DMA_HISR_TEIF6)) != 0u)
+	{
+		USART2->CR1 |= USART_CR1_TCIE;
+	}
+}
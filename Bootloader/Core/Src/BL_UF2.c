@@ -0,0 +1,760 @@
+#include <string.h>
+#include "main.h"
+
+#if BL_USB_MSC_ENABLE
+
+#include "BL.h"
+#include "BL_Image.h"
+#include "BL_UF2.h"
+#include "BL_USB.h"
+
+
+/* Bulk-only transport wrappers */
+#define UF2_CBW_SIGNATURE            0x43425355UL   /* "USBC" */
+#define UF2_CSW_SIGNATURE            0x53425355UL   /* "USBS" */
+#define UF2_CBW_LENGTH               31u
+#define UF2_CSW_LENGTH               13u
+#define UF2_CBW_FLAG_IN              0x80u
+
+#define UF2_CSW_PASSED               0x00u
+#define UF2_CSW_FAILED               0x01u
+
+/* SCSI operation codes */
+#define UF2_SCSI_TEST_UNIT_READY     0x00u
+#define UF2_SCSI_REQUEST_SENSE       0x03u
+#define UF2_SCSI_INQUIRY             0x12u
+#define UF2_SCSI_MODE_SENSE6         0x1Au
+#define UF2_SCSI_START_STOP_UNIT     0x1Bu
+#define UF2_SCSI_PREVENT_REMOVAL     0x1Eu
+#define UF2_SCSI_READ_FORMAT_CAPS    0x23u
+#define UF2_SCSI_READ_CAPACITY10     0x25u
+#define UF2_SCSI_READ10              0x28u
+#define UF2_SCSI_WRITE10             0x2Au
+#define UF2_SCSI_VERIFY10            0x2Fu
+#define UF2_SCSI_SYNC_CACHE10        0x35u
+#define UF2_SCSI_MODE_SENSE10        0x5Au
+
+/* Sense keys / additional sense codes */
+#define UF2_SENSE_ILLEGAL_REQUEST    0x05u
+#define UF2_ASC_INVALID_COMMAND      0x20u
+#define UF2_ASC_LBA_OUT_OF_RANGE     0x21u
+#define UF2_ASC_INVALID_FIELD        0x24u
+
+/*
+ * Volume layout
+ * -------------
+ * Sector 0 boot sector, two FATs, a 64-entry root directory, then the
+ * clusters (one sector each) from cluster 2 on.
+ */
+#define UF2_SECTOR_SIZE              512u
+#define UF2_FAT_SECTORS              ((BL_UF2_VOLUME_SECTORS * 2u + UF2_SECTOR_SIZE - 1u) / UF2_SECTOR_SIZE)
+#define UF2_ROOT_ENTRIES             64u
+#define UF2_ROOT_SECTORS             ((UF2_ROOT_ENTRIES * 32u) / UF2_SECTOR_SIZE)
+#define UF2_FAT0_START               1u
+#define UF2_FAT1_START               (UF2_FAT0_START + UF2_FAT_SECTORS)
+#define UF2_ROOT_START               (UF2_FAT1_START + UF2_FAT_SECTORS)
+#define UF2_DATA_START               (UF2_ROOT_START + UF2_ROOT_SECTORS)
+
+#define UF2_CURRENT_BLOCKS           ((BL_UF2_FLASH_END - BL_UF2_FLASH_BASE) / BL_UF2_PAYLOAD_SIZE)
+
+/* FAT date of the files: 2024-01-01 */
+#define UF2_FILE_DATE                ((44u << 9) | (1u << 5) | 1u)
+
+#define UF2_ATTR_READ_ONLY           0x01u
+#define UF2_ATTR_VOLUME_ID           0x08u
+
+/* Bulk-only transport state */
+#define UF2_STATE_COMMAND            0u      /* Waiting for a command block wrapper */
+#define UF2_STATE_DATA_OUT           1u      /* WRITE(10) sectors to come */
+#define UF2_STATE_DISCARD            2u      /* Data of a refused command to drop */
+#define UF2_STATE_STATUS             3u      /* Status wrapper waits for the bulk IN halt to clear */
+
+typedef struct
+{
+	char        Name[11];                       /* 8.3, space padded */
+	const char* Content;                        /* NULL: CURRENT.UF2, generated from flash */
+	uint32_t    Size;
+	uint16_t    FirstCluster;
+} UF2File_t;
+
+static const char Global_charInfo[] =
+	"UF2 Bootloader 1.0\r\n"
+	"Model: STM32F407 UART Bootloader\r\n"
+	"Board-ID: STM32F407VG-Discovery\r\n";
+
+/* Clusters follow each other: a file starts after the last sector of the previous one */
+static const UF2File_t Global_Files[] =
+{
+	{ "INFO_UF2TXT", Global_charInfo, sizeof(Global_charInfo) - 1u,                    2u },
+	{ "CURRENT UF2", NULL,            UF2_CURRENT_BLOCKS * BL_UF2_BLOCK_SIZE,          3u },
+};
+
+#define UF2_FILE_COUNT               (sizeof(Global_Files) / sizeof(Global_Files[0]))
+
+/* BIOS parameter block of the boot sector, bytes 0..61 */
+static const uint8_t Global_uint8BootSector[62] =
+{
+	0xEBu, 0x3Cu, 0x90u,                                        /* Jump */
+	'U', 'F', '2', ' ', 'U', 'F', '2', ' ',                     /* OEM name */
+	(uint8_t)UF2_SECTOR_SIZE, (uint8_t)(UF2_SECTOR_SIZE >> 8),  /* Bytes per sector */
+	1u,                                                         /* Sectors per cluster */
+	1u, 0u,                                                     /* Reserved sectors */
+	2u,                                                         /* FATs */
+	(uint8_t)UF2_ROOT_ENTRIES, (uint8_t)(UF2_ROOT_ENTRIES >> 8),
+	(uint8_t)BL_UF2_VOLUME_SECTORS, (uint8_t)(BL_UF2_VOLUME_SECTORS >> 8),
+	0xF8u,                                                      /* Fixed disk */
+	(uint8_t)UF2_FAT_SECTORS, (uint8_t)(UF2_FAT_SECTORS >> 8),
+	1u, 0u, 1u, 0u,                                             /* Sectors per track, heads */
+	0u, 0u, 0u, 0u,                                             /* Hidden sectors */
+	0u, 0u, 0u, 0u,                                             /* 32-bit sector count, unused */
+	0x80u, 0u, 0x29u,                                           /* Drive number, extended signature */
+	0x42u, 0x4Cu, 0x46u, 0x32u,                                 /* Volume serial */
+	'S', 'T', 'M', '3', '2', 'F', '4', 'B', 'O', 'O', 'T',      /* Volume label */
+	'F', 'A', 'T', '1', '6', ' ', ' ', ' '
+};
+
+/* Last sector of the volume, big endian in READ CAPACITY */
+#define UF2_LAST_LBA                 (BL_UF2_VOLUME_SECTORS - 1u)
+
+/* One sector: generated for READ(10), received for WRITE(10) */
+static uint8_t  Global_uint8Sector[UF2_SECTOR_SIZE] __attribute__((aligned(4))) BL_CCMRAM_BUDGET("staging");
+
+/* Command block wrapper fields of the command being served */
+static uint32_t Global_uint32Tag;
+static uint32_t Global_uint32DataLength;
+static uint32_t Global_uint32Residue;
+static uint8_t  Global_uint8Status;
+static uint8_t  Global_uint8State = UF2_STATE_COMMAND;
+
+/* WRITE(10) bytes still to receive / bytes of a refused command still to drop */
+static uint32_t Global_uint32OutRemaining;
+
+/* Sense data of the last failed command, for REQUEST SENSE */
+static uint8_t  Global_uint8SenseKey;
+static uint8_t  Global_uint8SenseCode;
+
+/*
+ * File being received
+ * -------------------
+ * Global_uint32NumBlocks  : Block count of the file, 0 while none is open.
+ * Global_uint32Received   : Distinct block numbers seen.
+ * Global_uint8Refused     : A block was refused or failed to program.
+ * Global_uint8ResetPending: File complete and programmed, reset after the status.
+ * Global_uint8Seen        : Bit n set, block n already handled.
+ */
+static uint32_t Global_uint32NumBlocks;
+static uint32_t Global_uint32Received;
+static uint8_t  Global_uint8Refused;
+static uint8_t  Global_uint8ResetPending;
+static uint8_t  Global_uint8Seen[BL_UF2_MAX_BLOCKS / 8u];
+
+/* Status wrapper, sent once the data phase is over */
+static uint8_t  Global_uint8Csw[UF2_CSW_LENGTH] __attribute__((aligned(4)));
+
+
+static void voidPutBE32(uint8_t* Copy_puint8Out, uint32_t Copy_uint32Value)
+{
+	Copy_puint8Out[0] = (uint8_t)(Copy_uint32Value >> 24);
+	Copy_puint8Out[1] = (uint8_t)(Copy_uint32Value >> 16);
+	Copy_puint8Out[2] = (uint8_t)(Copy_uint32Value >> 8);
+	Copy_puint8Out[3] = (uint8_t)Copy_uint32Value;
+}
+
+
+static uint32_t uint32_GetBE32(const uint8_t* Copy_puint8In)
+{
+	return ((uint32_t)Copy_puint8In[0] << 24) | ((uint32_t)Copy_puint8In[1] << 16) |
+	       ((uint32_t)Copy_puint8In[2] << 8)  |  (uint32_t)Copy_puint8In[3];
+}
+
+
+/* Number of clusters (sectors) a file occupies, at least one */
+static uint16_t uint16_FileClusters(const UF2File_t* Copy_pFile)
+{
+	return (uint16_t)((Copy_pFile->Size == 0u) ? 1u : ((Copy_pFile->Size + UF2_SECTOR_SIZE - 1u) / UF2_SECTOR_SIZE));
+}
+
+
+/* File holding a cluster, NULL for a free one */
+static const UF2File_t* pFile_LookupCluster(uint32_t Copy_uint32Cluster)
+{
+	uint8_t Local_uint8File;
+
+	for(Local_uint8File = 0; Local_uint8File < UF2_FILE_COUNT; Local_uint8File++)
+	{
+		if((Copy_uint32Cluster >= Global_Files[Local_uint8File].FirstCluster) &&
+		   (Copy_uint32Cluster <  (uint32_t)Global_Files[Local_uint8File].FirstCluster + uint16_FileClusters(&Global_Files[Local_uint8File])))
+		{
+			return &Global_Files[Local_uint8File];
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ * voidBuildCurrentBlock
+ * ---------------------
+ * Block n of CURRENT.UF2: BL_UF2_PAYLOAD_SIZE bytes of flash from
+ * BL_UF2_FLASH_BASE + n * BL_UF2_PAYLOAD_SIZE, tagged with the family ID,
+ * so the file copied off one board programs another.
+ */
+static void voidBuildCurrentBlock(uint32_t Copy_uint32Block, uint8_t* Copy_puint8Out)
+{
+	BL_UF2Block_t* Local_pBlock = (BL_UF2Block_t*)Copy_puint8Out;
+
+	Local_pBlock->MagicStart0 = BL_UF2_MAGIC_START0;
+	Local_pBlock->MagicStart1 = BL_UF2_MAGIC_START1;
+	Local_pBlock->Flags       = BL_UF2_FLAG_FAMILY_ID;
+	Local_pBlock->TargetAddr  = BL_UF2_FLASH_BASE + (Copy_uint32Block * BL_UF2_PAYLOAD_SIZE);
+	Local_pBlock->PayloadSize = BL_UF2_PAYLOAD_SIZE;
+	Local_pBlock->BlockNo     = Copy_uint32Block;
+	Local_pBlock->NumBlocks   = UF2_CURRENT_BLOCKS;
+	Local_pBlock->FamilyId    = BL_UF2_FAMILY_STM32F407;
+	memcpy(Local_pBlock->Data, (const uint8_t*)Local_pBlock->TargetAddr, BL_UF2_PAYLOAD_SIZE);
+	Local_pBlock->MagicEnd    = BL_UF2_MAGIC_END;
+}
+
+
+/*
+ * voidReadSector
+ * --------------
+ * Generates one sector of the virtual volume into Copy_puint8Out. Anything
+ * not described below (free clusters, the end of the root directory) reads
+ * as zeros.
+ */
+static void voidReadSector(uint32_t Copy_uint32Lba, uint8_t* Copy_puint8Out)
+{
+	uint32_t Local_uint32Entry;
+	uint16_t Local_uint16Iterator;
+	uint8_t  Local_uint8File;
+	const UF2File_t* Local_pFile;
+
+	memset(Copy_puint8Out, 0, UF2_SECTOR_SIZE);
+
+	if(Copy_uint32Lba == 0u)
+	{
+		memcpy(Copy_puint8Out, Global_uint8BootSector, sizeof(Global_uint8BootSector));
+		Copy_puint8Out[510] = 0x55u;
+		Copy_puint8Out[511] = 0xAAu;
+	}
+	else if(Copy_uint32Lba < UF2_ROOT_START)
+	{
+		/* Either FAT: 256 16-bit entries per sector, every file one chain of consecutive clusters */
+		Local_uint32Entry = ((Copy_uint32Lba - UF2_FAT0_START) % UF2_FAT_SECTORS) * (UF2_SECTOR_SIZE / 2u);
+
+		for(Local_uint16Iterator = 0; Local_uint16Iterator < (UF2_SECTOR_SIZE / 2u); Local_uint16Iterator++, Local_uint32Entry++)
+		{
+			uint16_t Local_uint16Next = 0u;
+
+			if(Local_uint32Entry < 2u)
+			{
+				Local_uint16Next = (Local_uint32Entry == 0u) ? 0xFFF8u : 0xFFFFu;
+			}
+			else
+			{
+				Local_pFile = pFile_LookupCluster(Local_uint32Entry);
+
+				if(Local_pFile != NULL)
+				{
+					Local_uint16Next = (Local_uint32Entry == ((uint32_t)Local_pFile->FirstCluster + uint16_FileClusters(Local_pFile) - 1u)) ?
+					                   0xFFFFu : (uint16_t)(Local_uint32Entry + 1u);
+				}
+			}
+
+			Copy_puint8Out[Local_uint16Iterator * 2u]      = (uint8_t)Local_uint16Next;
+			Copy_puint8Out[Local_uint16Iterator * 2u + 1u] = (uint8_t)(Local_uint16Next >> 8);
+		}
+	}
+	else if(Copy_uint32Lba == UF2_ROOT_START)
+	{
+		/* Volume label, then one 32-byte entry per file */
+		memcpy(Copy_puint8Out, &Global_uint8BootSector[43], 11u);
+		Copy_puint8Out[11] = UF2_ATTR_VOLUME_ID;
+
+		for(Local_uint8File = 0; Local_uint8File < UF2_FILE_COUNT; Local_uint8File++)
+		{
+			uint8_t* Local_puint8Entry = &Copy_puint8Out[(Local_uint8File + 1u) * 32u];
+
+			memcpy(Local_puint8Entry, Global_Files[Local_uint8File].Name, 11u);
+			Local_puint8Entry[11] = UF2_ATTR_READ_ONLY;
+			Local_puint8Entry[16] = (uint8_t)UF2_FILE_DATE;          /* Creation date */
+			Local_puint8Entry[17] = (uint8_t)(UF2_FILE_DATE >> 8);
+			Local_puint8Entry[18] = (uint8_t)UF2_FILE_DATE;          /* Last access */
+			Local_puint8Entry[19] = (uint8_t)(UF2_FILE_DATE >> 8);
+			Local_puint8Entry[24] = (uint8_t)UF2_FILE_DATE;          /* Modification */
+			Local_puint8Entry[25] = (uint8_t)(UF2_FILE_DATE >> 8);
+			Local_puint8Entry[26] = (uint8_t)Global_Files[Local_uint8File].FirstCluster;
+			Local_puint8Entry[27] = (uint8_t)(Global_Files[Local_uint8File].FirstCluster >> 8);
+			memcpy(&Local_puint8Entry[28], &Global_Files[Local_uint8File].Size, 4u);
+		}
+	}
+	else if(Copy_uint32Lba >= UF2_DATA_START)
+	{
+		uint32_t Local_uint32Cluster = Copy_uint32Lba - UF2_DATA_START + 2u;
+
+		Local_pFile = pFile_LookupCluster(Local_uint32Cluster);
+
+		if((Local_pFile != NULL) && (Local_pFile->Content == NULL))
+		{
+			voidBuildCurrentBlock(Local_uint32Cluster - Local_pFile->FirstCluster, Copy_puint8Out);
+		}
+		else if(Local_pFile != NULL)
+		{
+			uint32_t Local_uint32Offset = (Local_uint32Cluster - Local_pFile->FirstCluster) * UF2_SECTOR_SIZE;
+			uint32_t Local_uint32Length = Local_pFile->Size - Local_uint32Offset;
+
+			memcpy(Copy_puint8Out, &Local_pFile->Content[Local_uint32Offset],
+			       (Local_uint32Length < UF2_SECTOR_SIZE) ? Local_uint32Length : UF2_SECTOR_SIZE);
+		}
+		else
+		{
+			/* Free cluster */
+		}
+	}
+	else
+	{
+		/* Rest of the root directory */
+	}
+}
+
+
+/*
+ * voidHandleBlock
+ * ---------------
+ * One sector written by the host. Only UF2 blocks of this family for the
+ * application flash are programmed (see BL_UF2.h for the sequence).
+ */
+static void voidHandleBlock(const uint8_t* Copy_puint8Sector)
+{
+	const BL_UF2Block_t* Local_pBlock = (const BL_UF2Block_t*)Copy_puint8Sector;
+	uint8_t Local_uint8Bit;
+
+	if((Local_pBlock->MagicStart0 != BL_UF2_MAGIC_START0) || (Local_pBlock->MagicStart1 != BL_UF2_MAGIC_START1) ||
+	   (Local_pBlock->MagicEnd != BL_UF2_MAGIC_END))
+	{
+		/* FAT, directory or another file: not ours to look at */
+		return;
+	}
+
+	if((Local_pBlock->NumBlocks == 0u) || (Local_pBlock->NumBlocks > BL_UF2_MAX_BLOCKS) ||
+	   (Local_pBlock->BlockNo >= Local_pBlock->NumBlocks))
+	{
+		return;
+	}
+
+	if(Local_pBlock->NumBlocks != Global_uint32NumBlocks)
+	{
+		/* First block of a new file */
+		memset(Global_uint8Seen, 0, sizeof(Global_uint8Seen));
+		Global_uint32NumBlocks = Local_pBlock->NumBlocks;
+		Global_uint32Received  = 0;
+		Global_uint8Refused    = (BL_uint8ProgramOpen() == HAL_OK) ? 0u : 1u;
+	}
+
+	Local_uint8Bit = (uint8_t)(1u << (Local_pBlock->BlockNo & 7u));
+
+	if((Global_uint8Seen[Local_pBlock->BlockNo >> 3] & Local_uint8Bit) != 0u)
+	{
+		/* Written already */
+		return;
+	}
+
+	Global_uint8Seen[Local_pBlock->BlockNo >> 3] |= Local_uint8Bit;
+	Global_uint32Received++;
+
+	if(((Local_pBlock->Flags & BL_UF2_FLAG_NOT_MAIN_FLASH) != 0u) ||
+	   (((Local_pBlock->Flags & BL_UF2_FLAG_FAMILY_ID) != 0u) &&
+	    (Local_pBlock->FamilyId != BL_UF2_FAMILY_STM32F407) && (Local_pBlock->FamilyId != BL_UF2_FAMILY_STM32F407VG)) ||
+	   (Local_pBlock->PayloadSize == 0u) || (Local_pBlock->PayloadSize > BL_UF2_DATA_SIZE) ||
+	   (Local_pBlock->TargetAddr < BL_UF2_FLASH_BASE) ||
+	   (Local_pBlock->TargetAddr > (BL_UF2_FLASH_END - Local_pBlock->PayloadSize)))
+	{
+		Global_uint8Refused = 1u;
+	}
+	else if(BL_uint8ProgramWrite(Local_pBlock->TargetAddr, (uint8_t*)Local_pBlock->Data, (uint16_t)Local_pBlock->PayloadSize) != HAL_OK)
+	{
+		Global_uint8Refused = 1u;
+	}
+	else
+	{
+		/* Programmed */
+	}
+
+	if(Global_uint32Received == Global_uint32NumBlocks)
+	{
+		if((BL_uint8ProgramClose() == HAL_OK) && (Global_uint8Refused == 0u))
+		{
+			Global_uint8ResetPending = 1u;
+		}
+
+		/* The same file copied again is a new file */
+		Global_uint32NumBlocks = 0;
+	}
+}
+
+
+/* Records why the command failed, for the REQUEST SENSE that follows */
+static void voidFail(uint8_t Copy_uint8SenseKey, uint8_t Copy_uint8SenseCode)
+{
+	Global_uint8Status    = UF2_CSW_FAILED;
+	Global_uint8SenseKey  = Copy_uint8SenseKey;
+	Global_uint8SenseCode = Copy_uint8SenseCode;
+}
+
+
+/*
+ * voidDataIn
+ * ----------
+ * Sends a command's data, at most what the host asked for. Sending less
+ * than that halts bulk IN (bulk-only transport case 5), the status wrapper
+ * with the residue waits for the host to clear it.
+ */
+static void voidDataIn(uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length)
+{
+	if(Copy_uint32Length > Global_uint32Residue)
+	{
+		Copy_uint32Length = Global_uint32Residue;
+	}
+
+	if(Copy_uint32Length != 0u)
+	{
+		BL_voidUSBTransmit(Copy_puint8Data, (uint16_t)Copy_uint32Length);
+		Global_uint32Residue -= Copy_uint32Length;
+	}
+}
+
+
+/*
+ * voidFinishCommand
+ * -----------------
+ * Ends the data phase: whatever the device did not take (OUT) is dropped,
+ * whatever it did not send (IN) halts the pipe; then the status wrapper.
+ */
+static void voidFinishCommand(uint8_t Copy_uint8DirectionIn)
+{
+	if(Global_uint32Residue != 0u)
+	{
+		if(Copy_uint8DirectionIn != 0u)
+		{
+			BL_voidUSBStallIn();
+		}
+		else
+		{
+			Global_uint32OutRemaining = Global_uint32Residue;
+			Global_uint8State         = UF2_STATE_DISCARD;
+			return;
+		}
+	}
+
+	Global_uint8State = UF2_STATE_STATUS;
+}
+
+
+/*
+ * voidExecuteCommand
+ * ------------------
+ * Serves one SCSI command block. Data-in commands are answered at once (a
+ * READ(10) sector by sector from voidReadSector); WRITE(10) only sets up
+ * the data-out phase, the sectors are taken as they arrive.
+ */
+static void voidExecuteCommand(const uint8_t* Copy_puint8Cbw)
+{
+	const uint8_t* Local_puint8Cb = &Copy_puint8Cbw[15];
+	uint8_t  Local_uint8DirectionIn = ((Copy_puint8Cbw[12] & UF2_CBW_FLAG_IN) != 0u) ? 1u : 0u;
+	uint8_t  Local_uint8Reply[36];
+	uint32_t Local_uint32Lba;
+	uint32_t Local_uint32Count;
+
+	Global_uint8Status   = UF2_CSW_PASSED;
+	Global_uint32Residue = Global_uint32DataLength;
+
+	memset(Local_uint8Reply, 0, sizeof(Local_uint8Reply));
+
+	switch(Local_puint8Cb[0])
+	{
+	case UF2_SCSI_TEST_UNIT_READY:
+	case UF2_SCSI_START_STOP_UNIT:
+	case UF2_SCSI_PREVENT_REMOVAL:
+	case UF2_SCSI_VERIFY10:
+	case UF2_SCSI_SYNC_CACHE10:
+		break;
+
+	case UF2_SCSI_REQUEST_SENSE:
+		Local_uint8Reply[0]  = 0x70u;                        /* Current, fixed format */
+		Local_uint8Reply[2]  = Global_uint8SenseKey;
+		Local_uint8Reply[7]  = 10u;
+		Local_uint8Reply[12] = Global_uint8SenseCode;
+		Global_uint8SenseKey  = 0u;
+		Global_uint8SenseCode = 0u;
+		voidDataIn(Local_uint8Reply, (Local_puint8Cb[4] < 18u) ? Local_puint8Cb[4] : 18u);
+		break;
+
+	case UF2_SCSI_INQUIRY:
+		if((Local_puint8Cb[1] & 0x01u) != 0u)
+		{
+			/* No vital product data pages */
+			voidFail(UF2_SENSE_ILLEGAL_REQUEST, UF2_ASC_INVALID_FIELD);
+			break;
+		}
+		Local_uint8Reply[1] = 0x80u;                         /* Removable */
+		Local_uint8Reply[2] = 0x02u;
+		Local_uint8Reply[3] = 0x02u;
+		Local_uint8Reply[4] = 31u;
+		memcpy(&Local_uint8Reply[8], "STM32   UF2 Bootloader  1.00", 28u);
+		voidDataIn(Local_uint8Reply, (Local_puint8Cb[4] < 36u) ? Local_puint8Cb[4] : 36u);
+		break;
+
+	case UF2_SCSI_MODE_SENSE6:
+		Local_uint8Reply[0] = 3u;                            /* Header only, not write protected */
+		voidDataIn(Local_uint8Reply, (Local_puint8Cb[4] < 4u) ? Local_puint8Cb[4] : 4u);
+		break;
+
+	case UF2_SCSI_MODE_SENSE10:
+		Local_uint8Reply[1] = 6u;
+		voidDataIn(Local_uint8Reply, 8u);
+		break;
+
+	case UF2_SCSI_READ_FORMAT_CAPS:
+		Local_uint8Reply[3] = 8u;
+		voidPutBE32(&Local_uint8Reply[4], BL_UF2_VOLUME_SECTORS);
+		voidPutBE32(&Local_uint8Reply[8], UF2_SECTOR_SIZE);
+		Local_uint8Reply[8] = 0x02u;                         /* Formatted media */
+		voidDataIn(Local_uint8Reply, 12u);
+		break;
+
+	case UF2_SCSI_READ_CAPACITY10:
+		voidPutBE32(&Local_uint8Reply[0], UF2_LAST_LBA);
+		voidPutBE32(&Local_uint8Reply[4], UF2_SECTOR_SIZE);
+		voidDataIn(Local_uint8Reply, 8u);
+		break;
+
+	case UF2_SCSI_READ10:
+		Local_uint32Lba   = uint32_GetBE32(&Local_puint8Cb[2]);
+		Local_uint32Count = ((uint32_t)Local_puint8Cb[7] << 8) | Local_puint8Cb[8];
+
+		if((Local_uint32Lba + Local_uint32Count) > BL_UF2_VOLUME_SECTORS)
+		{
+			voidFail(UF2_SENSE_ILLEGAL_REQUEST, UF2_ASC_LBA_OUT_OF_RANGE);
+			break;
+		}
+
+		for(; (Local_uint32Count != 0u) && (Global_uint32Residue >= UF2_SECTOR_SIZE); Local_uint32Count--, Local_uint32Lba++)
+		{
+			/* The previous sector left the buffer once its last word was in the FIFO */
+			voidReadSector(Local_uint32Lba, Global_uint8Sector);
+			voidDataIn(Global_uint8Sector, UF2_SECTOR_SIZE);
+		}
+		break;
+
+	case UF2_SCSI_WRITE10:
+		Local_uint32Lba   = uint32_GetBE32(&Local_puint8Cb[2]);
+		Local_uint32Count = ((uint32_t)Local_puint8Cb[7] << 8) | Local_puint8Cb[8];
+
+		if(((Local_uint32Lba + Local_uint32Count) > BL_UF2_VOLUME_SECTORS) || (Local_uint8DirectionIn != 0u))
+		{
+			voidFail(UF2_SENSE_ILLEGAL_REQUEST, UF2_ASC_LBA_OUT_OF_RANGE);
+			break;
+		}
+
+		Global_uint32OutRemaining = Local_uint32Count * UF2_SECTOR_SIZE;
+		if(Global_uint32OutRemaining > Global_uint32Residue)
+		{
+			Global_uint32OutRemaining = Global_uint32Residue & ~(UF2_SECTOR_SIZE - 1u);
+		}
+
+		if(Global_uint32OutRemaining != 0u)
+		{
+			Global_uint8State = UF2_STATE_DATA_OUT;
+			return;
+		}
+		break;
+
+	default:
+		voidFail(UF2_SENSE_ILLEGAL_REQUEST, UF2_ASC_INVALID_COMMAND);
+		break;
+	}
+
+	voidFinishCommand(Local_uint8DirectionIn);
+}
+
+
+/*
+ * uint8_TakeSector
+ * ----------------
+ * Moves the next 512 received bytes into Global_uint8Sector: in one copy
+ * when they do not wrap around the ring, byte by byte when they do (the
+ * 31-byte command blocks misalign the stream).
+ */
+static uint8_t uint8_TakeSector(void)
+{
+	uint8_t* Local_puint8Data;
+	uint16_t Local_uint16Iterator;
+
+	if(BL_uint16USBAvailable() < UF2_SECTOR_SIZE)
+	{
+		return 0u;
+	}
+
+	Local_puint8Data = BL_puint8USBPeekBuffer(UF2_SECTOR_SIZE);
+
+	if(Local_puint8Data != NULL)
+	{
+		memcpy(Global_uint8Sector, Local_puint8Data, UF2_SECTOR_SIZE);
+	}
+	else
+	{
+		for(Local_uint16Iterator = 0; Local_uint16Iterator < UF2_SECTOR_SIZE; Local_uint16Iterator++)
+		{
+			Global_uint8Sector[Local_uint16Iterator] = BL_uint8USBPeek(Local_uint16Iterator);
+		}
+	}
+
+	BL_voidUSBConsume(UF2_SECTOR_SIZE);
+
+	return 1u;
+}
+
+
+/*
+ * voidSendStatus
+ * --------------
+ * Command status wrapper: tag, residue, status. A completed UF2 file resets
+ * the board once the host had time to read it.
+ */
+static void voidSendStatus(void)
+{
+	uint32_t Local_uint32Signature = UF2_CSW_SIGNATURE;
+
+	memcpy(&Global_uint8Csw[0], &Local_uint32Signature, 4u);
+	memcpy(&Global_uint8Csw[4], &Global_uint32Tag, 4u);
+	memcpy(&Global_uint8Csw[8], &Global_uint32Residue, 4u);
+	Global_uint8Csw[12] = Global_uint8Status;
+
+	BL_voidUSBTransmit(Global_uint8Csw, UF2_CSW_LENGTH);
+	Global_uint8State = UF2_STATE_COMMAND;
+
+	if(Global_uint8ResetPending != 0u)
+	{
+		BL_voidUSBTxFlush();
+		HAL_Delay(BL_UF2_RESET_DELAY_MS);
+		NVIC_SystemReset();
+	}
+}
+
+
+/*
+ * BL_voidUF2Init
+ * --------------
+ * Brings up the OTG FS device in its mass-storage personality.
+ */
+void BL_voidUF2Init(void)
+{
+	BL_voidUSBInit();
+}
+
+
+/*
+ * BL_voidUF2Poll
+ * --------------
+ * Bulk-only transport state machine, run by the command loop whenever bulk
+ * OUT data arrived or the host cleared a halt. Returns as soon as it needs
+ * more data from the host.
+ */
+void BL_voidUF2Poll(void)
+{
+	uint8_t  Local_uint8Cbw[UF2_CBW_LENGTH];
+	uint32_t Local_uint32Signature;
+	uint8_t  Local_uint8Iterator;
+
+	if(BL_uint8USBTakeReset() != 0u)
+	{
+		Global_uint8State = UF2_STATE_COMMAND;
+	}
+
+	while(1)
+	{
+		switch(Global_uint8State)
+		{
+		case UF2_STATE_COMMAND:
+			if(BL_uint16USBAvailable() < UF2_CBW_LENGTH)
+			{
+				return;
+			}
+
+			for(Local_uint8Iterator = 0; Local_uint8Iterator < UF2_CBW_LENGTH; Local_uint8Iterator++)
+			{
+				Local_uint8Cbw[Local_uint8Iterator] = BL_uint8USBPeek(Local_uint8Iterator);
+			}
+			memcpy(&Local_uint32Signature, &Local_uint8Cbw[0], 4u);
+
+			if(Local_uint32Signature != UF2_CBW_SIGNATURE)
+			{
+				/* Not a command block: drop what is there and wait for the host's reset recovery */
+				BL_voidUSBConsume(BL_uint16USBAvailable());
+				BL_voidUSBStallIn();
+				return;
+			}
+
+			BL_voidUSBConsume(UF2_CBW_LENGTH);
+			memcpy(&Global_uint32Tag, &Local_uint8Cbw[4], 4u);
+			memcpy(&Global_uint32DataLength, &Local_uint8Cbw[8], 4u);
+			voidExecuteCommand(Local_uint8Cbw);
+			break;
+
+		case UF2_STATE_DATA_OUT:
+			if(uint8_TakeSector() == 0u)
+			{
+				return;
+			}
+
+			voidHandleBlock(Global_uint8Sector);
+			Global_uint32Residue      -= UF2_SECTOR_SIZE;
+			Global_uint32OutRemaining -= UF2_SECTOR_SIZE;
+
+			if(Global_uint32OutRemaining == 0u)
+			{
+				voidFinishCommand(0u);
+			}
+			break;
+
+		case UF2_STATE_DISCARD:
+		{
+			uint16_t Local_uint16Count = BL_uint16USBAvailable();
+
+			if(Local_uint16Count == 0u)
+			{
+				return;
+			}
+
+			if(Local_uint16Count > Global_uint32OutRemaining)
+			{
+				Local_uint16Count = (uint16_t)Global_uint32OutRemaining;
+			}
+
+			BL_voidUSBConsume(Local_uint16Count);
+			Global_uint32OutRemaining -= Local_uint16Count;
+
+			if(Global_uint32OutRemaining == 0u)
+			{
+				/* The residue reports the bytes dropped */
+				Global_uint8State = UF2_STATE_STATUS;
+			}
+			break;
+		}
+
+		case UF2_STATE_STATUS:
+		default:
+			if(BL_uint8USBInHalted() != 0u)
+			{
+				return;
+			}
+
+			voidSendStatus();
+			break;
+		}
+	}
+}
+
+#endif /* BL_USB_MSC_ENABLE */
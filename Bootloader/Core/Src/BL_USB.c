@@ -0,0 +1,828 @@
+
+#include "main.h"
+
+#if (BL_TRANSPORT_USB_ENABLE || BL_USB_MSC_ENABLE)
+
+#include "BL_USB.h"
+#include "BL_Transport.h"
+
+
+#if !BL_CLOCK_PROFILE_168MHZ
+#error "The OTG FS device needs the 48 MHz PLLQ clock of BL_CLOCK_PROFILE_168MHZ"
+#endif
+
+
+/*
+ * OTG_FS register blocks
+ * ----------------------
+ * The CMSIS header only defines the global block, the device, endpoint and
+ * FIFO blocks are located at fixed offsets from it.
+ */
+#define USB_DEVICE                   ((USB_OTG_DeviceTypeDef *)(USB_OTG_FS_PERIPH_BASE + USB_OTG_DEVICE_BASE))
+#define USB_INEP(EP)                 ((USB_OTG_INEndpointTypeDef *)(USB_OTG_FS_PERIPH_BASE + USB_OTG_IN_ENDPOINT_BASE + ((EP) * USB_OTG_EP_REG_SIZE)))
+#define USB_OUTEP(EP)                ((USB_OTG_OUTEndpointTypeDef *)(USB_OTG_FS_PERIPH_BASE + USB_OTG_OUT_ENDPOINT_BASE + ((EP) * USB_OTG_EP_REG_SIZE)))
+#define USB_FIFO(EP)                 (*(__IO uint32_t *)(USB_OTG_FS_PERIPH_BASE + USB_OTG_FIFO_BASE + ((EP) * USB_OTG_FIFO_SIZE)))
+#define USB_PCGCCTL                  (*(__IO uint32_t *)(USB_OTG_FS_PERIPH_BASE + USB_OTG_PCGCCTL_BASE))
+
+/* FIFO RAM split, in 32-bit words (1.25 KB total on OTG_FS) */
+#define USB_RX_FIFO_WORDS            128u
+#define USB_TX0_FIFO_WORDS           64u
+#define USB_TX1_FIFO_WORDS           128u
+
+/* GRXSTSP packet status values */
+#define USB_PKTSTS_OUT_DATA          2u
+#define USB_PKTSTS_SETUP_DATA        6u
+
+/* EP0 OUT: accept 3 back-to-back SETUP packets, or one status/data packet */
+#define USB_EP0_OUT_TSIZ             ((3u << USB_OTG_DOEPTSIZ_STUPCNT_Pos) | (1u << USB_OTG_DOEPTSIZ_PKTCNT_Pos) | 64u)
+
+/* Standard requests (USB 2.0 chapter 9) */
+#define USB_REQ_GET_STATUS           0x00u
+#define USB_REQ_CLEAR_FEATURE        0x01u
+#define USB_REQ_SET_FEATURE          0x03u
+#define USB_REQ_SET_ADDRESS          0x05u
+#define USB_REQ_GET_DESCRIPTOR       0x06u
+#define USB_REQ_GET_CONFIGURATION    0x08u
+#define USB_REQ_SET_CONFIGURATION    0x09u
+#define USB_REQ_GET_INTERFACE        0x0Au
+#define USB_REQ_SET_INTERFACE        0x0Bu
+
+/* Mass-storage class requests (Bulk-Only Transport 1.0) */
+#define USB_REQ_MSC_GET_MAX_LUN      0xFEu
+#define USB_REQ_MSC_RESET            0xFFu
+
+#define USB_REQ_TYPE_MASK            0x60u
+#define USB_REQ_TYPE_CLASS           0x20u
+#define USB_REQ_RECIPIENT_ENDPOINT   0x02u
+
+#define USB_DESC_DEVICE              0x01u
+#define USB_DESC_CONFIGURATION       0x02u
+#define USB_DESC_STRING              0x03u
+
+/* Unique device ID, used as serial number string */
+#define USB_UID_BASE                 0x1FFF7A10UL
+
+/* Product ID and interface class / subclass / protocol of the two personalities */
+#if BL_USB_MSC_ENABLE
+#define USB_PID                      BL_USB_MSC_PID
+#define USB_INTERFACE_CLASS          0x08u, 0x06u, 0x50u   /* Mass storage, SCSI transparent, bulk-only */
+#else
+#define USB_PID                      BL_USB_PID
+#define USB_INTERFACE_CLASS          0xFFu, 0x00u, 0x00u   /* Vendor specific */
+#endif
+
+
+/*
+ * The interrupt path runs from RAM (__RAM_FUNC) and reads its constants from
+ * RAM too, so the descriptors and strings are initialised data, not flash.
+ */
+static uint8_t Global_uint8DeviceDesc[18] =
+{
+	18u, USB_DESC_DEVICE,
+	0x00u, 0x02u,                                      /* USB 2.0 */
+	0xFFu, 0x00u, 0x00u,                               /* Class defined at interface level: vendor */
+	64u,                                               /* EP0 max packet size */
+	(uint8_t)BL_USB_VID, (uint8_t)(BL_USB_VID >> 8),
+	(uint8_t)USB_PID, (uint8_t)(USB_PID >> 8),
+	(uint8_t)BL_USB_BCD_DEVICE, (uint8_t)(BL_USB_BCD_DEVICE >> 8),
+	1u, 2u, 3u,                                        /* Manufacturer, product, serial strings */
+	1u                                                 /* One configuration */
+};
+
+static uint8_t Global_uint8ConfigDesc[32] =
+{
+	/* Configuration */
+	9u, USB_DESC_CONFIGURATION, 32u, 0u, 1u, 1u, 0u, 0xC0u, 50u,
+	/* Interface 0: two bulk endpoints */
+	9u, 0x04u, 0u, 0u, 2u, USB_INTERFACE_CLASS, 0u,
+	/* Bulk OUT */
+	7u, 0x05u, BL_USB_BULK_OUT_EP, 0x02u, BL_USB_BULK_MPS, 0u, 0u,
+	/* Bulk IN */
+	7u, 0x05u, BL_USB_BULK_IN_EP, 0x02u, BL_USB_BULK_MPS, 0u, 0u
+};
+
+static uint8_t Global_uint8LangIdDesc[4] = {4u, USB_DESC_STRING, 0x09u, 0x04u};   /* English (US) */
+
+static char Global_charManufacturer[] = "STMicroelectronics";
+#if BL_USB_MSC_ENABLE
+static char Global_charProduct[]      = "STM32F407 UF2 Bootloader";
+#else
+static char Global_charProduct[]      = "STM32F407 UART Bootloader";
+#endif
+
+
+/* Bulk OUT bytes received from the host, producer: IRQ, consumer: frame parser */
+static uint8_t           Global_uint8RxRing[BL_USB_RX_RING_SIZE] __attribute__((aligned(4))) BL_CCMRAM_BUDGET("rx"); /* Filled by the CPU from the FIFO */
+static volatile uint16_t Global_uint16RxHead;
+static volatile uint16_t Global_uint16RxTail;
+
+/* Bulk OUT left NAKed because the ring was full */
+static volatile uint8_t  Global_uint8OutPaused;
+
+/* SET_CONFIGURATION received, bulk endpoints active */
+static volatile uint8_t  Global_uint8Configured;
+
+/* Last SETUP packet */
+static uint32_t          Global_uint32Setup[2];
+
+/* Serial number string: the unique device ID in hexadecimal, read at init (system memory) */
+static char              Global_charSerial[25];
+
+#if BL_USB_MSC_ENABLE
+/* Bulk IN halted by BL_voidUSBStallIn, until the host's CLEAR_FEATURE */
+static volatile uint8_t  Global_uint8InHalted;
+
+/* Bus reset, new configuration or mass-storage reset not yet seen by BL_UF2 */
+static volatile uint8_t  Global_uint8ResetEvent;
+#endif
+
+
+/*
+ * voidFlushFifos
+ * --------------
+ * Flushes every TX FIFO and the shared RX FIFO.
+ */
+__RAM_FUNC static void voidFlushFifos(void)
+{
+	USB_OTG_FS->GRSTCTL = USB_OTG_GRSTCTL_TXFFLSH | (0x10u << USB_OTG_GRSTCTL_TXFNUM_Pos);
+	while(USB_OTG_FS->GRSTCTL & USB_OTG_GRSTCTL_TXFFLSH);
+
+	USB_OTG_FS->GRSTCTL = USB_OTG_GRSTCTL_RXFFLSH;
+	while(USB_OTG_FS->GRSTCTL & USB_OTG_GRSTCTL_RXFFLSH);
+}
+
+
+/*
+ * voidWriteFifo
+ * -------------
+ * Copies a packet into the TX FIFO of an IN endpoint, one 32-bit word at a time.
+ * Waits for FIFO space, so it also handles transfers larger than the FIFO.
+ */
+__RAM_FUNC static void voidWriteFifo(uint8_t Copy_uint8EP, const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length)
+{
+	uint16_t Local_uint16Iterator;
+	uint32_t Local_uint32Word;
+
+	for(Local_uint16Iterator = 0; Local_uint16Iterator < Copy_uint16Length; Local_uint16Iterator += 4u)
+	{
+		Local_uint32Word = Copy_puint8Data[Local_uint16Iterator];
+		if((Local_uint16Iterator + 1u) < Copy_uint16Length) Local_uint32Word |= (uint32_t)Copy_puint8Data[Local_uint16Iterator + 1u] << 8;
+		if((Local_uint16Iterator + 2u) < Copy_uint16Length) Local_uint32Word |= (uint32_t)Copy_puint8Data[Local_uint16Iterator + 2u] << 16;
+		if((Local_uint16Iterator + 3u) < Copy_uint16Length) Local_uint32Word |= (uint32_t)Copy_puint8Data[Local_uint16Iterator + 3u] << 24;
+
+		while((USB_INEP(Copy_uint8EP)->DTXFSTS & USB_OTG_DTXFSTS_INEPTFSAV) == 0u);
+		USB_FIFO(Copy_uint8EP) = Local_uint32Word;
+	}
+}
+
+
+/*
+ * voidEP0Transmit
+ * ---------------
+ * Sends one control IN data packet (at most 64 bytes), or a zero-length
+ * status packet, then arms EP0 OUT for the next SETUP / status stage.
+ */
+__RAM_FUNC static void voidEP0Transmit(const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length)
+{
+	USB_INEP(0)->DIEPTSIZ = (1u << USB_OTG_DIEPTSIZ_PKTCNT_Pos) | Copy_uint16Length;
+	USB_INEP(0)->DIEPCTL |= USB_OTG_DIEPCTL_CNAK | USB_OTG_DIEPCTL_EPENA;
+
+	if(Copy_uint16Length > 0u)
+	{
+		voidWriteFifo(0u, Copy_puint8Data, Copy_uint16Length);
+	}
+
+	USB_OUTEP(0)->DOEPTSIZ = USB_EP0_OUT_TSIZ;
+	USB_OUTEP(0)->DOEPCTL |= USB_OTG_DOEPCTL_CNAK | USB_OTG_DOEPCTL_EPENA;
+}
+
+
+/*
+ * voidEP0Stall
+ * ------------
+ * Rejects an unsupported control request. The core clears the STALL on the next SETUP.
+ */
+__RAM_FUNC static void voidEP0Stall(void)
+{
+	USB_INEP(0)->DIEPCTL  |= USB_OTG_DIEPCTL_STALL;
+	USB_OUTEP(0)->DOEPCTL |= USB_OTG_DOEPCTL_STALL;
+}
+
+
+/*
+ * voidSendStringDescriptor
+ * ------------------------
+ * Builds a UTF-16LE string descriptor from an ASCII string and sends it.
+ * Index 3 (serial number) is the 96-bit unique device ID in hexadecimal.
+ */
+__RAM_FUNC static void voidSendStringDescriptor(uint8_t Copy_uint8Index, uint16_t Copy_uint16MaxLength)
+{
+	uint8_t  Local_uint8Desc[64];
+	uint8_t  Local_uint8Length = 2u;
+	uint8_t  Local_uint8Iterator;
+
+	if(Copy_uint8Index == 0u)
+	{
+		voidEP0Transmit(Global_uint8LangIdDesc, (Copy_uint16MaxLength < 4u) ? Copy_uint16MaxLength : 4u);
+		return;
+	}
+
+	if((Copy_uint8Index >= 1u) && (Copy_uint8Index <= 3u))
+	{
+		const char* Local_pcharString = (Copy_uint8Index == 1u) ? Global_charManufacturer :
+		                                (Copy_uint8Index == 2u) ? Global_charProduct : Global_charSerial;
+
+		for(Local_uint8Iterator = 0; (Local_pcharString[Local_uint8Iterator] != '\0') && (Local_uint8Length < sizeof(Local_uint8Desc)); Local_uint8Iterator++)
+		{
+			Local_uint8Desc[Local_uint8Length++] = (uint8_t)Local_pcharString[Local_uint8Iterator];
+			Local_uint8Desc[Local_uint8Length++] = 0u;
+		}
+	}
+	else
+	{
+		voidEP0Stall();
+		return;
+	}
+
+	Local_uint8Desc[0] = Local_uint8Length;
+	Local_uint8Desc[1] = USB_DESC_STRING;
+
+	voidEP0Transmit(Local_uint8Desc, (Copy_uint16MaxLength < Local_uint8Length) ? Copy_uint16MaxLength : Local_uint8Length);
+}
+
+
+/*
+ * voidArmBulkOut
+ * --------------
+ * Enables bulk OUT for one packet if the RX ring can take it, otherwise the
+ * endpoint stays NAKed and BL_voidUSBConsume() re-arms it later.
+ */
+__RAM_FUNC static void voidArmBulkOut(void)
+{
+	uint16_t Local_uint16Free = (uint16_t)((BL_USB_RX_RING_SIZE - 1u) - ((Global_uint16RxHead - Global_uint16RxTail) & (BL_USB_RX_RING_SIZE - 1u)));
+
+	if(Local_uint16Free >= BL_USB_BULK_MPS)
+	{
+		Global_uint8OutPaused = 0;
+		USB_OUTEP(1)->DOEPTSIZ = (1u << USB_OTG_DOEPTSIZ_PKTCNT_Pos) | BL_USB_BULK_MPS;
+		USB_OUTEP(1)->DOEPCTL |= USB_OTG_DOEPCTL_CNAK | USB_OTG_DOEPCTL_EPENA;
+	}
+	else
+	{
+		Global_uint8OutPaused = 1;
+	}
+}
+
+
+/*
+ * voidSetConfiguration
+ * --------------------
+ * Activates the two bulk endpoints (DATA0, 64-byte packets, IN on TX FIFO 1).
+ */
+__RAM_FUNC static void voidSetConfiguration(void)
+{
+	USB_INEP(1)->DIEPCTL = USB_OTG_DIEPCTL_USBAEP | USB_OTG_DIEPCTL_SD0PID_SEVNFRM | USB_OTG_DIEPCTL_SNAK |
+	                       (1u << USB_OTG_DIEPCTL_TXFNUM_Pos) | (2u << USB_OTG_DIEPCTL_EPTYP_Pos) | BL_USB_BULK_MPS;
+	USB_OUTEP(1)->DOEPCTL = USB_OTG_DOEPCTL_USBAEP | USB_OTG_DOEPCTL_SD0PID_SEVNFRM | USB_OTG_DOEPCTL_SNAK |
+	                        (2u << USB_OTG_DOEPCTL_EPTYP_Pos) | BL_USB_BULK_MPS;
+
+	USB_DEVICE->DAINTMSK |= (1u << 1) | (1u << 17);
+
+	Global_uint16RxHead    = 0;
+	Global_uint16RxTail    = 0;
+	Global_uint8Configured = 1;
+
+#if BL_USB_MSC_ENABLE
+	Global_uint8InHalted   = 0;
+	Global_uint8ResetEvent = 1;
+	BL_voidTransportNotifyBackground();
+#endif
+
+	voidArmBulkOut();
+}
+
+
+#if BL_USB_MSC_ENABLE
+/*
+ * voidHandleClassSetup
+ * --------------------
+ * The two bulk-only transport requests. A mass-storage reset drops whatever
+ * the ring holds and makes BL_UF2 wait for a new command block; the host
+ * then clears the endpoint halts.
+ */
+__RAM_FUNC static void voidHandleClassSetup(uint8_t Copy_uint8Request, uint16_t Copy_uint16Length)
+{
+	uint8_t Local_uint8MaxLun = 0u;                       /* One logical unit */
+
+	switch(Copy_uint8Request)
+	{
+	case USB_REQ_MSC_GET_MAX_LUN:
+		voidEP0Transmit(&Local_uint8MaxLun, (Copy_uint16Length < 1u) ? Copy_uint16Length : 1u);
+		break;
+
+	case USB_REQ_MSC_RESET:
+		Global_uint16RxTail    = Global_uint16RxHead;
+		Global_uint8ResetEvent = 1;
+		BL_voidTransportNotifyBackground();
+		if(Global_uint8OutPaused != 0)
+		{
+			voidArmBulkOut();
+		}
+		voidEP0Transmit(0, 0u);
+		break;
+
+	default:
+		voidEP0Stall();
+		break;
+	}
+}
+
+
+/*
+ * voidClearEndpointHalt
+ * ---------------------
+ * CLEAR_FEATURE(ENDPOINT_HALT) on a bulk endpoint: the STALL is removed and
+ * the data toggle restarts at DATA0.
+ */
+__RAM_FUNC static void voidClearEndpointHalt(uint8_t Copy_uint8Endpoint)
+{
+	if(Copy_uint8Endpoint == BL_USB_BULK_IN_EP)
+	{
+		USB_INEP(1)->DIEPCTL = (USB_INEP(1)->DIEPCTL & ~USB_OTG_DIEPCTL_STALL) | USB_OTG_DIEPCTL_SD0PID_SEVNFRM;
+		Global_uint8InHalted = 0;
+		BL_voidTransportNotifyBackground();
+	}
+	else if(Copy_uint8Endpoint == BL_USB_BULK_OUT_EP)
+	{
+		USB_OUTEP(1)->DOEPCTL = (USB_OUTEP(1)->DOEPCTL & ~USB_OTG_DOEPCTL_STALL) | USB_OTG_DOEPCTL_SD0PID_SEVNFRM;
+	}
+	else
+	{
+		/* EP0: cleared by the next SETUP */
+	}
+}
+#endif
+
+
+/*
+ * voidHandleSetup
+ * ---------------
+ * Standard chapter 9 requests; a vendor interface needs nothing else.
+ * Status stages are zero-length IN packets.
+ */
+__RAM_FUNC static void voidHandleSetup(void)
+{
+	uint8_t  Local_uint8Request = (uint8_t)(Global_uint32Setup[0] >> 8);
+	uint16_t Local_uint16Value  = (uint16_t)(Global_uint32Setup[0] >> 16);
+	uint16_t Local_uint16Length = (uint16_t)(Global_uint32Setup[1] >> 16);
+	uint8_t  Local_uint8Reply[2] = {0u, 0u};
+
+#if BL_USB_MSC_ENABLE
+	if((Global_uint32Setup[0] & USB_REQ_TYPE_MASK) == USB_REQ_TYPE_CLASS)
+	{
+		voidHandleClassSetup(Local_uint8Request, Local_uint16Length);
+		return;
+	}
+#endif
+
+	if((Global_uint32Setup[0] & USB_REQ_TYPE_MASK) != 0u)
+	{
+		/* Class / vendor requests are not used */
+		voidEP0Stall();
+		return;
+	}
+
+	switch(Local_uint8Request)
+	{
+	case USB_REQ_GET_STATUS:
+		voidEP0Transmit(Local_uint8Reply, (Local_uint16Length < 2u) ? Local_uint16Length : 2u);
+		break;
+
+	case USB_REQ_SET_ADDRESS:
+		/* The OTG core takes the new address before the status stage */
+		USB_DEVICE->DCFG = (USB_DEVICE->DCFG & ~USB_OTG_DCFG_DAD) | (((uint32_t)Local_uint16Value & 0x7Fu) << USB_OTG_DCFG_DAD_Pos);
+		voidEP0Transmit(0, 0u);
+		break;
+
+	case USB_REQ_GET_DESCRIPTOR:
+		switch(Local_uint16Value >> 8)
+		{
+		case USB_DESC_DEVICE:
+			voidEP0Transmit(Global_uint8DeviceDesc, (Local_uint16Length < sizeof(Global_uint8DeviceDesc)) ? Local_uint16Length : sizeof(Global_uint8DeviceDesc));
+			break;
+		case USB_DESC_CONFIGURATION:
+			voidEP0Transmit(Global_uint8ConfigDesc, (Local_uint16Length < sizeof(Global_uint8ConfigDesc)) ? Local_uint16Length : sizeof(Global_uint8ConfigDesc));
+			break;
+		case USB_DESC_STRING:
+			voidSendStringDescriptor((uint8_t)Local_uint16Value, Local_uint16Length);
+			break;
+		default:
+			voidEP0Stall();
+			break;
+		}
+		break;
+
+	case USB_REQ_GET_CONFIGURATION:
+		Local_uint8Reply[0] = Global_uint8Configured;
+		voidEP0Transmit(Local_uint8Reply, (Local_uint16Length < 1u) ? Local_uint16Length : 1u);
+		break;
+
+	case USB_REQ_SET_CONFIGURATION:
+		if(Local_uint16Value != 0u)
+		{
+			voidSetConfiguration();
+		}
+		else
+		{
+			Global_uint8Configured = 0;
+		}
+		voidEP0Transmit(0, 0u);
+		break;
+
+	case USB_REQ_GET_INTERFACE:
+		voidEP0Transmit(Local_uint8Reply, (Local_uint16Length < 1u) ? Local_uint16Length : 1u);
+		break;
+
+	case USB_REQ_CLEAR_FEATURE:
+#if BL_USB_MSC_ENABLE
+		if((Global_uint32Setup[0] & 0x1Fu) == USB_REQ_RECIPIENT_ENDPOINT)
+		{
+			voidClearEndpointHalt((uint8_t)Global_uint32Setup[1]);
+		}
+#endif
+		voidEP0Transmit(0, 0u);
+		break;
+
+	case USB_REQ_SET_FEATURE:
+	case USB_REQ_SET_INTERFACE:
+		voidEP0Transmit(0, 0u);
+		break;
+
+	default:
+		voidEP0Stall();
+		break;
+	}
+}
+
+
+/*
+ * voidHandleBusReset
+ * ------------------
+ * Returns the device to the default state: address 0, only EP0 active.
+ */
+__RAM_FUNC static void voidHandleBusReset(void)
+{
+	uint8_t Local_uint8EP;
+
+	voidFlushFifos();
+
+	for(Local_uint8EP = 0; Local_uint8EP < 4u; Local_uint8EP++)
+	{
+		USB_INEP(Local_uint8EP)->DIEPINT  = 0xFB7Fu;
+		USB_INEP(Local_uint8EP)->DIEPCTL &= ~USB_OTG_DIEPCTL_STALL;
+		USB_OUTEP(Local_uint8EP)->DOEPINT = 0xFB7Fu;
+		USB_OUTEP(Local_uint8EP)->DOEPCTL = (USB_OUTEP(Local_uint8EP)->DOEPCTL & ~USB_OTG_DOEPCTL_STALL) | USB_OTG_DOEPCTL_SNAK;
+	}
+
+	USB_DEVICE->DAINTMSK = (1u << 0) | (1u << 16);
+	USB_DEVICE->DOEPMSK  = USB_OTG_DOEPMSK_STUPM | USB_OTG_DOEPMSK_XFRCM;
+	USB_DEVICE->DIEPMSK  = USB_OTG_DIEPMSK_XFRCM;
+	USB_DEVICE->DCFG    &= ~USB_OTG_DCFG_DAD;
+
+	USB_OUTEP(0)->DOEPTSIZ = USB_EP0_OUT_TSIZ;
+
+	Global_uint8Configured = 0;
+	Global_uint8OutPaused  = 0;
+
+#if BL_USB_MSC_ENABLE
+	Global_uint8InHalted   = 0;
+	Global_uint8ResetEvent = 1;
+#endif
+}
+
+
+/*
+ * BL_voidUSBInit
+ * --------------
+ * Brings up OTG_FS as a full-speed device on the embedded PHY (PA11/PA12,
+ * already in AF10 from MX_GPIO_Init) and connects to the bus. The serial
+ * number string is built first, while the flash is idle.
+ * VBUS sensing is disabled: the board is self-powered from the ST-LINK.
+ */
+void BL_voidUSBInit(void)
+{
+	static const char Local_charHex[] = "0123456789ABCDEF";
+	const uint8_t* Local_puint8UID = (const uint8_t*)USB_UID_BASE;
+	uint8_t Local_uint8EP;
+	uint8_t Local_uint8Index;
+
+	for(Local_uint8Index = 0; Local_uint8Index < 12u; Local_uint8Index++)
+	{
+		Global_charSerial[2u * Local_uint8Index]      = Local_charHex[Local_puint8UID[Local_uint8Index] >> 4];
+		Global_charSerial[2u * Local_uint8Index + 1u] = Local_charHex[Local_puint8UID[Local_uint8Index] & 0x0Fu];
+	}
+
+	__HAL_RCC_USB_OTG_FS_CLK_ENABLE();
+
+	/* Embedded full-speed PHY, core soft reset */
+	USB_OTG_FS->GUSBCFG |= USB_OTG_GUSBCFG_PHYSEL;
+	while((USB_OTG_FS->GRSTCTL & USB_OTG_GRSTCTL_AHBIDL) == 0u);
+	USB_OTG_FS->GRSTCTL |= USB_OTG_GRSTCTL_CSRST;
+	while(USB_OTG_FS->GRSTCTL & USB_OTG_GRSTCTL_CSRST);
+
+	USB_OTG_FS->GCCFG = USB_OTG_GCCFG_PWRDWN | USB_OTG_GCCFG_NOVBUSSENS;
+
+	/* Force device mode, takes effect after at least 25 ms */
+	USB_OTG_FS->GUSBCFG = (USB_OTG_FS->GUSBCFG & ~(USB_OTG_GUSBCFG_FHMOD | USB_OTG_GUSBCFG_TRDT)) |
+	                      USB_OTG_GUSBCFG_FDMOD | (6u << USB_OTG_GUSBCFG_TRDT_Pos);
+	HAL_Delay(50);
+
+	/* Stay disconnected until everything is set up */
+	USB_PCGCCTL = 0;
+	USB_DEVICE->DCTL |= USB_OTG_DCTL_SDIS;
+	USB_DEVICE->DCFG |= USB_OTG_DCFG_DSPD;
+
+	USB_OTG_FS->GRXFSIZ            = USB_RX_FIFO_WORDS;
+	USB_OTG_FS->DIEPTXF0_HNPTXFSIZ = (USB_TX0_FIFO_WORDS << 16) | USB_RX_FIFO_WORDS;
+	USB_OTG_FS->DIEPTXF[0]         = (USB_TX1_FIFO_WORDS << 16) | (USB_RX_FIFO_WORDS + USB_TX0_FIFO_WORDS);
+	voidFlushFifos();
+
+	USB_DEVICE->DIEPMSK  = 0;
+	USB_DEVICE->DOEPMSK  = 0;
+	USB_DEVICE->DAINTMSK = 0;
+	for(Local_uint8EP = 0; Local_uint8EP < 4u; Local_uint8EP++)
+	{
+		USB_INEP(Local_uint8EP)->DIEPCTL   = 0;
+		USB_INEP(Local_uint8EP)->DIEPTSIZ  = 0;
+		USB_INEP(Local_uint8EP)->DIEPINT   = 0xFB7Fu;
+		USB_OUTEP(Local_uint8EP)->DOEPCTL  = 0;
+		USB_OUTEP(Local_uint8EP)->DOEPTSIZ = 0;
+		USB_OUTEP(Local_uint8EP)->DOEPINT  = 0xFB7Fu;
+	}
+
+	USB_OTG_FS->GINTSTS = 0xBFFFFFFFu;
+	USB_OTG_FS->GINTMSK = USB_OTG_GINTMSK_USBRST | USB_OTG_GINTMSK_ENUMDNEM | USB_OTG_GINTMSK_RXFLVLM | USB_OTG_GINTMSK_OEPINT;
+	USB_OTG_FS->GAHBCFG |= USB_OTG_GAHBCFG_GINT;
+
+	HAL_NVIC_EnableIRQ(OTG_FS_IRQn);
+
+	/* Soft connect: pull-up on D+ */
+	USB_DEVICE->DCTL &= ~USB_OTG_DCTL_SDIS;
+}
+
+
+/*
+ * BL_voidUSBDeInit
+ * ----------------
+ * Soft disconnect (the host sees the device unplugged), interrupt off,
+ * transceiver powered down and the core's clock stopped. Bytes from the host
+ * are lost from now on; BL_voidUSBInit starts everything again.
+ */
+void BL_voidUSBDeInit(void)
+{
+	HAL_NVIC_DisableIRQ(OTG_FS_IRQn);
+
+	USB_DEVICE->DCTL   |= USB_OTG_DCTL_SDIS;
+	USB_OTG_FS->GAHBCFG &= ~USB_OTG_GAHBCFG_GINT;
+	USB_OTG_FS->GINTMSK = 0;
+	USB_OTG_FS->GCCFG   = 0;
+
+	__HAL_RCC_USB_OTG_FS_CLK_DISABLE();
+	HAL_NVIC_ClearPendingIRQ(OTG_FS_IRQn);
+}
+
+
+/*
+ * BL_uint16USBAvailable
+ * ---------------------
+ * Returns the number of bulk OUT bytes not yet consumed by the parser.
+ */
+uint16_t BL_uint16USBAvailable(void)
+{
+	return (uint16_t)((Global_uint16RxHead - Global_uint16RxTail) & (BL_USB_RX_RING_SIZE - 1u));
+}
+
+
+/*
+ * BL_uint8USBPeek
+ * ---------------
+ * Returns the byte Copy_uint16Offset positions after the ring tail.
+ */
+uint8_t BL_uint8USBPeek(uint16_t Copy_uint16Offset)
+{
+	return Global_uint8RxRing[(Global_uint16RxTail + Copy_uint16Offset) & (BL_USB_RX_RING_SIZE - 1u)];
+}
+
+
+/*
+ * BL_puint8USBPeekBuffer
+ * ----------------------
+ * Returns the next Copy_uint16Length bytes in place, not consumed, or NULL
+ * when they wrap around the end of the ring.
+ */
+uint8_t* BL_puint8USBPeekBuffer(uint16_t Copy_uint16Length)
+{
+	if(((uint32_t)Global_uint16RxTail + Copy_uint16Length) > BL_USB_RX_RING_SIZE)
+	{
+		return NULL;
+	}
+
+	return &Global_uint8RxRing[Global_uint16RxTail];
+}
+
+
+/*
+ * BL_voidUSBConsume
+ * -----------------
+ * Releases bytes from the ring and resumes bulk OUT if it was paused for space.
+ */
+void BL_voidUSBConsume(uint16_t Copy_uint16Count)
+{
+	Global_uint16RxTail = (Global_uint16RxTail + Copy_uint16Count) & (BL_USB_RX_RING_SIZE - 1u);
+
+	if(Global_uint8OutPaused != 0)
+	{
+		HAL_NVIC_DisableIRQ(OTG_FS_IRQn);
+		voidArmBulkOut();
+		HAL_NVIC_EnableIRQ(OTG_FS_IRQn);
+	}
+}
+
+
+/*
+ * BL_voidUSBTransmit
+ * ------------------
+ * Sends one response as a single bulk IN transfer.
+ *
+ * Behavior:
+ * ---------
+ * 1. Waits for the previous transfer to finish.
+ * 2. Programs packet count and size, the core splits it into 64-byte packets.
+ * 3. Fills the TX FIFO as space frees up; returns when the last word is queued.
+ *
+ * NOTE: a transfer that is a multiple of 64 bytes ends without a short packet;
+ *       host tools read the announced length, not until a short packet.
+ */
+void BL_voidUSBTransmit(uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length)
+{
+	uint16_t Local_uint16Packets = (uint16_t)((Copy_uint16Length + BL_USB_BULK_MPS - 1u) / BL_USB_BULK_MPS);
+
+	if((Global_uint8Configured == 0) || (Copy_uint16Length == 0u))
+	{
+		return;
+	}
+
+	BL_voidUSBTxFlush();
+
+	USB_INEP(1)->DIEPTSIZ = ((uint32_t)Local_uint16Packets << USB_OTG_DIEPTSIZ_PKTCNT_Pos) | Copy_uint16Length;
+	USB_INEP(1)->DIEPCTL |= USB_OTG_DIEPCTL_CNAK | USB_OTG_DIEPCTL_EPENA;
+
+	voidWriteFifo(1u, Copy_puint8Data, Copy_uint16Length);
+}
+
+
+/*
+ * BL_voidUSBTxFlush
+ * -----------------
+ * The core clears EPENA once the whole IN transfer has been sent.
+ */
+void BL_voidUSBTxFlush(void)
+{
+	while((Global_uint8Configured != 0) && (USB_INEP(1)->DIEPCTL & USB_OTG_DIEPCTL_EPENA));
+}
+
+
+/*
+ * BL_voidUSBIRQHandler
+ * --------------------
+ * Bus reset, enumeration done, RX FIFO (SETUP and OUT data) and OUT endpoint events.
+ * Runs from RAM with everything it calls, so enumeration, control requests
+ * and the bulk OUT NAK flow control carry on while an erase or a program
+ * stalls the flash.
+ */
+__RAM_FUNC void BL_voidUSBIRQHandler(void)
+{
+	uint32_t Local_uint32Status = USB_OTG_FS->GINTSTS & USB_OTG_FS->GINTMSK;
+
+	if(Local_uint32Status & USB_OTG_GINTSTS_USBRST)
+	{
+		USB_OTG_FS->GINTSTS = USB_OTG_GINTSTS_USBRST;
+		voidHandleBusReset();
+	}
+
+	if(Local_uint32Status & USB_OTG_GINTSTS_ENUMDNE)
+	{
+		USB_OTG_FS->GINTSTS = USB_OTG_GINTSTS_ENUMDNE;
+		USB_INEP(0)->DIEPCTL &= ~USB_OTG_DIEPCTL_MPSIZ;      /* 64-byte EP0 */
+		USB_DEVICE->DCTL |= USB_OTG_DCTL_CGINAK;
+	}
+
+	while(USB_OTG_FS->GINTSTS & USB_OTG_GINTSTS_RXFLVL)
+	{
+		uint32_t Local_uint32Rx    = USB_OTG_FS->GRXSTSP;
+		uint8_t  Local_uint8EP     = (uint8_t)(Local_uint32Rx & USB_OTG_GRXSTSP_EPNUM);
+		uint16_t Local_uint16Count = (uint16_t)((Local_uint32Rx & USB_OTG_GRXSTSP_BCNT) >> USB_OTG_GRXSTSP_BCNT_Pos);
+		uint8_t  Local_uint8Status = (uint8_t)((Local_uint32Rx & USB_OTG_GRXSTSP_PKTSTS) >> USB_OTG_GRXSTSP_PKTSTS_Pos);
+		uint16_t Local_uint16Iterator;
+		uint32_t Local_uint32Word = 0;
+
+		if(Local_uint8Status == USB_PKTSTS_SETUP_DATA)
+		{
+			Global_uint32Setup[0] = USB_FIFO(0);
+			Global_uint32Setup[1] = USB_FIFO(0);
+		}
+		else if((Local_uint8Status == USB_PKTSTS_OUT_DATA) && (Local_uint8EP == 1u))
+		{
+			for(Local_uint16Iterator = 0; Local_uint16Iterator < Local_uint16Count; Local_uint16Iterator++)
+			{
+				if((Local_uint16Iterator & 3u) == 0u)
+				{
+					Local_uint32Word = USB_FIFO(0);
+				}
+				Global_uint8RxRing[Global_uint16RxHead] = (uint8_t)(Local_uint32Word >> ((Local_uint16Iterator & 3u) * 8u));
+				Global_uint16RxHead = (Global_uint16RxHead + 1u) & (BL_USB_RX_RING_SIZE - 1u);
+			}
+#if BL_USB_MSC_ENABLE
+			BL_voidTransportNotifyBackground();
+#else
+			BL_voidTransportNotifyRx();
+#endif
+		}
+		else
+		{
+			/* Status stage / other endpoints: drain the words */
+			for(Local_uint16Iterator = 0; Local_uint16Iterator < Local_uint16Count; Local_uint16Iterator += 4u)
+			{
+				(void)USB_FIFO(0);
+			}
+		}
+	}
+
+	if(Local_uint32Status & USB_OTG_GINTSTS_OEPINT)
+	{
+		uint32_t Local_uint32EPInt;
+
+		if(USB_DEVICE->DAINT & (1u << 16))
+		{
+			Local_uint32EPInt = USB_OUTEP(0)->DOEPINT;
+			USB_OUTEP(0)->DOEPINT = Local_uint32EPInt;
+
+			if(Local_uint32EPInt & USB_OTG_DOEPINT_STUP)
+			{
+				voidHandleSetup();
+			}
+		}
+
+		if(USB_DEVICE->DAINT & (1u << 17))
+		{
+			Local_uint32EPInt = USB_OUTEP(1)->DOEPINT;
+			USB_OUTEP(1)->DOEPINT = Local_uint32EPInt;
+
+			if(Local_uint32EPInt & USB_OTG_DOEPINT_XFRC)
+			{
+				voidArmBulkOut();
+			}
+		}
+	}
+}
+
+#if BL_USB_MSC_ENABLE
+/*
+ * BL_voidUSBStallIn
+ * -----------------
+ * Ends a data-in phase the device had less data for than the host asked:
+ * bulk IN answers STALL until the host clears the halt, then the status
+ * wrapper follows (BL_uint8USBInHalted).
+ */
+void BL_voidUSBStallIn(void)
+{
+	BL_voidUSBTxFlush();
+
+	Global_uint8InHalted = 1;
+	USB_INEP(1)->DIEPCTL |= USB_OTG_DIEPCTL_STALL;
+}
+
+
+uint8_t BL_uint8USBInHalted(void)
+{
+	return Global_uint8InHalted;
+}
+
+
+/*
+ * BL_uint8USBTakeReset
+ * --------------------
+ * Returns 1, once, after a bus reset, a SET_CONFIGURATION or a mass-storage
+ * reset: the byte stream restarts at a command block boundary.
+ */
+uint8_t BL_uint8USBTakeReset(void)
+{
+	uint8_t Local_uint8Reset = Global_uint8ResetEvent;
+
+	Global_uint8ResetEvent = 0;
+
+	return Local_uint8Reset;
+}
+#endif
+
+#endif /* BL_TRANSPORT_USB_ENABLE || BL_USB_MSC_ENABLE */
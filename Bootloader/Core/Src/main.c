@@ -24,6 +24,22 @@
 /* USER CODE BEGIN Includes */
 #include "string.h"
 #include "BL.h"
+#include "BL_Transport.h"
+#include "BL_UART.h"
+#include "BL_Flash.h"
+#include "BL_CRC.h"
+#include "BL_AES.h"
+#include "BL_Image.h"
+#include "BL_Staging.h"
+#include "BL_Handoff.h"
+#include "BL_Loader.h"
+#include "BL_Services.h"
+#include "BL_Journal.h"
+#include "BL_KV.h"
+#include "BL_Trace.h"
+#include "BL_Bench.h"
+#include "BL_UF2.h"
+#include "BL_Port.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -39,23 +55,60 @@
 /* USER CODE BEGIN PM */
 /*start flash region for user*/
 #define FLASH_SECTOR2_BASE_ADDRESS       0X08008000UL
+
+/* Trial boot and update mode watchdog: LSI (32 kHz) / 64, 4096 ticks -> about 8 s */
+#define TRIAL_IWDG_PRESCALER             IWDG_PR_PR_2
+#define TRIAL_IWDG_RELOAD                0x0FFFu
+
+/* Returned by Bootloader_TrialBoot */
+#define TRIAL_NONE                       0u   /* Confirmed image, no watchdog */
+#define TRIAL_ARMED                      1u   /* Attempt counted, arm the IWDG before the jump */
+#define TRIAL_EXPIRED                    2u   /* Out of attempts, roll back */
+
+/* Returned by Bootloader_TakeUpdateRequest */
+#define REQUEST_NONE                     0u   /* B1 and the image decide */
+#define REQUEST_UPDATE                   1u   /* Update mode asked for by the application */
+#define REQUEST_BOOT                     2u   /* BL_RESET_AND_BOOT: B1 ignored on this boot */
 /* USER CODE END PM */
 
 /* Private variables ---------------------------------------------------------*/
 CRC_HandleTypeDef hcrc;
 
 UART_HandleTypeDef huart2;
+DMA_HandleTypeDef hdma_usart2_rx;
+DMA_HandleTypeDef hdma_usart2_tx;
 
 /* USER CODE BEGIN PV */
+/* BL_HANDOFF_PATH_xxx reported to the application by Bootloader_JumpToImage */
+static uint32_t Global_uint32BootPath = BL_HANDOFF_PATH_FAST;
+
+#if BL_KV_ENABLE
+/* Key/value store (BL_KV.h) for the bootloader's keys, indexed at start-up */
+static BL_KV_t Global_KV;
+#endif
 
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_CRC_Init(void);
 static void MX_USART2_UART_Init(void);
 /* USER CODE BEGIN PFP */
+#if BL_CLOCK_PROFILE_168MHZ || BL_BENCH_ENABLE
+static void SystemClock_Config168MHz(void);
+#endif
+static void Bootloader_WriteHandoff(void);
+static void Bootloader_StartBootTimer(void);
+static void Bootloader_BootStamp(uint8_t Copy_uint8Milestone);
+#if BL_TRIAL_BOOT_ENABLE
+static uint8_t Bootloader_TrialBoot(void);
+static void Bootloader_ArmTrialWatchdog(void);
+#endif
+#if BL_TRIAL_BOOT_ENABLE || BL_WATCHDOG_ENABLE
+static void Bootloader_StartWatchdog(uint32_t Copy_uint32Reload);
+#endif
 
 /* USER CODE END PFP */
 
@@ -72,6 +125,25 @@ int main(void)
 {
   /* USER CODE BEGIN 1 */
 char HelloBootloader[]= "Hello From Bootloader\r\n" ;
+uint8_t Local_uint8UpdateRequest;
+#if BL_TRIAL_BOOT_ENABLE
+uint8_t Local_uint8Trial;
+#endif
+#if BL_JOURNAL_ENABLE
+uint8_t Local_uint8Interrupted;
+#endif
+
+  Bootloader_StartBootTimer();
+  Local_uint8UpdateRequest = Bootloader_TakeUpdateRequest();
+
+  /* Normal boot of a validated application: jump before any clock or peripheral set-up */
+  if((BL_BENCH_ENABLE == 0) && (Local_uint8UpdateRequest != REQUEST_UPDATE) &&
+     (Bootloader_FastBootAllowed((uint8_t)(Local_uint8UpdateRequest == REQUEST_BOOT)) != 0u))
+  {
+	  Bootloader_BootStamp(BL_BOOT_STAMP_DECISION);
+	  Bootloader_BootStamp(BL_BOOT_STAMP_VALIDATED);
+	  Bootloader_JumpToUserApp();
+  }
   /* USER CODE END 1 */
 
   /* MCU Configuration--------------------------------------------------------*/
@@ -87,20 +159,120 @@ char HelloBootloader[]= "Hello From Bootloader\r\n" ;
   SystemClock_Config();
 
   /* USER CODE BEGIN SysInit */
+#if BL_CLOCK_PROFILE_168MHZ && !BL_BENCH_ENABLE
+  SystemClock_Config168MHz();
+#endif
+  Bootloader_BootStamp(BL_BOOT_STAMP_CLOCK);
 
   /* USER CODE END SysInit */
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_CRC_Init();
   MX_USART2_UART_Init();
   /* USER CODE BEGIN 2 */
-   /*Read the button*/
- if( HAL_GPIO_ReadPin(B1_GPIO_Port, B1_Pin)== GPIO_PIN_SET)
+  /* DMA feed of the CRC unit for large ranges (image check and commands) */
+  BL_voidCRCInit();
+#if BL_DECRYPT_ENABLE || BL_BENCH_ENABLE
+  /* AES tables of encrypted updates, into CCMRAM */
+  BL_voidAESInit();
+#endif
+
+#if BL_BENCH_ENABLE
+  /* Microbenchmark build: the suite at the HSI profile, then at 168 MHz HSE, and nothing else */
+  BL_voidFlashInit();
+  BL_voidBenchRun();
+  SystemClock_Config168MHz();
+  MX_USART2_UART_Init();
+  BL_voidBenchRun();
+  while(1)
+  {
+  }
+#endif
+
+#if BL_JOURNAL_ENABLE
+  /* A session cut by power loss gets its resume point back from the flash journal */
+  Local_uint8Interrupted = BL_uint8SessionRecover(BL_uint32ImageGetSlotBase(BL_uint8ImageGetActiveSlot()),
+                                                  BL_uint32ImageGetSlotEnd(BL_uint8ImageGetActiveSlot()));
+#endif
+
+#if BL_KV_ENABLE
+  /* One read-only scan of the active store sector; the first set formats it */
+  BL_voidKVInit(&Global_KV);
+#endif
+
+   /*Read the button once: update mode on request, otherwise the image decides*/
+ if(((HAL_GPIO_ReadPin(B1_GPIO_Port, B1_Pin)== GPIO_PIN_SET) && (Local_uint8UpdateRequest != REQUEST_BOOT)) ||
+    (Local_uint8UpdateRequest == REQUEST_UPDATE))
  {
+	 Bootloader_BootStamp(BL_BOOT_STAMP_DECISION);
 	 Bootloader_UartReadData();
- }else if(HAL_GPIO_ReadPin(B1_GPIO_Port, B1_Pin)== GPIO_PIN_RESET)
+ }else
  {
+	 Bootloader_BootStamp(BL_BOOT_STAMP_DECISION);
+	 Global_uint32BootPath = BL_HANDOFF_PATH_CHECKED;
+
+	 /* An update staged by the application is installed first */
+	 if(BL_uint8StagingInstall() == BL_STAGING_INSTALLED)
+	 {
+		 Global_uint32BootPath = BL_HANDOFF_PATH_INSTALLED;
+#if BL_TRIAL_BOOT_ENABLE
+		 Bootloader_TrialStart();
+#endif
+	 }
+
+#if BL_TRIAL_BOOT_ENABLE
+	 /* An image that never confirmed itself gives way to the previous slot */
+	 Local_uint8Trial = Bootloader_TrialBoot();
+
+	 if(Local_uint8Trial == TRIAL_EXPIRED)
+	 {
+		 if((BL_uint8ImageGetUpdateSlot() != BL_uint8ImageGetActiveSlot()) &&
+		    (BL_uint8ImageActivate(BL_uint8ImageGetUpdateSlot()) == HAL_OK))
+		 {
+			 Global_uint32BootPath = BL_HANDOFF_PATH_ROLLBACK;
+		 }
+		 else
+		 {
+			 Bootloader_UartReadData();
+		 }
+	 }
+#endif
+
+	 /* A missing, half-written or corrupted application keeps the bootloader waiting for an update */
+	 if(BL_uint8ImageCheck() == BL_IMAGE_INVALID)
+	 {
+		 Bootloader_UartReadData();
+	 }
+
+#if BL_JOURNAL_ENABLE
+	 /* Without a header nothing proves the image whole after an interrupted session */
+	 if((Local_uint8Interrupted != 0u) && (BL_uint8ImageCheck() == BL_IMAGE_NO_HEADER))
+	 {
+		 Bootloader_UartReadData();
+	 }
+#endif
+
+	 Bootloader_BootStamp(BL_BOOT_STAMP_VALIDATED);
+
+#if BL_ROLLBACK_ENABLE
+	 /* A confirmed image closes out the older ones: the OTP counter follows its security version */
+#if BL_TRIAL_BOOT_ENABLE
+	 if(Local_uint8Trial != TRIAL_ARMED)
+#endif
+	 {
+		 (void)BL_uint8ImageRaiseRollback();
+	 }
+#endif
+
+#if BL_TRIAL_BOOT_ENABLE
+	 if(Local_uint8Trial == TRIAL_ARMED)
+	 {
+		 Bootloader_ArmTrialWatchdog();
+	 }
+#endif
+
 	 Bootloader_JumpToUserApp();
  }
   /* USER CODE END 2 */
@@ -112,7 +284,7 @@ char HelloBootloader[]= "Hello From Bootloader\r\n" ;
     /* USER CODE END WHILE */
 
     /* USER CODE BEGIN 3 */
-	  HAL_UART_Transmit(&huart2, (uint8_t*)HelloBootloader, sizeof(HelloBootloader), HAL_MAX_DELAY);
+	  BL_voidUARTWrite((const uint8_t*)HelloBootloader, sizeof(HelloBootloader));
 	      HAL_Delay(1000);
   }
   /* USER CODE END 3 */
@@ -221,6 +393,23 @@ static void MX_USART2_UART_Init(void)
 
 }
 
+/**
+  * Enable DMA controller clock
+  */
+static void MX_DMA_Init(void)
+{
+
+  /* DMA controller clock enable */
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  /* DMA interrupt init */
+  /* DMA1_Stream5_IRQn interrupt configuration */
+  HAL_NVIC_EnableIRQ(DMA1_Stream5_IRQn);
+  /* DMA1_Stream6_IRQn interrupt configuration */
+  HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+
+}
+
 /**
   * @brief GPIO Initialization Function
   * @param None
@@ -361,73 +550,434 @@ static void MX_GPIO_Init(void)
 
 /* USER CODE BEGIN 4 */
 
+#if BL_CLOCK_PROFILE_168MHZ || BL_BENCH_ENABLE
+/*
+ * SystemClock_Config168MHz
+ * ------------------------
+ * High-performance clock profile, applied on top of the CubeMX SystemClock_Config().
+ *
+ * Behavior:
+ * ---------
+ * 1. SYSCLK is moved back to HSI, the PLL cannot be reconfigured while it drives SYSCLK.
+ * 2. The PLL is fed from the 8 MHz HSE: 8 / 8 * 336 / 2 = 168 MHz (PLLQ = 7 -> 48 MHz).
+ *    This is the same configuration as the UserApp, so its SystemClock_Config() accepts it.
+ * 3. AHB 168 MHz, APB1 42 MHz, APB2 84 MHz with FLASH_LATENCY_5 (5 wait states at 3.3 V).
+ * 4. The ART accelerator (prefetch, instruction and data caches) is enabled.
+ *
+ * HAL_RCC_ClockConfig() updates SystemCoreClock and the SysTick, and the peripherals
+ * are initialized afterwards, so USART2 computes its BRR from the new PCLK1.
+ */
+static void SystemClock_Config168MHz(void)
+{
+  RCC_OscInitTypeDef RCC_OscInitStruct = {0};
+  RCC_ClkInitTypeDef RCC_ClkInitStruct = {0};
+
+  /* Run from HSI while the PLL is reprogrammed */
+  RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_SYSCLK;
+  RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_HSI;
+  if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_0) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_HSE;
+  RCC_OscInitStruct.HSEState = RCC_HSE_ON;
+  RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
+  RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSE;
+  RCC_OscInitStruct.PLL.PLLM = 8;
+  RCC_OscInitStruct.PLL.PLLN = 336;
+  RCC_OscInitStruct.PLL.PLLP = RCC_PLLP_DIV2;
+  RCC_OscInitStruct.PLL.PLLQ = 7;
+  if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK|RCC_CLOCKTYPE_SYSCLK
+                              |RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2;
+  RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
+  RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
+  RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV4;
+  RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV2;
+  if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_5) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  /* ART accelerator: HAL_Init() enables it from stm32f4xx_hal_conf.h, kept explicit for this profile */
+  __HAL_FLASH_PREFETCH_BUFFER_ENABLE();
+  __HAL_FLASH_INSTRUCTION_CACHE_ENABLE();
+  __HAL_FLASH_DATA_CACHE_ENABLE();
+}
+#endif
+
 /*
  * Bootloader_UartReadData
  * ------------------------
  * This function continuously listens for commands from the host via UART.
+ * Reception runs in the background by DMA into a circular ring buffer
+ * (see BL_Transport.c), so bytes sent while a handler is busy are not lost.
  * It follows a structured protocol:
- *  1. Reads the first byte, which contains the length of the remaining command.
- *  2. Reads the full command based on the received length.
- *  3. Parses the command and executes the corresponding handler function.
+ *  1. Waits for one complete frame, signalled by the USART IDLE line event.
+ *     The first byte ("Length to Follow") is only used to validate the frame.
+ *  2. Parses the command and executes the corresponding handler function.
  */
 void Bootloader_UartReadData(void)
 {
-	/* Buffer to store the received command packet */
-	uint8_t Local_uint8CmdPacket[255] ={0};
+	/* Only frames wrapping around the end of a receive ring (or misaligned aligned frames) are copied here, static: extended frames carry up to 4 KB */
+	static uint8_t Local_uint8CmdPacket[BL_MAX_FRAME_LENGTH] __attribute__((aligned(4)));
+
+	/* The current frame, normally in place in the receive ring */
+	uint8_t* Local_puint8Frame;
+
+#if BL_WATCHDOG_ENABLE
+	/* From here on every step of the loop is bounded (BL_PORT_WATCHDOG_REFRESH) */
+	Bootloader_StartWatchdog(BL_WATCHDOG_RELOAD);
+#endif
+
+	/* Vector table to SRAM: interrupts must not fetch from flash while it is busy */
+	BL_voidFlashInit();
+
+	/* Start circular DMA reception, from now on the host may stream packets */
+	BL_voidTransportInit();
+#if BL_USB_MSC_ENABLE
+	BL_voidUF2Init();
+#endif
+	BL_voidTraceItmInit();
+	BL_TRACE(BL_TRACE_BOOT, 0u, SystemCoreClock);
 
    /* Infinite loop to keep listening for commands */
 	while(1)
 	{
-       /* Clear the command packet buffer before reading a new command */
-		memset(Local_uint8CmdPacket,0,255); // memset(array , value to put , size )
+		/* One command per pass: the longest one is a 128 KB sector erase */
+		BL_PORT_WATCHDOG_REFRESH();
 
-		/*
-		        * Step 1: Read the first byte from UART.
-		        * This byte contains the "Length to Follow" field, which tells how many bytes
-		        * are coming next in the packet.
-        */
-		HAL_UART_Receive(&huart2, Local_uint8CmdPacket, 1, HAL_MAX_DELAY);
+		/* Progress of a background erase, if one is running */
+		BL_voidRunBackgroundTasks();
+
+#if BL_USB_MSC_ENABLE
+		/* Mass-storage commands; the bulk OUT interrupt wakes the wait below for them */
+		BL_voidUF2Poll();
+#endif
 
 		/*
-		        * Step 2: Read the remaining bytes of the command.
-		        * It's size is the previous byte value .
-	   */
-		HAL_UART_Receive(&huart2, &Local_uint8CmdPacket[1], Local_uint8CmdPacket[0], HAL_MAX_DELAY);
+		        * Step 1: Receive one complete frame out of the RX ring.
+		        * The transport returns only once "Length to Follow" + that many
+		        * bytes have arrived, with a single wake-up per packet.
+        */
+		if(BL_uint16TransportReceiveFrame(&Local_puint8Frame, Local_uint8CmdPacket, sizeof(Local_uint8CmdPacket)) == 0)
+		{
+			/* Woken for background work only */
+			continue;
+		}
 
 		/*
-		        * Step 3: Check the command code (second byte in the packet)
-		        * and call the corresponding handler function.
+		        * Step 2: Check the frame CRC and call the handler of the command code
+		        * (second byte in a v1 packet, fourth in an extended one) from the command table.
 		        */
-		switch(Local_uint8CmdPacket[1])     /*this byte includes the command code*/
+		BL_voidDispatchCommand(Local_puint8Frame);
+	}
+}
+
+/*
+ * Bootloader_FastBootAllowed
+ * --------------------------
+ * Boot decision taken from reset state, before HAL_Init: B1 is sampled with
+ * raw register reads (GPIOA clock on just for the read, then back to its
+ * reset value) and the image / staging headers are read from flash.
+ *
+ * Parameters:
+ * -----------
+ * @param Copy_uint8IgnoreButton : 1 after a BL_RESET_AND_BOOT reset, B1 is
+ *                                 not read.
+ *
+ * Return:
+ * -------
+ * 1 when the normal path would jump anyway without doing anything first:
+ * B1 released, no staged update to install, an image already marked
+ * validated (no CRC to compute), no trial boot to count and no anti-rollback
+ * step to burn. 0 sends the boot through the full path.
+ */
+uint8_t Bootloader_FastBootAllowed(uint8_t Copy_uint8IgnoreButton)
+{
+	uint32_t Local_uint32Button;
+
+	RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN;
+	(void)RCC->AHB1ENR;
+	__DSB();
+
+	/* PA0 is an input after reset; one more read lets the synchronizer settle */
+	(void)B1_GPIO_Port->IDR;
+	Local_uint32Button = B1_GPIO_Port->IDR & B1_Pin;
+
+	RCC->AHB1ENR &= ~RCC_AHB1ENR_GPIOAEN;
+
+	return (uint8_t)(((Local_uint32Button == 0u) || (Copy_uint8IgnoreButton != 0u)) &&
+	                 (BL_uint8ImageIsValidated() != 0u) && (Bootloader_HandoffAllowed() != 0u));
+}
+
+/*
+ * Bootloader_HandoffAllowed
+ * -------------------------
+ * The part of the boot decision that depends on neither B1 nor the image
+ * check, also asked by BL_RESET_AND_BOOT before a handoff from update mode.
+ *
+ * Return:
+ * -------
+ * 1 when a jump skips nothing the full path does first: no staged update to
+ * install, no trial boot to count and no anti-rollback step to burn.
+ */
+uint8_t Bootloader_HandoffAllowed(void)
+{
+	return (uint8_t)((BL_uint8StagingIsPending() == 0u) &&
+	                 ((BL_TRIAL_BOOT_ENABLE == 0) || ((BL_TRIAL_REGISTER & BL_TRIAL_MAGIC_MASK) != BL_TRIAL_MAGIC)) &&
+	                 (BL_uint8ImageRollbackPending() == 0u));
+}
+
+/*
+ * Bootloader_TakeUpdateRequest
+ * ----------------------------
+ * Reads and clears the application's update request (BL_Handoff.h), from
+ * reset state like Bootloader_FastBootAllowed: the PWR clock and backup
+ * domain write access are on only for the access.
+ *
+ * Return:
+ * -------
+ * REQUEST_UPDATE if the application asked for update mode before its reset,
+ * REQUEST_BOOT if BL_RESET_AND_BOOT reset the device, REQUEST_NONE otherwise.
+ */
+uint8_t Bootloader_TakeUpdateRequest(void)
+{
+	uint8_t Local_uint8Request = REQUEST_NONE;
+
+	RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+	(void)RCC->APB1ENR;
+	PWR->CR |= PWR_CR_DBP;
+
+	if(BL_UPDATE_REQUEST_REGISTER == BL_UPDATE_REQUEST_MAGIC)
+	{
+		BL_UPDATE_REQUEST_REGISTER = 0u;
+		Local_uint8Request = REQUEST_UPDATE;
+	}
+	else if(BL_UPDATE_REQUEST_REGISTER == BL_BOOT_REQUEST_MAGIC)
+	{
+		BL_UPDATE_REQUEST_REGISTER = 0u;
+		Local_uint8Request = REQUEST_BOOT;
+	}
+
+	PWR->CR &= ~PWR_CR_DBP;
+	RCC->APB1ENR &= ~RCC_APB1ENR_PWREN;
+
+	return Local_uint8Request;
+}
+
+/*
+ * Bootloader_TrialStart
+ * ---------------------
+ * Puts the image that just became active on trial (BL_Handoff.h): attempt
+ * count 0, counted from the next boot on.
+ */
+void Bootloader_TrialStart(void)
+{
+	RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+	(void)RCC->APB1ENR;
+	PWR->CR |= PWR_CR_DBP;
+
+	BL_TRIAL_REGISTER = BL_TRIAL_MAGIC;
+
+	PWR->CR &= ~PWR_CR_DBP;
+}
+
+#if BL_TRIAL_BOOT_ENABLE
+/*
+ * Bootloader_TrialBoot
+ * --------------------
+ * Counts one boot of an image on trial.
+ *
+ * Return:
+ * -------
+ * TRIAL_NONE (confirmed, or never on trial), TRIAL_ARMED (attempt counted)
+ * or TRIAL_EXPIRED (BL_TRIAL_BOOT_ATTEMPTS used up; the trial is cleared).
+ */
+static uint8_t Bootloader_TrialBoot(void)
+{
+	uint8_t  Local_uint8Trial = TRIAL_NONE;
+	uint32_t Local_uint32Word = BL_TRIAL_REGISTER;
+
+	if((Local_uint32Word & BL_TRIAL_MAGIC_MASK) == BL_TRIAL_MAGIC)
+	{
+		__HAL_RCC_PWR_CLK_ENABLE();
+		PWR->CR |= PWR_CR_DBP;
+
+		if((Local_uint32Word & ~BL_TRIAL_MAGIC_MASK) >= BL_TRIAL_BOOT_ATTEMPTS)
 		{
-		case BL_GET_VESRION        :BL_voidHandleGetVERCmd(Local_uint8CmdPacket)                  ;        break;
-		case BL_GET_HELP           :BL_voidHandleGetHelpCmd(Local_uint8CmdPacket)                 ;        break;
-		case BL_GET_CID            :BL_voidHandleGetCIDcmd(Local_uint8CmdPacket)                  ;        break;
-		case BL_GET_RDP_STATUS     :BL_voidHandleGetRDPStatusCmd(Local_uint8CmdPacket)            ;        break;
-		case BL_GO_TO_ADDR         :BL_voidHandleGoToAddressCmd(Local_uint8CmdPacket)             ;        break;
-		case BL_FLASH_ERASE        :BL_voidHandleFlashEraseCmd(Local_uint8CmdPacket)              ;        break;
-		case BL_MEM_WRITE          :BL_voidHandleMemWriteCmd(Local_uint8CmdPacket)                ;        break;
-		case BL_EN_RW_PROTECT      :BL_voidHandleEnRWProtectCmd(Local_uint8CmdPacket)             ;        break;
-		case BL_MEM_READ           :BL_voidHandleMemReadCmd(Local_uint8CmdPacket)                 ;        break;
-		case BL_READ_SECTOR_STATUS :BL_voidHandleReadSectorStatusCmd(Local_uint8CmdPacket)        ;        break;
-		case BL_OTP_READ           :BL_voidHandleOTPReadCmd(Local_uint8CmdPacket)                 ;        break;
-		case BL_DIS_WR_PROTECT     :BL_voidHandleDisWRProtectCmd(Local_uint8CmdPacket)            ;        break;
-
-		default : /*Invalid command from host */ break ;
+			BL_TRIAL_REGISTER = BL_TRIAL_CONFIRMED;
+			Local_uint8Trial  = TRIAL_EXPIRED;
 		}
+		else
+		{
+			BL_TRIAL_REGISTER = Local_uint32Word + 1u;
+			Local_uint8Trial  = TRIAL_ARMED;
+		}
+
+		PWR->CR &= ~PWR_CR_DBP;
+	}
+
+	return Local_uint8Trial;
+}
+
+/*
+ * Bootloader_ArmTrialWatchdog
+ * ---------------------------
+ * Starts the IWDG with the trial timeout, right before the jump. Once
+ * started it runs until the next reset, the application refreshes it.
+ */
+static void Bootloader_ArmTrialWatchdog(void)
+{
+	Bootloader_StartWatchdog(TRIAL_IWDG_RELOAD);
+}
+#endif
+
+#if BL_TRIAL_BOOT_ENABLE || BL_WATCHDOG_ENABLE
+/*
+ * Bootloader_StartWatchdog
+ * ------------------------
+ * Starts the IWDG at LSI / 64 with the given reload, or sets the timeout of
+ * an IWDG already running (started by the application before its reset, or
+ * by the option bytes), and reloads it.
+ */
+static void Bootloader_StartWatchdog(uint32_t Copy_uint32Reload)
+{
+	IWDG->KR  = 0xCCCCu;                         /* Start (LSI on by hardware) */
+	IWDG->KR  = 0x5555u;                         /* PR / RLR write access */
+	IWDG->PR  = TRIAL_IWDG_PRESCALER;
+	IWDG->RLR = Copy_uint32Reload;
+
+	while(IWDG->SR != 0u)
+	{
+	}
+
+	IWDG->KR  = 0xAAAAu;                         /* Reload */
+}
+#endif
+
+/*
+ * Bootloader_StartBootTimer
+ * -------------------------
+ * Starts the DWT cycle counter from 0 and invalidates the handoff block left
+ * by the previous boot, its stamps cleared for this one.
+ */
+static void Bootloader_StartBootTimer(void)
+{
+	uint8_t Local_uint8Index;
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0u;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	BL_HANDOFF->Magic = 0u;
+
+	for(Local_uint8Index = 0; Local_uint8Index < BL_BOOT_STAMPS; Local_uint8Index++)
+	{
+		BL_HANDOFF->Stamps[Local_uint8Index] = 0u;
+	}
+}
+
+/*
+ * Bootloader_BootStamp
+ * --------------------
+ * Records the cycle count of a boot milestone (BL_BOOT_STAMP_xxx).
+ */
+static void Bootloader_BootStamp(uint8_t Copy_uint8Milestone)
+{
+	BL_HANDOFF->Stamps[Copy_uint8Milestone] = DWT->CYCCNT;
+}
+
+/*
+ * Bootloader_WriteHandoff
+ * -----------------------
+ * Fills the BL_Handoff_t block at the end of CCMRAM with the clock tree about
+ * to be handed over, the reset flags and the boot path, stamps the jump and
+ * seals the block with Check.
+ */
+static void Bootloader_WriteHandoff(void)
+{
+	volatile BL_Handoff_t* Local_pHandoff = BL_HANDOFF;
+	const volatile uint32_t* Local_puint32Word = (const volatile uint32_t*)BL_HANDOFF;
+	uint32_t Local_uint32Check = 0;
+	uint8_t  Local_uint8Index;
+
+	Local_pHandoff->Magic      = BL_HANDOFF_MAGIC;
+	Local_pHandoff->Version    = BL_VERSION;
+	Local_pHandoff->BootPath   = Global_uint32BootPath;
+	Local_pHandoff->ResetFlags = RCC->CSR;
+	Local_pHandoff->SysClock   = SystemCoreClock;
+	Local_pHandoff->Pllcfgr    = RCC->PLLCFGR;
+	Local_pHandoff->Cfgr       = RCC->CFGR;
+	Local_pHandoff->FlashAcr   = FLASH->ACR;
+	Local_pHandoff->Stamps[BL_BOOT_STAMP_JUMP] = DWT->CYCCNT;
+
+	for(Local_uint8Index = 0; Local_uint8Index < ((sizeof(BL_Handoff_t) / sizeof(uint32_t)) - 1u); Local_uint8Index++)
+	{
+		Local_uint32Check ^= Local_puint32Word[Local_uint8Index];
 	}
+
+	Local_pHandoff->Check = ~Local_uint32Check;
 }
 
 /*
  * Bootloader_JumpToUserApp
  * ------------------------
  * This function transfers execution from the Bootloader to the User Application.
- * It achieves this by setting the MSP (Main Stack Pointer) and jumping to the
- * Reset Handler of the user application.
  */
 void Bootloader_JumpToUserApp(void)
+{
+	/* Slot A, or with BL_AB_SLOTS_ENABLE the last activated slot */
+	Bootloader_JumpToImage(BL_uint32ImageGetSlotBase(BL_uint8ImageGetActiveSlot()));
+}
+
+/*
+ * Bootloader_LeaveUpdateMode
+ * --------------------------
+ * End of BL_RESET_AND_BOOT, once its reply is on the line: with
+ * Copy_uint8Reset a system reset that skips update mode on the next boot
+ * (BL_BOOT_REQUEST_MAGIC), otherwise the clean handoff of
+ * Bootloader_JumpToImage into the active slot.
+ */
+void Bootloader_LeaveUpdateMode(uint8_t Copy_uint8Reset)
+{
+	if(Copy_uint8Reset != 0u)
+	{
+		__HAL_RCC_PWR_CLK_ENABLE();
+		PWR->CR |= PWR_CR_DBP;
+		BL_UPDATE_REQUEST_REGISTER = BL_BOOT_REQUEST_MAGIC;
+
+		NVIC_SystemReset();
+	}
+
+	Global_uint32BootPath = BL_HANDOFF_PATH_COMMAND;
+	Bootloader_JumpToUserApp();
+
+	/* The image does not return; nothing is left to go back to */
+	while(1)
+	{
+	}
+}
+
+/*
+ * Bootloader_JumpToImage
+ * ----------------------
+ * Starts the image whose vector table is at Copy_uint32Base: the flash
+ * application, or a development image in the RAM run area (BL_RAM_RUN).
+ * The image must start as from a reset: every peripheral the bootloader
+ * used is reset, the clock tree is back on HSI, no interrupt is enabled or
+ * pending and VTOR points at the image's vector table. Then the MSP is
+ * loaded and the image's Reset Handler is called.
+ */
+void Bootloader_JumpToImage(uint32_t Copy_uint32Base)
 {
 	uint32_t ResetHandlerAddress ,Local_uint32MSPVal;
+	uint8_t  Local_uint8Index;
 
 	/*
 	     * Pointer to function to hold the address of the User Application's Reset Handler.
@@ -435,37 +985,163 @@ void Bootloader_JumpToUserApp(void)
     */
 		void (*App_ResetHandle)(void);
 
+#if BL_WEAR_STATS_ENABLE
+	/* Erases of this boot (staging install, session) are counted before the application runs */
+	BL_uint8JournalFlushWear();
+#endif
+
+	/*
+	     * Step 1: Return the clock tree to its reset state (HSI, PLL off, zero wait
+	     * states). Skipped on the fast boot path, where it was never changed, and
+	     * with BL_HANDOFF_KEEP_CLOCK, where the application takes it over as is.
+	     * Either way BL_Handoff_t records the clock tree the application gets.
+    */
+#if (BL_HANDOFF_KEEP_CLOCK == 0)
+	if(((RCC->CR & RCC_CR_PLLON) != 0u) || ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_HSI))
+	{
+		HAL_RCC_DeInit();
+	}
+#endif
+
+	if(Copy_uint32Base >= BL_RAM_RUN_BASE)
+	{
+		Global_uint32BootPath = BL_HANDOFF_PATH_RAM;
+	}
+
+	Bootloader_WriteHandoff();
+
 	/*
-		     * Step 1: Configure the MSP (Main Stack Pointer) for the User Application.
-		     * The MSP value is stored at the first address of the application's Vector Table,
-		     * which is located at the base address of FLASH Sector 2.
+	     * Step 2: No interrupt from here on: SysTick stopped, every NVIC line
+	     * disabled and its pending bit cleared.
     */
- 	Local_uint32MSPVal =  *((volatile uint32_t*)FLASH_SECTOR2_BASE_ADDRESS);
+	__disable_irq();
+
+	SysTick->CTRL = 0u;
+	SysTick->LOAD = 0u;
+	SysTick->VAL  = 0u;
+	SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk | SCB_ICSR_PENDSVCLR_Msk;
+
+	for(Local_uint8Index = 0; Local_uint8Index < (sizeof(NVIC->ICER) / sizeof(NVIC->ICER[0])); Local_uint8Index++)
+	{
+		NVIC->ICER[Local_uint8Index] = 0xFFFFFFFFUL;
+		NVIC->ICPR[Local_uint8Index] = 0xFFFFFFFFUL;
+	}
 
 	/*
-	     * Step 2: Load the User Application MSP value into the MSP register.
-	     * This ensures that the stack pointer is correctly set before executing the application.
+	     * Step 3: Reset the peripherals (USART2, DMA, CRC, GPIO, USB, SPI, PWR)
+	     * and put their clock enables back to the reset values.
     */
-	 __asm volatile("MSR MSP ,%0"::"r"(Local_uint32MSPVal));
+	RCC->AHB1RSTR = 0xFFFFFFFFUL;
+	RCC->AHB1RSTR = 0u;
+	RCC->AHB2RSTR = 0xFFFFFFFFUL;
+	RCC->AHB2RSTR = 0u;
+	RCC->APB1RSTR = 0xFFFFFFFFUL;
+	RCC->APB1RSTR = 0u;
+	RCC->APB2RSTR = 0xFFFFFFFFUL;
+	RCC->APB2RSTR = 0u;
+
+	RCC->AHB1ENR = RCC_AHB1ENR_CCMDATARAMEN;
+	RCC->AHB2ENR = 0u;
+	RCC->APB1ENR = 0u;
+	RCC->APB2ENR = 0u;
+
+	/*
+	     * Step 4: Point VTOR at the application's vector table.
+	     * The bootloader may have moved it to SRAM (BL_voidFlashInit).
+    */
+	 SCB->VTOR = Copy_uint32Base;
 
 	/*
-	     * Step 3: Retrieve the Reset Handler address of the User Application.
+	     * Step 5: Configure the MSP (Main Stack Pointer) for the User Application.
+	     * The MSP value is stored at the first address of the application's Vector Table,
+	     * which is located at the image base (FLASH Sector 2 for the application).
+    */
+ 	Local_uint32MSPVal =  *((volatile uint32_t*)Copy_uint32Base);
+
+	/*
+	     * Step 6: Retrieve the Reset Handler address of the User Application.
 	     * This is stored at the second entry in the Vector Table (offset +4 from base address).
    */
-	 ResetHandlerAddress = *((volatile uint32_t*)(FLASH_SECTOR2_BASE_ADDRESS+ 4));
+	 ResetHandlerAddress = *((volatile uint32_t*)(Copy_uint32Base+ 4));
+	 App_ResetHandle =(void*)ResetHandlerAddress;
+
 	/*
-	     * Step 4: Assign the Reset Handler address to the function pointer.
-	     * This allows the program to jump to the application by calling this function.
-   */
-	App_ResetHandle =(void*)ResetHandlerAddress;
+	     * Step 7: Load the User Application MSP value into the MSP register, make
+	     * every write above take effect, and re-enable interrupts as at reset
+	     * (nothing is left that could fire).
+    */
+	 __asm volatile("MSR MSP ,%0"::"r"(Local_uint32MSPVal));
+	 __DSB();
+	 __ISB();
+	 __enable_irq();
 
 	/*
-	     * Step 5: Jump to the User Application's Reset Handler.
+	     * Step 8: Jump to the User Application's Reset Handler.
 	     * This effectively transfers control from the Bootloader to the application.
    */
 	App_ResetHandle();
 
 }
+
+/*
+ * Bootloader_JumpToLoader
+ * -----------------------
+ * Hands the running system to a second-stage loader checked by
+ * BL_voidHandleGoToAddressCmd (see BL_Loader.h). Unlike Bootloader_JumpToImage
+ * nothing is reset: the clock tree, the GPIOs and USART2 stay as they are,
+ * only its DMA transfers are stopped, since the RX ring they fill belongs to
+ * the bootloader's RAM the loader may reuse. The loader's reset handler gets
+ * its header in R0.
+ */
+void Bootloader_JumpToLoader(uint32_t Copy_uint32Base)
+{
+	volatile BL_LoaderHeader_t* Local_pHeader = BL_LOADER_HEADER(Copy_uint32Base);
+	void (*Local_pvLoaderEntry)(volatile BL_LoaderHeader_t*);
+	uint32_t Local_uint32MSPVal;
+	uint8_t  Local_uint8Index;
+
+#if BL_WEAR_STATS_ENABLE
+	BL_uint8JournalFlushWear();
+#endif
+
+	/* The line stays configured, the bootloader's transfers on it end here */
+	BL_voidUARTStop();
+
+	Local_pHeader->BootloaderVersion = BL_VERSION;
+	Local_pHeader->Link              = BL_LINK_UART;
+	Local_pHeader->BaudRate          = huart2.Init.BaudRate;
+	Local_pHeader->SysClock          = SystemCoreClock;
+	Local_pHeader->Services          = BL_SERVICES_ADDRESS;
+
+	Global_uint32BootPath = BL_HANDOFF_PATH_LOADER;
+	Bootloader_WriteHandoff();
+
+	/* No interrupt from here on, as for an image */
+	__disable_irq();
+
+	SysTick->CTRL = 0u;
+	SysTick->LOAD = 0u;
+	SysTick->VAL  = 0u;
+	SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk | SCB_ICSR_PENDSVCLR_Msk;
+
+	for(Local_uint8Index = 0; Local_uint8Index < (sizeof(NVIC->ICER) / sizeof(NVIC->ICER[0])); Local_uint8Index++)
+	{
+		NVIC->ICER[Local_uint8Index] = 0xFFFFFFFFUL;
+		NVIC->ICPR[Local_uint8Index] = 0xFFFFFFFFUL;
+	}
+
+	SCB->VTOR = Copy_uint32Base;
+
+	Local_uint32MSPVal  = *((volatile uint32_t*)Copy_uint32Base);
+	Local_pvLoaderEntry = (void (*)(volatile BL_LoaderHeader_t*))(*((volatile uint32_t*)(Copy_uint32Base + 4u)));
+
+	__asm volatile("MSR MSP ,%0"::"r"(Local_uint32MSPVal));
+	__DSB();
+	__ISB();
+	__enable_irq();
+
+	Local_pvLoaderEntry(Local_pHeader);
+}
 /* USER CODE END 4 */
 
 /**
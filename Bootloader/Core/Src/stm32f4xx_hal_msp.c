@@ -22,8 +22,12 @@
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
 /* USER CODE BEGIN Includes */
+#include "BL_Port.h"
 
 /* USER CODE END Includes */
+extern DMA_HandleTypeDef hdma_usart2_rx;
+
+extern DMA_HandleTypeDef hdma_usart2_tx;
 
 /* Private typedef -----------------------------------------------------------*/
 /* USER CODE BEGIN TD */
@@ -43,6 +47,14 @@
 /* Private variables ---------------------------------------------------------*/
 /* USER CODE BEGIN PV */
 
+/*
+ * BL_PortMaskStats
+ * ----------------
+ * Longest and number of interrupt-masked sections (BL_PORT_IRQ_SAVE in
+ * BL_Port.h), reported by BL_GET_STATS.
+ */
+BL_PortMaskStats_t BL_PortMaskStats;
+
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -70,11 +82,23 @@ void HAL_MspInit(void)
   __HAL_RCC_SYSCFG_CLK_ENABLE();
   __HAL_RCC_PWR_CLK_ENABLE();
 
-  HAL_NVIC_SetPriorityGrouping(NVIC_PRIORITYGROUP_0);
+  HAL_NVIC_SetPriorityGrouping(NVIC_PRIORITYGROUP_4);
 
   /* System interrupt init*/
 
   /* USER CODE BEGIN MspInit 1 */
+  /* The priority scheme of BL_Port.h for every interrupt the bootloader may
+     enable, whichever links are built in; the drivers only enable them */
+  HAL_NVIC_SetPriority(USART2_IRQn,       BL_IRQ_PRIORITY_LINK_RX, 0);
+  HAL_NVIC_SetPriority(DMA1_Stream5_IRQn, BL_IRQ_PRIORITY_LINK_RX, 0);
+  HAL_NVIC_SetPriority(OTG_FS_IRQn,       BL_IRQ_PRIORITY_LINK_RX, 0);
+  HAL_NVIC_SetPriority(EXTI15_10_IRQn,    BL_IRQ_PRIORITY_LINK_RX, 0);
+  HAL_NVIC_SetPriority(CAN1_RX0_IRQn,     BL_IRQ_PRIORITY_LINK_RX, 0);
+  HAL_NVIC_SetPriority(CAN1_RX1_IRQn,     BL_IRQ_PRIORITY_LINK_RX, 0);
+  HAL_NVIC_SetPriority(DMA1_Stream6_IRQn, BL_IRQ_PRIORITY_LINK_TX, 0);
+  HAL_NVIC_SetPriority(CAN1_TX_IRQn,      BL_IRQ_PRIORITY_LINK_TX, 0);
+  HAL_NVIC_SetPriority(FLASH_IRQn,        BL_IRQ_PRIORITY_FLASH, 0);
+  HAL_NVIC_SetPriority(SysTick_IRQn,      BL_IRQ_PRIORITY_TICK, 0);
 
   /* USER CODE END MspInit 1 */
 }
@@ -152,6 +176,45 @@ void HAL_UART_MspInit(UART_HandleTypeDef* huart)
     GPIO_InitStruct.Alternate = GPIO_AF7_USART2;
     HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
+    /* USART2 DMA Init */
+    /* USART2_RX Init */
+    hdma_usart2_rx.Instance = DMA1_Stream5;
+    hdma_usart2_rx.Init.Channel = DMA_CHANNEL_4;
+    hdma_usart2_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_usart2_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart2_rx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart2_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart2_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart2_rx.Init.Mode = DMA_CIRCULAR;
+    hdma_usart2_rx.Init.Priority = DMA_PRIORITY_HIGH;
+    hdma_usart2_rx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(&hdma_usart2_rx) != HAL_OK)
+    {
+      Error_Handler();
+    }
+
+    __HAL_LINKDMA(huart,hdmarx,hdma_usart2_rx);
+
+    /* USART2_TX Init */
+    hdma_usart2_tx.Instance = DMA1_Stream6;
+    hdma_usart2_tx.Init.Channel = DMA_CHANNEL_4;
+    hdma_usart2_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_usart2_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart2_tx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart2_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart2_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart2_tx.Init.Mode = DMA_NORMAL;
+    hdma_usart2_tx.Init.Priority = DMA_PRIORITY_LOW;
+    hdma_usart2_tx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(&hdma_usart2_tx) != HAL_OK)
+    {
+      Error_Handler();
+    }
+
+    __HAL_LINKDMA(huart,hdmatx,hdma_usart2_tx);
+
+    /* USART2 interrupt Init */
+    HAL_NVIC_EnableIRQ(USART2_IRQn);
   /* USER CODE BEGIN USART2_MspInit 1 */
 
   /* USER CODE END USART2_MspInit 1 */
@@ -181,6 +244,12 @@ void HAL_UART_MspDeInit(UART_HandleTypeDef* huart)
     */
     HAL_GPIO_DeInit(GPIOA, GPIO_PIN_2|GPIO_PIN_3);
 
+    /* USART2 DMA DeInit */
+    HAL_DMA_DeInit(huart->hdmarx);
+    HAL_DMA_DeInit(huart->hdmatx);
+
+    /* USART2 interrupt DeInit */
+    HAL_NVIC_DisableIRQ(USART2_IRQn);
   /* USER CODE BEGIN USART2_MspDeInit 1 */
 
   /* USER CODE END USART2_MspDeInit 1 */
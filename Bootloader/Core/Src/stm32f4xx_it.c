@@ -23,6 +23,14 @@
 #include "stm32f4xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "BL.h"
+#include "BL_Transport.h"
+#include "BL_UART.h"
+#include "BL_Flash.h"
+#include "BL_USB.h"
+#include "BL_SPI.h"
+#include "BL_CAN.h"
+#include "BL_Handoff.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -37,7 +45,26 @@
 
 /* Private macro -------------------------------------------------------------*/
 /* USER CODE BEGIN PM */
-
+/*
+ * FAULT_CAPTURE
+ * -------------
+ * First and only statement of the fault handlers, which are naked (PFP): the
+ * stack still holds the exception frame exactly as the core pushed it.
+ * EXC_RETURN bit 2 names the stack it went to (MSP / PSP); the frame and
+ * EXC_RETURN go to voidFaultCapture, which never returns.
+ */
+#define FAULT_CAPTURE()                __asm volatile("tst   lr, #4            \n\t" \
+                                                      "ite   eq                \n\t" \
+                                                      "mrseq r0, msp           \n\t" \
+                                                      "mrsne r0, psp           \n\t" \
+                                                      "mov   r1, lr            \n\t" \
+                                                      "b     voidFaultCapture  \n\t")
+
+/* RAM a stack may live in: SRAM1 / SRAM2, CCMRAM */
+#define FAULT_SRAM_BASE                0x20000000UL
+#define FAULT_SRAM_END                 0x20020000UL
+#define FAULT_CCMRAM_BASE              0x10000000UL
+#define FAULT_CCMRAM_END               0x10010000UL
 /* USER CODE END PM */
 
 /* Private variables ---------------------------------------------------------*/
@@ -47,15 +74,155 @@
 
 /* Private function prototypes -----------------------------------------------*/
 /* USER CODE BEGIN PFP */
+/* USART2 / DMA / USB handlers run from RAM so reception is serviced during flash operations */
+__RAM_FUNC void DMA1_Stream5_IRQHandler(void);
+__RAM_FUNC void DMA1_Stream6_IRQHandler(void);
+__RAM_FUNC void USART2_IRQHandler(void);
+__RAM_FUNC void FLASH_IRQHandler(void);
+#if (BL_TRANSPORT_USB_ENABLE || BL_USB_MSC_ENABLE)
+__RAM_FUNC void OTG_FS_IRQHandler(void);
+#endif
+
+/* The tick has the highest priority (TICK_INT_PRIORITY 0): from flash, its
+ * first interrupt during an erase would hold off every other one until the
+ * erase ends */
+__RAM_FUNC void SysTick_Handler(void);
+__RAM_FUNC void HAL_IncTick(void);
+
+/* Fault handlers without prologue, see FAULT_CAPTURE */
+void HardFault_Handler(void) __attribute__((naked));
+void MemManage_Handler(void) __attribute__((naked));
+void BusFault_Handler(void) __attribute__((naked));
+void UsageFault_Handler(void) __attribute__((naked));
+
+static void voidFaultCapture(const uint32_t* Copy_puint32Frame, uint32_t Copy_uint32ExcReturn) __attribute__((used, noreturn));
 
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
+/*
+ * uint32_FaultReadableWords
+ * -------------------------
+ * Words that can be read from Copy_uint32Address up to the end of its RAM,
+ * 0 when it is not a word-aligned SRAM / CCMRAM address: a fault handler
+ * must not fault again on a corrupted stack pointer.
+ */
+static uint32_t uint32_FaultReadableWords(uint32_t Copy_uint32Address)
+{
+	uint32_t Local_uint32Words = 0u;
+
+	if((Copy_uint32Address & 3u) == 0u)
+	{
+		if((Copy_uint32Address >= FAULT_SRAM_BASE) && (Copy_uint32Address < FAULT_SRAM_END))
+		{
+			Local_uint32Words = (FAULT_SRAM_END - Copy_uint32Address) / 4u;
+		}
+		else if((Copy_uint32Address >= FAULT_CCMRAM_BASE) && (Copy_uint32Address < FAULT_CCMRAM_END))
+		{
+			Local_uint32Words = (FAULT_CCMRAM_END - Copy_uint32Address) / 4u;
+		}
+	}
+
+	return Local_uint32Words;
+}
 
+/*
+ * voidFaultCapture
+ * ----------------
+ * Saves the crash record (BL_Handoff.h) and resets.
+ *
+ * Behavior:
+ * ---------
+ * 1. Backup SRAM access is set up on the registers: the HAL state may be
+ *    what faulted.
+ * 2. Count carries on from a valid record, every other field is the new fault.
+ * 3. The pre-exception stack pointer is the frame end: 8 words, 26 with the
+ *    FPU state (EXC_RETURN bit 4 clear), one more when the core aligned the
+ *    frame (stacked xPSR bit 9).
+ * 4. Check is written last, then NVIC_SystemReset.
+ */
+static void voidFaultCapture(const uint32_t* Copy_puint32Frame, uint32_t Copy_uint32ExcReturn)
+{
+	volatile BL_CrashRecord_t* Local_pRecord = BL_CRASH_RECORD;
+	volatile uint32_t* Local_puint32Words = (volatile uint32_t*)BL_CRASH_RECORD;
+	uint32_t Local_uint32Count = 0u;
+	uint32_t Local_uint32Check = 0u;
+	uint32_t Local_uint32Sp;
+	uint32_t Local_uint32Words;
+	uint32_t Local_uint32Index;
+
+	RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+	PWR->CR      |= PWR_CR_DBP;
+	RCC->AHB1ENR |= RCC_AHB1ENR_BKPSRAMEN;
+	__DSB();
+
+	for(Local_uint32Index = 0u; Local_uint32Index < BL_CRASH_RECORD_WORDS; Local_uint32Index++)
+	{
+		Local_uint32Check ^= Local_puint32Words[Local_uint32Index];
+	}
+
+	if((Local_pRecord->Magic == BL_CRASH_MAGIC) && (Local_uint32Check == 0xFFFFFFFFUL))
+	{
+		Local_uint32Count = Local_pRecord->Count;
+	}
+
+	for(Local_uint32Index = 0u; Local_uint32Index < BL_CRASH_RECORD_WORDS; Local_uint32Index++)
+	{
+		Local_puint32Words[Local_uint32Index] = 0u;
+	}
+
+	Local_pRecord->Magic     = BL_CRASH_MAGIC;
+	Local_pRecord->Count     = Local_uint32Count + 1u;
+	Local_pRecord->Source    = BL_CRASH_SOURCE_BOOTLOADER;
+	Local_pRecord->Fault     = __get_IPSR() & IPSR_ISR_Msk;
+	Local_pRecord->ExcReturn = Copy_uint32ExcReturn;
+	Local_pRecord->Cfsr      = SCB->CFSR;
+	Local_pRecord->Hfsr      = SCB->HFSR;
+	Local_pRecord->Mmfar     = SCB->MMFAR;
+	Local_pRecord->Bfar      = SCB->BFAR;
+	Local_pRecord->Cycles    = DWT->CYCCNT;
+
+	if(uint32_FaultReadableWords((uint32_t)Copy_puint32Frame) >= BL_CRASH_REGISTERS)
+	{
+		for(Local_uint32Index = 0u; Local_uint32Index < BL_CRASH_REGISTERS; Local_uint32Index++)
+		{
+			Local_pRecord->Registers[Local_uint32Index] = Copy_puint32Frame[Local_uint32Index];
+		}
+
+		Local_uint32Sp  = (uint32_t)Copy_puint32Frame + (((Copy_uint32ExcReturn & 0x10u) == 0u) ? 0x68u : 0x20u);
+		Local_uint32Sp += ((Copy_puint32Frame[7] & (1UL << 9)) != 0u) ? 4u : 0u;
+		Local_pRecord->Sp = Local_uint32Sp;
+
+		Local_uint32Words = uint32_FaultReadableWords(Local_uint32Sp);
+		Local_uint32Words = (Local_uint32Words > BL_CRASH_STACK_WORDS) ? BL_CRASH_STACK_WORDS : Local_uint32Words;
+		for(Local_uint32Index = 0u; Local_uint32Index < Local_uint32Words; Local_uint32Index++)
+		{
+			Local_pRecord->Stack[Local_uint32Index] = ((const uint32_t*)Local_uint32Sp)[Local_uint32Index];
+		}
+		Local_pRecord->StackWords = Local_uint32Words;
+	}
+	else
+	{
+		Local_pRecord->Sp = (uint32_t)Copy_puint32Frame;
+	}
+
+	Local_uint32Check = 0u;
+	for(Local_uint32Index = 0u; Local_uint32Index < (BL_CRASH_RECORD_WORDS - 1u); Local_uint32Index++)
+	{
+		Local_uint32Check ^= Local_puint32Words[Local_uint32Index];
+	}
+	Local_pRecord->Check = ~Local_uint32Check;
+
+	__DSB();
+	NVIC_SystemReset();
+}
 /* USER CODE END 0 */
 
 /* External variables --------------------------------------------------------*/
+extern DMA_HandleTypeDef hdma_usart2_rx;
+extern DMA_HandleTypeDef hdma_usart2_tx;
+extern UART_HandleTypeDef huart2;
 
 /* USER CODE BEGIN EV */
 
@@ -83,7 +250,7 @@ void NMI_Handler(void)
 void HardFault_Handler(void)
 {
   /* USER CODE BEGIN HardFault_IRQn 0 */
-
+  FAULT_CAPTURE();
   /* USER CODE END HardFault_IRQn 0 */
   while (1)
   {
@@ -98,7 +265,7 @@ void HardFault_Handler(void)
 void MemManage_Handler(void)
 {
   /* USER CODE BEGIN MemoryManagement_IRQn 0 */
-
+  FAULT_CAPTURE();
   /* USER CODE END MemoryManagement_IRQn 0 */
   while (1)
   {
@@ -113,7 +280,7 @@ void MemManage_Handler(void)
 void BusFault_Handler(void)
 {
   /* USER CODE BEGIN BusFault_IRQn 0 */
-
+  FAULT_CAPTURE();
   /* USER CODE END BusFault_IRQn 0 */
   while (1)
   {
@@ -128,7 +295,7 @@ void BusFault_Handler(void)
 void UsageFault_Handler(void)
 {
   /* USER CODE BEGIN UsageFault_IRQn 0 */
-
+  FAULT_CAPTURE();
   /* USER CODE END UsageFault_IRQn 0 */
   while (1)
   {
@@ -186,6 +353,7 @@ void SysTick_Handler(void)
   /* USER CODE END SysTick_IRQn 0 */
   HAL_IncTick();
   /* USER CODE BEGIN SysTick_IRQn 1 */
+  BL_voidSessionTick();
 
   /* USER CODE END SysTick_IRQn 1 */
 }
@@ -197,7 +365,111 @@ void SysTick_Handler(void)
 /* please refer to the startup file (startup_stm32f4xx.s).                    */
 /******************************************************************************/
 
+/**
+  * @brief This function handles DMA1 stream5 global interrupt.
+  */
+void DMA1_Stream5_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA1_Stream5_IRQn 0 */
+
+  /* USER CODE END DMA1_Stream5_IRQn 0 */
+  BL_voidUARTRxDmaIRQHandler();
+  /* USER CODE BEGIN DMA1_Stream5_IRQn 1 */
+
+  /* USER CODE END DMA1_Stream5_IRQn 1 */
+}
+
+/**
+  * @brief This function handles DMA1 stream6 global interrupt.
+  */
+void DMA1_Stream6_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA1_Stream6_IRQn 0 */
+
+  /* USER CODE END DMA1_Stream6_IRQn 0 */
+  BL_voidUARTTxDmaIRQHandler();
+  /* USER CODE BEGIN DMA1_Stream6_IRQn 1 */
+
+  /* USER CODE END DMA1_Stream6_IRQn 1 */
+}
+
+/**
+  * @brief This function handles USART2 global interrupt.
+  */
+void USART2_IRQHandler(void)
+{
+  /* USER CODE BEGIN USART2_IRQn 0 */
+
+  /* USER CODE END USART2_IRQn 0 */
+  BL_voidUARTIRQHandler();
+  /* USER CODE BEGIN USART2_IRQn 1 */
+
+  /* USER CODE END USART2_IRQn 1 */
+}
+
 /* USER CODE BEGIN 1 */
+/**
+  * @brief Replaces the HAL's weak HAL_IncTick, which is in flash.
+  */
+void HAL_IncTick(void)
+{
+  uwTick += uwTickFreq;
+}
+
+/**
+  * @brief This function handles Flash global interrupt (end of a background sector erase).
+  */
+void FLASH_IRQHandler(void)
+{
+  BL_voidFlashIRQHandler();
+}
+
+#if (BL_TRANSPORT_USB_ENABLE || BL_USB_MSC_ENABLE)
+/**
+  * @brief This function handles USB On The Go FS global interrupt.
+  */
+void OTG_FS_IRQHandler(void)
+{
+  BL_voidUSBIRQHandler();
+}
+#endif
+
+#if BL_TRANSPORT_SPI_ENABLE
+/**
+  * @brief This function handles EXTI line[15:10] interrupts (SPI1 NSS on PA15).
+  */
+void EXTI15_10_IRQHandler(void)
+{
+  __HAL_GPIO_EXTI_CLEAR_IT(BL_SPI_NSS_PIN);
+  BL_voidSPINssIRQHandler();
+}
+#endif
+
+#if BL_TRANSPORT_CAN_ENABLE
+/**
+  * @brief This function handles CAN1 RX0 interrupt (unicast frames).
+  */
+void CAN1_RX0_IRQHandler(void)
+{
+  BL_voidCANRxIRQHandler(0u);
+}
+
+/**
+  * @brief This function handles CAN1 RX1 interrupt (group frames).
+  */
+void CAN1_RX1_IRQHandler(void)
+{
+  BL_voidCANRxIRQHandler(1u);
+}
+
+/**
+  * @brief This function handles CAN1 TX interrupt.
+  */
+void CAN1_TX_IRQHandler(void)
+{
+  BL_voidCANTxIRQHandler();
+}
+#endif
 
 /* USER CODE END 1 */
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
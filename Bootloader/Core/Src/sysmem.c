@@ -24,6 +24,7 @@
 /* Includes */
 #include <errno.h>
 #include <stdint.h>
+#include "MemoryUsage.h"
 
 /**
  * Pointer to the current high watermark of the heap usage
@@ -44,7 +45,9 @@ static uint8_t *__sbrk_heap_end = NULL;
  *
  * This implementation starts allocating at the '_end' linker symbol
  * The '_Min_Stack_Size' linker symbol reserves a memory for the MSP stack
- * The implementation considers '_estack' linker symbol to be RAM end
+ * The implementation considers '_heap_limit' linker symbol to be the heap end:
+ * '_estack' - '_Min_Stack_Size', or RAM end with the stack in CCMRAM
+ * ('_Stack_In_CCMRAM')
  * NOTE: If the MSP stack, at any point during execution, grows larger than the
  * reserved size, please increase the '_Min_Stack_Size'.
  *
@@ -54,10 +57,8 @@ static uint8_t *__sbrk_heap_end = NULL;
 void *_sbrk(ptrdiff_t incr)
 {
   extern uint8_t _end; /* Symbol defined in the linker script */
-  extern uint8_t _estack; /* Symbol defined in the linker script */
-  extern uint32_t _Min_Stack_Size; /* Symbol defined in the linker script */
-  const uint32_t stack_limit = (uint32_t)&_estack - (uint32_t)&_Min_Stack_Size;
-  const uint8_t *max_heap = (uint8_t *)stack_limit;
+  extern uint8_t _heap_limit; /* Symbol defined in the linker script */
+  const uint8_t *max_heap = &_heap_limit;
   uint8_t *prev_heap_end;
 
   /* Initalize heap end at first call */
@@ -78,3 +79,33 @@ void *_sbrk(ptrdiff_t incr)
 
   return (void *)prev_heap_end;
 }
+
+/**
+ * @brief Memory_GetUsage() reports the stack and heap high-water marks
+ *        (MemoryUsage.h)
+ *
+ * The startup painted '_estack' - '_Min_Stack_Size' up to '_estack' with
+ * MEMORY_STACK_PAINT: the stack reached down to the lowest word changed.
+ *
+ * @param usage Filled with the marks
+ */
+void Memory_GetUsage(MemoryUsage_t *usage)
+{
+  extern uint8_t _end; /* Symbol defined in the linker script */
+  extern uint8_t _heap_limit; /* Symbol defined in the linker script */
+  extern uint8_t _estack; /* Symbol defined in the linker script */
+  extern uint8_t _Min_Stack_Size; /* Symbol defined in the linker script */
+  const uint32_t *word = (const uint32_t *)(&_estack - (uint32_t)&_Min_Stack_Size);
+  const uint32_t *top = (const uint32_t *)&_estack;
+  const uint8_t *heap_end = __sbrk_heap_end;
+
+  while ((word < top) && (*word == MEMORY_STACK_PAINT))
+  {
+    word++;
+  }
+
+  usage->StackPeak = (uint32_t)((const uint8_t *)top - (const uint8_t *)word);
+  usage->StackSize = (uint32_t)&_Min_Stack_Size;
+  usage->HeapPeak = (NULL == heap_end) ? 0u : (uint32_t)(heap_end - &_end);
+  usage->HeapSize = (uint32_t)(&_heap_limit - &_end);
+}
@@ -0,0 +1,44 @@
+#ifndef INC_MEMORYUSAGE_H_
+#define INC_MEMORYUSAGE_H_
+
+#include <stdint.h>
+
+/*
+ * Stack And Heap High-Water Marks
+ * -------------------------------
+ * How much of their RAM reserves the Bootloader and the UserApp have ever
+ * used since reset, to size _Min_Stack_Size, _Min_Heap_Size and the pools
+ * from a real run instead of guessing, shared by both projects:
+ *  - the startup paints the main stack's reservation, _Min_Stack_Size
+ *    bytes below _estack, with MEMORY_STACK_PAINT before main. The stack
+ *    grows down from _estack: the lowest word no longer holding the
+ *    pattern is as deep as it ever went, interrupts included (they all run
+ *    on the main stack). Overwritten down to the bottom word: at least the
+ *    whole reservation, and possibly past it,
+ *  - the heap's mark is how far _sbrk (sysmem.c) has ever moved from _end.
+ *    The UserApp serves malloc from its pools (App_Pool.h), whose
+ *    high-water marks App_PoolGetStats reports; _sbrk stays at 0 there
+ *    unless something bypasses them.
+ * Memory_GetUsage scans at most _Min_Stack_Size bytes: a few microseconds.
+ * Each sysmem.c implements it, the host simulation its own (Host/sim).
+ */
+#define MEMORY_STACK_PAINT           0x5354434BUL   /* "STCK", also in startup_stm32f407vgtx.s */
+
+typedef struct
+{
+	uint32_t StackPeak;                        /* Bytes below _estack ever written */
+	uint32_t StackSize;                        /* _Min_Stack_Size */
+	uint32_t HeapPeak;                         /* Bytes _sbrk has ever handed out */
+	uint32_t HeapSize;                         /* _heap_limit - _end */
+} MemoryUsage_t;
+
+
+/*
+ * Memory Usage Functions
+ * ----------------------
+ */
+
+void     Memory_GetUsage(MemoryUsage_t* Usage);                          /* The marks so far, from any context */
+
+
+#endif /* INC_MEMORYUSAGE_H_ */
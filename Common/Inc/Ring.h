@@ -0,0 +1,213 @@
+#ifndef INC_RING_H_
+#define INC_RING_H_
+
+#include <stdint.h>
+
+/*
+ * Single-Producer Single-Consumer Ring
+ * ------------------------------------
+ * The queue between one interrupt (or DMA callback) and one task, shared by
+ * the Bootloader and the UserApp: Common/Inc is on the include path of both
+ * projects. One side only ever writes, the other only ever reads, and
+ * neither masks interrupts:
+ *  - Count slots of Stride bytes in a buffer the caller places (SRAM for
+ *    DMA, CCMRAM otherwise). Count is a power of two: Head and Tail are
+ *    free-running element counts, wrapped with the mask only to address the
+ *    buffer, so Head - Tail is the fill level and every slot is usable,
+ *  - Head is stored by the producer only, Tail by the consumer only. Each
+ *    side stores its index with release semantics once it is done with the
+ *    slots, and loads the other's with acquire semantics before it touches
+ *    them (__atomic builtins: a DMB around the access on the Cortex-M4, the
+ *    host's own barriers on a host build),
+ *  - Ring_WriteSpan / Ring_ReadSpan give the contiguous run of free / filled
+ *    slots at Head / Tail, for a DMA transfer or a copy straight into or
+ *    out of the buffer; Ring_Commit / Ring_Release then publish it.
+ *    Ring_Write / Ring_Read do the copy, in at most two spans.
+ * Everything is forced inline and copies without memcpy, so it also runs
+ * from RAM code (__RAM_FUNC) while the flash is busy, at any optimisation
+ * level. Ring_Init with both sides stopped only.
+ */
+
+#define RING_INLINE                  static inline __attribute__((always_inline))
+
+/* Static initialiser of an empty ring, instead of Ring_Init; COUNT a power of two */
+#define RING_INIT(BUFFER, COUNT, STRIDE)  { (uint8_t*)(BUFFER), (COUNT) - 1u, (STRIDE), 0u, 0u }
+
+typedef struct
+{
+	uint8_t* Data;
+	uint32_t Mask;                             /* Count - 1 */
+	uint32_t Stride;                           /* Bytes per slot */
+	uint32_t Head;                             /* Slots written, producer only */
+	uint32_t Tail;                             /* Slots read, consumer only */
+} Ring_t;
+
+
+/* 1: ring empty over Copy_uint32Count slots, 0: Count not a power of two */
+RING_INLINE uint8_t Ring_Init(Ring_t* Copy_pRing, void* Copy_pvBuffer, uint32_t Copy_uint32Count, uint32_t Copy_uint32Stride)
+{
+	if((Copy_uint32Count == 0u) || ((Copy_uint32Count & (Copy_uint32Count - 1u)) != 0u) || (Copy_uint32Count > 0x80000000u))
+	{
+		return 0u;
+	}
+
+	Copy_pRing->Data   = (uint8_t*)Copy_pvBuffer;
+	Copy_pRing->Mask   = Copy_uint32Count - 1u;
+	Copy_pRing->Stride = Copy_uint32Stride;
+	__atomic_store_n(&Copy_pRing->Head, 0u, __ATOMIC_RELEASE);
+	__atomic_store_n(&Copy_pRing->Tail, 0u, __ATOMIC_RELEASE);
+
+	return 1u;
+}
+
+
+/* Filled slots; exact on the consumer side, a lower bound on the producer's */
+RING_INLINE uint32_t Ring_Used(const Ring_t* Copy_pRing)
+{
+	uint32_t Local_uint32Tail = __atomic_load_n(&Copy_pRing->Tail, __ATOMIC_ACQUIRE);
+
+	return __atomic_load_n(&Copy_pRing->Head, __ATOMIC_ACQUIRE) - Local_uint32Tail;
+}
+
+
+/* Free slots; exact on the producer side, a lower bound on the consumer's */
+RING_INLINE uint32_t Ring_Free(const Ring_t* Copy_pRing)
+{
+	uint32_t Local_uint32Head = __atomic_load_n(&Copy_pRing->Head, __ATOMIC_ACQUIRE);
+
+	return (Copy_pRing->Mask + 1u) - (Local_uint32Head - __atomic_load_n(&Copy_pRing->Tail, __ATOMIC_ACQUIRE));
+}
+
+
+/*
+ * Ring_WriteSpan
+ * --------------
+ * Producer: the free slots from Head up to the end of the buffer (or to
+ * Tail), *Copy_puint32Count of them. Filled, they are published by
+ * Ring_Commit.
+ */
+RING_INLINE void* Ring_WriteSpan(Ring_t* Copy_pRing, uint32_t* Copy_puint32Count)
+{
+	uint32_t Local_uint32Head   = __atomic_load_n(&Copy_pRing->Head, __ATOMIC_RELAXED);
+	uint32_t Local_uint32Free   = (Copy_pRing->Mask + 1u) - (Local_uint32Head - __atomic_load_n(&Copy_pRing->Tail, __ATOMIC_ACQUIRE));
+	uint32_t Local_uint32Offset = Local_uint32Head & Copy_pRing->Mask;
+	uint32_t Local_uint32First  = (Copy_pRing->Mask + 1u) - Local_uint32Offset;
+
+	*Copy_puint32Count = (Local_uint32First < Local_uint32Free) ? Local_uint32First : Local_uint32Free;
+
+	return &Copy_pRing->Data[Local_uint32Offset * Copy_pRing->Stride];
+}
+
+
+/* Producer: Copy_uint32Count slots at Head are filled, the consumer may have them */
+RING_INLINE void Ring_Commit(Ring_t* Copy_pRing, uint32_t Copy_uint32Count)
+{
+	__atomic_store_n(&Copy_pRing->Head, __atomic_load_n(&Copy_pRing->Head, __ATOMIC_RELAXED) + Copy_uint32Count, __ATOMIC_RELEASE);
+}
+
+
+/*
+ * Ring_ReadSpan
+ * -------------
+ * Consumer: the filled slots from Tail up to the end of the buffer (or to
+ * Head), *Copy_puint32Count of them. Done with, they go back to the
+ * producer by Ring_Release.
+ */
+RING_INLINE const void* Ring_ReadSpan(const Ring_t* Copy_pRing, uint32_t* Copy_puint32Count)
+{
+	uint32_t Local_uint32Tail   = __atomic_load_n(&Copy_pRing->Tail, __ATOMIC_RELAXED);
+	uint32_t Local_uint32Used   = __atomic_load_n(&Copy_pRing->Head, __ATOMIC_ACQUIRE) - Local_uint32Tail;
+	uint32_t Local_uint32Offset = Local_uint32Tail & Copy_pRing->Mask;
+	uint32_t Local_uint32First  = (Copy_pRing->Mask + 1u) - Local_uint32Offset;
+
+	*Copy_puint32Count = (Local_uint32First < Local_uint32Used) ? Local_uint32First : Local_uint32Used;
+
+	return &Copy_pRing->Data[Local_uint32Offset * Copy_pRing->Stride];
+}
+
+
+/* Consumer: the slot Copy_uint32Offset after Tail, which must be filled */
+RING_INLINE const void* Ring_Peek(const Ring_t* Copy_pRing, uint32_t Copy_uint32Offset)
+{
+	return &Copy_pRing->Data[((__atomic_load_n(&Copy_pRing->Tail, __ATOMIC_RELAXED) + Copy_uint32Offset) & Copy_pRing->Mask) * Copy_pRing->Stride];
+}
+
+
+/* Consumer: Copy_uint32Count slots at Tail are read, the producer may refill them */
+RING_INLINE void Ring_Release(Ring_t* Copy_pRing, uint32_t Copy_uint32Count)
+{
+	__atomic_store_n(&Copy_pRing->Tail, __atomic_load_n(&Copy_pRing->Tail, __ATOMIC_RELAXED) + Copy_uint32Count, __ATOMIC_RELEASE);
+}
+
+
+/* Byte copy; the empty asm keeps the compiler from turning the loop back into a memcpy call */
+RING_INLINE void Ring_Copy(uint8_t* Copy_puint8To, const uint8_t* Copy_puint8From, uint32_t Copy_uint32Length)
+{
+	while(Copy_uint32Length != 0u)
+	{
+		*Copy_puint8To++ = *Copy_puint8From++;
+		Copy_uint32Length--;
+		__asm__("" : "+r" (Copy_uint32Length));
+	}
+}
+
+
+/* Producer: copies in and commits up to Copy_uint32Count slots, returns how many */
+RING_INLINE uint32_t Ring_Write(Ring_t* Copy_pRing, const void* Copy_pvData, uint32_t Copy_uint32Count)
+{
+	const uint8_t* Local_puint8Data = (const uint8_t*)Copy_pvData;
+	uint32_t Local_uint32Done = 0u;
+	uint32_t Local_uint32Span;
+	uint8_t* Local_puint8Slot;
+
+	while(Local_uint32Done < Copy_uint32Count)
+	{
+		Local_puint8Slot = (uint8_t*)Ring_WriteSpan(Copy_pRing, &Local_uint32Span);
+		if(Local_uint32Span == 0u)
+		{
+			break;
+		}
+		if(Local_uint32Span > (Copy_uint32Count - Local_uint32Done))
+		{
+			Local_uint32Span = Copy_uint32Count - Local_uint32Done;
+		}
+
+		Ring_Copy(Local_puint8Slot, &Local_puint8Data[Local_uint32Done * Copy_pRing->Stride], Local_uint32Span * Copy_pRing->Stride);
+		Ring_Commit(Copy_pRing, Local_uint32Span);
+		Local_uint32Done += Local_uint32Span;
+	}
+
+	return Local_uint32Done;
+}
+
+
+/* Consumer: copies out and releases up to Copy_uint32Count slots, returns how many */
+RING_INLINE uint32_t Ring_Read(Ring_t* Copy_pRing, void* Copy_pvData, uint32_t Copy_uint32Count)
+{
+	uint8_t* Local_puint8Data = (uint8_t*)Copy_pvData;
+	uint32_t Local_uint32Done = 0u;
+	uint32_t Local_uint32Span;
+	const uint8_t* Local_puint8Slot;
+
+	while(Local_uint32Done < Copy_uint32Count)
+	{
+		Local_puint8Slot = (const uint8_t*)Ring_ReadSpan(Copy_pRing, &Local_uint32Span);
+		if(Local_uint32Span == 0u)
+		{
+			break;
+		}
+		if(Local_uint32Span > (Copy_uint32Count - Local_uint32Done))
+		{
+			Local_uint32Span = Copy_uint32Count - Local_uint32Done;
+		}
+
+		Ring_Copy(&Local_puint8Data[Local_uint32Done * Copy_pRing->Stride], Local_puint8Slot, Local_uint32Span * Copy_pRing->Stride);
+		Ring_Release(Copy_pRing, Local_uint32Span);
+		Local_uint32Done += Local_uint32Span;
+	}
+
+	return Local_uint32Done;
+}
+
+
+#endif /* INC_RING_H_ */
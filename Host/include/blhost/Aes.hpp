@@ -0,0 +1,59 @@
+#ifndef BLHOST_AES_HPP
+#define BLHOST_AES_HPP
+
+/*
+ * Aes
+ * ---
+ * The AES-CTR cipher of encrypted sessions ("Encrypted Session" in BL.h):
+ * AES-128 or AES-256 by key size, keystream block n the encryption of the
+ * initial counter block with n added to its last four bytes (big endian,
+ * modulo 2^32). Byte n of the target range is encrypted with keystream byte
+ * n, so apply works on any piece of the image from its offset; encryption
+ * and decryption are the same operation.
+ *
+ * A plain byte-oriented AES: the host encrypts an image once, at tens of
+ * MB/s, far ahead of any link.
+ */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace blhost
+{
+
+constexpr std::size_t kAesBlockSize   = 16;
+constexpr std::size_t kAesCounterSize = 16;    /* BL_SESSION_COUNTER_SIZE */
+
+using AesCounter = std::array<std::uint8_t, kAesCounterSize>;
+
+class AesCtr
+{
+public:
+	/* Throws std::invalid_argument unless the key is 16 or 32 bytes */
+	AesCtr(const std::vector<std::uint8_t>& key, const AesCounter& counter);
+
+	/* XORs the keystream into data, the first byte at offset in the range */
+	void apply(std::size_t offset, std::uint8_t* data, std::size_t size) const;
+
+	const AesCounter& counter() const { return counter_; }
+
+	/* 12 random bytes and a zero block count: a new counter block per update */
+	static AesCounter randomCounter();
+
+	/* A raw 16- or 32-byte key file; throws std::runtime_error otherwise */
+	static std::vector<std::uint8_t> loadKey(const std::string& path);
+
+private:
+	void encryptBlock(const std::uint8_t* input, std::uint8_t* output) const;
+
+	std::array<std::uint8_t, 16 * 15> roundKeys_ {};
+	unsigned                         rounds_ = 0;
+	AesCounter                       counter_;
+};
+
+}
+
+#endif /* BLHOST_AES_HPP */
@@ -0,0 +1,54 @@
+#ifndef BLHOST_BATCH_HPP
+#define BLHOST_BATCH_HPP
+
+/*
+ * Batch
+ * -----
+ * Flashes the same image into several boards at once, one port each. Every
+ * board gets its own SerialPort, Engine (with its I/O thread) and a worker
+ * thread running Flasher::writeStream (or writeViaRam), so the boards run side by side and a
+ * slow or failing one never holds up the others. The image is only read, so
+ * all workers share one buffer (typically a MappedFile).
+ *
+ * With a log directory, each board writes <dir>/<port name>.log: the start,
+ * progress every 10 %, the stream tuner's decisions, retransmissions and
+ * the result.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "blhost/Engine.hpp"
+#include "blhost/Flasher.hpp"
+
+namespace blhost
+{
+
+struct BatchOptions
+{
+	unsigned        baud        = 115200;
+	bool            flowControl = false;
+	Engine::Options engine;
+	StreamOptions   stream;
+	std::string     logDirectory;      /* Empty: no per-board log */
+	bool            viaRam      = false;   /* Flasher::writeViaRam: the link fills SRAM while the flash programs */
+};
+
+struct BoardResult
+{
+	std::string port;
+	bool        ok              = false;
+	std::string error;                 /* Empty when ok */
+	int         status          = -1;  /* FlashError::status() of the failure */
+	double      seconds         = 0.0;
+	unsigned    retransmissions = 0;
+};
+
+/* Returns when every board is done, in the order of ports */
+std::vector<BoardResult> flashBoards(const std::vector<std::string>& ports, std::uint32_t address,
+                                     const std::uint8_t* image, std::size_t size, const BatchOptions& options);
+
+}
+
+#endif /* BLHOST_BATCH_HPP */
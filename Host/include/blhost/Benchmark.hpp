@@ -0,0 +1,80 @@
+#ifndef BLHOST_BENCHMARK_HPP
+#define BLHOST_BENCHMARK_HPP
+
+/*
+ * Benchmark
+ * ---------
+ * Fixed measurement matrix of a bootloader, for trending across versions:
+ *
+ * latency     Round trip of every opcode that leaves the device as it was:
+ *             GET_VERSION .. GET_TRACE, a 4-byte MEM_READ and
+ *             VERIFY_RANGE, a FLASH_ERASE_STATUS poll, an empty
+ *             BEGIN_PROGRAM / END_PROGRAM (which drops a resumable session
+ *             saved in backup SRAM). Opcodes that erase, protect,
+ *             jump or reconfigure the link are measured by the rows below
+ *             or not at all. A build without an opcode gives a "nack" row.
+ * link        The link alone, no flash (kFeatureLinkTest): BL_ECHO replies
+ *             (download, and both ways at once) and BL_SINK frames sent
+ *             back to back (upload), per frame size. A row also counts
+ *             the CRC errors the device saw.
+ * mem_write   Stop-and-wait BL_MEM_WRITE throughput per payload size.
+ * stream      BL_MEM_WRITE_STREAM throughput, fixed window and packet.
+ * verify      BL_VERIFY_RANGE over the whole scratch sector.
+ * erase       BL_FLASH_ERASE of the scratch sector (programmed first, a
+ *             blank sector is skipped by the device) and of every extra
+ *             sector the caller allows, one row per sector.
+ * update      Flasher::execute of a plan, when one is given.
+ *
+ * Everything that writes stays in the scratch sector (default 11, 128 KB),
+ * which ends erased. Times are host-side, so every row includes the link.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "blhost/Flasher.hpp"
+
+namespace blhost
+{
+
+struct BenchOptions
+{
+	unsigned              scratchSector = 11;
+	unsigned              iterations    = 20;     /* Samples per latency row */
+	std::vector<unsigned> eraseSectors;           /* Also erased and timed: their contents are lost */
+	const Plan*           plan          = nullptr;
+	LogCallback           log;                    /* One line per finished row */
+};
+
+struct BenchResult
+{
+	std::string test;
+	std::string parameter;
+	unsigned    samples        = 0;
+	double      minUs          = 0.0;
+	double      medianUs       = 0.0;
+	double      p95Us          = 0.0;
+	double      maxUs          = 0.0;
+	std::size_t bytes          = 0;      /* Per sample, 0 for latency rows */
+	double      bytesPerSecond = 0.0;    /* bytes / median */
+	std::string status         = "ok";   /* "nack", or the FlashError text */
+};
+
+struct BenchReport
+{
+	unsigned                 bootloaderVersion = 0;
+	std::uint16_t            chipId            = 0;
+	std::string              uniqueId;
+	unsigned                 baud              = 0;
+	std::vector<BenchResult> results;
+};
+
+BenchReport runBenchmarks(Engine& engine, Flasher& flasher, const BenchOptions& options);
+
+std::string benchCsv(const BenchReport& report);
+std::string benchJson(const BenchReport& report);
+
+}
+
+#endif /* BLHOST_BENCHMARK_HPP */
@@ -0,0 +1,104 @@
+#ifndef BLHOST_BLOCKSTORE_HPP
+#define BLHOST_BLOCKSTORE_HPP
+
+/*
+ * BlockStore
+ * ----------
+ * Content-addressed store of the 4 KB blocks of every firmware version
+ * shipped, under one directory:
+ *
+ *   DIR/blocks/<crc>-<n>       4096 bytes; crc the word-wise CRC-32 of the
+ *                              block as BL_BLOCK_CRC_MANIFEST computes it,
+ *                              n tells apart blocks that share a CRC
+ *   DIR/versions/<name>        "blhost version 1", "address", then one
+ *                              "block <key>" line per block
+ *
+ * A version is its image flattened from the 4 KB block below its lowest
+ * address to the block above its highest one, gaps and padding 0xFF (the
+ * erased flash a programmed image leaves there). A block shared by any
+ * number of versions is kept once; a CRC match is always confirmed on the
+ * bytes before a block is reused.
+ *
+ * identify() asks the device for its block manifest (one BLOCK_CRC_MANIFEST
+ * per base address, a few round trips) and ranks the stored versions by the
+ * blocks the device holds: the installed version is known from the flash
+ * itself, whatever version string it reports. delta() then compares two
+ * versions block by block from their block lists alone, without reading
+ * either image: the blocks to send, those the installed version already has
+ * elsewhere, and the sectors a plan can leave alone
+ * (PlanOptions::unchangedSectors).
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace blhost
+{
+
+class Flasher;
+class Image;
+
+struct StoredVersion
+{
+	std::string                name;
+	std::uint32_t              address = 0;   /* First block, 4 KB aligned */
+	std::vector<std::string>   blocks;        /* Keys, in address order */
+	std::vector<std::uint32_t> crcs;          /* Per block, as the device reports it */
+
+	std::uint32_t end() const { return address + static_cast<std::uint32_t>(blocks.size()) * 4096u; }
+};
+
+struct VersionMatch
+{
+	std::string name;
+	std::size_t matching = 0;   /* Blocks the device holds */
+	std::size_t blocks   = 0;
+
+	bool exact() const { return matching == blocks; }
+};
+
+struct BlockDelta
+{
+	std::vector<std::size_t> changed;            /* Target blocks that differ from the installed ones at their address */
+	std::size_t              moved    = 0;       /* Of those, blocks the installed version holds elsewhere */
+	std::size_t              newBytes = 0;       /* Bytes of blocks in no installed block */
+	std::uint16_t            unchangedSectors = 0;  /* Bit n: every target block in sector n is already there */
+};
+
+class BlockStore
+{
+public:
+	static constexpr std::uint32_t kBlockSize = 4096;
+
+	/* Creates the directories when missing; throws std::runtime_error */
+	explicit BlockStore(std::string directory);
+
+	/* Stores the image's blocks and its version file (replacing one of that name); newBlocks: blocks not stored before */
+	StoredVersion add(const std::string& name, const Image& image, std::size_t* newBlocks = nullptr);
+
+	/* nullopt for an unknown or unreadable version */
+	std::optional<StoredVersion> version(const std::string& name) const;
+
+	/* Names, sorted */
+	std::vector<std::string> versions() const;
+
+	/* The block's bytes; throws std::runtime_error for a missing one */
+	std::vector<std::uint8_t> block(const std::string& key) const;
+
+	/* Every stored version, best match first */
+	std::vector<VersionMatch> identify(Flasher& flasher) const;
+
+	BlockDelta delta(const StoredVersion& installed, const StoredVersion& target) const;
+
+private:
+	std::string storeBlock(const std::uint8_t* data, std::uint32_t crc, bool& added);
+
+	std::string directory_;
+};
+
+}
+
+#endif /* BLHOST_BLOCKSTORE_HPP */
@@ -0,0 +1,71 @@
+#ifndef BLHOST_CODEC_HPP
+#define BLHOST_CODEC_HPP
+
+/*
+ * Codec
+ * -----
+ * How an image goes over the link, chosen per image: raw by
+ * BL_MEM_WRITE_STREAM, or LZ-compressed by BL_MEM_WRITE_LZ (Lz.hpp), which
+ * the device decodes as it arrives. chooseCodec compresses the image once,
+ * timing the encoder, and predicts both transfers:
+ *
+ *   raw  max(wire bytes / link rate, size / write rate) + one round trip
+ *        (the stream is pipelined: the link and the flash overlap)
+ *   lz   compressed wire bytes / link rate + size / decode rate
+ *        + size / write rate + one round trip per packet (stop-and-wait)
+ *
+ * Wire bytes count the packet headers and frame overhead. The decode rate
+ * (and, when known, the write rate) is the device's own from
+ * GET_CAPABILITIES version 2; without a decode rate LZ is not considered,
+ * Flasher::probeLz measures one. A write rate of 0 drops its term. The
+ * erase is the same either way and left out.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace blhost
+{
+
+enum class Codec
+{
+	Raw,
+	Lz,
+};
+
+const char* codecName(Codec codec);
+
+struct LinkModel
+{
+	double        bytesPerSecond   = 11520.0;  /* Line rate, baud / 10 on a UART (8N1) */
+	double        roundTripSeconds = 0.002;    /* Short request to its reply */
+	std::size_t   packetSize       = 1024;     /* Data bytes per packet */
+	std::uint32_t decodeRate       = 0;        /* Capabilities::lzDecodeRate, 0 = LZ not considered */
+	std::uint32_t writeRate        = 0;        /* Image bytes / s of the flash write path, 0 = unknown */
+};
+
+struct CodecEstimate
+{
+	Codec       codec          = Codec::Raw;
+	std::size_t wireBytes      = 0;      /* Data, packet headers and frame overhead */
+	double      seconds        = 0.0;    /* Predicted transfer time */
+	double      bytesPerSecond = 0.0;    /* Image bytes / seconds */
+};
+
+struct CodecChoice
+{
+	Codec                      codec = Codec::Raw;
+	std::vector<CodecEstimate> estimates;              /* Raw, then LZ when considered */
+	std::vector<std::uint8_t>  stream;                 /* lzCompress of the image, empty without LZ */
+	double                     compressSeconds = 0.0;  /* Host encoder time */
+
+	const CodecEstimate& chosen() const;
+};
+
+/* lz: the bootloader has kCapsCodecWriteLz; without it the image is not compressed and raw is chosen */
+CodecChoice chooseCodec(const std::uint8_t* image, std::size_t size, const LinkModel& link, bool lz);
+
+}
+
+#endif /* BLHOST_CODEC_HPP */
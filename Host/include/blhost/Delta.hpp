@@ -0,0 +1,77 @@
+#ifndef BLHOST_DELTA_HPP
+#define BLHOST_DELTA_HPP
+
+/*
+ * Delta
+ * -----
+ * BL_MEM_WRITE_DELTA patches ("Delta Write" in BL.h): the bsdiff record
+ * stream that rebuilds a new image from the one installed.
+ *
+ * makeDelta sorts the suffixes of the installed image once (prefix
+ * doubling, one radix pass per doubling), then cuts the new image into
+ * chunks searched side by side, one thread per core by default: each chunk
+ * runs Percival's bsdiff scan on its own (approximate matches grown forward
+ * and backward, overlaps split where they score best), and the records of
+ * all chunks are joined by recomputing the seek between neighbours. A chunk
+ * starts without the previous one's offset, which costs a few bytes per
+ * chunk against one sequential scan.
+ *
+ * Two options make the patch smaller; the bootloader must list what a
+ * patch uses (BL_CAPS_CODEC_DELTA_xxx):
+ *  - thumb: both images are BL-filtered first (BL_DELTA_FLAG_THUMB): every
+ *    Thumb-2 BL holds its absolute target, so the calls to a function that
+ *    moved become the same bytes at every call site, the way BCJ filters
+ *    work for x86 code. Which wins depends on the change: a function moved
+ *    or relinked favours the filter, code inserted before everything else
+ *    the raw offsets (only the calls across it change). Best, the default,
+ *    makes both patches and keeps the smaller,
+ *  - compress: the record stream, mostly zero diff bytes, is LZ-compressed
+ *    for the bootloader's 4 KB window (BL_DELTA_FLAG_LZ, Lz.hpp), and kept
+ *    as it is when that is not smaller.
+ *
+ * Every patch is applied on the host (applyDelta, the device's algorithm)
+ * and compared with the new image before makeDelta returns it.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace blhost
+{
+
+enum class ThumbFilter { Off, On, Best };
+
+struct DeltaOptions
+{
+	ThumbFilter thumb     = ThumbFilter::Best;  /* BL_DELTA_FLAG_THUMB */
+	bool        compress  = true;               /* BL_DELTA_FLAG_LZ */
+	unsigned    threads   = 0;                  /* Chunks searched at once, 0: one per core */
+	std::size_t chunkSize = 64 * 1024;          /* New image bytes per chunk */
+};
+
+struct Delta
+{
+	std::vector<std::uint8_t> patch;             /* The patch bytes MEM_WRITE_DELTA streams */
+	std::uint8_t              flags        = 0;  /* delta::FlagLz / FlagThumb of the START packet */
+	std::uint32_t             sourceLength = 0;
+	std::uint32_t             targetLength = 0;
+	std::size_t               records      = 0;
+	std::size_t               recordBytes  = 0;  /* Record stream before compression */
+	std::size_t               extraBytes   = 0;  /* New image bytes found nowhere in the source */
+};
+
+/* Throws std::logic_error if the patch does not rebuild the target */
+Delta makeDelta(const std::uint8_t* source, std::size_t sourceLength, const std::uint8_t* target, std::size_t targetLength,
+                const DeltaOptions& options = {});
+
+/* The image the device rebuilds; nullopt for a patch it would refuse (BL_DELTA_CORRUPT) */
+std::optional<std::vector<std::uint8_t>> applyDelta(const std::uint8_t* source, std::size_t sourceLength, const Delta& delta);
+
+/* BL_DELTA_FLAG_THUMB filter of a whole image in place: encode relative -> absolute, or back */
+void thumbFilter(std::uint8_t* image, std::size_t size, bool encode);
+
+}
+
+#endif /* BLHOST_DELTA_HPP */
@@ -0,0 +1,117 @@
+#ifndef BLHOST_DEVICEVIEW_HPP
+#define BLHOST_DEVICEVIEW_HPP
+
+/*
+ * DeviceView
+ * ----------
+ * A read-only window on a range of device memory (flash, SRAM, backup
+ * SRAM...), fetched on demand: read() pulls only the 4 KB pages it touches
+ * through BL_READ_MULTI and keeps them in an LRU cache of
+ * ViewOptions::cachePages. A miss right after the page before it reads
+ * ahead, twice as many pages each time up to readAhead, so a sequential
+ * scan needs few round trips. A scattered one still reads one page at a
+ * time.
+ *
+ * With validate, each fetch first asks BL_BLOCK_CRC_MANIFEST for the
+ * word-wise CRC of the pages it covers (one request for the whole window).
+ * A page whose CRC is found elsewhere is not read:
+ *  - in the view's own cache, after refresh() or maxAge marked it stale
+ *    (live RAM),
+ *  - in cacheDirectory, the pages of earlier sessions, keyed by CRC,
+ *  - in a BlockStore, the blocks of every version shipped.
+ * Bytes taken by CRC are checked on the host against it first. So a
+ * forensic session on a device that runs a known image reads little more
+ * than its RAM and the flash it wrote itself.
+ *
+ * Not thread-safe: one caller at a time (blmount holds a lock around it).
+ * Link failures and ranges the bootloader does not read throw FlashError
+ * from the Flasher.
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace blhost
+{
+
+class BlockStore;
+class Flasher;
+
+struct ViewOptions
+{
+	std::size_t               cachePages     = 64;      /* Pages kept in memory, 256 KB */
+	unsigned                  readAhead      = 8;       /* Pages read past a sequential miss, at most */
+	bool                      validate       = true;    /* BL_BLOCK_CRC_MANIFEST before each fetch */
+	std::string               cacheDirectory;           /* Pages kept across sessions, "" for none */
+	const BlockStore*         store          = nullptr; /* Blocks of the shipped versions */
+	std::chrono::milliseconds maxAge { 0 };             /* A cached page is checked again after it, 0 never */
+};
+
+struct ViewStats
+{
+	std::size_t   pagesRead     = 0;                    /* Over the link */
+	std::size_t   pagesReused   = 0;                    /* From cacheDirectory or the store, by CRC */
+	std::size_t   pagesChecked  = 0;                    /* Stale, unchanged on the device */
+	std::size_t   manifests     = 0;                    /* BL_BLOCK_CRC_MANIFEST requests */
+	std::uint64_t bytesRead     = 0;
+};
+
+class DeviceView
+{
+public:
+	static constexpr std::uint32_t kPageSize = 4096;
+
+	/* Pages are kPageSize from base on, the last one up to base + length */
+	DeviceView(Flasher& flasher, std::uint32_t base, std::uint32_t length, ViewOptions options = ViewOptions());
+
+	std::uint32_t base() const { return base_; }
+	std::uint32_t length() const { return length_; }
+
+	/* Bytes copied, fewer than length past the end of the view */
+	std::size_t read(std::uint32_t address, std::uint8_t* data, std::size_t length);
+
+	/* Every cached page is checked against the device's CRC on its next read */
+	void refresh();
+
+	const ViewStats& stats() const { return stats_; }
+
+private:
+	struct Page
+	{
+		std::vector<std::uint8_t>             data;
+		std::uint32_t                         crc   = 0;
+		bool                                  stale = false;
+		std::chrono::steady_clock::time_point checked;
+		std::list<std::uint32_t>::iterator    lru;
+	};
+
+	const Page& page(std::uint32_t index);
+	void        fetch(std::uint32_t first, std::uint32_t count);
+	bool        reuse(std::uint32_t index, std::uint32_t crc, std::vector<std::uint8_t>& data);
+	void        keep(std::uint32_t index, std::vector<std::uint8_t> data, std::uint32_t crc);
+	bool        fresh(const Page& page) const;
+
+	std::uint32_t pageLength(std::uint32_t index) const;
+	std::uint32_t pageCount() const { return (length_ + kPageSize - 1u) / kPageSize; }
+
+	Flasher&                                  flasher_;
+	std::uint32_t                             base_;
+	std::uint32_t                             length_;
+	ViewOptions                               options_;
+	std::unordered_map<std::uint32_t, Page>   pages_;
+	std::list<std::uint32_t>                  lru_;          /* Most recent first */
+	std::multimap<std::uint32_t, std::string> storeBlocks_;  /* CRC -> block key */
+	std::uint32_t                             lastMiss_;     /* Last page of the last fetch */
+	unsigned                                  run_ = 0;      /* Pages read ahead on the last miss */
+	ViewStats                                 stats_;
+};
+
+}
+
+#endif /* BLHOST_DEVICEVIEW_HPP */
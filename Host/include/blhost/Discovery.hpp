@@ -0,0 +1,88 @@
+#ifndef BLHOST_DISCOVERY_HPP
+#define BLHOST_DISCOVERY_HPP
+
+/*
+ * Discovery
+ * ---------
+ * Enumerates the nodes of a CAN or RS-485 bus by their 96-bit unique ID with
+ * BL_DISCOVER ("Node Discovery" in BL.h), without knowing any node address.
+ * The walks are independent of the adapter: the caller sends the payload
+ * given to the query callback as a group frame (CAN) or a broadcast (RS-485)
+ * and reports what came back.
+ *
+ * CAN: each query returns one frame per distinct next 25 ID bits of the
+ * matching nodes (the bus arbitrates them apart and merges equal ones), so a
+ * node is found after four rounds and 32 nodes take a few hundred frames.
+ *
+ * RS-485: each query listens to 16 slots of BL_RS485_DISCOVER_SLOT_US. A slot
+ * with a reply that decodes is confirmed with a full 96-bit query, a garbled
+ * one (two or more nodes) is searched 4 bits deeper.
+ */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+namespace blhost
+{
+
+namespace discover
+{
+constexpr std::uint8_t Ok       = 0x00;   /* BL_DISCOVER_OK */
+constexpr std::uint8_t NoMatch  = 0x01;   /* BL_DISCOVER_NO_MATCH, unicast only */
+
+constexpr unsigned    UidBits   = 96;
+constexpr unsigned    CanBits   = 25;    /* BL_DISCOVER_CAN_BITS */
+constexpr unsigned    SlotBits  = 4;     /* BL_DISCOVER_SLOT_BITS */
+constexpr std::size_t Slots     = 1u << SlotBits;
+constexpr std::size_t ReplySize = 14;
+
+constexpr std::uint32_t CanExtIdBase = 0x1E000000u;   /* BL_CAN_EXT_ID_DISCOVER */
+constexpr std::uint32_t CanExtIdMask = 0x01FFFFFFu;
+}
+
+using UniqueId = std::array<std::uint8_t, 12>;
+
+struct DiscoveredNode
+{
+	UniqueId     uniqueId {};
+	std::uint8_t address = 0;   /* BL_CAN_NODE_ID / BL_RS485_NODE_ADDRESS */
+	std::uint8_t group   = 0;   /* BL_CAN_GROUP_ID, CAN only */
+};
+
+/* BL_DISCOVER payload: [bits] [prefix (12)], bits past the length cleared */
+std::vector<std::uint8_t> encodeDiscover(const UniqueId& prefix, unsigned bits);
+
+/* [status] [unique ID (12)] [address]; nullopt unless well formed and BL_DISCOVER_OK */
+std::optional<DiscoveredNode> parseDiscoverReply(const std::vector<std::uint8_t>& payload);
+
+/* One received discovery frame: the 29-bit identifier and its data */
+struct CanDiscoveryFrame
+{
+	std::uint32_t             identifier = 0;
+	std::vector<std::uint8_t> data;
+};
+
+/* Sends the payload on the group identifier, returns the discovery frames seen until the bus is quiet */
+using CanDiscoveryQuery = std::function<std::vector<CanDiscoveryFrame>(const std::vector<std::uint8_t>& payload)>;
+
+std::vector<DiscoveredNode> discoverCan(const CanDiscoveryQuery& query);
+
+/* What the host saw in one RS-485 time slot */
+struct SlotObservation
+{
+	bool                                     activity = false;   /* Any byte or line error in the slot */
+	std::optional<std::vector<std::uint8_t>> payload;            /* The reply payload, when a frame decoded with a good CRC */
+};
+
+/* Sends the payload as a broadcast, returns the 16 slots that follow it */
+using SlotDiscoveryQuery = std::function<std::array<SlotObservation, discover::Slots>(const std::vector<std::uint8_t>& payload)>;
+
+std::vector<DiscoveredNode> discoverSlots(const SlotDiscoveryQuery& query);
+
+}
+
+#endif /* BLHOST_DISCOVERY_HPP */
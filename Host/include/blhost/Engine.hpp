@@ -0,0 +1,115 @@
+#ifndef BLHOST_ENGINE_HPP
+#define BLHOST_ENGINE_HPP
+
+/*
+ * Engine
+ * ------
+ * Asynchronous I/O over a Transport: one thread owns the link, drains the
+ * transmit queue as fast as the link accepts bytes and cuts the received
+ * stream into replies at the same time. Callers only queue frames and
+ * collect replies, so a windowed writer (Flasher::writeStream) keeps the
+ * queue full while the bootloader works through the frames already sent.
+ *
+ * Replies go to the callback set with onResponse (called on the I/O thread,
+ * keep it short), or without one to a queue read by next(). Progress frames
+ * are never replies: they go to the onProgress callback, or are dropped. A
+ * link error stops the thread; next() then rethrows it.
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "blhost/Protocol.hpp"
+#include "blhost/Transport.hpp"
+
+namespace blhost
+{
+
+class Engine
+{
+public:
+	struct Options
+	{
+		CrcMode crc         = CrcMode::BytePerWord;   /* BL_CRC_WORDWISE_ENABLE of the target */
+		bool    responseCrc = false;                  /* BL_RESPONSE_CRC_ENABLE of the target */
+	};
+
+	using ResponseCallback = std::function<void(const Response&)>;
+	using DeviceProgressCallback = std::function<void(const DeviceProgress&)>;
+
+	explicit Engine(Transport& transport) : Engine(transport, Options()) {}
+	Engine(Transport& transport, Options options);
+	~Engine();
+
+	Engine(const Engine&)            = delete;
+	Engine& operator=(const Engine&) = delete;
+
+	void start();
+	void stop();
+
+	const Options& options() const { return options_; }
+
+	/* Encodes and queues one request, returns at once */
+	void submit(std::uint8_t command, const std::vector<std::uint8_t>& payload);
+
+	/* Drops the queued frames not yet started on the wire; returns how many */
+	std::size_t discardQueued();
+
+	/* Bytes queued but not yet accepted by the transport */
+	std::size_t queuedBytes() const;
+
+	/* Replies to a callback instead of the queue (nullptr: back to the queue) */
+	void onResponse(ResponseCallback callback);
+
+	/* Progress frames to a callback, on the I/O thread (nullptr: dropped) */
+	void onProgress(DeviceProgressCallback callback);
+
+	/* Next queued reply, or nothing after the timeout */
+	std::optional<Response> next(std::chrono::milliseconds timeout);
+
+	/* Forgets the queued replies (a new request/response exchange starts) */
+	void clearResponses();
+
+	/* Submit and wait for the reply of a command that always answers */
+	std::optional<Response> transact(std::uint8_t command, const std::vector<std::uint8_t>& payload,
+	                                 std::chrono::milliseconds timeout);
+
+	/* transact for a reply that always ends with its CRC (ResponseParser::expectCrc) */
+	std::optional<Response> transactChecked(std::uint8_t command, const std::vector<std::uint8_t>& payload,
+	                                        std::chrono::milliseconds timeout);
+
+private:
+	void run();
+	void deliver(std::vector<Response>& responses);
+
+	Transport&     transport_;
+	Options        options_;
+	ResponseParser parser_;
+
+	mutable std::mutex                    mutex_;
+	std::condition_variable               responseReady_;
+	std::deque<std::vector<std::uint8_t>> txQueue_;
+	std::size_t                           txQueuedBytes_ = 0;
+	std::deque<Response>                  rxQueue_;
+	ResponseCallback                      callback_;
+	DeviceProgressCallback                progressCallback_;
+	std::exception_ptr                    error_;
+
+	std::vector<std::uint8_t> current_;        /* Frame being written, owned by the I/O thread */
+	std::size_t               currentSent_ = 0;
+
+	std::thread thread_;
+	bool        running_ = false;
+};
+
+}
+
+#endif /* BLHOST_ENGINE_HPP */
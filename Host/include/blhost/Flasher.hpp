@@ -0,0 +1,256 @@
+#ifndef BLHOST_FLASHER_HPP
+#define BLHOST_FLASHER_HPP
+
+/*
+ * Flasher
+ * -------
+ * Bootloader operations on top of an Engine. Every call is synchronous for
+ * the caller; the pipelining happens inside writeStream, which keeps a
+ * window of BL_MEM_WRITE_STREAM packets in flight (go-back-N on the
+ * bootloader's cumulative ACK / RETRANSMIT replies), packet size and window
+ * tuned to the link by a StreamTuner.
+ *
+ * Failures throw FlashError with the bootloader's status byte when there is
+ * one; a link that stays silent throws after the configured retries.
+ */
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "blhost/Aes.hpp"
+#include "blhost/Delta.hpp"
+#include "blhost/Engine.hpp"
+#include "blhost/Package.hpp"
+#include "blhost/Planner.hpp"
+#include "blhost/Tuner.hpp"
+
+namespace blhost
+{
+
+class FlashError : public std::runtime_error
+{
+public:
+	FlashError(const std::string& what, int status = -1) : std::runtime_error(what), status_(status) {}
+
+	/* Status byte of the reply, -1 for a timeout or a malformed reply */
+	int status() const { return status_; }
+
+private:
+	int status_;
+};
+
+struct StreamOptions
+{
+	std::size_t packetSize = 1024;     /* Data bytes per packet (first packets when adaptive) */
+	unsigned    window     = 8;        /* Packets in flight (at the start when adaptive) */
+	bool        adaptive   = true;     /* Tune both to the link as the stream runs (Tuner.hpp) */
+	bool        autoErase  = false;    /* BL_STREAM_FLAG_AUTO_ERASE */
+	bool        session    = true;     /* Wrap in BL_BEGIN_PROGRAM / BL_END_PROGRAM */
+	bool        verify     = true;     /* BL_VERIFY_RANGE CRC-32 of the written range at the end */
+	std::chrono::milliseconds timeout { 3000 };  /* Without any reply; covers a 128 KB auto-erase */
+	unsigned    retries    = 8;        /* Timeouts / retransmit requests in a row before giving up */
+	const AesCtr* cipher   = nullptr;  /* writeStream only: sent as ciphertext in an encrypted session */
+	LogCallback log;                   /* Tuner decisions and the final parameters of each stream */
+};
+
+/* Bytes acknowledged so far, and the total */
+using ProgressCallback = std::function<void(std::size_t done, std::size_t total)>;
+
+class Flasher
+{
+public:
+	explicit Flasher(Engine& engine) : engine_(engine) {}
+
+	std::uint8_t getVersion();
+
+	/* BL_GET_DEVICE_INFO; throws FlashError for a NACK or a short reply */
+	DeviceInfo deviceInfo();
+
+	/* BL_GET_STATS, with clear the counters restart from 0; throws FlashError without BL_STATS_ENABLE */
+	DeviceStats stats(bool clear = false);
+
+	/* BL_GET_TRACE from sequence from on (the oldest still held if it is gone); throws FlashError without BL_TRACE_ENABLE */
+	DeviceTrace trace(std::uint32_t from = 0);
+
+	/* BL_GET_CRASH_RECORD, nullopt when no fault is recorded; with clear the record is dropped after the read */
+	std::optional<CrashRecord> crashRecord(bool clear = false);
+
+	/* BL_GET_APP_INFO: header and state of every slot, no CRC computed; throws FlashError for a NACK or a short reply */
+	AppInfo appInfo();
+
+	/* BL_READ_MULTI of one range per request, kReadMultiMaxData bytes at a time; throws FlashError for a
+	 * range the bootloader does not read */
+	std::vector<std::uint8_t> readMemory(std::uint32_t address, std::size_t length);
+
+	/* The UserApp's PC-sampling record in backup SRAM, nullopt when it holds none; with clear its magic
+	 * is zeroed after the read, so the next App_ProfileStart starts over */
+	std::optional<AppProfile> appProfile(bool clear = false);
+
+	/* GET_SCHED_LATENCY of the running UserApp (App_Ota.h) for one task and event bit; throws FlashError
+	 * for a NACK (the bootloader, or an APP_CDC_BRIDGE build) or a refused event */
+	SchedLatency schedLatency(std::uint8_t task, std::uint8_t bit);
+
+	/* Every histogram of the UserApp's scheduler back to 0 */
+	void clearSchedLatency();
+
+	/* BL_ERASE_FOR_IMAGE: the device picks what to erase; a refused plan is returned, not thrown */
+	ImageErasePlan eraseForImage(std::uint32_t address, std::uint32_t length, bool dryRun = false,
+	                             std::chrono::milliseconds timeout = std::chrono::milliseconds(30000));
+
+	/* BL_ERASE_RANGE, synchronous; with plan, the per-sector results (BL_ERASE_FLAG_PLAN) */
+	std::vector<std::uint8_t> eraseRange(std::uint32_t address, std::uint32_t length, bool plan = false,
+	                                     std::chrono::milliseconds timeout = std::chrono::milliseconds(30000));
+
+	/* The image is only read, so several Flashers may share one mapping (MappedFile.hpp). With a
+	 * cipher the session is an encrypted one (kFeatureDecrypt, thrown as FlashError without it): the
+	 * packets carry a ciphertext copy, the verify compares the device with the plain image */
+	void writeStream(std::uint32_t address, const std::uint8_t* image, std::size_t size,
+	                 const StreamOptions& options = {}, const ProgressCallback& progress = nullptr);
+
+	void writeStream(std::uint32_t address, const std::vector<std::uint8_t>& image,
+	                 const StreamOptions& options = {}, const ProgressCallback& progress = nullptr)
+	{
+		writeStream(address, image.data(), image.size(), options, progress);
+	}
+
+	/* Writes flash through the RAM run area, kRamRunSize bytes at a time: each window is streamed into
+	 * SRAM, then BL_PROGRAM_FROM_RAM checks its CRC, programs and verifies it on the device. No session
+	 * (its hashes would take in the SRAM uploads too) and no cipher; autoErase erases the range first.
+	 * Progress counts uploaded bytes */
+	void writeViaRam(std::uint32_t address, const std::uint8_t* image, std::size_t size,
+	                 const StreamOptions& options = {}, const ProgressCallback& progress = nullptr);
+
+	/* BL_PROGRAM_FROM_RAM of length bytes uploaded at source, crc their word-wise CRC-32; throws
+	 * FlashError with the status and the failing address */
+	void programFromRam(std::uint32_t source, std::uint32_t destination, std::uint32_t length, std::uint32_t crc,
+	                    std::chrono::milliseconds timeout = std::chrono::milliseconds(10000));
+
+	/* BL_RUN_SCRIPT: uploads the steps (encodeScript) to address in the RAM run area and has the device run
+	 * them in one round trip, stopping at the first step that fails. Data the steps take (a PROGRAM_FROM_RAM
+	 * image) is uploaded beforehand, elsewhere in the area. Throws FlashError for a script the device
+	 * refuses (batch::Invalid) or that does not fit; a failed step is returned, not thrown */
+	ScriptResult runScript(const std::vector<ScriptStep>& steps, std::uint32_t address = kRamRunBase,
+	                       std::chrono::milliseconds timeout = std::chrono::milliseconds(60000));
+
+	/* BL_MEM_WRITE_LZ: sends stream, the image's lzCompress (Lz.hpp), one packet at a time, the device
+	 * decoding it into address. Throws FlashError without kCapsCodecWriteLz, with a cipher or for a
+	 * refused packet; autoErase erases the range first, verify checks it against image. Progress counts
+	 * image bytes written */
+	void writeLz(std::uint32_t address, const std::uint8_t* image, std::size_t size, const std::vector<std::uint8_t>& stream,
+	             const StreamOptions& options = {}, const ProgressCallback& progress = nullptr);
+
+	/* The device's LZ decoder on sample (up to kRamRunSize bytes) before anything is erased: writeLz into
+	 * the RAM run area, then GET_CAPABILITIES asked again for the rates of that stream. Throws FlashError
+	 * without kCapsCodecWriteLz */
+	const Capabilities& probeLz(const std::uint8_t* sample, std::size_t size);
+
+	/* BL_MEM_WRITE_DELTA: rebuilds target at address from the image at source and a patch (Delta.hpp), one
+	 * packet at a time. Throws FlashError when the bootloader lacks a codec the patch uses; verify checks
+	 * the range against target. Progress counts patch bytes */
+	void writeDelta(std::uint32_t address, std::uint32_t source, const Delta& delta, const std::uint8_t* target,
+	                const StreamOptions& options = {}, const ProgressCallback& progress = nullptr);
+
+	/* BL_MEM_WRITE_PACKAGE: sends an update package (Package.hpp) one packet at a time, the device erasing
+	 * its plan once the manifest is in. Throws FlashError for a package that does not unpack or a
+	 * bootloader without kCapsCodecPackage; verify checks every segment. Progress counts package bytes */
+	void writePackage(const std::vector<std::uint8_t>& package, const StreamOptions& options = {},
+	                  const ProgressCallback& progress = nullptr);
+
+	/* BL_SELF_UPDATE: erases and writes a bootloader image at staging, then has the device copy it over
+	 * sectors 0 and 1 and reset; signature is the 64-byte ECDSA-P256 of its SHA-256 for BL_SIGNATURE_ENABLE.
+	 * Throws FlashError for an image over selfupdate::BootloaderSize or a refusal; once it returns, the
+	 * device is resetting and the staging copy is still there. Progress counts staged bytes */
+	void selfUpdate(const std::vector<std::uint8_t>& image, std::uint32_t staging = selfupdate::StagingAddress,
+	                const std::vector<std::uint8_t>& signature = {}, const StreamOptions& options = {},
+	                const ProgressCallback& progress = nullptr);
+
+	/* Runs a transfer plan (Planner.hpp) in one session: erases, writes, fills, then verifies; the
+	 * StreamOptions apply to every write, autoErase is ignored. Progress counts written + filled bytes */
+	void execute(const Plan& plan, const StreamOptions& options = {}, const ProgressCallback& progress = nullptr);
+
+	/* One BL_MEM_WRITE, up to kMaxPayloadLength - 6 bytes; stop-and-wait */
+	void memWrite(std::uint32_t address, const std::uint8_t* data, std::size_t length);
+
+	/* BL_FLASH_ERASE of count sectors from first, synchronous */
+	void flashErase(unsigned first, unsigned count,
+	                std::chrono::milliseconds timeout = std::chrono::milliseconds(30000));
+
+	/* BL_MEM_FILL of a word-aligned range */
+	void fill(std::uint32_t address, std::uint32_t length, const std::array<std::uint8_t, 4>& pattern);
+
+	/* BL_VERIFY_RANGE CRC-32 of a device range: word-wise, or the standard CRC-32 with CrcMode::Ieee */
+	std::uint32_t rangeCrc(std::uint32_t address, std::uint32_t length, CrcMode mode = CrcMode::WordWise);
+
+	/* CRC used to verify images: Ieee when the bootloader has kFeatureCrcIeee, WordWise otherwise */
+	CrcMode digestMode();
+
+	/* BL_BLOCK_CRC_MANIFEST word-wise CRC of every blockSize block of a range, as many requests as it takes */
+	std::vector<std::uint32_t> blockCrcs(std::uint32_t address, std::uint32_t length, std::uint16_t blockSize);
+
+	/* BL_GO_TO_ADDR; flags kGoFlagVectorTable / kGoFlagLoader start a vector table instead of calling the address */
+	void goTo(std::uint32_t address, std::uint8_t flags = 0);
+
+	/* BL_SLOT_ACTIVATE of slot index, slot::Query only reads; a refused activation comes back in status,
+	 * a NACK or a short reply throws FlashError */
+	SlotState slotActivate(std::uint8_t index = slot::Query);
+
+	/* Updates the inactive A/B slot with the basic commands only, which the bootloader and the UserApp's
+	 * USART2 receiver (App_Ota.h) both take: the SLOT_ACTIVATE query, FLASH_ERASE of the sectors the image
+	 * covers, MEM_WRITE of up to chunk bytes at a time, then SLOT_ACTIVATE of the slot, which boots from
+	 * the device's next reset. Throws FlashError for a device without an update slot, an image linked
+	 * elsewhere (its reset vector outside the slot), a refused step or a failed image check. Progress
+	 * counts written bytes */
+	void writeSlot(const std::uint8_t* image, std::size_t size, std::size_t chunk = 1024,
+	               const ProgressCallback& progress = nullptr);
+
+	/* BL_RESET_AND_BOOT: leaves update mode by the clean handoff into the active slot, or with reset by a
+	 * system reset that skips update mode once. Returns true for a handoff, false when the device resets
+	 * (also a handoff the boot path needs a reset for); throws FlashError when no valid image is there */
+	bool resetAndBoot(bool reset = false);
+
+	/* Uploads a second-stage loader to kRamRunBase (SRAM stream, verified) and hands the link to it */
+	void startLoader(const std::uint8_t* image, std::size_t size, const StreamOptions& options = {});
+
+	/* BL_SET_PROGRESS: erases and programs push DeviceProgress at most every interval (0: off), handed to
+	 * callback on the engine's I/O thread. False, with nothing sent, without kFeatureProgress */
+	bool enableProgress(std::chrono::milliseconds interval, Engine::DeviceProgressCallback callback);
+
+	/* BL_ECHO: a reply of length bytes, data first, then the device's pattern (byte n is n & 0xFF); throws
+	 * FlashError for a length over linktest::EchoMax or a NACK (no kFeatureLinkTest) */
+	std::vector<std::uint8_t> echo(std::size_t length, const std::vector<std::uint8_t>& data = {});
+
+	/* BL_SINK: size bytes in frames of at most frameBytes data, queued back to back with no reply in
+	 * between; the first resets the device's counters, the last asks for them */
+	SinkCounters sink(const std::uint8_t* data, std::size_t size, std::size_t frameBytes = kMaxPayloadLength - 1,
+	                  std::chrono::milliseconds timeout = std::chrono::milliseconds(10000));
+
+	/* BL_GET_CAPABILITIES, asked once; defaults for a bootloader without it */
+	const Capabilities& capabilities();
+
+	/* Retries counted by the last writeStream */
+	unsigned lastRetransmissions() const { return retransmissions_; }
+
+private:
+	Response request(std::uint8_t command, const std::vector<std::uint8_t>& payload,
+	                 std::chrono::milliseconds timeout = std::chrono::milliseconds(1000));
+
+	void beginSession(const std::vector<std::uint8_t>& payload);
+	void endSession();
+
+	void streamPackets(std::uint32_t address, const std::uint8_t* image, std::size_t size,
+	                   const StreamOptions& options, const ProgressCallback& progress);
+
+	Engine&                     engine_;
+	unsigned                    retransmissions_ = 0;
+	std::optional<Capabilities> capabilities_;
+};
+
+}
+
+#endif /* BLHOST_FLASHER_HPP */
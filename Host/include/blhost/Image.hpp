@@ -0,0 +1,62 @@
+#ifndef BLHOST_IMAGE_HPP
+#define BLHOST_IMAGE_HPP
+
+/*
+ * Image
+ * -----
+ * Loadable contents of an ELF, Intel HEX or raw binary file as a list of
+ * (address, bytes) segments sorted by address. ELF and binary segments point
+ * straight into a read-only mapping of the file (MappedFile.hpp); HEX text
+ * has to be decoded, into one buffer per contiguous run of records.
+ *
+ * ELF: 32-bit little-endian; the allocated sections with contents, each at
+ * its load address (through the PT_LOAD holding it), so initialised data
+ * lands in flash behind the code, as objcopy -O binary lays it out. The format is told by the file contents: the ELF
+ * magic, a leading ':' for HEX, anything else is a binary at binaryBase.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "blhost/MappedFile.hpp"
+
+namespace blhost
+{
+
+struct Segment
+{
+	std::uint32_t       address = 0;
+	const std::uint8_t* data    = nullptr;
+	std::size_t         size    = 0;
+
+	std::uint32_t end() const { return address + static_cast<std::uint32_t>(size); }
+};
+
+class Image
+{
+public:
+	/* Throws std::runtime_error on an unreadable or malformed file, or overlapping segments */
+	static Image load(const std::string& path, std::uint32_t binaryBase = 0x08000000u);
+
+	const std::vector<Segment>& segments() const { return segments_; }
+	const char*                 format() const { return format_; }
+	std::size_t                 size() const;
+
+private:
+	Image() = default;
+
+	void loadElf(const std::string& path);
+	void loadHex(const std::string& path);
+
+	std::shared_ptr<MappedFile>            file_;
+	std::vector<std::vector<std::uint8_t>> decoded_;   /* HEX runs; the buffers survive a move */
+	std::vector<Segment>                   segments_;
+	const char*                            format_ = "";
+};
+
+}
+
+#endif /* BLHOST_IMAGE_HPP */
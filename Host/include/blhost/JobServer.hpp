@@ -0,0 +1,129 @@
+#ifndef BLHOST_JOBSERVER_HPP
+#define BLHOST_JOBSERVER_HPP
+
+/*
+ * JobServer
+ * ---------
+ * The long-running side of blflashd: one Station per port keeps its
+ * SerialPort, Engine and Flasher open between jobs, with the capabilities
+ * and the device info read once per session, so a job costs its own
+ * transfer and nothing else (no port open, no I/O thread start, no
+ * handshake).
+ *
+ * run() may be called from any number of threads. A job names its port or
+ * asks for any: it then goes to the station with the fewest jobs queued.
+ * Jobs of one station run one at a time in arrival order, different
+ * stations side by side.
+ *
+ * A session ends with any job that fails on the device (timeout, port
+ * error, refused or mismatching transfer): the station is closed and the
+ * next job reopens it, so an unplugged adapter or a board replaced while
+ * powered down costs one failed job at most, and no job inherits the
+ * state a failed one left behind. A fixture that swaps boards without the
+ * link ever failing releases the station between boards, or the cached
+ * device info (and with it the manifest cache key) would still name the
+ * previous board.
+ */
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "blhost/Batch.hpp"
+#include "blhost/Planner.hpp"
+
+namespace blhost
+{
+
+struct Job
+{
+	enum class Kind { Write, Program, Verify, Info, Release };
+
+	Kind          kind    = Kind::Info;
+	std::string   port;                /* Empty: any station */
+	std::string   image;               /* Write / Verify: a .bin, Program: .elf, .hex or .bin */
+	std::uint32_t address = 0;         /* Write / Verify: target, Program: --base of a .bin */
+};
+
+struct JobResult
+{
+	bool        ok      = false;
+	std::string port;
+	std::string message;               /* The error when !ok, a one-line summary otherwise */
+	double      seconds = 0.0;
+};
+
+struct JobServerOptions
+{
+	BatchOptions board;                /* Baud, flow control, CRC modes, stream options */
+	PlanOptions  plan;
+	std::string  cacheDirectory;       /* Program jobs: per-board manifests (Manifest.hpp), empty: none */
+};
+
+class Station
+{
+public:
+	Station(std::string port, const JobServerOptions& options);
+	~Station();
+
+	Station(const Station&)            = delete;
+	Station& operator=(const Station&) = delete;
+
+	const std::string& port() const { return port_; }
+
+	/* Takes the next place in the queue */
+	std::uint64_t reserve();
+
+	/* Waits for the jobs reserved before ticket, then runs the job */
+	JobResult run(std::uint64_t ticket, const Job& job);
+
+	/* Jobs reserved and not finished */
+	unsigned queued() const;
+
+	/* "port warm|closed jobs-done queued" */
+	std::string describe() const;
+
+private:
+	struct Session;
+
+	void      open();
+	void      execute(const Job& job, JobResult& result);
+
+	std::string              port_;
+	const JobServerOptions&  options_;
+	std::unique_ptr<Session> session_;   /* Only touched by the job holding the turn */
+
+	mutable std::mutex      mutex_;
+	std::condition_variable turn_;
+	std::uint64_t           ticket_  = 0;   /* Next ticket handed out */
+	std::uint64_t           serving_ = 0;   /* Ticket allowed to run */
+	unsigned                done_    = 0;
+	bool                    warm_    = false;
+};
+
+class JobServer
+{
+public:
+	JobServer(const std::vector<std::string>& ports, JobServerOptions options);
+
+	JobResult run(const Job& job);
+
+	/* Station::describe of every station */
+	std::vector<std::string> describe() const;
+
+private:
+	/* The named station, or the least busy one for an empty name; nullptr for an unknown port */
+	Station* pick(const std::string& port, std::uint64_t& ticket);
+
+	JobServerOptions                      options_;
+	std::vector<std::unique_ptr<Station>> stations_;
+	std::mutex                            pickMutex_;
+};
+
+}
+
+#endif /* BLHOST_JOBSERVER_HPP */
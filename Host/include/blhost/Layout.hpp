@@ -0,0 +1,92 @@
+#ifndef BLHOST_LAYOUT_HPP
+#define BLHOST_LAYOUT_HPP
+
+/*
+ * Layout
+ * ------
+ * Stable function order for the UserApp's .text, kept in its linker script
+ * between the "bllayout begin" / "bllayout end" markers, so that a small
+ * source change moves little of the image and the MEM_WRITE_DELTA patch
+ * between two builds stays small.
+ *
+ * Each module (object file, or library archive) gets a slot at a fixed
+ * offset from the start of .text, with its functions' input sections in
+ * the order they were first placed, and slack for them to grow. An update
+ * from a new map file keeps every slot where it is:
+ *  - a module's new functions go at the end of its last slot,
+ *  - functions that no longer fit (one before them grew past the slack)
+ *    move, in order, to a new slot for the module at the end,
+ *  - new modules get new slots at the end, functions that are gone leave
+ *    a hole.
+ * Between two updates a slot that outgrew its slack pushes the ones after
+ * it along, and the link goes on. A tail reserve after the slots takes the
+ * functions linked since the last update, so .rodata does not move either.
+ * reset() starts a packed layout again, for a release that ships a full
+ * image anyway.
+ *
+ * Functions that run from RAM (a writable region in the map) are left out:
+ * their objects stay on the script's EXCLUDE_FILE path into .data.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "blhost/LinkerMap.hpp"
+
+namespace blhost
+{
+
+struct LayoutSlot
+{
+	std::string              module;            /* Object file name, or archive for library members */
+	std::uint32_t            offset = 0;        /* From the start of .text (_stable_layout) */
+	std::uint32_t            size   = 0;        /* Bytes reserved, slack included */
+	std::vector<std::string> sections;          /* Input sections, e.g. .text.App_HubRead, in link order */
+};
+
+struct LayoutOptions
+{
+	unsigned      slackPercent = 10;            /* Of a new slot's functions, added as slack */
+	std::uint32_t minSlack     = 64;            /* Bytes, at least */
+	std::uint32_t tail         = 2048;          /* Reserve after the slots for code not placed yet */
+};
+
+struct LayoutChanges
+{
+	std::size_t kept     = 0;                   /* Functions left where they were */
+	std::size_t added    = 0;                   /* New functions appended to their module's slot */
+	std::size_t moved    = 0;                   /* Placed before, moved to a slot at the end */
+	std::size_t removed  = 0;                   /* No longer in the map */
+	std::size_t newSlots = 0;
+	std::vector<std::string> movedSections;
+};
+
+class StableLayout
+{
+public:
+	/* The layout in a linker script's text; throws std::runtime_error without the bllayout markers */
+	static StableLayout parse(const std::string& script);
+
+	/* Merges the FLASH .text.* input sections of the map into the layout */
+	LayoutChanges update(const LinkerMap& map, const LayoutOptions& options);
+
+	/* Drops every slot: the next update packs the map's functions afresh */
+	void reset();
+
+	/* The script with its bllayout blocks rewritten */
+	std::string apply(const std::string& script) const;
+
+	const std::vector<LayoutSlot>& slots() const { return slots_; }
+	std::uint32_t                  end() const;          /* Past the last slot */
+	std::uint32_t                  tailEnd() const { return tailEnd_; }
+
+private:
+	std::vector<LayoutSlot> slots_;
+	std::uint32_t           tailEnd_ = 0;   /* .text reaches at least this offset: .rodata's start */
+};
+
+}
+
+#endif /* BLHOST_LAYOUT_HPP */
@@ -0,0 +1,60 @@
+#ifndef BLHOST_LINKERMAP_HPP
+#define BLHOST_LINKERMAP_HPP
+
+/*
+ * LinkerMap
+ * ---------
+ * The memory regions and allocated input sections of a GNU ld map file
+ * (-Wl,-Map), to account for the flash and RAM of a firmware build per
+ * region, object and function. Initialised data counts twice: in its RAM
+ * region and, through its load address, in flash.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace blhost
+{
+
+struct MemoryRegion
+{
+	std::string   name;
+	std::uint32_t origin   = 0;
+	std::uint32_t length   = 0;
+	bool          writable = false;   /* "w" in the attributes: RAM, else flash */
+	std::uint32_t used     = 0;       /* Output sections, fill and load images included */
+};
+
+/* One function or variable: an input section, or a symbol of one holding several */
+struct MapEntry
+{
+	std::string   name;
+	std::string   object;
+	std::string   section;            /* Input section, e.g. .text.BL_voidHandleGetTraceCmd */
+	std::uint32_t address = 0;
+	std::uint32_t size    = 0;
+	int           region  = -1;       /* Index in regions(), where it runs or lives */
+	int           load    = -1;       /* Where its initial value is stored, -1 for none */
+};
+
+class LinkerMap
+{
+public:
+	/* Throws std::runtime_error on an unreadable file or one without a memory configuration */
+	static LinkerMap load(const std::string& path);
+
+	const std::vector<MemoryRegion>& regions() const { return regions_; }
+	const std::vector<MapEntry>&     entries() const { return entries_; }
+
+	/* Index of the region holding address, -1 outside all of them */
+	int regionOf(std::uint32_t address) const;
+
+private:
+	std::vector<MemoryRegion> regions_;
+	std::vector<MapEntry>     entries_;
+};
+
+}
+
+#endif /* BLHOST_LINKERMAP_HPP */
@@ -0,0 +1,34 @@
+#ifndef BLHOST_LZ_HPP
+#define BLHOST_LZ_HPP
+
+/*
+ * Lz
+ * --
+ * The LZ4 sequence format the bootloader decodes (BL_LZ.h): the contents of
+ * an LZ4 block without any frame header, match offsets limited to the
+ * decoder's 4 KB window. lzCompress is a hash-chain encoder: every match
+ * candidate of the window with the same first four bytes is tried, the
+ * longest kept. lzDecompress is the reference decoder, for checking what is
+ * about to be sent.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace blhost
+{
+
+constexpr std::size_t kLzWindowSize = 4096;   /* BL_LZ_WINDOW_SIZE */
+constexpr std::size_t kLzMinMatch   = 4;      /* BL_LZ_MIN_MATCH */
+
+/* One sequence stream ending on the literals of its last sequence */
+std::vector<std::uint8_t> lzCompress(const std::uint8_t* data, std::size_t size);
+
+/* nullopt for an offset outside the output or the window, or a stream cut inside a sequence */
+std::optional<std::vector<std::uint8_t>> lzDecompress(const std::uint8_t* data, std::size_t size);
+
+}
+
+#endif /* BLHOST_LZ_HPP */
@@ -0,0 +1,87 @@
+#ifndef BLHOST_MANIFEST_HPP
+#define BLHOST_MANIFEST_HPP
+
+/*
+ * Manifest
+ * --------
+ * What a board holds after a plan was programmed: the word-wise CRC-32 of
+ * every piece of the plan's regions, one piece per flash sector, and a CRC
+ * over all of them that names the image. ManifestCache keeps the last one
+ * of each board by its 96-bit unique ID, one text file per board.
+ *
+ * findUnchangedSectors tells which sectors already hold their part of a new
+ * plan. Every piece the cache does not already know to differ is checked
+ * on the device with BL_VERIFY_RANGE (computed there, a few milliseconds a
+ * sector); a board carrying the same build answers every check and is done
+ * in one round trip per sector instead of an erase and a rewrite. Nothing
+ * is trusted from the cache alone, so a board changed behind its back (by
+ * the application or another station) is only rewritten, never skipped.
+ *
+ * manifestOf computes the pieces' CRCs on every core (one piece at a time
+ * per worker, the image being read-only). imageManifestOf also keeps the
+ * result next to the image file (IMAGE.blmanifest), stamped with the file's
+ * size and modification time: planning the same build again, for every
+ * board of a run or the next run, then costs one small file read. A stale
+ * or foreign file is recomputed, and a read-only image directory only
+ * loses the sidecar, never the update.
+ */
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "blhost/Planner.hpp"
+
+namespace blhost
+{
+
+class Flasher;
+
+struct ManifestPiece
+{
+	unsigned      sector  = 0;
+	std::uint32_t address = 0;
+	std::uint32_t size    = 0;
+	std::uint32_t crc     = 0;    /* Word-wise, as BL_VERIFY_RANGE */
+};
+
+struct Manifest
+{
+	std::string                uniqueId;    /* DeviceInfo::uniqueIdHex() */
+	std::uint32_t              imageCrc = 0;
+	std::vector<ManifestPiece> pieces;
+};
+
+/* Pieces of the plan's regions, the unique ID left empty; threads 0: one per core */
+Manifest manifestOf(const Plan& plan, unsigned threads = 0);
+
+/* manifestOf(plan) through the sidecar of the image file the plan was made from */
+Manifest imageManifestOf(const std::string& imagePath, const Plan& plan);
+
+class ManifestCache
+{
+public:
+	explicit ManifestCache(std::string directory) : directory_(std::move(directory)) {}
+
+	/* nullopt when the board has no manifest yet or the file does not parse */
+	std::optional<Manifest> load(const std::string& uniqueId) const;
+
+	/* Written to a temporary file and renamed; throws std::runtime_error */
+	void store(const Manifest& manifest) const;
+
+private:
+	std::string path(const std::string& uniqueId) const;
+
+	std::string directory_;
+};
+
+/* Bit n: every piece of the wanted manifest in sector n is on the device */
+std::uint16_t findUnchangedSectors(Flasher& flasher, const Manifest& wanted, const std::optional<Manifest>& cached);
+
+/* Bit n for every sector holding a piece */
+std::uint16_t sectorsOf(const Manifest& manifest);
+
+}
+
+#endif /* BLHOST_MANIFEST_HPP */
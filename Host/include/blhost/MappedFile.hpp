@@ -0,0 +1,39 @@
+#ifndef BLHOST_MAPPEDFILE_HPP
+#define BLHOST_MAPPEDFILE_HPP
+
+/*
+ * MappedFile
+ * ----------
+ * Read-only memory mapping of an image file. The pages are shared by every
+ * thread that reads them, so flashing N boards keeps one copy of the image
+ * in memory and never copies it before it is cut into packets.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace blhost
+{
+
+class MappedFile
+{
+public:
+	/* Throws std::runtime_error when the file cannot be opened or mapped */
+	explicit MappedFile(const std::string& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&)            = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const std::uint8_t* data() const { return data_; }
+	std::size_t         size() const { return size_; }
+
+private:
+	const std::uint8_t* data_ = nullptr;
+	std::size_t         size_ = 0;
+};
+
+}
+
+#endif /* BLHOST_MAPPEDFILE_HPP */
@@ -0,0 +1,96 @@
+#ifndef BLHOST_PACKAGE_HPP
+#define BLHOST_PACKAGE_HPP
+
+/*
+ * Package
+ * -------
+ * Update packages ("Update Package" in BL_Package.h): one file per update
+ * holding the whole decision of what to erase and write, made once on the
+ * host and replayed unchanged by every device (BL_MEM_WRITE_PACKAGE) or
+ * staged by the application (BL_STAGING_CODEC_PACKAGE).
+ *
+ * makePackage runs the transfer planner (Planner.hpp) on the image: its
+ * merged regions are the segments, its erase list the erase plan. Each
+ * segment is LZ-compressed for the bootloader's 4 KB window (Lz.hpp) and
+ * kept raw when that is not smaller. The block CRCs, payload digest and
+ * manifest CRC follow; every package is unpacked with the device's checks
+ * (unpackPackage) and compared with the image before it is returned.
+ *
+ * Signing stays outside: a package made with sign reserves the signature,
+ * packageManifest gives the bytes to sign (openssl dgst -sha256 -sign on
+ * them makes the ECDSA-P256 signature BL_SIGNATURE_ENABLE checks) and
+ * signPackage puts the signature in.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "blhost/Image.hpp"
+#include "blhost/Planner.hpp"
+
+namespace blhost
+{
+
+constexpr std::uint32_t kPackageMagic         = 0x4B504C42u;   /* "BLPK" */
+constexpr std::uint16_t kPackageVersion       = 1;
+constexpr std::uint8_t  kPackageFlagSigned    = 0x01;
+constexpr std::uint8_t  kPackageCodecRaw      = 0;
+constexpr std::uint8_t  kPackageCodecLz       = 1;
+constexpr std::size_t   kPackageMaxSegments   = 16;
+constexpr std::size_t   kPackageMinBlockSize  = 256;
+constexpr std::size_t   kPackageMaxBlockSize  = 2048;
+constexpr std::size_t   kPackageMaxBlocks     = 512;
+constexpr std::size_t   kPackageHeaderSize    = 56;
+constexpr std::size_t   kPackageSegmentSize   = 16;
+constexpr std::size_t   kPackageSignatureSize = 64;            /* r || s, big endian */
+
+struct PackageOptions
+{
+	std::size_t blockSize = 1024;     /* Payload bytes per block CRC, a power of two */
+	bool        compress  = true;     /* LZ segments where smaller */
+	bool        sign      = false;    /* Reserve a signature (kPackageFlagSigned) */
+	PlanOptions plan;                 /* Segments and erase plan; erase must stay on */
+};
+
+/* One segment as the device writes it */
+struct PackageSegment
+{
+	std::uint32_t             address = 0;
+	std::vector<std::uint8_t> data;
+	std::uint8_t              codec       = kPackageCodecRaw;
+	std::size_t               storedBytes = 0;
+};
+
+struct PackageContents
+{
+	std::vector<PackageSegment> segments;
+	std::uint32_t               eraseSectors = 0;   /* Bit n: sector n */
+	std::uint8_t                flags        = 0;
+	std::size_t                 blockSize    = 0;
+	std::size_t                 manifestSize = 0;   /* Bytes covered by the manifest CRC and the signature */
+	std::size_t                 payloadSize  = 0;   /* At the end of the package */
+};
+
+/* Throws std::invalid_argument for options or an image the bootloader would refuse (too many segments,
+ * a bootloader sector), std::logic_error if the package does not unpack to the image */
+std::vector<std::uint8_t> makePackage(const Image& image, const PackageOptions& options = {});
+
+/* The device's checks (CRCs, plan, digest) without the signature; nullopt for a package it would refuse */
+std::optional<PackageContents> unpackPackage(const std::vector<std::uint8_t>& package);
+
+/* The bytes whose SHA-256 is signed; throws std::invalid_argument for a malformed package */
+std::vector<std::uint8_t> packageManifest(const std::vector<std::uint8_t>& package);
+
+/* The package with its reserved signature filled in, from a DER ECDSA-Sig-Value or raw r || s.
+ * Throws std::invalid_argument for an unsigned package or a malformed signature */
+std::vector<std::uint8_t> signPackage(const std::vector<std::uint8_t>& package, const std::vector<std::uint8_t>& signature);
+
+/* 64 raw bytes r || s of a DER ECDSA-Sig-Value or raw signature (also the one BL_SELF_UPDATE carries);
+ * throws std::invalid_argument for anything else */
+std::vector<std::uint8_t> rawSignature(const std::vector<std::uint8_t>& signature);
+
+}
+
+#endif /* BLHOST_PACKAGE_HPP */
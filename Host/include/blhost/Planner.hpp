@@ -0,0 +1,98 @@
+#ifndef BLHOST_PLANNER_HPP
+#define BLHOST_PLANNER_HPP
+
+/*
+ * Planner
+ * -------
+ * Turns an Image into the commands that program it (Flasher::execute):
+ *
+ * 1. Segments closer than PlanOptions::mergeGap are merged into one region;
+ *    the gap is written as 0xFF. Regions that touch in memory too (BIN,
+ *    consecutive ELF segments) stay views of the image, only a bridged gap
+ *    copies the region into the plan.
+ * 2. Every F407 sector a region touches is erased once (erase list).
+ * 3. Each region is cut on flash-line boundaries (lineSize, the bootloader's
+ *    write-combine line): runs of at least minSkip bytes of 0xFF are dropped
+ *    (the sector is erased), runs of at least minFill bytes repeating one
+ *    word become BL_MEM_FILL, everything else is written with
+ *    BL_MEM_WRITE_STREAM. Writes therefore start and end on a line except at
+ *    the edges of a region.
+ * 4. Each region is checked with one BL_VERIFY_RANGE.
+ *
+ * Sectors in PlanOptions::unchangedSectors are left out of steps 2 and 3:
+ * the device already holds that part of the image.
+ *
+ * A plan points into the image: keep the Image alive while the plan is used.
+ */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "blhost/Image.hpp"
+
+namespace blhost
+{
+
+struct FlashSector
+{
+	std::uint32_t address;
+	std::uint32_t size;
+};
+
+/* STM32F407 single-bank flash: 4 x 16 KB, 64 KB, 7 x 128 KB */
+constexpr std::array<FlashSector, 12> kFlashSectors = { {
+	{ 0x08000000u, 0x4000u },  { 0x08004000u, 0x4000u },  { 0x08008000u, 0x4000u },  { 0x0800C000u, 0x4000u },
+	{ 0x08010000u, 0x10000u }, { 0x08020000u, 0x20000u }, { 0x08040000u, 0x20000u }, { 0x08060000u, 0x20000u },
+	{ 0x08080000u, 0x20000u }, { 0x080A0000u, 0x20000u }, { 0x080C0000u, 0x20000u }, { 0x080E0000u, 0x20000u },
+} };
+
+struct PlanOptions
+{
+	std::size_t   lineSize         = 16;     /* WRITE_COMBINE_LINE_SIZE; a multiple of 4 */
+	std::size_t   mergeGap         = 64;     /* Segments at most this far apart are merged */
+	std::size_t   minSkip          = 64;     /* Shortest 0xFF run left out of the writes */
+	std::size_t   minFill          = 256;    /* Shortest constant-word run sent as BL_MEM_FILL */
+	bool          erase            = true;   /* false: the target area is known to be erased */
+	std::uint16_t unchangedSectors = 0;      /* Bit n: sector n already holds its part of the image */
+};
+
+struct PlanStep
+{
+	enum class Kind { Write, Fill };
+
+	Kind                        kind    = Kind::Write;
+	std::uint32_t               address = 0;
+	const std::uint8_t*         data    = nullptr;  /* Write: the bytes, in the image or the plan */
+	std::size_t                 size    = 0;
+	std::array<std::uint8_t, 4> pattern {};         /* Fill: the word, as in memory */
+};
+
+struct Plan
+{
+	std::vector<unsigned> eraseSectors;   /* Indexes into kFlashSectors, ascending */
+	std::vector<PlanStep> steps;          /* Ascending addresses */
+	std::vector<Segment>  verify;         /* The regions, with their expected contents */
+
+	std::size_t imageBytes     = 0;   /* Loadable bytes of the image */
+	std::size_t bridgedBytes   = 0;   /* 0xFF gap bytes between merged segments */
+	std::size_t writeBytes     = 0;   /* Sent as data */
+	std::size_t fillBytes      = 0;   /* Produced by BL_MEM_FILL */
+	std::size_t skippedBytes   = 0;   /* 0xFF left to the erase */
+	std::size_t unchangedBytes = 0;   /* In unchangedSectors: neither erased nor written */
+
+	std::deque<std::vector<std::uint8_t>> storage;   /* Bridged regions; elements never move */
+};
+
+/* Throws std::invalid_argument for a segment outside the flash */
+Plan planTransfer(const Image& image, const PlanOptions& options = {});
+
+/* Human-readable listing of the plan and its efficiency (blflash --dry-run) */
+std::string describePlan(const Plan& plan);
+
+}
+
+#endif /* BLHOST_PLANNER_HPP */
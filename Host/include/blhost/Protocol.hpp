@@ -0,0 +1,732 @@
+#ifndef BLHOST_PROTOCOL_HPP
+#define BLHOST_PROTOCOL_HPP
+
+/*
+ * Wire Protocol
+ * -------------
+ * Host-side mirror of Bootloader/Core/Inc/BL.h: command codes, reply codes,
+ * frame formats and the CRC of the STM32 CRC unit. Keep it in step with BL.h.
+ *
+ * Request : v1       [length to follow (1)] [command] [payload] [CRC32 (4)]
+ *           extended [0x00] [length to follow (2, LE)] [command] [payload] [CRC32 (4)]
+ * Reply   : [BL_ACK] [length (1)] [payload] [CRC32 (4), BL_RESPONSE_CRC_ENABLE]
+ *           [BL_ACK] [0x00] [length (2, LE)] [payload] [CRC32 (4), ...] above 255 bytes
+ *           [BL_NACK] alone for a bad CRC or an unknown / short command.
+ */
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace blhost
+{
+
+constexpr std::uint8_t kAck  = 0xA5;
+constexpr std::uint8_t kNack = 0x7F;
+constexpr std::uint8_t kProgressMarker = 0xA6;   /* BL_PROGRESS_MARKER: unsolicited DeviceProgress frame */
+
+constexpr std::uint8_t kFrameExtMarker   = 0x00;
+constexpr std::size_t  kMaxPayloadLength = 4096;   /* BL_MAX_PAYLOAD_LENGTH */
+constexpr std::size_t  kRxRingSize       = 16384;  /* BL_RX_RING_SIZE: budget for bytes in flight */
+
+namespace cmd
+{
+constexpr std::uint8_t GetVersion       = 0x51;
+constexpr std::uint8_t GetHelp          = 0x52;
+constexpr std::uint8_t GetCid           = 0x53;
+constexpr std::uint8_t GetRdpStatus     = 0x54;
+constexpr std::uint8_t GoToAddr         = 0x55;
+constexpr std::uint8_t FlashErase       = 0x56;
+constexpr std::uint8_t MemWrite         = 0x57;
+constexpr std::uint8_t MemRead          = 0x59;
+constexpr std::uint8_t ReadSectorStatus = 0x5A;
+constexpr std::uint8_t OtpRead          = 0x5B;
+constexpr std::uint8_t MemWriteStream   = 0x5D;
+constexpr std::uint8_t FlashEraseStatus = 0x60;
+constexpr std::uint8_t BeginProgram     = 0x62;
+constexpr std::uint8_t EndProgram       = 0x63;
+constexpr std::uint8_t EraseRange       = 0x64;
+constexpr std::uint8_t VerifyRange      = 0x65;
+constexpr std::uint8_t BlockCrcManifest = 0x67;
+constexpr std::uint8_t GetDeviceInfo    = 0x69;
+constexpr std::uint8_t ReadMulti        = 0x6A;
+constexpr std::uint8_t GetCapabilities  = 0x6E;
+constexpr std::uint8_t MemWriteLz       = 0x70;
+constexpr std::uint8_t MemWriteDelta    = 0x71;
+constexpr std::uint8_t MemFill          = 0x72;
+constexpr std::uint8_t GetBootTimes     = 0x73;
+constexpr std::uint8_t SlotActivate     = 0x75;
+constexpr std::uint8_t GetWearStats     = 0x76;
+constexpr std::uint8_t GetStats         = 0x77;
+constexpr std::uint8_t GetTrace         = 0x78;
+constexpr std::uint8_t BroadcastStatus  = 0x79;
+constexpr std::uint8_t GetCrashRecord   = 0x7A;
+constexpr std::uint8_t EraseForImage    = 0x7B;
+constexpr std::uint8_t Discover         = 0x7C;
+constexpr std::uint8_t MemWritePackage  = 0x7D;
+constexpr std::uint8_t SelfUpdate       = 0x7E;
+constexpr std::uint8_t ResetAndBoot     = 0x80;   /* 0x7F is kNack */
+constexpr std::uint8_t GetAppInfo       = 0x81;
+constexpr std::uint8_t ProgramFromRam   = 0x82;
+constexpr std::uint8_t SetProgress      = 0x83;
+constexpr std::uint8_t RunScript        = 0x84;
+constexpr std::uint8_t Echo             = 0x85;
+constexpr std::uint8_t Sink             = 0x86;
+constexpr std::uint8_t GetSchedLatency  = 0x87;   /* The running UserApp only (App_Ota.h) */
+}
+
+/* BL_STREAM_FLAG_xxx */
+namespace stream
+{
+constexpr std::uint8_t FlagStart     = 0x01;
+constexpr std::uint8_t FlagLast      = 0x02;
+constexpr std::uint8_t FlagAutoErase = 0x04;
+
+constexpr std::uint8_t Ack           = 0x00;
+constexpr std::uint8_t Retransmit    = 0x01;
+constexpr std::uint8_t WriteError    = 0x02;
+constexpr std::uint8_t EraseRequired = 0x03;
+constexpr std::uint8_t Missing       = 0x04;
+
+constexpr std::size_t  HeaderLength  = 9;     /* [seq (2)] [flags] [address (4)] [length (2)], extended frame */
+}
+
+/* BL_LZ_WRITE_FLAG_xxx and the BL_MEM_WRITE_LZ statuses */
+namespace lzwrite
+{
+constexpr std::uint8_t FlagStart = 0x01;
+constexpr std::uint8_t FlagEnd   = 0x02;
+
+constexpr std::uint8_t Ok        = 0x00;
+constexpr std::uint8_t Failed    = 0x01;
+constexpr std::uint8_t Sequence  = 0x02;
+constexpr std::uint8_t Corrupt   = 0x03;
+
+constexpr std::size_t  HeaderLength = 5;      /* [flags] [address (4)] */
+}
+
+/* BL_DELTA_FLAG_xxx and the BL_MEM_WRITE_DELTA statuses */
+namespace delta
+{
+constexpr std::uint8_t FlagStart = 0x01;
+constexpr std::uint8_t FlagEnd   = 0x02;
+constexpr std::uint8_t FlagLz    = 0x04;
+constexpr std::uint8_t FlagThumb = 0x08;
+
+constexpr std::uint8_t Ok        = 0x00;
+constexpr std::uint8_t Failed    = 0x01;
+constexpr std::uint8_t Sequence  = 0x02;
+constexpr std::uint8_t Corrupt   = 0x03;
+
+constexpr std::size_t  StartLength = 17;      /* [flags] [address (4)] [source (4)] [source length (4)] [target length (4)] */
+}
+
+/* BL_PACKAGE_FLAG_xxx and the BL_MEM_WRITE_PACKAGE statuses (BL_PACKAGE_xxx of BL_Package.h from 0x10) */
+namespace package
+{
+constexpr std::uint8_t FlagStart    = 0x01;
+constexpr std::uint8_t FlagEnd      = 0x02;
+
+constexpr std::uint8_t Ok           = 0x00;
+constexpr std::uint8_t Failed       = 0x01;
+constexpr std::uint8_t Sequence     = 0x02;
+constexpr std::uint8_t Incomplete   = 0x03;
+constexpr std::uint8_t BadHeader    = 0x10;
+constexpr std::uint8_t BadManifest  = 0x11;
+constexpr std::uint8_t BadSignature = 0x12;
+constexpr std::uint8_t BadPlan      = 0x13;
+constexpr std::uint8_t BadBlock     = 0x14;
+constexpr std::uint8_t Corrupt      = 0x15;
+constexpr std::uint8_t BadDigest    = 0x16;
+
+constexpr std::size_t  HeaderLength = 5;      /* [flags] [package offset (4)] */
+}
+
+/* BL_SELF_UPDATE statuses, the bootloader area it replaces and the default staging address (sector 10) */
+namespace selfupdate
+{
+constexpr std::uint8_t  Ok             = 0x00;
+constexpr std::uint8_t  Invalid        = 0x01;
+constexpr std::uint8_t  Digest         = 0x02;
+constexpr std::uint8_t  Signature      = 0x03;
+constexpr std::uint8_t  Protected      = 0x04;
+
+constexpr std::uint32_t BootloaderSize = 0x00008000;   /* Sectors 0 and 1 */
+constexpr std::uint32_t StagingAddress = 0x080C0000;
+}
+
+/* BL_RESET_BOOT_MODE_xxx, then the BL_RESET_AND_BOOT statuses */
+namespace resetboot
+{
+constexpr std::uint8_t ModeHandoff = 0x00;
+constexpr std::uint8_t ModeReset   = 0x01;
+
+constexpr std::uint8_t Handoff     = 0x00;
+constexpr std::uint8_t Reset       = 0x01;
+constexpr std::uint8_t Invalid     = 0x02;
+}
+
+/* BL_PROGRAM_FROM_RAM statuses */
+namespace ramprogram
+{
+constexpr std::uint8_t Ok          = 0x00;
+constexpr std::uint8_t Invalid     = 0x01;
+constexpr std::uint8_t Crc         = 0x02;
+constexpr std::uint8_t WriteError  = 0x03;
+constexpr std::uint8_t VerifyError = 0x04;
+}
+
+/* BL_ECHO / BL_SINK */
+namespace linktest
+{
+constexpr std::uint8_t Ok          = 0x00;
+constexpr std::uint8_t EchoTooLong = 0x01;
+constexpr std::size_t  EchoMax     = kMaxPayloadLength - 1;   /* BL_ECHO_MAX_LENGTH */
+constexpr std::uint8_t FlagReset   = 0x01;
+constexpr std::uint8_t FlagReport  = 0x02;
+}
+
+/* BL_BATCH_xxx: results of BL_BATCH and BL_RUN_SCRIPT */
+namespace batch
+{
+constexpr std::uint8_t Done      = 0x00;
+constexpr std::uint8_t Stopped   = 0x01;
+constexpr std::uint8_t Malformed = 0x02;
+constexpr std::uint8_t Rejected  = 0x03;
+constexpr std::uint8_t Handoff   = 0x04;
+constexpr std::uint8_t Invalid   = 0x05;   /* BL_RUN_SCRIPT: outside the RAM run area or CRC mismatch */
+constexpr std::uint8_t ExpectAny = 0xFF;
+}
+
+constexpr std::uint8_t kStatusOk          = 0x00;   /* HAL_OK */
+constexpr std::uint8_t kValidAddress      = 0x01;   /* GO_TO_ADDR */
+constexpr std::uint8_t kVerifyAlgoCrc32   = 0x00;
+constexpr std::uint8_t kVerifyAlgoCrc32Ieee = 0x02;   /* Standard CRC-32, BL_FEATURE_CRC_IEEE */
+
+/* BL_BLOCK_CRC_MANIFEST flags and the feature bit of the standard CRC-32 (BL_FEATURE_CRC_IEEE) */
+constexpr std::uint8_t  kManifestFlagIeee = 0x01;
+constexpr std::uint32_t kFeatureCrcIeee   = 1u << 14;
+
+/* Encrypted sessions: BL_BEGIN_PROGRAM with an AES-CTR counter block (BL_FEATURE_DECRYPT, Aes.hpp) */
+constexpr std::uint32_t kFeatureDecrypt   = 1u << 15;
+
+/* Progress frames during long commands (BL_SET_PROGRESS, DeviceProgress) */
+constexpr std::uint32_t kFeatureProgress  = 1u << 16;
+
+/* Link benchmark commands (BL_ECHO, BL_SINK) */
+constexpr std::uint32_t kFeatureLinkTest  = 1u << 17;
+
+/* BL_Capabilities_t.Codecs */
+constexpr std::uint8_t kCapsCodecWriteLz    = 1u << 1;
+constexpr std::uint8_t kCapsCodecWriteDelta = 1u << 2;
+constexpr std::uint8_t kCapsCodecDeltaLz    = 1u << 3;
+constexpr std::uint8_t kCapsCodecDeltaThumb = 1u << 4;
+constexpr std::uint8_t kCapsCodecPackage    = 1u << 5;
+
+/* GO_TO_ADDR flags (BL_GO_FLAG_xxx) and the SRAM area a second-stage loader is linked for (BL_Loader.h) */
+constexpr std::uint8_t  kGoFlagVectorTable = 0x01;
+constexpr std::uint8_t  kGoFlagLoader      = 0x02;
+constexpr std::uint32_t kRamRunBase        = 0x20010000;
+constexpr std::uint32_t kRamRunSize        = 0x00010000;
+
+/*
+ * Capabilities
+ * ------------
+ * The BL_GET_CAPABILITIES reply (BL_Capabilities_t): limits of the build and
+ * the link it answers on. parseCapabilities returns nullopt for a reply too
+ * short for the version 1 fields. The LZ rates cover the device's last
+ * BL_MEM_WRITE_LZ stream, which may have gone to SRAM (Flasher::probeLz).
+ */
+struct Capabilities
+{
+	std::uint8_t  version           = 0;
+	std::uint8_t  link              = 0;
+	std::uint8_t  codecs            = 0;   /* kCapsCodecxxx */
+	std::uint8_t  streamAckInterval = 2;
+	std::uint16_t maxFrame          = 0;
+	std::uint16_t maxPayload        = static_cast<std::uint16_t>(kMaxPayloadLength);
+	std::uint16_t rxBuffer          = static_cast<std::uint16_t>(kRxRingSize);
+	std::uint32_t maxBaudRate       = 0;
+	std::uint32_t features          = 0;
+	std::uint32_t lzDecodeRate      = 0;   /* Version 2: decoded bytes / s of decoder time, 0 = not measured */
+	std::uint32_t lzWriteRate       = 0;   /* Version 2: decoded bytes / s of write-path time, same stream */
+	std::uint16_t vddMv             = 0;   /* Version 3: supply at the last session start, 0 = not measured */
+	std::uint8_t  flashParallelism  = 4;   /* Version 3: bytes per flash program / erase step */
+};
+
+std::optional<Capabilities> parseCapabilities(const std::vector<std::uint8_t>& payload);
+
+/*
+ * DeviceInfo
+ * ----------
+ * The BL_GET_DEVICE_INFO reply (BL_DeviceInfo_t) without the command list.
+ * uniqueId is the 96-bit UID as stored, hex() prints it the same way for
+ * every host.
+ */
+struct DeviceInfo
+{
+	std::uint8_t                 version           = 0;
+	std::uint8_t                 bootloaderVersion = 0;
+	std::uint16_t                chipId            = 0;
+	std::uint8_t                 rdpLevel          = 0;
+	std::uint16_t                writeProtected    = 0;
+	std::array<std::uint8_t, 12> uniqueId {};
+	std::uint16_t                flashSizeKb       = 0;
+	std::uint32_t                features          = 0;
+
+	std::string uniqueIdHex() const;
+};
+
+std::optional<DeviceInfo> parseDeviceInfo(const std::vector<std::uint8_t>& payload);
+
+/*
+ * DeviceStats
+ * -----------
+ * The BL_GET_STATS reply: link counters and, per opcode dispatched since the
+ * last reset or clear, count, DWT cycles and NACKs, then the flash
+ * operation times per sector class and the USART2 error detail (none from
+ * a bootloader predating them).
+ * parseStats returns nullopt for a build without BL_STATS_ENABLE or a
+ * malformed reply.
+ */
+struct CommandStats
+{
+	std::uint8_t  opcode      = 0;
+	std::uint32_t count       = 0;
+	std::uint64_t totalCycles = 0;
+	std::uint32_t maxCycles   = 0;
+	std::uint32_t nacks       = 0;
+};
+
+/* Log2 histogram of one flash operation: counts[0] under 1 us, counts[n] 2^(n-1) .. 2^n - 1 us */
+struct FlashHistogram
+{
+	std::uint32_t              maxUs   = 0;
+	std::uint32_t              totalUs = 0;
+	std::uint32_t              units   = 0;   /* Bytes programmed / sectors erased */
+	std::vector<std::uint32_t> counts;
+
+	std::uint64_t operations() const;
+
+	/* Upper bound of the bucket holding that fraction of the operations, maxUs for 1.0; 0 without any */
+	std::uint32_t percentileUs(double fraction) const;
+};
+
+/* Sector classes of FlashTiming, as BL_FLASH_CLASS_xxx */
+constexpr std::size_t kFlashClasses = 3;
+
+struct FlashTiming
+{
+	FlashHistogram program[kFlashClasses];   /* 16, 64, 128 KB */
+	FlashHistogram erase[kFlashClasses];
+};
+
+/* USART2 line errors by kind and the RX ring's fill peak: lost bytes at the current baud rate */
+struct UartDiagnostics
+{
+	std::uint32_t overrun       = 0;
+	std::uint32_t framing       = 0;
+	std::uint32_t noise         = 0;
+	std::uint32_t parity        = 0;
+	std::uint32_t dma           = 0;
+	std::uint32_t ringHighWater = 0;
+	std::uint32_t ringSize      = 0;
+};
+
+/* High-water marks of the main stack's and the heap's reserves since reset, in bytes (MemoryUsage.h) */
+struct MemoryUsage
+{
+	std::uint32_t stackPeak = 0;
+	std::uint32_t stackSize = 0;
+	std::uint32_t heapPeak  = 0;
+	std::uint32_t heapSize  = 0;
+};
+
+/* Longest interrupt-masked section since the counters were cleared, in core cycles, and how many ran (BL_Port.h) */
+struct IrqMasking
+{
+	std::uint32_t maxCycles = 0;
+	std::uint32_t sections  = 0;
+};
+
+struct DeviceStats
+{
+	std::uint32_t             rxBytes     = 0;
+	std::uint32_t             txBytes     = 0;
+	std::uint32_t             crcFailures = 0;
+	std::uint32_t             uartErrors  = 0;
+	std::uint32_t             coreClockHz = 0;
+	std::vector<CommandStats> commands;
+	std::optional<FlashTiming> flash;
+	std::optional<UartDiagnostics> uart;
+	std::optional<MemoryUsage>     memory;
+	std::optional<IrqMasking>      masking;
+};
+
+std::optional<DeviceStats> parseStats(const std::vector<std::uint8_t>& payload);
+
+/* BL_GET_STATS flags */
+constexpr std::uint8_t kStatsFlagClear = 0x01;
+
+/*
+ * DeviceTrace
+ * -----------
+ * One BL_GET_TRACE reply: the events from firstSequence on, oldest first,
+ * as many as one frame holds, stamped with the DWT cycle counter. head is
+ * the number recorded so far; the rest follow from firstSequence +
+ * events.size(). parseTrace returns nullopt for a build without
+ * BL_TRACE_ENABLE or a malformed reply.
+ */
+struct TraceEvent
+{
+	std::uint32_t sequence = 0;
+	std::uint32_t cycles   = 0;
+	std::uint16_t event    = 0;
+	std::uint16_t arg0     = 0;
+	std::uint32_t arg1     = 0;
+};
+
+struct DeviceTrace
+{
+	std::uint32_t           head          = 0;
+	std::uint16_t           depth         = 0;
+	std::uint32_t           coreClockHz   = 0;
+	std::uint32_t           firstSequence = 0;
+	std::vector<TraceEvent> events;
+};
+
+std::optional<DeviceTrace> parseTrace(const std::vector<std::uint8_t>& payload);
+
+/* BL_TRACE_xxx as printed by blflash trace; "?" for an unknown id */
+const char* traceEventName(std::uint16_t event);
+
+/*
+ * CrashRecord
+ * -----------
+ * BL_GET_CRASH_RECORD: the last fault a fault handler saved before resetting
+ * (BL_CrashRecord_t, BL_Handoff.h). parseCrashRecord returns nullopt when
+ * the device holds no record (BL_CRASH_NONE) or for a malformed reply.
+ */
+struct CrashRecord
+{
+	std::uint32_t              count     = 0;
+	std::uint32_t              source    = 0;   /* 1 bootloader, 2 application */
+	std::uint32_t              fault     = 0;   /* Exception number: 3 hard, 4 memmanage, 5 bus, 6 usage */
+	std::uint32_t              registers[8] = {};   /* R0 R1 R2 R3 R12 LR PC xPSR */
+	std::uint32_t              excReturn = 0;
+	std::uint32_t              cfsr      = 0;
+	std::uint32_t              hfsr      = 0;
+	std::uint32_t              mmfar     = 0;
+	std::uint32_t              bfar      = 0;
+	std::uint32_t              cycles    = 0;
+	std::uint32_t              sp        = 0;
+	std::vector<std::uint32_t> stack;           /* From sp up */
+};
+
+std::optional<CrashRecord> parseCrashRecord(const std::vector<std::uint8_t>& payload);
+
+/* BL_GET_CRASH_RECORD flags */
+constexpr std::uint8_t kCrashFlagClear = 0x01;
+
+/* BL_READ_MULTI: [count] then count x [address (4)] [length (2)]; one reply [status] [data] */
+constexpr std::size_t kReadMultiMaxData = kMaxPayloadLength - 1;   /* BL_READ_MULTI_MAX_DATA */
+
+/*
+ * AppProfile
+ * ----------
+ * The UserApp's PC-sampling histogram (AppProfile_t, App_Profile.h), read
+ * from backup SRAM through the bootloader. Bucket n counts the samples with
+ * a PC in [base + (n << shift), base + ((n + 1) << shift)). parseAppProfile
+ * returns nullopt for a record that was never started or was cleared.
+ */
+constexpr std::uint32_t kAppProfileAddress = 0x40024400;   /* APP_PROFILE_ADDRESS */
+constexpr std::uint32_t kAppProfileMagic   = 0x464F5250;   /* APP_PROFILE_MAGIC */
+constexpr std::size_t   kAppProfileHeader  = 32;
+constexpr std::size_t   kAppProfileBuckets = 1392;         /* APP_PROFILE_BUCKETS */
+constexpr std::size_t   kAppProfileSize    = kAppProfileHeader + kAppProfileBuckets * 2;
+
+struct AppProfile
+{
+	std::uint32_t              base     = 0;
+	std::uint32_t              shift    = 0;
+	std::uint32_t              rateHz   = 0;
+	std::uint32_t              samples  = 0;   /* Raw total, not halved */
+	std::uint32_t              outside  = 0;   /* Halved with the counts */
+	std::uint32_t              halvings = 0;
+	std::vector<std::uint16_t> counts;
+};
+
+/* From the kAppProfileSize bytes at kAppProfileAddress */
+std::optional<AppProfile> parseAppProfile(const std::vector<std::uint8_t>& record);
+
+/*
+ * SchedLatency
+ * ------------
+ * GET_SCHED_LATENCY [task] [bit], answered by the running UserApp on
+ * USART2: the wait of one scheduler event from its signal (the entry of the
+ * interrupt handler that raised it) to the start of its task
+ * (AppSchedLatency_t, App_Scheduler.h), in core cycles. Bucket 0 counts the
+ * waits below 1 << shift, bucket n those from 1 << (shift + n - 1) to twice
+ * that, the last one open. parseSchedLatency returns nullopt for a refused
+ * event or a malformed reply.
+ */
+constexpr std::uint8_t kSchedLatencyClear = 0xFF;   /* GET_SCHED_LATENCY [0xFF] */
+
+struct SchedLatency
+{
+	std::uint8_t               tasks       = 0;   /* APP_SCHED_MAX_TASKS */
+	std::uint8_t               bits        = 0;   /* APP_SCHED_LATENCY_BITS */
+	std::uint8_t               shift       = 0;
+	std::uint32_t              coreClockHz = 0;   /* At the reply */
+	std::uint32_t              total       = 0;   /* Dispatches, not halved */
+	std::uint32_t              worst       = 0;   /* Cycles */
+	std::uint32_t              halvings    = 0;
+	std::vector<std::uint16_t> counts;
+
+	/* Upper bound of the bucket the fraction of the counts reaches, at most worst; 0 when empty */
+	std::uint32_t percentileCycles(double fraction) const;
+};
+
+std::optional<SchedLatency> parseSchedLatency(const std::vector<std::uint8_t>& payload);
+
+/*
+ * AppInfo
+ * -------
+ * BL_GET_APP_INFO: the image header of every application slot as the
+ * bootloader reads it, with its BL_IMAGE_STATE_xxx. crc is the stamped
+ * image CRC, the one to compare with a build (kImageHeaderOffset + 12 in
+ * the binary); without a header every field after state is 0.
+ */
+constexpr std::size_t   kImageHeaderOffset = 0x200;   /* BL_IMAGE_HEADER_OFFSET */
+
+namespace appstate
+{
+constexpr std::uint8_t Empty     = 0;
+constexpr std::uint8_t NoHeader  = 1;
+constexpr std::uint8_t Unchecked = 2;
+constexpr std::uint8_t Validated = 3;
+constexpr std::uint8_t Revoked   = 4;
+constexpr std::uint8_t Invalid   = 5;
+}
+
+struct SlotInfo
+{
+	std::uint8_t  state           = appstate::Empty;
+	std::uint32_t version         = 0;
+	std::uint32_t buildId         = 0;
+	std::uint32_t length          = 0;
+	std::uint32_t crc             = 0;
+	std::uint32_t securityVersion = 0;
+	std::uint32_t activation      = 0;   /* 0xFFFFFFFF: never activated */
+};
+
+struct AppInfo
+{
+	std::uint8_t          activeSlot = 0;
+	std::vector<SlotInfo> slots;
+};
+
+std::optional<AppInfo> parseAppInfo(const std::vector<std::uint8_t>& payload);
+
+/* appstate::xxx as printed by blflash app-info */
+const char* appStateName(std::uint8_t state);
+
+/*
+ * SlotState
+ * ---------
+ * BL_SLOT_ACTIVATE reply: [status] [active slot] [update slot base (4)].
+ * The UserApp's USART2 receiver (App_Ota.h) answers it too, with base 0
+ * when it cannot take an update.
+ */
+namespace slot
+{
+constexpr std::uint8_t  Query   = 0xFF;   /* BL_SLOT_QUERY */
+constexpr std::uint8_t  Ok      = 0x00;
+constexpr std::uint8_t  Invalid = 0x01;
+
+constexpr std::uint32_t BaseA   = 0x08008000;   /* BL_IMAGE_BASE_ADDRESS */
+constexpr std::uint32_t BaseB   = 0x08040000;   /* BL_IMAGE_SLOT_B_ADDRESS */
+}
+
+struct SlotState
+{
+	std::uint8_t  status     = slot::Ok;
+	std::uint8_t  activeSlot = 0;
+	std::uint32_t updateBase = 0;
+};
+
+std::optional<SlotState> parseSlotState(const std::vector<std::uint8_t>& payload);
+
+/*
+ * DeviceProgress
+ * --------------
+ * One unsolicited progress frame ("Progress Frames" in BL.h), pushed by a
+ * long erase / program command after BL_SET_PROGRESS: done and total are
+ * bytes of its range, sector the flash sector last worked on (0xFF outside
+ * flash). parseDeviceProgress returns nullopt for a short frame.
+ */
+namespace progress
+{
+constexpr std::uint8_t OpErase   = 0x01;
+constexpr std::uint8_t OpProgram = 0x02;
+constexpr std::uint8_t OpVerify  = 0x03;
+}
+
+struct DeviceProgress
+{
+	std::uint8_t  operation = 0;   /* progress::Opxxx */
+	std::uint8_t  percent   = 0;
+	std::uint8_t  sector    = 0;
+	std::uint32_t done      = 0;
+	std::uint32_t total     = 0;
+};
+
+std::optional<DeviceProgress> parseDeviceProgress(const std::vector<std::uint8_t>& payload);
+
+/* "erase", "program", "verify" */
+const char* progressOperationName(std::uint8_t operation);
+
+/* The BL_SINK_FLAG_REPORT reply: good frames and their data bytes since the reset frame, bad CRCs, device ms */
+struct SinkCounters
+{
+	std::uint32_t frames    = 0;
+	std::uint32_t bytes     = 0;
+	std::uint32_t crcErrors = 0;
+	std::uint32_t deviceMs  = 0;
+};
+
+/* One entry of a BL_BATCH payload / BL_RUN_SCRIPT script: the step stops the run unless it answers expect */
+struct ScriptStep
+{
+	std::uint8_t              command = 0;
+	std::vector<std::uint8_t> payload;
+	std::uint8_t              expect  = batch::ExpectAny;
+};
+
+/* The reply: batch::xxx and the status of every step that ran */
+struct ScriptResult
+{
+	std::uint8_t              result = batch::Invalid;
+	std::vector<std::uint8_t> statuses;
+};
+
+/* [count] then [expect] [frame] per step; throws std::invalid_argument for more than 255 steps */
+std::vector<std::uint8_t> encodeScript(const std::vector<ScriptStep>& steps);
+
+/*
+ * ImageErasePlan
+ * --------------
+ * BL_ERASE_FOR_IMAGE: how the device erased (or, dry run, would erase) an
+ * image range and how long it expects that to take. results holds one
+ * BL_ERASE_SECTOR_xxx per sector, 6 (planned) on a dry run.
+ */
+struct ImageErasePlan
+{
+	std::uint8_t              status     = 0;
+	std::uint8_t              method     = 0;   /* 0 skip (all blank), 1 sector by sector */
+	std::uint32_t             estimateMs = 0;
+	std::vector<std::uint8_t> results;
+};
+
+std::optional<ImageErasePlan> parseImageErasePlan(const std::vector<std::uint8_t>& payload);
+
+/* BL_ERASE_FOR_IMAGE flags */
+constexpr std::uint8_t kEraseImageFlagDryRun = 0x01;
+
+/*
+ * CrcMode
+ * -------
+ * BL_CRC_WORDWISE_ENABLE of the bootloader build: one byte per CRC word
+ * (default), or little-endian words with the tail bytes one per word.
+ * Image digests (BL_VERIFY_RANGE) are word-wise, or the standard (zlib)
+ * CRC-32 when the bootloader has kFeatureCrcIeee; Ieee is computed with
+ * zlib when the build found it (BLHOST_HAVE_ZLIB), with a table otherwise.
+ */
+enum class CrcMode
+{
+	BytePerWord,
+	WordWise,
+	Ieee
+};
+
+std::uint32_t crc32(const std::uint8_t* data, std::size_t length, CrcMode mode);
+
+/* Request frame: v1 when it fits in a 1-byte length, extended otherwise */
+std::vector<std::uint8_t> encodeFrame(std::uint8_t command, const std::uint8_t* payload, std::size_t length, CrcMode mode);
+
+inline void putLe16(std::vector<std::uint8_t>& out, std::uint16_t value)
+{
+	out.push_back(static_cast<std::uint8_t>(value));
+	out.push_back(static_cast<std::uint8_t>(value >> 8));
+}
+
+inline void putLe32(std::vector<std::uint8_t>& out, std::uint32_t value)
+{
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		out.push_back(static_cast<std::uint8_t>(value >> shift));
+	}
+}
+
+inline std::uint16_t getLe16(const std::uint8_t* p)
+{
+	return static_cast<std::uint16_t>(p[0] | (p[1] << 8));
+}
+
+inline std::uint32_t getLe32(const std::uint8_t* p)
+{
+	return static_cast<std::uint32_t>(p[0]) | (static_cast<std::uint32_t>(p[1]) << 8) |
+	       (static_cast<std::uint32_t>(p[2]) << 16) | (static_cast<std::uint32_t>(p[3]) << 24);
+}
+
+/*
+ * Response
+ * --------
+ * One reply: ACK with its payload, or a NACK (empty payload). A progress
+ * frame (kProgressMarker) comes as a Response with progress set, which is no
+ * reply to anything; Engine hands those to its progress callback.
+ */
+struct Response
+{
+	bool                      ack      = false;
+	bool                      progress = false;
+	std::vector<std::uint8_t> payload;
+};
+
+/*
+ * ResponseParser
+ * --------------
+ * Cuts the received byte stream into replies. Bytes that cannot start a
+ * reply are skipped (line noise, a banner); with a response CRC, a reply
+ * that does not verify is dropped and counted. expectCrc covers the replies
+ * that carry their CRC whatever BL_RESPONSE_CRC_ENABLE (MEM_READ data,
+ * READ_MULTI): the next ACK reply is read and checked with one.
+ */
+class ResponseParser
+{
+public:
+	ResponseParser(CrcMode mode, bool responseCrc) : mode_(mode), responseCrc_(responseCrc) {}
+
+	/* Appends received bytes; complete replies are moved to out */
+	void feed(const std::uint8_t* data, std::size_t length, std::vector<Response>& out);
+
+	std::size_t droppedReplies() const { return dropped_; }
+
+	/* Before the request: its ACK reply ends with a CRC even without a response CRC */
+	void expectCrc() { crcOnce_ = true; }
+
+private:
+	CrcMode                   mode_;
+	bool                      responseCrc_;
+	std::atomic<bool>         crcOnce_{false};
+	std::vector<std::uint8_t> buffer_;
+	std::size_t               dropped_ = 0;
+};
+
+}
+
+#endif /* BLHOST_PROTOCOL_HPP */
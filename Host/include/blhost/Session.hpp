@@ -0,0 +1,152 @@
+#ifndef BLHOST_SESSION_HPP
+#define BLHOST_SESSION_HPP
+
+/*
+ * Session Recording
+ * -----------------
+ * A fixture's update, kept byte for byte so its timing can be looked at and
+ * reproduced away from the fixture:
+ *
+ * record   RecordingTransport sits between the Engine and the real link and
+ *          logs every chunk read or written, with its direction and the time
+ *          since the recording started. Stats snapshots (Flasher::stats, as
+ *          blflash --record takes before and after its command) are ordinary
+ *          GET_STATS traffic in the log.
+ * replay   replaySession sends the recorded host bytes again, at the
+ *          recorded times (scaled by speed) or, with lockstep, each chunk
+ *          as soon as the device has answered as many bytes as it had
+ *          then, and records the new session. Lockstep is the mode for the
+ *          simulator (Simulator.hpp), whose clock is not the host's.
+ * report   analyzeSession cuts both directions into frames, pairs every
+ *          reply with its request (a MEM_WRITE_STREAM reply with all the
+ *          packets it acknowledges, one SINK reply with the SINK frames
+ *          before it) and says where the time went: on the wire, waiting
+ *          for the device, or on the host with nothing outstanding; per
+ *          opcode the latency, and from the first and last GET_STATS the
+ *          device's own time for the same commands.
+ *
+ * File: ["BLSN"] [version (1)] [CRC mode (1)] [response CRC (1)] [0]
+ *       [baud (4)], then per event [direction (1)] [time ns (8)]
+ *       [length (4)] [bytes], little endian. The CRC options are the
+ *       Engine's at recording; the report needs them to cut the replies.
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "blhost/Protocol.hpp"
+#include "blhost/Transport.hpp"
+
+namespace blhost
+{
+
+enum class SessionDirection : std::uint8_t
+{
+	Sent     = 0,    /* Host to device */
+	Received = 1     /* Device to host */
+};
+
+struct SessionEvent
+{
+	SessionDirection          direction = SessionDirection::Sent;
+	std::uint64_t             timeNs    = 0;   /* Since the recording started */
+	std::vector<std::uint8_t> data;
+};
+
+struct SessionLog
+{
+	unsigned                  baud        = 115200;
+	CrcMode                   crc         = CrcMode::BytePerWord;
+	bool                      responseCrc = false;
+	std::vector<SessionEvent> events;
+
+	/* Throws std::runtime_error when the file cannot be written */
+	void save(const std::string& path) const;
+
+	/* Throws std::runtime_error for a missing, truncated or foreign file */
+	static SessionLog load(const std::string& path);
+};
+
+/* Nanoseconds of the clock sessions are timed with; nullptr: std::chrono::steady_clock */
+using SessionClock = std::function<std::uint64_t()>;
+
+/*
+ * RecordingTransport
+ * ------------------
+ * Forwards to the transport it wraps and appends every non-empty read and
+ * write to the log, from the Engine's thread. The log must outlive it and
+ * is only read once the Engine has stopped.
+ */
+class RecordingTransport : public Transport
+{
+public:
+	RecordingTransport(Transport& transport, SessionLog& log, SessionClock clock = nullptr);
+
+	std::size_t read(std::uint8_t* buffer, std::size_t capacity) override;
+	std::size_t write(const std::uint8_t* data, std::size_t length) override;
+	Ready       wait(bool wantWrite, int timeoutMs) override;
+	void        wake() override;
+
+private:
+	void add(SessionDirection direction, const std::uint8_t* data, std::size_t length);
+
+	Transport&    transport_;
+	SessionLog&   log_;
+	SessionClock  clock_;
+	std::uint64_t start_ = 0;
+	std::mutex    mutex_;
+};
+
+struct ReplayOptions
+{
+	bool                      lockstep = false;   /* Wait for the device's bytes instead of the clock */
+	double                    speed    = 1.0;     /* Paced: recorded gaps divided by this */
+	std::chrono::milliseconds timeout { 5000 };   /* Lockstep: longest wait for the device's bytes */
+	SessionClock              clock;              /* Times of the new session */
+};
+
+/* Sends the recorded host bytes over transport (no Engine on it) and returns the new session, with
+ * the recording's baud and CRC options; throws what the transport throws */
+SessionLog replaySession(const SessionLog& recorded, Transport& transport, const ReplayOptions& options = {});
+
+struct OpcodeLatency
+{
+	std::uint8_t  opcode   = 0;
+	std::uint32_t requests = 0;
+	std::uint32_t replies  = 0;      /* Replies paired with requests of this opcode */
+	std::uint32_t nacks    = 0;
+	double        totalMs  = 0.0;    /* Last request byte sent to last reply byte received */
+	double        maxMs    = 0.0;
+	double        deviceMs = -1.0;   /* Between the first and last GET_STATS, -1 without both */
+};
+
+struct SessionReport
+{
+	double                     durationMs     = 0.0;   /* First to last event */
+	std::size_t                sentBytes      = 0;
+	std::size_t                receivedBytes  = 0;
+	double                     wireSentMs     = 0.0;   /* Bytes x 10 bits at the baud rate */
+	double                     wireReceivedMs = 0.0;
+	double                     waitingMs      = 0.0;   /* At least one request unanswered */
+	double                     hostMs         = 0.0;   /* Nothing outstanding: the host was preparing the next request */
+	std::size_t                unanswered     = 0;     /* Requests still outstanding at the end */
+	std::size_t                droppedReplies = 0;     /* Replies failing their CRC (response CRC builds) */
+	std::uint32_t              statsSnapshots = 0;     /* GET_STATS replies in the session */
+	std::uint32_t              crcFailures    = 0;     /* Device counters between the first and last snapshot */
+	std::uint32_t              uartErrors     = 0;
+	std::vector<OpcodeLatency> opcodes;                /* Ascending opcode */
+};
+
+SessionReport analyzeSession(const SessionLog& log);
+
+/* Human-readable report (blflash report) */
+std::string describeSession(const SessionReport& report);
+
+}
+
+#endif /* BLHOST_SESSION_HPP */
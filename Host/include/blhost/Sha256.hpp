@@ -0,0 +1,45 @@
+#ifndef BLHOST_SHA256_HPP
+#define BLHOST_SHA256_HPP
+
+/*
+ * Sha256
+ * ------
+ * FIPS 180-4 SHA-256, the digest of BL_SHA256.h: update packages carry the
+ * SHA-256 of their payload and are signed over the SHA-256 of their
+ * manifest (Package.hpp). A plain implementation, one pass per package.
+ */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace blhost
+{
+
+constexpr std::size_t kSha256DigestSize = 32;
+
+using Sha256Digest = std::array<std::uint8_t, kSha256DigestSize>;
+
+class Sha256
+{
+public:
+	Sha256();
+
+	void         update(const std::uint8_t* data, std::size_t size);
+	Sha256Digest finish();
+
+	/* Digest of one buffer */
+	static Sha256Digest of(const std::uint8_t* data, std::size_t size);
+
+private:
+	void compress(const std::uint8_t* block);
+
+	std::array<std::uint32_t, 8> state_;
+	std::array<std::uint8_t, 64> block_ {};
+	std::size_t                  held_   = 0;
+	std::uint64_t                length_ = 0;
+};
+
+}
+
+#endif /* BLHOST_SHA256_HPP */
@@ -0,0 +1,72 @@
+#ifndef BLHOST_SIMULATOR_HPP
+#define BLHOST_SIMULATOR_HPP
+
+/*
+ * SimulatedDevice
+ * ---------------
+ * The bootloader core built for the host (Host/sim, BL_Sim.h) as a
+ * Transport: the protocol, the dispatcher and the write pipeline of the
+ * firmware run unmodified against a simulated F407 flash and USART2, so a
+ * transfer can be timed without a board. Time is simulated: stats().nowNs is
+ * how long the device took on the modelled link and flash, whatever the
+ * host machine's speed. The CPU is not modelled (infinitely fast).
+ *
+ * Only on Linux x86-64, in an executable linked without PIE; one instance
+ * per process, for the lifetime of the process (the core's statics are not
+ * reset).
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include "blhost/Transport.hpp"
+
+namespace blhost
+{
+
+struct SimOptions
+{
+	unsigned      baud         = 115200;
+	std::uint32_t programNs    = 16000;       /* One x32 word or x8 byte */
+	std::uint32_t erase16KbUs  = 250000;      /* STM32F407 datasheet typical, x32 parallelism */
+	std::uint32_t erase64KbUs  = 550000;
+	std::uint32_t erase128KbUs = 1000000;
+	std::uint32_t massEraseUs  = 8000000;
+};
+
+struct SimStats
+{
+	std::uint64_t nowNs        = 0;           /* Device clock */
+	std::uint64_t flashBusyNs  = 0;           /* Programming / erasing */
+	std::uint64_t rxBytes      = 0;           /* USART2 RX: written by the host */
+	std::uint64_t txBytes      = 0;           /* USART2 TX: read by the host */
+	std::uint32_t programOps   = 0;
+	std::uint32_t sectorErases = 0;
+	bool          running      = false;       /* false once the core jumped to an image */
+};
+
+class SimulatedDevice : public Transport
+{
+public:
+	/* Throws std::runtime_error when the memory map cannot be set up or a device already exists */
+	SimulatedDevice() : SimulatedDevice(SimOptions()) {}
+	explicit SimulatedDevice(const SimOptions& options);
+	~SimulatedDevice() override;
+
+	SimulatedDevice(const SimulatedDevice&)            = delete;
+	SimulatedDevice& operator=(const SimulatedDevice&) = delete;
+
+	std::size_t read(std::uint8_t* buffer, std::size_t capacity) override;
+	std::size_t write(const std::uint8_t* data, std::size_t length) override;
+	Ready       wait(bool wantWrite, int timeoutMs) override;
+	void        wake() override;
+
+	/* Host view of a simulated address, nullptr if unmapped: preload flash, inspect results */
+	std::uint8_t* memory(std::uint32_t address);
+
+	SimStats stats() const;
+};
+
+}
+
+#endif /* BLHOST_SIMULATOR_HPP */
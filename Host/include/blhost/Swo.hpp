@@ -0,0 +1,90 @@
+#ifndef BLHOST_SWO_HPP
+#define BLHOST_SWO_HPP
+
+/*
+ * SwoDecoder
+ * ----------
+ * ITM / DWT packets of a raw SWO capture (NRZ, TPIU formatter off, as the
+ * bootloader sets it up with BL_ITM_ENABLE): synchronisation, overflow,
+ * local and global timestamps, instrumentation (SWIT) and hardware source
+ * packets, among them the DWT's PC samples. The capture may start anywhere:
+ * bytes before the first header that makes sense are skipped, and after an
+ * overflow the stream is read on.
+ *
+ * TraceAssembler puts the bootloader's trace events back together from
+ * their three stimulus ports (BL_Trace.h); a field missing after an
+ * overflow drops the event it belongs to.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "blhost/Protocol.hpp"
+
+namespace blhost
+{
+
+struct SwoPacket
+{
+	enum class Kind
+	{
+		Sync,
+		Overflow,
+		LocalTimestamp,    /* value: cycles since the previous one (TS prescaler 1) */
+		GlobalTimestamp,   /* value: the low bits sent */
+		Instrumentation,   /* source: stimulus port */
+		Hardware,          /* source: discriminator, 2 for PC samples */
+		Extension,
+	};
+
+	Kind          kind   = Kind::Sync;
+	std::uint8_t  source = 0;
+	std::uint8_t  size   = 0;   /* Payload bytes of Instrumentation / Hardware */
+	std::uint32_t value  = 0;
+
+	/* DWT PC sample: size 4 is a sampled PC, size 1 the core asleep (WFI / WFE) */
+	bool isPcSample() const { return kind == Kind::Hardware && source == 2; }
+};
+
+class SwoDecoder
+{
+public:
+	/* Packets completed by data, appended to out; a packet may straddle calls */
+	void feed(const std::uint8_t* data, std::size_t length, std::vector<SwoPacket>& out);
+
+	std::size_t skippedBytes() const { return skipped_; }
+
+private:
+	enum class State { Header, Payload, Continuation };
+
+	State         state_    = State::Header;
+	SwoPacket     packet_;
+	std::uint8_t  need_     = 0;
+	std::uint8_t  have_     = 0;
+	unsigned      zeros_    = 0;
+	std::size_t   skipped_  = 0;
+};
+
+class TraceAssembler
+{
+public:
+	/* The event completed by packet, if any; sequence counts events since the capture started */
+	std::optional<TraceEvent> add(const SwoPacket& packet);
+
+	/* After an Overflow packet: the event being put together is lost */
+	void reset() { stage_ = 0; }
+
+	std::uint32_t dropped() const { return dropped_; }
+
+private:
+	unsigned      stage_    = 0;
+	TraceEvent    event_;
+	std::uint32_t sequence_ = 0;
+	std::uint32_t dropped_  = 0;
+};
+
+}
+
+#endif /* BLHOST_SWO_HPP */
@@ -0,0 +1,43 @@
+#ifndef BLHOST_SYMBOLS_HPP
+#define BLHOST_SYMBOLS_HPP
+
+/*
+ * SymbolTable
+ * -----------
+ * The functions of a 32-bit little-endian ELF file (.symtab, STT_FUNC), to
+ * name the PCs of an SWO capture. Static functions are there too, unless
+ * the compiler inlined them: their samples land in the caller.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace blhost
+{
+
+struct Symbol
+{
+	std::uint32_t address = 0;   /* Thumb bit cleared */
+	std::uint32_t size    = 0;
+	std::string   name;
+};
+
+class SymbolTable
+{
+public:
+	/* Throws std::runtime_error on an unreadable file or one that is not an ELF with a symbol table */
+	static SymbolTable load(const std::string& path);
+
+	/* The function holding address, nullptr outside all of them */
+	const Symbol* find(std::uint32_t address) const;
+
+	std::size_t size() const { return symbols_.size(); }
+
+private:
+	std::vector<Symbol> symbols_;   /* Sorted by address */
+};
+
+}
+
+#endif /* BLHOST_SYMBOLS_HPP */
@@ -0,0 +1,85 @@
+#ifndef BLHOST_TELEMETRY_HPP
+#define BLHOST_TELEMETRY_HPP
+
+/*
+ * TelemetryDecoder
+ * ----------------
+ * The UserApp's binary telemetry on USART2 (App_Telemetry.h): COBS frames
+ * ended by 0x00, each a version byte, a sequence number, a millisecond
+ * timestamp, typed records and a CRC-16/CCITT-FALSE. The capture may start
+ * anywhere and may carry printf text between frames: everything up to a
+ * 0x00 that does not decode into a frame with a good CRC is counted as bad
+ * and skipped (but for the piece before the first 0x00, which may be the
+ * tail of a frame). A sequence gap between good frames counts the frames the
+ * UserApp's transmit queue had no room for.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace blhost
+{
+
+/* App_Telemetry.h */
+constexpr std::uint8_t kTelemetryVersion = 1;
+
+enum class TelemetryType : std::uint8_t
+{
+	Mark = 0,
+	U8   = 1,
+	I16  = 2,
+	U16  = 3,
+	I32  = 4,
+	U32  = 5,
+};
+
+struct TelemetrySample
+{
+	std::uint32_t timeMs = 0;   /* UserApp HAL_GetTick */
+	std::uint8_t  field  = 0;
+	TelemetryType type   = TelemetryType::U8;
+	std::int64_t  value  = 0;   /* Signed types sign-extended */
+};
+
+struct TelemetryFrame
+{
+	std::uint16_t                sequence  = 0;
+	std::uint32_t                timestamp = 0;
+	std::vector<TelemetrySample> samples;
+};
+
+/* COBS decoding of one frame without its 0x00; false if it is not valid COBS */
+bool cobsDecode(const std::uint8_t* data, std::size_t length, std::vector<std::uint8_t>& out);
+
+/* "uptime_s", "vibe_x_rms_mg", ... ; "field_<n>" for an unknown one */
+std::string telemetryFieldName(std::uint8_t field);
+
+class TelemetryDecoder
+{
+public:
+	/* Frames completed by data, appended to out; a frame may straddle calls */
+	void feed(const std::uint8_t* data, std::size_t length, std::vector<TelemetryFrame>& out);
+
+	std::size_t frames() const { return frames_; }
+	std::size_t badFrames() const { return bad_; }
+	std::size_t lostFrames() const { return lost_; }
+
+private:
+	void decode(std::vector<TelemetryFrame>& out);
+
+	std::vector<std::uint8_t> encoded_;
+	std::vector<std::uint8_t> raw_;
+	bool                      first_     = true;    /* The capture may start inside a frame: not counted as bad */
+	bool                      overlong_  = false;   /* More bytes than any frame before the 0x00 */
+	bool                      sequenced_ = false;
+	std::uint16_t             next_      = 0;
+	std::size_t               frames_    = 0;
+	std::size_t               bad_       = 0;
+	std::size_t               lost_      = 0;
+};
+
+}
+
+#endif /* BLHOST_TELEMETRY_HPP */
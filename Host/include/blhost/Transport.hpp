@@ -0,0 +1,74 @@
+#ifndef BLHOST_TRANSPORT_HPP
+#define BLHOST_TRANSPORT_HPP
+
+/*
+ * Transport
+ * ---------
+ * Byte pipe to the bootloader, driven by the I/O engine (Engine.hpp) from its
+ * own thread. read / write never block; wait blocks until the pipe can make
+ * progress in the requested direction, the timeout ends or another thread
+ * calls wake. An application with its own link (TCP bridge, USB CDC library,
+ * test double) implements these calls.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace blhost
+{
+
+class Transport
+{
+public:
+	struct Ready
+	{
+		bool readable = false;
+		bool writable = false;
+	};
+
+	virtual ~Transport() = default;
+
+	/* Bytes read, 0 when nothing is waiting; throws on a broken link */
+	virtual std::size_t read(std::uint8_t* buffer, std::size_t capacity) = 0;
+
+	/* Bytes accepted, possibly fewer than length; throws on a broken link */
+	virtual std::size_t write(const std::uint8_t* data, std::size_t length) = 0;
+
+	virtual Ready wait(bool wantWrite, int timeoutMs) = 0;
+
+	/* Ends a wait in progress (or the next one) early, from any thread */
+	virtual void wake() = 0;
+};
+
+/*
+ * SerialPort
+ * ----------
+ * POSIX tty in raw 8N1 mode, non-blocking. Optional RTS/CTS flow control for
+ * a bootloader built with BL_UART_FLOW_CONTROL_ENABLE.
+ */
+class SerialPort : public Transport
+{
+public:
+	SerialPort(const std::string& device, unsigned baud, bool flowControl = false);
+	~SerialPort() override;
+
+	SerialPort(const SerialPort&)            = delete;
+	SerialPort& operator=(const SerialPort&) = delete;
+
+	std::size_t read(std::uint8_t* buffer, std::size_t capacity) override;
+	std::size_t write(const std::uint8_t* data, std::size_t length) override;
+	Ready       wait(bool wantWrite, int timeoutMs) override;
+	void        wake() override;
+
+	/* Discards whatever the driver still holds in both directions */
+	void flush();
+
+private:
+	int fd_      = -1;
+	int wake_[2] = { -1, -1 };   /* Self-pipe: wake() writes, wait() polls the read end */
+};
+
+}
+
+#endif /* BLHOST_TRANSPORT_HPP */
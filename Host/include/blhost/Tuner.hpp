@@ -0,0 +1,92 @@
+#ifndef BLHOST_TUNER_HPP
+#define BLHOST_TUNER_HPP
+
+/*
+ * StreamTuner
+ * -----------
+ * Packet size and window of a BL_MEM_WRITE_STREAM transfer, adapted to the
+ * link while it runs (AIMD, as TCP congestion control):
+ *
+ * - Every window's worth of acknowledged packets without a loss is a clean
+ *   round: the window grows by one packet, unless the smoothed RTT has
+ *   doubled over the lowest one seen (the device, not the link, is the
+ *   bottleneck and a larger window only queues in its RX ring). Four clean
+ *   rounds in a row grow the packet by kPacketStep bytes.
+ * - A loss (RETRANSMIT, MISSING, NACK or timeout) halves the window; a second
+ *   loss before a clean round also halves the packet, since long packets are
+ *   the ones a noisy line corrupts.
+ *
+ * Replies are waited for srtt + 4 rttvar (RFC 6298), at least kMinTimeout,
+ * doubled after every timeout until the next ACK and never longer than the
+ * caller's ceiling, so a packet lost at the tail costs a few RTTs rather
+ * than a fixed timeout.
+ *
+ * The window never drops below the device's ACK interval (it would stall)
+ * and never keeps more frames in flight than its RX ring holds, from
+ * BL_GET_CAPABILITIES. RTT samples come from packets sent once only (Karn).
+ * Without adaptation the starting values are only clipped to those limits.
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string>
+
+#include "blhost/Protocol.hpp"
+
+namespace blhost
+{
+
+using LogCallback = std::function<void(const std::string& line)>;
+
+class StreamTuner
+{
+public:
+	static constexpr std::size_t kMinPacket  = 128;
+	static constexpr std::size_t kPacketStep = 256;
+	static constexpr std::chrono::milliseconds kMinTimeout { 100 };
+
+	StreamTuner(const Capabilities& caps, std::size_t packetSize, unsigned window, bool adaptive,
+	            LogCallback log = nullptr);
+
+	std::size_t packetSize() const { return packetSize_; }
+	unsigned    window() const { return window_; }
+	std::chrono::microseconds smoothedRtt() const { return std::chrono::microseconds(static_cast<long long>(srttUs_)); }
+
+	/* How long to wait for the next reply; the ceiling until an RTT is known */
+	std::chrono::milliseconds timeout(std::chrono::milliseconds ceiling) const;
+
+	/* Packets newly acknowledged, and the RTT of the newest if it was sent once */
+	void onAck(std::size_t packets, std::chrono::microseconds rtt);
+	void onLoss(const char* why);
+	void onTimeout();
+
+	/* Final parameters, RTT and loss rate, one line */
+	std::string summary() const;
+
+private:
+	std::size_t frameSize(std::size_t packet) const;
+	unsigned    windowLimit() const;
+	void        report(const char* why);
+
+	Capabilities caps_;
+	bool         adaptive_;
+	LogCallback  log_;
+	std::size_t  maxPacket_;
+	std::size_t  packetSize_;
+	unsigned     window_;
+
+	std::size_t  credit_      = 0;      /* Packets acknowledged in this round */
+	unsigned     cleanRounds_ = 0;
+	bool         lossInRound_ = false;
+	std::size_t  acked_       = 0;
+	unsigned     losses_      = 0;
+	double       srttUs_      = 0.0;
+	double       rttvarUs_    = 0.0;
+	unsigned     backoff_     = 0;      /* Timeouts since the last ACK */
+	double       minRttUs_    = 0.0;
+};
+
+}
+
+#endif /* BLHOST_TUNER_HPP */
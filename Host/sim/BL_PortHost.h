@@ -0,0 +1,25 @@
+#ifndef SIM_BL_PORTHOST_H_
+#define SIM_BL_PORTHOST_H_
+
+/*
+ * Host Port
+ * ---------
+ * BL_Port.h for the simulated device (BL_Sim.h): a busy wait of the core
+ * hands control to the simulation, which delivers the bytes, DMA events,
+ * erase completions and SysTicks due at the simulated time, or advances the
+ * time to the next of them.
+ */
+
+void BL_voidSimWaitEvent(void);                                          /* Simulated interrupts, see BL_SimDevice.c */
+
+#define BL_PORT_WAIT_EVENT()          BL_voidSimWaitEvent()
+
+/* Simulated interrupts only run inside BL_voidSimWaitEvent, on the core's own thread */
+#define BL_PORT_IRQ_SAVE()            (0u)
+#define BL_PORT_IRQ_RESTORE(STATE)    ((void)(STATE))
+
+/* No watchdog in the simulation */
+#define BL_PORT_WATCHDOG_REFRESH()
+
+
+#endif /* SIM_BL_PORTHOST_H_ */
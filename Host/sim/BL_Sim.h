@@ -0,0 +1,91 @@
+#ifndef SIM_BL_SIM_H_
+#define SIM_BL_SIM_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Simulated Bootloader
+ * --------------------
+ * The bootloader core (BL.c, BL_Transport.c and the modules it uses) built
+ * for Linux x86-64 behind the port layer of BL_Port.h:
+ *  - the F407 memory map (flash, CCM, system memory / OTP / UID, SRAM,
+ *    peripherals, backup SRAM, Cortex-M private bus) is mapped at its real
+ *    addresses, so the core's fixed addresses and uint32_t <-> pointer casts
+ *    hold; registers nobody emulates are plain memory,
+ *  - BL_Flash.h on that memory with the datasheet timing (BL_SimFlash.c),
+ *  - BL_CRC.h in software (BL_SimCRC.c),
+ *  - BL_UART.h as two byte queues with the timing of an 8N1 line, DMA
+ *    reception into the core's own ring with half / full / IDLE events, DMA
+ *    transmission (BL_SimDevice.c).
+ * The executable must be linked without PIE (the core's globals stay below
+ * 4 GB); the core runs on its own thread with a stack mapped below 4 GB.
+ *
+ * Time is simulated, in ns: the host side is released from the device's
+ * clock only through the bytes it reads. Every byte written by the host
+ * arrives one character time after the previous one, or after the last byte
+ * the host has read (it reacts at once); flash operations take their
+ * duration; the CPU is infinitely fast. A transfer therefore completes as
+ * fast as the host machine runs, while BL_SimStats_t.NowNs tells how long it
+ * would take on the modelled link and flash.
+ * The clock only jumps to an erase end or TX completion while the host is
+ * waiting with nothing left to read, so host reactions are never skipped.
+ *
+ * One device per process, started once: the core's statics are not reset.
+ */
+
+typedef struct
+{
+	uint32_t BaudRate;                          /* Initial USART2 rate; BL_CHANGE_BAUD changes it */
+	uint32_t ProgramNs;                         /* One x32 word or x8 byte program */
+	uint32_t Erase16KbUs;                       /* Sector erase, x32 parallelism */
+	uint32_t Erase64KbUs;
+	uint32_t Erase128KbUs;
+	uint32_t MassEraseUs;
+} BL_SimConfig_t;
+
+typedef struct
+{
+	uint64_t NowNs;                             /* Device clock */
+	uint64_t FlashBusyNs;                       /* Spent programming / erasing (synchronous or not) */
+	uint64_t RxBytes;                           /* USART2 RX: written by the host */
+	uint64_t TxBytes;                           /* USART2 TX: read by the host */
+	uint32_t ProgramOps;                        /* Words + bytes programmed */
+	uint32_t SectorErases;
+	uint8_t  Running;                           /* 0 once the core jumped away (BL_GO_TO_ADDR ...) or stopped */
+} BL_SimStats_t;
+
+
+/*
+ * Bootloader Simulation Functions
+ * -------------------------------
+ * Host side, from one thread at a time (except BL_voidSimHostWake).
+ */
+
+void     BL_voidSimDefaultConfig(BL_SimConfig_t* Copy_pConfig);          /* 115200 baud, STM32F407 datasheet typical times */
+
+uint8_t  BL_uint8SimStart(const BL_SimConfig_t* Copy_pConfig);         /* Maps the memory, starts the core: 0 on success */
+
+void     BL_voidSimStop(void);                                            /* Ends the core thread */
+
+uint8_t* BL_puint8SimMemory(uint32_t Copy_uint32Address);                /* Host view of a simulated address (preload, inspect), NULL if unmapped */
+
+uint32_t BL_uint32SimHostWrite(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length); /* Bytes queued towards USART2 RX */
+
+uint32_t BL_uint32SimHostRead(uint8_t* Copy_puint8Buffer, uint32_t Copy_uint32Capacity);    /* Bytes the device sent */
+
+uint8_t  BL_uint8SimHostWait(int32_t Copy_int32TimeoutMs);              /* 1 when bytes are ready to read, 0 on timeout / wake */
+
+void     BL_voidSimHostWake(void);                                        /* Ends a BL_uint8SimHostWait early, any thread */
+
+void     BL_voidSimGetStats(BL_SimStats_t* Copy_pStats);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_BL_SIM_H_ */
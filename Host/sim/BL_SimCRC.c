@@ -0,0 +1,258 @@
+#include "main.h"
+#include "BL_CRC.h"
+
+/*
+ * Simulated CRC Unit
+ * ------------------
+ * BL_CRC.h in software: the same word-wise / byte-per-word conventions, one
+ * 32-bit "data register" (Global_uint32Unit) for BL_voidCRCReset /
+ * BL_uint32CRCFeedBytes, a table for the 32 shift / XOR steps of a word.
+ */
+
+#define CRC_POLYNOMIAL                0x04C11DB7UL
+#define CRC_INITIAL_VALUE             0xFFFFFFFFUL
+
+static uint32_t Global_uint32Table[256];
+static uint32_t Global_uint32Unit = CRC_INITIAL_VALUE;
+
+
+/*
+ * uint32_FeedWord
+ * ---------------
+ * One write of the data register: crc ^= word, then 32 steps, a byte at a time.
+ */
+static uint32_t uint32_FeedWord(uint32_t Copy_uint32Crc, uint32_t Copy_uint32Word)
+{
+	uint8_t Local_uint8Step;
+
+	Copy_uint32Crc ^= Copy_uint32Word;
+
+	for(Local_uint8Step = 0; Local_uint8Step < 4u; Local_uint8Step++)
+	{
+		Copy_uint32Crc = (Copy_uint32Crc << 8) ^ Global_uint32Table[Copy_uint32Crc >> 24];
+	}
+
+	return Copy_uint32Crc;
+}
+
+
+/*
+ * uint32_FeedWords
+ * ----------------
+ * Whole little-endian words, continuing Copy_uint32Crc.
+ */
+static uint32_t uint32_FeedWords(uint32_t Copy_uint32Crc, const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Words)
+{
+	for( ; Copy_uint32Words != 0u; Copy_uint32Words--)
+	{
+		Copy_uint32Crc = uint32_FeedWord(Copy_uint32Crc, __UNALIGNED_UINT32_READ(Copy_puint8Data));
+		Copy_puint8Data += 4u;
+	}
+
+	return Copy_uint32Crc;
+}
+
+
+/*
+ * BL_voidCRCInit
+ * --------------
+ * Builds the step table (no DMA stream to set up).
+ */
+void BL_voidCRCInit(void)
+{
+	uint32_t Local_uint32Index;
+	uint32_t Local_uint32Value;
+	uint8_t  Local_uint8Bit;
+
+	for(Local_uint32Index = 0; Local_uint32Index < 256u; Local_uint32Index++)
+	{
+		Local_uint32Value = Local_uint32Index << 24;
+
+		for(Local_uint8Bit = 0; Local_uint8Bit < 8u; Local_uint8Bit++)
+		{
+			Local_uint32Value = ((Local_uint32Value & 0x80000000UL) != 0u) ? ((Local_uint32Value << 1) ^ CRC_POLYNOMIAL) : (Local_uint32Value << 1);
+		}
+
+		Global_uint32Table[Local_uint32Index] = Local_uint32Value;
+	}
+}
+
+
+uint32_t BL_uint32CRCCalculate(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length)
+{
+	uint32_t Local_uint32Crc = uint32_FeedWords(CRC_INITIAL_VALUE, Copy_puint8Data, Copy_uint32Length / 4u);
+
+	Copy_puint8Data += Copy_uint32Length & ~3u;
+
+	for(Copy_uint32Length &= 3u; Copy_uint32Length != 0u; Copy_uint32Length--)
+	{
+		Local_uint32Crc = uint32_FeedWord(Local_uint32Crc, *Copy_puint8Data);
+		Copy_puint8Data++;
+	}
+
+	return Local_uint32Crc;
+}
+
+
+/*
+ * BL_uint32CRCCalculateIEEE
+ * -------------------------
+ * Standard CRC-32 directly on the reflected value, a bit at a time: the
+ * reference the bit-reversed unit of the target has to match.
+ */
+uint32_t BL_uint32CRCCalculateIEEE(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length)
+{
+	uint32_t Local_uint32Crc = CRC_INITIAL_VALUE;
+	uint8_t  Local_uint8Bit;
+
+	for( ; Copy_uint32Length != 0u; Copy_uint32Length--)
+	{
+		Local_uint32Crc ^= *Copy_puint8Data;
+		Copy_puint8Data++;
+
+		for(Local_uint8Bit = 0; Local_uint8Bit < 8u; Local_uint8Bit++)
+		{
+			Local_uint32Crc = (Local_uint32Crc >> 1) ^ (BL_CRC_IEEE_POLYNOMIAL & (0u - (Local_uint32Crc & 1u)));
+		}
+	}
+
+	return ~Local_uint32Crc;
+}
+
+
+void BL_voidCRCStreamStart(BL_CRCStream_t* Copy_pStream)
+{
+	Copy_pStream->State     = CRC_INITIAL_VALUE;
+	Copy_pStream->Length    = 0;
+	Copy_pStream->TailCount = 0;
+}
+
+
+void BL_voidCRCStreamUpdate(BL_CRCStream_t* Copy_pStream, const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length)
+{
+	uint32_t Local_uint32Crc = Copy_pStream->State;
+
+	Copy_pStream->Length += Copy_uint32Length;
+
+	while((Copy_pStream->TailCount != 0u) && (Copy_uint32Length != 0u))
+	{
+		Copy_pStream->Tail[Copy_pStream->TailCount] = *Copy_puint8Data;
+		Copy_pStream->TailCount = (uint8_t)((Copy_pStream->TailCount + 1u) & 3u);
+		Copy_puint8Data++;
+		Copy_uint32Length--;
+
+		if(Copy_pStream->TailCount == 0u)
+		{
+			Local_uint32Crc = uint32_FeedWord(Local_uint32Crc, __UNALIGNED_UINT32_READ(Copy_pStream->Tail));
+		}
+	}
+
+	Local_uint32Crc    = uint32_FeedWords(Local_uint32Crc, Copy_puint8Data, Copy_uint32Length / 4u);
+	Copy_puint8Data   += Copy_uint32Length & ~3u;
+	Copy_uint32Length &= 3u;
+
+	for( ; Copy_uint32Length != 0u; Copy_uint32Length--)
+	{
+		Copy_pStream->Tail[Copy_pStream->TailCount] = *Copy_puint8Data;
+		Copy_pStream->TailCount++;
+		Copy_puint8Data++;
+	}
+
+	Copy_pStream->State = Local_uint32Crc;
+}
+
+
+uint32_t BL_uint32CRCStreamFinish(const BL_CRCStream_t* Copy_pStream)
+{
+	uint32_t Local_uint32Crc = Copy_pStream->State;
+	uint8_t  Local_uint8Iterator;
+
+	for(Local_uint8Iterator = 0; Local_uint8Iterator < Copy_pStream->TailCount; Local_uint8Iterator++)
+	{
+		Local_uint32Crc = uint32_FeedWord(Local_uint32Crc, Copy_pStream->Tail[Local_uint8Iterator]);
+	}
+
+	return Local_uint32Crc;
+}
+
+
+void BL_voidCRCReset(void)
+{
+	Global_uint32Unit = CRC_INITIAL_VALUE;
+}
+
+
+uint32_t BL_uint32CRCFeedBytes(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length)
+{
+	for( ; Copy_uint32Length != 0u; Copy_uint32Length--)
+	{
+		Global_uint32Unit = uint32_FeedWord(Global_uint32Unit, *Copy_puint8Data);
+		Copy_puint8Data++;
+	}
+
+	return Global_uint32Unit;
+}
+
+
+/*
+ * BL_uint8CRCCheckFrame
+ * ---------------------
+ * Always checks: no DMA stream can be busy with the unit.
+ */
+uint8_t BL_uint8CRCCheckFrame(const uint8_t* Copy_puint8Frame, uint16_t Copy_uint16Length)
+{
+	uint16_t Local_uint16Length = (uint16_t)(Copy_uint16Length - 4u);
+	uint16_t Local_uint16Iterator = 0;
+	uint32_t Local_uint32Crc = CRC_INITIAL_VALUE;
+
+#if BL_CRC_WORDWISE_ENABLE
+	for( ; (Local_uint16Iterator + 4u) <= Local_uint16Length; Local_uint16Iterator += 4u)
+	{
+		Local_uint32Crc = uint32_FeedWord(Local_uint32Crc, __UNALIGNED_UINT32_READ(&Copy_puint8Frame[Local_uint16Iterator]));
+	}
+#endif
+	for( ; Local_uint16Iterator < Local_uint16Length; Local_uint16Iterator++)
+	{
+		Local_uint32Crc = uint32_FeedWord(Local_uint32Crc, Copy_puint8Frame[Local_uint16Iterator]);
+	}
+
+	return (Local_uint32Crc == __UNALIGNED_UINT32_READ(&Copy_puint8Frame[Local_uint16Length])) ? BL_CRC_FRAME_OK : BL_CRC_FRAME_BAD;
+}
+
+
+/*
+ * BL_uint8CRCCheckFrameStart / BL_uint8CRCCheckFramePoll
+ * ------------------------------------------------------
+ * No DMA: the start checks at once and the poll hands the result out, one
+ * check at a time as on the target.
+ */
+static uint8_t Global_uint8AsyncStatus = BL_CRC_FRAME_UNCHECKED;
+
+uint8_t BL_uint8CRCCheckFrameStart(const uint8_t* Copy_puint8Frame, uint16_t Copy_uint16Length)
+{
+#if BL_CRC_WORDWISE_ENABLE
+	if((Global_uint8AsyncStatus != BL_CRC_FRAME_UNCHECKED) || (Copy_uint16Length < 8u))
+	{
+		return BL_CRC_FRAME_UNCHECKED;
+	}
+
+	Global_uint8AsyncStatus = BL_uint8CRCCheckFrame(Copy_puint8Frame, Copy_uint16Length);
+
+	return BL_CRC_FRAME_PENDING;
+#else
+	(void)Copy_puint8Frame;
+	(void)Copy_uint16Length;
+
+	return BL_CRC_FRAME_UNCHECKED;
+#endif
+}
+
+uint8_t BL_uint8CRCCheckFramePoll(uint8_t Copy_uint8Wait)
+{
+	uint8_t Local_uint8Status = Global_uint8AsyncStatus;
+
+	(void)Copy_uint8Wait;
+	Global_uint8AsyncStatus = BL_CRC_FRAME_UNCHECKED;
+
+	return Local_uint8Status;
+}
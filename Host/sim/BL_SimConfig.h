@@ -0,0 +1,25 @@
+#ifndef SIM_BL_SIM_CONFIG_H_
+#define SIM_BL_SIM_CONFIG_H_
+
+/*
+ * Simulated Bootloader Configuration
+ * ----------------------------------
+ * BL_CONFIG_FILE of the host build (BL_config.h): every optional subsystem
+ * the 32 KB flash budget keeps off by default is switched on here, so blsim,
+ * the ctest gates and host tools run against all of them. The host build
+ * has no flash budget.
+ */
+
+#define BL_LZ_ENABLE                 1
+#define BL_DELTA_ENABLE              1
+#define BL_PACKAGE_ENABLE            1
+#define BL_SELF_UPDATE_ENABLE        1
+#define BL_READ_RLE_ENABLE           1
+#define BL_SHA256_ENABLE             1
+#define BL_TRACE_ENABLE              1
+#define BL_STATS_ENABLE              1
+#define BL_PROGRESS_ENABLE           1
+#define BL_LINK_TEST_ENABLE          1
+#define BL_SLOT_CACHE_ENABLE         1
+
+#endif /* SIM_BL_SIM_CONFIG_H_ */
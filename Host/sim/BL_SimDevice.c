@@ -0,0 +1,979 @@
+#include <errno.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "main.h"
+#include "BL.h"
+#include "BL_Transport.h"
+#include "BL_Flash.h"
+#include "BL_SlotCache.h"
+#include "BL_CRC.h"
+#include "BL_AES.h"
+#include "BL_UART.h"
+#include "MemoryUsage.h"
+#include "BL_Port.h"
+#include "BL_SimPrivate.h"
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE           0x100000
+#endif
+
+/*
+ * Simulated Device
+ * ----------------
+ * Memory map, device clock, USART2 line and DMA (BL_UART.h), the HAL calls
+ * of the core, and the core's command loop on its own thread (see BL_Sim.h).
+ *
+ * Locking: one mutex (recursive: callbacks of the core run with it held and
+ * may come back through BL_voidSimAdvance / BL_voidSimFlashAccount) guards
+ * the clock, the line queues and the statistics. The core itself only runs
+ * on the device thread, so the interrupts it sees, delivered from
+ * BL_voidSimWaitEvent, never overlap its own code.
+ */
+
+#define SIM_QUEUE_SIZE                65536u    /* Bytes on the line in each direction, power of two */
+#define SIM_DEVICE_STACK_SIZE         (1024u * 1024u)
+#define SIM_NS_PER_MS                 1000000ULL
+#define SIM_HOST_QUIET_NS             2000000LL /* Host idle this long (wall time): the clock may jump to an erase end */
+
+/* Identity the core reports (GET_CID, GET_DEVICE_INFO) */
+#define SIM_IDCODE                    0x10076413UL   /* Revision 0x1007, device 0x413 (F405 / F407) */
+#define SIM_IDCODE_ADDRESS            0xE0042000UL   /* DBGMCU_IDCODE (BL_private.h) */
+#define SIM_FLASH_SIZE_KB             1024u
+
+typedef struct
+{
+	uint32_t Base;
+	uint32_t Size;
+	uint8_t  Fill;
+} BL_SimRegion_t;
+
+/*
+ * Global_Regions
+ * --------------
+ * Mapped at their real addresses. The system memory region holds OTP, its
+ * lock bytes, the UID and the flash size word; the peripheral region also
+ * holds the backup SRAM.
+ */
+static const BL_SimRegion_t Global_Regions[] =
+{
+	{ FLASH_BASE,       0x00100000UL, 0xFFu },  /* Flash, erased */
+	{ CCMDATARAM_BASE,  0x00010000UL, 0x00u },  /* CCM (handoff block) */
+	{ 0x1FFF0000UL,     0x00010000UL, 0xFFu },  /* System memory, OTP, UID, option bytes */
+	{ SRAM1_BASE,       0x00020000UL, 0x00u },  /* SRAM1 / SRAM2 */
+	{ PERIPH_BASE,      0x00080000UL, 0x00u },  /* APB1 / APB2 / AHB1, backup SRAM */
+	{ 0xE0000000UL,     0x00100000UL, 0x00u }   /* Cortex-M private bus (SCB, DWT, DBGMCU) */
+};
+
+#define SIM_REGION_COUNT              (sizeof(Global_Regions) / sizeof(Global_Regions[0]))
+
+/*
+ * BL_SimQueue_t
+ * -------------
+ * One direction of the line: each byte with the device time at which its
+ * stop bit ends.
+ */
+typedef struct
+{
+	uint8_t  Data[SIM_QUEUE_SIZE];
+	uint64_t Time[SIM_QUEUE_SIZE];
+	uint32_t Head;                              /* Next byte out, free-running */
+	uint32_t Tail;                              /* Next byte in, free-running */
+} BL_SimQueue_t;
+
+uint32_t SystemCoreClock = 16000000UL;           /* HSI, as SystemClock_Config */
+BL_PortMaskStats_t BL_PortMaskStats;             /* Nothing is masked here: stays 0 */
+
+/*
+ * Simulation state
+ * ----------------
+ * Global_uint64Now         : Device clock, ns.
+ * Global_uint64ByteNs      : One 8N1 character at the current baud rate.
+ * Global_uint64RxLineFree  : End of the last byte queued by the host.
+ * Global_uint64TxLineFree  : End of the last byte the device sent.
+ * Global_uint64HostNow     : Host clock: end of the last byte it has read.
+ * Global_uint64LastTickNs  : Last SysTick delivered.
+ * Global_puint8DmaRing     : USART2 RX DMA target (NULL while aborted), its
+ *                            size and the next position written.
+ */
+static pthread_mutex_t Global_Mutex;
+static pthread_cond_t  Global_DeviceCond;
+static pthread_cond_t  Global_HostCond;
+static pthread_t       Global_Thread;
+static jmp_buf         Global_Exit;
+
+static BL_SimQueue_t   Global_Rx;
+static BL_SimQueue_t   Global_Tx;
+static BL_SimStats_t   Global_Stats;
+
+static uint64_t Global_uint64Now;
+static uint64_t Global_uint64ByteNs;
+static uint64_t Global_uint64RxLineFree;
+static uint64_t Global_uint64TxLineFree;
+static uint64_t Global_uint64HostNow;
+static uint64_t Global_uint64LastTickNs;
+
+static uint8_t* Global_puint8DmaRing;
+static uint32_t Global_uint32DmaSize;
+static uint32_t Global_uint32DmaPosition;
+
+static uint8_t  Global_uint8Started;
+static uint8_t  Global_uint8Stop;
+static uint8_t  Global_uint8HostWaiting;
+static uint8_t  Global_uint8HostWake;
+static int64_t  Global_int64HostActivity;       /* Wall time of the last host call, ns */
+
+static FLASH_OBProgramInitTypeDef Global_OptionBytes;
+
+/* Frames wrapping around the end of the ring are copied here (Bootloader_UartReadData) */
+static uint8_t  Global_uint8CmdPacket[BL_MAX_FRAME_LENGTH] __attribute__((aligned(4)));
+
+
+/*
+ * int64_WallNs
+ * ------------
+ * Monotonic wall time, ns.
+ */
+static int64_t int64_WallNs(void)
+{
+	struct timespec Local_Time;
+
+	clock_gettime(CLOCK_MONOTONIC, &Local_Time);
+	return ((int64_t)Local_Time.tv_sec * 1000000000LL) + Local_Time.tv_nsec;
+}
+
+
+/*
+ * voidTimedWait
+ * -------------
+ * Waits on a condition for at most Copy_int64Ns of wall time.
+ */
+static void voidTimedWait(pthread_cond_t* Copy_pCond, int64_t Copy_int64Ns)
+{
+	int64_t Local_int64Deadline = int64_WallNs() + Copy_int64Ns;
+	struct timespec Local_Time;
+
+	Local_Time.tv_sec  = (time_t)(Local_int64Deadline / 1000000000LL);
+	Local_Time.tv_nsec = (long)(Local_int64Deadline % 1000000000LL);
+	(void)pthread_cond_timedwait(Copy_pCond, &Global_Mutex, &Local_Time);
+}
+
+
+static uint32_t uint32_QueueLength(const BL_SimQueue_t* Copy_pQueue)
+{
+	return Copy_pQueue->Tail - Copy_pQueue->Head;
+}
+
+
+/*
+ * voidLeave
+ * ---------
+ * Ends the core: back to the start of the device thread. Called without the mutex.
+ */
+__attribute__((noreturn)) static void voidLeave(void)
+{
+	longjmp(Global_Exit, 1);
+}
+
+
+/*
+ * voidSetBaudRate
+ * ---------------
+ * Character time of the line, both directions (10 bits per byte).
+ */
+static void voidSetBaudRate(uint32_t Copy_uint32BaudRate)
+{
+	Global_uint64ByteNs = (10000000000ULL + (Copy_uint32BaudRate / 2u)) / Copy_uint32BaudRate;
+}
+
+
+/*
+ * uint8_DeliverDue
+ * ----------------
+ * The USART2 RX DMA: bytes whose stop bit has ended by now are written into
+ * the core's ring (NDTR follows), with the half / full ring events. When
+ * the line then goes quiet the IDLE event is raised; inside a burst the
+ * parser is only told to look again (on the target it reads NDTR live).
+ *
+ * Return:
+ * -------
+ * @return uint8_t : 1 if any byte was delivered.
+ */
+static uint8_t uint8_DeliverDue(void)
+{
+	uint64_t Local_uint64Last = 0;
+	uint32_t Local_uint32Index;
+	uint8_t  Local_uint8Delivered = 0;
+
+	while((uint32_QueueLength(&Global_Rx) != 0u) && (Global_Rx.Time[Global_Rx.Head & (SIM_QUEUE_SIZE - 1u)] <= Global_uint64Now))
+	{
+		Local_uint32Index = Global_Rx.Head & (SIM_QUEUE_SIZE - 1u);
+		Local_uint64Last  = Global_Rx.Time[Local_uint32Index];
+		Global_Rx.Head++;
+		Local_uint8Delivered = 1u;
+
+		/* Reception aborted: the byte is lost, as in an overrun */
+		if(Global_puint8DmaRing == NULL)
+		{
+			continue;
+		}
+
+		Global_puint8DmaRing[Global_uint32DmaPosition] = Global_Rx.Data[Local_uint32Index];
+		Global_uint32DmaPosition++;
+		if(Global_uint32DmaPosition == Global_uint32DmaSize)
+		{
+			Global_uint32DmaPosition = 0;
+		}
+
+		if((Global_uint32DmaPosition == (Global_uint32DmaSize / 2u)) || (Global_uint32DmaPosition == 0u))
+		{
+			BL_voidTransportUartRxEvent();
+		}
+	}
+
+	if(Local_uint8Delivered != 0u)
+	{
+		if((uint32_QueueLength(&Global_Rx) == 0u) ||
+		   (Global_Rx.Time[Global_Rx.Head & (SIM_QUEUE_SIZE - 1u)] > (Local_uint64Last + Global_uint64ByteNs)))
+		{
+			BL_voidTransportUartRxEvent();
+		}
+		else
+		{
+			BL_voidTransportNotifyRx();
+		}
+	}
+
+	return Local_uint8Delivered;
+}
+
+
+/*
+ * uint64_NextRxEvent
+ * ------------------
+ * Device time of the next reception event: the end of the burst at the head
+ * of the queue, or the byte completing the current ring half if earlier.
+ */
+static uint64_t uint64_NextRxEvent(void)
+{
+	uint32_t Local_uint32Length = uint32_QueueLength(&Global_Rx);
+	uint32_t Local_uint32Room   = SIM_QUEUE_SIZE;
+	uint32_t Local_uint32Index  = Global_Rx.Head;
+	uint32_t Local_uint32Count  = 1u;
+
+	if(Local_uint32Length == 0u)
+	{
+		return BL_SIM_NO_EVENT;
+	}
+
+	if(Global_puint8DmaRing != NULL)
+	{
+		Local_uint32Room = ((Global_uint32DmaPosition < (Global_uint32DmaSize / 2u)) ? (Global_uint32DmaSize / 2u) : Global_uint32DmaSize) -
+		                   Global_uint32DmaPosition;
+	}
+
+	while((Local_uint32Count < Local_uint32Room) && (Local_uint32Count < Local_uint32Length) &&
+	      (Global_Rx.Time[(Local_uint32Index + 1u) & (SIM_QUEUE_SIZE - 1u)] <= (Global_Rx.Time[Local_uint32Index & (SIM_QUEUE_SIZE - 1u)] + Global_uint64ByteNs)))
+	{
+		Local_uint32Index++;
+		Local_uint32Count++;
+	}
+
+	return Global_Rx.Time[Local_uint32Index & (SIM_QUEUE_SIZE - 1u)];
+}
+
+
+/*
+ * uint8_HostQuiet
+ * ---------------
+ * The host waits with nothing to read and nothing sent for SIM_HOST_QUIET_NS:
+ * nothing it does can arrive before an event the device is waiting for.
+ */
+static uint8_t uint8_HostQuiet(void)
+{
+	return (uint8_t)((Global_uint8HostWaiting != 0u) && (uint32_QueueLength(&Global_Tx) == 0u) &&
+	                 (uint32_QueueLength(&Global_Rx) == 0u) && ((int64_WallNs() - Global_int64HostActivity) >= SIM_HOST_QUIET_NS));
+}
+
+
+/*
+ * voidSysTicks
+ * ------------
+ * One BL_voidSessionTick per simulated millisecond elapsed.
+ */
+static void voidSysTicks(void)
+{
+	while((Global_uint64Now - Global_uint64LastTickNs) >= SIM_NS_PER_MS)
+	{
+		Global_uint64LastTickNs += SIM_NS_PER_MS;
+		BL_voidSessionTick();
+	}
+}
+
+
+/*
+ * BL_voidSimWaitEvent
+ * -------------------
+ * BL_PORT_WAIT_EVENT of the host port: the core waits for an interrupt.
+ *
+ * Behavior:
+ * ---------
+ * 1. Delivers what is due at the current time: received bytes, the end of a
+ *    started erase, SysTicks. Anything delivered returns to the core, which
+ *    checks its flags again.
+ * 2. Otherwise advances the clock to the next reception event, or to the end
+ *    of the erase once the host is quiet (uint8_HostQuiet).
+ * 3. With nothing to expect, sleeps until the host writes or stops the device.
+ */
+void BL_voidSimWaitEvent(void)
+{
+	uint64_t Local_uint64Next;
+	uint8_t  Local_uint8Events;
+
+	pthread_mutex_lock(&Global_Mutex);
+
+	while(1)
+	{
+		if(Global_uint8Stop != 0u)
+		{
+			pthread_mutex_unlock(&Global_Mutex);
+			voidLeave();
+		}
+
+		Local_uint8Events  = uint8_DeliverDue();
+		Local_uint8Events |= BL_uint8SimFlashEvent();
+		voidSysTicks();
+
+		if(Local_uint8Events != 0u)
+		{
+			break;
+		}
+
+		Local_uint64Next = uint64_NextRxEvent();
+		if(Local_uint64Next != BL_SIM_NO_EVENT)
+		{
+			Global_uint64Now = Local_uint64Next;
+		}
+		else if(BL_uint64SimFlashPendingEnd() != BL_SIM_NO_EVENT)
+		{
+			if(uint8_HostQuiet() != 0u)
+			{
+				Global_uint64Now = BL_uint64SimFlashPendingEnd();
+			}
+			else
+			{
+				voidTimedWait(&Global_DeviceCond, SIM_HOST_QUIET_NS);
+			}
+		}
+		else
+		{
+			pthread_cond_wait(&Global_DeviceCond, &Global_Mutex);
+		}
+	}
+
+	pthread_mutex_unlock(&Global_Mutex);
+}
+
+
+uint64_t BL_uint64SimNow(void)
+{
+	return Global_uint64Now;
+}
+
+
+void BL_voidSimAdvance(uint64_t Copy_uint64Ns)
+{
+	pthread_mutex_lock(&Global_Mutex);
+	Global_uint64Now += Copy_uint64Ns;
+	pthread_mutex_unlock(&Global_Mutex);
+}
+
+
+void BL_voidSimFlashAccount(uint64_t Copy_uint64Ns, uint32_t Copy_uint32Programs, uint32_t Copy_uint32Erases)
+{
+	pthread_mutex_lock(&Global_Mutex);
+	Global_Stats.FlashBusyNs  += Copy_uint64Ns;
+	Global_Stats.ProgramOps   += Copy_uint32Programs;
+	Global_Stats.SectorErases += Copy_uint32Erases;
+	pthread_mutex_unlock(&Global_Mutex);
+}
+
+
+/*
+ * voidTransmit
+ * ------------
+ * USART2 TX: the bytes leave one character time apart, after the previous
+ * response (the TxAcquire wait of the core is where the clock catches up).
+ * Waits for the host to read when the queue is full.
+ */
+static void voidTransmit(const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length)
+{
+	uint64_t Local_uint64Time;
+	uint16_t Local_uint16Iterator;
+
+	pthread_mutex_lock(&Global_Mutex);
+
+	while((uint32_QueueLength(&Global_Tx) + Copy_uint16Length) > SIM_QUEUE_SIZE)
+	{
+		if(Global_uint8Stop != 0u)
+		{
+			pthread_mutex_unlock(&Global_Mutex);
+			voidLeave();
+		}
+		pthread_cond_wait(&Global_DeviceCond, &Global_Mutex);
+	}
+
+	if(Global_uint64TxLineFree > Global_uint64Now)
+	{
+		Global_uint64Now = Global_uint64TxLineFree;
+	}
+	Local_uint64Time = Global_uint64Now;
+
+	for(Local_uint16Iterator = 0; Local_uint16Iterator < Copy_uint16Length; Local_uint16Iterator++)
+	{
+		Local_uint64Time += Global_uint64ByteNs;
+		Global_Tx.Data[Global_Tx.Tail & (SIM_QUEUE_SIZE - 1u)] = Copy_puint8Data[Local_uint16Iterator];
+		Global_Tx.Time[Global_Tx.Tail & (SIM_QUEUE_SIZE - 1u)] = Local_uint64Time;
+		Global_Tx.Tail++;
+	}
+
+	Global_uint64TxLineFree   = Local_uint64Time;
+	Global_Stats.TxBytes += Copy_uint16Length;
+
+	pthread_cond_broadcast(&Global_HostCond);
+	pthread_mutex_unlock(&Global_Mutex);
+}
+
+
+/*
+ * voidDrainTx
+ * -----------
+ * TxFlush: the clock waits for the last stop bit.
+ */
+static void voidDrainTx(void)
+{
+	pthread_mutex_lock(&Global_Mutex);
+	if(Global_uint64TxLineFree > Global_uint64Now)
+	{
+		Global_uint64Now = Global_uint64TxLineFree;
+	}
+	pthread_mutex_unlock(&Global_Mutex);
+}
+
+
+/*
+ * HAL
+ * ---
+ * The calls the core makes, on the simulated peripherals.
+ */
+uint32_t HAL_GetTick(void)
+{
+	return (uint32_t)(Global_uint64Now / SIM_NS_PER_MS);
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq(void)
+{
+	return SystemCoreClock;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+	(void)GPIOx;
+	(void)GPIO_Pin;
+	(void)PinState;
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_Init)
+{
+	(void)GPIOx;
+	(void)GPIO_Init;
+}
+
+void HAL_PWR_EnableBkUpAccess(void)
+{
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+	FLASH->CR &= ~FLASH_CR_LOCK;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+	FLASH->CR |= FLASH_CR_LOCK;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_OB_Unlock(void)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_OB_Lock(void)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_OB_Launch(void)
+{
+	return HAL_OK;
+}
+
+void HAL_FLASHEx_OBGetConfig(FLASH_OBProgramInitTypeDef* pOBInit)
+{
+	*pOBInit = Global_OptionBytes;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_OBProgram(FLASH_OBProgramInitTypeDef* pOBInit)
+{
+	if((pOBInit->OptionType & OPTIONBYTE_WRP) != 0u)
+	{
+		if(pOBInit->WRPState == OB_WRPSTATE_ENABLE)
+		{
+			Global_OptionBytes.WRPSector &= ~pOBInit->WRPSector;
+		}
+		else
+		{
+			Global_OptionBytes.WRPSector |= pOBInit->WRPSector;
+		}
+	}
+
+	if((pOBInit->OptionType & OPTIONBYTE_RDP) != 0u)
+	{
+		Global_OptionBytes.RDPLevel = pOBInit->RDPLevel;
+	}
+
+	return HAL_OK;
+}
+
+
+
+/*
+ * BL_UART.c
+ * ---------
+ * USART2 on the simulated line: reception into the ring from its start,
+ * responses in line order, the DMA transfer done at once (the clock catches
+ * up at the next flush), so the line is never busy for the core.
+ */
+void BL_voidUARTStartRx(uint8_t* Copy_puint8Ring, uint16_t Copy_uint16Size)
+{
+	Global_puint8DmaRing     = Copy_puint8Ring;
+	Global_uint32DmaSize     = Copy_uint16Size;
+	Global_uint32DmaPosition = 0;
+}
+
+void BL_voidUARTStopRx(void)
+{
+	Global_puint8DmaRing = NULL;
+}
+
+uint16_t BL_uint16UARTRxRemaining(void)
+{
+	return (uint16_t)(Global_uint32DmaSize - Global_uint32DmaPosition);
+}
+
+void BL_voidUARTTransmit(const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length)
+{
+	voidTransmit(Copy_puint8Data, Copy_uint16Length);
+}
+
+void BL_voidUARTWrite(const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length)
+{
+	voidTransmit(Copy_puint8Data, Copy_uint16Length);
+	voidDrainTx();
+}
+
+uint8_t BL_uint8UARTTxBusy(void)
+{
+	return 0u;
+}
+
+uint8_t BL_uint8UARTSetBaudRate(uint32_t Copy_uint32BaudRate)
+{
+	if(Copy_uint32BaudRate == 0u)
+	{
+		return 1u;
+	}
+
+	voidDrainTx();
+	voidSetBaudRate(Copy_uint32BaudRate);
+	return 0u;
+}
+
+
+/*
+ * main.c
+ * ------
+ * Leaving the bootloader ends the simulation; a trial start has no watchdog
+ * here, and no staged update or trial ever holds a handoff back.
+ */
+void Bootloader_JumpToImage(uint32_t Copy_uint32Base)
+{
+	(void)Copy_uint32Base;
+
+	voidDrainTx();
+	voidLeave();
+}
+
+void Bootloader_JumpToLoader(uint32_t Copy_uint32Base)
+{
+	(void)Copy_uint32Base;
+
+	voidDrainTx();
+	voidLeave();
+}
+
+void BL_voidSimReset(void)
+{
+	voidDrainTx();
+	voidLeave();
+}
+
+uint8_t Bootloader_HandoffAllowed(void)
+{
+	return 1u;
+}
+
+void Bootloader_LeaveUpdateMode(uint8_t Copy_uint8Reset)
+{
+	(void)Copy_uint8Reset;
+
+	voidDrainTx();
+	voidLeave();
+}
+
+void Bootloader_TrialStart(void)
+{
+}
+
+
+/*
+ * sysmem.c
+ * --------
+ * No linker script and no startup here: the core runs on the host's
+ * stack and heap, so there is no reserve to report.
+ */
+void Memory_GetUsage(MemoryUsage_t* Usage)
+{
+	memset(Usage, 0, sizeof(*Usage));
+}
+
+
+/*
+ * pvoidDeviceThread
+ * -----------------
+ * The bootloader-mode path of main(): CRC set-up, then the command loop of
+ * Bootloader_UartReadData.
+ */
+static void* pvoidDeviceThread(void* Copy_pvoidArgument)
+{
+	uint8_t* Local_puint8Frame;
+
+	(void)Copy_pvoidArgument;
+
+	if(setjmp(Global_Exit) == 0)
+	{
+		BL_voidCRCInit();
+#if BL_DECRYPT_ENABLE
+		BL_voidAESInit();
+#endif
+		BL_voidFlashInit();
+		BL_voidTransportInit();
+
+		while(1)
+		{
+			BL_voidRunBackgroundTasks();
+
+			if(BL_uint16TransportReceiveFrame(&Local_puint8Frame, Global_uint8CmdPacket, sizeof(Global_uint8CmdPacket)) == 0)
+			{
+				continue;
+			}
+
+			BL_voidDispatchCommand(Local_puint8Frame);
+		}
+	}
+
+	pthread_mutex_lock(&Global_Mutex);
+	Global_Stats.Running = 0;
+	pthread_cond_broadcast(&Global_HostCond);
+	pthread_mutex_unlock(&Global_Mutex);
+
+	return NULL;
+}
+
+
+/*
+ * uint8_MapMemory
+ * ---------------
+ * Maps every region at its address and writes the identity words.
+ *
+ * Return:
+ * -------
+ * @return uint8_t : 0, or 1 if an address range is already in use.
+ */
+static uint8_t uint8_MapMemory(void)
+{
+	uint32_t Local_uint32Region;
+	void*    Local_pvoidMapping;
+
+	for(Local_uint32Region = 0; Local_uint32Region < SIM_REGION_COUNT; Local_uint32Region++)
+	{
+		Local_pvoidMapping = mmap((void*)(uintptr_t)Global_Regions[Local_uint32Region].Base, Global_Regions[Local_uint32Region].Size,
+		                          PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+		if(Local_pvoidMapping != (void*)(uintptr_t)Global_Regions[Local_uint32Region].Base)
+		{
+			return 1u;
+		}
+
+		memset(Local_pvoidMapping, Global_Regions[Local_uint32Region].Fill, Global_Regions[Local_uint32Region].Size);
+	}
+
+	*((volatile uint32_t*)(UID_BASE + 0u))   = 0x00300041UL;
+	*((volatile uint32_t*)(UID_BASE + 4u))   = 0x3138470EUL;
+	*((volatile uint32_t*)(UID_BASE + 8u))   = 0x39373530UL;
+	*((volatile uint16_t*)FLASHSIZE_BASE)    = SIM_FLASH_SIZE_KB;
+	*((volatile uint32_t*)SIM_IDCODE_ADDRESS) = SIM_IDCODE;
+	FLASH->CR                                = FLASH_CR_LOCK;
+
+	return 0;
+}
+
+
+void BL_voidSimDefaultConfig(BL_SimConfig_t* Copy_pConfig)
+{
+	/* Datasheet typical values at 2.7 V .. 3.6 V, x32 parallelism */
+	Copy_pConfig->BaudRate     = 115200u;
+	Copy_pConfig->ProgramNs    = 16000u;
+	Copy_pConfig->Erase16KbUs  = 250000u;
+	Copy_pConfig->Erase64KbUs  = 550000u;
+	Copy_pConfig->Erase128KbUs = 1000000u;
+	Copy_pConfig->MassEraseUs  = 8000000u;
+}
+
+
+/*
+ * BL_uint8SimStart
+ * ----------------
+ * Maps the memory, sets up the peripherals the core expects after
+ * MX_xxx_Init, and starts the core on a thread whose stack lies below 4 GB.
+ *
+ * Return:
+ * -------
+ * @return uint8_t : 0 on success, 1 if already started or the memory map or
+ *                   the thread could not be set up.
+ */
+uint8_t BL_uint8SimStart(const BL_SimConfig_t* Copy_pConfig)
+{
+	pthread_mutexattr_t Local_MutexAttr;
+	pthread_condattr_t  Local_CondAttr;
+	pthread_attr_t      Local_ThreadAttr;
+	void*               Local_pvoidStack;
+
+	if((Global_uint8Started != 0u) || (Copy_pConfig->BaudRate == 0u) || (uint8_MapMemory() != 0u))
+	{
+		return 1u;
+	}
+
+	Local_pvoidStack = mmap(NULL, SIM_DEVICE_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT | MAP_STACK, -1, 0);
+	if(Local_pvoidStack == MAP_FAILED)
+	{
+		return 1u;
+	}
+
+	pthread_mutexattr_init(&Local_MutexAttr);
+	pthread_mutexattr_settype(&Local_MutexAttr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&Global_Mutex, &Local_MutexAttr);
+	pthread_mutexattr_destroy(&Local_MutexAttr);
+
+	pthread_condattr_init(&Local_CondAttr);
+	pthread_condattr_setclock(&Local_CondAttr, CLOCK_MONOTONIC);
+	pthread_cond_init(&Global_DeviceCond, &Local_CondAttr);
+	pthread_cond_init(&Global_HostCond, &Local_CondAttr);
+	pthread_condattr_destroy(&Local_CondAttr);
+
+	Global_OptionBytes.RDPLevel  = OB_RDP_LEVEL_0;
+	Global_OptionBytes.WRPSector = OB_WRP_SECTOR_All;    /* nWRP set: nothing protected */
+
+	voidSetBaudRate(Copy_pConfig->BaudRate);
+	BL_voidSimFlashConfigure(Copy_pConfig);
+	Global_Stats.Running     = 1u;
+	Global_int64HostActivity = int64_WallNs();
+	Global_uint8Started      = 1u;
+
+	pthread_attr_init(&Local_ThreadAttr);
+	pthread_attr_setstack(&Local_ThreadAttr, Local_pvoidStack, SIM_DEVICE_STACK_SIZE);
+	if(pthread_create(&Global_Thread, &Local_ThreadAttr, pvoidDeviceThread, NULL) != 0)
+	{
+		Global_Stats.Running = 0;
+	}
+	pthread_attr_destroy(&Local_ThreadAttr);
+
+	return (Global_Stats.Running != 0u) ? 0u : 1u;
+}
+
+
+void BL_voidSimStop(void)
+{
+	if(Global_uint8Started == 0u)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&Global_Mutex);
+	Global_uint8Stop = 1u;
+	pthread_cond_broadcast(&Global_DeviceCond);
+	pthread_mutex_unlock(&Global_Mutex);
+
+	pthread_join(Global_Thread, NULL);
+	Global_uint8Started = 0;
+}
+
+
+/*
+ * BL_puint8SimMemory
+ * ------------------
+ * The host may write through the pointer behind the core's back: the slot
+ * cache forgets the flash from the address on, as after a program.
+ */
+uint8_t* BL_puint8SimMemory(uint32_t Copy_uint32Address)
+{
+	uint32_t Local_uint32Region;
+
+#if BL_SLOT_CACHE_ENABLE
+	if((Copy_uint32Address - FLASH_BASE) <= (FLASH_END - FLASH_BASE))
+	{
+		BL_voidSlotCacheInvalidate(Copy_uint32Address, (FLASH_END + 1u) - Copy_uint32Address);
+	}
+#endif
+
+	for(Local_uint32Region = 0; Local_uint32Region < SIM_REGION_COUNT; Local_uint32Region++)
+	{
+		if((Copy_uint32Address - Global_Regions[Local_uint32Region].Base) < Global_Regions[Local_uint32Region].Size)
+		{
+			return (uint8_t*)(uintptr_t)Copy_uint32Address;
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ * BL_uint32SimHostWrite
+ * ---------------------
+ * Queues bytes towards USART2 RX: the first starts when both the host (its
+ * last read) and the line are free, each following one a character later.
+ */
+uint32_t BL_uint32SimHostWrite(const uint8_t* Copy_puint8Data, uint32_t Copy_uint32Length)
+{
+	uint32_t Local_uint32Iterator;
+	uint64_t Local_uint64Time;
+
+	pthread_mutex_lock(&Global_Mutex);
+
+	if(Copy_uint32Length > (SIM_QUEUE_SIZE - uint32_QueueLength(&Global_Rx)))
+	{
+		Copy_uint32Length = SIM_QUEUE_SIZE - uint32_QueueLength(&Global_Rx);
+	}
+
+	Local_uint64Time = (Global_uint64RxLineFree > Global_uint64HostNow) ? Global_uint64RxLineFree : Global_uint64HostNow;
+
+	for(Local_uint32Iterator = 0; Local_uint32Iterator < Copy_uint32Length; Local_uint32Iterator++)
+	{
+		Local_uint64Time += Global_uint64ByteNs;
+		Global_Rx.Data[Global_Rx.Tail & (SIM_QUEUE_SIZE - 1u)] = Copy_puint8Data[Local_uint32Iterator];
+		Global_Rx.Time[Global_Rx.Tail & (SIM_QUEUE_SIZE - 1u)] = Local_uint64Time;
+		Global_Rx.Tail++;
+	}
+
+	Global_uint64RxLineFree   = Local_uint64Time;
+	Global_Stats.RxBytes += Copy_uint32Length;
+	Global_int64HostActivity  = int64_WallNs();
+
+	pthread_cond_broadcast(&Global_DeviceCond);
+	pthread_mutex_unlock(&Global_Mutex);
+
+	return Copy_uint32Length;
+}
+
+
+/*
+ * BL_uint32SimHostRead
+ * --------------------
+ * Takes the bytes the device sent; the host clock moves to the last one.
+ */
+uint32_t BL_uint32SimHostRead(uint8_t* Copy_puint8Buffer, uint32_t Copy_uint32Capacity)
+{
+	uint32_t Local_uint32Count = 0;
+	uint32_t Local_uint32Index;
+
+	pthread_mutex_lock(&Global_Mutex);
+
+	while((Local_uint32Count < Copy_uint32Capacity) && (uint32_QueueLength(&Global_Tx) != 0u))
+	{
+		Local_uint32Index = Global_Tx.Head & (SIM_QUEUE_SIZE - 1u);
+		Copy_puint8Buffer[Local_uint32Count++] = Global_Tx.Data[Local_uint32Index];
+		if(Global_Tx.Time[Local_uint32Index] > Global_uint64HostNow)
+		{
+			Global_uint64HostNow = Global_Tx.Time[Local_uint32Index];
+		}
+		Global_Tx.Head++;
+	}
+
+	if(Local_uint32Count != 0u)
+	{
+		Global_int64HostActivity = int64_WallNs();
+		pthread_cond_broadcast(&Global_DeviceCond);
+	}
+
+	pthread_mutex_unlock(&Global_Mutex);
+
+	return Local_uint32Count;
+}
+
+
+uint8_t BL_uint8SimHostWait(int32_t Copy_int32TimeoutMs)
+{
+	int64_t Local_int64Deadline = int64_WallNs() + ((int64_t)Copy_int32TimeoutMs * 1000000LL);
+	uint8_t Local_uint8Ready;
+
+	pthread_mutex_lock(&Global_Mutex);
+
+	Global_uint8HostWaiting = 1u;
+	pthread_cond_broadcast(&Global_DeviceCond);
+
+	while((uint32_QueueLength(&Global_Tx) == 0u) && (Global_uint8HostWake == 0u) && (Global_Stats.Running != 0u) &&
+	      (int64_WallNs() < Local_int64Deadline))
+	{
+		voidTimedWait(&Global_HostCond, Local_int64Deadline - int64_WallNs());
+	}
+
+	Local_uint8Ready        = (uint8_t)(uint32_QueueLength(&Global_Tx) != 0u);
+	Global_uint8HostWaiting = 0;
+	Global_uint8HostWake    = 0;
+
+	pthread_mutex_unlock(&Global_Mutex);
+
+	return Local_uint8Ready;
+}
+
+
+void BL_voidSimHostWake(void)
+{
+	pthread_mutex_lock(&Global_Mutex);
+	Global_uint8HostWake = 1u;
+	pthread_cond_broadcast(&Global_HostCond);
+	pthread_mutex_unlock(&Global_Mutex);
+}
+
+
+void BL_voidSimGetStats(BL_SimStats_t* Copy_pStats)
+{
+	pthread_mutex_lock(&Global_Mutex);
+	*Copy_pStats       = Global_Stats;
+	Copy_pStats->NowNs = Global_uint64Now;
+	pthread_mutex_unlock(&Global_Mutex);
+}
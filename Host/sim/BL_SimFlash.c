@@ -0,0 +1,533 @@
+#include <string.h>
+#include "main.h"
+#include "BL_Flash.h"
+#include "BL_Transport.h"
+#include "BL_Trace.h"
+#include "BL_SlotCache.h"
+#include "BL_SimPrivate.h"
+
+/*
+ * Simulated Flash Interface
+ * -------------------------
+ * BL_Flash.h on the flash mapped at FLASH_BASE (BL_SimDevice.c):
+ *  - programming clears bits only (the result is old AND new, as on the
+ *    cells), one ProgramNs per word of the body and per head / tail byte,
+ *  - an erase sets the sector to 0xFF when it ends,
+ *  - every operation first waits for a started erase, like the BSY wait,
+ *  - with FLASH_CR_LOCK set (HAL_FLASH_Lock) program and erase fail.
+ */
+
+
+/* Same layout as BL_Flash.c */
+static const BL_FlashSector_t Global_FlashSectors[BL_FLASH_SECTOR_COUNT] =
+{
+	{ 0x08000000UL, 0x04000UL },                /* Sector 0  :  16 KB */
+	{ 0x08004000UL, 0x04000UL },                /* Sector 1  :  16 KB */
+	{ 0x08008000UL, 0x04000UL },                /* Sector 2  :  16 KB */
+	{ 0x0800C000UL, 0x04000UL },                /* Sector 3  :  16 KB */
+	{ 0x08010000UL, 0x10000UL },                /* Sector 4  :  64 KB */
+	{ 0x08020000UL, 0x20000UL },                /* Sector 5  : 128 KB */
+	{ 0x08040000UL, 0x20000UL },                /* Sector 6  : 128 KB */
+	{ 0x08060000UL, 0x20000UL },                /* Sector 7  : 128 KB */
+	{ 0x08080000UL, 0x20000UL },                /* Sector 8  : 128 KB */
+	{ 0x080A0000UL, 0x20000UL },                /* Sector 9  : 128 KB */
+	{ 0x080C0000UL, 0x20000UL },                /* Sector 10 : 128 KB */
+	{ 0x080E0000UL, 0x20000UL }                 /* Sector 11 : 128 KB */
+};
+
+/*
+ * Operation times (BL_voidSimFlashConfigure), ns
+ * ----------------------------------------------
+ */
+static uint64_t Global_uint64ProgramNs;
+static uint64_t Global_uint64Erase16KbNs;
+static uint64_t Global_uint64Erase64KbNs;
+static uint64_t Global_uint64Erase128KbNs;
+static uint64_t Global_uint64MassEraseNs;
+
+/*
+ * Started erase (BL_voidFlashEraseSectorStart)
+ * --------------------------------------------
+ * Global_uint8PendingSector : Sector being erased, BL_FLASH_INVALID_SECTOR if none.
+ * Global_uint64PendingEnd   : Device time at which it ends.
+ */
+static uint8_t  Global_uint8PendingSector = BL_FLASH_INVALID_SECTOR;
+static uint64_t Global_uint64PendingStart;
+static uint64_t Global_uint64PendingEnd = BL_SIM_NO_EVENT;
+
+static volatile uint8_t Global_uint8EraseResult = HAL_OK;
+
+#if BL_WEAR_STATS_ENABLE
+static uint16_t Global_uint16EraseCounts[BL_FLASH_SECTOR_COUNT];
+#endif
+
+#if BL_STATS_ENABLE
+static BL_FlashTiming_t Global_FlashTiming;
+#endif
+
+
+/*
+ * uint64_EraseNs
+ * --------------
+ * Erase time of a sector from its size.
+ */
+static uint64_t uint64_EraseNs(uint8_t Copy_uint8Sector)
+{
+	uint32_t Local_uint32Size = Global_FlashSectors[Copy_uint8Sector].Size;
+
+	return (Local_uint32Size == 0x04000UL) ? Global_uint64Erase16KbNs :
+	       (Local_uint32Size == 0x10000UL) ? Global_uint64Erase64KbNs : Global_uint64Erase128KbNs;
+}
+
+
+/*
+ * voidCountErase
+ * --------------
+ * BL_WEAR_STATS_ENABLE: one more erase of a sector, counted when started.
+ */
+static void voidCountErase(uint8_t Copy_uint8Sector)
+{
+#if BL_WEAR_STATS_ENABLE
+	if(Global_uint16EraseCounts[Copy_uint8Sector] != 0xFFFFu)
+	{
+		Global_uint16EraseCounts[Copy_uint8Sector]++;
+	}
+#else
+	(void)Copy_uint8Sector;
+#endif
+}
+
+
+#if BL_STATS_ENABLE
+/*
+ * voidRecordTiming
+ * ----------------
+ * Same histograms as BL_Flash.c, from the simulated operation time.
+ */
+static void voidRecordTiming(uint8_t Copy_uint8Erase, uint8_t Copy_uint8Sector, uint64_t Copy_uint64Ns, uint32_t Copy_uint32Units)
+{
+	uint32_t             Local_uint32Size   = Global_FlashSectors[Copy_uint8Sector].Size;
+	uint8_t              Local_uint8Class   = (Local_uint32Size == 0x04000UL) ? BL_FLASH_CLASS_16KB :
+	                                          (Local_uint32Size == 0x10000UL) ? BL_FLASH_CLASS_64KB : BL_FLASH_CLASS_128KB;
+	BL_FlashHistogram_t* Local_pHistogram   = Copy_uint8Erase ? &Global_FlashTiming.Erase[Local_uint8Class] : &Global_FlashTiming.Program[Local_uint8Class];
+	uint32_t             Local_uint32Us     = (uint32_t)(Copy_uint64Ns / 1000u);
+	uint32_t             Local_uint32Bucket = (Local_uint32Us == 0u) ? 0u : (32u - (uint32_t)__builtin_clz(Local_uint32Us));
+
+	if(Local_uint32Bucket >= BL_FLASH_TIMING_BUCKETS)
+	{
+		Local_uint32Bucket = BL_FLASH_TIMING_BUCKETS - 1u;
+	}
+
+	Local_pHistogram->Counts[Local_uint32Bucket]++;
+	Local_pHistogram->TotalUs += Local_uint32Us;
+	Local_pHistogram->Units   += Copy_uint32Units;
+	if(Local_uint32Us > Local_pHistogram->MaxUs)
+	{
+		Local_pHistogram->MaxUs = Local_uint32Us;
+	}
+}
+#endif
+
+
+/*
+ * voidFinishErase
+ * ---------------
+ * End of the started erase: the sector reads 0xFF, the result is recorded and
+ * the command loop woken (BL_voidFlashIRQHandler on the target).
+ */
+static void voidFinishErase(void)
+{
+	const BL_FlashSector_t* Local_pSector = &Global_FlashSectors[Global_uint8PendingSector];
+
+	memset((void*)Local_pSector->Base, 0xFF, Local_pSector->Size);
+	BL_voidSimFlashAccount(Global_uint64PendingEnd - Global_uint64PendingStart, 0, 1u);
+#if BL_STATS_ENABLE
+	voidRecordTiming(1u, Global_uint8PendingSector, Global_uint64PendingEnd - Global_uint64PendingStart, 1u);
+#endif
+
+	Global_uint8PendingSector = BL_FLASH_INVALID_SECTOR;
+	Global_uint64PendingEnd   = BL_SIM_NO_EVENT;
+	Global_uint8EraseResult   = HAL_OK;
+	BL_TRACE(BL_TRACE_ERASE_END, 0xFFu, HAL_OK);
+	BL_voidTransportNotifyBackground();
+}
+
+
+/*
+ * uint8_WaitForFlash
+ * ------------------
+ * BSY wait: a started erase runs to its end first. HAL_ERROR while locked.
+ */
+static uint8_t uint8_WaitForFlash(void)
+{
+	if(Global_uint8PendingSector != BL_FLASH_INVALID_SECTOR)
+	{
+		if(Global_uint64PendingEnd > BL_uint64SimNow())
+		{
+			BL_voidSimAdvance(Global_uint64PendingEnd - BL_uint64SimNow());
+		}
+		voidFinishErase();
+	}
+
+	return ((FLASH->CR & FLASH_CR_LOCK) != 0u) ? HAL_ERROR : HAL_OK;
+}
+
+
+/*
+ * voidProgramByte
+ * ---------------
+ * One cell write: bits only go from 1 to 0.
+ */
+static void voidProgramByte(uint32_t Copy_uint32Address, uint8_t Copy_uint8Value)
+{
+	*(volatile uint8_t*)Copy_uint32Address &= Copy_uint8Value;
+}
+
+
+void BL_voidSimFlashConfigure(const BL_SimConfig_t* Copy_pConfig)
+{
+	Global_uint64ProgramNs    = Copy_pConfig->ProgramNs;
+	Global_uint64Erase16KbNs  = (uint64_t)Copy_pConfig->Erase16KbUs * 1000u;
+	Global_uint64Erase64KbNs  = (uint64_t)Copy_pConfig->Erase64KbUs * 1000u;
+	Global_uint64Erase128KbNs = (uint64_t)Copy_pConfig->Erase128KbUs * 1000u;
+	Global_uint64MassEraseNs  = (uint64_t)Copy_pConfig->MassEraseUs * 1000u;
+}
+
+uint64_t BL_uint64SimFlashPendingEnd(void)
+{
+	return Global_uint64PendingEnd;
+}
+
+uint8_t BL_uint8SimFlashEvent(void)
+{
+	if((Global_uint8PendingSector == BL_FLASH_INVALID_SECTOR) || (Global_uint64PendingEnd > BL_uint64SimNow()))
+	{
+		return 0;
+	}
+
+	voidFinishErase();
+	return 1u;
+}
+
+
+/*
+ * BL_voidFlashInit
+ * ----------------
+ * Nothing to relocate: the simulated interrupts do not fetch from flash.
+ * The slot cache of an earlier simulated device in this process is dropped.
+ */
+void BL_voidFlashInit(void)
+{
+#if BL_SLOT_CACHE_ENABLE
+	BL_voidSlotCacheInvalidate(FLASH_BASE, (FLASH_END + 1u) - FLASH_BASE);
+#endif
+}
+
+
+/*
+ * BL_uint8FlashSelectParallelism / BL_uint8FlashGetParallelism / BL_uint16FlashGetVdd
+ * -----------------------------------------------------------------------------------
+ * The simulated board runs from 3.3 V: always x32.
+ */
+uint8_t BL_uint8FlashSelectParallelism(void)
+{
+	return BL_FLASH_PSIZE_X32;
+}
+
+uint8_t BL_uint8FlashGetParallelism(void)
+{
+	return BL_FLASH_PSIZE_X32;
+}
+
+uint16_t BL_uint16FlashGetVdd(void)
+{
+	return 3300u;
+}
+
+
+/*
+ * BL_uint8FlashProgram
+ * --------------------
+ * Same head / body / tail split as BL_Flash.c, one ProgramNs per operation.
+ */
+uint8_t BL_uint8FlashProgram(uint32_t Copy_uint32Address, const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length)
+{
+	uint16_t Local_uint16Iterator = 0;
+	uint32_t Local_uint32Operations = 0;
+
+	BL_TRACE(BL_TRACE_PROGRAM_START, Copy_uint16Length, Copy_uint32Address);
+
+	if(uint8_WaitForFlash() != HAL_OK)
+	{
+		BL_TRACE(BL_TRACE_PROGRAM_END, 0u, HAL_ERROR);
+		return HAL_ERROR;
+	}
+#if BL_SLOT_CACHE_ENABLE
+	BL_voidSlotCacheInvalidate(Copy_uint32Address, Copy_uint16Length);
+#endif
+
+	/* Head: bytes up to the first word-aligned address */
+	while((Local_uint16Iterator < Copy_uint16Length) && (((Copy_uint32Address + Local_uint16Iterator) & 0x3u) != 0u))
+	{
+		Local_uint32Operations++;
+		Local_uint16Iterator++;
+	}
+
+	/* Body words, then tail bytes */
+	Local_uint32Operations += (uint32_t)(Copy_uint16Length - Local_uint16Iterator) / 4u;
+	Local_uint32Operations += (uint32_t)(Copy_uint16Length - Local_uint16Iterator) % 4u;
+
+	for(Local_uint16Iterator = 0; Local_uint16Iterator < Copy_uint16Length; Local_uint16Iterator++)
+	{
+		voidProgramByte(Copy_uint32Address + Local_uint16Iterator, Copy_puint8Data[Local_uint16Iterator]);
+	}
+
+	BL_voidSimAdvance(Local_uint32Operations * Global_uint64ProgramNs);
+	BL_voidSimFlashAccount(Local_uint32Operations * Global_uint64ProgramNs, Local_uint32Operations, 0);
+#if BL_STATS_ENABLE
+	if(BL_uint8FlashGetSector(Copy_uint32Address) != BL_FLASH_INVALID_SECTOR)
+	{
+		voidRecordTiming(0u, BL_uint8FlashGetSector(Copy_uint32Address), Local_uint32Operations * Global_uint64ProgramNs, Copy_uint16Length);
+	}
+#endif
+	BL_TRACE(BL_TRACE_PROGRAM_END, 0u, HAL_OK);
+
+	return HAL_OK;
+}
+
+
+/*
+ * BL_uint8FlashEraseSector
+ * ------------------------
+ * Erases one sector, the clock advancing by its erase time.
+ */
+uint8_t BL_uint8FlashEraseSector(uint8_t Copy_uint8Sector)
+{
+	uint64_t Local_uint64Ns;
+
+	if((Copy_uint8Sector >= BL_FLASH_SECTOR_COUNT) || (uint8_WaitForFlash() != HAL_OK))
+	{
+		return HAL_ERROR;
+	}
+
+	voidCountErase(Copy_uint8Sector);
+	BL_TRACE(BL_TRACE_ERASE_START, Copy_uint8Sector, 0u);
+#if BL_SLOT_CACHE_ENABLE
+	BL_voidSlotCacheInvalidate(Global_FlashSectors[Copy_uint8Sector].Base, Global_FlashSectors[Copy_uint8Sector].Size);
+#endif
+
+	Local_uint64Ns = uint64_EraseNs(Copy_uint8Sector);
+	BL_voidSimAdvance(Local_uint64Ns);
+	memset((void*)Global_FlashSectors[Copy_uint8Sector].Base, 0xFF, Global_FlashSectors[Copy_uint8Sector].Size);
+	BL_voidSimFlashAccount(Local_uint64Ns, 0, 1u);
+#if BL_STATS_ENABLE
+	voidRecordTiming(1u, Copy_uint8Sector, Local_uint64Ns, 1u);
+#endif
+	BL_TRACE(BL_TRACE_ERASE_END, Copy_uint8Sector, HAL_OK);
+
+	return HAL_OK;
+}
+
+
+/*
+ * BL_uint8FlashMassErase
+ * ----------------------
+ * The whole bank; the simulated core keeps running (it is not in the flash).
+ */
+uint8_t BL_uint8FlashMassErase(void)
+{
+	uint8_t Local_uint8Sector;
+
+	if(uint8_WaitForFlash() != HAL_OK)
+	{
+		return HAL_ERROR;
+	}
+
+	for(Local_uint8Sector = 0; Local_uint8Sector < BL_FLASH_SECTOR_COUNT; Local_uint8Sector++)
+	{
+		voidCountErase(Local_uint8Sector);
+	}
+#if BL_SLOT_CACHE_ENABLE
+	BL_voidSlotCacheInvalidate(FLASH_BASE, (FLASH_END + 1u) - FLASH_BASE);
+#endif
+
+	BL_voidSimAdvance(Global_uint64MassEraseNs);
+	memset((void*)FLASH_BASE, 0xFF, (FLASH_END - FLASH_BASE) + 1u);
+	BL_voidSimFlashAccount(Global_uint64MassEraseNs, 0, BL_FLASH_SECTOR_COUNT);
+	BL_TRACE(BL_TRACE_MASS_ERASE, 0u, HAL_OK);
+
+	return HAL_OK;
+}
+
+
+/*
+ * BL_voidFlashReplaceBootloader
+ * -----------------------------
+ * Sectors 0 and 1 erased unless blank, the image programmed a word per
+ * operation, then the reset ends the simulation.
+ */
+void BL_voidFlashReplaceBootloader(uint32_t Copy_uint32Source, uint32_t Copy_uint32Length)
+{
+	uint8_t  Local_uint8Sector;
+	uint32_t Local_uint32Offset;
+	uint64_t Local_uint64Ns;
+
+	(void)uint8_WaitForFlash();
+
+	for(Local_uint8Sector = 0; Local_uint8Sector < BL_FLASH_BOOTLOADER_SECTORS; Local_uint8Sector++)
+	{
+		if(BL_uint8FlashSectorIsBlank(Local_uint8Sector) == BL_FLASH_SECTOR_NOT_BLANK)
+		{
+			voidCountErase(Local_uint8Sector);
+			Local_uint64Ns = uint64_EraseNs(Local_uint8Sector);
+			BL_voidSimAdvance(Local_uint64Ns);
+			memset((void*)Global_FlashSectors[Local_uint8Sector].Base, 0xFF, Global_FlashSectors[Local_uint8Sector].Size);
+			BL_voidSimFlashAccount(Local_uint64Ns, 0, 1u);
+		}
+	}
+
+	for(Local_uint32Offset = 0; Local_uint32Offset < Copy_uint32Length; Local_uint32Offset++)
+	{
+		voidProgramByte(FLASH_BASE + Local_uint32Offset, *(const uint8_t*)(Copy_uint32Source + Local_uint32Offset));
+	}
+
+	Local_uint64Ns = (Copy_uint32Length / 4u) * Global_uint64ProgramNs;
+	BL_voidSimAdvance(Local_uint64Ns);
+	BL_voidSimFlashAccount(Local_uint64Ns, Copy_uint32Length / 4u, 0);
+
+	BL_voidSimReset();
+}
+
+
+uint8_t BL_uint8FlashSectorIsBlank(uint8_t Copy_uint8Sector)
+{
+	return BL_uint8FlashRangeIsBlank(Global_FlashSectors[Copy_uint8Sector].Base, Global_FlashSectors[Copy_uint8Sector].Size);
+}
+
+
+uint8_t BL_uint8FlashRangeIsBlank(uint32_t Copy_uint32Address, uint32_t Copy_uint32Length)
+{
+	const uint32_t* Local_puint32Word = (const uint32_t*)Copy_uint32Address;
+	const uint32_t* Local_puint32End  = Local_puint32Word + (Copy_uint32Length / 4u);
+
+	while((Local_puint32Word < Local_puint32End) && (*Local_puint32Word == 0xFFFFFFFFUL))
+	{
+		Local_puint32Word++;
+	}
+
+	return (Local_puint32Word == Local_puint32End) ? BL_FLASH_SECTOR_BLANK : BL_FLASH_SECTOR_NOT_BLANK;
+}
+
+
+uint32_t BL_uint32FlashVerify(uint32_t Copy_uint32Address, const uint8_t* Copy_puint8Data, uint16_t Copy_uint16Length)
+{
+	uint16_t Local_uint16Iterator = 0;
+
+	while((Local_uint16Iterator < Copy_uint16Length) &&
+	      (*(const uint8_t*)(Copy_uint32Address + Local_uint16Iterator) == Copy_puint8Data[Local_uint16Iterator]))
+	{
+		Local_uint16Iterator++;
+	}
+
+	return (Local_uint16Iterator == Copy_uint16Length) ? BL_FLASH_VERIFY_OK : (Copy_uint32Address + Local_uint16Iterator);
+}
+
+
+/*
+ * BL_voidFlashEraseSectorStart
+ * ----------------------------
+ * Starts the erase; it ends BL_SimConfig_t's erase time later, in
+ * BL_uint8SimFlashEvent (or the BSY wait of the next operation).
+ */
+void BL_voidFlashEraseSectorStart(uint8_t Copy_uint8Sector)
+{
+	(void)uint8_WaitForFlash();
+
+	if((Copy_uint8Sector >= BL_FLASH_SECTOR_COUNT) || ((FLASH->CR & FLASH_CR_LOCK) != 0u))
+	{
+		/* Error: the interrupt reports it at once */
+		Global_uint8EraseResult = HAL_ERROR;
+		BL_voidTransportNotifyBackground();
+		return;
+	}
+
+	voidCountErase(Copy_uint8Sector);
+	BL_TRACE(BL_TRACE_ERASE_START, Copy_uint8Sector, 1u);
+#if BL_SLOT_CACHE_ENABLE
+	BL_voidSlotCacheInvalidate(Global_FlashSectors[Copy_uint8Sector].Base, Global_FlashSectors[Copy_uint8Sector].Size);
+#endif
+
+	Global_uint8EraseResult   = BL_FLASH_OP_PENDING;
+	Global_uint8PendingSector = Copy_uint8Sector;
+	Global_uint64PendingStart = BL_uint64SimNow();
+	Global_uint64PendingEnd   = Global_uint64PendingStart + uint64_EraseNs(Copy_uint8Sector);
+}
+
+
+uint8_t BL_uint8FlashGetEraseResult(void)
+{
+	return Global_uint8EraseResult;
+}
+
+
+/*
+ * BL_voidFlashIRQHandler
+ * ----------------------
+ * Nothing raises the FLASH interrupt here: BL_uint8SimFlashEvent ends the erase.
+ */
+void BL_voidFlashIRQHandler(void)
+{
+	(void)BL_uint8SimFlashEvent();
+}
+
+
+uint8_t BL_uint8FlashGetSector(uint32_t Copy_uint32Address)
+{
+	uint8_t Local_uint8Sector = BL_FLASH_SECTOR_COUNT;
+
+	if((Copy_uint32Address < FLASH_BASE) || (Copy_uint32Address > FLASH_END))
+	{
+		return BL_FLASH_INVALID_SECTOR;
+	}
+
+	while(Global_FlashSectors[Local_uint8Sector - 1u].Base > Copy_uint32Address)
+	{
+		Local_uint8Sector--;
+	}
+
+	return (uint8_t)(Local_uint8Sector - 1u);
+}
+
+
+const BL_FlashSector_t* BL_pFlashGetSectorInfo(uint8_t Copy_uint8Sector)
+{
+	return (Copy_uint8Sector < BL_FLASH_SECTOR_COUNT) ? &Global_FlashSectors[Copy_uint8Sector] : NULL;
+}
+
+
+#if BL_WEAR_STATS_ENABLE
+uint16_t BL_uint16FlashGetEraseCount(uint8_t Copy_uint8Sector)
+{
+	return (Copy_uint8Sector < BL_FLASH_SECTOR_COUNT) ? Global_uint16EraseCounts[Copy_uint8Sector] : 0u;
+}
+
+
+void BL_voidFlashClearEraseCounts(void)
+{
+	memset(Global_uint16EraseCounts, 0, sizeof(Global_uint16EraseCounts));
+}
+#endif
+
+
+#if BL_STATS_ENABLE
+const BL_FlashTiming_t* BL_pFlashGetTiming(void)
+{
+	return &Global_FlashTiming;
+}
+
+
+void BL_voidFlashClearTiming(void)
+{
+	memset(&Global_FlashTiming, 0, sizeof(Global_FlashTiming));
+}
+#endif
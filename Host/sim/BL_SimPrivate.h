@@ -0,0 +1,29 @@
+#ifndef SIM_BL_SIMPRIVATE_H_
+#define SIM_BL_SIMPRIVATE_H_
+
+#include <stdint.h>
+#include "BL_Sim.h"
+
+/*
+ * Between the simulated peripherals: the device clock (BL_SimDevice.c) and
+ * the flash interface (BL_SimFlash.c). Device thread only.
+ */
+
+#define BL_SIM_NO_EVENT               UINT64_MAX
+
+uint64_t BL_uint64SimNow(void);                                          /* Device clock, ns */
+
+void     BL_voidSimAdvance(uint64_t Copy_uint64Ns);                      /* The core waits for a synchronous operation: the clock moves on */
+
+void     BL_voidSimFlashAccount(uint64_t Copy_uint64Ns, uint32_t Copy_uint32Programs, uint32_t Copy_uint32Erases); /* Statistics of a finished flash operation */
+
+void     BL_voidSimFlashConfigure(const BL_SimConfig_t* Copy_pConfig);   /* Operation times */
+
+uint64_t BL_uint64SimFlashPendingEnd(void);                              /* End of the started erase, BL_SIM_NO_EVENT if none */
+
+uint8_t  BL_uint8SimFlashEvent(void);                                    /* Ends the started erase if due (FLASH interrupt): 1 if it did */
+
+void     BL_voidSimReset(void) __attribute__((noreturn));                /* System reset: the reply drains, the simulation ends */
+
+
+#endif /* SIM_BL_SIMPRIVATE_H_ */
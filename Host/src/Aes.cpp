@@ -0,0 +1,212 @@
+#include "blhost/Aes.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+
+namespace blhost
+{
+
+namespace
+{
+
+std::uint8_t xtime(std::uint8_t value)
+{
+	return static_cast<std::uint8_t>((value << 1) ^ ((value & 0x80) ? 0x1B : 0x00));
+}
+
+/* S-box from the multiplicative inverse and the affine map, built once */
+const std::array<std::uint8_t, 256>& sbox()
+{
+	static const std::array<std::uint8_t, 256> table = [] {
+		std::array<std::uint8_t, 256> box {};
+		std::uint8_t                  power   = 1;
+		std::uint8_t                  inverse = 1;
+
+		do
+		{
+			power = static_cast<std::uint8_t>(power ^ xtime(power));
+
+			inverse = static_cast<std::uint8_t>(inverse ^ (inverse << 1));
+			inverse = static_cast<std::uint8_t>(inverse ^ (inverse << 2));
+			inverse = static_cast<std::uint8_t>(inverse ^ (inverse << 4));
+			inverse = static_cast<std::uint8_t>(inverse ^ ((inverse & 0x80) ? 0x09 : 0x00));
+
+			std::uint8_t value = inverse;
+
+			for (unsigned shift = 1; shift <= 4; shift++)
+			{
+				value ^= static_cast<std::uint8_t>((inverse << shift) | (inverse >> (8 - shift)));
+			}
+			box[power] = static_cast<std::uint8_t>(value ^ 0x63);
+		} while (power != 1);
+
+		box[0] = 0x63;
+		return box;
+	}();
+
+	return table;
+}
+
+}
+
+AesCtr::AesCtr(const std::vector<std::uint8_t>& key, const AesCounter& counter) : counter_(counter)
+{
+	const std::array<std::uint8_t, 256>& box = sbox();
+
+	if (key.size() != 16 && key.size() != 32)
+	{
+		throw std::invalid_argument("AES keys are 16 or 32 bytes, not " + std::to_string(key.size()));
+	}
+
+	std::size_t  words = key.size() / 4;
+	std::uint8_t rcon  = 1;
+
+	rounds_ = static_cast<unsigned>(words) + 6;
+	std::copy(key.begin(), key.end(), roundKeys_.begin());
+
+	/* FIPS 197 key expansion, one 4-byte word at a time */
+	for (std::size_t index = words; index < 4 * (rounds_ + 1); index++)
+	{
+		std::uint8_t word[4];
+
+		std::copy(&roundKeys_[4 * (index - 1)], &roundKeys_[4 * index], word);
+
+		if (index % words == 0)
+		{
+			std::uint8_t first = word[0];
+
+			word[0] = static_cast<std::uint8_t>(box[word[1]] ^ rcon);
+			word[1] = box[word[2]];
+			word[2] = box[word[3]];
+			word[3] = box[first];
+			rcon    = xtime(rcon);
+		}
+		else if (words == 8 && index % 8 == 4)
+		{
+			for (auto& byte : word)
+			{
+				byte = box[byte];
+			}
+		}
+
+		for (std::size_t byte = 0; byte < 4; byte++)
+		{
+			roundKeys_[4 * index + byte] = static_cast<std::uint8_t>(roundKeys_[4 * (index - words) + byte] ^ word[byte]);
+		}
+	}
+}
+
+void AesCtr::encryptBlock(const std::uint8_t* input, std::uint8_t* output) const
+{
+	const std::array<std::uint8_t, 256>& box = sbox();
+	std::uint8_t                         state[kAesBlockSize];
+
+	for (std::size_t index = 0; index < kAesBlockSize; index++)
+	{
+		state[index] = static_cast<std::uint8_t>(input[index] ^ roundKeys_[index]);
+	}
+
+	for (unsigned round = 1; round <= rounds_; round++)
+	{
+		std::uint8_t shifted[kAesBlockSize];
+
+		/* SubBytes and ShiftRows: row r of column c comes from column c + r */
+		for (std::size_t column = 0; column < 4; column++)
+		{
+			for (std::size_t row = 0; row < 4; row++)
+			{
+				shifted[4 * column + row] = box[state[4 * ((column + row) % 4) + row]];
+			}
+		}
+
+		for (std::size_t column = 0; column < 4; column++)
+		{
+			const std::uint8_t* in  = &shifted[4 * column];
+			std::uint8_t*       out = &state[4 * column];
+
+			if (round == rounds_)
+			{
+				std::copy(in, in + 4, out);
+				continue;
+			}
+
+			std::uint8_t all = static_cast<std::uint8_t>(in[0] ^ in[1] ^ in[2] ^ in[3]);
+
+			for (std::size_t row = 0; row < 4; row++)
+			{
+				out[row] = static_cast<std::uint8_t>(in[row] ^ all ^ xtime(static_cast<std::uint8_t>(in[row] ^ in[(row + 1) % 4])));
+			}
+		}
+
+		for (std::size_t index = 0; index < kAesBlockSize; index++)
+		{
+			state[index] ^= roundKeys_[kAesBlockSize * round + index];
+		}
+	}
+
+	std::copy(state, state + kAesBlockSize, output);
+}
+
+void AesCtr::apply(std::size_t offset, std::uint8_t* data, std::size_t size) const
+{
+	AesCounter    block = counter_;
+	std::uint32_t count = (static_cast<std::uint32_t>(counter_[12]) << 24) | (static_cast<std::uint32_t>(counter_[13]) << 16) |
+	                      (static_cast<std::uint32_t>(counter_[14]) << 8) | counter_[15];
+	std::size_t   skip  = offset % kAesBlockSize;
+
+	count += static_cast<std::uint32_t>(offset / kAesBlockSize);
+
+	while (size != 0)
+	{
+		std::uint8_t stream[kAesBlockSize];
+
+		block[12] = static_cast<std::uint8_t>(count >> 24);
+		block[13] = static_cast<std::uint8_t>(count >> 16);
+		block[14] = static_cast<std::uint8_t>(count >> 8);
+		block[15] = static_cast<std::uint8_t>(count);
+		encryptBlock(block.data(), stream);
+		count++;
+
+		for (; skip < kAesBlockSize && size != 0; skip++, size--)
+		{
+			*data++ ^= stream[skip];
+		}
+		skip = 0;
+	}
+}
+
+AesCounter AesCtr::randomCounter()
+{
+	std::random_device device;
+	AesCounter         counter {};
+
+	for (std::size_t index = 0; index < 12; index++)
+	{
+		counter[index] = static_cast<std::uint8_t>(device());
+	}
+
+	return counter;
+}
+
+std::vector<std::uint8_t> AesCtr::loadKey(const std::string& path)
+{
+	std::ifstream             file(path, std::ios::binary);
+	std::vector<std::uint8_t> key;
+
+	if (file)
+	{
+		key.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	if (key.size() != 16 && key.size() != 32)
+	{
+		throw std::runtime_error(path + " is not a 16- or 32-byte AES key");
+	}
+
+	return key;
+}
+
+}
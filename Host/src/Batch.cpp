@@ -0,0 +1,122 @@
+#include "blhost/Batch.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+
+namespace blhost
+{
+
+namespace
+{
+
+/* /dev/ttyUSB3 -> ttyUSB3 */
+std::string portName(const std::string& port)
+{
+	std::size_t slash = port.find_last_of('/');
+
+	return (slash == std::string::npos) ? port : port.substr(slash + 1);
+}
+
+void flashBoard(const std::string& port, std::uint32_t address, const std::uint8_t* image, std::size_t size,
+                const BatchOptions& options, BoardResult& result)
+{
+	using Clock = std::chrono::steady_clock;
+
+	const Clock::time_point start = Clock::now();
+	std::ofstream log;
+	unsigned      logged = 0;   /* Progress tenths already written */
+
+	auto elapsed = [&] { return std::chrono::duration<double>(Clock::now() - start).count(); };
+	auto stamp   = [&]() -> std::ostream& { return log << std::fixed << std::setprecision(3) << elapsed() << " "; };
+
+	if (!options.logDirectory.empty())
+	{
+		log.open(options.logDirectory + "/" + portName(port) + ".log");
+	}
+
+	result.port = port;
+	stamp() << "write " << size << " bytes at 0x" << std::hex << address << std::dec << " on " << port << "\n";
+
+	try
+	{
+		SerialPort    serial(port, options.baud, options.flowControl);
+		Engine        engine(serial, options.engine);
+		Flasher       flasher(engine);
+		StreamOptions stream = options.stream;
+
+		stream.log = [&](const std::string& line) { stamp() << line << "\n"; };
+
+		engine.start();
+		stamp() << "bootloader version " << unsigned(flasher.getVersion()) << "\n";
+
+		try
+		{
+			ProgressCallback progress = [&](std::size_t done, std::size_t total) {
+				unsigned tenths = (total != 0) ? static_cast<unsigned>(done * 10 / total) : 10;
+
+				if (tenths > logged)
+				{
+					logged = tenths;
+					stamp() << done << " / " << total << " bytes\n";
+				}
+			};
+
+			if (options.viaRam)
+			{
+				flasher.writeViaRam(address, image, size, stream, progress);
+			}
+			else
+			{
+				flasher.writeStream(address, image, size, stream, progress);
+			}
+		}
+		catch (...)
+		{
+			result.retransmissions = flasher.lastRetransmissions();
+			throw;
+		}
+
+		result.retransmissions = flasher.lastRetransmissions();
+		result.ok              = true;
+	}
+	catch (const FlashError& error)
+	{
+		result.error  = error.what();
+		result.status = error.status();
+	}
+	catch (const std::exception& error)
+	{
+		result.error = error.what();
+	}
+
+	result.seconds = elapsed();
+	stamp() << result.retransmissions << " retransmissions, " << (result.ok ? "OK" : "FAILED: " + result.error) << "\n";
+}
+
+}
+
+std::vector<BoardResult> flashBoards(const std::vector<std::string>& ports, std::uint32_t address,
+                                     const std::uint8_t* image, std::size_t size, const BatchOptions& options)
+{
+	std::vector<BoardResult> results(ports.size());
+	std::vector<std::thread> workers;
+
+	workers.reserve(ports.size());
+
+	for (std::size_t index = 0; index < ports.size(); index++)
+	{
+		workers.emplace_back(flashBoard, std::cref(ports[index]), address, image, size, std::cref(options),
+		                     std::ref(results[index]));
+	}
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+
+	return results;
+}
+
+}
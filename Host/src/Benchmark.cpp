@@ -0,0 +1,311 @@
+#include "blhost/Benchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+
+namespace blhost
+{
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+struct Probe
+{
+	const char*               name;
+	std::uint8_t              command;
+	std::vector<std::uint8_t> payload;
+	unsigned                  replies;    /* MEM_READ answers a header, then the data */
+};
+
+/* Fills the statistics of a row from its samples, microseconds */
+void summarize(BenchResult& result, std::vector<double> samples)
+{
+	if (samples.empty())
+	{
+		return;
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	result.samples  = static_cast<unsigned>(samples.size());
+	result.minUs    = samples.front();
+	result.maxUs    = samples.back();
+	result.medianUs = samples[samples.size() / 2];
+	result.p95Us    = samples[std::min(samples.size() - 1, (samples.size() * 95) / 100)];
+
+	if (result.bytes != 0 && result.medianUs > 0.0)
+	{
+		result.bytesPerSecond = result.bytes * 1e6 / result.medianUs;
+	}
+}
+
+double elapsedUs(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+/* Times body() count times; a FlashError ends the row with its text */
+BenchResult measure(const std::string& test, const std::string& parameter, std::size_t bytes, unsigned count,
+                    const std::function<void()>& body)
+{
+	BenchResult         result;
+	std::vector<double> samples;
+
+	result.test      = test;
+	result.parameter = parameter;
+	result.bytes     = bytes;
+
+	try
+	{
+		for (unsigned sample = 0; sample < count; sample++)
+		{
+			Clock::time_point start = Clock::now();
+
+			body();
+			samples.push_back(elapsedUs(start));
+		}
+	}
+	catch (const FlashError& error)
+	{
+		result.status = error.what();
+	}
+
+	summarize(result, samples);
+
+	return result;
+}
+
+}
+
+BenchReport runBenchmarks(Engine& engine, Flasher& flasher, const BenchOptions& options)
+{
+	const FlashSector& scratch = kFlashSectors.at(options.scratchSector);
+	BenchReport        report;
+
+	auto add = [&](BenchResult result) {
+		if (options.log)
+		{
+			char line[160];
+			std::snprintf(line, sizeof(line), "%-10s %-20s median %10.0f us %12.0f B/s  %s", result.test.c_str(),
+			              result.parameter.c_str(), result.medianUs, result.bytesPerSecond, result.status.c_str());
+			options.log(line);
+		}
+		report.results.push_back(std::move(result));
+	};
+
+	DeviceInfo info = flasher.deviceInfo();
+
+	report.bootloaderVersion = info.bootloaderVersion;
+	report.chipId            = info.chipId;
+	report.uniqueId          = info.uniqueIdHex();
+
+	/* 1. Round trip of the opcodes that change nothing */
+	std::vector<std::uint8_t> small;
+	putLe32(small, scratch.address);
+	putLe32(small, 4);
+
+	std::vector<std::uint8_t> read;
+	putLe32(read, scratch.address);
+	putLe16(read, 4);
+
+	std::vector<std::uint8_t> verify = small;
+	verify.push_back(kVerifyAlgoCrc32);
+
+	const std::vector<Probe> probes = {
+		{ "GET_VERSION",        cmd::GetVersion,       {},         1 },
+		{ "GET_HELP",           cmd::GetHelp,          {},         1 },
+		{ "GET_CID",            cmd::GetCid,           {},         1 },
+		{ "GET_RDP_STATUS",     cmd::GetRdpStatus,     {},         1 },
+		{ "MEM_READ",           cmd::MemRead,          read,       2 },
+		{ "READ_SECTOR_STATUS", cmd::ReadSectorStatus, {},         1 },
+		{ "OTP_READ",           cmd::OtpRead,          { 0, 1 },   1 },
+		{ "FLASH_ERASE_STATUS", cmd::FlashEraseStatus, {},         1 },
+		{ "BEGIN_PROGRAM",      cmd::BeginProgram,     {},         1 },
+		{ "END_PROGRAM",        cmd::EndProgram,       {},         1 },
+		{ "VERIFY_RANGE",       cmd::VerifyRange,      verify,     1 },
+		{ "GET_DEVICE_INFO",    cmd::GetDeviceInfo,    {},         1 },
+		{ "GET_CAPABILITIES",   cmd::GetCapabilities,  {},         1 },
+		{ "GET_BOOT_TIMES",     cmd::GetBootTimes,     {},         1 },
+		{ "SLOT_ACTIVATE",      cmd::SlotActivate,     { 0xFF },   1 },   /* BL_SLOT_QUERY */
+		{ "GET_WEAR_STATS",     cmd::GetWearStats,     {},         1 },
+		{ "GET_STATS",          cmd::GetStats,         {},         1 },
+		{ "GET_TRACE",          cmd::GetTrace,         {},         1 },
+	};
+
+	for (const auto& probe : probes)
+	{
+		bool nack = false;
+
+		BenchResult result = measure("latency", probe.name, 0, options.iterations, [&] {
+			std::optional<Response> response = engine.transact(probe.command, probe.payload, std::chrono::milliseconds(1000));
+
+			for (unsigned reply = 1; response && response->ack && reply < probe.replies; reply++)
+			{
+				response = engine.next(std::chrono::milliseconds(1000));
+			}
+
+			if (!response)
+			{
+				throw FlashError("no reply");
+			}
+
+			nack = nack || !response->ack;
+		});
+
+		if (nack)
+		{
+			result.status = "nack";
+		}
+		add(result);
+	}
+
+	std::vector<std::uint8_t> pattern(scratch.size);
+	for (std::size_t index = 0; index < pattern.size(); index++)
+	{
+		pattern[index] = static_cast<std::uint8_t>((index * 7u) ^ (index >> 8));
+	}
+
+	/* 2. The link without the flash */
+	if (flasher.capabilities().features & kFeatureLinkTest)
+	{
+		const std::size_t half = linktest::EchoMax / 2;
+
+		add(measure("link", "echo " + std::to_string(linktest::EchoMax) + " B down", linktest::EchoMax, options.iterations,
+		            [&] { flasher.echo(linktest::EchoMax); }));
+
+		std::vector<std::uint8_t> data(pattern.begin(), pattern.begin() + half);
+
+		add(measure("link", "echo " + std::to_string(half) + " B both", 2 * half, options.iterations,
+		            [&] { flasher.echo(half, data); }));
+
+		constexpr std::size_t kSinkBytes = 64 * 1024;
+		const std::size_t     frames[]   = { 64, 240, 1024, linktest::EchoMax };
+
+		for (std::size_t frame : frames)
+		{
+			std::uint32_t crcErrors = 0;
+
+			BenchResult result = measure("link", "sink " + std::to_string(frame) + " B up", kSinkBytes, 1, [&] {
+				crcErrors = flasher.sink(pattern.data(), kSinkBytes, frame).crcErrors;
+			});
+
+			if (crcErrors != 0 && result.status == "ok")
+			{
+				result.status = std::to_string(crcErrors) + " CRC errors";
+			}
+			add(result);
+		}
+	}
+
+	/* 3. Writes into the erased scratch sector, a fresh range per row */
+	add(measure("erase", "sector " + std::to_string(options.scratchSector) + " (blank)", scratch.size, 1,
+	            [&] { flasher.flashErase(options.scratchSector, 1); }));
+
+	constexpr std::size_t kWriteBytes = 16 * 1024;
+	const std::size_t     sizes[] = { 16, 64, 128, 240, 1024, kMaxPayloadLength - 8 };
+	std::uint32_t         offset  = 0;
+
+	for (std::size_t size : sizes)
+	{
+		std::size_t total = (kWriteBytes / size) * size;
+
+		add(measure("mem_write", std::to_string(size) + " B", total, 1, [&] {
+			for (std::size_t done = 0; done < total; done += size)
+			{
+				flasher.memWrite(scratch.address + offset + static_cast<std::uint32_t>(done), &pattern[offset + done], size);
+			}
+		}));
+		offset += static_cast<std::uint32_t>(kWriteBytes);
+	}
+
+	StreamOptions stream;
+	stream.adaptive = false;
+	stream.session  = false;
+	stream.verify   = false;
+
+	const std::size_t streamBytes = scratch.size - offset;
+
+	add(measure("stream", std::to_string(stream.packetSize) + " B x " + std::to_string(stream.window), streamBytes, 1,
+	            [&] { flasher.writeStream(scratch.address + offset, &pattern[offset], streamBytes, stream); }));
+
+	/* 4. The sector is programmed now: device-side CRC, then a real erase */
+	add(measure("verify", std::to_string(scratch.size / 1024) + " KB", scratch.size, 5,
+	            [&] { flasher.rangeCrc(scratch.address, scratch.size); }));
+
+	add(measure("erase", "sector " + std::to_string(options.scratchSector), scratch.size, 1,
+	            [&] { flasher.flashErase(options.scratchSector, 1); }));
+
+	for (unsigned sector : options.eraseSectors)
+	{
+		const FlashSector& target = kFlashSectors.at(sector);
+
+		/* Programmed first so the device cannot skip the sector as blank */
+		flasher.flashErase(sector, 1);
+		flasher.memWrite(target.address, pattern.data(), 16);
+
+		add(measure("erase", "sector " + std::to_string(sector), target.size, 1,
+		            [&] { flasher.flashErase(sector, 1); }));
+	}
+
+	/* 5. A whole update */
+	if (options.plan != nullptr)
+	{
+		StreamOptions update;
+		std::size_t   bytes = options.plan->writeBytes + options.plan->fillBytes;
+
+		add(measure("update", std::to_string(options.plan->imageBytes) + " B image", bytes, 1,
+		            [&] { flasher.execute(*options.plan, update); }));
+	}
+
+	return report;
+}
+
+std::string benchCsv(const BenchReport& report)
+{
+	std::string text = "bl_version,chip_id,uid,baud,test,parameter,samples,min_us,median_us,p95_us,max_us,bytes,bytes_per_s,status\n";
+	char        line[512];
+
+	for (const auto& result : report.results)
+	{
+		std::snprintf(line, sizeof(line), "%u,0x%03X,%s,%u,%s,\"%s\",%u,%.0f,%.0f,%.0f,%.0f,%zu,%.0f,\"%s\"\n",
+		              report.bootloaderVersion, report.chipId, report.uniqueId.c_str(), report.baud,
+		              result.test.c_str(), result.parameter.c_str(), result.samples, result.minUs, result.medianUs,
+		              result.p95Us, result.maxUs, result.bytes, result.bytesPerSecond, result.status.c_str());
+		text += line;
+	}
+
+	return text;
+}
+
+std::string benchJson(const BenchReport& report)
+{
+	std::string text;
+	char        line[512];
+
+	std::snprintf(line, sizeof(line), "{\n  \"bl_version\": %u,\n  \"chip_id\": %u,\n  \"uid\": \"%s\",\n  \"baud\": %u,\n  \"results\": [\n",
+	              report.bootloaderVersion, report.chipId, report.uniqueId.c_str(), report.baud);
+	text += line;
+
+	for (std::size_t index = 0; index < report.results.size(); index++)
+	{
+		const BenchResult& result = report.results[index];
+
+		std::snprintf(line, sizeof(line),
+		              "    { \"test\": \"%s\", \"parameter\": \"%s\", \"samples\": %u, \"min_us\": %.0f, \"median_us\": %.0f, "
+		              "\"p95_us\": %.0f, \"max_us\": %.0f, \"bytes\": %zu, \"bytes_per_s\": %.0f, \"status\": \"%s\" }%s\n",
+		              result.test.c_str(), result.parameter.c_str(), result.samples, result.minUs, result.medianUs,
+		              result.p95Us, result.maxUs, result.bytes, result.bytesPerSecond, result.status.c_str(),
+		              (index + 1 < report.results.size()) ? "," : "");
+		text += line;
+	}
+
+	text += "  ]\n}\n";
+
+	return text;
+}
+
+}
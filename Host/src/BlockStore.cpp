@@ -0,0 +1,344 @@
+#include "blhost/BlockStore.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "blhost/Flasher.hpp"
+#include "blhost/Image.hpp"
+#include "blhost/Planner.hpp"
+
+namespace blhost
+{
+
+namespace
+{
+
+constexpr const char* kVersionMagic = "blhost version 1";
+
+void makeDirectory(const std::string& path)
+{
+	if (::mkdir(path.c_str(), 0777) != 0 && errno != EEXIST)
+	{
+		throw std::runtime_error("cannot create " + path);
+	}
+}
+
+/* Written to a temporary file and renamed, so a reader sees all of it or nothing */
+void writeFile(const std::string& target, const void* data, std::size_t size)
+{
+	std::string temporary = target + ".tmp";
+
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+
+		file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+
+		if (!file.flush())
+		{
+			throw std::runtime_error("cannot write " + temporary);
+		}
+	}
+
+	if (std::rename(temporary.c_str(), target.c_str()) != 0)
+	{
+		std::remove(temporary.c_str());
+		throw std::runtime_error("cannot replace " + target);
+	}
+}
+
+/* The whole file, nullopt when it cannot be read */
+std::optional<std::vector<std::uint8_t>> readFile(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+
+	if (!file)
+	{
+		return std::nullopt;
+	}
+
+	return std::vector<std::uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+/* CRC part of a block key, "0a1b2c3d-0" -> 0x0a1b2c3d */
+std::uint32_t crcOfKey(const std::string& key)
+{
+	return static_cast<std::uint32_t>(std::strtoul(key.substr(0, 8).c_str(), nullptr, 16));
+}
+
+/* Sector holding an address, kFlashSectors.size() outside the flash */
+unsigned sectorOf(std::uint32_t address)
+{
+	unsigned sector = 0;
+
+	while (sector < kFlashSectors.size() &&
+	       !(address >= kFlashSectors[sector].address && address - kFlashSectors[sector].address < kFlashSectors[sector].size))
+	{
+		sector++;
+	}
+
+	return sector;
+}
+
+}
+
+BlockStore::BlockStore(std::string directory) : directory_(std::move(directory))
+{
+	makeDirectory(directory_);
+	makeDirectory(directory_ + "/blocks");
+	makeDirectory(directory_ + "/versions");
+}
+
+std::string BlockStore::storeBlock(const std::uint8_t* data, std::uint32_t crc, bool& added)
+{
+	char name[16];
+
+	/* The first key with this CRC that holds the same bytes, or the first free one */
+	for (unsigned index = 0; ; index++)
+	{
+		std::snprintf(name, sizeof(name), "%08x-%u", crc, index);
+
+		std::string                              path   = directory_ + "/blocks/" + name;
+		std::optional<std::vector<std::uint8_t>> stored = readFile(path);
+
+		if (!stored)
+		{
+			writeFile(path, data, kBlockSize);
+			added = true;
+			return name;
+		}
+
+		if (stored->size() == kBlockSize && std::memcmp(stored->data(), data, kBlockSize) == 0)
+		{
+			added = false;
+			return name;
+		}
+	}
+}
+
+StoredVersion BlockStore::add(const std::string& name, const Image& image, std::size_t* newBlocks)
+{
+	const std::vector<Segment>& segments = image.segments();
+	StoredVersion               version;
+	std::size_t                 added = 0;
+
+	if (name.empty() || name.find('/') != std::string::npos || segments.empty())
+	{
+		throw std::runtime_error("cannot store version '" + name + "'");
+	}
+
+	version.name    = name;
+	version.address = segments.front().address & ~(kBlockSize - 1u);
+
+	std::uint32_t             end = (segments.back().end() + kBlockSize - 1u) & ~(kBlockSize - 1u);
+	std::vector<std::uint8_t> flat(end - version.address, 0xFF);
+
+	for (const auto& segment : segments)
+	{
+		std::memcpy(&flat[segment.address - version.address], segment.data, segment.size);
+	}
+
+	std::ostringstream text;
+	char               line[32];
+
+	std::snprintf(line, sizeof(line), "address %08x\n", version.address);
+	text << kVersionMagic << "\n" << line;
+
+	for (std::size_t offset = 0; offset < flat.size(); offset += kBlockSize)
+	{
+		std::uint32_t crc   = crc32(&flat[offset], kBlockSize, CrcMode::WordWise);
+		bool          isNew = false;
+
+		version.blocks.push_back(storeBlock(&flat[offset], crc, isNew));
+		version.crcs.push_back(crc);
+		added += isNew ? 1 : 0;
+		text << "block " << version.blocks.back() << "\n";
+	}
+
+	std::string contents = text.str();
+	writeFile(directory_ + "/versions/" + name, contents.data(), contents.size());
+
+	if (newBlocks != nullptr)
+	{
+		*newBlocks = added;
+	}
+
+	return version;
+}
+
+std::optional<StoredVersion> BlockStore::version(const std::string& name) const
+{
+	std::ifstream file(directory_ + "/versions/" + name);
+	std::string   line;
+	StoredVersion version;
+
+	if (!std::getline(file, line) || line != kVersionMagic)
+	{
+		return std::nullopt;
+	}
+
+	version.name = name;
+
+	while (std::getline(file, line))
+	{
+		std::istringstream fields(line);
+		std::string        key;
+
+		fields >> key;
+
+		if (key == "address")
+		{
+			fields >> std::hex >> version.address;
+		}
+		else if (key == "block")
+		{
+			fields >> key;
+			version.blocks.push_back(key);
+			version.crcs.push_back(crcOfKey(key));
+		}
+
+		if (fields.fail())
+		{
+			return std::nullopt;
+		}
+	}
+
+	return version;
+}
+
+std::vector<std::string> BlockStore::versions() const
+{
+	std::vector<std::string> names;
+	DIR*                     directory = ::opendir((directory_ + "/versions").c_str());
+
+	for (dirent* entry = directory ? ::readdir(directory) : nullptr; entry != nullptr; entry = ::readdir(directory))
+	{
+		std::string name = entry->d_name;
+
+		if (name != "." && name != ".." && (name.size() < 4 || name.compare(name.size() - 4, 4, ".tmp") != 0))
+		{
+			names.push_back(name);
+		}
+	}
+
+	if (directory != nullptr)
+	{
+		::closedir(directory);
+	}
+
+	std::sort(names.begin(), names.end());
+
+	return names;
+}
+
+std::vector<std::uint8_t> BlockStore::block(const std::string& key) const
+{
+	std::optional<std::vector<std::uint8_t>> data = readFile(directory_ + "/blocks/" + key);
+
+	if (!data || data->size() != kBlockSize)
+	{
+		throw std::runtime_error("block " + key + " missing from " + directory_);
+	}
+
+	return *data;
+}
+
+std::vector<VersionMatch> BlockStore::identify(Flasher& flasher) const
+{
+	std::vector<StoredVersion>                          stored;
+	std::map<std::uint32_t, std::uint32_t>              ends;     /* Per base address, the furthest version end */
+	std::map<std::uint32_t, std::vector<std::uint32_t>> device;
+	std::vector<VersionMatch>                           matches;
+
+	for (const auto& name : versions())
+	{
+		if (std::optional<StoredVersion> version = this->version(name))
+		{
+			ends[version->address] = std::max(ends[version->address], version->end());
+			stored.push_back(std::move(*version));
+		}
+	}
+
+	/* One manifest per base address covers every version starting there */
+	for (const auto& range : ends)
+	{
+		device[range.first] = flasher.blockCrcs(range.first, range.second - range.first, kBlockSize);
+	}
+
+	for (const auto& version : stored)
+	{
+		const std::vector<std::uint32_t>& crcs = device[version.address];
+		VersionMatch                      match;
+
+		match.name   = version.name;
+		match.blocks = version.blocks.size();
+
+		for (std::size_t index = 0; index < version.crcs.size() && index < crcs.size(); index++)
+		{
+			match.matching += (version.crcs[index] == crcs[index]) ? 1 : 0;
+		}
+
+		matches.push_back(match);
+	}
+
+	/* Exact matches first, then by the share of blocks held */
+	std::stable_sort(matches.begin(), matches.end(), [](const VersionMatch& left, const VersionMatch& right) {
+		if (left.exact() != right.exact())
+		{
+			return left.exact();
+		}
+		return left.matching * right.blocks > right.matching * left.blocks;
+	});
+
+	return matches;
+}
+
+BlockDelta BlockStore::delta(const StoredVersion& installed, const StoredVersion& target) const
+{
+	BlockDelta            delta;
+	std::set<std::string> held(installed.blocks.begin(), installed.blocks.end());
+	std::uint16_t         touched = 0;
+	std::uint16_t         changed = 0;
+
+	for (std::size_t index = 0; index < target.blocks.size(); index++)
+	{
+		std::uint32_t address = target.address + static_cast<std::uint32_t>(index) * kBlockSize;
+		unsigned      sector  = sectorOf(address);
+		bool          same    = (address >= installed.address && address < installed.end()) &&
+		                        (installed.blocks[(address - installed.address) / kBlockSize] == target.blocks[index]);
+
+		touched |= (sector < kFlashSectors.size()) ? static_cast<std::uint16_t>(1u << sector) : 0;
+
+		if (same)
+		{
+			continue;
+		}
+
+		delta.changed.push_back(index);
+		changed |= (sector < kFlashSectors.size()) ? static_cast<std::uint16_t>(1u << sector) : 0;
+
+		if (held.count(target.blocks[index]) != 0)
+		{
+			delta.moved++;
+		}
+		else
+		{
+			delta.newBytes += kBlockSize;
+		}
+	}
+
+	delta.unchangedSectors = static_cast<std::uint16_t>(touched & ~changed);
+
+	return delta;
+}
+
+}
@@ -0,0 +1,83 @@
+#include "blhost/Codec.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#include "blhost/Lz.hpp"
+#include "blhost/Protocol.hpp"
+
+namespace blhost
+{
+
+namespace
+{
+
+constexpr std::size_t kFrameOverhead = 8;   /* [0x00] [length (2)] [command] ... [CRC32 (4)], extended frame */
+
+std::size_t wireBytes(std::size_t data, std::size_t packet, std::size_t header)
+{
+	std::size_t packets = (data + packet - 1) / packet;
+
+	return data + packets * (header + kFrameOverhead);
+}
+
+CodecEstimate estimate(Codec codec, std::size_t size, std::size_t wire, double seconds)
+{
+	CodecEstimate result;
+
+	result.codec          = codec;
+	result.wireBytes      = wire;
+	result.seconds        = seconds;
+	result.bytesPerSecond = (seconds > 0.0) ? size / seconds : 0.0;
+
+	return result;
+}
+
+}
+
+const char* codecName(Codec codec)
+{
+	return (codec == Codec::Lz) ? "lz" : "raw";
+}
+
+const CodecEstimate& CodecChoice::chosen() const
+{
+	return *std::find_if(estimates.begin(), estimates.end(), [this](const CodecEstimate& entry) { return entry.codec == codec; });
+}
+
+CodecChoice chooseCodec(const std::uint8_t* image, std::size_t size, const LinkModel& link, bool lz)
+{
+	CodecChoice choice;
+	std::size_t packet    = std::max<std::size_t>(link.packetSize, 1);
+	double      writeTime = (link.writeRate != 0) ? size / double(link.writeRate) : 0.0;
+	std::size_t rawWire   = wireBytes(size, packet, stream::HeaderLength);
+
+	choice.estimates.push_back(estimate(Codec::Raw, size, rawWire,
+	                                    std::max(rawWire / link.bytesPerSecond, writeTime) + link.roundTripSeconds));
+
+	if (!lz || link.decodeRate == 0 || size == 0)
+	{
+		return choice;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	choice.stream          = lzCompress(image, size);
+	choice.compressSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	/* Nothing overlaps: each packet is sent, decoded and written before the next one leaves */
+	std::size_t lzWire  = wireBytes(choice.stream.size(), packet, lzwrite::HeaderLength);
+	std::size_t packets = (choice.stream.size() + packet - 1) / packet;
+	double      seconds = lzWire / link.bytesPerSecond + size / double(link.decodeRate) + writeTime +
+	                      packets * link.roundTripSeconds;
+
+	choice.estimates.push_back(estimate(Codec::Lz, size, lzWire, seconds));
+	if (choice.estimates.back().seconds < choice.estimates.front().seconds)
+	{
+		choice.codec = Codec::Lz;
+	}
+
+	return choice;
+}
+
+}
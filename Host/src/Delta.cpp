@@ -0,0 +1,518 @@
+#include "blhost/Delta.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#include "blhost/Lz.hpp"
+#include "blhost/Protocol.hpp"
+
+namespace blhost
+{
+
+namespace
+{
+
+constexpr std::size_t kRecordHeaderSize = 12;   /* BL_DELTA_HEADER_SIZE */
+
+/* One record of a chunk: diff bytes against the source from source on, then extra bytes */
+struct Record
+{
+	std::size_t source = 0;
+	std::size_t diff   = 0;
+	std::size_t extra  = 0;
+};
+
+/* The sorted suffixes of the source and the source itself (filtered when thumb) */
+struct SuffixIndex
+{
+	const std::uint8_t*       data = nullptr;
+	std::ptrdiff_t            size = 0;
+	std::vector<std::int32_t> order;
+};
+
+/* Relative <-> absolute target of a BL pair, as uint8_FilterBranchPair (BL.c); false for any other bytes */
+bool filterPair(std::uint8_t* pair, std::size_t offset, bool encode)
+{
+	std::uint32_t position = static_cast<std::uint32_t>((offset + 4) >> 1);
+	std::uint32_t value;
+
+	if ((pair[1] & 0xF8u) != 0xF0u || (pair[3] & 0xF8u) != 0xF8u)
+	{
+		return false;
+	}
+
+	value = (static_cast<std::uint32_t>(pair[1] & 0x07u) << 19) | (static_cast<std::uint32_t>(pair[0]) << 11) |
+	        (static_cast<std::uint32_t>(pair[3] & 0x07u) << 8)  | pair[2];
+	value = encode ? value + position : value - position;
+
+	pair[0] = static_cast<std::uint8_t>(value >> 11);
+	pair[1] = static_cast<std::uint8_t>(0xF0u | ((value >> 19) & 0x07u));
+	pair[2] = static_cast<std::uint8_t>(value);
+	pair[3] = static_cast<std::uint8_t>(0xF8u | ((value >> 8) & 0x07u));
+
+	return true;
+}
+
+/* Prefix doubling: each round orders the suffixes by their first 2k bytes with two counting sorts */
+std::vector<std::int32_t> suffixArray(const std::uint8_t* data, std::size_t size)
+{
+	std::vector<std::int32_t> order(size), rank(size), next(size), byHalf(size);
+	std::vector<std::int32_t> count(std::max<std::size_t>(size, 256) + 1, 0);
+	std::size_t               classes = 256;
+
+	for (std::size_t index = 0; index < size; index++)
+	{
+		count[data[index] + 1]++;
+		rank[index] = data[index];
+	}
+	for (std::size_t value = 1; value <= 256; value++)
+	{
+		count[value] += count[value - 1];
+	}
+	for (std::size_t index = 0; index < size; index++)
+	{
+		order[static_cast<std::size_t>(count[data[index]]++)] = static_cast<std::int32_t>(index);
+	}
+
+	for (std::size_t half = 1; size > 1 && half < size; half <<= 1)
+	{
+		std::size_t filled = 0;
+
+		/* By the second half: the suffixes without one first, then the order so far shifted back */
+		for (std::size_t index = size - half; index < size; index++)
+		{
+			byHalf[filled++] = static_cast<std::int32_t>(index);
+		}
+		for (std::size_t index = 0; index < size; index++)
+		{
+			if (static_cast<std::size_t>(order[index]) >= half)
+			{
+				byHalf[filled++] = order[index] - static_cast<std::int32_t>(half);
+			}
+		}
+
+		/* Stable by the first half */
+		std::fill(count.begin(), count.begin() + static_cast<std::ptrdiff_t>(classes) + 1, 0);
+		for (std::size_t index = 0; index < size; index++)
+		{
+			count[static_cast<std::size_t>(rank[index]) + 1]++;
+		}
+		for (std::size_t value = 1; value <= classes; value++)
+		{
+			count[value] += count[value - 1];
+		}
+		for (std::size_t index = 0; index < size; index++)
+		{
+			std::int32_t suffix = byHalf[index];
+			order[static_cast<std::size_t>(count[static_cast<std::size_t>(rank[static_cast<std::size_t>(suffix)])]++)] = suffix;
+		}
+
+		auto second = [&](std::size_t suffix) { return (suffix + half < size) ? rank[suffix + half] : -1; };
+
+		next[static_cast<std::size_t>(order[0])] = 0;
+		classes = 1;
+		for (std::size_t index = 1; index < size; index++)
+		{
+			std::size_t previous = static_cast<std::size_t>(order[index - 1]);
+			std::size_t current  = static_cast<std::size_t>(order[index]);
+
+			if (rank[previous] != rank[current] || second(previous) != second(current))
+			{
+				classes++;
+			}
+			next[current] = static_cast<std::int32_t>(classes - 1);
+		}
+		rank.swap(next);
+
+		if (classes == size)
+		{
+			break;
+		}
+	}
+
+	return order;
+}
+
+std::ptrdiff_t matchLength(const std::uint8_t* left, std::ptrdiff_t leftSize, const std::uint8_t* right, std::ptrdiff_t rightSize)
+{
+	std::ptrdiff_t length = 0;
+
+	while (length < leftSize && length < rightSize && left[length] == right[length])
+	{
+		length++;
+	}
+
+	return length;
+}
+
+/* Longest prefix of target anywhere in the source, by binary search over the sorted suffixes */
+std::ptrdiff_t search(const SuffixIndex& index, const std::uint8_t* target, std::ptrdiff_t targetSize, std::ptrdiff_t& position)
+{
+	std::size_t low  = 0;
+	std::size_t high = index.order.size() - 1;
+
+	while (high - low >= 2)
+	{
+		std::size_t    middle = low + (high - low) / 2;
+		std::ptrdiff_t start  = index.order[middle];
+		std::size_t    length = static_cast<std::size_t>(std::min(index.size - start, targetSize));
+
+		if (std::memcmp(index.data + start, target, length) < 0)
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	std::ptrdiff_t lowStart  = index.order[low];
+	std::ptrdiff_t highStart = index.order[high];
+	std::ptrdiff_t lowLength  = matchLength(index.data + lowStart, index.size - lowStart, target, targetSize);
+	std::ptrdiff_t highLength = matchLength(index.data + highStart, index.size - highStart, target, targetSize);
+
+	position = (lowLength > highLength) ? lowStart : highStart;
+
+	return std::max(lowLength, highLength);
+}
+
+/* The bsdiff scan over one chunk of the target: records covering all of it, in order */
+std::vector<Record> scanChunk(const SuffixIndex& index, const std::uint8_t* target, std::ptrdiff_t targetSize)
+{
+	const std::uint8_t*  old     = index.data;
+	const std::ptrdiff_t oldSize = index.size;
+	std::vector<Record>  records;
+	std::ptrdiff_t       scan = 0, length = 0, position = 0;
+	std::ptrdiff_t       lastScan = 0, lastPosition = 0, lastOffset = 0;
+
+	if (oldSize == 0)
+	{
+		records.push_back({ 0, 0, static_cast<std::size_t>(targetSize) });
+		return records;
+	}
+
+	while (scan < targetSize)
+	{
+		std::ptrdiff_t oldScore = 0;
+		std::ptrdiff_t scored;
+
+		/* Next match that the previous offset does not explain almost as well */
+		for (scored = scan += length; scan < targetSize; scan++)
+		{
+			length = search(index, target + scan, targetSize - scan, position);
+
+			for (; scored < scan + length; scored++)
+			{
+				if (scored + lastOffset < oldSize && old[scored + lastOffset] == target[scored])
+				{
+					oldScore++;
+				}
+			}
+
+			if ((length == oldScore && length != 0) || length > oldScore + 8)
+			{
+				break;
+			}
+
+			if (scan + lastOffset < oldSize && old[scan + lastOffset] == target[scan])
+			{
+				oldScore--;
+			}
+		}
+
+		if (length == oldScore && scan != targetSize)
+		{
+			continue;
+		}
+
+		/* Grow the previous match forward and this one backward while more than half the bytes agree */
+		std::ptrdiff_t score = 0, best = 0, forward = 0, backward = 0;
+
+		for (std::ptrdiff_t step = 0; lastScan + step < scan && lastPosition + step < oldSize;)
+		{
+			score += (old[lastPosition + step] == target[lastScan + step]) ? 1 : 0;
+			step++;
+			if (score * 2 - step > best * 2 - forward)
+			{
+				best    = score;
+				forward = step;
+			}
+		}
+
+		if (scan < targetSize)
+		{
+			score = 0;
+			best  = 0;
+			for (std::ptrdiff_t step = 1; scan >= lastScan + step && position >= step; step++)
+			{
+				score += (old[position - step] == target[scan - step]) ? 1 : 0;
+				if (score * 2 - step > best * 2 - backward)
+				{
+					best     = score;
+					backward = step;
+				}
+			}
+		}
+
+		/* Overlapping growths: split where the forward one stops paying */
+		if (lastScan + forward > scan - backward)
+		{
+			std::ptrdiff_t overlap = (lastScan + forward) - (scan - backward);
+			std::ptrdiff_t split   = 0;
+
+			score = 0;
+			best  = 0;
+			for (std::ptrdiff_t step = 0; step < overlap; step++)
+			{
+				score += (target[lastScan + forward - overlap + step] == old[lastPosition + forward - overlap + step]) ? 1 : 0;
+				score -= (target[scan - backward + step] == old[position - backward + step]) ? 1 : 0;
+				if (score > best)
+				{
+					best  = score;
+					split = step + 1;
+				}
+			}
+
+			forward  += split - overlap;
+			backward -= split;
+		}
+
+		records.push_back({ static_cast<std::size_t>(lastPosition), static_cast<std::size_t>(forward),
+		                    static_cast<std::size_t>((scan - backward) - (lastScan + forward)) });
+
+		lastScan     = scan - backward;
+		lastPosition = position - backward;
+		lastOffset   = position - scan;
+	}
+
+	return records;
+}
+
+/* One patch, from the filtered images with thumb */
+Delta encode(const std::uint8_t* source, std::size_t sourceLength, const std::uint8_t* target, std::size_t targetLength,
+             bool thumb, const DeltaOptions& options)
+{
+	std::vector<std::uint8_t> old(source, source + sourceLength);
+	std::vector<std::uint8_t> wanted(target, target + targetLength);
+	Delta                     delta;
+	SuffixIndex               index;
+
+	delta.sourceLength = static_cast<std::uint32_t>(sourceLength);
+	delta.targetLength = static_cast<std::uint32_t>(targetLength);
+
+	if (thumb)
+	{
+		thumbFilter(old.data(), old.size(), true);
+		thumbFilter(wanted.data(), wanted.size(), true);
+		delta.flags |= delta::FlagThumb;
+	}
+
+	index.data  = old.data();
+	index.size  = static_cast<std::ptrdiff_t>(old.size());
+	index.order = suffixArray(old.data(), old.size());
+
+	/* Chunks of the target searched side by side */
+	std::size_t                      chunkSize = std::max<std::size_t>(options.chunkSize, 1024);
+	std::size_t                      chunks    = (targetLength + chunkSize - 1) / chunkSize;
+	std::vector<std::vector<Record>> found(chunks);
+	std::atomic<std::size_t>         next(0);
+	unsigned                         threads   = options.threads;
+
+	auto work = [&]
+	{
+		for (std::size_t chunk = next++; chunk < chunks; chunk = next++)
+		{
+			std::size_t start = chunk * chunkSize;
+
+			found[chunk] = scanChunk(index, &wanted[start], static_cast<std::ptrdiff_t>(std::min(chunkSize, targetLength - start)));
+		}
+	};
+
+	if (threads == 0)
+	{
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	threads = static_cast<unsigned>(std::max<std::size_t>(1, std::min<std::size_t>(threads, chunks)));
+
+	std::vector<std::thread> workers;
+
+	for (unsigned worker = 1; worker < threads; worker++)
+	{
+		workers.emplace_back(work);
+	}
+	work();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+
+	/* Joined in target order; the device's source cursor starts at 0 */
+	std::vector<Record> records(1);
+
+	for (const auto& chunk : found)
+	{
+		for (const auto& record : chunk)
+		{
+			if (record.diff != 0 || record.extra != 0)
+			{
+				records.push_back(record);
+			}
+		}
+	}
+
+	if (records.size() > 1 && records[1].source == 0)
+	{
+		records.erase(records.begin());
+	}
+
+	std::vector<std::uint8_t> stream;
+	std::size_t               written = 0;
+
+	for (std::size_t record = 0; record < records.size(); record++)
+	{
+		const Record& current = records[record];
+		std::int64_t  seek    = (record + 1 < records.size())
+		                        ? static_cast<std::int64_t>(records[record + 1].source) - static_cast<std::int64_t>(current.source + current.diff)
+		                        : 0;
+
+		putLe32(stream, static_cast<std::uint32_t>(current.diff));
+		putLe32(stream, static_cast<std::uint32_t>(current.extra));
+		putLe32(stream, static_cast<std::uint32_t>(static_cast<std::int32_t>(seek)));
+
+		for (std::size_t byte = 0; byte < current.diff; byte++)
+		{
+			stream.push_back(static_cast<std::uint8_t>(wanted[written + byte] - old[current.source + byte]));
+		}
+		stream.insert(stream.end(), wanted.begin() + static_cast<std::ptrdiff_t>(written + current.diff),
+		              wanted.begin() + static_cast<std::ptrdiff_t>(written + current.diff + current.extra));
+
+		written          += current.diff + current.extra;
+		delta.extraBytes += current.extra;
+	}
+
+	delta.records     = records.size();
+	delta.recordBytes = stream.size();
+	delta.patch       = std::move(stream);
+
+	if (options.compress)
+	{
+		std::vector<std::uint8_t> compressed = lzCompress(delta.patch.data(), delta.patch.size());
+
+		if (compressed.size() < delta.patch.size())
+		{
+			delta.patch  = std::move(compressed);
+			delta.flags |= delta::FlagLz;
+		}
+	}
+
+	return delta;
+}
+
+}
+
+void thumbFilter(std::uint8_t* image, std::size_t size, bool encode)
+{
+	for (std::size_t offset = 0; offset + 4 <= size;)
+	{
+		offset += filterPair(&image[offset], offset, encode) ? 4 : 2;
+	}
+}
+
+Delta makeDelta(const std::uint8_t* source, std::size_t sourceLength, const std::uint8_t* target, std::size_t targetLength,
+                const DeltaOptions& options)
+{
+	Delta delta = encode(source, sourceLength, target, targetLength, options.thumb == ThumbFilter::On, options);
+
+	if (options.thumb == ThumbFilter::Best)
+	{
+		Delta filtered = encode(source, sourceLength, target, targetLength, true, options);
+
+		if (filtered.patch.size() < delta.patch.size())
+		{
+			delta = std::move(filtered);
+		}
+	}
+
+	std::optional<std::vector<std::uint8_t>> rebuilt = applyDelta(source, sourceLength, delta);
+
+	if (!rebuilt || rebuilt->size() != targetLength || !std::equal(rebuilt->begin(), rebuilt->end(), target))
+	{
+		throw std::logic_error("delta does not rebuild the target");
+	}
+
+	return delta;
+}
+
+std::optional<std::vector<std::uint8_t>> applyDelta(const std::uint8_t* source, std::size_t sourceLength, const Delta& delta)
+{
+	std::vector<std::uint8_t> old(source, source + sourceLength);
+	std::vector<std::uint8_t> patch = delta.patch;
+	std::vector<std::uint8_t> out;
+	std::int64_t              cursor = 0;
+
+	if (delta.flags & delta::FlagLz)
+	{
+		std::optional<std::vector<std::uint8_t>> decoded = lzDecompress(patch.data(), patch.size());
+
+		if (!decoded)
+		{
+			return std::nullopt;
+		}
+		patch = std::move(*decoded);
+	}
+
+	if (delta.flags & delta::FlagThumb)
+	{
+		thumbFilter(old.data(), old.size(), true);
+	}
+
+	for (std::size_t index = 0; index < patch.size();)
+	{
+		if (patch.size() - index < kRecordHeaderSize)
+		{
+			return std::nullopt;
+		}
+
+		std::size_t  diff  = getLe32(&patch[index]);
+		std::size_t  extra = getLe32(&patch[index + 4]);
+		std::int32_t seek  = static_cast<std::int32_t>(getLe32(&patch[index + 8]));
+
+		index += kRecordHeaderSize;
+
+		if (diff > delta.targetLength - out.size() || extra > delta.targetLength - out.size() - diff ||
+		    patch.size() - index < diff + extra ||
+		    (diff != 0 && (cursor < 0 || static_cast<std::size_t>(cursor) > old.size() || diff > old.size() - static_cast<std::size_t>(cursor))))
+		{
+			return std::nullopt;
+		}
+
+		for (std::size_t byte = 0; byte < diff; byte++)
+		{
+			out.push_back(static_cast<std::uint8_t>(old[static_cast<std::size_t>(cursor) + byte] + patch[index + byte]));
+		}
+		out.insert(out.end(), patch.begin() + static_cast<std::ptrdiff_t>(index + diff),
+		           patch.begin() + static_cast<std::ptrdiff_t>(index + diff + extra));
+
+		index  += diff + extra;
+		cursor += static_cast<std::int64_t>(diff) + seek;
+	}
+
+	if (out.size() != delta.targetLength)
+	{
+		return std::nullopt;
+	}
+
+	if (delta.flags & delta::FlagThumb)
+	{
+		thumbFilter(out.data(), out.size(), false);
+	}
+
+	return out;
+}
+
+}
@@ -0,0 +1,289 @@
+#include "blhost/DeviceView.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+#include <sys/stat.h>
+
+#include "blhost/BlockStore.hpp"
+#include "blhost/Flasher.hpp"
+
+namespace blhost
+{
+
+namespace
+{
+
+constexpr std::uint32_t kNoMiss = 0xFFFFFFFFu;
+
+/* DIR/<crc>-<length>: pages of any address and device share a file */
+std::string cachePath(const std::string& directory, std::uint32_t crc, std::uint32_t length)
+{
+	char name[32];
+
+	std::snprintf(name, sizeof(name), "/%08x-%u", crc, length);
+	return directory + name;
+}
+
+}
+
+DeviceView::DeviceView(Flasher& flasher, std::uint32_t base, std::uint32_t length, ViewOptions options)
+	: flasher_(flasher), base_(base), length_(length), options_(std::move(options)), lastMiss_(kNoMiss)
+{
+	options_.cachePages = std::max<std::size_t>(options_.cachePages, 1);
+
+	if (!options_.cacheDirectory.empty() && ::mkdir(options_.cacheDirectory.c_str(), 0777) != 0 && errno != EEXIST)
+	{
+		throw std::runtime_error("cannot create " + options_.cacheDirectory);
+	}
+
+	if (options_.store != nullptr)
+	{
+		for (const std::string& name : options_.store->versions())
+		{
+			std::optional<StoredVersion> version = options_.store->version(name);
+
+			for (std::size_t index = 0; version && index < version->blocks.size() && index < version->crcs.size(); index++)
+			{
+				storeBlocks_.emplace(version->crcs[index], version->blocks[index]);
+			}
+		}
+	}
+}
+
+std::size_t DeviceView::read(std::uint32_t address, std::uint8_t* data, std::size_t length)
+{
+	if (address < base_ || address - base_ >= length_)
+	{
+		return 0;
+	}
+
+	std::uint32_t offset = address - base_;
+	std::size_t   total  = std::min<std::size_t>(length, length_ - offset);
+	std::size_t   done   = 0;
+
+	while (done < total)
+	{
+		std::uint32_t at     = offset + static_cast<std::uint32_t>(done);
+		const Page&   cached = page(at / kPageSize);
+		std::size_t   from   = at % kPageSize;
+		std::size_t   count  = std::min(total - done, cached.data.size() - from);
+
+		std::memcpy(data + done, cached.data.data() + from, count);
+		done += count;
+	}
+
+	return total;
+}
+
+void DeviceView::refresh()
+{
+	for (auto& entry : pages_)
+	{
+		entry.second.stale = true;
+	}
+}
+
+std::uint32_t DeviceView::pageLength(std::uint32_t index) const
+{
+	return std::min(kPageSize, length_ - index * kPageSize);
+}
+
+bool DeviceView::fresh(const Page& page) const
+{
+	return !page.stale &&
+	       (options_.maxAge.count() == 0 || (std::chrono::steady_clock::now() - page.checked) < options_.maxAge);
+}
+
+const DeviceView::Page& DeviceView::page(std::uint32_t index)
+{
+	auto found = pages_.find(index);
+
+	if (found != pages_.end() && fresh(found->second))
+	{
+		lru_.splice(lru_.begin(), lru_, found->second.lru);
+		return found->second;
+	}
+
+	/* Read ahead on a sequential miss, doubling up to readAhead; back to one page on a jump */
+	run_ = (lastMiss_ != kNoMiss && index == lastMiss_ + 1u) ? std::min(std::max(run_ * 2u, 1u), options_.readAhead) : 0u;
+
+	std::uint32_t count = std::min<std::uint32_t>(1u + run_, pageCount() - index);
+
+	count = static_cast<std::uint32_t>(std::min<std::size_t>(count, options_.cachePages));
+	for (std::uint32_t next = 1; next < count; next++)
+	{
+		auto ahead = pages_.find(index + next);
+
+		if (ahead != pages_.end() && fresh(ahead->second))
+		{
+			count = next;
+		}
+	}
+
+	fetch(index, count);
+	lastMiss_ = index + count - 1u;
+
+	return pages_.at(index);
+}
+
+void DeviceView::fetch(std::uint32_t first, std::uint32_t count)
+{
+	std::uint32_t              address = base_ + first * kPageSize;
+	std::uint32_t              span    = std::min(count * kPageSize, length_ - first * kPageSize);
+	std::vector<std::uint32_t> crcs;
+	std::vector<bool>          needed(count, true);
+
+	if (options_.validate)
+	{
+		crcs = flasher_.blockCrcs(address, span, static_cast<std::uint16_t>(kPageSize));
+		stats_.manifests++;
+
+		for (std::uint32_t page = 0; page < count; page++)
+		{
+			auto                      cached = pages_.find(first + page);
+			std::vector<std::uint8_t> data;
+
+			if (cached != pages_.end() && cached->second.crc == crcs[page])
+			{
+				cached->second.stale   = false;
+				cached->second.checked = std::chrono::steady_clock::now();
+				lru_.splice(lru_.begin(), lru_, cached->second.lru);
+				stats_.pagesChecked++;
+				needed[page] = false;
+			}
+			else if (reuse(first + page, crcs[page], data))
+			{
+				keep(first + page, std::move(data), crcs[page]);
+				stats_.pagesReused++;
+				needed[page] = false;
+			}
+		}
+	}
+
+	/* The pages still needed, one readMemory per run of them */
+	for (std::uint32_t page = 0; page < count;)
+	{
+		std::uint32_t end = page;
+
+		while (end < count && needed[end])
+		{
+			end++;
+		}
+		if (end == page)
+		{
+			page++;
+			continue;
+		}
+
+		std::uint32_t             from  = first + page;
+		std::uint32_t             bytes = std::min((end - page) * kPageSize, length_ - from * kPageSize);
+		std::vector<std::uint8_t> data  = flasher_.readMemory(base_ + from * kPageSize, bytes);
+
+		stats_.bytesRead += data.size();
+
+		for (std::uint32_t index = from; index < first + end; index++)
+		{
+			std::size_t               at = (index - from) * kPageSize;
+			std::vector<std::uint8_t> bytesOfPage(data.begin() + at, data.begin() + at + pageLength(index));
+
+			/* The host's own CRC: live RAM may have moved on since the manifest */
+			std::uint32_t crc = crc32(bytesOfPage.data(), bytesOfPage.size(), CrcMode::WordWise);
+
+			if (!options_.cacheDirectory.empty())
+			{
+				std::string   target    = cachePath(options_.cacheDirectory, crc, pageLength(index));
+				std::string   temporary = target + ".tmp";
+				std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+
+				file.write(reinterpret_cast<const char*>(bytesOfPage.data()), static_cast<std::streamsize>(bytesOfPage.size()));
+				file.close();
+				if (!file || std::rename(temporary.c_str(), target.c_str()) != 0)
+				{
+					std::remove(temporary.c_str());
+				}
+			}
+
+			keep(index, std::move(bytesOfPage), crc);
+			stats_.pagesRead++;
+		}
+		page = end;
+	}
+}
+
+bool DeviceView::reuse(std::uint32_t index, std::uint32_t crc, std::vector<std::uint8_t>& data)
+{
+	std::uint32_t length = pageLength(index);
+
+	if (!options_.cacheDirectory.empty())
+	{
+		std::ifstream file(cachePath(options_.cacheDirectory, crc, length), std::ios::binary);
+
+		if (file)
+		{
+			data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			if (data.size() == length && crc32(data.data(), data.size(), CrcMode::WordWise) == crc)
+			{
+				return true;
+			}
+		}
+	}
+
+	if (options_.store != nullptr && length == BlockStore::kBlockSize)
+	{
+		auto range = storeBlocks_.equal_range(crc);
+
+		for (auto block = range.first; block != range.second; ++block)
+		{
+			try
+			{
+				data = options_.store->block(block->second);
+			}
+			catch (const std::runtime_error&)
+			{
+				continue;
+			}
+			if (data.size() == length && crc32(data.data(), data.size(), CrcMode::WordWise) == crc)
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void DeviceView::keep(std::uint32_t index, std::vector<std::uint8_t> data, std::uint32_t crc)
+{
+	auto found = pages_.find(index);
+
+	if (found == pages_.end())
+	{
+		while (pages_.size() >= options_.cachePages)
+		{
+			pages_.erase(lru_.back());
+			lru_.pop_back();
+		}
+
+		lru_.push_front(index);
+		found = pages_.emplace(index, Page()).first;
+		found->second.lru = lru_.begin();
+	}
+	else
+	{
+		lru_.splice(lru_.begin(), lru_, found->second.lru);
+	}
+
+	found->second.data    = std::move(data);
+	found->second.crc     = crc;
+	found->second.stale   = false;
+	found->second.checked = std::chrono::steady_clock::now();
+}
+
+}
@@ -0,0 +1,154 @@
+#include "blhost/Discovery.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace blhost
+{
+
+namespace
+{
+
+/* Bit order of BL_DISCOVER: bytes in address order, most significant bit first */
+void setBits(UniqueId& id, unsigned first, unsigned count, unsigned value)
+{
+	for (unsigned index = 0; index < count; ++index)
+	{
+		const unsigned     bit  = first + index;
+		const std::uint8_t mask = static_cast<std::uint8_t>(0x80u >> (bit & 7u));
+
+		if ((value >> (count - 1u - index)) & 1u)
+		{
+			id[bit >> 3] |= mask;
+		}
+		else
+		{
+			id[bit >> 3] &= static_cast<std::uint8_t>(~mask);
+		}
+	}
+}
+
+/* A prefix and bits of it to search below */
+using Branch = std::pair<UniqueId, unsigned>;
+
+}
+
+std::vector<std::uint8_t> encodeDiscover(const UniqueId& prefix, unsigned bits)
+{
+	UniqueId masked = prefix;
+
+	bits = std::min(bits, discover::UidBits);
+	setBits(masked, bits, discover::UidBits - bits, 0);
+
+	std::vector<std::uint8_t> payload { static_cast<std::uint8_t>(bits) };
+	payload.insert(payload.end(), masked.begin(), masked.end());
+
+	return payload;
+}
+
+std::optional<DiscoveredNode> parseDiscoverReply(const std::vector<std::uint8_t>& payload)
+{
+	if (payload.size() < discover::ReplySize || payload[0] != discover::Ok)
+	{
+		return std::nullopt;
+	}
+
+	DiscoveredNode node;
+	std::copy(payload.begin() + 1, payload.begin() + 13, node.uniqueId.begin());
+	node.address = payload[13];
+
+	return node;
+}
+
+std::vector<DiscoveredNode> discoverCan(const CanDiscoveryQuery& query)
+{
+	std::vector<DiscoveredNode> nodes;
+	std::vector<Branch>         pending { Branch { UniqueId {}, 0u } };
+
+	while (!pending.empty())
+	{
+		const Branch branch = pending.back();
+		pending.pop_back();
+
+		/* The last round carries the 21 bits left, left-aligned in the 25 */
+		const unsigned count = std::min(discover::CanBits, discover::UidBits - branch.second);
+
+		for (const CanDiscoveryFrame& frame : query(encodeDiscover(branch.first, branch.second)))
+		{
+			if ((frame.identifier & ~discover::CanExtIdMask) != discover::CanExtIdBase)
+			{
+				continue;
+			}
+
+			UniqueId prefix = branch.first;
+			setBits(prefix, branch.second, count, (frame.identifier & discover::CanExtIdMask) >> (discover::CanBits - count));
+
+			if (branch.second + count < discover::UidBits)
+			{
+				pending.emplace_back(prefix, branch.second + count);
+			}
+			else if (frame.data.size() >= 2)
+			{
+				DiscoveredNode node;
+				node.uniqueId = prefix;
+				node.address  = frame.data[0];
+				node.group    = frame.data[1];
+				nodes.push_back(node);
+			}
+		}
+	}
+
+	return nodes;
+}
+
+std::vector<DiscoveredNode> discoverSlots(const SlotDiscoveryQuery& query)
+{
+	std::vector<DiscoveredNode> nodes;
+	std::vector<Branch>         pending { Branch { UniqueId {}, 0u } };
+
+	while (!pending.empty())
+	{
+		const Branch branch = pending.back();
+		pending.pop_back();
+
+		const unsigned count = std::min(discover::SlotBits, discover::UidBits - branch.second);
+		const auto     slots = query(encodeDiscover(branch.first, branch.second));
+
+		for (unsigned slot = 0; slot < discover::Slots; ++slot)
+		{
+			if (!slots[slot].activity)
+			{
+				continue;
+			}
+
+			/* Two senders in one slot garble the frame: an intact reply is one node, checked on its own */
+			if (slots[slot].payload)
+			{
+				const auto candidate = parseDiscoverReply(*slots[slot].payload);
+
+				if (candidate)
+				{
+					const auto confirm = query(encodeDiscover(candidate->uniqueId, discover::UidBits));
+					const auto reply   = confirm[0].payload ? parseDiscoverReply(*confirm[0].payload) : std::nullopt;
+
+					if (reply && reply->uniqueId == candidate->uniqueId)
+					{
+						nodes.push_back(*reply);
+						continue;
+					}
+				}
+			}
+
+			if (branch.second + count < discover::UidBits)
+			{
+				UniqueId prefix = branch.first;
+				setBits(prefix, branch.second, count, slot >> (discover::SlotBits - count));
+				pending.emplace_back(prefix, branch.second + count);
+			}
+		}
+	}
+
+	return nodes;
+}
+
+}
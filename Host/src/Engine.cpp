@@ -0,0 +1,261 @@
+#include "blhost/Engine.hpp"
+
+#include <algorithm>
+
+namespace blhost
+{
+
+namespace
+{
+
+constexpr int         kIdleWaitMs = 50;     /* Upper bound of a wait, submit() and stop() wake it */
+constexpr std::size_t kReadChunk  = 4096;
+
+}
+
+Engine::Engine(Transport& transport, Options options)
+	: transport_(transport), options_(options), parser_(options.crc, options.responseCrc)
+{
+}
+
+Engine::~Engine()
+{
+	stop();
+}
+
+void Engine::start()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	if (!running_)
+	{
+		running_ = true;
+		error_   = nullptr;
+		thread_  = std::thread(&Engine::run, this);
+	}
+}
+
+void Engine::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		running_ = false;
+	}
+
+	transport_.wake();
+
+	if (thread_.joinable())
+	{
+		thread_.join();
+	}
+
+	responseReady_.notify_all();
+}
+
+void Engine::submit(std::uint8_t command, const std::vector<std::uint8_t>& payload)
+{
+	std::vector<std::uint8_t> frame = encodeFrame(command, payload.data(), payload.size(), options_.crc);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		txQueuedBytes_ += frame.size();
+		txQueue_.push_back(std::move(frame));
+	}
+
+	transport_.wake();
+}
+
+std::size_t Engine::discardQueued()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::size_t count = txQueue_.size();
+
+	for (const auto& frame : txQueue_)
+	{
+		txQueuedBytes_ -= frame.size();
+	}
+	txQueue_.clear();
+
+	return count;
+}
+
+std::size_t Engine::queuedBytes() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return txQueuedBytes_;
+}
+
+void Engine::onResponse(ResponseCallback callback)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	callback_ = std::move(callback);
+}
+
+void Engine::onProgress(DeviceProgressCallback callback)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	progressCallback_ = std::move(callback);
+}
+
+std::optional<Response> Engine::next(std::chrono::milliseconds timeout)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+
+	responseReady_.wait_for(lock, timeout, [this] { return !rxQueue_.empty() || error_ || !running_; });
+
+	if (!rxQueue_.empty())
+	{
+		Response response = std::move(rxQueue_.front());
+		rxQueue_.pop_front();
+		return response;
+	}
+
+	if (error_)
+	{
+		std::rethrow_exception(error_);
+	}
+
+	return std::nullopt;
+}
+
+void Engine::clearResponses()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	rxQueue_.clear();
+}
+
+std::optional<Response> Engine::transact(std::uint8_t command, const std::vector<std::uint8_t>& payload,
+                                         std::chrono::milliseconds timeout)
+{
+	clearResponses();
+	submit(command, payload);
+
+	return next(timeout);
+}
+
+std::optional<Response> Engine::transactChecked(std::uint8_t command, const std::vector<std::uint8_t>& payload,
+                                                std::chrono::milliseconds timeout)
+{
+	parser_.expectCrc();
+
+	return transact(command, payload, timeout);
+}
+
+void Engine::deliver(std::vector<Response>& responses)
+{
+	ResponseCallback       callback;
+	DeviceProgressCallback progressCallback;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		progressCallback = progressCallback_;
+	}
+
+	/* Progress frames leave the replies here, whoever takes those */
+	auto replies = std::stable_partition(responses.begin(), responses.end(), [](const Response& response) { return !response.progress; });
+
+	for (auto frame = replies; frame != responses.end(); ++frame)
+	{
+		std::optional<DeviceProgress> progress = parseDeviceProgress(frame->payload);
+
+		if (progressCallback && progress)
+		{
+			progressCallback(*progress);
+		}
+	}
+	responses.erase(replies, responses.end());
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		if (callback_)
+		{
+			callback = callback_;
+		}
+		else
+		{
+			for (auto& response : responses)
+			{
+				rxQueue_.push_back(std::move(response));
+			}
+		}
+	}
+
+	if (callback)
+	{
+		for (const auto& response : responses)
+		{
+			callback(response);
+		}
+	}
+	else
+	{
+		responseReady_.notify_all();
+	}
+
+	responses.clear();
+}
+
+void Engine::run()
+{
+	std::vector<std::uint8_t> buffer(kReadChunk);
+	std::vector<Response>     responses;
+
+	try
+	{
+		for (;;)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+
+				if (!running_)
+				{
+					break;
+				}
+
+				/* A frame is never cut: the next one starts once the current one is on the wire */
+				if (currentSent_ == current_.size() && !txQueue_.empty())
+				{
+					current_     = std::move(txQueue_.front());
+					currentSent_ = 0;
+					txQueue_.pop_front();
+				}
+			}
+
+			bool pending = currentSent_ < current_.size();
+			Transport::Ready ready = transport_.wait(pending, kIdleWaitMs);
+
+			if (ready.readable)
+			{
+				std::size_t count = transport_.read(buffer.data(), buffer.size());
+
+				parser_.feed(buffer.data(), count, responses);
+				if (!responses.empty())
+				{
+					deliver(responses);
+				}
+			}
+
+			if (pending && ready.writable)
+			{
+				std::size_t count = transport_.write(&current_[currentSent_], current_.size() - currentSent_);
+
+				currentSent_ += count;
+
+				std::lock_guard<std::mutex> lock(mutex_);
+				txQueuedBytes_ -= count;
+			}
+		}
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		error_   = std::current_exception();
+		running_ = false;
+	}
+
+	responseReady_.notify_all();
+}
+
+}
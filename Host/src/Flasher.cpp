@@ -0,0 +1,1309 @@
+#include "blhost/Flasher.hpp"
+
+#include <algorithm>
+
+#include "blhost/Lz.hpp"
+#include "blhost/Sha256.hpp"
+#include "blhost/Tuner.hpp"
+
+namespace blhost
+{
+
+namespace
+{
+
+std::string hex(std::uint32_t value)
+{
+	static const char digits[] = "0123456789ABCDEF";
+	std::string text = "0x";
+
+	for (int shift = 28; shift >= 0; shift -= 4)
+	{
+		text.push_back(digits[(value >> shift) & 0xFu]);
+	}
+
+	return text;
+}
+
+/* Status byte of a reply that must carry at least one */
+std::uint8_t statusOf(const Response& response, const char* what)
+{
+	if (!response.ack || response.payload.empty())
+	{
+		throw FlashError(std::string(what) + ": NACK");
+	}
+
+	return response.payload[0];
+}
+
+}
+
+Response Flasher::request(std::uint8_t command, const std::vector<std::uint8_t>& payload,
+                          std::chrono::milliseconds timeout)
+{
+	std::optional<Response> response = engine_.transact(command, payload, timeout);
+
+	if (!response)
+	{
+		throw FlashError("no reply to command " + hex(command));
+	}
+
+	return *response;
+}
+
+std::uint8_t Flasher::getVersion()
+{
+	return statusOf(request(cmd::GetVersion, {}), "GET_VERSION");
+}
+
+DeviceInfo Flasher::deviceInfo()
+{
+	Response response = request(cmd::GetDeviceInfo, {});
+	std::optional<DeviceInfo> info = response.ack ? parseDeviceInfo(response.payload) : std::nullopt;
+
+	if (!info)
+	{
+		throw FlashError("GET_DEVICE_INFO: NACK or short reply");
+	}
+
+	return *info;
+}
+
+DeviceStats Flasher::stats(bool clear)
+{
+	Response response = request(cmd::GetStats, { static_cast<std::uint8_t>(clear ? kStatsFlagClear : 0) });
+	std::optional<DeviceStats> stats = response.ack ? parseStats(response.payload) : std::nullopt;
+
+	if (!stats)
+	{
+		throw FlashError("GET_STATS: NACK, short reply or built without BL_STATS_ENABLE");
+	}
+
+	return *stats;
+}
+
+DeviceTrace Flasher::trace(std::uint32_t from)
+{
+	std::vector<std::uint8_t> payload;
+
+	putLe32(payload, from);
+
+	Response response = request(cmd::GetTrace, payload);
+	std::optional<DeviceTrace> trace = response.ack ? parseTrace(response.payload) : std::nullopt;
+
+	if (!trace)
+	{
+		throw FlashError("GET_TRACE: NACK, short reply or built without BL_TRACE_ENABLE");
+	}
+
+	return *trace;
+}
+
+std::optional<CrashRecord> Flasher::crashRecord(bool clear)
+{
+	Response response = request(cmd::GetCrashRecord, { static_cast<std::uint8_t>(clear ? kCrashFlagClear : 0) });
+
+	if (!response.ack || response.payload.empty())
+	{
+		throw FlashError("GET_CRASH_RECORD: NACK or empty reply");
+	}
+
+	return parseCrashRecord(response.payload);
+}
+
+AppInfo Flasher::appInfo()
+{
+	Response               response = request(cmd::GetAppInfo, {});
+	std::optional<AppInfo> info     = response.ack ? parseAppInfo(response.payload) : std::nullopt;
+
+	if (!info)
+	{
+		throw FlashError("GET_APP_INFO: NACK or short reply");
+	}
+
+	return *info;
+}
+
+std::vector<std::uint8_t> Flasher::readMemory(std::uint32_t address, std::size_t length)
+{
+	std::vector<std::uint8_t> data;
+
+	while (data.size() < length)
+	{
+		std::size_t               chunk = std::min(length - data.size(), kReadMultiMaxData);
+		std::uint32_t             from  = address + static_cast<std::uint32_t>(data.size());
+		std::vector<std::uint8_t> payload = { 1 };
+
+		putLe32(payload, from);
+		putLe16(payload, static_cast<std::uint16_t>(chunk));
+
+		std::optional<Response> response = engine_.transactChecked(cmd::ReadMulti, payload, std::chrono::milliseconds(1000));
+
+		if (!response)
+		{
+			throw FlashError("no reply to READ_MULTI");
+		}
+		if (statusOf(*response, "READ_MULTI") != kStatusOk || response->payload.size() != chunk + 1)
+		{
+			throw FlashError("read of " + hex(from) + " refused");
+		}
+		data.insert(data.end(), response->payload.begin() + 1, response->payload.end());
+	}
+
+	return data;
+}
+
+std::optional<AppProfile> Flasher::appProfile(bool clear)
+{
+	std::optional<AppProfile> profile = parseAppProfile(readMemory(kAppProfileAddress, kAppProfileSize));
+
+	if (profile && clear)
+	{
+		const std::uint8_t zero[4] = {};
+
+		memWrite(kAppProfileAddress, zero, sizeof(zero));
+	}
+
+	return profile;
+}
+
+SchedLatency Flasher::schedLatency(std::uint8_t task, std::uint8_t bit)
+{
+	Response                    response = request(cmd::GetSchedLatency, { task, bit });
+	std::optional<SchedLatency> latency  = response.ack ? parseSchedLatency(response.payload) : std::nullopt;
+
+	if (!latency)
+	{
+		throw FlashError("GET_SCHED_LATENCY: NACK, refused event or built without APP_SCHED_LATENCY_ENABLE");
+	}
+
+	return *latency;
+}
+
+void Flasher::clearSchedLatency()
+{
+	Response response = request(cmd::GetSchedLatency, { kSchedLatencyClear });
+
+	if (statusOf(response, "GET_SCHED_LATENCY") != kStatusOk)
+	{
+		throw FlashError("GET_SCHED_LATENCY: clear refused");
+	}
+}
+
+ImageErasePlan Flasher::eraseForImage(std::uint32_t address, std::uint32_t length, bool dryRun,
+                                      std::chrono::milliseconds timeout)
+{
+	std::vector<std::uint8_t> payload;
+
+	putLe32(payload, address);
+	putLe32(payload, length);
+	payload.push_back(dryRun ? kEraseImageFlagDryRun : 0);
+
+	Response response = request(cmd::EraseForImage, payload, timeout);
+	std::optional<ImageErasePlan> plan;
+
+	if (response.ack)
+	{
+		plan = parseImageErasePlan(response.payload);
+	}
+	if (!plan)
+	{
+		throw FlashError("ERASE_FOR_IMAGE: NACK or malformed reply");
+	}
+
+	return *plan;
+}
+
+std::vector<std::uint8_t> Flasher::eraseRange(std::uint32_t address, std::uint32_t length, bool plan,
+                                              std::chrono::milliseconds timeout)
+{
+	std::vector<std::uint8_t> payload;
+
+	putLe32(payload, address);
+	putLe32(payload, length);
+	if (plan)
+	{
+		payload.push_back(0x02);   /* BL_ERASE_FLAG_PLAN */
+	}
+
+	Response response = request(cmd::EraseRange, payload, timeout);
+	std::uint8_t status = statusOf(response, "ERASE_RANGE");
+
+	if (status != kStatusOk && !plan)
+	{
+		throw FlashError("erase of " + hex(address) + " failed", status);
+	}
+
+	return std::vector<std::uint8_t>(response.payload.begin() + 1, response.payload.end());
+}
+
+std::uint32_t Flasher::rangeCrc(std::uint32_t address, std::uint32_t length, CrcMode mode)
+{
+	std::vector<std::uint8_t> payload;
+
+	putLe32(payload, address);
+	putLe32(payload, length);
+	payload.push_back((mode == CrcMode::Ieee) ? kVerifyAlgoCrc32Ieee : kVerifyAlgoCrc32);
+
+	Response response = request(cmd::VerifyRange, payload, std::chrono::milliseconds(5000));
+	std::uint8_t status = statusOf(response, "VERIFY_RANGE");
+
+	if (status != kStatusOk || response.payload.size() < 5)
+	{
+		throw FlashError("verify of " + hex(address) + " refused", status);
+	}
+
+	return getLe32(&response.payload[1]);
+}
+
+CrcMode Flasher::digestMode()
+{
+	return (capabilities().features & kFeatureCrcIeee) ? CrcMode::Ieee : CrcMode::WordWise;
+}
+
+std::vector<std::uint32_t> Flasher::blockCrcs(std::uint32_t address, std::uint32_t length, std::uint16_t blockSize)
+{
+	std::vector<std::uint32_t> crcs;
+
+	/* Each reply holds as many blocks as fit; ask again from the first missing one */
+	while (length != 0)
+	{
+		std::vector<std::uint8_t> payload;
+
+		putLe32(payload, address);
+		putLe32(payload, length);
+		putLe16(payload, blockSize);
+
+		Response      response = request(cmd::BlockCrcManifest, payload, std::chrono::milliseconds(5000));
+		std::uint8_t  status   = statusOf(response, "BLOCK_CRC_MANIFEST");
+		std::uint16_t count    = (response.payload.size() >= 3) ? getLe16(&response.payload[1]) : 0;
+
+		if (status != kStatusOk || count == 0 || response.payload.size() < 3u + 4u * count)
+		{
+			throw FlashError("block manifest of " + hex(address) + " refused", status);
+		}
+
+		for (std::uint16_t index = 0; index < count && length != 0; index++)
+		{
+			std::uint32_t size = std::min<std::uint32_t>(length, blockSize);
+
+			crcs.push_back(getLe32(&response.payload[3u + 4u * index]));
+			address += size;
+			length  -= size;
+		}
+	}
+
+	return crcs;
+}
+
+void Flasher::goTo(std::uint32_t address, std::uint8_t flags)
+{
+	std::vector<std::uint8_t> payload;
+
+	putLe32(payload, address);
+	if (flags != 0)
+	{
+		payload.push_back(flags);
+	}
+
+	if (statusOf(request(cmd::GoToAddr, payload), "GO_TO_ADDR") != kValidAddress)
+	{
+		throw FlashError(hex(address) + " is not executable");
+	}
+}
+
+SlotState Flasher::slotActivate(std::uint8_t index)
+{
+	/* Generous: a UserApp in the middle of a background erase answers late */
+	Response                 response = request(cmd::SlotActivate, {index}, std::chrono::milliseconds(3000));
+	std::optional<SlotState> state    = response.ack ? parseSlotState(response.payload) : std::nullopt;
+
+	if (!state)
+	{
+		throw FlashError("SLOT_ACTIVATE: NACK or short reply");
+	}
+
+	return *state;
+}
+
+void Flasher::writeSlot(const std::uint8_t* image, std::size_t size, std::size_t chunk, const ProgressCallback& progress)
+{
+	const std::uint32_t base  = slotActivate(slot::Query).updateBase;
+	const std::uint8_t  index = (base == slot::BaseA) ? 0 : 1;
+	const FlashSector&  last  = kFlashSectors.back();
+	unsigned            first = 0;
+	unsigned            count = 0;
+
+	if (base == 0)
+	{
+		throw FlashError("the device has no slot to update");
+	}
+	if (size < 8 || size > last.address + last.size - base)
+	{
+		throw FlashError("image does not fit from " + hex(base));
+	}
+
+	std::uint32_t entry = getLe32(&image[4]) & ~1u;
+
+	if (entry < base || entry - base >= size)
+	{
+		throw FlashError("image starts at " + hex(entry) + ", not in the update slot at " + hex(base));
+	}
+
+	for (unsigned sector = 0; sector < kFlashSectors.size(); sector++)
+	{
+		const FlashSector& range = kFlashSectors[sector];
+
+		if (range.address + range.size > base && range.address < base + size)
+		{
+			first  = (count == 0) ? sector : first;
+			count += 1;
+		}
+	}
+
+	/* Up to 2 s per 128 KB sector */
+	flashErase(first, count, std::chrono::milliseconds(1000 + 4000 * count));
+
+	for (std::size_t offset = 0; offset < size; offset += chunk)
+	{
+		std::size_t length = std::min(chunk, size - offset);
+
+		memWrite(base + static_cast<std::uint32_t>(offset), &image[offset], length);
+		if (progress)
+		{
+			progress(offset + length, size);
+		}
+	}
+
+	SlotState state = slotActivate(index);
+
+	if (state.status != slot::Ok)
+	{
+		throw FlashError(std::string("slot ") + static_cast<char>('A' + index) + " failed the image check", state.status);
+	}
+}
+
+bool Flasher::resetAndBoot(bool reset)
+{
+	std::uint8_t status = statusOf(request(cmd::ResetAndBoot, {reset ? resetboot::ModeReset : resetboot::ModeHandoff},
+	                                       std::chrono::milliseconds(3000)), "RESET_AND_BOOT");
+
+	if (status == resetboot::Invalid)
+	{
+		throw FlashError("no valid application to boot", status);
+	}
+
+	return status == resetboot::Handoff;
+}
+
+void Flasher::startLoader(const std::uint8_t* image, std::size_t size, const StreamOptions& options)
+{
+	StreamOptions sram = options;
+
+	if (size == 0 || size > kRamRunSize)
+	{
+		throw FlashError("loader of " + std::to_string(size) + " bytes does not fit the RAM run area");
+	}
+
+	/* SRAM: no erase, and no programming session to resume */
+	sram.autoErase = false;
+	sram.session   = false;
+	sram.cipher    = nullptr;
+	writeStream(kRamRunBase, image, size, sram);
+	goTo(kRamRunBase, kGoFlagLoader);
+}
+
+void Flasher::writeViaRam(std::uint32_t address, const std::uint8_t* image, std::size_t size,
+                          const StreamOptions& options, const ProgressCallback& progress)
+{
+	StreamOptions sram = options;
+
+	if (options.cipher != nullptr)
+	{
+		throw FlashError("an encrypted image cannot be programmed from RAM");
+	}
+
+	if (options.autoErase)
+	{
+		eraseRange(address, static_cast<std::uint32_t>(size));
+	}
+
+	/* SRAM: the device checks the window's CRC itself before programming it */
+	sram.autoErase = false;
+	sram.session   = false;
+	sram.verify    = false;
+
+	for (std::size_t offset = 0; offset < size; offset += kRamRunSize)
+	{
+		std::size_t window = std::min<std::size_t>(size - offset, kRamRunSize);
+
+		writeStream(kRamRunBase, image + offset, window, sram, [&](std::size_t written, std::size_t) {
+			if (progress)
+			{
+				progress(offset + written, size);
+			}
+		});
+		programFromRam(kRamRunBase, address + static_cast<std::uint32_t>(offset), static_cast<std::uint32_t>(window),
+		               crc32(image + offset, window, CrcMode::WordWise));
+	}
+
+	if (options.verify)
+	{
+		CrcMode       mode     = digestMode();
+		std::uint32_t expected = crc32(image, size, mode);
+		std::uint32_t actual   = rangeCrc(address, static_cast<std::uint32_t>(size), mode);
+
+		if (actual != expected)
+		{
+			throw FlashError("verify failed: device CRC " + hex(actual) + ", image CRC " + hex(expected));
+		}
+	}
+}
+
+void Flasher::programFromRam(std::uint32_t source, std::uint32_t destination, std::uint32_t length, std::uint32_t crc,
+                             std::chrono::milliseconds timeout)
+{
+	std::vector<std::uint8_t> payload;
+
+	putLe32(payload, source);
+	putLe32(payload, destination);
+	putLe32(payload, length);
+	putLe32(payload, crc);
+
+	Response     response = request(cmd::ProgramFromRam, payload, timeout);
+	std::uint8_t status   = statusOf(response, "PROGRAM_FROM_RAM");
+
+	if (status != ramprogram::Ok)
+	{
+		static const char* const reasons[] = { "", "invalid range", "upload CRC mismatch", "write failed", "verify failed" };
+		std::uint32_t            at        = 0;
+
+		for (std::size_t index = 0; index < 4 && (index + 1) < response.payload.size(); index++)
+		{
+			at |= static_cast<std::uint32_t>(response.payload[index + 1]) << (8 * index);
+		}
+
+		throw FlashError(std::string("program from RAM: ") + ((status < 5) ? reasons[status] : "unknown status") + " at " + hex(at),
+		                 status);
+	}
+}
+
+ScriptResult Flasher::runScript(const std::vector<ScriptStep>& steps, std::uint32_t address, std::chrono::milliseconds timeout)
+{
+	std::vector<std::uint8_t> script = encodeScript(steps);
+	std::vector<std::uint8_t> payload;
+	StreamOptions             sram;
+	ScriptResult              result;
+
+	if (address < kRamRunBase || script.size() > kRamRunSize || (address - kRamRunBase) > (kRamRunSize - script.size()))
+	{
+		throw FlashError("script of " + std::to_string(script.size()) + " bytes does not fit in the RAM run area at " + hex(address));
+	}
+
+	sram.session = false;
+	sram.verify  = false;
+	writeStream(address, script, sram);
+
+	putLe32(payload, address);
+	putLe32(payload, static_cast<std::uint32_t>(script.size()));
+	putLe32(payload, crc32(script.data(), script.size(), CrcMode::WordWise));
+
+	Response response = request(cmd::RunScript, payload, timeout);
+
+	result.result = statusOf(response, "RUN_SCRIPT");
+	if (result.result == batch::Invalid || response.payload.size() < 2 || response.payload.size() < (2u + response.payload[1]))
+	{
+		throw FlashError("run script: refused or malformed reply", result.result);
+	}
+	result.statuses.assign(response.payload.begin() + 2, response.payload.begin() + 2 + response.payload[1]);
+
+	return result;
+}
+
+bool Flasher::enableProgress(std::chrono::milliseconds interval, Engine::DeviceProgressCallback callback)
+{
+	std::vector<std::uint8_t> payload;
+
+	if (!(capabilities().features & kFeatureProgress))
+	{
+		return false;
+	}
+
+	putLe16(payload, static_cast<std::uint16_t>(std::min<std::chrono::milliseconds::rep>(interval.count(), 0xFFFF)));
+
+	/* Registered first: the next command may report before this reply is read */
+	engine_.onProgress(interval.count() != 0 ? std::move(callback) : nullptr);
+
+	if (statusOf(request(cmd::SetProgress, payload), "SET_PROGRESS") != kStatusOk)
+	{
+		engine_.onProgress(nullptr);
+		throw FlashError("SET_PROGRESS refused");
+	}
+
+	return true;
+}
+
+std::vector<std::uint8_t> Flasher::echo(std::size_t length, const std::vector<std::uint8_t>& data)
+{
+	std::vector<std::uint8_t> payload;
+
+	putLe16(payload, static_cast<std::uint16_t>(std::min<std::size_t>(length, 0xFFFF)));
+	payload.insert(payload.end(), data.begin(), data.end());
+
+	Response response = request(cmd::Echo, payload);
+
+	if (statusOf(response, "ECHO") != linktest::Ok)
+	{
+		throw FlashError("ECHO of " + std::to_string(length) + " bytes refused", response.payload[0]);
+	}
+	if (response.payload.size() != length + 1)
+	{
+		throw FlashError("ECHO: " + std::to_string(response.payload.size() - 1) + " bytes instead of " + std::to_string(length));
+	}
+
+	return std::vector<std::uint8_t>(response.payload.begin() + 1, response.payload.end());
+}
+
+SinkCounters Flasher::sink(const std::uint8_t* data, std::size_t size, std::size_t frameBytes, std::chrono::milliseconds timeout)
+{
+	SinkCounters counters;
+	std::size_t  offset = 0;
+
+	frameBytes = std::max<std::size_t>(1, std::min(frameBytes, kMaxPayloadLength - 1));
+	engine_.clearResponses();
+
+	do
+	{
+		std::size_t               chunk = std::min(frameBytes, size - offset);
+		std::vector<std::uint8_t> payload;
+
+		payload.push_back(static_cast<std::uint8_t>(((offset == 0) ? linktest::FlagReset : 0) |
+		                                            (((offset + chunk) == size) ? linktest::FlagReport : 0)));
+		payload.insert(payload.end(), data + offset, data + offset + chunk);
+		engine_.submit(cmd::Sink, payload);
+		offset += chunk;
+	} while (offset < size);
+
+	std::optional<Response> response = engine_.next(timeout);
+
+	if (!response)
+	{
+		throw FlashError("no reply to SINK");
+	}
+	if (statusOf(*response, "SINK") != linktest::Ok || response->payload.size() < 17)
+	{
+		throw FlashError("SINK: malformed report", response->payload[0]);
+	}
+
+	counters.frames    = getLe32(&response->payload[1]);
+	counters.bytes     = getLe32(&response->payload[5]);
+	counters.crcErrors = getLe32(&response->payload[9]);
+	counters.deviceMs  = getLe32(&response->payload[13]);
+
+	return counters;
+}
+
+void Flasher::memWrite(std::uint32_t address, const std::uint8_t* data, std::size_t length)
+{
+	std::vector<std::uint8_t> payload;
+
+	putLe32(payload, address);
+
+	/* v1 frames carry a 1-byte length, extended frames a 2-byte one */
+	if (1 + 5 + length + 4 <= 0xFF)
+	{
+		payload.push_back(static_cast<std::uint8_t>(length));
+	}
+	else
+	{
+		putLe16(payload, static_cast<std::uint16_t>(length));
+	}
+	payload.insert(payload.end(), data, data + length);
+
+	std::uint8_t status = statusOf(request(cmd::MemWrite, payload), "MEM_WRITE");
+
+	if (status != kStatusOk)
+	{
+		throw FlashError("write of " + hex(address) + " failed", status);
+	}
+}
+
+void Flasher::flashErase(unsigned first, unsigned count, std::chrono::milliseconds timeout)
+{
+	std::vector<std::uint8_t> payload = { static_cast<std::uint8_t>(first), static_cast<std::uint8_t>(count), 0 };
+
+	std::uint8_t status = statusOf(request(cmd::FlashErase, payload, timeout), "FLASH_ERASE");
+
+	if (status != kStatusOk)
+	{
+		throw FlashError("erase of sector " + std::to_string(first) + " failed", status);
+	}
+}
+
+void Flasher::fill(std::uint32_t address, std::uint32_t length, const std::array<std::uint8_t, 4>& pattern)
+{
+	std::vector<std::uint8_t> payload;
+
+	putLe32(payload, address);
+	putLe32(payload, length);
+	payload.insert(payload.end(), pattern.begin(), pattern.end());
+
+	std::uint8_t status = statusOf(request(cmd::MemFill, payload, std::chrono::milliseconds(5000)), "MEM_FILL");
+
+	if (status != kStatusOk)
+	{
+		throw FlashError("fill of " + hex(address) + " failed", status);
+	}
+}
+
+void Flasher::beginSession(const std::vector<std::uint8_t>& payload)
+{
+	if (statusOf(request(cmd::BeginProgram, payload), "BEGIN_PROGRAM") != kStatusOk)
+	{
+		throw FlashError("BEGIN_PROGRAM refused");
+	}
+}
+
+void Flasher::endSession()
+{
+	/* The last partial line is programmed now: the status covers every write */
+	std::uint8_t status = statusOf(request(cmd::EndProgram, {}), "END_PROGRAM");
+
+	if (status != kStatusOk)
+	{
+		throw FlashError("END_PROGRAM reports a failed write", status);
+	}
+}
+
+void Flasher::execute(const Plan& plan, const StreamOptions& options, const ProgressCallback& progress)
+{
+	const std::size_t total = plan.writeBytes + plan.fillBytes;
+	std::size_t       done  = 0;
+	StreamOptions     streamOptions = options;
+	unsigned          retransmissions = 0;
+
+	streamOptions.autoErase = false;
+
+	/* Without base / size: the writes are not one sequential range, the session is not resumable */
+	if (options.session)
+	{
+		beginSession({});
+	}
+
+	/* Runs of adjacent sectors in one BL_ERASE_RANGE each */
+	for (std::size_t first = 0; first < plan.eraseSectors.size();)
+	{
+		std::size_t last = first;
+
+		while (last + 1 < plan.eraseSectors.size() && plan.eraseSectors[last + 1] == plan.eraseSectors[last] + 1)
+		{
+			last++;
+		}
+
+		const FlashSector& start = kFlashSectors[plan.eraseSectors[first]];
+		const FlashSector& end   = kFlashSectors[plan.eraseSectors[last]];
+
+		eraseRange(start.address, end.address + end.size - start.address);
+		first = last + 1;
+	}
+
+	for (const auto& step : plan.steps)
+	{
+		if (step.kind == PlanStep::Kind::Write)
+		{
+			streamPackets(step.address, step.data, step.size, streamOptions, [&](std::size_t written, std::size_t) {
+				if (progress)
+				{
+					progress(done + written, total);
+				}
+			});
+			retransmissions += retransmissions_;
+		}
+		else
+		{
+			fill(step.address, static_cast<std::uint32_t>(step.size), step.pattern);
+		}
+
+		done += step.size;
+		if (progress)
+		{
+			progress(done, total);
+		}
+	}
+
+	retransmissions_ = retransmissions;
+
+	if (options.session)
+	{
+		endSession();
+	}
+
+	for (std::size_t index = 0; options.verify && index < plan.verify.size(); index++)
+	{
+		const Segment& region   = plan.verify[index];
+		CrcMode        mode     = digestMode();
+		std::uint32_t  expected = crc32(region.data, region.size, mode);
+		std::uint32_t  actual   = rangeCrc(region.address, static_cast<std::uint32_t>(region.size), mode);
+
+		if (actual != expected)
+		{
+			throw FlashError("verify of " + hex(region.address) + " failed: device CRC " + hex(actual) +
+			                 ", image CRC " + hex(expected));
+		}
+	}
+}
+
+void Flasher::writeLz(std::uint32_t address, const std::uint8_t* image, std::size_t size, const std::vector<std::uint8_t>& stream,
+                      const StreamOptions& options, const ProgressCallback& progress)
+{
+	if (!(capabilities().codecs & kCapsCodecWriteLz))
+	{
+		throw FlashError("the bootloader cannot take LZ streams (codecs " + hex(capabilities().codecs) + ")");
+	}
+	if (options.cipher != nullptr)
+	{
+		throw FlashError("an encrypted image cannot be sent LZ-compressed");
+	}
+
+	if (options.autoErase)
+	{
+		eraseRange(address, static_cast<std::uint32_t>(size));
+	}
+
+	std::size_t   packet = std::min<std::size_t>(options.packetSize, capabilities().maxPayload - lzwrite::HeaderLength);
+	std::uint32_t next   = address;
+	std::size_t   sent   = 0;
+
+	if (options.session)
+	{
+		std::vector<std::uint8_t> payload;
+
+		putLe32(payload, address);
+		putLe32(payload, static_cast<std::uint32_t>(size));
+		beginSession(payload);
+	}
+
+	/* Stop-and-wait: each reply names the address the next packet's output starts at */
+	do
+	{
+		std::size_t               length  = std::min(packet, stream.size() - sent);
+		std::vector<std::uint8_t> payload = { static_cast<std::uint8_t>(((sent == 0) ? lzwrite::FlagStart : 0) |
+		                                                                ((sent + length == stream.size()) ? lzwrite::FlagEnd : 0)) };
+
+		putLe32(payload, next);
+		payload.insert(payload.end(), stream.begin() + static_cast<std::ptrdiff_t>(sent),
+		               stream.begin() + static_cast<std::ptrdiff_t>(sent + length));
+
+		Response     response = request(cmd::MemWriteLz, payload, options.timeout);
+		std::uint8_t status   = statusOf(response, "MEM_WRITE_LZ");
+
+		if (status != lzwrite::Ok || response.payload.size() < 5)
+		{
+			throw FlashError("LZ write stopped at " + hex((response.payload.size() >= 5) ? getLe32(&response.payload[1]) : next), status);
+		}
+
+		next  = getLe32(&response.payload[1]);
+		sent += length;
+
+		if (progress)
+		{
+			progress(next - address, size);
+		}
+	} while (sent < stream.size());
+
+	if (next != address + size)
+	{
+		throw FlashError("LZ stream decoded to " + hex(next) + ", image ends at " + hex(static_cast<std::uint32_t>(address + size)));
+	}
+
+	if (options.session)
+	{
+		endSession();
+	}
+
+	if (options.verify)
+	{
+		CrcMode       mode     = digestMode();
+		std::uint32_t expected = crc32(image, size, mode);
+		std::uint32_t actual   = rangeCrc(address, static_cast<std::uint32_t>(size), mode);
+
+		if (actual != expected)
+		{
+			throw FlashError("verify failed: device CRC " + hex(actual) + ", image CRC " + hex(expected));
+		}
+	}
+}
+
+const Capabilities& Flasher::probeLz(const std::uint8_t* sample, std::size_t size)
+{
+	StreamOptions sram;
+
+	size = std::min<std::size_t>(size, kRamRunSize);
+
+	sram.session = false;
+	sram.verify  = false;
+	writeLz(kRamRunBase, sample, size, lzCompress(sample, size), sram);
+
+	/* The rates are the device's for the stream just sent */
+	capabilities_.reset();
+	return capabilities();
+}
+
+void Flasher::writeDelta(std::uint32_t address, std::uint32_t source, const Delta& delta, const std::uint8_t* target,
+                         const StreamOptions& options, const ProgressCallback& progress)
+{
+	std::uint8_t needed = kCapsCodecWriteDelta | ((delta.flags & delta::FlagLz) ? kCapsCodecDeltaLz : 0) |
+	                      ((delta.flags & delta::FlagThumb) ? kCapsCodecDeltaThumb : 0);
+
+	if ((capabilities().codecs & needed) != needed)
+	{
+		throw FlashError("the bootloader cannot apply this delta (codecs " + hex(capabilities().codecs) + ")");
+	}
+
+	std::size_t   packet = std::min<std::size_t>(options.packetSize, capabilities().maxPayload - delta::StartLength);
+	std::uint32_t next   = address;
+	std::size_t   sent   = 0;
+
+	if (options.session)
+	{
+		std::vector<std::uint8_t> payload;
+
+		putLe32(payload, address);
+		putLe32(payload, delta.targetLength);
+		beginSession(payload);
+	}
+
+	/* Stop-and-wait: each reply names the address the next packet continues at */
+	do
+	{
+		std::size_t               size    = std::min(packet, delta.patch.size() - sent);
+		std::vector<std::uint8_t> payload = { static_cast<std::uint8_t>(((sent == 0) ? (delta::FlagStart | delta.flags) : 0) |
+		                                                                ((sent + size == delta.patch.size()) ? delta::FlagEnd : 0)) };
+
+		putLe32(payload, next);
+		if (sent == 0)
+		{
+			putLe32(payload, source);
+			putLe32(payload, delta.sourceLength);
+			putLe32(payload, delta.targetLength);
+		}
+		payload.insert(payload.end(), delta.patch.begin() + static_cast<std::ptrdiff_t>(sent),
+		               delta.patch.begin() + static_cast<std::ptrdiff_t>(sent + size));
+
+		Response     response = request(cmd::MemWriteDelta, payload, options.timeout);
+		std::uint8_t status   = statusOf(response, "MEM_WRITE_DELTA");
+
+		if (status != delta::Ok || response.payload.size() < 5)
+		{
+			throw FlashError("delta write stopped at " + hex((response.payload.size() >= 5) ? getLe32(&response.payload[1]) : next), status);
+		}
+
+		next  = getLe32(&response.payload[1]);
+		sent += size;
+
+		if (progress)
+		{
+			progress(sent, delta.patch.size());
+		}
+	} while (sent < delta.patch.size());
+
+	if (options.session)
+	{
+		endSession();
+	}
+
+	if (options.verify)
+	{
+		CrcMode       mode     = digestMode();
+		std::uint32_t expected = crc32(target, delta.targetLength, mode);
+		std::uint32_t actual   = rangeCrc(address, delta.targetLength, mode);
+
+		if (actual != expected)
+		{
+			throw FlashError("verify failed: device CRC " + hex(actual) + ", image CRC " + hex(expected));
+		}
+	}
+}
+
+void Flasher::writePackage(const std::vector<std::uint8_t>& package, const StreamOptions& options, const ProgressCallback& progress)
+{
+	std::optional<PackageContents> contents = unpackPackage(package);
+
+	if (!contents)
+	{
+		throw FlashError("not a valid update package");
+	}
+	if (!(capabilities().codecs & kCapsCodecPackage))
+	{
+		throw FlashError("the bootloader cannot take update packages (codecs " + hex(capabilities().codecs) + ")");
+	}
+
+	std::size_t   packet   = std::min<std::size_t>(options.packetSize, capabilities().maxPayload - package::HeaderLength);
+	std::size_t   manifest = package.size() - contents->payloadSize;
+	std::uint32_t next     = 0;
+
+	if (options.session)
+	{
+		beginSession({});
+	}
+
+	/* Stop-and-wait: each reply names the offset the next packet continues at */
+	do
+	{
+		std::size_t               size    = std::min(packet, package.size() - next);
+		std::vector<std::uint8_t> payload = { static_cast<std::uint8_t>(((next == 0) ? package::FlagStart : 0) |
+		                                                                ((next + size == package.size()) ? package::FlagEnd : 0)) };
+
+		putLe32(payload, next);
+		payload.insert(payload.end(), package.begin() + static_cast<std::ptrdiff_t>(next), package.begin() + static_cast<std::ptrdiff_t>(next + size));
+
+		/* The packet completing the manifest waits for the erase of the whole plan */
+		std::chrono::milliseconds timeout = (next < manifest && next + size >= manifest)
+		                                        ? std::max(options.timeout, std::chrono::milliseconds(30000))
+		                                        : options.timeout;
+		Response     response = request(cmd::MemWritePackage, payload, timeout);
+		std::uint8_t status   = statusOf(response, "MEM_WRITE_PACKAGE");
+
+		if (status != package::Ok || response.payload.size() < 5 || getLe32(&response.payload[1]) != next + size)
+		{
+			throw FlashError("package write stopped at offset " + hex((response.payload.size() >= 5) ? getLe32(&response.payload[1]) : next),
+			                 status);
+		}
+
+		next += static_cast<std::uint32_t>(size);
+
+		if (progress)
+		{
+			progress(next, package.size());
+		}
+	} while (next < package.size());
+
+	if (options.session)
+	{
+		endSession();
+	}
+
+	if (options.verify)
+	{
+		CrcMode mode = digestMode();
+
+		for (const PackageSegment& segment : contents->segments)
+		{
+			std::uint32_t expected = crc32(segment.data.data(), segment.data.size(), mode);
+			std::uint32_t actual   = rangeCrc(segment.address, static_cast<std::uint32_t>(segment.data.size()), mode);
+
+			if (actual != expected)
+			{
+				throw FlashError("verify failed at " + hex(segment.address) + ": device CRC " + hex(actual) + ", image CRC " + hex(expected));
+			}
+		}
+	}
+}
+
+void Flasher::selfUpdate(const std::vector<std::uint8_t>& image, std::uint32_t staging, const std::vector<std::uint8_t>& signature,
+                         const StreamOptions& options, const ProgressCallback& progress)
+{
+	/* Whole words: the copier programs and verifies a word at a time */
+	std::vector<std::uint8_t> padded = image;
+	StreamOptions             stage  = options;
+
+	padded.resize((image.size() + 3) & ~static_cast<std::size_t>(3), 0xFF);
+
+	if (padded.size() < 8 || padded.size() > selfupdate::BootloaderSize)
+	{
+		throw FlashError("bootloader image of " + std::to_string(image.size()) + " bytes does not fit sectors 0 and 1");
+	}
+	if (!signature.empty() && signature.size() != 64)
+	{
+		throw FlashError("the signature is 64 bytes (r || s), not " + std::to_string(signature.size()));
+	}
+
+	stage.autoErase = false;
+	stage.cipher    = nullptr;
+	eraseRange(staging, static_cast<std::uint32_t>(padded.size()));
+	writeStream(staging, padded, stage, progress);
+
+	Sha256Digest              digest  = Sha256::of(padded.data(), padded.size());
+	std::vector<std::uint8_t> payload;
+
+	putLe32(payload, staging);
+	putLe32(payload, static_cast<std::uint32_t>(padded.size()));
+	payload.insert(payload.end(), digest.begin(), digest.end());
+	payload.insert(payload.end(), signature.begin(), signature.end());
+
+	/* The device hashes the staged copy before it answers */
+	std::uint8_t status = statusOf(request(cmd::SelfUpdate, payload, std::chrono::milliseconds(3000)), "SELF_UPDATE");
+
+	if (status != selfupdate::Ok)
+	{
+		static const char* const reasons[] = { "", "image or vector table invalid", "SHA-256 mismatch", "signature refused",
+		                                       "bootloader sectors write protected" };
+
+		throw FlashError(std::string("self-update refused: ") + ((status < 5) ? reasons[status] : "unknown status"), status);
+	}
+}
+
+void Flasher::writeStream(std::uint32_t address, const std::uint8_t* image, std::size_t size,
+                          const StreamOptions& options, const ProgressCallback& progress)
+{
+	std::vector<std::uint8_t> ciphertext;
+
+	if (options.cipher != nullptr)
+	{
+		if (!options.session || !(capabilities().features & kFeatureDecrypt))
+		{
+			throw FlashError(options.session ? "the bootloader cannot decrypt images" : "an encrypted image needs a session");
+		}
+
+		ciphertext.assign(image, image + size);
+		options.cipher->apply(0, ciphertext.data(), ciphertext.size());
+	}
+
+	if (options.session)
+	{
+		std::vector<std::uint8_t> payload;
+
+		putLe32(payload, address);
+		putLe32(payload, static_cast<std::uint32_t>(size));
+		if (options.cipher != nullptr)
+		{
+			payload.insert(payload.end(), options.cipher->counter().begin(), options.cipher->counter().end());
+		}
+		beginSession(payload);
+	}
+
+	streamPackets(address, ciphertext.empty() ? image : ciphertext.data(), size, options, progress);
+
+	if (options.session)
+	{
+		endSession();
+	}
+
+	if (options.verify)
+	{
+		CrcMode       mode     = digestMode();
+		std::uint32_t expected = crc32(image, size, mode);
+		std::uint32_t actual   = rangeCrc(address, static_cast<std::uint32_t>(size), mode);
+
+		if (actual != expected)
+		{
+			throw FlashError("verify failed: device CRC " + hex(actual) + ", image CRC " + hex(expected));
+		}
+	}
+}
+
+/*
+ * streamPackets
+ * -------------
+ * Go-back-N over BL_MEM_WRITE_STREAM. Packet i carries sequence i; the first
+ * is flagged START (with AUTO_ERASE if asked), the last LAST so the device
+ * answers it at once. Packets are queued while fewer than the tuner's window
+ * are unacknowledged; every cumulative ACK slides the window. A RETRANSMIT, or
+ * a timeout, drops what is still queued and goes back to the packet the
+ * device expects: sequence numbers behind the device are answered with a
+ * RETRANSMIT naming it, so a lost ACK costs one round trip. A RETRANSMIT
+ * naming a packet resent less than two RTTs ago is one of those and only
+ * acknowledges what comes before it.
+ *
+ * A packet keeps the offset and length it was first sent with; the tuner's
+ * packet size only applies to packets not issued yet.
+ */
+void Flasher::streamPackets(std::uint32_t address, const std::uint8_t* image, std::size_t size,
+                            const StreamOptions& options, const ProgressCallback& progress)
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct Packet
+	{
+		std::size_t       offset;
+		std::size_t       length;
+		Clock::time_point sentAt;
+		bool              resent;
+	};
+
+	StreamTuner tuner(capabilities(), options.packetSize, options.window, options.adaptive, options.log);
+	std::vector<Packet> packets;   /* Issued so far, by sequence */
+	std::size_t base       = 0;    /* First packet not acknowledged */
+	std::size_t sent       = 0;    /* Next packet to queue */
+	std::size_t nextOffset = 0;    /* Image bytes not in any packet yet */
+	unsigned    failures   = 0;
+
+	retransmissions_ = 0;
+	engine_.clearResponses();
+
+	auto queuePacket = [&](std::size_t index) {
+		Packet&      packet = packets[index];
+		std::uint8_t flags  = 0;
+		std::vector<std::uint8_t> payload;
+
+		if (index == 0)
+		{
+			flags |= stream::FlagStart | (options.autoErase ? stream::FlagAutoErase : 0);
+		}
+		if (packet.offset + packet.length == size)
+		{
+			flags |= stream::FlagLast;
+		}
+
+		payload.reserve(stream::HeaderLength + packet.length);
+		putLe16(payload, static_cast<std::uint16_t>(index));
+		payload.push_back(flags);
+		putLe32(payload, address + static_cast<std::uint32_t>(packet.offset));
+
+		/* v1 frames carry a 1-byte length, extended frames a 2-byte one */
+		if (1 + 8 + packet.length + 4 <= 0xFF)
+		{
+			payload.push_back(static_cast<std::uint8_t>(packet.length));
+		}
+		else
+		{
+			putLe16(payload, static_cast<std::uint16_t>(packet.length));
+		}
+		payload.insert(payload.end(), image + packet.offset, image + packet.offset + packet.length);
+
+		packet.resent = packet.resent || (packet.sentAt != Clock::time_point());
+		packet.sentAt = Clock::now();
+		engine_.submit(cmd::MemWriteStream, payload);
+	};
+
+	auto addressOf = [&](std::size_t index) {
+		std::size_t offset = (index < packets.size()) ? packets[index].offset : nextOffset;
+		return hex(address + static_cast<std::uint32_t>(offset));
+	};
+
+	auto goBack = [&](std::size_t to, const char* why) {
+		engine_.discardQueued();
+		sent = to;
+		retransmissions_++;
+		if (why != nullptr)
+		{
+			tuner.onLoss(why);
+		}
+		else
+		{
+			tuner.onTimeout();
+		}
+
+		if (++failures > options.retries)
+		{
+			throw FlashError("stream stalled at " + addressOf(to));
+		}
+	};
+
+	while (base < packets.size() || nextOffset < size)
+	{
+		while ((sent - base) < tuner.window())
+		{
+			if (sent == packets.size())
+			{
+				if (nextOffset >= size)
+				{
+					break;
+				}
+
+				std::size_t length = std::min(tuner.packetSize(), size - nextOffset);
+				packets.push_back({ nextOffset, length, Clock::time_point(), false });
+				nextOffset += length;
+			}
+
+			queuePacket(sent);
+			sent++;
+		}
+
+		/* A sector erase makes replies slow on no schedule the RTT can predict */
+		std::optional<Response> response = engine_.next(options.autoErase ? options.timeout : tuner.timeout(options.timeout));
+
+		if (!response)
+		{
+			goBack(base, nullptr);
+			continue;
+		}
+
+		if (!response->ack || response->payload.size() < 3)
+		{
+			/* NACK of a frame the dispatcher rejected: same as a lost packet */
+			goBack(base, "NACK");
+			continue;
+		}
+
+		std::uint8_t  status   = response->payload[0];
+		std::uint16_t expected = getLe16(&response->payload[1]);
+		std::size_t   next     = base + static_cast<std::uint16_t>(expected - static_cast<std::uint16_t>(base));
+
+		if (next > packets.size())
+		{
+			/* Stale reply of an earlier stream */
+			continue;
+		}
+
+		switch (status)
+		{
+		case stream::Ack:
+			if (next > base)
+			{
+				/* RTT of the newest packet covered, only if it went out once (Karn) */
+				const Packet& newest = packets[next - 1];
+				auto rtt = newest.resent ? std::chrono::microseconds(0)
+				                         : std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - newest.sentAt);
+
+				tuner.onAck(next - base, rtt);
+
+				/* May be ahead of a go-back: those packets did arrive */
+				base     = next;
+				sent     = std::max(sent, next);
+				failures = 0;
+
+				if (progress)
+				{
+					progress((base < packets.size()) ? packets[base].offset : nextOffset, size);
+				}
+			}
+			break;
+
+		case stream::Retransmit:
+		case stream::Missing:
+			if (next > base)
+			{
+				/* Everything before next did arrive */
+				tuner.onAck(next - base, std::chrono::microseconds(0));
+				base     = next;
+				sent     = std::max(sent, next);
+				failures = 0;
+			}
+
+			/* Duplicates of a go-back each draw one more reply naming the packet
+			 * just resent: only a request older than that resend is acted on */
+			if (next < sent && (!packets[next].resent || (Clock::now() - packets[next].sentAt) > 2 * tuner.smoothedRtt()))
+			{
+				goBack(next, (status == stream::Retransmit) ? "retransmit" : "missing");
+			}
+			break;
+
+		case stream::EraseRequired:
+			throw FlashError("flash at " + addressOf(next) + " needs an erase", status);
+
+		default:
+			throw FlashError("write failed at " + addressOf(next), status);
+		}
+	}
+
+	if (options.log)
+	{
+		options.log("stream done: " + tuner.summary());
+	}
+}
+
+const Capabilities& Flasher::capabilities()
+{
+	if (!capabilities_)
+	{
+		Response response = request(cmd::GetCapabilities, {});
+
+		/* A bootloader without the command NACKs it: the compiled-in limits */
+		capabilities_ = (response.ack ? parseCapabilities(response.payload) : std::nullopt).value_or(Capabilities());
+	}
+
+	return *capabilities_;
+}
+
+}
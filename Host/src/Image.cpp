@@ -0,0 +1,280 @@
+#include "blhost/Image.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "blhost/Protocol.hpp"
+
+namespace blhost
+{
+
+namespace
+{
+
+constexpr std::uint32_t kElfProgramLoad    = 1u;   /* PT_LOAD */
+constexpr std::uint32_t kElfSectionNoBits  = 8u;   /* SHT_NOBITS: .bss, stack */
+constexpr std::uint32_t kElfSectionAlloc   = 2u;   /* SHF_ALLOC */
+
+int hexDigit(char digit)
+{
+	if (digit >= '0' && digit <= '9') { return digit - '0'; }
+	if (digit >= 'A' && digit <= 'F') { return digit - 'A' + 10; }
+	if (digit >= 'a' && digit <= 'f') { return digit - 'a' + 10; }
+	return -1;
+}
+
+}
+
+Image Image::load(const std::string& path, std::uint32_t binaryBase)
+{
+	Image image;
+
+	image.file_ = std::make_shared<MappedFile>(path);
+
+	const std::uint8_t* data = image.file_->data();
+	std::size_t         size = image.file_->size();
+
+	if (size >= 4 && std::memcmp(data, "\x7F" "ELF", 4) == 0)
+	{
+		image.loadElf(path);
+	}
+	else if (size >= 1 && data[0] == ':')
+	{
+		image.loadHex(path);
+	}
+	else
+	{
+		image.format_ = "binary";
+		if (size != 0)
+		{
+			image.segments_.push_back({ binaryBase, data, size });
+		}
+	}
+
+	std::sort(image.segments_.begin(), image.segments_.end(),
+	          [](const Segment& left, const Segment& right) { return left.address < right.address; });
+
+	for (std::size_t index = 1; index < image.segments_.size(); index++)
+	{
+		if (image.segments_[index].address < image.segments_[index - 1].end())
+		{
+			throw std::runtime_error(path + ": segments overlap");
+		}
+	}
+
+	return image;
+}
+
+std::size_t Image::size() const
+{
+	std::size_t total = 0;
+
+	for (const auto& segment : segments_)
+	{
+		total += segment.size;
+	}
+
+	return total;
+}
+
+void Image::loadElf(const std::string& path)
+{
+	const std::uint8_t* data = file_->data();
+	std::size_t         size = file_->size();
+
+	format_ = "ELF";
+
+	/* ELFCLASS32, ELFDATA2LSB, and a whole 52-byte header */
+	if (size < 52 || data[4] != 1 || data[5] != 1)
+	{
+		throw std::runtime_error(path + ": not a 32-bit little-endian ELF file");
+	}
+
+	std::uint32_t programs     = getLe32(&data[28]);
+	std::uint32_t sections     = getLe32(&data[32]);
+	std::uint16_t programEntry = getLe16(&data[42]);
+	std::uint16_t programCount = getLe16(&data[44]);
+	std::uint16_t sectionEntry = getLe16(&data[46]);
+	std::uint16_t sectionCount = getLe16(&data[48]);
+
+	auto table = [&](std::uint32_t offset, std::uint16_t entry, std::uint16_t count, std::uint16_t minimum) {
+		if (count != 0 && (entry < minimum || offset > size || (std::size_t(entry) * count) > (size - offset)))
+		{
+			throw std::runtime_error(path + ": ELF header table out of the file");
+		}
+	};
+
+	table(programs, programEntry, programCount, 32);
+	table(sections, sectionEntry, sectionCount, 40);
+
+	auto contents = [&](std::uint32_t address, std::uint32_t offset, std::uint32_t length) {
+		if (offset > size || length > (size - offset))
+		{
+			throw std::runtime_error(path + ": segment out of the file");
+		}
+		segments_.push_back({ address, &data[offset], length });
+	};
+
+	/* Allocated sections with contents, at their load address: a PT_LOAD can
+	 * also cover the ELF header and padding, which must not be programmed */
+	for (std::uint16_t index = 0; index < sectionCount; index++)
+	{
+		const std::uint8_t* section = &data[sections + std::size_t(index) * sectionEntry];
+		std::uint32_t       type    = getLe32(&section[4]);
+		std::uint32_t       flags   = getLe32(&section[8]);
+		std::uint32_t       address = getLe32(&section[12]);
+		std::uint32_t       offset  = getLe32(&section[16]);
+		std::uint32_t       length  = getLe32(&section[20]);
+
+		if ((flags & kElfSectionAlloc) == 0 || type == kElfSectionNoBits || length == 0)
+		{
+			continue;
+		}
+
+		/* LMA: the offset inside the PT_LOAD that holds the section, from its physical address */
+		std::uint32_t load = address;
+
+		for (std::uint16_t segment = 0; segment < programCount; segment++)
+		{
+			const std::uint8_t* header  = &data[programs + std::size_t(segment) * programEntry];
+			std::uint32_t       virt    = getLe32(&header[8]);
+			std::uint32_t       memory  = getLe32(&header[20]);
+
+			if (getLe32(&header[0]) == kElfProgramLoad && address >= virt && (address - virt) < memory)
+			{
+				load = getLe32(&header[12]) + (address - virt);
+				break;
+			}
+		}
+
+		contents(load, offset, length);
+	}
+
+	/* No section table (stripped): the PT_LOAD file contents */
+	for (std::uint16_t index = 0; sectionCount == 0 && index < programCount; index++)
+	{
+		const std::uint8_t* header = &data[programs + std::size_t(index) * programEntry];
+		std::uint32_t       length = getLe32(&header[16]);
+
+		if (getLe32(&header[0]) == kElfProgramLoad && length != 0)
+		{
+			contents(getLe32(&header[12]), getLe32(&header[4]), length);
+		}
+	}
+}
+
+void Image::loadHex(const std::string& path)
+{
+	const char*   text   = reinterpret_cast<const char*>(file_->data());
+	std::size_t   size   = file_->size();
+	std::size_t   at     = 0;
+	std::uint32_t upper  = 0;       /* Extended linear / segment address */
+	std::uint32_t runEnd = 0;
+	unsigned      line   = 0;
+	bool          ended  = false;
+
+	format_ = "Intel HEX";
+
+	while (at < size && !ended)
+	{
+		std::size_t eol = at;
+		while (eol < size && text[eol] != '\n' && text[eol] != '\r')
+		{
+			eol++;
+		}
+
+		std::size_t length = eol - at;
+		line++;
+
+		if (length != 0)
+		{
+			std::vector<std::uint8_t> record;
+
+			if (text[at] != ':' || (length % 2) != 1 || length < 11)
+			{
+				throw std::runtime_error(path + ":" + std::to_string(line) + ": malformed record");
+			}
+
+			for (std::size_t digit = at + 1; digit < eol; digit += 2)
+			{
+				int high = hexDigit(text[digit]);
+				int low  = hexDigit(text[digit + 1]);
+
+				if (high < 0 || low < 0)
+				{
+					throw std::runtime_error(path + ":" + std::to_string(line) + ": bad hex digit");
+				}
+				record.push_back(static_cast<std::uint8_t>((high << 4) | low));
+			}
+
+			std::uint8_t sum = 0;
+			for (std::uint8_t byte : record)
+			{
+				sum = static_cast<std::uint8_t>(sum + byte);
+			}
+
+			if (record.size() != std::size_t(record[0]) + 5 || sum != 0)
+			{
+				throw std::runtime_error(path + ":" + std::to_string(line) + ": bad length or checksum");
+			}
+
+			/* Segment and linear base records carry exactly two bytes */
+			if ((record[3] == 0x02 || record[3] == 0x04) && record[0] != 2)
+			{
+				throw std::runtime_error(path + ":" + std::to_string(line) + ": malformed record");
+			}
+
+			std::uint32_t offset = (std::uint32_t(record[1]) << 8) | record[2];
+			const std::uint8_t* bytes = &record[4];
+
+			switch (record[3])
+			{
+			case 0x00:   /* Data: appended to the current run when it follows it */
+			{
+				std::uint32_t address = upper + offset;
+
+				if (record[0] == 0)
+				{
+					break;
+				}
+
+				if (decoded_.empty() || address != runEnd)
+				{
+					decoded_.emplace_back();
+					segments_.push_back({ address, nullptr, 0 });
+				}
+				decoded_.back().insert(decoded_.back().end(), bytes, bytes + record[0]);
+				runEnd = address + record[0];
+				break;
+			}
+
+			case 0x01:
+				ended = true;
+				break;
+
+			case 0x02:
+				upper = ((std::uint32_t(bytes[0]) << 8) | bytes[1]) << 4;
+				break;
+
+			case 0x04:
+				upper = ((std::uint32_t(bytes[0]) << 8) | bytes[1]) << 16;
+				break;
+
+			default:   /* 03 / 05: start address, not programmed */
+				break;
+			}
+		}
+
+		at = eol + 1;
+	}
+
+	/* The buffers have stopped growing: point the segments at them */
+	for (std::size_t index = 0; index < segments_.size(); index++)
+	{
+		segments_[index].data = decoded_[index].data();
+		segments_[index].size = decoded_[index].size();
+	}
+}
+
+}
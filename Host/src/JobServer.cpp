@@ -0,0 +1,265 @@
+#include "blhost/JobServer.hpp"
+
+#include <chrono>
+#include <cstdio>
+
+#include "blhost/Engine.hpp"
+#include "blhost/Flasher.hpp"
+#include "blhost/Image.hpp"
+#include "blhost/Manifest.hpp"
+#include "blhost/MappedFile.hpp"
+#include "blhost/Transport.hpp"
+
+namespace blhost
+{
+
+/* What stays open between jobs */
+struct Station::Session
+{
+	Session(const std::string& port, const BatchOptions& options)
+		: serial(port, options.baud, options.flowControl), engine(serial, options.engine), flasher(engine)
+	{
+		engine.start();
+		version = flasher.getVersion();
+		info    = flasher.deviceInfo();
+		flasher.capabilities();
+	}
+
+	SerialPort   serial;
+	Engine       engine;
+	Flasher      flasher;
+	std::uint8_t version = 0;
+	DeviceInfo   info;
+};
+
+Station::Station(std::string port, const JobServerOptions& options) : port_(std::move(port)), options_(options) {}
+
+Station::~Station() = default;
+
+std::uint64_t Station::reserve()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	return ticket_++;
+}
+
+unsigned Station::queued() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	return static_cast<unsigned>(ticket_ - serving_);
+}
+
+std::string Station::describe() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	return port_ + (warm_ ? " warm " : " closed ") + std::to_string(done_) + " " + std::to_string(ticket_ - serving_);
+}
+
+void Station::open()
+{
+	if (!session_)
+	{
+		session_ = std::make_unique<Session>(port_, options_.board);
+	}
+}
+
+JobResult Station::run(std::uint64_t ticket, const Job& job)
+{
+	auto      start = std::chrono::steady_clock::now();
+	JobResult result;
+
+	result.port = port_;
+
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		turn_.wait(lock, [&] { return serving_ == ticket; });
+	}
+
+	try
+	{
+		execute(job, result);
+	}
+	catch (const std::exception& error)
+	{
+		result.ok      = false;
+		result.message = error.what();
+		session_.reset();
+	}
+
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		warm_ = (session_ != nullptr);
+		done_++;
+		serving_++;
+	}
+	turn_.notify_all();
+
+	return result;
+}
+
+void Station::execute(const Job& job, JobResult& result)
+{
+	char line[160];
+
+	if (job.kind == Job::Kind::Release)
+	{
+		session_.reset();
+		result.ok      = true;
+		result.message = "released";
+		return;
+	}
+
+	open();
+
+	Flasher& flasher = session_->flasher;
+
+	switch (job.kind)
+	{
+	case Job::Kind::Info:
+		std::snprintf(line, sizeof(line), "bootloader %u chip 0x%03X flash %u KB uid %s", session_->version,
+		              session_->info.chipId, session_->info.flashSizeKb, session_->info.uniqueIdHex().c_str());
+		result.ok = true;
+		break;
+
+	case Job::Kind::Write:
+	{
+		MappedFile image(job.image);
+
+		flasher.writeStream(job.address, image.data(), image.size(), options_.board.stream);
+		std::snprintf(line, sizeof(line), "%zu bytes, %u retransmissions", image.size(), flasher.lastRetransmissions());
+		result.ok = true;
+		break;
+	}
+
+	case Job::Kind::Verify:
+	{
+		MappedFile    image(job.image);
+		CrcMode       mode     = flasher.digestMode();
+		std::uint32_t expected = crc32(image.data(), image.size(), mode);
+		std::uint32_t actual   = flasher.rangeCrc(job.address, static_cast<std::uint32_t>(image.size()), mode);
+
+		std::snprintf(line, sizeof(line), "device 0x%08X, image 0x%08X", actual, expected);
+		result.ok = (actual == expected);
+		break;
+	}
+
+	case Job::Kind::Program:
+	{
+		Image    image    = Image::load(job.image, job.address);
+		Plan     transfer = planTransfer(image, options_.plan);
+		Manifest wanted   = imageManifestOf(job.image, transfer);
+
+		std::unique_ptr<ManifestCache> cache;
+
+		if (!options_.cacheDirectory.empty())
+		{
+			cache = std::make_unique<ManifestCache>(options_.cacheDirectory);
+			wanted.uniqueId = session_->info.uniqueIdHex();
+
+			std::uint16_t unchanged = findUnchangedSectors(flasher, wanted, cache->load(wanted.uniqueId));
+
+			if (unchanged == sectorsOf(wanted))
+			{
+				cache->store(wanted);
+				result.ok      = true;
+				result.message = "up to date";
+				return;
+			}
+
+			PlanOptions options      = options_.plan;
+			options.unchangedSectors = unchanged;
+			transfer = planTransfer(image, options);
+		}
+
+		flasher.execute(transfer, options_.board.stream);
+
+		/* Only after the verify passed */
+		if (cache)
+		{
+			cache->store(wanted);
+		}
+
+		std::snprintf(line, sizeof(line), "%zu bytes sent, %zu filled, %zu skipped, %zu unchanged, %u retransmissions",
+		              transfer.writeBytes, transfer.fillBytes, transfer.skippedBytes, transfer.unchangedBytes,
+		              flasher.lastRetransmissions());
+		result.ok = true;
+		break;
+	}
+
+	default:
+		line[0] = '\0';
+		break;
+	}
+
+	result.message = line;
+
+	/* A mismatch is a failure on the device too: start the next job afresh */
+	if (!result.ok)
+	{
+		session_.reset();
+	}
+}
+
+JobServer::JobServer(const std::vector<std::string>& ports, JobServerOptions options) : options_(std::move(options))
+{
+	for (const auto& port : ports)
+	{
+		stations_.push_back(std::make_unique<Station>(port, options_));
+	}
+}
+
+Station* JobServer::pick(const std::string& port, std::uint64_t& ticket)
+{
+	std::lock_guard<std::mutex> lock(pickMutex_);
+	Station*                    chosen = nullptr;
+
+	for (const auto& station : stations_)
+	{
+		if (port.empty() ? (chosen == nullptr || station->queued() < chosen->queued()) : (station->port() == port))
+		{
+			chosen = station.get();
+		}
+	}
+
+	/* Reserved under the lock, so two jobs for any never both see the same station idle */
+	if (chosen != nullptr)
+	{
+		ticket = chosen->reserve();
+	}
+
+	return chosen;
+}
+
+JobResult JobServer::run(const Job& job)
+{
+	std::uint64_t ticket  = 0;
+	Station*      station = pick(job.port, ticket);
+
+	if (station == nullptr)
+	{
+		JobResult result;
+		result.port    = job.port;
+		result.message = "no such port";
+		return result;
+	}
+
+	return station->run(ticket, job);
+}
+
+std::vector<std::string> JobServer::describe() const
+{
+	std::vector<std::string> lines;
+
+	for (const auto& station : stations_)
+	{
+		lines.push_back(station->describe());
+	}
+
+	return lines;
+}
+
+}
@@ -0,0 +1,391 @@
+#include "blhost/Layout.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace blhost
+{
+
+namespace
+{
+
+const char* const kBegin     = "/* bllayout begin */";
+const char* const kEnd       = "/* bllayout end */";
+const char* const kTailBegin = "/* bllayout tail begin */";
+const char* const kTailEnd   = "/* bllayout tail end */";
+
+struct Function
+{
+	std::string   section;
+	std::string   module;
+	std::uint32_t size = 0;
+};
+
+std::uint32_t alignUp(std::uint32_t value, std::uint32_t alignment)
+{
+	return (value + alignment - 1u) & ~(alignment - 1u);
+}
+
+std::string trim(const std::string& text)
+{
+	std::string::size_type first = text.find_first_not_of(" \t");
+	std::string::size_type last  = text.find_last_not_of(" \t");
+
+	return (first == std::string::npos) ? std::string() : text.substr(first, last - first + 1);
+}
+
+std::vector<std::string> lines(const std::string& text)
+{
+	std::vector<std::string> result;
+	std::istringstream       stream(text);
+	std::string              line;
+
+	while (std::getline(stream, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+		result.push_back(line);
+	}
+	return result;
+}
+
+/* Index of the line holding marker, lines.size() without one */
+std::size_t find(const std::vector<std::string>& lines, const char* marker, std::size_t from = 0)
+{
+	for (std::size_t index = from; index < lines.size(); index++)
+	{
+		if (trim(lines[index]) == marker)
+		{
+			return index;
+		}
+	}
+	return lines.size();
+}
+
+/* The object file, or the archive of a library member: one slot for all of libc */
+std::string moduleOf(const std::string& object)
+{
+	std::string            file  = object.substr(0, object.find('('));
+	std::string::size_type slash = file.find_last_of("/\\");
+
+	return (slash == std::string::npos) ? file : file.substr(slash + 1);
+}
+
+std::string hex(std::uint32_t value)
+{
+	char text[16];
+
+	std::snprintf(text, sizeof(text), "0x%08X", value);
+	return text;
+}
+
+/* Code bytes of sections in a row, each on a word as the slot checks assume */
+std::uint32_t codeSize(const std::vector<std::string>& sections, const std::map<std::string, Function>& functions)
+{
+	std::uint32_t size = 0;
+
+	for (const std::string& section : sections)
+	{
+		size += alignUp(functions.at(section).size, 4u);
+	}
+	return size;
+}
+
+}
+
+StableLayout StableLayout::parse(const std::string& script)
+{
+	std::vector<std::string> text      = lines(script);
+	std::size_t              begin     = find(text, kBegin);
+	std::size_t              end       = find(text, kEnd, begin);
+	std::size_t              tailBegin = find(text, kTailBegin);
+	std::size_t              tailEnd   = find(text, kTailEnd, tailBegin);
+	StableLayout             layout;
+
+	if (end >= text.size() || tailEnd >= text.size())
+	{
+		throw std::runtime_error("no bllayout begin / end and tail begin / end markers in the .text section");
+	}
+
+	/* "slot MODULE OFFSET SIZE" comments, then "*(SECTION)" lines */
+	for (std::size_t index = begin + 1; index < end; index++)
+	{
+		std::string line = trim(text[index]);
+
+		if (line.rfind("/* slot ", 0) == 0 && line.size() > 11)
+		{
+			std::istringstream       fields(line.substr(8, line.size() - 11));
+			std::vector<std::string> tokens;
+			std::string              token;
+
+			while (fields >> token)
+			{
+				tokens.push_back(token);
+			}
+			if (tokens.size() < 3)
+			{
+				throw std::runtime_error("bad bllayout slot line: " + line);
+			}
+
+			LayoutSlot slot;
+
+			slot.offset = static_cast<std::uint32_t>(std::strtoul(tokens[tokens.size() - 2].c_str(), nullptr, 0));
+			slot.size   = static_cast<std::uint32_t>(std::strtoul(tokens[tokens.size() - 1].c_str(), nullptr, 0));
+			for (std::size_t part = 0; part + 2 < tokens.size(); part++)
+			{
+				slot.module += (part != 0 ? " " : "") + tokens[part];
+			}
+			layout.slots_.push_back(slot);
+		}
+		else if (line.rfind("*(", 0) == 0 && line.back() == ')')
+		{
+			if (layout.slots_.empty())
+			{
+				throw std::runtime_error("bllayout section outside a slot: " + line);
+			}
+			layout.slots_.back().sections.push_back(line.substr(2, line.size() - 3));
+		}
+	}
+
+	for (std::size_t index = tailBegin + 1; index < tailEnd; index++)
+	{
+		std::string::size_type at = text[index].find("_stable_layout + ");
+
+		if (at != std::string::npos)
+		{
+			layout.tailEnd_ = static_cast<std::uint32_t>(std::strtoul(text[index].c_str() + at + 17, nullptr, 0));
+		}
+	}
+
+	std::stable_sort(layout.slots_.begin(), layout.slots_.end(),
+	                 [](const LayoutSlot& left, const LayoutSlot& right) { return left.offset < right.offset; });
+	return layout;
+}
+
+std::uint32_t StableLayout::end() const
+{
+	std::uint32_t result = 0;
+
+	for (const LayoutSlot& slot : slots_)
+	{
+		result = std::max(result, slot.offset + slot.size);
+	}
+	return result;
+}
+
+void StableLayout::reset()
+{
+	slots_.clear();
+	tailEnd_ = 0;
+}
+
+LayoutChanges StableLayout::update(const LinkerMap& map, const LayoutOptions& options)
+{
+	const std::vector<MemoryRegion>& regions = map.regions();
+	std::map<std::string, Function>  functions;
+	std::vector<std::string>         order;          /* Map order, by address */
+	std::set<std::string>            inRam;
+	LayoutChanges                    changes;
+
+	for (const MapEntry& entry : map.entries())
+	{
+		if (entry.region < 0 || entry.section.rfind(".text.", 0) != 0)
+		{
+			continue;
+		}
+		if (regions[entry.region].writable)
+		{
+			inRam.insert(entry.section);
+			continue;
+		}
+
+		auto found = functions.find(entry.section);
+
+		if (found == functions.end())
+		{
+			functions[entry.section] = { entry.section, moduleOf(entry.object), entry.size };
+			order.push_back(entry.section);
+		}
+		else
+		{
+			/* Static functions of one name in several objects: one pattern places them all */
+			found->second.size += entry.size;
+		}
+	}
+
+	/* A pattern would also pull a RAM function of that name out of .data */
+	for (const std::string& section : inRam)
+	{
+		functions.erase(section);
+	}
+	order.erase(std::remove_if(order.begin(), order.end(),
+	                           [&](const std::string& section) { return functions.count(section) == 0; }),
+	            order.end());
+
+	std::set<std::string>                           listed;
+	std::set<std::string>                           placed;
+	std::map<std::string, std::size_t>              lastSlot;          /* A module's new functions go there */
+	std::vector<std::string>                        pendingModules;    /* New slots at the end, in this order */
+	std::map<std::string, std::vector<std::string>> pending;
+
+	for (std::size_t index = 0; index < slots_.size(); index++)
+	{
+		listed.insert(slots_[index].sections.begin(), slots_[index].sections.end());
+		lastSlot[slots_[index].module] = index;
+	}
+
+	auto defer = [&](const std::string& module, const std::string& section)
+	{
+		if (pending.count(module) == 0)
+		{
+			pendingModules.push_back(module);
+		}
+		pending[module].push_back(section);
+	};
+
+	for (std::size_t index = 0; index < slots_.size(); index++)
+	{
+		LayoutSlot&              slot = slots_[index];
+		std::vector<std::string> kept;
+		std::uint32_t            fill = 0;
+		bool                     full = false;
+
+		auto place = [&](const std::string& section) -> bool
+		{
+			std::uint32_t need = alignUp(functions.at(section).size, 4u);
+
+			placed.insert(section);
+			if (!full && fill + need <= slot.size)
+			{
+				fill += need;
+				kept.push_back(section);
+				return true;
+			}
+			/* Past the first that does not fit, all of them go: the order in the slot stays */
+			full = true;
+			defer(slot.module, section);
+			return false;
+		};
+
+		for (const std::string& section : slot.sections)
+		{
+			if (functions.count(section) == 0)
+			{
+				changes.removed++;
+			}
+			else if (placed.count(section) == 0)
+			{
+				if (place(section))
+				{
+					changes.kept++;
+				}
+				else
+				{
+					changes.moved++;
+					changes.movedSections.push_back(section);
+				}
+			}
+		}
+
+		if (lastSlot[slot.module] == index)
+		{
+			for (const std::string& section : order)
+			{
+				if (functions.at(section).module == slot.module && listed.count(section) == 0 && placed.count(section) == 0)
+				{
+					place(section);
+					changes.added++;
+				}
+			}
+		}
+		slot.sections = kept;
+	}
+
+	/* New modules, after the ones that spilled over */
+	for (const std::string& section : order)
+	{
+		if (placed.count(section) == 0)
+		{
+			placed.insert(section);
+			defer(functions.at(section).module, section);
+			changes.added++;
+		}
+	}
+
+	for (const std::string& module : pendingModules)
+	{
+		LayoutSlot    slot;
+		std::uint32_t code = codeSize(pending[module], functions);
+
+		slot.module   = module;
+		slot.offset   = alignUp(end(), 16u);
+		slot.size     = alignUp(code + std::max<std::uint32_t>(code / 100u * options.slackPercent, options.minSlack), 16u);
+		slot.sections = pending[module];
+		slots_.push_back(slot);
+		changes.newSlots++;
+	}
+
+	if (slots_.empty())
+	{
+		tailEnd_ = 0;
+	}
+	else if (end() > tailEnd_)
+	{
+		tailEnd_ = alignUp(end() + options.tail, 16u);
+	}
+
+	return changes;
+}
+
+std::string StableLayout::apply(const std::string& script) const
+{
+	std::vector<std::string> text      = lines(script);
+	std::size_t              begin     = find(text, kBegin);
+	std::size_t              end       = find(text, kEnd, begin);
+	std::size_t              tailBegin = find(text, kTailBegin);
+	std::size_t              tailEnd   = find(text, kTailEnd, tailBegin);
+
+	if (end >= text.size() || tailEnd >= text.size() || tailBegin < end)
+	{
+		throw std::runtime_error("no bllayout begin / end and tail begin / end markers in the .text section");
+	}
+
+	std::string        indent = text[begin].substr(0, text[begin].find_first_not_of(" \t"));
+	std::ostringstream out;
+
+	for (std::size_t index = 0; index <= begin; index++)
+	{
+		out << text[index] << '\n';
+	}
+	for (const LayoutSlot& slot : slots_)
+	{
+		out << indent << "/* slot " << slot.module << ' ' << hex(slot.offset) << ' ' << hex(slot.size) << " */\n";
+		out << indent << ". = MAX(., _stable_layout + " << hex(slot.offset) << ");\n";
+		for (const std::string& section : slot.sections)
+		{
+			out << indent << "*(" << section << ")\n";
+		}
+	}
+	for (std::size_t index = end; index <= tailBegin; index++)
+	{
+		out << text[index] << '\n';
+	}
+	if (tailEnd_ != 0)
+	{
+		out << indent << ". = MAX(., _stable_layout + " << hex(tailEnd_) << ");\n";
+	}
+	for (std::size_t index = tailEnd; index < text.size(); index++)
+	{
+		out << text[index] << '\n';
+	}
+	return out.str();
+}
+
+}
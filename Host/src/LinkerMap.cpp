@@ -0,0 +1,304 @@
+#include "blhost/LinkerMap.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace blhost
+{
+
+namespace
+{
+
+/* The per-function and per-variable sections of -ffunction-sections / -fdata-sections */
+const char* const kNamedPrefixes[] = { ".text.", ".rodata.", ".data.", ".bss.", ".RamFunc.", ".ccmram." };
+
+std::vector<std::string> split(const std::string& line)
+{
+	std::istringstream       stream(line);
+	std::vector<std::string> tokens;
+	std::string              token;
+
+	while (stream >> token)
+	{
+		tokens.push_back(token);
+	}
+	return tokens;
+}
+
+bool isHex(const std::string& token)
+{
+	return token.size() > 2 && token[0] == '0' && (token[1] == 'x' || token[1] == 'X');
+}
+
+std::uint32_t hex(const std::string& token)
+{
+	/* 64-bit hosts print 16 digits; the target's addresses are the low 32 bits */
+	return static_cast<std::uint32_t>(std::strtoull(token.c_str(), nullptr, 16));
+}
+
+/* No contents in the image: nothing to copy from flash at startup */
+bool isNoBits(const std::string& section)
+{
+	return section.rfind(".bss", 0) == 0 || section == "COMMON" || section.rfind(".noinit", 0) == 0;
+}
+
+/* Toolchain objects by file name, archive members as library(member), the project's relative to the build */
+std::string shortObject(const std::string& object)
+{
+	std::string::size_type member = object.find('(');
+	std::string            file   = object.substr(0, member);
+	bool                   system = !file.empty() && (file[0] == '/' || (file.size() > 1 && file[1] == ':'));
+
+	if (system || member != std::string::npos)
+	{
+		std::string::size_type slash = file.find_last_of("/\\");
+
+		if (slash != std::string::npos)
+		{
+			file.erase(0, slash + 1);
+		}
+	}
+	return (member == std::string::npos) ? file : file + object.substr(member);
+}
+
+struct Input
+{
+	std::string                                       name;
+	std::string                                       object;
+	std::uint32_t                                     address = 0;
+	std::uint32_t                                     size    = 0;
+	std::vector<std::pair<std::uint32_t, std::string>> symbols;
+};
+
+struct Output
+{
+	int           region      = -1;
+	int           loadRegion  = -1;
+	std::uint32_t size        = 0;
+	bool          contents    = false;   /* Holds an input section with bits to load */
+	std::size_t   firstEntry  = 0;
+};
+
+}
+
+int LinkerMap::regionOf(std::uint32_t address) const
+{
+	for (std::size_t index = 0; index < regions_.size(); index++)
+	{
+		if (address >= regions_[index].origin && (address - regions_[index].origin) < regions_[index].length)
+		{
+			return static_cast<int>(index);
+		}
+	}
+	return -1;
+}
+
+LinkerMap LinkerMap::load(const std::string& path)
+{
+	std::ifstream            file(path);
+	std::vector<std::string> lines;
+	std::string              line;
+	LinkerMap                map;
+
+	if (!file)
+	{
+		throw std::runtime_error(path + ": cannot open");
+	}
+	while (std::getline(file, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+		lines.push_back(line);
+	}
+
+	std::size_t index = 0;
+
+	while (index < lines.size() && lines[index] != "Memory Configuration")
+	{
+		index++;
+	}
+	if (index == lines.size())
+	{
+		throw std::runtime_error(path + ": no memory configuration (not a GNU ld map file?)");
+	}
+
+	/* Name Origin Length [Attributes], *default* is the catch-all */
+	for (index += 2; index < lines.size() && lines[index] != "Linker script and memory map"; index++)
+	{
+		std::vector<std::string> tokens = split(lines[index]);
+
+		if (tokens.size() >= 3 && isHex(tokens[1]) && isHex(tokens[2]) && tokens[0] != "*default*")
+		{
+			MemoryRegion region;
+
+			region.name     = tokens[0];
+			region.origin   = hex(tokens[1]);
+			region.length   = hex(tokens[2]);
+			region.writable = tokens.size() > 3 && tokens[3].find('w') != std::string::npos;
+			map.regions_.push_back(region);
+		}
+	}
+
+	Input  input;
+	Output output;
+
+	auto finishInput = [&]()
+	{
+		if (input.size == 0 || input.name == "*fill*" || output.region < 0)
+		{
+			input = Input();
+			return;
+		}
+
+		bool noBits = isNoBits(input.name);
+		auto add    = [&](const std::string& name, std::uint32_t address, std::uint32_t size)
+		{
+			if (size != 0)
+			{
+				map.entries_.push_back({ name, input.object, input.name, address, size, output.region,
+				                         noBits ? -1 : output.loadRegion });
+			}
+		};
+
+		output.contents = output.contents || !noBits;
+
+		for (const char* prefix : kNamedPrefixes)
+		{
+			if (input.name.rfind(prefix, 0) == 0 && input.name.size() > std::char_traits<char>::length(prefix))
+			{
+				add(input.name.substr(std::char_traits<char>::length(prefix)), input.address, input.size);
+				input = Input();
+				return;
+			}
+		}
+
+		/* Several symbols in one section (assembly, COMMON, .RamFunc): up to the next one */
+		std::uint32_t end    = input.address + input.size;
+		std::uint32_t cursor = input.address;
+
+		std::sort(input.symbols.begin(), input.symbols.end());
+		for (std::size_t symbol = 0; symbol < input.symbols.size(); symbol++)
+		{
+			std::uint32_t address = input.symbols[symbol].first;
+			std::uint32_t next    = (symbol + 1 < input.symbols.size()) ? std::min(input.symbols[symbol + 1].first, end) : end;
+
+			if (address < cursor || address >= end)
+			{
+				continue;
+			}
+			add(input.name, cursor, address - cursor);   /* Static code or data ahead of it */
+			add(input.symbols[symbol].second, address, next - address);
+			cursor = next;
+		}
+		add(input.name, cursor, end - cursor);
+		input = Input();
+	};
+
+	auto finishOutput = [&]()
+	{
+		finishInput();
+		if (output.region >= 0)
+		{
+			map.regions_[output.region].used += output.size;
+		}
+
+		/* Initialised data: its image sits at the load address; .bss and the stack are only reserved */
+		if (output.loadRegion >= 0 && output.loadRegion != output.region && output.contents)
+		{
+			map.regions_[output.loadRegion].used += output.size;
+		}
+		else
+		{
+			for (std::size_t entry = output.firstEntry; entry < map.entries_.size(); entry++)
+			{
+				map.entries_[entry].load = -1;
+			}
+		}
+		output            = Output();
+		output.firstEntry = map.entries_.size();
+	};
+
+	for (index++; index < lines.size(); index++)
+	{
+		const std::string&       text   = lines[index];
+		std::vector<std::string> tokens = split(text);
+
+		if (tokens.empty())
+		{
+			continue;
+		}
+
+		/* Continuation of a name too long for its column */
+		auto wrapped = [&]()
+		{
+			if (tokens.size() == 1 && index + 1 < lines.size())
+			{
+				std::vector<std::string> next = split(lines[index + 1]);
+
+				if (next.size() >= 2 && isHex(next[0]) && isHex(next[1]))
+				{
+					tokens.insert(tokens.end(), next.begin(), next.end());
+					index++;
+				}
+			}
+		};
+
+		if (text[0] != ' ')
+		{
+			/* Output section, or LOAD / OUTPUT / /DISCARD/ and the like */
+			finishOutput();
+			if (text[0] != '.')
+			{
+				continue;
+			}
+
+			wrapped();
+			if (tokens.size() >= 3 && isHex(tokens[1]) && isHex(tokens[2]))
+			{
+				std::uint32_t address = hex(tokens[1]);
+
+				output.region = map.regionOf(address);
+				output.size   = hex(tokens[2]);
+				if (tokens.size() >= 6 && tokens[3] == "load" && tokens[4] == "address" && isHex(tokens[5]))
+				{
+					output.loadRegion = map.regionOf(hex(tokens[5]));
+				}
+			}
+		}
+		else if (text.size() > 1 && text[1] != ' ')
+		{
+			/* Input section: name address size object */
+			finishInput();
+			wrapped();
+			if (tokens.size() >= 3 && isHex(tokens[1]) && isHex(tokens[2]))
+			{
+				input.name    = tokens[0];
+				input.address = hex(tokens[1]);
+				input.size    = hex(tokens[2]);
+
+				/* The object as written, spaces and all: everything after the size */
+				const std::string&     holder = lines[index];
+				std::string::size_type at     = holder.find(tokens[2], holder.find(tokens[1]) + tokens[1].size());
+				std::string            object = holder.substr(at + tokens[2].size());
+
+				object.erase(0, object.find_first_not_of(' '));
+				input.object = shortObject(object);
+			}
+		}
+		else if (tokens.size() == 2 && isHex(tokens[0]) && !isHex(tokens[1]) && !input.name.empty())
+		{
+			/* Global symbol defined in the current input section */
+			input.symbols.emplace_back(hex(tokens[0]), tokens[1]);
+		}
+	}
+	finishOutput();
+
+	return map;
+}
+
+}
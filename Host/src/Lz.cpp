@@ -0,0 +1,196 @@
+#include "blhost/Lz.hpp"
+
+#include <cstring>
+
+namespace blhost
+{
+
+namespace
+{
+
+constexpr unsigned kHashBits  = 16;
+constexpr unsigned kMaxChain  = 256;   /* Candidates tried per position */
+constexpr unsigned kGoodMatch = 1024;  /* A match this long ends the search */
+
+std::uint32_t hashAt(const std::uint8_t* data)
+{
+	std::uint32_t word;
+
+	std::memcpy(&word, data, sizeof(word));
+
+	return (word * 2654435761u) >> (32 - kHashBits);
+}
+
+/* [count] as a token nibble already holding 15, then 255s and the rest */
+void putLength(std::vector<std::uint8_t>& out, std::size_t count)
+{
+	for (; count >= 255; count -= 255)
+	{
+		out.push_back(255);
+	}
+	out.push_back(static_cast<std::uint8_t>(count));
+}
+
+void putSequence(std::vector<std::uint8_t>& out, const std::uint8_t* literals, std::size_t literalCount,
+                 std::size_t offset, std::size_t matchLength)
+{
+	std::size_t  matchCount = (matchLength != 0) ? matchLength - kLzMinMatch : 0;
+	std::uint8_t token      = static_cast<std::uint8_t>(((literalCount < 15) ? literalCount : 15) << 4);
+
+	token |= static_cast<std::uint8_t>((matchCount < 15) ? matchCount : 15);
+	out.push_back(token);
+
+	if (literalCount >= 15)
+	{
+		putLength(out, literalCount - 15);
+	}
+	out.insert(out.end(), literals, literals + literalCount);
+
+	/* The last sequence stops after its literals */
+	if (matchLength == 0)
+	{
+		return;
+	}
+
+	out.push_back(static_cast<std::uint8_t>(offset));
+	out.push_back(static_cast<std::uint8_t>(offset >> 8));
+
+	if (matchCount >= 15)
+	{
+		putLength(out, matchCount - 15);
+	}
+}
+
+/* An extension after a nibble of 15; false when the input ends inside it */
+bool getLength(const std::uint8_t* data, std::size_t size, std::size_t& index, std::size_t& count)
+{
+	std::uint8_t byte;
+
+	do
+	{
+		if (index >= size)
+		{
+			return false;
+		}
+		byte   = data[index++];
+		count += byte;
+	} while (byte == 255);
+
+	return true;
+}
+
+}
+
+std::vector<std::uint8_t> lzCompress(const std::uint8_t* data, std::size_t size)
+{
+	std::vector<std::uint8_t> out;
+	std::vector<std::int32_t> head(std::size_t(1) << kHashBits, -1);
+	std::vector<std::int32_t> previous(size, -1);   /* Earlier position with the same hash */
+	std::size_t               literals = 0;         /* First byte not yet in a sequence */
+	std::size_t               position = 0;
+
+	auto insert = [&](std::size_t at) {
+		std::uint32_t hash = hashAt(&data[at]);
+
+		previous[at] = head[hash];
+		head[hash]   = static_cast<std::int32_t>(at);
+	};
+
+	while (position + kLzMinMatch <= size)
+	{
+		std::size_t best       = 0;
+		std::size_t bestOffset = 0;
+		unsigned    tried      = 0;
+
+		for (std::int32_t candidate = head[hashAt(&data[position])];
+		     candidate >= 0 && position - static_cast<std::size_t>(candidate) <= kLzWindowSize && tried < kMaxChain &&
+		     best < kGoodMatch;
+		     candidate = previous[static_cast<std::size_t>(candidate)], tried++)
+		{
+			std::size_t length = 0;
+
+			while (position + length < size && data[static_cast<std::size_t>(candidate) + length] == data[position + length])
+			{
+				length++;
+			}
+
+			if (length > best)
+			{
+				best       = length;
+				bestOffset = position - static_cast<std::size_t>(candidate);
+			}
+		}
+
+		if (best < kLzMinMatch)
+		{
+			insert(position);
+			position++;
+			continue;
+		}
+
+		putSequence(out, &data[literals], position - literals, bestOffset, best);
+
+		for (std::size_t end = position + best; position < end; position++)
+		{
+			if (position + kLzMinMatch <= size)
+			{
+				insert(position);
+			}
+		}
+		literals = position;
+	}
+
+	putSequence(out, &data[literals], size - literals, 0, 0);
+
+	return out;
+}
+
+std::optional<std::vector<std::uint8_t>> lzDecompress(const std::uint8_t* data, std::size_t size)
+{
+	std::vector<std::uint8_t> out;
+	std::size_t               index = 0;
+
+	while (index < size)
+	{
+		std::uint8_t token    = data[index++];
+		std::size_t  literals = token >> 4;
+		std::size_t  match    = token & 0x0Fu;
+		std::size_t  offset;
+
+		if ((literals == 15 && !getLength(data, size, index, literals)) || size - index < literals)
+		{
+			return std::nullopt;
+		}
+
+		out.insert(out.end(), &data[index], &data[index] + literals);
+		index += literals;
+
+		if (index == size)
+		{
+			break;
+		}
+
+		if (size - index < 2)
+		{
+			return std::nullopt;
+		}
+
+		offset = data[index] | (static_cast<std::size_t>(data[index + 1]) << 8);
+		index += 2;
+
+		if (offset == 0 || offset > kLzWindowSize || offset > out.size() ||
+		    (match == 15 && !getLength(data, size, index, match)))
+		{
+			return std::nullopt;
+		}
+
+		for (std::size_t count = 0; count < match + kLzMinMatch; count++)
+		{
+			out.push_back(out[out.size() - offset]);
+		}
+	}
+
+	return out;
+}
+
+}
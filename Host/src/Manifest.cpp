@@ -0,0 +1,313 @@
+#include "blhost/Manifest.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <sys/stat.h>
+
+#include "blhost/Flasher.hpp"
+
+namespace blhost
+{
+
+namespace
+{
+
+constexpr const char* kMagic = "blhost manifest 1";
+
+/* The pieces of the plan's regions with their bytes, CRCs not computed yet */
+std::vector<ManifestPiece> piecesOf(const Plan& plan, std::vector<const std::uint8_t*>& data)
+{
+	std::vector<ManifestPiece> pieces;
+
+	for (const auto& region : plan.verify)
+	{
+		for (unsigned sector = 0; sector < kFlashSectors.size(); sector++)
+		{
+			std::uint32_t start = std::max(region.address, kFlashSectors[sector].address);
+			std::uint32_t end   = std::min(region.end(), kFlashSectors[sector].address + kFlashSectors[sector].size);
+
+			if (start >= end)
+			{
+				continue;
+			}
+
+			ManifestPiece piece;
+			piece.sector  = sector;
+			piece.address = start;
+			piece.size    = end - start;
+			pieces.push_back(piece);
+			data.push_back(region.data + (start - region.address));
+		}
+	}
+
+	return pieces;
+}
+
+/* CRC over the pieces' address, size and CRC: names the image */
+std::uint32_t imageCrcOf(const std::vector<ManifestPiece>& pieces)
+{
+	std::vector<std::uint8_t> names;
+
+	for (const auto& piece : pieces)
+	{
+		putLe32(names, piece.address);
+		putLe32(names, piece.size);
+		putLe32(names, piece.crc);
+	}
+
+	return crc32(names.data(), names.size(), CrcMode::WordWise);
+}
+
+/* Lines after the magic line; key "source" filled into source, nullopt for a malformed file */
+std::optional<Manifest> readManifest(std::istream& file, std::string* source)
+{
+	std::string line;
+	Manifest    manifest;
+
+	if (!std::getline(file, line) || line != kMagic)
+	{
+		return std::nullopt;
+	}
+
+	while (std::getline(file, line))
+	{
+		std::istringstream fields(line);
+		std::string        key;
+
+		fields >> key >> std::hex;
+
+		if (key == "uid")
+		{
+			fields >> manifest.uniqueId;
+		}
+		else if (key == "source" && source != nullptr)
+		{
+			std::getline(fields >> std::ws, *source);
+		}
+		else if (key == "image")
+		{
+			fields >> manifest.imageCrc;
+		}
+		else if (key == "piece")
+		{
+			ManifestPiece piece;
+			fields >> std::dec >> piece.sector >> std::hex >> piece.address >> std::dec >> piece.size >> std::hex >> piece.crc;
+			manifest.pieces.push_back(piece);
+		}
+
+		if (fields.fail())
+		{
+			return std::nullopt;
+		}
+	}
+
+	return manifest;
+}
+
+/* Written to a temporary file and renamed; header is the line after the magic one */
+void writeManifest(const std::string& target, const std::string& header, const Manifest& manifest)
+{
+	std::string temporary = target + ".tmp";
+
+	{
+		std::ofstream file(temporary, std::ios::trunc);
+		char          line[96];
+
+		file << kMagic << "\n" << header << "\n";
+		std::snprintf(line, sizeof(line), "image %08x\n", manifest.imageCrc);
+		file << line;
+
+		for (const auto& piece : manifest.pieces)
+		{
+			std::snprintf(line, sizeof(line), "piece %u %08x %u %08x\n", piece.sector, piece.address, piece.size, piece.crc);
+			file << line;
+		}
+
+		if (!file.flush())
+		{
+			throw std::runtime_error("cannot write " + temporary);
+		}
+	}
+
+	/* A reader never sees half a manifest */
+	if (std::rename(temporary.c_str(), target.c_str()) != 0)
+	{
+		std::remove(temporary.c_str());
+		throw std::runtime_error("cannot replace " + target);
+	}
+}
+
+/* "size mtime" of a file, empty when it cannot be read */
+std::string stampOf(const std::string& path)
+{
+	struct stat status;
+
+	if (::stat(path.c_str(), &status) != 0)
+	{
+		return std::string();
+	}
+
+	return std::to_string(status.st_size) + " " + std::to_string(status.st_mtim.tv_sec) + "." +
+	       std::to_string(status.st_mtim.tv_nsec);
+}
+
+}
+
+Manifest manifestOf(const Plan& plan, unsigned threads)
+{
+	Manifest                         manifest;
+	std::vector<const std::uint8_t*> data;
+	std::atomic<std::size_t>         next(0);
+
+	manifest.pieces = piecesOf(plan, data);
+
+	auto work = [&]
+	{
+		for (std::size_t index = next++; index < manifest.pieces.size(); index = next++)
+		{
+			manifest.pieces[index].crc = crc32(data[index], manifest.pieces[index].size, CrcMode::WordWise);
+		}
+	};
+
+	if (threads == 0)
+	{
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	threads = static_cast<unsigned>(std::min<std::size_t>(threads, manifest.pieces.size()));
+
+	std::vector<std::thread> workers;
+
+	for (unsigned worker = 1; worker < threads; worker++)
+	{
+		workers.emplace_back(work);
+	}
+	work();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+
+	manifest.imageCrc = imageCrcOf(manifest.pieces);
+
+	return manifest;
+}
+
+Manifest imageManifestOf(const std::string& imagePath, const Plan& plan)
+{
+	std::string                      target = imagePath + ".blmanifest";
+	std::string                      stamp  = stampOf(imagePath);
+	std::string                      source;
+	std::vector<const std::uint8_t*> data;
+	std::ifstream                    file(target);
+	std::optional<Manifest>          cached = readManifest(file, &source);
+
+	/* Same file, and the plan cut it into the same pieces */
+	if (cached && !stamp.empty() && source == stamp)
+	{
+		std::vector<ManifestPiece> pieces = piecesOf(plan, data);
+		bool                       same   = (pieces.size() == cached->pieces.size());
+
+		for (std::size_t index = 0; same && index < pieces.size(); index++)
+		{
+			same = (pieces[index].sector == cached->pieces[index].sector) &&
+			       (pieces[index].address == cached->pieces[index].address) &&
+			       (pieces[index].size == cached->pieces[index].size);
+		}
+
+		if (same && cached->imageCrc == imageCrcOf(cached->pieces))
+		{
+			cached->uniqueId.clear();
+			return *cached;
+		}
+	}
+
+	Manifest manifest = manifestOf(plan);
+
+	if (!stamp.empty())
+	{
+		try
+		{
+			writeManifest(target, "source " + stamp, manifest);
+		}
+		catch (const std::runtime_error&)
+		{
+			/* Read-only image directory: computed again next time */
+		}
+	}
+
+	return manifest;
+}
+
+std::string ManifestCache::path(const std::string& uniqueId) const
+{
+	return directory_ + "/" + uniqueId + ".manifest";
+}
+
+std::optional<Manifest> ManifestCache::load(const std::string& uniqueId) const
+{
+	std::ifstream           file(path(uniqueId));
+	std::optional<Manifest> manifest = readManifest(file, nullptr);
+
+	if (!manifest || manifest->uniqueId != uniqueId)
+	{
+		return std::nullopt;
+	}
+
+	return manifest;
+}
+
+void ManifestCache::store(const Manifest& manifest) const
+{
+	writeManifest(path(manifest.uniqueId), "uid " + manifest.uniqueId, manifest);
+}
+
+std::uint16_t sectorsOf(const Manifest& manifest)
+{
+	std::uint16_t sectors = 0;
+
+	for (const auto& piece : manifest.pieces)
+	{
+		sectors |= static_cast<std::uint16_t>(1u << piece.sector);
+	}
+
+	return sectors;
+}
+
+std::uint16_t findUnchangedSectors(Flasher& flasher, const Manifest& wanted, const std::optional<Manifest>& cached)
+{
+	static const std::vector<ManifestPiece> none;
+
+	const std::vector<ManifestPiece>& known   = cached ? cached->pieces : none;
+	std::uint16_t                     changed = 0;
+
+	for (const auto& piece : wanted.pieces)
+	{
+		bool knownChanged = false;
+
+		/* The cache says the board holds other contents there: no need to ask */
+		for (const auto& old : known)
+		{
+			if (old.address == piece.address && old.size == piece.size)
+			{
+				knownChanged = (old.crc != piece.crc);
+				break;
+			}
+		}
+
+		if (knownChanged || flasher.rangeCrc(piece.address, piece.size) != piece.crc)
+		{
+			changed |= static_cast<std::uint16_t>(1u << piece.sector);
+		}
+	}
+
+	return static_cast<std::uint16_t>(sectorsOf(wanted) & ~changed);
+}
+
+}
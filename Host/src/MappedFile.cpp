@@ -0,0 +1,63 @@
+#include "blhost/MappedFile.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace blhost
+{
+
+MappedFile::MappedFile(const std::string& path)
+{
+	int fd = ::open(path.c_str(), O_RDONLY);
+	struct stat info {};
+
+	if (fd < 0 || ::fstat(fd, &info) != 0)
+	{
+		std::string reason = std::strerror(errno);
+
+		if (fd >= 0)
+		{
+			::close(fd);
+		}
+		throw std::runtime_error("open " + path + ": " + reason);
+	}
+
+	size_ = static_cast<std::size_t>(info.st_size);
+
+	/* An empty file has nothing to map */
+	if (size_ != 0)
+	{
+		void* address = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+
+		if (address == MAP_FAILED)
+		{
+			std::string reason = std::strerror(errno);
+
+			::close(fd);
+			throw std::runtime_error("mmap " + path + ": " + reason);
+		}
+
+		/* Packets are cut front to back */
+		::madvise(address, size_, MADV_SEQUENTIAL);
+		data_ = static_cast<const std::uint8_t*>(address);
+	}
+
+	/* The mapping stays valid without the descriptor */
+	::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+	if (data_ != nullptr)
+	{
+		::munmap(const_cast<std::uint8_t*>(data_), size_);
+	}
+}
+
+}
@@ -0,0 +1,358 @@
+#include "blhost/Package.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "blhost/Lz.hpp"
+#include "blhost/Protocol.hpp"
+#include "blhost/Sha256.hpp"
+
+namespace blhost
+{
+
+namespace
+{
+
+/* BL_IMAGE_BASE_ADDRESS: sectors below it hold the bootloader */
+constexpr unsigned kFirstImageSector = 2;
+
+std::size_t blockCount(std::size_t payloadSize, std::size_t blockSize)
+{
+	return (payloadSize + blockSize - 1) / blockSize;
+}
+
+/* Index of the sector holding address, kFlashSectors.size() outside the flash */
+std::size_t sectorOf(std::uint32_t address)
+{
+	for (std::size_t index = 0; index < kFlashSectors.size(); index++)
+	{
+		if (address >= kFlashSectors[index].address && address - kFlashSectors[index].address < kFlashSectors[index].size)
+		{
+			return index;
+		}
+	}
+
+	return kFlashSectors.size();
+}
+
+/* One DER INTEGER as 32 big-endian bytes; false if it does not fit */
+bool derInteger(const std::vector<std::uint8_t>& der, std::size_t& offset, std::uint8_t* out)
+{
+	if (offset + 2 > der.size() || der[offset] != 0x02)
+	{
+		return false;
+	}
+
+	std::size_t length = der[offset + 1];
+
+	offset += 2;
+	if (length == 0 || length > 33 || offset + length > der.size())
+	{
+		return false;
+	}
+
+	const std::uint8_t* value = &der[offset];
+
+	offset += length;
+	while (length > 32 && *value == 0)
+	{
+		value++;
+		length--;
+	}
+	if (length > 32)
+	{
+		return false;
+	}
+
+	std::fill(out, out + 32 - length, 0);
+	std::copy(value, value + length, out + 32 - length);
+	return true;
+}
+
+}
+
+std::vector<std::uint8_t> makePackage(const Image& image, const PackageOptions& options)
+{
+	if (options.blockSize < kPackageMinBlockSize || options.blockSize > kPackageMaxBlockSize ||
+	    (options.blockSize & (options.blockSize - 1)) != 0)
+	{
+		throw std::invalid_argument("package blocks are a power of two from 256 to 2048 bytes");
+	}
+	if (!options.plan.erase || options.plan.unchangedSectors != 0)
+	{
+		throw std::invalid_argument("a package erases every sector it writes");
+	}
+
+	Plan                      plan = planTransfer(image, options.plan);
+	std::uint32_t             eraseSectors = 0;
+	std::vector<std::uint8_t> table;
+	std::vector<std::uint8_t> payload;
+
+	if (plan.verify.empty() || plan.verify.size() > kPackageMaxSegments)
+	{
+		throw std::invalid_argument("the image needs " + std::to_string(plan.verify.size()) +
+		                            " segments, a package holds 1 to 16 (raise the merge gap)");
+	}
+
+	for (unsigned sector : plan.eraseSectors)
+	{
+		if (sector < kFirstImageSector)
+		{
+			throw std::invalid_argument("the image reaches into the bootloader sectors");
+		}
+		eraseSectors |= 1u << sector;
+	}
+
+	for (const Segment& segment : plan.verify)
+	{
+		std::vector<std::uint8_t> stored;
+		std::uint8_t              codec = kPackageCodecRaw;
+
+		if (options.compress)
+		{
+			stored = lzCompress(segment.data, segment.size);
+			codec  = kPackageCodecLz;
+		}
+		if (!options.compress || stored.size() >= segment.size)
+		{
+			stored.assign(segment.data, segment.data + segment.size);
+			codec = kPackageCodecRaw;
+		}
+
+		putLe32(table, segment.address);
+		putLe32(table, static_cast<std::uint32_t>(segment.size));
+		putLe32(table, static_cast<std::uint32_t>(stored.size()));
+		table.insert(table.end(), { codec, 0, 0, 0 });
+		payload.insert(payload.end(), stored.begin(), stored.end());
+	}
+
+	if (blockCount(payload.size(), options.blockSize) > kPackageMaxBlocks)
+	{
+		throw std::invalid_argument("the payload needs more than 512 blocks of " + std::to_string(options.blockSize) + " bytes");
+	}
+
+	Sha256Digest              digest = Sha256::of(payload.data(), payload.size());
+	std::vector<std::uint8_t> package;
+
+	putLe32(package, kPackageMagic);
+	putLe16(package, kPackageVersion);
+	package.push_back(static_cast<std::uint8_t>(plan.verify.size()));
+	package.push_back(options.sign ? kPackageFlagSigned : 0);
+	putLe32(package, static_cast<std::uint32_t>(options.blockSize));
+	putLe32(package, static_cast<std::uint32_t>(payload.size()));
+	putLe32(package, eraseSectors);
+	putLe32(package, 0);
+	package.insert(package.end(), digest.begin(), digest.end());
+	package.insert(package.end(), table.begin(), table.end());
+
+	for (std::size_t offset = 0; offset < payload.size(); offset += options.blockSize)
+	{
+		putLe32(package, crc32(&payload[offset], std::min(options.blockSize, payload.size() - offset), CrcMode::WordWise));
+	}
+
+	putLe32(package, crc32(package.data(), package.size(), CrcMode::WordWise));
+	if (options.sign)
+	{
+		package.resize(package.size() + kPackageSignatureSize, 0);
+	}
+	package.insert(package.end(), payload.begin(), payload.end());
+
+	/* The device's view of the package must be the image */
+	std::optional<PackageContents> contents = unpackPackage(package);
+
+	if (!contents || contents->segments.size() != plan.verify.size())
+	{
+		throw std::logic_error("the package does not unpack");
+	}
+	for (std::size_t index = 0; index < plan.verify.size(); index++)
+	{
+		const Segment& segment = plan.verify[index];
+
+		if (contents->segments[index].address != segment.address || contents->segments[index].data.size() != segment.size ||
+		    !std::equal(segment.data, segment.data + segment.size, contents->segments[index].data.begin()))
+		{
+			char address[16];
+
+			std::snprintf(address, sizeof(address), "0x%08X", segment.address);
+			throw std::logic_error(std::string("the package does not rebuild the segment at ") + address);
+		}
+	}
+
+	return package;
+}
+
+std::optional<PackageContents> unpackPackage(const std::vector<std::uint8_t>& package)
+{
+	PackageContents contents;
+
+	if (package.size() < kPackageHeaderSize || getLe32(&package[0]) != kPackageMagic ||
+	    (package[4] | (package[5] << 8)) != kPackageVersion)
+	{
+		return std::nullopt;
+	}
+
+	std::size_t               segments    = package[6];
+	std::size_t               payloadSize = getLe32(&package[12]);
+	std::vector<std::uint8_t> digest(&package[24], &package[24] + kSha256DigestSize);
+
+	contents.flags        = package[7];
+	contents.blockSize    = getLe32(&package[8]);
+	contents.eraseSectors = getLe32(&package[16]);
+	contents.payloadSize  = payloadSize;
+
+	if (segments == 0 || segments > kPackageMaxSegments || contents.blockSize < kPackageMinBlockSize ||
+	    contents.blockSize > kPackageMaxBlockSize || (contents.blockSize & (contents.blockSize - 1)) != 0 ||
+	    payloadSize == 0 || blockCount(payloadSize, contents.blockSize) > kPackageMaxBlocks)
+	{
+		return std::nullopt;
+	}
+
+	std::size_t blocks  = blockCount(payloadSize, contents.blockSize);
+	std::size_t trailer = 4 + ((contents.flags & kPackageFlagSigned) ? kPackageSignatureSize : 0);
+
+	contents.manifestSize = kPackageHeaderSize + kPackageSegmentSize * segments + 4 * blocks;
+	if (package.size() != contents.manifestSize + trailer + payloadSize ||
+	    crc32(package.data(), contents.manifestSize, CrcMode::WordWise) != getLe32(&package[contents.manifestSize]))
+	{
+		return std::nullopt;
+	}
+
+	/* The erase plan: no bootloader sector, nothing past the flash */
+	if ((contents.eraseSectors & ((1u << kFirstImageSector) - 1)) != 0 || (contents.eraseSectors >> kFlashSectors.size()) != 0)
+	{
+		return std::nullopt;
+	}
+
+	const std::uint8_t* payload = &package[contents.manifestSize + trailer];
+	const std::uint8_t* crcs    = &package[kPackageHeaderSize + kPackageSegmentSize * segments];
+
+	for (std::size_t index = 0; index < blocks; index++)
+	{
+		std::size_t offset = index * contents.blockSize;
+
+		if (crc32(payload + offset, std::min(contents.blockSize, payloadSize - offset), CrcMode::WordWise) != getLe32(&crcs[4 * index]))
+		{
+			return std::nullopt;
+		}
+	}
+
+	Sha256Digest actual = Sha256::of(payload, payloadSize);
+
+	if (!std::equal(actual.begin(), actual.end(), digest.begin()))
+	{
+		return std::nullopt;
+	}
+
+	std::uint64_t next   = kFlashSectors[kFirstImageSector].address;
+	std::size_t   stored = 0;
+
+	for (std::size_t index = 0; index < segments; index++)
+	{
+		const std::uint8_t* entry  = &package[kPackageHeaderSize + kPackageSegmentSize * index];
+		PackageSegment      segment;
+		std::size_t         length = getLe32(&entry[4]);
+
+		segment.address     = getLe32(&entry[0]);
+		segment.storedBytes = getLe32(&entry[8]);
+		segment.codec       = entry[12];
+
+		if (length == 0 || segment.storedBytes == 0 || segment.storedBytes > payloadSize - stored || segment.address < next ||
+		    sectorOf(segment.address) == kFlashSectors.size() ||
+		    sectorOf(static_cast<std::uint32_t>(segment.address + length - 1)) == kFlashSectors.size() ||
+		    segment.address + static_cast<std::uint64_t>(length) - 1 > 0xFFFFFFFFu)
+		{
+			return std::nullopt;
+		}
+		for (std::size_t sector = sectorOf(segment.address); sector <= sectorOf(static_cast<std::uint32_t>(segment.address + length - 1)); sector++)
+		{
+			if ((contents.eraseSectors & (1u << sector)) == 0)
+			{
+				return std::nullopt;
+			}
+		}
+
+		if (segment.codec == kPackageCodecRaw && segment.storedBytes == length)
+		{
+			segment.data.assign(payload + stored, payload + stored + length);
+		}
+		else if (segment.codec == kPackageCodecLz)
+		{
+			std::optional<std::vector<std::uint8_t>> decoded = lzDecompress(payload + stored, segment.storedBytes);
+
+			if (!decoded || decoded->size() != length)
+			{
+				return std::nullopt;
+			}
+			segment.data = std::move(*decoded);
+		}
+		else
+		{
+			return std::nullopt;
+		}
+
+		next    = static_cast<std::uint64_t>(segment.address) + length;
+		stored += segment.storedBytes;
+		contents.segments.push_back(std::move(segment));
+	}
+
+	if (stored != payloadSize)
+	{
+		return std::nullopt;
+	}
+
+	return contents;
+}
+
+std::vector<std::uint8_t> packageManifest(const std::vector<std::uint8_t>& package)
+{
+	std::optional<PackageContents> contents = unpackPackage(package);
+
+	if (!contents)
+	{
+		throw std::invalid_argument("not a valid update package");
+	}
+
+	return std::vector<std::uint8_t>(package.begin(), package.begin() + static_cast<std::ptrdiff_t>(contents->manifestSize));
+}
+
+std::vector<std::uint8_t> signPackage(const std::vector<std::uint8_t>& package, const std::vector<std::uint8_t>& signature)
+{
+	std::optional<PackageContents> contents = unpackPackage(package);
+
+	if (!contents || !(contents->flags & kPackageFlagSigned))
+	{
+		throw std::invalid_argument("not an update package made for signing");
+	}
+
+	std::vector<std::uint8_t> raw           = rawSignature(signature);
+	std::vector<std::uint8_t> signedPackage = package;
+
+	std::copy(raw.begin(), raw.end(), signedPackage.begin() + static_cast<std::ptrdiff_t>(contents->manifestSize + 4));
+	return signedPackage;
+}
+
+std::vector<std::uint8_t> rawSignature(const std::vector<std::uint8_t>& signature)
+{
+	std::vector<std::uint8_t> raw(kPackageSignatureSize);
+
+	if (signature.size() == kPackageSignatureSize)
+	{
+		return signature;
+	}
+
+	/* SEQUENCE { INTEGER r, INTEGER s }, short-form lengths (at most 72 bytes) */
+	std::size_t offset = 2;
+
+	if (signature.size() < 8 || signature[0] != 0x30 || signature[1] != signature.size() - 2 ||
+	    !derInteger(signature, offset, raw.data()) || !derInteger(signature, offset, raw.data() + 32) || offset != signature.size())
+	{
+		throw std::invalid_argument("the signature is neither DER ECDSA-Sig-Value nor 64 raw bytes");
+	}
+
+	return raw;
+}
+
+}
@@ -0,0 +1,299 @@
+#include "blhost/Planner.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include "blhost/Protocol.hpp"
+
+namespace blhost
+{
+
+namespace
+{
+
+enum class LineKind { Blank, Constant, Data };
+
+struct Line
+{
+	LineKind                    kind;
+	std::array<std::uint8_t, 4> word;
+};
+
+Line classify(const std::uint8_t* line, std::size_t size)
+{
+	Line result { LineKind::Constant, { line[0], line[1], line[2], line[3] } };
+
+	for (std::size_t offset = 4; offset < size; offset += 4)
+	{
+		if (std::memcmp(&line[offset], line, 4) != 0)
+		{
+			result.kind = LineKind::Data;
+			return result;
+		}
+	}
+
+	if (result.word == std::array<std::uint8_t, 4> { 0xFF, 0xFF, 0xFF, 0xFF })
+	{
+		result.kind = LineKind::Blank;
+	}
+
+	return result;
+}
+
+void appendWrite(Plan& plan, const Segment& region, std::uint32_t address, std::size_t size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	plan.writeBytes += size;
+
+	if (!plan.steps.empty() && plan.steps.back().kind == PlanStep::Kind::Write &&
+	    plan.steps.back().address + plan.steps.back().size == address)
+	{
+		plan.steps.back().size += size;
+		return;
+	}
+
+	PlanStep step;
+	step.address = address;
+	step.data    = region.data + (address - region.address);
+	step.size    = size;
+	plan.steps.push_back(step);
+}
+
+/* A finished run of equal lines: dropped, filled or written */
+void closeRun(Plan& plan, const Segment& region, const PlanOptions& options, const Line& kind,
+              std::uint32_t address, std::size_t size)
+{
+	if (kind.kind == LineKind::Blank && size >= options.minSkip)
+	{
+		plan.skippedBytes += size;
+	}
+	else if (kind.kind == LineKind::Constant && size >= options.minFill)
+	{
+		PlanStep step;
+		step.kind    = PlanStep::Kind::Fill;
+		step.address = address;
+		step.size    = size;
+		step.pattern = kind.word;
+		plan.steps.push_back(step);
+		plan.fillBytes += size;
+	}
+	else
+	{
+		appendWrite(plan, region, address, size);
+	}
+}
+
+void cutRegion(Plan& plan, const Segment& region, const PlanOptions& options)
+{
+	const std::uint32_t line         = static_cast<std::uint32_t>(options.lineSize);
+	const std::uint32_t alignedStart = std::min(region.end(), (region.address + line - 1) / line * line);
+	const std::uint32_t alignedEnd   = std::max(alignedStart, region.end() / line * line);
+
+	/* Head of a region that starts inside a line */
+	appendWrite(plan, region, region.address, alignedStart - region.address);
+
+	std::uint32_t runStart = alignedStart;
+	Line          run {};
+
+	for (std::uint32_t address = alignedStart; address < alignedEnd; address += line)
+	{
+		Line current = classify(region.data + (address - region.address), line);
+
+		if (address != runStart && (current.kind != run.kind || current.word != run.word))
+		{
+			closeRun(plan, region, options, run, runStart, address - runStart);
+			runStart = address;
+		}
+		run = current;
+	}
+
+	if (alignedEnd != runStart)
+	{
+		closeRun(plan, region, options, run, runStart, alignedEnd - runStart);
+	}
+
+	/* Tail of a region that ends inside a line */
+	appendWrite(plan, region, alignedEnd, region.end() - alignedEnd);
+}
+
+}
+
+Plan planTransfer(const Image& image, const PlanOptions& options)
+{
+	const std::uint32_t flashStart = kFlashSectors.front().address;
+	const std::uint32_t flashEnd   = kFlashSectors.back().address + kFlashSectors.back().size;
+
+	Plan plan;
+	std::vector<std::vector<Segment>> groups;
+
+	if (options.lineSize < 4 || (options.lineSize % 4) != 0)
+	{
+		throw std::invalid_argument("line size must be a multiple of 4");
+	}
+
+	plan.imageBytes = image.size();
+
+	/* 1. Regions: segments (sorted, not overlapping) closer than mergeGap */
+	for (const auto& segment : image.segments())
+	{
+		if (segment.address < flashStart || segment.end() > flashEnd || segment.end() < segment.address)
+		{
+			char text[64];
+			std::snprintf(text, sizeof(text), "segment at 0x%08X is not in flash", segment.address);
+			throw std::invalid_argument(text);
+		}
+
+		if (!groups.empty() && (segment.address - groups.back().back().end()) <= options.mergeGap)
+		{
+			groups.back().push_back(segment);
+		}
+		else
+		{
+			groups.push_back({ segment });
+		}
+	}
+
+	for (const auto& group : groups)
+	{
+		Segment region { group.front().address, group.front().data, group.back().end() - group.front().address };
+		bool    contiguous = true;
+
+		for (std::size_t index = 1; index < group.size(); index++)
+		{
+			contiguous = contiguous && (group[index].address == group[index - 1].end()) &&
+			             (group[index].data == group[index - 1].data + group[index - 1].size);
+		}
+
+		if (!contiguous)
+		{
+			std::vector<std::uint8_t>& buffer = plan.storage.emplace_back(region.size, 0xFF);
+			std::size_t                loaded = 0;
+
+			for (const auto& segment : group)
+			{
+				std::copy(segment.data, segment.data + segment.size, buffer.begin() + (segment.address - region.address));
+				loaded += segment.size;
+			}
+			plan.bridgedBytes += region.size - loaded;
+			region.data = buffer.data();
+		}
+
+		plan.verify.push_back(region);
+	}
+
+	/* 2. Every sector a region touches */
+	if (options.erase)
+	{
+		for (unsigned sector = 0; sector < kFlashSectors.size(); sector++)
+		{
+			if ((options.unchangedSectors >> sector) & 1u)
+			{
+				continue;
+			}
+
+			std::uint32_t start = kFlashSectors[sector].address;
+			std::uint32_t end   = start + kFlashSectors[sector].size;
+
+			for (const auto& region : plan.verify)
+			{
+				if (region.address < end && region.end() > start)
+				{
+					plan.eraseSectors.push_back(sector);
+					break;
+				}
+			}
+		}
+	}
+
+	/* 3. Line-aligned writes, fills and skips, sector by sector */
+	for (const auto& region : plan.verify)
+	{
+		for (unsigned sector = 0; sector < kFlashSectors.size(); sector++)
+		{
+			std::uint32_t start = std::max(region.address, kFlashSectors[sector].address);
+			std::uint32_t end   = std::min(region.end(), kFlashSectors[sector].address + kFlashSectors[sector].size);
+
+			if (start >= end)
+			{
+				continue;
+			}
+
+			if ((options.unchangedSectors >> sector) & 1u)
+			{
+				plan.unchangedBytes += end - start;
+				continue;
+			}
+
+			/* Sector boundaries are line boundaries: the writes still merge across them */
+			cutRegion(plan, { start, region.data + (start - region.address), end - start }, options);
+		}
+	}
+
+	return plan;
+}
+
+std::string describePlan(const Plan& plan)
+{
+	std::string text;
+	char        line[160];
+	std::size_t eraseBytes = 0;
+
+	auto percent = [&](std::size_t part) { return (plan.imageBytes != 0) ? 100.0 * part / plan.imageBytes : 0.0; };
+
+	for (unsigned sector : plan.eraseSectors)
+	{
+		std::snprintf(line, sizeof(line), "erase   sector %2u  0x%08X  %6u KB\n", sector,
+		              kFlashSectors[sector].address, kFlashSectors[sector].size / 1024u);
+		text += line;
+		eraseBytes += kFlashSectors[sector].size;
+	}
+
+	for (const auto& step : plan.steps)
+	{
+		if (step.kind == PlanStep::Kind::Write)
+		{
+			std::snprintf(line, sizeof(line), "write   0x%08X  %8zu bytes\n", step.address, step.size);
+		}
+		else
+		{
+			std::snprintf(line, sizeof(line), "fill    0x%08X  %8zu bytes  pattern %02X %02X %02X %02X\n", step.address,
+			              step.size, step.pattern[0], step.pattern[1], step.pattern[2], step.pattern[3]);
+		}
+		text += line;
+	}
+
+	for (const auto& region : plan.verify)
+	{
+		std::snprintf(line, sizeof(line), "verify  0x%08X  %8zu bytes  crc 0x%08X\n", region.address, region.size,
+		              crc32(region.data, region.size, CrcMode::WordWise));
+		text += line;
+	}
+
+	std::snprintf(line, sizeof(line),
+	              "image %zu bytes; sent %zu (%.1f %%), filled %zu (%.1f %%), skipped 0xFF %zu (%.1f %%), bridged %zu\n",
+	              plan.imageBytes, plan.writeBytes, percent(plan.writeBytes), plan.fillBytes, percent(plan.fillBytes),
+	              plan.skippedBytes, percent(plan.skippedBytes), plan.bridgedBytes);
+	text += line;
+	if (plan.unchangedBytes != 0)
+	{
+		std::snprintf(line, sizeof(line), "unchanged on the device %zu (%.1f %%)\n", plan.unchangedBytes,
+		              percent(plan.unchangedBytes));
+		text += line;
+	}
+	std::snprintf(line, sizeof(line), "%zu sectors (%zu KB) erased, %zu writes, %zu regions verified\n",
+	              plan.eraseSectors.size(), eraseBytes / 1024u,
+	              static_cast<std::size_t>(std::count_if(plan.steps.begin(), plan.steps.end(),
+	                  [](const PlanStep& step) { return step.kind == PlanStep::Kind::Write; })),
+	              plan.verify.size());
+	text += line;
+
+	return text;
+}
+
+}
@@ -0,0 +1,707 @@
+#include "blhost/Protocol.hpp"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+#if BLHOST_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace blhost
+{
+
+namespace
+{
+
+/*
+ * One word through the CRC unit: polynomial 0x04C11DB7, MSB first. The 32
+ * steps are linear, so they are the XOR of the steps of each byte of
+ * crc ^ word on its own: table n holds the 32 steps of a byte at bits 8n.
+ */
+std::uint32_t crcWord(std::uint32_t crc, std::uint32_t word)
+{
+	static const std::array<std::array<std::uint32_t, 256>, 4> table = []
+	{
+		std::array<std::array<std::uint32_t, 256>, 4> entries{};
+
+		for (unsigned lane = 0; lane < 4; lane++)
+		{
+			for (std::uint32_t index = 0; index < 256; index++)
+			{
+				std::uint32_t value = index << (8 * lane);
+
+				for (int bit = 0; bit < 32; bit++)
+				{
+					value = (value & 0x80000000UL) ? ((value << 1) ^ 0x04C11DB7UL) : (value << 1);
+				}
+
+				entries[lane][index] = value;
+			}
+		}
+
+		return entries;
+	}();
+
+	crc ^= word;
+
+	return table[0][crc & 0xFFu] ^ table[1][(crc >> 8) & 0xFFu] ^ table[2][(crc >> 16) & 0xFFu] ^ table[3][crc >> 24];
+}
+
+/* Standard CRC-32: reflected polynomial 0xEDB88320, initial value and final XOR 0xFFFFFFFF */
+std::uint32_t crcIeee(const std::uint8_t* data, std::size_t length)
+{
+#if BLHOST_HAVE_ZLIB
+	uLong crc = ::crc32(0L, Z_NULL, 0);
+
+	while (length != 0)
+	{
+		uInt piece = static_cast<uInt>(std::min<std::size_t>(length, 1u << 30));
+
+		crc     = ::crc32(crc, data, piece);
+		data   += piece;
+		length -= piece;
+	}
+
+	return static_cast<std::uint32_t>(crc);
+#else
+	static const std::array<std::uint32_t, 256> table = []
+	{
+		std::array<std::uint32_t, 256> entries{};
+
+		for (std::uint32_t index = 0; index < 256; index++)
+		{
+			std::uint32_t value = index;
+
+			for (int bit = 0; bit < 8; bit++)
+			{
+				value = (value >> 1) ^ (0xEDB88320UL & (0u - (value & 1u)));
+			}
+
+			entries[index] = value;
+		}
+
+		return entries;
+	}();
+
+	std::uint32_t crc = 0xFFFFFFFFUL;
+
+	for (std::size_t index = 0; index < length; index++)
+	{
+		crc = (crc >> 8) ^ table[(crc ^ data[index]) & 0xFFu];
+	}
+
+	return ~crc;
+#endif
+}
+
+}
+
+std::uint32_t crc32(const std::uint8_t* data, std::size_t length, CrcMode mode)
+{
+	std::uint32_t crc = 0xFFFFFFFFUL;
+	std::size_t   index = 0;
+
+	if (mode == CrcMode::Ieee)
+	{
+		return crcIeee(data, length);
+	}
+
+	if (mode == CrcMode::WordWise)
+	{
+		for (; (index + 4) <= length; index += 4)
+		{
+			crc = crcWord(crc, getLe32(&data[index]));
+		}
+	}
+
+	for (; index < length; index++)
+	{
+		crc = crcWord(crc, data[index]);
+	}
+
+	return crc;
+}
+
+
+std::vector<std::uint8_t> encodeFrame(std::uint8_t command, const std::uint8_t* payload, std::size_t length, CrcMode mode)
+{
+	std::vector<std::uint8_t> frame;
+	std::size_t follow = 1 + length + 4;
+
+	frame.reserve(3 + follow);
+
+	if (follow <= 0xFF)
+	{
+		frame.push_back(static_cast<std::uint8_t>(follow));
+	}
+	else
+	{
+		frame.push_back(kFrameExtMarker);
+		putLe16(frame, static_cast<std::uint16_t>(follow));
+	}
+
+	frame.push_back(command);
+	frame.insert(frame.end(), payload, payload + length);
+	putLe32(frame, crc32(frame.data(), frame.size(), mode));
+
+	return frame;
+}
+
+std::vector<std::uint8_t> encodeScript(const std::vector<ScriptStep>& steps)
+{
+	std::vector<std::uint8_t> script;
+
+	if (steps.size() > 0xFF)
+	{
+		throw std::invalid_argument("a script holds at most 255 steps");
+	}
+
+	script.push_back(static_cast<std::uint8_t>(steps.size()));
+
+	for (const ScriptStep& step : steps)
+	{
+		/* The device does not check a step's CRC: the script's covers it */
+		std::vector<std::uint8_t> frame = encodeFrame(step.command, step.payload.data(), step.payload.size(), CrcMode::WordWise);
+
+		script.push_back(step.expect);
+		script.insert(script.end(), frame.begin(), frame.end());
+	}
+
+	return script;
+}
+
+std::optional<Capabilities> parseCapabilities(const std::vector<std::uint8_t>& payload)
+{
+	/* Version 1 ends after Features */
+	if (payload.size() < 30)
+	{
+		return std::nullopt;
+	}
+
+	Capabilities caps;
+
+	caps.version           = payload[0];
+	caps.link              = payload[1];
+	caps.codecs            = payload[3];
+	caps.streamAckInterval = payload[5];
+	caps.maxFrame          = getLe16(&payload[8]);
+	caps.maxPayload        = getLe16(&payload[10]);
+	caps.rxBuffer          = getLe16(&payload[12]);
+	caps.maxBaudRate       = getLe32(&payload[22]);
+	caps.features          = getLe32(&payload[26]);
+	if (payload.size() >= 38)
+	{
+		caps.lzDecodeRate = getLe32(&payload[30]);
+		caps.lzWriteRate  = getLe32(&payload[34]);
+	}
+	if (payload.size() >= 42)
+	{
+		caps.vddMv            = getLe16(&payload[38]);
+		caps.flashParallelism = payload[40];
+	}
+
+	return caps;
+}
+
+std::optional<DeviceInfo> parseDeviceInfo(const std::vector<std::uint8_t>& payload)
+{
+	/* Up to CommandCount */
+	if (payload.size() < 30)
+	{
+		return std::nullopt;
+	}
+
+	DeviceInfo info;
+
+	info.version           = payload[0];
+	info.bootloaderVersion = payload[1];
+	info.chipId            = getLe16(&payload[2]);
+	info.rdpLevel          = payload[6];
+	info.writeProtected    = getLe16(&payload[7]);
+	std::copy(&payload[9], &payload[21], info.uniqueId.begin());
+	info.flashSizeKb       = getLe16(&payload[21]);
+	info.features          = getLe32(&payload[25]);
+
+	return info;
+}
+
+std::optional<DeviceStats> parseStats(const std::vector<std::uint8_t>& payload)
+{
+	constexpr std::size_t kHeader = 22;
+	constexpr std::size_t kEntry  = 21;
+
+	if (payload.size() < kHeader || payload[0] != kStatusOk || payload.size() < kHeader + payload[21] * kEntry)
+	{
+		return std::nullopt;
+	}
+
+	DeviceStats stats;
+
+	stats.rxBytes     = getLe32(&payload[1]);
+	stats.txBytes     = getLe32(&payload[5]);
+	stats.crcFailures = getLe32(&payload[9]);
+	stats.uartErrors  = getLe32(&payload[13]);
+	stats.coreClockHz = getLe32(&payload[17]);
+
+	for (std::size_t index = 0; index < payload[21]; index++)
+	{
+		const std::uint8_t* entry = &payload[kHeader + index * kEntry];
+		CommandStats        command;
+
+		command.opcode      = entry[0];
+		command.count       = getLe32(&entry[1]);
+		command.totalCycles = getLe32(&entry[5]) | (static_cast<std::uint64_t>(getLe32(&entry[9])) << 32);
+		command.maxCycles   = getLe32(&entry[13]);
+		command.nacks       = getLe32(&entry[17]);
+		stats.commands.push_back(command);
+	}
+
+	/* Flash timing: [classes] [buckets], then program / erase histogram per class */
+	std::size_t offset = kHeader + payload[21] * kEntry;
+
+	if (payload.size() >= offset + 2 && payload[offset] == kFlashClasses)
+	{
+		std::size_t buckets   = payload[offset + 1];
+		std::size_t histogram = 12 + 4 * buckets;
+
+		if (payload.size() < offset + 2 + 2 * kFlashClasses * histogram)
+		{
+			return std::nullopt;
+		}
+
+		FlashTiming timing;
+		const std::uint8_t* data = &payload[offset + 2];
+
+		auto read = [&](FlashHistogram& out) {
+			out.maxUs   = getLe32(&data[0]);
+			out.totalUs = getLe32(&data[4]);
+			out.units   = getLe32(&data[8]);
+			for (std::size_t bucket = 0; bucket < buckets; bucket++)
+			{
+				out.counts.push_back(getLe32(&data[12 + 4 * bucket]));
+			}
+			data += histogram;
+		};
+
+		for (std::size_t index = 0; index < kFlashClasses; index++)
+		{
+			read(timing.program[index]);
+			read(timing.erase[index]);
+		}
+		stats.flash = timing;
+
+		if (payload.size() >= static_cast<std::size_t>(data - payload.data()) + 28)
+		{
+			UartDiagnostics uart;
+
+			uart.overrun       = getLe32(&data[0]);
+			uart.framing       = getLe32(&data[4]);
+			uart.noise         = getLe32(&data[8]);
+			uart.parity        = getLe32(&data[12]);
+			uart.dma           = getLe32(&data[16]);
+			uart.ringHighWater = getLe32(&data[20]);
+			uart.ringSize      = getLe32(&data[24]);
+			stats.uart = uart;
+			data += 28;
+
+			if (payload.size() >= static_cast<std::size_t>(data - payload.data()) + 16)
+			{
+				MemoryUsage memory;
+
+				memory.stackPeak = getLe32(&data[0]);
+				memory.stackSize = getLe32(&data[4]);
+				memory.heapPeak  = getLe32(&data[8]);
+				memory.heapSize  = getLe32(&data[12]);
+				stats.memory = memory;
+				data += 16;
+
+				if (payload.size() >= static_cast<std::size_t>(data - payload.data()) + 8)
+				{
+					IrqMasking masking;
+
+					masking.maxCycles = getLe32(&data[0]);
+					masking.sections  = getLe32(&data[4]);
+					stats.masking = masking;
+				}
+			}
+		}
+	}
+
+	return stats;
+}
+
+std::uint64_t FlashHistogram::operations() const
+{
+	std::uint64_t total = 0;
+
+	for (std::uint32_t count : counts)
+	{
+		total += count;
+	}
+
+	return total;
+}
+
+std::uint32_t FlashHistogram::percentileUs(double fraction) const
+{
+	std::uint64_t total = operations();
+	std::uint64_t seen  = 0;
+
+	if (total == 0)
+	{
+		return 0;
+	}
+
+	for (std::size_t bucket = 0; bucket < counts.size(); bucket++)
+	{
+		seen += counts[bucket];
+		if (seen >= fraction * total && bucket + 1 < counts.size())
+		{
+			return std::min(maxUs, static_cast<std::uint32_t>((1ull << bucket) - 1));
+		}
+	}
+
+	return maxUs;
+}
+
+std::optional<DeviceTrace> parseTrace(const std::vector<std::uint8_t>& payload)
+{
+	constexpr std::size_t kHeader = 17;
+	constexpr std::size_t kEntry  = 12;
+
+	if (payload.size() < kHeader || payload[0] != kStatusOk || payload.size() < kHeader + getLe16(&payload[11]) * kEntry)
+	{
+		return std::nullopt;
+	}
+
+	DeviceTrace trace;
+
+	trace.head          = getLe32(&payload[1]);
+	trace.depth         = getLe16(&payload[5]);
+	trace.coreClockHz   = getLe32(&payload[7]);
+	trace.firstSequence = getLe32(&payload[13]);
+
+	for (std::size_t index = 0; index < getLe16(&payload[11]); index++)
+	{
+		const std::uint8_t* entry = &payload[kHeader + index * kEntry];
+		TraceEvent          event;
+
+		event.sequence = trace.firstSequence + static_cast<std::uint32_t>(index);
+		event.cycles   = getLe32(&entry[0]);
+		event.event    = getLe16(&entry[4]);
+		event.arg0     = getLe16(&entry[6]);
+		event.arg1     = getLe32(&entry[8]);
+		trace.events.push_back(event);
+	}
+
+	return trace;
+}
+
+std::optional<CrashRecord> parseCrashRecord(const std::vector<std::uint8_t>& payload)
+{
+	constexpr std::size_t kWords      = 53;
+	constexpr std::size_t kStackWords = 32;
+
+	if (payload.size() < 1 + kWords * 4 || payload[0] != kStatusOk)
+	{
+		return std::nullopt;
+	}
+
+	const std::uint8_t* words = &payload[1];
+	CrashRecord         record;
+
+	record.count  = getLe32(&words[4]);
+	record.source = getLe32(&words[8]);
+	record.fault  = getLe32(&words[12]);
+	for (std::size_t index = 0; index < 8; index++)
+	{
+		record.registers[index] = getLe32(&words[16 + index * 4]);
+	}
+	record.excReturn = getLe32(&words[48]);
+	record.cfsr      = getLe32(&words[52]);
+	record.hfsr      = getLe32(&words[56]);
+	record.mmfar     = getLe32(&words[60]);
+	record.bfar      = getLe32(&words[64]);
+	record.cycles    = getLe32(&words[68]);
+	record.sp        = getLe32(&words[72]);
+	for (std::size_t index = 0; index < std::min<std::size_t>(getLe32(&words[76]), kStackWords); index++)
+	{
+		record.stack.push_back(getLe32(&words[80 + index * 4]));
+	}
+
+	return record;
+}
+
+std::optional<AppProfile> parseAppProfile(const std::vector<std::uint8_t>& record)
+{
+	if (record.size() < kAppProfileHeader || getLe32(&record[0]) != kAppProfileMagic)
+	{
+		return std::nullopt;
+	}
+
+	AppProfile    profile;
+	std::uint32_t buckets = getLe32(&record[12]);
+
+	if (buckets > kAppProfileBuckets || record.size() < kAppProfileHeader + buckets * 2 || getLe32(&record[8]) >= 32)
+	{
+		return std::nullopt;
+	}
+
+	profile.base     = getLe32(&record[4]);
+	profile.shift    = getLe32(&record[8]);
+	profile.rateHz   = getLe32(&record[16]);
+	profile.samples  = getLe32(&record[20]);
+	profile.outside  = getLe32(&record[24]);
+	profile.halvings = getLe32(&record[28]);
+	for (std::size_t index = 0; index < buckets; index++)
+	{
+		profile.counts.push_back(getLe16(&record[kAppProfileHeader + index * 2]));
+	}
+
+	return profile;
+}
+
+std::uint32_t SchedLatency::percentileCycles(double fraction) const
+{
+	std::uint64_t total = 0;
+	std::uint64_t seen  = 0;
+
+	for (std::uint16_t count : counts)
+	{
+		total += count;
+	}
+	if (total == 0)
+	{
+		return 0;
+	}
+
+	for (std::size_t bucket = 0; bucket < counts.size(); bucket++)
+	{
+		seen += counts[bucket];
+		if (seen >= fraction * total && bucket + 1 < counts.size())
+		{
+			return std::min(worst, static_cast<std::uint32_t>((1ull << (shift + bucket)) - 1));
+		}
+	}
+
+	return worst;
+}
+
+std::optional<SchedLatency> parseSchedLatency(const std::vector<std::uint8_t>& payload)
+{
+	constexpr std::size_t kHeader = 21;
+
+	if (payload.size() < kHeader || payload[0] != kStatusOk || payload.size() < kHeader + payload[3] * 2u ||
+	    payload[4] >= 32)
+	{
+		return std::nullopt;
+	}
+
+	SchedLatency latency;
+
+	latency.tasks       = payload[1];
+	latency.bits        = payload[2];
+	latency.shift       = payload[4];
+	latency.coreClockHz = getLe32(&payload[5]);
+	latency.total       = getLe32(&payload[9]);
+	latency.worst       = getLe32(&payload[13]);
+	latency.halvings    = getLe32(&payload[17]);
+	for (std::size_t index = 0; index < payload[3]; index++)
+	{
+		latency.counts.push_back(getLe16(&payload[kHeader + index * 2]));
+	}
+
+	return latency;
+}
+
+std::optional<DeviceProgress> parseDeviceProgress(const std::vector<std::uint8_t>& payload)
+{
+	constexpr std::size_t kPayloadSize = 11;   /* BL_PROGRESS_PAYLOAD_SIZE */
+
+	if (payload.size() < kPayloadSize)
+	{
+		return std::nullopt;
+	}
+
+	DeviceProgress progress;
+
+	progress.operation = payload[0];
+	progress.percent   = payload[1];
+	progress.sector    = payload[2];
+	progress.done      = getLe32(&payload[3]);
+	progress.total     = getLe32(&payload[7]);
+
+	return progress;
+}
+
+const char* progressOperationName(std::uint8_t operation)
+{
+	static const char* const names[] = { "?", "erase", "program", "verify" };
+
+	return (operation < sizeof(names) / sizeof(names[0])) ? names[operation] : "?";
+}
+
+std::optional<AppInfo> parseAppInfo(const std::vector<std::uint8_t>& payload)
+{
+	constexpr std::size_t kEntrySize = 25;   /* BL_APP_INFO_ENTRY_SIZE */
+
+	if (payload.size() < 3 || payload[0] != kStatusOk || payload.size() < 3 + payload[1] * kEntrySize)
+	{
+		return std::nullopt;
+	}
+
+	AppInfo info;
+
+	info.activeSlot = payload[2];
+	for (std::size_t index = 0; index < payload[1]; index++)
+	{
+		const std::uint8_t* entry = &payload[3 + index * kEntrySize];
+		SlotInfo            slot;
+
+		slot.state           = entry[0];
+		slot.version         = getLe32(&entry[1]);
+		slot.buildId         = getLe32(&entry[5]);
+		slot.length          = getLe32(&entry[9]);
+		slot.crc             = getLe32(&entry[13]);
+		slot.securityVersion = getLe32(&entry[17]);
+		slot.activation      = getLe32(&entry[21]);
+		info.slots.push_back(slot);
+	}
+
+	return info;
+}
+
+std::optional<SlotState> parseSlotState(const std::vector<std::uint8_t>& payload)
+{
+	if (payload.size() < 6)   /* BL_SLOT_REPLY_SIZE */
+	{
+		return std::nullopt;
+	}
+
+	SlotState state;
+
+	state.status     = payload[0];
+	state.activeSlot = payload[1];
+	state.updateBase = getLe32(&payload[2]);
+
+	return state;
+}
+
+const char* appStateName(std::uint8_t state)
+{
+	static const char* const names[] = { "empty", "no header", "unchecked", "validated", "revoked", "invalid" };
+
+	return (state < sizeof(names) / sizeof(names[0])) ? names[state] : "?";
+}
+
+std::optional<ImageErasePlan> parseImageErasePlan(const std::vector<std::uint8_t>& payload)
+{
+	constexpr std::size_t kHeader = 6;
+
+	if (payload.size() < kHeader)
+	{
+		return std::nullopt;
+	}
+
+	ImageErasePlan plan;
+
+	plan.status     = payload[0];
+	plan.method     = payload[1];
+	plan.estimateMs = getLe32(&payload[2]);
+	plan.results.assign(payload.begin() + kHeader, payload.end());
+
+	return plan;
+}
+
+const char* traceEventName(std::uint16_t event)
+{
+	static const char* const names[] = {
+		"?", "BOOT", "FRAME_RX", "CRC_CHECKED", "DISPATCH", "DISPATCH_END", "TX_QUEUED", "PROGRAM_START",
+		"PROGRAM_END", "ERASE_START", "ERASE_END", "MASS_ERASE", "UART_ERROR", "BAUD_CHANGE",
+		"LINK_LOCKED",
+	};
+
+	return (event < sizeof(names) / sizeof(names[0])) ? names[event] : names[0];
+}
+
+std::string DeviceInfo::uniqueIdHex() const
+{
+	static const char digits[] = "0123456789abcdef";
+	std::string text;
+
+	for (std::uint8_t byte : uniqueId)
+	{
+		text.push_back(digits[byte >> 4]);
+		text.push_back(digits[byte & 0xFu]);
+	}
+
+	return text;
+}
+
+void ResponseParser::feed(const std::uint8_t* data, std::size_t length, std::vector<Response>& out)
+{
+	std::size_t start = 0;
+
+	buffer_.insert(buffer_.end(), data, data + length);
+
+	while (start < buffer_.size())
+	{
+		const std::uint8_t* p    = &buffer_[start];
+		std::size_t         left = buffer_.size() - start;
+
+		if (p[0] == kNack)
+		{
+			out.push_back(Response{});
+			start++;
+			continue;
+		}
+
+		if (p[0] != kAck && p[0] != kProgressMarker)
+		{
+			start++;
+			continue;
+		}
+
+		if (left < 2 || (p[0] == kAck && p[1] == kFrameExtMarker && left < 4))
+		{
+			break;
+		}
+
+		/* Progress frames are always v1 */
+		bool        extended = (p[0] == kAck) && (p[1] == kFrameExtMarker);
+		std::size_t header   = extended ? 4 : 2;
+		std::size_t payload  = extended ? getLe16(&p[2]) : p[1];
+		bool        crc      = responseCrc_ || ((p[0] == kAck) && crcOnce_);
+		std::size_t total   = header + payload + (crc ? 4 : 0);
+
+		if (left < total)
+		{
+			break;
+		}
+
+		if (p[0] == kAck)
+		{
+			crcOnce_ = false;
+		}
+
+		if (crc && crc32(p, header + payload, mode_) != getLe32(&p[header + payload]))
+		{
+			dropped_++;
+		}
+		else
+		{
+			Response response;
+			response.ack      = (p[0] == kAck);
+			response.progress = (p[0] == kProgressMarker);
+			response.payload.assign(p + header, p + header + payload);
+			out.push_back(std::move(response));
+		}
+
+		start += total;
+	}
+
+	buffer_.erase(buffer_.begin(), buffer_.begin() + static_cast<std::ptrdiff_t>(start));
+}
+
+}
@@ -0,0 +1,189 @@
+#include "blhost/Transport.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace blhost
+{
+
+namespace
+{
+
+speed_t toSpeed(unsigned baud)
+{
+	switch (baud)
+	{
+	case 9600:    return B9600;
+	case 19200:   return B19200;
+	case 38400:   return B38400;
+	case 57600:   return B57600;
+	case 115200:  return B115200;
+	case 230400:  return B230400;
+#ifdef B460800
+	case 460800:  return B460800;
+#endif
+#ifdef B921600
+	case 921600:  return B921600;
+#endif
+#ifdef B2000000
+	case 2000000: return B2000000;
+#endif
+	default:
+		throw std::invalid_argument("unsupported baud rate " + std::to_string(baud));
+	}
+}
+
+[[noreturn]] void fail(const std::string& what)
+{
+	throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+}
+
+SerialPort::SerialPort(const std::string& device, unsigned baud, bool flowControl)
+{
+	termios tty {};
+
+	fd_ = ::open(device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd_ < 0)
+	{
+		fail("open " + device);
+	}
+
+	if (::tcgetattr(fd_, &tty) != 0)
+	{
+		::close(fd_);
+		fail("tcgetattr " + device);
+	}
+
+	::cfmakeraw(&tty);
+	tty.c_cflag |= CLOCAL | CREAD;
+	tty.c_cflag &= ~(CSTOPB | PARENB);
+	if (flowControl)
+	{
+		tty.c_cflag |= CRTSCTS;
+	}
+	else
+	{
+		tty.c_cflag &= ~CRTSCTS;
+	}
+	tty.c_cc[VMIN]  = 0;
+	tty.c_cc[VTIME] = 0;
+
+	::cfsetispeed(&tty, toSpeed(baud));
+	::cfsetospeed(&tty, toSpeed(baud));
+
+	if (::tcsetattr(fd_, TCSANOW, &tty) != 0)
+	{
+		::close(fd_);
+		fail("tcsetattr " + device);
+	}
+
+	if (::pipe(wake_) != 0)
+	{
+		::close(fd_);
+		fail("pipe");
+	}
+	::fcntl(wake_[0], F_SETFL, O_NONBLOCK);
+	::fcntl(wake_[1], F_SETFL, O_NONBLOCK);
+
+	flush();
+}
+
+SerialPort::~SerialPort()
+{
+	::close(wake_[0]);
+	::close(wake_[1]);
+	::close(fd_);
+}
+
+std::size_t SerialPort::read(std::uint8_t* buffer, std::size_t capacity)
+{
+	ssize_t count = ::read(fd_, buffer, capacity);
+
+	if (count < 0)
+	{
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+		{
+			return 0;
+		}
+		fail("serial read");
+	}
+
+	return static_cast<std::size_t>(count);
+}
+
+std::size_t SerialPort::write(const std::uint8_t* data, std::size_t length)
+{
+	ssize_t count = ::write(fd_, data, length);
+
+	if (count < 0)
+	{
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+		{
+			return 0;
+		}
+		fail("serial write");
+	}
+
+	return static_cast<std::size_t>(count);
+}
+
+Transport::Ready SerialPort::wait(bool wantWrite, int timeoutMs)
+{
+	pollfd descriptors[2] {};
+	Ready  ready;
+
+	descriptors[0].fd     = fd_;
+	descriptors[0].events = static_cast<short>(POLLIN | (wantWrite ? POLLOUT : 0));
+	descriptors[1].fd     = wake_[0];
+	descriptors[1].events = POLLIN;
+
+	if (::poll(descriptors, 2, timeoutMs) < 0)
+	{
+		if (errno == EINTR)
+		{
+			return ready;
+		}
+		fail("serial poll");
+	}
+
+	if (descriptors[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+	{
+		throw std::runtime_error("serial port closed");
+	}
+
+	if (descriptors[1].revents & POLLIN)
+	{
+		std::uint8_t drain[64];
+		while (::read(wake_[0], drain, sizeof(drain)) > 0)
+		{
+		}
+	}
+
+	ready.readable = (descriptors[0].revents & POLLIN) != 0;
+	ready.writable = (descriptors[0].revents & POLLOUT) != 0;
+
+	return ready;
+}
+
+void SerialPort::wake()
+{
+	const std::uint8_t token = 1;
+
+	/* A full pipe already wakes the poll */
+	(void)::write(wake_[1], &token, 1);
+}
+
+void SerialPort::flush()
+{
+	::tcflush(fd_, TCIOFLUSH);
+}
+
+}
@@ -0,0 +1,499 @@
+#include "blhost/Session.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <stdexcept>
+
+namespace blhost
+{
+
+namespace
+{
+
+constexpr std::uint8_t kSessionMagic[4] = { 'B', 'L', 'S', 'N' };
+constexpr std::uint8_t kSessionVersion  = 1;
+constexpr std::size_t  kHeaderLength    = 12;
+constexpr std::size_t  kEventHeader     = 13;
+constexpr std::size_t  kReplayChunk     = 4096;
+constexpr int          kReplayWaitMs    = 50;
+
+std::uint64_t steadyNs()
+{
+	return static_cast<std::uint64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+double wireMs(std::size_t bytes, unsigned baud)
+{
+	/* 8N1: 10 bits per byte */
+	return (baud != 0) ? (bytes * 10.0 * 1000.0) / baud : 0.0;
+}
+
+/* Request frames as the host sent them: command, stream sequence number, time of the last byte */
+struct SentRequest
+{
+	std::uint8_t  command  = 0;
+	std::uint16_t sequence = 0;
+	std::uint64_t endNs    = 0;
+};
+
+/* true when stream packet sequence precedes next (16-bit wrap) */
+bool before(std::uint16_t sequence, std::uint16_t next)
+{
+	return static_cast<std::uint16_t>(next - sequence - 1u) < 0x8000u;
+}
+
+}
+
+void SessionLog::save(const std::string& path) const
+{
+	std::vector<std::uint8_t> out(kSessionMagic, kSessionMagic + 4);
+	std::ofstream             file(path, std::ios::binary | std::ios::trunc);
+
+	out.push_back(kSessionVersion);
+	out.push_back(static_cast<std::uint8_t>(crc));
+	out.push_back(responseCrc ? 1 : 0);
+	out.push_back(0);
+	putLe32(out, baud);
+
+	for (const SessionEvent& event : events)
+	{
+		out.push_back(static_cast<std::uint8_t>(event.direction));
+		putLe32(out, static_cast<std::uint32_t>(event.timeNs));
+		putLe32(out, static_cast<std::uint32_t>(event.timeNs >> 32));
+		putLe32(out, static_cast<std::uint32_t>(event.data.size()));
+		out.insert(out.end(), event.data.begin(), event.data.end());
+	}
+
+	file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+	if (!file.flush())
+	{
+		throw std::runtime_error("cannot write session " + path);
+	}
+}
+
+SessionLog SessionLog::load(const std::string& path)
+{
+	std::ifstream             file(path, std::ios::binary);
+	std::vector<std::uint8_t> in((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	SessionLog                log;
+	std::size_t               offset = kHeaderLength;
+
+	if (!file.good() && !file.eof())
+	{
+		throw std::runtime_error("cannot read session " + path);
+	}
+	if (in.size() < kHeaderLength || !std::equal(kSessionMagic, kSessionMagic + 4, in.begin()) || in[4] != kSessionVersion ||
+	    in[5] > static_cast<std::uint8_t>(CrcMode::Ieee))
+	{
+		throw std::runtime_error(path + ": not a recorded session");
+	}
+
+	log.crc         = static_cast<CrcMode>(in[5]);
+	log.responseCrc = in[6] != 0;
+	log.baud        = getLe32(&in[8]);
+
+	while (offset < in.size())
+	{
+		SessionEvent event;
+		std::size_t  length;
+
+		if (in.size() - offset < kEventHeader || in[offset] > static_cast<std::uint8_t>(SessionDirection::Received))
+		{
+			throw std::runtime_error(path + ": truncated or corrupt session");
+		}
+
+		event.direction = static_cast<SessionDirection>(in[offset]);
+		event.timeNs    = getLe32(&in[offset + 1]) | (static_cast<std::uint64_t>(getLe32(&in[offset + 5])) << 32);
+		length          = getLe32(&in[offset + 9]);
+		offset         += kEventHeader;
+
+		if (in.size() - offset < length)
+		{
+			throw std::runtime_error(path + ": truncated or corrupt session");
+		}
+
+		event.data.assign(in.begin() + static_cast<std::ptrdiff_t>(offset), in.begin() + static_cast<std::ptrdiff_t>(offset + length));
+		offset += length;
+		log.events.push_back(std::move(event));
+	}
+
+	return log;
+}
+
+RecordingTransport::RecordingTransport(Transport& transport, SessionLog& log, SessionClock clock)
+	: transport_(transport), log_(log), clock_(clock ? std::move(clock) : SessionClock(steadyNs))
+{
+	start_ = clock_();
+}
+
+std::size_t RecordingTransport::read(std::uint8_t* buffer, std::size_t capacity)
+{
+	std::size_t count = transport_.read(buffer, capacity);
+
+	add(SessionDirection::Received, buffer, count);
+
+	return count;
+}
+
+std::size_t RecordingTransport::write(const std::uint8_t* data, std::size_t length)
+{
+	std::size_t count = transport_.write(data, length);
+
+	add(SessionDirection::Sent, data, count);
+
+	return count;
+}
+
+Transport::Ready RecordingTransport::wait(bool wantWrite, int timeoutMs)
+{
+	return transport_.wait(wantWrite, timeoutMs);
+}
+
+void RecordingTransport::wake()
+{
+	transport_.wake();
+}
+
+void RecordingTransport::add(SessionDirection direction, const std::uint8_t* data, std::size_t length)
+{
+	if (length == 0)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	SessionEvent                event;
+
+	event.direction = direction;
+	event.timeNs    = clock_() - start_;
+	event.data.assign(data, data + length);
+	log_.events.push_back(std::move(event));
+}
+
+SessionLog replaySession(const SessionLog& recorded, Transport& transport, const ReplayOptions& options)
+{
+	SessionLog         log;
+	RecordingTransport link(transport, log, options.clock);
+	auto               start    = std::chrono::steady_clock::now();
+	std::size_t        received = 0;
+	std::size_t        expected = 0;   /* Device bytes the recording had by now */
+	std::uint8_t       buffer[kReplayChunk];
+
+	log.baud        = recorded.baud;
+	log.crc         = recorded.crc;
+	log.responseCrc = recorded.responseCrc;
+
+	auto drain = [&]() {
+		std::size_t count;
+
+		while ((count = link.read(buffer, sizeof(buffer))) != 0)
+		{
+			received += count;
+		}
+	};
+
+	/* Lockstep: until the device has sent what it had at this point of the recording, or the timeout */
+	auto catchUp = [&]() {
+		auto deadline = std::chrono::steady_clock::now() + options.timeout;
+
+		drain();
+		while (received < expected && std::chrono::steady_clock::now() < deadline)
+		{
+			link.wait(false, kReplayWaitMs);
+			drain();
+		}
+	};
+
+	for (const SessionEvent& event : recorded.events)
+	{
+		if (event.direction == SessionDirection::Received)
+		{
+			expected += event.data.size();
+			continue;
+		}
+
+		if (options.lockstep)
+		{
+			catchUp();
+		}
+		else
+		{
+			auto due = start + std::chrono::nanoseconds(static_cast<std::int64_t>(event.timeNs / options.speed));
+
+			for (auto now = std::chrono::steady_clock::now(); now < due; now = std::chrono::steady_clock::now())
+			{
+				auto left = std::chrono::duration_cast<std::chrono::milliseconds>(due - now).count();
+
+				link.wait(false, static_cast<int>(std::min<long long>(left, kReplayWaitMs)));
+				drain();
+			}
+		}
+
+		for (std::size_t sent = 0; sent < event.data.size();)
+		{
+			std::size_t count = link.write(&event.data[sent], event.data.size() - sent);
+
+			sent += count;
+			if (count == 0)
+			{
+				link.wait(true, kReplayWaitMs);
+			}
+			drain();
+		}
+	}
+
+	/* The replies to the last requests */
+	catchUp();
+
+	return log;
+}
+
+SessionReport analyzeSession(const SessionLog& log)
+{
+	SessionReport                         report;
+	ResponseParser                        parser(log.crc, log.responseCrc);
+	std::map<std::uint8_t, OpcodeLatency> opcodes;
+	std::deque<SentRequest>               outstanding;
+	std::vector<std::uint8_t>             frame;
+	std::size_t                           frameLength = 0;   /* 0: not known yet */
+	std::uint64_t                         busySince   = 0;
+	std::uint64_t                         lastNs      = 0;
+	std::optional<DeviceStats>            firstStats;
+	std::optional<DeviceStats>            lastStats;
+	std::vector<Response>                 replies;
+
+	auto requestDone = [&](std::uint64_t timeNs) {
+		SentRequest request;
+		std::size_t header = (frame[0] == kFrameExtMarker) ? 3 : 1;
+
+		request.command = frame[header];
+		request.endNs   = timeNs;
+		if (request.command == cmd::MemWriteStream && frame.size() >= header + 3)
+		{
+			request.sequence = getLe16(&frame[header + 1]);
+		}
+		if (request.command == cmd::ReadMulti)
+		{
+			parser.expectCrc();
+		}
+
+		opcodes[request.command].opcode = request.command;
+		opcodes[request.command].requests++;
+		if (outstanding.empty())
+		{
+			busySince = timeNs;
+		}
+		outstanding.push_back(request);
+	};
+
+	auto replyDone = [&](const Response& reply, std::uint64_t timeNs) {
+		if (outstanding.empty())
+		{
+			return;
+		}
+
+		SentRequest answered = outstanding.front();
+		std::size_t popped   = 0;
+
+		/* A stream reply acknowledges every packet before its next sequence; a refusal ends those in flight */
+		if (answered.command == cmd::MemWriteStream && reply.ack && reply.payload.size() >= 3)
+		{
+			std::uint16_t next = getLe16(&reply.payload[1]);
+
+			while (!outstanding.empty() && outstanding.front().command == cmd::MemWriteStream &&
+			       (reply.payload[0] != stream::Ack || before(outstanding.front().sequence, next)))
+			{
+				answered = outstanding.front();
+				outstanding.pop_front();
+				popped++;
+			}
+		}
+		else if (answered.command == cmd::Sink)
+		{
+			while (!outstanding.empty() && outstanding.front().command == cmd::Sink)
+			{
+				answered = outstanding.front();
+				outstanding.pop_front();
+				popped++;
+			}
+		}
+
+		if (popped == 0)
+		{
+			outstanding.pop_front();
+		}
+
+		OpcodeLatency& entry = opcodes[answered.command];
+		double         ms    = (timeNs - answered.endNs) / 1e6;
+
+		entry.replies++;
+		entry.nacks   += reply.ack ? 0 : 1;
+		entry.totalMs += ms;
+		entry.maxMs    = std::max(entry.maxMs, ms);
+
+		if (answered.command == cmd::GetStats && reply.ack)
+		{
+			std::optional<DeviceStats> stats = parseStats(reply.payload);
+
+			if (stats)
+			{
+				report.statsSnapshots++;
+				if (!firstStats)
+				{
+					firstStats = stats;
+				}
+				else
+				{
+					lastStats = stats;
+				}
+			}
+		}
+
+		if (outstanding.empty())
+		{
+			report.waitingMs += (timeNs - busySince) / 1e6;
+		}
+	};
+
+	if (log.events.empty())
+	{
+		return report;
+	}
+
+	for (const SessionEvent& event : log.events)
+	{
+		lastNs = event.timeNs;
+
+		if (event.direction == SessionDirection::Received)
+		{
+			report.receivedBytes += event.data.size();
+			parser.feed(event.data.data(), event.data.size(), replies);
+			for (const Response& reply : replies)
+			{
+				if (!reply.progress)
+				{
+					replyDone(reply, event.timeNs);
+				}
+			}
+			replies.clear();
+			continue;
+		}
+
+		report.sentBytes += event.data.size();
+		for (std::uint8_t byte : event.data)
+		{
+			frame.push_back(byte);
+
+			if (frame.size() == 1 && byte != kFrameExtMarker)
+			{
+				frameLength = 1u + byte;
+			}
+			else if (frame.size() == 3 && frame[0] == kFrameExtMarker)
+			{
+				frameLength = 3u + getLe16(&frame[1]);
+			}
+
+			if (frameLength != 0 && frame.size() == frameLength)
+			{
+				requestDone(event.timeNs);
+				frame.clear();
+				frameLength = 0;
+			}
+		}
+	}
+
+	if (!outstanding.empty())
+	{
+		report.waitingMs += (lastNs - busySince) / 1e6;
+	}
+
+	report.durationMs     = (lastNs - log.events.front().timeNs) / 1e6;
+	report.wireSentMs     = wireMs(report.sentBytes, log.baud);
+	report.wireReceivedMs = wireMs(report.receivedBytes, log.baud);
+	report.hostMs         = std::max(0.0, report.durationMs - report.waitingMs);
+	report.unanswered     = outstanding.size();
+	report.droppedReplies = parser.droppedReplies();
+
+	/* Device time of the same commands between the first and the last snapshot */
+	if (firstStats && lastStats && lastStats->coreClockHz != 0)
+	{
+		report.crcFailures = lastStats->crcFailures - firstStats->crcFailures;
+		report.uartErrors  = lastStats->uartErrors - firstStats->uartErrors;
+
+		for (const CommandStats& last : lastStats->commands)
+		{
+			std::uint64_t cycles = last.totalCycles;
+
+			for (const CommandStats& first : firstStats->commands)
+			{
+				if (first.opcode == last.opcode)
+				{
+					cycles = (last.totalCycles >= first.totalCycles) ? last.totalCycles - first.totalCycles : 0;
+				}
+			}
+
+			auto entry = opcodes.find(last.opcode);
+			if (entry != opcodes.end())
+			{
+				entry->second.deviceMs = cycles * 1000.0 / lastStats->coreClockHz;
+			}
+		}
+	}
+
+	for (const auto& entry : opcodes)
+	{
+		report.opcodes.push_back(entry.second);
+	}
+
+	return report;
+}
+
+std::string describeSession(const SessionReport& report)
+{
+	std::string out;
+	char        line[160];
+	double      duration = (report.durationMs > 0.0) ? report.durationMs : 1.0;
+
+	std::snprintf(line, sizeof(line), "session %.1f ms: sent %zu bytes (%.1f ms on the wire), received %zu bytes (%.1f ms)\n",
+	              report.durationMs, report.sentBytes, report.wireSentMs, report.receivedBytes, report.wireReceivedMs);
+	out += line;
+	std::snprintf(line, sizeof(line), "waiting for the device %.1f ms (%.1f %%), host with nothing outstanding %.1f ms (%.1f %%)\n",
+	              report.waitingMs, 100.0 * report.waitingMs / duration, report.hostMs, 100.0 * report.hostMs / duration);
+	out += line;
+	if (report.unanswered != 0 || report.droppedReplies != 0)
+	{
+		std::snprintf(line, sizeof(line), "%zu requests unanswered, %zu replies failing their CRC\n", report.unanswered,
+		              report.droppedReplies);
+		out += line;
+	}
+	if (report.statsSnapshots >= 2)
+	{
+		std::snprintf(line, sizeof(line), "device between %u stats snapshots: %u CRC failures, %u UART errors\n",
+		              report.statsSnapshots, report.crcFailures, report.uartErrors);
+		out += line;
+	}
+
+	out += "opcode requests replies  nacks    mean_ms     max_ms  device_ms\n";
+	for (const OpcodeLatency& entry : report.opcodes)
+	{
+		char device[16] = "-";
+
+		if (entry.deviceMs >= 0.0)
+		{
+			std::snprintf(device, sizeof(device), "%.2f", entry.deviceMs);
+		}
+		std::snprintf(line, sizeof(line), "  0x%02X %8u %7u %6u %10.2f %10.2f %10s\n", entry.opcode, entry.requests, entry.replies,
+		              entry.nacks, entry.replies ? entry.totalMs / entry.replies : 0.0, entry.maxMs, device);
+		out += line;
+	}
+
+	return out;
+}
+
+}
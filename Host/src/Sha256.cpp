@@ -0,0 +1,134 @@
+#include "blhost/Sha256.hpp"
+
+#include <algorithm>
+
+namespace blhost
+{
+
+namespace
+{
+
+constexpr std::uint32_t kRoundConstants[64] = {
+	0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+	0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+	0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+	0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+	0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+	0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+	0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+	0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+std::uint32_t rotr(std::uint32_t value, unsigned bits)
+{
+	return (value >> bits) | (value << (32 - bits));
+}
+
+}
+
+Sha256::Sha256() : state_ { 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 }
+{
+}
+
+void Sha256::compress(const std::uint8_t* block)
+{
+	std::uint32_t words[64];
+	std::uint32_t v[8];
+
+	for (std::size_t index = 0; index < 16; index++)
+	{
+		words[index] = (static_cast<std::uint32_t>(block[4 * index]) << 24) | (static_cast<std::uint32_t>(block[4 * index + 1]) << 16) |
+		               (static_cast<std::uint32_t>(block[4 * index + 2]) << 8) | block[4 * index + 3];
+	}
+	for (std::size_t index = 16; index < 64; index++)
+	{
+		std::uint32_t s0 = rotr(words[index - 15], 7) ^ rotr(words[index - 15], 18) ^ (words[index - 15] >> 3);
+		std::uint32_t s1 = rotr(words[index - 2], 17) ^ rotr(words[index - 2], 19) ^ (words[index - 2] >> 10);
+
+		words[index] = words[index - 16] + s0 + words[index - 7] + s1;
+	}
+
+	std::copy(state_.begin(), state_.end(), v);
+
+	for (std::size_t index = 0; index < 64; index++)
+	{
+		std::uint32_t t1 = v[7] + (rotr(v[4], 6) ^ rotr(v[4], 11) ^ rotr(v[4], 25)) + ((v[4] & v[5]) ^ (~v[4] & v[6])) +
+		                   kRoundConstants[index] + words[index];
+		std::uint32_t t2 = (rotr(v[0], 2) ^ rotr(v[0], 13) ^ rotr(v[0], 22)) + ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+
+		v[7] = v[6];
+		v[6] = v[5];
+		v[5] = v[4];
+		v[4] = v[3] + t1;
+		v[3] = v[2];
+		v[2] = v[1];
+		v[1] = v[0];
+		v[0] = t1 + t2;
+	}
+
+	for (std::size_t index = 0; index < 8; index++)
+	{
+		state_[index] += v[index];
+	}
+}
+
+void Sha256::update(const std::uint8_t* data, std::size_t size)
+{
+	length_ += size;
+
+	while (size != 0)
+	{
+		std::size_t chunk = std::min(size, block_.size() - held_);
+
+		std::copy(data, data + chunk, block_.begin() + static_cast<std::ptrdiff_t>(held_));
+		held_ += chunk;
+		data  += chunk;
+		size  -= chunk;
+
+		if (held_ == block_.size())
+		{
+			compress(block_.data());
+			held_ = 0;
+		}
+	}
+}
+
+Sha256Digest Sha256::finish()
+{
+	std::uint64_t bits = length_ * 8;
+	std::uint8_t  pad  = 0x80;
+	Sha256Digest  digest;
+
+	update(&pad, 1);
+	pad = 0;
+	while (held_ != 56)
+	{
+		update(&pad, 1);
+	}
+	for (int shift = 56; shift >= 0; shift -= 8)
+	{
+		std::uint8_t byte = static_cast<std::uint8_t>(bits >> shift);
+
+		update(&byte, 1);
+	}
+
+	for (std::size_t index = 0; index < 8; index++)
+	{
+		digest[4 * index]     = static_cast<std::uint8_t>(state_[index] >> 24);
+		digest[4 * index + 1] = static_cast<std::uint8_t>(state_[index] >> 16);
+		digest[4 * index + 2] = static_cast<std::uint8_t>(state_[index] >> 8);
+		digest[4 * index + 3] = static_cast<std::uint8_t>(state_[index]);
+	}
+
+	return digest;
+}
+
+Sha256Digest Sha256::of(const std::uint8_t* data, std::size_t size)
+{
+	Sha256 sha;
+
+	sha.update(data, size);
+	return sha.finish();
+}
+
+}
@@ -0,0 +1,86 @@
+#include "blhost/Simulator.hpp"
+
+#include <stdexcept>
+
+#include "BL_Sim.h"
+
+namespace blhost
+{
+
+SimulatedDevice::SimulatedDevice(const SimOptions& options)
+{
+	BL_SimConfig_t config;
+
+	BL_voidSimDefaultConfig(&config);
+	config.BaudRate     = options.baud;
+	config.ProgramNs    = options.programNs;
+	config.Erase16KbUs  = options.erase16KbUs;
+	config.Erase64KbUs  = options.erase64KbUs;
+	config.Erase128KbUs = options.erase128KbUs;
+	config.MassEraseUs  = options.massEraseUs;
+
+	if (BL_uint8SimStart(&config) != 0)
+	{
+		throw std::runtime_error("simulated device: cannot map the F407 memory or start the core");
+	}
+}
+
+SimulatedDevice::~SimulatedDevice()
+{
+	BL_voidSimStop();
+}
+
+std::size_t SimulatedDevice::read(std::uint8_t* buffer, std::size_t capacity)
+{
+	return BL_uint32SimHostRead(buffer, static_cast<std::uint32_t>(capacity));
+}
+
+std::size_t SimulatedDevice::write(const std::uint8_t* data, std::size_t length)
+{
+	if (!stats().running)
+	{
+		throw std::runtime_error("simulated device: the bootloader has left");
+	}
+
+	return BL_uint32SimHostWrite(data, static_cast<std::uint32_t>(length));
+}
+
+Transport::Ready SimulatedDevice::wait(bool wantWrite, int timeoutMs)
+{
+	Ready ready;
+
+	/* The RX queue only fills when the core stops reading: always writable, reads polled */
+	ready.writable = wantWrite;
+	ready.readable = BL_uint8SimHostWait(wantWrite ? 0 : timeoutMs) != 0;
+
+	return ready;
+}
+
+void SimulatedDevice::wake()
+{
+	BL_voidSimHostWake();
+}
+
+std::uint8_t* SimulatedDevice::memory(std::uint32_t address)
+{
+	return BL_puint8SimMemory(address);
+}
+
+SimStats SimulatedDevice::stats() const
+{
+	BL_SimStats_t raw;
+	SimStats      stats;
+
+	BL_voidSimGetStats(&raw);
+	stats.nowNs        = raw.NowNs;
+	stats.flashBusyNs  = raw.FlashBusyNs;
+	stats.rxBytes      = raw.RxBytes;
+	stats.txBytes      = raw.TxBytes;
+	stats.programOps   = raw.ProgramOps;
+	stats.sectorErases = raw.SectorErases;
+	stats.running      = raw.Running != 0;
+
+	return stats;
+}
+
+}
@@ -0,0 +1,166 @@
+#include "blhost/Swo.hpp"
+
+namespace blhost
+{
+
+namespace
+{
+
+constexpr std::uint8_t kSyncEnd        = 0x80;   /* After at least 47 zero bits */
+constexpr std::uint8_t kOverflow       = 0x70;
+constexpr std::uint8_t kContinuation   = 0x80;
+constexpr unsigned     kSyncZeroBytes  = 5;
+
+/* Instrumentation / hardware source payload size from bits [1:0]: 1, 2, 4 */
+constexpr std::uint8_t kPayloadSize[4] = { 0, 1, 2, 4 };
+
+}
+
+void SwoDecoder::feed(const std::uint8_t* data, std::size_t length, std::vector<SwoPacket>& out)
+{
+	for (std::size_t index = 0; index < length; index++)
+	{
+		std::uint8_t byte = data[index];
+
+		if (state_ == State::Payload)
+		{
+			packet_.value |= static_cast<std::uint32_t>(byte) << (8 * have_);
+			if (++have_ == need_)
+			{
+				out.push_back(packet_);
+				state_ = State::Header;
+			}
+			continue;
+		}
+
+		if (state_ == State::Continuation)
+		{
+			if (have_ < 5)
+			{
+				packet_.value |= static_cast<std::uint32_t>(byte & 0x7Fu) << (7 * have_);
+			}
+			have_++;
+			if ((byte & kContinuation) == 0)
+			{
+				out.push_back(packet_);
+				state_ = State::Header;
+			}
+			continue;
+		}
+
+		/* Synchronisation: a run of zero bytes closed by 0x80 */
+		if (byte == 0x00)
+		{
+			zeros_++;
+			continue;
+		}
+		if (zeros_ != 0)
+		{
+			bool sync = (zeros_ >= kSyncZeroBytes) && (byte == kSyncEnd);
+
+			zeros_ = 0;
+			if (sync)
+			{
+				packet_ = SwoPacket();
+				out.push_back(packet_);
+				continue;
+			}
+		}
+
+		packet_ = SwoPacket();
+		have_   = 0;
+
+		if (byte == kOverflow)
+		{
+			packet_.kind = SwoPacket::Kind::Overflow;
+			out.push_back(packet_);
+		}
+		else if ((byte & 0x03u) != 0)
+		{
+			/* Source packet: [port / id (5)] [hardware] [size (2)] */
+			packet_.kind   = ((byte & 0x04u) != 0) ? SwoPacket::Kind::Hardware : SwoPacket::Kind::Instrumentation;
+			packet_.source = static_cast<std::uint8_t>(byte >> 3);
+			packet_.size   = kPayloadSize[byte & 0x03u];
+			need_          = packet_.size;
+			state_         = State::Payload;
+		}
+		else if ((byte & 0x0Fu) == 0)
+		{
+			/* Local timestamp: 0TTT0000 is the value itself, 11TT0000 has continuation bytes */
+			packet_.kind = SwoPacket::Kind::LocalTimestamp;
+			if ((byte & kContinuation) == 0)
+			{
+				packet_.value = (byte >> 4) & 0x7u;
+				out.push_back(packet_);
+			}
+			else
+			{
+				state_ = State::Continuation;
+			}
+		}
+		else if (byte == 0x94 || byte == 0xB4)
+		{
+			packet_.kind = SwoPacket::Kind::GlobalTimestamp;
+			state_       = State::Continuation;
+		}
+		else if ((byte & 0x0Bu) == 0x08u)
+		{
+			packet_.kind  = SwoPacket::Kind::Extension;
+			packet_.value = (byte >> 4) & 0x7u;
+			if ((byte & kContinuation) == 0)
+			{
+				out.push_back(packet_);
+			}
+			else
+			{
+				state_ = State::Continuation;
+			}
+		}
+		else
+		{
+			/* Reserved header: out of step, until the next one that decodes */
+			skipped_++;
+		}
+	}
+}
+
+std::optional<TraceEvent> TraceAssembler::add(const SwoPacket& packet)
+{
+	if (packet.kind != SwoPacket::Kind::Instrumentation || packet.size != 4 || packet.source < 1 || packet.source > 3)
+	{
+		return std::nullopt;
+	}
+
+	/* Port 1 starts an event, ports 2 and 3 must follow in order */
+	if (packet.source == 1)
+	{
+		dropped_      += (stage_ != 0) ? 1 : 0;
+		event_         = TraceEvent();
+		event_.cycles  = packet.value;
+		stage_         = 1;
+		return std::nullopt;
+	}
+
+	if (packet.source != stage_ + 1)
+	{
+		dropped_ += (stage_ != 0) ? 1 : 0;
+		stage_    = 0;
+		return std::nullopt;
+	}
+
+	if (packet.source == 2)
+	{
+		event_.event = static_cast<std::uint16_t>(packet.value >> 16);
+		event_.arg0  = static_cast<std::uint16_t>(packet.value & 0xFFFFu);
+		stage_       = 2;
+		return std::nullopt;
+	}
+
+	event_.arg1     = packet.value;
+	event_.sequence = sequence_++;
+	stage_          = 0;
+
+	return event_;
+}
+
+}
@@ -0,0 +1,109 @@
+#include "blhost/Symbols.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "blhost/MappedFile.hpp"
+#include "blhost/Protocol.hpp"
+
+namespace blhost
+{
+
+namespace
+{
+
+constexpr std::uint32_t kElfSectionSymbols = 2u;   /* SHT_SYMTAB */
+constexpr std::uint8_t  kElfSymbolFunction = 2u;   /* STT_FUNC */
+constexpr std::size_t   kElfSymbolEntry    = 16u;
+
+}
+
+SymbolTable SymbolTable::load(const std::string& path)
+{
+	MappedFile          file(path);
+	const std::uint8_t* data = file.data();
+	std::size_t         size = file.size();
+	SymbolTable         table;
+
+	if (size < 52 || std::memcmp(data, "\x7F" "ELF", 4) != 0 || data[4] != 1 || data[5] != 1)
+	{
+		throw std::runtime_error(path + ": not a 32-bit little-endian ELF file");
+	}
+
+	std::uint32_t sections     = getLe32(&data[32]);
+	std::uint16_t sectionEntry = getLe16(&data[46]);
+	std::uint16_t sectionCount = getLe16(&data[48]);
+
+	if (sectionCount == 0 || sectionEntry < 40 || sections > size || (std::size_t(sectionEntry) * sectionCount) > (size - sections))
+	{
+		throw std::runtime_error(path + ": no section headers");
+	}
+
+	auto section = [&](std::uint32_t index) { return &data[sections + std::size_t(index) * sectionEntry]; };
+
+	for (std::uint16_t index = 0; index < sectionCount; index++)
+	{
+		const std::uint8_t* symbols = section(index);
+
+		if (getLe32(&symbols[4]) != kElfSectionSymbols || getLe32(&symbols[24]) >= sectionCount)
+		{
+			continue;
+		}
+
+		const std::uint8_t* strings      = section(getLe32(&symbols[24]));
+		std::uint32_t       offset       = getLe32(&symbols[16]);
+		std::uint32_t       length       = getLe32(&symbols[20]);
+		std::uint32_t       stringOffset = getLe32(&strings[16]);
+		std::uint32_t       stringLength = getLe32(&strings[20]);
+
+		if (offset > size || length > (size - offset) || stringOffset > size || stringLength > (size - stringOffset))
+		{
+			throw std::runtime_error(path + ": symbol table out of the file");
+		}
+
+		for (std::size_t entry = 0; entry + kElfSymbolEntry <= length; entry += kElfSymbolEntry)
+		{
+			const std::uint8_t* symbol = &data[offset + entry];
+			std::uint32_t       name   = getLe32(&symbol[0]);
+
+			if ((symbol[12] & 0x0Fu) != kElfSymbolFunction || name >= stringLength)
+			{
+				continue;
+			}
+
+			const char* text = reinterpret_cast<const char*>(&data[stringOffset + name]);
+
+			table.symbols_.push_back({ getLe32(&symbol[4]) & ~1u, getLe32(&symbol[8]),
+			                           std::string(text, strnlen(text, stringLength - name)) });
+		}
+	}
+
+	if (table.symbols_.empty())
+	{
+		throw std::runtime_error(path + ": no function symbols (stripped?)");
+	}
+
+	std::sort(table.symbols_.begin(), table.symbols_.end(),
+	          [](const Symbol& left, const Symbol& right) { return left.address < right.address; });
+
+	return table;
+}
+
+const Symbol* SymbolTable::find(std::uint32_t address) const
+{
+	auto next = std::upper_bound(symbols_.begin(), symbols_.end(), address,
+	                             [](std::uint32_t value, const Symbol& symbol) { return value < symbol.address; });
+
+	if (next == symbols_.begin())
+	{
+		return nullptr;
+	}
+
+	const Symbol& symbol = *(next - 1);
+
+	/* Size 0 (hand-written assembly): up to the next symbol */
+	return (symbol.size == 0 || address < symbol.address + symbol.size) ? &symbol : nullptr;
+}
+
+}
@@ -0,0 +1,240 @@
+#include "blhost/Telemetry.hpp"
+
+#include <utility>
+
+namespace blhost
+{
+
+namespace
+{
+
+constexpr std::size_t   kHeaderSize  = 7;     /* Version, sequence, timestamp */
+constexpr std::size_t   kCrcSize     = 2;
+constexpr std::size_t   kMaxEncoded  = 1024;  /* Far above APP_TELEMETRY_BATCH_SIZE */
+constexpr std::uint8_t  kVibeFirst   = 16;
+
+const char* const kFieldNames[] =
+{
+	nullptr,
+	"uptime_s",
+	"clock_source",
+	"uart_dropped_bytes",
+	"telemetry_dropped_frames",
+	"cdc_dropped_bytes",
+	"audio_underruns",
+	"audio_fx_max_cycles",
+	"accel_dropped_samples",
+	"vibe_max_cycles",
+	"stack_peak_bytes",
+	"heap_peak_bytes",
+	"pool_32_high_water",
+	"pool_128_high_water",
+	"pool_512_high_water",
+	"pool_2048_high_water",
+};
+
+const char* const kVibeNames[] = { "mean_mg", "rms_mg", "peak_mg", "frequency_0.1hz", "amplitude_mg" };
+
+std::uint16_t crc16(const std::uint8_t* data, std::size_t length)
+{
+	std::uint16_t crc = 0xFFFF;
+
+	for (std::size_t index = 0; index < length; index++)
+	{
+		crc ^= static_cast<std::uint16_t>(data[index] << 8);
+		for (int bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x8000) ? static_cast<std::uint16_t>((crc << 1) ^ 0x1021) : static_cast<std::uint16_t>(crc << 1);
+		}
+	}
+
+	return crc;
+}
+
+std::uint32_t little(const std::uint8_t* data, std::size_t size)
+{
+	std::uint32_t value = 0;
+
+	for (std::size_t index = 0; index < size; index++)
+	{
+		value |= static_cast<std::uint32_t>(data[index]) << (8 * index);
+	}
+
+	return value;
+}
+
+std::size_t valueSize(TelemetryType type)
+{
+	switch (type)
+	{
+	case TelemetryType::U8:   return 1;
+	case TelemetryType::Mark:
+	case TelemetryType::I16:
+	case TelemetryType::U16:  return 2;
+	case TelemetryType::I32:
+	case TelemetryType::U32:  return 4;
+	}
+
+	return 0;
+}
+
+std::int64_t typedValue(TelemetryType type, std::uint32_t value)
+{
+	switch (type)
+	{
+	case TelemetryType::I16: return static_cast<std::int16_t>(value);
+	case TelemetryType::I32: return static_cast<std::int32_t>(value);
+	default:                 return value;
+	}
+}
+
+}
+
+bool cobsDecode(const std::uint8_t* data, std::size_t length, std::vector<std::uint8_t>& out)
+{
+	std::size_t index = 0;
+
+	out.clear();
+	while (index < length)
+	{
+		std::uint8_t code = data[index++];
+
+		if (code == 0 || (index + code - 1) > length)
+		{
+			return false;
+		}
+		for (std::uint8_t run = 1; run < code; run++)
+		{
+			if (data[index] == 0)
+			{
+				return false;
+			}
+			out.push_back(data[index++]);
+		}
+		/* The zero a code stands for, but for the block that ends the frame */
+		if (code != 0xFF && index < length)
+		{
+			out.push_back(0);
+		}
+	}
+
+	return length != 0;
+}
+
+std::string telemetryFieldName(std::uint8_t field)
+{
+	static const char axes[] = { 'x', 'y', 'z' };
+
+	if (field < sizeof(kFieldNames) / sizeof(kFieldNames[0]) && kFieldNames[field] != nullptr)
+	{
+		return kFieldNames[field];
+	}
+	if (field >= kVibeFirst)
+	{
+		unsigned axis  = (field - kVibeFirst) / 8u;
+		unsigned index = (field - kVibeFirst) % 8u;
+
+		if (axis < 3 && index < sizeof(kVibeNames) / sizeof(kVibeNames[0]))
+		{
+			return std::string("vibe_") + axes[axis] + "_" + kVibeNames[index];
+		}
+	}
+
+	return "field_" + std::to_string(field);
+}
+
+void TelemetryDecoder::feed(const std::uint8_t* data, std::size_t length, std::vector<TelemetryFrame>& out)
+{
+	for (std::size_t index = 0; index < length; index++)
+	{
+		if (data[index] != 0)
+		{
+			if (encoded_.size() < kMaxEncoded)
+			{
+				encoded_.push_back(data[index]);
+			}
+			else
+			{
+				overlong_ = true;
+			}
+			continue;
+		}
+
+		decode(out);
+		encoded_.clear();
+		overlong_ = false;
+		first_    = false;
+	}
+}
+
+void TelemetryDecoder::decode(std::vector<TelemetryFrame>& out)
+{
+	std::size_t    length;
+	std::size_t    offset;
+	std::uint32_t  mark;
+	TelemetryFrame frame;
+
+	if (encoded_.empty())
+	{
+		return;
+	}
+
+	if (overlong_ || !cobsDecode(encoded_.data(), encoded_.size(), raw_) ||
+	    raw_.size() < (kHeaderSize + kCrcSize) || raw_[0] != kTelemetryVersion ||
+	    crc16(raw_.data(), raw_.size() - kCrcSize) != little(&raw_[raw_.size() - kCrcSize], kCrcSize))
+	{
+		bad_ += first_ ? 0 : 1;
+		return;
+	}
+
+	frame.sequence  = static_cast<std::uint16_t>(little(&raw_[1], 2));
+	frame.timestamp = little(&raw_[3], 4);
+	mark            = frame.timestamp;
+	length          = raw_.size() - kCrcSize;
+
+	for (offset = kHeaderSize; offset + 2 <= length;)
+	{
+		TelemetrySample sample;
+		std::size_t     size;
+
+		sample.field = raw_[offset];
+		sample.type  = static_cast<TelemetryType>(raw_[offset + 1]);
+		size         = valueSize(sample.type);
+		if (size == 0 || offset + 2 + size > length)
+		{
+			break;
+		}
+
+		std::uint32_t value = little(&raw_[offset + 2], size);
+		offset += 2 + size;
+
+		if (sample.type == TelemetryType::Mark)
+		{
+			mark = frame.timestamp + value;
+			continue;
+		}
+
+		sample.timeMs = mark;
+		sample.value  = typedValue(sample.type, value);
+		frame.samples.push_back(sample);
+	}
+
+	/* A record the decoder does not know: the rest of the frame cannot be read */
+	if (offset != length)
+	{
+		bad_++;
+		return;
+	}
+
+	if (sequenced_ && frame.sequence != next_)
+	{
+		lost_ += static_cast<std::uint16_t>(frame.sequence - next_);
+	}
+	sequenced_ = true;
+	next_      = static_cast<std::uint16_t>(frame.sequence + 1);
+
+	frames_++;
+	out.push_back(std::move(frame));
+}
+
+}
@@ -0,0 +1,178 @@
+#include "blhost/Tuner.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace blhost
+{
+
+namespace
+{
+
+constexpr double kRttGain        = 0.125;   /* EWMA weight of a new sample (RFC 6298 alpha) */
+constexpr double kRttVarGain     = 0.25;    /* RFC 6298 beta */
+constexpr unsigned kMaxBackoff   = 6;
+constexpr double kRttQueueFactor = 2.0;     /* Smoothed / lowest RTT above which the window stops growing */
+constexpr unsigned kRoundsPerStep = 4;      /* Clean rounds before the packet grows */
+
+}
+
+StreamTuner::StreamTuner(const Capabilities& caps, std::size_t packetSize, unsigned window, bool adaptive,
+                         LogCallback log)
+	: caps_(caps), adaptive_(adaptive), log_(std::move(log))
+{
+	std::size_t payload = std::min<std::size_t>(caps_.maxPayload ? caps_.maxPayload : kMaxPayloadLength, kMaxPayloadLength);
+
+	maxPacket_ = payload - stream::HeaderLength;
+
+	/* MaxFrame counts the length field and the CRC too */
+	while (caps_.maxFrame != 0 && maxPacket_ > kMinPacket && frameSize(maxPacket_) > caps_.maxFrame)
+	{
+		maxPacket_--;
+	}
+
+	caps_.streamAckInterval = std::max<std::uint8_t>(caps_.streamAckInterval, 1);
+	if (caps_.rxBuffer == 0)
+	{
+		caps_.rxBuffer = static_cast<std::uint16_t>(kRxRingSize);
+	}
+
+	packetSize_ = std::clamp<std::size_t>(packetSize, 1, maxPacket_);
+	window_     = std::clamp<unsigned>(window, caps_.streamAckInterval, windowLimit());
+
+	report("start");
+}
+
+std::size_t StreamTuner::frameSize(std::size_t packet) const
+{
+	/* Extended frame: marker, 16-bit length, command, header, data, CRC */
+	return 3 + 1 + stream::HeaderLength + packet + 4;
+}
+
+unsigned StreamTuner::windowLimit() const
+{
+	/* Frames in flight must fit in the RX ring with room for one more */
+	std::size_t frames = caps_.rxBuffer / frameSize(packetSize_);
+
+	return static_cast<unsigned>(std::max<std::size_t>(caps_.streamAckInterval, (frames > 1) ? frames - 1 : 1));
+}
+
+void StreamTuner::onAck(std::size_t packets, std::chrono::microseconds rtt)
+{
+	acked_   += packets;
+	credit_  += packets;
+	backoff_  = 0;
+
+	if (rtt.count() > 0)
+	{
+		double sample = static_cast<double>(rtt.count());
+
+		if (srttUs_ == 0.0)
+		{
+			srttUs_   = sample;
+			rttvarUs_ = sample / 2.0;
+		}
+		else
+		{
+			rttvarUs_ += kRttVarGain * (std::abs(srttUs_ - sample) - rttvarUs_);
+			srttUs_   += kRttGain * (sample - srttUs_);
+		}
+		minRttUs_ = (minRttUs_ == 0.0) ? sample : std::min(minRttUs_, sample);
+	}
+
+	if (credit_ < window_)
+	{
+		return;
+	}
+
+	/* A clean round */
+	credit_      = 0;
+	lossInRound_ = false;
+
+	if (!adaptive_)
+	{
+		return;
+	}
+
+	cleanRounds_++;
+
+	if (window_ < windowLimit() && (minRttUs_ == 0.0 || srttUs_ <= kRttQueueFactor * minRttUs_))
+	{
+		window_++;
+	}
+
+	if (cleanRounds_ >= kRoundsPerStep && packetSize_ < maxPacket_)
+	{
+		cleanRounds_ = 0;
+		packetSize_  = std::min(maxPacket_, packetSize_ + kPacketStep);
+		window_      = std::min(window_, windowLimit());
+
+		/* The RTT of the longer packets is a new baseline */
+		minRttUs_ = 0.0;
+		report("growth");
+	}
+}
+
+void StreamTuner::onLoss(const char* why)
+{
+	losses_++;
+	credit_      = 0;
+	cleanRounds_ = 0;
+
+	if (!adaptive_)
+	{
+		return;
+	}
+
+	window_ = std::max<unsigned>(caps_.streamAckInterval, window_ / 2);
+
+	if (lossInRound_ && packetSize_ > kMinPacket)
+	{
+		packetSize_ = std::max(kMinPacket, packetSize_ / 2);
+		window_     = std::min(std::max(window_, 1u), windowLimit());
+		minRttUs_   = 0.0;
+	}
+	lossInRound_ = true;
+
+	report(why);
+}
+
+void StreamTuner::onTimeout()
+{
+	backoff_ = std::min(backoff_ + 1, kMaxBackoff);
+	onLoss("timeout");
+}
+
+std::chrono::milliseconds StreamTuner::timeout(std::chrono::milliseconds ceiling) const
+{
+	if (srttUs_ == 0.0)
+	{
+		return ceiling;
+	}
+
+	auto rto = std::chrono::milliseconds(static_cast<long long>((srttUs_ + 4.0 * rttvarUs_) / 1000.0) + 1);
+
+	return std::min(ceiling, std::max(kMinTimeout, rto) * (1 << backoff_));
+}
+
+std::string StreamTuner::summary() const
+{
+	char text[160];
+
+	std::snprintf(text, sizeof(text), "packet %zu, window %u, srtt %.1f ms, %zu packets, %u losses (%.2f %%)",
+	              packetSize_, window_, srttUs_ / 1000.0, acked_, losses_,
+	              (acked_ != 0) ? 100.0 * losses_ / acked_ : 0.0);
+
+	return text;
+}
+
+void StreamTuner::report(const char* why)
+{
+	if (log_)
+	{
+		log_(std::string("stream ") + why + ": " + summary());
+	}
+}
+
+}
@@ -0,0 +1,316 @@
+/*
+ * ring-test
+ * ---------
+ * Host test of the shared SPSC ring (Common/Inc/Ring.h), as the firmware
+ * uses it between an interrupt and a task:
+ *
+ *   ring-test [ELEMENTS]
+ *
+ *  - Ring_Init refuses counts that are not a power of two,
+ *  - Head and Tail wrap past 2^32 with the fill level, spans and data right,
+ *  - a random mix of WriteSpan / Commit, Write, ReadSpan / Release, Read and
+ *    Peek on one thread, checked against a std::deque after every step,
+ *  - a producer and a consumer thread moving ELEMENTS (default 5M) sequence
+ *    numbers through a 256-slot ring in mixed span and copy sizes; every
+ *    element must arrive once and in order. Its throughput is printed.
+ * Exit status 0 when every check passes. Configure with -DBLHOST_TSAN=ON to
+ * run the two-thread part under ThreadSanitizer.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Ring.h"
+
+namespace
+{
+
+int failures = 0;
+
+void check(bool condition, const char* what, unsigned long long at = 0)
+{
+	if (!condition)
+	{
+		if (failures++ < 10)
+		{
+			std::fprintf(stderr, "ring-test: %s (at %llu)\n", what, at);
+		}
+	}
+}
+
+void testInit()
+{
+	std::uint8_t buffer[64];
+	Ring_t       ring;
+
+	check(Ring_Init(&ring, buffer, 0, 1) == 0, "count 0 accepted");
+	check(Ring_Init(&ring, buffer, 12, 1) == 0, "count 12 accepted");
+	check(Ring_Init(&ring, buffer, 64, 1) == 1, "count 64 refused");
+	check(Ring_Used(&ring) == 0 && Ring_Free(&ring) == 64, "new ring not empty");
+
+	Ring_t fixed = RING_INIT(buffer, 16u, 4u);
+
+	check(fixed.Mask == 15 && fixed.Stride == 4 && Ring_Used(&fixed) == 0, "RING_INIT");
+}
+
+/* Indexes just below 2^32: the fill level and the slots stay right across the wrap */
+void testWraparound()
+{
+	constexpr std::uint32_t kCount = 8;
+	std::uint32_t           buffer[kCount];
+	Ring_t                  ring = RING_INIT(buffer, kCount, sizeof(std::uint32_t));
+	std::uint32_t           next = 0;
+	std::uint32_t           expected = 0;
+
+	ring.Head = ring.Tail = 0xFFFFFFFAu;
+
+	for (unsigned round = 0; round < 64; round++)
+	{
+		std::uint32_t in[5];
+		std::uint32_t out[5];
+		std::uint32_t span = 0;
+
+		for (std::uint32_t& value : in)
+		{
+			value = next++;
+		}
+		check(Ring_Write(&ring, in, 5) == 5, "write across the wrap", round);
+		check(Ring_Used(&ring) == 5 && Ring_Free(&ring) == kCount - 5, "fill level across the wrap", round);
+
+		/* The span ends at the buffer's end or at Head, whichever is first */
+		Ring_ReadSpan(&ring, &span);
+		check(span == std::min<std::uint32_t>(5, kCount - (ring.Tail & ring.Mask)), "read span at the wrap", round);
+		check(*static_cast<const std::uint32_t*>(Ring_Peek(&ring, 4)) == expected + 4, "peek across the wrap", round);
+
+		check(Ring_Read(&ring, out, 5) == 5, "read across the wrap", round);
+		for (std::uint32_t value : out)
+		{
+			check(value == expected++, "data across the wrap", round);
+		}
+		check(Ring_Used(&ring) == 0 && Ring_Free(&ring) == kCount, "empty after the wrap", round);
+	}
+	check(ring.Head < 0x1000u, "indexes did not wrap");
+
+	/* Full: no span, no write */
+	std::uint32_t fill[kCount] = {};
+	std::uint32_t span = 1;
+
+	check(Ring_Write(&ring, fill, kCount + 3) == kCount, "write past full");
+	Ring_WriteSpan(&ring, &span);
+	check(span == 0 && Ring_Free(&ring) == 0, "span of a full ring");
+}
+
+/* One thread, every accessor in random sizes, against a model of the queue */
+void testModel()
+{
+	constexpr std::uint32_t kCount  = 16;
+	constexpr std::uint32_t kStride = 3;
+	std::uint8_t            buffer[kCount * kStride];
+	Ring_t                  ring;
+	std::deque<std::uint8_t> model;            /* Bytes */
+	std::mt19937            random(127);
+	std::uint8_t            next = 0;
+
+	Ring_Init(&ring, buffer, kCount, kStride);
+
+	for (unsigned step = 0; step < 200000; step++)
+	{
+		std::uint32_t want = random() % (kCount + 4);
+		std::uint32_t span = 0;
+		std::uint8_t  data[(kCount + 4) * kStride];
+
+		switch (random() % 5)
+		{
+		case 0:   /* WriteSpan, then commit part of it */
+		{
+			std::uint8_t* slot = static_cast<std::uint8_t*>(Ring_WriteSpan(&ring, &span));
+
+			check(span <= kCount - model.size() / kStride, "write span past the free slots", step);
+			span = std::min(span, want);
+			for (std::uint32_t byte = 0; byte < span * kStride; byte++)
+			{
+				slot[byte] = next;
+				model.push_back(next++);
+			}
+			Ring_Commit(&ring, span);
+			break;
+		}
+		case 1:   /* Write */
+		{
+			std::uint32_t expected = std::min<std::uint32_t>(want, kCount - static_cast<std::uint32_t>(model.size() / kStride));
+
+			for (std::uint32_t byte = 0; byte < want * kStride; byte++)
+			{
+				data[byte] = static_cast<std::uint8_t>(next + byte);
+			}
+			check(Ring_Write(&ring, data, want) == expected, "write count", step);
+			for (std::uint32_t byte = 0; byte < expected * kStride; byte++)
+			{
+				model.push_back(next++);
+			}
+			break;
+		}
+		case 2:   /* ReadSpan, then release part of it */
+		{
+			const std::uint8_t* slot = static_cast<const std::uint8_t*>(Ring_ReadSpan(&ring, &span));
+
+			check(span * kStride <= model.size(), "read span past the filled slots", step);
+			span = std::min(span, want);
+			for (std::uint32_t byte = 0; byte < span * kStride; byte++)
+			{
+				check(slot[byte] == model.front(), "read span data", step);
+				model.pop_front();
+			}
+			Ring_Release(&ring, span);
+			break;
+		}
+		case 3:   /* Read */
+		{
+			std::uint32_t expected = std::min<std::uint32_t>(want, static_cast<std::uint32_t>(model.size() / kStride));
+
+			check(Ring_Read(&ring, data, want) == expected, "read count", step);
+			for (std::uint32_t byte = 0; byte < expected * kStride; byte++)
+			{
+				check(data[byte] == model.front(), "read data", step);
+				model.pop_front();
+			}
+			break;
+		}
+		default:  /* Peek at a filled slot */
+			if (!model.empty())
+			{
+				std::uint32_t offset = random() % (model.size() / kStride);
+
+				check(*static_cast<const std::uint8_t*>(Ring_Peek(&ring, offset)) == model[offset * kStride], "peek", step);
+			}
+			break;
+		}
+
+		check(Ring_Used(&ring) * kStride == model.size(), "used", step);
+		check(Ring_Free(&ring) == kCount - model.size() / kStride, "free", step);
+	}
+}
+
+/* Producer and consumer threads, as an interrupt and a task: sequence numbers in, order checked out */
+void testThreads(unsigned long long elements)
+{
+	constexpr std::uint32_t kCount = 256;
+	std::uint32_t           buffer[kCount];
+	Ring_t                  ring = RING_INIT(buffer, kCount, sizeof(std::uint32_t));
+	auto                    start = std::chrono::steady_clock::now();
+
+	std::thread producer([&]() {
+		std::mt19937       random(1);
+		unsigned long long sent = 0;
+		std::uint32_t      chunk[64];
+
+		while (sent < elements)
+		{
+			std::uint32_t want = 1 + random() % 64;
+
+			want = static_cast<std::uint32_t>(std::min<unsigned long long>(want, elements - sent));
+			if ((random() & 1u) != 0u)
+			{
+				std::uint32_t  span = 0;
+				std::uint32_t* slot = static_cast<std::uint32_t*>(Ring_WriteSpan(&ring, &span));
+
+				span = std::min(span, want);
+				for (std::uint32_t index = 0; index < span; index++)
+				{
+					slot[index] = static_cast<std::uint32_t>(sent + index);
+				}
+				Ring_Commit(&ring, span);
+				sent += span;
+			}
+			else
+			{
+				for (std::uint32_t index = 0; index < want; index++)
+				{
+					chunk[index] = static_cast<std::uint32_t>(sent + index);
+				}
+				sent += Ring_Write(&ring, chunk, want);
+			}
+			if (Ring_Free(&ring) == 0)
+			{
+				std::this_thread::yield();   /* Full: let the consumer run on a single core */
+			}
+		}
+	});
+
+	std::mt19937       random(2);
+	unsigned long long received = 0;
+	std::uint32_t      chunk[64];
+
+	while (received < elements && failures == 0)
+	{
+		std::uint32_t want = 1 + random() % 64;
+		std::uint32_t got  = 0;
+
+		if ((random() & 1u) != 0u)
+		{
+			const std::uint32_t* slot = static_cast<const std::uint32_t*>(Ring_ReadSpan(&ring, &got));
+
+			got = std::min(got, want);
+			std::memcpy(chunk, slot, got * sizeof(std::uint32_t));
+			Ring_Release(&ring, got);
+		}
+		else
+		{
+			got = Ring_Read(&ring, chunk, want);
+		}
+
+		for (std::uint32_t index = 0; index < got; index++)
+		{
+			check(chunk[index] == static_cast<std::uint32_t>(received + index), "element lost or out of order", received + index);
+		}
+		received += got;
+		if (got == 0)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	if (failures != 0)
+	{
+		/* The producer may wait for room forever */
+		std::fprintf(stderr, "ring-test: %d check(s) failed\n", failures);
+		std::_Exit(1);
+	}
+	producer.join();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::printf("ring-test: %llu elements through %u slots in %.3f s, %.1f M elements/s\n", elements, kCount, seconds,
+	            seconds > 0 ? elements / seconds / 1e6 : 0.0);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	unsigned long long elements = (argc > 1) ? std::strtoull(argv[1], nullptr, 0) : 5000000ull;
+
+	testInit();
+	testWraparound();
+	testModel();
+	if (failures == 0)
+	{
+		testThreads(elements);
+	}
+
+	if (failures != 0)
+	{
+		std::fprintf(stderr, "ring-test: %d check(s) failed\n", failures);
+		return 1;
+	}
+	std::printf("ring-test: ok\n");
+	return 0;
+}
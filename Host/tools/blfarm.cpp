@@ -0,0 +1,639 @@
+/*
+ * blfarm
+ * ------
+ * Nightly performance run over a rack of boards, one row of the trend
+ * dataset per number, so a slower bootloader shows up the morning after the
+ * commit that made it slower:
+ *
+ *   blfarm --farm FILE [-b 115200] [--crc-wordwise] [--response-crc]
+ *          [--image IMAGE.bin --address ADDR] [--bench-image FILE] [--iterations N]
+ *          [--micro PORT [--micro-reset CMD] [--micro-timeout S]]
+ *          [--commit ID] [--dataset FILE] [--threshold PERCENT]
+ *
+ * FILE lists one board per line, "<port> [scratch sector]" (default 11),
+ * '#' starts a comment. For every board:
+ *  - --image is written to all boards at once through the parallel engine
+ *    (Batch.hpp): one throughput row per board,
+ *  - the counters are cleared (BL_GET_STATS), then the benchmark matrix runs
+ *    (Benchmark.hpp, all boards in parallel, --bench-image adds the update
+ *    row), then BL_GET_BOOT_TIMES: how long this boot took to configure the
+ *    clock and decide, in us,
+ *  - the counters afterwards: per opcode mean handler time, flash program
+ *    and erase means per sector class, longest masked section, CRC and UART
+ *    errors.
+ * --micro reads the CSV of the on-target microbenchmarks (BL_BENCH_ENABLE,
+ * the Bench build) from a board that runs them, after --micro-reset (e.g.
+ * "st-flash reset"), until --micro-timeout seconds without a line.
+ *
+ * Rows are appended to --dataset (default bench-trend.csv), the header
+ * first when the file is new:
+ *
+ *   commit,date,board,uid,bl_version,suite,test,parameter,value,unit
+ *
+ * --commit defaults to "git rev-parse --short HEAD". Every row is then
+ * compared with the same row of the latest other commit in the dataset:
+ * times (us, s, cycles, cycles/B) higher or throughput (B/s) lower by more
+ * than --threshold percent (default 10) are printed as regressions. Exit
+ * status 0, 1 when a board or the microbenchmarks failed, 2 on a regression.
+ * "make farm-bench" runs it with BL_FARM_FILE and BL_FARM_DATASET.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "blhost/Batch.hpp"
+#include "blhost/Benchmark.hpp"
+#include "blhost/MappedFile.hpp"
+
+namespace
+{
+
+struct Board
+{
+	std::string port;
+	unsigned    scratch = 11;
+};
+
+struct Options
+{
+	std::string          farm;
+	blhost::BatchOptions batch;
+	std::string          image;
+	std::uint32_t        address      = 0x08008000u;
+	std::string          benchImage;
+	unsigned             iterations   = 20;
+	std::string          microPort;
+	std::string          microReset;
+	unsigned             microTimeout = 30;        /* Seconds without a line */
+	std::string          commit;
+	std::string          dataset      = "bench-trend.csv";
+	double               threshold    = 10.0;      /* Percent */
+};
+
+struct Row
+{
+	std::string board;
+	std::string uid;
+	unsigned    blVersion = 0;
+	std::string suite;
+	std::string test;
+	std::string parameter;
+	double      value = 0.0;
+	std::string unit;
+};
+
+void usage()
+{
+	std::fprintf(stderr,
+	             "usage: blfarm --farm FILE [-b <baud>] [--crc-wordwise] [--response-crc]\n"
+	             "              [--image IMAGE.bin --address ADDR] [--bench-image FILE] [--iterations N]\n"
+	             "              [--micro PORT [--micro-reset CMD] [--micro-timeout S]]\n"
+	             "              [--commit ID] [--dataset FILE] [--threshold PERCENT]\n");
+}
+
+bool parse(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg   = argv[i];
+		bool        value = (i + 1) < argc;
+
+		if (arg == "--farm" && value)                { options.farm = argv[++i]; }
+		else if (arg == "-b" && value)               { options.batch.baud = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0)); }
+		else if (arg == "--crc-wordwise")            { options.batch.engine.crc = blhost::CrcMode::WordWise; }
+		else if (arg == "--response-crc")            { options.batch.engine.responseCrc = true; }
+		else if (arg == "--image" && value)          { options.image = argv[++i]; }
+		else if (arg == "--address" && value)        { options.address = static_cast<std::uint32_t>(std::strtoul(argv[++i], nullptr, 0)); }
+		else if (arg == "--bench-image" && value)    { options.benchImage = argv[++i]; }
+		else if (arg == "--iterations" && value)     { options.iterations = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0)); }
+		else if (arg == "--micro" && value)          { options.microPort = argv[++i]; }
+		else if (arg == "--micro-reset" && value)    { options.microReset = argv[++i]; }
+		else if (arg == "--micro-timeout" && value)  { options.microTimeout = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0)); }
+		else if (arg == "--commit" && value)         { options.commit = argv[++i]; }
+		else if (arg == "--dataset" && value)        { options.dataset = argv[++i]; }
+		else if (arg == "--threshold" && value)      { options.threshold = std::strtod(argv[++i], nullptr); }
+		else                                         { return false; }
+	}
+
+	return !options.farm.empty() && options.batch.baud != 0 && options.threshold > 0.0;
+}
+
+std::vector<Board> loadFarm(const std::string& path)
+{
+	std::ifstream      file(path);
+	std::vector<Board> boards;
+	std::string        line;
+
+	if (!file)
+	{
+		throw std::runtime_error("cannot read " + path);
+	}
+
+	while (std::getline(file, line))
+	{
+		std::istringstream fields(line.substr(0, line.find('#')));
+		Board              board;
+
+		if (fields >> board.port)
+		{
+			fields >> board.scratch;
+			boards.push_back(board);
+		}
+	}
+
+	return boards;
+}
+
+std::string gitCommit()
+{
+	std::string commit;
+	char        buffer[64];
+	FILE*       pipe = popen("git rev-parse --short HEAD 2>/dev/null", "r");
+
+	if (pipe != nullptr)
+	{
+		if (std::fgets(buffer, sizeof(buffer), pipe) != nullptr)
+		{
+			commit = buffer;
+			commit.erase(commit.find_last_not_of("\r\n") + 1);
+		}
+		pclose(pipe);
+	}
+
+	return commit.empty() ? "unknown" : commit;
+}
+
+std::string utcDate()
+{
+	std::time_t now = std::time(nullptr);
+	char        text[32];
+
+	std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+	return text;
+}
+
+std::string hexByte(std::uint8_t value)
+{
+	char text[8];
+
+	std::snprintf(text, sizeof(text), "0x%02X", value);
+
+	return text;
+}
+
+/* BL_GET_BOOT_TIMES: [count] [stamps (4 each)] [SystemCoreClock (4)]; before the CLOCK stamp at HSI */
+void addBootTimes(const std::vector<std::uint8_t>& payload, Row row, std::vector<Row>& rows)
+{
+	static const char* const names[] = { "clock", "decision", "validated", "jump" };
+
+	if (payload.empty() || payload.size() < 1u + 4u * payload[0] + 4u)
+	{
+		return;
+	}
+
+	std::size_t   count  = payload[0];
+	std::uint32_t clock  = blhost::getLe32(&payload[1 + 4 * count]);
+	std::uint32_t origin = blhost::getLe32(&payload[1]);
+	double        hsiUs  = origin / 16.0;
+
+	row.suite = "boot";
+	row.unit  = "us";
+	for (std::size_t index = 0; index < count && index < 4 && clock != 0; index++)
+	{
+		std::uint32_t stamp = blhost::getLe32(&payload[1 + 4 * index]);
+
+		if (stamp == 0)
+		{
+			continue;
+		}
+
+		row.test  = names[index];
+		row.value = (origin != 0 && index > 0) ? hsiUs + (stamp - origin) * 1e6 / clock : stamp / 16.0;
+		rows.push_back(row);
+	}
+}
+
+void addStats(const blhost::DeviceStats& stats, Row row, std::vector<Row>& rows)
+{
+	static const char* const classes[] = { "16KB", "64KB", "128KB" };
+
+	row.suite = "stats";
+
+	for (const blhost::CommandStats& entry : stats.commands)
+	{
+		if (entry.count != 0 && stats.coreClockHz != 0)
+		{
+			row.test      = "handler";
+			row.parameter = hexByte(entry.opcode);
+			row.value     = entry.totalCycles * 1e6 / stats.coreClockHz / entry.count;
+			row.unit      = "us";
+			rows.push_back(row);
+		}
+	}
+
+	for (std::size_t index = 0; stats.flash && index < blhost::kFlashClasses; index++)
+	{
+		const blhost::FlashHistogram* histograms[] = { &stats.flash->program[index], &stats.flash->erase[index] };
+
+		for (int kind = 0; kind < 2; kind++)
+		{
+			if (histograms[kind]->operations() != 0)
+			{
+				row.test      = kind ? "erase" : "program";
+				row.parameter = classes[index];
+				row.value     = static_cast<double>(histograms[kind]->totalUs) / histograms[kind]->operations();
+				row.unit      = "us";
+				rows.push_back(row);
+			}
+		}
+	}
+
+	if (stats.masking && stats.coreClockHz != 0)
+	{
+		row.test      = "masked";
+		row.parameter = "max";
+		row.value     = stats.masking->maxCycles * 1e6 / stats.coreClockHz;
+		row.unit      = "us";
+		rows.push_back(row);
+	}
+
+	row.parameter = "";
+	row.unit      = "count";
+	row.test      = "crc_failures";
+	row.value     = stats.crcFailures;
+	rows.push_back(row);
+	row.test  = "uart_errors";
+	row.value = stats.uartErrors;
+	rows.push_back(row);
+}
+
+/* One board: benchmarks, boot times and statistics on its own link */
+std::vector<Row> measureBoard(const Board& board, const Options& options, const blhost::Plan* plan)
+{
+	blhost::SerialPort   serial(board.port, options.batch.baud, options.batch.flowControl);
+	blhost::Engine       engine(serial, options.batch.engine);
+	blhost::Flasher      flasher(engine);
+	blhost::BenchOptions bench;
+	std::vector<Row>     rows;
+	Row                  row;
+
+	engine.start();
+	flasher.stats(true);
+
+	bench.scratchSector = board.scratch;
+	bench.iterations    = options.iterations;
+	bench.plan          = plan;
+
+	blhost::BenchReport report = blhost::runBenchmarks(engine, flasher, bench);
+
+	row.board     = board.port;
+	row.uid       = report.uniqueId;
+	row.blVersion = report.bootloaderVersion;
+
+	for (const blhost::BenchResult& result : report.results)
+	{
+		if (result.status != "ok")
+		{
+			std::fprintf(stderr, "blfarm: %s: %s %s: %s\n", board.port.c_str(), result.test.c_str(), result.parameter.c_str(),
+			             result.status.c_str());
+			continue;
+		}
+
+		row.suite     = "bench";
+		row.test      = result.test;
+		row.parameter = result.parameter;
+		row.value     = result.medianUs;
+		row.unit      = "us";
+		rows.push_back(row);
+		if (result.bytesPerSecond > 0.0)
+		{
+			row.value = result.bytesPerSecond;
+			row.unit  = "B/s";
+			rows.push_back(row);
+		}
+	}
+
+	std::optional<blhost::Response> bootTimes = engine.transact(blhost::cmd::GetBootTimes, {}, std::chrono::milliseconds(1000));
+
+	row.parameter = "";
+	if (bootTimes && bootTimes->ack)
+	{
+		addBootTimes(bootTimes->payload, row, rows);
+	}
+	addStats(flasher.stats(), row, rows);
+
+	engine.stop();
+
+	return rows;
+}
+
+/* The Bench build's lines: bench,<name>,<SYSCLK Hz>,<wait states>,<bytes>,<min cycles>,<max cycles>,<cycles/byte> */
+std::vector<Row> readMicrobenchmarks(const Options& options)
+{
+	blhost::SerialPort serial(options.microPort, 115200);
+	std::vector<Row>   rows;
+	std::string        line;
+	auto               quiet = std::chrono::steady_clock::now();
+
+	serial.flush();
+	if (!options.microReset.empty() && std::system(options.microReset.c_str()) != 0)
+	{
+		throw std::runtime_error("--micro-reset failed: " + options.microReset);
+	}
+
+	while (std::chrono::steady_clock::now() - quiet < std::chrono::seconds(options.microTimeout))
+	{
+		std::uint8_t buffer[256];
+		std::size_t  count;
+
+		serial.wait(false, 100);
+		while ((count = serial.read(buffer, sizeof(buffer))) != 0)
+		{
+			quiet = std::chrono::steady_clock::now();
+			for (std::size_t index = 0; index < count; index++)
+			{
+				if (buffer[index] != '\n')
+				{
+					line += static_cast<char>(buffer[index]);
+					continue;
+				}
+
+				std::vector<std::string> fields;
+				std::istringstream       split(line);
+				std::string              field;
+
+				while (std::getline(split, field, ','))
+				{
+					fields.push_back(field);
+				}
+				line.clear();
+
+				if (fields.size() == 8 && fields[0] == "bench")
+				{
+					Row  row;
+					char parameter[64];
+
+					std::snprintf(parameter, sizeof(parameter), "%luMHz/%sws/%sB", std::strtoul(fields[2].c_str(), nullptr, 10) / 1000000ul,
+					              fields[3].c_str(), fields[4].c_str());
+					row.board     = options.microPort;
+					row.suite     = "micro";
+					row.test      = fields[1];
+					row.parameter = parameter;
+					row.value     = std::strtod(fields[7].c_str(), nullptr);
+					row.unit      = "cycles/B";
+					rows.push_back(row);
+					row.value = std::strtod(fields[5].c_str(), nullptr);
+					row.unit  = "cycles";
+					rows.push_back(row);
+				}
+			}
+		}
+	}
+
+	return rows;
+}
+
+std::string rowKey(const std::string& board, const std::string& suite, const std::string& test, const std::string& parameter,
+                   const std::string& unit)
+{
+	return board + '\x1f' + suite + '\x1f' + test + '\x1f' + parameter + '\x1f' + unit;
+}
+
+/* Splits a dataset line, "..." fields may hold commas */
+std::vector<std::string> splitCsv(const std::string& line)
+{
+	std::vector<std::string> fields(1);
+	bool                     quoted = false;
+
+	for (char c : line)
+	{
+		if (c == '"')
+		{
+			quoted = !quoted;
+		}
+		else if (c == ',' && !quoted)
+		{
+			fields.emplace_back();
+		}
+		else
+		{
+			fields.back() += c;
+		}
+	}
+
+	return fields;
+}
+
+/* Values of the latest commit other than this one, by rowKey */
+std::map<std::string, double> previousRun(const std::string& path, const std::string& commit, std::string& previous)
+{
+	std::ifstream                                        file(path);
+	std::map<std::string, std::map<std::string, double>> runs;
+	std::string                                          line;
+
+	while (std::getline(file, line))
+	{
+		std::vector<std::string> fields = splitCsv(line);
+
+		if (fields.size() != 10 || fields[0] == "commit" || fields[0] == commit)
+		{
+			continue;
+		}
+
+		if (fields[0] != previous)
+		{
+			previous = fields[0];
+			runs[previous].clear();
+		}
+		runs[previous][rowKey(fields[2], fields[5], fields[6], fields[7], fields[9])] = std::strtod(fields[8].c_str(), nullptr);
+	}
+
+	return previous.empty() ? std::map<std::string, double>() : runs[previous];
+}
+
+void appendDataset(const std::string& path, const std::vector<Row>& rows, const std::string& commit, const std::string& date)
+{
+	bool          fresh = !std::ifstream(path).good();
+	std::ofstream file(path, std::ios::app);
+
+	if (fresh)
+	{
+		file << "commit,date,board,uid,bl_version,suite,test,parameter,value,unit\n";
+	}
+
+	for (const Row& row : rows)
+	{
+		char value[32];
+
+		std::snprintf(value, sizeof(value), "%.3f", row.value);
+		file << commit << ',' << date << ',' << row.board << ',' << row.uid << ',' << row.blVersion << ',' << row.suite << ','
+		     << row.test << ",\"" << row.parameter << "\"," << value << ',' << row.unit << '\n';
+	}
+
+	if (!file.flush())
+	{
+		throw std::runtime_error("cannot write " + path);
+	}
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	int     status = 0;
+
+	if (!parse(argc, argv, options))
+	{
+		usage();
+		return 1;
+	}
+
+	try
+	{
+		std::vector<Board>             boards = loadFarm(options.farm);
+		std::vector<std::string>       ports;
+		std::vector<Row>               rows;
+		std::mutex                     mutex;
+		std::unique_ptr<blhost::Image> benchImage;
+		blhost::Plan                   plan;
+
+		for (const Board& board : boards)
+		{
+			ports.push_back(board.port);
+		}
+		if (options.commit.empty())
+		{
+			options.commit = gitCommit();
+		}
+
+		/* 1. The image to every board at once */
+		if (!options.image.empty())
+		{
+			blhost::MappedFile image(options.image);
+
+			for (const blhost::BoardResult& result :
+			     blhost::flashBoards(ports, options.address, image.data(), image.size(), options.batch))
+			{
+				Row row;
+
+				if (!result.ok)
+				{
+					std::fprintf(stderr, "blfarm: %s: write failed: %s\n", result.port.c_str(), result.error.c_str());
+					status = 1;
+					continue;
+				}
+
+				row.board     = result.port;
+				row.suite     = "flash";
+				row.test      = "write";
+				row.parameter = std::to_string(image.size());
+				row.value     = image.size() / result.seconds;
+				row.unit      = "B/s";
+				rows.push_back(row);
+			}
+		}
+
+		/* 2. Benchmarks, boot times and counters, every board on its own thread */
+		if (!options.benchImage.empty())
+		{
+			benchImage = std::make_unique<blhost::Image>(blhost::Image::load(options.benchImage, 0x08000000u));
+			plan       = blhost::planTransfer(*benchImage);
+		}
+
+		std::vector<std::thread> workers;
+
+		for (const Board& board : boards)
+		{
+			workers.emplace_back([&, board]() {
+				try
+				{
+					std::vector<Row>            measured = measureBoard(board, options, benchImage ? &plan : nullptr);
+					std::lock_guard<std::mutex> lock(mutex);
+
+					rows.insert(rows.end(), measured.begin(), measured.end());
+				}
+				catch (const std::exception& error)
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+
+					std::fprintf(stderr, "blfarm: %s: %s\n", board.port.c_str(), error.what());
+					status = 1;
+				}
+			});
+		}
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+
+		/* 3. The on-target microbenchmarks */
+		if (!options.microPort.empty())
+		{
+			std::vector<Row> micro = readMicrobenchmarks(options);
+
+			if (micro.empty())
+			{
+				std::fprintf(stderr, "blfarm: %s: no microbenchmark lines\n", options.microPort.c_str());
+				status = 1;
+			}
+			rows.insert(rows.end(), micro.begin(), micro.end());
+		}
+
+		/* 4. Against the previous commit, then into the dataset */
+		std::string                   previous;
+		std::map<std::string, double> baseline = previousRun(options.dataset, options.commit, previous);
+		unsigned                      regressions = 0;
+
+		for (const Row& row : rows)
+		{
+			auto   entry  = baseline.find(rowKey(row.board, row.suite, row.test, row.parameter, row.unit));
+			bool   higher = (row.unit == "us" || row.unit == "s" || row.unit == "cycles" || row.unit == "cycles/B");
+			bool   lower  = (row.unit == "B/s");
+
+			if (entry == baseline.end() || entry->second <= 0.0 || (!higher && !lower))
+			{
+				continue;
+			}
+
+			double change = 100.0 * (row.value - entry->second) / entry->second;
+
+			if ((higher && change > options.threshold) || (lower && -change > options.threshold))
+			{
+				std::printf("regression %s %s %s %s: %.3f %s, %.3f at %s (%+.1f %%)\n", row.board.c_str(), row.suite.c_str(),
+				            row.test.c_str(), row.parameter.c_str(), row.value, row.unit.c_str(), entry->second,
+				            previous.c_str(), change);
+				regressions++;
+			}
+		}
+
+		appendDataset(options.dataset, rows, options.commit, utcDate());
+		std::printf("%s: %zu rows from %zu boards into %s, %u regressions against %s\n", options.commit.c_str(), rows.size(),
+		            boards.size(), options.dataset.c_str(), regressions, previous.empty() ? "nothing" : previous.c_str());
+
+		if (regressions != 0 && status == 0)
+		{
+			status = 2;
+		}
+	}
+	catch (const std::exception& error)
+	{
+		std::fprintf(stderr, "blfarm: %s\n", error.what());
+		return 1;
+	}
+
+	return status;
+}
@@ -0,0 +1,1289 @@
+/*
+ * blflash
+ * -------
+ * Command-line front end of the host library:
+ *
+ *   blflash -p /dev/ttyUSB0 [-b 115200] [--rtscts] [--crc-wordwise] [--response-crc] [--progress] [--record FILE]
+ *           [-v] <command>
+ *     version
+ *     erase  <address> <length> [--plan]
+ *     erase-image <address> <length> [--dry-run]
+ *     write  <address> <image.bin> [--window N] [--packet N] [--fixed] [--auto-erase] [--no-session] [--no-verify]
+ *            [--encrypt KEYFILE] [--via-ram] [--codec auto|raw|lz]
+ *     verify <address> <image.bin>
+ *     program <image.elf|.hex|.bin> [--base ADDR] [--dry-run] [--no-erase] [--cache DIR] [--store DIR]
+ *             [--line N] [--merge-gap N] [--min-skip N] [--min-fill N]
+ *     identify --store DIR
+ *     store-add <name> <image> --store DIR [--base ADDR]          (no port)
+ *     delta <installed> <target> --store DIR                       (no port)
+ *     diff  <old.bin> <new.bin> [--thumb|--no-thumb] [--no-lz] [--threads N]      (no port)
+ *     write-delta <address> <source> <old.bin> <new.bin> [--thumb|--no-thumb] [--no-lz] [--threads N]
+ *            [--packet N] [--no-session] [--no-verify]
+ *     package <image> <out.pkg> [--base ADDR] [--block N] [--no-lz] [--signed] [--merge-gap N]  (no port)
+ *     sign-package <package.pkg> <signature>                       (no port)
+ *     write-package <package.pkg> [--packet N] [--no-session] [--no-verify]
+ *     self-update <bootloader.bin> [--staging ADDR] [--signature FILE] [--packet N]
+ *     go     <address>
+ *     boot   [--reset]
+ *     ota    <image.bin>
+ *     app-info [<image.bin>]
+ *     loader <loader.bin>
+ *     stats  [--clear]
+ *     trace  [--from SEQUENCE]
+ *     crash  [--clear]
+ *     dump   <address> <length> [-o FILE] [--cache DIR] [--store DIR]
+ *     profile [--elf UserApp.elf] [--top N] [--clear]
+ *     latency [--clear]
+ *     bench  [--scratch SECTOR] [--iterations N] [--erase-sector N ...] [--image FILE]
+ *            [--format csv|json] [-o FILE]
+ *     replay <session> [--lockstep] [--speed X]
+ *     report <session>                                             (no port)
+ *
+ * The CRC options must match the bootloader build (BL_CRC_WORDWISE_ENABLE,
+ * BL_RESPONSE_CRC_ENABLE). Exit status 0 on success, 1 on failure.
+ *
+ * --progress asks the bootloader for progress frames (BL_SET_PROGRESS) and
+ * prints them on stderr while an erase or an on-device program runs, so a
+ * long command shows it is alive; ignored by a bootloader without them.
+ *
+ * program loads the image and runs its transfer plan (Planner.hpp); with
+ * --dry-run it only prints the plan and needs no port. With --cache, the
+ * board's manifest (Manifest.hpp) is kept under DIR: sectors the board
+ * already holds are neither erased nor written, and a board carrying the
+ * build is left alone after one check per sector.
+ *
+ * --store names a block store (BlockStore.hpp) of the versions shipped.
+ * store-add puts an image into it under a name; identify tells which stored
+ * version the board holds from its block manifest; delta lists what a move
+ * from one stored version to another has to send. program --store stores
+ * the image under its file name, identifies the board and leaves out the
+ * sectors the delta says are already there (VERIFY_RANGE still checks all).
+ *
+ * diff makes the BL_MEM_WRITE_DELTA patch from old.bin to new.bin (Delta.hpp)
+ * and prints its size; write-delta sends it: the bootloader rebuilds
+ * new.bin at address (an erased staging slot) from old.bin installed at
+ * source. The Thumb-2 BL filter is tried both ways unless --thumb or
+ * --no-thumb, --no-lz leaves the patch uncompressed.
+ *
+ * package builds an update package (Package.hpp, BL_Package.h) from an
+ * image: the erase plan, segments (LZ-compressed unless --no-lz), block CRCs
+ * and payload digest in one file the bootloader checks before it erases
+ * anything; write-package sends it (BL_MEM_WRITE_PACKAGE), and the same
+ * file can be staged by the application. With --signed the package
+ * reserves a signature and <out.pkg>.manifest receives the bytes to sign
+ * for a BL_SIGNATURE_ENABLE bootloader:
+ *     openssl dgst -sha256 -sign key.pem -out sig.der out.pkg.manifest
+ *     blflash sign-package out.pkg sig.der
+ *
+ * self-update replaces the bootloader itself (BL_SELF_UPDATE): the image is
+ * staged at --staging (default 0x080C0000, sector 10) and checked there by
+ * the running bootloader, which then copies it over sectors 0 and 1 from
+ * SRAM and resets; a BL_SIGNATURE_ENABLE build wants --signature, the
+ * ECDSA-P256 signature (DER or raw) of the image's SHA-256:
+ *     openssl dgst -sha256 -sign key.pem -out bl.sig bootloader.bin
+ * The staging sector is left as it is; erase it once the new bootloader
+ * answers.
+ *
+ * --window / --packet are starting values the stream tunes to the link
+ * (Tuner.hpp) unless --fixed; -v prints the tuner's decisions.
+ *
+ * stats prints the bootloader's counters (BL_GET_STATS): link bytes, CRC
+ * failures and UART errors, then per opcode its count, mean / max time and
+ * NACKs, the USART2 errors by kind with the RX ring's fill peak (overruns
+ * or a peak near the ring size: too fast a baud rate for this fixture),
+ * then per sector class the flash program / erase times (mean,
+ * 99th percentile bucket, max); --clear restarts them, e.g. before an update
+ * worth examining.
+ *
+ * trace prints the bootloader's event ring (BL_GET_TRACE) oldest first:
+ * sequence, time since the first event printed, event and its arguments;
+ * --from skips the events up to that sequence number.
+ *
+ * crash prints the last fault saved by a fault handler (BL_GET_CRASH_RECORD):
+ * image, exception, stacked registers, fault status registers and the stack
+ * words above the faulting SP; --clear drops it once read.
+ *
+ * dump reads a device range through a DeviceView (DeviceView.hpp) to FILE
+ * or stdout: 4 KB pages, each checked against its BL_BLOCK_CRC_MANIFEST CRC
+ * first. With --cache the pages are kept under DIR by CRC, so a page read
+ * once is not read again, on this board or another. With --store, blocks of
+ * a shipped version come from the block store. The pages read, reused and
+ * checked go to stderr. blmount serves the same views as files.
+ *
+ * profile reads the UserApp's PC-sampling histogram from backup SRAM
+ * (App_Profile.h) through the bootloader and prints the --top (default 20)
+ * functions of --elf by share of the samples. A bucket that spans several
+ * functions is split between them by the bytes each has in it; without the
+ * ELF the buckets are listed by address. --clear has the UserApp start over
+ * at its next boot.
+ *
+ * latency asks the running UserApp on USART2 (GET_SCHED_LATENCY, App_Ota.h)
+ * for its scheduler's dispatch latency: per event signalled since its boot,
+ * the dispatches, the 50th and 99th percentile buckets and the worst wait
+ * from the signal (the entry of the interrupt handler that raised it) to
+ * the start of its task, in us at the core clock of the reply. The events
+ * are named as in UserApp main.h. --clear starts them over once read.
+ *
+ * bench runs the fixed matrix of Benchmark.hpp; it erases the scratch
+ * sector (default 11), every --erase-sector, and with --image programs it.
+ *
+ * boot leaves update mode once a flash is done (BL_RESET_AND_BOOT): the
+ * session is closed and the active image started by the same clean handoff
+ * as a normal boot, or with --reset by a system reset that skips update
+ * mode once. A handoff the boot path would not make (staged update, image on
+ * trial) turns into a reset; either way the command says which.
+ *
+ * ota updates the inactive A/B slot with the basic commands the running
+ * UserApp also answers on USART2 (App_Ota.h), so the application keeps
+ * working during the transfer: erase of the sectors the image needs, 1 KB
+ * writes, activation of the slot, then a reset into it. The image is the
+ * one built for the inactive slot; the bootloader takes the same sequence.
+ *
+ * app-info prints the image header of each slot (BL_GET_APP_INFO): state,
+ * version, build ID, length, stamped CRC, security version and activation,
+ * the active slot marked; no CRC is computed and nothing is read back. With
+ * an image it also says whether the active slot already holds that build
+ * (same stamped CRC, validated), so a line can skip boards that are current.
+ *
+ * loader uploads a second-stage loader into SRAM and starts it
+ * (BL_Loader.h); the port then belongs to the loader's own protocol.
+ *
+ * erase-image lets the bootloader erase what an image range needs
+ * (BL_ERASE_FOR_IMAGE): blank sectors are skipped, and the request is refused
+ * as a whole on a bootloader, running-slot or protected sector. It prints
+ * the method, the expected time and the sectors; --dry-run changes nothing.
+ *
+ * write accepts -p more than once: the boards are flashed in parallel
+ * (Batch.hpp) from one mapping of the image, each with its own log under
+ * --log-dir, followed by one summary line per board.
+ *
+ * write --via-ram uploads the image into SRAM 64 KB at a time and has the
+ * bootloader program each window from there (BL_PROGRAM_FROM_RAM), checked
+ * by its CRC before and read back after; no session. The link is then only
+ * busy with memcpy-speed uploads, so boards on one jig spend the flash time
+ * in parallel whatever the port.
+ *
+ * write picks its codec per image (Codec.hpp) unless --codec says which: the
+ * image is LZ-compressed on the host, timed, and the raw stream and the
+ * BL_MEM_WRITE_LZ transfer are predicted from the line rate (-b / 10), a
+ * measured round trip and the device's decoder rate from GET_CAPABILITIES,
+ * measured first on a sample decoded into SRAM (Flasher::probeLz) when the
+ * device has none yet. The faster one is sent. Both predictions go to
+ * stderr, and the actual throughput beside the chosen one at the end.
+ * --via-ram, --encrypt and several ports always send raw.
+ *
+ * write --encrypt sends the image as AES-CTR ciphertext (Aes.hpp) under the
+ * raw 16- or 32-byte key in KEYFILE, the key of a BL_DECRYPT_ENABLE
+ * bootloader, with a new random counter block per run.
+ *
+ * --record saves the command's traffic to FILE (Session.hpp): every chunk
+ * each way with its time, and a GET_STATS snapshot before and after the
+ * command (not around go, boot, loader and self-update, where the
+ * bootloader leaves), also when the command fails. report prints where the
+ * time of a recorded session went: the wire, the device, the host, per
+ * opcode the latency beside the device's own time. replay sends its host
+ * bytes to the board at the recorded times (--speed divides the gaps), or
+ * with --lockstep each one once the board has answered as much as it had
+ * then; it prints the replay's report, and --record keeps the replay.
+ * blsim --replay does the same against the simulated device.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "blhost/Aes.hpp"
+#include "blhost/Batch.hpp"
+#include "blhost/Benchmark.hpp"
+#include "blhost/BlockStore.hpp"
+#include "blhost/Codec.hpp"
+#include "blhost/Delta.hpp"
+#include "blhost/DeviceView.hpp"
+#include "blhost/Lz.hpp"
+#include "blhost/Flasher.hpp"
+#include "blhost/Manifest.hpp"
+#include "blhost/MappedFile.hpp"
+#include "blhost/Package.hpp"
+#include "blhost/Planner.hpp"
+#include "blhost/Session.hpp"
+#include "blhost/Symbols.hpp"
+
+namespace
+{
+
+void usage()
+{
+	std::fprintf(stderr,
+	             "usage: blflash -p <port> [-b <baud>] [--rtscts] [--crc-wordwise] [--response-crc] [--progress] [--record FILE]\n"
+	             "               [-v] <command>\n"
+	             "  version\n"
+	             "  erase  <address> <length> [--plan]\n"
+	             "  erase-image <address> <length> [--dry-run]\n"
+	             "  write  <address> <image.bin> [--window N] [--packet N] [--fixed] [--auto-erase] [--no-session] [--no-verify]\n"
+	             "         [-p <port> ...] [--log-dir <dir>]   several ports: flashed in parallel\n"
+	             "         [--encrypt KEYFILE]   AES-CTR ciphertext for a BL_DECRYPT_ENABLE bootloader\n"
+	             "         [--via-ram]   upload 64 KB windows to SRAM, programmed by BL_PROGRAM_FROM_RAM\n"
+	             "         [--codec auto|raw|lz]   raw stream or BL_MEM_WRITE_LZ, auto: the faster predicted\n"
+	             "  verify <address> <image.bin>\n"
+	             "  program <image.elf|.hex|.bin> [--base ADDR] [--dry-run] [--no-erase] [--cache DIR] [--store DIR]\n"
+	             "          [--line N] [--merge-gap N] [--min-skip N] [--min-fill N]\n"
+	             "  identify --store DIR\n"
+	             "  store-add <name> <image> --store DIR [--base ADDR]   (no port)\n"
+	             "  delta <installed> <target> --store DIR                (no port)\n"
+	             "  diff  <old.bin> <new.bin> [--thumb|--no-thumb] [--no-lz] [--threads N]   (no port)\n"
+	             "  write-delta <address> <source> <old.bin> <new.bin> [--thumb|--no-thumb] [--no-lz] [--threads N]\n"
+	             "         [--packet N] [--no-session] [--no-verify]\n"
+	             "  package <image> <out.pkg> [--base ADDR] [--block N] [--no-lz] [--signed] [--merge-gap N]   (no port)\n"
+	             "  sign-package <package.pkg> <signature.der|.raw>   (no port)\n"
+	             "  write-package <package.pkg> [--packet N] [--no-session] [--no-verify]\n"
+	             "  self-update <bootloader.bin> [--staging ADDR] [--signature FILE] [--packet N]\n"
+	             "  go     <address>\n"
+	             "  boot   [--reset]\n"
+	             "  ota    <image.bin>   inactive A/B slot, also from the running UserApp\n"
+	             "  app-info [<image.bin>]\n"
+	             "  loader <loader.bin>\n"
+	             "  stats  [--clear]\n"
+	             "  trace  [--from SEQUENCE]\n"
+	             "  crash  [--clear]\n"
+	             "  dump   <address> <length> [-o FILE] [--cache DIR] [--store DIR]\n"
+	             "  profile [--elf UserApp.elf] [--top N] [--clear]\n"
+	             "  latency [--clear]   scheduler dispatch latency of the running UserApp\n"
+	             "  bench  [--scratch SECTOR] [--iterations N] [--erase-sector N ...] [--image FILE]\n"
+	             "         [--format csv|json] [-o FILE]\n"
+	             "  replay <session> [--lockstep] [--speed X]\n"
+	             "  report <session>   (no port)\n");
+	std::exit(1);
+}
+
+std::uint32_t number(const char* text)
+{
+	char*         end   = nullptr;
+	unsigned long value = std::strtoul(text, &end, 0);
+
+	if (end == text || *end != '\0')
+	{
+		std::fprintf(stderr, "blflash: not a number: %s\n", text);
+		std::exit(1);
+	}
+
+	return static_cast<std::uint32_t>(value);
+}
+
+std::vector<std::uint8_t> readFile(const std::string& path)
+{
+	blhost::MappedFile file(path);
+
+	return std::vector<std::uint8_t>(file.data(), file.data() + file.size());
+}
+
+void writeFile(const std::string& path, const std::vector<std::uint8_t>& data)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+	file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+	if (!file.flush())
+	{
+		throw std::runtime_error("cannot write " + path);
+	}
+}
+
+/*
+ * SessionSaver
+ * ------------
+ * --record: the closing stats snapshot once the command is over, whether it
+ * returned or threw, then the Engine stopped and the session written.
+ */
+class SessionSaver
+{
+public:
+	SessionSaver(const std::string& path, bool snapshot, blhost::SessionLog& log, blhost::Engine& engine,
+	             blhost::Flasher& flasher)
+		: path_(path), snapshot_(snapshot), log_(log), engine_(engine), flasher_(flasher)
+	{
+	}
+
+	~SessionSaver()
+	{
+		if (path_.empty())
+		{
+			return;
+		}
+
+		try
+		{
+			if (snapshot_)
+			{
+				flasher_.stats();
+			}
+		}
+		catch (const std::exception&)
+		{
+			/* No statistics in this build, or the link is gone: the traffic is what matters */
+		}
+
+		engine_.stop();
+
+		try
+		{
+			log_.save(path_);
+			std::fprintf(stderr, "session: %zu events recorded to %s\n", log_.events.size(), path_.c_str());
+		}
+		catch (const std::exception& error)
+		{
+			std::fprintf(stderr, "blflash: %s\n", error.what());
+		}
+	}
+
+	SessionSaver(const SessionSaver&)            = delete;
+	SessionSaver& operator=(const SessionSaver&) = delete;
+
+private:
+	std::string         path_;
+	bool                snapshot_;
+	blhost::SessionLog& log_;
+	blhost::Engine&     engine_;
+	blhost::Flasher&    flasher_;
+};
+
+/* Predicts raw and LZ for the image on this link and returns the faster, or LZ for codec "lz" */
+blhost::CodecChoice chooseWriteCodec(blhost::Flasher& flasher, const blhost::MappedFile& image, unsigned baud,
+                                     std::size_t packetSize, const std::string& codec)
+{
+	constexpr std::size_t kProbeSize = 16 * 1024;
+
+	blhost::Capabilities caps = flasher.capabilities();
+	bool                 lz   = (caps.codecs & blhost::kCapsCodecWriteLz) != 0;
+	blhost::LinkModel    link;
+
+	/* Lowest of a few GET_VERSION round trips */
+	link.roundTripSeconds = 1.0;
+	for (int ping = 0; ping < 3; ping++)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		flasher.getVersion();
+		link.roundTripSeconds = std::min(link.roundTripSeconds,
+		                                 std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	link.bytesPerSecond = baud / 10.0;
+	link.packetSize     = std::min<std::size_t>(packetSize, caps.maxPayload - blhost::lzwrite::HeaderLength);
+	link.writeRate      = caps.lzWriteRate;
+
+	/* A device that has not decoded anything since its reset: a sample into SRAM, nothing erased */
+	if (lz && caps.lzDecodeRate == 0)
+	{
+		link.decodeRate = flasher.probeLz(image.data(), std::min(image.size(), kProbeSize)).lzDecodeRate;
+	}
+	else
+	{
+		link.decodeRate = caps.lzDecodeRate;
+	}
+
+	blhost::CodecChoice choice = blhost::chooseCodec(image.data(), image.size(), link, lz);
+
+	if (!choice.stream.empty())
+	{
+		std::fprintf(stderr, "lz: %zu -> %zu bytes (%.1f %%) in %.1f ms on the host, device decodes %u B/s\n", image.size(),
+		             choice.stream.size(), 100.0 * choice.stream.size() / image.size(), choice.compressSeconds * 1e3,
+		             link.decodeRate);
+	}
+	for (const blhost::CodecEstimate& estimate : choice.estimates)
+	{
+		std::fprintf(stderr, "%-3s: %zu wire bytes, predicted %.2f s (%.0f B/s)\n", blhost::codecName(estimate.codec),
+		             estimate.wireBytes, estimate.seconds, estimate.bytesPerSecond);
+	}
+
+	if (codec == "lz")
+	{
+		/* Not compressed yet without a decode rate; writeLz refuses a bootloader without the codec */
+		if (choice.stream.empty())
+		{
+			choice.stream = blhost::lzCompress(image.data(), image.size());
+			choice.estimates.push_back({ blhost::Codec::Lz, choice.stream.size(), 0.0, 0.0 });
+		}
+		choice.codec = blhost::Codec::Lz;
+	}
+
+	return choice;
+}
+
+int writeBoards(const std::vector<std::string>& ports, std::uint32_t address, const blhost::MappedFile& image,
+                const blhost::BatchOptions& options)
+{
+	std::vector<blhost::BoardResult> results = blhost::flashBoards(ports, address, image.data(), image.size(), options);
+	std::size_t failed = 0;
+
+	for (const auto& result : results)
+	{
+		std::printf("%-20s %-6s %7.2f s %5.0f B/s %3u retransmissions%s%s\n", result.port.c_str(),
+		            result.ok ? "OK" : "FAILED", result.seconds, result.ok ? image.size() / result.seconds : 0.0,
+		            result.retransmissions, result.ok ? "" : "  ", result.error.c_str());
+		failed += result.ok ? 0 : 1;
+	}
+
+	std::printf("%zu of %zu boards flashed\n", results.size() - failed, results.size());
+
+	return (failed != 0) ? 1 : 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> ports;
+	blhost::BatchOptions     options;
+	bool                     deviceProgress = false;
+	blhost::Engine::Options& engineOptions = options.engine;
+	blhost::StreamOptions&   streamOptions = options.stream;
+	bool                     plan = false;
+	blhost::PlanOptions      planOptions;
+	std::uint32_t            base   = 0x08000000u;
+	std::uint32_t            staging = blhost::selfupdate::StagingAddress;
+	bool                     dryRun = false;
+	bool                     verbose = false;
+	bool                     clearStats = false;
+	bool                     reset = false;
+	std::uint32_t            traceFrom  = 0;
+	std::string              elfPath;
+	std::size_t              top = 20;
+	std::string              cacheDirectory;
+	std::string              storeDirectory;
+	blhost::DeltaOptions     deltaOptions;
+	blhost::PackageOptions   packageOptions;
+	blhost::BenchOptions     benchOptions;
+	std::string              benchImage;
+	std::string              benchFormat = "csv";
+	std::string              outputPath;
+	std::string              keyPath;
+	std::string              signaturePath;
+	std::string              recordPath;
+	std::string              codec = "auto";
+	blhost::ReplayOptions    replayOptions;
+	std::vector<std::string> arguments;
+
+	for (int index = 1; index < argc; index++)
+	{
+		std::string option = argv[index];
+		bool        hasValue = (index + 1) < argc;
+
+		if ((option == "-p") && hasValue)            { ports.push_back(argv[++index]); }
+		else if ((option == "-b") && hasValue)       { options.baud = number(argv[++index]); }
+		else if (option == "--rtscts")               { options.flowControl = true; }
+		else if (option == "--crc-wordwise")         { engineOptions.crc = blhost::CrcMode::WordWise; }
+		else if (option == "--response-crc")         { engineOptions.responseCrc = true; }
+		else if (option == "--progress")             { deviceProgress = true; }
+		else if ((option == "--window") && hasValue) { streamOptions.window = number(argv[++index]); }
+		else if ((option == "--packet") && hasValue) { streamOptions.packetSize = number(argv[++index]); }
+		else if (option == "--auto-erase")           { streamOptions.autoErase = true; }
+		else if (option == "--no-session")           { streamOptions.session = false; }
+		else if (option == "--no-verify")            { streamOptions.verify = false; }
+		else if (option == "--via-ram")              { options.viaRam = true; }
+		else if ((option == "--codec") && hasValue)  { codec = argv[++index]; }
+		else if (option == "--fixed")                { streamOptions.adaptive = false; }
+		else if ((option == "--encrypt") && hasValue) { keyPath = argv[++index]; }
+		else if ((option == "--record") && hasValue) { recordPath = argv[++index]; }
+		else if (option == "--lockstep")             { replayOptions.lockstep = true; }
+		else if ((option == "--speed") && hasValue)  { replayOptions.speed = std::strtod(argv[++index], nullptr); }
+		else if (option == "-v")                     { verbose = true; }
+		else if (option == "--plan")                 { plan = true; }
+		else if (option == "--clear")                { clearStats = true; }
+		else if (option == "--reset")                { reset = true; }
+		else if ((option == "--from") && hasValue)   { traceFrom = number(argv[++index]); }
+		else if ((option == "--elf") && hasValue)    { elfPath = argv[++index]; }
+		else if ((option == "--top") && hasValue)    { top = number(argv[++index]); }
+		else if ((option == "--log-dir") && hasValue) { options.logDirectory = argv[++index]; }
+		else if ((option == "--base") && hasValue)   { base = number(argv[++index]); }
+		else if (option == "--dry-run")              { dryRun = true; }
+		else if (option == "--no-erase")             { planOptions.erase = false; }
+		else if ((option == "--cache") && hasValue)  { cacheDirectory = argv[++index]; }
+		else if ((option == "--store") && hasValue)  { storeDirectory = argv[++index]; }
+		else if (option == "--thumb")                { deltaOptions.thumb = blhost::ThumbFilter::On; }
+		else if (option == "--no-thumb")             { deltaOptions.thumb = blhost::ThumbFilter::Off; }
+		else if (option == "--no-lz")                { deltaOptions.compress = false; packageOptions.compress = false; }
+		else if ((option == "--block") && hasValue)  { packageOptions.blockSize = number(argv[++index]); }
+		else if (option == "--signed")               { packageOptions.sign = true; }
+		else if ((option == "--staging") && hasValue) { staging = number(argv[++index]); }
+		else if ((option == "--signature") && hasValue) { signaturePath = argv[++index]; }
+		else if ((option == "--threads") && hasValue) { deltaOptions.threads = number(argv[++index]); }
+		else if ((option == "--scratch") && hasValue) { benchOptions.scratchSector = number(argv[++index]); }
+		else if ((option == "--iterations") && hasValue) { benchOptions.iterations = number(argv[++index]); }
+		else if ((option == "--erase-sector") && hasValue) { benchOptions.eraseSectors.push_back(number(argv[++index])); }
+		else if ((option == "--image") && hasValue)  { benchImage = argv[++index]; }
+		else if ((option == "--format") && hasValue) { benchFormat = argv[++index]; }
+		else if ((option == "-o") && hasValue)       { outputPath = argv[++index]; }
+		else if ((option == "--line") && hasValue)   { planOptions.lineSize = number(argv[++index]); }
+		else if ((option == "--merge-gap") && hasValue) { planOptions.mergeGap = number(argv[++index]); }
+		else if ((option == "--min-skip") && hasValue)  { planOptions.minSkip = number(argv[++index]); }
+		else if ((option == "--min-fill") && hasValue)  { planOptions.minFill = number(argv[++index]); }
+		else if (option.rfind("-", 0) == 0)          { usage(); }
+		else                                         { arguments.push_back(option); }
+	}
+
+	if (verbose)
+	{
+		streamOptions.log = [](const std::string& line) { std::fprintf(stderr, "\n%s\n", line.c_str()); };
+	}
+
+	bool offline = !arguments.empty() && ((dryRun && arguments[0] == "program") || arguments[0] == "store-add" ||
+	                                      arguments[0] == "delta" || arguments[0] == "diff" || arguments[0] == "package" ||
+	                                      arguments[0] == "sign-package" || arguments[0] == "report");
+
+	if (arguments.empty() || (ports.empty() && !offline) || !(replayOptions.speed > 0.0) ||
+	    (codec != "auto" && codec != "raw" && codec != "lz") ||
+	    (storeDirectory.empty() && (arguments[0] == "identify" || arguments[0] == "store-add" || arguments[0] == "delta")))
+	{
+		usage();
+	}
+
+	try
+	{
+		std::unique_ptr<blhost::Image>  image;
+		std::unique_ptr<blhost::AesCtr> cipher;
+		blhost::Plan                    transfer;
+
+		/* One random counter block for the whole run: every board gets the same ciphertext */
+		if (!keyPath.empty())
+		{
+			cipher = std::make_unique<blhost::AesCtr>(blhost::AesCtr::loadKey(keyPath), blhost::AesCtr::randomCounter());
+			streamOptions.cipher = cipher.get();
+		}
+
+		if (arguments[0] == "store-add" && arguments.size() == 3)
+		{
+			blhost::BlockStore    store(storeDirectory);
+			std::size_t           added   = 0;
+			blhost::StoredVersion version = store.add(arguments[1], blhost::Image::load(arguments[2], base), &added);
+
+			std::printf("%s: %zu blocks at 0x%08X, %zu new\n", version.name.c_str(), version.blocks.size(), version.address, added);
+			return 0;
+		}
+		else if (arguments[0] == "delta" && arguments.size() == 3)
+		{
+			blhost::BlockStore                   store(storeDirectory);
+			std::optional<blhost::StoredVersion> installed = store.version(arguments[1]);
+			std::optional<blhost::StoredVersion> target    = store.version(arguments[2]);
+
+			if (!installed || !target)
+			{
+				std::fprintf(stderr, "blflash: no version %s in %s\n", (!installed ? arguments[1] : arguments[2]).c_str(),
+				             storeDirectory.c_str());
+				return 1;
+			}
+
+			blhost::BlockDelta delta = store.delta(*installed, *target);
+
+			std::printf("%zu of %zu blocks changed, %zu of them already on the device elsewhere, %zu bytes new\n",
+			            delta.changed.size(), target->blocks.size(), delta.moved, delta.newBytes);
+			for (std::size_t index : delta.changed)
+			{
+				std::printf("  0x%08X\n", target->address + static_cast<std::uint32_t>(index) * blhost::BlockStore::kBlockSize);
+			}
+			std::printf("unchanged sectors: 0x%03X\n", delta.unchangedSectors);
+			return 0;
+		}
+		else if (arguments[0] == "diff" && arguments.size() == 3)
+		{
+			blhost::MappedFile old(arguments[1]);
+			blhost::MappedFile wanted(arguments[2]);
+			auto               start = std::chrono::steady_clock::now();
+			blhost::Delta      delta = blhost::makeDelta(old.data(), old.size(), wanted.data(), wanted.size(), deltaOptions);
+			double             seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			std::printf("patch %zu bytes for %u (%.1f %%): %zu records, %zu extra bytes, %zu before LZ%s%s, %.2f s\n",
+			            delta.patch.size(), delta.targetLength, 100.0 * delta.patch.size() / std::max<std::size_t>(1, delta.targetLength),
+			            delta.records, delta.extraBytes, delta.recordBytes,
+			            (delta.flags & blhost::delta::FlagLz) ? ", LZ" : "", (delta.flags & blhost::delta::FlagThumb) ? ", Thumb filter" : "",
+			            seconds);
+			return 0;
+		}
+		else if (arguments[0] == "package" && arguments.size() == 3)
+		{
+			packageOptions.plan = planOptions;
+
+			std::vector<std::uint8_t>              package  = blhost::makePackage(blhost::Image::load(arguments[1], base), packageOptions);
+			std::optional<blhost::PackageContents> contents = blhost::unpackPackage(package);
+			std::size_t                            written  = 0;
+
+			for (const blhost::PackageSegment& segment : contents->segments)
+			{
+				std::printf("  0x%08X %7zu bytes, %7zu stored%s\n", segment.address, segment.data.size(), segment.storedBytes,
+				            (segment.codec == blhost::kPackageCodecLz) ? " (LZ)" : "");
+				written += segment.data.size();
+			}
+
+			writeFile(arguments[2], package);
+			std::printf("%s: %zu bytes for %zu, %zu segments, erase plan 0x%03X%s\n", arguments[2].c_str(), package.size(), written,
+			            contents->segments.size(), contents->eraseSectors, packageOptions.sign ? ", signature reserved" : "");
+
+			if (packageOptions.sign)
+			{
+				writeFile(arguments[2] + ".manifest", blhost::packageManifest(package));
+				std::printf("sign %s.manifest, then run sign-package\n", arguments[2].c_str());
+			}
+			return 0;
+		}
+		else if (arguments[0] == "sign-package" && arguments.size() == 3)
+		{
+			writeFile(arguments[1], blhost::signPackage(readFile(arguments[1]), readFile(arguments[2])));
+			std::printf("%s signed\n", arguments[1].c_str());
+			return 0;
+		}
+		else if (arguments[0] == "report" && arguments.size() == 2)
+		{
+			std::printf("%s", blhost::describeSession(blhost::analyzeSession(blhost::SessionLog::load(arguments[1]))).c_str());
+			return 0;
+		}
+		else if (arguments[0] == "store-add" || arguments[0] == "delta" || arguments[0] == "diff" || arguments[0] == "package" ||
+		         arguments[0] == "sign-package" || arguments[0] == "report")
+		{
+			usage();
+		}
+
+		if (arguments[0] == "program")
+		{
+			if (arguments.size() != 2)
+			{
+				usage();
+			}
+
+			image    = std::make_unique<blhost::Image>(blhost::Image::load(arguments[1], base));
+			transfer = blhost::planTransfer(*image, planOptions);
+
+			if (dryRun)
+			{
+				std::printf("%s, %zu segments\n%s", image->format(), image->segments().size(),
+				            blhost::describePlan(transfer).c_str());
+				return 0;
+			}
+		}
+
+		if (ports.size() > 1)
+		{
+			if (arguments[0] != "write" || arguments.size() != 3)
+			{
+				usage();
+			}
+
+			blhost::MappedFile image(arguments[2]);
+			return writeBoards(ports, number(arguments[1].c_str()), image, options);
+		}
+
+		blhost::SerialPort serial(ports[0], options.baud, options.flowControl);
+		const std::string& command = arguments[0];
+
+		/* The recording drives the port itself: no Engine */
+		if (command == "replay")
+		{
+			if (arguments.size() != 2)
+			{
+				usage();
+			}
+
+			blhost::SessionLog replayed = blhost::replaySession(blhost::SessionLog::load(arguments[1]), serial, replayOptions);
+
+			std::printf("%s", blhost::describeSession(blhost::analyzeSession(replayed)).c_str());
+			if (!recordPath.empty())
+			{
+				replayed.save(recordPath);
+			}
+			return 0;
+		}
+
+		blhost::SessionLog         session;
+		blhost::RecordingTransport recorder(serial, session);
+		blhost::Engine             engine(recordPath.empty() ? static_cast<blhost::Transport&>(serial) : recorder, engineOptions);
+		blhost::Flasher            flasher(engine);
+		bool                       snapshot = (command != "go" && command != "boot" && command != "loader" &&
+		                                       command != "self-update");
+
+		session.baud        = options.baud;
+		session.crc         = engineOptions.crc;
+		session.responseCrc = engineOptions.responseCrc;
+
+		SessionSaver saver(recordPath, snapshot, session, engine, flasher);
+
+		engine.start();
+
+		if (!recordPath.empty() && snapshot)
+		{
+			try
+			{
+				flasher.stats();
+			}
+			catch (const blhost::FlashError&)
+			{
+				/* Built without BL_STATS_ENABLE */
+			}
+		}
+
+		if (deviceProgress)
+		{
+			flasher.enableProgress(std::chrono::milliseconds(200), [](const blhost::DeviceProgress& progress) {
+				std::fprintf(stderr, "\r%s %3u %%, sector %u, %u / %u bytes", blhost::progressOperationName(progress.operation),
+				             unsigned(progress.percent), unsigned(progress.sector), progress.done, progress.total);
+			});
+		}
+
+		if (command == "version" && arguments.size() == 1)
+		{
+			std::printf("bootloader version %u\n", flasher.getVersion());
+		}
+		else if (command == "identify" && arguments.size() == 1)
+		{
+			std::vector<blhost::VersionMatch> matches = blhost::BlockStore(storeDirectory).identify(flasher);
+
+			for (std::size_t index = 0; index < matches.size() && index < 5; index++)
+			{
+				std::printf("%-32s %5zu / %5zu blocks%s\n", matches[index].name.c_str(), matches[index].matching,
+				            matches[index].blocks, matches[index].exact() ? "  installed" : "");
+			}
+
+			return (!matches.empty() && matches[0].exact()) ? 0 : 1;
+		}
+		else if (command == "erase" && arguments.size() == 3)
+		{
+			std::vector<std::uint8_t> results = flasher.eraseRange(number(arguments[1].c_str()), number(arguments[2].c_str()), plan);
+			int failed = 0;
+
+			for (std::size_t sector = 0; plan && sector < results.size(); sector++)
+			{
+				static const char* const names[] = { "-", "erased", "blank", "protected", "refused", "failed" };
+				std::uint8_t result = results[sector];
+
+				if (result != 0)
+				{
+					std::printf("sector %2zu: %s\n", sector, (result < 6) ? names[result] : "?");
+					failed += (result > 2) ? 1 : 0;
+				}
+			}
+
+			return (failed != 0) ? 1 : 0;
+		}
+		else if (command == "write" && arguments.size() == 3)
+		{
+			blhost::MappedFile image(arguments[2]);
+			auto start = std::chrono::steady_clock::now();
+
+			blhost::ProgressCallback progress = [](std::size_t done, std::size_t total) {
+				std::fprintf(stderr, "\r%zu / %zu bytes", done, total);
+			};
+
+			std::optional<blhost::CodecChoice> choice;
+
+			if (!options.viaRam && streamOptions.cipher == nullptr && codec != "raw")
+			{
+				choice = chooseWriteCodec(flasher, image, options.baud, streamOptions.packetSize, codec);
+			}
+
+			start = std::chrono::steady_clock::now();
+
+			if (options.viaRam)
+			{
+				flasher.writeViaRam(number(arguments[1].c_str()), image.data(), image.size(), streamOptions, progress);
+			}
+			else if (choice && choice->codec == blhost::Codec::Lz)
+			{
+				flasher.writeLz(number(arguments[1].c_str()), image.data(), image.size(), choice->stream, streamOptions, progress);
+			}
+			else
+			{
+				flasher.writeStream(number(arguments[1].c_str()), image.data(), image.size(), streamOptions, progress);
+			}
+
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			std::fprintf(stderr, "\n%zu bytes in %.2f s (%.0f B/s), %u retransmissions\n",
+			             image.size(), seconds, image.size() / seconds, flasher.lastRetransmissions());
+			if (choice)
+			{
+				std::fprintf(stderr, "%s: predicted %.0f B/s, actual %.0f B/s (erase and verify included)\n",
+				             blhost::codecName(choice->codec), choice->chosen().bytesPerSecond, image.size() / seconds);
+			}
+		}
+		else if (command == "write-delta" && arguments.size() == 5)
+		{
+			blhost::MappedFile old(arguments[3]);
+			blhost::MappedFile wanted(arguments[4]);
+			blhost::Delta      delta = blhost::makeDelta(old.data(), old.size(), wanted.data(), wanted.size(), deltaOptions);
+			auto               start = std::chrono::steady_clock::now();
+
+			flasher.writeDelta(number(arguments[1].c_str()), number(arguments[2].c_str()), delta, wanted.data(), streamOptions,
+			                   [](std::size_t done, std::size_t total) { std::fprintf(stderr, "\r%zu / %zu patch bytes", done, total); });
+
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			std::fprintf(stderr, "\n%u bytes rebuilt from a %zu byte patch in %.2f s\n", delta.targetLength, delta.patch.size(), seconds);
+		}
+		else if (command == "write-package" && arguments.size() == 2)
+		{
+			std::vector<std::uint8_t> package = readFile(arguments[1]);
+			auto                      start   = std::chrono::steady_clock::now();
+
+			flasher.writePackage(package, streamOptions,
+			                     [](std::size_t done, std::size_t total) { std::fprintf(stderr, "\r%zu / %zu package bytes", done, total); });
+
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			std::fprintf(stderr, "\n%zu byte package written in %.2f s\n", package.size(), seconds);
+		}
+		else if (command == "self-update" && arguments.size() == 2)
+		{
+			std::vector<std::uint8_t> bootloader = readFile(arguments[1]);
+			std::vector<std::uint8_t> signature  = signaturePath.empty() ? std::vector<std::uint8_t>()
+			                                                             : blhost::rawSignature(readFile(signaturePath));
+
+			flasher.selfUpdate(bootloader, staging, signature, streamOptions,
+			                   [](std::size_t done, std::size_t total) { std::fprintf(stderr, "\r%zu / %zu staged bytes", done, total); });
+			std::fprintf(stderr, "\nbootloader of %zu bytes accepted, the board is replacing it and resets\n", bootloader.size());
+		}
+		else if (command == "verify" && arguments.size() == 3)
+		{
+			blhost::MappedFile image(arguments[2]);
+			blhost::CrcMode mode   = flasher.digestMode();
+			std::uint32_t expected = blhost::crc32(image.data(), image.size(), mode);
+			std::uint32_t actual   = flasher.rangeCrc(number(arguments[1].c_str()), static_cast<std::uint32_t>(image.size()), mode);
+
+			std::printf("device 0x%08X, image 0x%08X: %s\n", actual, expected, (actual == expected) ? "match" : "DIFFER");
+			return (actual == expected) ? 0 : 1;
+		}
+		else if (command == "program")
+		{
+			blhost::Manifest wanted = blhost::imageManifestOf(arguments[1], transfer);
+			std::unique_ptr<blhost::ManifestCache> cache;
+
+			if (!storeDirectory.empty())
+			{
+				blhost::BlockStore store(storeDirectory);
+				std::string        name   = arguments[1].substr(arguments[1].find_last_of('/') + 1);
+				blhost::StoredVersion target = store.add(name, *image);
+
+				std::vector<blhost::VersionMatch> matches = store.identify(flasher);
+
+				if (!matches.empty() && matches[0].exact())
+				{
+					planOptions.unchangedSectors = store.delta(*store.version(matches[0].name), target).unchangedSectors;
+					transfer = blhost::planTransfer(*image, planOptions);
+					std::fprintf(stderr, "installed: %s\n", matches[0].name.c_str());
+				}
+			}
+
+			if (!cacheDirectory.empty())
+			{
+				cache = std::make_unique<blhost::ManifestCache>(cacheDirectory);
+				wanted.uniqueId = flasher.deviceInfo().uniqueIdHex();
+
+				std::uint16_t unchanged = blhost::findUnchangedSectors(flasher, wanted, cache->load(wanted.uniqueId));
+
+				if (unchanged == blhost::sectorsOf(wanted))
+				{
+					cache->store(wanted);
+					std::printf("%s: up to date\n", wanted.uniqueId.c_str());
+					return 0;
+				}
+
+				planOptions.unchangedSectors |= unchanged;
+				transfer = blhost::planTransfer(*image, planOptions);
+			}
+
+			flasher.execute(transfer, streamOptions, [](std::size_t done, std::size_t total) {
+				std::fprintf(stderr, "\r%zu / %zu bytes", done, total);
+			});
+			std::fprintf(stderr, "\n%zu bytes sent, %zu filled, %zu skipped, %zu unchanged, %u retransmissions\n",
+			             transfer.writeBytes, transfer.fillBytes, transfer.skippedBytes, transfer.unchangedBytes,
+			             flasher.lastRetransmissions());
+
+			/* Only after the verify passed */
+			if (cache)
+			{
+				cache->store(wanted);
+			}
+		}
+		else if (command == "bench" && arguments.size() == 1 && (benchFormat == "csv" || benchFormat == "json"))
+		{
+			if (!benchImage.empty())
+			{
+				image    = std::make_unique<blhost::Image>(blhost::Image::load(benchImage, base));
+				transfer = blhost::planTransfer(*image, planOptions);
+				benchOptions.plan = &transfer;
+			}
+
+			benchOptions.log = [](const std::string& line) { std::fprintf(stderr, "%s\n", line.c_str()); };
+
+			blhost::BenchReport report = blhost::runBenchmarks(engine, flasher, benchOptions);
+			report.baud = options.baud;
+
+			std::string text = (benchFormat == "json") ? blhost::benchJson(report) : blhost::benchCsv(report);
+			std::FILE*  file = outputPath.empty() ? stdout : std::fopen(outputPath.c_str(), "w");
+
+			if (file == nullptr)
+			{
+				std::fprintf(stderr, "blflash: cannot write %s\n", outputPath.c_str());
+				return 1;
+			}
+
+			std::fputs(text.c_str(), file);
+			if (file != stdout)
+			{
+				std::fclose(file);
+			}
+		}
+		else if (command == "go" && arguments.size() == 2)
+		{
+			flasher.goTo(number(arguments[1].c_str()));
+		}
+		else if (command == "boot" && arguments.size() == 1)
+		{
+			std::fprintf(stderr, "%s\n", flasher.resetAndBoot(reset) ? "application started" : "resetting into the application");
+		}
+		else if (command == "ota" && arguments.size() == 2)
+		{
+			blhost::MappedFile image(arguments[1]);
+			auto start = std::chrono::steady_clock::now();
+
+			flasher.writeSlot(image.data(), image.size(), 1024,
+			                  [](std::size_t done, std::size_t total) { std::fprintf(stderr, "\r%zu / %zu bytes", done, total); });
+
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			std::fprintf(stderr, "\n%zu bytes in %.2f s, slot activated\n", image.size(), seconds);
+			std::fprintf(stderr, "%s\n", flasher.resetAndBoot(true) ? "application started" : "resetting into the new slot");
+		}
+		else if (command == "loader" && arguments.size() == 2)
+		{
+			blhost::MappedFile image(arguments[1]);
+
+			flasher.startLoader(image.data(), image.size(), streamOptions);
+			std::fprintf(stderr, "loader started at 0x%08X\n", blhost::kRamRunBase);
+		}
+		else if (command == "stats" && arguments.size() == 1)
+		{
+			blhost::DeviceStats stats = flasher.stats(clearStats);
+			double              usPerCycle = stats.coreClockHz ? 1e6 / stats.coreClockHz : 0.0;
+
+			std::printf("rx %u bytes, tx %u bytes, %u CRC failures, %u UART errors, core %u Hz\n", stats.rxBytes,
+			            stats.txBytes, stats.crcFailures, stats.uartErrors, stats.coreClockHz);
+			if (stats.uart)
+			{
+				std::printf("uart: %u overrun, %u framing, %u noise, %u parity, %u DMA; RX ring peak %u of %u bytes\n",
+				            stats.uart->overrun, stats.uart->framing, stats.uart->noise, stats.uart->parity, stats.uart->dma,
+				            stats.uart->ringHighWater, stats.uart->ringSize);
+			}
+			if (stats.memory && stats.memory->stackSize != 0)
+			{
+				std::printf("memory: stack peak %u of %u bytes, heap peak %u of %u bytes%s\n", stats.memory->stackPeak,
+				            stats.memory->stackSize, stats.memory->heapPeak, stats.memory->heapSize,
+				            stats.memory->stackPeak >= stats.memory->stackSize ? " (stack reserve exhausted)" : "");
+			}
+			if (stats.masking)
+			{
+				std::printf("irq: %u masked sections, longest %.1f us\n", stats.masking->sections,
+				            stats.masking->maxCycles * usPerCycle);
+			}
+			std::printf("opcode    count     mean_us      max_us  nacks\n");
+
+			for (const blhost::CommandStats& entry : stats.commands)
+			{
+				std::printf("  0x%02X %9u %11.1f %11.1f %6u\n", entry.opcode, entry.count,
+				            entry.totalCycles * usPerCycle / entry.count, entry.maxCycles * usPerCycle, entry.nacks);
+			}
+
+			if (stats.flash)
+			{
+				static const char* const classes[blhost::kFlashClasses] = { "16 KB", "64 KB", "128 KB" };
+
+				std::printf("flash      op        count     mean_us      p99_us      max_us\n");
+
+				for (std::size_t index = 0; index < blhost::kFlashClasses; index++)
+				{
+					const blhost::FlashHistogram* histograms[] = { &stats.flash->program[index], &stats.flash->erase[index] };
+
+					for (const blhost::FlashHistogram* histogram : histograms)
+					{
+						std::uint64_t count = histogram->operations();
+
+						if (count != 0)
+						{
+							std::printf("  %-7s  %-7s %7llu %11.1f %11u %11u\n", classes[index],
+							            (histogram == histograms[0]) ? "program" : "erase", static_cast<unsigned long long>(count),
+							            static_cast<double>(histogram->totalUs) / count, histogram->percentileUs(0.99),
+							            histogram->maxUs);
+						}
+					}
+				}
+			}
+		}
+		else if (command == "trace" && arguments.size() == 1)
+		{
+			blhost::DeviceTrace trace = flasher.trace(traceFrom);
+			std::uint32_t       end    = trace.head;   /* Not the events this readout records itself */
+			std::uint32_t       origin = trace.events.empty() ? 0 : trace.events.front().cycles;
+			double              usPerCycle = trace.coreClockHz ? 1e6 / trace.coreClockHz : 0.0;
+
+			std::printf("%u events recorded, %u held, core %u Hz\n", trace.head, trace.depth, trace.coreClockHz);
+			std::printf("sequence        time_us  event          arg0        arg1\n");
+
+			while (!trace.events.empty())
+			{
+				for (const blhost::TraceEvent& event : trace.events)
+				{
+					std::printf("%8u %14.1f  %-13s %5u  0x%08X\n", event.sequence,
+					            static_cast<std::uint32_t>(event.cycles - origin) * usPerCycle,
+					            blhost::traceEventName(event.event), event.arg0, event.arg1);
+				}
+
+				if (trace.events.back().sequence + 1 >= end)
+				{
+					break;
+				}
+				trace = flasher.trace(trace.events.back().sequence + 1);
+			}
+		}
+		else if (command == "erase-image" && arguments.size() == 3)
+		{
+			static const char* const names[] = { "-", "erased", "blank", "protected", "refused", "failed", "planned" };
+			blhost::ImageErasePlan result = flasher.eraseForImage(number(arguments[1].c_str()), number(arguments[2].c_str()), dryRun);
+
+			std::printf("%s, %u ms expected%s\n", (result.method == 0) ? "already blank" : "sector erase",
+			            result.estimateMs, (result.status != 0) ? ", refused" : "");
+			for (std::size_t sector = 0; sector < result.results.size(); sector++)
+			{
+				std::uint8_t state = result.results[sector];
+
+				if (state != 0)
+				{
+					std::printf("sector %2zu: %s\n", sector, (state < 7) ? names[state] : "?");
+				}
+			}
+
+			return (result.status != 0) ? 1 : 0;
+		}
+		else if (command == "app-info" && (arguments.size() == 1 || arguments.size() == 2))
+		{
+			blhost::AppInfo info = flasher.appInfo();
+
+			for (std::size_t index = 0; index < info.slots.size(); index++)
+			{
+				const blhost::SlotInfo& slot = info.slots[index];
+
+				std::printf("slot %c%s: %-9s version 0x%08X build 0x%08X length %u crc 0x%08X security %u activation 0x%08X\n",
+				            static_cast<char>('A' + index), (index == info.activeSlot) ? "*" : " ",
+				            blhost::appStateName(slot.state), slot.version, slot.buildId, slot.length, slot.crc,
+				            slot.securityVersion, slot.activation);
+			}
+
+			if (arguments.size() == 2)
+			{
+				blhost::MappedFile image(arguments[1]);
+				bool               current = false;
+
+				if (image.size() >= blhost::kImageHeaderOffset + 16 && info.activeSlot < info.slots.size())
+				{
+					const blhost::SlotInfo& active = info.slots[info.activeSlot];
+
+					current = (active.state == blhost::appstate::Validated) &&
+					          (active.crc == blhost::getLe32(image.data() + blhost::kImageHeaderOffset + 12));
+				}
+				std::printf("%s: %s\n", arguments[1].c_str(), current ? "up to date" : "differs from the active slot");
+			}
+		}
+		else if (command == "crash" && arguments.size() == 1)
+		{
+			static const char* const faults[] = { "?", "?", "?", "HardFault", "MemManage", "BusFault", "UsageFault" };
+			static const char* const names[]  = { "r0", "r1", "r2", "r3", "r12", "lr", "pc", "xpsr" };
+			std::optional<blhost::CrashRecord> record = flasher.crashRecord(clearStats);
+
+			if (!record)
+			{
+				std::printf("no crash recorded\n");
+				return 0;
+			}
+
+			std::printf("%u fault(s), last: %s in the %s, %u cycles after reset\n", record->count,
+			            (record->fault < 7) ? faults[record->fault] : "?",
+			            (record->source == 1) ? "bootloader" : "application", record->cycles);
+			for (std::size_t index = 0; index < 8; index++)
+			{
+				std::printf("  %-4s 0x%08X%s", names[index], record->registers[index], ((index % 4) == 3) ? "\n" : "");
+			}
+			std::printf("  cfsr 0x%08X  hfsr 0x%08X  mmfar 0x%08X  bfar 0x%08X  exc_return 0x%08X\n", record->cfsr,
+			            record->hfsr, record->mmfar, record->bfar, record->excReturn);
+			std::printf("stack at 0x%08X:\n", record->sp);
+			for (std::size_t index = 0; index < record->stack.size(); index++)
+			{
+				std::printf("%s0x%08X%s", ((index % 4) == 0) ? "  " : " ", record->stack[index],
+				            (((index % 4) == 3) || (index + 1 == record->stack.size())) ? "\n" : "");
+			}
+		}
+		else if (command == "dump" && arguments.size() == 3)
+		{
+			std::uint32_t                       address = number(arguments[1].c_str());
+			std::uint32_t                       length  = number(arguments[2].c_str());
+			std::unique_ptr<blhost::BlockStore> store;
+			blhost::ViewOptions                 viewOptions;
+
+			if (!storeDirectory.empty())
+			{
+				store             = std::make_unique<blhost::BlockStore>(storeDirectory);
+				viewOptions.store = store.get();
+			}
+			viewOptions.cacheDirectory = cacheDirectory;
+
+			blhost::DeviceView        view(flasher, address, length, viewOptions);
+			std::vector<std::uint8_t> data(length);
+
+			view.read(address, data.data(), data.size());
+
+			if (outputPath.empty())
+			{
+				std::fwrite(data.data(), 1, data.size(), stdout);
+			}
+			else
+			{
+				writeFile(outputPath, data);
+			}
+
+			const blhost::ViewStats& stats = view.stats();
+
+			std::fprintf(stderr, "%zu pages read, %zu reused, %zu checked; %zu manifest requests\n", stats.pagesRead,
+			             stats.pagesReused, stats.pagesChecked, stats.manifests);
+		}
+		else if (command == "profile" && arguments.size() == 1)
+		{
+			std::optional<blhost::AppProfile> profile = flasher.appProfile(clearStats);
+
+			if (!profile)
+			{
+				std::printf("no profile recorded\n");
+				return 0;
+			}
+
+			std::unique_ptr<blhost::SymbolTable> symbols;
+			std::map<std::string, double>        totals;
+			double                               counted = profile->outside;
+			std::uint32_t                        bucketSize = 1u << profile->shift;
+			char                                 block[32];
+
+			if (!elfPath.empty())
+			{
+				symbols = std::make_unique<blhost::SymbolTable>(blhost::SymbolTable::load(elfPath));
+			}
+
+			for (std::size_t index = 0; index < profile->counts.size(); index++)
+			{
+				std::uint32_t address = profile->base + static_cast<std::uint32_t>(index << profile->shift);
+				double        count   = profile->counts[index];
+
+				if (count == 0)
+				{
+					continue;
+				}
+				counted += count;
+				std::snprintf(block, sizeof(block), "0x%08X", address);
+
+				/* Per halfword (a Thumb instruction): the functions share the bucket by their bytes in it */
+				for (std::uint32_t offset = 0; offset < bucketSize; offset += 2)
+				{
+					const blhost::Symbol* symbol = symbols ? symbols->find(address + offset) : nullptr;
+
+					totals[symbol ? symbol->name : std::string(block)] += count * 2 / bucketSize;
+				}
+			}
+			if (profile->outside != 0)
+			{
+				totals["(outside the code)"] += profile->outside;
+			}
+
+			std::vector<std::pair<std::string, double>> ranked(totals.begin(), totals.end());
+
+			std::sort(ranked.begin(), ranked.end(), [](const auto& left, const auto& right) { return left.second > right.second; });
+
+			std::printf("%u samples at %u Hz (%.0f s), %u-byte buckets from 0x%08X, %u halvings\n", profile->samples,
+			            profile->rateHz, profile->rateHz ? static_cast<double>(profile->samples) / profile->rateHz : 0.0,
+			            bucketSize, profile->base, profile->halvings);
+			for (std::size_t index = 0; index < ranked.size() && index < top && counted > 0; index++)
+			{
+				std::printf("%6.2f%%  %s\n", 100.0 * ranked[index].second / counted, ranked[index].first.c_str());
+			}
+		}
+		else if (command == "latency" && arguments.size() == 1)
+		{
+			/* APP_TASK_xxx and their APP_EVENT_xxx bits, UserApp main.h */
+			static const char* const tasks[] = { "USB_HOST", "CDC", "DEBOUNCE", "BUTTON", "HEARTBEAT",
+			                                     "UPDATE", "ACCEL", "OTA", "CLOCK", "PRE_ERASE" };
+			static const char* const events[][5] = {
+				{ "USB_IRQ", "USB_POLL" },
+				{ "CDC_RX", "BRIDGE_UP", "BRIDGE_DOWN" },
+				{ "B1", "button 1", "button 2", "button 3", "button 4" },
+				{ "BUTTON" },
+				{ "TIMER", "TELEMETRY" },
+				{ "MSC_READY", "MSC_DONE", "MSC_GONE", "UPDATE_PROGRAM", "UPDATE_RESET" },
+				{ "ACCEL_DATA" },
+				{ "OTA_RX", "OTA_STEP", "OTA_TX", "OTA_TIMEOUT", "OTA_RESTART" },
+				{ "CLOCK_CHANGE" },
+				{ "TIMER" },
+			};
+			blhost::SchedLatency first = flasher.schedLatency(0, 0);
+			double               usPerCycle = first.coreClockHz ? 1e6 / first.coreClockHz : 0.0;
+
+			std::printf("dispatch latency, core %u Hz\n", first.coreClockHz);
+			std::printf("event                       count      p50_us      p99_us    worst_us\n");
+
+			for (std::uint8_t task = 0; task < first.tasks; task++)
+			{
+				for (std::uint8_t bit = 0; bit < first.bits; bit++)
+				{
+					blhost::SchedLatency latency = (task == 0 && bit == 0) ? first : flasher.schedLatency(task, bit);
+					const char*          event   = (task < 10 && bit < 5) ? events[task][bit] : nullptr;
+					char                 name[32];
+
+					if (latency.total == 0)
+					{
+						continue;
+					}
+					if (task < 10 && event != nullptr)
+					{
+						std::snprintf(name, sizeof(name), "%s/%s", tasks[task], event);
+					}
+					else
+					{
+						std::snprintf(name, sizeof(name), "task %u bit %u", task, bit);
+					}
+					std::printf("  %-22s %9u %11.1f %11.1f %11.1f%s\n", name, latency.total,
+					            latency.percentileCycles(0.5) * usPerCycle, latency.percentileCycles(0.99) * usPerCycle,
+					            latency.worst * usPerCycle, (latency.halvings != 0) ? "  (halved)" : "");
+				}
+			}
+
+			if (clearStats)
+			{
+				flasher.clearSchedLatency();
+			}
+		}
+		else
+		{
+			usage();
+		}
+	}
+	catch (const blhost::FlashError& error)
+	{
+		std::fprintf(stderr, "blflash: %s", error.what());
+		if (error.status() >= 0)
+		{
+			std::fprintf(stderr, " (status 0x%02X)", error.status());
+		}
+		std::fprintf(stderr, "\n");
+		return 1;
+	}
+	catch (const std::exception& error)
+	{
+		std::fprintf(stderr, "blflash: %s\n", error.what());
+		return 1;
+	}
+
+	return 0;
+}
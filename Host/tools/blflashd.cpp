@@ -0,0 +1,246 @@
+/*
+ * blflashd
+ * --------
+ * Flashing daemon for production lines: keeps a warm session on every port
+ * (JobServer.hpp) and takes jobs over a local Unix socket.
+ *
+ *   blflashd -p /dev/ttyUSB0 [-p /dev/ttyUSB1 ...] [--socket PATH] [-b 115200] [--rtscts]
+ *            [--crc-wordwise] [--response-crc] [--window N] [--packet N] [--no-verify]
+ *            [--cache DIR] [--no-erase]
+ *
+ * One request per line, one reply line per request, any number of
+ * connections at once (each job waits for its station, not for the other
+ * connections); PORT is a port given with -p or "any":
+ *
+ *   write   PORT ADDRESS IMAGE.bin
+ *   verify  PORT ADDRESS IMAGE.bin
+ *   program PORT IMAGE [BASE]          .elf, .hex or .bin (at BASE, default 0x08000000)
+ *   info    PORT                       bootloader version, chip, unique ID
+ *   release PORT                       ends the session: the next job reopens it
+ *   ports                              "port warm|closed jobs-done queued" per port
+ *
+ * Replies: "ok PORT SECONDS message" or "error PORT message". Image paths
+ * are read by the daemon, so give absolute ones. For example:
+ *
+ *   echo "program any /srv/builds/app.elf" | socat - UNIX-CONNECT:/tmp/blflashd.sock
+ *
+ * The socket is created with the daemon's umask; it is meant for the line
+ * controller on the same host, not for a network.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "blhost/JobServer.hpp"
+
+namespace
+{
+
+void usage()
+{
+	std::fprintf(stderr,
+	             "usage: blflashd -p <port> [-p <port> ...] [--socket PATH] [-b <baud>] [--rtscts]\n"
+	             "                [--crc-wordwise] [--response-crc] [--window N] [--packet N] [--no-verify]\n"
+	             "                [--cache DIR] [--no-erase]\n");
+	std::exit(1);
+}
+
+bool number(const std::string& text, std::uint32_t& value)
+{
+	char* end = nullptr;
+
+	value = static_cast<std::uint32_t>(std::strtoul(text.c_str(), &end, 0));
+
+	return !text.empty() && *end == '\0';
+}
+
+/* One request line into a job; the reply line for a malformed one */
+bool parseJob(const std::string& line, blhost::Job& job, std::string& error)
+{
+	std::istringstream       fields(line);
+	std::vector<std::string> words;
+	std::string              word;
+
+	while (fields >> word)
+	{
+		words.push_back(word);
+	}
+
+	if (words.size() < 2)
+	{
+		error = "error - expected: COMMAND PORT ...";
+		return false;
+	}
+
+	const std::string& command = words[0];
+
+	job.port = (words[1] == "any") ? std::string() : words[1];
+
+	if ((command == "write" || command == "verify") && words.size() == 4 && number(words[2], job.address))
+	{
+		job.kind  = (command == "write") ? blhost::Job::Kind::Write : blhost::Job::Kind::Verify;
+		job.image = words[3];
+	}
+	else if (command == "program" && (words.size() == 3 || (words.size() == 4 && number(words[3], job.address))))
+	{
+		job.kind  = blhost::Job::Kind::Program;
+		job.image = words[2];
+		job.address = (words.size() == 4) ? job.address : 0x08000000u;
+	}
+	else if (command == "info" && words.size() == 2)
+	{
+		job.kind = blhost::Job::Kind::Info;
+	}
+	else if (command == "release" && words.size() == 2 && !job.port.empty())
+	{
+		job.kind = blhost::Job::Kind::Release;
+	}
+	else
+	{
+		error = "error " + words[1] + " malformed request";
+		return false;
+	}
+
+	return true;
+}
+
+void sendLine(int fd, std::string line)
+{
+	line += "\n";
+
+	for (std::size_t sent = 0; sent < line.size(); )
+	{
+		ssize_t count = ::send(fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+
+		if (count <= 0)
+		{
+			return;
+		}
+		sent += static_cast<std::size_t>(count);
+	}
+}
+
+/* Requests of one connection, in order, until the peer closes it */
+void serve(int fd, blhost::JobServer& server)
+{
+	std::string buffer;
+	char        chunk[512];
+	ssize_t     count;
+
+	while ((count = ::recv(fd, chunk, sizeof(chunk), 0)) > 0)
+	{
+		buffer.append(chunk, static_cast<std::size_t>(count));
+
+		for (std::size_t end = buffer.find('\n'); end != std::string::npos; end = buffer.find('\n'))
+		{
+			std::string line = buffer.substr(0, end);
+			blhost::Job job;
+			std::string error;
+
+			buffer.erase(0, end + 1);
+
+			if (line.find_first_not_of(" \t\r") == std::string::npos)
+			{
+				continue;
+			}
+
+			if (line.rfind("ports", 0) == 0)
+			{
+				std::string reply = "ok";
+
+				for (const auto& station : server.describe())
+				{
+					reply += " [" + station + "]";
+				}
+				sendLine(fd, reply);
+			}
+			else if (!parseJob(line, job, error))
+			{
+				sendLine(fd, error);
+			}
+			else
+			{
+				blhost::JobResult result = server.run(job);
+				char              seconds[32];
+
+				std::snprintf(seconds, sizeof(seconds), "%.2f", result.seconds);
+				sendLine(fd, result.ok ? ("ok " + result.port + " " + seconds + " " + result.message)
+				                       : ("error " + (result.port.empty() ? std::string("-") : result.port) + " " + result.message));
+			}
+		}
+	}
+
+	::close(fd);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> ports;
+	blhost::JobServerOptions options;
+	std::string              socketPath = "/tmp/blflashd.sock";
+	std::uint32_t            value;
+
+	for (int index = 1; index < argc; index++)
+	{
+		std::string option   = argv[index];
+		bool        hasValue = (index + 1) < argc;
+
+		if ((option == "-p") && hasValue)             { ports.push_back(argv[++index]); }
+		else if ((option == "--socket") && hasValue)  { socketPath = argv[++index]; }
+		else if ((option == "-b") && hasValue && number(argv[index + 1], value))      { options.board.baud = value; index++; }
+		else if (option == "--rtscts")                { options.board.flowControl = true; }
+		else if (option == "--crc-wordwise")          { options.board.engine.crc = blhost::CrcMode::WordWise; }
+		else if (option == "--response-crc")          { options.board.engine.responseCrc = true; }
+		else if ((option == "--window") && hasValue && number(argv[index + 1], value)) { options.board.stream.window = value; index++; }
+		else if ((option == "--packet") && hasValue && number(argv[index + 1], value)) { options.board.stream.packetSize = value; index++; }
+		else if (option == "--no-verify")             { options.board.stream.verify = false; }
+		else if ((option == "--cache") && hasValue)   { options.cacheDirectory = argv[++index]; }
+		else if (option == "--no-erase")              { options.plan.erase = false; }
+		else                                          { usage(); }
+	}
+
+	if (ports.empty() || socketPath.size() >= sizeof(sockaddr_un::sun_path))
+	{
+		usage();
+	}
+
+	blhost::JobServer server(ports, options);
+	sockaddr_un       address {};
+	int               listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+	address.sun_family = AF_UNIX;
+	socketPath.copy(address.sun_path, socketPath.size());
+	::unlink(socketPath.c_str());
+
+	if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+	    ::listen(listener, 16) != 0)
+	{
+		std::perror(("blflashd: " + socketPath).c_str());
+		return 1;
+	}
+
+	std::signal(SIGPIPE, SIG_IGN);
+	std::fprintf(stderr, "blflashd: %zu ports, listening on %s\n", ports.size(), socketPath.c_str());
+
+	for (;;)
+	{
+		int client = ::accept(listener, nullptr, nullptr);
+
+		if (client >= 0)
+		{
+			std::thread(serve, client, std::ref(server)).detach();
+		}
+	}
+}
@@ -0,0 +1,172 @@
+/*
+ * bllayout
+ * --------
+ * Keeps the UserApp's functions where the last build put them, for small
+ * delta updates (blflash diff / write-delta):
+ *
+ *   bllayout <file.map> <script.ld> [--reset] [--slack PERCENT]
+ *            [--min-slack BYTES] [--tail BYTES[K]] [--dry-run]
+ *
+ * Reads the stable layout in the linker script's .text (Layout.hpp), merges
+ * the functions of the map file the script linked, and writes the script
+ * back: the next link places every function that did not outgrow its
+ * module's slot at the address it had. A function linked since the last
+ * run lands in the tail reserve, after the slots, until the next one.
+ *
+ * Run it after a build that is to be released, and commit the script with
+ * the source: the next release is then linked against the same order.
+ * --reset packs the layout afresh, for a release shipped as a full image.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "blhost/Layout.hpp"
+#include "blhost/LinkerMap.hpp"
+
+namespace
+{
+
+struct Options
+{
+	std::string           map;
+	std::string           script;
+	bool                  reset  = false;
+	bool                  dryRun = false;
+	blhost::LayoutOptions layout;
+};
+
+void usage()
+{
+	std::fprintf(stderr, "usage: bllayout <file.map> <script.ld> [--reset] [--slack PERCENT] [--min-slack BYTES] "
+	                     "[--tail BYTES[K]] [--dry-run]\n");
+}
+
+bool parseBytes(const char* text, std::uint32_t& bytes)
+{
+	char*         end   = nullptr;
+	unsigned long value = std::strtoul(text, &end, 0);
+
+	if (end == text || (*end != '\0' && !((*end == 'K' || *end == 'k') && end[1] == '\0')))
+	{
+		return false;
+	}
+	bytes = static_cast<std::uint32_t>((*end != '\0') ? value * 1024u : value);
+	return true;
+}
+
+bool parse(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg   = argv[i];
+		bool        value = (i + 1) < argc;
+
+		if (arg == "--reset")
+		{
+			options.reset = true;
+		}
+		else if (arg == "--dry-run")
+		{
+			options.dryRun = true;
+		}
+		else if (arg == "--slack" && value)
+		{
+			options.layout.slackPercent = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0));
+		}
+		else if (arg == "--min-slack" && value)
+		{
+			if (!parseBytes(argv[++i], options.layout.minSlack))
+			{
+				return false;
+			}
+		}
+		else if (arg == "--tail" && value)
+		{
+			if (!parseBytes(argv[++i], options.layout.tail))
+			{
+				return false;
+			}
+		}
+		else if (arg.rfind("-", 0) != 0 && options.map.empty())
+		{
+			options.map = arg;
+		}
+		else if (arg.rfind("-", 0) != 0 && options.script.empty())
+		{
+			options.script = arg;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return !options.map.empty() && !options.script.empty();
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	if (!parse(argc, argv, options))
+	{
+		usage();
+		return 1;
+	}
+
+	try
+	{
+		blhost::LinkerMap  map = blhost::LinkerMap::load(options.map);
+		std::ifstream      in(options.script);
+		std::ostringstream text;
+
+		if (!in)
+		{
+			std::fprintf(stderr, "bllayout: %s: cannot open\n", options.script.c_str());
+			return 1;
+		}
+		text << in.rdbuf();
+		in.close();
+
+		blhost::StableLayout layout = blhost::StableLayout::parse(text.str());
+
+		if (options.reset)
+		{
+			layout.reset();
+		}
+
+		blhost::LayoutChanges changes = layout.update(map, options.layout);
+
+		std::printf("%zu slots, %u bytes, tail reserve to 0x%X\n", layout.slots().size(), layout.end(), layout.tailEnd());
+		std::printf("functions: %zu kept, %zu added, %zu moved, %zu removed; %zu new slots\n", changes.kept,
+		            changes.added, changes.moved, changes.removed, changes.newSlots);
+		for (const std::string& section : changes.movedSections)
+		{
+			std::printf("  moved %s\n", section.c_str());
+		}
+
+		if (!options.dryRun)
+		{
+			std::string   result = layout.apply(text.str());
+			std::ofstream out(options.script, std::ios::binary | std::ios::trunc);
+
+			if (!(out << result) || !out.flush())
+			{
+				std::fprintf(stderr, "bllayout: %s: cannot write\n", options.script.c_str());
+				return 1;
+			}
+		}
+		return 0;
+	}
+	catch (const std::exception& error)
+	{
+		std::fprintf(stderr, "bllayout: %s\n", error.what());
+		return 1;
+	}
+}
@@ -0,0 +1,378 @@
+/*
+ * blmount
+ * -------
+ * A board's memory as read-only files, fetched as they are read (FUSE):
+ *
+ *   blmount -p <port> [-b <baud>] [--rtscts] [--crc-wordwise] [--response-crc]
+ *           [--cache DIR] [--store DIR] [--cache-pages N] [--read-ahead N] [--max-age MS]
+ *           [--range NAME=ADDRESS:LENGTH[:live]]... <mountpoint> [FUSE options]
+ *
+ * Each file is a DeviceView (DeviceView.hpp) of one range: objdump, a log
+ * parser or a hex viewer then reads only the pages it touches, each checked
+ * against its block CRC first, so what the cache, --cache DIR or the block
+ * store of --store already holds is not read again. Without --range:
+ *
+ *   flash.bin     0x08000000, the size GET_DEVICE_INFO reports
+ *   sram.bin      0x20000000, 128 KB, live
+ *   ccmram.bin    0x10000000, 64 KB, live
+ *   bkpsram.bin   0x40024000, 4 KB, live
+ *
+ * A live file bypasses the kernel's page cache (so it is read, not
+ * mmap()ed), and its pages are checked again once older than --max-age
+ * (default 500 ms): a second read shows what changed, at a CRC per page
+ * for the rest. The flash is a snapshot, and can be mapped.
+ * Disassemble the flash with
+ *
+ *   arm-none-eabi-objdump -D -b binary -m arm -M force-thumb --adjust-vma=0x08000000 mnt/flash.bin
+ *
+ * blmount stays in the foreground (the engine's I/O thread would not
+ * survive a fork); unmount with fusermount3 -u or Ctrl-C. A range the
+ * bootloader does not read fails with EIO. Built when libfuse3 is found.
+ */
+
+#define FUSE_USE_VERSION 31
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <fuse.h>
+#include <sys/stat.h>
+
+#include "blhost/BlockStore.hpp"
+#include "blhost/DeviceView.hpp"
+#include "blhost/Engine.hpp"
+#include "blhost/Flasher.hpp"
+#include "blhost/Transport.hpp"
+
+namespace
+{
+
+struct Range
+{
+	std::string   name;
+	std::uint32_t address = 0;
+	std::uint32_t length  = 0;
+	bool          live    = false;
+};
+
+struct File
+{
+	std::string                         name;
+	bool                                live = false;
+	std::unique_ptr<blhost::DeviceView> view;
+};
+
+/* FUSE's private_data: one lock for the link and every view */
+struct Mount
+{
+	std::mutex        lock;
+	std::vector<File> files;
+};
+
+struct Options
+{
+	std::string                port;
+	unsigned                   baud        = 115200;
+	bool                       flowControl = false;
+	blhost::Engine::Options    engine;
+	std::string                cacheDirectory;
+	std::string                storeDirectory;
+	blhost::ViewOptions        view;
+	unsigned                   maxAgeMs    = 500;
+	std::vector<Range>         ranges;
+	std::vector<std::string>   fuse;         /* Mount point and FUSE options */
+};
+
+void usage()
+{
+	std::fprintf(stderr,
+	             "usage: blmount -p <port> [-b <baud>] [--rtscts] [--crc-wordwise] [--response-crc]\n"
+	             "               [--cache DIR] [--store DIR] [--cache-pages N] [--read-ahead N] [--max-age MS]\n"
+	             "               [--range NAME=ADDRESS:LENGTH[:live]]... <mountpoint> [FUSE options]\n");
+}
+
+bool parseRange(const std::string& text, Range& range)
+{
+	std::string::size_type equals = text.find('=');
+	char*                  end    = nullptr;
+
+	if (equals == 0 || equals == std::string::npos)
+	{
+		return false;
+	}
+
+	range.name    = text.substr(0, equals);
+	range.address = static_cast<std::uint32_t>(std::strtoul(text.c_str() + equals + 1, &end, 0));
+	if (*end != ':')
+	{
+		return false;
+	}
+	range.length = static_cast<std::uint32_t>(std::strtoul(end + 1, &end, 0));
+	range.live   = (std::strcmp(end, ":live") == 0);
+
+	return range.length != 0 && (*end == '\0' || range.live) && range.name.find('/') == std::string::npos;
+}
+
+bool parse(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg   = argv[i];
+		bool        value = (i + 1) < argc;
+
+		if (arg == "-p" && value)
+		{
+			options.port = argv[++i];
+		}
+		else if (arg == "-b" && value)
+		{
+			options.baud = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0));
+		}
+		else if (arg == "--rtscts")
+		{
+			options.flowControl = true;
+		}
+		else if (arg == "--crc-wordwise")
+		{
+			options.engine.crc = blhost::CrcMode::WordWise;
+		}
+		else if (arg == "--response-crc")
+		{
+			options.engine.responseCrc = true;
+		}
+		else if (arg == "--cache" && value)
+		{
+			options.cacheDirectory = argv[++i];
+		}
+		else if (arg == "--store" && value)
+		{
+			options.storeDirectory = argv[++i];
+		}
+		else if (arg == "--cache-pages" && value)
+		{
+			options.view.cachePages = std::strtoul(argv[++i], nullptr, 0);
+		}
+		else if (arg == "--read-ahead" && value)
+		{
+			options.view.readAhead = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0));
+		}
+		else if (arg == "--max-age" && value)
+		{
+			options.maxAgeMs = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0));
+		}
+		else if (arg == "--range" && value)
+		{
+			Range range;
+
+			if (!parseRange(argv[++i], range))
+			{
+				return false;
+			}
+			options.ranges.push_back(range);
+		}
+		else
+		{
+			options.fuse.push_back(arg);
+		}
+	}
+
+	return !options.port.empty() && options.baud != 0 && !options.fuse.empty();
+}
+
+Mount& mount()
+{
+	return *static_cast<Mount*>(fuse_get_context()->private_data);
+}
+
+File* find(const char* path)
+{
+	for (File& file : mount().files)
+	{
+		if (path[0] == '/' && file.name == path + 1)
+		{
+			return &file;
+		}
+	}
+	return nullptr;
+}
+
+int getattrFile(const char* path, struct stat* status, struct fuse_file_info*)
+{
+	std::memset(status, 0, sizeof(*status));
+
+	if (std::strcmp(path, "/") == 0)
+	{
+		status->st_mode  = S_IFDIR | 0555;
+		status->st_nlink = 2;
+		return 0;
+	}
+
+	File* file = find(path);
+
+	if (file == nullptr)
+	{
+		return -ENOENT;
+	}
+	status->st_mode  = S_IFREG | 0444;
+	status->st_nlink = 1;
+	status->st_size  = file->view->length();
+	return 0;
+}
+
+int readdirRoot(const char* path, void* buffer, fuse_fill_dir_t fill, off_t, struct fuse_file_info*,
+                enum fuse_readdir_flags)
+{
+	if (std::strcmp(path, "/") != 0)
+	{
+		return -ENOENT;
+	}
+
+	fill(buffer, ".", nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
+	fill(buffer, "..", nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
+	for (const File& file : mount().files)
+	{
+		fill(buffer, file.name.c_str(), nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
+	}
+	return 0;
+}
+
+int openFile(const char* path, struct fuse_file_info* info)
+{
+	File* file = find(path);
+
+	if (file == nullptr)
+	{
+		return -ENOENT;
+	}
+	if ((info->flags & O_ACCMODE) != O_RDONLY)
+	{
+		return -EACCES;
+	}
+
+	/* Every read of a live file reaches the view; the flash may stay in the kernel's cache */
+	info->direct_io  = file->live ? 1 : 0;
+	info->keep_cache = file->live ? 0 : 1;
+	return 0;
+}
+
+int readFile(const char* path, char* buffer, size_t size, off_t offset, struct fuse_file_info*)
+{
+	File* file = find(path);
+
+	if (file == nullptr)
+	{
+		return -ENOENT;
+	}
+	if (offset < 0 || static_cast<std::uint64_t>(offset) >= file->view->length())
+	{
+		return 0;
+	}
+
+	std::lock_guard<std::mutex> hold(mount().lock);
+
+	try
+	{
+		return static_cast<int>(file->view->read(file->view->base() + static_cast<std::uint32_t>(offset),
+		                                         reinterpret_cast<std::uint8_t*>(buffer), size));
+	}
+	catch (const std::exception& error)
+	{
+		std::fprintf(stderr, "blmount: %s at 0x%08X: %s\n", file->name.c_str(),
+		             file->view->base() + static_cast<std::uint32_t>(offset), error.what());
+		return -EIO;
+	}
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	if (!parse(argc, argv, options))
+	{
+		usage();
+		return 1;
+	}
+
+	try
+	{
+		blhost::SerialPort                  serial(options.port, options.baud, options.flowControl);
+		blhost::Engine                      engine(serial, options.engine);
+		blhost::Flasher                     flasher(engine);
+		std::unique_ptr<blhost::BlockStore> store;
+		Mount                               state;
+
+		engine.start();
+
+		if (!options.storeDirectory.empty())
+		{
+			store              = std::make_unique<blhost::BlockStore>(options.storeDirectory);
+			options.view.store = store.get();
+		}
+		options.view.cacheDirectory = options.cacheDirectory;
+
+		if (options.ranges.empty())
+		{
+			std::uint16_t flashKb = flasher.deviceInfo().flashSizeKb;
+
+			options.ranges = {
+				{ "flash.bin",   0x08000000u, (flashKb != 0) ? flashKb * 1024u : 0x100000u, false },
+				{ "sram.bin",    0x20000000u, 0x20000u, true },
+				{ "ccmram.bin",  0x10000000u, 0x10000u, true },
+				{ "bkpsram.bin", 0x40024000u, 0x1000u,  true },
+			};
+		}
+
+		for (const Range& range : options.ranges)
+		{
+			blhost::ViewOptions view = options.view;
+
+			view.maxAge = std::chrono::milliseconds(range.live ? options.maxAgeMs : 0u);
+			state.files.push_back({ range.name, range.live,
+			                        std::make_unique<blhost::DeviceView>(flasher, range.address, range.length, view) });
+		}
+
+		fuse_operations operations = {};
+
+		operations.getattr = getattrFile;
+		operations.readdir = readdirRoot;
+		operations.open    = openFile;
+		operations.read    = readFile;
+
+		/* Foreground, read-only, whatever else the caller passed */
+		std::vector<char*> fuseArguments = { argv[0], const_cast<char*>("-f"), const_cast<char*>("-o"),
+		                                     const_cast<char*>("ro") };
+
+		for (std::string& argument : options.fuse)
+		{
+			fuseArguments.push_back(&argument[0]);
+		}
+
+		int status = fuse_main(static_cast<int>(fuseArguments.size()), fuseArguments.data(), &operations, &state);
+
+		for (const File& file : state.files)
+		{
+			const blhost::ViewStats& stats = file.view->stats();
+
+			std::fprintf(stderr, "%s: %zu pages read, %zu reused, %zu checked\n", file.name.c_str(), stats.pagesRead,
+			             stats.pagesReused, stats.pagesChecked);
+		}
+
+		engine.stop();
+		return (status != 0) ? 1 : 0;
+	}
+	catch (const std::exception& error)
+	{
+		std::fprintf(stderr, "blmount: %s\n", error.what());
+		return 1;
+	}
+}
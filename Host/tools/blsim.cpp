@@ -0,0 +1,272 @@
+/*
+ * blsim
+ * -----
+ * Throughput regression test of the bootloader core on the host
+ * (Simulator.hpp): no board, simulated time, so the numbers only change
+ * when the firmware or the host library does.
+ *
+ *   blsim [-b 115200] [--size BYTES] [--address ADDR] [--window N ...] [--packet N ...]
+ *         [--min-rate BYTES_PER_S] [--record FILE] [-v]
+ *   blsim --replay FILE
+ *
+ * Writes the image (pseudo-random, --size bytes, default 64 KB) with
+ * BL_MEM_WRITE_STREAM once per window / packet pair, fixed, then once
+ * adaptive from the defaults, into the range at --address (default sector
+ * 11, erased first). Every run is verified. One CSV row per run:
+ *
+ *   mode,window,packet,bytes,sim_ms,bytes_per_s,wall_ms,retransmits,program_ops
+ *
+ * sim_ms is the simulated device time, bytes_per_s derives from it. Exit
+ * status 1 when a run fails or, with --min-rate, is slower than the bound.
+ *
+ * --record keeps the runs as a session (Session.hpp), timed with the
+ * simulated clock, with a stats snapshot before and after. --replay sends
+ * a recorded session, from blflash --record or from here, to the simulated
+ * device in lockstep and prints the report of the replay: a fixture's
+ * traffic against the core as it is in this tree, at the recording's baud
+ * rate.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "blhost/Flasher.hpp"
+#include "blhost/Session.hpp"
+#include "blhost/Simulator.hpp"
+
+namespace
+{
+
+struct Options
+{
+	unsigned              baud    = 115200;
+	std::size_t           size    = 64 * 1024;
+	std::uint32_t         address = 0x080E0000;
+	std::vector<unsigned> windows;
+	std::vector<unsigned> packets;
+	double                minRate = 0.0;
+	bool                  verbose = false;
+	std::string           recordPath;
+	std::string           replayPath;
+};
+
+struct Run
+{
+	bool        adaptive;
+	unsigned    window;
+	std::size_t packet;
+};
+
+void usage()
+{
+	std::fprintf(stderr,
+	             "usage: blsim [-b <baud>] [--size BYTES] [--address ADDR] [--window N ...] [--packet N ...]\n"
+	             "             [--min-rate BYTES_PER_S] [--record FILE] [-v]\n"
+	             "       blsim --replay FILE\n");
+}
+
+bool parse(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg   = argv[i];
+		bool        value = (i + 1) < argc;
+
+		if (arg == "-b" && value)
+		{
+			options.baud = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0));
+		}
+		else if (arg == "--size" && value)
+		{
+			options.size = std::strtoul(argv[++i], nullptr, 0);
+		}
+		else if (arg == "--address" && value)
+		{
+			options.address = static_cast<std::uint32_t>(std::strtoul(argv[++i], nullptr, 0));
+		}
+		else if (arg == "--window" && value)
+		{
+			options.windows.push_back(static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0)));
+		}
+		else if (arg == "--packet" && value)
+		{
+			options.packets.push_back(static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0)));
+		}
+		else if (arg == "--min-rate" && value)
+		{
+			options.minRate = std::strtod(argv[++i], nullptr);
+		}
+		else if (arg == "--record" && value)
+		{
+			options.recordPath = argv[++i];
+		}
+		else if (arg == "--replay" && value)
+		{
+			options.replayPath = argv[++i];
+		}
+		else if (arg == "-v")
+		{
+			options.verbose = true;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	if (options.windows.empty())
+	{
+		options.windows = { 1, 4, 8 };
+	}
+	if (options.packets.empty())
+	{
+		options.packets = { 256, 1024 };
+	}
+
+	return options.baud != 0 && options.size != 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	if (!parse(argc, argv, options))
+	{
+		usage();
+		return 1;
+	}
+
+	if (!options.replayPath.empty())
+	{
+		try
+		{
+			blhost::SessionLog    recorded = blhost::SessionLog::load(options.replayPath);
+			blhost::SimOptions    simOptions;
+			blhost::ReplayOptions replay;
+
+			simOptions.baud = recorded.baud;
+
+			blhost::SimulatedDevice device(simOptions);
+
+			replay.lockstep = true;
+			replay.clock    = [&device]() { return device.stats().nowNs; };
+
+			blhost::SessionReport report = blhost::analyzeSession(blhost::replaySession(recorded, device, replay));
+
+			std::printf("%s", blhost::describeSession(report).c_str());
+			return (report.unanswered != 0) ? 1 : 0;
+		}
+		catch (const std::exception& error)
+		{
+			std::fprintf(stderr, "blsim: %s\n", error.what());
+			return 1;
+		}
+	}
+
+	/* Same image every run (xorshift32) */
+	std::vector<std::uint8_t> image(options.size);
+	std::uint32_t             seed = 0x2545F491;
+
+	for (std::uint8_t& byte : image)
+	{
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		byte  = static_cast<std::uint8_t>(seed);
+	}
+
+	std::vector<Run> runs;
+
+	for (unsigned window : options.windows)
+	{
+		for (unsigned packet : options.packets)
+		{
+			runs.push_back({ false, window, packet });
+		}
+	}
+	runs.push_back({ true, blhost::StreamOptions().window, blhost::StreamOptions().packetSize });
+
+	int status = 0;
+
+	try
+	{
+		blhost::SimOptions simOptions;
+
+		simOptions.baud = options.baud;
+
+		blhost::SimulatedDevice    device(simOptions);
+		blhost::SessionLog         session;
+		blhost::RecordingTransport recorder(device, session, [&device]() { return device.stats().nowNs; });
+		blhost::Engine             engine(options.recordPath.empty() ? static_cast<blhost::Transport&>(device) : recorder);
+		blhost::Flasher            flasher(engine);
+
+		session.baud = options.baud;
+		engine.start();
+		if (!options.recordPath.empty())
+		{
+			flasher.stats();
+		}
+
+		std::printf("mode,window,packet,bytes,sim_ms,bytes_per_s,wall_ms,retransmits,program_ops\n");
+
+		for (const Run& run : runs)
+		{
+			blhost::StreamOptions stream;
+
+			stream.window     = run.window;
+			stream.packetSize = run.packet;
+			stream.adaptive   = run.adaptive;
+			if (options.verbose)
+			{
+				stream.log = [](const std::string& line) { std::fprintf(stderr, "%s\n", line.c_str()); };
+			}
+
+			/* The erase stays out of the measurement */
+			flasher.eraseRange(options.address, static_cast<std::uint32_t>(image.size()));
+
+			blhost::SimStats before = device.stats();
+			auto             start  = std::chrono::steady_clock::now();
+
+			flasher.writeStream(options.address, image, stream);
+
+			double           wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			blhost::SimStats after  = device.stats();
+			double           simMs  = (after.nowNs - before.nowNs) / 1e6;
+			double           rate   = (simMs > 0.0) ? (image.size() * 1e3 / simMs) : 0.0;
+
+			std::printf("%s,%u,%zu,%zu,%.3f,%.0f,%.1f,%u,%u\n", run.adaptive ? "adaptive" : "fixed", run.window,
+			            run.packet, image.size(), simMs, rate, wallMs, flasher.lastRetransmissions(),
+			            after.programOps - before.programOps);
+
+			if (options.minRate > 0.0 && rate < options.minRate)
+			{
+				std::fprintf(stderr, "blsim: %s window %u packet %zu: %.0f B/s below %.0f\n", run.adaptive ? "adaptive" : "fixed",
+				             run.window, run.packet, rate, options.minRate);
+				status = 1;
+			}
+		}
+
+		if (!options.recordPath.empty())
+		{
+			flasher.stats();
+		}
+		engine.stop();
+
+		if (!options.recordPath.empty())
+		{
+			session.save(options.recordPath);
+		}
+	}
+	catch (const std::exception& error)
+	{
+		std::fprintf(stderr, "blsim: %s\n", error.what());
+		return 1;
+	}
+
+	return status;
+}
@@ -0,0 +1,197 @@
+/*
+ * blsize
+ * ------
+ * Flash and RAM report of a firmware build from its GNU ld map file
+ * (<Configuration>/Bootloader.map or UserApp.map, written by every link).
+ *
+ *   blsize <file.map> [--top N] [--objects N] [--budget REGION=BYTES[K]]...
+ *
+ * First each memory region of the linker script, used against its budget:
+ * the region's length (for the bootloader's FLASH, sectors 0-1) unless a
+ * --budget narrows it. Then the --objects (default 15) objects by flash and
+ * the --top (default 20) functions and variables by size. Initialised data
+ * counts in both flash and RAM.
+ *
+ * Exits 1 when a region is over its budget, so that a build script or CI job
+ * can stop on it.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "blhost/LinkerMap.hpp"
+
+namespace
+{
+
+struct Options
+{
+	std::string                          map;
+	std::size_t                          top     = 20;
+	std::size_t                          objects = 15;
+	std::map<std::string, std::uint32_t> budgets;
+};
+
+struct Usage
+{
+	std::uint32_t flash = 0;
+	std::uint32_t ram   = 0;
+};
+
+void usage()
+{
+	std::fprintf(stderr, "usage: blsize <file.map> [--top N] [--objects N] [--budget REGION=BYTES[K]]...\n");
+}
+
+bool parseBudget(const std::string& text, Options& options)
+{
+	std::string::size_type equals = text.find('=');
+	char*                  end    = nullptr;
+
+	if (equals == 0 || equals == std::string::npos)
+	{
+		return false;
+	}
+
+	unsigned long bytes = std::strtoul(text.c_str() + equals + 1, &end, 0);
+
+	if (end == text.c_str() + equals + 1 || (*end != '\0' && !((*end == 'K' || *end == 'k') && end[1] == '\0')))
+	{
+		return false;
+	}
+	options.budgets[text.substr(0, equals)] = static_cast<std::uint32_t>((*end != '\0') ? bytes * 1024u : bytes);
+	return true;
+}
+
+bool parse(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg   = argv[i];
+		bool        value = (i + 1) < argc;
+
+		if (arg == "--top" && value)
+		{
+			options.top = std::strtoul(argv[++i], nullptr, 0);
+		}
+		else if (arg == "--objects" && value)
+		{
+			options.objects = std::strtoul(argv[++i], nullptr, 0);
+		}
+		else if (arg == "--budget" && value)
+		{
+			if (!parseBudget(argv[++i], options))
+			{
+				return false;
+			}
+		}
+		else if (options.map.empty() && arg.rfind("-", 0) != 0)
+		{
+			options.map = arg;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return !options.map.empty();
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	if (!parse(argc, argv, options))
+	{
+		usage();
+		return 1;
+	}
+
+	try
+	{
+		blhost::LinkerMap                        map     = blhost::LinkerMap::load(options.map);
+		const std::vector<blhost::MemoryRegion>& regions = map.regions();
+		bool                                     over    = false;
+
+		/* Regions against their budget */
+		std::printf("%-10s %9s %9s %7s\n", "region", "used", "budget", "use");
+
+		for (const blhost::MemoryRegion& region : regions)
+		{
+			auto          budget = options.budgets.find(region.name);
+			std::uint32_t limit  = (budget != options.budgets.end()) ? budget->second : region.length;
+
+			over = over || region.used > limit;
+
+			std::printf("%-10s %9u %9u %6.1f%%%s\n", region.name.c_str(), region.used, limit,
+			            (limit != 0) ? 100.0 * region.used / limit : 0.0, (region.used > limit) ? "  OVER BUDGET" : "");
+		}
+
+		for (const auto& budget : options.budgets)
+		{
+			if (std::none_of(regions.begin(), regions.end(),
+			                 [&](const blhost::MemoryRegion& region) { return region.name == budget.first; }))
+			{
+				std::fprintf(stderr, "blsize: no region %s in %s\n", budget.first.c_str(), options.map.c_str());
+				over = true;
+			}
+		}
+
+		/* Objects: flash is what runs from or loads out of a read-only region */
+		std::map<std::string, Usage> objects;
+
+		for (const blhost::MapEntry& entry : map.entries())
+		{
+			Usage& usage = objects[entry.object];
+			bool   ram   = regions[entry.region].writable;
+
+			(ram ? usage.ram : usage.flash) += entry.size;
+			if (entry.load >= 0 && !regions[entry.load].writable)
+			{
+				usage.flash += entry.size;
+			}
+		}
+
+		std::vector<std::pair<std::string, Usage>> ranked(objects.begin(), objects.end());
+
+		std::sort(ranked.begin(), ranked.end(), [](const auto& left, const auto& right) {
+			return (left.second.flash != right.second.flash) ? left.second.flash > right.second.flash
+			                                                 : left.second.ram > right.second.ram;
+		});
+
+		std::printf("\n%9s %9s  %s\n", "flash", "ram", "object");
+		for (std::size_t index = 0; index < ranked.size() && index < options.objects; index++)
+		{
+			std::printf("%9u %9u  %s\n", ranked[index].second.flash, ranked[index].second.ram, ranked[index].first.c_str());
+		}
+
+		/* Functions and variables */
+		std::vector<blhost::MapEntry> entries = map.entries();
+
+		std::stable_sort(entries.begin(), entries.end(),
+		                 [](const blhost::MapEntry& left, const blhost::MapEntry& right) { return left.size > right.size; });
+
+		std::printf("\n%9s %-10s %-10s  %s\n", "size", "region", "address", "name (object)");
+		for (std::size_t index = 0; index < entries.size() && index < options.top; index++)
+		{
+			const blhost::MapEntry& entry = entries[index];
+
+			std::printf("%9u %-10s 0x%08X  %s (%s)\n", entry.size, regions[entry.region].name.c_str(), entry.address,
+			            entry.name.c_str(), entry.object.c_str());
+		}
+
+		return over ? 1 : 0;
+	}
+	catch (const std::exception& error)
+	{
+		std::fprintf(stderr, "blsize: %s\n", error.what());
+		return 1;
+	}
+}
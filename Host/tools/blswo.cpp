@@ -0,0 +1,216 @@
+/*
+ * blswo
+ * -----
+ * Decoder of the bootloader's SWO stream (BL_ITM_ENABLE): a raw capture of
+ * the SWO pin, e.g. from OpenOCD's "tpiu config ... uart off <file>" or a
+ * USB-UART on PB3 at BL_ITM_SWO_BAUD, back into a timeline and a profile.
+ *
+ *   blswo <capture.bin | -> [--elf bootloader.elf] [--clock HZ] [--top N] [--no-events]
+ *
+ * First the trace events, one per line (Swo.hpp), time in µs from the first
+ * one at --clock (default 168 MHz):
+ *
+ *   sequence,time_us,event,arg0,arg1
+ *
+ * then, with the ELF, the --top (default 20) functions by PC samples, the
+ * share of samples with the core asleep and the overflows of the capture.
+ * Without it the samples are grouped by 256-byte block of the address.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "blhost/Swo.hpp"
+#include "blhost/Symbols.hpp"
+
+namespace
+{
+
+struct Options
+{
+	std::string   capture;
+	std::string   elf;
+	std::uint32_t clockHz = 168000000;
+	std::size_t   top     = 20;
+	bool          events  = true;
+};
+
+void usage()
+{
+	std::fprintf(stderr, "usage: blswo <capture.bin | -> [--elf bootloader.elf] [--clock HZ] [--top N] [--no-events]\n");
+}
+
+bool parse(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg   = argv[i];
+		bool        value = (i + 1) < argc;
+
+		if (arg == "--elf" && value)
+		{
+			options.elf = argv[++i];
+		}
+		else if (arg == "--clock" && value)
+		{
+			options.clockHz = static_cast<std::uint32_t>(std::strtoul(argv[++i], nullptr, 0));
+		}
+		else if (arg == "--top" && value)
+		{
+			options.top = std::strtoul(argv[++i], nullptr, 0);
+		}
+		else if (arg == "--no-events")
+		{
+			options.events = false;
+		}
+		else if (options.capture.empty() && (arg == "-" || arg.rfind("-", 0) != 0))
+		{
+			options.capture = arg;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return !options.capture.empty() && options.clockHz != 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	if (!parse(argc, argv, options))
+	{
+		usage();
+		return 1;
+	}
+
+	try
+	{
+		std::unique_ptr<blhost::SymbolTable> symbols;
+
+		if (!options.elf.empty())
+		{
+			symbols = std::make_unique<blhost::SymbolTable>(blhost::SymbolTable::load(options.elf));
+		}
+
+		std::FILE* file = (options.capture == "-") ? stdin : std::fopen(options.capture.c_str(), "rb");
+
+		if (file == nullptr)
+		{
+			std::fprintf(stderr, "blswo: cannot open %s\n", options.capture.c_str());
+			return 1;
+		}
+
+		blhost::SwoDecoder                   decoder;
+		blhost::TraceAssembler               assembler;
+		std::vector<blhost::SwoPacket>       packets;
+		std::map<std::uint32_t, std::size_t> samples;   /* PC -> count */
+		std::size_t                          sleeping  = 0;
+		std::size_t                          overflows = 0;
+		bool                                 first     = true;
+		std::uint32_t                        origin    = 0;
+		double                               usPerCycle = 1e6 / options.clockHz;
+		std::uint8_t                         buffer[4096];
+		std::size_t                          length;
+
+		if (options.events)
+		{
+			std::printf("sequence,time_us,event,arg0,arg1\n");
+		}
+
+		while ((length = std::fread(buffer, 1, sizeof(buffer), file)) != 0)
+		{
+			packets.clear();
+			decoder.feed(buffer, length, packets);
+
+			for (const blhost::SwoPacket& packet : packets)
+			{
+				if (packet.kind == blhost::SwoPacket::Kind::Overflow)
+				{
+					overflows++;
+					assembler.reset();
+				}
+				else if (packet.isPcSample())
+				{
+					if (packet.size == 4)
+					{
+						samples[packet.value]++;
+					}
+					else
+					{
+						sleeping++;
+					}
+				}
+				else if (std::optional<blhost::TraceEvent> event = assembler.add(packet))
+				{
+					if (first)
+					{
+						origin = event->cycles;
+						first  = false;
+					}
+					if (options.events)
+					{
+						std::printf("%u,%.2f,%s,%u,0x%08X\n", event->sequence,
+						            static_cast<std::uint32_t>(event->cycles - origin) * usPerCycle,
+						            blhost::traceEventName(event->event), event->arg0, event->arg1);
+					}
+				}
+			}
+		}
+
+		if (file != stdin)
+		{
+			std::fclose(file);
+		}
+
+		/* Profile: samples per function, or per 256-byte block without symbols */
+		std::map<std::string, std::size_t> totals;
+		std::size_t                        running = 0;
+		char                               block[32];
+
+		for (const auto& [pc, count] : samples)
+		{
+			const blhost::Symbol* symbol = symbols ? symbols->find(pc) : nullptr;
+
+			if (symbol != nullptr)
+			{
+				totals[symbol->name] += count;
+			}
+			else
+			{
+				std::snprintf(block, sizeof(block), "0x%08X", pc & ~0xFFu);
+				totals[block] += count;
+			}
+			running += count;
+		}
+
+		std::vector<std::pair<std::string, std::size_t>> ranked(totals.begin(), totals.end());
+
+		std::sort(ranked.begin(), ranked.end(), [](const auto& left, const auto& right) { return left.second > right.second; });
+
+		std::fprintf(stderr, "%zu PC samples (%zu asleep), %zu overflows, %u events dropped, %zu bytes skipped\n",
+		             running + sleeping, sleeping, overflows, assembler.dropped(), decoder.skippedBytes());
+
+		for (std::size_t index = 0; index < ranked.size() && index < options.top; index++)
+		{
+			std::fprintf(stderr, "%6.2f%%  %8zu  %s\n", 100.0 * ranked[index].second / (running + sleeping),
+			             ranked[index].second, ranked[index].first.c_str());
+		}
+	}
+	catch (const std::exception& error)
+	{
+		std::fprintf(stderr, "blswo: %s\n", error.what());
+		return 1;
+	}
+
+	return 0;
+}
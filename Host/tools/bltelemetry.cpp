@@ -0,0 +1,119 @@
+/*
+ * bltelemetry
+ * -----------
+ * Decoder of the UserApp's binary telemetry (App_Telemetry.h): a capture of
+ * USART2, e.g. "cat /dev/ttyUSB0 > capture.bin" at 115200 baud, or - to
+ * read it live from stdin, back into one line per sample:
+ *
+ *   bltelemetry <capture.bin | -> [--field NAME]...
+ *
+ *   time_ms,sequence,field,value
+ *
+ * time_ms is the UserApp's HAL_GetTick when the sample was taken. --field
+ * keeps only the named fields (telemetryFieldName). The frames, bad frames
+ * (CRC, framing, printf text) and frames lost to the UserApp's full queue go
+ * to stderr at the end.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "blhost/Telemetry.hpp"
+
+namespace
+{
+
+struct Options
+{
+	std::string              capture;
+	std::vector<std::string> fields;
+};
+
+void usage()
+{
+	std::fprintf(stderr, "usage: bltelemetry <capture.bin | -> [--field NAME]...\n");
+}
+
+bool parse(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg   = argv[i];
+		bool        value = (i + 1) < argc;
+
+		if (arg == "--field" && value)
+		{
+			options.fields.push_back(argv[++i]);
+		}
+		else if (options.capture.empty() && (arg == "-" || arg.rfind("-", 0) != 0))
+		{
+			options.capture = arg;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return !options.capture.empty();
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	if (!parse(argc, argv, options))
+	{
+		usage();
+		return 1;
+	}
+
+	std::FILE* file = (options.capture == "-") ? stdin : std::fopen(options.capture.c_str(), "rb");
+
+	if (file == nullptr)
+	{
+		std::fprintf(stderr, "bltelemetry: cannot open %s\n", options.capture.c_str());
+		return 1;
+	}
+
+	blhost::TelemetryDecoder            decoder;
+	std::vector<blhost::TelemetryFrame> frames;
+	std::uint8_t                        buffer[4096];
+	std::size_t                         length;
+
+	std::printf("time_ms,sequence,field,value\n");
+
+	while ((length = std::fread(buffer, 1, sizeof(buffer), file)) != 0)
+	{
+		frames.clear();
+		decoder.feed(buffer, length, frames);
+
+		for (const blhost::TelemetryFrame& frame : frames)
+		{
+			for (const blhost::TelemetrySample& sample : frame.samples)
+			{
+				std::string name = blhost::telemetryFieldName(sample.field);
+
+				if (!options.fields.empty() && std::find(options.fields.begin(), options.fields.end(), name) == options.fields.end())
+				{
+					continue;
+				}
+				std::printf("%u,%u,%s,%lld\n", sample.timeMs, frame.sequence, name.c_str(), static_cast<long long>(sample.value));
+			}
+		}
+		std::fflush(stdout);
+	}
+
+	if (file != stdin)
+	{
+		std::fclose(file);
+	}
+
+	std::fprintf(stderr, "%zu frames, %zu bad, %zu lost\n", decoder.frames(), decoder.badFrames(), decoder.lostFrames());
+
+	return 0;
+}
@@ -0,0 +1,58 @@
+#ifndef INC_APP_ACCEL_H_
+#define INC_APP_ACCEL_H_
+
+#include <stdint.h>
+
+/*
+ * LIS302DL Accelerometer on SPI1
+ * ------------------------------
+ * The sensor converts at 400 Hz and raises its data-ready on INT2 (PE1,
+ * EXTI1). The interrupt only starts one DMA burst on SPI1 (5.25 MHz, chip
+ * select CS_I2C_SPI held high between transfers): the read command with
+ * auto-increment and the X, Y and Z outputs in a single transaction. Its
+ * completion converts the sample to mg and pushes it into a ring the main
+ * loop drains with App_AccelRead, so the CPU never polls the sensor and
+ * never waits for the bus. Once the ring holds APP_ACCEL_NOTIFY_LEVEL
+ * samples, every completion signals APP_EVENT_ACCEL_DATA to APP_TASK_ACCEL.
+ *
+ * A ring with no room drops the new sample and counts it. A data-ready
+ * that rose during a burst has no edge left to trigger on, so the
+ * completion starts the next burst itself while the line is still high.
+ */
+#define APP_ACCEL_FIFO_SIZE          64u       /* Samples, power of two: 160 ms at 400 Hz */
+#define APP_ACCEL_MG_PER_DIGIT       18        /* Full scale +-2.3 g */
+#define APP_ACCEL_NOTIFY_LEVEL       16u       /* Samples: a task run every 40 ms */
+
+#if ((APP_ACCEL_FIFO_SIZE & (APP_ACCEL_FIFO_SIZE - 1u)) != 0u)
+#error "APP_ACCEL_FIFO_SIZE must be a power of two"
+#endif
+
+typedef struct
+{
+	int16_t X;                                  /* mg */
+	int16_t Y;
+	int16_t Z;
+} AppAccelSample_t;
+
+
+/*
+ * UserApp Accelerometer Functions
+ * -------------------------------
+ */
+
+uint8_t  App_AccelStart(void);                                           /* 1: LIS302DL found and converting */
+
+void     App_AccelStop(void);                                            /* Powers the sensor down */
+
+uint8_t  App_AccelRunning(void);
+
+void     App_AccelDataReady(void);                                       /* EXTI1 (MEMS_INT2) */
+
+uint16_t App_AccelRead(AppAccelSample_t* Samples, uint16_t Count);       /* Samples copied out of the ring */
+
+uint16_t App_AccelAvailable(void);
+
+uint32_t App_AccelDropped(void);                                         /* Samples lost to a full ring */
+
+
+#endif /* INC_APP_ACCEL_H_ */
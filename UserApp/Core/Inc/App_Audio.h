@@ -0,0 +1,53 @@
+#ifndef INC_APP_AUDIO_H_
+#define INC_APP_AUDIO_H_
+
+#include <stdint.h>
+#include "App_I2c.h"
+
+/*
+ * I2S3 Audio Output
+ * -----------------
+ * DMA1 Stream7 sends one statically allocated buffer to I2S3 (CS43L22) in
+ * circular mode, without ever stopping. The buffer is two halves: while the
+ * DMA plays one, the half-transfer and transfer complete interrupts have
+ * the other refilled, so the CPU is only asked for samples once per
+ * APP_AUDIO_HALF_FRAMES frames.
+ *
+ * The samples are pulled: the refill calls the source given to
+ * App_AudioStart for up to Frames interleaved stereo frames (left, right,
+ * 16 bits each) and it returns how many it wrote. It runs in the DMA
+ * interrupt, so it must be short and never wait; what it could not supply
+ * is played as silence and counted by App_AudioUnderruns. A source that
+ * needs the main loop (a decoder, a file) keeps its own ring filled from a
+ * task and only copies out of it here.
+ * The interrupt path runs from RAM (.RamFunc, vectors in SRAM), so a flash
+ * sector erase (pre-erase, update) does not hold the refill up, provided
+ * the source is __RAM_FUNC too and only touches RAM.
+ *
+ * The CS43L22 itself is configured over I2C1 by App_AudioCodecInit without
+ * waiting (App_I2c.h): it is left powered down, headphone output, I2S
+ * Philips 16 bits, and App_AudioStart powers it up once MCLK runs.
+ */
+#define APP_AUDIO_CHANNELS           2u
+#define APP_AUDIO_HALF_FRAMES        512u      /* 5.3 ms at 96 kHz, the refill deadline */
+
+#define APP_AUDIO_CODEC_ADDRESS      0x94u     /* CS43L22, AD0 low */
+
+typedef uint32_t (*AppAudioSource_t)(int16_t* Samples, uint32_t Frames);   /* Frames written */
+
+
+/*
+ * UserApp Audio Functions
+ * -----------------------
+ */
+
+uint8_t  App_AudioCodecInit(AppI2cDone_t Done);                          /* 1: register batch started, Done when written */
+
+uint8_t  App_AudioStart(AppAudioSource_t Source);                       /* 1: both halves filled, DMA running */
+
+void     App_AudioStop(void);
+
+uint32_t App_AudioUnderruns(void);                                       /* Refills the source left short */
+
+
+#endif /* INC_APP_AUDIO_H_ */
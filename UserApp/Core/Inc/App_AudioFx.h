@@ -0,0 +1,77 @@
+#ifndef INC_APP_AUDIO_FX_H_
+#define INC_APP_AUDIO_FX_H_
+
+#include <stdint.h>
+#include "App_Audio.h"
+
+/*
+ * Audio Processing Stage
+ * ----------------------
+ * EQ, volume and mixing of the I2S3 stream (App_Audio.h), applied by the
+ * refill to each half buffer as one block of APP_AUDIO_HALF_FRAMES frames,
+ * in the DMA interrupt, from RAM. Everything is 16-bit fixed point on the
+ * M4 DSP instructions (CMSIS core intrinsics), a stereo frame being one
+ * word (left in the low half):
+ *  - EQ: APP_AUDIO_FX_STAGES biquads per channel in cascade, Direct Form I,
+ *    coefficients Q2.14 (-2.0 .. 2.0), RBJ convention
+ *        y = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+ *    Three __SMLALD per sample on packed (sample, sample) / (coefficient,
+ *    coefficient) pairs into a 64-bit accumulator, as arm_biquad_cascade_df1_q15
+ *    does, then __SSAT to 16 bits. A stage with b0 = 1.0 and the rest 0 is
+ *    skipped.
+ *  - Volume and mix: per channel one __SMUAD of (sample, mix sample) with
+ *    (volume, mix gain), Q2.14 gains (unity APP_AUDIO_FX_UNITY, up to +6 dB),
+ *    then __SSAT. The mix source is pulled like the main one, into a RAM
+ *    block; whatever it leaves short is mixed as silence. At unity gains a
+ *    mix is one __QADD16 per frame, and a stage with nothing to do is not
+ *    run at all.
+ *
+ * Setters may be called from any task: they swap the values in with
+ * interrupts masked for a few instructions, so a block never sees half an
+ * update. The stage counts the cycles of every block (DWT->CYCCNT, started
+ * by the bootloader and by App_AudioFxInit), App_AudioFxGetStats gives the
+ * last and the worst block; cycles per sample = cycles / (2 x frames).
+ */
+#define APP_AUDIO_FX_STAGES          2u        /* Biquads per channel */
+
+#define APP_AUDIO_FX_UNITY           0x4000    /* 1.0 in Q2.14 */
+
+#define APP_AUDIO_FX_LEFT            0u
+#define APP_AUDIO_FX_RIGHT           1u
+
+typedef struct
+{
+	int16_t B0;
+	int16_t B1;
+	int16_t B2;
+	int16_t A1;
+	int16_t A2;
+} AppAudioFxBiquad_t;                          /* Q2.14, a0 normalized to 1 */
+
+typedef struct
+{
+	uint32_t LastCycles;                       /* Last block, source pulls excluded */
+	uint32_t MaxCycles;                        /* Worst block since App_AudioFxInit */
+	uint32_t Frames;                           /* Frames per block */
+} AppAudioFxStats_t;
+
+
+/*
+ * UserApp Audio Processing Functions
+ * ----------------------------------
+ */
+
+void    App_AudioFxInit(void);                                           /* Flat EQ, unity volume, no mix */
+
+uint8_t App_AudioFxSetBiquad(uint8_t Channel, uint8_t Stage, const AppAudioFxBiquad_t* Coefficients); /* 1: set, state cleared */
+
+void    App_AudioFxSetVolume(int16_t Left, int16_t Right);               /* Q2.14 gains, 0 mutes */
+
+void    App_AudioFxSetMix(AppAudioSource_t Source, int16_t Gain);        /* Second source, NULL: none */
+
+void    App_AudioFxProcess(int16_t* Samples, uint32_t Frames);          /* One block in place, from the refill */
+
+void    App_AudioFxGetStats(AppAudioFxStats_t* Stats);
+
+
+#endif /* INC_APP_AUDIO_FX_H_ */
@@ -0,0 +1,54 @@
+#ifndef INC_APP_BRIDGE_H_
+#define INC_APP_BRIDGE_H_
+
+#include <stdint.h>
+#include "App_Cdc.h"
+
+/*
+ * USB Host CDC to USART2 Bridge
+ * -----------------------------
+ * APP_CDC_BRIDGE builds pass the CDC device on the OTG FS host port
+ * through to USART2 and back, without copying a byte in either direction:
+ *  - USB to UART: APP_BRIDGE_DOWN_BUFFERS packet buffers taken in turn.
+ *    The receive callback queues the one the IN transfer filled and arms
+ *    the next free one; USART2 TX DMA sends the queued buffers in order,
+ *    straight out of them. With every buffer queued the IN transfer is not
+ *    re-armed, so the device is NAKed until the UART frees one: the
+ *    back-pressure reaches the device and nothing is dropped.
+ *  - UART to USB: USART2 RX DMA runs circular into a ring. Its half and
+ *    complete interrupts and the idle line publish what came in, and
+ *    USBH_CDC_Transmit sends it straight out of the ring, one contiguous
+ *    piece per transfer. Without RTS/CTS nothing holds the sender off: if
+ *    the USB falls a whole ring behind, or a receive error stops the DMA,
+ *    what was queued is dropped, counted by App_BridgeUpLost, and the ring
+ *    starts over.
+ * Both directions run at the speed of the slower link. The bridge holds
+ * USART2 from App_BridgeStart to App_BridgeStop (App_UartAttach): logging
+ * and App_UartSend are refused meanwhile.
+ */
+#define APP_BRIDGE_DOWN_BUFFERS      4u        /* Power of two */
+#define APP_BRIDGE_DOWN_SIZE         APP_CDC_RX_PACKET_SIZE
+#define APP_BRIDGE_UP_RING_SIZE      1024u     /* Power of two: 89 ms at 115200 baud */
+
+#if ((APP_BRIDGE_DOWN_BUFFERS & (APP_BRIDGE_DOWN_BUFFERS - 1u)) != 0u) || ((APP_BRIDGE_UP_RING_SIZE & (APP_BRIDGE_UP_RING_SIZE - 1u)) != 0u)
+#error "APP_BRIDGE_DOWN_BUFFERS and APP_BRIDGE_UP_RING_SIZE must be powers of two"
+#endif
+
+
+/*
+ * UserApp Bridge Functions
+ * ------------------------
+ */
+
+void     App_BridgeStart(void);                                          /* HOST_USER_CLASS_ACTIVE */
+
+void     App_BridgeStop(void);                                           /* HOST_USER_DISCONNECTION */
+
+void     App_BridgeTask(uint32_t Events);                                /* APP_TASK_CDC */
+
+void     App_BridgeRxIdle(void);                                         /* USART2 idle line, interrupt context */
+
+uint32_t App_BridgeUpLost(void);                                         /* UART bytes dropped so far */
+
+
+#endif /* INC_APP_BRIDGE_H_ */
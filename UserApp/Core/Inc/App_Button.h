@@ -0,0 +1,51 @@
+#ifndef INC_APP_BUTTON_H_
+#define INC_APP_BUTTON_H_
+
+#include <stdint.h>
+#include "main.h"
+
+/*
+ * Debounced Buttons
+ * -----------------
+ * A button's first edge (EXTI on both edges) masks its EXTI line and starts
+ * its one-shot scheduler timer; the bounce that follows raises no further
+ * interrupt. When the timer runs out, App_ButtonDebounceTask reads the pin:
+ * a level other than the last one taken is one transition, delivered as
+ * PressEvents or ReleaseEvents to the button's task, and the line is
+ * unmasked again. A contact that bounced back to where it was delivers
+ * nothing. An edge while the line was masked stays pending in EXTI and
+ * starts the next round as soon as it is unmasked.
+ *
+ * Each button has an EXTI line of its own (its pin number: PA0 and PE0
+ * cannot both be buttons) and a scheduler timer of its own.
+ */
+#define APP_BUTTON_MAX               4u
+#define APP_BUTTON_DEBOUNCE_MS       30u       /* Bounce of a tactile switch, with margin */
+
+typedef struct
+{
+	GPIO_TypeDef* Port;
+	uint16_t      Pin;                          /* GPIO_PIN_x, also its EXTI line */
+	GPIO_PinState PressedLevel;                 /* B1: GPIO_PIN_SET */
+	uint8_t       Timer;                        /* APP_TIMER_xxx */
+	uint8_t       Task;                         /* Gets the events below */
+	uint32_t      PressEvents;                  /* 0: none */
+	uint32_t      ReleaseEvents;
+} AppButton_t;
+
+
+/*
+ * UserApp Button Functions
+ * ------------------------
+ */
+
+uint8_t App_ButtonAdd(const AppButton_t* Button);                        /* 1: added; Button must stay in memory */
+
+void    App_ButtonEdge(uint16_t Pin);                                    /* From HAL_GPIO_EXTI_Callback */
+
+void    App_ButtonDebounceTask(uint32_t Events);                         /* APP_TASK_DEBOUNCE, bit n: button n */
+
+uint8_t App_ButtonIsPressed(uint8_t Index);                              /* Debounced, in App_ButtonAdd order */
+
+
+#endif /* INC_APP_BUTTON_H_ */
@@ -0,0 +1,42 @@
+#ifndef INC_APP_CDC_H_
+#define INC_APP_CDC_H_
+
+#include <stdint.h>
+
+/*
+ * USB Host CDC Receive Path
+ * -------------------------
+ * Two packet buffers take turns: USBH_CDC_ReceiveCallback arms the IN
+ * transfer into the other buffer before it copies the one just filled into
+ * the receive ring, and has the host task issue that transfer at once
+ * instead of at the next 1 ms poll. The ring has one producer (the
+ * callback, in the USB host task) and one consumer (App_CdcRead): each
+ * side writes only its own index, so neither needs interrupts off.
+ * APP_TASK_CDC is signalled APP_EVENT_CDC_RX whenever data came in.
+ */
+#define APP_CDC_RX_PACKET_SIZE       64u       /* Full-speed bulk packet */
+
+#define APP_CDC_RX_RING_SIZE         2048u     /* Power of two */
+
+#if ((APP_CDC_RX_RING_SIZE & (APP_CDC_RX_RING_SIZE - 1u)) != 0u)
+#error "APP_CDC_RX_RING_SIZE must be a power of two"
+#endif
+
+
+/*
+ * UserApp CDC Functions
+ * ---------------------
+ */
+
+void     App_CdcStart(void);                                             /* HOST_USER_CLASS_ACTIVE: first IN transfer */
+
+void     App_CdcStop(void);                                              /* HOST_USER_DISCONNECTION: no more re-arming */
+
+uint16_t App_CdcRead(uint8_t* Data, uint16_t Length);                  /* Bytes taken, up to Length */
+
+uint16_t App_CdcRxAvailable(void);                                       /* Bytes waiting in the ring */
+
+uint32_t App_CdcRxDropped(void);                                         /* Bytes lost to a full ring so far */
+
+
+#endif /* INC_APP_CDC_H_ */
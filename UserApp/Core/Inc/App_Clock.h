@@ -0,0 +1,69 @@
+#ifndef INC_APP_CLOCK_H_
+#define INC_APP_CLOCK_H_
+
+#include <stdint.h>
+
+/*
+ * Clock Profiles
+ * --------------
+ * The core runs at the highest profile any task asks for:
+ *  - APP_CLOCK_PROFILE_LOW, 16 MHz from the HSI, AHB and both APBs
+ *    undivided, flash with no wait state,
+ *  - APP_CLOCK_PROFILE_FULL, SystemClock_Config's 168 MHz from the PLL,
+ *    APB1 / 4, APB2 / 2, 5 wait states.
+ * App_ClockRequest and App_ClockRelease count each profile's users (any
+ * context, in pairs); the highest profile with users wins, LOW with none.
+ * The switch itself runs later, in App_ClockTask, between two tasks: a
+ * profile asked for is not in place yet when App_ClockRequest returns
+ * (App_ClockProfile says when it is).
+ *
+ * HAL_RCC_ClockConfig orders the change: more wait states before a faster
+ * clock, fewer after a slower one, the APB dividers never out of range,
+ * then SystemCoreClock and SysTick for the new HCLK. Everything else that
+ * counts on a bus clock hears of it through the listeners: asked first
+ * (APP_CLOCK_BEFORE), where any of them returning 0 (a transfer running)
+ * puts the switch off by APP_CLOCK_RETRY_MS, then told (APP_CLOCK_AFTER)
+ * to reprogram its dividers. Listeners run in App_ClockTask.
+ *
+ * The main PLL stays on at LOW unless APP_CLOCK_LOW_PLL_OFF: the OTG_FS
+ * core needs its 48 MHz to see a device connect, and FULL comes back
+ * without waiting for it to lock. I2S3 has PLLI2S of its own; with the
+ * PLL off, HSE stays on for it while PLLI2S runs.
+ */
+#define APP_CLOCK_DVFS_ENABLE        1u        /* 0 -> FULL throughout, requests only counted */
+#define APP_CLOCK_LOW_PLL_OFF        0u        /* 1 -> PLL (and HSE without PLLI2S) off at LOW, no USB host */
+#define APP_CLOCK_RETRY_MS           1u        /* A listener put the switch off */
+#define APP_CLOCK_START_MS           100u      /* HSE and PLL start-up, longest */
+#define APP_CLOCK_MAX_LISTENERS      4u
+
+#define APP_CLOCK_PROFILE_LOW        0u
+#define APP_CLOCK_PROFILE_FULL       1u
+#define APP_CLOCK_PROFILES           2u
+
+#define APP_CLOCK_BEFORE             0u        /* Listener: may the clock change? 1 yes, 0 not now */
+#define APP_CLOCK_AFTER              1u        /* Listener: the clock changed, HCLK Hz */
+
+typedef uint8_t (*AppClockListener_t)(uint8_t Phase, uint32_t Hz);
+
+
+/*
+ * UserApp Clock Functions
+ * -----------------------
+ */
+
+uint8_t  App_ClockAddListener(AppClockListener_t Listener);              /* Before App_ClockStart; 0 when all are taken */
+
+void     App_ClockStart(void);                                           /* After every listener: settles on the profile asked for */
+
+void     App_ClockRequest(uint8_t Profile);                              /* Any context: one more user of Profile */
+
+void     App_ClockRelease(uint8_t Profile);                              /* Any context: one user fewer */
+
+uint8_t  App_ClockProfile(void);                                         /* The profile in place */
+
+void     App_ClockResume(void);                                          /* After STOP (HSI, PLLs off): the profile in place, again */
+
+void     App_ClockTask(uint32_t Events);                                 /* APP_TASK_CLOCK */
+
+
+#endif /* INC_APP_CLOCK_H_ */
@@ -0,0 +1,63 @@
+#ifndef INC_APP_FAT_H_
+#define INC_APP_FAT_H_
+
+#include <stdint.h>
+
+/*
+ * FAT Reader
+ * ----------
+ * Read-only FAT16 / FAT32 on 512-byte sectors, no I/O of its own: each
+ * function decodes a sector the caller read (App_MscRead) and says which
+ * sector to read next. Enough to find a file by its 8.3 name in the root
+ * directory and follow its cluster chain:
+ *  - sector 0: App_FatVolumeLba (MBR with a FAT partition, or a drive
+ *    formatted without partition table), then its boot sector: App_FatMount,
+ *  - root directory sectors: App_FatFindFile (FAT16: a fixed area; FAT32:
+ *    a cluster chain like any file),
+ *  - FAT sectors: App_FatNextCluster for the cluster after a given one.
+ * FAT12 (volumes below about 16 MB) and long file names are not supported.
+ */
+#define APP_FAT_SECTOR_SIZE          512u
+
+#define APP_FAT_16                   16u
+#define APP_FAT_32                   32u
+
+#define APP_FAT_CHAIN_END            0xFFFFFFFFUL   /* App_FatNextCluster: last cluster, or a bad chain */
+
+/* App_FatFindFile */
+#define APP_FAT_FOUND                0u
+#define APP_FAT_NOT_HERE             1u        /* Not in this sector, go on with the next one */
+#define APP_FAT_END                  2u        /* End of the directory, no such file */
+
+typedef struct
+{
+	uint32_t FatLba;                            /* First sector of the first FAT */
+	uint32_t RootLba;                           /* FAT16: first root directory sector */
+	uint32_t RootSectors;                       /* FAT16: root directory sectors, 0 on FAT32 */
+	uint32_t RootCluster;                       /* FAT32: first root directory cluster */
+	uint32_t DataLba;                           /* Sector of cluster 2 */
+	uint32_t ClusterCount;
+	uint8_t  SectorsPerCluster;
+	uint8_t  Type;                              /* APP_FAT_16 / APP_FAT_32 */
+} AppFat_t;
+
+
+/*
+ * UserApp FAT Functions
+ * ---------------------
+ */
+
+uint8_t  App_FatVolumeLba(const uint8_t* Sector, uint32_t* Lba);                     /* 1: Lba of the boot sector */
+
+uint8_t  App_FatMount(AppFat_t* Fat, const uint8_t* Sector, uint32_t Lba);           /* 1: FAT16 / FAT32 boot sector decoded */
+
+uint32_t App_FatClusterLba(const AppFat_t* Fat, uint32_t Cluster);                   /* First sector of a data cluster */
+
+uint32_t App_FatEntryLba(const AppFat_t* Fat, uint32_t Cluster);                     /* FAT sector holding the cluster's entry */
+
+uint32_t App_FatNextCluster(const AppFat_t* Fat, const uint8_t* Sector, uint32_t Cluster); /* From that FAT sector */
+
+uint8_t  App_FatFindFile(const uint8_t* Sector, const char* Name, uint32_t* Cluster, uint32_t* Size); /* Name: 11 chars, "APP_B   BIN" */
+
+
+#endif /* INC_APP_FAT_H_ */
@@ -0,0 +1,67 @@
+#ifndef INC_APP_HUB_H_
+#define INC_APP_HUB_H_
+
+#include <stdint.h>
+#include "usbh_core.h"
+
+/*
+ * USB Host Hub With CDC Devices
+ * -----------------------------
+ * A host class for a full-speed hub on the root port, registered next to
+ * the CDC and MSC classes: the ST core enumerates the hub, this class does
+ * the rest. It powers the ports, reads the status change endpoint at its
+ * bInterval, and resets and enumerates each device that connects. The
+ * devices go one at a time, each at address 0 until SET_ADDRESS gives it
+ * hub address + port. A device with a CDC data interface (or any bulk or
+ * interrupt IN endpoint) then gets SET_CONFIGURATION and DTR / RTS on.
+ *
+ * Host channels are few (8, the ST core keeps 2 for the hub's control
+ * pipe), so the devices share theirs: one control pair for enumeration
+ * and hub requests, one IN and one OUT channel for every device's data.
+ * The IN channel goes round robin over the ready devices, one packet per
+ * turn, reopened on each device's address and endpoint with its saved
+ * data toggle:
+ *  - a device that sent data is due again at once, so a busy device gets
+ *    every turn nobody else needs,
+ *  - a NAK (or a bulk IN the hub did not answer within the frame) makes
+ *    it due again after bInterval, 1 ms for bulk endpoints without one,
+ *  - a device whose ring has no room for a packet is skipped, and left to
+ *    NAK: nothing is dropped.
+ * What comes in is kept per device in a ring (App_HubRead), and
+ * APP_TASK_CDC is signalled APP_EVENT_CDC_RX. The combined rate grows
+ * with the devices attached rather than stopping at one device's
+ * packet per poll. App_HubWrite queues one packet per device. The OUT
+ * channel takes the queued packets in turn.
+ *
+ * A device that fails to enumerate, or stalls, stays off until it is
+ * plugged in again; the others carry on. Without a hub the class is not
+ * used: a CDC device on the root port still goes to App_Cdc.h.
+ */
+#define APP_HUB_MAX_PORTS            4u        /* Ports served, devices 0 .. 3 on ports 1 .. 4 */
+#define APP_HUB_PACKET_SIZE          64u       /* Full-speed bulk packet, the largest IN taken */
+#define APP_HUB_RX_RING_SIZE         512u      /* Per device, power of two */
+#define APP_HUB_CONFIG_SIZE          128u      /* Configuration descriptor kept while enumerating */
+#define APP_HUB_CONTROL_TIMEOUT_MS   100u      /* One control transfer, all stages */
+
+#if ((APP_HUB_RX_RING_SIZE & (APP_HUB_RX_RING_SIZE - 1u)) != 0u)
+#error "APP_HUB_RX_RING_SIZE must be a power of two"
+#endif
+
+extern USBH_ClassTypeDef App_HubClass;
+
+
+/*
+ * UserApp Hub Functions
+ * ---------------------
+ */
+
+uint8_t  App_HubDevices(void);                                           /* Bit n: device n enumerated and polled */
+
+uint16_t App_HubRead(uint8_t Device, uint8_t* Data, uint16_t Length);  /* Bytes taken, up to Length */
+
+uint16_t App_HubRxAvailable(uint8_t Device);                             /* Bytes waiting in its ring */
+
+uint8_t  App_HubWrite(uint8_t Device, const uint8_t* Data, uint16_t Length); /* 1: queued, up to its OUT packet size */
+
+
+#endif /* INC_APP_HUB_H_ */
@@ -0,0 +1,43 @@
+#ifndef INC_APP_I2C_H_
+#define INC_APP_I2C_H_
+
+#include <stdint.h>
+
+/*
+ * I2C1 Register Batch Writer
+ * --------------------------
+ * App_I2cBatchStart takes a const table of (register, value) pairs for one
+ * device and returns at once: each pair is one interrupt-driven memory
+ * write, and its completion interrupt starts the next. The last one (or the
+ * first error: no acknowledge, lost arbitration) calls Done in interrupt
+ * context, so Done should only signal a task.
+ *
+ * A write is a single data byte, where a DMA transfer would cost more to
+ * set up than the five interrupts the HAL takes for it. The table must stay
+ * in memory until Done; a const table in flash does.
+ */
+#define APP_I2C_FAST_MODE            0u        /* 1 -> 400 kHz; the CS43L22 is specified up to 100 kHz */
+
+#define APP_I2C_OK                   0u
+#define APP_I2C_ERROR                1u
+
+typedef struct
+{
+	uint8_t Reg;
+	uint8_t Value;
+} AppI2cWrite_t;
+
+typedef void (*AppI2cDone_t)(uint8_t Status, uint16_t Written);      /* APP_I2C_xxx, pairs acknowledged */
+
+
+/*
+ * UserApp I2C Functions
+ * ---------------------
+ */
+
+uint8_t App_I2cBatchStart(uint16_t Address, const AppI2cWrite_t* Table, uint16_t Count, AppI2cDone_t Done); /* 1: started */
+
+uint8_t App_I2cBatchBusy(void);
+
+
+#endif /* INC_APP_I2C_H_ */
@@ -0,0 +1,82 @@
+#ifndef INC_APP_IMAGE_H_
+#define INC_APP_IMAGE_H_
+
+#include <stdint.h>
+
+/*
+ * Image Header and Bootloader Services
+ * ------------------------------------
+ * The UserApp's copies of the bootloader layouts it shares (IDE projects are
+ * separate): the header the bootloader checks before the jump, and the
+ * services table it exports at a fixed address. Entries are only ever
+ * appended to the table; check Version against the revision that added the
+ * entry before calling it.
+ */
+#define APP_HEADER_MAGIC        0x48494C42UL
+#define APP_HEADER_OFFSET       0x200u          /* From the slot base, after the vector table */
+
+#define APP_SERVICES            ((const AppServices_t*)0x08000200UL)
+#define APP_SERVICES_MAGIC      0x56534C42UL
+#define APP_SERVICES_VERSION_PRE_ERASE 2u  /* First table revision with InactiveSectors */
+#define APP_SERVICES_VERSION_ACTIVATE  3u  /* First table revision with ImageActivateUpdate */
+#define APP_SERVICES_VERSION_KV        4u  /* First table revision with the key/value store */
+
+#define APP_KV_INDEX_SLOTS      128u            /* BL_KV_INDEX_SLOTS */
+#define APP_KV_KEY_FIRST        0x0100u         /* Keys below belong to the bootloader */
+#define APP_KV_NOT_FOUND        0xFFFFu
+
+/* Image header checked by the bootloader before the jump, same layout as BL_ImageHeader_t (BL_Image.h) */
+typedef struct
+{
+	uint32_t    Magic;
+	uint32_t    Version;
+	const void* EndAddress;     /* First address after the image, from the linker script */
+	uint32_t    Crc;            /* Stamped after the build, 0xFFFFFFFF: not checked */
+	uint32_t    Validated;      /* Left erased, written by the bootloader */
+	uint32_t    Activated;      /* Left erased, A/B activation written by the bootloader */
+	uint32_t    SecurityVersion; /* Anti-rollback version (BL_ROLLBACK_ENABLE), raised to lock older builds out */
+	uint32_t    BuildId;        /* Build identifier (APP_BUILD_ID), for the host */
+} AppHeader_t;
+
+/* Key/value store context, same layout as BL_KV_t (BL_KV.h) */
+typedef struct
+{
+	uint32_t Base;
+	uint32_t End;
+	uint32_t Sequence;
+	uint16_t Keys;
+	uint16_t Reserved;
+	struct
+	{
+		uint16_t Key;
+		uint16_t Word;
+	} Index[APP_KV_INDEX_SLOTS];
+} AppKv_t;
+
+/* Bootloader services table, same layout as BL_Services_t (BL_Services.h); Sha256 contexts as BL_SHA256_t */
+typedef struct
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t (*Crc)(const uint8_t* Data, uint32_t Length);
+	uint8_t  (*FlashUnlock)(void);
+	void     (*FlashLock)(void);
+	uint8_t  (*FlashProgram)(uint32_t Address, const uint8_t* Data, uint32_t Length);
+	uint8_t  (*FlashEraseSector)(uint8_t Sector);
+	void     (*Sha256Start)(void* Context);
+	void     (*Sha256Update)(void* Context, const uint8_t* Data, uint32_t Length);
+	void     (*Sha256Finish)(const void* Context, uint8_t* Digest);
+	uint8_t  (*ImageIsValidated)(void);
+	uint8_t  (*InactiveSectors)(uint8_t* First, uint8_t* Count);   /* Version 2 */
+	uint8_t  (*FlashSectorIsBlank)(uint8_t Sector);                 /* Version 2, 1 = blank */
+	uint8_t  (*ImageActivateUpdate)(void);                          /* Version 3, A/B: the update slot boots next */
+	void     (*KvInit)(AppKv_t* Kv);                                /* Version 4 */
+	uint16_t (*KvGet)(const AppKv_t* Kv, uint16_t Key, void* Data, uint16_t Size); /* Version 4, length or APP_KV_NOT_FOUND */
+	uint8_t  (*KvSet)(AppKv_t* Kv, uint16_t Key, const void* Data, uint16_t Length); /* Version 4, 1 .. 256 bytes */
+	uint8_t  (*KvDelete)(AppKv_t* Kv, uint16_t Key);                /* Version 4 */
+} AppServices_t;
+
+extern const AppHeader_t App_Header;    /* This image's own header (main.c) */
+
+
+#endif /* INC_APP_IMAGE_H_ */
@@ -0,0 +1,45 @@
+#ifndef INC_APP_MSC_H_
+#define INC_APP_MSC_H_
+
+#include <stdint.h>
+#include "usbh_core.h"
+
+/*
+ * USB Host Mass Storage (Bulk-Only Transport, SCSI)
+ * -------------------------------------------------
+ * A host class for flash drives, registered next to the CDC class: LUN 0,
+ * 512-byte blocks, read only. Once enumerated the drive is polled with TEST
+ * UNIT READY until it answers, then READ CAPACITY(10) sizes it and
+ * APP_TASK_UPDATE is signalled APP_EVENT_MSC_READY.
+ *
+ * App_MscRead starts one READ(10) of up to APP_MSC_MAX_BLOCKS blocks and
+ * returns: the data stage is one multi-packet IN transfer straight into the
+ * caller's buffer, so the only per-command costs are the CBW and the CSW.
+ * Completion signals APP_EVENT_MSC_DONE, App_MscResult tells how it went.
+ * Unplugging signals APP_EVENT_MSC_GONE.
+ */
+#define APP_MSC_BLOCK_SIZE           512u
+#define APP_MSC_MAX_BLOCKS           32u       /* 16 KB: the most one host channel transfer carries */
+
+#define APP_MSC_OK                   0u
+#define APP_MSC_BUSY                 1u        /* Not ready, or a command is running */
+#define APP_MSC_ERROR                2u        /* Command failed, or the transport broke */
+
+extern USBH_ClassTypeDef App_MscClass;
+
+
+/*
+ * UserApp MSC Functions
+ * ---------------------
+ */
+
+uint8_t  App_MscIsReady(void);                                           /* 1: sized, no command running */
+
+uint32_t App_MscBlockCount(void);                                        /* Blocks on the drive, 0 before ready */
+
+uint8_t  App_MscRead(uint32_t Lba, uint16_t Blocks, uint8_t* Buffer);  /* APP_MSC_OK: started */
+
+uint8_t  App_MscResult(void);                                            /* Of the last App_MscRead */
+
+
+#endif /* INC_APP_MSC_H_ */
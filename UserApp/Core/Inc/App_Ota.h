@@ -0,0 +1,74 @@
+#ifndef INC_APP_OTA_H_
+#define INC_APP_OTA_H_
+
+#include <stdint.h>
+
+/*
+ * Background Update Over USART2
+ * -----------------------------
+ * The bootloader's own update commands, answered by the running application
+ * on USART2, so the transfer into the inactive A/B slot happens while the
+ * application keeps working and only the final reset is downtime:
+ *  - USART2 RX DMA runs circular into a ring (half, complete and idle-line
+ *    interrupts), the task takes frames out of it: v1 and extended, frame
+ *    CRC of the CRC unit with one byte per word (BL_CRC_WORDWISE_ENABLE 0),
+ *    replies in the bootloader's format without a CRC
+ *    (BL_RESPONSE_CRC_ENABLE 0), so blflash and the host library talk to
+ *    it as they do to the bootloader,
+ *  - the first good frame opens a session: the line is attached
+ *    (App_UartAttach), logging and telemetry are refused until it ends.
+ *    Before that, bytes that make no frame are dropped silently: the line
+ *    may carry a terminal. A session ends after APP_OTA_SESSION_TIMEOUT_MS
+ *    without a frame, at RESET_AND_BOOT, or never while a command runs,
+ *  - GET_VERSION, FLASH_ERASE, MEM_WRITE, SLOT_ACTIVATE and RESET_AND_BOOT,
+ *    and GET_SCHED_LATENCY (0x87), the scheduler's dispatch latency
+ *    histograms, which the bootloader lacks; anything else is NACKed. Only the sectors InactiveSectors names are
+ *    erased or written; one sector (blank ones cost a read scan only) or
+ *    APP_OTA_SLICE bytes per task run, the reply after the last, so the
+ *    other tasks keep their turns. Each erase still stalls the CPU for up
+ *    to 2 s,
+ *  - SLOT_ACTIVATE of the update slot has the bootloader check the image
+ *    and program its Activated word (ImageActivateUpdate), the handoff
+ *    flags the next boot goes by; RESET_AND_BOOT then restarts into it.
+ * Needs a services revision with ImageActivateUpdate and a validated image
+ * (on trial the inactive slot is the way back): otherwise the erase and
+ * write commands are refused. While a session is open, and from its first
+ * erase or write on until reset, the slot belongs to this module
+ * (App_OtaBusy): the USB update and the background pre-erase leave it
+ * alone. APP_CDC_BRIDGE builds lack it, the
+ * bridge owns USART2's receiver there.
+ *
+ * blflash ota <image.bin> runs the whole update (Flasher::writeSlot), the
+ * image built for the inactive slot.
+ */
+#define APP_OTA_ENABLE               1u        /* 0 -> USART2 RX stays off */
+#define APP_OTA_RX_RING_SIZE         1024u     /* Power of two: 89 ms at 115200 baud */
+#define APP_OTA_MAX_WRITE            1024u     /* MEM_WRITE data per frame */
+#define APP_OTA_FRAME_SIZE           (APP_OTA_MAX_WRITE + 16u)   /* Extended header, address, length, CRC */
+#define APP_OTA_SLICE                256u      /* Bytes programmed per task run, about 1 ms */
+#define APP_OTA_FRAME_TIMEOUT_MS     200u      /* A frame cut short this long is dropped */
+#define APP_OTA_SESSION_TIMEOUT_MS   10000u    /* BL_SESSION_TIMEOUT_MS */
+#define APP_OTA_VERSION              1u        /* GET_VERSION: the BL_VERSION these commands follow */
+
+#if ((APP_OTA_RX_RING_SIZE & (APP_OTA_RX_RING_SIZE - 1u)) != 0u)
+#error "APP_OTA_RX_RING_SIZE must be a power of two"
+#endif
+
+
+/*
+ * UserApp OTA Functions
+ * ---------------------
+ */
+
+void     App_OtaStart(void);                                             /* After MX_USART2_UART_Init: RX DMA on */
+
+void     App_OtaTask(uint32_t Events);                                   /* APP_TASK_OTA */
+
+void     App_OtaRxIdle(void);                                            /* USART2 idle line, interrupt context */
+
+void     App_OtaRxError(void);                                           /* Interrupt context: a UART error stopped the receiver */
+
+uint8_t  App_OtaBusy(void);                                              /* 1: session open, or the slot already touched */
+
+
+#endif /* INC_APP_OTA_H_ */
@@ -0,0 +1,53 @@
+#ifndef INC_APP_POOL_H_
+#define INC_APP_POOL_H_
+
+#include <stdint.h>
+
+/*
+ * Fixed-Block Pools
+ * -----------------
+ * malloc, free, calloc and realloc (and newlib's _malloc_r family, which
+ * printf and friends call) are served from statically sized pools of
+ * 32, 128, 512 and 2048-byte blocks instead of the _sbrk heap, so they are
+ * O(1), never fragment and never fail because of it: each class is a free
+ * list threaded through its unused blocks. A request takes a block of the
+ * smallest class that fits and, when that one is empty, of the next larger
+ * one. Interrupts are off for the few instructions of a list operation, so
+ * an interrupt may allocate too.
+ *
+ * The USB host (USBH_malloc, usbh_conf.h) allocates its class handle here.
+ * App_PoolGetStats reports the blocks in use and the high-water mark of
+ * each class, to size the counts below from a real run.
+ */
+#define APP_POOL_CLASSES             4u
+
+#define APP_POOL_32_COUNT            16u
+#define APP_POOL_128_COUNT           8u
+#define APP_POOL_512_COUNT           4u
+#define APP_POOL_2048_COUNT          2u
+
+typedef struct
+{
+	uint16_t BlockSize;
+	uint16_t Count;
+	uint16_t InUse;
+	uint16_t HighWater;                         /* Most blocks ever in use at once */
+	uint32_t Failures;                          /* Requests of this size no class could serve */
+} AppPoolStats_t;
+
+
+/*
+ * UserApp Pool Functions
+ * ----------------------
+ */
+
+void*    App_PoolAlloc(uint32_t Size);                                    /* NULL when no block fits */
+
+void     App_PoolFree(void* Block);                                       /* NULL and foreign pointers are ignored */
+
+uint32_t App_PoolBlockSize(const void* Block);                           /* 0 for a pointer outside the pools */
+
+uint8_t  App_PoolGetStats(uint8_t Class, AppPoolStats_t* Stats);          /* 0: no such class (0 = 32 bytes) */
+
+
+#endif /* INC_APP_POOL_H_ */
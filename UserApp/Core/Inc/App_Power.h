@@ -0,0 +1,48 @@
+#ifndef INC_APP_POWER_H_
+#define INC_APP_POWER_H_
+
+#include <stdint.h>
+
+/*
+ * Idle and Low Power
+ * ------------------
+ * App_SchedRun calls App_PowerIdle, interrupts masked, whenever no task has
+ * events, with the milliseconds until the first timer expires. Any
+ * interrupt ends the sleep at once; the return value is the whole
+ * milliseconds slept that SysTick did not count, for the scheduler to add
+ * to its timers and to HAL_GetTick.
+ *
+ * Tickless: instead of waking on every 1 ms SysTick only to find nothing
+ * due, SysTick is reloaded to fire when the first timer expires (at most
+ * about 99 ms at 168 MHz, its 24 bits), then put back on its millisecond
+ * phase after the wake-up. With USB polling running (a timer every 1 ms)
+ * this changes nothing; with a single heartbeat the core wakes about ten
+ * times a second rather than a thousand.
+ *
+ * STOP (APP_POWER_STOP_ENABLE): when the wait is at least
+ * APP_POWER_STOP_MIN_MS and nothing that STOP would halt is in use (UART,
+ * I2S, accelerometer, I2C, the update, the USB host), the core stops with
+ * the RTC wake-up timer (LSI) armed instead. PLL and HSE are off while
+ * stopped, and App_ClockResume restarts them, and the clock profile,
+ * before any interrupt runs. The LSI is measured against SysTick over the first second, its
+ * spread (17 to 47 kHz) would otherwise skew every timer. A USB device
+ * plugged in during STOP is only seen at the next wake-up.
+ */
+#define APP_POWER_TICKLESS           1u        /* 0 -> plain WFI, woken by every SysTick */
+#define APP_POWER_STOP_ENABLE        0u        /* 1 -> STOP mode in long idle periods */
+#define APP_POWER_STOP_MIN_MS        20u       /* Shorter waits: the clock restart costs more than it saves */
+
+#define APP_POWER_FOREVER            0xFFFFFFFFUL   /* App_PowerIdle: no timer running */
+
+
+/*
+ * UserApp Power Functions
+ * -----------------------
+ */
+
+void     App_PowerInit(void);                                            /* After the clock and SysTick are set up */
+
+uint32_t App_PowerIdle(uint32_t Ms);                                     /* Interrupts masked: sleeps, returns ms slept */
+
+
+#endif /* INC_APP_POWER_H_ */
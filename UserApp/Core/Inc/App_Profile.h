@@ -0,0 +1,70 @@
+#ifndef INC_APP_PROFILE_H_
+#define INC_APP_PROFILE_H_
+
+#include <stdint.h>
+
+/*
+ * Statistical PC-Sampling Profiler
+ * --------------------------------
+ * TIM7 interrupts every APP_PROFILE_PERIOD us (1988 Hz) and counts the PC it
+ * interrupted (the PC of its exception frame) in a histogram over the
+ * image's code, from the vector table to _etext, cut into APP_PROFILE_BUCKETS
+ * ranges of a power of two bytes: the smallest that covers the code (64
+ * bytes up to 87 KB of it), a few per function. PCs outside it (RAM
+ * functions, system memory) only count in Outside.
+ *  - the record lives in backup SRAM, between the bootloader's session
+ *    records and the crash record. It survives the reset into the
+ *    bootloader, which reads it back like any other memory (blflash profile
+ *    names the ranges from UserApp.elf). A boot with the same code size and
+ *    rate carries on counting, any other starts over; blflash profile
+ *    --clear starts over by hand (Magic 0),
+ *  - a count reaching 0xFFFF halves every count and Outside (Halvings), so
+ *    the shares stay right however long the unit runs. Samples is the raw
+ *    total,
+ *  - the period is a prime number of microseconds, so work done on the
+ *    scheduler's 1 ms timers is not hit at the same phase every time.
+ * The UserApp's interrupts all have the same priority and do not preempt
+ * each other: a sample due during a handler is taken as it returns, so
+ * handler time shows up on the code it interrupted. Time asleep counts on
+ * App_PowerIdle, where the core waits. About 60 cycles a sample, 0.1 % of
+ * the CPU at 168 MHz, but TIM7 also ends every sleep: the tickless idle of
+ * App_Power.h wakes every 0.5 ms instead of once per timer. Battery builds
+ * set APP_PROFILE_ENABLE to 0.
+ *
+ * The layout is read by Host/ (AppProfile in Protocol.hpp).
+ */
+#define APP_PROFILE_ENABLE           1u        /* 0 -> App_ProfileStart does nothing, TIM7 stays off */
+#define APP_PROFILE_PERIOD           503u      /* TIM7 counts, prime: no common phase with the 1 ms tick */
+#define APP_PROFILE_TIMER_HZ         1000000u  /* TIM7 counter clock */
+
+#define APP_PROFILE_ADDRESS          0x40024400UL   /* Backup SRAM + 1 KB, the session records stay below */
+#define APP_PROFILE_MAGIC            0x464F5250UL   /* "PROF" */
+#define APP_PROFILE_BUCKETS          1392u     /* Up to the crash record at 0x40024F00 */
+
+typedef struct
+{
+	uint32_t Magic;                            /* APP_PROFILE_MAGIC */
+	uint32_t Base;                             /* Address of bucket 0: the vector table */
+	uint32_t Shift;                            /* A bucket is 1 << Shift bytes */
+	uint32_t Buckets;                          /* In use, up to APP_PROFILE_BUCKETS */
+	uint32_t RateHz;                           /* Samples per second: APP_PROFILE_TIMER_HZ / APP_PROFILE_PERIOD */
+	uint32_t Samples;                          /* Taken since the record was started */
+	uint32_t Outside;                          /* PC outside the buckets, halved with them */
+	uint32_t Halvings;                         /* Times every count was halved */
+	uint16_t Count[APP_PROFILE_BUCKETS];
+} AppProfile_t;
+
+
+/*
+ * UserApp Profile Functions
+ * -------------------------
+ */
+
+void     App_ProfileStart(void);                                         /* After the clock is set up: resumes or clears the record, starts TIM7 */
+
+void     App_ProfileStop(void);                                          /* TIM7 off, the record kept */
+
+void     App_ProfileClear(void);                                         /* Every count back to 0 */
+
+
+#endif /* INC_APP_PROFILE_H_ */
@@ -0,0 +1,84 @@
+#ifndef INC_APP_SCHEDULER_H_
+#define INC_APP_SCHEDULER_H_
+
+#include <stdint.h>
+
+/*
+ * Run-to-Completion Scheduler
+ * ---------------------------
+ * Tasks are functions that run only when they have work: App_SchedSignal
+ * (from an interrupt or from another task) or a timer sets event bits for a
+ * task, App_SchedRun calls it with the bits gathered since its last run.
+ * Each task returns before the next one starts (no stacks, no preemption
+ * between tasks); the lowest task number with events runs first, and the
+ * scan starts over after every task. With nothing to run the core sleeps
+ * until the next interrupt or the first timer due (App_Power.h).
+ *
+ * Timers count in SysTick milliseconds (App_SchedTick from SysTick_Handler)
+ * and signal their task's events when they expire: once, or every period.
+ *
+ * Dispatch latency (APP_SCHED_LATENCY_ENABLE): an event bit below
+ * APP_SCHED_LATENCY_BITS is stamped with DWT->CYCCNT when it is signalled
+ * while not pending (a signal already waiting keeps its stamp: the oldest
+ * counts), and its wait is counted just before the task is called, in a
+ * histogram per task and bit:
+ *  - bucket 0 below 1 << APP_SCHED_LATENCY_SHIFT cycles (1.5 us at
+ *    168 MHz), bucket n from 1 << (SHIFT + n - 1) to twice that, the last
+ *    one open (from 25 ms on),
+ *  - a handler that calls App_SchedIsrEntry first has its signals stamped
+ *    at its entry, so the HAL's handler time before the callback counts
+ *    too: OTG_FS, USART2 and its RX DMA (DMA1 stream 5, half and full
+ *    ring), the accelerometer's SPI DMA. Timer events are stamped as they
+ *    expire, so the button's debounce wait is not in its latency,
+ *  - a count reaching 0xFFFF halves that event's counts (Halvings), as the
+ *    profiler does; Total and Worst are the raw dispatches and the longest
+ *    wait in cycles.
+ * About 30 cycles per signal and per dispatched event. The cycles are the
+ * core's: after a clock profile switch (App_Clock.h) they are of another
+ * length. App_Ota answers GET_SCHED_LATENCY with them (blflash latency).
+ */
+#define APP_SCHED_MAX_TASKS          10u       /* Task numbers 0 (first) .. 9 */
+
+#define APP_SCHED_MAX_TIMERS         8u
+
+#define APP_SCHED_LATENCY_ENABLE     1u        /* 0 -> no stamps, App_SchedLatency returns 0 */
+#define APP_SCHED_LATENCY_BITS       5u        /* Events 0 .. 4 of every task (main.h) */
+#define APP_SCHED_LATENCY_BUCKETS    16u
+#define APP_SCHED_LATENCY_SHIFT      8u        /* Bucket 0: below 256 cycles */
+
+typedef void (*AppTask_t)(uint32_t Events);   /* The events it was signalled since the last run */
+
+typedef struct
+{
+	uint32_t Total;                            /* Dispatches, not halved */
+	uint32_t Worst;                            /* Cycles, the longest wait */
+	uint32_t Halvings;                         /* Times every count was halved */
+	uint16_t Count[APP_SCHED_LATENCY_BUCKETS];
+} AppSchedLatency_t;
+
+
+/*
+ * UserApp Scheduler Functions
+ * ---------------------------
+ */
+
+void App_SchedSetTask(uint8_t Task, AppTask_t Run);                      /* Task numbers are the priorities */
+
+void App_SchedSignal(uint8_t Task, uint32_t Events);                     /* Any context: OR Events into the task's */
+
+void App_SchedTimerStart(uint8_t Timer, uint8_t Task, uint32_t Events, uint32_t FirstMs, uint32_t PeriodMs); /* PeriodMs 0: once */
+
+void App_SchedTimerStop(uint8_t Timer);                                  /* No expiry after this returns */
+
+void App_SchedTick(void);                                                /* From SysTick_Handler, every 1 ms it is not suppressed */
+
+void App_SchedRun(void);                                                 /* The main loop, never returns */
+
+void App_SchedIsrEntry(void);                                            /* First in a handler: its signals are stamped here (RAM) */
+
+const AppSchedLatency_t* App_SchedLatency(uint8_t Task, uint8_t Bit);    /* 0 past the table or without APP_SCHED_LATENCY_ENABLE */
+
+void App_SchedLatencyClear(void);                                        /* From a task: every histogram back to 0 */
+
+
+#endif /* INC_APP_SCHEDULER_H_ */
@@ -0,0 +1,71 @@
+#ifndef INC_APP_TELEMETRY_H_
+#define INC_APP_TELEMETRY_H_
+
+#include <stdint.h>
+
+/*
+ * Binary Telemetry on USART2
+ * --------------------------
+ * Samples are typed fields (App_TelemetryAdd) batched into one frame, which
+ * goes into the USART2 transmit queue every APP_TELEMETRY_PERIOD_MS
+ * (APP_TIMER_TELEMETRY, on the heartbeat task) or as soon as the batch is
+ * full. A frame before framing, little endian:
+ *     [version (1)] [sequence (2)] [timestamp (4, ms)] [records] [CRC (2)]
+ *  - a record is [field] [type] [value: 1, 2 or 4 bytes by type]. A mark
+ *    (field 0, APP_TLM_TYPE_MARK, 2 bytes) gives the ms from the frame's
+ *    timestamp to the records after it; records before the first mark are
+ *    at the timestamp itself. Samples taken in the same ms share one mark,
+ *  - the CRC is CRC-16/CCITT-FALSE of everything before it,
+ *  - the frame is then COBS encoded and sent between two 0x00, the only
+ *    zero bytes on the line: a receiver starting anywhere resynchronises on
+ *    the next one, and printf text in between fails the CRC and is skipped.
+ * The sequence counts every frame built, so a gap on the host is a frame
+ * the queue had no room for (App_TelemetryDropped). Host side: Telemetry.hpp
+ * and bltelemetry in Host/.
+ *
+ * For the tasks only, not for interrupts.
+ */
+#define APP_TELEMETRY_PERIOD_MS      1000u     /* Flush rate */
+#define APP_TELEMETRY_BATCH_SIZE     240u      /* Record bytes per frame */
+#define APP_TELEMETRY_VERSION        1u
+
+#define APP_TLM_TYPE_MARK            0u        /* uint16_t, ms after the timestamp */
+#define APP_TLM_TYPE_U8              1u
+#define APP_TLM_TYPE_I16             2u
+#define APP_TLM_TYPE_U16             3u
+#define APP_TLM_TYPE_I32             4u
+#define APP_TLM_TYPE_U32             5u
+
+/* Fields */
+#define APP_TLM_UPTIME               1u        /* U32, s */
+#define APP_TLM_CLOCK                2u        /* U8, once: 0 not 168 MHz, 1 kept from the bootloader, 2 set up here */
+#define APP_TLM_UART_DROPPED         3u        /* U32, bytes refused by the USART2 queue */
+#define APP_TLM_TELEMETRY_DROPPED    4u        /* U32, frames */
+#define APP_TLM_CDC_DROPPED          5u        /* U32, bytes */
+#define APP_TLM_AUDIO_UNDERRUNS      6u        /* U32, refills */
+#define APP_TLM_AUDIO_CYCLES         7u        /* U32, worst processing block (App_AudioFx.h) */
+#define APP_TLM_ACCEL_DROPPED        8u        /* U32, samples */
+#define APP_TLM_VIBE_CYCLES          9u        /* U32, worst block (App_Vibe.h) */
+#define APP_TLM_STACK_PEAK           10u       /* U32, bytes of the main stack ever used (MemoryUsage.h) */
+#define APP_TLM_HEAP_PEAK            11u       /* U32, bytes of the _sbrk heap ever used */
+#define APP_TLM_POOL_FIRST           12u       /* Pool class n at 12 + n: high-water mark (U16, App_Pool.h) */
+#define APP_TLM_VIBE_FIRST           16u       /* Axis n at 16 + 8 n: mean (I16), RMS, peak, frequency, amplitude (U16) */
+
+#define APP_TLM_VIBE_FIELD(Axis, Index) ((uint8_t)(APP_TLM_VIBE_FIRST + (8u * (Axis)) + (Index)))
+
+
+/*
+ * UserApp Telemetry Functions
+ * ---------------------------
+ */
+
+void     App_TelemetryStart(void);                                       /* Flush timer, empty batch */
+
+uint8_t  App_TelemetryAdd(uint8_t Field, uint8_t Type, uint32_t Value);  /* 1: batched (signed types sign-extended) */
+
+void     App_TelemetryFlush(void);                                       /* The batch as one frame, if any */
+
+uint32_t App_TelemetryDropped(void);                                     /* Frames the queue refused */
+
+
+#endif /* INC_APP_TELEMETRY_H_ */
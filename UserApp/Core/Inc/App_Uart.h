@@ -0,0 +1,60 @@
+#ifndef INC_APP_UART_H_
+#define INC_APP_UART_H_
+
+#include <stdint.h>
+
+/*
+ * USART2 Transmit Queue
+ * ---------------------
+ * App_UartSend copies a message into a ring and returns: DMA1 Stream6
+ * sends the ring in contiguous pieces, the transfer complete interrupt
+ * starts the next one. The main loop never waits for the line, a full
+ * ring refuses the message whole (no partial, interleaved lines).
+ *
+ * printf and the rest of stdio go the same way: _write (in App_Uart.c,
+ * overriding the weak one of syscalls.c) queues stdout / stderr in pieces
+ * of up to the ring size and counts what found no room as dropped instead
+ * of waiting, so logging never blocks on the line. Like App_UartSend it is
+ * for the main loop, not for interrupts.
+ *
+ * A client sending its own buffers (App_Bridge.h) attaches instead: from
+ * then on App_UartSend and stdio are refused and counted as dropped, the
+ * piece of the ring in flight finishes, and the client's TxDone says each
+ * time the line is free for App_UartTransmit, which hands the DMA the
+ * client's buffer as it is. What was queued waits for App_UartDetach.
+ * App_Ota.h attaches for the length of an update session only.
+ */
+#define APP_UART_TX_QUEUE_SIZE       512u      /* Power of two */
+
+#if ((APP_UART_TX_QUEUE_SIZE & (APP_UART_TX_QUEUE_SIZE - 1u)) != 0u)
+#error "APP_UART_TX_QUEUE_SIZE must be a power of two"
+#endif
+
+typedef struct
+{
+	void (*TxDone)(void);                      /* Interrupt context: the line is free */
+	void (*Error)(void);                       /* Interrupt context: a UART error stopped the receiver */
+} AppUartClient_t;
+
+
+/*
+ * UserApp UART Functions
+ * ----------------------
+ */
+
+uint8_t  App_UartSend(const uint8_t* Data, uint16_t Length);            /* Queues all of it (1) or nothing (0) */
+
+uint16_t App_UartTxFree(void);                                           /* Bytes the queue still takes */
+
+uint8_t  App_UartTxIdle(void);                                           /* 1 once everything queued is on the line */
+
+uint32_t App_UartDropped(void);                                          /* Bytes refused for want of room, since reset */
+
+uint8_t  App_UartAttach(const AppUartClient_t* Client);                 /* 1: line free now, 0: TxDone follows */
+
+void     App_UartDetach(void);                                           /* The queue owns the line again */
+
+uint8_t  App_UartTransmit(const uint8_t* Data, uint16_t Length);        /* Attached only: DMA straight from Data */
+
+
+#endif /* INC_APP_UART_H_ */
@@ -0,0 +1,39 @@
+#ifndef INC_APP_UPDATE_H_
+#define INC_APP_UPDATE_H_
+
+#include <stdint.h>
+
+/*
+ * Firmware Update from a USB Flash Drive
+ * --------------------------------------
+ * With an A/B bootloader (services table revision 3) and the running image
+ * validated, a drive plugged into the OTG_FS port is searched for the image
+ * built for the inactive slot: APP_A.BIN or APP_B.BIN (STM32F407VGTX_FLASH.ld
+ * or STM32F407VGTX_FLASH_SLOTB.ld) in the root directory of its first FAT16 /
+ * FAT32 partition. A file whose header (first chunk) names a newer version
+ * than the running one is programmed into that slot; ImageActivateUpdate
+ * then checks its stamped CRC and makes it the slot the next reset starts.
+ *
+ * Throughput: the file is read in READ(10) commands of up to
+ * APP_UPDATE_CHUNK_BLOCKS contiguous sectors (as far as the cluster chain is
+ * contiguous), into two buffers taking turns. While the drive fills one, the
+ * other is programmed APP_UPDATE_SLICE bytes per task run: the USB host task
+ * runs between slices, so reading and programming overlap, and sectors are
+ * blank-checked and erased only when the programming reaches them.
+ */
+#define APP_UPDATE_CHUNK_BLOCKS      16u       /* 8 KB per read, per buffer */
+#define APP_UPDATE_SLICE             1024u     /* Bytes programmed per run, about 4 ms of stall */
+#define APP_UPDATE_RESET_DELAY_MS    100u      /* For the last UART message before the reset */
+
+
+/*
+ * UserApp Update Functions
+ * ------------------------
+ */
+
+void    App_UpdateTask(uint32_t Events);                                 /* APP_TASK_UPDATE */
+
+uint8_t App_UpdateBusy(void);                                            /* 1 while the inactive slot is being written */
+
+
+#endif /* INC_APP_UPDATE_H_ */
@@ -0,0 +1,67 @@
+#ifndef INC_APP_VIBE_H_
+#define INC_APP_VIBE_H_
+
+#include <stdint.h>
+#include "App_Accel.h"
+
+/*
+ * Vibration Features
+ * ------------------
+ * A task (APP_TASK_ACCEL) drains the accelerometer ring (App_Accel.h) in
+ * blocks and turns the 400 Hz X, Y and Z samples into features, all in
+ * fixed point on the M4 DSP instructions:
+ *  - decimation by 2 to 200 Hz through a 16-tap linear-phase FIR (-6 dB at
+ *    80 Hz, -16 dB at 100 Hz), Q15 taps: 8 __SMLAD per output on a history
+ *    kept twice over, so the window is always contiguous and word aligned,
+ *  - per APP_VIBE_BLOCK_SIZE decimated samples: mean, RMS around the mean
+ *    and peak (largest distance from the mean), in mg,
+ *  - with APP_VIBE_FFT_ENABLE, the dominant frequency of each axis and its
+ *    amplitude: a radix-2 complex FFT of the block, Q15 with a halving per
+ *    stage, butterflies on packed (re, im) words (__SMUSD, __SMUADX,
+ *    __SHADD16, __SHSUB16). Resolution 200 Hz / APP_VIBE_BLOCK_SIZE.
+ *
+ * The features of every block go into the telemetry batch (App_Telemetry.h,
+ * APP_TLM_VIBE_FIELD): per axis mean, RMS and peak, then frequency (0.1 Hz)
+ * and amplitude with the FFT. The DWT cycle counter times the processing
+ * of every block (the drain included); cycles per sample =
+ * cycles / (2 x APP_VIBE_BLOCK_SIZE).
+ */
+#define APP_VIBE_BLOCK_SIZE          128u      /* Decimated samples, power of two: 640 ms */
+#define APP_VIBE_FFT_ENABLE          0u        /* 1 -> dominant frequency per axis */
+
+#if ((APP_VIBE_BLOCK_SIZE & (APP_VIBE_BLOCK_SIZE - 1u)) != 0u) || (APP_VIBE_BLOCK_SIZE < 16u) || (APP_VIBE_BLOCK_SIZE > 256u)
+#error "APP_VIBE_BLOCK_SIZE must be a power of two from 16 to 256"
+#endif
+
+typedef struct
+{
+	int16_t  Mean;                             /* mg */
+	uint16_t Rms;                              /* mg, around the mean */
+	uint16_t Peak;                             /* mg, from the mean */
+	uint16_t Frequency;                        /* 0.1 Hz, APP_VIBE_FFT_ENABLE only */
+	uint16_t Amplitude;                        /* mg, APP_VIBE_FFT_ENABLE only */
+} AppVibeAxis_t;
+
+typedef struct
+{
+	uint32_t Blocks;
+	uint32_t LastCycles;                       /* Last block */
+	uint32_t MaxCycles;                        /* Worst block since App_VibeStart */
+} AppVibeStats_t;
+
+
+/*
+ * UserApp Vibration Functions
+ * ---------------------------
+ */
+
+uint8_t App_VibeStart(void);                                             /* 1: accelerometer found, pipeline reset */
+
+void    App_VibeTask(uint32_t Events);                                   /* APP_TASK_ACCEL */
+
+void    App_VibeGetLast(AppVibeAxis_t Axes[3]);                          /* Features of the last block, X Y Z */
+
+void    App_VibeGetStats(AppVibeStats_t* Stats);
+
+
+#endif /* INC_APP_VIBE_H_ */
@@ -47,6 +47,12 @@ extern "C" {
 
 /* Exported macro ------------------------------------------------------------*/
 /* USER CODE BEGIN EM */
+/* CCMRAM placement (.ccmbss zeroed, .ccmram initialized by the startup): not reachable by DMA */
+#define APP_CCMRAM               __attribute__((section(".ccmbss")))
+#define APP_CCMRAM_DATA          __attribute__((section(".ccmram")))
+
+/* SRAM1, charged to a RAM budget of the FLASH linker scripts ("rx", "staging", "codec", "trace", "pool"): the link fails once it is outgrown */
+#define APP_RAM_BUDGET(NAME)     __attribute__((section(".bss.budget." NAME)))
 
 /* USER CODE END EM */
 
@@ -54,6 +60,8 @@ extern "C" {
 void Error_Handler(void);
 
 /* USER CODE BEGIN EFP */
+void Bootloader_RequestUpdate(void);        /* Reset into the bootloader's update mode */
+void Bootloader_ConfirmImage(void);         /* End of a trial boot: the image works */
 
 /* USER CODE END EFP */
 
@@ -126,6 +134,47 @@ void Error_Handler(void);
 #define MEMS_INT2_Pin GPIO_PIN_1
 #define MEMS_INT2_GPIO_Port GPIOE
 /* USER CODE BEGIN Private defines */
+/* App_Scheduler.h tasks, first to run first, and their events */
+#define APP_TASK_USB_HOST        0u
+#define APP_TASK_CDC             1u
+#define APP_TASK_DEBOUNCE        2u   /* App_Button.h */
+#define APP_TASK_BUTTON          3u
+#define APP_TASK_HEARTBEAT       4u
+#define APP_TASK_UPDATE          5u   /* App_Update.h, programs the slot in slices */
+#define APP_TASK_ACCEL           6u   /* App_Vibe.h */
+#define APP_TASK_OTA             7u   /* App_Ota.h, USART2 update sessions */
+#define APP_TASK_CLOCK           8u   /* App_Clock.h, profile switches between tasks */
+#define APP_TASK_PRE_ERASE       9u   /* Stalls the CPU for up to 2 s: last */
+
+#define APP_EVENT_USB_IRQ        (1UL << 0)   /* OTG_FS interrupt */
+#define APP_EVENT_USB_POLL       (1UL << 1)   /* APP_TIMER_USB_POLL, while the host is not idle */
+#define APP_EVENT_CDC_RX         (1UL << 0)   /* Bytes in the CDC receive ring */
+#define APP_EVENT_BRIDGE_UP      (1UL << 1)   /* USART2 bytes for the device (App_Bridge.h) */
+#define APP_EVENT_BRIDGE_DOWN    (1UL << 2)   /* A bridge buffer sent on USART2 */
+#define APP_EVENT_BUTTON         (1UL << 0)   /* B1 pressed, debounced */
+#define APP_EVENT_TIMER          (1UL << 0)
+#define APP_EVENT_TELEMETRY      (1UL << 1)   /* APP_TIMER_TELEMETRY, on the heartbeat task */
+#define APP_EVENT_MSC_READY      (1UL << 0)   /* Flash drive sized (App_Msc.h) */
+#define APP_EVENT_MSC_DONE       (1UL << 1)   /* App_MscRead finished */
+#define APP_EVENT_MSC_GONE       (1UL << 2)   /* Flash drive removed */
+#define APP_EVENT_UPDATE_PROGRAM (1UL << 3)   /* Next programming slice */
+#define APP_EVENT_UPDATE_RESET   (1UL << 4)   /* APP_TIMER_UPDATE_RESET */
+#define APP_EVENT_ACCEL_DATA     (1UL << 0)   /* APP_ACCEL_NOTIFY_LEVEL samples in the ring */
+#define APP_EVENT_OTA_RX         (1UL << 0)   /* USART2 bytes in the OTA ring */
+#define APP_EVENT_OTA_STEP       (1UL << 1)   /* Next erase sector / programming slice */
+#define APP_EVENT_OTA_TX         (1UL << 2)   /* USART2 free for a reply */
+#define APP_EVENT_OTA_TIMEOUT    (1UL << 3)   /* APP_TIMER_OTA */
+#define APP_EVENT_OTA_RESTART    (1UL << 4)   /* A UART error stopped the receiver */
+#define APP_EVENT_CLOCK_CHANGE   (1UL << 0)   /* Requests changed, or APP_TIMER_CLOCK */
+
+#define APP_TIMER_USB_POLL       0u
+#define APP_TIMER_HEARTBEAT      1u
+#define APP_TIMER_CDC_RETRY      2u
+#define APP_TIMER_UPDATE_RESET   3u
+#define APP_TIMER_B1_DEBOUNCE    4u
+#define APP_TIMER_TELEMETRY      5u   /* App_Telemetry.h batch flush */
+#define APP_TIMER_OTA            6u   /* App_Ota.h frame and session timeouts */
+#define APP_TIMER_CLOCK          7u   /* App_Clock.h switch retry */
 
 /* USER CODE END Private defines */
 
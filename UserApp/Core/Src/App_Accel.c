@@ -0,0 +1,197 @@
+#include "main.h"
+#include "App_Accel.h"
+#include "App_Scheduler.h"
+#include "Ring.h"
+
+extern SPI_HandleTypeDef hspi1;
+
+#define ACCEL_WHO_AM_I               0x0Fu
+#define ACCEL_CTRL_REG1              0x20u
+#define ACCEL_CTRL_REG2              0x21u
+#define ACCEL_CTRL_REG3              0x22u
+#define ACCEL_OUT_X                  0x29u     /* OUT_Y 0x2B, OUT_Z 0x2D, a spare register between each */
+
+#define ACCEL_ID                     0x3Bu
+
+#define ACCEL_READ                   0x80u
+#define ACCEL_AUTO_INCREMENT         0x40u
+
+#define ACCEL_CTRL1_ON_400HZ_XYZ     0xC7u     /* DR 400 Hz, PD active, Z Y X enabled */
+#define ACCEL_CTRL3_INT2_DATA_READY  0x20u     /* I2CFG = 100: data ready on INT2, active high, push-pull */
+
+#define ACCEL_BURST_LENGTH           6u        /* Command, X, -, Y, -, Z */
+#define ACCEL_TIMEOUT_MS             10u
+
+/* Sample ring (Ring.h): the DMA completion the producer, App_AccelRead the consumer */
+static AppAccelSample_t  Global_Samples[APP_ACCEL_FIFO_SIZE] APP_CCMRAM;   /* The DMA only writes Global_uint8BurstRx */
+static Ring_t            Global_SampleRing = RING_INIT(Global_Samples, APP_ACCEL_FIFO_SIZE, sizeof(AppAccelSample_t));
+static volatile uint32_t Global_uint32Dropped;
+
+static uint8_t           Global_uint8BurstTx[ACCEL_BURST_LENGTH] = { ACCEL_READ | ACCEL_AUTO_INCREMENT | ACCEL_OUT_X };
+static uint8_t           Global_uint8BurstRx[ACCEL_BURST_LENGTH];
+static volatile uint8_t  Global_uint8Running;
+static volatile uint8_t  Global_uint8Busy;
+
+
+static void App_AccelSelect(GPIO_PinState State)
+{
+	/* Low selects the SPI interface, high between transfers (low alone would mean I2C) */
+	HAL_GPIO_WritePin(CS_I2C_SPI_GPIO_Port, CS_I2C_SPI_Pin, State);
+}
+
+
+/* Configuration only, before the bursts start or after they stopped */
+static uint8_t App_AccelTransfer(uint8_t Command, uint8_t Value)
+{
+	uint8_t Local_uint8Tx[2] = { Command, Value };
+	uint8_t Local_uint8Rx[2] = { 0u, 0u };
+
+	App_AccelSelect(GPIO_PIN_RESET);
+	(void)HAL_SPI_TransmitReceive(&hspi1, Local_uint8Tx, Local_uint8Rx, 2u, ACCEL_TIMEOUT_MS);
+	App_AccelSelect(GPIO_PIN_SET);
+
+	return Local_uint8Rx[1];
+}
+
+
+/*
+ * App_AccelStart
+ * --------------
+ * Identifies the sensor, routes data-ready to INT2 and starts conversions.
+ * A sample left unread (say from before a reset) holds the line high
+ * without an edge: it is fetched at once.
+ */
+uint8_t App_AccelStart(void)
+{
+	if(App_AccelTransfer(ACCEL_READ | ACCEL_WHO_AM_I, 0u) != ACCEL_ID)
+	{
+		return 0u;
+	}
+
+	(void)App_AccelTransfer(ACCEL_CTRL_REG2, 0u);
+	(void)App_AccelTransfer(ACCEL_CTRL_REG3, ACCEL_CTRL3_INT2_DATA_READY);
+	(void)App_AccelTransfer(ACCEL_CTRL_REG1, ACCEL_CTRL1_ON_400HZ_XYZ);
+
+	Global_uint8Running = 1u;
+	if(HAL_GPIO_ReadPin(MEMS_INT2_GPIO_Port, MEMS_INT2_Pin) == GPIO_PIN_SET)
+	{
+		App_AccelDataReady();
+	}
+
+	return 1u;
+}
+
+
+/* A burst in flight ends within microseconds, the bus is free after it */
+void App_AccelStop(void)
+{
+	Global_uint8Running = 0u;
+	while(Global_uint8Busy != 0u)
+	{
+	}
+
+	(void)App_AccelTransfer(ACCEL_CTRL_REG1, 0u);
+}
+
+
+uint8_t App_AccelRunning(void)
+{
+	return Global_uint8Running;
+}
+
+
+/*
+ * App_AccelDataReady
+ * ------------------
+ * Interrupt context: starts the burst unless one is already running.
+ */
+void App_AccelDataReady(void)
+{
+	if((Global_uint8Running == 0u) || (Global_uint8Busy != 0u))
+	{
+		return;
+	}
+
+	Global_uint8Busy = 1u;
+	App_AccelSelect(GPIO_PIN_RESET);
+
+	if(HAL_SPI_TransmitReceive_DMA(&hspi1, Global_uint8BurstTx, Global_uint8BurstRx, ACCEL_BURST_LENGTH) != HAL_OK)
+	{
+		App_AccelSelect(GPIO_PIN_SET);
+		Global_uint8Busy = 0u;
+	}
+}
+
+
+uint16_t App_AccelRead(AppAccelSample_t* Samples, uint16_t Count)
+{
+	return (uint16_t)Ring_Read(&Global_SampleRing, Samples, Count);
+}
+
+
+uint16_t App_AccelAvailable(void)
+{
+	return (uint16_t)Ring_Used(&Global_SampleRing);
+}
+
+
+uint32_t App_AccelDropped(void)
+{
+	return Global_uint32Dropped;
+}
+
+
+/*
+ * HAL_SPI_TxRxCpltCallback
+ * ------------------------
+ * Burst done: release the sensor, publish the sample (waking the task once
+ * enough are waiting), and go again if the next one is already waiting.
+ */
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef* hspi)
+{
+	AppAccelSample_t* Local_pSample;
+	uint32_t          Local_uint32Free;
+
+	if(hspi->Instance != SPI1)
+	{
+		return;
+	}
+
+	App_AccelSelect(GPIO_PIN_SET);
+
+	/* Straight into the slot at Head */
+	Local_pSample = (AppAccelSample_t*)Ring_WriteSpan(&Global_SampleRing, &Local_uint32Free);
+	if(Local_uint32Free != 0u)
+	{
+		Local_pSample->X = (int16_t)((int8_t)Global_uint8BurstRx[1] * APP_ACCEL_MG_PER_DIGIT);
+		Local_pSample->Y = (int16_t)((int8_t)Global_uint8BurstRx[3] * APP_ACCEL_MG_PER_DIGIT);
+		Local_pSample->Z = (int16_t)((int8_t)Global_uint8BurstRx[5] * APP_ACCEL_MG_PER_DIGIT);
+
+		Ring_Commit(&Global_SampleRing, 1u);
+
+		if(App_AccelAvailable() >= APP_ACCEL_NOTIFY_LEVEL)
+		{
+			App_SchedSignal(APP_TASK_ACCEL, APP_EVENT_ACCEL_DATA);
+		}
+	}
+	else
+	{
+		Global_uint32Dropped++;
+	}
+
+	Global_uint8Busy = 0u;
+	if(HAL_GPIO_ReadPin(MEMS_INT2_GPIO_Port, MEMS_INT2_Pin) == GPIO_PIN_SET)
+	{
+		App_AccelDataReady();
+	}
+}
+
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef* hspi)
+{
+	if(hspi->Instance == SPI1)
+	{
+		App_AccelSelect(GPIO_PIN_SET);
+		Global_uint8Busy = 0u;
+	}
+}
@@ -0,0 +1,185 @@
+#include "main.h"
+#include "App_Audio.h"
+#include "App_AudioFx.h"
+#include "App_Clock.h"
+
+extern I2S_HandleTypeDef hi2s3;
+
+#define AUDIO_HALF_SAMPLES           (APP_AUDIO_HALF_FRAMES * APP_AUDIO_CHANNELS)
+
+#define CODEC_POWER_CTL1             0x02u
+#define CODEC_POWER_DOWN             0x01u
+#define CODEC_POWER_UP               0x9Eu
+
+/* As the ST BSP driver sets it up, before the power-up */
+static const AppI2cWrite_t Global_CodecInit[] =
+{
+	{ CODEC_POWER_CTL1, CODEC_POWER_DOWN },
+	{ 0x04u, 0xAFu },                           /* Power Ctl 2: headphone on, speaker off */
+	{ 0x05u, 0x81u },                           /* Clocking: auto-detect speed from MCLK */
+	{ 0x06u, 0x04u },                           /* Interface: slave, I2S Philips, 16 bits */
+	{ 0x0Au, 0x00u },                           /* Analog soft ramp and zero cross off */
+	{ 0x0Eu, 0x04u },                           /* Misc: digital soft ramp off */
+	{ 0x27u, 0x00u },                           /* Limiter off */
+	{ 0x1Fu, 0x0Fu },                           /* Bass and treble gain */
+	{ 0x1Au, 0x0Au },                           /* PCM A and B volume */
+	{ 0x1Bu, 0x0Au },
+};
+
+static const AppI2cWrite_t Global_CodecPowerUp[] =
+{
+	{ CODEC_POWER_CTL1, CODEC_POWER_UP },
+};
+
+/* Both halves back to back, the DMA wraps from the end to the start */
+static int16_t                   Global_int16Buffer[2u * AUDIO_HALF_SAMPLES] __attribute__((aligned(4))) APP_RAM_BUDGET("codec"); /* Frames as words in App_AudioFx.c */
+static volatile AppAudioSource_t Global_Source;
+static volatile uint32_t         Global_uint32Underruns;
+static volatile uint8_t          Global_uint8CodecReady;
+static AppI2cDone_t              Global_CodecDone;
+
+
+/*
+ * App_AudioFill
+ * -------------
+ * Asks the source for one half and pads what it left with silence. Without
+ * a source (stopped) the half is silence. Runs from RAM like the rest of the
+ * DMA interrupt path, so the padding is a loop rather than memset (flash).
+ * The half then goes through the processing stage (App_AudioFx.h).
+ */
+__RAM_FUNC static void App_AudioFill(int16_t* Half)
+{
+	AppAudioSource_t Local_Source = Global_Source;
+	uint32_t Local_uint32Frames   = 0u;
+	uint32_t Local_uint32Index;
+
+	if(Local_Source != NULL)
+	{
+		Local_uint32Frames = Local_Source(Half, APP_AUDIO_HALF_FRAMES);
+
+		if(Local_uint32Frames < APP_AUDIO_HALF_FRAMES)
+		{
+			Global_uint32Underruns++;
+		}
+		else
+		{
+			Local_uint32Frames = APP_AUDIO_HALF_FRAMES;
+		}
+	}
+
+	for(Local_uint32Index = Local_uint32Frames * APP_AUDIO_CHANNELS; Local_uint32Index < AUDIO_HALF_SAMPLES; Local_uint32Index++)
+	{
+		Half[Local_uint32Index] = 0;
+	}
+
+	App_AudioFxProcess(Half, APP_AUDIO_HALF_FRAMES);
+}
+
+
+/* Interrupt context, from the batch writer */
+static void App_AudioCodecDone(uint8_t Status, uint16_t Written)
+{
+	Global_uint8CodecReady = (Status == APP_I2C_OK) ? 1u : 0u;
+
+	if(Global_CodecDone != NULL)
+	{
+		Global_CodecDone(Status, Written);
+	}
+}
+
+
+/*
+ * App_AudioCodecInit
+ * ------------------
+ * Releases the codec's reset (held low since MX_GPIO_Init) and queues its
+ * configuration; start-up goes on while I2C1 writes it.
+ */
+uint8_t App_AudioCodecInit(AppI2cDone_t Done)
+{
+	Global_uint8CodecReady = 0u;
+	Global_CodecDone       = Done;
+	HAL_GPIO_WritePin(Audio_RST_GPIO_Port, Audio_RST_Pin, GPIO_PIN_SET);
+
+	return App_I2cBatchStart(APP_AUDIO_CODEC_ADDRESS, Global_CodecInit,
+	                         (uint16_t)(sizeof(Global_CodecInit) / sizeof(Global_CodecInit[0])), App_AudioCodecDone);
+}
+
+
+/*
+ * App_AudioStart
+ * --------------
+ * Fills both halves before the first sample goes out, then starts the
+ * circular transfer. The length is in 16-bit words, as the HAL counts them
+ * with a 16-bit data format.
+ */
+uint8_t App_AudioStart(AppAudioSource_t Source)
+{
+	if((Source == NULL) || (HAL_I2S_GetState(&hi2s3) != HAL_I2S_STATE_READY))
+	{
+		return 0u;
+	}
+
+	Global_Source          = Source;
+	Global_uint32Underruns = 0u;
+	App_AudioFill(&Global_int16Buffer[0]);
+	App_AudioFill(&Global_int16Buffer[AUDIO_HALF_SAMPLES]);
+
+	if(HAL_I2S_Transmit_DMA(&hi2s3, (uint16_t*)Global_int16Buffer, (uint16_t)(2u * AUDIO_HALF_SAMPLES)) != HAL_OK)
+	{
+		Global_Source = NULL;
+		return 0u;
+	}
+
+	/* The effects chain in the DMA interrupt needs the full clock while playing */
+	App_ClockRequest(APP_CLOCK_PROFILE_FULL);
+
+	/* The codec powers up on a running MCLK, which the transfer just started */
+	if(Global_uint8CodecReady != 0u)
+	{
+		(void)App_I2cBatchStart(APP_AUDIO_CODEC_ADDRESS, Global_CodecPowerUp, 1u, NULL);
+	}
+
+	return 1u;
+}
+
+
+void App_AudioStop(void)
+{
+	(void)HAL_I2S_DMAStop(&hi2s3);
+
+	if(Global_Source != NULL)
+	{
+		App_ClockRelease(APP_CLOCK_PROFILE_FULL);
+	}
+	Global_Source = NULL;
+}
+
+
+uint32_t App_AudioUnderruns(void)
+{
+	return Global_uint32Underruns;
+}
+
+
+/*
+ * HAL_I2S_TxHalfCpltCallback / HAL_I2S_TxCpltCallback
+ * ---------------------------------------------------
+ * The DMA moved on to the other half: the one it left has a full half
+ * period to be refilled.
+ */
+__RAM_FUNC void HAL_I2S_TxHalfCpltCallback(I2S_HandleTypeDef* hi2s)
+{
+	if(hi2s->Instance == SPI3)
+	{
+		App_AudioFill(&Global_int16Buffer[0]);
+	}
+}
+
+
+__RAM_FUNC void HAL_I2S_TxCpltCallback(I2S_HandleTypeDef* hi2s)
+{
+	if(hi2s->Instance == SPI3)
+	{
+		App_AudioFill(&Global_int16Buffer[AUDIO_HALF_SAMPLES]);
+	}
+}
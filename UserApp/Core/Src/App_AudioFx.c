@@ -0,0 +1,288 @@
+#include "main.h"
+#include "App_AudioFx.h"
+
+/* One stereo frame, left in the low half; may alias the int16_t buffers it is read from */
+typedef uint32_t AudioFxFrame_t __attribute__((may_alias));
+
+#define AUDIO_FX_SHIFT               14u       /* Q2.14 */
+#define AUDIO_FX_ROUND               (1 << (AUDIO_FX_SHIFT - 1u))
+#define AUDIO_FX_GAIN_MAX            0x7FFF    /* Positive gains only: two products stay below 2^31 */
+#define AUDIO_FX_UNITY_PAIR          (((uint32_t)APP_AUDIO_FX_UNITY << 16) | APP_AUDIO_FX_UNITY)
+
+/* One biquad of one channel, coefficients packed for __SMLALD */
+typedef struct
+{
+	uint32_t B0B1;                             /* (b0, b1) */
+	uint32_t B2A1;                             /* (b2, -a1) */
+	uint32_t A2;                               /* (0, -a2) */
+	uint32_t X;                                /* (x[n-1], x[n-2]) */
+	uint32_t Y;                                /* (y[n-1], y[n-2]) */
+	uint8_t  Bypass;                           /* b0 = 1.0, the rest 0 */
+} AudioFxStage_t;
+
+static AudioFxStage_t            Global_Stages[APP_AUDIO_CHANNELS][APP_AUDIO_FX_STAGES];
+static AudioFxFrame_t            Global_MixBlock[APP_AUDIO_HALF_FRAMES] APP_RAM_BUDGET("codec");
+static volatile AppAudioSource_t Global_MixSource;
+static volatile uint32_t         Global_uint32GainLeft;    /* (volume left, mix gain) */
+static volatile uint32_t         Global_uint32GainRight;   /* (volume right, mix gain) */
+static volatile uint32_t         Global_uint32LastCycles;
+static volatile uint32_t         Global_uint32MaxCycles;
+
+
+/*
+ * App_AudioFxBiquad
+ * -----------------
+ * One stage over one channel of a block (every other sample), the state in
+ * registers for the loop: x[n] is packed under x[n-1] with __PKHBT, and the
+ * three pairs against the packed coefficients give the whole sum.
+ */
+__RAM_FUNC static void App_AudioFxBiquad(int16_t* Samples, uint32_t Frames, AudioFxStage_t* Stage)
+{
+	uint32_t Local_uint32B0B1 = Stage->B0B1;
+	uint32_t Local_uint32B2A1 = Stage->B2A1;
+	uint32_t Local_uint32A2   = Stage->A2;
+	uint32_t Local_uint32X    = Stage->X;
+	uint32_t Local_uint32Y    = Stage->Y;
+	uint32_t Local_uint32X0;
+	int64_t  Local_int64Acc;
+	int32_t  Local_int32Out;
+
+	while(Frames-- != 0u)
+	{
+		Local_uint32X0 = __PKHBT((uint32_t)(int32_t)*Samples, Local_uint32X, 16);
+
+		Local_int64Acc = (int64_t)__SMLALD(Local_uint32X0, Local_uint32B0B1, (uint64_t)AUDIO_FX_ROUND);
+		Local_int64Acc = (int64_t)__SMLALD(__PKHBT(Local_uint32X >> 16, Local_uint32Y, 16), Local_uint32B2A1, (uint64_t)Local_int64Acc);
+		Local_int64Acc = (int64_t)__SMLALD(Local_uint32Y, Local_uint32A2, (uint64_t)Local_int64Acc);
+
+		Local_int32Out = __SSAT((int32_t)(Local_int64Acc >> AUDIO_FX_SHIFT), 16);
+		*Samples       = (int16_t)Local_int32Out;
+		Samples       += APP_AUDIO_CHANNELS;
+
+		Local_uint32Y = __PKHBT((uint32_t)Local_int32Out, Local_uint32Y, 16);
+		Local_uint32X = Local_uint32X0;
+	}
+
+	Stage->X = Local_uint32X;
+	Stage->Y = Local_uint32Y;
+}
+
+
+/*
+ * App_AudioFxGain
+ * ---------------
+ * Volume and mix of a block: per channel (sample, mix sample) against
+ * (volume, mix gain) in one __SMUAD. Without a mix the mix samples are 0.
+ */
+__RAM_FUNC static void App_AudioFxGain(AudioFxFrame_t* Frames, const AudioFxFrame_t* Mix, uint32_t Count,
+                                       uint32_t GainLeft, uint32_t GainRight)
+{
+	uint32_t Local_uint32Frame;
+	uint32_t Local_uint32Mix = 0u;
+	int32_t  Local_int32Left;
+	int32_t  Local_int32Right;
+
+	while(Count-- != 0u)
+	{
+		Local_uint32Frame = *Frames;
+
+		if(Mix != NULL)
+		{
+			Local_uint32Mix = *Mix++;
+		}
+
+		Local_int32Left  = __SSAT((int32_t)__SMUAD(__PKHBT(Local_uint32Frame, Local_uint32Mix, 16), GainLeft) >> AUDIO_FX_SHIFT, 16);
+		Local_int32Right = __SSAT((int32_t)__SMUAD(__PKHTB(Local_uint32Mix, Local_uint32Frame, 16), GainRight) >> AUDIO_FX_SHIFT, 16);
+
+		*Frames++ = __PKHBT((uint32_t)Local_int32Left, (uint32_t)Local_int32Right, 16);
+	}
+}
+
+
+/*
+ * App_AudioFxClamp
+ * ----------------
+ * A gain from 0 to AUDIO_FX_GAIN_MAX, as the 16 bits __SMUAD multiplies.
+ */
+static uint32_t App_AudioFxClamp(int16_t Gain)
+{
+	return (Gain < 0) ? 0u : ((uint32_t)Gain & AUDIO_FX_GAIN_MAX);
+}
+
+
+/*
+ * App_AudioFxInit
+ * ---------------
+ * Every stage bypassed, unity volume, no mix, statistics cleared. Starts the
+ * DWT cycle counter if the application was started without the bootloader.
+ */
+void App_AudioFxInit(void)
+{
+	static const AppAudioFxBiquad_t Local_Flat = { APP_AUDIO_FX_UNITY, 0, 0, 0, 0 };
+	uint8_t Local_uint8Channel;
+	uint8_t Local_uint8Stage;
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+
+	for(Local_uint8Channel = 0; Local_uint8Channel < APP_AUDIO_CHANNELS; Local_uint8Channel++)
+	{
+		for(Local_uint8Stage = 0; Local_uint8Stage < APP_AUDIO_FX_STAGES; Local_uint8Stage++)
+		{
+			(void)App_AudioFxSetBiquad(Local_uint8Channel, Local_uint8Stage, &Local_Flat);
+		}
+	}
+
+	App_AudioFxSetMix(NULL, 0);
+	App_AudioFxSetVolume(APP_AUDIO_FX_UNITY, APP_AUDIO_FX_UNITY);
+	Global_uint32LastCycles = 0u;
+	Global_uint32MaxCycles  = 0u;
+}
+
+
+/*
+ * App_AudioFxSetBiquad
+ * --------------------
+ * Packs one stage's coefficients (a1 and a2 negated, -2.0 saturating to
+ * just under 2.0) and clears its state, so the new filter starts from
+ * silence rather than the old filter's history.
+ */
+uint8_t App_AudioFxSetBiquad(uint8_t Channel, uint8_t Stage, const AppAudioFxBiquad_t* Coefficients)
+{
+	AudioFxStage_t Local_Stage;
+	uint32_t Local_uint32Primask;
+
+	if((Channel >= APP_AUDIO_CHANNELS) || (Stage >= APP_AUDIO_FX_STAGES) || (Coefficients == NULL))
+	{
+		return 0u;
+	}
+
+	Local_Stage.B0B1   = __PKHBT((uint32_t)(int32_t)Coefficients->B0, (uint32_t)(int32_t)Coefficients->B1, 16);
+	Local_Stage.B2A1   = __PKHBT((uint32_t)(int32_t)Coefficients->B2, (uint32_t)__SSAT(-(int32_t)Coefficients->A1, 16), 16);
+	Local_Stage.A2     = (uint32_t)__SSAT(-(int32_t)Coefficients->A2, 16) << 16;
+	Local_Stage.X      = 0u;
+	Local_Stage.Y      = 0u;
+	Local_Stage.Bypass = (uint8_t)((Coefficients->B0 == APP_AUDIO_FX_UNITY) && (Coefficients->B1 == 0) &&
+	                               (Coefficients->B2 == 0) && (Coefficients->A1 == 0) && (Coefficients->A2 == 0));
+
+	Local_uint32Primask = __get_PRIMASK();
+	__disable_irq();
+	Global_Stages[Channel][Stage] = Local_Stage;
+	__set_PRIMASK(Local_uint32Primask);
+
+	return 1u;
+}
+
+
+/*
+ * App_AudioFxSetVolume
+ * --------------------
+ * Both channel gains at once; the mix gain in the packed words is kept.
+ */
+void App_AudioFxSetVolume(int16_t Left, int16_t Right)
+{
+	uint32_t Local_uint32Primask = __get_PRIMASK();
+
+	__disable_irq();
+	Global_uint32GainLeft  = (Global_uint32GainLeft & 0xFFFF0000UL) | App_AudioFxClamp(Left);
+	Global_uint32GainRight = (Global_uint32GainRight & 0xFFFF0000UL) | App_AudioFxClamp(Right);
+	__set_PRIMASK(Local_uint32Primask);
+}
+
+
+/*
+ * App_AudioFxSetMix
+ * -----------------
+ * The second source and its gain, both channels. Like the main source, it
+ * runs in the DMA interrupt and must only copy out of RAM.
+ */
+void App_AudioFxSetMix(AppAudioSource_t Source, int16_t Gain)
+{
+	uint32_t Local_uint32Gain    = (Source != NULL) ? (App_AudioFxClamp(Gain) << 16) : 0u;
+	uint32_t Local_uint32Primask = __get_PRIMASK();
+
+	__disable_irq();
+	Global_MixSource       = Source;
+	Global_uint32GainLeft  = (Global_uint32GainLeft & 0x0000FFFFUL) | Local_uint32Gain;
+	Global_uint32GainRight = (Global_uint32GainRight & 0x0000FFFFUL) | Local_uint32Gain;
+	__set_PRIMASK(Local_uint32Primask);
+}
+
+
+/*
+ * App_AudioFxProcess
+ * ------------------
+ * Runs the stage on one block in place: the mix source is pulled first
+ * (its time is not counted), then the EQ cascade per channel, then volume
+ * and mix. Skipped stages cost a compare each.
+ */
+__RAM_FUNC void App_AudioFxProcess(int16_t* Samples, uint32_t Frames)
+{
+	AppAudioSource_t Local_Mix       = Global_MixSource;
+	uint32_t Local_uint32GainLeft    = Global_uint32GainLeft;
+	uint32_t Local_uint32GainRight   = Global_uint32GainRight;
+	uint32_t Local_uint32MixFrames   = 0u;
+	uint32_t Local_uint32Start;
+	uint32_t Local_uint32Index;
+	uint8_t  Local_uint8Channel;
+	uint8_t  Local_uint8Stage;
+
+	if(Frames > APP_AUDIO_HALF_FRAMES)
+	{
+		Frames = APP_AUDIO_HALF_FRAMES;
+	}
+
+	if(Local_Mix != NULL)
+	{
+		Local_uint32MixFrames = Local_Mix((int16_t*)Global_MixBlock, Frames);
+
+		for(Local_uint32Index = (Local_uint32MixFrames < Frames) ? Local_uint32MixFrames : Frames; Local_uint32Index < Frames; Local_uint32Index++)
+		{
+			Global_MixBlock[Local_uint32Index] = 0u;
+		}
+	}
+
+	Local_uint32Start = DWT->CYCCNT;
+
+	for(Local_uint8Channel = 0; Local_uint8Channel < APP_AUDIO_CHANNELS; Local_uint8Channel++)
+	{
+		for(Local_uint8Stage = 0; Local_uint8Stage < APP_AUDIO_FX_STAGES; Local_uint8Stage++)
+		{
+			if(Global_Stages[Local_uint8Channel][Local_uint8Stage].Bypass == 0u)
+			{
+				App_AudioFxBiquad(&Samples[Local_uint8Channel], Frames, &Global_Stages[Local_uint8Channel][Local_uint8Stage]);
+			}
+		}
+	}
+
+	if((Local_Mix != NULL) && (Local_uint32GainLeft == AUDIO_FX_UNITY_PAIR) && (Local_uint32GainRight == AUDIO_FX_UNITY_PAIR))
+	{
+		/* Both unity: a saturating add of the packed frames */
+		for(Local_uint32Index = 0; Local_uint32Index < Frames; Local_uint32Index++)
+		{
+			((AudioFxFrame_t*)Samples)[Local_uint32Index] = __QADD16(((AudioFxFrame_t*)Samples)[Local_uint32Index],
+			                                                         Global_MixBlock[Local_uint32Index]);
+		}
+	}
+	else if((Local_Mix != NULL) || ((Local_uint32GainLeft & 0xFFFFu) != APP_AUDIO_FX_UNITY) ||
+	        ((Local_uint32GainRight & 0xFFFFu) != APP_AUDIO_FX_UNITY))
+	{
+		App_AudioFxGain((AudioFxFrame_t*)Samples, (Local_Mix != NULL) ? Global_MixBlock : NULL, Frames,
+		                Local_uint32GainLeft, Local_uint32GainRight);
+	}
+
+	Global_uint32LastCycles = DWT->CYCCNT - Local_uint32Start;
+
+	if(Global_uint32LastCycles > Global_uint32MaxCycles)
+	{
+		Global_uint32MaxCycles = Global_uint32LastCycles;
+	}
+}
+
+
+void App_AudioFxGetStats(AppAudioFxStats_t* Stats)
+{
+	Stats->LastCycles = Global_uint32LastCycles;
+	Stats->MaxCycles  = Global_uint32MaxCycles;
+	Stats->Frames     = APP_AUDIO_HALF_FRAMES;
+}
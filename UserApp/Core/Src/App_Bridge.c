@@ -0,0 +1,325 @@
+#include "main.h"
+#include "usbh_cdc.h"
+#include "App_Bridge.h"
+#include "App_Uart.h"
+#include "App_Scheduler.h"
+
+#ifdef APP_CDC_BRIDGE
+
+extern USBH_HandleTypeDef hUsbHostFS;
+extern UART_HandleTypeDef huart2;
+
+static void App_BridgeTxDone(void);
+static void App_BridgeRxError(void);
+
+static const AppUartClient_t Global_Client = { App_BridgeTxDone, App_BridgeRxError };
+
+/*
+ * USB to UART: slot n is Global_uint8Down[n % APP_BRIDGE_DOWN_BUFFERS].
+ * Free-running counts: slots [Sent, Filled) are queued for the UART, slot
+ * Filled is with the USB while Armed. Filled moves in the USB host task
+ * only, Sent in the UART interrupt only.
+ */
+static uint8_t           Global_uint8Down[APP_BRIDGE_DOWN_BUFFERS][APP_BRIDGE_DOWN_SIZE] __attribute__((aligned(4))) APP_RAM_BUDGET("rx");
+static uint16_t          Global_uint16DownLength[APP_BRIDGE_DOWN_BUFFERS];
+static volatile uint16_t Global_uint16DownFilled;
+static volatile uint16_t Global_uint16DownSent;
+static volatile uint8_t  Global_uint8DownArmed;
+static volatile uint8_t  Global_uint8DownBusy;       /* Slot Sent is with the UART */
+
+/*
+ * UART to USB: Head bytes came in (DMA and idle interrupts only), Tail
+ * bytes were sent (USB host task only), InFlight bytes from Tail are with
+ * the USB.
+ */
+static uint8_t           Global_uint8Up[APP_BRIDGE_UP_RING_SIZE] __attribute__((aligned(4))) APP_RAM_BUDGET("rx");
+static volatile uint32_t Global_uint32UpHead;
+static uint32_t          Global_uint32UpTail;
+static uint16_t          Global_uint16UpInFlight;
+static uint16_t          Global_uint16UpPosition;    /* DMA write offset at the last update */
+static volatile uint8_t  Global_uint8UpRestart;      /* A receive error stopped the DMA */
+static uint32_t          Global_uint32UpLost;
+
+static volatile uint8_t  Global_uint8Running;
+
+
+/*
+ * App_BridgeSendDown
+ * ------------------
+ * Hands the UART the oldest queued slot if it is idle, in place. From the
+ * UART interrupt, or with interrupts off.
+ */
+static void App_BridgeSendDown(void)
+{
+	uint16_t Local_uint16Slot = Global_uint16DownSent & (APP_BRIDGE_DOWN_BUFFERS - 1u);
+
+	if((Global_uint8DownBusy != 0u) || (Global_uint16DownSent == Global_uint16DownFilled))
+	{
+		return;
+	}
+
+	if(App_UartTransmit(Global_uint8Down[Local_uint16Slot], Global_uint16DownLength[Local_uint16Slot]) != 0u)
+	{
+		Global_uint8DownBusy = 1u;
+	}
+}
+
+
+/* USB host task: the next IN transfer, if a slot is free */
+static void App_BridgeArmDown(void)
+{
+	if((Global_uint8Running == 0u) || (Global_uint8DownArmed != 0u) ||
+	   ((uint16_t)(Global_uint16DownFilled - Global_uint16DownSent) >= APP_BRIDGE_DOWN_BUFFERS))
+	{
+		return;
+	}
+
+	if(USBH_CDC_Receive(&hUsbHostFS, Global_uint8Down[Global_uint16DownFilled & (APP_BRIDGE_DOWN_BUFFERS - 1u)], APP_BRIDGE_DOWN_SIZE) == USBH_OK)
+	{
+		Global_uint8DownArmed = 1u;
+		App_SchedSignal(APP_TASK_USB_HOST, APP_EVENT_USB_POLL);
+	}
+}
+
+
+static void App_BridgeStartRx(void)
+{
+	Global_uint16UpPosition = 0u;
+
+	if(HAL_UART_Receive_DMA(&huart2, Global_uint8Up, APP_BRIDGE_UP_RING_SIZE) == HAL_OK)
+	{
+		__HAL_UART_ENABLE_IT(&huart2, UART_IT_IDLE);
+	}
+}
+
+
+/*
+ * App_BridgeSendUp
+ * ----------------
+ * USB host task: the next contiguous piece of the ring to the device. A
+ * ring the DMA lapped, or a receiver stopped by an error, drops what was
+ * queued and starts over.
+ */
+static void App_BridgeSendUp(void)
+{
+	uint32_t Local_uint32Queued;
+	uint32_t Local_uint32Primask;
+	uint16_t Local_uint16Offset;
+	uint16_t Local_uint16Length;
+
+	if((Global_uint8Running == 0u) || (Global_uint16UpInFlight != 0u))
+	{
+		return;
+	}
+
+	if(Global_uint8UpRestart != 0u)
+	{
+		Local_uint32Primask = __get_PRIMASK();
+		__disable_irq();
+		Global_uint32UpLost  += Global_uint32UpHead - Global_uint32UpTail;
+		Global_uint32UpHead   = 0u;
+		Global_uint32UpTail   = 0u;
+		Global_uint8UpRestart = 0u;
+		__set_PRIMASK(Local_uint32Primask);
+
+		App_BridgeStartRx();
+		return;
+	}
+
+	Local_uint32Queued = Global_uint32UpHead - Global_uint32UpTail;
+	if(Local_uint32Queued > APP_BRIDGE_UP_RING_SIZE)
+	{
+		Global_uint32UpLost += Local_uint32Queued;
+		Global_uint32UpTail += Local_uint32Queued;
+		return;
+	}
+	if(Local_uint32Queued == 0u)
+	{
+		return;
+	}
+
+	Local_uint16Offset = (uint16_t)(Global_uint32UpTail & (APP_BRIDGE_UP_RING_SIZE - 1u));
+	Local_uint16Length = (uint16_t)(APP_BRIDGE_UP_RING_SIZE - Local_uint16Offset);
+	if(Local_uint16Length > Local_uint32Queued)
+	{
+		Local_uint16Length = (uint16_t)Local_uint32Queued;
+	}
+
+	if(USBH_CDC_Transmit(&hUsbHostFS, &Global_uint8Up[Local_uint16Offset], Local_uint16Length) == USBH_OK)
+	{
+		Global_uint16UpInFlight = Local_uint16Length;
+		App_SchedSignal(APP_TASK_USB_HOST, APP_EVENT_USB_POLL);
+	}
+}
+
+
+/*
+ * App_BridgeRxUpdate
+ * ------------------
+ * Interrupt context: moves Head up to where the DMA is writing. The half
+ * and complete interrupts come at least twice per lap, so the distance from
+ * the last update is never ambiguous.
+ */
+static void App_BridgeRxUpdate(void)
+{
+	uint16_t Local_uint16Position = (uint16_t)(APP_BRIDGE_UP_RING_SIZE - __HAL_DMA_GET_COUNTER(huart2.hdmarx));
+
+	Global_uint32UpHead    += (uint16_t)(Local_uint16Position - Global_uint16UpPosition) & (APP_BRIDGE_UP_RING_SIZE - 1u);
+	Global_uint16UpPosition = Local_uint16Position & (APP_BRIDGE_UP_RING_SIZE - 1u);
+
+	App_SchedSignal(APP_TASK_CDC, APP_EVENT_BRIDGE_UP);
+}
+
+
+/* UART interrupt: the line is free (a slot sent, or the queue's last piece) */
+static void App_BridgeTxDone(void)
+{
+	if(Global_uint8DownBusy != 0u)
+	{
+		Global_uint8DownBusy = 0u;
+		Global_uint16DownSent++;
+		App_SchedSignal(APP_TASK_CDC, APP_EVENT_BRIDGE_DOWN);
+	}
+
+	App_BridgeSendDown();
+}
+
+
+/* UART interrupt: the HAL stopped the receive DMA */
+static void App_BridgeRxError(void)
+{
+	Global_uint8UpRestart = 1u;
+	App_SchedSignal(APP_TASK_CDC, APP_EVENT_BRIDGE_UP);
+}
+
+
+/*
+ * App_BridgeStart
+ * ---------------
+ * Takes USART2 over, starts the receive DMA and the first IN transfer.
+ */
+void App_BridgeStart(void)
+{
+	Global_uint16DownFilled = 0u;
+	Global_uint16DownSent   = 0u;
+	Global_uint8DownArmed   = 0u;
+	Global_uint8DownBusy    = 0u;
+	Global_uint32UpHead     = 0u;
+	Global_uint32UpTail     = 0u;
+	Global_uint16UpInFlight = 0u;
+	Global_uint8UpRestart   = 0u;
+	Global_uint8Running     = 1u;
+
+	(void)App_UartAttach(&Global_Client);
+	App_BridgeStartRx();
+	App_BridgeArmDown();
+}
+
+
+/* The device is gone: its transfers with it. The line goes back to the queue. */
+void App_BridgeStop(void)
+{
+	Global_uint8Running = 0u;
+
+	__HAL_UART_DISABLE_IT(&huart2, UART_IT_IDLE);
+	(void)HAL_UART_AbortReceive(&huart2);
+	App_UartDetach();
+}
+
+
+/*
+ * App_BridgeTask
+ * --------------
+ * A slot freed by the UART re-arms a stalled IN transfer, bytes from the
+ * UART go on to the device.
+ */
+void App_BridgeTask(uint32_t Events)
+{
+	if((Events & APP_EVENT_BRIDGE_DOWN) != 0u)
+	{
+		App_BridgeArmDown();
+	}
+
+	App_BridgeSendUp();
+}
+
+
+void App_BridgeRxIdle(void)
+{
+	if(Global_uint8Running != 0u)
+	{
+		App_BridgeRxUpdate();
+	}
+}
+
+
+uint32_t App_BridgeUpLost(void)
+{
+	return Global_uint32UpLost;
+}
+
+
+/*
+ * USBH_CDC_ReceiveCallback
+ * ------------------------
+ * One IN transfer done: its slot is queued for the UART as it is, and the
+ * next free slot armed. An empty transfer re-arms the same slot.
+ */
+void USBH_CDC_ReceiveCallback(USBH_HandleTypeDef *phost)
+{
+	uint16_t Local_uint16Length = USBH_CDC_GetLastReceivedDataSize(phost);
+	uint32_t Local_uint32Primask;
+
+	if(Global_uint8Running == 0u)
+	{
+		return;
+	}
+
+	Global_uint8DownArmed = 0u;
+
+	if(Local_uint16Length != 0u)
+	{
+		Global_uint16DownLength[Global_uint16DownFilled & (APP_BRIDGE_DOWN_BUFFERS - 1u)] = Local_uint16Length;
+
+		/* The UART interrupt could otherwise find its queue empty at the same time */
+		Local_uint32Primask = __get_PRIMASK();
+		__disable_irq();
+		Global_uint16DownFilled++;
+		App_BridgeSendDown();
+		__set_PRIMASK(Local_uint32Primask);
+	}
+
+	App_BridgeArmDown();
+}
+
+
+/* The piece is out: its bytes may be overwritten, the next one goes */
+void USBH_CDC_TransmitCallback(USBH_HandleTypeDef *phost)
+{
+	(void)phost;
+
+	Global_uint32UpTail    += Global_uint16UpInFlight;
+	Global_uint16UpInFlight = 0u;
+
+	App_BridgeSendUp();
+}
+
+
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef* huart)
+{
+	if((huart->Instance == USART2) && (Global_uint8Running != 0u))
+	{
+		App_BridgeRxUpdate();
+	}
+}
+
+
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart)
+{
+	if((huart->Instance == USART2) && (Global_uint8Running != 0u))
+	{
+		App_BridgeRxUpdate();
+	}
+}
+
+#endif /* APP_CDC_BRIDGE */
@@ -0,0 +1,102 @@
+#include "main.h"
+#include "App_Button.h"
+#include "App_Scheduler.h"
+
+static const AppButton_t* Global_Buttons[APP_BUTTON_MAX];
+static uint8_t            Global_uint8Count;
+static volatile uint8_t   Global_uint8Pressed;          /* Bit n: button n's debounced state */
+
+
+static uint8_t App_ButtonReadPressed(const AppButton_t* Button)
+{
+	return (HAL_GPIO_ReadPin(Button->Port, Button->Pin) == Button->PressedLevel) ? 1u : 0u;
+}
+
+
+/*
+ * App_ButtonAdd
+ * -------------
+ * Takes the present level as the starting state, so a button held at
+ * start-up delivers its release only.
+ */
+uint8_t App_ButtonAdd(const AppButton_t* Button)
+{
+	if(Global_uint8Count >= APP_BUTTON_MAX)
+	{
+		return 0u;
+	}
+
+	if(App_ButtonReadPressed(Button) != 0u)
+	{
+		Global_uint8Pressed |= (uint8_t)(1u << Global_uint8Count);
+	}
+	Global_Buttons[Global_uint8Count] = Button;
+	Global_uint8Count++;
+
+	return 1u;
+}
+
+
+/*
+ * App_ButtonEdge
+ * --------------
+ * Interrupt context: masks the line for the debounce time. Pins that are
+ * no button are ignored.
+ */
+void App_ButtonEdge(uint16_t Pin)
+{
+	uint8_t Local_uint8Index;
+
+	for(Local_uint8Index = 0; Local_uint8Index < Global_uint8Count; Local_uint8Index++)
+	{
+		if(Global_Buttons[Local_uint8Index]->Pin == Pin)
+		{
+			EXTI->IMR &= ~(uint32_t)Pin;
+			App_SchedTimerStart(Global_Buttons[Local_uint8Index]->Timer, APP_TASK_DEBOUNCE, 1UL << Local_uint8Index,
+			                    APP_BUTTON_DEBOUNCE_MS, 0u);
+			return;
+		}
+	}
+}
+
+
+/*
+ * App_ButtonDebounceTask
+ * ----------------------
+ * The pending bit is cleared before the pin is read: an edge after the
+ * read interrupts again once the line is unmasked.
+ */
+void App_ButtonDebounceTask(uint32_t Events)
+{
+	const AppButton_t* Local_pButton;
+	uint8_t Local_uint8Index;
+	uint8_t Local_uint8Bit;
+	uint8_t Local_uint8Pressed;
+
+	for(Local_uint8Index = 0; Local_uint8Index < Global_uint8Count; Local_uint8Index++)
+	{
+		if((Events & (1UL << Local_uint8Index)) == 0u)
+		{
+			continue;
+		}
+
+		Local_pButton      = Global_Buttons[Local_uint8Index];
+		Local_uint8Bit     = (uint8_t)(1u << Local_uint8Index);
+		EXTI->PR           = Local_pButton->Pin;
+		Local_uint8Pressed = App_ButtonReadPressed(Local_pButton);
+
+		if(Local_uint8Pressed != ((Global_uint8Pressed & Local_uint8Bit) != 0u))
+		{
+			Global_uint8Pressed ^= Local_uint8Bit;
+			App_SchedSignal(Local_pButton->Task, (Local_uint8Pressed != 0u) ? Local_pButton->PressEvents : Local_pButton->ReleaseEvents);
+		}
+
+		EXTI->IMR |= Local_pButton->Pin;
+	}
+}
+
+
+uint8_t App_ButtonIsPressed(uint8_t Index)
+{
+	return ((Index < Global_uint8Count) && ((Global_uint8Pressed & (1u << Index)) != 0u)) ? 1u : 0u;
+}
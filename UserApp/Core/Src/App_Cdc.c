@@ -0,0 +1,91 @@
+#include "main.h"
+#include "usbh_cdc.h"
+#include "App_Cdc.h"
+#include "App_Scheduler.h"
+#include "Ring.h"
+
+extern USBH_HandleTypeDef hUsbHostFS;
+
+/* Ping-pong packet buffers, Global_uint8RxActive the one with the USB */
+static uint8_t          Global_uint8RxPacket[2][APP_CDC_RX_PACKET_SIZE] __attribute__((aligned(4))) APP_RAM_BUDGET("rx");
+static uint8_t          Global_uint8RxActive;
+static volatile uint8_t Global_uint8RxRunning;
+
+/* Receive ring (Ring.h): the callback the producer, App_CdcRead the consumer */
+static uint8_t           Global_uint8RxData[APP_CDC_RX_RING_SIZE] APP_RAM_BUDGET("rx");
+static Ring_t            Global_RxRing = RING_INIT(Global_uint8RxData, APP_CDC_RX_RING_SIZE, 1u);
+static volatile uint32_t Global_uint32RxDropped;
+
+
+void App_CdcStart(void)
+{
+	Global_uint8RxActive = 0;
+	if(USBH_CDC_Receive(&hUsbHostFS, Global_uint8RxPacket[0], APP_CDC_RX_PACKET_SIZE) == USBH_OK)
+	{
+		Global_uint8RxRunning = 1;
+	}
+}
+
+
+void App_CdcStop(void)
+{
+	Global_uint8RxRunning = 0;
+}
+
+
+/* Up to Length bytes out of the ring, in at most two pieces */
+uint16_t App_CdcRead(uint8_t* Data, uint16_t Length)
+{
+	return (uint16_t)Ring_Read(&Global_RxRing, Data, Length);
+}
+
+
+uint16_t App_CdcRxAvailable(void)
+{
+	return (uint16_t)Ring_Used(&Global_RxRing);
+}
+
+
+uint32_t App_CdcRxDropped(void)
+{
+	return Global_uint32RxDropped;
+}
+
+
+#ifndef APP_CDC_BRIDGE
+/*
+ * USBH_CDC_ReceiveCallback
+ * ------------------------
+ * One IN transfer done. The other buffer goes to the USB first, then the
+ * filled one is copied into the ring; a packet the ring has no room for is
+ * dropped whole and counted.
+ */
+void USBH_CDC_ReceiveCallback(USBH_HandleTypeDef *phost)
+{
+	uint8_t* Local_puint8Filled = Global_uint8RxPacket[Global_uint8RxActive];
+	uint16_t Local_uint16Length = USBH_CDC_GetLastReceivedDataSize(phost);
+
+	if(Global_uint8RxRunning == 0u)
+	{
+		return;
+	}
+
+	Global_uint8RxActive ^= 1u;
+	(void)USBH_CDC_Receive(phost, Global_uint8RxPacket[Global_uint8RxActive], APP_CDC_RX_PACKET_SIZE);
+	App_SchedSignal(APP_TASK_USB_HOST, APP_EVENT_USB_POLL);
+
+	if(Local_uint16Length == 0u)
+	{
+		return;
+	}
+	if(Local_uint16Length > Ring_Free(&Global_RxRing))
+	{
+		Global_uint32RxDropped += Local_uint16Length;
+		return;
+	}
+
+	(void)Ring_Write(&Global_RxRing, Local_puint8Filled, Local_uint16Length);
+	App_SchedSignal(APP_TASK_CDC, APP_EVENT_CDC_RX);
+}
+
+#endif /* APP_CDC_BRIDGE: App_Bridge.c takes the packets */
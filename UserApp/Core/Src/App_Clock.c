@@ -0,0 +1,242 @@
+#include "main.h"
+#include "App_Clock.h"
+#include "App_Scheduler.h"
+
+void SystemClock_Config(void);
+
+typedef struct
+{
+	uint32_t Source;                           /* RCC_SYSCLKSOURCE_xxx */
+	uint32_t Apb1;                             /* RCC_HCLK_DIVx */
+	uint32_t Apb2;
+	uint32_t Latency;                          /* FLASH_LATENCY_x, RM0090 table 10 at 2.7 to 3.6 V */
+	uint32_t Hz;                               /* HCLK, AHB undivided */
+} AppClockProfile_t;
+
+static const AppClockProfile_t Global_Profiles[APP_CLOCK_PROFILES] =
+{
+	{ RCC_SYSCLKSOURCE_HSI,    RCC_HCLK_DIV1, RCC_HCLK_DIV1, FLASH_LATENCY_0, 16000000UL  },   /* PCLK1 and PCLK2 16 MHz */
+	{ RCC_SYSCLKSOURCE_PLLCLK, RCC_HCLK_DIV4, RCC_HCLK_DIV2, FLASH_LATENCY_5, 168000000UL }    /* PCLK1 42 MHz, PCLK2 84 MHz */
+};
+
+static volatile uint8_t Global_uint8Requests[APP_CLOCK_PROFILES];
+static AppClockListener_t Global_Listeners[APP_CLOCK_MAX_LISTENERS];
+static uint8_t Global_uint8Listeners;
+
+/* SystemClock_Config's until the first switch */
+static uint8_t Global_uint8Profile = APP_CLOCK_PROFILE_FULL;
+
+
+uint8_t App_ClockAddListener(AppClockListener_t Listener)
+{
+	if((Listener == NULL) || (Global_uint8Listeners >= APP_CLOCK_MAX_LISTENERS))
+	{
+		return 0u;
+	}
+
+	Global_Listeners[Global_uint8Listeners] = Listener;
+	Global_uint8Listeners++;
+
+	return 1u;
+}
+
+
+void App_ClockStart(void)
+{
+	App_SchedSignal(APP_TASK_CLOCK, APP_EVENT_CLOCK_CHANGE);
+}
+
+
+void App_ClockRequest(uint8_t Profile)
+{
+	uint32_t Local_uint32Primask = __get_PRIMASK();
+
+	if(Profile >= APP_CLOCK_PROFILES)
+	{
+		return;
+	}
+
+	__disable_irq();
+	Global_uint8Requests[Profile]++;
+	__set_PRIMASK(Local_uint32Primask);
+
+	App_SchedSignal(APP_TASK_CLOCK, APP_EVENT_CLOCK_CHANGE);
+}
+
+
+void App_ClockRelease(uint8_t Profile)
+{
+	uint32_t Local_uint32Primask = __get_PRIMASK();
+
+	if(Profile >= APP_CLOCK_PROFILES)
+	{
+		return;
+	}
+
+	__disable_irq();
+	if(Global_uint8Requests[Profile] != 0u)
+	{
+		Global_uint8Requests[Profile]--;
+	}
+	__set_PRIMASK(Local_uint32Primask);
+
+	App_SchedSignal(APP_TASK_CLOCK, APP_EVENT_CLOCK_CHANGE);
+}
+
+
+uint8_t App_ClockProfile(void)
+{
+	return Global_uint8Profile;
+}
+
+
+/* The highest profile with users, LOW with none */
+static uint8_t App_ClockTarget(void)
+{
+	uint8_t Local_uint8Profile = APP_CLOCK_PROFILES - 1u;
+
+#if APP_CLOCK_DVFS_ENABLE
+	while((Local_uint8Profile > APP_CLOCK_PROFILE_LOW) && (Global_uint8Requests[Local_uint8Profile] == 0u))
+	{
+		Local_uint8Profile--;
+	}
+#endif
+
+	return Local_uint8Profile;
+}
+
+
+/* Sets On in RCC->CR and waits for Ready, at most APP_CLOCK_START_MS */
+static uint8_t App_ClockOscillator(uint32_t On, uint32_t Ready)
+{
+	uint32_t Local_uint32Start = HAL_GetTick();
+
+	RCC->CR |= On;
+	while((RCC->CR & Ready) == 0u)
+	{
+		if((HAL_GetTick() - Local_uint32Start) > APP_CLOCK_START_MS)
+		{
+			return 0u;
+		}
+	}
+
+	return 1u;
+}
+
+
+/*
+ * App_ClockApply
+ * --------------
+ * Starts the source the profile needs (the PLL keeps the PLLCFGR
+ * SystemClock_Config wrote) and switches to it. HAL_RCC_ClockConfig waits
+ * for the switch on HAL_GetTick, which also works with interrupts masked:
+ * a ready source takes a few cycles.
+ */
+static uint8_t App_ClockApply(uint8_t Profile)
+{
+	const AppClockProfile_t* Local_pProfile = &Global_Profiles[Profile];
+	RCC_ClkInitTypeDef       Local_Clk      = {0};
+
+	if(Local_pProfile->Source == RCC_SYSCLKSOURCE_PLLCLK)
+	{
+		if((App_ClockOscillator(RCC_CR_HSEON, RCC_CR_HSERDY) == 0u) ||
+		   (App_ClockOscillator(RCC_CR_PLLON, RCC_CR_PLLRDY) == 0u))
+		{
+			return 0u;
+		}
+	}
+	else if(App_ClockOscillator(RCC_CR_HSION, RCC_CR_HSIRDY) == 0u)
+	{
+		return 0u;
+	}
+
+	Local_Clk.ClockType      = RCC_CLOCKTYPE_HCLK | RCC_CLOCKTYPE_SYSCLK | RCC_CLOCKTYPE_PCLK1 | RCC_CLOCKTYPE_PCLK2;
+	Local_Clk.SYSCLKSource   = Local_pProfile->Source;
+	Local_Clk.AHBCLKDivider  = RCC_SYSCLK_DIV1;
+	Local_Clk.APB1CLKDivider = Local_pProfile->Apb1;
+	Local_Clk.APB2CLKDivider = Local_pProfile->Apb2;
+
+	/* Also SystemCoreClock and SysTick: HAL_InitTick on the new HCLK */
+	if(HAL_RCC_ClockConfig(&Local_Clk, Local_pProfile->Latency) != HAL_OK)
+	{
+		return 0u;
+	}
+
+#if APP_CLOCK_LOW_PLL_OFF
+	if(Local_pProfile->Source != RCC_SYSCLKSOURCE_PLLCLK)
+	{
+		RCC->CR &= ~RCC_CR_PLLON;
+		if((RCC->CR & RCC_CR_PLLI2SON) == 0u)
+		{
+			RCC->CR &= ~RCC_CR_HSEON;
+		}
+	}
+#endif
+
+	return 1u;
+}
+
+
+/*
+ * App_ClockResume
+ * ---------------
+ * STOP woke the core on the HSI with every PLL off. SystemClock_Config
+ * brings back HSE, the PLL and PLLI2S as at boot (FULL), then the profile
+ * in place, if it is another, is set again. The listeners are not told:
+ * for them the clock never changed.
+ */
+void App_ClockResume(void)
+{
+	SystemClock_Config();
+
+	if(Global_uint8Profile != APP_CLOCK_PROFILE_FULL)
+	{
+		(void)App_ClockApply(Global_uint8Profile);
+	}
+}
+
+
+/*
+ * App_ClockTask
+ * -------------
+ * Asks every listener, switches, tells every listener. A listener that is
+ * busy, or a source that did not start, leaves the profile as it was and
+ * tries again APP_CLOCK_RETRY_MS later; a request in between just moves
+ * the target.
+ */
+void App_ClockTask(uint32_t Events)
+{
+	uint8_t Local_uint8Target = App_ClockTarget();
+	uint8_t Local_uint8Listener;
+
+	(void)Events;
+
+	if(Local_uint8Target == Global_uint8Profile)
+	{
+		return;
+	}
+
+	for(Local_uint8Listener = 0u; Local_uint8Listener < Global_uint8Listeners; Local_uint8Listener++)
+	{
+		if(Global_Listeners[Local_uint8Listener](APP_CLOCK_BEFORE, Global_Profiles[Local_uint8Target].Hz) == 0u)
+		{
+			App_SchedTimerStart(APP_TIMER_CLOCK, APP_TASK_CLOCK, APP_EVENT_CLOCK_CHANGE, APP_CLOCK_RETRY_MS, 0u);
+			return;
+		}
+	}
+
+	if(App_ClockApply(Local_uint8Target) == 0u)
+	{
+		/* Back on the profile in place, whatever the failed start left */
+		(void)App_ClockApply(Global_uint8Profile);
+		App_SchedTimerStart(APP_TIMER_CLOCK, APP_TASK_CLOCK, APP_EVENT_CLOCK_CHANGE, APP_CLOCK_RETRY_MS, 0u);
+		return;
+	}
+
+	Global_uint8Profile = Local_uint8Target;
+
+	for(Local_uint8Listener = 0u; Local_uint8Listener < Global_uint8Listeners; Local_uint8Listener++)
+	{
+		(void)Global_Listeners[Local_uint8Listener](APP_CLOCK_AFTER, SystemCoreClock);
+	}
+}
@@ -0,0 +1,207 @@
+#include <string.h>
+#include "App_Fat.h"
+
+#define FAT_SIGNATURE_OFFSET         510u
+#define FAT_PARTITION_TABLE          446u
+#define FAT_PARTITION_ENTRY_SIZE     16u
+#define FAT_DIR_ENTRY_SIZE           32u
+
+#define FAT_ATTR_VOLUME              0x08u
+#define FAT_ATTR_DIRECTORY           0x10u
+#define FAT_ENTRY_DELETED            0xE5u
+
+/* Below this many clusters a volume is FAT12, below the second FAT16 (Microsoft FAT specification) */
+#define FAT_FAT16_MIN_CLUSTERS       4085u
+#define FAT_FAT32_MIN_CLUSTERS       65525u
+
+
+static uint16_t App_FatGet16(const uint8_t* Bytes)
+{
+	return (uint16_t)(Bytes[0] | ((uint16_t)Bytes[1] << 8));
+}
+
+static uint32_t App_FatGet32(const uint8_t* Bytes)
+{
+	return Bytes[0] | ((uint32_t)Bytes[1] << 8) | ((uint32_t)Bytes[2] << 16) | ((uint32_t)Bytes[3] << 24);
+}
+
+
+/* A boot sector: x86 jump, 512-byte sectors and a power-of-two cluster size */
+static uint8_t App_FatIsBootSector(const uint8_t* Sector)
+{
+	uint8_t Local_uint8Cluster = Sector[13];
+
+	return (uint8_t)(((Sector[0] == 0xEBu) || (Sector[0] == 0xE9u)) &&
+	                 (App_FatGet16(&Sector[11]) == APP_FAT_SECTOR_SIZE) &&
+	                 (Local_uint8Cluster != 0u) && ((Local_uint8Cluster & (Local_uint8Cluster - 1u)) == 0u));
+}
+
+
+/*
+ * App_FatVolumeLba
+ * ----------------
+ * Sector 0 of the drive: a boot sector itself (Lba 0), or an MBR whose first
+ * FAT16 / FAT32 partition gives the boot sector's Lba.
+ */
+uint8_t App_FatVolumeLba(const uint8_t* Sector, uint32_t* Lba)
+{
+	const uint8_t* Local_puint8Entry;
+	uint8_t Local_uint8Index;
+	uint8_t Local_uint8Type;
+
+	if(App_FatGet16(&Sector[FAT_SIGNATURE_OFFSET]) != 0xAA55u)
+	{
+		return 0u;
+	}
+
+	if(App_FatIsBootSector(Sector) != 0u)
+	{
+		*Lba = 0u;
+		return 1u;
+	}
+
+	for(Local_uint8Index = 0; Local_uint8Index < 4u; Local_uint8Index++)
+	{
+		Local_puint8Entry = &Sector[FAT_PARTITION_TABLE + (Local_uint8Index * FAT_PARTITION_ENTRY_SIZE)];
+		Local_uint8Type   = Local_puint8Entry[4];
+
+		/* FAT16 (CHS, LBA, < 32 MB), FAT32 (CHS, LBA) */
+		if((Local_uint8Type == 0x04u) || (Local_uint8Type == 0x06u) || (Local_uint8Type == 0x0Eu) ||
+		   (Local_uint8Type == 0x0Bu) || (Local_uint8Type == 0x0Cu))
+		{
+			*Lba = App_FatGet32(&Local_puint8Entry[8]);
+			return 1u;
+		}
+	}
+
+	return 0u;
+}
+
+
+/*
+ * App_FatMount
+ * ------------
+ * Decodes the BIOS parameter block of the boot sector at Lba. The FAT type
+ * follows from the cluster count alone, as the specification says; FAT12
+ * is refused.
+ */
+uint8_t App_FatMount(AppFat_t* Fat, const uint8_t* Sector, uint32_t Lba)
+{
+	uint32_t Local_uint32Reserved;
+	uint32_t Local_uint32FatSize;
+	uint32_t Local_uint32Total;
+	uint32_t Local_uint32RootEntries;
+
+	if((App_FatGet16(&Sector[FAT_SIGNATURE_OFFSET]) != 0xAA55u) || (App_FatIsBootSector(Sector) == 0u) || (Sector[16] == 0u))
+	{
+		return 0u;
+	}
+
+	Local_uint32Reserved    = App_FatGet16(&Sector[14]);
+	Local_uint32RootEntries = App_FatGet16(&Sector[17]);
+	Local_uint32Total       = (App_FatGet16(&Sector[19]) != 0u) ? App_FatGet16(&Sector[19]) : App_FatGet32(&Sector[32]);
+	Local_uint32FatSize     = (App_FatGet16(&Sector[22]) != 0u) ? App_FatGet16(&Sector[22]) : App_FatGet32(&Sector[36]);
+
+	Fat->SectorsPerCluster = Sector[13];
+	Fat->FatLba            = Lba + Local_uint32Reserved;
+	Fat->RootLba           = Fat->FatLba + (Sector[16] * Local_uint32FatSize);
+	Fat->RootSectors       = ((Local_uint32RootEntries * FAT_DIR_ENTRY_SIZE) + (APP_FAT_SECTOR_SIZE - 1u)) / APP_FAT_SECTOR_SIZE;
+	Fat->DataLba           = Fat->RootLba + Fat->RootSectors;
+
+	if((Local_uint32FatSize == 0u) || (Local_uint32Total <= (Fat->DataLba - Lba)))
+	{
+		return 0u;
+	}
+
+	Fat->ClusterCount = (Local_uint32Total - (Fat->DataLba - Lba)) / Fat->SectorsPerCluster;
+
+	if(Fat->ClusterCount < FAT_FAT16_MIN_CLUSTERS)
+	{
+		return 0u;
+	}
+	else if(Fat->ClusterCount < FAT_FAT32_MIN_CLUSTERS)
+	{
+		Fat->Type        = APP_FAT_16;
+		Fat->RootCluster = 0u;
+	}
+	else
+	{
+		Fat->Type        = APP_FAT_32;
+		Fat->RootCluster = App_FatGet32(&Sector[44]);
+		Fat->RootSectors = 0u;
+	}
+
+	return 1u;
+}
+
+
+uint32_t App_FatClusterLba(const AppFat_t* Fat, uint32_t Cluster)
+{
+	return Fat->DataLba + ((Cluster - 2u) * Fat->SectorsPerCluster);
+}
+
+
+uint32_t App_FatEntryLba(const AppFat_t* Fat, uint32_t Cluster)
+{
+	uint32_t Local_uint32EntrySize = (Fat->Type == APP_FAT_32) ? 4u : 2u;
+
+	return Fat->FatLba + ((Cluster * Local_uint32EntrySize) / APP_FAT_SECTOR_SIZE);
+}
+
+
+/*
+ * App_FatNextCluster
+ * ------------------
+ * The entry of Cluster in its FAT sector (App_FatEntryLba). End of chain,
+ * free, reserved and bad entries, and clusters outside the volume all end
+ * the chain.
+ */
+uint32_t App_FatNextCluster(const AppFat_t* Fat, const uint8_t* Sector, uint32_t Cluster)
+{
+	uint32_t Local_uint32Next;
+
+	if(Fat->Type == APP_FAT_32)
+	{
+		Local_uint32Next = App_FatGet32(&Sector[(Cluster * 4u) % APP_FAT_SECTOR_SIZE]) & 0x0FFFFFFFUL;
+	}
+	else
+	{
+		Local_uint32Next = App_FatGet16(&Sector[(Cluster * 2u) % APP_FAT_SECTOR_SIZE]);
+	}
+
+	return ((Local_uint32Next >= 2u) && (Local_uint32Next < (Fat->ClusterCount + 2u))) ? Local_uint32Next : APP_FAT_CHAIN_END;
+}
+
+
+/*
+ * App_FatFindFile
+ * ---------------
+ * Looks for a file (not a directory or volume label) named Name, 8.3 padded
+ * with spaces and upper case, in one directory sector. On FAT16 the high
+ * cluster word is 0.
+ */
+uint8_t App_FatFindFile(const uint8_t* Sector, const char* Name, uint32_t* Cluster, uint32_t* Size)
+{
+	const uint8_t* Local_puint8Entry;
+	uint32_t Local_uint32Offset;
+
+	for(Local_uint32Offset = 0; Local_uint32Offset < APP_FAT_SECTOR_SIZE; Local_uint32Offset += FAT_DIR_ENTRY_SIZE)
+	{
+		Local_puint8Entry = &Sector[Local_uint32Offset];
+
+		if(Local_puint8Entry[0] == 0x00u)
+		{
+			return APP_FAT_END;
+		}
+
+		if((Local_puint8Entry[0] != FAT_ENTRY_DELETED) && ((Local_puint8Entry[11] & (FAT_ATTR_VOLUME | FAT_ATTR_DIRECTORY)) == 0u) &&
+		   (memcmp(Local_puint8Entry, Name, 11u) == 0))
+		{
+			*Cluster = ((uint32_t)App_FatGet16(&Local_puint8Entry[20]) << 16) | App_FatGet16(&Local_puint8Entry[26]);
+			*Size    = App_FatGet32(&Local_puint8Entry[28]);
+			return APP_FAT_FOUND;
+		}
+	}
+
+	return APP_FAT_NOT_HERE;
+}
@@ -0,0 +1,1023 @@
+#include <string.h>
+#include "main.h"
+#include "usbh_ioreq.h"
+#include "usbh_pipes.h"
+#include "App_Hub.h"
+#include "App_Scheduler.h"
+#include "Ring.h"
+
+#define HUB_CLASS_CODE               0x09u
+#define CDC_COMM_CLASS_CODE          0x02u
+
+/* Hub class requests (USB 2.0 section 11.24) */
+#define HUB_DESCRIPTOR               (0x29u << 8)
+#define HUB_REQ_HUB_IN               (USB_D2H | USB_REQ_TYPE_CLASS | USB_REQ_RECIPIENT_DEVICE)
+#define HUB_REQ_PORT_IN              (USB_D2H | USB_REQ_TYPE_CLASS | USB_REQ_RECIPIENT_OTHER)
+#define HUB_REQ_PORT_OUT             (USB_H2D | USB_REQ_TYPE_CLASS | USB_REQ_RECIPIENT_OTHER)
+#define HUB_FEATURE_PORT_RESET       4u
+#define HUB_FEATURE_PORT_POWER       8u
+#define HUB_FEATURE_C_CONNECTION     16u       /* wPortChange bit n: feature 16 + n */
+
+/* wPortStatus and wPortChange */
+#define HUB_PORT_CONNECTION          0x0001u
+#define HUB_PORT_ENABLE              0x0002u
+#define HUB_PORT_LOW_SPEED           0x0200u
+#define HUB_PORT_CHANGES             0x001Fu   /* Connection, enable, suspend, over-current, reset */
+
+#define CDC_REQ_OUT                  (USB_H2D | USB_REQ_TYPE_CLASS | USB_REQ_RECIPIENT_INTERFACE)
+#define CDC_SET_CONTROL_LINE_STATE   0x22u
+#define CDC_LINE_DTR_RTS             0x0003u
+
+#define HUB_RESET_RECOVERY_MS        10u       /* TRSTRCY, after the reset ends */
+#define HUB_ADDRESS_RECOVERY_MS      2u        /* TRSQRCY, after SET_ADDRESS */
+#define HUB_BULK_RETRY_MS            1u        /* After a NAK: bInterval means nothing for full-speed bulk */
+#define HUB_IN_SLOT_MS               2u        /* A transfer left to the channel's NAK retries: at least one whole frame */
+
+#define HUB_NO_DEVICE                0xFFu
+#define HUB_NO_INTERFACE             0xFFu
+
+/* Global_Hub.State */
+#define HUB_STATE_NONE               0u
+#define HUB_STATE_DESCRIPTOR         1u
+#define HUB_STATE_POWER              2u
+#define HUB_STATE_RUN                3u
+#define HUB_STATE_FAILED             4u
+
+/* Global_Hub.Step: the port being looked at */
+#define HUB_STEP_IDLE                0u
+#define HUB_STEP_STATUS              1u
+#define HUB_STEP_CLEAR               2u
+#define HUB_STEP_RESET               3u
+#define HUB_STEP_DEVICE_DESC         4u        /* From here on: enumerating */
+#define HUB_STEP_ADDRESS             5u
+#define HUB_STEP_CONFIG_HEADER       6u
+#define HUB_STEP_CONFIG              7u
+#define HUB_STEP_SET_CONFIG          8u
+#define HUB_STEP_LINE_STATE          9u
+
+/* AppHubDevice_t.State */
+#define HUB_DEVICE_NONE              0u
+#define HUB_DEVICE_RESET             1u        /* Port reset asked for */
+#define HUB_DEVICE_ENUMERATING       2u
+#define HUB_DEVICE_READY             3u
+#define HUB_DEVICE_OFF               4u        /* Failed, stalled or nothing to poll: until unplugged */
+
+/* Global_Hub.CtlPhase */
+#define HUB_CONTROL_IDLE             0u
+#define HUB_CONTROL_SETUP_WAIT       1u
+#define HUB_CONTROL_DATA_WAIT        2u
+#define HUB_CONTROL_STATUS_WAIT      3u
+
+/* uint8_HubControl results */
+#define HUB_CONTROL_BUSY             0u
+#define HUB_CONTROL_DONE             1u
+#define HUB_CONTROL_FAILED           2u
+
+typedef struct
+{
+	uint8_t  State;
+	uint8_t  Address;
+	uint8_t  Speed;                            /* USBH_SPEED_FULL or USBH_SPEED_LOW */
+	uint8_t  Mps0;
+	uint8_t  Configuration;                    /* bConfigurationValue */
+	uint8_t  CommInterface;                    /* CDC communication interface, HUB_NO_INTERFACE without */
+	uint8_t  InEp;
+	uint8_t  InType;                           /* USB_EP_TYPE_BULK or USB_EP_TYPE_INTR */
+	uint8_t  InToggle;
+	uint8_t  InInterval;                       /* ms after a NAK */
+	uint16_t InSize;
+	uint8_t  OutEp;                            /* 0: none */
+	uint8_t  OutType;
+	uint8_t  OutToggle;
+	uint16_t OutSize;
+	uint16_t TxLength;                         /* Queued by App_HubWrite, 0 none */
+	uint32_t InDue;                            /* phost->Timer of its next IN turn */
+} AppHubDevice_t;
+
+typedef struct
+{
+	uint8_t  State;
+	uint8_t  Step;
+	uint8_t  Ports;
+	uint8_t  Port;                             /* 1 .. Ports, the one Step is for */
+	uint8_t  Pending;                          /* Bit n: port n has a change to look at */
+	uint8_t  Feature;                          /* HUB_STEP_CLEAR */
+	uint16_t PortStatus;
+	uint16_t ConfigLength;
+	uint32_t Wait;                             /* phost->Timer the next step waits for */
+
+	uint8_t  IntPipe;                          /* Status change endpoint */
+	uint8_t  IntEp;
+	uint8_t  IntSize;
+	uint8_t  IntInterval;
+	uint8_t  IntBusy;
+	uint32_t IntDue;
+
+	uint8_t  CtlOut;                           /* Control pipes, on CtlAddress */
+	uint8_t  CtlIn;
+	uint8_t  CtlAddress;
+	uint8_t  CtlSize;
+	uint8_t  CtlPhase;
+	uint32_t CtlStart;
+
+	uint8_t  InPipe;                           /* Shared by every device's data */
+	uint8_t  InDevice;                         /* HUB_NO_DEVICE: free */
+	uint8_t  InNext;                           /* Round robin: the first device looked at */
+	uint32_t InStart;
+	uint8_t  OutPipe;
+	uint8_t  OutDevice;
+	uint8_t  OutNext;
+	uint32_t OutStart;
+
+	uint8_t  Setup[8] __attribute__((aligned(4)));
+	uint8_t  Change[8] __attribute__((aligned(4)));
+	uint8_t  Reply[APP_HUB_CONFIG_SIZE] __attribute__((aligned(4)));   /* Descriptors, port status */
+
+	AppHubDevice_t Devices[APP_HUB_MAX_PORTS];
+} AppHub_t;
+
+static AppHub_t Global_Hub;
+
+/* Per device: the packet in flight each way, and the receive ring (Ring.h): App_HubProcess the producer */
+static uint8_t Global_uint8HubRx[APP_HUB_MAX_PORTS][APP_HUB_PACKET_SIZE] __attribute__((aligned(4))) APP_RAM_BUDGET("rx");
+static uint8_t Global_uint8HubTx[APP_HUB_MAX_PORTS][APP_HUB_PACKET_SIZE] __attribute__((aligned(4))) APP_RAM_BUDGET("rx");
+static uint8_t Global_uint8HubRing[APP_HUB_MAX_PORTS][APP_HUB_RX_RING_SIZE] APP_RAM_BUDGET("rx");
+static Ring_t  Global_HubRings[APP_HUB_MAX_PORTS];
+
+static USBH_StatusTypeDef App_HubInit(USBH_HandleTypeDef *phost);
+static USBH_StatusTypeDef App_HubDeInit(USBH_HandleTypeDef *phost);
+static USBH_StatusTypeDef App_HubRequests(USBH_HandleTypeDef *phost);
+static USBH_StatusTypeDef App_HubProcess(USBH_HandleTypeDef *phost);
+static USBH_StatusTypeDef App_HubSOFProcess(USBH_HandleTypeDef *phost);
+
+USBH_ClassTypeDef App_HubClass =
+{
+	"HUB",
+	HUB_CLASS_CODE,
+	App_HubInit,
+	App_HubDeInit,
+	App_HubRequests,
+	App_HubProcess,
+	App_HubSOFProcess,
+	NULL,
+};
+
+
+/* Reopens the control pipes when the transfer goes to another device, or the same at another EP0 size */
+static void App_HubControlPipes(USBH_HandleTypeDef *phost, uint8_t Address)
+{
+	uint8_t Local_uint8Size  = (uint8_t)phost->Control.pipe_size;
+	uint8_t Local_uint8Speed = phost->device.speed;
+
+	/* Anything but the hub is the device on the port being enumerated */
+	if(Address != phost->device.address)
+	{
+		Local_uint8Size  = Global_Hub.Devices[Global_Hub.Port - 1u].Mps0;
+		Local_uint8Speed = Global_Hub.Devices[Global_Hub.Port - 1u].Speed;
+	}
+
+	if((Address != Global_Hub.CtlAddress) || (Local_uint8Size != Global_Hub.CtlSize))
+	{
+		(void)USBH_OpenPipe(phost, Global_Hub.CtlOut, 0x00u, Address, Local_uint8Speed, USB_EP_TYPE_CTRL, Local_uint8Size);
+		(void)USBH_OpenPipe(phost, Global_Hub.CtlIn, 0x80u, Address, Local_uint8Speed, USB_EP_TYPE_CTRL, Local_uint8Size);
+		Global_Hub.CtlAddress = Address;
+		Global_Hub.CtlSize    = Local_uint8Size;
+	}
+}
+
+
+/*
+ * uint8_HubControl
+ * ----------------
+ * One control transfer to Address on the class's own control pipes, so a
+ * device that stops answering fails only its transfer (the core's would
+ * give up on the hub): SETUP, then Length bytes IN if there are any (no
+ * request here sends data OUT), then the status stage. Called with the
+ * same arguments on every pass until it returns HUB_CONTROL_DONE or
+ * HUB_CONTROL_FAILED; APP_HUB_CONTROL_TIMEOUT_MS covers all stages.
+ */
+static uint8_t uint8_HubControl(USBH_HandleTypeDef *phost, uint8_t Address, uint8_t RequestType, uint8_t Request,
+                                uint16_t Value, uint16_t Index, uint8_t* Data, uint16_t Length)
+{
+	uint8_t Local_uint8Result = HUB_CONTROL_BUSY;
+	USBH_URBStateTypeDef Local_Urb;
+
+	switch(Global_Hub.CtlPhase)
+	{
+	case HUB_CONTROL_IDLE:
+		App_HubControlPipes(phost, Address);
+		Global_Hub.Setup[0] = RequestType;
+		Global_Hub.Setup[1] = Request;
+		Global_Hub.Setup[2] = (uint8_t)Value;
+		Global_Hub.Setup[3] = (uint8_t)(Value >> 8);
+		Global_Hub.Setup[4] = (uint8_t)Index;
+		Global_Hub.Setup[5] = (uint8_t)(Index >> 8);
+		Global_Hub.Setup[6] = (uint8_t)Length;
+		Global_Hub.Setup[7] = (uint8_t)(Length >> 8);
+		Global_Hub.CtlStart = phost->Timer;
+		(void)USBH_CtlSendSetup(phost, Global_Hub.Setup, Global_Hub.CtlOut);
+		Global_Hub.CtlPhase = HUB_CONTROL_SETUP_WAIT;
+		break;
+
+	case HUB_CONTROL_SETUP_WAIT:
+		Local_Urb = USBH_LL_GetURBState(phost, Global_Hub.CtlOut);
+		if((Local_Urb == USBH_URB_DONE) && (Length != 0u))
+		{
+			(void)USBH_CtlReceiveData(phost, Data, Length, Global_Hub.CtlIn);
+			Global_Hub.CtlPhase = HUB_CONTROL_DATA_WAIT;
+		}
+		else if(Local_Urb == USBH_URB_DONE)
+		{
+			(void)USBH_CtlReceiveData(phost, NULL, 0u, Global_Hub.CtlIn);
+			Global_Hub.CtlPhase = HUB_CONTROL_STATUS_WAIT;
+		}
+		else if(Local_Urb != USBH_URB_IDLE)
+		{
+			Local_uint8Result = HUB_CONTROL_FAILED;
+		}
+		break;
+
+	case HUB_CONTROL_DATA_WAIT:
+		Local_Urb = USBH_LL_GetURBState(phost, Global_Hub.CtlIn);
+		if(Local_Urb == USBH_URB_DONE)
+		{
+			(void)USBH_CtlSendData(phost, NULL, 0u, Global_Hub.CtlOut, 0u);
+			Global_Hub.CtlPhase = HUB_CONTROL_STATUS_WAIT;
+		}
+		else if((Local_Urb == USBH_URB_STALL) || (Local_Urb == USBH_URB_ERROR))
+		{
+			Local_uint8Result = HUB_CONTROL_FAILED;
+		}
+		break;
+
+	case HUB_CONTROL_STATUS_WAIT:
+		Local_Urb = USBH_LL_GetURBState(phost, (Length != 0u) ? Global_Hub.CtlOut : Global_Hub.CtlIn);
+		if(Local_Urb == USBH_URB_DONE)
+		{
+			Local_uint8Result = HUB_CONTROL_DONE;
+		}
+		else if((Local_Urb == USBH_URB_NOTREADY) && (Length != 0u))
+		{
+			(void)USBH_CtlSendData(phost, NULL, 0u, Global_Hub.CtlOut, 0u);
+		}
+		else if((Local_Urb == USBH_URB_STALL) || (Local_Urb == USBH_URB_ERROR))
+		{
+			Local_uint8Result = HUB_CONTROL_FAILED;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	if((Local_uint8Result == HUB_CONTROL_BUSY) && ((phost->Timer - Global_Hub.CtlStart) > APP_HUB_CONTROL_TIMEOUT_MS))
+	{
+		(void)USBH_ClosePipe(phost, Global_Hub.CtlOut);
+		(void)USBH_ClosePipe(phost, Global_Hub.CtlIn);
+		Global_Hub.CtlAddress = 0xFFu;
+		Local_uint8Result = HUB_CONTROL_FAILED;
+	}
+
+	if(Local_uint8Result != HUB_CONTROL_BUSY)
+	{
+		Global_Hub.CtlPhase = HUB_CONTROL_IDLE;
+	}
+
+	return Local_uint8Result;
+}
+
+
+/*
+ * App_HubInit
+ * -----------
+ * Takes the hub interface and its status change endpoint, and allocates
+ * the five pipes the class shares out: status change, control pair, data
+ * IN, data OUT.
+ */
+static USBH_StatusTypeDef App_HubInit(USBH_HandleTypeDef *phost)
+{
+	uint8_t Local_uint8Interface = USBH_FindInterface(phost, HUB_CLASS_CODE, 0xFFu, 0xFFu);
+	USBH_EpDescTypeDef* Local_pEp;
+
+	if((Local_uint8Interface == 0xFFu) || (Local_uint8Interface >= USBH_MAX_NUM_INTERFACES) ||
+	   (USBH_SelectInterface(phost, Local_uint8Interface) != USBH_OK))
+	{
+		return USBH_FAIL;
+	}
+
+	Local_pEp = &phost->device.CfgDesc.Itf_Desc[Local_uint8Interface].Ep_Desc[0];
+	if((Local_pEp->bEndpointAddress & USB_EP_DIR_IN) == 0u)
+	{
+		return USBH_FAIL;
+	}
+
+	memset(&Global_Hub, 0, sizeof(Global_Hub));
+	phost->pActiveClass->pData = &Global_Hub;
+
+	Global_Hub.IntEp       = Local_pEp->bEndpointAddress;
+	Global_Hub.IntSize     = (Local_pEp->wMaxPacketSize < sizeof(Global_Hub.Change)) ? (uint8_t)Local_pEp->wMaxPacketSize : (uint8_t)sizeof(Global_Hub.Change);
+	Global_Hub.IntInterval = (Local_pEp->bInterval != 0u) ? Local_pEp->bInterval : 1u;
+
+	Global_Hub.IntPipe = USBH_AllocPipe(phost, Global_Hub.IntEp);
+	Global_Hub.CtlOut  = USBH_AllocPipe(phost, 0x00u);
+	Global_Hub.CtlIn   = USBH_AllocPipe(phost, 0x80u);
+	Global_Hub.InPipe  = USBH_AllocPipe(phost, 0x81u);
+	Global_Hub.OutPipe = USBH_AllocPipe(phost, 0x01u);
+
+	if((Global_Hub.IntPipe == 0xFFu) || (Global_Hub.CtlOut == 0xFFu) || (Global_Hub.CtlIn == 0xFFu) ||
+	   (Global_Hub.InPipe == 0xFFu) || (Global_Hub.OutPipe == 0xFFu))
+	{
+		return USBH_FAIL;
+	}
+
+	(void)USBH_OpenPipe(phost, Global_Hub.IntPipe, Global_Hub.IntEp, phost->device.address, phost->device.speed,
+	                    USB_EP_TYPE_INTR, Global_Hub.IntSize);
+	USBH_LL_SetToggle(phost, Global_Hub.IntPipe, 0u);
+
+	Global_Hub.CtlAddress = 0xFFu;
+	Global_Hub.InDevice   = HUB_NO_DEVICE;
+	Global_Hub.OutDevice  = HUB_NO_DEVICE;
+	Global_Hub.State      = HUB_STATE_DESCRIPTOR;
+
+	return USBH_OK;
+}
+
+
+static void App_HubFreePipe(USBH_HandleTypeDef *phost, uint8_t Pipe)
+{
+	if((Pipe != 0u) && (Pipe != 0xFFu))
+	{
+		(void)USBH_ClosePipe(phost, Pipe);
+		(void)USBH_FreePipe(phost, Pipe);
+	}
+}
+
+
+static USBH_StatusTypeDef App_HubDeInit(USBH_HandleTypeDef *phost)
+{
+	App_HubFreePipe(phost, Global_Hub.IntPipe);
+	App_HubFreePipe(phost, Global_Hub.CtlOut);
+	App_HubFreePipe(phost, Global_Hub.CtlIn);
+	App_HubFreePipe(phost, Global_Hub.InPipe);
+	App_HubFreePipe(phost, Global_Hub.OutPipe);
+
+	memset(&Global_Hub, 0, sizeof(Global_Hub));
+	phost->pActiveClass->pData = NULL;
+
+	return USBH_OK;
+}
+
+
+/* The hub descriptor and port power come in App_HubProcess, on the class's own pipes */
+static USBH_StatusTypeDef App_HubRequests(USBH_HandleTypeDef *phost)
+{
+	phost->pUser(phost, HOST_USER_CLASS_ACTIVE);
+
+	return USBH_OK;
+}
+
+
+static USBH_StatusTypeDef App_HubSOFProcess(USBH_HandleTypeDef *phost)
+{
+	(void)phost;
+
+	return USBH_OK;
+}
+
+
+/* The device on a port is gone, or about to be: its data transfers stop, its ring is kept for the reader */
+static void App_HubDrop(USBH_HandleTypeDef *phost, uint8_t Device)
+{
+	if(Global_Hub.InDevice == Device)
+	{
+		(void)USBH_ClosePipe(phost, Global_Hub.InPipe);
+		Global_Hub.InDevice = HUB_NO_DEVICE;
+	}
+	if(Global_Hub.OutDevice == Device)
+	{
+		(void)USBH_ClosePipe(phost, Global_Hub.OutPipe);
+		Global_Hub.OutDevice = HUB_NO_DEVICE;
+	}
+
+	Global_Hub.Devices[Device].State    = HUB_DEVICE_NONE;
+	Global_Hub.Devices[Device].TxLength = 0u;
+}
+
+
+/*
+ * uint8_HubParseConfig
+ * --------------------
+ * Picks the first IN and OUT endpoints (bulk or interrupt) outside a CDC
+ * communication interface, whose interrupt IN only carries notifications,
+ * and notes that interface for SET_CONTROL_LINE_STATE. 0 when there is
+ * no IN endpoint to poll.
+ */
+static uint8_t uint8_HubParseConfig(AppHubDevice_t* Device, uint16_t Length)
+{
+	const uint8_t* Local_puint8Desc = Global_Hub.Reply;
+	uint16_t Local_uint16Offset = 0u;
+	uint8_t  Local_uint8Class   = 0u;
+	uint8_t  Local_uint8Type;
+	uint16_t Local_uint16Size;
+
+	Device->Configuration = Local_puint8Desc[5];
+	Device->CommInterface = HUB_NO_INTERFACE;
+	Device->InEp          = 0u;
+	Device->OutEp         = 0u;
+
+	while(((Local_uint16Offset + 2u) <= Length) && (Local_puint8Desc[Local_uint16Offset] >= 2u) &&
+	      ((Local_uint16Offset + Local_puint8Desc[Local_uint16Offset]) <= Length))
+	{
+		const uint8_t* Local_puint8Item = &Local_puint8Desc[Local_uint16Offset];
+
+		if((Local_puint8Item[1] == USB_DESC_TYPE_INTERFACE) && (Local_puint8Item[0] >= USB_INTERFACE_DESC_SIZE))
+		{
+			Local_uint8Class = Local_puint8Item[5];
+			if((Local_uint8Class == CDC_COMM_CLASS_CODE) && (Device->CommInterface == HUB_NO_INTERFACE))
+			{
+				Device->CommInterface = Local_puint8Item[2];
+			}
+		}
+		else if((Local_puint8Item[1] == USB_DESC_TYPE_ENDPOINT) && (Local_puint8Item[0] >= USB_ENDPOINT_DESC_SIZE) &&
+		        (Local_uint8Class != CDC_COMM_CLASS_CODE))
+		{
+			Local_uint8Type  = Local_puint8Item[3] & 0x03u;
+			Local_uint16Size = (uint16_t)(Local_puint8Item[4] | ((uint16_t)Local_puint8Item[5] << 8));
+			Local_uint16Size = (Local_uint16Size < APP_HUB_PACKET_SIZE) ? Local_uint16Size : APP_HUB_PACKET_SIZE;
+
+			if((Local_uint8Type == USB_EP_TYPE_BULK) || (Local_uint8Type == USB_EP_TYPE_INTR))
+			{
+				if(((Local_puint8Item[2] & USB_EP_DIR_IN) != 0u) && (Device->InEp == 0u))
+				{
+					Device->InEp       = Local_puint8Item[2];
+					Device->InType     = Local_uint8Type;
+					Device->InSize     = Local_uint16Size;
+					Device->InInterval = ((Local_uint8Type == USB_EP_TYPE_INTR) && (Local_puint8Item[6] != 0u)) ? Local_puint8Item[6] : HUB_BULK_RETRY_MS;
+				}
+				else if(((Local_puint8Item[2] & USB_EP_DIR_IN) == 0u) && (Device->OutEp == 0u))
+				{
+					Device->OutEp   = Local_puint8Item[2];
+					Device->OutType = Local_uint8Type;
+					Device->OutSize = Local_uint16Size;
+				}
+			}
+		}
+
+		Local_uint16Offset += Local_puint8Item[0];
+	}
+
+	return ((Device->InEp != 0u) && (Device->InSize != 0u)) ? 1u : 0u;
+}
+
+
+/* Port status read, no change left to clear: what the port needs next */
+static uint8_t uint8_HubPortAction(USBH_HandleTypeDef *phost, AppHubDevice_t* Device)
+{
+	if((Global_Hub.PortStatus & HUB_PORT_CONNECTION) == 0u)
+	{
+		App_HubDrop(phost, (uint8_t)(Global_Hub.Port - 1u));
+		return HUB_STEP_IDLE;
+	}
+
+	if(Device->State == HUB_DEVICE_NONE)
+	{
+		return HUB_STEP_RESET;
+	}
+
+	if((Device->State == HUB_DEVICE_RESET) && ((Global_Hub.PortStatus & HUB_PORT_ENABLE) != 0u))
+	{
+		Device->Speed   = ((Global_Hub.PortStatus & HUB_PORT_LOW_SPEED) != 0u) ? USBH_SPEED_LOW : USBH_SPEED_FULL;
+		Device->Address = (uint8_t)(phost->device.address + Global_Hub.Port);
+		Device->Mps0    = 8u;
+		Device->State   = HUB_DEVICE_ENUMERATING;
+		Global_Hub.Wait = phost->Timer + HUB_RESET_RECOVERY_MS;
+		return HUB_STEP_DEVICE_DESC;
+	}
+
+	return HUB_STEP_IDLE;
+}
+
+
+/*
+ * App_HubPortStep
+ * ---------------
+ * One port at a time, the lowest with a change pending: its status, each
+ * change bit cleared and the status read again, then what the port
+ * needs. A connection change drops whatever was on the port; a new
+ * connection is reset, and once the reset is over (a change of its own)
+ * the device is enumerated, every step a transfer of uint8_HubControl.
+ */
+static void App_HubPortStep(USBH_HandleTypeDef *phost)
+{
+	AppHubDevice_t* Local_pDevice;
+	uint8_t  Local_uint8Result = HUB_CONTROL_BUSY;
+	uint16_t Local_uint16Change;
+
+	if((int32_t)(phost->Timer - Global_Hub.Wait) < 0)
+	{
+		return;
+	}
+
+	if(Global_Hub.Step == HUB_STEP_IDLE)
+	{
+		if(Global_Hub.Pending == 0u)
+		{
+			return;
+		}
+		for(Global_Hub.Port = 1u; (Global_Hub.Pending & (1u << Global_Hub.Port)) == 0u; Global_Hub.Port++)
+		{
+		}
+		Global_Hub.Step = HUB_STEP_STATUS;
+	}
+
+	Local_pDevice = &Global_Hub.Devices[Global_Hub.Port - 1u];
+
+	switch(Global_Hub.Step)
+	{
+	case HUB_STEP_STATUS:
+		Local_uint8Result = uint8_HubControl(phost, phost->device.address, HUB_REQ_PORT_IN, USB_REQ_GET_STATUS, 0u,
+		                                     Global_Hub.Port, Global_Hub.Reply, 4u);
+		if(Local_uint8Result == HUB_CONTROL_DONE)
+		{
+			Global_Hub.PortStatus = (uint16_t)(Global_Hub.Reply[0] | ((uint16_t)Global_Hub.Reply[1] << 8));
+			Local_uint16Change    = (uint16_t)(Global_Hub.Reply[2] | ((uint16_t)Global_Hub.Reply[3] << 8)) & HUB_PORT_CHANGES;
+
+			if((Local_uint16Change & HUB_PORT_CONNECTION) != 0u)
+			{
+				App_HubDrop(phost, (uint8_t)(Global_Hub.Port - 1u));
+			}
+
+			if(Local_uint16Change != 0u)
+			{
+				for(Global_Hub.Feature = HUB_FEATURE_C_CONNECTION; (Local_uint16Change & 1u) == 0u; Global_Hub.Feature++)
+				{
+					Local_uint16Change >>= 1;
+				}
+				Global_Hub.Step = HUB_STEP_CLEAR;
+			}
+			else
+			{
+				Global_Hub.Step = uint8_HubPortAction(phost, Local_pDevice);
+			}
+		}
+		break;
+
+	case HUB_STEP_CLEAR:
+		Local_uint8Result = uint8_HubControl(phost, phost->device.address, HUB_REQ_PORT_OUT, USB_REQ_CLEAR_FEATURE,
+		                                     Global_Hub.Feature, Global_Hub.Port, NULL, 0u);
+		if(Local_uint8Result == HUB_CONTROL_DONE)
+		{
+			Global_Hub.Step = HUB_STEP_STATUS;
+		}
+		break;
+
+	case HUB_STEP_RESET:
+		Local_uint8Result = uint8_HubControl(phost, phost->device.address, HUB_REQ_PORT_OUT, USB_REQ_SET_FEATURE,
+		                                     HUB_FEATURE_PORT_RESET, Global_Hub.Port, NULL, 0u);
+		if(Local_uint8Result == HUB_CONTROL_DONE)
+		{
+			/* The end of the reset comes as a change on the status endpoint */
+			Local_pDevice->State = HUB_DEVICE_RESET;
+			Global_Hub.Step      = HUB_STEP_IDLE;
+		}
+		break;
+
+	case HUB_STEP_DEVICE_DESC:
+		Local_uint8Result = uint8_HubControl(phost, 0u, USB_D2H | USB_REQ_TYPE_STANDARD, USB_REQ_GET_DESCRIPTOR,
+		                                     USB_DESC_DEVICE, 0u, Global_Hub.Reply, 8u);
+		if(Local_uint8Result == HUB_CONTROL_DONE)
+		{
+			Local_pDevice->Mps0 = (Global_Hub.Reply[7] >= 8u) ? Global_Hub.Reply[7] : 8u;
+			Global_Hub.Step     = HUB_STEP_ADDRESS;
+		}
+		break;
+
+	case HUB_STEP_ADDRESS:
+		Local_uint8Result = uint8_HubControl(phost, 0u, USB_H2D | USB_REQ_TYPE_STANDARD, USB_REQ_SET_ADDRESS,
+		                                     Local_pDevice->Address, 0u, NULL, 0u);
+		if(Local_uint8Result == HUB_CONTROL_DONE)
+		{
+			Global_Hub.Wait = phost->Timer + HUB_ADDRESS_RECOVERY_MS;
+			Global_Hub.Step = HUB_STEP_CONFIG_HEADER;
+		}
+		break;
+
+	case HUB_STEP_CONFIG_HEADER:
+		Local_uint8Result = uint8_HubControl(phost, Local_pDevice->Address, USB_D2H | USB_REQ_TYPE_STANDARD, USB_REQ_GET_DESCRIPTOR,
+		                                     USB_DESC_CONFIGURATION, 0u, Global_Hub.Reply, USB_CONFIGURATION_DESC_SIZE);
+		if(Local_uint8Result == HUB_CONTROL_DONE)
+		{
+			Global_Hub.ConfigLength = (uint16_t)(Global_Hub.Reply[2] | ((uint16_t)Global_Hub.Reply[3] << 8));
+			Global_Hub.ConfigLength = (Global_Hub.ConfigLength < APP_HUB_CONFIG_SIZE) ? Global_Hub.ConfigLength : APP_HUB_CONFIG_SIZE;
+			Global_Hub.Step         = HUB_STEP_CONFIG;
+		}
+		break;
+
+	case HUB_STEP_CONFIG:
+		Local_uint8Result = uint8_HubControl(phost, Local_pDevice->Address, USB_D2H | USB_REQ_TYPE_STANDARD, USB_REQ_GET_DESCRIPTOR,
+		                                     USB_DESC_CONFIGURATION, 0u, Global_Hub.Reply, Global_Hub.ConfigLength);
+		if(Local_uint8Result == HUB_CONTROL_DONE)
+		{
+			if(uint8_HubParseConfig(Local_pDevice, Global_Hub.ConfigLength) != 0u)
+			{
+				Global_Hub.Step = HUB_STEP_SET_CONFIG;
+			}
+			else
+			{
+				Local_pDevice->State = HUB_DEVICE_OFF;
+				Global_Hub.Step      = HUB_STEP_IDLE;
+			}
+		}
+		break;
+
+	case HUB_STEP_SET_CONFIG:
+		Local_uint8Result = uint8_HubControl(phost, Local_pDevice->Address, USB_H2D | USB_REQ_TYPE_STANDARD, USB_REQ_SET_CONFIGURATION,
+		                                     Local_pDevice->Configuration, 0u, NULL, 0u);
+		if(Local_uint8Result == HUB_CONTROL_DONE)
+		{
+			Global_Hub.Step = (Local_pDevice->CommInterface != HUB_NO_INTERFACE) ? HUB_STEP_LINE_STATE : HUB_STEP_IDLE;
+		}
+		break;
+
+	case HUB_STEP_LINE_STATE:
+		/* Many CDC devices only send with DTR on; one that refuses the request still gets polled */
+		Local_uint8Result = uint8_HubControl(phost, Local_pDevice->Address, CDC_REQ_OUT, CDC_SET_CONTROL_LINE_STATE,
+		                                     CDC_LINE_DTR_RTS, Local_pDevice->CommInterface, NULL, 0u);
+		if(Local_uint8Result != HUB_CONTROL_BUSY)
+		{
+			Local_uint8Result = HUB_CONTROL_DONE;
+			Global_Hub.Step   = HUB_STEP_IDLE;
+		}
+		break;
+
+	default:
+		Global_Hub.Step = HUB_STEP_IDLE;
+		break;
+	}
+
+	if(Local_uint8Result == HUB_CONTROL_FAILED)
+	{
+		/* A hub request is tried again on the next change; a device that fails enumerating stays off */
+		if(Global_Hub.Step >= HUB_STEP_DEVICE_DESC)
+		{
+			Local_pDevice->State = HUB_DEVICE_OFF;
+		}
+		Global_Hub.Step = HUB_STEP_IDLE;
+	}
+	else if((Local_uint8Result == HUB_CONTROL_DONE) && (Local_pDevice->State == HUB_DEVICE_ENUMERATING) &&
+	        (Global_Hub.Step == HUB_STEP_IDLE))
+	{
+		Local_pDevice->InToggle  = 0u;
+		Local_pDevice->OutToggle = 0u;
+		Local_pDevice->TxLength  = 0u;
+		Local_pDevice->InDue     = phost->Timer;
+		(void)Ring_Init(&Global_HubRings[Global_Hub.Port - 1u], Global_uint8HubRing[Global_Hub.Port - 1u], APP_HUB_RX_RING_SIZE, 1u);
+		Local_pDevice->State     = HUB_DEVICE_READY;
+	}
+
+	if(Global_Hub.Step == HUB_STEP_IDLE)
+	{
+		Global_Hub.Pending &= (uint8_t)~(1u << Global_Hub.Port);
+	}
+}
+
+
+/* The status change endpoint, every bInterval: bit n set, port n changed; bit 0, the hub itself, is not used */
+static void App_HubStatusChange(USBH_HandleTypeDef *phost)
+{
+	USBH_URBStateTypeDef Local_Urb;
+
+	if(Global_Hub.IntBusy == 0u)
+	{
+		if((int32_t)(phost->Timer - Global_Hub.IntDue) >= 0)
+		{
+			(void)USBH_InterruptReceiveData(phost, Global_Hub.Change, Global_Hub.IntSize, Global_Hub.IntPipe);
+			Global_Hub.IntBusy = 1u;
+		}
+		return;
+	}
+
+	Local_Urb = USBH_LL_GetURBState(phost, Global_Hub.IntPipe);
+	if(Local_Urb == USBH_URB_DONE)
+	{
+		Global_Hub.Pending |= (uint8_t)(Global_Hub.Change[0] & ((1u << (Global_Hub.Ports + 1u)) - 2u));
+	}
+	if(Local_Urb != USBH_URB_IDLE)
+	{
+		Global_Hub.IntBusy = 0u;
+		Global_Hub.IntDue  = phost->Timer + Global_Hub.IntInterval;
+	}
+}
+
+
+/*
+ * App_HubUrbEnd
+ * -------------
+ * The state of a data transfer on a shared pipe. One still running after
+ * HUB_IN_SLOT_MS (a bulk endpoint NAKing, which the channel retries on its
+ * own) is halted, and read again in case it finished first; still running
+ * then, it counts as a NAK.
+ */
+static USBH_URBStateTypeDef App_HubUrbEnd(USBH_HandleTypeDef *phost, uint8_t Pipe, uint32_t Start)
+{
+	USBH_URBStateTypeDef Local_Urb = USBH_LL_GetURBState(phost, Pipe);
+
+	if((Local_Urb == USBH_URB_IDLE) && ((phost->Timer - Start) >= HUB_IN_SLOT_MS))
+	{
+		(void)USBH_ClosePipe(phost, Pipe);
+		Local_Urb = USBH_LL_GetURBState(phost, Pipe);
+		if(Local_Urb == USBH_URB_IDLE)
+		{
+			Local_Urb = USBH_URB_NOTREADY;
+		}
+	}
+
+	return Local_Urb;
+}
+
+
+/*
+ * App_HubPollIn
+ * -------------
+ * The shared IN pipe: the packet in flight first, then the next device in
+ * round robin that is due and has a packet's room in its ring (a full
+ * ring leaves the device to NAK, nothing is dropped). Data makes the
+ * device due again at once, a NAK after its interval.
+ */
+static void App_HubPollIn(USBH_HandleTypeDef *phost)
+{
+	AppHubDevice_t* Local_pDevice;
+	USBH_URBStateTypeDef Local_Urb;
+	uint32_t Local_uint32Length;
+	uint8_t  Local_uint8Index;
+	uint8_t  Local_uint8Device;
+
+	if(Global_Hub.InDevice != HUB_NO_DEVICE)
+	{
+		Local_pDevice = &Global_Hub.Devices[Global_Hub.InDevice];
+		Local_Urb     = App_HubUrbEnd(phost, Global_Hub.InPipe, Global_Hub.InStart);
+
+		if(Local_Urb == USBH_URB_IDLE)
+		{
+			return;
+		}
+
+		if(Local_Urb == USBH_URB_DONE)
+		{
+			Local_pDevice->InToggle = USBH_LL_GetToggle(phost, Global_Hub.InPipe);
+			Local_pDevice->InDue    = phost->Timer;
+			Local_uint32Length      = USBH_LL_GetLastXferSize(phost, Global_Hub.InPipe);
+
+			if(Local_uint32Length != 0u)
+			{
+				(void)Ring_Write(&Global_HubRings[Global_Hub.InDevice], Global_uint8HubRx[Global_Hub.InDevice], Local_uint32Length);
+#ifndef APP_CDC_BRIDGE
+				App_SchedSignal(APP_TASK_CDC, APP_EVENT_CDC_RX);
+#endif
+			}
+		}
+		else if(Local_Urb == USBH_URB_STALL)
+		{
+			Local_pDevice->State = HUB_DEVICE_OFF;
+		}
+		else
+		{
+			Local_pDevice->InDue = phost->Timer + Local_pDevice->InInterval;
+		}
+
+		Global_Hub.InDevice = HUB_NO_DEVICE;
+	}
+
+	for(Local_uint8Index = 0u; Local_uint8Index < APP_HUB_MAX_PORTS; Local_uint8Index++)
+	{
+		Local_uint8Device = (uint8_t)((Global_Hub.InNext + Local_uint8Index) % APP_HUB_MAX_PORTS);
+		Local_pDevice     = &Global_Hub.Devices[Local_uint8Device];
+
+		if((Local_pDevice->State == HUB_DEVICE_READY) && ((int32_t)(phost->Timer - Local_pDevice->InDue) >= 0) &&
+		   (Ring_Free(&Global_HubRings[Local_uint8Device]) >= Local_pDevice->InSize))
+		{
+			(void)USBH_OpenPipe(phost, Global_Hub.InPipe, Local_pDevice->InEp, Local_pDevice->Address, Local_pDevice->Speed,
+			                    Local_pDevice->InType, Local_pDevice->InSize);
+			USBH_LL_SetToggle(phost, Global_Hub.InPipe, Local_pDevice->InToggle);
+
+			if(Local_pDevice->InType == USB_EP_TYPE_INTR)
+			{
+				(void)USBH_InterruptReceiveData(phost, Global_uint8HubRx[Local_uint8Device], (uint8_t)Local_pDevice->InSize, Global_Hub.InPipe);
+			}
+			else
+			{
+				(void)USBH_BulkReceiveData(phost, Global_uint8HubRx[Local_uint8Device], Local_pDevice->InSize, Global_Hub.InPipe);
+			}
+
+			Global_Hub.InDevice = Local_uint8Device;
+			Global_Hub.InStart  = phost->Timer;
+			Global_Hub.InNext   = (uint8_t)((Local_uint8Device + 1u) % APP_HUB_MAX_PORTS);
+
+			/* The result is looked at on the next pass, not at the next 1 ms poll */
+			App_SchedSignal(APP_TASK_USB_HOST, APP_EVENT_USB_POLL);
+			return;
+		}
+	}
+}
+
+
+/* The shared OUT pipe: like App_HubPollIn, over the devices with a packet queued; a NAK tries again on the device's next turn */
+static void App_HubPollOut(USBH_HandleTypeDef *phost)
+{
+	AppHubDevice_t* Local_pDevice;
+	USBH_URBStateTypeDef Local_Urb;
+	uint8_t  Local_uint8Index;
+	uint8_t  Local_uint8Device;
+
+	if(Global_Hub.OutDevice != HUB_NO_DEVICE)
+	{
+		Local_pDevice = &Global_Hub.Devices[Global_Hub.OutDevice];
+		Local_Urb     = App_HubUrbEnd(phost, Global_Hub.OutPipe, Global_Hub.OutStart);
+
+		if(Local_Urb == USBH_URB_IDLE)
+		{
+			return;
+		}
+
+		if(Local_Urb == USBH_URB_DONE)
+		{
+			Local_pDevice->OutToggle = USBH_LL_GetToggle(phost, Global_Hub.OutPipe);
+			Local_pDevice->TxLength  = 0u;
+		}
+		else if(Local_Urb == USBH_URB_STALL)
+		{
+			Local_pDevice->State = HUB_DEVICE_OFF;
+		}
+
+		Global_Hub.OutDevice = HUB_NO_DEVICE;
+	}
+
+	for(Local_uint8Index = 0u; Local_uint8Index < APP_HUB_MAX_PORTS; Local_uint8Index++)
+	{
+		Local_uint8Device = (uint8_t)((Global_Hub.OutNext + Local_uint8Index) % APP_HUB_MAX_PORTS);
+		Local_pDevice     = &Global_Hub.Devices[Local_uint8Device];
+
+		if((Local_pDevice->State == HUB_DEVICE_READY) && (Local_pDevice->TxLength != 0u))
+		{
+			(void)USBH_OpenPipe(phost, Global_Hub.OutPipe, Local_pDevice->OutEp, Local_pDevice->Address, Local_pDevice->Speed,
+			                    Local_pDevice->OutType, Local_pDevice->OutSize);
+			USBH_LL_SetToggle(phost, Global_Hub.OutPipe, Local_pDevice->OutToggle);
+
+			if(Local_pDevice->OutType == USB_EP_TYPE_INTR)
+			{
+				(void)USBH_InterruptSendData(phost, Global_uint8HubTx[Local_uint8Device], (uint8_t)Local_pDevice->TxLength, Global_Hub.OutPipe);
+			}
+			else
+			{
+				(void)USBH_BulkSendData(phost, Global_uint8HubTx[Local_uint8Device], Local_pDevice->TxLength, Global_Hub.OutPipe, 0u);
+			}
+
+			Global_Hub.OutDevice = Local_uint8Device;
+			Global_Hub.OutStart  = phost->Timer;
+			Global_Hub.OutNext   = (uint8_t)((Local_uint8Device + 1u) % APP_HUB_MAX_PORTS);
+			App_SchedSignal(APP_TASK_USB_HOST, APP_EVENT_USB_POLL);
+			return;
+		}
+	}
+}
+
+
+/*
+ * App_HubProcess
+ * --------------
+ * The hub, then its ports and devices, on every pass of the host task.
+ *
+ * Behavior:
+ * ---------
+ * 1. The hub descriptor: the number of ports (up to APP_HUB_MAX_PORTS
+ *    served) and bPwrOn2PwrGood.
+ * 2. SET_FEATURE(PORT_POWER) on each port, then the power-good time before
+ *    every port's status is read.
+ * 3. Running: the status change endpoint, one port step, and the data
+ *    pipes, the three independent of each other.
+ */
+static USBH_StatusTypeDef App_HubProcess(USBH_HandleTypeDef *phost)
+{
+	uint8_t Local_uint8Result;
+
+	switch(Global_Hub.State)
+	{
+	case HUB_STATE_DESCRIPTOR:
+		Local_uint8Result = uint8_HubControl(phost, phost->device.address, HUB_REQ_HUB_IN, USB_REQ_GET_DESCRIPTOR,
+		                                     HUB_DESCRIPTOR, 0u, Global_Hub.Reply, 9u);
+		if(Local_uint8Result == HUB_CONTROL_DONE)
+		{
+			Global_Hub.Ports = (Global_Hub.Reply[2] < APP_HUB_MAX_PORTS) ? Global_Hub.Reply[2] : APP_HUB_MAX_PORTS;
+			Global_Hub.Wait  = 2u * Global_Hub.Reply[5];
+			Global_Hub.Port  = 1u;
+			Global_Hub.State = (Global_Hub.Ports != 0u) ? HUB_STATE_POWER : HUB_STATE_FAILED;
+		}
+		else if(Local_uint8Result == HUB_CONTROL_FAILED)
+		{
+			Global_Hub.State = HUB_STATE_FAILED;
+		}
+		break;
+
+	case HUB_STATE_POWER:
+		Local_uint8Result = uint8_HubControl(phost, phost->device.address, HUB_REQ_PORT_OUT, USB_REQ_SET_FEATURE,
+		                                     HUB_FEATURE_PORT_POWER, Global_Hub.Port, NULL, 0u);
+		if((Local_uint8Result == HUB_CONTROL_DONE) && (Global_Hub.Port < Global_Hub.Ports))
+		{
+			Global_Hub.Port++;
+		}
+		else if(Local_uint8Result == HUB_CONTROL_DONE)
+		{
+			/* Wait held bPwrOn2PwrGood in ms until now */
+			Global_Hub.Wait    = phost->Timer + Global_Hub.Wait;
+			Global_Hub.Pending = (uint8_t)((1u << (Global_Hub.Ports + 1u)) - 2u);
+			Global_Hub.State   = HUB_STATE_RUN;
+		}
+		else if(Local_uint8Result == HUB_CONTROL_FAILED)
+		{
+			Global_Hub.State = HUB_STATE_FAILED;
+		}
+		break;
+
+	case HUB_STATE_RUN:
+		App_HubStatusChange(phost);
+		App_HubPortStep(phost);
+		App_HubPollIn(phost);
+		App_HubPollOut(phost);
+		break;
+
+	default:
+		break;
+	}
+
+	return USBH_OK;
+}
+
+
+uint8_t App_HubDevices(void)
+{
+	uint8_t Local_uint8Mask = 0u;
+	uint8_t Local_uint8Device;
+
+	for(Local_uint8Device = 0u; Local_uint8Device < APP_HUB_MAX_PORTS; Local_uint8Device++)
+	{
+		if(Global_Hub.Devices[Local_uint8Device].State == HUB_DEVICE_READY)
+		{
+			Local_uint8Mask |= (uint8_t)(1u << Local_uint8Device);
+		}
+	}
+
+	return Local_uint8Mask;
+}
+
+
+/* Up to Length bytes out of the device's ring, in at most two pieces; what is left after it went away too */
+uint16_t App_HubRead(uint8_t Device, uint8_t* Data, uint16_t Length)
+{
+	if((Device >= APP_HUB_MAX_PORTS) || (Global_HubRings[Device].Data == NULL))
+	{
+		return 0u;
+	}
+
+	return (uint16_t)Ring_Read(&Global_HubRings[Device], Data, Length);
+}
+
+
+uint16_t App_HubRxAvailable(uint8_t Device)
+{
+	if((Device >= APP_HUB_MAX_PORTS) || (Global_HubRings[Device].Data == NULL))
+	{
+		return 0u;
+	}
+
+	return (uint16_t)Ring_Used(&Global_HubRings[Device]);
+}
+
+
+/*
+ * App_HubWrite
+ * ------------
+ * Queues one OUT packet for the device, from task context; 0 while the
+ * last one is still queued, or the device has no OUT endpoint.
+ */
+uint8_t App_HubWrite(uint8_t Device, const uint8_t* Data, uint16_t Length)
+{
+	AppHubDevice_t* Local_pDevice;
+
+	if(Device >= APP_HUB_MAX_PORTS)
+	{
+		return 0u;
+	}
+
+	Local_pDevice = &Global_Hub.Devices[Device];
+	if((Local_pDevice->State != HUB_DEVICE_READY) || (Local_pDevice->OutEp == 0u) || (Local_pDevice->TxLength != 0u) ||
+	   (Length == 0u) || (Length > Local_pDevice->OutSize))
+	{
+		return 0u;
+	}
+
+	memcpy(Global_uint8HubTx[Device], Data, Length);
+	Local_pDevice->TxLength = Length;
+	App_SchedSignal(APP_TASK_USB_HOST, APP_EVENT_USB_POLL);
+
+	return 1u;
+}
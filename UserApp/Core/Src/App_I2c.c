@@ -0,0 +1,103 @@
+#include <stddef.h>
+#include "main.h"
+#include "App_I2c.h"
+
+extern I2C_HandleTypeDef hi2c1;
+
+/* The batch in progress, Global_Table is NULL when there is none */
+static const AppI2cWrite_t* volatile Global_Table;
+static uint16_t                      Global_uint16Address;
+static uint16_t                      Global_uint16Count;
+static uint16_t                      Global_uint16Next;
+static AppI2cDone_t                  Global_Done;
+static uint8_t                       Global_uint8Value;
+
+
+/* Ends the batch before Done runs, so Done may start the next one */
+static void App_I2cFinish(uint8_t Status)
+{
+	AppI2cDone_t Local_Done = Global_Done;
+
+	Global_Table = NULL;
+	if(Local_Done != NULL)
+	{
+		Local_Done(Status, Global_uint16Next);
+	}
+}
+
+
+/*
+ * App_I2cWriteNext
+ * ----------------
+ * Starts the write of the next pair. The value is copied first: the HAL
+ * wants a writable buffer and the table is const.
+ */
+static void App_I2cWriteNext(void)
+{
+	const AppI2cWrite_t* Local_pWrite;
+
+	if(Global_uint16Next >= Global_uint16Count)
+	{
+		App_I2cFinish(APP_I2C_OK);
+		return;
+	}
+
+	Local_pWrite      = &Global_Table[Global_uint16Next];
+	Global_uint8Value = Local_pWrite->Value;
+
+	if(HAL_I2C_Mem_Write_IT(&hi2c1, Global_uint16Address, Local_pWrite->Reg, I2C_MEMADD_SIZE_8BIT, &Global_uint8Value, 1u) != HAL_OK)
+	{
+		App_I2cFinish(APP_I2C_ERROR);
+	}
+}
+
+
+/*
+ * App_I2cBatchStart
+ * -----------------
+ * Address is the 8-bit form (write address, 0x94 for the CS43L22). Returns
+ * 0 while another batch runs; Done is called for every batch started.
+ */
+uint8_t App_I2cBatchStart(uint16_t Address, const AppI2cWrite_t* Table, uint16_t Count, AppI2cDone_t Done)
+{
+	if((Table == NULL) || (Global_Table != NULL))
+	{
+		return 0u;
+	}
+
+	Global_uint16Address = Address;
+	Global_uint16Count   = Count;
+	Global_uint16Next    = 0u;
+	Global_Done          = Done;
+	Global_Table         = Table;
+
+	App_I2cWriteNext();
+
+	return 1u;
+}
+
+
+uint8_t App_I2cBatchBusy(void)
+{
+	return (Global_Table != NULL) ? 1u : 0u;
+}
+
+
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef* hi2c)
+{
+	if((hi2c->Instance == I2C1) && (Global_Table != NULL))
+	{
+		Global_uint16Next++;
+		App_I2cWriteNext();
+	}
+}
+
+
+/* The HAL has released the bus (STOP) before it calls this */
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c)
+{
+	if((hi2c->Instance == I2C1) && (Global_Table != NULL))
+	{
+		App_I2cFinish(APP_I2C_ERROR);
+	}
+}
@@ -0,0 +1,481 @@
+#include <string.h>
+#include "main.h"
+#include "usbh_ioreq.h"
+#include "usbh_pipes.h"
+#include "usbh_ctlreq.h"
+#include "App_Msc.h"
+#include "App_Scheduler.h"
+
+#define MSC_CLASS_CODE               0x08u
+#define MSC_SUBCLASS_SCSI            0x06u
+#define MSC_PROTOCOL_BOT             0x50u
+
+/* Command and status wrappers (USB MSC Bulk-Only Transport 1.0) */
+#define MSC_CBW_SIGNATURE            0x43425355UL
+#define MSC_CSW_SIGNATURE            0x53425355UL
+#define MSC_CBW_SIZE                 31u
+#define MSC_CSW_SIZE                 13u
+#define MSC_CBW_FLAG_IN              0x80u
+
+#define SCSI_TEST_UNIT_READY         0x00u
+#define SCSI_REQUEST_SENSE           0x03u
+#define SCSI_READ_CAPACITY_10        0x25u
+#define SCSI_READ_10                 0x28u
+
+#define SCSI_SENSE_SIZE              18u
+#define SCSI_CAPACITY_SIZE           8u
+
+#define MSC_READY_RETRY_MS           100u      /* Between TEST UNIT READY while the drive spins up */
+
+/* Global_Msc.State */
+#define MSC_STATE_NONE               0u
+#define MSC_STATE_TEST_READY         1u
+#define MSC_STATE_SENSE              2u
+#define MSC_STATE_CAPACITY           3u
+#define MSC_STATE_READY              4u
+#define MSC_STATE_READ               5u
+#define MSC_STATE_FAILED             6u
+
+/* Global_Msc.Phase: one command through the transport */
+#define MSC_PHASE_IDLE               0u
+#define MSC_PHASE_CBW                1u
+#define MSC_PHASE_CBW_WAIT           2u
+#define MSC_PHASE_DATA               3u
+#define MSC_PHASE_DATA_WAIT          4u
+#define MSC_PHASE_CLEAR_IN           5u
+#define MSC_PHASE_CSW                6u
+#define MSC_PHASE_CSW_WAIT           7u
+
+/* uint8_MscTransport results */
+#define MSC_TRANSPORT_BUSY           0u
+#define MSC_TRANSPORT_PASSED         1u
+#define MSC_TRANSPORT_FAILED         2u        /* CSW status "command failed": ask REQUEST SENSE */
+#define MSC_TRANSPORT_ERROR          3u        /* Stall, phase error, bad CSW */
+
+typedef struct
+{
+	uint8_t  InPipe;
+	uint8_t  OutPipe;
+	uint8_t  InEp;
+	uint8_t  OutEp;
+	uint16_t InEpSize;
+	uint16_t OutEpSize;
+
+	uint8_t  State;
+	uint8_t  Phase;
+	uint8_t  Result;
+	uint32_t Tag;
+	uint32_t RetryMs;
+	uint32_t BlockCount;
+
+	uint8_t* Data;
+	uint32_t DataLength;
+
+	uint8_t  Cbw[32] __attribute__((aligned(4)));
+	uint8_t  Csw[16] __attribute__((aligned(4)));
+	uint8_t  Reply[SCSI_SENSE_SIZE + 2u] __attribute__((aligned(4)));   /* Sense or capacity data */
+} AppMsc_t;
+
+static AppMsc_t Global_Msc;
+
+static USBH_StatusTypeDef App_MscInit(USBH_HandleTypeDef *phost);
+static USBH_StatusTypeDef App_MscDeInit(USBH_HandleTypeDef *phost);
+static USBH_StatusTypeDef App_MscRequests(USBH_HandleTypeDef *phost);
+static USBH_StatusTypeDef App_MscProcess(USBH_HandleTypeDef *phost);
+static USBH_StatusTypeDef App_MscSOFProcess(USBH_HandleTypeDef *phost);
+
+USBH_ClassTypeDef App_MscClass =
+{
+	"MSC",
+	MSC_CLASS_CODE,
+	App_MscInit,
+	App_MscDeInit,
+	App_MscRequests,
+	App_MscProcess,
+	App_MscSOFProcess,
+	NULL,
+};
+
+
+static void App_MscPutBigEndian32(uint8_t* Bytes, uint32_t Value)
+{
+	Bytes[0] = (uint8_t)(Value >> 24);
+	Bytes[1] = (uint8_t)(Value >> 16);
+	Bytes[2] = (uint8_t)(Value >> 8);
+	Bytes[3] = (uint8_t)Value;
+}
+
+static uint32_t App_MscGetBigEndian32(const uint8_t* Bytes)
+{
+	return ((uint32_t)Bytes[0] << 24) | ((uint32_t)Bytes[1] << 16) | ((uint32_t)Bytes[2] << 8) | Bytes[3];
+}
+
+
+/*
+ * App_MscCommand
+ * --------------
+ * Builds the CBW of a SCSI command block with Length bytes of data in, and
+ * hands it to the transport.
+ */
+static void App_MscCommand(const uint8_t* Block, uint8_t BlockLength, uint8_t* Data, uint32_t Length)
+{
+	uint32_t Local_uint32Word;
+
+	memset(Global_Msc.Cbw, 0, sizeof(Global_Msc.Cbw));
+
+	Global_Msc.Tag++;
+	Local_uint32Word = MSC_CBW_SIGNATURE;
+	memcpy(&Global_Msc.Cbw[0], &Local_uint32Word, 4u);
+	memcpy(&Global_Msc.Cbw[4], &Global_Msc.Tag, 4u);
+	memcpy(&Global_Msc.Cbw[8], &Length, 4u);
+	Global_Msc.Cbw[12] = MSC_CBW_FLAG_IN;
+	Global_Msc.Cbw[13] = 0u;                      /* LUN 0 */
+	Global_Msc.Cbw[14] = BlockLength;
+	memcpy(&Global_Msc.Cbw[15], Block, BlockLength);
+
+	Global_Msc.Data       = Data;
+	Global_Msc.DataLength = Length;
+	Global_Msc.Phase      = MSC_PHASE_CBW;
+
+	App_SchedSignal(APP_TASK_USB_HOST, APP_EVENT_USB_POLL);
+}
+
+
+/*
+ * uint8_MscTransport
+ * ------------------
+ * Steps the command handed over by App_MscCommand: CBW out, data in, CSW in.
+ * A stalled data stage clears the IN endpoint and still reads the CSW, as
+ * the transport requires; anything else out of order ends the command with
+ * MSC_TRANSPORT_ERROR.
+ */
+static uint8_t uint8_MscTransport(USBH_HandleTypeDef *phost)
+{
+	uint8_t  Local_uint8Result = MSC_TRANSPORT_BUSY;
+	uint32_t Local_uint32Word;
+	USBH_URBStateTypeDef Local_Urb;
+
+	switch(Global_Msc.Phase)
+	{
+	case MSC_PHASE_CBW:
+		(void)USBH_BulkSendData(phost, Global_Msc.Cbw, MSC_CBW_SIZE, Global_Msc.OutPipe, 0u);
+		Global_Msc.Phase = MSC_PHASE_CBW_WAIT;
+		break;
+
+	case MSC_PHASE_CBW_WAIT:
+		Local_Urb = USBH_LL_GetURBState(phost, Global_Msc.OutPipe);
+		if(Local_Urb == USBH_URB_DONE)
+		{
+			Global_Msc.Phase = (Global_Msc.DataLength != 0u) ? MSC_PHASE_DATA : MSC_PHASE_CSW;
+		}
+		else if(Local_Urb == USBH_URB_NOTREADY)
+		{
+			Global_Msc.Phase = MSC_PHASE_CBW;
+		}
+		else if((Local_Urb == USBH_URB_STALL) || (Local_Urb == USBH_URB_ERROR))
+		{
+			Local_uint8Result = MSC_TRANSPORT_ERROR;
+		}
+		break;
+
+	case MSC_PHASE_DATA:
+		(void)USBH_BulkReceiveData(phost, Global_Msc.Data, (uint16_t)Global_Msc.DataLength, Global_Msc.InPipe);
+		Global_Msc.Phase = MSC_PHASE_DATA_WAIT;
+		break;
+
+	case MSC_PHASE_DATA_WAIT:
+		Local_Urb = USBH_LL_GetURBState(phost, Global_Msc.InPipe);
+		if(Local_Urb == USBH_URB_DONE)
+		{
+			Global_Msc.Phase = MSC_PHASE_CSW;
+		}
+		else if(Local_Urb == USBH_URB_STALL)
+		{
+			Global_Msc.Phase = MSC_PHASE_CLEAR_IN;
+		}
+		else if(Local_Urb == USBH_URB_ERROR)
+		{
+			Local_uint8Result = MSC_TRANSPORT_ERROR;
+		}
+		break;
+
+	case MSC_PHASE_CLEAR_IN:
+		if(USBH_ClrFeature(phost, Global_Msc.InEp) == USBH_OK)
+		{
+			USBH_LL_SetToggle(phost, Global_Msc.InPipe, 0u);
+			Global_Msc.Phase = MSC_PHASE_CSW;
+		}
+		break;
+
+	case MSC_PHASE_CSW:
+		(void)USBH_BulkReceiveData(phost, Global_Msc.Csw, MSC_CSW_SIZE, Global_Msc.InPipe);
+		Global_Msc.Phase = MSC_PHASE_CSW_WAIT;
+		break;
+
+	case MSC_PHASE_CSW_WAIT:
+		Local_Urb = USBH_LL_GetURBState(phost, Global_Msc.InPipe);
+		if(Local_Urb == USBH_URB_DONE)
+		{
+			memcpy(&Local_uint32Word, &Global_Msc.Csw[0], 4u);
+			if((Local_uint32Word != MSC_CSW_SIGNATURE) || (memcmp(&Global_Msc.Csw[4], &Global_Msc.Tag, 4u) != 0) ||
+			   (Global_Msc.Csw[12] > 1u))
+			{
+				Local_uint8Result = MSC_TRANSPORT_ERROR;
+			}
+			else
+			{
+				Local_uint8Result = (Global_Msc.Csw[12] == 0u) ? MSC_TRANSPORT_PASSED : MSC_TRANSPORT_FAILED;
+			}
+		}
+		else if((Local_Urb == USBH_URB_STALL) || (Local_Urb == USBH_URB_ERROR))
+		{
+			Local_uint8Result = MSC_TRANSPORT_ERROR;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	if(Local_uint8Result != MSC_TRANSPORT_BUSY)
+	{
+		Global_Msc.Phase = MSC_PHASE_IDLE;
+	}
+	else if((Global_Msc.Phase == MSC_PHASE_CBW) || (Global_Msc.Phase == MSC_PHASE_DATA) || (Global_Msc.Phase == MSC_PHASE_CSW))
+	{
+		/* The next stage goes out on the next pass, not at the next 1 ms poll */
+		App_SchedSignal(APP_TASK_USB_HOST, APP_EVENT_USB_POLL);
+	}
+
+	return Local_uint8Result;
+}
+
+
+/*
+ * App_MscInit
+ * -----------
+ * Takes the first SCSI / Bulk-Only interface and opens its two bulk pipes.
+ */
+static USBH_StatusTypeDef App_MscInit(USBH_HandleTypeDef *phost)
+{
+	uint8_t Local_uint8Interface = USBH_FindInterface(phost, MSC_CLASS_CODE, MSC_SUBCLASS_SCSI, MSC_PROTOCOL_BOT);
+	uint8_t Local_uint8Ep;
+	USBH_EpDescTypeDef* Local_pEp;
+
+	if((Local_uint8Interface == 0xFFu) || (Local_uint8Interface >= USBH_MAX_NUM_INTERFACES) ||
+	   (USBH_SelectInterface(phost, Local_uint8Interface) != USBH_OK))
+	{
+		return USBH_FAIL;
+	}
+
+	memset(&Global_Msc, 0, sizeof(Global_Msc));
+	phost->pActiveClass->pData = &Global_Msc;
+
+	for(Local_uint8Ep = 0; Local_uint8Ep < 2u; Local_uint8Ep++)
+	{
+		Local_pEp = &phost->device.CfgDesc.Itf_Desc[Local_uint8Interface].Ep_Desc[Local_uint8Ep];
+
+		if((Local_pEp->bEndpointAddress & 0x80u) != 0u)
+		{
+			Global_Msc.InEp     = Local_pEp->bEndpointAddress;
+			Global_Msc.InEpSize = Local_pEp->wMaxPacketSize;
+		}
+		else
+		{
+			Global_Msc.OutEp     = Local_pEp->bEndpointAddress;
+			Global_Msc.OutEpSize = Local_pEp->wMaxPacketSize;
+		}
+	}
+
+	Global_Msc.OutPipe = USBH_AllocPipe(phost, Global_Msc.OutEp);
+	Global_Msc.InPipe  = USBH_AllocPipe(phost, Global_Msc.InEp);
+
+	(void)USBH_OpenPipe(phost, Global_Msc.OutPipe, Global_Msc.OutEp, phost->device.address, phost->device.speed,
+	                    USB_EP_TYPE_BULK, Global_Msc.OutEpSize);
+	(void)USBH_OpenPipe(phost, Global_Msc.InPipe, Global_Msc.InEp, phost->device.address, phost->device.speed,
+	                    USB_EP_TYPE_BULK, Global_Msc.InEpSize);
+
+	USBH_LL_SetToggle(phost, Global_Msc.OutPipe, 0u);
+	USBH_LL_SetToggle(phost, Global_Msc.InPipe, 0u);
+
+	Global_Msc.State = MSC_STATE_TEST_READY;
+
+	return USBH_OK;
+}
+
+
+static USBH_StatusTypeDef App_MscDeInit(USBH_HandleTypeDef *phost)
+{
+	if(Global_Msc.OutPipe != 0u)
+	{
+		(void)USBH_ClosePipe(phost, Global_Msc.OutPipe);
+		(void)USBH_FreePipe(phost, Global_Msc.OutPipe);
+	}
+	if(Global_Msc.InPipe != 0u)
+	{
+		(void)USBH_ClosePipe(phost, Global_Msc.InPipe);
+		(void)USBH_FreePipe(phost, Global_Msc.InPipe);
+	}
+
+	memset(&Global_Msc, 0, sizeof(Global_Msc));
+	phost->pActiveClass->pData = NULL;
+
+	App_SchedSignal(APP_TASK_UPDATE, APP_EVENT_MSC_GONE);
+
+	return USBH_OK;
+}
+
+
+/* No class request: LUN 0 only, so GET MAX LUN is not needed */
+static USBH_StatusTypeDef App_MscRequests(USBH_HandleTypeDef *phost)
+{
+	phost->pUser(phost, HOST_USER_CLASS_ACTIVE);
+
+	return USBH_OK;
+}
+
+
+static USBH_StatusTypeDef App_MscSOFProcess(USBH_HandleTypeDef *phost)
+{
+	(void)phost;
+
+	return USBH_OK;
+}
+
+
+/*
+ * App_MscProcess
+ * --------------
+ * The drive's state, one transport step per call.
+ *
+ * Behavior:
+ * ---------
+ * 1. TEST UNIT READY every MSC_READY_RETRY_MS until it passes; a failure is
+ *    followed by REQUEST SENSE, which clears the unit attention most drives
+ *    report first.
+ * 2. READ CAPACITY(10): a block size other than APP_MSC_BLOCK_SIZE is not
+ *    supported, the drive is left alone.
+ * 3. Ready: App_MscRead commands run to their CSW, then APP_EVENT_MSC_DONE.
+ */
+static USBH_StatusTypeDef App_MscProcess(USBH_HandleTypeDef *phost)
+{
+	static const uint8_t Local_Test[6]     = { SCSI_TEST_UNIT_READY, 0u, 0u, 0u, 0u, 0u };
+	static const uint8_t Local_Sense[6]    = { SCSI_REQUEST_SENSE, 0u, 0u, 0u, SCSI_SENSE_SIZE, 0u };
+	static const uint8_t Local_Capacity[10] = { SCSI_READ_CAPACITY_10, 0u, 0u, 0u, 0u, 0u, 0u, 0u, 0u, 0u };
+	uint8_t Local_uint8Transport = MSC_TRANSPORT_BUSY;
+
+	if(Global_Msc.Phase != MSC_PHASE_IDLE)
+	{
+		Local_uint8Transport = uint8_MscTransport(phost);
+	}
+
+	switch(Global_Msc.State)
+	{
+	case MSC_STATE_TEST_READY:
+		if((Global_Msc.Phase == MSC_PHASE_IDLE) && (Local_uint8Transport == MSC_TRANSPORT_BUSY) &&
+		   ((HAL_GetTick() - Global_Msc.RetryMs) >= MSC_READY_RETRY_MS))
+		{
+			App_MscCommand(Local_Test, sizeof(Local_Test), NULL, 0u);
+		}
+		else if(Local_uint8Transport == MSC_TRANSPORT_PASSED)
+		{
+			App_MscCommand(Local_Capacity, sizeof(Local_Capacity), Global_Msc.Reply, SCSI_CAPACITY_SIZE);
+			Global_Msc.State = MSC_STATE_CAPACITY;
+		}
+		else if(Local_uint8Transport == MSC_TRANSPORT_FAILED)
+		{
+			App_MscCommand(Local_Sense, sizeof(Local_Sense), Global_Msc.Reply, SCSI_SENSE_SIZE);
+			Global_Msc.State = MSC_STATE_SENSE;
+		}
+		else if(Local_uint8Transport == MSC_TRANSPORT_ERROR)
+		{
+			Global_Msc.State = MSC_STATE_FAILED;
+		}
+		break;
+
+	case MSC_STATE_SENSE:
+		if(Local_uint8Transport == MSC_TRANSPORT_ERROR)
+		{
+			Global_Msc.State = MSC_STATE_FAILED;
+		}
+		else if(Local_uint8Transport != MSC_TRANSPORT_BUSY)
+		{
+			Global_Msc.RetryMs = HAL_GetTick();
+			Global_Msc.State   = MSC_STATE_TEST_READY;
+		}
+		break;
+
+	case MSC_STATE_CAPACITY:
+		if((Local_uint8Transport == MSC_TRANSPORT_PASSED) &&
+		   (App_MscGetBigEndian32(&Global_Msc.Reply[4]) == APP_MSC_BLOCK_SIZE))
+		{
+			Global_Msc.BlockCount = App_MscGetBigEndian32(&Global_Msc.Reply[0]) + 1u;
+			Global_Msc.State      = MSC_STATE_READY;
+			App_SchedSignal(APP_TASK_UPDATE, APP_EVENT_MSC_READY);
+		}
+		else if(Local_uint8Transport != MSC_TRANSPORT_BUSY)
+		{
+			Global_Msc.State = MSC_STATE_FAILED;
+		}
+		break;
+
+	case MSC_STATE_READ:
+		if(Local_uint8Transport != MSC_TRANSPORT_BUSY)
+		{
+			Global_Msc.Result = (Local_uint8Transport == MSC_TRANSPORT_PASSED) ? APP_MSC_OK : APP_MSC_ERROR;
+			Global_Msc.State  = (Local_uint8Transport == MSC_TRANSPORT_ERROR) ? MSC_STATE_FAILED : MSC_STATE_READY;
+			App_SchedSignal(APP_TASK_UPDATE, APP_EVENT_MSC_DONE);
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return USBH_OK;
+}
+
+
+uint8_t App_MscIsReady(void)
+{
+	return (Global_Msc.State == MSC_STATE_READY) ? 1u : 0u;
+}
+
+
+uint32_t App_MscBlockCount(void)
+{
+	return Global_Msc.BlockCount;
+}
+
+
+/*
+ * App_MscRead
+ * -----------
+ * Starts READ(10) of Blocks blocks from Lba into Buffer (Blocks x 512
+ * bytes); the host task sends the CBW on its next pass.
+ */
+uint8_t App_MscRead(uint32_t Lba, uint16_t Blocks, uint8_t* Buffer)
+{
+	uint8_t Local_uint8Read[10] = { SCSI_READ_10, 0u, 0u, 0u, 0u, 0u, 0u, 0u, 0u, 0u };
+
+	if((Global_Msc.State != MSC_STATE_READY) || (Blocks == 0u) || (Blocks > APP_MSC_MAX_BLOCKS))
+	{
+		return APP_MSC_BUSY;
+	}
+
+	App_MscPutBigEndian32(&Local_uint8Read[2], Lba);
+	Local_uint8Read[7] = (uint8_t)(Blocks >> 8);
+	Local_uint8Read[8] = (uint8_t)Blocks;
+
+	App_MscCommand(Local_uint8Read, sizeof(Local_uint8Read), Buffer, (uint32_t)Blocks * APP_MSC_BLOCK_SIZE);
+	Global_Msc.State  = MSC_STATE_READ;
+	Global_Msc.Result = APP_MSC_BUSY;
+
+	return APP_MSC_OK;
+}
+
+
+uint8_t App_MscResult(void)
+{
+	return Global_Msc.Result;
+}
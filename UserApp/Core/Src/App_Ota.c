@@ -0,0 +1,781 @@
+#include <string.h>
+#include "main.h"
+#include "App_Ota.h"
+#include "App_Image.h"
+#include "App_Uart.h"
+#include "App_Update.h"
+#include "App_Scheduler.h"
+
+#if APP_OTA_ENABLE && !defined(APP_CDC_BRIDGE)
+
+extern UART_HandleTypeDef huart2;
+
+/* Codes and replies as the bootloader has them (BL.h) */
+#define OTA_ACK                      0xA5u
+#define OTA_NACK                     0x7Fu
+#define OTA_FRAME_EXT_MARKER         0x00u
+#define OTA_FRAME_MIN_FOLLOW         5u        /* Command and CRC */
+
+#define OTA_GET_VERSION              0x51u
+#define OTA_FLASH_ERASE              0x56u
+#define OTA_MEM_WRITE                0x57u
+#define OTA_SLOT_ACTIVATE            0x75u
+#define OTA_RESET_AND_BOOT           0x80u
+#define OTA_GET_SCHED_LATENCY        0x87u     /* The UserApp's own, the bootloader NACKs it */
+
+#define OTA_SLOT_QUERY               0xFFu
+#define OTA_SLOT_OK                  0x00u
+#define OTA_SLOT_INVALID             0x01u
+#define OTA_SLOT_REPLY_SIZE          6u
+#define OTA_RESET_BOOT_RESET         0x01u     /* BL_RESET_AND_BOOT status: the device resets */
+
+#define OTA_LATENCY_CLEAR            0xFFu     /* GET_SCHED_LATENCY [0xFF]: every histogram cleared */
+#define OTA_LATENCY_OK               0x00u
+#define OTA_LATENCY_INVALID          0x01u
+#define OTA_LATENCY_REPLY_SIZE       (21u + (2u * APP_SCHED_LATENCY_BUCKETS))
+
+#define OTA_REPLY_SIZE               (2u + OTA_LATENCY_REPLY_SIZE)   /* The longest reply */
+
+/* STM32F407xG sectors: 4 x 16 KB, 64 KB, 7 x 128 KB; slot A starts at sector 2 */
+#define OTA_FLASH_SECTORS            12u
+#define OTA_SLOT_A_BASE              0x08008000UL
+
+/* Global_Ota.State */
+#define OTA_STATE_IDLE               0u        /* No session, the line is the queue's */
+#define OTA_STATE_OPEN               1u        /* Session, waiting for a frame */
+#define OTA_STATE_ERASE              2u        /* FLASH_ERASE, a sector per run */
+#define OTA_STATE_WRITE              3u        /* MEM_WRITE, a slice per run */
+#define OTA_STATE_RESET              4u        /* Reset once the reply is out */
+
+typedef struct
+{
+	uint8_t  State;
+	uint8_t  Touched;                           /* The slot was erased or written since reset */
+	uint8_t  Activated;                         /* No more erases or writes: the slot boots next */
+	uint8_t  Ready;                             /* Slot fields valid */
+	uint32_t LastTick;                          /* Last frame answered */
+
+	uint16_t Fill;                              /* Frame bytes so far */
+	uint16_t Need;                              /* Frame bytes in all, 0: header not complete */
+
+	uint8_t  SlotFirst;                         /* InactiveSectors */
+	uint8_t  SlotCount;
+	uint32_t SlotBase;
+	uint32_t SlotEnd;
+
+	uint8_t  Sector;                            /* FLASH_ERASE: next sector, sectors left, blank ones */
+	uint8_t  Left;
+	uint16_t Blank;
+
+	uint32_t Address;                           /* MEM_WRITE: next word, bytes left, from Frame[Offset] */
+	uint32_t Length;
+	uint16_t Offset;
+
+	uint8_t  ReplyLength;                       /* Waiting for the line, 0: none */
+} AppOta_t;
+
+static AppOta_t Global_Ota;
+
+static void App_OtaTxDone(void);
+
+static const AppUartClient_t Global_Client = { App_OtaTxDone, App_OtaRxError };
+
+/* Head bytes came in (DMA and idle interrupts only), Tail were taken (task only) */
+static uint8_t           Global_uint8Rx[APP_OTA_RX_RING_SIZE] __attribute__((aligned(4))) APP_RAM_BUDGET("rx");
+static volatile uint32_t Global_uint32RxHead;
+static uint32_t          Global_uint32RxTail;
+static uint16_t          Global_uint16RxPosition;    /* DMA write offset at the last update */
+static volatile uint8_t  Global_uint8Sending;        /* A reply is with the DMA */
+
+static uint8_t           Global_uint8Frame[APP_OTA_FRAME_SIZE] __attribute__((aligned(4))) APP_RAM_BUDGET("staging");
+static uint8_t           Global_uint8Reply[OTA_REPLY_SIZE];
+
+
+static uint32_t App_OtaSectorBase(uint8_t Sector)
+{
+	if(Sector < 4u)
+	{
+		return FLASH_BASE + ((uint32_t)Sector * 0x4000UL);
+	}
+	else if(Sector == 4u)
+	{
+		return FLASH_BASE + 0x10000UL;
+	}
+
+	return FLASH_BASE + 0x20000UL + ((uint32_t)(Sector - 5u) * 0x20000UL);
+}
+
+
+/* The slot this image runs from: its header sits APP_HEADER_OFFSET into it */
+static uint8_t App_OtaRunningSlot(void)
+{
+	return (((uint32_t)&App_Header - APP_HEADER_OFFSET) == OTA_SLOT_A_BASE) ? 0u : 1u;
+}
+
+
+/*
+ * App_OtaSlotReady
+ * ----------------
+ * 1 when the inactive slot may be erased and written: a bootloader table
+ * that can activate it, the running image validated, no USB update on it
+ * and no activation done yet. The slot's sectors are read once.
+ */
+static uint8_t App_OtaSlotReady(void)
+{
+	if(Global_Ota.Ready == 0u)
+	{
+		if((APP_SERVICES->Magic != APP_SERVICES_MAGIC) || (APP_SERVICES->Version < APP_SERVICES_VERSION_ACTIVATE) ||
+		   (APP_SERVICES->InactiveSectors(&Global_Ota.SlotFirst, &Global_Ota.SlotCount) != HAL_OK) ||
+		   ((Global_Ota.SlotFirst + Global_Ota.SlotCount) > OTA_FLASH_SECTORS) || (Global_Ota.SlotCount == 0u))
+		{
+			return 0u;
+		}
+
+		Global_Ota.SlotBase = App_OtaSectorBase(Global_Ota.SlotFirst);
+		Global_Ota.SlotEnd  = (Global_Ota.SlotFirst + Global_Ota.SlotCount < OTA_FLASH_SECTORS) ?
+		                      App_OtaSectorBase(Global_Ota.SlotFirst + Global_Ota.SlotCount) : (FLASH_END + 1u);
+		Global_Ota.Ready    = 1u;
+	}
+
+	return ((Global_Ota.Activated == 0u) && (APP_SERVICES->ImageIsValidated() != 0u) && (App_UpdateBusy() == 0u)) ? 1u : 0u;
+}
+
+
+/* CRC unit, every byte fed as a word (the bootloader's default frame CRC) */
+static uint32_t App_OtaCrc(const uint8_t* Data, uint16_t Length)
+{
+	CRC->CR = CRC_CR_RESET;
+
+	for( ; Length != 0u; Length--)
+	{
+		CRC->DR = *Data;
+		Data++;
+	}
+
+	return CRC->DR;
+}
+
+
+static void App_OtaArm(uint32_t Ms)
+{
+	App_SchedTimerStart(APP_TIMER_OTA, APP_TASK_OTA, APP_EVENT_OTA_TIMEOUT, Ms, 0u);
+}
+
+
+static void App_OtaStartRx(void)
+{
+	uint32_t Local_uint32Primask = __get_PRIMASK();
+
+	__disable_irq();
+	Global_uint32RxHead     = 0u;
+	Global_uint32RxTail     = 0u;
+	Global_uint16RxPosition = 0u;
+	__set_PRIMASK(Local_uint32Primask);
+
+	Global_Ota.Fill = 0u;
+	Global_Ota.Need = 0u;
+
+	if(HAL_UART_Receive_DMA(&huart2, Global_uint8Rx, APP_OTA_RX_RING_SIZE) == HAL_OK)
+	{
+		__HAL_UART_ENABLE_IT(&huart2, UART_IT_IDLE);
+	}
+}
+
+
+/*
+ * App_OtaRxUpdate
+ * ---------------
+ * Interrupt context: moves Head up to where the DMA is writing, as
+ * App_Bridge.c does.
+ */
+static void App_OtaRxUpdate(void)
+{
+	uint16_t Local_uint16Position = (uint16_t)(APP_OTA_RX_RING_SIZE - __HAL_DMA_GET_COUNTER(huart2.hdmarx));
+
+	Global_uint32RxHead    += (uint16_t)(Local_uint16Position - Global_uint16RxPosition) & (APP_OTA_RX_RING_SIZE - 1u);
+	Global_uint16RxPosition = Local_uint16Position & (APP_OTA_RX_RING_SIZE - 1u);
+
+	App_SchedSignal(APP_TASK_OTA, APP_EVENT_OTA_RX);
+}
+
+
+/* UART interrupt: the line is free, a reply may go */
+static void App_OtaTxDone(void)
+{
+	Global_uint8Sending = 0u;
+	App_SchedSignal(APP_TASK_OTA, APP_EVENT_OTA_TX);
+}
+
+
+/* The reply goes out as soon as the line is free: back on TX otherwise */
+static void App_OtaSendReply(void)
+{
+	if((Global_Ota.ReplyLength == 0u) || (Global_uint8Sending != 0u))
+	{
+		return;
+	}
+
+	Global_uint8Sending = 1u;
+	if(App_UartTransmit(Global_uint8Reply, Global_Ota.ReplyLength) == 0u)
+	{
+		Global_uint8Sending = 0u;
+		return;
+	}
+
+	Global_Ota.ReplyLength = 0u;
+}
+
+
+/* [ACK] [length] [payload]: the command is done, the session waits for the next frame */
+static void App_OtaReply(const uint8_t* Payload, uint8_t Length)
+{
+	Global_uint8Reply[0] = OTA_ACK;
+	Global_uint8Reply[1] = Length;
+	memcpy(&Global_uint8Reply[2], Payload, Length);
+	Global_Ota.ReplyLength = (uint8_t)(2u + Length);
+
+	Global_Ota.State    = OTA_STATE_OPEN;
+	Global_Ota.LastTick = HAL_GetTick();
+	App_OtaSendReply();
+	App_SchedSignal(APP_TASK_OTA, APP_EVENT_OTA_RX);
+}
+
+
+static void App_OtaNack(void)
+{
+	Global_uint8Reply[0]   = OTA_NACK;
+	Global_Ota.ReplyLength = 1u;
+	App_OtaSendReply();
+}
+
+
+static void App_OtaEnd(void)
+{
+	Global_Ota.State = OTA_STATE_IDLE;
+	App_UartDetach();
+}
+
+
+/* [status] [blank-skipped bitmap (2, LE)], as BL_FLASH_ERASE */
+static void App_OtaEraseReply(uint8_t Status)
+{
+	uint8_t Local_uint8Reply[3];
+
+	APP_SERVICES->FlashLock();
+
+	Local_uint8Reply[0] = Status;
+	Local_uint8Reply[1] = (uint8_t)Global_Ota.Blank;
+	Local_uint8Reply[2] = (uint8_t)(Global_Ota.Blank >> 8);
+	App_OtaReply(Local_uint8Reply, 3u);
+}
+
+
+static void App_OtaWriteReply(uint8_t Status)
+{
+	APP_SERVICES->FlashLock();
+	App_OtaReply(&Status, 1u);
+}
+
+
+/*
+ * App_OtaErase
+ * ------------
+ * FLASH_ERASE [first] [count] [flags]: only a range inside the inactive
+ * slot. The flags are not looked at, the erase is always synchronous (the
+ * reply after the last sector).
+ */
+static void App_OtaErase(const uint8_t* Payload, uint16_t Length)
+{
+	Global_Ota.Blank = 0u;
+
+	if((Length < 2u) || (App_OtaSlotReady() == 0u) || (Payload[1] == 0u) || (Payload[0] < Global_Ota.SlotFirst) ||
+	   ((uint32_t)Payload[0] + Payload[1] > (uint32_t)Global_Ota.SlotFirst + Global_Ota.SlotCount) ||
+	   (APP_SERVICES->FlashUnlock() != HAL_OK))
+	{
+		App_OtaEraseReply(HAL_ERROR);
+		return;
+	}
+
+	Global_Ota.Touched = 1u;
+	Global_Ota.Sector  = Payload[0];
+	Global_Ota.Left    = Payload[1];
+	Global_Ota.State   = OTA_STATE_ERASE;
+	App_SchedSignal(APP_TASK_OTA, APP_EVENT_OTA_STEP);
+}
+
+
+/* One sector: a blank one is only scanned */
+static void App_OtaEraseStep(void)
+{
+	if(APP_SERVICES->FlashSectorIsBlank(Global_Ota.Sector) != 0u)
+	{
+		Global_Ota.Blank |= (uint16_t)(1u << Global_Ota.Sector);
+	}
+	else if(APP_SERVICES->FlashEraseSector(Global_Ota.Sector) != HAL_OK)
+	{
+		App_OtaEraseReply(HAL_ERROR);
+		return;
+	}
+
+	Global_Ota.Sector++;
+	if(--Global_Ota.Left == 0u)
+	{
+		App_OtaEraseReply(HAL_OK);
+		return;
+	}
+
+	App_SchedSignal(APP_TASK_OTA, APP_EVENT_OTA_STEP);
+}
+
+
+/*
+ * App_OtaWrite
+ * ------------
+ * MEM_WRITE [address (4)] [length (1, 2 in an extended frame)] [data]: a
+ * word-aligned address, the whole range inside the inactive slot, at most
+ * APP_OTA_MAX_WRITE bytes. The data is programmed where it lies in the
+ * frame; a tail short of a word is padded with 0xFF over the CRC just
+ * checked.
+ */
+static void App_OtaWrite(const uint8_t* Payload, uint16_t Length, uint8_t Extended)
+{
+	uint16_t Local_uint16Header = Extended ? 6u : 5u;
+	uint32_t Local_uint32Address;
+	uint32_t Local_uint32Length;
+
+	if(Length < Local_uint16Header)
+	{
+		App_OtaWriteReply(HAL_ERROR);
+		return;
+	}
+
+	memcpy(&Local_uint32Address, Payload, 4u);
+	Local_uint32Length = Extended ? ((uint32_t)Payload[4] | ((uint32_t)Payload[5] << 8)) : Payload[4];
+
+	if(((Local_uint32Address & 0x3u) != 0u) || (Local_uint32Length == 0u) || (Local_uint32Length > APP_OTA_MAX_WRITE) ||
+	   (Local_uint32Length > (uint32_t)(Length - Local_uint16Header)) || (App_OtaSlotReady() == 0u) ||
+	   (Local_uint32Address < Global_Ota.SlotBase) || (Local_uint32Address >= Global_Ota.SlotEnd) ||
+	   (Local_uint32Length > (Global_Ota.SlotEnd - Local_uint32Address)) || (APP_SERVICES->FlashUnlock() != HAL_OK))
+	{
+		App_OtaWriteReply(HAL_ERROR);
+		return;
+	}
+
+	Global_Ota.Offset  = (uint16_t)((Payload - Global_uint8Frame) + Local_uint16Header);
+	while((Local_uint32Length & 0x3u) != 0u)
+	{
+		Global_uint8Frame[Global_Ota.Offset + Local_uint32Length] = 0xFFu;
+		Local_uint32Length++;
+	}
+
+	Global_Ota.Touched = 1u;
+	Global_Ota.Address = Local_uint32Address;
+	Global_Ota.Length  = Local_uint32Length;
+	Global_Ota.State   = OTA_STATE_WRITE;
+	App_SchedSignal(APP_TASK_OTA, APP_EVENT_OTA_STEP);
+}
+
+
+static void App_OtaWriteStep(void)
+{
+	uint32_t Local_uint32Length = (Global_Ota.Length > APP_OTA_SLICE) ? APP_OTA_SLICE : Global_Ota.Length;
+
+	if(APP_SERVICES->FlashProgram(Global_Ota.Address, &Global_uint8Frame[Global_Ota.Offset], Local_uint32Length) != HAL_OK)
+	{
+		App_OtaWriteReply(HAL_ERROR);
+		return;
+	}
+
+	Global_Ota.Address += Local_uint32Length;
+	Global_Ota.Offset   = (uint16_t)(Global_Ota.Offset + Local_uint32Length);
+	Global_Ota.Length  -= Local_uint32Length;
+
+	if(Global_Ota.Length == 0u)
+	{
+		App_OtaWriteReply(HAL_OK);
+		return;
+	}
+
+	App_SchedSignal(APP_TASK_OTA, APP_EVENT_OTA_STEP);
+}
+
+
+/*
+ * App_OtaSlot
+ * -----------
+ * SLOT_ACTIVATE [slot]: [status] [active slot] [update slot base (4)], as
+ * the bootloader answers it. The running slot is already active; the other
+ * one is checked and activated by the bootloader's ImageActivateUpdate
+ * (CPU-fed CRC, the CRC clock is on) and boots from the next reset. An
+ * update slot base of 0: no update possible.
+ */
+static void App_OtaSlot(const uint8_t* Payload, uint16_t Length)
+{
+	uint8_t  Local_uint8Reply[OTA_SLOT_REPLY_SIZE];
+	uint8_t  Local_uint8Active = App_OtaRunningSlot();
+	uint32_t Local_uint32Base  = (App_OtaSlotReady() != 0u) ? Global_Ota.SlotBase : 0u;
+
+	Local_uint8Reply[0] = OTA_SLOT_OK;
+
+	if((Length < 1u) || ((Payload[0] != OTA_SLOT_QUERY) && (Payload[0] != Local_uint8Active) &&
+	   ((Payload[0] != (Local_uint8Active ^ 1u)) || (Local_uint32Base == 0u))))
+	{
+		Local_uint8Reply[0] = OTA_SLOT_INVALID;
+	}
+	else if((Payload[0] != OTA_SLOT_QUERY) && (Payload[0] != Local_uint8Active))
+	{
+		if(APP_SERVICES->ImageActivateUpdate() != HAL_OK)
+		{
+			Local_uint8Reply[0] = OTA_SLOT_INVALID;
+		}
+		else
+		{
+			Global_Ota.Activated = 1u;
+			Local_uint8Active    = Payload[0];
+			Local_uint32Base     = (uint32_t)&App_Header - APP_HEADER_OFFSET;
+		}
+	}
+
+	Local_uint8Reply[1] = Local_uint8Active;
+	memcpy(&Local_uint8Reply[2], &Local_uint32Base, 4u);
+	App_OtaReply(Local_uint8Reply, OTA_SLOT_REPLY_SIZE);
+}
+
+
+/*
+ * App_OtaLatency
+ * --------------
+ * GET_SCHED_LATENCY [task] [bit]: [status] [tasks] [bits] [buckets]
+ * [shift] [core clock (4)] [total (4)] [worst (4)] [halvings (4)]
+ * [counts (2 each)], the dispatch latency of one event (App_Scheduler.h);
+ * [0xFF] clears them all, [status] alone. A task or bit past the table, or
+ * a build without APP_SCHED_LATENCY_ENABLE: OTA_LATENCY_INVALID alone.
+ */
+static void App_OtaLatency(const uint8_t* Payload, uint16_t Length)
+{
+	uint8_t Local_uint8Reply[OTA_LATENCY_REPLY_SIZE];
+	const AppSchedLatency_t* Local_pLatency = (Length >= 2u) ? App_SchedLatency(Payload[0], Payload[1]) : 0;
+
+	if((Length == 1u) && (Payload[0] == OTA_LATENCY_CLEAR) && (APP_SCHED_LATENCY_ENABLE != 0u))
+	{
+		App_SchedLatencyClear();
+		Local_uint8Reply[0] = OTA_LATENCY_OK;
+		App_OtaReply(Local_uint8Reply, 1u);
+		return;
+	}
+
+	if(Local_pLatency == 0)
+	{
+		Local_uint8Reply[0] = OTA_LATENCY_INVALID;
+		App_OtaReply(Local_uint8Reply, 1u);
+		return;
+	}
+
+	Local_uint8Reply[0] = OTA_LATENCY_OK;
+	Local_uint8Reply[1] = APP_SCHED_MAX_TASKS;
+	Local_uint8Reply[2] = APP_SCHED_LATENCY_BITS;
+	Local_uint8Reply[3] = APP_SCHED_LATENCY_BUCKETS;
+	Local_uint8Reply[4] = APP_SCHED_LATENCY_SHIFT;
+	memcpy(&Local_uint8Reply[5], (const void*)&SystemCoreClock, 4u);
+	memcpy(&Local_uint8Reply[9], &Local_pLatency->Total, 4u);
+	memcpy(&Local_uint8Reply[13], &Local_pLatency->Worst, 4u);
+	memcpy(&Local_uint8Reply[17], &Local_pLatency->Halvings, 4u);
+	memcpy(&Local_uint8Reply[21], Local_pLatency->Count, 2u * APP_SCHED_LATENCY_BUCKETS);
+	App_OtaReply(Local_uint8Reply, OTA_LATENCY_REPLY_SIZE);
+}
+
+
+/*
+ * App_OtaFrame
+ * ------------
+ * A whole frame in Global_uint8Frame. A bad CRC is NACKed in a session and
+ * dropped outside one; the first good frame opens the session.
+ */
+static void App_OtaFrame(void)
+{
+	uint8_t  Local_uint8Extended = (Global_uint8Frame[0] == OTA_FRAME_EXT_MARKER) ? 1u : 0u;
+	uint16_t Local_uint16Header  = Local_uint8Extended ? 3u : 1u;
+	uint16_t Local_uint16Crc     = (uint16_t)(Global_Ota.Need - 4u);
+	uint16_t Local_uint16Length  = (uint16_t)(Local_uint16Crc - Local_uint16Header - 1u);
+	const uint8_t* Local_puint8Payload = &Global_uint8Frame[Local_uint16Header + 1u];
+	uint32_t Local_uint32Crc;
+	uint8_t  Local_uint8Status;
+
+	memcpy(&Local_uint32Crc, &Global_uint8Frame[Local_uint16Crc], 4u);
+	if(App_OtaCrc(Global_uint8Frame, Local_uint16Crc) != Local_uint32Crc)
+	{
+		if(Global_Ota.State != OTA_STATE_IDLE)
+		{
+			App_OtaNack();
+		}
+		return;
+	}
+
+	if(Global_Ota.State == OTA_STATE_IDLE)
+	{
+		/* A queue piece still in flight: its TxDone frees the line */
+		Global_Ota.State    = OTA_STATE_OPEN;
+		Global_uint8Sending = 1u;
+		if(App_UartAttach(&Global_Client) != 0u)
+		{
+			Global_uint8Sending = 0u;
+		}
+	}
+	Global_Ota.LastTick = HAL_GetTick();
+
+	switch(Global_uint8Frame[Local_uint16Header])
+	{
+	case OTA_GET_VERSION:
+		Local_uint8Status = APP_OTA_VERSION;
+		App_OtaReply(&Local_uint8Status, 1u);
+		break;
+
+	case OTA_FLASH_ERASE:
+		App_OtaErase(Local_puint8Payload, Local_uint16Length);
+		break;
+
+	case OTA_MEM_WRITE:
+		App_OtaWrite(Local_puint8Payload, Local_uint16Length, Local_uint8Extended);
+		break;
+
+	case OTA_SLOT_ACTIVATE:
+		App_OtaSlot(Local_puint8Payload, Local_uint16Length);
+		break;
+
+	case OTA_RESET_AND_BOOT:
+		Local_uint8Status = OTA_RESET_BOOT_RESET;
+		App_OtaReply(&Local_uint8Status, 1u);
+		Global_Ota.State = OTA_STATE_RESET;
+		break;
+
+	case OTA_GET_SCHED_LATENCY:
+		App_OtaLatency(Local_puint8Payload, Local_uint16Length);
+		break;
+
+	default:
+		App_OtaNack();
+		break;
+	}
+}
+
+
+/*
+ * App_OtaReceive
+ * --------------
+ * Takes bytes from the ring into the frame while no command runs: the
+ * length byte (or the extended marker and its 2-byte length) says how many
+ * follow. A length no frame can have drops the byte and the search goes on
+ * from the next one; a ring the DMA lapped drops everything.
+ */
+static void App_OtaReceive(void)
+{
+	uint32_t Local_uint32Head = Global_uint32RxHead;
+	uint32_t Local_uint32Follow;
+	uint8_t  Local_uint8Byte;
+
+	if((Local_uint32Head - Global_uint32RxTail) > APP_OTA_RX_RING_SIZE)
+	{
+		Global_uint32RxTail = Local_uint32Head;
+		Global_Ota.Fill = 0u;
+		Global_Ota.Need = 0u;
+		return;
+	}
+
+	if(Global_uint32RxTail != Local_uint32Head)
+	{
+		App_OtaArm(APP_OTA_FRAME_TIMEOUT_MS);
+	}
+
+	while((Global_uint32RxTail != Local_uint32Head) && (Global_Ota.State <= OTA_STATE_OPEN))
+	{
+		Local_uint8Byte = Global_uint8Rx[Global_uint32RxTail & (APP_OTA_RX_RING_SIZE - 1u)];
+		Global_uint32RxTail++;
+
+		Global_uint8Frame[Global_Ota.Fill++] = Local_uint8Byte;
+
+		if(Global_Ota.Need == 0u)
+		{
+			if(Global_uint8Frame[0] != OTA_FRAME_EXT_MARKER)
+			{
+				Local_uint32Follow = Global_uint8Frame[0];
+				Global_Ota.Need    = (uint16_t)(1u + Local_uint32Follow);
+			}
+			else if(Global_Ota.Fill == 3u)
+			{
+				Local_uint32Follow = (uint32_t)Global_uint8Frame[1] | ((uint32_t)Global_uint8Frame[2] << 8);
+				Global_Ota.Need    = (uint16_t)(3u + Local_uint32Follow);
+			}
+			else
+			{
+				continue;
+			}
+
+			if((Local_uint32Follow < OTA_FRAME_MIN_FOLLOW) || (Global_Ota.Need > APP_OTA_FRAME_SIZE))
+			{
+				Global_Ota.Fill = 0u;
+				Global_Ota.Need = 0u;
+			}
+			continue;
+		}
+
+		if(Global_Ota.Fill == Global_Ota.Need)
+		{
+			App_OtaFrame();
+			Global_Ota.Fill = 0u;
+			Global_Ota.Need = 0u;
+		}
+	}
+}
+
+
+/*
+ * App_OtaTimeout
+ * --------------
+ * No byte for APP_OTA_FRAME_TIMEOUT_MS: a partial frame is dropped. An open
+ * session without a frame for APP_OTA_SESSION_TIMEOUT_MS ends, the line goes
+ * back to the queue; one that runs a command is not timed.
+ */
+static void App_OtaTimeout(void)
+{
+	uint32_t Local_uint32Idle = HAL_GetTick() - Global_Ota.LastTick;
+
+	Global_Ota.Fill = 0u;
+	Global_Ota.Need = 0u;
+
+	if(Global_Ota.State == OTA_STATE_OPEN)
+	{
+		if(Local_uint32Idle >= APP_OTA_SESSION_TIMEOUT_MS)
+		{
+			App_OtaEnd();
+		}
+		else
+		{
+			App_OtaArm(APP_OTA_SESSION_TIMEOUT_MS - Local_uint32Idle);
+		}
+	}
+	else if(Global_Ota.State != OTA_STATE_IDLE)
+	{
+		App_OtaArm(APP_OTA_SESSION_TIMEOUT_MS);
+	}
+}
+
+
+void App_OtaStart(void)
+{
+	memset(&Global_Ota, 0, sizeof(Global_Ota));
+
+	__HAL_RCC_CRC_CLK_ENABLE();
+	App_OtaStartRx();
+}
+
+
+/*
+ * App_OtaTask
+ * -----------
+ * A receiver stopped by an error starts over, then the command in progress
+ * takes its step or new bytes are parsed, and a reply waiting for the line
+ * goes. RESET_AND_BOOT resets once its reply is on the line.
+ */
+void App_OtaTask(uint32_t Events)
+{
+	if((Events & APP_EVENT_OTA_RESTART) != 0u)
+	{
+		App_OtaStartRx();
+	}
+
+	if((Events & APP_EVENT_OTA_TIMEOUT) != 0u)
+	{
+		App_OtaTimeout();
+	}
+
+	if((Events & APP_EVENT_OTA_STEP) != 0u)
+	{
+		if(Global_Ota.State == OTA_STATE_ERASE)
+		{
+			App_OtaEraseStep();
+		}
+		else if(Global_Ota.State == OTA_STATE_WRITE)
+		{
+			App_OtaWriteStep();
+		}
+	}
+
+	if((Events & APP_EVENT_OTA_RX) != 0u)
+	{
+		App_OtaReceive();
+	}
+
+	App_OtaSendReply();
+
+	if((Global_Ota.State == OTA_STATE_RESET) && (Global_Ota.ReplyLength == 0u) && (Global_uint8Sending == 0u))
+	{
+		NVIC_SystemReset();
+	}
+}
+
+
+void App_OtaRxIdle(void)
+{
+	App_OtaRxUpdate();
+}
+
+
+/* UART interrupt: the HAL stopped the receive DMA */
+void App_OtaRxError(void)
+{
+	App_SchedSignal(APP_TASK_OTA, APP_EVENT_OTA_RESTART);
+}
+
+
+uint8_t App_OtaBusy(void)
+{
+	return ((Global_Ota.State != OTA_STATE_IDLE) || (Global_Ota.Touched != 0u)) ? 1u : 0u;
+}
+
+
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef* huart)
+{
+	if(huart->Instance == USART2)
+	{
+		App_OtaRxUpdate();
+	}
+}
+
+
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart)
+{
+	if(huart->Instance == USART2)
+	{
+		App_OtaRxUpdate();
+	}
+}
+
+#else
+
+void App_OtaStart(void)
+{
+}
+
+
+void App_OtaTask(uint32_t Events)
+{
+	(void)Events;
+}
+
+
+void App_OtaRxIdle(void)
+{
+}
+
+
+void App_OtaRxError(void)
+{
+}
+
+
+uint8_t App_OtaBusy(void)
+{
+	return 0u;
+}
+
+#endif
@@ -0,0 +1,285 @@
+#include <string.h>
+#include <reent.h>
+#include "main.h"
+#include "App_Pool.h"
+
+typedef struct PoolBlock
+{
+	struct PoolBlock* Next;
+} PoolBlock_t;
+
+typedef struct
+{
+	uint8_t* Storage;
+	uint16_t BlockSize;
+	uint16_t Count;
+} PoolClass_t;
+
+static uint8_t Global_uint8Pool32[APP_POOL_32_COUNT * 32u] __attribute__((aligned(8))) APP_RAM_BUDGET("pool");
+static uint8_t Global_uint8Pool128[APP_POOL_128_COUNT * 128u] __attribute__((aligned(8))) APP_RAM_BUDGET("pool");
+static uint8_t Global_uint8Pool512[APP_POOL_512_COUNT * 512u] __attribute__((aligned(8))) APP_RAM_BUDGET("pool");
+static uint8_t Global_uint8Pool2048[APP_POOL_2048_COUNT * 2048u] __attribute__((aligned(8))) APP_RAM_BUDGET("pool");
+
+/* By increasing block size: App_PoolAlloc takes the first that fits */
+static const PoolClass_t Global_Classes[APP_POOL_CLASSES] =
+{
+	{ Global_uint8Pool32,   32u,   APP_POOL_32_COUNT   },
+	{ Global_uint8Pool128,  128u,  APP_POOL_128_COUNT  },
+	{ Global_uint8Pool512,  512u,  APP_POOL_512_COUNT  },
+	{ Global_uint8Pool2048, 2048u, APP_POOL_2048_COUNT },
+};
+
+static PoolBlock_t*   Global_FreeLists[APP_POOL_CLASSES];
+static AppPoolStats_t Global_Stats[APP_POOL_CLASSES];
+static uint8_t        Global_uint8Ready;
+
+
+/*
+ * App_PoolInit
+ * ------------
+ * Threads every block of every class onto its free list. Run by the first
+ * allocation, which may come from the C library before main().
+ */
+static void App_PoolInit(void)
+{
+	uint8_t  Local_uint8Class;
+	uint16_t Local_uint16Block;
+	PoolBlock_t* Local_pBlock;
+
+	for(Local_uint8Class = 0; Local_uint8Class < APP_POOL_CLASSES; Local_uint8Class++)
+	{
+		Global_FreeLists[Local_uint8Class] = NULL;
+
+		for(Local_uint16Block = Global_Classes[Local_uint8Class].Count; Local_uint16Block != 0u; Local_uint16Block--)
+		{
+			Local_pBlock = (PoolBlock_t*)&Global_Classes[Local_uint8Class].Storage[(Local_uint16Block - 1u) * Global_Classes[Local_uint8Class].BlockSize];
+			Local_pBlock->Next = Global_FreeLists[Local_uint8Class];
+			Global_FreeLists[Local_uint8Class] = Local_pBlock;
+		}
+	}
+
+	Global_uint8Ready = 1u;
+}
+
+
+/* Class owning Block, APP_POOL_CLASSES when it is no pool block */
+static uint8_t App_PoolClassOf(const void* Block)
+{
+	uint8_t Local_uint8Class;
+	const uint8_t* Local_puint8Block = (const uint8_t*)Block;
+
+	for(Local_uint8Class = 0; Local_uint8Class < APP_POOL_CLASSES; Local_uint8Class++)
+	{
+		if((Local_puint8Block >= Global_Classes[Local_uint8Class].Storage) &&
+		   (Local_puint8Block <  &Global_Classes[Local_uint8Class].Storage[Global_Classes[Local_uint8Class].Count * Global_Classes[Local_uint8Class].BlockSize]) &&
+		   (((uint32_t)(Local_puint8Block - Global_Classes[Local_uint8Class].Storage) % Global_Classes[Local_uint8Class].BlockSize) == 0u))
+		{
+			break;
+		}
+	}
+
+	return Local_uint8Class;
+}
+
+
+/*
+ * App_PoolAlloc
+ * -------------
+ * Pops a block off the smallest class that fits and is not empty. A request
+ * nothing could serve counts as a failure of the class it fits.
+ */
+void* App_PoolAlloc(uint32_t Size)
+{
+	PoolBlock_t* Local_pBlock = NULL;
+	uint32_t Local_uint32Primask;
+	uint8_t  Local_uint8Fit;
+	uint8_t  Local_uint8Class;
+
+	for(Local_uint8Fit = 0; Local_uint8Fit < APP_POOL_CLASSES; Local_uint8Fit++)
+	{
+		if(Size <= Global_Classes[Local_uint8Fit].BlockSize)
+		{
+			break;
+		}
+	}
+
+	if((Size == 0u) || (Local_uint8Fit == APP_POOL_CLASSES))
+	{
+		return NULL;
+	}
+
+	Local_uint32Primask = __get_PRIMASK();
+	__disable_irq();
+
+	if(Global_uint8Ready == 0u)
+	{
+		App_PoolInit();
+	}
+
+	for(Local_uint8Class = Local_uint8Fit; Local_uint8Class < APP_POOL_CLASSES; Local_uint8Class++)
+	{
+		Local_pBlock = Global_FreeLists[Local_uint8Class];
+
+		if(Local_pBlock != NULL)
+		{
+			Global_FreeLists[Local_uint8Class] = Local_pBlock->Next;
+			Global_Stats[Local_uint8Class].InUse++;
+
+			if(Global_Stats[Local_uint8Class].InUse > Global_Stats[Local_uint8Class].HighWater)
+			{
+				Global_Stats[Local_uint8Class].HighWater = Global_Stats[Local_uint8Class].InUse;
+			}
+			break;
+		}
+	}
+
+	if(Local_pBlock == NULL)
+	{
+		Global_Stats[Local_uint8Fit].Failures++;
+	}
+
+	__set_PRIMASK(Local_uint32Primask);
+
+	return Local_pBlock;
+}
+
+
+void App_PoolFree(void* Block)
+{
+	PoolBlock_t* Local_pBlock = (PoolBlock_t*)Block;
+	uint32_t Local_uint32Primask;
+	uint8_t  Local_uint8Class = App_PoolClassOf(Block);
+
+	if((Block == NULL) || (Local_uint8Class == APP_POOL_CLASSES))
+	{
+		return;
+	}
+
+	Local_uint32Primask = __get_PRIMASK();
+	__disable_irq();
+	Local_pBlock->Next = Global_FreeLists[Local_uint8Class];
+	Global_FreeLists[Local_uint8Class] = Local_pBlock;
+	Global_Stats[Local_uint8Class].InUse--;
+	__set_PRIMASK(Local_uint32Primask);
+}
+
+
+uint32_t App_PoolBlockSize(const void* Block)
+{
+	uint8_t Local_uint8Class = App_PoolClassOf(Block);
+
+	return (Local_uint8Class == APP_POOL_CLASSES) ? 0u : Global_Classes[Local_uint8Class].BlockSize;
+}
+
+
+uint8_t App_PoolGetStats(uint8_t Class, AppPoolStats_t* Stats)
+{
+	uint32_t Local_uint32Primask;
+
+	if(Class >= APP_POOL_CLASSES)
+	{
+		return 0u;
+	}
+
+	Local_uint32Primask = __get_PRIMASK();
+	__disable_irq();
+	*Stats           = Global_Stats[Class];
+	Stats->BlockSize = Global_Classes[Class].BlockSize;
+	Stats->Count     = Global_Classes[Class].Count;
+	__set_PRIMASK(Local_uint32Primask);
+
+	return 1u;
+}
+
+
+/*
+ * C library allocation shim
+ * -------------------------
+ * Defining these replaces newlib's allocator (and with it the _sbrk heap of
+ * sysmem.c) at link time. realloc keeps the block when the new size still
+ * fits its class.
+ */
+void* malloc(size_t Size)
+{
+	return App_PoolAlloc(Size);
+}
+
+void free(void* Block)
+{
+	App_PoolFree(Block);
+}
+
+void* calloc(size_t Count, size_t Size)
+{
+	void* Local_pBlock;
+
+	if((Size != 0u) && (Count > (0xFFFFFFFFUL / Size)))
+	{
+		return NULL;
+	}
+
+	Local_pBlock = App_PoolAlloc(Count * Size);
+
+	if(Local_pBlock != NULL)
+	{
+		memset(Local_pBlock, 0, Count * Size);
+	}
+
+	return Local_pBlock;
+}
+
+void* realloc(void* Block, size_t Size)
+{
+	uint32_t Local_uint32Old = App_PoolBlockSize(Block);
+	void*    Local_pNew;
+
+	if(Block == NULL)
+	{
+		return App_PoolAlloc(Size);
+	}
+
+	if(Size == 0u)
+	{
+		App_PoolFree(Block);
+		return NULL;
+	}
+
+	if(Size <= Local_uint32Old)
+	{
+		return Block;
+	}
+
+	Local_pNew = App_PoolAlloc(Size);
+
+	if(Local_pNew != NULL)
+	{
+		memcpy(Local_pNew, Block, Local_uint32Old);
+		App_PoolFree(Block);
+	}
+
+	return Local_pNew;
+}
+
+void* _malloc_r(struct _reent* Reent, size_t Size)
+{
+	(void)Reent;
+	return malloc(Size);
+}
+
+void _free_r(struct _reent* Reent, void* Block)
+{
+	(void)Reent;
+	free(Block);
+}
+
+void* _calloc_r(struct _reent* Reent, size_t Count, size_t Size)
+{
+	(void)Reent;
+	return calloc(Count, Size);
+}
+
+void* _realloc_r(struct _reent* Reent, void* Block, size_t Size)
+{
+	(void)Reent;
+	return realloc(Block, Size);
+}
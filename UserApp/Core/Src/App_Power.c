@@ -0,0 +1,316 @@
+#include "main.h"
+#include "usbh_core.h"
+#include "App_Power.h"
+#include "App_Uart.h"
+#include "App_I2c.h"
+#include "App_Accel.h"
+#include "App_Update.h"
+#include "App_Clock.h"
+
+/* SysTick counts per millisecond, LOAD + 1 as HAL_InitTick left it */
+static uint32_t Global_uint32TickCycles;
+
+#if APP_POWER_STOP_ENABLE
+
+extern I2S_HandleTypeDef  hi2s3;
+extern USBH_HandleTypeDef hUsbHostFS;
+
+#define POWER_RTC_PREDIV_S           0x7FFFu   /* PREDIV_A 0: SSR counts LSI cycles, 32768 per "second" */
+#define POWER_RTC_WRAP               (3600UL * (POWER_RTC_PREDIV_S + 1u))   /* App_PowerRtcNow: minutes and seconds */
+#define POWER_WAKEUP_DIV             16u       /* WUCKSEL 000: RTCCLK / 16 */
+#define POWER_CALIBRATION_MS         1000u
+
+static uint8_t  Global_uint8RtcReady;
+static uint32_t Global_uint32LsiHz;            /* 0 until measured */
+static uint32_t Global_uint32CalTick;
+static uint32_t Global_uint32CalRtc;
+
+
+/* BCD minutes and seconds plus the subsecond count, in LSI cycles within the hour */
+static uint32_t App_PowerRtcNow(void)
+{
+	uint32_t Local_uint32Tr;
+	uint32_t Local_uint32Ssr;
+	uint32_t Local_uint32Seconds;
+
+	/* Shadow registers bypassed (BYPSHAD): read until a second boundary did not fall in between */
+	do
+	{
+		Local_uint32Tr  = RTC->TR;
+		Local_uint32Ssr = RTC->SSR;
+	} while(Local_uint32Tr != RTC->TR);
+
+	Local_uint32Seconds = (((Local_uint32Tr >> 12) & 0x7u) * 600u) + (((Local_uint32Tr >> 8) & 0xFu) * 60u) +
+	                      (((Local_uint32Tr >> 4) & 0x7u) * 10u) + (Local_uint32Tr & 0xFu);
+
+	return (Local_uint32Seconds * (POWER_RTC_PREDIV_S + 1u)) + (POWER_RTC_PREDIV_S - (Local_uint32Ssr & 0xFFFFu));
+}
+
+
+static uint32_t App_PowerRtcSince(uint32_t Before)
+{
+	return (App_PowerRtcNow() + POWER_RTC_WRAP - Before) % POWER_RTC_WRAP;
+}
+
+
+/*
+ * App_PowerRtcInit
+ * ----------------
+ * LSI as RTC clock, unless the backup domain already runs the RTC on
+ * another one (only a backup domain reset could change it, and that would
+ * clear the bootloader's backup registers): then no STOP.
+ */
+static void App_PowerRtcInit(void)
+{
+	RCC->CSR |= RCC_CSR_LSION;
+	while((RCC->CSR & RCC_CSR_LSIRDY) == 0u)
+	{
+	}
+
+	HAL_PWR_EnableBkUpAccess();
+
+	if((RCC->BDCR & RCC_BDCR_RTCSEL) == 0u)
+	{
+		RCC->BDCR |= RCC_BDCR_RTCSEL_1;
+	}
+	if((RCC->BDCR & RCC_BDCR_RTCSEL) != RCC_BDCR_RTCSEL_1)
+	{
+		HAL_PWR_DisableBkUpAccess();
+		return;
+	}
+	RCC->BDCR |= RCC_BDCR_RTCEN;
+
+	RTC->WPR = 0xCAu;
+	RTC->WPR = 0x53u;
+
+	RTC->ISR = 0xFFFFFFFFUL;                    /* INIT, the flags unchanged (written 1) */
+	while((RTC->ISR & RTC_ISR_INITF) == 0u)
+	{
+	}
+	RTC->PRER = POWER_RTC_PREDIV_S;             /* PREDIV_A 0 */
+	RTC->CR   = RTC_CR_BYPSHAD;
+	RTC->ISR &= ~RTC_ISR_INIT;
+
+	RTC->WPR = 0xFFu;
+	HAL_PWR_DisableBkUpAccess();
+
+	/* Wake-up timer: EXTI line 22, rising edge */
+	EXTI->IMR  |= EXTI_IMR_MR22;
+	EXTI->RTSR |= EXTI_RTSR_TR22;
+	HAL_NVIC_SetPriority(RTC_WKUP_IRQn, 0, 0);
+	HAL_NVIC_EnableIRQ(RTC_WKUP_IRQn);
+
+	Global_uint32CalTick = HAL_GetTick();
+	Global_uint32CalRtc  = App_PowerRtcNow();
+	Global_uint8RtcReady = 1u;
+}
+
+
+static void App_PowerWakeupTimer(uint32_t Count)
+{
+	HAL_PWR_EnableBkUpAccess();
+	RTC->WPR = 0xCAu;
+	RTC->WPR = 0x53u;
+
+	RTC->CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+	if(Count != 0u)
+	{
+		while((RTC->ISR & RTC_ISR_WUTWF) == 0u)
+		{
+		}
+		RTC->WUTR = Count - 1u;
+		RTC->ISR  = (~(RTC_ISR_WUTF | RTC_ISR_INIT) & 0xFFFFu) | (RTC->ISR & RTC_ISR_INIT);
+		RTC->CR  |= RTC_CR_WUTIE | RTC_CR_WUTE;
+	}
+
+	RTC->WPR = 0xFFu;
+	HAL_PWR_DisableBkUpAccess();
+}
+
+
+/* STOP halts the clocks of everything here: only with all of it idle */
+static uint8_t App_PowerCanStop(void)
+{
+	return (uint8_t)((Global_uint8RtcReady != 0u) && (Global_uint32LsiHz != 0u) &&
+	                 (App_UartTxIdle() != 0u) && (App_I2cBatchBusy() == 0u) &&
+	                 (App_AccelRunning() == 0u) && (App_UpdateBusy() == 0u) &&
+	                 (HAL_I2S_GetState(&hi2s3) == HAL_I2S_STATE_READY) && (hUsbHostFS.gState == HOST_IDLE));
+}
+
+
+/*
+ * App_PowerStop
+ * -------------
+ * Wakes one millisecond early: the SysTick after it expires the timer. The
+ * time stopped comes from the RTC, whichever interrupt ended it.
+ */
+static uint32_t App_PowerStop(uint32_t Ms)
+{
+	uint32_t Local_uint32Max   = (0x10000UL * POWER_WAKEUP_DIV * 1000u) / Global_uint32LsiHz;
+	uint32_t Local_uint32Before;
+	uint32_t Local_uint32Slept;
+
+	if(Ms > Local_uint32Max)
+	{
+		Ms = Local_uint32Max;
+	}
+
+	App_PowerWakeupTimer(((Ms - 1u) * Global_uint32LsiHz) / (POWER_WAKEUP_DIV * 1000u));
+	Local_uint32Before = App_PowerRtcNow();
+
+	SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+	HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI);
+
+	/* HSI after STOP: back to HSE, the PLLs and the clock profile, SysTick restarts on the new clock */
+	App_ClockResume();
+
+	Local_uint32Slept = (uint32_t)(((uint64_t)App_PowerRtcSince(Local_uint32Before) * 1000u) / Global_uint32LsiHz);
+	App_PowerWakeupTimer(0u);
+
+	return (Local_uint32Slept < Ms) ? Local_uint32Slept : (Ms - 1u);
+}
+
+
+/* The LSI against SysTick, once, over the first second of idle time */
+static void App_PowerCalibrate(void)
+{
+	uint32_t Local_uint32Ms = HAL_GetTick() - Global_uint32CalTick;
+
+	if((Global_uint8RtcReady != 0u) && (Global_uint32LsiHz == 0u) && (Local_uint32Ms >= POWER_CALIBRATION_MS))
+	{
+		Global_uint32LsiHz = (uint32_t)(((uint64_t)App_PowerRtcSince(Global_uint32CalRtc) * 1000u) / Local_uint32Ms);
+	}
+}
+
+
+/* Only enables the core to leave STOP: the wake-up itself is the work */
+void RTC_WKUP_IRQHandler(void)
+{
+	HAL_PWR_EnableBkUpAccess();
+	RTC->ISR = (~(RTC_ISR_WUTF | RTC_ISR_INIT) & 0xFFFFu) | (RTC->ISR & RTC_ISR_INIT);
+	HAL_PWR_DisableBkUpAccess();
+	EXTI->PR = EXTI_PR_PR22;
+}
+
+#endif /* APP_POWER_STOP_ENABLE */
+
+
+/* HAL_InitTick reloaded SysTick for the new HCLK */
+static uint8_t App_PowerClock(uint8_t Phase, uint32_t Hz)
+{
+	(void)Hz;
+
+	if(Phase == APP_CLOCK_AFTER)
+	{
+		Global_uint32TickCycles = SysTick->LOAD + 1u;
+	}
+
+	return 1u;
+}
+
+
+void App_PowerInit(void)
+{
+	Global_uint32TickCycles = SysTick->LOAD + 1u;
+	(void)App_ClockAddListener(App_PowerClock);
+
+#if APP_POWER_STOP_ENABLE
+	App_PowerRtcInit();
+#endif
+}
+
+
+#if APP_POWER_TICKLESS
+/*
+ * App_PowerSleep
+ * --------------
+ * SysTick reloaded to end the tick period Ms - 1 periods later (the usual
+ * suppressed-tick scheme): when it fires the pending SysTick_Handler counts
+ * the last millisecond itself, otherwise the periods that did pass are
+ * returned and SysTick is reloaded with the rest of the current one.
+ */
+static uint32_t App_PowerSleep(uint32_t Ms)
+{
+	uint32_t Local_uint32Period = Global_uint32TickCycles;
+	uint32_t Local_uint32Max    = (SysTick_LOAD_RELOAD_Msk / Local_uint32Period) - 1u;
+	uint32_t Local_uint32Reload;
+	uint32_t Local_uint32Elapsed;
+	uint32_t Local_uint32Slept;
+
+	if(Ms > Local_uint32Max)
+	{
+		Ms = Local_uint32Max;
+	}
+
+	SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+
+	/* The tick came due meanwhile: it has to run first */
+	if((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0u)
+	{
+		SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+		return 0u;
+	}
+
+	Local_uint32Reload = SysTick->VAL + (Local_uint32Period * (Ms - 1u));
+	SysTick->LOAD = Local_uint32Reload;
+	SysTick->VAL  = 0u;
+	SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+	__DSB();
+	__WFI();
+	__ISB();
+
+	/* Stopped by a write, which leaves COUNTFLAG to be read */
+	SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk;
+
+	if((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) != 0u)
+	{
+		Local_uint32Elapsed = Local_uint32Reload - SysTick->VAL;
+		SysTick->LOAD = (Local_uint32Elapsed < Local_uint32Period) ? ((Local_uint32Period - 1u) - Local_uint32Elapsed) : (Local_uint32Period - 1u);
+		Local_uint32Slept = Ms - 1u;
+	}
+	else
+	{
+		Local_uint32Elapsed = (Ms * Local_uint32Period) - SysTick->VAL;
+		Local_uint32Slept   = Local_uint32Elapsed / Local_uint32Period;
+		SysTick->LOAD = ((Local_uint32Slept + 1u) * Local_uint32Period) - Local_uint32Elapsed;
+	}
+
+	SysTick->VAL  = 0u;
+	SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk;
+	SysTick->LOAD = Local_uint32Period - 1u;
+
+	return Local_uint32Slept;
+}
+#endif /* APP_POWER_TICKLESS */
+
+
+/*
+ * App_PowerIdle
+ * -------------
+ * With interrupts masked, so that an interrupt pending since the scheduler
+ * looked still ends the sleep at once (and runs once they are unmasked).
+ * A wait shorter than two milliseconds is a plain WFI.
+ */
+uint32_t App_PowerIdle(uint32_t Ms)
+{
+#if APP_POWER_STOP_ENABLE
+	App_PowerCalibrate();
+	if((Ms >= APP_POWER_STOP_MIN_MS) && (App_PowerCanStop() != 0u))
+	{
+		return App_PowerStop(Ms);
+	}
+#endif
+
+#if APP_POWER_TICKLESS
+	if((Ms >= 2u) && (Global_uint32TickCycles != 0u))
+	{
+		return App_PowerSleep(Ms);
+	}
+#endif
+
+	__DSB();
+	__WFI();
+
+	return 0u;
+}
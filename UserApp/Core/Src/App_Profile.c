@@ -0,0 +1,202 @@
+#include "main.h"
+#include "App_Profile.h"
+#include "App_Clock.h"
+
+#if APP_PROFILE_ENABLE
+
+#define PROFILE_RECORD               ((volatile AppProfile_t*)APP_PROFILE_ADDRESS)
+#define PROFILE_MIN_SHIFT            2u        /* 4 bytes: two Thumb instructions */
+
+/* Linker script and startup: the code the buckets cover */
+extern const uint32_t g_pfnVectors[];
+extern const uint32_t _etext;
+
+/* Set once by App_ProfileStart, read by every sample */
+static uint32_t Global_uint32Base;
+static uint32_t Global_uint32Span;             /* Buckets << Shift */
+static uint32_t Global_uint32Shift;
+
+
+/* Every count, Outside included, over two: the shares stay, the counts fit */
+static void App_ProfileHalve(volatile AppProfile_t* Record)
+{
+	uint32_t Local_uint32Index;
+
+	for(Local_uint32Index = 0u; Local_uint32Index < Record->Buckets; Local_uint32Index++)
+	{
+		Record->Count[Local_uint32Index] = (uint16_t)(Record->Count[Local_uint32Index] >> 1);
+	}
+	Record->Outside >>= 1;
+	Record->Halvings++;
+}
+
+
+/* Tail-called by TIM7_IRQHandler with the exception frame: [6] is the interrupted PC */
+static __attribute__((used)) void App_ProfileSample(const uint32_t* Frame)
+{
+	volatile AppProfile_t* Local_pRecord = PROFILE_RECORD;
+	uint32_t Local_uint32Offset = Frame[6] - Global_uint32Base;
+	uint32_t Local_uint32Bucket;
+
+	TIM7->SR = 0u;
+
+	Local_pRecord->Samples++;
+
+	if(Local_uint32Offset < Global_uint32Span)
+	{
+		Local_uint32Bucket = Local_uint32Offset >> Global_uint32Shift;
+
+		if(++Local_pRecord->Count[Local_uint32Bucket] == 0xFFFFu)
+		{
+			App_ProfileHalve(Local_pRecord);
+		}
+	}
+	else
+	{
+		Local_pRecord->Outside++;
+	}
+}
+
+
+/* Naked: the frame is on the stack EXC_RETURN says, and App_ProfileSample returns from the interrupt */
+__attribute__((naked)) void TIM7_IRQHandler(void)
+{
+	__asm volatile("tst   lr, #4              \n\t"
+	               "ite   eq                  \n\t"
+	               "mrseq r0, msp             \n\t"
+	               "mrsne r0, psp             \n\t"
+	               "b     App_ProfileSample   \n\t");
+}
+
+
+/* The counter clock of TIM7: PCLK1, twice it when APB1 is divided */
+static uint32_t App_ProfileTimerClock(void)
+{
+	uint32_t Local_uint32Clock = HAL_RCC_GetPCLK1Freq();
+
+	if((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1)
+	{
+		Local_uint32Clock *= 2u;
+	}
+
+	return Local_uint32Clock;
+}
+
+
+/* The same APP_PROFILE_TIMER_HZ on the new PCLK1, from the next update on */
+static uint8_t App_ProfileClock(uint8_t Phase, uint32_t Hz)
+{
+	(void)Hz;
+
+	if(Phase == APP_CLOCK_AFTER)
+	{
+		TIM7->PSC = (App_ProfileTimerClock() / APP_PROFILE_TIMER_HZ) - 1u;
+	}
+
+	return 1u;
+}
+
+
+/*
+ * App_ProfileStart
+ * ----------------
+ * Picks the bucket size, keeps a record left by a boot of the same image
+ * at the same rate or clears it, then runs TIM7: APP_PROFILE_TIMER_HZ
+ * counter, update interrupt every APP_PROFILE_PERIOD counts.
+ */
+void App_ProfileStart(void)
+{
+	volatile AppProfile_t* Local_pRecord = PROFILE_RECORD;
+	uint32_t Local_uint32Length = (uint32_t)&_etext - (uint32_t)g_pfnVectors;
+	uint32_t Local_uint32Shift  = PROFILE_MIN_SHIFT;
+
+	while((Local_uint32Length >> Local_uint32Shift) >= APP_PROFILE_BUCKETS)
+	{
+		Local_uint32Shift++;
+	}
+
+	Global_uint32Base  = (uint32_t)g_pfnVectors;
+	Global_uint32Shift = Local_uint32Shift;
+	Global_uint32Span  = ((Local_uint32Length >> Local_uint32Shift) + 1u) << Local_uint32Shift;
+
+	__HAL_RCC_PWR_CLK_ENABLE();
+	HAL_PWR_EnableBkUpAccess();
+	__HAL_RCC_BKPSRAM_CLK_ENABLE();
+
+	if((Local_pRecord->Magic   != APP_PROFILE_MAGIC) ||
+	   (Local_pRecord->Base    != Global_uint32Base) ||
+	   (Local_pRecord->Shift   != Global_uint32Shift) ||
+	   (Local_pRecord->Buckets != (Global_uint32Span >> Global_uint32Shift)) ||
+	   (Local_pRecord->RateHz  != (APP_PROFILE_TIMER_HZ / APP_PROFILE_PERIOD)))
+	{
+		Local_pRecord->Magic   = 0u;
+		Local_pRecord->Base    = Global_uint32Base;
+		Local_pRecord->Shift   = Global_uint32Shift;
+		Local_pRecord->Buckets = Global_uint32Span >> Global_uint32Shift;
+		Local_pRecord->RateHz  = APP_PROFILE_TIMER_HZ / APP_PROFILE_PERIOD;
+		App_ProfileClear();
+		Local_pRecord->Magic   = APP_PROFILE_MAGIC;
+	}
+
+	__HAL_RCC_TIM7_CLK_ENABLE();
+	TIM7->CR1  = 0u;
+	TIM7->PSC  = (App_ProfileTimerClock() / APP_PROFILE_TIMER_HZ) - 1u;
+	TIM7->ARR  = APP_PROFILE_PERIOD - 1u;
+	TIM7->EGR  = TIM_EGR_UG;                   /* Loads PSC */
+	TIM7->SR   = 0u;
+	TIM7->DIER = TIM_DIER_UIE;
+
+	HAL_NVIC_SetPriority(TIM7_IRQn, 0, 0);
+	HAL_NVIC_EnableIRQ(TIM7_IRQn);
+
+	TIM7->CR1  = TIM_CR1_CEN;
+
+	(void)App_ClockAddListener(App_ProfileClock);
+}
+
+
+void App_ProfileStop(void)
+{
+	TIM7->CR1 = 0u;
+	HAL_NVIC_DisableIRQ(TIM7_IRQn);
+}
+
+
+void App_ProfileClear(void)
+{
+	volatile AppProfile_t* Local_pRecord = PROFILE_RECORD;
+	uint32_t Local_uint32Index;
+
+	NVIC_DisableIRQ(TIM7_IRQn);
+
+	for(Local_uint32Index = 0u; Local_uint32Index < APP_PROFILE_BUCKETS; Local_uint32Index++)
+	{
+		Local_pRecord->Count[Local_uint32Index] = 0u;
+	}
+	Local_pRecord->Samples  = 0u;
+	Local_pRecord->Outside  = 0u;
+	Local_pRecord->Halvings = 0u;
+
+	if((TIM7->CR1 & TIM_CR1_CEN) != 0u)
+	{
+		NVIC_EnableIRQ(TIM7_IRQn);
+	}
+}
+
+#else
+
+void App_ProfileStart(void)
+{
+}
+
+
+void App_ProfileStop(void)
+{
+}
+
+
+void App_ProfileClear(void)
+{
+}
+
+#endif
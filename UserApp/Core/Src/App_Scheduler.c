@@ -0,0 +1,357 @@
+#include "main.h"
+#include "App_Scheduler.h"
+#include "App_Power.h"
+
+/* One timer: counts Remaining milliseconds down, 0 when stopped */
+typedef struct
+{
+	uint32_t Remaining;
+	uint32_t PeriodMs;
+	uint32_t Events;
+	uint8_t  Task;
+} AppTimer_t;
+
+static AppTask_t           Global_Tasks[APP_SCHED_MAX_TASKS] APP_CCMRAM;
+static volatile uint32_t   Global_uint32Events[APP_SCHED_MAX_TASKS] APP_CCMRAM;
+static volatile uint32_t   Global_uint32Ready;            /* Bit n: task n has events */
+static volatile AppTimer_t Global_Timers[APP_SCHED_MAX_TIMERS] APP_CCMRAM;
+
+#if APP_SCHED_LATENCY_ENABLE
+
+#define SCHED_LATENCY_MASK           ((1UL << APP_SCHED_LATENCY_BITS) - 1u)
+
+/* Since: CYCCNT of the oldest signal of each pending event, written and read with interrupts off */
+static uint32_t            Global_uint32Since[APP_SCHED_MAX_TASKS][APP_SCHED_LATENCY_BITS] APP_CCMRAM;
+static AppSchedLatency_t   Global_Latency[APP_SCHED_MAX_TASKS][APP_SCHED_LATENCY_BITS] APP_CCMRAM;   /* Tasks only */
+static volatile uint32_t   Global_uint32IsrCycles;        /* CYCCNT at the last App_SchedIsrEntry */
+static volatile uint32_t   Global_uint32IsrNumber;        /* And the exception it was called from */
+
+
+/* The entry of the running handler if it called App_SchedIsrEntry, else now */
+static uint32_t App_SchedStamp(void)
+{
+	uint32_t Local_uint32Ipsr = __get_IPSR();
+
+	return ((Local_uint32Ipsr != 0u) && (Local_uint32Ipsr == Global_uint32IsrNumber)) ? Global_uint32IsrCycles : DWT->CYCCNT;
+}
+
+
+/*
+ * App_SchedRecord
+ * ---------------
+ * The wait of each of the task's events, from its stamp to now (the task is
+ * called next), into its histogram.
+ */
+static void App_SchedRecord(uint8_t Task, uint32_t Events, const uint32_t* Since)
+{
+	uint32_t Local_uint32Now  = DWT->CYCCNT;
+	uint32_t Local_uint32Bits = Events & SCHED_LATENCY_MASK;
+	uint32_t Local_uint32Wait;
+	uint32_t Local_uint32Bucket;
+	uint32_t Local_uint32Index;
+	uint8_t  Local_uint8Bit;
+	AppSchedLatency_t* Local_pLatency;
+
+	while(Local_uint32Bits != 0u)
+	{
+		Local_uint8Bit    = (uint8_t)__CLZ(__RBIT(Local_uint32Bits));
+		Local_uint32Bits &= Local_uint32Bits - 1u;
+		Local_pLatency    = &Global_Latency[Task][Local_uint8Bit];
+		Local_uint32Wait  = Local_uint32Now - Since[Local_uint8Bit];
+
+		Local_uint32Bucket = 0u;
+		if((Local_uint32Wait >> APP_SCHED_LATENCY_SHIFT) != 0u)
+		{
+			Local_uint32Bucket = (31u - __CLZ(Local_uint32Wait)) - APP_SCHED_LATENCY_SHIFT + 1u;
+			if(Local_uint32Bucket >= APP_SCHED_LATENCY_BUCKETS)
+			{
+				Local_uint32Bucket = APP_SCHED_LATENCY_BUCKETS - 1u;
+			}
+		}
+
+		Local_pLatency->Total++;
+		if(Local_uint32Wait > Local_pLatency->Worst)
+		{
+			Local_pLatency->Worst = Local_uint32Wait;
+		}
+
+		if(++Local_pLatency->Count[Local_uint32Bucket] == 0xFFFFu)
+		{
+			for(Local_uint32Index = 0u; Local_uint32Index < APP_SCHED_LATENCY_BUCKETS; Local_uint32Index++)
+			{
+				Local_pLatency->Count[Local_uint32Index] = (uint16_t)(Local_pLatency->Count[Local_uint32Index] >> 1);
+			}
+			Local_pLatency->Halvings++;
+		}
+	}
+}
+
+#endif
+
+
+void App_SchedSetTask(uint8_t Task, AppTask_t Run)
+{
+	if(Task < APP_SCHED_MAX_TASKS)
+	{
+		Global_Tasks[Task] = Run;
+	}
+}
+
+
+/*
+ * App_SchedSignal
+ * ---------------
+ * Interrupts off for the two read-modify-writes, so an interrupt signalling
+ * the same task in between loses nothing. Events of a task without a
+ * function are dropped.
+ */
+void App_SchedSignal(uint8_t Task, uint32_t Events)
+{
+	uint32_t Local_uint32Primask;
+#if APP_SCHED_LATENCY_ENABLE
+	uint32_t Local_uint32New;
+	uint32_t Local_uint32Stamp;
+#endif
+
+	if((Task >= APP_SCHED_MAX_TASKS) || (Global_Tasks[Task] == 0) || (Events == 0u))
+	{
+		return;
+	}
+
+	Local_uint32Primask = __get_PRIMASK();
+	__disable_irq();
+#if APP_SCHED_LATENCY_ENABLE
+	Local_uint32New = Events & ~Global_uint32Events[Task] & SCHED_LATENCY_MASK;
+	if(Local_uint32New != 0u)
+	{
+		Local_uint32Stamp = App_SchedStamp();
+		do
+		{
+			Global_uint32Since[Task][__CLZ(__RBIT(Local_uint32New))] = Local_uint32Stamp;
+			Local_uint32New &= Local_uint32New - 1u;
+		} while(Local_uint32New != 0u);
+	}
+#endif
+	Global_uint32Events[Task] |= Events;
+	Global_uint32Ready        |= (1UL << Task);
+	__set_PRIMASK(Local_uint32Primask);
+}
+
+
+void App_SchedTimerStart(uint8_t Timer, uint8_t Task, uint32_t Events, uint32_t FirstMs, uint32_t PeriodMs)
+{
+	uint32_t Local_uint32Primask;
+
+	if(Timer >= APP_SCHED_MAX_TIMERS)
+	{
+		return;
+	}
+
+	Local_uint32Primask = __get_PRIMASK();
+	__disable_irq();
+	Global_Timers[Timer].Task      = Task;
+	Global_Timers[Timer].Events    = Events;
+	Global_Timers[Timer].PeriodMs  = PeriodMs;
+	Global_Timers[Timer].Remaining = (FirstMs != 0u) ? FirstMs : 1u;
+	__set_PRIMASK(Local_uint32Primask);
+}
+
+
+void App_SchedTimerStop(uint8_t Timer)
+{
+	if(Timer < APP_SCHED_MAX_TIMERS)
+	{
+		Global_Timers[Timer].Remaining = 0u;
+	}
+}
+
+
+/*
+ * App_SchedTick
+ * -------------
+ * Counts every running timer down by one millisecond; an expired one
+ * signals its task and reloads with its period, or stops.
+ */
+void App_SchedTick(void)
+{
+	uint8_t Local_uint8Timer;
+
+	for(Local_uint8Timer = 0; Local_uint8Timer < APP_SCHED_MAX_TIMERS; Local_uint8Timer++)
+	{
+		if((Global_Timers[Local_uint8Timer].Remaining != 0u) && (--Global_Timers[Local_uint8Timer].Remaining == 0u))
+		{
+			Global_Timers[Local_uint8Timer].Remaining = Global_Timers[Local_uint8Timer].PeriodMs;
+			App_SchedSignal(Global_Timers[Local_uint8Timer].Task, Global_Timers[Local_uint8Timer].Events);
+		}
+	}
+}
+
+
+/* Milliseconds until the first running timer expires, with interrupts masked */
+static uint32_t App_SchedNextDue(void)
+{
+	uint32_t Local_uint32Next = APP_POWER_FOREVER;
+	uint8_t  Local_uint8Timer;
+
+	for(Local_uint8Timer = 0; Local_uint8Timer < APP_SCHED_MAX_TIMERS; Local_uint8Timer++)
+	{
+		if((Global_Timers[Local_uint8Timer].Remaining != 0u) && (Global_Timers[Local_uint8Timer].Remaining < Local_uint32Next))
+		{
+			Local_uint32Next = Global_Timers[Local_uint8Timer].Remaining;
+		}
+	}
+
+	return Local_uint32Next;
+}
+
+
+/*
+ * App_SchedAdvance
+ * ----------------
+ * The milliseconds App_PowerIdle slept without SysTick counting them. No
+ * timer expires here: the sleep ends before the first one is due.
+ */
+static void App_SchedAdvance(uint32_t Ms)
+{
+	uint8_t Local_uint8Timer;
+
+	if(Ms == 0u)
+	{
+		return;
+	}
+
+	uwTick += Ms * (uint32_t)uwTickFreq;
+
+	for(Local_uint8Timer = 0; Local_uint8Timer < APP_SCHED_MAX_TIMERS; Local_uint8Timer++)
+	{
+		if(Global_Timers[Local_uint8Timer].Remaining > Ms)
+		{
+			Global_Timers[Local_uint8Timer].Remaining -= Ms;
+		}
+		else if(Global_Timers[Local_uint8Timer].Remaining != 0u)
+		{
+			Global_Timers[Local_uint8Timer].Remaining = 1u;
+		}
+	}
+}
+
+
+/*
+ * App_SchedRun
+ * ------------
+ * Takes the first task with events and its events in one critical section,
+ * then runs it with interrupts on. With no task ready, App_PowerIdle sleeps
+ * with interrupts still masked: an interrupt pending since the check wakes
+ * the core at once instead of being slept through, and runs when they are
+ * unmasked. Starts the DWT cycle counter for the latency stamps if the
+ * application was started without the bootloader.
+ */
+void App_SchedRun(void)
+{
+	uint32_t Local_uint32Events;
+	uint8_t  Local_uint8Task;
+#if APP_SCHED_LATENCY_ENABLE
+	uint32_t Local_uint32Since[APP_SCHED_LATENCY_BITS];
+	uint8_t  Local_uint8Bit;
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+	while(1)
+	{
+		__disable_irq();
+
+		if(Global_uint32Ready == 0u)
+		{
+			App_SchedAdvance(App_PowerIdle(App_SchedNextDue()));
+			__enable_irq();
+			continue;
+		}
+
+		Local_uint8Task    = (uint8_t)__CLZ(__RBIT(Global_uint32Ready));
+		Local_uint32Events = Global_uint32Events[Local_uint8Task];
+		Global_uint32Events[Local_uint8Task] = 0u;
+		Global_uint32Ready &= ~(1UL << Local_uint8Task);
+#if APP_SCHED_LATENCY_ENABLE
+		for(Local_uint8Bit = 0; Local_uint8Bit < APP_SCHED_LATENCY_BITS; Local_uint8Bit++)
+		{
+			Local_uint32Since[Local_uint8Bit] = Global_uint32Since[Local_uint8Task][Local_uint8Bit];
+		}
+#endif
+
+		__enable_irq();
+
+#if APP_SCHED_LATENCY_ENABLE
+		App_SchedRecord(Local_uint8Task, Local_uint32Events, Local_uint32Since);
+#endif
+		Global_Tasks[Local_uint8Task](Local_uint32Events);
+	}
+}
+
+
+#if APP_SCHED_LATENCY_ENABLE
+
+/* From RAM: the handlers that call it run from RAM while the flash is busy */
+__RAM_FUNC void App_SchedIsrEntry(void)
+{
+	Global_uint32IsrCycles = DWT->CYCCNT;
+	Global_uint32IsrNumber = __get_IPSR();
+}
+
+
+const AppSchedLatency_t* App_SchedLatency(uint8_t Task, uint8_t Bit)
+{
+	if((Task >= APP_SCHED_MAX_TASKS) || (Bit >= APP_SCHED_LATENCY_BITS))
+	{
+		return 0;
+	}
+
+	return &Global_Latency[Task][Bit];
+}
+
+
+void App_SchedLatencyClear(void)
+{
+	uint8_t  Local_uint8Task;
+	uint8_t  Local_uint8Bit;
+	uint32_t Local_uint32Index;
+	AppSchedLatency_t* Local_pLatency;
+
+	for(Local_uint8Task = 0; Local_uint8Task < APP_SCHED_MAX_TASKS; Local_uint8Task++)
+	{
+		for(Local_uint8Bit = 0; Local_uint8Bit < APP_SCHED_LATENCY_BITS; Local_uint8Bit++)
+		{
+			Local_pLatency = &Global_Latency[Local_uint8Task][Local_uint8Bit];
+			Local_pLatency->Total    = 0u;
+			Local_pLatency->Worst    = 0u;
+			Local_pLatency->Halvings = 0u;
+			for(Local_uint32Index = 0u; Local_uint32Index < APP_SCHED_LATENCY_BUCKETS; Local_uint32Index++)
+			{
+				Local_pLatency->Count[Local_uint32Index] = 0u;
+			}
+		}
+	}
+}
+
+#else
+
+__RAM_FUNC void App_SchedIsrEntry(void)
+{
+}
+
+
+const AppSchedLatency_t* App_SchedLatency(uint8_t Task, uint8_t Bit)
+{
+	(void)Task;
+	(void)Bit;
+
+	return 0;
+}
+
+
+void App_SchedLatencyClear(void)
+{
+}
+
+#endif
@@ -0,0 +1,221 @@
+#include "main.h"
+#include "App_Telemetry.h"
+#include "App_Uart.h"
+#include "App_Scheduler.h"
+
+#define TLM_HEADER_SIZE      7u        /* Version, sequence, timestamp */
+#define TLM_CRC_SIZE         2u
+#define TLM_RAW_SIZE         (TLM_HEADER_SIZE + APP_TELEMETRY_BATCH_SIZE + TLM_CRC_SIZE)
+#define TLM_COBS_SIZE        (TLM_RAW_SIZE + (TLM_RAW_SIZE / 254u) + 3u)   /* Code bytes and both delimiters */
+#define TLM_MARK_SIZE        4u
+
+/* The batch is built in place, after room for the header */
+static uint8_t  Global_uint8Raw[TLM_RAW_SIZE] APP_RAM_BUDGET("trace");
+static uint8_t  Global_uint8Encoded[TLM_COBS_SIZE] APP_RAM_BUDGET("trace");
+static uint16_t Global_uint16Used;            /* Record bytes in the batch */
+static uint16_t Global_uint16Sequence;
+static uint32_t Global_uint32Timestamp;       /* ms, first sample of the batch */
+static uint32_t Global_uint32Mark;            /* ms, the records since the last mark */
+static uint32_t Global_uint32Dropped;
+
+
+static uint8_t App_TelemetrySize(uint8_t Type)
+{
+	switch(Type)
+	{
+	case APP_TLM_TYPE_U8:
+		return 1u;
+	case APP_TLM_TYPE_MARK:
+	case APP_TLM_TYPE_I16:
+	case APP_TLM_TYPE_U16:
+		return 2u;
+	case APP_TLM_TYPE_I32:
+	case APP_TLM_TYPE_U32:
+		return 4u;
+	default:
+		return 0u;
+	}
+}
+
+
+static void App_TelemetryPut(uint8_t* Data, uint32_t Value, uint8_t Size)
+{
+	uint8_t Local_uint8Index;
+
+	for(Local_uint8Index = 0; Local_uint8Index < Size; Local_uint8Index++)
+	{
+		Data[Local_uint8Index] = (uint8_t)(Value >> (8u * Local_uint8Index));
+	}
+}
+
+
+/* CRC-16/CCITT-FALSE: polynomial 0x1021, initial 0xFFFF, MSB first */
+static uint16_t App_TelemetryCrc(const uint8_t* Data, uint16_t Length)
+{
+	uint16_t Local_uint16Crc = 0xFFFFu;
+	uint16_t Local_uint16Index;
+	uint8_t  Local_uint8Bit;
+
+	for(Local_uint16Index = 0; Local_uint16Index < Length; Local_uint16Index++)
+	{
+		Local_uint16Crc ^= (uint16_t)((uint16_t)Data[Local_uint16Index] << 8);
+		for(Local_uint8Bit = 0; Local_uint8Bit < 8u; Local_uint8Bit++)
+		{
+			Local_uint16Crc = ((Local_uint16Crc & 0x8000u) != 0u) ? (uint16_t)((Local_uint16Crc << 1) ^ 0x1021u) : (uint16_t)(Local_uint16Crc << 1);
+		}
+	}
+
+	return Local_uint16Crc;
+}
+
+
+/*
+ * App_TelemetryCobs
+ * -----------------
+ * COBS: every zero of Data replaced by the distance to the next one, a code
+ * byte in front, a code of 0xFF for 254 bytes without a zero. Then the 0x00
+ * delimiter. Returns the bytes written to Encoded.
+ */
+static uint16_t App_TelemetryCobs(const uint8_t* Data, uint16_t Length, uint8_t* Encoded)
+{
+	uint16_t Local_uint16Code   = 0u;      /* Where the current block's code goes */
+	uint16_t Local_uint16Output = 1u;
+	uint16_t Local_uint16Index;
+	uint8_t  Local_uint8Run     = 1u;
+
+	for(Local_uint16Index = 0; Local_uint16Index < Length; Local_uint16Index++)
+	{
+		if(Data[Local_uint16Index] != 0u)
+		{
+			Encoded[Local_uint16Output++] = Data[Local_uint16Index];
+			Local_uint8Run++;
+		}
+
+		if((Data[Local_uint16Index] == 0u) || (Local_uint8Run == 0xFFu))
+		{
+			Encoded[Local_uint16Code] = Local_uint8Run;
+			Local_uint16Code = Local_uint16Output++;
+			Local_uint8Run   = 1u;
+		}
+	}
+
+	Encoded[Local_uint16Code]     = Local_uint8Run;
+	Encoded[Local_uint16Output++] = 0u;
+
+	return Local_uint16Output;
+}
+
+
+/*
+ * App_TelemetryStart
+ * ------------------
+ * Empties the batch and starts the flush timer.
+ */
+void App_TelemetryStart(void)
+{
+	Global_uint16Used = 0u;
+
+	App_SchedTimerStart(APP_TIMER_TELEMETRY, APP_TASK_HEARTBEAT, APP_EVENT_TELEMETRY, APP_TELEMETRY_PERIOD_MS, APP_TELEMETRY_PERIOD_MS);
+}
+
+
+/*
+ * App_TelemetryAdd
+ * ----------------
+ * One sample, timestamped now: a mark first if the time moved since the
+ * batch's last record. A batch it would not fit in, or whose marks would
+ * no longer reach, is flushed first. 0 for an unknown type or field 0.
+ */
+uint8_t App_TelemetryAdd(uint8_t Field, uint8_t Type, uint32_t Value)
+{
+	uint32_t Local_uint32Now  = HAL_GetTick();
+	uint8_t  Local_uint8Size  = App_TelemetrySize(Type);
+	uint8_t  Local_uint8Mark;
+	uint8_t* Local_puint8Record;
+
+	if((Local_uint8Size == 0u) || (Type == APP_TLM_TYPE_MARK) || (Field == 0u))
+	{
+		return 0u;
+	}
+
+	Local_uint8Mark = ((Global_uint16Used != 0u) && (Local_uint32Now != Global_uint32Mark)) ? 1u : 0u;
+
+	if((Local_uint8Mark != 0u) &&
+	   (((Local_uint32Now - Global_uint32Timestamp) > 0xFFFFu) ||
+	    ((Global_uint16Used + TLM_MARK_SIZE + 2u + Local_uint8Size) > APP_TELEMETRY_BATCH_SIZE)))
+	{
+		App_TelemetryFlush();
+		Local_uint8Mark = 0u;
+	}
+	else if((Global_uint16Used + 2u + Local_uint8Size) > APP_TELEMETRY_BATCH_SIZE)
+	{
+		App_TelemetryFlush();
+	}
+
+	if(Global_uint16Used == 0u)
+	{
+		Global_uint32Timestamp = Local_uint32Now;
+		Global_uint32Mark      = Local_uint32Now;
+	}
+
+	Local_puint8Record = &Global_uint8Raw[TLM_HEADER_SIZE + Global_uint16Used];
+
+	if(Local_uint8Mark != 0u)
+	{
+		Local_puint8Record[0] = 0u;
+		Local_puint8Record[1] = APP_TLM_TYPE_MARK;
+		App_TelemetryPut(&Local_puint8Record[2], Local_uint32Now - Global_uint32Timestamp, 2u);
+		Local_puint8Record += TLM_MARK_SIZE;
+		Global_uint16Used   = (uint16_t)(Global_uint16Used + TLM_MARK_SIZE);
+		Global_uint32Mark   = Local_uint32Now;
+	}
+
+	Local_puint8Record[0] = Field;
+	Local_puint8Record[1] = Type;
+	App_TelemetryPut(&Local_puint8Record[2], Value, Local_uint8Size);
+	Global_uint16Used = (uint16_t)(Global_uint16Used + 2u + Local_uint8Size);
+
+	return 1u;
+}
+
+
+/*
+ * App_TelemetryFlush
+ * ------------------
+ * Header and CRC around the batch, COBS between two delimiters, into the
+ * USART2 queue: the leading one keeps printf text sent since the last
+ * frame out of this one. The sequence moves on whether or not the queue
+ * takes the frame.
+ */
+void App_TelemetryFlush(void)
+{
+	uint16_t Local_uint16Length;
+
+	if(Global_uint16Used == 0u)
+	{
+		return;
+	}
+
+	Global_uint8Raw[0] = APP_TELEMETRY_VERSION;
+	App_TelemetryPut(&Global_uint8Raw[1], Global_uint16Sequence++, 2u);
+	App_TelemetryPut(&Global_uint8Raw[3], Global_uint32Timestamp, 4u);
+
+	Local_uint16Length = (uint16_t)(TLM_HEADER_SIZE + Global_uint16Used);
+	App_TelemetryPut(&Global_uint8Raw[Local_uint16Length], App_TelemetryCrc(Global_uint8Raw, Local_uint16Length), 2u);
+	Local_uint16Length = (uint16_t)(Local_uint16Length + TLM_CRC_SIZE);
+
+	Global_uint8Encoded[0] = 0u;
+	Local_uint16Length = (uint16_t)(1u + App_TelemetryCobs(Global_uint8Raw, Local_uint16Length, &Global_uint8Encoded[1]));
+	if(App_UartSend(Global_uint8Encoded, Local_uint16Length) == 0u)
+	{
+		Global_uint32Dropped++;
+	}
+
+	Global_uint16Used = 0u;
+}
+
+
+uint32_t App_TelemetryDropped(void)
+{
+	return Global_uint32Dropped;
+}
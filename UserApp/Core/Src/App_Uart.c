@@ -0,0 +1,285 @@
+#include <string.h>
+#include <errno.h>
+#include "main.h"
+#include "App_Uart.h"
+#include "App_Ota.h"
+
+extern UART_HandleTypeDef huart2;
+
+/*
+ * Transmit ring: free-running indexes, Head written by App_UartSend only,
+ * Tail by the completion interrupt only. Global_uint16TxInFlight bytes from
+ * Tail are with the DMA, 0 when it is idle.
+ */
+static uint8_t           Global_uint8TxQueue[APP_UART_TX_QUEUE_SIZE];
+static volatile uint16_t Global_uint16TxHead;
+static volatile uint16_t Global_uint16TxTail;
+static volatile uint16_t Global_uint16TxInFlight;
+static uint32_t          Global_uint32Dropped;
+
+/* The attached client, and 1 while its buffer is with the DMA */
+static const AppUartClient_t* volatile Global_pClient;
+static volatile uint8_t  Global_uint8ClientBusy;
+
+
+/*
+ * App_UartStartNext
+ * -----------------
+ * Hands the DMA the queued bytes from Tail up to Head or the end of the
+ * ring, whichever comes first. Called with the DMA idle, from the main loop
+ * with interrupts off or from the completion interrupt. Nothing while a
+ * client has the line.
+ */
+__RAM_FUNC static void App_UartStartNext(void)
+{
+	uint16_t Local_uint16Queued = (uint16_t)(Global_uint16TxHead - Global_uint16TxTail);
+	uint16_t Local_uint16Offset = Global_uint16TxTail & (APP_UART_TX_QUEUE_SIZE - 1u);
+	uint16_t Local_uint16Length = APP_UART_TX_QUEUE_SIZE - Local_uint16Offset;
+
+	if((Local_uint16Queued == 0u) || (Global_pClient != NULL))
+	{
+		return;
+	}
+	if(Local_uint16Length > Local_uint16Queued)
+	{
+		Local_uint16Length = Local_uint16Queued;
+	}
+
+	if(HAL_UART_Transmit_DMA(&huart2, &Global_uint8TxQueue[Local_uint16Offset], Local_uint16Length) == HAL_OK)
+	{
+		Global_uint16TxInFlight = Local_uint16Length;
+	}
+}
+
+
+/*
+ * App_UartSend
+ * ------------
+ * Copies a message behind the queued ones and starts the DMA if it is idle.
+ * Returns 1, or 0 without queuing anything when the ring lacks the room or
+ * a client has the line.
+ */
+uint8_t App_UartSend(const uint8_t* Data, uint16_t Length)
+{
+	uint16_t Local_uint16Offset = Global_uint16TxHead & (APP_UART_TX_QUEUE_SIZE - 1u);
+	uint16_t Local_uint16First  = APP_UART_TX_QUEUE_SIZE - Local_uint16Offset;
+	uint32_t Local_uint32Primask;
+
+	if((Length > App_UartTxFree()) || (Global_pClient != NULL))
+	{
+		Global_uint32Dropped += Length;
+		return 0u;
+	}
+
+	/* Up to the end of the ring, then from its start */
+	if(Local_uint16First > Length)
+	{
+		Local_uint16First = Length;
+	}
+	memcpy(&Global_uint8TxQueue[Local_uint16Offset], Data, Local_uint16First);
+	memcpy(&Global_uint8TxQueue[0], &Data[Local_uint16First], Length - Local_uint16First);
+
+	/* The completion interrupt could otherwise find the DMA idle at the same time */
+	Local_uint32Primask = __get_PRIMASK();
+	__disable_irq();
+	Global_uint16TxHead = (uint16_t)(Global_uint16TxHead + Length);
+	if(Global_uint16TxInFlight == 0u)
+	{
+		App_UartStartNext();
+	}
+	__set_PRIMASK(Local_uint32Primask);
+
+	return 1u;
+}
+
+
+uint16_t App_UartTxFree(void)
+{
+	return (uint16_t)(APP_UART_TX_QUEUE_SIZE - (uint16_t)(Global_uint16TxHead - Global_uint16TxTail));
+}
+
+
+uint8_t App_UartTxIdle(void)
+{
+	return (Global_uint16TxHead == Global_uint16TxTail) ? 1u : 0u;
+}
+
+
+uint32_t App_UartDropped(void)
+{
+	return Global_uint32Dropped;
+}
+
+
+/*
+ * App_UartAttach
+ * --------------
+ * Gives the line to Client. Returns 1 if the DMA is idle, otherwise the
+ * piece in flight ends first and Client->TxDone follows it.
+ */
+uint8_t App_UartAttach(const AppUartClient_t* Client)
+{
+	uint8_t  Local_uint8Idle;
+	uint32_t Local_uint32Primask = __get_PRIMASK();
+
+	__disable_irq();
+	Global_pClient  = Client;
+	Local_uint8Idle = (Global_uint16TxInFlight == 0u) ? 1u : 0u;
+	__set_PRIMASK(Local_uint32Primask);
+
+	return Local_uint8Idle;
+}
+
+
+/* With the client's last buffer sent: the queue goes on where it stopped */
+void App_UartDetach(void)
+{
+	uint32_t Local_uint32Primask = __get_PRIMASK();
+
+	__disable_irq();
+	Global_pClient = NULL;
+	if((Global_uint16TxInFlight == 0u) && (Global_uint8ClientBusy == 0u))
+	{
+		App_UartStartNext();
+	}
+	__set_PRIMASK(Local_uint32Primask);
+}
+
+
+/*
+ * App_UartTransmit
+ * ----------------
+ * Attached client only, with the line free: the DMA sends Data in place,
+ * which must stay untouched until the client's TxDone. Returns 1 if started.
+ */
+__RAM_FUNC uint8_t App_UartTransmit(const uint8_t* Data, uint16_t Length)
+{
+	if((Global_pClient == NULL) || (Global_uint8ClientBusy != 0u) || (Global_uint16TxInFlight != 0u))
+	{
+		return 0u;
+	}
+
+	if(HAL_UART_Transmit_DMA(&huart2, (uint8_t*)Data, Length) != HAL_OK)
+	{
+		return 0u;
+	}
+
+	Global_uint8ClientBusy = 1u;
+	return 1u;
+}
+
+
+/*
+ * _write
+ * ------
+ * stdio output. stdout / stderr go to the ring in pieces of at most its size;
+ * from the first piece that does not fit, the rest is dropped (and counted
+ * by App_UartSend), and all of it is still reported written so the C library
+ * does not retry in a loop.
+ */
+int _write(int file, char *ptr, int len)
+{
+	uint16_t Local_uint16Piece;
+	int      Local_intLeft = len;
+
+	if((file != 1) && (file != 2))
+	{
+		errno = EBADF;
+		return -1;
+	}
+
+	while(Local_intLeft > 0)
+	{
+		Local_uint16Piece = (Local_intLeft > (int)APP_UART_TX_QUEUE_SIZE) ? APP_UART_TX_QUEUE_SIZE : (uint16_t)Local_intLeft;
+
+		if(App_UartSend((const uint8_t*)ptr, Local_uint16Piece) == 0u)
+		{
+			Global_uint32Dropped += (uint32_t)(Local_intLeft - Local_uint16Piece);
+			break;
+		}
+
+		ptr           += Local_uint16Piece;
+		Local_intLeft -= Local_uint16Piece;
+	}
+
+	return len;
+}
+
+
+/*
+ * HAL_UART_TxCpltCallback
+ * -----------------------
+ * Last byte of a piece shifted out: release it and send what came meanwhile,
+ * or tell the client the line is free.
+ */
+__RAM_FUNC void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart)
+{
+	const AppUartClient_t* Local_pClient = Global_pClient;
+
+	if(huart->Instance != USART2)
+	{
+		return;
+	}
+
+	if(Global_uint8ClientBusy != 0u)
+	{
+		Global_uint8ClientBusy = 0u;
+	}
+	else
+	{
+		Global_uint16TxTail     = (uint16_t)(Global_uint16TxTail + Global_uint16TxInFlight);
+		Global_uint16TxInFlight = 0u;
+	}
+	App_UartStartNext();
+
+	if(Local_pClient != NULL)
+	{
+		Local_pClient->TxDone();
+	}
+}
+
+
+/*
+ * HAL_UART_ErrorCallback
+ * ----------------------
+ * The HAL aborts the transfer on an error: drop the piece, carry on with the
+ * rest. A receive error goes to the client, or without one to App_Ota.c,
+ * the receiver's owner between sessions.
+ */
+__RAM_FUNC void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart)
+{
+	const AppUartClient_t* Local_pClient = Global_pClient;
+
+	if(huart->Instance != USART2)
+	{
+		return;
+	}
+
+	if(huart->gState == HAL_UART_STATE_READY)
+	{
+		if((Global_uint8ClientBusy != 0u) || (Global_uint16TxInFlight != 0u))
+		{
+			Global_uint16TxTail     = (uint16_t)(Global_uint16TxTail + Global_uint16TxInFlight);
+			Global_uint16TxInFlight = 0u;
+			Global_uint8ClientBusy  = 0u;
+			App_UartStartNext();
+
+			if(Local_pClient != NULL)
+			{
+				Local_pClient->TxDone();
+			}
+		}
+	}
+
+	if(huart->RxState == HAL_UART_STATE_READY)
+	{
+		if(Local_pClient != NULL)
+		{
+			Local_pClient->Error();
+		}
+		else
+		{
+			App_OtaRxError();
+		}
+	}
+}
@@ -0,0 +1,637 @@
+#include <string.h>
+#include "main.h"
+#include "App_Update.h"
+#include "App_Msc.h"
+#include "App_Fat.h"
+#include "App_Image.h"
+#include "App_Uart.h"
+#include "App_Ota.h"
+#include "App_Scheduler.h"
+
+#define UPDATE_CHUNK_SIZE            (APP_UPDATE_CHUNK_BLOCKS * APP_MSC_BLOCK_SIZE)
+
+/* STM32F407xG sectors: 4 x 16 KB, 64 KB, 7 x 128 KB */
+#define UPDATE_FLASH_SECTORS         12u
+
+/* Global_Update.State */
+#define UPDATE_STATE_IDLE            0u        /* No drive, or waiting for it */
+#define UPDATE_STATE_MBR             1u        /* Sector 0 read */
+#define UPDATE_STATE_BOOT            2u        /* Boot sector read */
+#define UPDATE_STATE_DIR             3u        /* Root directory scan */
+#define UPDATE_STATE_FILE            4u        /* Streaming the file into the slot */
+#define UPDATE_STATE_RESET           5u        /* Activated, reset pending */
+#define UPDATE_STATE_DONE            6u        /* Nothing (more) to do with this drive */
+
+/* uint8_UpdateNextRun */
+#define UPDATE_RUN_DATA              0u
+#define UPDATE_RUN_FAT               1u        /* The FAT sector at Lba is needed first */
+#define UPDATE_RUN_END               2u
+
+#define UPDATE_NO_SECTOR             0xFFFFFFFFUL
+
+/* Position in a cluster chain: Sector counts the sectors of Cluster already taken */
+typedef struct
+{
+	uint32_t Cluster;
+	uint32_t Sector;
+} AppUpdateCursor_t;
+
+typedef struct
+{
+	uint8_t  State;
+	uint8_t  Reading;                           /* App_MscRead in flight */
+	uint8_t  ReadFat;                           /* ... into FatSector rather than a buffer */
+	uint8_t  Fill;                              /* Buffer the next data read goes to */
+	uint8_t  Program;                           /* Buffer being programmed */
+	uint8_t  Checked;                           /* Header of the first chunk accepted */
+
+	AppFat_t Fat;
+	uint32_t FatLba;                            /* Sector in FatSector, UPDATE_NO_SECTOR: none */
+	AppUpdateCursor_t Cursor;                   /* Directory (FAT32) or file chain */
+	uint32_t DirLba;                            /* FAT16 root directory: next sector, sectors left */
+	uint32_t DirLeft;
+
+	char     Name[12];
+	uint32_t SlotBase;
+	uint32_t SlotEnd;
+	uint32_t Size;                              /* File bytes */
+	uint32_t Requested;                         /* File bytes asked of the drive so far */
+	uint32_t ReadBlocks;                        /* Of the read in flight */
+	uint32_t ErasedEnd;                         /* Flash from SlotBase up to here is blank */
+
+	uint32_t Length[2];                         /* Bytes to program of each buffer, 0: free */
+	uint32_t Address[2];
+	uint32_t Offset;                            /* Already programmed of Buffer[Program] */
+} AppUpdate_t;
+
+static AppUpdate_t Global_Update;
+
+static uint8_t Global_uint8Buffer[2][UPDATE_CHUNK_SIZE] __attribute__((aligned(4))) APP_RAM_BUDGET("staging");
+static uint8_t Global_uint8FatSector[APP_FAT_SECTOR_SIZE] __attribute__((aligned(4))) APP_RAM_BUDGET("staging");
+
+
+static void App_UpdateReport(const char* Message)
+{
+	(void)App_UartSend((const uint8_t*)Message, (uint16_t)strlen(Message));
+}
+
+
+static uint32_t App_UpdateSectorBase(uint8_t Sector)
+{
+	if(Sector < 4u)
+	{
+		return FLASH_BASE + ((uint32_t)Sector * 0x4000UL);
+	}
+	else if(Sector == 4u)
+	{
+		return FLASH_BASE + 0x10000UL;
+	}
+
+	return FLASH_BASE + 0x20000UL + ((uint32_t)(Sector - 5u) * 0x20000UL);
+}
+
+
+static uint8_t App_UpdateSectorOf(uint32_t Address)
+{
+	uint8_t Local_uint8Sector = UPDATE_FLASH_SECTORS - 1u;
+
+	while((Local_uint8Sector != 0u) && (App_UpdateSectorBase(Local_uint8Sector) > Address))
+	{
+		Local_uint8Sector--;
+	}
+
+	return Local_uint8Sector;
+}
+
+
+/*
+ * App_UpdateFail
+ * --------------
+ * Ends the update for this drive. The slot is left as far as it got: it is
+ * not activated, and the next try erases it again.
+ */
+static void App_UpdateFail(const char* Message)
+{
+	if(Global_Update.State == UPDATE_STATE_FILE)
+	{
+		APP_SERVICES->FlashLock();
+	}
+
+	Global_Update.State = UPDATE_STATE_DONE;
+	App_UpdateReport(Message);
+}
+
+
+/* Starts a read; a drive that refuses it ends the update */
+static void App_UpdateRead(uint32_t Lba, uint32_t Blocks, uint8_t* Buffer, uint8_t Fat)
+{
+	if(App_MscRead(Lba, (uint16_t)Blocks, Buffer) == APP_MSC_OK)
+	{
+		Global_Update.Reading    = 1;
+		Global_Update.ReadFat    = Fat;
+		Global_Update.ReadBlocks = Blocks;
+	}
+	else
+	{
+		App_UpdateFail("USB update: drive not ready\r\n");
+	}
+}
+
+
+/*
+ * uint8_UpdateNextRun
+ * -------------------
+ * The next sectors of a cluster chain, up to Max of them, as long as the
+ * clusters follow each other on the drive. At a cluster end the FAT sector
+ * with its entry must be in Global_uint8FatSector: UPDATE_RUN_FAT asks for
+ * it when it is not (only before anything of the run is taken).
+ */
+static uint8_t uint8_UpdateNextRun(AppUpdateCursor_t* Cursor, uint32_t Max, uint32_t* Lba, uint32_t* Count)
+{
+	const AppFat_t* Local_pFat = &Global_Update.Fat;
+	uint32_t Local_uint32Next;
+	uint32_t Local_uint32Take;
+
+	*Count = 0u;
+
+	while(*Count < Max)
+	{
+		if(Cursor->Sector == Local_pFat->SectorsPerCluster)
+		{
+			if(App_FatEntryLba(Local_pFat, Cursor->Cluster) != Global_Update.FatLba)
+			{
+				if(*Count == 0u)
+				{
+					*Lba = App_FatEntryLba(Local_pFat, Cursor->Cluster);
+					return UPDATE_RUN_FAT;
+				}
+				break;
+			}
+
+			Local_uint32Next = App_FatNextCluster(Local_pFat, Global_uint8FatSector, Cursor->Cluster);
+			if(Local_uint32Next == APP_FAT_CHAIN_END)
+			{
+				if(*Count == 0u)
+				{
+					return UPDATE_RUN_END;
+				}
+				break;
+			}
+			if((*Count != 0u) && (Local_uint32Next != (Cursor->Cluster + 1u)))
+			{
+				break;
+			}
+
+			Cursor->Cluster = Local_uint32Next;
+			Cursor->Sector  = 0u;
+		}
+
+		if(*Count == 0u)
+		{
+			*Lba = App_FatClusterLba(Local_pFat, Cursor->Cluster) + Cursor->Sector;
+		}
+
+		Local_uint32Take = Local_pFat->SectorsPerCluster - Cursor->Sector;
+		if(Local_uint32Take > (Max - *Count))
+		{
+			Local_uint32Take = Max - *Count;
+		}
+
+		Cursor->Sector += Local_uint32Take;
+		*Count         += Local_uint32Take;
+	}
+
+	return UPDATE_RUN_DATA;
+}
+
+
+/* Next root directory sector, or the end of the directory */
+static void App_UpdateReadDir(void)
+{
+	uint32_t Local_uint32Lba;
+	uint32_t Local_uint32Count;
+	uint8_t  Local_uint8Run = UPDATE_RUN_END;
+
+	if(Global_Update.Fat.Type == APP_FAT_16)
+	{
+		if(Global_Update.DirLeft != 0u)
+		{
+			Local_uint32Lba = Global_Update.DirLba++;
+			Global_Update.DirLeft--;
+			Local_uint8Run = UPDATE_RUN_DATA;
+		}
+	}
+	else
+	{
+		Local_uint8Run = uint8_UpdateNextRun(&Global_Update.Cursor, 1u, &Local_uint32Lba, &Local_uint32Count);
+	}
+
+	if(Local_uint8Run == UPDATE_RUN_END)
+	{
+		App_UpdateFail("USB update: no image for the inactive slot\r\n");
+	}
+	else
+	{
+		App_UpdateRead(Local_uint32Lba, 1u, (Local_uint8Run == UPDATE_RUN_FAT) ? Global_uint8FatSector : Global_uint8Buffer[0],
+		               (Local_uint8Run == UPDATE_RUN_FAT) ? 1u : 0u);
+	}
+}
+
+
+/*
+ * App_UpdateReadNext
+ * ------------------
+ * Keeps the drive busy: the next chunk of the file into the free buffer, or
+ * the FAT sector the chain needs first. Nothing while a read runs, the
+ * buffer is still to be programmed or the whole file was asked for.
+ */
+static void App_UpdateReadNext(void)
+{
+	uint32_t Local_uint32Left = (Global_Update.Size - Global_Update.Requested + (APP_MSC_BLOCK_SIZE - 1u)) / APP_MSC_BLOCK_SIZE;
+	uint32_t Local_uint32Lba;
+	uint32_t Local_uint32Count;
+	uint8_t  Local_uint8Run;
+
+	if((Global_Update.State != UPDATE_STATE_FILE) || (Global_Update.Reading != 0u) || (Local_uint32Left == 0u) ||
+	   (Global_Update.Length[Global_Update.Fill] != 0u) || ((Global_Update.Requested != 0u) && (Global_Update.Checked == 0u)))
+	{
+		return;
+	}
+
+	Local_uint8Run = uint8_UpdateNextRun(&Global_Update.Cursor, (Local_uint32Left < APP_UPDATE_CHUNK_BLOCKS) ? Local_uint32Left : APP_UPDATE_CHUNK_BLOCKS,
+	                                     &Local_uint32Lba, &Local_uint32Count);
+
+	if(Local_uint8Run == UPDATE_RUN_END)
+	{
+		App_UpdateFail("USB update: file shorter than its size\r\n");
+	}
+	else if(Local_uint8Run == UPDATE_RUN_FAT)
+	{
+		App_UpdateRead(Local_uint32Lba, 1u, Global_uint8FatSector, 1u);
+	}
+	else
+	{
+		App_UpdateRead(Local_uint32Lba, Local_uint32Count, Global_uint8Buffer[Global_Update.Fill], 0u);
+	}
+}
+
+
+/*
+ * uint8_UpdateCheckHeader
+ * -----------------------
+ * The first chunk: a header at the slot's header offset, a version above the
+ * running one and an end address that is exactly the file's end in the slot
+ * (a file built for the other slot or padded otherwise does not match).
+ */
+static uint8_t uint8_UpdateCheckHeader(const uint8_t* Chunk, uint32_t Length)
+{
+	AppHeader_t Local_Header;
+
+	if(Length < (APP_HEADER_OFFSET + sizeof(AppHeader_t)))
+	{
+		return 0u;
+	}
+
+	memcpy(&Local_Header, &Chunk[APP_HEADER_OFFSET], sizeof(Local_Header));
+
+	return (uint8_t)((Local_Header.Magic == APP_HEADER_MAGIC) && (Local_Header.Version > App_Header.Version) &&
+	                 ((uint32_t)Local_Header.EndAddress == (Global_Update.SlotBase + Global_Update.Size)));
+}
+
+
+/*
+ * App_UpdateStart
+ * ---------------
+ * The drive is ready: only with an inactive A/B slot to write, a running
+ * image that is validated (on trial, the other slot is the way back), a
+ * bootloader that can activate it and no USART2 update on the slot
+ * (App_Ota.h). Then sector 0 is read.
+ */
+static void App_UpdateStart(void)
+{
+	uint8_t Local_uint8First;
+	uint8_t Local_uint8Count;
+
+	memset(&Global_Update, 0, sizeof(Global_Update));
+	Global_Update.FatLba = UPDATE_NO_SECTOR;
+	Global_Update.State  = UPDATE_STATE_DONE;
+
+	if((APP_SERVICES->Magic != APP_SERVICES_MAGIC) || (APP_SERVICES->Version < APP_SERVICES_VERSION_ACTIVATE) ||
+	   (APP_SERVICES->ImageIsValidated() == 0u) || (App_OtaBusy() != 0u) ||
+	   (APP_SERVICES->InactiveSectors(&Local_uint8First, &Local_uint8Count) != HAL_OK) ||
+	   ((Local_uint8First + Local_uint8Count) > UPDATE_FLASH_SECTORS))
+	{
+		App_UpdateReport("USB update: not available with this bootloader or image\r\n");
+		return;
+	}
+
+	Global_Update.SlotBase = App_UpdateSectorBase(Local_uint8First);
+	Global_Update.SlotEnd  = (Local_uint8First + Local_uint8Count < UPDATE_FLASH_SECTORS) ?
+	                         App_UpdateSectorBase(Local_uint8First + Local_uint8Count) : (FLASH_END + 1u);
+	memcpy(Global_Update.Name, "APP_A   BIN", sizeof(Global_Update.Name));
+	if(Global_Update.SlotBase != 0x08008000UL)
+	{
+		Global_Update.Name[4] = 'B';
+	}
+
+	Global_Update.State = UPDATE_STATE_MBR;
+	App_UpdateRead(0u, 1u, Global_uint8Buffer[0], 0u);
+}
+
+
+/*
+ * App_UpdateDataDone
+ * ------------------
+ * A chunk of the file arrived in Buffer[Fill]: the bytes beyond the file end
+ * up to a whole word read as erased flash. The first chunk must pass the
+ * header check before anything is erased or programmed.
+ */
+static void App_UpdateDataDone(void)
+{
+	uint8_t* Local_puint8Chunk  = Global_uint8Buffer[Global_Update.Fill];
+	uint32_t Local_uint32Length = Global_Update.ReadBlocks * APP_MSC_BLOCK_SIZE;
+
+	if(Local_uint32Length > (Global_Update.Size - Global_Update.Requested))
+	{
+		Local_uint32Length = Global_Update.Size - Global_Update.Requested;
+		memset(&Local_puint8Chunk[Local_uint32Length], 0xFF, 3u);
+		Local_uint32Length = (Local_uint32Length + 3u) & ~3UL;
+	}
+
+	if((Global_Update.Requested == 0u) && (uint8_UpdateCheckHeader(Local_puint8Chunk, Local_uint32Length) == 0u))
+	{
+		App_UpdateFail("USB update: image not newer, or not built for the inactive slot\r\n");
+		return;
+	}
+
+	if(Global_Update.Checked == 0u)
+	{
+		if(APP_SERVICES->FlashUnlock() != HAL_OK)
+		{
+			App_UpdateFail("USB update: flash locked\r\n");
+			return;
+		}
+		Global_Update.Checked   = 1;
+		Global_Update.ErasedEnd = Global_Update.SlotBase;
+		App_UpdateReport("USB update: programming the inactive slot\r\n");
+	}
+
+	Global_Update.Address[Global_Update.Fill] = Global_Update.SlotBase + Global_Update.Requested;
+	Global_Update.Length[Global_Update.Fill]  = Local_uint32Length;
+	Global_Update.Requested += Global_Update.ReadBlocks * APP_MSC_BLOCK_SIZE;
+	if(Global_Update.Requested > Global_Update.Size)
+	{
+		Global_Update.Requested = Global_Update.Size;
+	}
+	Global_Update.Fill ^= 1u;
+
+	App_UpdateReadNext();
+	App_SchedSignal(APP_TASK_UPDATE, APP_EVENT_UPDATE_PROGRAM);
+}
+
+
+/*
+ * App_UpdateReadDone
+ * ------------------
+ * One App_MscRead finished: the next step of the state.
+ */
+static void App_UpdateReadDone(void)
+{
+	uint32_t Local_uint32Lba;
+	uint32_t Local_uint32Cluster;
+	uint8_t  Local_uint8Found;
+
+	Global_Update.Reading = 0;
+
+	if(App_MscResult() != APP_MSC_OK)
+	{
+		App_UpdateFail("USB update: read error\r\n");
+		return;
+	}
+
+	if(Global_Update.ReadFat != 0u)
+	{
+		/* The FAT sector a chain needed: go on where it stopped */
+		Global_Update.FatLba = App_FatEntryLba(&Global_Update.Fat, Global_Update.Cursor.Cluster);
+		if(Global_Update.State == UPDATE_STATE_DIR)
+		{
+			App_UpdateReadDir();
+		}
+		else
+		{
+			App_UpdateReadNext();
+		}
+		return;
+	}
+
+	switch(Global_Update.State)
+	{
+	case UPDATE_STATE_MBR:
+		if(App_FatVolumeLba(Global_uint8Buffer[0], &Local_uint32Lba) == 0u)
+		{
+			App_UpdateFail("USB update: no FAT partition\r\n");
+		}
+		else
+		{
+			Global_Update.DirLba = Local_uint32Lba;   /* Boot sector, until mounted */
+			Global_Update.State  = UPDATE_STATE_BOOT;
+			App_UpdateRead(Local_uint32Lba, 1u, Global_uint8Buffer[0], 0u);
+		}
+		break;
+
+	case UPDATE_STATE_BOOT:
+		if(App_FatMount(&Global_Update.Fat, Global_uint8Buffer[0], Global_Update.DirLba) == 0u)
+		{
+			App_UpdateFail("USB update: no FAT16 / FAT32 volume\r\n");
+		}
+		else
+		{
+			Global_Update.DirLba         = Global_Update.Fat.RootLba;
+			Global_Update.DirLeft        = Global_Update.Fat.RootSectors;
+			Global_Update.Cursor.Cluster = Global_Update.Fat.RootCluster;
+			Global_Update.Cursor.Sector  = 0u;
+			Global_Update.State          = UPDATE_STATE_DIR;
+			App_UpdateReadDir();
+		}
+		break;
+
+	case UPDATE_STATE_DIR:
+		Local_uint8Found = App_FatFindFile(Global_uint8Buffer[0], Global_Update.Name, &Local_uint32Cluster, &Global_Update.Size);
+		if(Local_uint8Found == APP_FAT_NOT_HERE)
+		{
+			App_UpdateReadDir();
+		}
+		else if(Local_uint8Found == APP_FAT_END)
+		{
+			App_UpdateFail("USB update: no image for the inactive slot\r\n");
+		}
+		else if((Global_Update.Size == 0u) || (Global_Update.Size > (Global_Update.SlotEnd - Global_Update.SlotBase)) ||
+		        (Local_uint32Cluster < 2u))
+		{
+			App_UpdateFail("USB update: image does not fit the inactive slot\r\n");
+		}
+		else
+		{
+			Global_Update.Cursor.Cluster = Local_uint32Cluster;
+			Global_Update.Cursor.Sector  = 0u;
+			Global_Update.State          = UPDATE_STATE_FILE;
+			App_UpdateReadNext();
+		}
+		break;
+
+	case UPDATE_STATE_FILE:
+		App_UpdateDataDone();
+		break;
+
+	default:
+		break;
+	}
+}
+
+
+/*
+ * App_UpdateFinish
+ * ----------------
+ * Everything programmed: the bootloader checks the slot's CRC (CPU-fed, the
+ * CRC clock is ours to enable) and activates it, then a reset starts it.
+ */
+static void App_UpdateFinish(void)
+{
+	APP_SERVICES->FlashLock();
+
+	__HAL_RCC_CRC_CLK_ENABLE();
+	if(APP_SERVICES->ImageActivateUpdate() != HAL_OK)
+	{
+		Global_Update.State = UPDATE_STATE_DONE;
+		App_UpdateReport("USB update: image check failed, not activated\r\n");
+		return;
+	}
+
+	Global_Update.State = UPDATE_STATE_RESET;
+	App_UpdateReport("USB update: activated, restarting\r\n");
+	App_SchedTimerStart(APP_TIMER_UPDATE_RESET, APP_TASK_UPDATE, APP_EVENT_UPDATE_RESET, APP_UPDATE_RESET_DELAY_MS, 0u);
+}
+
+
+/*
+ * App_UpdateProgramSlice
+ * ----------------------
+ * One step of the programming side, then the task gives way: either the
+ * next sector the data reaches is made blank (blank check, erase only when
+ * needed), or up to APP_UPDATE_SLICE bytes of Buffer[Program] are
+ * programmed. A finished buffer goes back to the reading side.
+ */
+static void App_UpdateProgramSlice(void)
+{
+	uint8_t  Local_uint8Program = Global_Update.Program;
+	uint32_t Local_uint32Address = Global_Update.Address[Local_uint8Program] + Global_Update.Offset;
+	uint32_t Local_uint32Length  = Global_Update.Length[Local_uint8Program] - Global_Update.Offset;
+	uint8_t  Local_uint8Sector;
+
+	if((Global_Update.State != UPDATE_STATE_FILE) || (Global_Update.Length[Local_uint8Program] == 0u))
+	{
+		return;
+	}
+
+	if(Local_uint32Address >= Global_Update.ErasedEnd)
+	{
+		Local_uint8Sector = App_UpdateSectorOf(Local_uint32Address);
+
+		if((APP_SERVICES->FlashSectorIsBlank(Local_uint8Sector) == 0u) && (APP_SERVICES->FlashEraseSector(Local_uint8Sector) != HAL_OK))
+		{
+			App_UpdateFail("USB update: erase failed\r\n");
+			return;
+		}
+
+		Global_Update.ErasedEnd = (Local_uint8Sector + 1u < UPDATE_FLASH_SECTORS) ? App_UpdateSectorBase(Local_uint8Sector + 1u) : (FLASH_END + 1u);
+		App_SchedSignal(APP_TASK_UPDATE, APP_EVENT_UPDATE_PROGRAM);
+		return;
+	}
+
+	if(Local_uint32Length > APP_UPDATE_SLICE)
+	{
+		Local_uint32Length = APP_UPDATE_SLICE;
+	}
+	if(Local_uint32Length > (Global_Update.ErasedEnd - Local_uint32Address))
+	{
+		Local_uint32Length = Global_Update.ErasedEnd - Local_uint32Address;
+	}
+
+	if(APP_SERVICES->FlashProgram(Local_uint32Address, &Global_uint8Buffer[Local_uint8Program][Global_Update.Offset], Local_uint32Length) != HAL_OK)
+	{
+		App_UpdateFail("USB update: program failed\r\n");
+		return;
+	}
+
+	Global_Update.Offset += Local_uint32Length;
+
+	if(Global_Update.Offset == Global_Update.Length[Local_uint8Program])
+	{
+		Global_Update.Length[Local_uint8Program] = 0u;
+		Global_Update.Offset  = 0u;
+		Global_Update.Program ^= 1u;
+
+		if((Global_Update.Requested == Global_Update.Size) && (Global_Update.Reading == 0u) &&
+		   (Global_Update.Length[Global_Update.Program] == 0u))
+		{
+			App_UpdateFinish();
+			return;
+		}
+
+		App_UpdateReadNext();
+	}
+
+	if(Global_Update.Length[Global_Update.Program] != 0u)
+	{
+		App_SchedSignal(APP_TASK_UPDATE, APP_EVENT_UPDATE_PROGRAM);
+	}
+}
+
+
+/*
+ * App_UpdateTask
+ * --------------
+ * Drive events from App_Msc.c, its own programming slices and the reset
+ * timer. Unplugging in the middle leaves the slot unactivated.
+ */
+void App_UpdateTask(uint32_t Events)
+{
+	if((Events & APP_EVENT_MSC_GONE) != 0u)
+	{
+		if(Global_Update.State == UPDATE_STATE_FILE)
+		{
+			App_UpdateFail("USB update: drive removed\r\n");
+		}
+		if(Global_Update.State != UPDATE_STATE_RESET)
+		{
+			Global_Update.State = UPDATE_STATE_IDLE;
+		}
+		return;
+	}
+
+	if(((Events & APP_EVENT_MSC_READY) != 0u) && (Global_Update.State == UPDATE_STATE_IDLE))
+	{
+		App_UpdateStart();
+	}
+
+	if(((Events & APP_EVENT_MSC_DONE) != 0u) && (Global_Update.Reading != 0u))
+	{
+		App_UpdateReadDone();
+	}
+
+	if((Events & APP_EVENT_UPDATE_PROGRAM) != 0u)
+	{
+		App_UpdateProgramSlice();
+	}
+
+	if(((Events & APP_EVENT_UPDATE_RESET) != 0u) && (Global_Update.State == UPDATE_STATE_RESET))
+	{
+		NVIC_SystemReset();
+	}
+}
+
+
+uint8_t App_UpdateBusy(void)
+{
+	return (Global_Update.State == UPDATE_STATE_FILE) ? 1u : 0u;
+}
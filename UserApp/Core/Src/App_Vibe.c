@@ -0,0 +1,439 @@
+#include "main.h"
+#include "App_Vibe.h"
+#include "App_Telemetry.h"
+
+/* Two packed int16_t, the first in the low half; may alias the arrays it is read from */
+typedef uint32_t VibePair_t __attribute__((may_alias));
+
+#define VIBE_AXES                    3u
+#define VIBE_DECIMATION              2u        /* Even: the window moves by whole words */
+#define VIBE_TAPS                    16u
+#define VIBE_DRAIN_CHUNK             16u       /* Samples per App_AccelRead */
+#define VIBE_ODR_DECI_HZ             4000u     /* 400 Hz in 0.1 Hz */
+
+#define VIBE_FFT_ANGLES              256u      /* Full turn of the sine table */
+#define VIBE_FFT_HEADROOM            16384     /* Input below 0.5: no butterfly overflows */
+
+/* Windowed sinc, fc 80 Hz at 400 Hz, Hamming; sum 32768 (unity at DC) */
+static const int16_t Global_int16Taps[VIBE_TAPS] __attribute__((aligned(4))) =
+{
+	0, 183, 259, -541, -1665, 0, 6025, 12123, 12123, 6025, 0, -1665, -541, 259, 183, 0
+};
+
+#if (APP_VIBE_FFT_ENABLE != 0u)
+/* sin(2 pi i / VIBE_FFT_ANGLES), Q15, a quarter turn */
+static const int16_t Global_int16Sine[(VIBE_FFT_ANGLES / 4u) + 1u] =
+{
+	    0,   804,  1608,  2410,  3212,  4011,  4808,  5602,  6393,  7179,  7962,  8739,  9512, 10278, 11039, 11793,
+	12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530, 18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+	23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790, 27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+	30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971, 32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+	32767
+};
+#endif
+
+typedef struct
+{
+	int16_t  History[2u * VIBE_TAPS] __attribute__((aligned(4)));   /* Each sample twice, VIBE_TAPS apart */
+#if (APP_VIBE_FFT_ENABLE != 0u)
+	int16_t  Block[APP_VIBE_BLOCK_SIZE];      /* Decimated samples of the block */
+#endif
+	int32_t  Sum;
+	uint64_t SumSquares;
+	int16_t  Min;
+	int16_t  Max;
+	uint8_t  Position;                         /* Next History slot, oldest sample of the window */
+} VibeAxis_t;
+
+static VibeAxis_t     Global_Axes[VIBE_AXES] APP_CCMRAM;
+#if (APP_VIBE_FFT_ENABLE != 0u)
+static VibePair_t     Global_Fft[APP_VIBE_BLOCK_SIZE] APP_CCMRAM;
+#endif
+static AppVibeAxis_t  Global_Last[VIBE_AXES];
+static AppVibeStats_t Global_Stats;
+static uint32_t       Global_uint32Cycles;     /* Task runs since the last block ended */
+static uint16_t       Global_uint16Count;      /* Decimated samples in the block */
+static uint8_t        Global_uint8Phase;       /* Inputs since the last output */
+
+
+static uint32_t App_VibeSqrt(uint64_t Value)
+{
+	uint64_t Local_uint64Bit  = 1ULL << 62;
+	uint64_t Local_uint64Root = 0u;
+
+	while(Local_uint64Bit > Value)
+	{
+		Local_uint64Bit >>= 2;
+	}
+
+	while(Local_uint64Bit != 0u)
+	{
+		if(Value >= (Local_uint64Root + Local_uint64Bit))
+		{
+			Value            -= Local_uint64Root + Local_uint64Bit;
+			Local_uint64Root  = (Local_uint64Root >> 1) + Local_uint64Bit;
+		}
+		else
+		{
+			Local_uint64Root >>= 1;
+		}
+		Local_uint64Bit >>= 2;
+	}
+
+	return (uint32_t)Local_uint64Root;
+}
+
+
+static void App_VibeResetBlock(void)
+{
+	uint8_t Local_uint8Axis;
+
+	for(Local_uint8Axis = 0; Local_uint8Axis < VIBE_AXES; Local_uint8Axis++)
+	{
+		Global_Axes[Local_uint8Axis].Sum        = 0;
+		Global_Axes[Local_uint8Axis].SumSquares = 0u;
+		Global_Axes[Local_uint8Axis].Min        = INT16_MAX;
+		Global_Axes[Local_uint8Axis].Max        = INT16_MIN;
+	}
+
+	Global_uint16Count = 0u;
+}
+
+
+/*
+ * App_VibeFilter
+ * --------------
+ * One FIR output from the window History[Position .. Position + 15]: the
+ * taps are symmetric, so the window's order does not matter.
+ */
+static int16_t App_VibeFilter(const VibeAxis_t* Axis)
+{
+	const VibePair_t* Local_pWindow = (const VibePair_t*)&Axis->History[Axis->Position];
+	const VibePair_t* Local_pTaps   = (const VibePair_t*)Global_int16Taps;
+	int32_t  Local_int32Acc         = 1 << 14;
+	uint32_t Local_uint32Index;
+
+	for(Local_uint32Index = 0; Local_uint32Index < (VIBE_TAPS / 2u); Local_uint32Index++)
+	{
+		Local_int32Acc = __SMLAD(Local_pWindow[Local_uint32Index], Local_pTaps[Local_uint32Index], Local_int32Acc);
+	}
+
+	return (int16_t)__SSAT(Local_int32Acc >> 15, 16);
+}
+
+
+#if (APP_VIBE_FFT_ENABLE != 0u)
+/* (cos, -sin) of Angle / VIBE_FFT_ANGLES turns, Angle below half a turn */
+static uint32_t App_VibeTwiddle(uint32_t Angle)
+{
+	int32_t Local_int32Sin;
+	int32_t Local_int32Cos;
+
+	if(Angle <= (VIBE_FFT_ANGLES / 4u))
+	{
+		Local_int32Sin = Global_int16Sine[Angle];
+		Local_int32Cos = Global_int16Sine[(VIBE_FFT_ANGLES / 4u) - Angle];
+	}
+	else
+	{
+		Local_int32Sin = Global_int16Sine[(VIBE_FFT_ANGLES / 2u) - Angle];
+		Local_int32Cos = -Global_int16Sine[Angle - (VIBE_FFT_ANGLES / 4u)];
+	}
+
+	return __PKHBT((uint32_t)Local_int32Cos, (uint32_t)-Local_int32Sin, 16);
+}
+
+
+/*
+ * App_VibeFft
+ * -----------
+ * In place on Global_Fft, decimation in time, every stage halved like
+ * arm_cfft_q15: the result is the DFT / APP_VIBE_BLOCK_SIZE.
+ */
+static void App_VibeFft(void)
+{
+	uint32_t Local_uint32Index;
+	uint32_t Local_uint32Reverse = 0u;
+	uint32_t Local_uint32Bit;
+	uint32_t Local_uint32Span;
+	uint32_t Local_uint32Step;
+	uint32_t Local_uint32Twiddle;
+	uint32_t Local_uint32Odd;
+	uint32_t Local_uint32Product;
+	VibePair_t Local_Swap;
+
+	for(Local_uint32Index = 0; Local_uint32Index < APP_VIBE_BLOCK_SIZE; Local_uint32Index++)
+	{
+		if(Local_uint32Index < Local_uint32Reverse)
+		{
+			Local_Swap                        = Global_Fft[Local_uint32Index];
+			Global_Fft[Local_uint32Index]     = Global_Fft[Local_uint32Reverse];
+			Global_Fft[Local_uint32Reverse]   = Local_Swap;
+		}
+
+		Local_uint32Bit = APP_VIBE_BLOCK_SIZE >> 1;
+		while((Local_uint32Reverse & Local_uint32Bit) != 0u)
+		{
+			Local_uint32Reverse ^= Local_uint32Bit;
+			Local_uint32Bit    >>= 1;
+		}
+		Local_uint32Reverse |= Local_uint32Bit;
+	}
+
+	for(Local_uint32Span = 1u; Local_uint32Span < APP_VIBE_BLOCK_SIZE; Local_uint32Span <<= 1)
+	{
+		for(Local_uint32Step = 0; Local_uint32Step < Local_uint32Span; Local_uint32Step++)
+		{
+			Local_uint32Twiddle = App_VibeTwiddle(Local_uint32Step * (VIBE_FFT_ANGLES / (2u * Local_uint32Span)));
+
+			for(Local_uint32Index = Local_uint32Step; Local_uint32Index < APP_VIBE_BLOCK_SIZE; Local_uint32Index += 2u * Local_uint32Span)
+			{
+				Local_uint32Odd     = Global_Fft[Local_uint32Index + Local_uint32Span];
+				Local_uint32Product = __PKHBT((uint32_t)((int32_t)__SMUSD(Local_uint32Odd, Local_uint32Twiddle) >> 15),
+				                              (uint32_t)((int32_t)__SMUADX(Local_uint32Odd, Local_uint32Twiddle) >> 15), 16);
+
+				Global_Fft[Local_uint32Index + Local_uint32Span] = __SHSUB16(Global_Fft[Local_uint32Index], Local_uint32Product);
+				Global_Fft[Local_uint32Index]                    = __SHADD16(Global_Fft[Local_uint32Index], Local_uint32Product);
+			}
+		}
+	}
+}
+
+
+/*
+ * App_VibeSpectrum
+ * ----------------
+ * Dominant bin of one axis, DC excluded: the block less its mean, scaled
+ * up to just under VIBE_FFT_HEADROOM for resolution, and the amplitude
+ * (twice the bin's magnitude for a real signal) scaled back down.
+ */
+static void App_VibeSpectrum(const VibeAxis_t* Axis, AppVibeAxis_t* Features)
+{
+	uint32_t Local_uint32Index;
+	uint32_t Local_uint32Power;
+	uint32_t Local_uint32BestPower = 0u;
+	uint32_t Local_uint32BestBin   = 0u;
+	uint8_t  Local_uint8Shift      = 0u;
+
+	while((Local_uint8Shift < 14u) && (((uint32_t)Features->Peak << (Local_uint8Shift + 1u)) < (uint32_t)VIBE_FFT_HEADROOM))
+	{
+		Local_uint8Shift++;
+	}
+
+	for(Local_uint32Index = 0; Local_uint32Index < APP_VIBE_BLOCK_SIZE; Local_uint32Index++)
+	{
+		Global_Fft[Local_uint32Index] = (uint16_t)((Axis->Block[Local_uint32Index] - Features->Mean) * (1 << Local_uint8Shift));
+	}
+
+	App_VibeFft();
+
+	for(Local_uint32Index = 1u; Local_uint32Index < (APP_VIBE_BLOCK_SIZE / 2u); Local_uint32Index++)
+	{
+		Local_uint32Power = __SMUAD(Global_Fft[Local_uint32Index], Global_Fft[Local_uint32Index]);
+		if(Local_uint32Power > Local_uint32BestPower)
+		{
+			Local_uint32BestPower = Local_uint32Power;
+			Local_uint32BestBin   = Local_uint32Index;
+		}
+	}
+
+	Features->Frequency = (uint16_t)(((Local_uint32BestBin * VIBE_ODR_DECI_HZ) + (VIBE_DECIMATION * APP_VIBE_BLOCK_SIZE / 2u)) /
+	                                 (VIBE_DECIMATION * APP_VIBE_BLOCK_SIZE));
+	Features->Amplitude = (uint16_t)((2u * App_VibeSqrt(Local_uint32BestPower)) >> Local_uint8Shift);
+}
+#endif
+
+
+/*
+ * App_VibeEndBlock
+ * ----------------
+ * Features of every axis from the block's sums, into the telemetry batch.
+ */
+static void App_VibeEndBlock(void)
+{
+	VibeAxis_t*    Local_pAxis;
+	AppVibeAxis_t* Local_pFeatures;
+	int32_t  Local_int32Mean;
+	int64_t  Local_int64Variance;
+	uint8_t  Local_uint8Axis;
+
+	for(Local_uint8Axis = 0; Local_uint8Axis < VIBE_AXES; Local_uint8Axis++)
+	{
+		Local_pAxis     = &Global_Axes[Local_uint8Axis];
+		Local_pFeatures = &Global_Last[Local_uint8Axis];
+
+		/* Rounded to the nearest, either sign */
+		Local_int32Mean = (Local_pAxis->Sum + ((Local_pAxis->Sum < 0) ? -(int32_t)(APP_VIBE_BLOCK_SIZE / 2u) : (int32_t)(APP_VIBE_BLOCK_SIZE / 2u))) /
+		                  (int32_t)APP_VIBE_BLOCK_SIZE;
+		Local_int64Variance = ((int64_t)Local_pAxis->SumSquares -
+		                       (((int64_t)Local_pAxis->Sum * Local_pAxis->Sum) / (int64_t)APP_VIBE_BLOCK_SIZE)) / (int64_t)APP_VIBE_BLOCK_SIZE;
+
+		Local_pFeatures->Mean = (int16_t)Local_int32Mean;
+		Local_pFeatures->Rms  = (uint16_t)App_VibeSqrt((Local_int64Variance > 0) ? (uint64_t)Local_int64Variance : 0u);
+		Local_pFeatures->Peak = (uint16_t)(((Local_pAxis->Max - Local_int32Mean) > (Local_int32Mean - Local_pAxis->Min)) ?
+		                                   (Local_pAxis->Max - Local_int32Mean) : (Local_int32Mean - Local_pAxis->Min));
+
+		(void)App_TelemetryAdd(APP_TLM_VIBE_FIELD(Local_uint8Axis, 0u), APP_TLM_TYPE_I16, (uint32_t)(int32_t)Local_pFeatures->Mean);
+		(void)App_TelemetryAdd(APP_TLM_VIBE_FIELD(Local_uint8Axis, 1u), APP_TLM_TYPE_U16, Local_pFeatures->Rms);
+		(void)App_TelemetryAdd(APP_TLM_VIBE_FIELD(Local_uint8Axis, 2u), APP_TLM_TYPE_U16, Local_pFeatures->Peak);
+
+#if (APP_VIBE_FFT_ENABLE != 0u)
+		App_VibeSpectrum(Local_pAxis, Local_pFeatures);
+		(void)App_TelemetryAdd(APP_TLM_VIBE_FIELD(Local_uint8Axis, 3u), APP_TLM_TYPE_U16, Local_pFeatures->Frequency);
+		(void)App_TelemetryAdd(APP_TLM_VIBE_FIELD(Local_uint8Axis, 4u), APP_TLM_TYPE_U16, Local_pFeatures->Amplitude);
+#else
+		Local_pFeatures->Frequency = 0u;
+		Local_pFeatures->Amplitude = 0u;
+#endif
+	}
+
+	Global_Stats.Blocks++;
+	App_VibeResetBlock();
+}
+
+
+/*
+ * App_VibePush
+ * ------------
+ * One 400 Hz sample: into every axis' history, and every second one a
+ * decimated output into the block sums.
+ */
+static void App_VibePush(const AppAccelSample_t* Sample)
+{
+	const int16_t Local_int16Input[VIBE_AXES] = { Sample->X, Sample->Y, Sample->Z };
+	VibeAxis_t* Local_pAxis;
+	int16_t  Local_int16Output;
+	uint8_t  Local_uint8Axis;
+
+	for(Local_uint8Axis = 0; Local_uint8Axis < VIBE_AXES; Local_uint8Axis++)
+	{
+		Local_pAxis = &Global_Axes[Local_uint8Axis];
+
+		Local_pAxis->History[Local_pAxis->Position]             = Local_int16Input[Local_uint8Axis];
+		Local_pAxis->History[Local_pAxis->Position + VIBE_TAPS] = Local_int16Input[Local_uint8Axis];
+		Local_pAxis->Position = (uint8_t)((Local_pAxis->Position + 1u) & (VIBE_TAPS - 1u));
+	}
+
+	if(++Global_uint8Phase < VIBE_DECIMATION)
+	{
+		return;
+	}
+	Global_uint8Phase = 0u;
+
+	for(Local_uint8Axis = 0; Local_uint8Axis < VIBE_AXES; Local_uint8Axis++)
+	{
+		Local_pAxis       = &Global_Axes[Local_uint8Axis];
+		Local_int16Output = App_VibeFilter(Local_pAxis);
+
+#if (APP_VIBE_FFT_ENABLE != 0u)
+		Local_pAxis->Block[Global_uint16Count] = Local_int16Output;
+#endif
+		Local_pAxis->Sum        += Local_int16Output;
+		Local_pAxis->SumSquares += (uint64_t)((int32_t)Local_int16Output * Local_int16Output);
+		if(Local_int16Output < Local_pAxis->Min)
+		{
+			Local_pAxis->Min = Local_int16Output;
+		}
+		if(Local_int16Output > Local_pAxis->Max)
+		{
+			Local_pAxis->Max = Local_int16Output;
+		}
+	}
+
+	if(++Global_uint16Count == APP_VIBE_BLOCK_SIZE)
+	{
+		App_VibeEndBlock();
+	}
+}
+
+
+/*
+ * App_VibeStart
+ * -------------
+ * Clears the filters and the block, then starts the sensor. The DWT cycle
+ * counter is started if the application was started without the
+ * bootloader.
+ */
+uint8_t App_VibeStart(void)
+{
+	uint8_t Local_uint8Axis;
+	uint8_t Local_uint8Index;
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+
+	for(Local_uint8Axis = 0; Local_uint8Axis < VIBE_AXES; Local_uint8Axis++)
+	{
+		for(Local_uint8Index = 0; Local_uint8Index < (2u * VIBE_TAPS); Local_uint8Index++)
+		{
+			Global_Axes[Local_uint8Axis].History[Local_uint8Index] = 0;
+		}
+		Global_Axes[Local_uint8Axis].Position = 0u;
+	}
+
+	Global_uint8Phase       = 0u;
+	Global_uint32Cycles     = 0u;
+	Global_Stats.LastCycles = 0u;
+	Global_Stats.MaxCycles  = 0u;
+	App_VibeResetBlock();
+
+	return App_AccelStart();
+}
+
+
+/*
+ * App_VibeTask
+ * ------------
+ * Signalled by the accelerometer once its ring holds
+ * APP_ACCEL_NOTIFY_LEVEL samples: drains all of it.
+ */
+void App_VibeTask(uint32_t Events)
+{
+	AppAccelSample_t Local_Samples[VIBE_DRAIN_CHUNK];
+	uint32_t Local_uint32Start = DWT->CYCCNT;
+	uint32_t Local_uint32Blocks = Global_Stats.Blocks;
+	uint16_t Local_uint16Count;
+	uint16_t Local_uint16Index;
+
+	(void)Events;
+
+	do
+	{
+		Local_uint16Count = App_AccelRead(Local_Samples, VIBE_DRAIN_CHUNK);
+
+		for(Local_uint16Index = 0; Local_uint16Index < Local_uint16Count; Local_uint16Index++)
+		{
+			App_VibePush(&Local_Samples[Local_uint16Index]);
+		}
+	} while(Local_uint16Count == VIBE_DRAIN_CHUNK);
+
+	/* A block's cost is the runs up to the one that ended it */
+	Global_uint32Cycles += DWT->CYCCNT - Local_uint32Start;
+	if(Global_Stats.Blocks != Local_uint32Blocks)
+	{
+		Global_Stats.LastCycles = Global_uint32Cycles;
+		Global_uint32Cycles     = 0u;
+
+		if(Global_Stats.LastCycles > Global_Stats.MaxCycles)
+		{
+			Global_Stats.MaxCycles = Global_Stats.LastCycles;
+		}
+	}
+}
+
+
+void App_VibeGetLast(AppVibeAxis_t Axes[3])
+{
+	uint8_t Local_uint8Axis;
+
+	for(Local_uint8Axis = 0; Local_uint8Axis < VIBE_AXES; Local_uint8Axis++)
+	{
+		Axes[Local_uint8Axis] = Global_Last[Local_uint8Axis];
+	}
+}
+
+
+void App_VibeGetStats(AppVibeStats_t* Stats)
+{
+	*Stats = Global_Stats;
+}
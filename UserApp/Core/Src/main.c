@@ -23,16 +23,83 @@
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
-
+#include "usbh_core.h"
+#include "App_Image.h"
+#include "App_Uart.h"
+#include "App_Telemetry.h"
+#include "App_Cdc.h"
+#include "App_Hub.h"
+#include "App_Bridge.h"
+#include "App_Update.h"
+#include "App_Ota.h"
+#include "App_Accel.h"
+#include "App_Vibe.h"
+#include "App_Audio.h"
+#include "App_AudioFx.h"
+#include "App_Power.h"
+#include "App_Clock.h"
+#include "App_Button.h"
+#include "App_Scheduler.h"
+#include "App_Profile.h"
+#include "App_Pool.h"
+#include "MemoryUsage.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
 /* USER CODE BEGIN PTD */
-
+/* Left by the bootloader at the end of CCMRAM, same layout as BL_Handoff_t (BL_Handoff.h) */
+typedef struct
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t BootPath;
+	uint32_t ResetFlags;
+	uint32_t SysClock;
+	uint32_t Pllcfgr;
+	uint32_t Cfgr;
+	uint32_t FlashAcr;
+	uint32_t Stamps[4];         /* DWT->CYCCNT at clock, decision, validated, jump (0 = not reached) */
+	uint32_t Check;             /* ~(XOR of the words above) */
+} AppHandoff_t;
 /* USER CODE END PTD */
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+#define APP_VERSION             0x00010000UL    /* 1.0.0 */
+#define APP_SECURITY_VERSION    0u              /* Raise only to keep every earlier build from booting */
+#ifndef APP_BUILD_ID
+#define APP_BUILD_ID            0u              /* Set by the build (e.g. -DAPP_BUILD_ID=0x<commit>), read back by GET_APP_INFO */
+#endif
+
+#define APP_HANDOFF             ((const volatile AppHandoff_t*)0x1000FFC0UL)
+#define APP_HANDOFF_MAGIC       0x46444842UL
+
+#define APP_PRE_ERASE_UNKNOWN   0xFFu       /* Global_uint8PreEraseLeft before the table was asked */
+
+/* Key/value store keys (APP_KV_STORE builds, STM32F407VGTX_FLASH_KV.ld) */
+#define APP_KV_KEY_BOOT_COUNT   APP_KV_KEY_FIRST
+
+/* Update request to the bootloader, BL_UPDATE_REQUEST_xxx (BL_Handoff.h) */
+#define APP_UPDATE_REQUEST_MAGIC 0x51524C42UL
+
+/* Trial boot state, BL_TRIAL_xxx (BL_Handoff.h) */
+#define APP_TRIAL_MAGIC         0x544C4200UL
+#define APP_TRIAL_MAGIC_MASK    0xFFFFFF00UL
+
+#define APP_HEARTBEAT_PERIOD_MS 1000u
+#define APP_USB_POLL_PERIOD_MS  1u
+#define APP_CDC_CHUNK_SIZE      64u
+#define APP_CDC_RETRY_MS        1u
+
+/* SystemClock_Config below: HSE / 8 * 336 / 2, Q = 7 -> 168 MHz, AHB / 1, APB1 / 4, APB2 / 2 */
+#define APP_CLOCK_PLLCFGR       (RCC_PLLCFGR_PLLSRC_HSE | 8u | (336u << RCC_PLLCFGR_PLLN_Pos) | (7u << RCC_PLLCFGR_PLLQ_Pos))
+#define APP_CLOCK_PLLCFGR_MASK  (RCC_PLLCFGR_PLLSRC | RCC_PLLCFGR_PLLM | RCC_PLLCFGR_PLLN | RCC_PLLCFGR_PLLP | RCC_PLLCFGR_PLLQ)
+#define APP_CLOCK_CFGR          (RCC_CFGR_SWS_PLL | RCC_CFGR_HPRE_DIV1 | RCC_CFGR_PPRE1_DIV4 | RCC_CFGR_PPRE2_DIV2)
+#define APP_CLOCK_CFGR_MASK     (RCC_CFGR_SWS | RCC_CFGR_HPRE | RCC_CFGR_PPRE1 | RCC_CFGR_PPRE2)
+#define APP_CLOCK_HZ            168000000UL
+#define APP_CLOCK_ART           (FLASH_ACR_PRFTEN | FLASH_ACR_ICEN | FLASH_ACR_DCEN)
+
+#define APP_VECTOR_ENTRIES      (16u + 82u)  /* Cortex-M4 exceptions, STM32F407 interrupts up to FPU_IRQn */
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -44,18 +111,65 @@
 I2C_HandleTypeDef hi2c1;
 
 I2S_HandleTypeDef hi2s3;
+DMA_HandleTypeDef hdma_spi3_tx;
 
 SPI_HandleTypeDef hspi1;
+DMA_HandleTypeDef hdma_spi1_rx;
+DMA_HandleTypeDef hdma_spi1_tx;
 
 UART_HandleTypeDef huart2;
+DMA_HandleTypeDef hdma_usart2_rx;
+DMA_HandleTypeDef hdma_usart2_tx;
 
 /* USER CODE BEGIN PV */
+extern const uint8_t _app_image_end[];
+extern USBH_HandleTypeDef hUsbHostFS;
 
+/* App_UsbHostTask: APP_TIMER_USB_POLL running */
+static uint8_t Global_uint8UsbPolling;
+
+/* App_VectorsToRam: VTOR needs the table aligned to its size rounded up to a power of two */
+static uint32_t Global_uint32VectorTable[APP_VECTOR_ENTRIES] __attribute__((aligned(512)));
+
+/* SystemClock_Config: 1 when it kept the bootloader's clock tree */
+static uint8_t Global_uint8ClockKept;
+
+/* B1, active high: one APP_EVENT_BUTTON per press */
+static const AppButton_t Global_ButtonB1 =
+{
+	B1_GPIO_Port, B1_Pin, GPIO_PIN_SET, APP_TIMER_B1_DEBOUNCE, APP_TASK_BUTTON, APP_EVENT_BUTTON, 0u
+};
+
+/* App_PreEraseStep: next sector, sectors left, finished */
+static uint8_t Global_uint8PreEraseNext;
+static uint8_t Global_uint8PreEraseLeft = APP_PRE_ERASE_UNKNOWN;
+static uint8_t Global_uint8PreEraseDone;
+
+#ifdef APP_KV_STORE
+/* Key/value store context (bootloader services) and this boot's number, 0 without a store */
+static AppKv_t Global_Kv;
+static uint32_t Global_uint32BootCount;
+#endif
+
+/* Placed at offset 0x200 by STM32F407VGTX_FLASH.ld */
+__attribute__((section(".app_header"), used))
+const AppHeader_t App_Header =
+{
+	APP_HEADER_MAGIC,
+	APP_VERSION,
+	_app_image_end,
+	0xFFFFFFFFUL,
+	0xFFFFFFFFUL,
+	0xFFFFFFFFUL,
+	APP_SECURITY_VERSION,
+	APP_BUILD_ID
+};
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_I2C1_Init(void);
 static void MX_I2S3_Init(void);
 static void MX_SPI1_Init(void);
@@ -63,6 +177,20 @@ static void MX_USART2_UART_Init(void);
 void MX_USB_HOST_Process(void);
 
 /* USER CODE BEGIN PFP */
+static void App_VectorsToRam(void);
+static uint8_t App_ClockFromBootloader(void);
+static void App_PreEraseStep(void);
+#ifdef APP_KV_STORE
+static void App_KvStart(void);
+#endif
+static uint8_t App_ClockPeripherals(uint8_t Phase, uint32_t Hz);
+static void App_UsbHostTask(uint32_t Events);
+#ifndef APP_CDC_BRIDGE
+static void App_CdcTask(uint32_t Events);
+#endif
+static void App_ButtonTask(uint32_t Events);
+static void App_HeartbeatTask(uint32_t Events);
+static void App_PreEraseTask(uint32_t Events);
 
 /* USER CODE END PFP */
 
@@ -78,7 +206,8 @@ void MX_USB_HOST_Process(void);
 int main(void)
 {
   /* USER CODE BEGIN 1 */
-   char HelloUserApp[] = "Hello From User App/r/n";
+  App_VectorsToRam();
+
   /* USER CODE END 1 */
 
   /* MCU Configuration--------------------------------------------------------*/
@@ -99,25 +228,68 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_I2C1_Init();
   MX_I2S3_Init();
   MX_SPI1_Init();
   MX_USB_HOST_Init();
   MX_USART2_UART_Init();
   /* USER CODE BEGIN 2 */
-
+  App_PowerInit();
+  (void)App_ButtonAdd(&Global_ButtonB1);
+#ifdef APP_KV_STORE
+  App_KvStart();
+#endif
+
+  App_SchedSetTask(APP_TASK_USB_HOST, App_UsbHostTask);
+#ifdef APP_CDC_BRIDGE
+  App_SchedSetTask(APP_TASK_CDC, App_BridgeTask);
+#else
+  App_SchedSetTask(APP_TASK_CDC, App_CdcTask);
+#endif
+  App_SchedSetTask(APP_TASK_DEBOUNCE, App_ButtonDebounceTask);
+  App_SchedSetTask(APP_TASK_BUTTON, App_ButtonTask);
+  App_SchedSetTask(APP_TASK_HEARTBEAT, App_HeartbeatTask);
+  App_SchedSetTask(APP_TASK_UPDATE, App_UpdateTask);
+  App_SchedSetTask(APP_TASK_ACCEL, App_VibeTask);
+  App_SchedSetTask(APP_TASK_OTA, App_OtaTask);
+  App_SchedSetTask(APP_TASK_CLOCK, App_ClockTask);
+  App_SchedSetTask(APP_TASK_PRE_ERASE, App_PreEraseTask);
+  (void)App_ClockAddListener(App_ClockPeripherals);
+
+  /* Bootloader commands on USART2 while the application runs */
+  App_OtaStart();
+
+  /* The first heartbeat right away: one full round confirms the image */
+  App_TelemetryStart();
+  App_SchedTimerStart(APP_TIMER_HEARTBEAT, APP_TASK_HEARTBEAT, APP_EVENT_TIMER, 1u, APP_HEARTBEAT_PERIOD_MS);
+  App_SchedSignal(APP_TASK_USB_HOST, APP_EVENT_USB_POLL);
+
+  /* Vibration telemetry on USART2 from the first block, if the LIS302DL answers */
+  (void)App_VibeStart();
+
+  /* Written by I2C1 interrupts while the tasks start; flat EQ, unity volume until set */
+  App_AudioFxInit();
+  (void)App_AudioCodecInit(NULL);
+
+  /* PC samples into backup SRAM from here on (blflash profile) */
+  App_ProfileStart();
+
+  /* Every clock listener is in: LOW until a task asks for more */
+  App_ClockStart();
   /* USER CODE END 2 */
 
   /* Infinite loop */
   /* USER CODE BEGIN WHILE */
+  /* Tasks on events and timers, WFI in between: the loop below is never reached */
+  App_SchedRun();
+
   while (1)
   {
     /* USER CODE END WHILE */
     MX_USB_HOST_Process();
 
     /* USER CODE BEGIN 3 */
-    HAL_UART_Transmit(&huart2, HelloUserApp, sizeof(HelloUserApp), HAL_MAX_DELAY);
-    HAL_Delay(1000);
   }
   /* USER CODE END 3 */
 }
@@ -136,6 +308,26 @@ void SystemClock_Config(void)
   */
   __HAL_RCC_PWR_CLK_ENABLE();
   __HAL_PWR_VOLTAGESCALING_CONFIG(PWR_REGULATOR_VOLTAGE_SCALE1);
+  /* USER CODE BEGIN SysClock */
+  /* The bootloader left this exact clock tree running: no PLL start-up */
+  if (App_ClockFromBootloader() != 0u)
+  {
+    Global_uint8ClockKept = 1u;
+    SystemCoreClockUpdate();
+    if (HAL_InitTick(uwTickPrio) != HAL_OK)
+    {
+      Error_Handler();
+    }
+  }
+  else
+  {
+    Global_uint8ClockKept = 0u;
+    /* A PLL the bootloader left on another profile cannot be reprogrammed while it clocks the core */
+    if (__HAL_RCC_GET_SYSCLK_SOURCE() == RCC_SYSCLKSOURCE_STATUS_PLLCLK)
+    {
+      (void)HAL_RCC_DeInit();
+    }
+  /* USER CODE END SysClock */
   /** Initializes the RCC Oscillators according to the specified parameters
   * in the RCC_OscInitTypeDef structure.
   */
@@ -164,6 +356,11 @@ void SystemClock_Config(void)
   {
     Error_Handler();
   }
+  /* USER CODE BEGIN SysClockEnd */
+  }
+  /* ART accelerator: 5 wait states only cost where prefetch and caches miss */
+  FLASH->ACR |= APP_CLOCK_ART;
+  /* USER CODE END SysClockEnd */
   PeriphClkInitStruct.PeriphClockSelection = RCC_PERIPHCLK_I2S;
   PeriphClkInitStruct.PLLI2S.PLLI2SN = 192;
   PeriphClkInitStruct.PLLI2S.PLLI2SR = 2;
@@ -202,6 +399,13 @@ static void MX_I2C1_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN I2C1_Init 2 */
+#if APP_I2C_FAST_MODE
+  hi2c1.Init.ClockSpeed = 400000;
+  if (HAL_I2C_Init(&hi2c1) != HAL_OK)
+  {
+    Error_Handler();
+  }
+#endif
 
   /* USER CODE END I2C1_Init 2 */
 
@@ -264,7 +468,7 @@ static void MX_SPI1_Init(void)
   hspi1.Init.CLKPolarity = SPI_POLARITY_LOW;
   hspi1.Init.CLKPhase = SPI_PHASE_1EDGE;
   hspi1.Init.NSS = SPI_NSS_SOFT;
-  hspi1.Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_2;
+  hspi1.Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_16;
   hspi1.Init.FirstBit = SPI_FIRSTBIT_MSB;
   hspi1.Init.TIMode = SPI_TIMODE_DISABLE;
   hspi1.Init.CRCCalculation = SPI_CRCCALCULATION_DISABLE;
@@ -312,6 +516,35 @@ static void MX_USART2_UART_Init(void)
 
 }
 
+/**
+  * Enable DMA controller clock
+  */
+static void MX_DMA_Init(void)
+{
+
+  /* DMA controller clock enable */
+  __HAL_RCC_DMA1_CLK_ENABLE();
+  __HAL_RCC_DMA2_CLK_ENABLE();
+
+  /* DMA interrupt init */
+  /* DMA1_Stream5_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Stream5_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream5_IRQn);
+  /* DMA1_Stream6_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Stream6_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+  /* DMA1_Stream7_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Stream7_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream7_IRQn);
+  /* DMA2_Stream0_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA2_Stream0_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA2_Stream0_IRQn);
+  /* DMA2_Stream3_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA2_Stream3_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA2_Stream3_IRQn);
+
+}
+
 /**
   * @brief GPIO Initialization Function
   * @param None
@@ -330,7 +563,7 @@ static void MX_GPIO_Init(void)
   __HAL_RCC_GPIOD_CLK_ENABLE();
 
   /*Configure GPIO pin Output Level */
-  HAL_GPIO_WritePin(CS_I2C_SPI_GPIO_Port, CS_I2C_SPI_Pin, GPIO_PIN_RESET);
+  HAL_GPIO_WritePin(CS_I2C_SPI_GPIO_Port, CS_I2C_SPI_Pin, GPIO_PIN_SET);
 
   /*Configure GPIO pin Output Level */
   HAL_GPIO_WritePin(OTG_FS_PowerSwitchOn_GPIO_Port, OTG_FS_PowerSwitchOn_Pin, GPIO_PIN_SET);
@@ -363,7 +596,7 @@ static void MX_GPIO_Init(void)
 
   /*Configure GPIO pin : B1_Pin */
   GPIO_InitStruct.Pin = B1_Pin;
-  GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING;
+  GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING_FALLING;
   GPIO_InitStruct.Pull = GPIO_NOPULL;
   HAL_GPIO_Init(B1_GPIO_Port, &GPIO_InitStruct);
 
@@ -398,7 +631,7 @@ static void MX_GPIO_Init(void)
 
   /*Configure GPIO pin : MEMS_INT2_Pin */
   GPIO_InitStruct.Pin = MEMS_INT2_Pin;
-  GPIO_InitStruct.Mode = GPIO_MODE_EVT_RISING;
+  GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING;
   GPIO_InitStruct.Pull = GPIO_NOPULL;
   HAL_GPIO_Init(MEMS_INT2_GPIO_Port, &GPIO_InitStruct);
 
@@ -406,10 +639,389 @@ static void MX_GPIO_Init(void)
   HAL_NVIC_SetPriority(EXTI0_IRQn, 0, 0);
   HAL_NVIC_EnableIRQ(EXTI0_IRQn);
 
+  HAL_NVIC_SetPriority(EXTI1_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(EXTI1_IRQn);
+
 }
 
 /* USER CODE BEGIN 4 */
 
+/*
+ * Bootloader_RequestUpdate
+ * ------------------------
+ * Restarts into the bootloader's update mode, as if B1 were held at reset:
+ * the request goes to RTC backup register 0, which the bootloader reads and
+ * clears first thing. Does not return.
+ */
+void Bootloader_RequestUpdate(void)
+{
+	__HAL_RCC_PWR_CLK_ENABLE();
+	HAL_PWR_EnableBkUpAccess();
+
+	RTC->BKP0R = APP_UPDATE_REQUEST_MAGIC;
+
+	NVIC_SystemReset();
+}
+
+/*
+ * Bootloader_ConfirmImage
+ * -----------------------
+ * Ends a trial boot (BL_Handoff.h): the bootloader no longer counts the
+ * boots of this image nor rolls it back. The IWDG it armed keeps running and
+ * must still be refreshed. Cheap when there is no trial: one register read.
+ */
+void Bootloader_ConfirmImage(void)
+{
+	if((RTC->BKP1R & APP_TRIAL_MAGIC_MASK) == APP_TRIAL_MAGIC)
+	{
+		__HAL_RCC_PWR_CLK_ENABLE();
+		HAL_PWR_EnableBkUpAccess();
+
+		RTC->BKP1R = 0u;
+
+		HAL_PWR_DisableBkUpAccess();
+	}
+}
+
+/*
+ * App_VectorsToRam
+ * ----------------
+ * Copies the vector table to SRAM and points VTOR at it: with the handlers
+ * in .RamFunc / .data (STM32F407VGTX_FLASH.ld), taking an interrupt no longer
+ * reads flash at all, so the I2S and UART interrupts still run while a flash
+ * erase or program stalls the main loop.
+ */
+static void App_VectorsToRam(void)
+{
+	const uint32_t* Local_puint32Source = (const uint32_t*)SCB->VTOR;
+	uint32_t Local_uint32Index;
+
+	for(Local_uint32Index = 0; Local_uint32Index < APP_VECTOR_ENTRIES; Local_uint32Index++)
+	{
+		Global_uint32VectorTable[Local_uint32Index] = Local_puint32Source[Local_uint32Index];
+	}
+
+	__DSB();
+	SCB->VTOR = (uint32_t)Global_uint32VectorTable;
+	__DSB();
+	__ISB();
+}
+
+/*
+ * App_ClockFromBootloader
+ * -----------------------
+ * 1 when the bootloader handoff block is intact and both it and the live RCC
+ * registers show the clock tree SystemClock_Config would set up: 168 MHz,
+ * PLL locked on HSE with the same factors and prescalers, selected, 5 wait
+ * states.
+ * Otherwise (bootloader put the clock back on HSI, other profile, no
+ * bootloader) 0 and SystemClock_Config runs in full.
+ */
+static uint8_t App_ClockFromBootloader(void)
+{
+	const volatile uint32_t* Local_puint32Word = (const volatile uint32_t*)APP_HANDOFF;
+	uint32_t Local_uint32Check = 0;
+	uint8_t  Local_uint8Index;
+
+	for(Local_uint8Index = 0; Local_uint8Index < ((sizeof(AppHandoff_t) / sizeof(uint32_t)) - 1u); Local_uint8Index++)
+	{
+		Local_uint32Check ^= Local_puint32Word[Local_uint8Index];
+	}
+
+	return (uint8_t)((APP_HANDOFF->Magic == APP_HANDOFF_MAGIC) && (APP_HANDOFF->Check == ~Local_uint32Check) &&
+	                 (APP_HANDOFF->SysClock == APP_CLOCK_HZ) &&
+	                 ((APP_HANDOFF->Pllcfgr & APP_CLOCK_PLLCFGR_MASK) == APP_CLOCK_PLLCFGR) &&
+	                 ((APP_HANDOFF->Cfgr & APP_CLOCK_CFGR_MASK) == APP_CLOCK_CFGR) &&
+	                 ((RCC->CR & (RCC_CR_HSERDY | RCC_CR_PLLRDY)) == (RCC_CR_HSERDY | RCC_CR_PLLRDY)) &&
+	                 ((RCC->PLLCFGR & APP_CLOCK_PLLCFGR_MASK) == APP_CLOCK_PLLCFGR) &&
+	                 ((RCC->CFGR & APP_CLOCK_CFGR_MASK) == APP_CLOCK_CFGR) &&
+	                 ((FLASH->ACR & FLASH_ACR_LATENCY) == FLASH_ACR_LATENCY_5WS));
+}
+
+#ifdef APP_KV_STORE
+/*
+ * App_KvStart
+ * -----------
+ * Indexes the bootloader's key/value store (sectors 8 and 9, below which
+ * STM32F407VGTX_FLASH_KV.ld ends the image) and counts this boot in it:
+ * one 12-byte record per boot, a compaction stall every ~10000 boots.
+ */
+static void App_KvStart(void)
+{
+	if((APP_SERVICES->Magic == APP_SERVICES_MAGIC) && (APP_SERVICES->Version >= APP_SERVICES_VERSION_KV))
+	{
+		APP_SERVICES->KvInit(&Global_Kv);
+
+		if(APP_SERVICES->KvGet(&Global_Kv, APP_KV_KEY_BOOT_COUNT, &Global_uint32BootCount, sizeof(Global_uint32BootCount)) != sizeof(Global_uint32BootCount))
+		{
+			Global_uint32BootCount = 0;
+		}
+
+		Global_uint32BootCount++;
+		(void)APP_SERVICES->KvSet(&Global_Kv, APP_KV_KEY_BOOT_COUNT, &Global_uint32BootCount, sizeof(Global_uint32BootCount));
+	}
+}
+#endif
+
+/*
+ * App_PreEraseStep
+ * ----------------
+ * Background pre-erase of the area the next update goes to (inactive A/B
+ * slot or swap scratch, from the bootloader services table), one slice per
+ * call from the main loop: the next sector that is not blank is erased,
+ * blank ones are skipped. Each erase stalls the CPU (the code runs from
+ * flash) for up to 2 s, once per sector instead of all of them in the update
+ * window; the bootloader then finds the sectors blank and programs at once.
+ * Only starts once the running image is validated: with A/B slots the
+ * inactive slot holds the previous image, the fallback until then.
+ * Stops for good once the area is blank, on an erase error, or without a
+ * bootloader table that knows the area.
+ */
+static void App_PreEraseStep(void)
+{
+	/* The same sectors: a USB or USART2 update erases them itself as it goes */
+	if((Global_uint8PreEraseDone != 0u) || (App_UpdateBusy() != 0u) || (App_OtaBusy() != 0u))
+	{
+		return;
+	}
+
+	if(Global_uint8PreEraseLeft == APP_PRE_ERASE_UNKNOWN)
+	{
+		if((APP_SERVICES->Magic != APP_SERVICES_MAGIC) || (APP_SERVICES->Version < APP_SERVICES_VERSION_PRE_ERASE) ||
+		   (APP_SERVICES->ImageIsValidated() == 0u) ||
+		   (APP_SERVICES->InactiveSectors(&Global_uint8PreEraseNext, &Global_uint8PreEraseLeft) != HAL_OK))
+		{
+			Global_uint8PreEraseLeft = 0;
+		}
+	}
+
+	/* Blank sectors cost a read scan only */
+	while((Global_uint8PreEraseLeft != 0u) && (APP_SERVICES->FlashSectorIsBlank(Global_uint8PreEraseNext) != 0u))
+	{
+		Global_uint8PreEraseNext++;
+		Global_uint8PreEraseLeft--;
+	}
+
+	if(Global_uint8PreEraseLeft == 0u)
+	{
+		Global_uint8PreEraseDone = 1;
+	}
+	else if(APP_SERVICES->FlashUnlock() == HAL_OK)
+	{
+		if(APP_SERVICES->FlashEraseSector(Global_uint8PreEraseNext) != HAL_OK)
+		{
+			Global_uint8PreEraseDone = 1;
+		}
+		APP_SERVICES->FlashLock();
+	}
+	else
+	{
+		Global_uint8PreEraseDone = 1;
+	}
+}
+
+/*
+ * App_UsbHostTask
+ * ---------------
+ * One step of the USB host state machine per OTG_FS interrupt. Outside
+ * HOST_IDLE (enumeration, an active class, a disconnection being handled)
+ * the state machine also has steps of its own: APP_TIMER_USB_POLL runs it
+ * every millisecond until it is idle again, waiting for a connection. The
+ * class drivers get the full clock for as long.
+ */
+static void App_UsbHostTask(uint32_t Events)
+{
+	(void)Events;
+
+	MX_USB_HOST_Process();
+
+	if((hUsbHostFS.gState != HOST_IDLE) && (Global_uint8UsbPolling == 0u))
+	{
+		App_SchedTimerStart(APP_TIMER_USB_POLL, APP_TASK_USB_HOST, APP_EVENT_USB_POLL, APP_USB_POLL_PERIOD_MS, APP_USB_POLL_PERIOD_MS);
+		App_ClockRequest(APP_CLOCK_PROFILE_FULL);
+		Global_uint8UsbPolling = 1;
+	}
+	else if((hUsbHostFS.gState == HOST_IDLE) && (Global_uint8UsbPolling != 0u))
+	{
+		App_SchedTimerStop(APP_TIMER_USB_POLL);
+		App_ClockRelease(APP_CLOCK_PROFILE_FULL);
+		Global_uint8UsbPolling = 0;
+	}
+}
+
+/*
+ * App_ClockPeripherals
+ * --------------------
+ * No switch while USART2 sends or I2C1 or SPI1 transfer. After one, the
+ * USART2 divider and the I2C1 timing follow PCLK1; SPI1 keeps its
+ * prescaler (5.25 MHz at FULL, 1 MHz at LOW, both fine for the LIS302DL).
+ * A byte USART2 receives during the switch may be lost, which the OTA
+ * and bridge framing already recovers from. I2S3 runs from PLLI2S.
+ */
+static uint8_t App_ClockPeripherals(uint8_t Phase, uint32_t Hz)
+{
+	(void)Hz;
+
+	if(Phase == APP_CLOCK_BEFORE)
+	{
+		return ((huart2.gState == HAL_UART_STATE_READY) && (hi2c1.State == HAL_I2C_STATE_READY) &&
+		        (hspi1.State == HAL_SPI_STATE_READY)) ? 1u : 0u;
+	}
+
+	USART2->BRR = UART_BRR_SAMPLING16(HAL_RCC_GetPCLK1Freq(), huart2.Init.BaudRate);
+	(void)HAL_I2C_Init(&hi2c1);
+
+	return 1u;
+}
+
+#ifndef APP_CDC_BRIDGE
+/*
+ * App_CdcTask
+ * -----------
+ * Forwards what the CDC devices sent to USART2, as much as the transmit
+ * queue takes: the one on the root port, or those behind a hub (App_Hub.h),
+ * a chunk from each in turn. Bytes left in a ring are tried again
+ * APP_CDC_RETRY_MS later, when the DMA has made room.
+ */
+static void App_CdcTask(uint32_t Events)
+{
+	uint8_t  Local_uint8Chunk[APP_CDC_CHUNK_SIZE];
+	uint16_t Local_uint16Free;
+	uint16_t Local_uint16Length;
+	uint16_t Local_uint16Sent;
+	uint8_t  Local_uint8Source;
+
+	(void)Events;
+
+	do
+	{
+		Local_uint16Sent = 0u;
+
+		/* Sources 0 .. APP_HUB_MAX_PORTS - 1 the hub's devices, APP_HUB_MAX_PORTS the root port's */
+		for(Local_uint8Source = 0u; Local_uint8Source <= APP_HUB_MAX_PORTS; Local_uint8Source++)
+		{
+			if(((Local_uint8Source < APP_HUB_MAX_PORTS) ? App_HubRxAvailable(Local_uint8Source) : App_CdcRxAvailable()) == 0u)
+			{
+				continue;
+			}
+
+			Local_uint16Free = App_UartTxFree();
+			if(Local_uint16Free == 0u)
+			{
+				App_SchedTimerStart(APP_TIMER_CDC_RETRY, APP_TASK_CDC, APP_EVENT_CDC_RX, APP_CDC_RETRY_MS, 0u);
+				return;
+			}
+
+			Local_uint16Free   = (Local_uint16Free < APP_CDC_CHUNK_SIZE) ? Local_uint16Free : APP_CDC_CHUNK_SIZE;
+			Local_uint16Length = (Local_uint8Source < APP_HUB_MAX_PORTS) ? App_HubRead(Local_uint8Source, Local_uint8Chunk, Local_uint16Free)
+			                                                             : App_CdcRead(Local_uint8Chunk, Local_uint16Free);
+			(void)App_UartSend(Local_uint8Chunk, Local_uint16Length);
+			Local_uint16Sent += Local_uint16Length;
+		}
+	} while(Local_uint16Sent != 0u);
+}
+#endif
+
+/*
+ * App_ButtonTask
+ * --------------
+ * B1 pressed, once per press (App_Button.h): toggles LD4 and LD5.
+ */
+static void App_ButtonTask(uint32_t Events)
+{
+	(void)Events;
+
+	HAL_GPIO_TogglePin(LD4_GPIO_Port, LD4_Pin);
+	HAL_GPIO_TogglePin(LD5_GPIO_Port, LD5_Pin);
+}
+
+/*
+ * App_HeartbeatTask
+ * -----------------
+ * Every APP_HEARTBEAT_PERIOD_MS: the status fields into the telemetry batch
+ * (the clock source once), then the image is confirmed and the trial
+ * watchdog refreshed, then a pre-erase slice is asked of the last task.
+ * APP_TIMER_TELEMETRY flushes the batch.
+ */
+static void App_HeartbeatTask(uint32_t Events)
+{
+	static uint8_t Local_uint8Reported;
+	AppAudioFxStats_t Local_AudioFx;
+	AppVibeStats_t    Local_Vibe;
+	AppPoolStats_t    Local_Pool;
+	MemoryUsage_t     Local_Memory;
+	uint8_t           Local_uint8Class;
+
+	if((Events & APP_EVENT_TELEMETRY) != 0u)
+	{
+		App_TelemetryFlush();
+	}
+
+	if((Events & APP_EVENT_TIMER) == 0u)
+	{
+		return;
+	}
+
+	/* Once: which side built the clock tree, the handoff check's outcome */
+	if(Local_uint8Reported == 0u)
+	{
+		Local_uint8Reported = 1u;
+		(void)App_TelemetryAdd(APP_TLM_CLOCK, APP_TLM_TYPE_U8,
+		                       (SystemCoreClock != APP_CLOCK_HZ) ? 0u : ((Global_uint8ClockKept != 0u) ? 1u : 2u));
+	}
+
+	App_AudioFxGetStats(&Local_AudioFx);
+	App_VibeGetStats(&Local_Vibe);
+	Memory_GetUsage(&Local_Memory);
+
+	(void)App_TelemetryAdd(APP_TLM_UPTIME, APP_TLM_TYPE_U32, HAL_GetTick() / 1000u);
+	(void)App_TelemetryAdd(APP_TLM_UART_DROPPED, APP_TLM_TYPE_U32, App_UartDropped());
+	(void)App_TelemetryAdd(APP_TLM_TELEMETRY_DROPPED, APP_TLM_TYPE_U32, App_TelemetryDropped());
+	(void)App_TelemetryAdd(APP_TLM_CDC_DROPPED, APP_TLM_TYPE_U32, App_CdcRxDropped());
+	(void)App_TelemetryAdd(APP_TLM_AUDIO_UNDERRUNS, APP_TLM_TYPE_U32, App_AudioUnderruns());
+	(void)App_TelemetryAdd(APP_TLM_AUDIO_CYCLES, APP_TLM_TYPE_U32, Local_AudioFx.MaxCycles);
+	(void)App_TelemetryAdd(APP_TLM_ACCEL_DROPPED, APP_TLM_TYPE_U32, App_AccelDropped());
+	(void)App_TelemetryAdd(APP_TLM_VIBE_CYCLES, APP_TLM_TYPE_U32, Local_Vibe.MaxCycles);
+	(void)App_TelemetryAdd(APP_TLM_STACK_PEAK, APP_TLM_TYPE_U32, Local_Memory.StackPeak);
+	(void)App_TelemetryAdd(APP_TLM_HEAP_PEAK, APP_TLM_TYPE_U32, Local_Memory.HeapPeak);
+	for(Local_uint8Class = 0u; App_PoolGetStats(Local_uint8Class, &Local_Pool) != 0u; Local_uint8Class++)
+	{
+		(void)App_TelemetryAdd((uint8_t)(APP_TLM_POOL_FIRST + Local_uint8Class), APP_TLM_TYPE_U16, Local_Pool.HighWater);
+	}
+
+	/* One full round of the tasks: the image works, end the trial boot */
+	Bootloader_ConfirmImage();
+	IWDG->KR = 0xAAAAu;   /* Trial watchdog refresh, no effect when not started */
+
+	App_SchedSignal(APP_TASK_PRE_ERASE, APP_EVENT_TIMER);
+}
+
+/* Last: every other task gets its turn before the CPU stalls on an erase */
+static void App_PreEraseTask(uint32_t Events)
+{
+	(void)Events;
+
+	App_PreEraseStep();
+}
+
+/*
+ * HAL_GPIO_EXTI_Callback
+ * ----------------------
+ * Interrupt context: a button edge only starts its debounce, an
+ * accelerometer data-ready only starts its DMA burst.
+ */
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+	if(GPIO_Pin == MEMS_INT2_Pin)
+	{
+		App_AccelDataReady();
+	}
+	else
+	{
+		App_ButtonEdge(GPIO_Pin);
+	}
+}
+
 /* USER CODE END 4 */
 
 /**
@@ -23,21 +23,59 @@
 #include "stm32f4xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "App_Scheduler.h"
+#include "App_Bridge.h"
+#include "App_Ota.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
 /* USER CODE BEGIN TD */
-
+/* Crash record in backup SRAM, read by the bootloader: same layout as BL_CrashRecord_t (BL_Handoff.h) */
+typedef struct
+{
+	uint32_t Magic;
+	uint32_t Count;             /* Faults since the record was cleared */
+	uint32_t Source;            /* 2: application */
+	uint32_t Fault;             /* Exception number (IPSR) */
+	uint32_t Registers[8];      /* R0 R1 R2 R3 R12 LR PC xPSR, 0 when not readable */
+	uint32_t ExcReturn;
+	uint32_t Cfsr;
+	uint32_t Hfsr;
+	uint32_t Mmfar;
+	uint32_t Bfar;
+	uint32_t Cycles;            /* DWT->CYCCNT */
+	uint32_t Sp;                /* MSP / PSP before the exception */
+	uint32_t StackWords;
+	uint32_t Stack[32];
+	uint32_t Check;             /* ~(XOR of the words above) */
+} AppCrashRecord_t;
 /* USER CODE END TD */
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
-
+#define APP_CRASH_RECORD        ((volatile AppCrashRecord_t*)0x40024F00UL)
+#define APP_CRASH_RECORD_WORDS  (sizeof(AppCrashRecord_t) / 4u)
+#define APP_CRASH_MAGIC         0x48535243UL
+#define APP_CRASH_SOURCE        2u
+#define APP_CRASH_REGISTERS     8u
+#define APP_CRASH_STACK_WORDS   32u
+
+/* RAM a stack may live in: SRAM1 / SRAM2, CCMRAM */
+#define APP_SRAM_BASE           0x20000000UL
+#define APP_SRAM_END            0x20020000UL
+#define APP_CCMRAM_BASE         0x10000000UL
+#define APP_CCMRAM_END          0x10010000UL
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
 /* USER CODE BEGIN PM */
-
+/* Naked fault handlers (PFP): the exception frame and EXC_RETURN to App_FaultCapture, as in the bootloader */
+#define APP_FAULT_CAPTURE()     __asm volatile("tst   lr, #4            \n\t" \
+                                               "ite   eq                \n\t" \
+                                               "mrseq r0, msp           \n\t" \
+                                               "mrsne r0, psp           \n\t" \
+                                               "mov   r1, lr            \n\t" \
+                                               "b     App_FaultCapture  \n\t")
 /* USER CODE END PM */
 
 /* Private variables ---------------------------------------------------------*/
@@ -47,16 +85,143 @@
 
 /* Private function prototypes -----------------------------------------------*/
 /* USER CODE BEGIN PFP */
+void HardFault_Handler(void) __attribute__((naked));
+void MemManage_Handler(void) __attribute__((naked));
+void BusFault_Handler(void) __attribute__((naked));
+void UsageFault_Handler(void) __attribute__((naked));
 
+static void App_FaultCapture(const uint32_t* Frame, uint32_t ExcReturn) __attribute__((used, noreturn));
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
+/*
+ * App_FaultReadableWords
+ * ----------------------
+ * Words that can be read from Address up to the end of its RAM,
+ * 0 when it is not a word-aligned SRAM / CCMRAM address: a fault handler
+ * must not fault again on a corrupted stack pointer.
+ */
+static uint32_t App_FaultReadableWords(uint32_t Address)
+{
+	uint32_t Local_uint32Words = 0u;
+
+	if((Address & 3u) == 0u)
+	{
+		if((Address >= APP_SRAM_BASE) && (Address < APP_SRAM_END))
+		{
+			Local_uint32Words = (APP_SRAM_END - Address) / 4u;
+		}
+		else if((Address >= APP_CCMRAM_BASE) && (Address < APP_CCMRAM_END))
+		{
+			Local_uint32Words = (APP_CCMRAM_END - Address) / 4u;
+		}
+	}
+
+	return Local_uint32Words;
+}
 
+/*
+ * App_FaultCapture
+ * ----------------
+ * Saves the crash record for the bootloader (BL_Handoff.h) and resets.
+ *
+ * Behavior:
+ * ---------
+ * 1. Backup SRAM access is set up on the registers: the HAL state may be
+ *    what faulted.
+ * 2. Count carries on from a valid record, every other field is the new fault.
+ * 3. The pre-exception stack pointer is the frame end: 8 words, 26 with the
+ *    FPU state (EXC_RETURN bit 4 clear), one more when the core aligned the
+ *    frame (stacked xPSR bit 9).
+ * 4. Check is written last, then NVIC_SystemReset.
+ */
+static void App_FaultCapture(const uint32_t* Frame, uint32_t ExcReturn)
+{
+	volatile AppCrashRecord_t* Local_pRecord = APP_CRASH_RECORD;
+	volatile uint32_t* Local_puint32Words = (volatile uint32_t*)APP_CRASH_RECORD;
+	uint32_t Local_uint32Count = 0u;
+	uint32_t Local_uint32Check = 0u;
+	uint32_t Local_uint32Sp;
+	uint32_t Local_uint32Words;
+	uint32_t Local_uint32Index;
+
+	RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+	PWR->CR      |= PWR_CR_DBP;
+	RCC->AHB1ENR |= RCC_AHB1ENR_BKPSRAMEN;
+	__DSB();
+
+	for(Local_uint32Index = 0u; Local_uint32Index < APP_CRASH_RECORD_WORDS; Local_uint32Index++)
+	{
+		Local_uint32Check ^= Local_puint32Words[Local_uint32Index];
+	}
+
+	if((Local_pRecord->Magic == APP_CRASH_MAGIC) && (Local_uint32Check == 0xFFFFFFFFUL))
+	{
+		Local_uint32Count = Local_pRecord->Count;
+	}
+
+	for(Local_uint32Index = 0u; Local_uint32Index < APP_CRASH_RECORD_WORDS; Local_uint32Index++)
+	{
+		Local_puint32Words[Local_uint32Index] = 0u;
+	}
+
+	Local_pRecord->Magic     = APP_CRASH_MAGIC;
+	Local_pRecord->Count     = Local_uint32Count + 1u;
+	Local_pRecord->Source    = APP_CRASH_SOURCE;
+	Local_pRecord->Fault     = __get_IPSR() & IPSR_ISR_Msk;
+	Local_pRecord->ExcReturn = ExcReturn;
+	Local_pRecord->Cfsr      = SCB->CFSR;
+	Local_pRecord->Hfsr      = SCB->HFSR;
+	Local_pRecord->Mmfar     = SCB->MMFAR;
+	Local_pRecord->Bfar      = SCB->BFAR;
+	Local_pRecord->Cycles    = DWT->CYCCNT;
+
+	if(App_FaultReadableWords((uint32_t)Frame) >= APP_CRASH_REGISTERS)
+	{
+		for(Local_uint32Index = 0u; Local_uint32Index < APP_CRASH_REGISTERS; Local_uint32Index++)
+		{
+			Local_pRecord->Registers[Local_uint32Index] = Frame[Local_uint32Index];
+		}
+
+		Local_uint32Sp  = (uint32_t)Frame + (((ExcReturn & 0x10u) == 0u) ? 0x68u : 0x20u);
+		Local_uint32Sp += ((Frame[7] & (1UL << 9)) != 0u) ? 4u : 0u;
+		Local_pRecord->Sp = Local_uint32Sp;
+
+		Local_uint32Words = App_FaultReadableWords(Local_uint32Sp);
+		Local_uint32Words = (Local_uint32Words > APP_CRASH_STACK_WORDS) ? APP_CRASH_STACK_WORDS : Local_uint32Words;
+		for(Local_uint32Index = 0u; Local_uint32Index < Local_uint32Words; Local_uint32Index++)
+		{
+			Local_pRecord->Stack[Local_uint32Index] = ((const uint32_t*)Local_uint32Sp)[Local_uint32Index];
+		}
+		Local_pRecord->StackWords = Local_uint32Words;
+	}
+	else
+	{
+		Local_pRecord->Sp = (uint32_t)Frame;
+	}
+
+	Local_uint32Check = 0u;
+	for(Local_uint32Index = 0u; Local_uint32Index < (APP_CRASH_RECORD_WORDS - 1u); Local_uint32Index++)
+	{
+		Local_uint32Check ^= Local_puint32Words[Local_uint32Index];
+	}
+	Local_pRecord->Check = ~Local_uint32Check;
+
+	__DSB();
+	NVIC_SystemReset();
+}
 /* USER CODE END 0 */
 
 /* External variables --------------------------------------------------------*/
 extern HCD_HandleTypeDef hhcd_USB_OTG_FS;
+extern I2C_HandleTypeDef hi2c1;
+extern DMA_HandleTypeDef hdma_spi1_rx;
+extern DMA_HandleTypeDef hdma_spi1_tx;
+extern DMA_HandleTypeDef hdma_spi3_tx;
+extern DMA_HandleTypeDef hdma_usart2_rx;
+extern DMA_HandleTypeDef hdma_usart2_tx;
+extern UART_HandleTypeDef huart2;
 /* USER CODE BEGIN EV */
 
 /* USER CODE END EV */
@@ -83,7 +248,7 @@ void NMI_Handler(void)
 void HardFault_Handler(void)
 {
   /* USER CODE BEGIN HardFault_IRQn 0 */
-
+  APP_FAULT_CAPTURE();
   /* USER CODE END HardFault_IRQn 0 */
   while (1)
   {
@@ -98,7 +263,7 @@ void HardFault_Handler(void)
 void MemManage_Handler(void)
 {
   /* USER CODE BEGIN MemoryManagement_IRQn 0 */
-
+  APP_FAULT_CAPTURE();
   /* USER CODE END MemoryManagement_IRQn 0 */
   while (1)
   {
@@ -113,7 +278,7 @@ void MemManage_Handler(void)
 void BusFault_Handler(void)
 {
   /* USER CODE BEGIN BusFault_IRQn 0 */
-
+  APP_FAULT_CAPTURE();
   /* USER CODE END BusFault_IRQn 0 */
   while (1)
   {
@@ -128,7 +293,7 @@ void BusFault_Handler(void)
 void UsageFault_Handler(void)
 {
   /* USER CODE BEGIN UsageFault_IRQn 0 */
-
+  APP_FAULT_CAPTURE();
   /* USER CODE END UsageFault_IRQn 0 */
   while (1)
   {
@@ -186,6 +351,7 @@ void SysTick_Handler(void)
   /* USER CODE END SysTick_IRQn 0 */
   HAL_IncTick();
   /* USER CODE BEGIN SysTick_IRQn 1 */
+  App_SchedTick();
 
   /* USER CODE END SysTick_IRQn 1 */
 }
@@ -203,7 +369,7 @@ void SysTick_Handler(void)
 void EXTI0_IRQHandler(void)
 {
   /* USER CODE BEGIN EXTI0_IRQn 0 */
-   HAL_GPIO_TogglePin(LD5_GPIO_Port, LD5_Pin);
+
   /* USER CODE END EXTI0_IRQn 0 */
   HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_0);
   /* USER CODE BEGIN EXTI0_IRQn 1 */
@@ -211,16 +377,162 @@ void EXTI0_IRQHandler(void)
   /* USER CODE END EXTI0_IRQn 1 */
 }
 
+/**
+  * @brief This function handles EXTI line1 interrupt.
+  */
+void EXTI1_IRQHandler(void)
+{
+  /* USER CODE BEGIN EXTI1_IRQn 0 */
+
+  /* USER CODE END EXTI1_IRQn 0 */
+  HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_1);
+  /* USER CODE BEGIN EXTI1_IRQn 1 */
+
+  /* USER CODE END EXTI1_IRQn 1 */
+}
+
+/**
+  * @brief This function handles DMA1 stream5 global interrupt.
+  */
+void DMA1_Stream5_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA1_Stream5_IRQn 0 */
+  App_SchedIsrEntry();
+
+  /* USER CODE END DMA1_Stream5_IRQn 0 */
+  HAL_DMA_IRQHandler(&hdma_usart2_rx);
+  /* USER CODE BEGIN DMA1_Stream5_IRQn 1 */
+
+  /* USER CODE END DMA1_Stream5_IRQn 1 */
+}
+
+/**
+  * @brief This function handles DMA1 stream6 global interrupt.
+  */
+void DMA1_Stream6_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA1_Stream6_IRQn 0 */
+
+  /* USER CODE END DMA1_Stream6_IRQn 0 */
+  HAL_DMA_IRQHandler(&hdma_usart2_tx);
+  /* USER CODE BEGIN DMA1_Stream6_IRQn 1 */
+
+  /* USER CODE END DMA1_Stream6_IRQn 1 */
+}
+
+/**
+  * @brief This function handles I2C1 event interrupt.
+  */
+void I2C1_EV_IRQHandler(void)
+{
+  /* USER CODE BEGIN I2C1_EV_IRQn 0 */
+
+  /* USER CODE END I2C1_EV_IRQn 0 */
+  HAL_I2C_EV_IRQHandler(&hi2c1);
+  /* USER CODE BEGIN I2C1_EV_IRQn 1 */
+
+  /* USER CODE END I2C1_EV_IRQn 1 */
+}
+
+/**
+  * @brief This function handles I2C1 error interrupt.
+  */
+void I2C1_ER_IRQHandler(void)
+{
+  /* USER CODE BEGIN I2C1_ER_IRQn 0 */
+
+  /* USER CODE END I2C1_ER_IRQn 0 */
+  HAL_I2C_ER_IRQHandler(&hi2c1);
+  /* USER CODE BEGIN I2C1_ER_IRQn 1 */
+
+  /* USER CODE END I2C1_ER_IRQn 1 */
+}
+
+/**
+  * @brief This function handles USART2 global interrupt.
+  */
+void USART2_IRQHandler(void)
+{
+  /* USER CODE BEGIN USART2_IRQn 0 */
+  App_SchedIsrEntry();
+
+#ifdef APP_CDC_BRIDGE
+  /* Idle line: the receive DMA took a burst shorter than half the ring */
+  if ((__HAL_UART_GET_FLAG(&huart2, UART_FLAG_IDLE) != RESET) && (__HAL_UART_GET_IT_SOURCE(&huart2, UART_IT_IDLE) != RESET))
+  {
+    __HAL_UART_CLEAR_IDLEFLAG(&huart2);
+    App_BridgeRxIdle();
+  }
+#else
+  /* Idle line: a frame for App_Ota.c ended short of half the ring */
+  if ((__HAL_UART_GET_FLAG(&huart2, UART_FLAG_IDLE) != RESET) && (__HAL_UART_GET_IT_SOURCE(&huart2, UART_IT_IDLE) != RESET))
+  {
+    __HAL_UART_CLEAR_IDLEFLAG(&huart2);
+    App_OtaRxIdle();
+  }
+#endif
+  /* USER CODE END USART2_IRQn 0 */
+  HAL_UART_IRQHandler(&huart2);
+  /* USER CODE BEGIN USART2_IRQn 1 */
+
+  /* USER CODE END USART2_IRQn 1 */
+}
+
+/**
+  * @brief This function handles DMA1 stream7 global interrupt.
+  */
+void DMA1_Stream7_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA1_Stream7_IRQn 0 */
+
+  /* USER CODE END DMA1_Stream7_IRQn 0 */
+  HAL_DMA_IRQHandler(&hdma_spi3_tx);
+  /* USER CODE BEGIN DMA1_Stream7_IRQn 1 */
+
+  /* USER CODE END DMA1_Stream7_IRQn 1 */
+}
+
+/**
+  * @brief This function handles DMA2 stream0 global interrupt.
+  */
+void DMA2_Stream0_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA2_Stream0_IRQn 0 */
+  App_SchedIsrEntry();
+
+  /* USER CODE END DMA2_Stream0_IRQn 0 */
+  HAL_DMA_IRQHandler(&hdma_spi1_rx);
+  /* USER CODE BEGIN DMA2_Stream0_IRQn 1 */
+
+  /* USER CODE END DMA2_Stream0_IRQn 1 */
+}
+
+/**
+  * @brief This function handles DMA2 stream3 global interrupt.
+  */
+void DMA2_Stream3_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA2_Stream3_IRQn 0 */
+
+  /* USER CODE END DMA2_Stream3_IRQn 0 */
+  HAL_DMA_IRQHandler(&hdma_spi1_tx);
+  /* USER CODE BEGIN DMA2_Stream3_IRQn 1 */
+
+  /* USER CODE END DMA2_Stream3_IRQn 1 */
+}
+
 /**
   * @brief This function handles USB On The Go FS global interrupt.
   */
 void OTG_FS_IRQHandler(void)
 {
   /* USER CODE BEGIN OTG_FS_IRQn 0 */
+  App_SchedIsrEntry();
 
   /* USER CODE END OTG_FS_IRQn 0 */
   HAL_HCD_IRQHandler(&hhcd_USB_OTG_FS);
   /* USER CODE BEGIN OTG_FS_IRQn 1 */
+  App_SchedSignal(APP_TASK_USB_HOST, APP_EVENT_USB_IRQ);
 
   /* USER CODE END OTG_FS_IRQn 1 */
 }
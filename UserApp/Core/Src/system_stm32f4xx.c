@@ -90,8 +90,14 @@
 /*!< Uncomment the following line if you need to relocate your vector Table in
      Internal SRAM. */
 /* #define VECT_TAB_SRAM */
+#ifdef VECT_TAB_SRAM
+#define VECT_TAB_OFFSET  0x10000U /*!< STM32F407VGTX_RAM.ld: the bootloader's RAM run area */
+#elif defined(APP_SLOT_B)
+#define VECT_TAB_OFFSET  0x40000U /*!< STM32F407VGTX_FLASH_SLOTB.ld: A/B slot B */
+#else
 #define VECT_TAB_OFFSET  0x8000U /*!< Vector Table base offset field.
                                    This value must be a multiple of 0x200. */
+#endif
 /******************************************************************************/
 
 /**
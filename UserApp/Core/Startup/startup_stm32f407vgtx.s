@@ -44,6 +44,17 @@ defined in linker script */
 .word  _sbss
 /* end address for the .bss section. defined in linker script */
 .word  _ebss
+/* start address for the initialization values of the .ccmram section.
+defined in linker script */
+.word  _siccmram
+/* start address for the .ccmram section. defined in linker script */
+.word  _sccmram
+/* end address for the .ccmram section. defined in linker script */
+.word  _eccmram
+/* start address for the .ccmbss section. defined in linker script */
+.word  _sccmbss
+/* end address for the .ccmbss section. defined in linker script */
+.word  _eccmbss
 /* stack used for SystemInit_ExtMemCtl; always internal RAM used */
 
 /**
@@ -89,6 +100,47 @@ LoopFillZerobss:
   cmp  r2, r3
   bcc  FillZerobss
 
+/* Copy the .ccmram initializers from flash and zero fill .ccmbss.
+   The CCMRAM clock is enabled at reset (RCC_AHB1ENR.CCMDATARAMEN). */
+  ldr  r0, =_sccmram
+  ldr  r1, =_eccmram
+  ldr  r2, =_siccmram
+  b  LoopCopyCcmramInit
+
+CopyCcmramInit:
+  ldr  r3, [r2], #4
+  str  r3, [r0], #4
+
+LoopCopyCcmramInit:
+  cmp  r0, r1
+  bcc  CopyCcmramInit
+  ldr  r2, =_sccmbss
+  ldr  r1, =_eccmbss
+  movs  r3, #0
+  b  LoopFillZeroCcmbss
+
+FillZeroCcmbss:
+  str  r3, [r2], #4
+
+LoopFillZeroCcmbss:
+  cmp  r2, r1
+  bcc  FillZeroCcmbss
+
+/* Paint the main stack's reservation, nothing is on it yet: sysmem.c finds
+ * how deep it went by the words still holding the pattern (MemoryUsage.h) */
+  ldr  r1, =_estack
+  ldr  r2, =_Min_Stack_Size
+  subs  r2, r1, r2
+  ldr  r3, =0x5354434B
+  b  LoopPaintStack
+
+PaintStack:
+  str  r3, [r2], #4
+
+LoopPaintStack:
+  cmp  r2, r1
+  bcc  PaintStack
+
 /* Call the clock system intitialization function.*/
   bl  SystemInit   
 /* Call static constructors */
@@ -26,6 +26,10 @@
 #include "usbh_cdc.h"
 
 /* USER CODE BEGIN Includes */
+#include "App_Cdc.h"
+#include "App_Msc.h"
+#include "App_Hub.h"
+#include "App_Bridge.h"
 
 /* USER CODE END Includes */
 
@@ -86,6 +90,16 @@ void MX_USB_HOST_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN USB_HOST_Init_PostTreatment */
+  /* Flash drives for App_Update.h; USBH_MAX_NUM_SUPPORTED_CLASS counts it */
+  if (USBH_RegisterClass(&hUsbHostFS, &App_MscClass) != USBH_OK)
+  {
+    Error_Handler();
+  }
+  /* CDC devices behind a hub (App_Hub.h) */
+  if (USBH_RegisterClass(&hUsbHostFS, &App_HubClass) != USBH_OK)
+  {
+    Error_Handler();
+  }
 
   /* USER CODE END USB_HOST_Init_PostTreatment */
 }
@@ -111,10 +125,23 @@ static void USBH_UserProcess  (USBH_HandleTypeDef *phost, uint8_t id)
 
   case HOST_USER_DISCONNECTION:
   Appli_state = APPLICATION_DISCONNECT;
+#ifdef APP_CDC_BRIDGE
+  App_BridgeStop();
+#else
+  App_CdcStop();
+#endif
   break;
 
   case HOST_USER_CLASS_ACTIVE:
   Appli_state = APPLICATION_READY;
+  if (phost->pActiveClass == USBH_CDC_CLASS)
+  {
+#ifdef APP_CDC_BRIDGE
+    App_BridgeStart();
+#else
+    App_CdcStart();
+#endif
+  }
   break;
 
   case HOST_USER_CONNECTION:
@@ -75,7 +75,7 @@
 #define USBH_KEEP_CFG_DESCRIPTOR      1U
 
 /*----------   -----------*/
-#define USBH_MAX_NUM_SUPPORTED_CLASS      1U
+#define USBH_MAX_NUM_SUPPORTED_CLASS      3U
 
 /*----------   -----------*/
 #define USBH_MAX_SIZE_CONFIGURATION      256U